@@ -0,0 +1,193 @@
+#!/usr/bin/env perl
+
+################################################################################
+#
+#
+#    WashingtonDC Dreamcast Emulator
+#    Copyright (C) 2020 snickerbockers
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#
+################################################################################
+
+################################################################################
+#
+# Runs every workload listed in the corpus file (homebrew_corpus.txt by
+# default) through washdc-headless's benchmark mode and compares the results
+# against the baselines stored in that same file.
+#
+# Each workload is a homebrew program which gets booted straight from its
+# 1ST_READ.BIN (-u), so nothing from the corpus needs a GD-ROM image.  It's
+# run for a fixed number of frames (-B), and then the frames per second and the
+# CRC32 of the final framebuffer from the JSON benchmark report are checked.  A
+# workload fails if its framebuffer CRC doesn't match the baseline exactly, or
+# if its FPS falls more than $FPS_TOLERANCE below the baseline.
+#
+# The corpus file has one workload per line:
+#
+#     name frames baseline_fps baseline_fb_crc32 binary [extra args...]
+#
+# binary is either a local path or a URL that can be downloaded using curl.
+# Downloaded binaries are kept in $CACHE_DIR so they only get fetched once.  A
+# baseline of - means that value isn't checked.  Anything after the binary gets
+# passed through to washdc-headless, so the same program can be listed more
+# than once (for example, once with -p for the interpreter and once with -x
+# for the native jit).  Lines beginning with # are comments.
+#
+# Run with --update to overwrite the baselines with the measured values instead
+# of checking them.
+#
+# Run with --alloc-audit to check that nothing allocates heap memory once the
+# emulator has warmed up instead of checking the fps.  The second half of each
+# workload gets audited (-M), and the workload fails if anything allocated.
+# This needs a washdc-headless built with ENABLE_ALLOC_AUDIT.
+#
+# Direct boot still needs a firmware image, a flash image and the system call
+# image; those come from the same paths the other regression tests use unless
+# they're overridden by the environment variables below.
+#
+################################################################################
+
+use File::Basename;
+
+$FIRMWARE_PATH = $ENV{'WASHDC_BIOS'} || "./dc_bios.bin";
+$FLASH_PATH = $ENV{'WASHDC_FLASH'} || "./dc_flash.bin";
+$SYSCALL_PATH = $ENV{'WASHDC_SYSCALLS'} || "./syscalls.bin";
+$WASH_PATH = $ENV{'WASHDC_HEADLESS'} || "./src/washdc-headless/washdc-headless";
+
+# maximum allowed slowdown relative to the baseline fps, as a fraction
+$FPS_TOLERANCE = $ENV{'HOMEBREW_FPS_TOLERANCE'} || 0.10;
+
+$CACHE_DIR = $ENV{'HOMEBREW_CACHE_DIR'} || "./homebrew_corpus_cache";
+
+$update = 0;
+$alloc_audit = 0;
+$corpus_path = dirname(__FILE__) . "/homebrew_corpus.txt";
+
+foreach $arg ( @ARGV ) {
+    if ($arg eq "--update") {
+        $update = 1;
+    } elsif ($arg eq "--alloc-audit") {
+        $alloc_audit = 1;
+    } else {
+        $corpus_path = $arg;
+    }
+}
+
+open($corpus_file, "< $corpus_path") || die "failed to open $corpus_path";
+@corpus_lines = <$corpus_file>;
+close($corpus_file);
+
+# returns a local path to the given binary, downloading it if necessary
+sub fetch_binary {
+    my ($name, $binary) = @_;
+
+    if (not $binary =~ /^[a-z]+:\/\//) {
+        return $binary;
+    }
+
+    my $local_path = "$CACHE_DIR/$name.bin";
+    if (not -e $local_path) {
+        mkdir $CACHE_DIR;
+        system("curl -L -f -o $local_path $binary") and
+            die "could not download \"$binary\"";
+    }
+    return $local_path;
+}
+
+$n_workloads = 0;
+$n_failures = 0;
+
+printf("%-24s %10s %10s %10s %10s  %s\n", "workload", "base fps", "fps",
+       "base crc", "crc", "result");
+
+for (my $line_no = 0; $line_no < scalar(@corpus_lines); $line_no++) {
+    my $line = $corpus_lines[$line_no];
+    if ($line =~ /^\s*(#.*)?$/) {
+        next;
+    }
+
+    my ($name, $frames, $base_fps, $base_crc, $binary, @extra_args) =
+        split(' ', $line);
+    if (not defined $binary) {
+        die "$corpus_path line " . ($line_no + 1) . " is malformed";
+    }
+    $n_workloads++;
+
+    my $bin_path = fetch_binary($name, $binary);
+    my $wash_cmd = "$WASH_PATH -b $FIRMWARE_PATH -f $FLASH_PATH " .
+        "-s $SYSCALL_PATH -u $bin_path -B $frames @extra_args";
+    if ($alloc_audit) {
+        my $warmup = int($frames / 2) || 1;
+        $wash_cmd = "$wash_cmd -M $warmup";
+    }
+
+    my $report = `$wash_cmd`;
+    my $exit_code = $?;
+
+    my ($fps, $crc);
+    if ($report =~ /"fps":\s*([0-9.]+)/) {
+        $fps = sprintf("%.2f", $1);
+    }
+    if ($report =~ /"fb_crc32":\s*"([0-9a-f]+)"/) {
+        $crc = $1;
+    }
+    my $n_allocs;
+    if ($report =~ /"steady_state_allocs":\s*([0-9]+)/) {
+        $n_allocs = $1;
+    }
+
+    my $result = "PASS";
+    if ($exit_code != 0 or not defined $fps or not defined $crc) {
+        $result = "FAIL (\"$wash_cmd\" exited with $exit_code)";
+        $fps = "-" unless defined $fps;
+        $crc = "-" unless defined $crc;
+    } elsif ($update) {
+        $result = "UPDATED";
+        $corpus_lines[$line_no] =
+            join(' ', $name, $frames, $fps, $crc, $binary, @extra_args) . "\n";
+    } elsif ($base_crc ne "-" and $crc ne $base_crc) {
+        $result = "FAIL (framebuffer mismatch)";
+    } elsif ($alloc_audit) {
+        if (not defined $n_allocs) {
+            $result = "FAIL (no allocation audit in the report)";
+        } elsif ($n_allocs > 0) {
+            $result = "FAIL ($n_allocs allocations)";
+        }
+    } elsif ($base_fps ne "-" and $fps < $base_fps * (1.0 - $FPS_TOLERANCE)) {
+        $result = "FAIL (too slow)";
+    }
+
+    if ($result =~ /^FAIL/) {
+        $n_failures++;
+    }
+
+    printf("%-24s %10s %10s %10s %10s  %s\n", $name, $base_fps, $fps,
+           $base_crc, $crc, $result);
+}
+
+if ($update) {
+    open($corpus_file, "> $corpus_path") || die "failed to open $corpus_path";
+    print $corpus_file @corpus_lines;
+    close($corpus_file);
+}
+
+if ($n_workloads == 0) {
+    print "$corpus_path does not list any workloads\n";
+}
+
+printf("%d of %d workloads failed\n", $n_failures, $n_workloads);
+
+exit($n_failures ? 1 : 0);
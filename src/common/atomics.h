@@ -77,6 +77,40 @@ static inline void washdc_atomic_int_init(washdc_atomic_int *atom, int val) {
     *atom = val;
 }
 
+static inline void washdc_atomic_int_store(washdc_atomic_int *atom, int val) {
+    InterlockedExchange(atom, val);
+}
+
+/*
+ * The Interlocked functions are all full barriers, so these are stronger than
+ * they need to be.
+ */
+static inline int washdc_atomic_int_load_relaxed(washdc_atomic_int *atom) {
+    return *atom;
+}
+
+static inline int washdc_atomic_int_load_acquire(washdc_atomic_int *atom) {
+    return InterlockedCompareExchange(atom, 0, 0);
+}
+
+static inline void
+washdc_atomic_int_store_release(washdc_atomic_int *atom, int val) {
+    InterlockedExchange(atom, val);
+}
+
+static inline void
+washdc_atomic_int_store_relaxed(washdc_atomic_int *atom, int val) {
+    *atom = val;
+}
+
+static inline void washdc_atomic_fence_acquire(void) {
+    MemoryBarrier();
+}
+
+static inline void washdc_atomic_fence_release(void) {
+    MemoryBarrier();
+}
+
 #else
 /*
  * Here we foolishly assume that any compiler which isn't MSVC will support C11
@@ -114,6 +148,36 @@ static inline void washdc_atomic_int_init(washdc_atomic_int *atom, int val) {
     atomic_init(atom, val);
 }
 
+static inline void washdc_atomic_int_store(washdc_atomic_int *atom, int val) {
+    atomic_store(atom, val);
+}
+
+static inline int washdc_atomic_int_load_relaxed(washdc_atomic_int *atom) {
+    return atomic_load_explicit(atom, memory_order_relaxed);
+}
+
+static inline int washdc_atomic_int_load_acquire(washdc_atomic_int *atom) {
+    return atomic_load_explicit(atom, memory_order_acquire);
+}
+
+static inline void
+washdc_atomic_int_store_release(washdc_atomic_int *atom, int val) {
+    atomic_store_explicit(atom, val, memory_order_release);
+}
+
+static inline void
+washdc_atomic_int_store_relaxed(washdc_atomic_int *atom, int val) {
+    atomic_store_explicit(atom, val, memory_order_relaxed);
+}
+
+static inline void washdc_atomic_fence_acquire(void) {
+    atomic_thread_fence(memory_order_acquire);
+}
+
+static inline void washdc_atomic_fence_release(void) {
+    atomic_thread_fence(memory_order_release);
+}
+
 #endif
 
 #ifdef __cplusplus
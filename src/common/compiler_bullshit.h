@@ -27,11 +27,13 @@
 
 #define WASHDC_NORETURN __attribute__((__noreturn__))
 #define WASHDC_UNUSED __attribute__((unused))
+#define WASHDC_ALWAYS_INLINE inline __attribute__((always_inline))
 
 #elif defined(_MSC_VER)
 
 #define WASHDC_NORETURN __declspec(noreturn)
 #define WASHDC_UNUSED
+#define WASHDC_ALWAYS_INLINE __forceinline
 
 #else
 #error unknown compiler
@@ -0,0 +1,348 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef USE_LIBEVENT
+#error recompile with -DUSE_LIBEVENT=On
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <event2/event.h>
+#include <event2/bufferevent.h>
+#include <event2/listener.h>
+#include <event2/buffer.h>
+
+#include "washdc/error.h"
+#include "washdc/washdc.h"
+#include "io_thread.hpp"
+
+#include "ctl_server.hpp"
+
+// how often to check whether a run command has finished, in microseconds
+#define CTL_RUN_POLL_US 1000
+
+struct ctl_conn {
+    struct bufferevent *bev;
+
+    /*
+     * done_ev gets activated (from whichever thread finished the command)
+     * once reply is ready.  poll_ev checks up on run commands.
+     */
+    struct event *done_ev;
+    struct event *poll_ev;
+
+    // set while a command is in flight; nothing else gets read until it's done
+    bool busy;
+
+    // set if the client went away while busy
+    bool closed;
+
+    /*
+     * a run command waits for the emulator to pause (it might still be
+     * booting) before starting, and then waits until it's at run_target.
+     */
+    unsigned run_frames, run_target;
+    std::string arg;
+    std::string reply;
+};
+
+static bool enabled;
+static unsigned port;
+static std::string boot_path;
+static struct evconnlistener *listener;
+static void (*metrics_fn)(std::ostream &os);
+
+static void
+listener_cb(struct evconnlistener *listener,
+            evutil_socket_t fd, struct sockaddr *saddr,
+            int socklen, void *arg);
+static void handle_read(struct bufferevent *bev, void *arg);
+static void handle_events(struct bufferevent *bev, short events, void *arg);
+static void done_cb(evutil_socket_t fd, short ev, void *arg);
+static void poll_cb(evutil_socket_t fd, short ev, void *arg);
+static void conn_free(struct ctl_conn *conn);
+static void conn_reply(struct ctl_conn *conn, std::string const& msg);
+static void process_lines(struct ctl_conn *conn);
+static void run_cmd(struct ctl_conn *conn, std::string const& line);
+static void finish_on_emu_thread(struct ctl_conn *conn,
+                                 void (*func)(void*));
+
+void ctl_server_enable(unsigned port_no, char const *boot_state_path) {
+    enabled = true;
+    port = port_no;
+    boot_path = boot_state_path;
+}
+
+void ctl_server_set_metrics_fn(void (*fn)(std::ostream &os)) {
+    metrics_fn = fn;
+}
+
+void ctl_server_boot(void) {
+    washdc_savestate_checkpoint(boot_path.c_str());
+    washdc_pause();
+}
+
+void ctl_server_init(void) {
+    if (!enabled)
+        return;
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    unsigned evflags = LEV_OPT_THREADSAFE | LEV_OPT_REUSEABLE |
+        LEV_OPT_CLOSE_ON_FREE;
+    listener = evconnlistener_new_bind(io::event_base, listener_cb,
+                                       NULL, evflags, -1,
+                                       (struct sockaddr*)&sin, sizeof(sin));
+    if (!listener)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    std::cout << "Accepting control connections on port " << port <<
+        std::endl;
+}
+
+void ctl_server_cleanup(void) {
+    if (listener)
+        evconnlistener_free(listener);
+    listener = NULL;
+}
+
+static void
+listener_cb(struct evconnlistener *listener,
+            evutil_socket_t fd, struct sockaddr *saddr,
+            int socklen, void *arg) {
+    struct ctl_conn *conn = new ctl_conn();
+
+    conn->bev = bufferevent_socket_new(io::event_base, fd,
+                                       BEV_OPT_CLOSE_ON_FREE);
+    conn->done_ev = event_new(io::event_base, -1, 0, done_cb, conn);
+    conn->poll_ev = event_new(io::event_base, -1, EV_PERSIST, poll_cb, conn);
+    if (!conn->bev || !conn->done_ev || !conn->poll_ev)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    bufferevent_setcb(conn->bev, handle_read, NULL, handle_events, conn);
+    bufferevent_enable(conn->bev, EV_READ | EV_WRITE);
+}
+
+static void handle_read(struct bufferevent *bev, void *arg) {
+    process_lines((struct ctl_conn*)arg);
+}
+
+static void handle_events(struct bufferevent *bev, short events, void *arg) {
+    struct ctl_conn *conn = (struct ctl_conn*)arg;
+    if (!(events & BEV_EVENT_EOF))
+        std::cerr << "control connection closed with error" << std::endl;
+
+    // a command in flight still holds onto conn, so let it clean up
+    if (conn->busy)
+        conn->closed = true;
+    else
+        conn_free(conn);
+}
+
+static void conn_free(struct ctl_conn *conn) {
+    event_free(conn->poll_ev);
+    event_free(conn->done_ev);
+    bufferevent_free(conn->bev);
+    delete conn;
+}
+
+static void conn_reply(struct ctl_conn *conn, std::string const& msg) {
+    std::string line = msg + "\n";
+    bufferevent_write(conn->bev, line.c_str(), line.size());
+}
+
+static void process_lines(struct ctl_conn *conn) {
+    struct evbuffer *input = bufferevent_get_input(conn->bev);
+    while (!conn->busy) {
+        size_t len;
+        char *line = evbuffer_readln(input, &len, EVBUFFER_EOL_ANY);
+        if (!line)
+            return;
+        std::string cmd(line, len);
+        free(line);
+        if (cmd.find_first_not_of(" \t") != std::string::npos)
+            run_cmd(conn, cmd);
+    }
+}
+
+// io thread, once whatever finished the command filled out conn->reply
+static void done_cb(evutil_socket_t fd, short ev, void *arg) {
+    struct ctl_conn *conn = (struct ctl_conn*)arg;
+    conn->busy = false;
+    if (conn->closed) {
+        conn_free(conn);
+        return;
+    }
+    conn_reply(conn, conn->reply);
+    process_lines(conn);
+}
+
+static void poll_cb(evutil_socket_t fd, short ev, void *arg) {
+    struct ctl_conn *conn = (struct ctl_conn*)arg;
+    if (!washdc_is_running()) {
+        event_del(conn->poll_ev);
+        conn->reply = "ERR emulator exited";
+        event_active(conn->done_ev, 0, 0);
+    } else if (!washdc_is_paused()) {
+        return;
+    } else if (conn->run_frames) {
+        conn->run_target = washdc_get_frame_count() + conn->run_frames;
+        if (washdc_run_frames(conn->run_frames) == 0)
+            conn->run_frames = 0;
+    } else if (washdc_get_frame_count() >= conn->run_target) {
+        event_del(conn->poll_ev);
+        conn->reply = "OK " + std::to_string(washdc_get_frame_count());
+        event_active(conn->done_ev, 0, 0);
+    }
+}
+
+/*
+ * emulation-thread halves of the commands.  Each one fills out conn->reply
+ * and hands the connection back to the io thread.
+ */
+static void emu_reply_ok(void *argp) {
+    struct ctl_conn *conn = (struct ctl_conn*)argp;
+    conn->reply = "OK";
+    event_active(conn->done_ev, 0, 0);
+}
+
+static void emu_load(void *argp) {
+    struct ctl_conn *conn = (struct ctl_conn*)argp;
+    if (washdc_load_disc(conn->arg.c_str()) == 0)
+        conn->reply = "OK";
+    else
+        conn->reply = "ERR unable to mount " + conn->arg;
+    event_active(conn->done_ev, 0, 0);
+}
+
+static void emu_screenshot(void *argp) {
+    struct ctl_conn *conn = (struct ctl_conn*)argp;
+    if (washdc_save_screenshot(conn->arg.c_str()) == 0)
+        conn->reply = "OK";
+    else
+        conn->reply = "ERR unable to write " + conn->arg;
+    event_active(conn->done_ev, 0, 0);
+}
+
+static void emu_metrics(void *argp) {
+    struct ctl_conn *conn = (struct ctl_conn*)argp;
+    struct washdc_perf_stat perf;
+    struct washdc_pvr2_stat pvr2;
+    washdc_get_perf_stat(&perf);
+    washdc_get_pvr2_stat(&pvr2);
+
+    std::stringstream ss;
+    ss << "OK {\"frames\":" << washdc_get_frame_count() <<
+        ",\"fps\":" << washdc_get_fps() <<
+        ",\"virt_fps\":" << washdc_get_virt_fps() <<
+        ",\"code_cache_entries\":" << perf.code_cache_entries <<
+        ",\"jit_compiles\":" << perf.jit_compiles <<
+        ",\"exec_mem_free_bytes\":" << perf.exec_mem_free_bytes <<
+        ",\"exec_mem_total_bytes\":" << perf.exec_mem_total_bytes <<
+        ",\"ch2_dma_bytes\":" << perf.ch2_dma_bytes <<
+        ",\"gdrom_dma_bytes\":" << perf.gdrom_dma_bytes <<
+        ",\"tex_cache_hits\":" << pvr2.tex_cache_hit_count <<
+        ",\"tex_cache_misses\":" << pvr2.tex_cache_miss_count <<
+        ",\"tex_xmits\":" << pvr2.tex_xmit_count;
+    if (metrics_fn)
+        metrics_fn(ss);
+    ss << "}";
+    conn->reply = ss.str();
+    event_active(conn->done_ev, 0, 0);
+}
+
+/*
+ * save-state requests get handled at the end of the frame before anything
+ * queued with washdc_run_on_emu_thread, so func doubles as a way to find out
+ * when they're done.
+ */
+static void finish_on_emu_thread(struct ctl_conn *conn,
+                                 void (*func)(void*)) {
+    conn->busy = true;
+    if (washdc_run_on_emu_thread(func, conn) != 0) {
+        conn->reply = "ERR too many requests";
+        event_active(conn->done_ev, 0, 0);
+    }
+}
+
+static void run_cmd(struct ctl_conn *conn, std::string const& line) {
+    std::istringstream ss(line);
+    std::string cmd;
+    ss >> cmd;
+
+    conn->arg.clear();
+    if (cmd != "run" && cmd != "restore") {
+        std::getline(ss >> std::ws, conn->arg);
+        size_t last = conn->arg.find_last_not_of(" \t");
+        conn->arg.erase(last == std::string::npos ? 0 : last + 1);
+    }
+
+    if ((cmd == "load" || cmd == "snapshot" || cmd == "screenshot") &&
+        conn->arg.empty()) {
+        conn_reply(conn, "ERR usage: " + cmd + " <path>");
+        return;
+    }
+
+    if (cmd == "run") {
+        long n_frames = 0;
+        if (!(ss >> n_frames) || n_frames <= 0) {
+            conn_reply(conn, "ERR usage: run <n>");
+        } else {
+            struct timeval tv = { 0, CTL_RUN_POLL_US };
+            conn->run_frames = n_frames;
+            conn->busy = true;
+            event_add(conn->poll_ev, &tv);
+        }
+    } else if (cmd == "reset") {
+        washdc_savestate_restore(boot_path.c_str(), 0);
+        finish_on_emu_thread(conn, emu_reply_ok);
+    } else if (cmd == "load") {
+        finish_on_emu_thread(conn, emu_load);
+    } else if (cmd == "snapshot") {
+        washdc_savestate_checkpoint(conn->arg.c_str());
+        finish_on_emu_thread(conn, emu_reply_ok);
+    } else if (cmd == "restore") {
+        unsigned checkpoint_no = 0;
+        if (!(ss >> conn->arg)) {
+            conn_reply(conn, "ERR usage: restore <path> [<n>]");
+            return;
+        }
+        ss >> checkpoint_no;
+        washdc_savestate_restore(conn->arg.c_str(), checkpoint_no);
+        finish_on_emu_thread(conn, emu_reply_ok);
+    } else if (cmd == "screenshot") {
+        finish_on_emu_thread(conn, emu_screenshot);
+    } else if (cmd == "metrics") {
+        finish_on_emu_thread(conn, emu_metrics);
+    } else if (cmd == "quit") {
+        conn_reply(conn, "OK");
+        washdc_kill();
+    } else {
+        conn_reply(conn, "ERR unknown command \"" + cmd + "\"");
+    }
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef CTL_SERVER_HPP_
+#define CTL_SERVER_HPP_
+
+#ifndef USE_LIBEVENT
+#error this file should not be built with USE_LIBEVENT disabled!
+#endif
+
+#include <ostream>
+
+/*
+ * Control server for running WashingtonDC as a long-lived service.
+ *
+ * The emulator sits paused at the end of a frame and a client drives it over
+ * TCP, one command per line.  Every command gets back exactly one line,
+ * either "OK" (possibly followed by a result) or "ERR <reason>".  Commands on
+ * the same connection are handled one at a time in the order they arrive.
+ *
+ *     run <n>                 run n frames, replies with the frame count
+ *     reset                   go back to the state from right after boot
+ *     load <path>             put a GDI/CDI/DCZ image in the GD-ROM drive
+ *     snapshot <path>         append a checkpoint to a save-state file
+ *     restore <path> [<n>]    go back to checkpoint n (default 0) of path
+ *     screenshot <path>       save a PNG (or QOI) of the current frame
+ *     metrics                 replies with a JSON object of counters
+ *     quit                    shut down the emulator
+ *
+ * Since the process stays alive between tests, everything that's expensive
+ * to set up (the graphics context, compiled shaders, mapped disc images and
+ * the code cache) stays warm from one test to the next.
+ */
+
+/*
+ * call this before io::init to make the io thread listen for control
+ * connections on port_no.  boot_state_path is the save-state file that
+ * "reset" rolls back to; the frontend is responsible for writing checkpoint
+ * 0 of it with ctl_server_boot before washdc_run.
+ */
+void ctl_server_enable(unsigned port_no, char const *boot_state_path);
+
+/*
+ * checkpoint the state after the first frame to the boot state and pause
+ * there so that the emulator waits for commands.  Call this after
+ * washdc_init but before washdc_run.
+ */
+void ctl_server_boot(void);
+
+/*
+ * optional.  The metrics command calls fn on the emulation thread, and
+ * whatever it writes goes at the end of the reply's JSON object, so it should
+ * only write whole members, each one starting with a comma.
+ */
+void ctl_server_set_metrics_fn(void (*fn)(std::ostream &os));
+
+// these get called from the io thread
+void ctl_server_init(void);
+void ctl_server_cleanup(void);
+
+#endif
@@ -60,6 +60,18 @@
 #define GDB_ASSERT(x)
 #endif
 
+/*
+ * maximum packet size advertised to the remote end in qSupported.  This is big
+ * enough that gdb can move 64KB of memory per m packet.
+ */
+#define GDB_PACKET_SIZE 0x20000
+
+/*
+ * incoming packets larger than this get dropped instead of growing the input
+ * buffer forever
+ */
+#define GDB_MAX_INPUT_PACKET (4 * GDB_PACKET_SIZE)
+
 enum gdb_state {
     GDB_STATE_DISABLED,
 
@@ -77,7 +89,19 @@ struct gdb_stub {
     // the last unsuccessfully acknowledged packet, or empty if there is none
     struct string unack_packet;
 
-    struct string input_packet;
+    /*
+     * raw bytes of the packet currently being received, starting with the '$'.
+     * This isn't a struct string because X packets carry binary data which
+     * can contain NUL bytes.
+     */
+    char *input_buf;
+    size_t input_len, input_cap;
+
+    // index of the '#' in input_buf, or 0 if it hasn't been received yet
+    size_t input_pound_idx;
+
+    // XML memory map sent in response to qXfer:memory-map:read
+    struct string mem_map_xml;
 
     bool frontend_supports_swbreak;
 
@@ -135,18 +159,17 @@ static size_t deserialize_data(struct string const *input_str,
                                void *out, size_t max_sz);
 static int decode_hex(char ch);
 static void do_write(void);
-static void extract_packet(struct string *out, struct string const *packet_in);
 static int set_reg(reg32_t reg_file[SH4_REGISTER_COUNT],
                    unsigned reg_no, reg32_t reg_val);
-static void handle_packet(struct string *pkt);
+static void handle_packet(char const *dat, size_t dat_len);
 static void transmit_pkt(struct string const *pkt);
-static bool next_packet(struct string *pkt);
 
 static void handle_c_packet(struct string *out, struct string *dat);
 static void handle_q_packet(struct string *out, struct string const *dat);
 static void handle_g_packet(struct string *out, struct string const *dat);
 static void handle_m_packet(struct string *out, struct string const *dat);
 static void handle_M_packet(struct string *out, struct string const *dat);
+static void handle_X_packet(struct string *out, char const *dat, size_t len);
 static void handle_s_packet(struct string *out, struct string const *dat);
 static void handle_G_packet(struct string *out, struct string const *dat);
 static void handle_P_packet(struct string *out, struct string const *dat);
@@ -201,6 +224,8 @@ static void on_write_watchpoint_event(evutil_socket_t fd, short ev, void *arg);
  */
 static int gdb_stub_read_mem(void *out, addr32_t addr, unsigned len);
 static int gdb_stub_write_mem(void const *input, addr32_t addr, unsigned len);
+static unsigned gdb_stub_get_mem_ranges(struct debug_mem_range *ranges,
+                                        unsigned max_ranges);
 static int gdb_stub_add_break(addr32_t addr);
 static int gdb_stub_remove_break(addr32_t addr);
 static int gdb_stub_add_write_watchpoint(addr32_t addr, unsigned len);
@@ -269,7 +294,12 @@ void gdb_init(void) {
                                                   on_write_watchpoint_event, NULL);
 
     string_init(&stub.unack_packet);
-    string_init(&stub.input_packet);
+    string_init(&stub.mem_map_xml);
+
+    stub.input_buf = NULL;
+    stub.input_len = 0;
+    stub.input_cap = 0;
+    stub.input_pound_idx = 0;
 
     stub.frontend_supports_swbreak = false;
     stub.listener = NULL;
@@ -318,7 +348,9 @@ void gdb_cleanup(void) {
     if (stub.listener)
         evconnlistener_free(stub.listener);
 
-    string_cleanup(&stub.input_packet);
+    free(stub.input_buf);
+    stub.input_buf = NULL;
+    string_cleanup(&stub.mem_map_xml);
     string_cleanup(&stub.unack_packet);
 
     event_free(gdb_inform_write_watchpoint_event);
@@ -456,11 +488,26 @@ static void serialize_data(struct string *out, void const *buf,
         'c', 'd', 'e', 'f'
     };
 
+    /*
+     * string_append_char reallocates the whole string every time, so build the
+     * hex string separately and append it all at once.
+     */
+    char *hex = (char*)malloc(2 * (size_t)buf_len + 1);
+    if (!hex) {
+        error_set_length(2 * (size_t)buf_len + 1);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    char *hex_ptr = hex;
     for (unsigned i = 0; i < buf_len; i++) {
-        string_append_char(out, hex_tbl[(*buf8) >> 4]);
-        string_append_char(out, hex_tbl[(*buf8) & 0xf]);
+        *hex_ptr++ = hex_tbl[(*buf8) >> 4];
+        *hex_ptr++ = hex_tbl[(*buf8) & 0xf];
         buf8++;
     }
+    *hex_ptr = '\0';
+
+    string_append(out, hex);
+    free(hex);
 }
 
 static int decode_hex(char ch)
@@ -514,16 +561,6 @@ static void craft_packet(struct string *out, struct string const *in) {
     string_append_char(out, hex_tbl[csum & 0xf]);
 }
 
-static void extract_packet(struct string *out, struct string const *packet_in) {
-    int dollar_idx = string_find_first_of(packet_in, "$");
-    int pound_idx = string_find_last_of(packet_in, "#");
-
-    if (dollar_idx < 0 || pound_idx < 0)
-        return;
-
-    string_substr(out, packet_in, dollar_idx + 1, pound_idx - 1);
-}
-
 static int conv_reg_idx_to_sh4(unsigned reg_no, reg32_t reg_sr) {
     if (reg_no >= R0 && reg_no <= R15)
         return debug_gen_reg_idx(DEBUG_CONTEXT_SH4, reg_no - R0);
@@ -606,6 +643,81 @@ static void handle_c_packet(struct string *out, struct string *dat) {
     debug_request_continue();
 }
 
+static void build_memory_map_xml(struct string *xml) {
+    unsigned n_ranges = gdb_stub_get_mem_ranges(NULL, 0);
+    struct debug_mem_range *ranges = (struct debug_mem_range*)
+        malloc(sizeof(struct debug_mem_range) * (n_ranges ? n_ranges : 1));
+    if (!ranges)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    n_ranges = gdb_stub_get_mem_ranges(ranges, n_ranges);
+
+    string_set(xml, "<?xml version=\"1.0\"?>\n<memory-map>\n");
+    for (unsigned idx = 0; idx < n_ranges; idx++) {
+        uint32_t len = ranges[idx].last - ranges[idx].first + 1;
+        string_append(xml, ranges[idx].rom ?
+                      "  <memory type=\"rom\" start=\"0x" :
+                      "  <memory type=\"ram\" start=\"0x");
+        string_append_hex32(xml, ranges[idx].first);
+        string_append(xml, "\" length=\"0x");
+        string_append_hex32(xml, len);
+        string_append(xml, "\"/>\n");
+    }
+    string_append(xml, "</memory-map>\n");
+
+    free(ranges);
+}
+
+/*
+ * qXfer:memory-map:read::offset,length
+ *
+ * the memory map gets generated when gdb asks for the first chunk and then
+ * served piecewise out of stub.mem_map_xml.
+ */
+static void handle_qxfer_memory_map(struct string *out,
+                                    struct string const *dat) {
+    int comma_idx = string_find_last_of(dat, ",");
+    if (comma_idx < 0) {
+        err_str(out, EINVAL);
+        return;
+    }
+
+    struct string offs_str, len_str;
+    string_init(&offs_str);
+    string_init(&len_str);
+    string_substr(&offs_str, dat, 23, comma_idx - 1);
+    string_substr(&len_str, dat, comma_idx + 1, string_length(dat) - 1);
+    uint32_t offs = string_read_hex32(&offs_str, 0);
+    uint32_t len = string_read_hex32(&len_str, 0);
+    string_cleanup(&len_str);
+    string_cleanup(&offs_str);
+
+    if (offs == 0 || !string_length(&stub.mem_map_xml))
+        build_memory_map_xml(&stub.mem_map_xml);
+
+    size_t xml_len = string_length(&stub.mem_map_xml);
+    if (offs >= xml_len) {
+        string_set(out, "l");
+        return;
+    }
+
+    // leave room for the 'm'/'l' prefix and the packet framing
+    if (len > GDB_PACKET_SIZE - 5)
+        len = GDB_PACKET_SIZE - 5;
+
+    size_t remaining = xml_len - offs;
+    if (len >= remaining) {
+        string_set(out, "l");
+        string_append(out, string_get(&stub.mem_map_xml) + offs);
+    } else {
+        string_set(out, "m");
+        struct string chunk;
+        string_init(&chunk);
+        string_substr(&chunk, &stub.mem_map_xml, offs, offs + len - 1);
+        string_append(out, string_get(&chunk));
+        string_cleanup(&chunk);
+    }
+}
+
 static void handle_q_packet(struct string *out, struct string const *dat_orig) {
     struct string dat, tok;
     string_init(&dat);
@@ -616,7 +728,7 @@ static void handle_q_packet(struct string *out, struct string const *dat_orig) {
         int semicolon_idx = string_find_first_of(&dat, ";");
 
         if (semicolon_idx == -1)
-            goto cleanup;
+            goto report_features;
 
         struct string tmp;
         string_init(&tmp);
@@ -653,12 +765,19 @@ static void handle_q_packet(struct string *out, struct string const *dat_orig) {
                 } else {
                     string_append(out, "swbreak-;");
                 }
-            } else {
+            } else if (strcmp(string_get(&tok), "qXfer:memory-map:read") != 0) {
                 string_append(out, string_get(&tok));
                 string_append(out, "-;");
             }
         }
 
+    report_features:
+        string_append(out, "PacketSize=");
+        string_append_hex32(out, GDB_PACKET_SIZE);
+        string_append(out, ";qXfer:memory-map:read+");
+        goto cleanup;
+    } else if (string_eq_n(&dat, "qXfer:memory-map:read::", 23)) {
+        handle_qxfer_memory_map(out, &dat);
         goto cleanup;
     }
 
@@ -743,8 +862,19 @@ static void handle_M_packet(struct string *out, struct string const *dat) {
     struct string new_dat;
     string_init(&new_dat);
     string_substr(&new_dat, dat, dat_idx, string_length(dat) - 1);
-    if (len < 1024) {
+    if (len > string_length(&new_dat) / 2) {
+        // the packet doesn't actually contain as much data as it claims
+        err_str(out, EINVAL);
+        string_cleanup(&new_dat);
+        return;
+    }
+
+    if (len) {
         uint8_t *buf = (uint8_t*)malloc(sizeof(uint8_t) * len);
+        if (!buf) {
+            error_set_length(len);
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        }
         deserialize_data(&new_dat, buf, len);
         int err = gdb_stub_write_mem(buf, addr, len);
         free(buf);
@@ -754,15 +884,85 @@ static void handle_M_packet(struct string *out, struct string const *dat) {
             string_cleanup(&new_dat);
             return;
         }
-    } else {
-        error_set_length(len);
-        RAISE_ERROR(ERROR_INVALID_PARAM);
     }
     string_cleanup(&new_dat);
 
     string_set(out, "OK");
 }
 
+static char const *read_hex32_raw(char const *ptr, char const *end,
+                                  uint32_t *val_out) {
+    uint32_t val = 0;
+    int digit;
+    while (ptr < end && (digit = decode_hex(*ptr)) >= 0) {
+        val = (val << 4) | digit;
+        ptr++;
+    }
+    *val_out = val;
+    return ptr;
+}
+
+/*
+ * X addr,length:XX...
+ *
+ * Like the M packet, except the data is sent as raw binary instead of as hex.
+ * The characters '#', '$', '}' and '*' are escaped as 0x7d followed by the
+ * original character XOR 0x20.  This gets the raw packet because the data can
+ * contain NUL bytes.
+ */
+static void handle_X_packet(struct string *out, char const *dat, size_t len) {
+    char const *end = dat + len;
+    char const *ptr = dat + 1;
+    uint32_t addr, n_bytes;
+
+    ptr = read_hex32_raw(ptr, end, &addr);
+    if (ptr >= end || *ptr != ',') {
+        err_str(out, EINVAL);
+        return;
+    }
+    ptr = read_hex32_raw(ptr + 1, end, &n_bytes);
+    if (ptr >= end || *ptr != ':') {
+        err_str(out, EINVAL);
+        return;
+    }
+    ptr++;
+
+    // gdb sends a zero-length X packet to find out if the stub supports X
+    if (!n_bytes) {
+        string_set(out, "OK");
+        return;
+    }
+
+    if (n_bytes > (size_t)(end - ptr)) {
+        err_str(out, EINVAL);
+        return;
+    }
+
+    uint8_t *buf = (uint8_t*)malloc(n_bytes);
+    if (!buf) {
+        error_set_length(n_bytes);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    uint32_t n_decoded = 0;
+    while (ptr < end && n_decoded < n_bytes) {
+        char ch = *ptr++;
+        if (ch == 0x7d) {
+            if (ptr >= end)
+                break;
+            ch = *ptr++ ^ 0x20;
+        }
+        buf[n_decoded++] = (uint8_t)ch;
+    }
+
+    if (n_decoded != n_bytes || gdb_stub_write_mem(buf, addr, n_bytes) < 0)
+        err_str(out, EINVAL);
+    else
+        string_set(out, "OK");
+
+    free(buf);
+}
+
 static void handle_s_packet(struct string *out, struct string const *dat) {
     debug_request_single_step();
 }
@@ -1102,16 +1302,25 @@ cleanup:
     string_cleanup(&dat_local);
 }
 
-static void handle_packet(struct string *pkt) {
+/*
+ * dat points to the contents of the packet between the '$' and the '#'; it
+ * must be NUL-terminated since everything other than the X packet gets
+ * treated as text.
+ */
+static void handle_packet(char const *dat_raw, size_t dat_len) {
     struct string dat;
     struct string response;
     struct string resp_pkt;
 
-    string_init(&dat);
     string_init(&response);
     string_init(&resp_pkt);
 
-    extract_packet(&dat, pkt);
+    if (dat_len && dat_raw[0] == 'X') {
+        string_init(&dat);
+        handle_X_packet(&response, dat_raw, dat_len);
+    } else {
+        string_init_txt(&dat, dat_raw);
+    }
 
     if (string_length(&dat)) {
         char first_ch = string_get(&dat)[0];
@@ -1164,86 +1373,6 @@ static void transmit_pkt(struct string const *pkt) {
     transmit(pkt);
 }
 
-static bool next_packet(struct string *pkt) {
-    struct string pktbuf_tmp;
-    struct string tmp_str;
-    char ch;
-    bool found_pkt = false;
-
-    string_init(&pktbuf_tmp);
-    string_copy(&pktbuf_tmp, &stub.input_packet);
-
-    // wait around for the start character, ignore all other characters
-    do {
-        if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-
-        ch = string_get(&pktbuf_tmp)[0];
-
-        string_init(&tmp_str);
-        string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-        string_cleanup(&pktbuf_tmp);
-        memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-
-        if (ch == EOF)
-            goto cleanup;
-    } while(ch != '$');
-    string_append_char(pkt, ch);
-
-    // now, read until a # or end of buffer is found
-    do {
-        if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-
-        ch = string_get(&pktbuf_tmp)[0];
-
-        string_init(&tmp_str);
-        string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-        string_cleanup(&pktbuf_tmp);
-        memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-
-        if (ch == EOF)
-            goto cleanup;
-
-        string_append_char(pkt, ch);
-    } while(ch != '#');
-        
-    // read the one-byte (two char) checksum
-    if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-    ch = string_get(&pktbuf_tmp)[0];
-    if (ch == EOF)
-            goto cleanup;
-    string_init(&tmp_str);
-    string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-    string_cleanup(&pktbuf_tmp);
-    memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-    string_append_char(pkt, ch);
-
-    if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-    ch = string_get(&pktbuf_tmp)[0];
-    if (ch == EOF)
-            goto cleanup;
-    string_init(&tmp_str);
-    string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-    string_cleanup(&pktbuf_tmp);
-    memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-    string_append_char(pkt, ch);
-
-    string_set(&stub.input_packet, string_get(&pktbuf_tmp));
-
-#ifdef GDBSTUB_VERBOSE
-    washdc_log_info("<<<< %s\n", string_get(pkt));
-#endif
-
-    found_pkt = true;
-
-cleanup:
-    string_cleanup(&pktbuf_tmp);
-    return found_pkt;
-}
-
 /*
  * this function gets called by libevent when a remote gdb stub connects
  */
@@ -1309,88 +1438,114 @@ static void handle_events(struct bufferevent *bev, short events, void *arg) {
     washdc_kill();
 }
 
-static void handle_read(struct bufferevent *bev, void *arg) {
-    struct evbuffer *read_buffer;
-
-    if (!(read_buffer = evbuffer_new()))
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-    gdb_stub_lock();
+static void input_append(char ch) {
+    if (stub.input_len >= stub.input_cap) {
+        size_t new_cap = stub.input_cap ? 2 * stub.input_cap : 256;
+        char *new_buf = (char*)realloc(stub.input_buf, new_cap);
+        if (!new_buf) {
+            error_set_length(new_cap);
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        }
+        stub.input_buf = new_buf;
+        stub.input_cap = new_cap;
+    }
+    stub.input_buf[stub.input_len++] = ch;
+}
 
-    bufferevent_read_buffer(bev, read_buffer);
-    size_t buflen = evbuffer_get_length(read_buffer);
+static void input_reset(void) {
+    stub.input_len = 0;
+    stub.input_pound_idx = 0;
+}
 
-    for (unsigned i = 0; i < buflen; i++) {
-        uint8_t tmp;
-        if (evbuffer_remove(read_buffer, &tmp, sizeof(tmp)) < 0)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
+static void handle_read(struct bufferevent *bev, void *arg) {
+    char chunk[4096];
+    size_t n_read;
 
-        char c = tmp;
+    gdb_stub_lock();
 
-        if (string_length(&stub.input_packet)) {
+    while ((n_read = bufferevent_read(bev, chunk, sizeof(chunk)))) {
+        for (size_t i = 0; i < n_read; i++) {
+            char c = chunk[i];
 
-            if (string_length(&stub.unack_packet)) {
-                washdc_log_warn("WARNING: new packet incoming; no "
-                                "acknowledgement was ever received for "
-                                "\"%s\"\n", string_get(&stub.unack_packet));
-                string_set(&stub.unack_packet, "");
-            }
+            if (stub.input_len) {
+                if (string_length(&stub.unack_packet)) {
+                    washdc_log_warn("WARNING: new packet incoming; no "
+                                    "acknowledgement was ever received for "
+                                    "\"%s\"\n", string_get(&stub.unack_packet));
+                    string_set(&stub.unack_packet, "");
+                }
 
-            string_append_char(&stub.input_packet, c);
+                input_append(c);
+
+                if (!stub.input_pound_idx) {
+                    /*
+                     * binary data in X packets escapes '#', so the first one
+                     * is always the end of the packet.
+                     */
+                    if (c == '#')
+                        stub.input_pound_idx = stub.input_len - 1;
+                    else if (stub.input_len > GDB_MAX_INPUT_PACKET) {
+                        washdc_log_warn("WARNING: dropping oversized incoming "
+                                        "packet\n");
+                        input_reset();
+                    }
+                    continue;
+                }
 
-            struct string pkt;
-            string_init(&pkt);
-            bool pkt_valid = next_packet(&pkt);
-            if (string_length(&pkt) && pkt_valid) {
-                string_set(&stub.input_packet, "");
+                // wait for the one-byte (two char) checksum
+                if (stub.input_len < stub.input_pound_idx + 3)
+                    continue;
 
                 // TODO: verify the checksum
 
+                stub.input_buf[stub.input_pound_idx] = '\0';
+
 #ifdef GDBSTUB_VERBOSE
+                washdc_log_info("<<<< $%s\n", stub.input_buf + 1);
                 washdc_log_info(">>>> +\n");
 #endif
                 struct string plus_symbol;
                 string_init_txt(&plus_symbol, "+");
                 transmit(&plus_symbol);
                 string_cleanup(&plus_symbol);
-                handle_packet(&pkt);
-            }
+                handle_packet(stub.input_buf + 1, stub.input_pound_idx - 1);
 
-            string_cleanup(&pkt);
-        } else {
-            if (c == '+') {
+                input_reset();
+            } else {
+                if (c == '+') {
 #ifdef GDBSTUB_VERBOSE
-                washdc_log_info("<<<< +\n");
+                    washdc_log_info("<<<< +\n");
 #endif
-                if (!string_length(&stub.unack_packet))
-                    washdc_log_warn("WARNING: received acknowledgement for "
-                                    "unsent packet\n");
-                string_set(&stub.unack_packet, "");
-            } else if (c == '-') {
+                    if (!string_length(&stub.unack_packet))
+                        washdc_log_warn("WARNING: received acknowledgement "
+                                        "for unsent packet\n");
+                    string_set(&stub.unack_packet, "");
+                } else if (c == '-') {
 #ifdef GDBSTUB_VERBOSE
-                washdc_log_info("<<<< -\n");
+                    washdc_log_info("<<<< -\n");
 #endif
-                if (!string_length(&stub.unack_packet)) {
-                    washdc_log_warn("WARNING: received negative "
-                                    "acknowledgement for unsent packet\n");
-                } else {
+                    if (!string_length(&stub.unack_packet)) {
+                        washdc_log_warn("WARNING: received negative "
+                                        "acknowledgement for unsent packet\n");
+                    } else {
 #ifdef GDBSTUB_VERBOSE
-                    washdc_log_info(">>>> %s\n",
-                                    string_get(&stub.unack_packet));
+                        washdc_log_info(">>>> %s\n",
+                                        string_get(&stub.unack_packet));
 #endif
-                    transmit(&stub.unack_packet);
+                        transmit(&stub.unack_packet);
+                    }
+                } else if (c == '$') {
+                    // new packet
+                    input_append(c);
+                } else if (c == 3) {
+                    // user pressed ctrl+c (^C) on the gdb frontend
+                    washdc_log_info("GDBSTUB: user requested breakpoint "
+                                    "(ctrl-C)\n");
+                    debug_request_break();
+                } else {
+                    washdc_log_warn("WARNING: ignoring unexpected character "
+                                    "%c\n", c);
                 }
-            } else if (c == '$') {
-                // new packet
-                string_set(&stub.input_packet, "$");
-            } else if (c == 3) {
-                // user pressed ctrl+c (^C) on the gdb frontend
-                washdc_log_info("GDBSTUB: user requested breakpoint "
-                                "(ctrl-C)\n");
-                debug_request_break();
-            } else {
-                washdc_log_warn("WARNING: ignoring unexpected character %c\n",
-                                c);
             }
         }
     }
@@ -1529,6 +1684,7 @@ enum deferred_cmd_type {
     DEFERRED_CMD_SET_REG,
     DEFERRED_CMD_READ_MEM,
     DEFERRED_CMD_WRITE_MEM,
+    DEFERRED_CMD_GET_MEM_RANGES,
 
     DEFERRED_CMD_ADD_BREAK,
     DEFERRED_CMD_REMOVE_BREAK,
@@ -1546,6 +1702,7 @@ char const *deferred_cmd_names[N_DEFERRED_CMD] = {
     "DEFERRED_CMD_SET_REG",
     "DEFERRED_CMD_READ_MEM",
     "DEFERRED_CMD_WRITE_MEM",
+    "DEFERRED_CMD_GET_MEM_RANGES",
 
     "DEFERRED_CMD_ADD_BREAK",
     "DEFERRED_CMD_REMOVE_BREAK",
@@ -1580,6 +1737,12 @@ struct meta_deferred_cmd_write_mem {
     addr32_t addr;
 };
 
+struct meta_deferred_cmd_get_mem_ranges {
+    struct debug_mem_range *ranges_out;
+    unsigned max_ranges;
+    unsigned n_ranges;
+};
+
 struct meta_deferred_cmd_add_break {
     addr32_t addr;
 };
@@ -1614,6 +1777,7 @@ union deferred_cmd_meta {
     struct meta_deferred_cmd_set_reg set_reg;
     struct meta_deferred_cmd_read_mem read_mem;
     struct meta_deferred_cmd_write_mem write_mem;
+    struct meta_deferred_cmd_get_mem_ranges get_mem_ranges;
     struct meta_deferred_cmd_add_break add_break;
     struct meta_deferred_cmd_remove_break remove_break;
     struct meta_deferred_cmd_add_write_watch add_write_watch;
@@ -1669,6 +1833,7 @@ static void deferred_cmd_exec(struct deferred_cmd *cmd) {
     deferred_cmd_lock();
 
     deferred_cmd_push_nolock(cmd);
+    debug_signal();
 
     while (cmd->status == DEFERRED_CMD_IN_PROGRESS)
         deferred_cmd_wait();
@@ -1715,6 +1880,20 @@ int gdb_stub_write_mem(void const *input, addr32_t addr, unsigned len) {
     return -1;
 }
 
+static unsigned gdb_stub_get_mem_ranges(struct debug_mem_range *ranges,
+                                        unsigned max_ranges) {
+    struct deferred_cmd cmd;
+
+    deferred_cmd_init(&cmd);
+    cmd.cmd_type = DEFERRED_CMD_GET_MEM_RANGES;
+    cmd.meta.get_mem_ranges.ranges_out = ranges;
+    cmd.meta.get_mem_ranges.max_ranges = max_ranges;
+
+    deferred_cmd_exec(&cmd);
+
+    return cmd.meta.get_mem_ranges.n_ranges;
+}
+
 static int gdb_stub_add_break(addr32_t addr) {
     struct deferred_cmd cmd;
 
@@ -1842,6 +2021,13 @@ static void deferred_cmd_do_write_mem(struct deferred_cmd *cmd) {
         cmd->status = DEFERRED_CMD_SUCCESS;
 }
 
+static void deferred_cmd_do_get_mem_ranges(struct deferred_cmd *cmd) {
+    struct meta_deferred_cmd_get_mem_ranges *meta = &cmd->meta.get_mem_ranges;
+    meta->n_ranges = debug_get_mem_ranges(DEBUG_CONTEXT_SH4, meta->ranges_out,
+                                          meta->max_ranges);
+    cmd->status = DEFERRED_CMD_SUCCESS;
+}
+
 static void deferred_cmd_do_add_break(struct deferred_cmd *cmd) {
     addr32_t addr = cmd->meta.add_break.addr;
     if (debug_add_break(DEBUG_CONTEXT_SH4, addr) != 0)
@@ -1934,6 +2120,9 @@ static void deferred_cmd_run(void) {
         case DEFERRED_CMD_WRITE_MEM:
             deferred_cmd_do_write_mem(cmd);
             break;
+        case DEFERRED_CMD_GET_MEM_RANGES:
+            deferred_cmd_do_get_mem_ranges(cmd);
+            break;
         case DEFERRED_CMD_ADD_BREAK:
             deferred_cmd_do_add_break(cmd);
             break;
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <atomic>
 #include <cstring>
+#include <string>
 
 #include <event2/event.h>
 #include <event2/bufferevent.h>
@@ -36,6 +37,9 @@
 #include "washdc/log.h"
 #include "washdc/washdc.h"
 
+#include "upload_server.hpp"
+#include "ctl_server.hpp"
+
 #ifdef ENABLE_DEBUGGER
 #include "gdb_stub.hpp"
 #include "washdbg_tcp.hpp"
@@ -68,8 +72,11 @@ static void work_callback(evutil_socket_t fd, short ev, void *arg);
 
 static std::atomic_bool alive;
 
-void init() {
+static std::string io_cpus;
+
+void init(char const *cpus) {
     alive = true;
+    io_cpus = cpus ? cpus : "";
 
     washdc_mutex_lock(&create_mutex);
 
@@ -90,6 +97,8 @@ void kick() {
 }
 
 static void io_main(void *arg) {
+    washdc_thread_pin_self("io", io_cpus.c_str());
+
     washdc_mutex_lock(&create_mutex);
 
 #ifdef _WIN32
@@ -124,6 +133,9 @@ static void io_main(void *arg) {
     serial_server_init();
 #endif
 
+    upload_server_init();
+    ctl_server_init();
+
 #ifdef ENABLE_DEBUGGER
     gdb_init();
     washdbg_tcp_init();
@@ -158,6 +170,9 @@ static void io_main(void *arg) {
     serial_server_cleanup();
 #endif
 
+    ctl_server_cleanup();
+    upload_server_cleanup();
+
     event_base_free(event_base);
 }
 
@@ -31,7 +31,11 @@
 
 namespace io {
 
-void init();
+/*
+ * cpus is an optional list of CPUs ("0,2-3") to pin the io thread to, so
+ * that it can be kept off of the emulation thread's CPUs.
+ */
+void init(char const *cpus = nullptr);
 void cleanup();
 void kick();
 
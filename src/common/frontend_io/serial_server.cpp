@@ -56,9 +56,16 @@ static struct serial_server {
 
     std::atomic_bool ready_to_write;
 
-    std::atomic_flag no_more_work;
+    // set when the SCIF has queued up data for us to send
+    std::atomic_bool tx_pending;
+
+    // set when the SCIF has room for data we couldn't give it before
+    std::atomic_bool rx_pending;
 } srv;
 
+// data gets moved between the SCIF and libevent in chunks of this many bytes
+#define SERIAL_CHUNK_LEN 4096
+
 /*
  * The SCIF calls this to let us know that it has data ready to transmit.
  * If the SerialServer is idling, it will immediately call sh4_scif_cts, and the
@@ -69,6 +76,12 @@ static struct serial_server {
  */
 static void serial_server_notify_tx_ready(void);
 
+/*
+ * The SCIF calls this after it takes data out of its rxq when the last
+ * call to washdc_serial_server_rx_n couldn't fit everything.
+ */
+static void serial_server_notify_rx_space(void);
+
 // this function can be safely called from outside of the context of the io thread
 static void serial_server_attach(void);
 
@@ -91,13 +104,16 @@ static void wait_for_connection(void);
 static void signal_connection(void);
 
 static void drain_txq(void);
+static void fill_rxq(void);
 
 void serial_server_init(void) {
 
     sersrv_intf.attach = serial_server_attach;
     sersrv_intf.notify_tx_ready = serial_server_notify_tx_ready;
+    sersrv_intf.notify_rx_space = serial_server_notify_rx_space;
 
-    atomic_flag_test_and_set(&srv.no_more_work);
+    atomic_store(&srv.tx_pending, false);
+    atomic_store(&srv.rx_pending, false);
 }
 
 void serial_server_cleanup(void) {
@@ -140,23 +156,28 @@ static void serial_server_attach(void) {
 }
 
 static void handle_read(struct bufferevent *bev, void *arg) {
-    struct evbuffer *read_buffer;
-    if (!(read_buffer = evbuffer_new()))
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    fill_rxq();
+}
 
-    // now send the data to the SCIF one char at a time
-    bufferevent_read_buffer(bev, read_buffer);
-    size_t buflen = evbuffer_get_length(read_buffer);
-    for (unsigned idx = 0; idx < buflen; idx++) {
-        uint8_t cur_byte;
-        if (evbuffer_remove(read_buffer, &cur_byte, sizeof(cur_byte)) < 0)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
+/*
+ * move as much data as the SCIF will take out of the bufferevent's input
+ * buffer.  Whatever doesn't fit stays in the bufferevent until the SCIF calls
+ * serial_server_notify_rx_space.
+ */
+static void fill_rxq(void) {
+    char chunk[SERIAL_CHUNK_LEN];
 
-        // TODO: it is possible for data to get dropped here.
-        washdc_serial_server_rx((char)cur_byte);
-    }
+    if (!srv.bev)
+        return;
 
-    evbuffer_free(read_buffer);
+    struct evbuffer *input = bufferevent_get_input(srv.bev);
+    ev_ssize_t n_avail;
+    while ((n_avail = evbuffer_copyout(input, chunk, sizeof(chunk))) > 0) {
+        unsigned n_rx = washdc_serial_server_rx_n(chunk, (unsigned)n_avail);
+        evbuffer_drain(input, n_rx);
+        if (n_rx < (unsigned)n_avail)
+            break;
+    }
 }
 
 /*
@@ -176,8 +197,14 @@ static void handle_write(struct bufferevent *bev, void *arg) {
 }
 
 static void serial_server_notify_tx_ready(void) {
-    atomic_flag_clear(&srv.no_more_work);
-    io::kick();
+    // only kick the io thread if it doesn't already have a kick on the way
+    if (!atomic_exchange(&srv.tx_pending, true))
+        io::kick();
+}
+
+static void serial_server_notify_rx_space(void) {
+    if (!atomic_exchange(&srv.rx_pending, true))
+        io::kick();
 }
 
 static void
@@ -262,26 +289,23 @@ static void signal_connection(void) {
 }
 
 void serial_server_run(void) {
-    if (!atomic_flag_test_and_set(&srv.no_more_work)) {
+    if (atomic_exchange(&srv.tx_pending, false))
         drain_txq();
-    }
-}
-
-// returns true if tx was successful, false otherwise
-static bool do_tx_char(void) {
-    char ch;
-    if (washdc_serial_server_tx(&ch) == 0) {
-        evbuffer_add(srv.outbound, &ch, sizeof(ch));
-        return true;
-    }
-    return false;
+    if (atomic_exchange(&srv.rx_pending, false))
+        fill_rxq();
 }
 
 static void drain_txq(void) {
-    // drain the txq
+    char chunk[SERIAL_CHUNK_LEN];
+    unsigned n_tx;
     bool did_tx = false;
-    while (do_tx_char())
+
+    while ((n_tx = washdc_serial_server_tx_n(chunk, sizeof(chunk)))) {
+        if (evbuffer_add(srv.outbound, chunk, n_tx) < 0)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
         did_tx = true;
+    }
+
     if (atomic_load(&srv.ready_to_write) && did_tx) {
         bufferevent_write_buffer(srv.bev, srv.outbound);
         srv.ready_to_write = false;
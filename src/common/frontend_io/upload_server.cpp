@@ -0,0 +1,195 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef USE_LIBEVENT
+#error recompile with -DUSE_LIBEVENT=On
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <event2/event.h>
+#include <event2/bufferevent.h>
+#include <event2/listener.h>
+#include <event2/buffer.h>
+
+#include "washdc/error.h"
+#include "washdc/washdc.h"
+#include "io_thread.hpp"
+
+#include "upload_server.hpp"
+
+#define UPLOAD_HDR_LEN 16
+#define UPLOAD_MAGIC 0x50554457 // "WDUP"
+
+// nothing bigger than system memory could possibly fit
+#define UPLOAD_MAX_LEN (16 * 1024 * 1024)
+
+struct upload_conn {
+    struct bufferevent *bev;
+
+    bool have_hdr;
+    uint32_t load_addr, entry, len;
+
+    // set once the reply has been queued; the connection closes after it's sent
+    bool done;
+};
+
+static bool enabled;
+static struct evconnlistener *listener;
+
+static void
+listener_cb(struct evconnlistener *listener,
+            evutil_socket_t fd, struct sockaddr *saddr,
+            int socklen, void *arg);
+static void handle_read(struct bufferevent *bev, void *arg);
+static void handle_write(struct bufferevent *bev, void *arg);
+static void handle_events(struct bufferevent *bev, short events, void *arg);
+static void conn_reply(struct upload_conn *conn, char const *msg);
+static void conn_close(struct upload_conn *conn);
+
+static uint32_t get_u32(unsigned char const *ptr) {
+    return ptr[0] | ((uint32_t)ptr[1] << 8) |
+        ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+void upload_server_enable(void) {
+    enabled = true;
+}
+
+void upload_server_init(void) {
+    if (!enabled)
+        return;
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(UPLOAD_PORT_NO);
+    unsigned evflags = LEV_OPT_THREADSAFE | LEV_OPT_REUSEABLE |
+        LEV_OPT_CLOSE_ON_FREE;
+    listener = evconnlistener_new_bind(io::event_base, listener_cb,
+                                       NULL, evflags, -1,
+                                       (struct sockaddr*)&sin, sizeof(sin));
+    if (!listener)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    std::cout << "Accepting program uploads on port " << UPLOAD_PORT_NO <<
+        std::endl;
+}
+
+void upload_server_cleanup(void) {
+    if (listener)
+        evconnlistener_free(listener);
+    listener = NULL;
+}
+
+static void
+listener_cb(struct evconnlistener *listener,
+            evutil_socket_t fd, struct sockaddr *saddr,
+            int socklen, void *arg) {
+    struct upload_conn *conn =
+        (struct upload_conn*)calloc(1, sizeof(struct upload_conn));
+    if (!conn)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    conn->bev = bufferevent_socket_new(io::event_base, fd,
+                                       BEV_OPT_CLOSE_ON_FREE);
+    if (!conn->bev)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    bufferevent_setcb(conn->bev, handle_read, handle_write,
+                      handle_events, conn);
+    bufferevent_enable(conn->bev, EV_READ | EV_WRITE);
+}
+
+static void handle_read(struct bufferevent *bev, void *arg) {
+    struct upload_conn *conn = (struct upload_conn*)arg;
+    struct evbuffer *input = bufferevent_get_input(bev);
+
+    if (conn->done) {
+        evbuffer_drain(input, evbuffer_get_length(input));
+        return;
+    }
+
+    if (!conn->have_hdr) {
+        unsigned char hdr[UPLOAD_HDR_LEN];
+        if (evbuffer_get_length(input) < UPLOAD_HDR_LEN)
+            return;
+        evbuffer_remove(input, hdr, UPLOAD_HDR_LEN);
+
+        if (get_u32(hdr) != UPLOAD_MAGIC) {
+            conn_reply(conn, "ERR bad magic\n");
+            return;
+        }
+
+        conn->load_addr = get_u32(hdr + 4);
+        conn->entry = get_u32(hdr + 8);
+        conn->len = get_u32(hdr + 12);
+        conn->have_hdr = true;
+
+        if (conn->len > UPLOAD_MAX_LEN) {
+            conn_reply(conn, "ERR too big\n");
+            return;
+        }
+    }
+
+    if (evbuffer_get_length(input) < conn->len)
+        return;
+
+    // the whole program has arrived, hand it off to the emulator
+    unsigned char const *dat = evbuffer_pullup(input, conn->len);
+    if (conn->len && !dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    if (washdc_upload(dat, conn->len, conn->load_addr, conn->entry) == 0) {
+        std::cout << "received " << conn->len << "-byte program upload" <<
+            std::endl;
+        conn_reply(conn, "OK\n");
+    } else {
+        conn_reply(conn, "ERR rejected\n");
+    }
+    evbuffer_drain(input, conn->len);
+}
+
+static void handle_write(struct bufferevent *bev, void *arg) {
+    struct upload_conn *conn = (struct upload_conn*)arg;
+    if (conn->done)
+        conn_close(conn);
+}
+
+static void handle_events(struct bufferevent *bev, short events, void *arg) {
+    struct upload_conn *conn = (struct upload_conn*)arg;
+    if (!(events & BEV_EVENT_EOF))
+        std::cerr << "upload connection closed with error" << std::endl;
+    conn_close(conn);
+}
+
+static void conn_reply(struct upload_conn *conn, char const *msg) {
+    conn->done = true;
+    bufferevent_write(conn->bev, msg, strlen(msg));
+}
+
+static void conn_close(struct upload_conn *conn) {
+    bufferevent_free(conn->bev);
+    free(conn);
+}
@@ -0,0 +1,57 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef UPLOAD_SERVER_HPP_
+#define UPLOAD_SERVER_HPP_
+
+#ifndef USE_LIBEVENT
+#error this file should not be built with USE_LIBEVENT disabled!
+#endif
+
+// one year before the Dreamcast came out, since it's for getting ready to run
+#define UPLOAD_PORT_NO 1997
+
+/*
+ * Fast program upload over TCP.
+ *
+ * A client connects, sends a 16-byte header followed by the program and gets
+ * back a single line saying whether or not it worked, after which the
+ * connection is closed.  The header is four little-endian 32-bit words:
+ *
+ *     "WDUP" magic
+ *     load address (ignored for ELF executables)
+ *     entry point (ignored for ELF executables)
+ *     length of the program in bytes
+ *
+ * The program gets loaded at the end of the frame it arrives in.
+ */
+
+/*
+ * call this before io::init to make the io thread listen for uploads.  If
+ * it's never called then the upload port is never opened.
+ */
+void upload_server_enable(void);
+
+// these get called from the io thread
+void upload_server_init(void);
+void upload_server_cleanup(void);
+
+#endif
@@ -131,6 +131,11 @@ enum washdbg_state {
     WASHDBG_STAT_CMD_AT_MODE,
     WASHDBG_STATE_CMD_AT_MODE,
     WASHDBG_STATE_CMD_DUMP,
+    WASHDBG_STATE_CMD_JITPROF,
+    WASHDBG_STATE_CMD_GUESTPROF,
+    WASHDBG_STATE_CMD_REWIND,
+    WASHDBG_STATE_CMD_PERF,
+    WASHDBG_STATE_CMD_SYSCALLS,
 
     // permanently stop accepting commands because we're about to disconnect.
     WASHDBG_STATE_CMD_EXIT
@@ -243,15 +248,20 @@ void washdbg_do_help(int argc, char **argv) {
         "dump         - dump memory to disk\n"
         "echo         - echo back text\n"
         "exit         - exit the debugger and close WashingtonDC\n"
+        "guestprof    - start, stop, reset or dump the guest sampling profiler\n"
         "help         - display this message\n"
+        "jitprof      - write the jit's per-block profile to disk as JSON\n"
 #ifdef ENABLE_DBG_COND
         "memwatch     - watch a specific memory address for a specific value\n"
 #endif
+        "perf [reset] - print or reset the hot-path performance counters\n"
         "print        - print a value\n"
+        "rewind [n]   - go back n rewind snapshots when execution continues\n"
 #ifdef ENABLE_DBG_COND
         "regwatch     - watch for a register to be set to a given value\n"
 #endif
         "step         - single-step\n"
+        "syscalls [n] - decode the last n system calls (DEEP_SYSCALL_TRACE)\n"
 #ifdef ENABLE_MMU
         "trans_itlb   - translate pointer using ITLB or UTLB\n"
         "trans_utlb   - translate pointer using UTLB only\n"
@@ -1115,6 +1125,191 @@ static void washdbg_dump(int argc, char **argv) {
     cur_state = WASHDBG_STATE_CMD_DUMP;
 }
 
+#define WASHDBG_JITPROF_STR_LEN 128
+
+static struct jitprof_state {
+    char msg[WASHDBG_JITPROF_STR_LEN];
+    struct washdbg_txt_state txt;
+} jitprof_state;
+
+static bool washdbg_is_jitprof_cmd(char const *str) {
+    return strcmp(str, "jitprof") == 0;
+}
+
+static void washdbg_jitprof(int argc, char **argv) {
+    if (argc != 2) {
+        washdbg_print_error("usage: jitprof path\n");
+        return;
+    }
+
+    if (washdc_dump_jit_profile(argv[1]) != 0) {
+        washdbg_print_error("unable to write jit profile.  This requires the "
+                            "jit to be enabled and WashingtonDC to be built "
+                            "with -DJIT_PROFILE=On.\n");
+        return;
+    }
+
+    snprintf(jitprof_state.msg, sizeof(jitprof_state.msg),
+             "jit profile written\n");
+    jitprof_state.txt.txt = jitprof_state.msg;
+    jitprof_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_JITPROF;
+}
+
+#define WASHDBG_GUESTPROF_STR_LEN 128
+
+static struct guestprof_state {
+    char msg[WASHDBG_GUESTPROF_STR_LEN];
+    struct washdbg_txt_state txt;
+} guestprof_state;
+
+static bool washdbg_is_guestprof_cmd(char const *str) {
+    return strcmp(str, "guestprof") == 0;
+}
+
+static void washdbg_guestprof(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "start") == 0) {
+        washdc_guest_prof_start();
+    } else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        washdc_guest_prof_stop();
+    } else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        washdc_guest_prof_reset();
+    } else if (argc == 3 && strcmp(argv[1], "dump") == 0) {
+        washdc_guest_prof_dump(argv[2]);
+    } else {
+        washdbg_print_error("usage: guestprof start|stop|reset|dump path\n");
+        return;
+    }
+
+    snprintf(guestprof_state.msg, sizeof(guestprof_state.msg),
+             "guestprof %s will happen at the end of the current frame\n",
+             argv[1]);
+    guestprof_state.txt.txt = guestprof_state.msg;
+    guestprof_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_GUESTPROF;
+}
+
+#define WASHDBG_REWIND_STR_LEN 128
+
+static struct rewind_state {
+    char msg[WASHDBG_REWIND_STR_LEN];
+    struct washdbg_txt_state txt;
+} rewind_state;
+
+static bool washdbg_is_rewind_cmd(char const *str) {
+    return strcmp(str, "rewind") == 0;
+}
+
+static void washdbg_rewind(int argc, char **argv) {
+    unsigned n_steps = 1;
+    if (argc == 2 && is_dec_str(argv[1])) {
+        n_steps = parse_dec_str(argv[1]);
+    } else if (argc != 1) {
+        washdbg_print_error("usage: rewind [n]\n");
+        return;
+    }
+
+    washdc_rewind(n_steps);
+
+    snprintf(rewind_state.msg, sizeof(rewind_state.msg),
+             "going back %u snapshots at the end of the current frame\n",
+             n_steps);
+    rewind_state.txt.txt = rewind_state.msg;
+    rewind_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_REWIND;
+}
+
+#define WASHDBG_PERF_MAX_PROBES 32
+#define WASHDBG_PERF_STR_LEN 4096
+
+static struct perf_state {
+    char msg[WASHDBG_PERF_STR_LEN];
+    struct washdbg_txt_state txt;
+} perf_state;
+
+static bool washdbg_is_perf_cmd(char const *str) {
+    return strcmp(str, "perf") == 0;
+}
+
+static void washdbg_perf(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        washdc_perf_reset();
+        snprintf(perf_state.msg, sizeof(perf_state.msg),
+                 "performance counters reset\n");
+    } else if (argc == 1) {
+        struct washdc_perf_probe probes[WASHDBG_PERF_MAX_PROBES];
+        unsigned n_probes = washdc_perf_get(probes, WASHDBG_PERF_MAX_PROBES);
+        if (n_probes > WASHDBG_PERF_MAX_PROBES)
+            n_probes = WASHDBG_PERF_MAX_PROBES;
+
+        if (!n_probes) {
+            snprintf(perf_state.msg, sizeof(perf_state.msg),
+                     "WashingtonDC was built without ENABLE_PERF_COUNTERS\n");
+        } else {
+            size_t len = 0;
+            unsigned idx;
+            for (idx = 0; idx < n_probes && len < sizeof(perf_state.msg);
+                 idx++) {
+                struct washdc_perf_probe const *probe = probes + idx;
+                size_t rem = sizeof(perf_state.msg) - len;
+                int n_chars;
+                if (probe->is_timer) {
+                    n_chars = snprintf(perf_state.msg + len, rem,
+                                       "%-24s %14llu %12.6f sec\n",
+                                       probe->name,
+                                       (unsigned long long)probe->count,
+                                       probe->seconds);
+                } else {
+                    n_chars = snprintf(perf_state.msg + len, rem,
+                                       "%-24s %14llu\n", probe->name,
+                                       (unsigned long long)probe->count);
+                }
+                if (n_chars < 0)
+                    break;
+                len += n_chars;
+            }
+        }
+    } else {
+        washdbg_print_error("usage: perf [reset]\n");
+        return;
+    }
+
+    perf_state.txt.txt = perf_state.msg;
+    perf_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_PERF;
+}
+
+#define WASHDBG_SYSCALLS_STR_LEN (WASHDC_SYSCALL_TRACE_MAX * 256)
+
+static struct syscalls_state {
+    char msg[WASHDBG_SYSCALLS_STR_LEN];
+    struct washdbg_txt_state txt;
+} syscalls_state;
+
+static bool washdbg_is_syscalls_cmd(char const *str) {
+    return strcmp(str, "syscalls") == 0;
+}
+
+static void washdbg_syscalls(int argc, char **argv) {
+    unsigned n_recs = 16;
+    if (argc == 2 && is_dec_str(argv[1])) {
+        n_recs = parse_dec_str(argv[1]);
+    } else if (argc != 1) {
+        washdbg_print_error("usage: syscalls [n]\n");
+        return;
+    }
+
+    if (!washdc_syscall_trace_dump(syscalls_state.msg,
+                                   sizeof(syscalls_state.msg), n_recs)) {
+        snprintf(syscalls_state.msg, sizeof(syscalls_state.msg),
+                 "no system calls traced (this needs DEEP_SYSCALL_TRACE)\n");
+    }
+
+    syscalls_state.txt.txt = syscalls_state.msg;
+    syscalls_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_SYSCALLS;
+}
+
 void washdbg_core_run_once(void) {
     switch (cur_state) {
     case WASHDBG_STATE_BANNER:
@@ -1191,6 +1386,26 @@ void washdbg_core_run_once(void) {
         if (washdbg_print_buffer(&dump_state.txt) == 0)
             washdbg_print_prompt();
         break;
+    case WASHDBG_STATE_CMD_JITPROF:
+        if (washdbg_print_buffer(&jitprof_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
+    case WASHDBG_STATE_CMD_GUESTPROF:
+        if (washdbg_print_buffer(&guestprof_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
+    case WASHDBG_STATE_CMD_REWIND:
+        if (washdbg_print_buffer(&rewind_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
+    case WASHDBG_STATE_CMD_PERF:
+        if (washdbg_print_buffer(&perf_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
+    case WASHDBG_STATE_CMD_SYSCALLS:
+        if (washdbg_print_buffer(&syscalls_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
     default:
         break;
     }
@@ -1309,6 +1524,16 @@ static void washdbg_process_input(void) {
                 washdbg_at_mode(argc, argv);
             } else if (washdbg_is_dump_cmd(cmd)) {
                 washdbg_dump(argc, argv);
+            } else if (washdbg_is_jitprof_cmd(cmd)) {
+                washdbg_jitprof(argc, argv);
+            } else if (washdbg_is_guestprof_cmd(cmd)) {
+                washdbg_guestprof(argc, argv);
+            } else if (washdbg_is_rewind_cmd(cmd)) {
+                washdbg_rewind(argc, argv);
+            } else if (washdbg_is_perf_cmd(cmd)) {
+                washdbg_perf(argc, argv);
+            } else if (washdbg_is_syscalls_cmd(cmd)) {
+                washdbg_syscalls(argc, argv);
             } else {
                 washdbg_bad_input(cmd);
             }
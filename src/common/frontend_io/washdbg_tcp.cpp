@@ -210,6 +210,9 @@ static void drain_tx(void) {
     }
 
     bufferevent_write_buffer(bev, outbound_buf);
+
+    // washdbg_core may be waiting for space in the tx_ring
+    debug_signal();
 }
 
 static void washdbg_run_once(void *argptr) {
@@ -333,6 +336,7 @@ static void dump_to_rx_ring(char const *dat, unsigned n_chars) {
             debug_request_break();
         else
             rx_ring.produce(dat[idx]);
+    debug_signal();
 }
 
 // libevent callback for when the socket has data for us to read
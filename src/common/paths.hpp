@@ -145,10 +145,18 @@ WASHDC_UNUSED static path_string screenshot_dir(void) {
     return path_append(data_dir(), "screenshots");
 }
 
+WASHDC_UNUSED static path_string capture_dir(void) {
+    return path_append(data_dir(), "captures");
+}
+
 WASHDC_UNUSED static path_string vmu_dir(void) {
     return path_append(data_dir(), "vmu");
 }
 
+WASHDC_UNUSED static path_string shader_cache_dir(void) {
+    return path_append(data_dir(), "shader_cache");
+}
+
 WASHDC_UNUSED static void create_data_dir(void) {
     create_directory(data_dir());
 }
@@ -163,6 +171,16 @@ WASHDC_UNUSED static void create_screenshot_dir(void) {
     create_directory(screenshot_dir());
 }
 
+WASHDC_UNUSED static void create_capture_dir(void) {
+    create_data_dir();
+    create_directory(capture_dir());
+}
+
+WASHDC_UNUSED static void create_shader_cache_dir(void) {
+    create_data_dir();
+    create_directory(shader_cache_dir());
+}
+
 WASHDC_UNUSED static void create_cfg_dir(void) {
     create_directory(cfg_dir());
 }
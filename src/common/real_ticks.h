@@ -33,39 +33,104 @@
 
 #include "i_hate_windows.h"
 
+// in units of the performance counter, see washdc_real_time_freq
 typedef ULONGLONG washdc_real_time;
 
-static void washdc_get_real_time(washdc_real_time *time) {
-    *time = GetTickCount64();
+static inline double washdc_real_time_freq(void) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (double)freq.QuadPart;
 }
 
-static void
+static inline void washdc_get_real_time(washdc_real_time *time) {
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
+    *time = count.QuadPart;
+}
+
+static inline void
 washdc_real_time_diff(washdc_real_time *delta, washdc_real_time const *end,
                       washdc_real_time const *start) {
     *delta = *end - *start;
 }
 
-static double washdc_real_time_to_seconds(washdc_real_time const *in) {
-    return *in / 1000.0;
+static inline double washdc_real_time_to_seconds(washdc_real_time const *in) {
+    return *in / washdc_real_time_freq();
 }
 
-static void washdc_real_time_from_seconds(washdc_real_time *outp,
-                                          double seconds) {
-    *outp = seconds * 1000.0;
+static inline void washdc_real_time_from_seconds(washdc_real_time *outp,
+                                                 double seconds) {
+    *outp = seconds * washdc_real_time_freq();
+}
+
+static inline void washdc_real_time_add(washdc_real_time *outp,
+                                        washdc_real_time const *lhs,
+                                        washdc_real_time const *rhs) {
+    *outp = *lhs + *rhs;
+}
+
+// negative if lhs is before rhs, positive if after, 0 if they're equal
+static inline int washdc_real_time_cmp(washdc_real_time const *lhs,
+                                       washdc_real_time const *rhs) {
+    return *lhs < *rhs ? -1 : (*lhs > *rhs ? 1 : 0);
+}
+
+/*
+ * wait until the absolute time deadline.  The waitable timer gets within a
+ * millisecond or so (much worse than that if the high-resolution flag isn't
+ * supported), so it's only used for the bulk of the wait and the rest is
+ * spent spinning on the performance counter.
+ */
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#define WASHDC_REAL_TIME_SPIN_SECONDS 0.002
+
+static inline void
+washdc_real_time_sleep_until(washdc_real_time const *deadline) {
+    static HANDLE timer;
+    washdc_real_time now;
+    double freq = washdc_real_time_freq();
+
+    if (!timer) {
+        timer = CreateWaitableTimerExW(NULL, NULL,
+                                       CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                       TIMER_ALL_ACCESS);
+        if (!timer)
+            timer = CreateWaitableTimerW(NULL, TRUE, NULL);
+    }
+
+    washdc_get_real_time(&now);
+    if (timer && *deadline > now) {
+        double remaining = (*deadline - now) / freq -
+            WASHDC_REAL_TIME_SPIN_SECONDS;
+        if (remaining > 0.0) {
+            // negative due times are relative, in units of 100ns
+            LARGE_INTEGER due;
+            due.QuadPart = -(LONGLONG)(remaining * 10000000.0);
+            if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE))
+                WaitForSingleObject(timer, INFINITE);
+        }
+    }
+
+    do {
+        washdc_get_real_time(&now);
+    } while (now < *deadline);
 }
 
 #else
 
 #include <time.h>
 #include <math.h>
+#include <errno.h>
 
 typedef struct timespec washdc_real_time;
 
-static void washdc_get_real_time(washdc_real_time *time) {
+static inline void washdc_get_real_time(washdc_real_time *time) {
     clock_gettime(CLOCK_MONOTONIC, time);
 }
 
-static void
+static inline void
 washdc_real_time_diff(washdc_real_time *delta, washdc_real_time const *end,
                       washdc_real_time const *start) {
     /* subtract delta_time = end_time - start_time */
@@ -78,12 +143,12 @@ washdc_real_time_diff(washdc_real_time *delta, washdc_real_time const *end,
     }
 }
 
-static double washdc_real_time_to_seconds(washdc_real_time const *in) {
+static inline double washdc_real_time_to_seconds(washdc_real_time const *in) {
     return in->tv_sec + ((double)in->tv_nsec) / 1000000000.0;
 }
 
-static void washdc_real_time_from_seconds(washdc_real_time *outp,
-                                          double seconds) {
+static inline void washdc_real_time_from_seconds(washdc_real_time *outp,
+                                                 double seconds) {
     double int_part;
     double frac_part = modf(seconds, &int_part);
 
@@ -91,6 +156,68 @@ static void washdc_real_time_from_seconds(washdc_real_time *outp,
     outp->tv_nsec = frac_part * 1000000000.0;
 }
 
+static inline void washdc_real_time_add(washdc_real_time *outp,
+                                        washdc_real_time const *lhs,
+                                        washdc_real_time const *rhs) {
+    outp->tv_sec = lhs->tv_sec + rhs->tv_sec;
+    outp->tv_nsec = lhs->tv_nsec + rhs->tv_nsec;
+    if (outp->tv_nsec >= 1000000000) {
+        outp->tv_nsec -= 1000000000;
+        outp->tv_sec++;
+    }
+}
+
+// negative if lhs is before rhs, positive if after, 0 if they're equal
+static inline int washdc_real_time_cmp(washdc_real_time const *lhs,
+                                       washdc_real_time const *rhs) {
+    if (lhs->tv_sec != rhs->tv_sec)
+        return lhs->tv_sec < rhs->tv_sec ? -1 : 1;
+    if (lhs->tv_nsec != rhs->tv_nsec)
+        return lhs->tv_nsec < rhs->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+/*
+ * wait until the absolute time deadline.  The kernel usually wakes us up
+ * within a few dozen microseconds of when we asked, but it's allowed to be
+ * late, so the sleep stops short of the deadline and the rest is spent
+ * spinning on the clock.  Sleeping until an absolute time rather than for an
+ * interval means that getting preempted between reading the clock and going
+ * to sleep doesn't push the wakeup back.
+ */
+#define WASHDC_REAL_TIME_SPIN_NS 500000
+
+static inline void
+washdc_real_time_sleep_until(washdc_real_time const *deadline) {
+    washdc_real_time now, wake = *deadline;
+
+    if (wake.tv_nsec >= WASHDC_REAL_TIME_SPIN_NS) {
+        wake.tv_nsec -= WASHDC_REAL_TIME_SPIN_NS;
+    } else {
+        wake.tv_nsec += 1000000000 - WASHDC_REAL_TIME_SPIN_NS;
+        wake.tv_sec--;
+    }
+
+#ifdef __APPLE__
+    // no clock_nanosleep here
+    washdc_get_real_time(&now);
+    if (washdc_real_time_cmp(&now, &wake) < 0) {
+        washdc_real_time delta;
+        washdc_real_time_diff(&delta, &wake, &now);
+        while (nanosleep(&delta, &delta) != 0 && errno == EINTR)
+            ;
+    }
+#else
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) ==
+           EINTR)
+        ;
+#endif
+
+    do {
+        washdc_get_real_time(&now);
+    } while (washdc_real_time_cmp(&now, deadline) < 0);
+}
+
 #endif
 
 #endif
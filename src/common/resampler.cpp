@@ -0,0 +1,74 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "resampler.hpp"
+
+void resampler_init(struct resampler *rs, unsigned in_rate, unsigned out_rate) {
+    memset(rs, 0, sizeof(*rs));
+    rs->step_nominal = (double)in_rate / (double)out_rate;
+    rs->step = rs->step_nominal;
+}
+
+void resampler_set_adjust(struct resampler *rs, double adjust) {
+    adjust = std::max(-RESAMPLER_MAX_ADJUST,
+                      std::min(RESAMPLER_MAX_ADJUST, adjust));
+    rs->step = rs->step_nominal / (1.0 + adjust);
+}
+
+unsigned resampler_max_out(struct resampler const *rs, unsigned n_in) {
+    return (unsigned)std::ceil(n_in / rs->step) + 1;
+}
+
+// Catmull-Rom spline between p1 and p2
+static double
+cubic(double p0, double p1, double p2, double p3, double t) {
+    return p1 + 0.5 * t * (p2 - p0 + t * (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3 +
+                                          t * (3.0 * (p1 - p2) + p3 - p0)));
+}
+
+unsigned resampler_process(struct resampler *rs,
+                           washdc_sample_type const *in, unsigned n_in,
+                           washdc_sample_type *out) {
+    unsigned n_out = 0;
+    washdc_sample_type *hist = rs->hist;
+
+    while (n_in--) {
+        hist[0] = hist[1];
+        hist[1] = hist[2];
+        hist[2] = hist[3];
+        hist[3] = *in++;
+
+        while (rs->pos < 1.0) {
+            double val = cubic(hist[0], hist[1], hist[2], hist[3], rs->pos);
+            val = std::max((double)INT32_MIN, std::min((double)INT32_MAX, val));
+            out[n_out++] = (washdc_sample_type)val;
+            rs->pos += rs->step;
+        }
+        rs->pos -= 1.0;
+    }
+
+    return n_out;
+}
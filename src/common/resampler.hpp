@@ -0,0 +1,71 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef RESAMPLER_HPP_
+#define RESAMPLER_HPP_
+
+/*
+ * resampler.hpp
+ *
+ * cubic resampler for the sample stream coming out of the AICA.  It converts
+ * between a nominal input and output rate, and the ratio can be nudged by a
+ * small amount while it runs.  That's used for dynamic rate control: a
+ * frontend which paces emulation against something other than the audio
+ * device (like vsync) can keep its audio buffer from slowly draining or
+ * overflowing by stretching or squashing the output a tiny bit.
+ */
+
+#include "washdc/sound_intf.h"
+
+// the most the rate will ever be nudged by (0.5%)
+#define RESAMPLER_MAX_ADJUST 0.005
+
+struct resampler {
+    double step_nominal; // input samples per output sample
+    double step;         // step_nominal with the current adjustment applied
+
+    // position of the next output sample between hist[1] and hist[2]
+    double pos;
+
+    washdc_sample_type hist[4];
+};
+
+void resampler_init(struct resampler *rs, unsigned in_rate, unsigned out_rate);
+
+/*
+ * set how much the output rate should be adjusted by, as a fraction of the
+ * nominal rate.  Positive values produce more output samples and negative
+ * values produce fewer.  This gets clamped to +/-RESAMPLER_MAX_ADJUST.
+ */
+void resampler_set_adjust(struct resampler *rs, double adjust);
+
+/*
+ * upper bound on how many samples resampler_process can produce from
+ * n_in input samples.
+ */
+unsigned resampler_max_out(struct resampler const *rs, unsigned n_in);
+
+// returns the number of samples written to out
+unsigned resampler_process(struct resampler *rs,
+                           washdc_sample_type const *in, unsigned n_in,
+                           washdc_sample_type *out);
+
+#endif
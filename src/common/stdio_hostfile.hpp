@@ -23,6 +23,15 @@
 #ifndef STDIO_HOSTFILE_HPP_
 #define STDIO_HOSTFILE_HPP_
 
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+
 #include "washdc/hostfile.h"
 
 static washdc_hostfile file_stdio_open(char const *path,
@@ -83,4 +92,92 @@ static int file_stdio_flush(washdc_hostfile file) {
     return fflush((FILE*)file);
 }
 
+#ifndef _WIN32
+
+/*
+ * these go straight to the file descriptor, underneath the FILE's buffer and
+ * file position.
+ */
+static size_t file_stdio_pread(washdc_hostfile file, void *outp,
+                               size_t len, long offs) {
+    int fd = fileno((FILE*)file);
+    char *dst = (char*)outp;
+    size_t total = 0;
+
+    while (total < len) {
+        ssize_t n_read = pread(fd, dst + total, len - total, offs + total);
+        if (n_read < 0 && errno == EINTR)
+            continue;
+        if (n_read <= 0)
+            break;
+        total += n_read;
+    }
+    return total;
+}
+
+#define FILE_STDIO_MAX_IOV 16
+
+static size_t file_stdio_preadv(washdc_hostfile file,
+                                struct washdc_hostfile_iov const *iov,
+                                unsigned n_iov, long offs) {
+    size_t total = 0;
+    unsigned idx;
+
+    if (n_iov <= FILE_STDIO_MAX_IOV) {
+        struct iovec vec[FILE_STDIO_MAX_IOV];
+        for (idx = 0; idx < n_iov; idx++) {
+            vec[idx].iov_base = iov[idx].outp;
+            vec[idx].iov_len = iov[idx].len;
+        }
+
+        ssize_t n_read;
+        do {
+            n_read = preadv(fileno((FILE*)file), vec, n_iov, offs);
+        } while (n_read < 0 && errno == EINTR);
+        if (n_read < 0)
+            return 0;
+        total = n_read;
+    }
+
+    // pick up after a short read, or do the whole thing if there were too many
+    size_t skip = total;
+    for (idx = 0; idx < n_iov; idx++) {
+        if (skip >= iov[idx].len) {
+            skip -= iov[idx].len;
+            continue;
+        }
+
+        size_t want = iov[idx].len - skip;
+        size_t n_read = file_stdio_pread(file, (char*)iov[idx].outp + skip,
+                                         want, offs + total);
+        total += n_read;
+        skip = 0;
+        if (n_read != want)
+            break;
+    }
+    return total;
+}
+
+static void const *file_stdio_map(washdc_hostfile file, size_t *len) {
+    int fd = fileno((FILE*)file);
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        return NULL;
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    *len = st.st_size;
+    return map;
+}
+
+static void file_stdio_unmap(washdc_hostfile file, void const *map,
+                             size_t len) {
+    munmap((void*)map, len);
+}
+
+#endif
+
 #endif
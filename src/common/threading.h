@@ -23,8 +23,22 @@
 #ifndef WASHDC_THREADING_H_
 #define WASHDC_THREADING_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
 typedef void(*washdc_thread_main)(void*);
 
+enum washdc_thread_prio {
+    WASHDC_THREAD_PRIO_NORMAL,
+    WASHDC_THREAD_PRIO_HIGH,
+
+    // this usually needs elevated privileges
+    WASHDC_THREAD_PRIO_REALTIME
+};
+
 #ifdef _WIN32
 
 #include "i_hate_windows.h"
@@ -73,10 +87,30 @@ inline static void washdc_cvar_wait(washdc_cvar *cvar, washdc_mutex *mtx) {
     }
 }
 
+/*
+ * like washdc_cvar_wait, but gives up after timeout_ms milliseconds.  Returns
+ * false if it timed out.
+ */
+inline static bool
+washdc_cvar_timed_wait(washdc_cvar *cvar, washdc_mutex *mtx,
+                       unsigned timeout_ms) {
+    if (!SleepConditionVariableSRW(cvar, mtx, timeout_ms, 0)) {
+        if (GetLastError() != ERROR_TIMEOUT)
+            fprintf(stderr, "Failure to acquire condition variable - %08X!\n",
+                    (unsigned)GetLastError());
+        return false;
+    }
+    return true;
+}
+
 inline static void washdc_cvar_signal(washdc_cvar *cvar) {
     WakeAllConditionVariable(cvar);
 }
 
+inline static void washdc_cvar_broadcast(washdc_cvar *cvar) {
+    WakeAllConditionVariable(cvar);
+}
+
 inline static DWORD washdc_thread_entry_proxy_win32(_In_ LPVOID lpParameter) {
     washdc_thread *td = (washdc_thread*)lpParameter;
     td->entry(td->argp);
@@ -98,10 +132,46 @@ inline static void washdc_thread_join(washdc_thread *td) {
         fprintf(stderr, "unable to join thread\n");
 }
 
+/*
+ * restrict the calling thread to the CPUs whose bits are set in cpu_mask.
+ * Returns 0 on success or -1 if that isn't possible.
+ */
+inline static int washdc_thread_set_affinity(uint64_t cpu_mask) {
+    return SetThreadAffinityMask(GetCurrentThread(),
+                                 (DWORD_PTR)cpu_mask) ? 0 : -1;
+}
+
+// returns 0 on success or -1 if that isn't possible
+inline static int washdc_thread_set_prio(enum washdc_thread_prio prio) {
+    int win_prio;
+    switch (prio) {
+    case WASHDC_THREAD_PRIO_NORMAL:
+        win_prio = THREAD_PRIORITY_NORMAL;
+        break;
+    case WASHDC_THREAD_PRIO_HIGH:
+        win_prio = THREAD_PRIORITY_HIGHEST;
+        break;
+    case WASHDC_THREAD_PRIO_REALTIME:
+        win_prio = THREAD_PRIORITY_TIME_CRITICAL;
+        break;
+    default:
+        return -1;
+    }
+    return SetThreadPriority(GetCurrentThread(), win_prio) ? 0 : -1;
+}
+
 #else
 
 #include <pthread.h>
-#include <stdio.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(__linux__) && defined(_GNU_SOURCE)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
 
 typedef struct {
     void *argp;
@@ -143,10 +213,32 @@ inline static void washdc_cvar_wait(washdc_cvar *cvar, washdc_mutex *mtx) {
         fprintf(stderr, "Failure to acquire condition variable\n");
 }
 
+inline static bool
+washdc_cvar_timed_wait(washdc_cvar *cvar, washdc_mutex *mtx,
+                       unsigned timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    int err = pthread_cond_timedwait(cvar, mtx, &deadline);
+    if (err != 0 && err != ETIMEDOUT)
+        fprintf(stderr, "Failure to acquire condition variable\n");
+    return err == 0;
+}
+
 inline static void washdc_cvar_signal(washdc_cvar *cvar) {
     pthread_cond_signal(cvar);
 }
 
+inline static void washdc_cvar_broadcast(washdc_cvar *cvar) {
+    pthread_cond_broadcast(cvar);
+}
+
 inline static void *washdc_thread_entry_proxy_unix(void *argp) {
     washdc_thread *td = (washdc_thread*)argp;
     td->entry(td->argp);
@@ -164,6 +256,109 @@ inline static void washdc_thread_join(washdc_thread *td) {
     pthread_join(td->td, NULL);
 }
 
+/*
+ * restrict the calling thread to the CPUs whose bits are set in cpu_mask.
+ * Returns 0 on success or -1 if that isn't possible.  This is only
+ * implemented on Linux.
+ */
+inline static int washdc_thread_set_affinity(uint64_t cpu_mask) {
+#if defined(__linux__) && defined(_GNU_SOURCE)
+    cpu_set_t set;
+    unsigned cpu;
+
+    CPU_ZERO(&set);
+    for (cpu = 0; cpu < 64; cpu++)
+        if (cpu_mask & ((uint64_t)1 << cpu))
+            CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? -1 : 0;
+#else
+    return -1;
 #endif
+}
+
+/*
+ * returns 0 on success or -1 if that isn't possible.  HIGH is only
+ * implemented on Linux, where it's a nice value of -10 on the calling thread.
+ */
+inline static int washdc_thread_set_prio(enum washdc_thread_prio prio) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+
+    switch (prio) {
+    case WASHDC_THREAD_PRIO_NORMAL:
+        if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) != 0)
+            return -1;
+#if defined(__linux__) && defined(_GNU_SOURCE)
+        return setpriority(PRIO_PROCESS, syscall(SYS_gettid), 0);
+#else
+        return 0;
+#endif
+    case WASHDC_THREAD_PRIO_HIGH:
+#if defined(__linux__) && defined(_GNU_SOURCE)
+        return setpriority(PRIO_PROCESS, syscall(SYS_gettid), -10);
+#else
+        return -1;
+#endif
+    case WASHDC_THREAD_PRIO_REALTIME:
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        return pthread_setschedparam(pthread_self(),
+                                     SCHED_FIFO, &param) ? -1 : 0;
+    default:
+        return -1;
+    }
+}
+
+#endif
+
+/*
+ * parse a list of CPUs like "0,2-3" into a mask for
+ * washdc_thread_set_affinity.  Returns 0 on success or -1 if the list is
+ * malformed or names a CPU above 63.
+ */
+inline static int washdc_cpu_list_parse(char const *str, uint64_t *mask) {
+    uint64_t ret = 0;
+
+    for (;;) {
+        char *end;
+        unsigned long first = strtoul(str, &end, 10), last = first;
+        if (end == str)
+            return -1;
+        str = end;
+        if (*str == '-') {
+            last = strtoul(++str, &end, 10);
+            if (end == str)
+                return -1;
+            str = end;
+        }
+        if (first > last || last > 63)
+            return -1;
+        for (; first <= last; first++)
+            ret |= (uint64_t)1 << first;
+
+        if (*str == '\0')
+            break;
+        if (*str++ != ',')
+            return -1;
+    }
+
+    *mask = ret;
+    return 0;
+}
+
+/*
+ * pin the calling thread to the CPUs in the list cpus.  This does nothing if
+ * cpus is NULL or empty, and it only complains if it fails.  what names the
+ * thread in the error message.
+ */
+inline static void washdc_thread_pin_self(char const *what, char const *cpus) {
+    uint64_t mask;
+
+    if (!cpus || !*cpus)
+        return;
+    if (washdc_cpu_list_parse(cpus, &mask) != 0)
+        fprintf(stderr, "%s thread: invalid CPU list \"%s\"\n", what, cpus);
+    else if (washdc_thread_set_affinity(mask) != 0)
+        fprintf(stderr, "%s thread: unable to pin to CPUs %s\n", what, cpus);
+}
 
 #endif
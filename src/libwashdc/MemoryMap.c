@@ -21,41 +21,48 @@
  ******************************************************************************/
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #include "dreamcast.h"
 #include "washdc/error.h"
 #include "mem_code.h"
+#include "memory.h"
 
 #include "washdc/MemoryMap.h"
 
+#ifdef ENABLE_WATCHPOINTS
+#include "washdc/debugger.h"
+#endif
+
+static void memory_map_update_pages(struct memory_map *map, unsigned reg_idx);
+
 void memory_map_init(struct memory_map *map) {
     memset(map, 0, sizeof(*map));
+    memset(map->page_tbl, MEMORY_MAP_PAGE_UNMAPPED, sizeof(map->page_tbl));
 }
 
 void memory_map_cleanup(struct memory_map *map) {
     memset(map, 0, sizeof(*map));
+    memset(map->page_tbl, MEMORY_MAP_PAGE_UNMAPPED, sizeof(map->page_tbl));
 }
 
 #define MEMORY_MAP_READ_TMPL(type, type_postfix)                        \
     type memory_map_read_##type_postfix(struct memory_map *map,         \
                                         uint32_t addr) {                \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            uint32_t mask = reg->mask;                                  \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
+            CHECK_R_WATCHPOINT(addr, type);                             \
                                                                         \
-                CHECK_R_WATCHPOINT(addr, type);                         \
-                                                                        \
-                return intf->read##type_postfix(addr & mask, ctxt);     \
+            if (reg->host) {                                            \
+                type val;                                               \
+                memcpy(&val, reg->host + (addr & mask), sizeof(val));   \
+                return val;                                             \
             }                                                           \
+            return reg->intf->read##type_postfix(addr & mask,           \
+                                                 reg->ctxt);            \
         }                                                               \
                                                                         \
         struct memory_interface const *unmap = map->unmap;              \
@@ -78,26 +85,19 @@ MEMORY_MAP_READ_TMPL(double, double)
 #define MEMORY_MAP_TRY_READ_TMPL(type, type_postfix)                    \
     int memory_map_try_read_##type_postfix(struct memory_map *map,      \
                                            uint32_t addr, type *val) {  \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
-                                                                        \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
-                if (intf->try_read##type_postfix) {                     \
-                    return intf->try_read##type_postfix(addr & mask,    \
-                                                        val, ctxt);     \
-                } else {                                                \
-                    *val = intf->read##type_postfix(addr & mask, ctxt); \
-                }                                                       \
-                return 0;                                               \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            struct memory_interface const *intf = reg->intf;            \
+            uint32_t mask = reg->mask;                                  \
+            void *ctxt = reg->ctxt;                                     \
+            if (intf->try_read##type_postfix) {                         \
+                return intf->try_read##type_postfix(addr & mask,        \
+                                                    val, ctxt);         \
+            } else {                                                    \
+                *val = intf->read##type_postfix(addr & mask, ctxt);     \
             }                                                           \
+            return 0;                                                   \
         }                                                               \
                                                                         \
         return 1;                                                       \
@@ -112,24 +112,22 @@ MEMORY_MAP_TRY_READ_TMPL(double, double)
 #define MEM_MAP_WRITE_TMPL(type, type_postfix)                          \
     void memory_map_write_##type_postfix(struct memory_map *map,        \
                                          uint32_t addr, type val) {     \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            uint32_t mask = reg->mask;                                  \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
+            CHECK_W_WATCHPOINT(addr, type);                             \
                                                                         \
-                CHECK_W_WATCHPOINT(addr, type);                         \
-                                                                        \
-                intf->write##type_postfix(addr & mask, val, ctxt);      \
+            if (reg->host) {                                            \
+                memcpy(reg->host + (addr & mask), &val, sizeof(val));   \
+                code_cache_notify_ram_write(addr & mask, sizeof(val));  \
+                savestate_notify_ram_write(addr & mask, sizeof(val));   \
                 return;                                                 \
             }                                                           \
+            reg->intf->write##type_postfix(addr & mask, val,            \
+                                           reg->ctxt);                  \
+            return;                                                     \
         }                                                               \
                                                                         \
         struct memory_interface const *unmap = map->unmap;              \
@@ -152,26 +150,19 @@ MEM_MAP_WRITE_TMPL(double, double)
 #define MEM_MAP_TRY_WRITE_TMPL(type, type_postfix)                      \
     int memory_map_try_write_##type_postfix(struct memory_map *map,     \
                                             uint32_t addr, type val) {  \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
-                                                                        \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
-                if (intf->try_write##type_postfix) {                    \
-                    return intf->try_write##type_postfix(addr & mask,   \
-                                                         val, ctxt);    \
-                } else {                                                \
-                    intf->write##type_postfix(addr & mask, val, ctxt);  \
-                }                                                       \
-                return 0;                                               \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            struct memory_interface const *intf = reg->intf;            \
+            uint32_t mask = reg->mask;                                  \
+            void *ctxt = reg->ctxt;                                     \
+            if (intf->try_write##type_postfix) {                        \
+                return intf->try_write##type_postfix(addr & mask,       \
+                                                     val, ctxt);        \
+            } else {                                                    \
+                intf->write##type_postfix(addr & mask, val, ctxt);      \
             }                                                           \
+            return 0;                                                   \
         }                                                               \
         return 1;                                                       \
     }                                                                   \
@@ -203,4 +194,53 @@ memory_map_add(struct memory_map *map,
     reg->id = id;
     reg->intf = intf;
     reg->ctxt = ctxt;
+
+    if (id == MEMORY_MAP_REGION_RAM)
+        reg->host = ((struct Memory*)ctxt)->mem;
+    else
+        reg->host = NULL;
+
+    memory_map_update_pages(map, map->n_regions - 1);
+}
+
+/*
+ * fill in the page table entries for a newly-added region.  Regions are
+ * searched in the order they were added and the first match wins, so any page
+ * that already has an entry is left alone; a page that was previously
+ * unmapped either belongs to this region (if the region covers the whole
+ * thing) or gets marked as MEMORY_MAP_PAGE_MIXED (if it only covers part of
+ * it).
+ */
+static void memory_map_update_pages(struct memory_map *map, unsigned reg_idx) {
+    struct memory_map_region const *reg = map->regions + reg_idx;
+    uint32_t range_mask = reg->range_mask;
+
+    /*
+     * if the range_mask clears any of the bits within a page then the page's
+     * addresses won't be contiguous after masking.  That doesn't happen with
+     * any of the regions we have now, but if it ever does we just search those
+     * pages linearly.
+     */
+    bool contiguous =
+        (range_mask & MEMORY_MAP_PAGE_MASK) == MEMORY_MAP_PAGE_MASK;
+
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_MAP_N_PAGES; page_no++) {
+        if (map->page_tbl[page_no] != MEMORY_MAP_PAGE_UNMAPPED)
+            continue;
+
+        if (!contiguous) {
+            map->page_tbl[page_no] = MEMORY_MAP_PAGE_MIXED;
+            continue;
+        }
+
+        uint32_t page_first = ((uint32_t)page_no << MEMORY_MAP_PAGE_SHIFT) &
+            range_mask;
+        uint32_t page_last = page_first + MEMORY_MAP_PAGE_MASK;
+
+        if (page_first >= reg->first_addr && page_last <= reg->last_addr)
+            map->page_tbl[page_no] = reg_idx;
+        else if (page_first <= reg->last_addr && page_last >= reg->first_addr)
+            map->page_tbl[page_no] = MEMORY_MAP_PAGE_MIXED;
+    }
 }
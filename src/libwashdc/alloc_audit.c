@@ -0,0 +1,223 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "log.h"
+
+#include "alloc_audit.h"
+
+/*
+ * dladdr is a GNU extension, so call sites only get names when the build
+ * defines _GNU_SOURCE (see CMakeLists.txt).
+ */
+#if defined(ENABLE_ALLOC_AUDIT) && defined(__GLIBC__)
+
+#ifdef _GNU_SOURCE
+#include <dlfcn.h>
+#define ALLOC_AUDIT_DLADDR
+#endif
+
+/*
+ * glibc lets a program replace malloc and friends by defining them itself.
+ * These forward to glibc's own allocator so that memory from functions which
+ * aren't replaced here (memalign, etc) can still be passed to free.
+ */
+void *__libc_malloc(size_t n_bytes);
+void *__libc_calloc(size_t n_elem, size_t elem_sz);
+void *__libc_realloc(void *ptr, size_t n_bytes);
+void __libc_free(void *ptr);
+
+#define ALLOC_AUDIT_MAX_SITES 64
+
+struct alloc_site {
+    void const *addr;
+    unsigned long n_allocs, n_frees;
+    unsigned long frame_allocs, frame_frees;
+};
+
+/*
+ * everything below is only ever touched by the thread that calls
+ * alloc_audit_frame, so none of it needs locks.  The last site collects
+ * anything that doesn't fit in the table.
+ */
+static struct alloc_site sites[ALLOC_AUDIT_MAX_SITES];
+static unsigned n_sites;
+
+static unsigned long frame_allocs, frame_frees;
+static unsigned long total_allocs, total_frees;
+
+static _Thread_local bool counting;
+
+static bool audit_started;
+static unsigned frames_left, frame_no;
+
+static struct alloc_site *alloc_site_get(void const *addr) {
+    unsigned idx;
+    for (idx = 0; idx < n_sites; idx++)
+        if (sites[idx].addr == addr)
+            return sites + idx;
+    if (n_sites == ALLOC_AUDIT_MAX_SITES)
+        return sites + ALLOC_AUDIT_MAX_SITES - 1;
+    sites[n_sites].addr = addr;
+    return sites + n_sites++;
+}
+
+static void count_alloc(void const *addr) {
+    struct alloc_site *site = alloc_site_get(addr);
+    site->n_allocs++;
+    site->frame_allocs++;
+    frame_allocs++;
+    total_allocs++;
+}
+
+static void count_free(void const *addr) {
+    struct alloc_site *site = alloc_site_get(addr);
+    site->n_frees++;
+    site->frame_frees++;
+    frame_frees++;
+    total_frees++;
+}
+
+void *malloc(size_t n_bytes) {
+    if (counting)
+        count_alloc(__builtin_return_address(0));
+    return __libc_malloc(n_bytes);
+}
+
+void *calloc(size_t n_elem, size_t elem_sz) {
+    if (counting)
+        count_alloc(__builtin_return_address(0));
+    return __libc_calloc(n_elem, elem_sz);
+}
+
+void *realloc(void *ptr, size_t n_bytes) {
+    if (counting)
+        count_alloc(__builtin_return_address(0));
+    return __libc_realloc(ptr, n_bytes);
+}
+
+void free(void *ptr) {
+    if (counting && ptr)
+        count_free(__builtin_return_address(0));
+    __libc_free(ptr);
+}
+
+void alloc_audit_start(unsigned warmup_frames) {
+    audit_started = true;
+    frames_left = warmup_frames;
+    frame_no = 0;
+    n_sites = 0;
+    frame_allocs = frame_frees = total_allocs = total_frees = 0;
+    LOG_INFO("alloc_audit: counting heap allocations after %u frames\n",
+             warmup_frames);
+}
+
+/*
+ * symbol names only resolve for functions in the dynamic symbol table (so
+ * link with -rdynamic for those); anything else gets module+offset, which
+ * addr2line can make sense of.
+ */
+static void alloc_site_log(struct alloc_site const *site) {
+#ifdef ALLOC_AUDIT_DLADDR
+    Dl_info info;
+    if (site->addr && dladdr(site->addr, &info) && info.dli_fname) {
+        void const *base = info.dli_sname ? info.dli_saddr : info.dli_fbase;
+        LOG_WARN("alloc_audit:     %p %s+0x%lx: %lu allocs, %lu frees\n",
+                 site->addr,
+                 info.dli_sname ? info.dli_sname : info.dli_fname,
+                 (unsigned long)((char const*)site->addr -
+                                 (char const*)base),
+                 site->frame_allocs, site->frame_frees);
+        return;
+    }
+#endif
+    LOG_WARN("alloc_audit:     %p: %lu allocs, %lu frees\n",
+             site->addr, site->frame_allocs, site->frame_frees);
+}
+
+void alloc_audit_frame(void) {
+    if (!audit_started)
+        return;
+
+    if (!counting) {
+        if (frames_left && --frames_left)
+            return;
+        counting = true;
+        return;
+    }
+
+    frame_no++;
+    if (!frame_allocs && !frame_frees)
+        return;
+
+    // logging isn't part of the frame, so it doesn't get counted
+    counting = false;
+    LOG_WARN("alloc_audit: frame %u after warm-up: %lu allocs, %lu frees\n",
+             frame_no, frame_allocs, frame_frees);
+    unsigned idx;
+    for (idx = 0; idx < n_sites; idx++) {
+        struct alloc_site *site = sites + idx;
+        if (site->frame_allocs || site->frame_frees)
+            alloc_site_log(site);
+        site->frame_allocs = site->frame_frees = 0;
+    }
+    frame_allocs = frame_frees = 0;
+    counting = true;
+}
+
+bool alloc_audit_active(void) {
+    return audit_started;
+}
+
+unsigned long alloc_audit_n_allocs(void) {
+    return total_allocs;
+}
+
+unsigned long alloc_audit_n_frees(void) {
+    return total_frees;
+}
+
+#else
+
+void alloc_audit_start(unsigned warmup_frames) {
+    LOG_WARN("alloc_audit: this build of WashingtonDC can't audit heap "
+             "allocations (build with ENABLE_ALLOC_AUDIT on glibc)\n");
+}
+
+void alloc_audit_frame(void) {
+}
+
+bool alloc_audit_active(void) {
+    return false;
+}
+
+unsigned long alloc_audit_n_allocs(void) {
+    return 0;
+}
+
+unsigned long alloc_audit_n_frees(void) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ALLOC_AUDIT_H_
+#define ALLOC_AUDIT_H_
+
+#include <stdbool.h>
+
+/*
+ * steady-state heap allocation audit.
+ *
+ * Once the audit is started, alloc_audit_frame gets called at the end of
+ * every emulated frame.  After the first warmup_frames frames, every call to
+ * malloc, calloc, realloc and free made by the thread that calls
+ * alloc_audit_frame gets counted along with the address it was called from,
+ * and at the end of each frame the call sites that allocated during that frame
+ * get logged.
+ * Nothing that runs every frame is supposed to touch the heap once the
+ * emulator has warmed up, so any site that shows up here is a bug.
+ *
+ * This only does anything when ENABLE_ALLOC_AUDIT is defined and the C library
+ * is glibc, since that's what lets the audit interpose the allocator.
+ * Otherwise alloc_audit_start logs a warning and the counts stay zero.
+ */
+
+void alloc_audit_start(unsigned warmup_frames);
+
+void alloc_audit_frame(void);
+
+// true if alloc_audit_start was called and the audit is actually supported
+bool alloc_audit_active(void);
+
+// totals since the end of the warm-up
+unsigned long alloc_audit_n_allocs(void);
+unsigned long alloc_audit_n_frees(void);
+
+#endif
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include "real_ticks.h"
+
+#include "bench.h"
+
+bool bench_enabled;
+
+static enum bench_sect cur_sect;
+static washdc_real_time last_switch;
+static double sect_seconds[BENCH_SECT_COUNT];
+
+void bench_start(void) {
+    unsigned idx;
+    for (idx = 0; idx < BENCH_SECT_COUNT; idx++)
+        sect_seconds[idx] = 0.0;
+    cur_sect = BENCH_OTHER;
+    washdc_get_real_time(&last_switch);
+    bench_enabled = true;
+}
+
+enum bench_sect bench_switch(enum bench_sect sect) {
+    washdc_real_time now, delta;
+    washdc_get_real_time(&now);
+    washdc_real_time_diff(&delta, &now, &last_switch);
+    sect_seconds[cur_sect] += washdc_real_time_to_seconds(&delta);
+    last_switch = now;
+
+    enum bench_sect prev = cur_sect;
+    cur_sect = sect;
+    return prev;
+}
+
+char const *bench_sect_name(enum bench_sect sect) {
+    static char const *names[BENCH_SECT_COUNT] = {
+        [BENCH_OTHER] = "other",
+        [BENCH_SH4] = "sh4_exec",
+        [BENCH_ARM7] = "arm7_exec",
+        [BENCH_SCHED] = "scheduler",
+        [BENCH_AICA] = "aica_mix",
+        [BENCH_TA] = "ta_decode",
+        [BENCH_TEX] = "tex_decode",
+        [BENCH_GDROM] = "gdrom_io"
+    };
+    return names[sect];
+}
+
+void bench_get_seconds(double seconds[BENCH_SECT_COUNT]) {
+    // bring the current section up to date
+    if (bench_enabled)
+        bench_switch(cur_sect);
+
+    unsigned idx;
+    for (idx = 0; idx < BENCH_SECT_COUNT; idx++)
+        seconds[idx] = sect_seconds[idx];
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdbool.h>
+
+/*
+ * host-time accounting for benchmark mode (config_get_bench_frames).
+ *
+ * The emulation thread is always "in" one section, and time is charged to
+ * whichever section it's in, so nested sections don't get counted twice; for
+ * example, time spent decoding TA packets that get written by the SH4 counts
+ * towards BENCH_TA and not BENCH_SH4.  This is only meant to be used from the
+ * emulation thread.
+ */
+
+enum bench_sect {
+    BENCH_OTHER,
+    BENCH_SH4,
+    BENCH_ARM7,
+    BENCH_SCHED,
+    BENCH_AICA,
+    BENCH_TA,
+    BENCH_TEX,
+    BENCH_GDROM,
+
+    BENCH_SECT_COUNT
+};
+
+extern bool bench_enabled;
+
+void bench_start(void);
+
+// charge time up to now to the current section, then switch to sect
+enum bench_sect bench_switch(enum bench_sect sect);
+
+/*
+ * bench_enter returns the section that was current before, which has to get
+ * passed to bench_leave.
+ */
+static inline enum bench_sect bench_enter(enum bench_sect sect) {
+    return bench_enabled ? bench_switch(sect) : sect;
+}
+
+static inline void bench_leave(enum bench_sect prev) {
+    if (bench_enabled)
+        bench_switch(prev);
+}
+
+// key used for the given section in the benchmark report
+char const *bench_sect_name(enum bench_sect sect);
+
+// seconds of host time spent in each section so far
+void bench_get_seconds(double seconds[BENCH_SECT_COUNT]);
+
+#endif
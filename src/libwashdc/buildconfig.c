@@ -37,3 +37,19 @@ bool washdc_have_x86_64_jit(void) {
     return false;
 #endif
 }
+
+bool washdc_have_aarch64_jit(void) {
+#ifdef ENABLE_JIT_AARCH64
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool washdc_have_native_jit(void) {
+#ifdef ENABLE_JIT_NATIVE
+    return true;
+#else
+    return false;
+#endif
+}
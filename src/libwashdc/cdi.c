@@ -28,6 +28,7 @@
 #include "log.h"
 #include "mount.h"
 #include "cdrom.h"
+#include "sector_cache.h"
 #include "washdc/hostfile.h"
 #include "washdc/error.h"
 
@@ -58,10 +59,25 @@ struct cdi_session {
     struct cdi_track *tracks;
 };
 
+/*
+ * where to find the frames of a single track within the .cdi file.  These
+ * are built once at mount time and sorted by fad.
+ */
+struct cdi_extent {
+    struct sector_run run;
+    unsigned data_offset; // offset to the data within each frame
+};
+
 struct cdi_mount {
     washdc_hostfile stream;
     unsigned n_sessions;
     struct cdi_session *sessions;
+
+    unsigned n_extents;
+    struct cdi_extent *extents;
+    unsigned last_extent;
+
+    struct sector_cache cache;
 };
 
 static void read_session(washdc_hostfile stream,
@@ -71,12 +87,19 @@ static void read_track(washdc_hostfile stream,
                        struct cdi_track *track,
                        size_t *total_pos, unsigned ver);
 static unsigned cdi_get_leadout(struct mount *mount);
+static void cdi_build_index(struct cdi_mount *mount);
+static struct cdi_extent const *cdi_find_extent(struct cdi_mount *mount,
+                                               unsigned fad);
 
 static unsigned mount_cdi_session_count(struct mount *mount);
 static int mount_cdi_read_toc(struct mount *mount, struct mount_toc *toc,
                               unsigned region);
 static int mount_cdi_read_sector(struct mount *mount,
                                  void *buf, unsigned fad);
+static int mount_cdi_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned sector_count);
+static int mount_cdi_read_raw_sectors(struct mount *mount, void *buf,
+                                      unsigned fad, unsigned sector_count);
 static void mount_cdi_cleanup(struct mount *mount);
 static int mount_cdi_get_meta(struct mount *mount, struct mount_meta *meta);
 static enum mount_disc_type cdi_get_disc_type(struct mount *mount);
@@ -89,6 +112,8 @@ static struct mount_ops cdi_mount_ops = {
     .session_count = mount_cdi_session_count,
     .read_toc = mount_cdi_read_toc,
     .read_sector = mount_cdi_read_sector,
+    .read_sectors = mount_cdi_read_sectors,
+    .read_raw_sectors = mount_cdi_read_raw_sectors,
     .cleanup = mount_cdi_cleanup,
     .get_meta = mount_cdi_get_meta,
     .get_leadout = cdi_get_leadout,
@@ -191,6 +216,9 @@ void mount_cdi(char const *path) {
         total_n_tracks += mount->sessions[sess_no].n_tracks;
     }
 
+    cdi_build_index(mount);
+    sector_cache_init(&mount->cache);
+
     mount_insert(&cdi_mount_ops, mount);
 }
 
@@ -384,6 +412,9 @@ static void read_track(washdc_hostfile stream,
 static void mount_cdi_cleanup(struct mount *mount) {
     struct cdi_mount *state = (struct cdi_mount*)mount->state;
 
+    sector_cache_cleanup(&state->cache);
+    free(state->extents);
+
     unsigned sess_no;
     for (sess_no = 0; sess_no < state->n_sessions; sess_no++)
         free(state->sessions[sess_no].tracks);
@@ -445,52 +476,141 @@ static unsigned cdi_get_leadout(struct mount *mount) {
     return last_track->start_lba + last_track->track_len;
 }
 
+static int cdi_cmp_extent(void const *lhs, void const *rhs) {
+    unsigned lhs_fad = ((struct cdi_extent const*)lhs)->run.first;
+    unsigned rhs_fad = ((struct cdi_extent const*)rhs)->run.first;
+    if (lhs_fad < rhs_fad)
+        return -1;
+    return lhs_fad > rhs_fad;
+}
+
+static void cdi_build_index(struct cdi_mount *mount) {
+    unsigned n_extents = 0;
+    unsigned sess_no, track_no;
+    for (sess_no = 0; sess_no < mount->n_sessions; sess_no++)
+        n_extents += mount->sessions[sess_no].n_tracks;
+
+    mount->extents = (struct cdi_extent*)calloc(n_extents,
+                                                sizeof(struct cdi_extent));
+    if (n_extents && !mount->extents)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    mount->n_extents = n_extents;
+    mount->last_extent = 0;
+
+    struct cdi_extent *ext = mount->extents;
+    for (sess_no = 0; sess_no < mount->n_sessions; sess_no++) {
+        struct cdi_session const *sess = mount->sessions + sess_no;
+        for (track_no = 0; track_no < sess->n_tracks; track_no++) {
+            struct cdi_track const *track = sess->tracks + track_no;
+
+            ext->run.stream = mount->stream;
+            ext->run.offset = (size_t)track->start +
+                (size_t)track->pregap_len * track->sector_sz;
+            ext->run.frame_len = track->sector_sz;
+            ext->run.first = cdrom_lba_to_fad(track->start_lba);
+            ext->run.count = track->track_len;
+
+            /*
+             * 2048-byte sectors are just the user data; everything else
+             * gets the same 8-byte offset this code has always used.
+             */
+            ext->data_offset = track->sector_sz == CDROM_FRAME_DATA_SIZE ?
+                0 : 8;
+
+            ext++;
+        }
+    }
+
+    qsort(mount->extents, n_extents, sizeof(struct cdi_extent),
+          cdi_cmp_extent);
+}
+
+static struct cdi_extent const *cdi_find_extent(struct cdi_mount *mount,
+                                               unsigned fad) {
+    struct cdi_extent const *ext;
+
+    if (mount->last_extent < mount->n_extents) {
+        ext = mount->extents + mount->last_extent;
+        if (fad >= ext->run.first && fad < ext->run.first + ext->run.count)
+            return ext;
+    }
+
+    unsigned lo = 0, hi = mount->n_extents;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        ext = mount->extents + mid;
+        if (fad < ext->run.first) {
+            hi = mid;
+        } else if (fad >= ext->run.first + ext->run.count) {
+            lo = mid + 1;
+        } else {
+            mount->last_extent = mid;
+            return ext;
+        }
+    }
+
+    return NULL;
+}
+
 static int mount_cdi_read_sector(struct mount *mount,
                                  void *buf, unsigned fad) {
-    struct cdi_mount const *cdi_mount = (struct cdi_mount const*)mount->state;
+    return mount_cdi_read_sectors(mount, buf, fad, 1);
+}
 
-    unsigned lba = cdrom_fad_to_lba(fad);
-    LOG_INFO("CDI Request to read LBA %u\n", lba);
-    unsigned track_no, session_no;
-    for (session_no = 0; session_no < cdi_mount->n_sessions; session_no++) {
-        struct cdi_session *sess = cdi_mount->sessions + session_no;
-        for (track_no = 0; track_no < sess->n_tracks; track_no++) {
-            struct cdi_track *track = sess->tracks + track_no;
-            if (lba >= track->start_lba && lba <
-                track->start_lba + track->track_len) {
-                LOG_INFO("Session %u, track %u\n", session_no, track_no);
-                LOG_INFO("\ttrack start is %u\n", track->start);
-                LOG_INFO("\ttrack pregap length is %u blocks\n", track->pregap_len);
-                LOG_INFO("\ttrack length is %u blocks\n", track->track_len);
-                LOG_INFO("\ttrack sector size is %u\n", track->sector_sz);
-                LOG_INFO("\ttrack first LBA is %u\n", track->start_lba);
-                LOG_INFO("\ttrack control nibble is %u\n", track->ctrl);
-                LOG_INFO("\ttrack total length is %u\n", track->total_len);
-
-                size_t byte_offset = (size_t)track->start +
-                    (size_t)track->pregap_len * track->sector_sz + 8 +
-                    (size_t)(lba - track->start_lba) * track->sector_sz;
-
-                if (washdc_hostfile_seek(cdi_mount->stream,
-                                         byte_offset,
-                                         WASHDC_HOSTFILE_SEEK_BEG) != 0) {
-                    LOG_ERROR("failure to seek to track (byte offset %llx)\n",
-                              (unsigned long long)byte_offset);
-                    return -1;
-                }
-                size_t bytes_read;
-                if ((bytes_read = washdc_hostfile_read(cdi_mount->stream,
-                                                       buf, 2048)) != 2048) {
-                    LOG_ERROR("Failure to read from cdi file (returned length %llu)\n",
-                              (long long unsigned)bytes_read);
-                    return -1;
-                }
-                return 0;
-            }
+static int mount_cdi_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned sector_count) {
+    struct cdi_mount *cdi_mount = (struct cdi_mount*)mount->state;
+    uint8_t *outp = (uint8_t*)buf;
+
+    while (sector_count--) {
+        struct cdi_extent const *ext = cdi_find_extent(cdi_mount, fad);
+        if (!ext) {
+            LOG_ERROR("unable to locate LBA %u\n", cdrom_fad_to_lba(fad));
+            return -1;
+        }
+
+        if (ext->data_offset + CDROM_FRAME_DATA_SIZE > ext->run.frame_len) {
+            LOG_ERROR("unsupported cdi sector size %u\n", ext->run.frame_len);
+            return -1;
+        }
+
+        uint8_t const *frame = sector_cache_get(&cdi_mount->cache,
+                                                &ext->run, fad);
+        if (!frame) {
+            LOG_ERROR("Failure to read LBA %u from cdi file\n",
+                      cdrom_fad_to_lba(fad));
+            return -1;
         }
+
+        memcpy(outp, frame + ext->data_offset, CDROM_FRAME_DATA_SIZE);
+        outp += CDROM_FRAME_DATA_SIZE;
+        fad++;
     }
-    LOG_ERROR("unable to locate LBA %u\n", lba);
-    return -1;
+
+    return 0;
+}
+
+static int mount_cdi_read_raw_sectors(struct mount *mount, void *buf,
+                                      unsigned fad, unsigned sector_count) {
+    struct cdi_mount *cdi_mount = (struct cdi_mount*)mount->state;
+    uint8_t *outp = (uint8_t*)buf;
+
+    while (sector_count--) {
+        struct cdi_extent const *ext = cdi_find_extent(cdi_mount, fad);
+        if (!ext || ext->run.frame_len != CDROM_FRAME_SIZE)
+            return -1;
+
+        uint8_t const *frame = sector_cache_get(&cdi_mount->cache,
+                                                &ext->run, fad);
+        if (!frame)
+            return -1;
+
+        memcpy(outp, frame, CDROM_FRAME_SIZE);
+        outp += CDROM_FRAME_SIZE;
+        fad++;
+    }
+
+    return 0;
 }
 
 static void cdi_get_session_start(struct mount *mount, unsigned session_no,
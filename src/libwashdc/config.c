@@ -85,13 +85,108 @@ CONFIG_DEF_BOOL(enable_cmd_tcp, false);
 
 CONFIG_DEF_BOOL(jit, false);
 
-#ifdef ENABLE_JIT_X86_64
+#ifdef ENABLE_JIT_NATIVE
 CONFIG_DEF_BOOL(native_jit, false);
+CONFIG_DEF_BOOL(jit_dual_map, false);
+CONFIG_DEF_BOOL(jit_fastmem, false);
+CONFIG_DEF_BOOL(jit_tiered, false);
+CONFIG_DEF_BOOL(jit_perf_map, false);
+CONFIG_DEF_BOOL(jit_bg_compile, false);
 #endif
 
 CONFIG_DEF_BOOL(inline_mem, true);
 
 CONFIG_DEF_BOOL(log_verbose, false);
 CONFIG_DEF_BOOL(log_stdout, false);
+CONFIG_DEF_BOOL(log_drop_on_overflow, false);
 
 CONFIG_DEF_BOOL(dump_mem_on_error, false)
+
+CONFIG_DEF_BOOL(rend_thread, false)
+
+CONFIG_DEF_BOOL(arm7_thread, false)
+
+CONFIG_DEF_BOOL(arm7_jit, false)
+
+CONFIG_DEF_BOOL(arm7_idle_skip, false)
+
+CONFIG_DEF_BOOL(sh4_icache, false)
+
+CONFIG_DEF_BOOL(fpu_pedantic, false)
+
+CONFIG_DEF_BOOL(intp_predecode, false)
+
+CONFIG_DEF_BOOL(jit_superblocks, false)
+
+CONFIG_DEF_BOOL(jit_idle_skip, false)
+
+CONFIG_DEF_BOOL(jit_stall_model, false)
+
+CONFIG_DEF_BOOL(jit_persist_cache, false)
+
+CONFIG_DEF_STRING(jit_cache_path);
+
+CONFIG_DEF_INT(jit_cache_budget, 0);
+
+CONFIG_DEF_BOOL(gpu_palette, false)
+
+CONFIG_DEF_BOOL(persistent_verts, false)
+
+CONFIG_DEF_BOOL(packed_verts, false)
+
+CONFIG_DEF_BOOL(merge_draws, false)
+
+CONFIG_DEF_BOOL(mod_vols, false)
+
+CONFIG_DEF_BOOL(poly_sort, false)
+
+CONFIG_DEF_BOOL(list_cache, false)
+
+CONFIG_DEF_BOOL(list_exec_threads, false)
+
+CONFIG_DEF_BOOL(fb_tex_alias, false)
+
+CONFIG_DEF_BOOL(async_readback, false)
+
+CONFIG_DEF_BOOL(gpu_fb_conv, false)
+
+CONFIG_DEF_BOOL(present_mailbox, false)
+
+CONFIG_DEF_BOOL(savestate_fork, false)
+
+CONFIG_DEF_INT(rewind_interval, 0);
+CONFIG_DEF_INT(rewind_budget, 0);
+
+CONFIG_DEF_INT(rollback_frames, 0);
+
+CONFIG_DEF_STRING(replay_record_path);
+CONFIG_DEF_STRING(replay_play_path);
+
+CONFIG_DEF_INT(bench_frames, 0);
+
+CONFIG_DEF_INT(alloc_audit_frames, 0);
+
+CONFIG_DEF_STRING(trace_path);
+
+CONFIG_DEF_STRING(guest_prof_path);
+CONFIG_DEF_STRING(guest_prof_syms);
+CONFIG_DEF_INT(guest_prof_interval, 0);
+
+CONFIG_DEF_STRING(hle_func_syms);
+
+CONFIG_DEF_INT(turbo_frames, 0);
+CONFIG_DEF_INT(frameskip_max, 0);
+CONFIG_DEF_BOOL(frame_limit, false)
+CONFIG_DEF_INT(timeslice_us, 0);
+CONFIG_DEF_BOOL(timeslice_adaptive, false)
+
+CONFIG_DEF_INT(screenshot_fmt, 0);
+CONFIG_DEF_INT(screenshot_png_level, 0);
+
+CONFIG_DEF_STRING(emu_cpus);
+CONFIG_DEF_STRING(rend_cpus);
+CONFIG_DEF_STRING(arm7_cpus);
+CONFIG_DEF_STRING(jit_cpus);
+
+CONFIG_DEF_STRING(tex_dump_dir);
+CONFIG_DEF_STRING(tex_pack_dir);
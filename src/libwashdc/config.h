@@ -83,9 +83,9 @@ CONFIG_DECL_STRING(exec_bin_path);
 // enable the dynamic recompiler, or disable it to use the interpreter
 CONFIG_DECL_BOOL(jit);
 
-#ifdef ENABLE_JIT_X86_64
+#ifdef ENABLE_JIT_NATIVE
 /*
- * enable the x86_64 backend to the dynamic recompiler.
+ * enable the native (x86_64 or AArch64) backend to the dynamic recompiler.
  * if this is enabled and the jit option is not enabled, then this option will
  * override the jit option and the jit will still be enabled.
  *
@@ -93,17 +93,302 @@ CONFIG_DECL_BOOL(jit);
  * platform-independent interpreter backend will be used.
  */
 CONFIG_DECL_BOOL(native_jit);
+
+/*
+ * map the native jit's code twice, once writable and once executable, instead
+ * of mapping it W|X.  This also gets used automatically if the host refuses
+ * W|X mappings.
+ */
+CONFIG_DECL_BOOL(jit_dual_map);
+
+/*
+ * map guest RAM into a 4GB window of host address space so that the native
+ * jit can access it directly, and catch everything else with a fault handler.
+ * Only the x86_64 backend supports this.
+ */
+CONFIG_DECL_BOOL(jit_fastmem);
+
+/*
+ * run new blocks through the jit's interpreter backend, and only compile them
+ * with the native backend after they've been executed enough times.
+ */
+CONFIG_DECL_BOOL(jit_tiered);
+
+// write a perf(1) symbol map of native code blocks to /tmp/perf-<pid>.map
+CONFIG_DECL_BOOL(jit_perf_map);
+
+/*
+ * compile hot tiered blocks with the native backend on a separate thread
+ * instead of stopping emulation to do it.  This requires jit_tiered.
+ */
+CONFIG_DECL_BOOL(jit_bg_compile);
 #endif
 
 /*
- * if this is set (default is true) then the jit's x86_64 backend will
+ * if this is set (default is true) then the jit's native backend will
  * inline memory accesses.
  */
 CONFIG_DECL_BOOL(inline_mem);
 
 CONFIG_DECL_BOOL(log_stdout);
 CONFIG_DECL_BOOL(log_verbose);
+CONFIG_DECL_BOOL(log_drop_on_overflow);
 
 CONFIG_DECL_BOOL(dump_mem_on_error);
 
+// execute gfx_il commands on a separate render thread
+CONFIG_DECL_BOOL(rend_thread);
+
+// run the ARM7 on its own thread, in lockstep with the SH4
+CONFIG_DECL_BOOL(arm7_thread);
+
+// run the ARM7 through the jit instead of the interpreter
+CONFIG_DECL_BOOL(arm7_jit);
+
+/*
+ * detect ARM7 loops that spin in place waiting on memory and skip straight to
+ * the next scheduled event when they loop back to themselves.
+ */
+CONFIG_DECL_BOOL(arm7_idle_skip);
+
+/*
+ * emulate the SH4's instruction cache in the interpreter.  This only matters
+ * for software which overwrites code without flushing the icache.
+ */
+CONFIG_DECL_BOOL(sh4_icache);
+
+/*
+ * use the pedantic variants of the SH4 FPU handlers, which check for
+ * denormals and invalid operations and keep the FPSCR cause bits up to date.
+ * The jit falls back to the interpreter for those opcodes when this is set.
+ */
+CONFIG_DECL_BOOL(fpu_pedantic);
+
+/*
+ * when the jit is disabled, run the SH4 interpreter on blocks of predecoded
+ * instructions instead of fetching and decoding every instruction.
+ */
+CONFIG_DECL_BOOL(intp_predecode);
+
+/*
+ * let the SH4 jit continue compiling past forward conditional branches
+ * instead of ending the block there.
+ */
+CONFIG_DECL_BOOL(jit_superblocks);
+
+/*
+ * detect SH4 blocks that spin in place waiting on memory and skip straight
+ * to the next scheduled event when they loop back to themselves.
+ */
+CONFIG_DECL_BOOL(jit_idle_skip);
+
+/*
+ * charge SH4 jit blocks for pipeline stalls on load-use and FPU latency
+ * instead of only counting issue cycles.  The cost is worked out once per
+ * block when it's compiled.
+ */
+CONFIG_DECL_BOOL(jit_stall_model);
+
+/*
+ * keep optimized SH4 jit blocks in a file between runs so they don't have to
+ * go through the frontend again.  The file is at jit_cache_path, and this is
+ * ignored if that's empty.
+ */
+CONFIG_DECL_BOOL(jit_persist_cache);
+CONFIG_DECL_STRING(jit_cache_path);
+
+/*
+ * throw out every SH4 block and start over once the code cache is using this
+ * many megabytes.  0 means there's no budget (see code_cache_set_budget).
+ */
+CONFIG_DECL_INT(jit_cache_budget);
+
+/*
+ * send paletted textures to the renderer as palette indices along with the
+ * palette itself instead of looking up every texel on the CPU.  Palette
+ * writes then no longer invalidate any textures.  Only set this if the
+ * renderer supports GFX_IL_SET_PALETTE.
+ */
+CONFIG_DECL_BOOL(gpu_palette);
+
+/*
+ * have the TA write display list vertices directly into persistently-mapped
+ * GPU buffers instead of uploading them every time a display list gets
+ * rendered.  This is ignored if the renderer doesn't support it.
+ */
+CONFIG_DECL_BOOL(persistent_verts);
+
+/*
+ * have the TA write display list vertices in GFX_VERT_FMT_PACKED instead of
+ * GFX_VERT_FMT_FLOAT.  Only set this if the renderer supports it.
+ */
+CONFIG_DECL_BOOL(packed_verts);
+
+/*
+ * merge consecutive triangle strips that share the same render state into
+ * indexed draws.  Only set this if the renderer supports
+ * GFX_IL_DRAW_INDEXED_VERT_ARRAY.
+ */
+CONFIG_DECL_BOOL(merge_draws);
+
+/*
+ * draw opaque modifier volumes (cheap shadows).  Only set this if the renderer
+ * supports GFX_IL_DRAW_MOD_VOL and GFX_IL_APPLY_MOD_VOL.
+ */
+CONFIG_DECL_BOOL(mod_vols);
+
+/*
+ * sort translucent polygons back-to-front in pvr2_core when the guest asks for
+ * auto-sorting, instead of leaving it to the renderer's depth sort mode.
+ */
+CONFIG_DECL_BOOL(poly_sort);
+
+/*
+ * hash display lists as the TA closes them, and when a frame's list matches
+ * the last one that was rendered, send the same gfx_il stream again instead
+ * of rebuilding it.
+ */
+CONFIG_DECL_BOOL(list_cache);
+
+/*
+ * turn each polygon group of a display list into gfx_il on its own thread.
+ * Texture lookups still happen on the emulation thread beforehand.
+ */
+CONFIG_DECL_BOOL(list_exec_threads);
+
+/*
+ * when a polygon samples a texture that aliases a framebuffer which only
+ * exists on the host, bind the host render target instead of copying it back
+ * to texture memory.  The texture's contents only get written back when the
+ * CPU reads them.  Only set this if the renderer supports bind_tex.alias.
+ */
+CONFIG_DECL_BOOL(fb_tex_alias);
+
+/*
+ * copy framebuffers that have been read back before into host memory as soon
+ * as they're done rendering, so a later read doesn't wait for the GPU.  Only
+ * set this if the renderer supports GFX_IL_PREFETCH_OBJ.
+ */
+CONFIG_DECL_BOOL(async_readback);
+
+/*
+ * hand framebuffers that come from texture memory to the renderer in the
+ * guest's pixel format instead of converting them to RGBA8888 on the CPU.
+ * Only set this if the renderer understands post_framebuffer.raw_fmt.
+ */
+CONFIG_DECL_BOOL(gpu_fb_conv);
+
+/*
+ * let the emulation thread queue up a frame while the render thread is still
+ * presenting the previous one.  Frames that have been superseded by the time
+ * the render thread gets to them are drawn but never presented.  This is
+ * ignored unless rend_thread is set.
+ */
+CONFIG_DECL_BOOL(present_mailbox);
+
+/*
+ * write save-state checkpoints from a forked child process's copy-on-write
+ * view of memory instead of copying every dirty page on the emulation thread.
+ * This is only supported on Linux, and it's ignored everywhere else.
+ */
+CONFIG_DECL_BOOL(savestate_fork);
+
+/*
+ * take a rewind snapshot every rewind_interval frames, and keep up to
+ * rewind_budget megabytes of them.  Rewind is disabled if either is 0.
+ */
+CONFIG_DECL_INT(rewind_interval);
+CONFIG_DECL_INT(rewind_budget);
+
+/*
+ * keep in-memory snapshots of the last rollback_frames frames so that
+ * washdc_rollback can go back to any of them.  0 disables rollback.
+ */
+CONFIG_DECL_INT(rollback_frames);
+
+/*
+ * record every maple GETCOND response to replay_record_path, and/or feed the
+ * guest the responses recorded in replay_play_path instead of the host's
+ * input.  Either one is ignored if it's empty.  See replay.h.
+ */
+CONFIG_DECL_STRING(replay_record_path);
+CONFIG_DECL_STRING(replay_play_path);
+
+/*
+ * if this is more than 0, exit after this many frames and print a report of
+ * where the host's time went (see bench.h).
+ */
+CONFIG_DECL_INT(bench_frames);
+
+/*
+ * if this is more than 0, count heap allocations on the emulation thread after
+ * this many frames (see alloc_audit.h).
+ */
+CONFIG_DECL_INT(alloc_audit_frames);
+
+// write a timeline of scheduler events and frame phases here (see trace.h)
+CONFIG_DECL_STRING(trace_path);
+
+/*
+ * sampling profiler for guest code.  If guest_prof_path is set the profiler
+ * starts at boot and writes folded stacks there at exit.  guest_prof_syms
+ * names an ELF to get function names from, and guest_prof_interval is the
+ * time between samples in microseconds (0 for the default).
+ */
+CONFIG_DECL_STRING(guest_prof_path);
+CONFIG_DECL_STRING(guest_prof_syms);
+CONFIG_DECL_INT(guest_prof_interval);
+
+// ELF to take library routine signatures from for the jit (see hle_func.h)
+CONFIG_DECL_STRING(hle_func_syms);
+
+/*
+ * fast-forward mode: if this is more than 1, only present one out of every
+ * turbo_frames frames, skip rendering frames that will never be seen and
+ * discard sound without mixing it.
+ */
+CONFIG_DECL_INT(turbo_frames);
+
+/*
+ * adaptive frameskip: when the host falls behind real time, skip drawing and
+ * presenting up to frameskip_max frames in a row until it catches up.  0
+ * disables it.
+ */
+CONFIG_DECL_INT(frameskip_max);
+
+/*
+ * if set, hold each frame back until the real time which corresponds to the
+ * virtual time at which it ended.  Turbo mode overrides this.
+ */
+CONFIG_DECL_BOOL(frame_limit);
+
+/*
+ * timeslice length in microseconds, or 0 for the default (DC_TIMESLICE).  If
+ * timeslice_adaptive is set, this is the longest that the timeslice can get.
+ */
+CONFIG_DECL_INT(timeslice_us);
+CONFIG_DECL_BOOL(timeslice_adaptive);
+
+// an enum screenshot_fmt for screenshots saved to the screenshot directory
+CONFIG_DECL_INT(screenshot_fmt);
+
+// zlib level (1-9) for PNG screenshots, or 0 to use zlib's default
+CONFIG_DECL_INT(screenshot_png_level);
+
+/*
+ * lists of CPUs ("0,2-3") to pin the emulation, render, ARM7 and background
+ * jit compiler threads to.  Empty leaves the thread wherever the OS puts it.
+ */
+CONFIG_DECL_STRING(emu_cpus);
+CONFIG_DECL_STRING(rend_cpus);
+CONFIG_DECL_STRING(arm7_cpus);
+CONFIG_DECL_STRING(jit_cpus);
+
+/*
+ * directory to dump decoded textures to, and directory of the texture pack to
+ * replace them from (see hw/pvr2/pvr2_tex_pack.h).  Empty turns them off.
+ */
+CONFIG_DECL_STRING(tex_dump_dir);
+CONFIG_DECL_STRING(tex_pack_dir);
+
 #endif
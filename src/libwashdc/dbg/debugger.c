@@ -38,6 +38,8 @@
 
 #ifdef ENABLE_MMU
 #include "hw/sh4/sh4_mem.h"
+#include "jit/code_cache.h"
+#include "savestate.h"
 #endif
 
 #ifndef ENABLE_DEBUGGER
@@ -57,6 +59,25 @@ struct watchpoint {
     bool enabled;
 };
 
+#define DEBUG_N_WATCHPOINTS_MAX                                 \
+    (DEBUG_N_R_WATCHPOINTS > DEBUG_N_W_WATCHPOINTS ?            \
+     DEBUG_N_R_WATCHPOINTS : DEBUG_N_W_WATCHPOINTS)
+
+struct watch_interval {
+    addr32_t first, last;
+};
+
+/*
+ * intervals are sorted by their first address.  max_last[idx] is the highest
+ * last address of any interval up to and including idx, so a search can stop
+ * as soon as it walks back past anything that could still overlap.
+ */
+struct watch_set {
+    struct watch_interval ivals[DEBUG_N_WATCHPOINTS_MAX];
+    addr32_t max_last[DEBUG_N_WATCHPOINTS_MAX];
+    unsigned n_ivals;
+};
+
 struct debug_context {
     enum dbg_context_id id;
     void *cpu;
@@ -70,6 +91,9 @@ struct debug_context {
     struct watchpoint w_watchpoints[DEBUG_N_W_WATCHPOINTS];
     struct watchpoint r_watchpoints[DEBUG_N_R_WATCHPOINTS];
 
+    // the enabled watchpoints, sorted for debug_is_r_watch/debug_is_w_watch
+    struct watch_set r_watch_set, w_watch_set;
+
     // when a watchpoint gets triggered, at_watchpoint is set to true
     // and the memory address is placed in watchpoint_addr
     addr32_t watchpoint_addr;
@@ -129,6 +153,10 @@ struct debugger {
 
 static struct debugger dbg;
 
+// union of every context's watched pages, see CHECK_R_WATCHPOINT
+uint32_t debug_r_watch_pages[DEBUG_WATCH_PAGE_WORDS];
+uint32_t debug_w_watch_pages[DEBUG_WATCH_PAGE_WORDS];
+
 static struct debug_context *get_ctx(void);
 
 
@@ -163,8 +191,13 @@ WASHDC_UNUSED static char const *cur_ctx_str(void);
 
 static addr32_t dbg_get_pc(enum dbg_context_id id);
 
+static void on_break_change(struct debug_context *ctx);
+static void update_watch_pages(struct debug_context *ctx);
+
 void debug_init(void) {
     memset(&dbg, 0, sizeof(dbg));
+    memset(debug_r_watch_pages, 0, sizeof(debug_r_watch_pages));
+    memset(debug_w_watch_pages, 0, sizeof(debug_w_watch_pages));
 
     dbg.contexts[DEBUG_CONTEXT_SH4].cur_state = DEBUG_STATE_NORM;
     dbg.contexts[DEBUG_CONTEXT_ARM7].cur_state = DEBUG_STATE_NORM;
@@ -267,6 +300,7 @@ void debug_notify_inst(void) {
 
 void debug_request_detach(void) {
     washdc_atomic_flag_clear(&dbg.not_detach);
+    dc_wake();
 }
 
 int debug_add_break(enum dbg_context_id id, addr32_t addr) {
@@ -277,6 +311,7 @@ int debug_add_break(enum dbg_context_id id, addr32_t addr) {
         if (!ctx->breakpoints[idx].enabled) {
             ctx->breakpoints[idx].addr = addr;
             ctx->breakpoints[idx].enabled = true;
+            on_break_change(ctx);
             return 0;
         }
 
@@ -294,6 +329,7 @@ int debug_remove_break(enum dbg_context_id id, addr32_t addr) {
         if (ctx->breakpoints[idx].enabled &&
             ctx->breakpoints[idx].addr == addr) {
             ctx->breakpoints[idx].enabled = false;
+            on_break_change(ctx);
             return 0;
         }
 
@@ -302,6 +338,112 @@ int debug_remove_break(enum dbg_context_id id, addr32_t addr) {
     return EINVAL;
 }
 
+bool debug_is_break(enum dbg_context_id id, addr32_t addr) {
+    struct debug_context const *ctx = dbg.contexts + id;
+    for (unsigned idx = 0; idx < DEBUG_N_BREAKPOINTS; idx++)
+        if (ctx->breakpoints[idx].enabled &&
+            ctx->breakpoints[idx].addr == addr)
+            return true;
+    return false;
+}
+
+enum debug_state debug_get_state(enum dbg_context_id id) {
+    return dbg.contexts[id].cur_state;
+}
+
+static void on_break_change(struct debug_context *ctx) {
+    // the sh4 jit splits blocks at breakpoints
+    if (ctx->id == DEBUG_CONTEXT_SH4)
+        dc_invalidate_code_cache();
+}
+
+/*
+ * An access can start on the page before a watchpoint and still run into it,
+ * so that page gets marked too.  That way the inline check in
+ * CHECK_R_WATCHPOINT/CHECK_W_WATCHPOINT only has to look at the page the
+ * access starts on.
+ */
+static void mark_watch_pages(uint32_t *bitmap, struct watch_interval const *iv) {
+    uint32_t page = ((iv->first >> MEMORY_MAP_PAGE_SHIFT) - 1) &
+        (MEMORY_MAP_N_PAGES - 1);
+    uint32_t last = iv->last >> MEMORY_MAP_PAGE_SHIFT;
+    for (;;) {
+        bitmap[page / 32] |= 1u << (page % 32);
+        if (page == last)
+            break;
+        page = (page + 1) & (MEMORY_MAP_N_PAGES - 1);
+    }
+}
+
+static void build_watch_set(struct watch_set *set,
+                            struct watchpoint const *wps, unsigned n_wps) {
+    set->n_ivals = 0;
+
+    // insertion sort by first address
+    unsigned idx;
+    for (idx = 0; idx < n_wps; idx++) {
+        if (!wps[idx].enabled)
+            continue;
+        struct watch_interval iv = {
+            .first = wps[idx].addr,
+            .last = wps[idx].addr + (wps[idx].len - 1)
+        };
+        unsigned pos = set->n_ivals++;
+        while (pos && set->ivals[pos - 1].first > iv.first) {
+            set->ivals[pos] = set->ivals[pos - 1];
+            pos--;
+        }
+        set->ivals[pos] = iv;
+    }
+
+    addr32_t max_last = 0;
+    for (idx = 0; idx < set->n_ivals; idx++) {
+        if (set->ivals[idx].last > max_last)
+            max_last = set->ivals[idx].last;
+        set->max_last[idx] = max_last;
+    }
+}
+
+static bool watch_set_overlaps(struct watch_set const *set,
+                               addr32_t access_first, addr32_t access_last) {
+    // find the number of intervals which start at or before access_last
+    unsigned lo = 0, hi = set->n_ivals;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (set->ivals[mid].first <= access_last)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    while (lo--) {
+        if (set->max_last[lo] < access_first)
+            return false;
+        if (set->ivals[lo].last >= access_first)
+            return true;
+    }
+    return false;
+}
+
+static void update_watch_pages(struct debug_context *ctx) {
+    build_watch_set(&ctx->r_watch_set, ctx->r_watchpoints,
+                    DEBUG_N_R_WATCHPOINTS);
+    build_watch_set(&ctx->w_watch_set, ctx->w_watchpoints,
+                    DEBUG_N_W_WATCHPOINTS);
+
+    memset(debug_r_watch_pages, 0, sizeof(debug_r_watch_pages));
+    memset(debug_w_watch_pages, 0, sizeof(debug_w_watch_pages));
+
+    unsigned ctx_no, idx;
+    for (ctx_no = 0; ctx_no < NUM_DEBUG_CONTEXTS; ctx_no++) {
+        struct debug_context const *cur = dbg.contexts + ctx_no;
+        for (idx = 0; idx < cur->r_watch_set.n_ivals; idx++)
+            mark_watch_pages(debug_r_watch_pages, cur->r_watch_set.ivals + idx);
+        for (idx = 0; idx < cur->w_watch_set.n_ivals; idx++)
+            mark_watch_pages(debug_w_watch_pages, cur->w_watch_set.ivals + idx);
+    }
+}
+
 // these functions return 0 on success, nonzero on failure
 int debug_add_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
     DBG_TRACE("request to add read-watchpoint at 0x%08x\n", (unsigned)addr);
@@ -314,6 +456,7 @@ int debug_add_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
             wp->addr = addr;
             wp->len = len;
             wp->enabled = true;
+            update_watch_pages(ctx);
             return 0;
         }
     }
@@ -334,6 +477,7 @@ int debug_remove_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
         struct watchpoint *wp = ctx->r_watchpoints + idx;
         if (wp->enabled && wp->addr == addr && wp->len == len) {
             wp->enabled = false;
+            update_watch_pages(ctx);
             return 0;
         }
     }
@@ -356,6 +500,7 @@ int debug_add_w_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
             wp->addr = addr;
             wp->len = len;
             wp->enabled = true;
+            update_watch_pages(ctx);
             return 0;
         }
     }
@@ -376,6 +521,7 @@ int debug_remove_w_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
         struct watchpoint *wp = ctx->w_watchpoints + idx;
         if (wp->enabled && wp->addr == addr && wp->len == len) {
             wp->enabled = false;
+            update_watch_pages(ctx);
             return 0;
         }
     }
@@ -392,28 +538,15 @@ bool debug_is_w_watch(addr32_t addr, unsigned len) {
     if (ctx->cur_state != DEBUG_STATE_NORM)
         return false;
 
-    addr32_t access_first = addr;
-    addr32_t access_last = addr + (len - 1);
-
-    for (unsigned idx = 0; idx < DEBUG_N_W_WATCHPOINTS; idx++) {
-        struct watchpoint *wp = ctx->w_watchpoints + idx;
-        if (wp->enabled) {
-            addr32_t watch_first = wp->addr;
-            addr32_t watch_last = watch_first + (wp->len - 1);
-            if ((access_first >= watch_first && access_first <= watch_last) ||
-                (access_last >= watch_first && access_last <= watch_last) ||
-                (watch_first >= access_first && watch_first <= access_last) ||
-                (watch_last >= access_first && watch_last <= access_last)) {
-                dbg_state_transition(DEBUG_STATE_PRE_WATCH);
-                ctx->watchpoint_addr = addr;
-                ctx->is_read_watchpoint = false;
-                DBG_TRACE("write-watchpoint at 0x%08x triggered "
-                          "(PC=0x%08x, cur_ctx = %s)!\n",
-                          (unsigned)addr, (unsigned)dbg_get_pc(dbg.cur_ctx),
-                          cur_ctx_str());
-                return true;
-            }
-        }
+    if (watch_set_overlaps(&ctx->w_watch_set, addr, addr + (len - 1))) {
+        dbg_state_transition(DEBUG_STATE_PRE_WATCH);
+        ctx->watchpoint_addr = addr;
+        ctx->is_read_watchpoint = false;
+        DBG_TRACE("write-watchpoint at 0x%08x triggered "
+                  "(PC=0x%08x, cur_ctx = %s)!\n",
+                  (unsigned)addr, (unsigned)dbg_get_pc(dbg.cur_ctx),
+                  cur_ctx_str());
+        return true;
     }
     return false;
 }
@@ -422,30 +555,17 @@ bool debug_is_r_watch(addr32_t addr, unsigned len) {
     struct debug_context *ctx = get_ctx();
 
     if (ctx->cur_state != DEBUG_STATE_NORM)
-	return false;
-
-    addr32_t access_first = addr;
-    addr32_t access_last = addr + (len - 1);
+        return false;
 
-    for (unsigned idx = 0; idx < DEBUG_N_R_WATCHPOINTS; idx++) {
-        struct watchpoint *wp = ctx->r_watchpoints + idx;
-        if (wp->enabled) {
-            addr32_t watch_first = wp->addr;
-            addr32_t watch_last = watch_first + (wp->len - 1);
-            if ((access_first >= watch_first && access_first <= watch_last) ||
-                (access_last >= watch_first && access_last <= watch_last) ||
-                (watch_first >= access_first && watch_first <= access_last) ||
-                (watch_last >= access_first && watch_last <= access_last)) {
-                dbg_state_transition(DEBUG_STATE_PRE_WATCH);
-                ctx->watchpoint_addr = addr;
-                ctx->is_read_watchpoint = true;
-                DBG_TRACE("read-watchpoint at 0x%08x triggered "
-                          "(PC=0x%08x, cur_ctx = %s)!\n",
-                          (unsigned)addr, (unsigned)dbg_get_pc(dbg.cur_ctx),
-                          cur_ctx_str());
-                return true;
-            }
-        }
+    if (watch_set_overlaps(&ctx->r_watch_set, addr, addr + (len - 1))) {
+        dbg_state_transition(DEBUG_STATE_PRE_WATCH);
+        ctx->watchpoint_addr = addr;
+        ctx->is_read_watchpoint = true;
+        DBG_TRACE("read-watchpoint at 0x%08x triggered "
+                  "(PC=0x%08x, cur_ctx = %s)!\n",
+                  (unsigned)addr, (unsigned)dbg_get_pc(dbg.cur_ctx),
+                  cur_ctx_str());
+        return true;
     }
     return false;
 }
@@ -560,10 +680,12 @@ unsigned debug_bank1_reg_idx(enum dbg_context_id id, unsigned reg_sr, unsigned i
 
 void debug_request_continue(void) {
     washdc_atomic_flag_clear(&dbg.not_continue);
+    dc_wake();
 }
 
 void debug_request_single_step(void) {
     washdc_atomic_flag_clear(&get_ctx()->not_single_step);
+    dc_wake();
 }
 
 void debug_request_break() {
@@ -605,7 +727,6 @@ static void dbg_state_transition(enum debug_state new_state) {
 }
 
 static washdc_mutex debug_mutex = WASHDC_MUTEX_STATIC_INIT;
-static washdc_cvar debug_cond = WASHDC_CVAR_STATIC_INIT;
 
 void debug_lock(void) {
     washdc_mutex_lock(&debug_mutex);
@@ -616,7 +737,7 @@ void debug_unlock(void) {
 }
 
 void debug_signal(void) {
-    washdc_cvar_signal(&debug_cond);
+    dc_wake();
 }
 
 void debug_run_once(void) {
@@ -654,7 +775,9 @@ void debug_run_once(void) {
             memset(ctx->breakpoints, 0, sizeof(ctx->breakpoints));
             memset(ctx->r_watchpoints, 0, sizeof(ctx->r_watchpoints));
             memset(ctx->w_watchpoints, 0, sizeof(ctx->w_watchpoints));
+            update_watch_pages(ctx);
         }
+        dc_invalidate_code_cache();
 
         dbg_state_transition(DEBUG_STATE_NORM);
         dc_state_transition(DC_STATE_RUNNING, DC_STATE_DEBUG);
@@ -746,6 +869,30 @@ void debug_set_reg(enum dbg_context_id id, unsigned reg_no, reg32_t val) {
     }
 }
 
+/*
+ * returns a pointer to the host memory backing [addr, addr + len) if the
+ * entire range lies within a single host-backed region without wrapping
+ * around the end of the mirror, else NULL.  *offs_out receives the offset of
+ * addr within the host buffer.
+ */
+static uint8_t *
+debug_host_ptr(struct memory_map *map, addr32_t addr,
+               unsigned len, addr32_t *offs_out) {
+    if (!len || (uint64_t)addr + len > (uint64_t)0x100000000)
+        return NULL;
+
+    struct memory_map_region *region = memory_map_get_region(map, addr, len);
+    if (!region || !region->host || region->id != MEMORY_MAP_REGION_RAM)
+        return NULL;
+
+    addr32_t offs = addr & region->mask;
+    if ((uint64_t)offs + len > (uint64_t)region->mask + 1)
+        return NULL;
+
+    *offs_out = offs;
+    return region->host + offs;
+}
+
 int debug_read_mem(enum dbg_context_id id, void *out,
                    addr32_t addr, unsigned len) {
     unsigned unit_len, n_units;
@@ -787,6 +934,14 @@ int debug_read_mem(enum dbg_context_id id, void *out,
     }
 #endif
 
+    // big reads out of system memory can skip the memory map entirely
+    addr32_t offs;
+    uint8_t const *host = debug_host_ptr(mmap, addr, len, &offs);
+    if (host) {
+        memcpy(out, host, len);
+        return 0;
+    }
+
     int err;
     while (n_units) {
         switch (unit_len) {
@@ -844,6 +999,15 @@ int debug_write_mem(enum dbg_context_id id, void const *input,
     }
 #endif
 
+    addr32_t offs;
+    uint8_t *host = debug_host_ptr(mmap, addr, len, &offs);
+    if (host) {
+        memcpy(host, input, len);
+        code_cache_notify_ram_range(offs, offs + (len - 1));
+        savestate_notify_ram_range(offs, offs + (len - 1));
+        return 0;
+    }
+
     /*
      * Ideally none of the writes would go through if there's a
      * failure at any point down the line, but that's not the way I've
@@ -899,6 +1063,47 @@ int debug_write_mem(enum dbg_context_id id, void const *input,
     return 0;
 }
 
+unsigned debug_get_mem_ranges(enum dbg_context_id id,
+                              struct debug_mem_range *ranges,
+                              unsigned max_ranges) {
+    struct memory_map const *mmap = dbg.contexts[id].map;
+    unsigned n_ranges = 0;
+    bool in_range = false;
+    bool rom = false;
+    unsigned page_no;
+
+    for (page_no = 0; page_no < MEMORY_MAP_N_PAGES; page_no++) {
+        unsigned ent = mmap->page_tbl[page_no];
+        bool mapped = ent != MEMORY_MAP_PAGE_UNMAPPED;
+        bool page_rom = mapped && ent != MEMORY_MAP_PAGE_MIXED &&
+            mmap->regions[ent].id == MEMORY_MAP_REGION_ROM;
+        addr32_t page_addr = (addr32_t)page_no << MEMORY_MAP_PAGE_SHIFT;
+
+        if (in_range && (!mapped || page_rom != rom)) {
+            in_range = false;
+            n_ranges++;
+        }
+
+        if (mapped) {
+            if (!in_range) {
+                in_range = true;
+                rom = page_rom;
+                if (n_ranges < max_ranges) {
+                    ranges[n_ranges].first = page_addr;
+                    ranges[n_ranges].rom = rom;
+                }
+            }
+            if (n_ranges < max_ranges)
+                ranges[n_ranges].last = page_addr + (MEMORY_MAP_PAGE_SIZE - 1);
+        }
+    }
+
+    if (in_range)
+        n_ranges++;
+
+    return n_ranges;
+}
+
 void debug_init_context(enum dbg_context_id id, void *cpu,
                         struct memory_map *map) {
     memset(dbg.contexts + id, 0, sizeof(dbg.contexts[id]));
@@ -21,23 +21,104 @@
  ******************************************************************************/
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "washdc/error.h"
 #include "hw/sh4/sh4.h" // for SH4_CLOCK_SCALE
 #include "dreamcast.h"
+#include "savestate.h"
+#include "bench.h"
+#include "perf_cnt.h"
+#include "trace.h"
+#include "log.h"
 
 #include "dc_sched.h"
 
 static DEF_ERROR_U64_ATTR(current_dc_cycle_stamp)
 static DEF_ERROR_U64_ATTR(event_sched_dc_cycle_stamp)
+static DEF_ERROR_STRING_ATTR(sched_event_id)
+
+#define SCHED_HEAP_MIN 32
 
 void dc_clock_init(struct dc_clock *clk) {
     memset(clk, 0, sizeof(*clk));
     clk->ptrs_priv = clk->priv;
+    clk->timeslice_len = DC_TIMESLICE;
+
+    clk->heap_priv = (struct sched_heap_ent*)
+        malloc(SCHED_HEAP_MIN * sizeof(struct sched_heap_ent));
+    if (!clk->heap_priv)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    clk->heap_alloc_priv = SCHED_HEAP_MIN;
 }
 
 void dc_clock_cleanup(struct dc_clock *clk) {
+    free(clk->heap_priv);
+    clk->heap_priv = NULL;
+    clk->heap_len_priv = clk->heap_alloc_priv = 0;
+}
+
+// true if lhs needs to come out of the heap before rhs
+static inline bool heap_before(struct sched_heap_ent const *lhs,
+                               struct sched_heap_ent const *rhs) {
+    return lhs->when < rhs->when ||
+        (lhs->when == rhs->when && lhs->serial > rhs->serial);
+}
+
+static inline bool heap_ent_valid(struct sched_heap_ent const *ent) {
+    return ent->event->scheduled && ent->event->sched_serial == ent->serial;
+}
+
+static void heap_sift_up(struct dc_clock *clock, unsigned idx) {
+    struct sched_heap_ent *heap = clock->heap_priv;
+    struct sched_heap_ent ent = heap[idx];
+
+    while (idx) {
+        unsigned parent = (idx - 1) / 4;
+        if (!heap_before(&ent, heap + parent))
+            break;
+        heap[idx] = heap[parent];
+        idx = parent;
+    }
+    heap[idx] = ent;
+}
+
+static void heap_sift_down(struct dc_clock *clock, unsigned idx) {
+    struct sched_heap_ent *heap = clock->heap_priv;
+    unsigned len = clock->heap_len_priv;
+    struct sched_heap_ent ent = heap[idx];
+
+    for (;;) {
+        unsigned first = idx * 4 + 1;
+        if (first >= len)
+            break;
+
+        unsigned last = first + 4 < len ? first + 4 : len;
+        unsigned best = first, child;
+        for (child = first + 1; child < last; child++)
+            if (heap_before(heap + child, heap + best))
+                best = child;
+
+        if (!heap_before(heap + best, &ent))
+            break;
+        heap[idx] = heap[best];
+        idx = best;
+    }
+    heap[idx] = ent;
+}
+
+static void heap_remove_top(struct dc_clock *clock) {
+    if (--clock->heap_len_priv) {
+        clock->heap_priv[0] = clock->heap_priv[clock->heap_len_priv];
+        heap_sift_down(clock, 0);
+    }
+}
+
+// throw away canceled events until the top of the heap is a real event
+static void heap_prune(struct dc_clock *clock) {
+    while (clock->heap_len_priv && !heap_ent_valid(clock->heap_priv))
+        heap_remove_top(clock);
 }
 
 static void update_target_stamp(struct dc_clock *clock) {
@@ -45,8 +126,8 @@ static void update_target_stamp(struct dc_clock *clock) {
         clock->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] -
         clock->ptrs_priv[WASHDC_CLOCK_IDX_COUNTDOWN];
 
-    if (clock->ev_next_priv) {
-        clock->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] = clock->ev_next_priv->when;
+    if (clock->heap_len_priv) {
+        clock->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] = clock->heap_priv[0].when;
     } else {
         /*
          * Somehow there are no events scheduled.
@@ -85,17 +166,25 @@ void sched_event(struct dc_clock *clock, struct SchedEvent *event) {
     }
 #endif
 
-    struct SchedEvent *next_ptr = clock->ev_next_priv;
-    struct SchedEvent **pprev_ptr = &clock->ev_next_priv;
-    while (next_ptr && next_ptr->when < event->when) {
-        pprev_ptr = &next_ptr->next_event;
-        next_ptr = next_ptr->next_event;
+    if (clock->heap_len_priv >= clock->heap_alloc_priv) {
+        unsigned new_alloc = clock->heap_alloc_priv * 2;
+        struct sched_heap_ent *new_heap = (struct sched_heap_ent*)
+            realloc(clock->heap_priv, new_alloc * sizeof(struct sched_heap_ent));
+        if (!new_heap)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        clock->heap_priv = new_heap;
+        clock->heap_alloc_priv = new_alloc;
     }
-    *pprev_ptr = event;
-    if (next_ptr)
-        next_ptr->pprev_event = &event->next_event;
-    event->next_event = next_ptr;
-    event->pprev_event = pprev_ptr;
+
+    event->sched_serial = ++clock->serial_priv;
+    event->scheduled = true;
+
+    unsigned idx = clock->heap_len_priv++;
+    struct sched_heap_ent *ent = clock->heap_priv + idx;
+    ent->when = event->when;
+    ent->serial = event->sched_serial;
+    ent->event = event;
+    heap_sift_up(clock, idx);
 
     update_target_stamp(clock);
 }
@@ -114,19 +203,23 @@ void cancel_event(struct dc_clock *clock, struct SchedEvent *event) {
     }
 #endif
 
-    if (event->next_event)
-        event->next_event->pprev_event = event->pprev_event;
-    *event->pprev_event = event->next_event;
-
-    // XXX this is unnecessary, but I'm trying to be extra-safe here
-    event->next_event = NULL;
-    event->pprev_event = NULL;
+    event->scheduled = false;
 
-    update_target_stamp(clock);
+    // the heap entry stays behind until it gets to the top
+    if (clock->heap_len_priv && clock->heap_priv[0].event == event) {
+        heap_prune(clock);
+        update_target_stamp(clock);
+    }
 }
 
 struct SchedEvent *pop_event(struct dc_clock *clock) {
-    struct SchedEvent *ev_ret = clock->ev_next_priv;
+    struct SchedEvent *ev_ret = NULL;
+
+    if (clock->heap_len_priv) {
+        ev_ret = clock->heap_priv[0].event;
+        heap_remove_top(clock);
+        heap_prune(clock);
+    }
 
 #ifdef INVARIANTS
     /*
@@ -141,17 +234,8 @@ struct SchedEvent *pop_event(struct dc_clock *clock) {
     }
 #endif
 
-    if (clock->ev_next_priv) {
-        clock->ev_next_priv = clock->ev_next_priv->next_event;
-        if (clock->ev_next_priv)
-            clock->ev_next_priv->pprev_event = &clock->ev_next_priv;
-    }
-
-    // XXX this is unnecessary, but I'm trying to be extra-safe here
-    if (ev_ret) {
-        ev_ret->next_event = NULL;
-        ev_ret->pprev_event = NULL;
-    }
+    if (ev_ret)
+        ev_ret->scheduled = false;
 
     update_target_stamp(clock);
 
@@ -159,7 +243,7 @@ struct SchedEvent *pop_event(struct dc_clock *clock) {
 }
 
 struct SchedEvent *peek_event(struct dc_clock *clock) {
-    return clock->ev_next_priv;
+    return clock->heap_len_priv ? clock->heap_priv[0].event : NULL;
 }
 
 dc_cycle_stamp_t clock_target_stamp(struct dc_clock *clock) {
@@ -183,24 +267,32 @@ static void on_end_of_ts(struct SchedEvent *event) {
 }
 
 bool dc_clock_run_timeslice(struct dc_clock *clk) {
+    PERF_TIMER_BEGIN(PERF_SCHED_TIMESLICE);
+
     /*
      * here we insert the timeslice end as an event, and then check for that
      * event as a special case.  This is a simple approach that leverages
-     * pre-existing infrastructure.  One shortfall of this approach is that it
-     * implicitly overclocks the CPU because the logic used to time events
-     * allows events to happen late (which means that extra CPU cycles are
-     * sometimes executed between events).
+     * pre-existing infrastructure.  Events are allowed to happen late, so the
+     * CPU usually runs a little past the end of the timeslice.
      *
-     * TODO: Ideally, we'd be able to track the extra cycles executed and
-     * subtract them form the next timeslice to avoid this overclock.
+     * To keep that from overclocking the CPU, each timeslice ends
+     * timeslice_len cycles after where the last one was supposed to end
+     * rather than where it actually ended, so the overrun comes out of the
+     * next one.  If the clock isn't within a timeslice of that (eg it just got
+     * loaded from a savestate) then it starts over from here.
      */
+    dc_cycle_stamp_t stamp = clock_cycle_stamp(clk);
+    dc_cycle_stamp_t len = clk->timeslice_len;
 
     // ts marks the end of the timeslice
-    dc_cycle_stamp_t ts = clock_cycle_stamp(clk) + DC_TIMESLICE;
+    dc_cycle_stamp_t ts = clk->ts_end_priv + len;
+    if (ts <= stamp || ts - stamp > len)
+        ts = stamp + len;
 
     struct SchedEvent *ts_end_evt = &clk->timeslice_end_event;
     ts_end_evt->when = ts;
     ts_end_evt->handler = on_end_of_ts;
+    ts_end_evt->name = "on_end_of_ts";
 
     sched_event(clk, ts_end_evt);
 
@@ -211,11 +303,235 @@ bool dc_clock_run_timeslice(struct dc_clock *clk) {
 
     while (!(ret_val = dispatch(dispatch_ctxt))) {
         struct SchedEvent *next_event = pop_event(clk);
-        if (next_event != ts_end_evt)
+        if (next_event != ts_end_evt) {
+            struct trace_span span;
+            trace_begin(&span, next_event->when);
+            enum bench_sect bench_prev = bench_enter(BENCH_SCHED);
             next_event->handler(next_event);
-        else
+            bench_leave(bench_prev);
+            trace_end(&span, clk->trace_track,
+                      next_event->name ? next_event->name : "sched_event",
+                      span.cycle);
+            PERF_COUNT(PERF_SCHED_EVENT);
+        } else {
+            dc_cycle_stamp_t overrun = clock_cycle_stamp(clk) - ts;
+            clk->ts_end_priv = ts;
+            clk->ts_stat.n_slices++;
+            clk->ts_stat.overrun_total += overrun;
+            if (overrun > clk->ts_stat.overrun_max)
+                clk->ts_stat.overrun_max = overrun;
             break;
+        }
     }
 
+    PERF_TIMER_END(PERF_SCHED_TIMESLICE);
     return ret_val;
 }
+
+void dc_clock_set_timeslice(struct dc_clock *clk, dc_cycle_stamp_t len) {
+    if (len < DC_TIMESLICE_MIN)
+        len = DC_TIMESLICE_MIN;
+    else if (len > DC_TIMESLICE_MAX)
+        len = DC_TIMESLICE_MAX;
+    clk->timeslice_len = len;
+}
+
+/*
+ * every event that save-states can refer to, along with the parts of it that
+ * belong to this process and not to the emulated machine.
+ */
+struct sched_event_reg {
+    char const *id;
+    struct SchedEvent *event;
+
+    dc_event_handler_t handler;
+    void *arg_ptr;
+    char const *name;
+};
+
+static struct sched_event_reg *event_reg;
+static unsigned n_event_reg, event_reg_alloc;
+
+void sched_event_register(struct SchedEvent *event, char const *id) {
+    struct sched_event_reg *reg = NULL;
+    unsigned idx;
+
+    for (idx = 0; idx < n_event_reg; idx++) {
+        if (event_reg[idx].event == event) {
+            reg = event_reg + idx;
+        } else if (strcmp(event_reg[idx].id, id) == 0) {
+            error_set_sched_event_id(id);
+            RAISE_ERROR(ERROR_DUPLICATE_DATA);
+        }
+    }
+
+    if (!reg) {
+        if (n_event_reg >= event_reg_alloc) {
+            unsigned new_alloc = event_reg_alloc ? 2 * event_reg_alloc : 32;
+            struct sched_event_reg *new_reg = (struct sched_event_reg*)
+                realloc(event_reg, new_alloc * sizeof(struct sched_event_reg));
+            if (!new_reg)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            event_reg = new_reg;
+            event_reg_alloc = new_alloc;
+        }
+        reg = event_reg + n_event_reg++;
+    }
+
+    reg->id = id;
+    reg->event = event;
+    reg->handler = event->handler;
+    reg->arg_ptr = event->arg_ptr;
+    reg->name = event->name;
+}
+
+void sched_event_registry_cleanup(void) {
+    free(event_reg);
+    event_reg = NULL;
+    n_event_reg = event_reg_alloc = 0;
+}
+
+static struct sched_event_reg const *
+sched_event_reg_find(struct SchedEvent const *event) {
+    unsigned idx;
+    for (idx = 0; idx < n_event_reg; idx++)
+        if (event_reg[idx].event == event)
+            return event_reg + idx;
+    return NULL;
+}
+
+static struct sched_event_reg const *
+sched_event_reg_find_id(char const *id, size_t id_len) {
+    unsigned idx;
+    for (idx = 0; idx < n_event_reg; idx++)
+        if (strlen(event_reg[idx].id) == id_len &&
+            memcmp(event_reg[idx].id, id, id_len) == 0)
+            return event_reg + idx;
+    return NULL;
+}
+
+// each of these is followed by id_len bytes of the event's id
+struct clock_saved_ent {
+    dc_cycle_stamp_t when;
+    uint64_t serial;
+    uint32_t id_len;
+};
+
+void dc_clock_save(struct savestate_buf *buf, void *ctxt) {
+    struct dc_clock *clk = (struct dc_clock*)ctxt;
+    dc_cycle_stamp_t stamp = clock_cycle_stamp(clk);
+    uint32_t n_events = 0;
+    unsigned idx;
+
+    for (idx = 0; idx < clk->heap_len_priv; idx++)
+        if (heap_ent_valid(clk->heap_priv + idx))
+            n_events++;
+
+    savestate_buf_put(buf, &stamp, sizeof(stamp));
+    savestate_buf_put(buf, &clk->serial_priv, sizeof(clk->serial_priv));
+    savestate_buf_put(buf, &n_events, sizeof(n_events));
+
+    for (idx = 0; idx < clk->heap_len_priv; idx++) {
+        struct sched_heap_ent const *ent = clk->heap_priv + idx;
+        if (heap_ent_valid(ent)) {
+            struct sched_event_reg const *reg = sched_event_reg_find(ent->event);
+            if (!reg) {
+                error_set_sched_event_id(ent->event->name ?
+                                         ent->event->name : "unnamed");
+                RAISE_ERROR(ERROR_MISSING_DATA);
+            }
+
+            struct clock_saved_ent saved = {
+                .when = ent->when,
+                .serial = ent->serial,
+                .id_len = strlen(reg->id)
+            };
+            savestate_buf_put(buf, &saved, sizeof(saved));
+            savestate_buf_put(buf, reg->id, saved.id_len);
+        }
+    }
+}
+
+int dc_clock_load(struct savestate_buf *buf, void *ctxt) {
+    struct dc_clock *clk = (struct dc_clock*)ctxt;
+    dc_cycle_stamp_t stamp;
+    uint64_t serial;
+    uint32_t n_events;
+    unsigned idx;
+
+    if (savestate_buf_get(buf, &stamp, sizeof(stamp)) != 0 ||
+        savestate_buf_get(buf, &serial, sizeof(serial)) != 0 ||
+        savestate_buf_get(buf, &n_events, sizeof(n_events)) != 0 ||
+        buf->len - buf->pos < n_events * sizeof(struct clock_saved_ent))
+        return -1;
+
+    /*
+     * device sections that were loaded before this one may have overwritten
+     * whole events, so put back everything that isn't the machine's state.
+     */
+    for (idx = 0; idx < n_event_reg; idx++) {
+        struct sched_event_reg const *reg = event_reg + idx;
+        reg->event->handler = reg->handler;
+        reg->event->arg_ptr = reg->arg_ptr;
+        reg->event->name = reg->name;
+    }
+
+    // unschedule everything which is currently scheduled
+    for (idx = 0; idx < clk->heap_len_priv; idx++)
+        if (heap_ent_valid(clk->heap_priv + idx))
+            clk->heap_priv[idx].event->scheduled = false;
+    clk->heap_len_priv = 0;
+
+    if (n_events > clk->heap_alloc_priv) {
+        struct sched_heap_ent *new_heap = (struct sched_heap_ent*)
+            realloc(clk->heap_priv, n_events * sizeof(struct sched_heap_ent));
+        if (!new_heap)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        clk->heap_priv = new_heap;
+        clk->heap_alloc_priv = n_events;
+    }
+
+    // the serials are restored as well so that ties come out in the same order
+    int err = 0;
+    for (idx = 0; idx < n_events; idx++) {
+        struct clock_saved_ent saved;
+        if (savestate_buf_get(buf, &saved, sizeof(saved)) != 0 ||
+            buf->len - buf->pos < saved.id_len) {
+            err = -1;
+            break;
+        }
+
+        struct sched_event_reg const *reg =
+            sched_event_reg_find_id((char const*)buf->dat + buf->pos,
+                                    saved.id_len);
+        if (!reg) {
+            LOG_ERROR("%s - unknown event \"%.*s\"\n", __func__,
+                      (int)saved.id_len, (char const*)buf->dat + buf->pos);
+            err = -1;
+            break;
+        }
+        buf->pos += saved.id_len;
+
+        struct SchedEvent *event = reg->event;
+        event->when = saved.when;
+        event->sched_serial = saved.serial;
+        event->scheduled = true;
+
+        unsigned heap_idx = clk->heap_len_priv++;
+        clk->heap_priv[heap_idx].when = saved.when;
+        clk->heap_priv[heap_idx].serial = saved.serial;
+        clk->heap_priv[heap_idx].event = event;
+        heap_sift_up(clk, heap_idx);
+    }
+
+    if (!err && buf->pos != buf->len)
+        err = -1;
+
+    clk->serial_priv = serial;
+
+    clk->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] = stamp;
+    clk->ptrs_priv[WASHDC_CLOCK_IDX_COUNTDOWN] = 0;
+    update_target_stamp(clk);
+
+    return err;
+}
@@ -32,9 +32,20 @@
  */
 #define SCHED_FREQUENCY 5400000000
 
+// default timeslice length, and limits on what it can be set to
 #define DC_TIMESLICE (SCHED_FREQUENCY / 400)
+#define DC_TIMESLICE_MIN (SCHED_FREQUENCY / 20000)
+#define DC_TIMESLICE_MAX (SCHED_FREQUENCY / 50)
 
-// simple priority-queue scheduler
+/*
+ * priority-queue scheduler.
+ *
+ * Events are kept in a 4-ary min-heap ordered by when.  Events which are
+ * scheduled for the same time come out in the reverse of the order they were
+ * scheduled in.  cancel_event doesn't remove anything from the heap; it just
+ * marks the event as not being scheduled, and the stale heap entry gets thrown
+ * away once it reaches the top.
+ */
 
 typedef uint64_t dc_cycle_stamp_t;
 
@@ -49,9 +60,19 @@ struct SchedEvent {
 
     void *arg_ptr;
 
-    // linked list, only the scheduler gets to touch these
-    struct SchedEvent **pprev_event;
-    struct SchedEvent *next_event;
+    // shows up in traces (see trace.h), may be NULL
+    char const *name;
+
+    // only the scheduler gets to touch these
+    uint64_t sched_serial;
+    bool scheduled;
+};
+
+// entry in a dc_clock's event heap
+struct sched_heap_ent {
+    dc_cycle_stamp_t when;
+    uint64_t serial;
+    struct SchedEvent *event;
 };
 
 enum washdc_clock_idx {
@@ -69,6 +90,16 @@ enum washdc_clock_idx {
 
 typedef struct SchedEvent SchedEvent;
 
+/*
+ * timeslice accounting.  The overrun is how far past the end of its
+ * timeslice a clock got before it noticed, which gets taken out of the
+ * next timeslice.
+ */
+struct dc_clock_ts_stat {
+    uint64_t n_slices;
+    dc_cycle_stamp_t overrun_total, overrun_max;
+};
+
 /*
  * A clock is an object which contains a timer and a scheduler based off of
  * that timer.  Each CPU will have its own clock, and that clock will be shared
@@ -80,11 +111,25 @@ struct dc_clock {
 
     struct SchedEvent timeslice_end_event;
 
+    // where the last complete timeslice was supposed to end
+    dc_cycle_stamp_t ts_end_priv;
+
+    // length of the next timeslice, DC_TIMESLICE by default
+    dc_cycle_stamp_t timeslice_len;
+    struct dc_clock_ts_stat ts_stat;
+
     dc_cycle_stamp_t priv[WASHDC_CLOCK_IDX_COUNT];
     dc_cycle_stamp_t *ptrs_priv;
 
-    // the next scheduled event
-    struct SchedEvent *ev_next_priv;
+    // event heap
+    struct sched_heap_ent *heap_priv;
+    unsigned heap_len_priv, heap_alloc_priv;
+
+    // incremented every time an event gets scheduled
+    uint64_t serial_priv;
+
+    // enum trace_track which this clock's events go on
+    unsigned trace_track;
 };
 
 void dc_clock_init(struct dc_clock *clk);
@@ -92,6 +137,13 @@ void dc_clock_cleanup(struct dc_clock *clk);
 
 bool dc_clock_run_timeslice(struct dc_clock *clk);
 
+/*
+ * the length gets clamped to DC_TIMESLICE_MIN..DC_TIMESLICE_MAX.  Clocks
+ * which are supposed to stay in step with each other should always be given
+ * the same length.
+ */
+void dc_clock_set_timeslice(struct dc_clock *clk, dc_cycle_stamp_t len);
+
 /*
  * these methods do not free or otherwise take ownership of the event.
  * This way, users can use global or static SchedEvent structs.
@@ -137,4 +189,26 @@ static inline void clock_countdown_sub(struct dc_clock *clock,
 
 void clock_set_ptrs_priv(struct dc_clock *clock, dc_cycle_stamp_t *ptrs);
 
+/*
+ * save-states refer to events by id instead of by pointer so that they can be
+ * restored by a different process.  Every event which can still be scheduled
+ * in between timeslices needs to be registered after its handler and arg_ptr
+ * have been set, and those must not change after that.  Events which are
+ * always scheduled for the current cycle don't need to be.  id must be unique
+ * and stay valid until sched_event_registry_cleanup.  Registering an event a
+ * second time updates it.
+ */
+void sched_event_register(struct SchedEvent *event, char const *id);
+void sched_event_registry_cleanup(void);
+
+/*
+ * save-state sections for a clock (ctxt is the dc_clock).  Loading one puts
+ * every registered event's handler, arg_ptr and name back the way they were
+ * when it was registered, so the clocks need to be loaded after any section
+ * that holds events.  These must not be called in the middle of a timeslice.
+ */
+struct savestate_buf;
+void dc_clock_save(struct savestate_buf *buf, void *ctxt);
+int dc_clock_load(struct savestate_buf *buf, void *ctxt);
+
 #endif
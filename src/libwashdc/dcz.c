@@ -0,0 +1,678 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "mount.h"
+#include "cdrom.h"
+#include "log.h"
+#include "threading.h"
+
+#include "dcz.h"
+
+#define DCZ_HEADER_LEN 32
+#define DCZ_TRACK_LEN 16
+#define DCZ_HUNK_LEN 16
+
+// number of decompressed hunks that are kept around
+#define DCZ_CACHE_HUNKS 16
+
+// number of hunks after the one being read that get decompressed ahead of time
+#define DCZ_PREFETCH_HUNKS 4
+
+// number of threads decompressing prefetched hunks
+#define DCZ_N_WORKERS 2
+
+struct dcz_track {
+    unsigned fad_start;
+    unsigned ctrl;
+    unsigned n_frames;
+
+    // index of the track's first frame among the frames of the whole image
+    unsigned first_frame;
+};
+
+struct dcz_hunk {
+    uint64_t offset;
+    uint32_t comp_len;
+    uint32_t codec;
+};
+
+enum dcz_slot_state {
+    DCZ_SLOT_EMPTY,
+
+    // dat is being filled in by whichever thread claimed the slot
+    DCZ_SLOT_LOADING,
+
+    DCZ_SLOT_READY,
+    DCZ_SLOT_FAILED
+};
+
+struct dcz_slot {
+    enum dcz_slot_state state;
+    unsigned hunk_no;
+    unsigned long long last_use;
+    uint8_t *dat;
+};
+
+struct dcz_mount {
+    washdc_hostfile stream;
+
+    unsigned n_tracks;
+    struct dcz_track *tracks;
+
+    unsigned hunk_frames, n_hunks, n_frames;
+    struct dcz_hunk *hunks;
+
+    // index of the track that satisfied the last read
+    unsigned last_track;
+
+    /*
+     * serializes access to stream between the worker threads and the caller
+     * when the frontend can't do positional reads
+     */
+    washdc_mutex stream_lock;
+
+    // everything below here is protected by lock
+    washdc_mutex lock;
+    washdc_cvar work_cvar, done_cvar;
+    washdc_thread workers[DCZ_N_WORKERS];
+    bool quit;
+
+    struct dcz_slot slots[DCZ_CACHE_HUNKS];
+    unsigned long long use_count;
+
+    // slots which are waiting for a worker to fill them, oldest first
+    unsigned queue[DCZ_CACHE_HUNKS];
+    unsigned queue_len;
+};
+
+static void mount_dcz_cleanup(struct mount *mount);
+static unsigned mount_dcz_session_count(struct mount *mount);
+static int mount_dcz_read_toc(struct mount *mount, struct mount_toc *toc,
+                              unsigned region);
+static int mount_dcz_read_sector(struct mount *mount, void *buf, unsigned fad);
+static int mount_dcz_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned sector_count);
+static int mount_dcz_read_raw_sectors(struct mount *mount, void *buf,
+                                      unsigned fad, unsigned sector_count);
+static int mount_dcz_get_meta(struct mount *mount, struct mount_meta *meta);
+static unsigned mount_dcz_get_leadout(struct mount *mount);
+static bool mount_dcz_has_hd_region(struct mount *mount);
+static enum mount_disc_type mount_dcz_get_disc_type(struct mount *mount);
+static void mount_dcz_get_session_start(struct mount *mount,
+                                        unsigned session_no,
+                                        unsigned *start_track, unsigned *fad);
+
+static void dcz_parse(struct dcz_mount *mount, char const *path);
+static int dcz_find_track(struct dcz_mount *mount, unsigned fad);
+static int dcz_read_frame(struct dcz_mount *mount, unsigned frame_no,
+                          void *outp, unsigned offset, unsigned len);
+static int dcz_hunk_fill(struct dcz_mount *mount, unsigned hunk_no,
+                         uint8_t *dat);
+static int dcz_slot_find(struct dcz_mount *mount, unsigned hunk_no);
+static int dcz_slot_claim(struct dcz_mount *mount, unsigned hunk_no);
+static void dcz_prefetch(struct dcz_mount *mount, unsigned hunk_no);
+static void dcz_worker_main(void *argp);
+
+static struct mount_ops dcz_mount_ops = {
+    .session_count = mount_dcz_session_count,
+    .read_toc = mount_dcz_read_toc,
+    .read_sector = mount_dcz_read_sector,
+    .read_sectors = mount_dcz_read_sectors,
+    .read_raw_sectors = mount_dcz_read_raw_sectors,
+    .cleanup = mount_dcz_cleanup,
+    .get_meta = mount_dcz_get_meta,
+    .get_leadout = mount_dcz_get_leadout,
+    .has_hd_region = mount_dcz_has_hd_region,
+    .get_disc_type = mount_dcz_get_disc_type,
+    .get_session_start = mount_dcz_get_session_start
+};
+
+static uint32_t dcz_get_u32(uint8_t const *src) {
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+        ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+static uint64_t dcz_get_u64(uint8_t const *src) {
+    return (uint64_t)dcz_get_u32(src) | ((uint64_t)dcz_get_u32(src + 4) << 32);
+}
+
+void mount_dcz(char const *path) {
+    struct dcz_mount *mount =
+        (struct dcz_mount*)calloc(1, sizeof(struct dcz_mount));
+
+    if (!mount)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    mount->stream = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                         WASHDC_HOSTFILE_BINARY);
+    if (!mount->stream) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    dcz_parse(mount, path);
+
+    LOG_INFO("about to (attempt to) mount the following image:\n");
+    LOG_INFO("%u tracks in %u hunks of %u frames\n",
+             mount->n_tracks, mount->n_hunks, mount->hunk_frames);
+    unsigned track_no;
+    for (track_no = 0; track_no < mount->n_tracks; track_no++) {
+        struct dcz_track const *trackp = mount->tracks + track_no;
+        LOG_INFO("%u %u %u %u\n", track_no + 1,
+                 cdrom_fad_to_lba(trackp->fad_start), trackp->ctrl,
+                 trackp->n_frames);
+    }
+
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < DCZ_CACHE_HUNKS; slot_no++) {
+        mount->slots[slot_no].dat =
+            (uint8_t*)malloc((size_t)mount->hunk_frames * CDROM_FRAME_SIZE);
+        if (!mount->slots[slot_no].dat)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        mount->slots[slot_no].state = DCZ_SLOT_EMPTY;
+    }
+
+    washdc_mutex_init(&mount->stream_lock);
+    washdc_mutex_init(&mount->lock);
+    washdc_cvar_init(&mount->work_cvar);
+    washdc_cvar_init(&mount->done_cvar);
+
+    unsigned worker_no;
+    for (worker_no = 0; worker_no < DCZ_N_WORKERS; worker_no++) {
+        washdc_thread_create(mount->workers + worker_no,
+                             dcz_worker_main, mount);
+    }
+
+    mount_insert(&dcz_mount_ops, mount);
+}
+
+static void dcz_parse(struct dcz_mount *mount, char const *path) {
+    uint8_t header[DCZ_HEADER_LEN];
+
+    if (washdc_hostfile_read(mount->stream, header, sizeof(header)) !=
+        sizeof(header) || memcmp(header, "WASHDCZ", 8) != 0 ||
+        dcz_get_u32(header + 8) != DCZ_VERSION) {
+        error_set_file_path(path);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    mount->n_tracks = dcz_get_u32(header + 12);
+    mount->hunk_frames = dcz_get_u32(header + 16);
+    mount->n_hunks = dcz_get_u32(header + 20);
+
+    // like a .gdi, there need to be at least three tracks for a GD-ROM
+    if (mount->n_tracks < 3 || mount->n_tracks > 99 || !mount->hunk_frames) {
+        error_set_file_path(path);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    size_t table_len = (size_t)mount->n_tracks * DCZ_TRACK_LEN;
+    size_t index_len = (size_t)mount->n_hunks * DCZ_HUNK_LEN;
+    uint8_t *tables = (uint8_t*)malloc(table_len + index_len);
+    mount->tracks = (struct dcz_track*)calloc(mount->n_tracks,
+                                              sizeof(struct dcz_track));
+    mount->hunks = (struct dcz_hunk*)calloc(mount->n_hunks ? mount->n_hunks : 1,
+                                            sizeof(struct dcz_hunk));
+    if (!tables || !mount->tracks || !mount->hunks)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    if (washdc_hostfile_read(mount->stream, tables, table_len + index_len) !=
+        table_len + index_len) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    unsigned track_no;
+    unsigned n_frames = 0;
+    for (track_no = 0; track_no < mount->n_tracks; track_no++) {
+        uint8_t const *src = tables + track_no * DCZ_TRACK_LEN;
+        struct dcz_track *trackp = mount->tracks + track_no;
+        trackp->fad_start = dcz_get_u32(src);
+        trackp->ctrl = dcz_get_u32(src + 4);
+        trackp->n_frames = dcz_get_u32(src + 8);
+        trackp->first_frame = n_frames;
+        n_frames += trackp->n_frames;
+    }
+    mount->n_frames = n_frames;
+
+    unsigned hunk_no;
+    for (hunk_no = 0; hunk_no < mount->n_hunks; hunk_no++) {
+        uint8_t const *src = tables + table_len + hunk_no * DCZ_HUNK_LEN;
+        struct dcz_hunk *hunkp = mount->hunks + hunk_no;
+        hunkp->offset = dcz_get_u64(src);
+        hunkp->comp_len = dcz_get_u32(src + 8);
+        hunkp->codec = dcz_get_u32(src + 12);
+    }
+
+    free(tables);
+
+    if (mount->n_hunks !=
+        (n_frames + mount->hunk_frames - 1) / mount->hunk_frames) {
+        error_set_file_path(path);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+}
+
+static void mount_dcz_cleanup(struct mount *mount) {
+    struct dcz_mount *state = (struct dcz_mount*)mount->state;
+
+    washdc_mutex_lock(&state->lock);
+    state->quit = true;
+    washdc_cvar_broadcast(&state->work_cvar);
+    washdc_mutex_unlock(&state->lock);
+
+    unsigned worker_no;
+    for (worker_no = 0; worker_no < DCZ_N_WORKERS; worker_no++)
+        washdc_thread_join(state->workers + worker_no);
+
+    washdc_cvar_cleanup(&state->done_cvar);
+    washdc_cvar_cleanup(&state->work_cvar);
+    washdc_mutex_cleanup(&state->lock);
+    washdc_mutex_cleanup(&state->stream_lock);
+
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < DCZ_CACHE_HUNKS; slot_no++)
+        free(state->slots[slot_no].dat);
+
+    washdc_hostfile_close(state->stream);
+    free(state->hunks);
+    free(state->tracks);
+    free(state);
+}
+
+static unsigned mount_dcz_session_count(struct mount *mount) {
+    return 1;
+}
+
+static enum mount_disc_type mount_dcz_get_disc_type(struct mount *mount) {
+    return DISC_TYPE_GDROM;
+}
+
+static bool mount_dcz_has_hd_region(struct mount *mount) {
+    return true;
+}
+
+static int mount_dcz_read_toc(struct mount *mount, struct mount_toc *toc,
+                              unsigned region) {
+    struct dcz_mount const *dcz_mount = (struct dcz_mount const*)mount->state;
+
+    memset(toc->tracks, 0, sizeof(toc->tracks));
+
+    // same layout as a .gdi: the first two tracks are the LD region
+    if (region == MOUNT_LD_REGION) {
+        toc->first_track = 1;
+        toc->last_track = 2;
+    } else {
+        toc->first_track = 3;
+        toc->last_track = dcz_mount->n_tracks;
+    }
+
+    unsigned track_no;
+    for (track_no = toc->first_track; track_no <= toc->last_track; track_no++) {
+        struct dcz_track const *trackp = dcz_mount->tracks + (track_no - 1);
+        toc->tracks[track_no - 1].fad = trackp->fad_start;
+        toc->tracks[track_no - 1].adr = 1;
+        toc->tracks[track_no - 1].ctrl = trackp->ctrl;
+        toc->tracks[track_no - 1].valid = true;
+    }
+
+    struct dcz_track const *last = dcz_mount->tracks + (toc->last_track - 1);
+    toc->leadout = last->fad_start + last->n_frames;
+    toc->leadout_adr = 1;
+
+    return 0;
+}
+
+static unsigned mount_dcz_get_leadout(struct mount *mount) {
+    struct dcz_mount const *dcz_mount = (struct dcz_mount const*)mount->state;
+    struct dcz_track const *last = dcz_mount->tracks + (dcz_mount->n_tracks - 1);
+
+    return last->n_frames + cdrom_fad_to_lba(last->fad_start);
+}
+
+static void mount_dcz_get_session_start(struct mount *mount,
+                                        unsigned session_no,
+                                        unsigned *start_track, unsigned *fad) {
+    if (session_no != 0)
+        RAISE_ERROR(ERROR_INTEGRITY);// there's only one session on a GD-ROM
+
+    struct dcz_mount const *dcz_mount = (struct dcz_mount const*)mount->state;
+
+    *start_track = 0;
+    *fad = dcz_mount->tracks[0].fad_start;
+}
+
+static int dcz_find_track(struct dcz_mount *mount, unsigned fad) {
+    // consecutive reads nearly always land in the same track
+    struct dcz_track const *trackp = mount->tracks + mount->last_track;
+    if (fad >= trackp->fad_start && fad < trackp->fad_start + trackp->n_frames)
+        return mount->last_track;
+
+    unsigned track_idx;
+    for (track_idx = 0; track_idx < mount->n_tracks; track_idx++) {
+        trackp = mount->tracks + track_idx;
+        if (fad >= trackp->fad_start &&
+            fad < trackp->fad_start + trackp->n_frames) {
+            mount->last_track = track_idx;
+            return track_idx;
+        }
+    }
+
+    return -1;
+}
+
+static int mount_dcz_read_sector(struct mount *mount, void *buf, unsigned fad) {
+    return mount_dcz_read_sectors(mount, buf, fad, 1);
+}
+
+static int mount_dcz_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned sector_count) {
+    struct dcz_mount *dcz_mount = (struct dcz_mount*)mount->state;
+    uint8_t *outp = (uint8_t*)buf;
+
+    // TODO: support MODE2 FORM1, MODE2 FORM2, CDDA, etc...
+    while (sector_count--) {
+        int track_idx = dcz_find_track(dcz_mount, fad);
+        if (track_idx < 0)
+            return -1;
+        struct dcz_track const *trackp = dcz_mount->tracks + track_idx;
+        unsigned frame_no = trackp->first_frame + (fad - trackp->fad_start);
+
+        if (dcz_read_frame(dcz_mount, frame_no, outp,
+                           CDROM_MODE1_DATA_OFFSET, CDROM_FRAME_DATA_SIZE) != 0)
+            return -1;
+
+        outp += CDROM_FRAME_DATA_SIZE;
+        fad++;
+    }
+
+    return 0;
+}
+
+static int mount_dcz_read_raw_sectors(struct mount *mount, void *buf,
+                                      unsigned fad, unsigned sector_count) {
+    struct dcz_mount *dcz_mount = (struct dcz_mount*)mount->state;
+    uint8_t *outp = (uint8_t*)buf;
+
+    while (sector_count--) {
+        int track_idx = dcz_find_track(dcz_mount, fad);
+        if (track_idx < 0)
+            return -1;
+        struct dcz_track const *trackp = dcz_mount->tracks + track_idx;
+        unsigned frame_no = trackp->first_frame + (fad - trackp->fad_start);
+
+        if (dcz_read_frame(dcz_mount, frame_no, outp, 0, CDROM_FRAME_SIZE) != 0)
+            return -1;
+
+        outp += CDROM_FRAME_SIZE;
+        fad++;
+    }
+
+    return 0;
+}
+
+static int mount_dcz_get_meta(struct mount *mount, struct mount_meta *meta) {
+    struct dcz_mount *dcz_mount = (struct dcz_mount*)mount->state;
+    uint8_t buffer[256];
+
+    // the metadata is at the beginning of the first high-density track
+    struct dcz_track const *trackp = dcz_mount->tracks + 2;
+    if (!trackp->n_frames ||
+        dcz_read_frame(dcz_mount, trackp->first_frame, buffer,
+                       CDROM_MODE1_DATA_OFFSET, sizeof(buffer)) != 0)
+        return -1;
+
+    memset(meta, 0, sizeof(*meta));
+
+    memcpy(meta->hardware, buffer, MOUNT_META_HARDWARE_LEN);
+    memcpy(meta->maker, buffer + 16, MOUNT_META_MAKER_LEN);
+    memcpy(meta->dev_info, buffer + 32, MOUNT_META_DEV_INFO_LEN);
+    memcpy(meta->region, buffer + 48, MOUNT_META_REGION_LEN);
+    memcpy(meta->periph_support, buffer + 56, MOUNT_META_PERIPH_LEN);
+    memcpy(meta->product_id, buffer + 64, MOUNT_META_PRODUCT_ID_LEN);
+    memcpy(meta->product_version, buffer + 74, MOUNT_META_PRODUCT_VERSION_LEN);
+    memcpy(meta->rel_date, buffer + 80, MOUNT_META_REL_DATE_LEN);
+    memcpy(meta->boot_file, buffer + 96, MOUNT_META_BOOT_FILE_LEN);
+    memcpy(meta->company, buffer + 112, MOUNT_META_COMPANY_LEN);
+    memcpy(meta->title, buffer + 128, MOUNT_META_TITLE_LEN);
+
+    return 0;
+}
+
+/*
+ * copy len bytes starting at offset within the given frame.  If the frame's
+ * hunk isn't already decompressed (or being decompressed by a worker) then
+ * this decompresses it on the calling thread.
+ */
+static int dcz_read_frame(struct dcz_mount *mount, unsigned frame_no,
+                          void *outp, unsigned offset, unsigned len) {
+    if (frame_no >= mount->n_frames)
+        return -1;
+
+    unsigned hunk_no = frame_no / mount->hunk_frames;
+    int ret = 0;
+
+    washdc_mutex_lock(&mount->lock);
+
+    for (;;) {
+        int slot_no = dcz_slot_find(mount, hunk_no);
+
+        if (slot_no < 0) {
+            slot_no = dcz_slot_claim(mount, hunk_no);
+            if (slot_no < 0) {
+                // every slot is busy, wait for a worker to finish one
+                washdc_cvar_wait(&mount->done_cvar, &mount->lock);
+                continue;
+            }
+
+            struct dcz_slot *slot = mount->slots + slot_no;
+            washdc_mutex_unlock(&mount->lock);
+            int err = dcz_hunk_fill(mount, hunk_no, slot->dat);
+            washdc_mutex_lock(&mount->lock);
+            slot->state = err ? DCZ_SLOT_FAILED : DCZ_SLOT_READY;
+            washdc_cvar_broadcast(&mount->done_cvar);
+            continue;
+        }
+
+        struct dcz_slot *slot = mount->slots + slot_no;
+        if (slot->state == DCZ_SLOT_LOADING) {
+            washdc_cvar_wait(&mount->done_cvar, &mount->lock);
+            continue;
+        }
+
+        if (slot->state == DCZ_SLOT_FAILED) {
+            // forget about it so that the next attempt tries again
+            slot->state = DCZ_SLOT_EMPTY;
+            ret = -1;
+            break;
+        }
+
+        slot->last_use = ++mount->use_count;
+        memcpy(outp, slot->dat +
+               (size_t)(frame_no - hunk_no * mount->hunk_frames) *
+               CDROM_FRAME_SIZE + offset, len);
+        break;
+    }
+
+    if (ret == 0) {
+        unsigned prefetch_no;
+        for (prefetch_no = 1; prefetch_no <= DCZ_PREFETCH_HUNKS; prefetch_no++)
+            dcz_prefetch(mount, hunk_no + prefetch_no);
+    }
+
+    washdc_mutex_unlock(&mount->lock);
+
+    return ret;
+}
+
+// mount->lock must be held
+static int dcz_slot_find(struct dcz_mount *mount, unsigned hunk_no) {
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < DCZ_CACHE_HUNKS; slot_no++) {
+        struct dcz_slot const *slot = mount->slots + slot_no;
+        if (slot->state != DCZ_SLOT_EMPTY && slot->hunk_no == hunk_no)
+            return slot_no;
+    }
+    return -1;
+}
+
+/*
+ * evict the least-recently used slot which isn't being filled and mark it as
+ * loading the given hunk.  Returns -1 if every slot is being filled.
+ * mount->lock must be held.
+ */
+static int dcz_slot_claim(struct dcz_mount *mount, unsigned hunk_no) {
+    int best = -1;
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < DCZ_CACHE_HUNKS; slot_no++) {
+        struct dcz_slot const *slot = mount->slots + slot_no;
+        if (slot->state == DCZ_SLOT_LOADING)
+            continue;
+        if (slot->state == DCZ_SLOT_EMPTY) {
+            best = slot_no;
+            break;
+        }
+        if (best < 0 || slot->last_use < mount->slots[best].last_use)
+            best = slot_no;
+    }
+
+    if (best >= 0) {
+        mount->slots[best].state = DCZ_SLOT_LOADING;
+        mount->slots[best].hunk_no = hunk_no;
+        mount->slots[best].last_use = ++mount->use_count;
+    }
+
+    return best;
+}
+
+// hand the given hunk to the workers if it isn't already cached.
+static void dcz_prefetch(struct dcz_mount *mount, unsigned hunk_no) {
+    if (hunk_no >= mount->n_hunks || dcz_slot_find(mount, hunk_no) >= 0)
+        return;
+
+    int slot_no = dcz_slot_claim(mount, hunk_no);
+    if (slot_no < 0)
+        return;
+
+    mount->queue[mount->queue_len++] = slot_no;
+    washdc_cvar_signal(&mount->work_cvar);
+}
+
+static void dcz_worker_main(void *argp) {
+    struct dcz_mount *mount = (struct dcz_mount*)argp;
+
+    washdc_mutex_lock(&mount->lock);
+    for (;;) {
+        while (!mount->queue_len && !mount->quit)
+            washdc_cvar_wait(&mount->work_cvar, &mount->lock);
+        if (mount->quit)
+            break;
+
+        unsigned slot_no = mount->queue[0];
+        memmove(mount->queue, mount->queue + 1,
+                --mount->queue_len * sizeof(mount->queue[0]));
+
+        struct dcz_slot *slot = mount->slots + slot_no;
+        unsigned hunk_no = slot->hunk_no;
+
+        washdc_mutex_unlock(&mount->lock);
+        int err = dcz_hunk_fill(mount, hunk_no, slot->dat);
+        if (err)
+            LOG_WARN("%s - failed to prefetch hunk %u\n", __func__, hunk_no);
+        washdc_mutex_lock(&mount->lock);
+
+        slot->state = err ? DCZ_SLOT_FAILED : DCZ_SLOT_READY;
+        washdc_cvar_broadcast(&mount->done_cvar);
+    }
+    washdc_mutex_unlock(&mount->lock);
+}
+
+// read and decompress the given hunk into dat.  This is called without lock.
+static int dcz_hunk_fill(struct dcz_mount *mount, unsigned hunk_no,
+                         uint8_t *dat) {
+    struct dcz_hunk const *hunkp = mount->hunks + hunk_no;
+    unsigned n_frames = mount->n_frames - hunk_no * mount->hunk_frames;
+    if (n_frames > mount->hunk_frames)
+        n_frames = mount->hunk_frames;
+    size_t n_bytes = (size_t)n_frames * CDROM_FRAME_SIZE;
+
+    if (hunkp->codec != DCZ_CODEC_NONE && hunkp->codec != DCZ_CODEC_DEFLATE) {
+        LOG_ERROR("hunk %u has unknown codec %u\n",
+                  hunk_no, (unsigned)hunkp->codec);
+        return -1;
+    }
+
+    if (hunkp->codec == DCZ_CODEC_NONE && hunkp->comp_len != n_bytes) {
+        LOG_ERROR("uncompressed hunk %u has length %u, expected %llu\n",
+                  hunk_no, (unsigned)hunkp->comp_len,
+                  (unsigned long long)n_bytes);
+        return -1;
+    }
+
+    uint8_t *comp = dat;
+    if (hunkp->codec != DCZ_CODEC_NONE) {
+        comp = (uint8_t*)malloc(hunkp->comp_len);
+        if (!comp)
+            return -1;
+    }
+
+    bool serialize = !washdc_hostfile_has_pread();
+    if (serialize)
+        washdc_mutex_lock(&mount->stream_lock);
+    size_t bytes_read = washdc_hostfile_pread(mount->stream, comp,
+                                              hunkp->comp_len,
+                                              (long)hunkp->offset);
+    if (serialize)
+        washdc_mutex_unlock(&mount->stream_lock);
+
+    int ret = 0;
+    if (bytes_read != hunkp->comp_len) {
+        LOG_ERROR("failure to read hunk %u (%u bytes at offset %llu)\n",
+                  hunk_no, (unsigned)hunkp->comp_len,
+                  (unsigned long long)hunkp->offset);
+        ret = -1;
+    } else if (hunkp->codec == DCZ_CODEC_DEFLATE) {
+        uLongf dst_len = n_bytes;
+        if (uncompress(dat, &dst_len, comp, hunkp->comp_len) != Z_OK ||
+            dst_len != n_bytes) {
+            LOG_ERROR("failure to decompress hunk %u\n", hunk_no);
+            ret = -1;
+        }
+    }
+
+    if (comp != dat)
+        free(comp);
+
+    return ret;
+}
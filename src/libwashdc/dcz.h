@@ -0,0 +1,64 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef DCZ_H_
+#define DCZ_H_
+
+/*
+ * dcz.h
+ *
+ * hunk-compressed GD-ROM images.  The raw 2352-byte frames of every track are
+ * concatenated and split into hunks of hunk_frames frames each, and every hunk
+ * is compressed on its own so that it can be decompressed independently of
+ * the others.  All integers are little-endian.
+ *
+ * header (32 bytes):
+ *     char magic[8]         "WASHDCZ\0"
+ *     uint32_t version      DCZ_VERSION
+ *     uint32_t n_tracks
+ *     uint32_t hunk_frames  number of frames in each hunk (the last hunk may
+ *                           be shorter)
+ *     uint32_t n_hunks
+ *     uint32_t reserved[2]
+ *
+ * track table, n_tracks entries of 16 bytes each:
+ *     uint32_t fad_start
+ *     uint32_t ctrl
+ *     uint32_t n_frames
+ *     uint32_t reserved
+ *
+ * hunk index, n_hunks entries of 16 bytes each:
+ *     uint64_t offset       byte offset of the hunk's data within the file
+ *     uint32_t comp_len     length of the hunk's data within the file
+ *     uint32_t codec        DCZ_CODEC_NONE or DCZ_CODEC_DEFLATE
+ *
+ * tool/gdi_to_dcz.py converts .gdi images to this format.
+ */
+
+#define DCZ_VERSION 1
+
+#define DCZ_CODEC_NONE 0
+#define DCZ_CODEC_DEFLATE 1
+
+void mount_dcz(char const *path);
+
+#endif
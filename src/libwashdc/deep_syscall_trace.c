@@ -20,11 +20,17 @@
  *
  ******************************************************************************/
 
+
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include "log.h"
+#include "memory.h"
+#include "threading.h"
+#include "atomics.h"
+#include "washdc/hostfile.h"
 #include "hw/sh4/sh4.h"
 #include "dreamcast.h"
 
@@ -46,350 +52,485 @@
 
 #include "deep_syscall_trace.h"
 
-static uint32_t ret_addr;
+#define GDROM_SYSCALL_STATE_ADDR (0x8c0012e8 + 20)
+#define GDROM_CMD_N_PARAMS_ADDR (0x8c0012e8 + 0x4e8)
+
+// PCs are always even, so this never matches
+#define NO_RET_ADDR 1
+
+/*
+ * deep_syscall_notify_jump reads the vector out of this until
+ * deep_syscall_trace_init points it at system RAM.
+ */
+static uint8_t const no_ram[DEEP_SYSCALL_VECTOR_OFFS + 4];
+
+uint8_t const *deep_syscall_ram = no_ram;
+addr32_t deep_syscall_ret_addr = NO_RET_ADDR;
+
+/*
+ * single-producer, single-consumer ring.  The emulation thread is the only
+ * thing that advances ring_head and the writer thread is the only thing that
+ * advances ring_tail.  Positions are free-running and only ever compared by
+ * their difference (see log.c).
+ */
+#define DEEP_SYSCALL_RING_SHIFT 12
+#define DEEP_SYSCALL_RING_LEN (1 << DEEP_SYSCALL_RING_SHIFT)
+#define DEEP_SYSCALL_RING_MASK (DEEP_SYSCALL_RING_LEN - 1)
+
+static struct deep_syscall_rec ring[DEEP_SYSCALL_RING_LEN];
+static washdc_atomic_int ring_head, ring_tail;
+
+// set by the writer thread while it's waiting for something to do
+static washdc_atomic_int writer_idle;
+
+// only touched by the emulation thread
+static unsigned n_dropped;
+
+static washdc_hostfile trace_file;
+static bool writer_running;
+static washdc_thread writer_thread;
+static washdc_mutex writer_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar writer_cvar = WASHDC_CVAR_STATIC_INIT;
+
+// protected by writer_lock
+static bool writer_quit;
+
+// the last few records the writer thread wrote out, for washdbg
+#define DEEP_SYSCALL_HISTORY_LEN 64
+static struct deep_syscall_rec history[DEEP_SYSCALL_HISTORY_LEN];
+static unsigned history_next, history_len;
+static washdc_mutex history_lock = WASHDC_MUTEX_STATIC_INIT;
+
+// the system call in progress, only touched by the emulation thread
+static struct deep_syscall_rec cur_call;
+static uint32_t cur_out_addr;
 static bool in_syscall;
 
-static struct memory_map *mem_map;
+static void writer_main(void *argp);
 
-void deep_syscall_trace_init(struct memory_map *map) {
-    mem_map = map;
+static inline int pos_add(int pos, int n) {
+    return (int)((unsigned)pos + (unsigned)n);
+}
+
+static inline int pos_diff(int lhs, int rhs) {
+    return (int)((unsigned)lhs - (unsigned)rhs);
+}
+
+void deep_syscall_trace_init(struct Memory *ram) {
+    deep_syscall_ram = ram->mem;
+    deep_syscall_ret_addr = NO_RET_ADDR;
+    in_syscall = false;
+    n_dropped = 0;
+    history_next = history_len = 0;
+
+    washdc_atomic_int_init(&ring_head, 0);
+    washdc_atomic_int_init(&ring_tail, 0);
+    washdc_atomic_int_init(&writer_idle, 0);
+
+    trace_file = washdc_hostfile_open(DEEP_SYSCALL_TRACE_PATH,
+                                      WASHDC_HOSTFILE_WRITE |
+                                      WASHDC_HOSTFILE_BINARY);
+    if (trace_file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open %s\n", DEEP_SYSCALL_TRACE_PATH);
+    } else {
+        struct deep_syscall_file_hdr hdr = {
+            .magic = DEEP_SYSCALL_FILE_MAGIC,
+            .version = DEEP_SYSCALL_FILE_VERSION,
+            .rec_len = sizeof(struct deep_syscall_rec)
+        };
+        washdc_hostfile_write(trace_file, &hdr, sizeof(hdr));
+    }
+
+    writer_quit = false;
+    writer_running = true;
+    washdc_thread_create(&writer_thread, writer_main, NULL);
 }
 
 void deep_syscall_trace_cleanup(void) {
+    if (writer_running) {
+        washdc_mutex_lock(&writer_lock);
+        writer_quit = true;
+        washdc_cvar_signal(&writer_cvar);
+        washdc_mutex_unlock(&writer_lock);
+
+        washdc_thread_join(&writer_thread);
+        writer_running = false;
+    }
+
+    if (n_dropped)
+        LOG_WARN("%u system call trace records dropped\n", n_dropped);
+
+    if (trace_file != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(trace_file);
+    trace_file = WASHDC_HOSTFILE_INVALID;
+    deep_syscall_ram = no_ram;
+}
+
+static void push_rec(struct deep_syscall_rec const *rec) {
+    int head = washdc_atomic_int_load_relaxed(&ring_head);
+    int tail = washdc_atomic_int_load_acquire(&ring_tail);
+    if (pos_diff(head, tail) >= DEEP_SYSCALL_RING_LEN) {
+        n_dropped++;
+        return;
+    }
+
+    ring[head & DEEP_SYSCALL_RING_MASK] = *rec;
+    washdc_atomic_int_store(&ring_head, pos_add(head, 1));
+
+    if (washdc_atomic_int_load(&writer_idle)) {
+        washdc_mutex_lock(&writer_lock);
+        washdc_cvar_signal(&writer_cvar);
+        washdc_mutex_unlock(&writer_lock);
+    }
+}
+
+static bool ring_empty(void) {
+    return washdc_atomic_int_load(&ring_head) ==
+        washdc_atomic_int_load(&ring_tail);
+}
+
+static void history_add(struct deep_syscall_rec const *recs, unsigned n_recs) {
+    washdc_mutex_lock(&history_lock);
+    while (n_recs--) {
+        history[history_next] = *recs++;
+        history_next = (history_next + 1) % DEEP_SYSCALL_HISTORY_LEN;
+        if (history_len < DEEP_SYSCALL_HISTORY_LEN)
+            history_len++;
+    }
+    washdc_mutex_unlock(&history_lock);
 }
 
-static uint32_t syscall_gdrom_vector(void) {
-    if (!mem_map) {
-        LOG_ERROR("You forgot to call deep_syscall_trace_init, dumbass!\n");
-        return 0x8c001000; // this is the default value
+static void writer_main(void *argp) {
+    for (;;) {
+        int tail = washdc_atomic_int_load_relaxed(&ring_tail);
+        int head = washdc_atomic_int_load_acquire(&ring_head);
+        while (tail != head) {
+            // write out everything up to head or the end of the ring
+            unsigned first = tail & DEEP_SYSCALL_RING_MASK;
+            unsigned n_recs = pos_diff(head, tail);
+            if (n_recs > DEEP_SYSCALL_RING_LEN - first)
+                n_recs = DEEP_SYSCALL_RING_LEN - first;
+
+            if (trace_file != WASHDC_HOSTFILE_INVALID) {
+                washdc_hostfile_write(trace_file, ring + first,
+                                      n_recs * sizeof(ring[0]));
+            }
+            history_add(ring + first, n_recs);
+
+            tail = pos_add(tail, n_recs);
+            washdc_atomic_int_store_release(&ring_tail, tail);
+            head = washdc_atomic_int_load_acquire(&ring_head);
+        }
+
+        washdc_mutex_lock(&writer_lock);
+        washdc_atomic_int_store(&writer_idle, 1);
+        while (ring_empty() && !writer_quit)
+            washdc_cvar_wait(&writer_cvar, &writer_lock);
+        washdc_atomic_int_store(&writer_idle, 0);
+        bool done = writer_quit && ring_empty();
+        washdc_mutex_unlock(&writer_lock);
+
+        if (done)
+            break;
+    }
+
+    if (trace_file != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_flush(trace_file);
+}
+
+unsigned deep_syscall_trace_recent(struct deep_syscall_rec *out,
+                                   unsigned max) {
+    washdc_mutex_lock(&history_lock);
+    unsigned n_recs = history_len < max ? history_len : max;
+    unsigned idx;
+    for (idx = 0; idx < n_recs; idx++) {
+        unsigned src = (history_next + DEEP_SYSCALL_HISTORY_LEN -
+                        n_recs + idx) % DEEP_SYSCALL_HISTORY_LEN;
+        out[idx] = history[src];
+    }
+    washdc_mutex_unlock(&history_lock);
+    return n_recs;
+}
+
+// read n_words consecutive words out of guest memory into rec->extra
+static void read_extra(struct deep_syscall_rec *rec, uint32_t addr,
+                       unsigned n_words) {
+    unsigned idx;
+    for (idx = 0; idx < n_words; idx++) {
+        if (dc_try_read32(addr + idx * 4, rec->extra + idx) != 0) {
+            rec->flags |= DEEP_SYSCALL_FLAG_READ_FAIL;
+            break;
+        }
+    }
+    rec->n_extra = idx;
+}
+
+/*
+ * what goes into extra:
+ *     GDROM_SEND_COMMAND entry - the first four parameters
+ *     GDROM_DMA_BEGIN entry - the destination and length
+ *     GDROM_CHECK_COMMAND return - the four status words
+ *     GDROM_CHECK_DRIVE return - the drive status and disc format
+ *     GDROM_DMA_CHECK return - the number of bytes transferred
+ */
+static void syscall_enter(Sh4 *sh4, addr32_t pc) {
+    struct deep_syscall_rec *rec = &cur_call;
+    memset(rec, 0, sizeof(*rec));
+
+    rec->tp = DEEP_SYSCALL_REC_ENTER;
+    rec->stamp = sh4_get_cycles(sh4);
+    rec->pc = pc;
+    rec->pr = sh4->reg[SH4_REG_PR];
+    rec->r4 = *sh4_gen_reg(sh4, 4);
+    rec->r5 = *sh4_gen_reg(sh4, 5);
+    rec->r6 = *sh4_gen_reg(sh4, 6);
+    rec->r7 = *sh4_gen_reg(sh4, 7);
+    if (in_syscall)
+        rec->flags |= DEEP_SYSCALL_FLAG_RECURSIVE;
+    if (dc_try_read32(GDROM_SYSCALL_STATE_ADDR, &rec->gdrom_state) != 0)
+        rec->flags |= DEEP_SYSCALL_FLAG_READ_FAIL;
+
+    cur_out_addr = 0;
+    if (rec->r6 == 0) {
+        uint32_t n_params;
+        switch (rec->r7) {
+        case 0:
+            // GDROM_SEND_COMMAND
+            if (dc_try_read32(GDROM_CMD_N_PARAMS_ADDR + rec->r4 * 4,
+                              &n_params) == 0) {
+                read_extra(rec, rec->r5, n_params < 4 ? n_params : 4);
+            } else {
+                rec->flags |= DEEP_SYSCALL_FLAG_READ_FAIL;
+            }
+            break;
+        case 1:
+            // GDROM_CHECK_COMMAND
+            cur_out_addr = rec->r5;
+            break;
+        case 4:
+            // GDROM_CHECK_DRIVE
+            cur_out_addr = rec->r4;
+            break;
+        case 6:
+            // GDROM_DMA_BEGIN
+            read_extra(rec, rec->r5, 2);
+            break;
+        case 7:
+            // GDROM_DMA_CHECK
+            cur_out_addr = rec->r5;
+            break;
+        }
     }
-    uint32_t ret;
-    if (memory_map_try_read_32(mem_map, 0x8c0000bc, &ret) != 0) {
-        LOG_ERROR("Failure to read GD-ROM syscall vector!\n");
-        return 0x8c001000; // this is the default value
+
+    push_rec(rec);
+
+    deep_syscall_ret_addr = rec->pr;
+    in_syscall = true;
+}
+
+static void syscall_return(Sh4 *sh4, addr32_t pc) {
+    struct deep_syscall_rec rec = cur_call;
+
+    rec.tp = DEEP_SYSCALL_REC_RETURN;
+    rec.stamp = sh4_get_cycles(sh4);
+    rec.pc = pc;
+    rec.r0 = *sh4_gen_reg(sh4, 0);
+    rec.n_extra = 0;
+    rec.flags = 0;
+    if (dc_try_read32(GDROM_SYSCALL_STATE_ADDR, &rec.gdrom_state) != 0)
+        rec.flags |= DEEP_SYSCALL_FLAG_READ_FAIL;
+
+    if (rec.r6 == 0) {
+        switch (rec.r7) {
+        case 1:
+            read_extra(&rec, cur_out_addr, 4);
+            break;
+        case 4:
+            read_extra(&rec, cur_out_addr, 2);
+            break;
+        case 7:
+            read_extra(&rec, cur_out_addr, 1);
+            break;
+        }
     }
-    return ret;
+
+    push_rec(&rec);
+
+    deep_syscall_ret_addr = NO_RET_ADDR;
+    in_syscall = false;
 }
 
-#define SYSCALL_TRACE(msg, ...)                                         \
-    do {                                                                \
-        printf("SYSCALL: ");                                            \
-        printf(msg, ##__VA_ARGS__);                                     \
-        LOG_DBG("SYSCALL: "msg, ##__VA_ARGS__);                         \
-    } while (0)
+void deep_syscall_notify(addr32_t pc) {
+    Sh4 *sh4 = dreamcast_get_cpu();
+    uint32_t vector;
+    memcpy(&vector, deep_syscall_ram + DEEP_SYSCALL_VECTOR_OFFS,
+           sizeof(vector));
 
-static char const* cmd_name(reg32_t r4) {
-#define CMD_NAME_BUF_LEN 32
-    static char cmd_name_buf[CMD_NAME_BUF_LEN];
+    if (pc == vector)
+        syscall_enter(sh4, pc);
+    else if (in_syscall && pc == deep_syscall_ret_addr)
+        syscall_return(sh4, pc);
+}
 
-    switch (r4) {
+static char const *gdrom_syscall_name(uint32_t id) {
+    static char const *names[] = {
+        [0] = "GDROM_SEND_COMMAND",
+        [1] = "GDROM_CHECK_COMMAND",
+        [2] = "GDROM_MAINLOOP",
+        [3] = "GDROM_INIT",
+        [4] = "GDROM_CHECK_DRIVE",
+        [6] = "GDROM_DMA_BEGIN",
+        [7] = "GDROM_DMA_CHECK",
+        [8] = "GDROM_ABORT_COMMAND",
+        [9] = "GDROM_RESET",
+        [10] = "GDROM_SECTOR_MODE"
+    };
+    if (id < sizeof(names) / sizeof(names[0]))
+        return names[id];
+    return NULL;
+}
+
+static char const *syscall_name(struct deep_syscall_rec const *rec) {
+    char const *name = NULL;
+    if (rec->r6 == 0xffffffff) {
+        if (rec->r7 == 0)
+            name = "MISC_INIT";
+        else if (rec->r7 == 1)
+            name = "MISC_SETVECTOR";
+    } else if (rec->r6 == 0) {
+        name = gdrom_syscall_name(rec->r7);
+    }
+    return name ? name : "unknown system call";
+}
+
+static char const *gdrom_cmd_name(uint32_t cmd) {
+    switch (cmd) {
     case 16:
-        strncpy(cmd_name_buf, "READ_PIO", CMD_NAME_BUF_LEN);
-        break;
+        return "READ_PIO";
     case 17:
-        strncpy(cmd_name_buf, "READ_DMA", CMD_NAME_BUF_LEN);
-        break;
+        return "READ_DMA";
     case 18:
-        strncpy(cmd_name_buf, "GET_TOC", CMD_NAME_BUF_LEN);
-        break;
+        return "GET_TOC";
     case 19:
-        strncpy(cmd_name_buf, "GET_TOC_2", CMD_NAME_BUF_LEN);
-        break;
+        return "GET_TOC_2";
     case 20:
-        strncpy(cmd_name_buf, "PLAY", CMD_NAME_BUF_LEN);
-        break;
+        return "PLAY";
     case 21:
-        strncpy(cmd_name_buf, "PLAY_2", CMD_NAME_BUF_LEN);
-        break;
+        return "PLAY_2";
     case 22:
-        strncpy(cmd_name_buf, "PAUSE", CMD_NAME_BUF_LEN);
-        break;
+        return "PAUSE";
     case 23:
-        strncpy(cmd_name_buf, "RELEASE", CMD_NAME_BUF_LEN);
-        break;
+        return "RELEASE";
     case 24:
-        strncpy(cmd_name_buf, "INIT", CMD_NAME_BUF_LEN);
-        break;
+        return "INIT";
     case 27:
-        strncpy(cmd_name_buf, "SEEK", CMD_NAME_BUF_LEN);
-        break;
+        return "SEEK";
     case 28:
-        strncpy(cmd_name_buf, "READ", CMD_NAME_BUF_LEN);
-        break;
+        return "READ";
     case 33:
-        strncpy(cmd_name_buf, "STOP", CMD_NAME_BUF_LEN);
-        break;
+        return "STOP";
     case 34:
-        strncpy(cmd_name_buf, "GET_SCD", CMD_NAME_BUF_LEN);
-        break;
+        return "GET_SCD";
     case 35:
-        strncpy(cmd_name_buf, "GET_SESSION", CMD_NAME_BUF_LEN);
-        break;
+        return "GET_SESSION";
     default:
-        snprintf(cmd_name_buf, CMD_NAME_BUF_LEN,
-                 "UNKNOWN <0x%02x>", (unsigned)r4);
-        break;
+        return "UNKNOWN";
     }
-    cmd_name_buf[CMD_NAME_BUF_LEN - 1] = '\0';
-    return cmd_name_buf;
 }
 
-static struct syscall_stat {
-    int id;
-    uint32_t initial_state;
-    union {
-        uint32_t n_bytes_addr;
-        uint32_t check_cmd_out_addr;
-        uint32_t check_drive_out_addr;
+static char const *drive_stat_name(uint32_t stat) {
+    static char const *names[] = {
+        "BUSY", "PAUSE", "STANDBY", "PLAY", "SEEK",
+        "SCAN", "OPEN", "NO_DISC", "RETRY", "ERROR"
     };
-} syscall_stat;
+    if (stat < sizeof(names) / sizeof(names[0]))
+        return names[stat];
+    return "UNKNOWN (EMULATOR OR FIRMWARE ERROR)";
+}
 
-void deep_syscall_notify_jump(addr32_t pc) {
-    Sh4 *sh4 = dreamcast_get_cpu();
-    if (pc == syscall_gdrom_vector()) {
-        if (in_syscall) {
-            SYSCALL_TRACE("recursive syscall detected.  "
-                          "Trace will be unreliable!\n");
-        }
+static char const *disc_fmt_name(uint32_t fmt) {
+    switch (fmt) {
+    case 0x00:
+        return "CD DIGITAL AUDIO";
+    case 0x10:
+        return "CD-ROM";
+    case 0x20:
+        return "CD-ROM XA";
+    case 0x30:
+        return "CD-I";
+    case 0x80:
+        return "GD-ROM";
+    default:
+        return "UNKNOWN (EMULATOR OR FIRMWARE ERROR)";
+    }
+}
 
-        reg32_t r4 = *sh4_gen_reg(sh4, 4);
-        reg32_t r5 = *sh4_gen_reg(sh4, 5);
-        reg32_t r6 = *sh4_gen_reg(sh4, 6);
-        reg32_t r7 = *sh4_gen_reg(sh4, 7);
-        ret_addr = sh4->reg[SH4_REG_PR];
-        in_syscall = true;
-        syscall_stat.id = -1;
-
-        if (dc_try_read32(0x8c0012e8 + 20, &syscall_stat.initial_state) != 0)
-            SYSCALL_TRACE("FAILURE TO READ GDROM SYSCALL STATE\n");
-
-        if (r6 == -1) {
-            if (r7 == 0) {
-                SYSCALL_TRACE("MISC_INIT\n");
-            } else if (r7 == 1) {
-                SYSCALL_TRACE("MISC_SETVECTOR\n");
-            } else {
-                SYSCALL_TRACE("unknown system call (r4=%08X, r5=%08X, r6=%02X, r7=%02X)\n",
-                              (unsigned)r4, (unsigned)r5, (unsigned)r6, (unsigned)r7);
-            }
-        } else if (r6 == 0) {
-            syscall_stat.id = r7;
-            switch (r7) {
-            case 0: {
-                SYSCALL_TRACE("GDROM_SEND_COMMAND <0x%02x> %s\n",
-                              (unsigned)r4, cmd_name(r4));
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                SYSCALL_TRACE("\tCOMMAND %02X\n", (unsigned)r4);
-                uint32_t n_dwords_addr = 0x8c0012e8 + 0x4e8 + r4 * 4;
-                uint32_t n_dwords;
-                if (dc_try_read32(n_dwords_addr, &n_dwords) == 0) {
-                    SYSCALL_TRACE("\tparams %08X\n", (unsigned)r5);
-                    unsigned idx;
-                    for (idx = 0; idx < n_dwords; idx++) {
-                        uint32_t val;
-                        if (dc_try_read32(r5 + idx * 4, &val) == 0)
-                            SYSCALL_TRACE("\t\tparams[%u] %08X\n", idx, (unsigned)val);
-                        else
-                            SYSCALL_TRACE("\t\tparams[%u] <ERROR>\n", idx);
-                    }
-                } else {
-                    SYSCALL_TRACE("\t<unable to determine parameter length>\n");
-                }
-            }
-                break;
-            case 1:
-                SYSCALL_TRACE("GDROM_CHECK_COMMAND\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                SYSCALL_TRACE("\treq_id %08X\n", (unsigned)r4);
-                SYSCALL_TRACE("\tparams %08X\n", (unsigned)r5);
-                break;
-            case 2:
-                SYSCALL_TRACE("GDROM_MAINLOOP\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                break;
-            case 3:
-                SYSCALL_TRACE("GDROM_INIT\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                break;
-            case 4:
-                SYSCALL_TRACE("GDROM_CHECK_DRIVE\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                SYSCALL_TRACE("\tparams %08X\n", (unsigned)r4);
-                syscall_stat.check_drive_out_addr = r4;
-                break;
-            case 6: {
-                SYSCALL_TRACE("GDROM_DMA_BEGIN\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                SYSCALL_TRACE("\treq_id %08X\n", (unsigned)r4);
-                SYSCALL_TRACE("\tparams %08X\n", (unsigned)r5);
-                uint32_t addr_dst;
-                if (dc_try_read32(r5, &addr_dst) == 0) {
-                    SYSCALL_TRACE("\t\tdst %08X\n", (unsigned)addr_dst);
-                } else {
-                    SYSCALL_TRACE("\t\tdst <unable to read from %08X>\n",
-                                  (unsigned)r5);
-                }
-                uint32_t n_bytes;
-                if (dc_try_read32(r5+4, &n_bytes) == 0) {
-                    SYSCALL_TRACE("\t\tn_bytes %08X\n", (unsigned)n_bytes);
-                } else {
-                    SYSCALL_TRACE("\t\tdst <unable to read from %08X>\n",
-                                  (unsigned)(r5+4));
-                }
-            }
-                break;
-            case 7:
-                SYSCALL_TRACE("GDROM_DMA_CHECK\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                SYSCALL_TRACE("\treq_id %08X\n", (unsigned)r4);
-                SYSCALL_TRACE("\tparams %08X\n", (unsigned)r5);
-                syscall_stat.n_bytes_addr = r5;
-                break;
-            case 8:
-                SYSCALL_TRACE("GDROM_ABORT_COMMAND\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                SYSCALL_TRACE("\treq_id = 0x%02x\n",
-                              (unsigned)r4);
-                break;
-            case 9:
-                SYSCALL_TRACE("GDROM_RESET\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                break;
-            case 10:
-                SYSCALL_TRACE("GDROM_SECTOR_MODE\n");
-                SYSCALL_TRACE("\treturn_addr %08X\n", (unsigned)ret_addr);
-                break;
-            default:
-                SYSCALL_TRACE("unknown system call (r4=%08X, r5=%08X, r6=%02X, r7=%02X)\n",
-                              (unsigned)r4, (unsigned)r5, (unsigned)r6, (unsigned)r7);
-            }
-        } else {
-            SYSCALL_TRACE("unknown system call (r4=%08X, r5=%08X, r6=%02X, r7=%02X)\n",
-                          (unsigned)r4, (unsigned)r5, (unsigned)r6, (unsigned)r7);
-        }
-    } else if (in_syscall && pc == ret_addr) {
-        switch (syscall_stat.id) {
-        case 1: {
-            // GDROM_CHECK_COMMAND
-            uint32_t param;
+// snprintf onto the end of what's already in buf
+static int fmt_append(char *buf, size_t len, int pos, char const *fmt, ...) {
+    if (pos < 0)
+        return pos;
+
+    va_list args;
+    va_start(args, fmt);
+    size_t offs = (size_t)pos < len ? (size_t)pos : len;
+    int n_chars = vsnprintf(buf + offs, len - offs, fmt, args);
+    va_end(args);
+    return n_chars < 0 ? n_chars : pos + n_chars;
+}
+
+int deep_syscall_rec_format(char *buf, size_t len,
+                            struct deep_syscall_rec const *rec) {
+    if (len)
+        buf[0] = '\0';
+
+    bool gdrom = rec->r6 == 0;
+    int pos = fmt_append(buf, len, 0, "%llu: ",
+                         (unsigned long long)rec->stamp);
+
+    if (rec->tp == DEEP_SYSCALL_REC_ENTER) {
+        pos = fmt_append(buf, len, pos, "%s r4=%08X r5=%08X r6=%08X "
+                         "r7=%08X pr=%08X", syscall_name(rec),
+                         (unsigned)rec->r4, (unsigned)rec->r5,
+                         (unsigned)rec->r6, (unsigned)rec->r7,
+                         (unsigned)rec->pr);
+        if (gdrom && rec->r7 == 0) {
+            pos = fmt_append(buf, len, pos, " cmd=%s params=[",
+                             gdrom_cmd_name(rec->r4));
             unsigned idx;
-            for (idx = 0; idx < 4; idx++) {
-                if (dc_try_read32(syscall_stat.check_cmd_out_addr + 4 * idx, &param) == 0) {
-                    SYSCALL_TRACE("\tparams[%u] <returned> %08X\n", idx,
-                                  (unsigned)param);
-                } else {
-                    SYSCALL_TRACE("\t\tparams[%u] <returned> <unable to read "
-                                  "from %08X>\n", idx,
-                                  (unsigned)syscall_stat.check_cmd_out_addr + 4 * idx);
-                }
+            for (idx = 0; idx < rec->n_extra; idx++) {
+                pos = fmt_append(buf, len, pos, idx ? " %08X" : "%08X",
+                                 (unsigned)rec->extra[idx]);
             }
+            pos = fmt_append(buf, len, pos, "]");
+        } else if (gdrom && rec->r7 == 6 && rec->n_extra == 2) {
+            pos = fmt_append(buf, len, pos, " dst=%08X n_bytes=%08X",
+                             (unsigned)rec->extra[0],
+                             (unsigned)rec->extra[1]);
         }
-            break;
-        case 4: {
-            uint32_t drive_stat, disc_fmt;
-            if (dc_try_read32(syscall_stat.check_drive_out_addr,
-                              &drive_stat) == 0) {
-                char const *drive_stat_str;
-                switch (drive_stat) {
-                case 0:
-                    drive_stat_str = "BUSY";
-                    break;
-                case 1:
-                    drive_stat_str = "PAUSE";
-                    break;
-                case 2:
-                    drive_stat_str = "STANDBY";
-                    break;
-                case 3:
-                    drive_stat_str = "PLAY";
-                    break;
-                case 4:
-                    drive_stat_str = "SEEK";
-                    break;
-                case 5:
-                    drive_stat_str = "SCAN";
-                    break;
-                case 6:
-                    drive_stat_str = "OPEN";
-                    break;
-                case 7:
-                    drive_stat_str = "NO_DISC";
-                    break;
-                case 8:
-                    drive_stat_str = "RETRY";
-                    break;
-                case 9:
-                    drive_stat_str = "ERROR";
-                    break;
-                default:
-                    drive_stat_str = "UNKNOWN (EMULATOR OR FIRMWARE ERROR)";
-                }
-                SYSCALL_TRACE("\tdrive_status <returned> %08X <%s>\n",
-                              (unsigned)drive_stat, drive_stat_str);
-            } else {
-                SYSCALL_TRACE("\tdrive_status <returned> <unable to read "
-                              "from %08X>\n",
-                              (unsigned)syscall_stat.check_drive_out_addr);
-            }
-            if (dc_try_read32(syscall_stat.check_drive_out_addr + 4,
-                              &disc_fmt) == 0) {
-                char const *disc_fmt_str;
-                switch(disc_fmt) {
-                case 0x00:
-                    disc_fmt_str = "CD DIGITAL AUDIO";
-                    break;
-                case 0x10:
-                    disc_fmt_str = "CD-ROM";
-                    break;
-                case 0x20:
-                    disc_fmt_str = "CD-ROM XA";
-                    break;
-                case 0x30:
-                    disc_fmt_str = "CD-I";
-                    break;
-                case 0x80:
-                    disc_fmt_str = "GD-ROM";
-                    break;
-                default:
-                    disc_fmt_str = "UNKNOWN (EMULATOR OR FIRMWARE ERROR)";
-                }
-                SYSCALL_TRACE("\tdisc_format <returned> %08X <%s>\n",
-                              (unsigned)disc_fmt, disc_fmt_str);
-            } else {
-                SYSCALL_TRACE("\tdisc_format <returned> <unable to read "
-                              "from %08X>\n",
-                              (unsigned)syscall_stat.check_drive_out_addr + 4);
-            }
+    } else {
+        pos = fmt_append(buf, len, pos, "return from %s to %08X r0=%08X",
+                         syscall_name(rec), (unsigned)rec->pc,
+                         (unsigned)rec->r0);
+        if (gdrom && rec->r7 == 1 && rec->n_extra == 4) {
+            pos = fmt_append(buf, len, pos, " status=[%08X %08X %08X %08X]",
+                             (unsigned)rec->extra[0], (unsigned)rec->extra[1],
+                             (unsigned)rec->extra[2], (unsigned)rec->extra[3]);
+        } else if (gdrom && rec->r7 == 4 && rec->n_extra == 2) {
+            pos = fmt_append(buf, len, pos,
+                             " drive_status=%s disc_format=%s",
+                             drive_stat_name(rec->extra[0]),
+                             disc_fmt_name(rec->extra[1]));
+        } else if (gdrom && rec->r7 == 7 && rec->n_extra == 1) {
+            pos = fmt_append(buf, len, pos, " n_bytes=%08X",
+                             (unsigned)rec->extra[0]);
         }
-            break;
-        case 7: {
-            // GDROM DMA CHECK
-            uint32_t n_bytes;
-            if (dc_try_read32(syscall_stat.n_bytes_addr, &n_bytes) == 0) {
-                SYSCALL_TRACE("\tn_bytes <returned> %08X\n",
-                              (unsigned)n_bytes);
-            } else {
-                SYSCALL_TRACE("\t\tn_bytes <returned> <unable to read "
-                              "from %08X>\n",
-                              (unsigned)syscall_stat.n_bytes_addr);
-            }
-        }
-            break;
-        }
-        uint32_t gdrom_syscall_state;
-        if (dc_try_read32(0x8c0012e8 + 20, &gdrom_syscall_state) == 0) {
-            if (syscall_stat.initial_state != gdrom_syscall_state) {
-                SYSCALL_TRACE("gd-rom syscall state changed from %d to %d "
-                              "during system call\n",
-                              (int)syscall_stat.initial_state,
-                              (int)gdrom_syscall_state);
-            }
-        } else {
-            SYSCALL_TRACE("FAILURE TO READ GDROM SYSCALL STATE\n");
-        }
-
-        SYSCALL_TRACE("Returining 0x%08x to 0x%08x\n",
-                      (unsigned)*sh4_gen_reg(sh4, 0), ret_addr);
-        in_syscall = false;
     }
+
+    pos = fmt_append(buf, len, pos, " gdrom_state=%d",
+                     (int)rec->gdrom_state);
+    if (rec->flags & DEEP_SYSCALL_FLAG_RECURSIVE)
+        pos = fmt_append(buf, len, pos, " (recursive, trace is unreliable)");
+    if (rec->flags & DEEP_SYSCALL_FLAG_READ_FAIL)
+        pos = fmt_append(buf, len, pos, " (guest memory read failed)");
+    return pos;
 }
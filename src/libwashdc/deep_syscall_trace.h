@@ -20,6 +20,7 @@
  *
  ******************************************************************************/
 
+
 #ifndef DEEP_SYSCALL_TRACE
 #error rebuild with DEEP_SYSCALL_TRACE enabled
 #endif
@@ -27,11 +28,96 @@
 #ifndef DEEP_SYSCALL_TRACE_H_
 #define DEEP_SYSCALL_TRACE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #include "washdc/types.h"
 
-void deep_syscall_trace_init(struct memory_map *mem_map);
+struct Memory;
+
+/*
+ * Every instruction the interpreter executes goes through
+ * deep_syscall_notify_jump, so all it does is compare the PC against the
+ * GD-ROM system call vector and the return address of the system call in
+ * progress.  Calls and returns get pushed into a ring as binary
+ * deep_syscall_recs, and a background thread writes them to
+ * DEEP_SYSCALL_TRACE_PATH.  Nothing gets formatted on the emulation thread;
+ * tool/decode_syscall_trace.py decodes the file, and washdbg's syscalls
+ * command decodes the most recent records on demand.
+ *
+ * If the ring fills up, records get dropped instead of stalling emulation.
+ */
+
+#define DEEP_SYSCALL_TRACE_PATH "syscall_trace.bin"
+
+// offset of the GD-ROM system call vector in system RAM
+#define DEEP_SYSCALL_VECTOR_OFFS 0xbc
+
+enum deep_syscall_rec_tp {
+    DEEP_SYSCALL_REC_ENTER,
+    DEEP_SYSCALL_REC_RETURN
+};
+
+// the system call was made while another one was still in progress
+#define DEEP_SYSCALL_FLAG_RECURSIVE 1
+
+// something extra was supposed to be read out of guest memory but couldn't be
+#define DEEP_SYSCALL_FLAG_READ_FAIL 2
+
+/*
+ * The trace file is a struct deep_syscall_file_hdr followed by these records
+ * in host byte order.  Returns carry the r4-r7 of the call they return from so
+ * that they can be decoded on their own.  What goes into extra depends on the
+ * system call (see deep_syscall_trace.c).
+ */
+struct deep_syscall_rec {
+    uint64_t stamp; // SH4 cycle count
+    uint32_t pc; // system call vector on entry, return address on return
+    uint32_t pr;
+    uint32_t r4, r5, r6, r7;
+    uint32_t r0; // only for returns
+    uint32_t gdrom_state; // the firmware's GD-ROM system call state
+    uint32_t extra[4];
+    uint8_t tp;
+    uint8_t n_extra;
+    uint8_t flags;
+    uint8_t pad[5];
+};
+
+#define DEEP_SYSCALL_FILE_MAGIC "WASHSYSC"
+#define DEEP_SYSCALL_FILE_VERSION 1
+
+struct deep_syscall_file_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_len;
+};
+
+void deep_syscall_trace_init(struct Memory *ram);
 void deep_syscall_trace_cleanup(void);
 
-void deep_syscall_notify_jump(addr32_t pc);
+extern uint8_t const *deep_syscall_ram;
+extern addr32_t deep_syscall_ret_addr;
+
+void deep_syscall_notify(addr32_t pc);
+
+static inline void deep_syscall_notify_jump(addr32_t pc) {
+    uint32_t vector;
+    memcpy(&vector, deep_syscall_ram + DEEP_SYSCALL_VECTOR_OFFS,
+           sizeof(vector));
+    if (pc == vector || pc == deep_syscall_ret_addr)
+        deep_syscall_notify(pc);
+}
+
+/*
+ * copy up to max of the most recent records that have been written out into
+ * out, oldest first, and return how many there were.
+ */
+unsigned deep_syscall_trace_recent(struct deep_syscall_rec *out, unsigned max);
+
+// decode rec into a line of text; this returns the same thing snprintf would
+int deep_syscall_rec_format(char *buf, size_t len,
+                            struct deep_syscall_rec const *rec);
 
 #endif
@@ -56,6 +56,8 @@
 #include "log.h"
 #include "hw/sh4/sh4_read_inst.h"
 #include "hw/sh4/sh4_jit.h"
+#include "hw/sh4/sh4_predecode.h"
+#include "hw/arm7/arm7_jit.h"
 #include "hw/pvr2/pvr2.h"
 #include "hw/pvr2/pvr2_reg.h"
 #include "hw/pvr2/pvr2_yuv.h"
@@ -72,23 +74,43 @@
 #include "jit/code_block.h"
 #include "jit/jit_intp/code_block_intp.h"
 #include "jit/code_cache.h"
-#include "jit/jit.h"
+#include "jit/jit_persist.h"
+#include "jit/jit_perf_map.h"
+#ifdef ENABLE_JIT_NATIVE
+#include "jit/jit_bg_compile.h"
+#endif
 #include "hw/boot_rom.h"
 #include "hw/arm7/arm7.h"
 #include "title.h"
 #include "mount.h"
 #include "gdi.h"
+#include "dcz.h"
 #include "cdi.h"
 #include "washdc/win.h"
 #include "washdc/sound_intf.h"
 #include "sound.h"
 #include "washdc/hostfile.h"
 #include "hw/sys/holly_intc.h"
+#include "threading.h"
+#include "savestate.h"
+#include "upload.h"
+#include "guest_prof.h"
+#include "hle_func.h"
+#include "rewind.h"
+#include "rollback.h"
+#include "replay.h"
+#include "bench.h"
+#include "perf_cnt.h"
+#include "alloc_audit.h"
+#include "trace.h"
+#include "screenshot.h"
 
 #ifdef DEEP_SYSCALL_TRACE
 #include "deep_syscall_trace.h"
 #endif
 
+#include "hle_syscall.h"
+
 #ifdef ENABLE_TCP_SERIAL
 #include "serial_server.h"
 #endif
@@ -96,9 +118,16 @@
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/native_dispatch.h"
 #include "jit/x86_64/native_mem.h"
+#include "jit/x86_64/fastmem.h"
 #include "jit/x86_64/exec_mem.h"
 #endif
 
+#ifdef ENABLE_JIT_AARCH64
+#include "jit/aarch64/native_dispatch.h"
+#include "jit/aarch64/native_mem.h"
+#include "jit/aarch64/exec_mem.h"
+#endif
+
 #include "dreamcast.h"
 
 static struct Sh4 cpu;
@@ -127,10 +156,51 @@ static bool using_debugger;
 static washdc_real_time last_frame_realtime;
 static dc_cycle_stamp_t last_frame_virttime;
 
+// frames remaining until the next one that gets presented in turbo mode
+static unsigned turbo_countdown;
+
+// true while frames are being simulated again after a rollback
+static bool resimulating;
+
+/*
+ * adaptive frameskip.  frameskip_debt is how far (in seconds) real time has
+ * gotten ahead of virtual time, and frameskip_cur is true if the frame
+ * currently being emulated is getting skipped.
+ */
+#define FRAMESKIP_DEBT_MAX 0.1
+static double frameskip_debt;
+static bool frameskip_cur;
+static int frameskip_run;
+
+/*
+ * adaptive timeslice.  Short timeslices let the SH4 and ARM7 see each other's
+ * interrupts and resets sooner, and long ones have less overhead.  The
+ * timeslice gets cut in half whenever one CPU pokes at the other during a
+ * timeslice, and grows back by an eighth after every timeslice without any
+ * of that, but it never goes below 1/TIMESLICE_ADAPT_RANGE of the configured
+ * length or above it.
+ */
+#define TIMESLICE_ADAPT_RANGE 16
+static dc_cycle_stamp_t timeslice_len_cfg;
+static unsigned long timeslice_last_xfer;
+
+/*
+ * frame limiter.  frame_deadline is the real time at which the current frame
+ * is allowed to end.  It only ever gets advanced by the virtual length of each
+ * frame so that rounding errors in the wakeups don't accumulate, except when
+ * the host falls more than FRAME_LIMIT_RESYNC seconds behind (or the emulator
+ * was paused), in which case it starts over from the present.
+ */
+#define FRAME_LIMIT_RESYNC 0.1
+static washdc_real_time frame_deadline;
+static bool frame_deadline_valid;
+
 static struct memory_interface sh4_unmapped_mem;
 static struct memory_interface arm7_unmapped_mem;
 
-#ifdef ENABLE_JIT_X86_64
+static struct code_cache sh4_code_cache;
+
+#ifdef ENABLE_JIT_NATIVE
 static struct native_dispatch_meta sh4_native_dispatch_meta;
 #endif
 
@@ -160,14 +230,16 @@ static void construct_arm7_mem_map(struct memory_map *map);
 // Run until the next scheduled event (in dc_sched) should occur
 static bool run_to_next_sh4_event(void *ctxt);
 static bool run_to_next_sh4_event_jit(void *ctxt);
+static bool run_to_next_sh4_event_predecode(void *ctxt);
 
 static bool run_to_next_arm7_event(void *ctxt);
+static bool run_to_next_arm7_event_jit(void *ctxt);
 
 static int lmmode0, lmmode1;
 
 static double dc_framerate, dc_virt_framerate;
 
-#ifdef ENABLE_JIT_X86_64
+#ifdef ENABLE_JIT_NATIVE
 static bool run_to_next_sh4_event_jit_native(void *ctxt);
 #endif
 
@@ -179,6 +251,7 @@ static void dreamcast_enable_debugger(void);
 static bool dreamcast_check_debugger(void);
 
 static bool run_to_next_sh4_event_debugger(void *ctxt);
+static bool run_to_next_sh4_event_jit_debugger(void *ctxt);
 
 static bool run_to_next_arm7_event_debugger(void *ctxt);
 
@@ -188,17 +261,91 @@ static bool run_to_next_arm7_event_debugger(void *ctxt);
 static void dreamcast_enable_serial_server(void);
 
 static void suspend_loop(void);
+static void frame_stop_loop(void);
+
+// frames left to go in a dc_run_frames request; 0 if there isn't one
+static unsigned frames_to_run;
+
+/*
+ * functions queued up by dc_run_on_emu_thread.  These get called at the end
+ * of the frame or right away if the emulator is stopped at a frame boundary.
+ */
+#define EMU_CALL_QUEUE_LEN 32
+
+struct emu_call {
+    void (*func)(void*);
+    void *arg;
+};
+
+static struct emu_call emu_calls[EMU_CALL_QUEUE_LEN];
+static unsigned n_emu_calls;
+static washdc_mutex emu_call_lock = WASHDC_MUTEX_STATIC_INIT;
+
+static void emu_call_run_pending(void);
+
+static int mount_disc(char const *path);
+
+/*
+ * Optional ARM7 thread.  When enabled, the ARM7 runs each timeslice on its own
+ * thread at the same time as the SH4 runs the corresponding timeslice on the
+ * main thread.  Neither CPU is allowed to start the next timeslice until both
+ * have finished the current one, so the two clocks never drift apart by more
+ * than a timeslice.
+ */
+static bool arm7_threaded;
+static washdc_thread arm7_thread;
+static washdc_mutex arm7_thread_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar arm7_thread_go_cvar = WASHDC_CVAR_STATIC_INIT;
+static washdc_cvar arm7_thread_done_cvar = WASHDC_CVAR_STATIC_INIT;
+static bool arm7_slice_go, arm7_slice_done, arm7_slice_ret, arm7_thread_quit;
+
+static void arm7_thread_start(void);
+static void arm7_thread_stop(void);
+static void arm7_thread_main(void *argp);
+static bool run_one_timeslice_threaded(void);
 
 static void dc_inject_irq(char const *id);
 
+static void dc_savestate_init(void);
+static void dc_savestate_restored(void);
+static void dc_rollback_restored(void);
+static bool dc_rollback_busy(void);
+static void run_rollback_requests(void);
+
+static void dc_print_bench_report(void);
+
 void washdc_dump_main_memory(char const *path) {
     FILE *outfile = fopen(path, "wb");
     if (outfile) {
-        fwrite(dc_mem.mem, sizeof(dc_mem.mem), 1, outfile);
+        fwrite(dc_mem.mem, MEMORY_SIZE, 1, outfile);
         fclose(outfile);
     }
 }
 
+int washdc_dump_jit_profile(char const *path) {
+#ifdef JIT_PROFILE
+    if (config_get_jit())
+        return sh4_jit_profile_export(&cpu, path);
+#endif
+    return -1;
+}
+
+void washdc_guest_prof_start(void) {
+    guest_prof_request_start();
+}
+
+void washdc_guest_prof_stop(void) {
+    guest_prof_request_stop();
+}
+
+void washdc_guest_prof_reset(void) {
+    guest_prof_request_reset();
+}
+
+void washdc_guest_prof_dump(char const *path) {
+    guest_prof_request_dump(path);
+}
+
 static uint32_t on_pdtra_read(struct Sh4*);
 static void on_pdtra_write(struct Sh4*, uint32_t);
 
@@ -236,12 +383,36 @@ static void dc_mute_sndchan(struct washdc_snddev const *dev,
     aica_mute_chan(&aica, chan_no, is_muted);
 }
 
-static inline void washdc_sleep_ms(unsigned n_ms) {
-#ifdef _MSC_VER
-    Sleep(n_ms);
-#else
-    usleep(n_ms * 1000);
-#endif
+/*
+ * when the emulation thread is suspended or stopped in the debugger it sleeps
+ * on wake_cvar until another thread calls dc_wake.  wake_pending makes sure a
+ * wakeup sent right before the emu thread goes to sleep doesn't get lost.
+ */
+static washdc_mutex wake_mutex = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar wake_cvar = WASHDC_CVAR_STATIC_INIT;
+static bool wake_pending;
+
+void dc_wake(void) {
+    washdc_mutex_lock(&wake_mutex);
+    wake_pending = true;
+    washdc_cvar_signal(&wake_cvar);
+    washdc_mutex_unlock(&wake_mutex);
+}
+
+/*
+ * block until somebody calls dc_wake or timeout_ms milliseconds go by.  If
+ * timeout_ms is 0 then there is no timeout.
+ */
+static void dc_wait_for_wake(unsigned timeout_ms) {
+    washdc_mutex_lock(&wake_mutex);
+    if (!wake_pending) {
+        if (timeout_ms)
+            washdc_cvar_timed_wait(&wake_cvar, &wake_mutex, timeout_ms);
+        else
+            washdc_cvar_wait(&wake_cvar, &wake_mutex);
+    }
+    wake_pending = false;
+    washdc_mutex_unlock(&wake_mutex);
 }
 
 static void dc_inject_irq(char const *id) {
@@ -508,19 +679,17 @@ dreamcast_init(char const *gdi_path,
     dbg_intf = dbg_frontend;
     sersrv = ser_intf;
 
-    log_init(config_get_log_stdout(), config_get_log_verbose());
+    log_init(config_get_log_stdout(), config_get_log_verbose(),
+             config_get_log_drop_on_overflow());
+    perf_cnt_init();
+    trace_init();
 
     char const *title_content = NULL;
     struct mount_meta content_meta; // only valid if gdi_path is non-null
 
     if (gdi_path) {
-        char const *ext = strrchr(gdi_path, '.');
-        if (ext && streq_case_insensitive(ext, ".cdi"))
-            mount_cdi(gdi_path);
-        else if (ext && streq_case_insensitive(ext, ".gdi"))
-            mount_gdi(gdi_path);
-        else {
-            LOG_ERROR("Unknown file type (need either GDI or CDI)!\n");
+        if (mount_disc(gdi_path) != 0) {
+            LOG_ERROR("Unknown file type (need either GDI, CDI or DCZ)!\n");
             exit(1);
         }
 
@@ -564,11 +733,13 @@ dreamcast_init(char const *gdi_path,
     memory_map_init(&mem_map);
     memory_map_init(&arm7_mem_map);
 
-#ifdef DEEP_SYSCALL_TRACE
-    deep_syscall_trace_init(&mem_map);
-#endif
+    hle_syscall_init(&mem_map);
+    hle_func_init();
 
     memory_init(&dc_mem);
+#ifdef DEEP_SYSCALL_TRACE
+    deep_syscall_trace_init(&dc_mem);
+#endif
     flash_mem_init(&flash_mem, config_get_dc_flash_path(), flash_mem_writeable);
     boot_rom_init(&firmware, config_get_dc_bios_path());
 
@@ -604,30 +775,87 @@ dreamcast_init(char const *gdi_path,
         }
 
         char const *syscall_path = config_get_syscall_path();
-        long syscall_len;
-        void *dat_syscall = load_file(syscall_path, &syscall_len);
+        if (syscall_path && strlen(syscall_path)) {
+            long syscall_len;
+            void *dat_syscall = load_file(syscall_path, &syscall_len);
 
-        if (!dat_syscall) {
-            error_set_file_path(syscall_path);
-            error_set_errno_val(errno);
-            RAISE_ERROR(ERROR_FILE_IO);
-        }
+            if (!dat_syscall) {
+                error_set_file_path(syscall_path);
+                error_set_errno_val(errno);
+                RAISE_ERROR(ERROR_FILE_IO);
+            }
 
-        if (syscall_len != LEN_SYSCALLS) {
-            error_set_length(syscall_len);
-            error_set_expected_length(LEN_SYSCALLS);
-            RAISE_ERROR(ERROR_INVALID_FILE_LEN);
-        }
+            if (syscall_len != LEN_SYSCALLS) {
+                error_set_length(syscall_len);
+                error_set_expected_length(LEN_SYSCALLS);
+                RAISE_ERROR(ERROR_INVALID_FILE_LEN);
+            }
 
-        memory_write(&dc_mem, dat_syscall,
-                     ADDR_SYSCALLS & ADDR_AREA3_MASK, syscall_len);
-        free(dat_syscall);
+            memory_write(&dc_mem, dat_syscall,
+                         ADDR_SYSCALLS & ADDR_AREA3_MASK, syscall_len);
+            free(dat_syscall);
+        } else {
+            // no dump of the system calls, so emulate them instead
+            static uint8_t dat_syscall[LEN_SYSCALLS];
+            LOG_INFO("no syscalls.bin; using HLE system calls\n");
+            hle_syscall_build(dat_syscall);
+            memory_write(&dc_mem, dat_syscall,
+                         ADDR_SYSCALLS & ADDR_AREA3_MASK, LEN_SYSCALLS);
+        }
     }
 
     dc_clock_init(&sh4_clock);
     dc_clock_init(&arm7_clock);
+    sh4_clock.trace_track = TRACE_TRACK_SH4_SCHED;
+    arm7_clock.trace_track = TRACE_TRACK_ARM7_SCHED;
     sh4_init(&cpu, &sh4_clock);
     arm7_init(&arm7, &arm7_clock, &aica.mem);
+    if (config_get_arm7_jit())
+        arm7_jit_init(&arm7);
+
+    if (config_get_jit()) {
+#ifdef ENABLE_JIT_NATIVE
+        code_cache_init(&sh4_code_cache, CODE_CACHE_HASH_TBL_SHIFT,
+                        config_get_native_jit());
+#else
+        code_cache_init(&sh4_code_cache, CODE_CACHE_HASH_TBL_SHIFT, false);
+#endif
+        code_cache_set_ram_owner(&sh4_code_cache);
+        cpu.code_cache = &sh4_code_cache;
+    } else if (config_get_intp_predecode()) {
+        code_cache_init(&sh4_code_cache, CODE_CACHE_HASH_TBL_SHIFT, false);
+        code_cache_set_ram_owner(&sh4_code_cache);
+        cpu.code_cache = &sh4_code_cache;
+    }
+
+    guest_prof_init(&cpu, &sh4_clock);
+
+    if ((config_get_jit() || config_get_intp_predecode()) &&
+        config_get_jit_cache_budget() > 0) {
+        code_cache_set_budget(&sh4_code_cache,
+                              (size_t)config_get_jit_cache_budget() << 20);
+    }
+
+#ifdef ENABLE_JIT_NATIVE
+    /*
+     * the background compiler only handles blocks which are promoted out of
+     * the interpreter.  It also can't be used with fastmem, since the fault
+     * handler reads the fastmem site table without any locking.
+     */
+    if (config_get_native_jit() && config_get_jit_bg_compile()) {
+        if (!config_get_jit_tiered()) {
+            LOG_WARN("background jit compilation requires tiered "
+                     "compilation\n");
+#ifdef ENABLE_JIT_X86_64
+        } else if (config_get_jit_fastmem()) {
+            LOG_WARN("background jit compilation is not supported with "
+                     "fastmem\n");
+#endif
+        } else {
+            jit_bg_compile_init();
+        }
+    }
+#endif
 
 #ifdef ENABLE_JIT_X86_64
     if (config_get_native_jit()) {
@@ -635,11 +863,28 @@ dreamcast_init(char const *gdi_path,
         exec_mem_init();
         sh4_jit_set_native_dispatch_meta(&sh4_native_dispatch_meta);
         sh4_native_dispatch_meta.clk = &sh4_clock;
+        sh4_native_dispatch_meta.cache = &sh4_code_cache;
+        native_dispatch_init(&sh4_native_dispatch_meta, &cpu);
+        native_mem_init();
+    }
+#elif defined(ENABLE_JIT_AARCH64)
+    if (config_get_native_jit()) {
+        if (config_get_jit_fastmem())
+            LOG_WARN("fastmem is not supported by the AArch64 jit backend\n");
+        jit_aarch64_backend_init();
+        exec_mem_init();
+        sh4_jit_set_native_dispatch_meta(&sh4_native_dispatch_meta);
+        sh4_native_dispatch_meta.clk = &sh4_clock;
+        sh4_native_dispatch_meta.cache = &sh4_code_cache;
         native_dispatch_init(&sh4_native_dispatch_meta, &cpu);
         native_mem_init();
     }
 #endif
-    jit_init(&sh4_clock);
+
+#ifdef ENABLE_JIT_NATIVE
+    if (config_get_native_jit() && config_get_jit_perf_map())
+        jit_perf_map_init();
+#endif
 
     g1_init();
     g2_init();
@@ -688,10 +933,23 @@ dreamcast_init(char const *gdi_path,
     arm7_set_mem_map(&arm7, &arm7_mem_map);
 
 #ifdef ENABLE_JIT_X86_64
+    if (config_get_native_jit()) {
+        if (config_get_jit_fastmem())
+            fastmem_init(cpu.mem.map);
+        native_mem_register(cpu.mem.map);
+    }
+#elif defined(ENABLE_JIT_AARCH64)
     if (config_get_native_jit())
         native_mem_register(cpu.mem.map);
 #endif
 
+    if (config_get_jit() && config_get_jit_persist_cache()) {
+        jit_persist_init();
+        sh4_jit_persist_register(&cpu);
+        jit_persist_register(dc_mem.mem, MEMORY_SIZE);
+        jit_persist_load(config_get_jit_cache_path(), sh4_jit_persist_flags());
+    }
+
     /* set the PC to the booststrap code within IP.BIN */
     if (boot_mode == (int)DC_BOOT_DIRECT)
         cpu.reg[SH4_REG_PC] = ADDR_1ST_READ_BIN;
@@ -716,6 +974,17 @@ dreamcast_init(char const *gdi_path,
 
     aica_rtc_init(&rtc, &sh4_clock, config_get_dc_path_rtc());
 
+    replay_init(&rtc.cur_rtc_val);
+    if (replay_is_playing()) {
+        // don't let the replay's clock replace the one that's saved on disk
+        rtc.aica_rtc_path[0] = '\0';
+    }
+
+    dc_savestate_init();
+    rewind_init();
+    rollback_init();
+    rollback_set_busy_fn(dc_rollback_busy);
+
 #ifdef ENABLE_DEBUGGER
     if (config_get_dbg_enable()) {
         dc_state_transition(DC_STATE_RUNNING, DC_STATE_NOT_RUNNING);
@@ -748,6 +1017,10 @@ init_complete:
 void dreamcast_cleanup() {
     init_complete = false;
 
+    rollback_cleanup();
+    rewind_cleanup();
+    savestate_cleanup();
+
 #ifdef ENABLE_DEBUGGER
     LOG_INFO("Cleanup up debugger\n");
     debug_cleanup();
@@ -755,6 +1028,7 @@ void dreamcast_cleanup() {
 #endif
 
     aica_rtc_cleanup(&rtc);
+    replay_cleanup();
 
     // disconnect PDTRA read/write handlers
     sh4_register_pdtra_read_handler(&cpu, NULL);
@@ -772,31 +1046,68 @@ void dreamcast_cleanup() {
     g2_cleanup();
     g1_cleanup();
 
-    jit_cleanup();
+    if (config_get_jit() && config_get_jit_persist_cache()) {
+        jit_persist_save(config_get_jit_cache_path(), sh4_jit_persist_flags());
+        jit_persist_cleanup();
+    }
+
+    if (config_get_jit() || config_get_intp_predecode()) {
+        cpu.code_cache = NULL;
+        code_cache_cleanup(&sh4_code_cache);
+    }
+
+#ifdef ENABLE_JIT_NATIVE
+    // this has to wait for the code cache to cancel its jobs
+    jit_bg_compile_cleanup();
+#endif
 #ifdef ENABLE_JIT_X86_64
     if (config_get_native_jit()) {
         native_mem_cleanup();
+        fastmem_cleanup();
         native_dispatch_cleanup(&sh4_native_dispatch_meta);
         exec_mem_cleanup();
         jit_x86_64_backend_cleanup();
     }
+#elif defined(ENABLE_JIT_AARCH64)
+    if (config_get_native_jit()) {
+        native_mem_cleanup();
+        native_dispatch_cleanup(&sh4_native_dispatch_meta);
+        exec_mem_cleanup();
+        jit_aarch64_backend_cleanup();
+    }
 #endif
 
+#ifdef ENABLE_JIT_NATIVE
+    jit_perf_map_cleanup();
+#endif
+
+    guest_prof_cleanup();
+
+    if (config_get_arm7_jit())
+        arm7_jit_cleanup(&arm7);
     arm7_cleanup(&arm7);
     sh4_cleanup(&cpu);
     dc_clock_cleanup(&arm7_clock);
     dc_clock_cleanup(&sh4_clock);
+    sched_event_registry_cleanup();
+
+    trace_cleanup();
     boot_rom_cleanup(&firmware);
     flash_mem_cleanup(&flash_mem);
-    memory_cleanup(&dc_mem);
-
 #ifdef DEEP_SYSCALL_TRACE
     deep_syscall_trace_cleanup();
 #endif
+    memory_cleanup(&dc_mem);
+
+    hle_func_cleanup();
+    hle_syscall_cleanup();
 
     memory_map_cleanup(&arm7_mem_map);
     memory_map_cleanup(&mem_map);
 
+    // the screenshot worker still needs the logger
+    screenshot_cleanup();
+
     dc_sound_cleanup();
     gfx_cleanup();
     /* win_cleanup(); */
@@ -813,31 +1124,205 @@ void dreamcast_cleanup() {
  */
 static washdc_real_time start_time;
 
+static void timeslice_adapt(void) {
+    dc_cycle_stamp_t len = sh4_clock.timeslice_len;
+    unsigned long xfer = aica.xfer_count;
+
+    if (xfer != timeslice_last_xfer) {
+        dc_cycle_stamp_t floor = timeslice_len_cfg / TIMESLICE_ADAPT_RANGE;
+        len /= 2;
+        if (len < floor)
+            len = floor;
+    } else {
+        len += len / 8;
+        if (len > timeslice_len_cfg)
+            len = timeslice_len_cfg;
+    }
+    timeslice_last_xfer = xfer;
+
+    dc_clock_set_timeslice(&sh4_clock, len);
+    dc_clock_set_timeslice(&arm7_clock, len);
+}
+
 static void run_one_frame(void) {
+    struct trace_span span;
+
     while (!end_of_frame) {
-        if (dc_clock_run_timeslice(&sh4_clock))
-            return;
-        if (dc_clock_run_timeslice(&arm7_clock))
-            return;
-        if (config_get_jit())
-            code_cache_gc();
+        if (arm7_threaded) {
+            trace_begin(&span, clock_cycle_stamp(&sh4_clock));
+            bool stop = run_one_timeslice_threaded();
+            trace_end(&span, TRACE_TRACK_FRAME, "timeslice",
+                      clock_cycle_stamp(&sh4_clock));
+            if (stop)
+                return;
+        } else {
+            trace_begin(&span, clock_cycle_stamp(&sh4_clock));
+            enum bench_sect bench_prev = bench_enter(BENCH_SH4);
+            bool stop = dc_clock_run_timeslice(&sh4_clock);
+            bench_leave(bench_prev);
+            trace_end(&span, TRACE_TRACK_FRAME, "sh4 timeslice",
+                      clock_cycle_stamp(&sh4_clock));
+            if (stop)
+                return;
+
+            trace_begin(&span, clock_cycle_stamp(&arm7_clock));
+            bench_prev = bench_enter(BENCH_ARM7);
+            stop = dc_clock_run_timeslice(&arm7_clock);
+            bench_leave(bench_prev);
+            trace_end(&span, TRACE_TRACK_FRAME, "arm7 timeslice",
+                      clock_cycle_stamp(&arm7_clock));
+            if (stop)
+                return;
+        }
+        if (config_get_timeslice_adaptive())
+            timeslice_adapt();
+        trace_begin(&span, clock_cycle_stamp(&sh4_clock));
+        if (config_get_jit() || config_get_intp_predecode())
+            code_cache_gc(&sh4_code_cache);
+        if (config_get_arm7_jit())
+            arm7_jit_gc();
+        trace_end(&span, TRACE_TRACK_FRAME, "jit gc", span.cycle);
     }
     end_of_frame = false;
 }
 
+// returns true if either CPU wants to exit
+static bool run_one_timeslice_threaded(void) {
+    // the ARM7 thread is parked, so this is the only safe time to do this
+    aica_sync_threads(&aica);
+
+    washdc_mutex_lock(&arm7_thread_lock);
+    arm7_slice_go = true;
+    arm7_slice_done = false;
+    washdc_cvar_signal(&arm7_thread_go_cvar);
+    washdc_mutex_unlock(&arm7_thread_lock);
+
+    bool sh4_ret = dc_clock_run_timeslice(&sh4_clock);
+
+    washdc_mutex_lock(&arm7_thread_lock);
+    while (!arm7_slice_done)
+        washdc_cvar_wait(&arm7_thread_done_cvar, &arm7_thread_lock);
+    bool arm7_ret = arm7_slice_ret;
+    washdc_mutex_unlock(&arm7_thread_lock);
+
+    return sh4_ret || arm7_ret;
+}
+
+static void arm7_thread_main(void *argp) {
+    washdc_thread_pin_self("ARM7", config_get_arm7_cpus());
+
+    washdc_mutex_lock(&arm7_thread_lock);
+    for (;;) {
+        while (!arm7_slice_go && !arm7_thread_quit)
+            washdc_cvar_wait(&arm7_thread_go_cvar, &arm7_thread_lock);
+        if (arm7_thread_quit)
+            break;
+        arm7_slice_go = false;
+        washdc_mutex_unlock(&arm7_thread_lock);
+
+        bool ret = dc_clock_run_timeslice(&arm7_clock);
+
+        washdc_mutex_lock(&arm7_thread_lock);
+        arm7_slice_ret = ret;
+        arm7_slice_done = true;
+        washdc_cvar_signal(&arm7_thread_done_cvar);
+    }
+    washdc_mutex_unlock(&arm7_thread_lock);
+}
+
+static void arm7_thread_start(void) {
+#ifdef ENABLE_DEBUGGER
+    if (config_get_dbg_enable()) {
+        LOG_WARN("the ARM7 thread is not supported with the debugger; the "
+                 "ARM7 will run on the main thread instead\n");
+        return;
+    }
+#endif
+
+    LOG_INFO("running the ARM7 on a separate thread\n");
+
+    arm7_slice_go = false;
+    arm7_slice_done = false;
+    arm7_thread_quit = false;
+    aica_set_threaded(&aica, true);
+    washdc_thread_create(&arm7_thread, arm7_thread_main, NULL);
+    arm7_threaded = true;
+}
+
+static void arm7_thread_stop(void) {
+    if (!arm7_threaded)
+        return;
+
+    washdc_mutex_lock(&arm7_thread_lock);
+    arm7_thread_quit = true;
+    washdc_cvar_signal(&arm7_thread_go_cvar);
+    washdc_mutex_unlock(&arm7_thread_lock);
+
+    washdc_thread_join(&arm7_thread);
+    arm7_threaded = false;
+
+    aica_sync_threads(&aica);
+    aica_set_threaded(&aica, false);
+}
+
 unsigned dc_get_frame_count(void) {
     return frame_count;
 }
 
+// returns true if the emulator's state got replaced
+static bool run_state_requests(void) {
+    bool restored = savestate_run_pending();
+    if (rewind_run_pending())
+        restored = true;
+    if (restored) {
+        dc_savestate_restored();
+        rollback_reset();
+    }
+    return restored;
+}
+
+static void run_frame_requests(void) {
+    upload_run_pending(&dc_mem, &cpu);
+    if (guest_prof_run_pending() && cpu.code_cache) {
+        // recompile everything so the jit emits the call/return hooks
+        code_cache_invalidate_all(cpu.code_cache);
+    }
+    emu_call_run_pending();
+}
+
 static void main_loop_sched(void) {
     while (washdc_atomic_int_load(&is_running)) {
+        struct trace_span span;
+        rollback_input(frame_count);
+
+        trace_begin(&span, clock_cycle_stamp(&sh4_clock));
         run_one_frame();
+        trace_end(&span, TRACE_TRACK_FRAME, "frame",
+                  clock_cycle_stamp(&sh4_clock));
+
         frame_count++;
+        alloc_audit_frame();
+        if (frame_count == (unsigned)config_get_bench_frames())
+            dreamcast_kill();
+
+        trace_begin(&span, clock_cycle_stamp(&sh4_clock));
+        if (!run_state_requests())
+            rewind_frame();
+        run_frame_requests();
+        trace_end(&span, TRACE_TRACK_FRAME, "savestate/rewind", span.cycle);
+
+        trace_begin(&span, clock_cycle_stamp(&sh4_clock));
+        run_rollback_requests();
+        rollback_frame(frame_count);
+        trace_end(&span, TRACE_TRACK_FRAME, "rollback",
+                  clock_cycle_stamp(&sh4_clock));
+        if (frames_to_run && --frames_to_run == 0)
+            frame_stop = true;
         if (frame_stop) {
             frame_stop = false;
             if (dc_state == DC_STATE_RUNNING) {
                 dc_state_transition(DC_STATE_SUSPEND, DC_STATE_RUNNING);
-                suspend_loop();
+                frame_stop_loop();
             } else {
                 LOG_WARN("Unable to suspend execution at frame stop: "
                          "system is not running\n");
@@ -846,16 +1331,57 @@ static void main_loop_sched(void) {
     }
 }
 
+/*
+ * handle a washdc_rollback request by restoring the frame it asked for and
+ * then running every frame from there up to the current one again.
+ */
+static void run_rollback_requests(void) {
+    unsigned target, cur = frame_count;
+    if (!rollback_run_pending(&target))
+        return;
+    dc_rollback_restored();
+
+    washdc_real_time start, end, delta;
+    washdc_get_real_time(&start);
+
+    resimulating = true;
+    frame_count = target;
+    while (frame_count < cur && washdc_atomic_int_load(&is_running)) {
+        rollback_input(frame_count);
+        run_one_frame();
+        frame_count++;
+        if (frame_count < cur)
+            rollback_frame(frame_count);
+    }
+    resimulating = false;
+
+    washdc_get_real_time(&end);
+    washdc_real_time_diff(&delta, &end, &start);
+    LOG_DBG("%s - simulated %u frames again in %f ms\n", __func__,
+            cur - target, washdc_real_time_to_seconds(&delta) * 1000.0);
+}
+
 typedef bool(*cpu_backend_func)(void*);
 
 static cpu_backend_func select_sh4_backend(void) {
 #ifdef ENABLE_DEBUGGER
     bool use_debugger = config_get_dbg_enable();
-    if (use_debugger)
+    if (use_debugger) {
+        /*
+         * native blocks link straight into each other without coming back
+         * here, so only the jit-interpreter can stop at breakpoints.
+         */
+#ifdef ENABLE_JIT_NATIVE
+        if (config_get_jit() && !config_get_native_jit())
+#else
+        if (config_get_jit())
+#endif
+            return run_to_next_sh4_event_jit_debugger;
         return run_to_next_sh4_event_debugger;
+    }
 #endif
 
-#ifdef ENABLE_JIT_X86_64
+#ifdef ENABLE_JIT_NATIVE
     bool const native_mode = config_get_native_jit();
     bool const jit = config_get_jit();
 
@@ -864,6 +1390,8 @@ static cpu_backend_func select_sh4_backend(void) {
             return run_to_next_sh4_event_jit_native;
         else
             return run_to_next_sh4_event_jit;
+    } else if (config_get_intp_predecode()) {
+        return run_to_next_sh4_event_predecode;
     } else {
         return run_to_next_sh4_event;
     }
@@ -871,6 +1399,8 @@ static cpu_backend_func select_sh4_backend(void) {
     bool const jit = config_get_jit();
     if (jit)
         return run_to_next_sh4_event_jit;
+    else if (config_get_intp_predecode())
+        return run_to_next_sh4_event_predecode;
     else
         return run_to_next_sh4_event;
 #endif
@@ -882,12 +1412,16 @@ static cpu_backend_func select_arm7_backend(void) {
     if (use_debugger)
         return run_to_next_arm7_event_debugger;
 #endif
+    if (config_get_arm7_jit())
+        return run_to_next_arm7_event_jit;
     return run_to_next_arm7_event;
 }
 
 void dreamcast_run() {
     signal(SIGINT, dc_sigint_handler);
 
+    washdc_thread_pin_self("emulation", config_get_emu_cpus());
+
     if (config_get_ser_srv_enable())
         dreamcast_enable_serial_server();
 
@@ -901,6 +1435,8 @@ void dreamcast_run() {
 
     periodic_event.when = clock_cycle_stamp(&sh4_clock) + DC_PERIODIC_EVENT_PERIOD;
     periodic_event.handler = periodic_event_handler;
+    periodic_event.name = "periodic_event_handler";
+    sched_event_register(&periodic_event, "periodic");
     sched_event(&sh4_clock, &periodic_event);
 
     // back when cmd existed, this was where we'd wait for the user to begin-execution
@@ -909,6 +1445,23 @@ void dreamcast_run() {
 
     washdc_get_real_time(&start_time);
     washdc_get_real_time(&last_frame_realtime);
+    if (config_get_bench_frames() > 0)
+        bench_start();
+    if (config_get_alloc_audit_frames() > 0)
+        alloc_audit_start(config_get_alloc_audit_frames());
+
+    timeslice_len_cfg = config_get_timeslice_us() > 0 ?
+        (dc_cycle_stamp_t)config_get_timeslice_us() *
+        (SCHED_FREQUENCY / 1000000) : DC_TIMESLICE;
+    dc_clock_set_timeslice(&sh4_clock, timeslice_len_cfg);
+    dc_clock_set_timeslice(&arm7_clock, timeslice_len_cfg);
+    timeslice_len_cfg = sh4_clock.timeslice_len;
+    timeslice_last_xfer = aica.xfer_count;
+    if (config_get_timeslice_us() > 0 || config_get_timeslice_adaptive()) {
+        LOG_INFO("timeslice length is %f microseconds%s\n",
+                 timeslice_len_cfg * 1000000.0 / (double)SCHED_FREQUENCY,
+                 config_get_timeslice_adaptive() ? " (adaptive)" : "");
+    }
 
     sh4_clock.dispatch = select_sh4_backend();
     sh4_clock.dispatch_ctxt = &cpu;
@@ -916,8 +1469,15 @@ void dreamcast_run() {
     arm7_clock.dispatch = select_arm7_backend();
     arm7_clock.dispatch_ctxt = &arm7;
 
+    if (config_get_arm7_thread())
+        arm7_thread_start();
+
     main_loop_sched();
 
+    arm7_thread_stop();
+
+    if (config_get_bench_frames() > 0)
+        dc_print_bench_report();
     dc_print_perf_stats();
 
     // tell the other threads it's time to clean up and exit
@@ -947,13 +1507,16 @@ static bool run_to_next_arm7_event(void *ctxt) {
         dc_cycle_stamp_t cycles_after;
         for (;;) {
             int extra_cycles;
-            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles);
-            arm7_op_fn handler = arm7_decode(&arm7, inst);
+            uint32_t inst_pc;
+            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles, &inst_pc);
+            arm7_op_fn handler = arm7_decode_cached(&arm7, inst_pc, inst);
             unsigned inst_cycles = handler(&arm7, inst);
             dc_cycle_stamp_t cycles_adv =
                 (inst_cycles + extra_cycles) * ARM7_CLOCK_SCALE;
 
-            if (cycles_adv >= clock_countdown(&arm7_clock)) {
+            // nothing changes until the next event, so skip right to it
+            if (cycles_adv >= clock_countdown(&arm7_clock) ||
+                arm7_idle_hit(&arm7, inst_pc)) {
                 cycles_after = clock_target_stamp(&arm7_clock);
                 break;
             }
@@ -981,6 +1544,35 @@ static bool run_to_next_arm7_event(void *ctxt) {
     return false;
 }
 
+static bool run_to_next_arm7_event_jit(void *ctxt) {
+    if (!arm7.enabled)
+        return run_to_next_arm7_event(ctxt);
+
+    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&arm7_clock);
+
+    do {
+        struct jit_code_block *blk = arm7_jit_get_block(&arm7);
+
+        // the last instruction is the only one that can branch
+        uint32_t last_pc = arm7.pipeline_pc[1] + 4 * (blk->src_len - 1);
+        unsigned n_cycles = arm7_jit_exec(&arm7, blk);
+
+        dc_cycle_stamp_t cycles_after = clock_cycle_stamp(&arm7_clock) +
+            n_cycles * ARM7_CLOCK_SCALE;
+
+        // nothing changes until the next event, so skip right to it
+        if (arm7_idle_hit(&arm7, last_pc) && cycles_after < tgt_stamp)
+            cycles_after = tgt_stamp;
+
+        clock_set_cycle_stamp(&arm7_clock, cycles_after);
+        tgt_stamp = clock_target_stamp(&arm7_clock);
+    } while (tgt_stamp > clock_cycle_stamp(&arm7_clock));
+    if (clock_cycle_stamp(&arm7_clock) > tgt_stamp)
+        clock_set_cycle_stamp(&arm7_clock, tgt_stamp);
+
+    return false;
+}
+
 #ifdef ENABLE_DEBUGGER
 static bool run_to_next_arm7_event_debugger(void *ctxt) {
     dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&arm7_clock);
@@ -995,8 +1587,9 @@ static bool run_to_next_arm7_event_debugger(void *ctxt) {
 
         while (!(exit_now = dreamcast_check_debugger())) {
             int extra_cycles;
-            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles);
-            arm7_op_fn handler = arm7_decode(&arm7, inst);
+            uint32_t inst_pc;
+            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles, &inst_pc);
+            arm7_op_fn handler = arm7_decode_cached(&arm7, inst_pc, inst);
             unsigned inst_cycles = handler(&arm7, inst);
             dc_cycle_stamp_t cycles_adv =
                 (inst_cycles + extra_cycles) * ARM7_CLOCK_SCALE;
@@ -1049,10 +1642,16 @@ static bool dreamcast_check_debugger(void) {
         cur_state == DC_STATE_DEBUG) {
         printf("cur_state is DC_STATE_DEBUG\n");
         do {
-            // call debug_run_once 100 times per second
+            /*
+             * the debugger frontends call dc_wake whenever they have
+             * something for debug_run_once to do.  The timeout is just there
+             * so the window keeps getting serviced; without a window to
+             * service it only guards against a frontend that forgot to wake
+             * us up.
+             */
             win_check_events();
             debug_run_once();
-            washdc_sleep_ms(1000 / 100);
+            dc_wait_for_wake(win_needs_polling() ? 1000 / 100 : 1000);
         } while ((cur_state = dc_get_state()) == DC_STATE_DEBUG &&
                  (is_running = dc_emu_thread_is_running()));
     }
@@ -1091,6 +1690,63 @@ static bool run_to_next_sh4_event_debugger(void *ctxt) {
     return exit_now;
 }
 
+/*
+ * Blocks always end right before a breakpoint (see
+ * sh4_jit_il_code_block_compile), so checking in between blocks is enough to
+ * catch them.  Single-steps and the instruction after a watchpoint go through
+ * the interpreter so that they stop after exactly one instruction.  Watchpoints
+ * that get triggered from inside a block don't stop until the end of that
+ * block.
+ */
+static bool run_to_next_sh4_event_jit_debugger(void *ctxt) {
+    Sh4 *sh4 = (Sh4*)ctxt;
+    bool exit_now;
+
+    debug_set_context(DEBUG_CONTEXT_SH4);
+
+    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&sh4_clock);
+    while (!(exit_now = dreamcast_check_debugger())) {
+        dc_cycle_stamp_t n_cycles;
+
+        if (debug_get_state(DEBUG_CONTEXT_SH4) == DEBUG_STATE_NORM) {
+            addr32_t blk_addr = sh4->reg[SH4_REG_PC];
+            jit_hash code_hash = sh4_jit_hash(sh4, blk_addr, sh4_fpscr_pr(sh4),
+                                              sh4_fpscr_sz(sh4));
+            struct cache_entry *ent =
+                code_cache_find(&sh4_code_cache, code_hash);
+
+            struct jit_code_block *blk = &ent->blk;
+            if (!ent->valid) {
+                sh4_jit_compile_intp(sh4, blk, blk_addr);
+                code_cache_set_valid(&sh4_code_cache, ent);
+            }
+
+            unsigned blk_cycles;
+            sh4->reg[SH4_REG_PC] =
+                code_block_intp_exec(sh4, &blk->intp, &blk_cycles);
+            n_cycles = blk_cycles;
+        } else {
+            n_cycles =
+                (dc_cycle_stamp_t)sh4_do_exec_inst(sh4) * SH4_CLOCK_SCALE;
+        }
+
+        clock_set_cycle_stamp(&sh4_clock,
+                              clock_cycle_stamp(&sh4_clock) + n_cycles);
+
+#ifdef ENABLE_DBG_COND
+        debug_check_conditions(DEBUG_CONTEXT_SH4);
+#endif
+
+        tgt_stamp = clock_target_stamp(&sh4_clock);
+        if (clock_cycle_stamp(&sh4_clock) >= tgt_stamp)
+            break;
+    }
+    if (clock_cycle_stamp(&sh4_clock) > tgt_stamp)
+        clock_set_cycle_stamp(&sh4_clock, tgt_stamp);
+
+    return exit_now;
+}
+
 #endif
 
 static bool run_to_next_sh4_event(void *ctxt) {
@@ -1116,7 +1772,52 @@ static bool run_to_next_sh4_event(void *ctxt) {
     return false;
 }
 
-#ifdef ENABLE_JIT_X86_64
+static bool run_to_next_sh4_event_predecode(void *ctxt) {
+    dc_cycle_stamp_t cycles_after;
+
+    Sh4 *sh4 = (void*)ctxt;
+
+    for (;;) {
+        /*
+         * predecoded blocks don't depend on FPSCR, so there's no reason to
+         * keep separate copies for each mode.
+         */
+        addr32_t blk_addr = sh4->reg[SH4_REG_PC];
+        jit_hash code_hash = sh4_jit_hash(sh4, blk_addr, false, false);
+        struct cache_entry *ent = code_cache_find(&sh4_code_cache, code_hash);
+
+        struct jit_code_block *blk = &ent->blk;
+        if (!ent->valid) {
+            sh4_predecode_compile(sh4, blk, blk_addr);
+            code_cache_set_valid(&sh4_code_cache, ent);
+        }
+
+#ifdef JIT_PROFILE
+        jit_profile_notify(&sh4->jit_profile, blk->profile);
+#endif
+
+        bool idle_loop = blk->idle_loop;
+        dc_cycle_stamp_t cycles_adv =
+            (dc_cycle_stamp_t)sh4_predecode_exec(sh4, blk) * SH4_CLOCK_SCALE;
+
+        // nothing changes until the next event, so skip right to it
+        if (idle_loop && sh4->reg[SH4_REG_PC] == blk_addr)
+            cycles_adv = clock_countdown(&sh4_clock);
+
+        if (cycles_adv >= clock_countdown(&sh4_clock)) {
+            cycles_after = clock_target_stamp(&sh4_clock);
+            break;
+        }
+
+        clock_countdown_sub(&sh4_clock, cycles_adv);
+    }
+
+    clock_set_cycle_stamp(&sh4_clock, cycles_after);
+
+    return false;
+}
+
+#ifdef ENABLE_JIT_NATIVE
 static bool run_to_next_sh4_event_jit_native(void *ctxt) {
     Sh4 *sh4 = (Sh4*)ctxt;
 
@@ -1142,23 +1843,30 @@ static bool run_to_next_sh4_event_jit(void *ctxt) {
         addr32_t blk_addr = newpc;
         jit_hash code_hash =
             sh4_jit_hash(sh4, blk_addr, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
-        struct cache_entry *ent = code_cache_find(code_hash);
+        struct cache_entry *ent = code_cache_find(&sh4_code_cache, code_hash);
 
         struct jit_code_block *blk = &ent->blk;
         struct code_block_intp *intp_blk = &blk->intp;
         if (!ent->valid) {
             sh4_jit_compile_intp(sh4, blk, blk_addr);
-            ent->valid = true;
+            code_cache_set_valid(&sh4_code_cache, ent);
         }
 
 #ifdef JIT_PROFILE
         jit_profile_notify(&sh4->jit_profile, blk->profile);
 #endif
 
-        newpc = code_block_intp_exec(sh4, intp_blk);
+        bool idle_loop = blk->idle_loop;
+        unsigned n_cycles;
+        newpc = code_block_intp_exec(sh4, intp_blk, &n_cycles);
 
         dc_cycle_stamp_t cycles_after = clock_cycle_stamp(&sh4_clock) +
-            intp_blk->cycle_count;
+            n_cycles;
+
+        // nothing changes until the next event, so skip right to it
+        if (idle_loop && newpc == blk_addr && cycles_after < tgt_stamp)
+            cycles_after = tgt_stamp;
+
         clock_set_cycle_stamp(&sh4_clock, cycles_after);
         tgt_stamp = clock_target_stamp(&sh4_clock);
     } while (tgt_stamp > clock_cycle_stamp(&sh4_clock));
@@ -1170,6 +1878,60 @@ static bool run_to_next_sh4_event_jit(void *ctxt) {
     return false;
 }
 
+// print the benchmark results as JSON so that they can be tracked by scripts
+static void dc_print_bench_report(void) {
+    washdc_real_time end_time, delta_time;
+    washdc_get_real_time(&end_time);
+    washdc_real_time_diff(&delta_time, &end_time, &start_time);
+    double seconds = washdc_real_time_to_seconds(&delta_time);
+
+    double sect_seconds[BENCH_SECT_COUNT];
+    bench_get_seconds(sect_seconds);
+
+    double sh4_cycles = sh4_get_cycles(&cpu);
+    double arm7_cycles = clock_cycle_stamp(&arm7_clock) / ARM7_CLOCK_SCALE;
+
+    printf("{\n");
+    printf("    \"frames\": %u,\n", frame_count);
+    printf("    \"seconds\": %f,\n", seconds);
+    printf("    \"fps\": %f,\n", frame_count / seconds);
+    printf("    \"sh4_mhz\": %f,\n", sh4_cycles / seconds / 1000000.0);
+    printf("    \"arm7_mhz\": %f,\n", arm7_cycles / seconds / 1000000.0);
+    printf("    \"fb_crc32\": \"%08x\",\n",
+           (unsigned)framebuffer_hash(&dc_pvr2));
+    if (alloc_audit_active()) {
+        printf("    \"steady_state_allocs\": %lu,\n", alloc_audit_n_allocs());
+        printf("    \"steady_state_frees\": %lu,\n", alloc_audit_n_frees());
+    }
+
+    // timeslice overruns, in nanoseconds of emulated time
+    struct dc_clock_ts_stat const *ts_stats[2] = {
+        &sh4_clock.ts_stat, &arm7_clock.ts_stat
+    };
+    char const *ts_names[2] = { "sh4", "arm7" };
+    double ns_per_cycle = 1000000000.0 / (double)SCHED_FREQUENCY;
+    printf("    \"timeslice_overrun_ns\": {\n");
+    for (unsigned clk_no = 0; clk_no < 2; clk_no++) {
+        struct dc_clock_ts_stat const *ts = ts_stats[clk_no];
+        double avg = ts->n_slices ?
+            ts->overrun_total * ns_per_cycle / ts->n_slices : 0.0;
+        printf("        \"%s_avg\": %f,\n", ts_names[clk_no], avg);
+        printf("        \"%s_max\": %f%s\n", ts_names[clk_no],
+               ts->overrun_max * ns_per_cycle, clk_no == 1 ? "" : ",");
+    }
+    printf("    },\n");
+
+    printf("    \"host_seconds\": {\n");
+    unsigned idx;
+    for (idx = 0; idx < BENCH_SECT_COUNT; idx++) {
+        printf("        \"%s\": %f%s\n", bench_sect_name(idx),
+               sect_seconds[idx], idx == BENCH_SECT_COUNT - 1 ? "" : ",");
+    }
+    printf("    }\n");
+    printf("}\n");
+    fflush(stdout);
+}
+
 void dc_print_perf_stats(void) {
     if (init_complete) {
         washdc_real_time end_time, delta_time;
@@ -1202,6 +1964,7 @@ void dreamcast_kill(void) {
     LOG_INFO("%s called - WashingtonDC will exit soon\n", __func__);
     int oldval = 1;
     washdc_atomic_int_compare_exchange(&is_running, &oldval, 0);
+    dc_wake();
 }
 
 Sh4 *dreamcast_get_cpu() {
@@ -1283,27 +2046,46 @@ void dc_state_transition(enum dc_state state_new, enum dc_state state_old) {
     if (state_old != dc_state)
         RAISE_ERROR(ERROR_INTEGRITY);
     dc_state = state_new;
+    dc_wake();
 }
 
 bool dc_debugger_enabled(void) {
     return using_debugger;
 }
 
+#ifdef ENABLE_DEBUGGER
+void dc_invalidate_code_cache(void) {
+    if (cpu.code_cache)
+        code_cache_invalidate_all(cpu.code_cache);
+}
+#endif
+
 static void suspend_loop(void) {
     enum dc_state cur_state = dc_get_state();
     if (cur_state == DC_STATE_SUSPEND) {
         do {
             win_run_once_on_suspend();
-            /*
-             * TODO: sleep on a pthread condition or something instead of
-             * polling.
-             */
-            washdc_sleep_ms(1000 / 60);
+            // leaving DC_STATE_SUSPEND always calls dc_wake
+            dc_wait_for_wake(win_needs_polling() ? 1000 / 60 : 0);
         } while (dc_emu_thread_is_running() &&
                  ((cur_state = dc_get_state()) == DC_STATE_SUSPEND));
     }
 }
 
+/*
+ * like suspend_loop, but for when the emulator stopped at the end of a frame.
+ * Requests which would otherwise wait for the end of the next frame get
+ * handled here as soon as they come in.
+ */
+static void frame_stop_loop(void) {
+    while (dc_emu_thread_is_running() && dc_get_state() == DC_STATE_SUSPEND) {
+        win_run_once_on_suspend();
+        dc_wait_for_wake(win_needs_polling() ? 1000 / 60 : 0);
+        run_state_requests();
+        run_frame_requests();
+    }
+}
+
 /*
  * the purpose of this handler is to perform processing that needs to happen
  * occasionally but has no hard timing requirements.  The timing of this event
@@ -1319,6 +2101,28 @@ static void periodic_event_handler(struct SchedEvent *event) {
     sched_event(&sh4_clock, &periodic_event);
 }
 
+static void frame_limit_wait(washdc_real_time const *now,
+                             washdc_real_time const *virt_frametime) {
+    washdc_real_time deadline, late;
+
+    if (!frame_deadline_valid) {
+        frame_deadline = *now;
+        frame_deadline_valid = true;
+        return;
+    }
+
+    washdc_real_time_add(&deadline, &frame_deadline, virt_frametime);
+    if (washdc_real_time_cmp(now, &deadline) >= 0) {
+        washdc_real_time_diff(&late, now, &deadline);
+        frame_deadline = washdc_real_time_to_seconds(&late) >
+            FRAME_LIMIT_RESYNC ? *now : deadline;
+        return;
+    }
+
+    washdc_real_time_sleep_until(&deadline);
+    frame_deadline = deadline;
+}
+
 void dc_end_frame(void) {
     washdc_real_time timestamp, delta, virt_frametime_ns;
     dc_cycle_stamp_t virt_timestamp = clock_cycle_stamp(&sh4_clock);
@@ -1326,6 +2130,12 @@ void dc_end_frame(void) {
 
     end_of_frame = true;
 
+    // nothing from a frame that's being simulated again goes to the host
+    if (resimulating) {
+        last_frame_virttime = virt_timestamp;
+        return;
+    }
+
     virt_frametime = (double)(virt_timestamp - last_frame_virttime);
     double virt_frametime_seconds = virt_frametime / (double)SCHED_FREQUENCY;
     washdc_real_time_from_seconds(&virt_frametime_ns, virt_frametime_seconds);
@@ -1344,10 +2154,76 @@ void dc_end_frame(void) {
     title_set_fps_internal(virt_framerate);
 
     win_update_title();
-    framebuffer_render(&dc_pvr2);
+
+    bool present = true;
+    int turbo_frames = config_get_turbo_frames();
+    if (turbo_frames > 1) {
+        if (turbo_countdown > 1) {
+            turbo_countdown--;
+            present = false;
+        } else {
+            turbo_countdown = turbo_frames;
+        }
+    }
+
+    int frameskip_max = config_get_frameskip_max();
+    if (frameskip_max > 0) {
+        if (frameskip_cur)
+            present = false;
+
+        /*
+         * a little bit of credit is allowed to build up so that jitter
+         * doesn't cause skipping, but not enough to hide a slow stretch.
+         */
+        frameskip_debt += washdc_real_time_to_seconds(&delta) -
+            virt_frametime_seconds;
+        if (frameskip_debt < -virt_frametime_seconds)
+            frameskip_debt = -virt_frametime_seconds;
+        else if (frameskip_debt > FRAMESKIP_DEBT_MAX)
+            frameskip_debt = FRAMESKIP_DEBT_MAX;
+
+        if (frameskip_debt > virt_frametime_seconds / 2 &&
+            frameskip_run < frameskip_max) {
+            frameskip_cur = true;
+            frameskip_run++;
+        } else {
+            frameskip_cur = false;
+            frameskip_run = 0;
+        }
+    }
+
+    if (present) {
+        struct trace_span span;
+        trace_begin(&span, virt_timestamp);
+        framebuffer_render(&dc_pvr2);
+        trace_end(&span, TRACE_TRACK_RENDER, "framebuffer_render",
+                  virt_timestamp);
+    }
+
+    if (config_get_frame_limit() && turbo_frames <= 1)
+        frame_limit_wait(&timestamp, &virt_frametime_ns);
+    else
+        frame_deadline_valid = false;
+
     win_check_events();
 }
 
+bool dc_skip_render(void) {
+    if (frameskip_cur || resimulating)
+        return true;
+
+    /*
+     * a frame that gets rendered during the frame before a presented one will
+     * usually be the one that gets presented, so only frames before that can
+     * be skipped.
+     */
+    return config_get_turbo_frames() > 1 && turbo_countdown > 2;
+}
+
+bool dc_skip_sound(void) {
+    return resimulating || config_get_turbo_frames() > 1;
+}
+
 double dc_get_fps(void) {
     return dc_framerate;
 }
@@ -1358,7 +2234,7 @@ double dc_get_virt_fps(void) {
 
 void dc_tex_cache_read(void **tex_dat_out, size_t *n_bytes_out,
                        struct pvr2_tex_meta const *meta) {
-    pvr2_tex_cache_read(&dc_pvr2, tex_dat_out, n_bytes_out, meta);
+    pvr2_tex_cache_read(&dc_pvr2, tex_dat_out, n_bytes_out, meta, NULL);
 }
 
 static void construct_arm7_mem_map(struct memory_map *map) {
@@ -1455,12 +2331,12 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
      */
 
     memory_map_add(map, 0x7c000000, 0x7fffffff,
-                   0xffffffff, 0xffffffff, MEMORY_MAP_REGION_UNKNOWN,
+                   0xffffffff, 0xffffffff, MEMORY_MAP_REGION_ORA,
                    &sh4_ora_intf, sh4);
 
 
     memory_map_add(map, ADDR_BIOS_FIRST, ADDR_BIOS_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_ROM,
                    &boot_rom_intf, &firmware);
     memory_map_add(map, ADDR_FLASH_FIRST, ADDR_FLASH_LAST,
                    0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
@@ -1503,7 +2379,7 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
                    &ext_dev_intf, NULL);
 
     memory_map_add(map, ADDR_BIOS_FIRST + 0x02000000, ADDR_BIOS_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_ROM,
                    &boot_rom_intf, &firmware);
     memory_map_add(map, ADDR_FLASH_FIRST + 0x02000000, ADDR_FLASH_LAST + 0x02000000,
                    0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
@@ -1565,6 +2441,263 @@ void dc_request_frame_stop(void) {
     frame_stop = true;
 }
 
+int dc_run_frames(unsigned n_frames) {
+    if (!n_frames || dc_get_state() != DC_STATE_SUSPEND)
+        return -1;
+    frames_to_run = n_frames;
+    dc_state_transition(DC_STATE_RUNNING, DC_STATE_SUSPEND);
+    return 0;
+}
+
+int dc_run_on_emu_thread(void (*func)(void*), void *arg) {
+    washdc_mutex_lock(&emu_call_lock);
+    if (n_emu_calls >= EMU_CALL_QUEUE_LEN) {
+        washdc_mutex_unlock(&emu_call_lock);
+        return -1;
+    }
+    emu_calls[n_emu_calls].func = func;
+    emu_calls[n_emu_calls].arg = arg;
+    n_emu_calls++;
+    washdc_mutex_unlock(&emu_call_lock);
+
+    dc_wake();
+    return 0;
+}
+
+static void emu_call_run_pending(void) {
+    struct emu_call calls[EMU_CALL_QUEUE_LEN];
+    unsigned n_calls, idx;
+
+    washdc_mutex_lock(&emu_call_lock);
+    n_calls = n_emu_calls;
+    memcpy(calls, emu_calls, n_calls * sizeof(calls[0]));
+    n_emu_calls = 0;
+    washdc_mutex_unlock(&emu_call_lock);
+
+    for (idx = 0; idx < n_calls; idx++)
+        calls[idx].func(calls[idx].arg);
+}
+
+static int mount_disc(char const *path) {
+    char const *ext = strrchr(path, '.');
+    if (ext && streq_case_insensitive(ext, ".cdi"))
+        mount_cdi(path);
+    else if (ext && streq_case_insensitive(ext, ".gdi"))
+        mount_gdi(path);
+    else if (ext && streq_case_insensitive(ext, ".dcz"))
+        mount_dcz(path);
+    else
+        return -1;
+    return 0;
+}
+
+int dc_load_disc(char const *path) {
+    if (mount_disc(path) != 0) {
+        LOG_ERROR("%s - unknown file type for \"%s\" (need either GDI, CDI "
+                  "or DCZ)\n", __func__, path);
+        return -1;
+    }
+    LOG_INFO("%s mounted in the GD-ROM drive\n", path);
+    return 0;
+}
+
+static int sh4_state_xfer(struct savestate_buf *buf, Sh4 *sh4, bool load) {
+    return SAVESTATE_XFER(buf, load, sh4->exec_state) ||
+        SAVESTATE_XFER(buf, load, sh4->reg) ||
+        SAVESTATE_XFER(buf, load, sh4->delayed_branch) ||
+        SAVESTATE_XFER(buf, load, sh4->delayed_branch_addr) ||
+        SAVESTATE_XFER(buf, load, sh4->dont_increment_pc);
+}
+
+static void sh4_state_save(struct savestate_buf *buf, void *ctxt) {
+    sh4_state_xfer(buf, (Sh4*)ctxt, false);
+}
+
+static int sh4_state_load(struct savestate_buf *buf, void *ctxt) {
+    return sh4_state_xfer(buf, (Sh4*)ctxt, true);
+}
+
+static int arm7_state_xfer(struct savestate_buf *buf, struct arm7 *arm7,
+                           bool load) {
+    return SAVESTATE_XFER(buf, load, arm7->reg) ||
+        SAVESTATE_XFER(buf, load, arm7->extra_cycles) ||
+        SAVESTATE_XFER(buf, load, arm7->pipeline) ||
+        SAVESTATE_XFER(buf, load, arm7->pipeline_pc) ||
+        SAVESTATE_XFER(buf, load, arm7->excp) ||
+        SAVESTATE_XFER(buf, load, arm7->enabled) ||
+        SAVESTATE_XFER(buf, load, arm7->fiq_line);
+}
+
+static void arm7_state_save(struct savestate_buf *buf, void *ctxt) {
+    arm7_state_xfer(buf, (struct arm7*)ctxt, false);
+}
+
+static int arm7_state_load(struct savestate_buf *buf, void *ctxt) {
+    return arm7_state_xfer(buf, (struct arm7*)ctxt, true);
+}
+
+static int sys_block_state_xfer(struct savestate_buf *buf,
+                                struct sys_block_ctxt *sys, bool load) {
+    return SAVESTATE_XFER(buf, load, sys->reg_backing) ||
+        SAVESTATE_XFER(buf, load, sys->reg_sb_c2dstat) ||
+        SAVESTATE_XFER(buf, load, sys->reg_sb_c2dlen) ||
+        SAVESTATE_XFER(buf, load, sys->sort_dma_in_progress) ||
+        SAVESTATE_XFER(buf, load, sys->sort_dma_complete_int_event);
+}
+
+static void sys_block_state_save(struct savestate_buf *buf, void *ctxt) {
+    sys_block_state_xfer(buf, (struct sys_block_ctxt*)ctxt, false);
+}
+
+static int sys_block_state_load(struct savestate_buf *buf, void *ctxt) {
+    return sys_block_state_xfer(buf, (struct sys_block_ctxt*)ctxt, true);
+}
+
+static int maple_state_xfer(struct savestate_buf *buf, struct maple *maple,
+                            bool load) {
+    return SAVESTATE_XFER(buf, load, maple->dma_complete_int_event) ||
+        SAVESTATE_XFER(buf, load, maple->dma_complete_int_event_scheduled) ||
+        SAVESTATE_XFER(buf, load, maple->dma_init_mode) ||
+        SAVESTATE_XFER(buf, load, maple->vblank_init_unlocked) ||
+        SAVESTATE_XFER(buf, load, maple->vblank_autoinit) ||
+        SAVESTATE_XFER(buf, load, maple->dma_en) ||
+        SAVESTATE_XFER(buf, load, maple->maple_dma_prot_bot) ||
+        SAVESTATE_XFER(buf, load, maple->maple_dma_prot_top) ||
+        SAVESTATE_XFER(buf, load, maple->maple_dma_cmd_start) ||
+        SAVESTATE_XFER(buf, load, maple->reg_backing) ||
+        SAVESTATE_XFER(buf, load, maple->reg_msys);
+}
+
+static void maple_state_save(struct savestate_buf *buf, void *ctxt) {
+    maple_state_xfer(buf, (struct maple*)ctxt, false);
+}
+
+static int maple_state_load(struct savestate_buf *buf, void *ctxt) {
+    return maple_state_xfer(buf, (struct maple*)ctxt, true);
+}
+
+static void pvr2_state_save(struct savestate_buf *buf, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+
+    // framebuffers which only exist on the host need to be in texture memory
+    pvr2_framebuffer_notify_read(pvr2, 0, PVR2_TEX32_MEM_LEN);
+
+    savestate_buf_put(buf, pvr2->reg_backing, sizeof(pvr2->reg_backing));
+}
+
+static int pvr2_state_load(struct savestate_buf *buf, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    enum palette_tp palette_tp = get_palette_tp(pvr2);
+
+    if (savestate_buf_get(buf, pvr2->reg_backing,
+                          sizeof(pvr2->reg_backing)) != 0)
+        return -1;
+
+    // palette RAM is in the registers, so this bypassed the usual notifications
+    pvr2_tex_cache_notify_palette_write(pvr2, PVR2_PALETTE_RAM_FIRST,
+                                        PVR2_PALETTE_RAM_LEN);
+    if (get_palette_tp(pvr2) != palette_tp)
+        pvr2_tex_cache_notify_palette_tp_change(pvr2);
+    return 0;
+}
+
+/*
+ * the host-side display list the TA has built so far and CD-DA playback
+ * aren't saved; everything else the guest can see is.
+ */
+static void dc_savestate_init(void) {
+    savestate_init();
+
+    savestate_add_mem(SAVESTATE_MEM_RAM, dc_mem.mem, MEMORY_SIZE,
+                      dc_mem.fastmem);
+    savestate_add_mem(SAVESTATE_MEM_VRAM, dc_pvr2.mem.tex32,
+                      PVR2_TEX32_MEM_LEN, false);
+    savestate_add_mem(SAVESTATE_MEM_WAVE, aica.mem.mem, AICA_WAVE_MEM_LEN,
+                      false);
+
+    savestate_add_section("sh4", sh4_state_save, sh4_state_load, &cpu);
+    savestate_add_section("sh4_p4", sh4_reg_area_save, sh4_reg_area_load, &cpu);
+    savestate_add_block("sh4_tmu", &cpu.tmu, sizeof(cpu.tmu));
+    savestate_add_block("sh4_oc_ram", cpu.ocache.oc_ram_area,
+                        SH4_OC_RAM_AREA_SIZE);
+    savestate_add_block("sh4_sq", cpu.ocache.sq, sizeof(cpu.ocache.sq));
+    savestate_add_section("arm7", arm7_state_save, arm7_state_load, &arm7);
+    savestate_add_section("pvr2", pvr2_state_save, pvr2_state_load, &dc_pvr2);
+    savestate_add_block("spg", &dc_pvr2.spg, sizeof(dc_pvr2.spg));
+    savestate_add_section("sys_block", sys_block_state_save,
+                          sys_block_state_load, &sys_block);
+    savestate_add_section("maple", maple_state_save, maple_state_load, &maple);
+    savestate_add_block("lmmode0", &lmmode0, sizeof(lmmode0));
+    savestate_add_block("lmmode1", &lmmode1, sizeof(lmmode1));
+    savestate_add_section("pvr2_ta", pvr2_ta_state_save, pvr2_ta_state_load,
+                          &dc_pvr2);
+    savestate_add_section("sh4_dmac", sh4_dmac_state_save, sh4_dmac_state_load,
+                          &cpu);
+    savestate_add_section("gdrom", gdrom_state_save, gdrom_state_load, &gdrom);
+    savestate_add_section("aica", aica_state_save, aica_state_load, &aica);
+
+    // the clocks go last so that they get the final say over event state
+    savestate_add_section("sh4_clock", dc_clock_save, dc_clock_load,
+                          &sh4_clock);
+    savestate_add_section("arm7_clock", dc_clock_save, dc_clock_load,
+                          &arm7_clock);
+}
+
+// throw away everything that was derived from memory before a restore
+static void dc_savestate_restored(void) {
+    code_cache_notify_ram_range(0, MEMORY_MASK);
+    sh4_intc_update(&cpu);
+    sh4_icache_invalidate_all(&cpu.icache);
+    pvr2_framebuffer_notify_write(&dc_pvr2, 0, PVR2_TEX32_MEM_LEN);
+    pvr2_tex_cache_notify_write(&dc_pvr2, 0, PVR2_TEX64_MEM_LEN);
+}
+
+/*
+ * rollbacks aren't safe while the AICA's channels, the TA, the GD-ROM or the
+ * SH4's DMAC are busy, since part of what they're doing lives outside of the
+ * saved state (the TA's display list, CD-DA playback, the GD-ROM's worker
+ * thread, the audio that's already been sent to the host).
+ */
+static bool dc_rollback_busy(void) {
+    return aica_busy(&aica) || pvr2_ta_busy(&dc_pvr2) || gdrom_busy(&gdrom) ||
+        sh4_dmac_busy(&cpu);
+}
+
+/*
+ * like dc_savestate_restored, but a rollback knows which pages it changed, so
+ * only things derived from those get thrown away.
+ */
+static void dc_rollback_restored(void) {
+    uint8_t const *pages = rollback_changed_pages(SAVESTATE_MEM_RAM);
+    unsigned page_no;
+    for (page_no = 0; page_no < (MEMORY_SIZE >> SAVESTATE_PAGE_SHIFT);
+         page_no++) {
+        if (pages[page_no]) {
+            addr32_t first = page_no << SAVESTATE_PAGE_SHIFT;
+            code_cache_notify_ram_range(first,
+                                        first + (SAVESTATE_PAGE_SIZE - 1));
+        }
+    }
+    sh4_intc_update(&cpu);
+    sh4_icache_invalidate_all(&cpu.icache);
+
+    /*
+     * a page of the 32-bit area is spread over every other word of twice as
+     * many bytes in the 64-bit area.
+     */
+    pages = rollback_changed_pages(SAVESTATE_MEM_VRAM);
+    for (page_no = 0; page_no < (PVR2_TEX32_MEM_LEN >> SAVESTATE_PAGE_SHIFT);
+         page_no++) {
+        if (pages[page_no]) {
+            uint32_t addr = page_no << SAVESTATE_PAGE_SHIFT;
+            pvr2_framebuffer_notify_write(&dc_pvr2, addr, SAVESTATE_PAGE_SIZE);
+            pvr2_tex_cache_notify_write(&dc_pvr2,
+                                        pvr2_tex_mem_addr_32_to_64(addr),
+                                        2 * SAVESTATE_PAGE_SIZE - 4);
+        }
+    }
+}
+
 static DEF_ERROR_U32_ATTR(ch2_dma_xfer_src_first)
 static DEF_ERROR_U32_ATTR(ch2_dma_xfer_src_last)
 static DEF_ERROR_U32_ATTR(ch2_dma_xfer_dst_first)
@@ -1643,6 +2776,43 @@ dc_ch2_dma_xfer_slow(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
     }
 }
 
+/*
+ * bulk-copy a channel-2 DMA transfer whose source is host memory.  Returns
+ * false if the destination is not one that has a bulk path.
+ */
+static bool
+dc_ch2_dma_xfer_bulk(uint32_t const *src, addr32_t xfer_dst, unsigned n_words) {
+    if ((xfer_dst >= ADDR_TA_FIFO_POLY_FIRST) &&
+        (xfer_dst <= ADDR_TA_FIFO_POLY_LAST)) {
+        pvr2_ta_fifo_poly_write_dwords(xfer_dst, src, n_words, &dc_pvr2);
+        return true;
+    }
+
+    unsigned lmmode;
+    if ((xfer_dst >= ADDR_AREA4_TEX_REGION_0_FIRST) &&
+        (xfer_dst <= ADDR_AREA4_TEX_REGION_0_LAST)) {
+        xfer_dst -= ADDR_AREA4_TEX_REGION_0_FIRST;
+        lmmode = dc_get_lmmode0();
+    } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_1_FIRST) &&
+               (xfer_dst <= ADDR_AREA4_TEX_REGION_1_LAST)) {
+        xfer_dst -= ADDR_AREA4_TEX_REGION_1_FIRST;
+        lmmode = dc_get_lmmode1();
+    } else {
+        return false;
+    }
+
+    if (lmmode == 0) {
+        if (xfer_dst + n_words * 4 > PVR2_TEX64_MEM_LEN)
+            return false;
+        pvr2_tex_mem_64bit_write_dwords(&dc_pvr2, xfer_dst, src, n_words);
+    } else {
+        if (xfer_dst + n_words * 4 > PVR2_TEX32_MEM_LEN)
+            return false;
+        pvr2_tex_mem_32bit_write_raw(&dc_pvr2, xfer_dst, src, n_words * 4);
+    }
+    return true;
+}
+
 dc_cycle_stamp_t
 dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
     struct memory_map_region *src_region = memory_map_get_region(&mem_map,
@@ -1664,6 +2834,19 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
     memory_map_read32_func read32 = src_region->intf->read32;
     void *ctxt = src_region->ctxt;
     uint32_t mask = src_region->mask;
+
+    /*
+     * transfers out of system memory can be read directly from the host
+     * buffer backing it as long as they don't wrap around the mirror.
+     */
+    if (src_region->id == MEMORY_MAP_REGION_RAM && src_region->host &&
+        !(xfer_src & 3) &&
+        (uint64_t)(xfer_src & mask) + n_words * 4 <= (uint64_t)mask + 1) {
+        uint32_t const *src =
+            (uint32_t const*)(src_region->host + (xfer_src & mask));
+        if (dc_ch2_dma_xfer_bulk(src, xfer_dst, n_words))
+            goto the_end;
+    }
     if ((xfer_dst >= ADDR_TA_FIFO_POLY_FIRST) &&
         (xfer_dst <= ADDR_TA_FIFO_POLY_LAST)) {
         while (n_words--) {
@@ -1674,7 +2857,6 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         }
     } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_0_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX_REGION_0_LAST)) {
-        // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
         xfer_dst -= ADDR_AREA4_TEX_REGION_0_FIRST;
         if (dc_get_lmmode0() == 0) {
             while (n_words--) {
@@ -1693,7 +2875,6 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         }
     } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_1_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX_REGION_1_LAST)) {
-        // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
         xfer_dst -= ADDR_AREA4_TEX_REGION_1_FIRST;
         if (dc_get_lmmode1() == 0) {
             while (n_words--) {
@@ -1712,10 +2893,16 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         }
     } else if (xfer_dst >= ADDR_TA_FIFO_YUV_FIRST &&
                xfer_dst <= ADDR_TA_FIFO_YUV_LAST) {
-        while (n_words--) {
-            uint32_t in = read32(xfer_src & mask, ctxt);
-            xfer_src += sizeof(in);
-            pvr2_yuv_input_data(&dc_pvr2, &in, sizeof(in));
+        // hand the converter a whole macroblock at a time
+        uint32_t buf[PVR2_YUV_420_MACROBLOCK_BYTES / sizeof(uint32_t)];
+        while (n_words) {
+            unsigned n_buf = 0;
+            while (n_words && n_buf < sizeof(buf) / sizeof(buf[0])) {
+                buf[n_buf++] = read32(xfer_src & mask, ctxt);
+                xfer_src += sizeof(buf[0]);
+                n_words--;
+            }
+            pvr2_yuv_input_data(&dc_pvr2, buf, n_buf * sizeof(buf[0]));
         }
     } else {
         error_set_address(xfer_dst);
@@ -1806,6 +2993,21 @@ void dc_get_pvr2_stats(struct pvr2_stat *stats) {
     *stats = dc_pvr2.stat;
 }
 
+void dc_get_code_cache_stat(unsigned *n_entries, unsigned long *n_compiles) {
+    *n_entries = sh4_code_cache.n_entries;
+    *n_compiles = sh4_code_cache.n_compiles;
+}
+
+void dc_get_ts_stat(struct dc_clock_ts_stat *sh4_stat,
+                    struct dc_clock_ts_stat *arm7_stat) {
+    *sh4_stat = sh4_clock.ts_stat;
+    *arm7_stat = arm7_clock.ts_stat;
+}
+
+dc_cycle_stamp_t dc_get_timeslice_len(void) {
+    return sh4_clock.timeslice_len;
+}
+
 static uint32_t trans_bind_washdc_to_maple(uint32_t wash) {
     uint32_t ret = 0;
 
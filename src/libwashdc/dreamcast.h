@@ -94,8 +94,29 @@ bool dc_debugger_enabled(void);
  */
 void dc_end_frame(void);
 
+/*
+ * returns true if whatever gets rendered right now won't make it to the
+ * screen, either because of the turbo_frames config option or because
+ * frameskip_max is on and the host has fallen behind.
+ */
+bool dc_skip_render(void);
+
+/*
+ * returns true if the sound being generated right now gets thrown away,
+ * either because of the turbo_frames config option or because the frame is
+ * being simulated again after a rollback.
+ */
+bool dc_skip_sound(void);
+
 #ifdef ENABLE_DEBUGGER
 void dc_single_step(Sh4 *sh4);
+
+/*
+ * throw out everything the sh4 jit has compiled.  The debugger calls this
+ * whenever a breakpoint gets added or removed because blocks get split at
+ * breakpoints.
+ */
+void dc_invalidate_code_cache(void);
 #endif
 
 enum dc_state {
@@ -115,6 +136,12 @@ enum dc_state {
 enum dc_state dc_get_state(void);
 void dc_state_transition(enum dc_state state_new, enum dc_state state_old);
 
+/*
+ * wake up the emulation thread if it's blocked in DC_STATE_SUSPEND or
+ * DC_STATE_DEBUG.  This is safe to call from any thread.
+ */
+void dc_wake(void);
+
 enum dc_boot_mode {
     // standard boot into firmware
     DC_BOOT_FIRMWARE,
@@ -128,6 +155,26 @@ enum dc_boot_mode {
 
 void dc_request_frame_stop(void);
 
+/*
+ * resume from DC_STATE_SUSPEND and stop again after n_frames frames.  Returns
+ * -1 if the emulator isn't suspended.
+ */
+int dc_run_frames(unsigned n_frames);
+
+/*
+ * call func(arg) on the emulation thread at the end of the current frame, or
+ * as soon as possible if the emulator is suspended at the end of a frame.
+ * This is safe to call from any thread, and it returns -1 if too many calls
+ * are already waiting.
+ */
+int dc_run_on_emu_thread(void (*func)(void*), void *arg);
+
+/*
+ * replace whatever's in the GD-ROM drive with the image at path.  This must
+ * be called from the emulation thread.
+ */
+int dc_load_disc(char const *path);
+
 dc_cycle_stamp_t
 dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words);
 
@@ -143,6 +190,15 @@ void dc_tex_cache_read(void **tex_dat_out, size_t *n_bytes_out,
 struct pvr2_stat;
 void dc_get_pvr2_stats(struct pvr2_stat *stats);
 
+// number of blocks in the SH4's code cache, and how many have been compiled
+void dc_get_code_cache_stat(unsigned *n_entries, unsigned long *n_compiles);
+
+void dc_get_ts_stat(struct dc_clock_ts_stat *sh4_stat,
+                    struct dc_clock_ts_stat *arm7_stat);
+
+// the length of the timeslice that's about to run (or is running)
+dc_cycle_stamp_t dc_get_timeslice_len(void);
+
 unsigned dc_get_frame_count(void);
 
 /*
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "log.h"
+
+#include "elf_syms.h"
+
+#define ELF_HDR_LEN 52
+#define ELF_SHDR_LEN 40
+#define ELF_SYM_LEN 16
+#define ELF_ET_REL 1
+#define ELF_EM_SH 42
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_NOBITS 8
+#define ELF_SHN_LORESERVE 0xff00
+#define ELF_STT_FUNC 2
+
+#define ELF_ADDR_MASK 0x1fffffff
+
+static uint32_t get_u16(uint8_t const *ptr) {
+    return ptr[0] | ((uint32_t)ptr[1] << 8);
+}
+
+static uint32_t get_u32(uint8_t const *ptr) {
+    return ptr[0] | ((uint32_t)ptr[1] << 8) |
+        ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static int sym_cmp(void const *lhs, void const *rhs) {
+    uint32_t lhs_addr = ((struct elf_sym const*)lhs)->addr;
+    uint32_t rhs_addr = ((struct elf_sym const*)rhs)->addr;
+    return lhs_addr < rhs_addr ? -1 : (lhs_addr > rhs_addr ? 1 : 0);
+}
+
+// where the bytes of sym are in the file
+static uint32_t sym_file_offs(uint8_t const *dat, size_t len, uint32_t shoff,
+                              unsigned shentsize, unsigned shnum, bool rel,
+                              uint8_t const *ent) {
+    unsigned shndx = get_u16(ent + 14);
+    if (!shndx || shndx >= ELF_SHN_LORESERVE || shndx >= shnum)
+        return ELF_SYM_NO_DATA;
+
+    uint8_t const *sh = dat + shoff + shndx * shentsize;
+    if (get_u32(sh + 4) == ELF_SHT_NOBITS)
+        return ELF_SYM_NO_DATA;
+
+    uint32_t val = get_u32(ent + 4);
+    uint32_t sec_addr = get_u32(sh + 12);
+    uint32_t sec_offs = get_u32(sh + 16);
+    uint32_t sec_len = get_u32(sh + 20);
+    uint32_t offs_in_sec = rel ? val : val - sec_addr;
+    uint32_t sym_len = get_u32(ent + 8);
+
+    if ((uint64_t)offs_in_sec + sym_len > sec_len ||
+        (uint64_t)sec_offs + sec_len > len)
+        return ELF_SYM_NO_DATA;
+    return sec_offs + offs_in_sec;
+}
+
+static int parse_syms(struct elf_syms *syms) {
+    uint8_t const *dat = syms->dat;
+    size_t len = syms->dat_len;
+
+    if (len < ELF_HDR_LEN || dat[0] != 0x7f || dat[1] != 'E' ||
+        dat[2] != 'L' || dat[3] != 'F' || dat[4] != 1 || dat[5] != 1 ||
+        get_u16(dat + 18) != ELF_EM_SH) {
+        LOG_ERROR("%s - not a little-endian 32-bit SH ELF\n", __func__);
+        return -1;
+    }
+
+    bool rel = get_u16(dat + 16) == ELF_ET_REL;
+    uint32_t shoff = get_u32(dat + 32);
+    unsigned shentsize = get_u16(dat + 46);
+    unsigned shnum = get_u16(dat + 48);
+    if (shentsize < ELF_SHDR_LEN ||
+        (uint64_t)shoff + (uint64_t)shentsize * shnum > len) {
+        LOG_ERROR("%s - bad section header table\n", __func__);
+        return -1;
+    }
+
+    unsigned sh_no;
+    for (sh_no = 0; sh_no < shnum; sh_no++) {
+        uint8_t const *sh = dat + shoff + sh_no * shentsize;
+        if (get_u32(sh + 4) != ELF_SHT_SYMTAB)
+            continue;
+
+        uint32_t sym_offs = get_u32(sh + 16);
+        uint32_t sym_len = get_u32(sh + 20);
+        unsigned strtab_no = get_u32(sh + 24);
+        uint32_t entsize = get_u32(sh + 36);
+        if (strtab_no >= shnum || entsize < ELF_SYM_LEN ||
+            (uint64_t)sym_offs + sym_len > len) {
+            LOG_ERROR("%s - bad symbol table\n", __func__);
+            return -1;
+        }
+
+        uint8_t const *strtab_sh = dat + shoff + strtab_no * shentsize;
+        uint32_t str_offs = get_u32(strtab_sh + 16);
+        uint32_t str_len = get_u32(strtab_sh + 20);
+        if ((uint64_t)str_offs + str_len > len) {
+            LOG_ERROR("%s - bad string table\n", __func__);
+            return -1;
+        }
+
+        unsigned n_ents = sym_len / entsize, ent_no;
+        for (ent_no = 0; ent_no < n_ents; ent_no++) {
+            uint8_t const *ent = dat + sym_offs + ent_no * entsize;
+            uint32_t name = get_u32(ent);
+            if ((ent[12] & 0xf) != ELF_STT_FUNC || name >= str_len)
+                continue;
+
+            char const *str = (char const*)dat + str_offs + name;
+            size_t max_len = str_len - name;
+            size_t name_len = strnlen(str, max_len);
+            if (name_len == max_len || !name_len)
+                continue;
+
+            struct elf_sym *new_syms = (struct elf_sym*)
+                realloc(syms->syms, (syms->n_syms + 1) * sizeof(struct elf_sym));
+            if (!new_syms)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            syms->syms = new_syms;
+
+            struct elf_sym *sym = syms->syms + syms->n_syms++;
+            sym->addr = get_u32(ent + 4) & ELF_ADDR_MASK;
+            sym->len = get_u32(ent + 8);
+            sym->file_offs = sym_file_offs(dat, len, shoff, shentsize,
+                                           shnum, rel, ent);
+            sym->name = (char*)malloc(name_len + 1);
+            if (!sym->name)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            memcpy(sym->name, str, name_len);
+            sym->name[name_len] = '\0';
+        }
+    }
+
+    qsort(syms->syms, syms->n_syms, sizeof(struct elf_sym), sym_cmp);
+    return 0;
+}
+
+int elf_syms_load(struct elf_syms *syms, char const *path) {
+    memset(syms, 0, sizeof(*syms));
+
+    washdc_hostfile file =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                             WASHDC_HOSTFILE_BINARY);
+    if (file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("%s - unable to open \"%s\"\n", __func__, path);
+        return -1;
+    }
+
+    long len;
+    if (washdc_hostfile_seek(file, 0, WASHDC_HOSTFILE_SEEK_END) != 0 ||
+        (len = washdc_hostfile_tell(file)) <= 0 ||
+        washdc_hostfile_seek(file, 0, WASHDC_HOSTFILE_SEEK_BEG) != 0) {
+        LOG_ERROR("%s - unable to get the length of \"%s\"\n", __func__, path);
+        washdc_hostfile_close(file);
+        return -1;
+    }
+
+    syms->dat = (uint8_t*)malloc(len);
+    if (!syms->dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    syms->dat_len = len;
+
+    int err = -1;
+    if (washdc_hostfile_read(file, syms->dat, len) == (size_t)len)
+        err = parse_syms(syms);
+    washdc_hostfile_close(file);
+
+    if (err) {
+        LOG_ERROR("%s - unable to read symbols from \"%s\"\n", __func__, path);
+        elf_syms_cleanup(syms);
+    }
+    return err;
+}
+
+void elf_syms_cleanup(struct elf_syms *syms) {
+    unsigned idx;
+    for (idx = 0; idx < syms->n_syms; idx++)
+        free(syms->syms[idx].name);
+    free(syms->syms);
+    free(syms->dat);
+    memset(syms, 0, sizeof(*syms));
+}
+
+struct elf_sym const *elf_syms_find(struct elf_syms const *syms, uint32_t addr) {
+    addr &= ELF_ADDR_MASK;
+
+    unsigned first = 0, last = syms->n_syms;
+    while (first < last) {
+        unsigned mid = first + (last - first) / 2;
+        if (syms->syms[mid].addr <= addr)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    if (!first)
+        return NULL;
+    struct elf_sym const *sym = syms->syms + first - 1;
+    if (sym->len && addr - sym->addr >= sym->len)
+        return NULL;
+    return sym;
+}
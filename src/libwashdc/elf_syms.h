@@ -0,0 +1,64 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ELF_SYMS_H_
+#define ELF_SYMS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * function symbols from a little-endian SH ELF, either an executable or a
+ * relocatable object.  This is used by the tools which need to know where
+ * guest functions are (see guest_prof.h and hle_func.h).
+ */
+
+#define ELF_SYM_NO_DATA 0xffffffff
+
+struct elf_sym {
+    // physical address; for relocatable objects this is the section offset
+    uint32_t addr;
+    uint32_t len;
+    char *name;
+
+    // where the function's code is in the file, or ELF_SYM_NO_DATA
+    uint32_t file_offs;
+};
+
+struct elf_syms {
+    // sorted by addr
+    struct elf_sym *syms;
+    unsigned n_syms;
+
+    // the whole file, so that callers can get at the code through file_offs
+    uint8_t *dat;
+    size_t dat_len;
+};
+
+// returns 0 on success.  On error, syms is left empty but still valid.
+int elf_syms_load(struct elf_syms *syms, char const *path);
+void elf_syms_cleanup(struct elf_syms *syms);
+
+// the function containing addr, or NULL
+struct elf_sym const *elf_syms_find(struct elf_syms const *syms, uint32_t addr);
+
+#endif
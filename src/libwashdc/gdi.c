@@ -31,6 +31,7 @@
 #include "mount.h"
 #include "cdrom.h"
 #include "log.h"
+#include "sector_cache.h"
 
 #include "gdi.h"
 
@@ -38,6 +39,18 @@ struct gdi_mount {
     struct gdi_info meta;
     washdc_hostfile *track_streams;
     size_t *track_lengths; // length of each track, in bytes
+
+    /*
+     * if a track could be mapped into memory then this points to the whole
+     * track file, else it's NULL and reads go through the sector cache.
+     */
+    uint8_t const **track_maps;
+
+    // index of the track that satisfied the last read
+    unsigned last_track;
+
+    // used for tracks which could not be mapped
+    struct sector_cache cache;
 };
 
 static void mount_gdi_cleanup(struct mount *mount);
@@ -46,6 +59,11 @@ static unsigned mount_gdi_session_count(struct mount *mount);
 static int mount_gdi_read_toc(struct mount *mount, struct mount_toc *toc,
                               unsigned session_no);
 static int mount_read_sector(struct mount *mount, void *buf, unsigned fad);
+static int mount_gdi_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned sector_count);
+static int mount_gdi_read_raw_sectors(struct mount *mount, void *buf,
+                                      unsigned fad, unsigned sector_count);
+static void const *mount_gdi_map_sector(struct mount *mount, unsigned fad);
 static enum mount_disc_type gdi_get_disc_type(struct mount* mount);
 
 // return true if this is a legitimate gd-rom; else return false
@@ -67,10 +85,19 @@ static bool mount_gdi_has_hd_region(struct mount *mount);
 static void gdi_get_session_start(struct mount *mount, unsigned session_no,
                                   unsigned *start_track, unsigned *fad);
 
+// return the index of the track containing fad, or -1 if there is none
+static int gdi_find_track(struct gdi_mount *gdi_mount, unsigned fad);
+
+static uint8_t const *gdi_map_track(washdc_hostfile stream, size_t len,
+                                    char const *path);
+
 static struct mount_ops gdi_mount_ops = {
     .session_count = mount_gdi_session_count,
     .read_toc = mount_gdi_read_toc,
     .read_sector = mount_read_sector,
+    .read_sectors = mount_gdi_read_sectors,
+    .read_raw_sectors = mount_gdi_read_raw_sectors,
+    .map_sector = mount_gdi_map_sector,
     .cleanup = mount_gdi_cleanup,
     .get_meta = mount_gdi_get_meta,
     .get_leadout = mount_gdi_get_leadout,
@@ -301,15 +328,41 @@ void mount_gdi(char const *path) {
         mount->track_lengths[track_no] = len;
     }
 
+    mount->track_maps = (uint8_t const**)calloc(mount->meta.n_tracks,
+                                                sizeof(uint8_t const*));
+    if (!mount->track_maps)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    for (track_no = 0; track_no < mount->meta.n_tracks; track_no++) {
+        struct string const *track_path =
+            &mount->meta.tracks[track_no].abs_path;
+        mount->track_maps[track_no] =
+            gdi_map_track(mount->track_streams[track_no],
+                          mount->track_lengths[track_no],
+                          string_get(track_path));
+    }
+
+    sector_cache_init(&mount->cache);
+
     mount_insert(&gdi_mount_ops, mount);
 }
 
 static void mount_gdi_cleanup(struct mount *mount) {
     struct gdi_mount *state = (struct gdi_mount*)mount->state;
 
+    sector_cache_cleanup(&state->cache);
+
     unsigned track_no;
-    for (track_no = 0; track_no < state->meta.n_tracks; track_no++)
+    for (track_no = 0; track_no < state->meta.n_tracks; track_no++) {
+        if (state->track_maps[track_no]) {
+            washdc_hostfile_unmap(state->track_streams[track_no],
+                                  state->track_maps[track_no],
+                                  state->track_lengths[track_no]);
+        }
         washdc_hostfile_close(state->track_streams[track_no]);
+    }
+    free(state->track_maps);
+    free(state->track_lengths);
     free(state->track_streams);
 
     cleanup_gdi_info(&state->meta);
@@ -382,61 +435,148 @@ static int mount_gdi_read_toc(struct mount *mount, struct mount_toc *toc,
     return 0;
 }
 
-static int mount_read_sector(struct mount *mount, void *buf, unsigned fad) {
-    struct gdi_mount const *gdi_mount = (struct gdi_mount const*)mount->state;
+static int gdi_find_track(struct gdi_mount *gdi_mount, unsigned fad) {
     struct gdi_info const *info = &gdi_mount->meta;
 
-    unsigned track_idx;
-    for (track_idx = 0; track_idx < info->n_tracks; track_idx++) {
-        struct gdi_track const *trackp = info->tracks + track_idx;
+    // consecutive reads nearly always land in the same track
+    unsigned track_idx = gdi_mount->last_track;
+    struct gdi_track const *trackp = info->tracks + track_idx;
+    unsigned track_fad_count =
+        gdi_mount->track_lengths[track_idx] / CDROM_FRAME_SIZE;
+    if ((fad >= trackp->fad_start) &&
+        (fad < (trackp->fad_start + track_fad_count)))
+        return track_idx;
 
-        unsigned track_fad_count =
+    for (track_idx = 0; track_idx < info->n_tracks; track_idx++) {
+        trackp = info->tracks + track_idx;
+        track_fad_count =
             gdi_mount->track_lengths[track_idx] / CDROM_FRAME_SIZE;
         if ((fad >= trackp->fad_start) &&
             (fad < (trackp->fad_start + track_fad_count))) {
+            LOG_DBG("Select track %d (%u blocks starting from %u)\n",
+                    track_idx + 1, track_fad_count,
+                    (unsigned)trackp->fad_start);
+            gdi_mount->last_track = track_idx;
+            return track_idx;
+        }
+    }
+
+    return -1;
+}
 
-            // TODO: support MODE2 FORM1, MODE2 FORM2, CDDA, etc...
-            unsigned fad_relative = fad - trackp->fad_start;
-            unsigned byte_offset = CDROM_FRAME_SIZE * fad_relative +
-                CDROM_MODE1_DATA_OFFSET;
+/*
+ * return a pointer to the raw frame at the given fad, either from the track's
+ * mapping or from the sector cache.  Returns NULL on error.
+ */
+static uint8_t const *gdi_get_frame(struct gdi_mount *gdi_mount, unsigned fad) {
+    int track_idx = gdi_find_track(gdi_mount, fad);
+    if (track_idx < 0)
+        return NULL;
+
+    struct gdi_track const *trackp = gdi_mount->meta.tracks + track_idx;
+    unsigned fad_relative = fad - trackp->fad_start;
+
+    // TODO: don't ignore the offset
+    if (gdi_mount->track_maps[track_idx])
+        return gdi_mount->track_maps[track_idx] +
+            (size_t)fad_relative * CDROM_FRAME_SIZE;
+
+    struct sector_run run = {
+        .stream = gdi_mount->track_streams[track_idx],
+        .offset = 0,
+        .frame_len = CDROM_FRAME_SIZE,
+        .first = trackp->fad_start,
+        .count = gdi_mount->track_lengths[track_idx] / CDROM_FRAME_SIZE
+    };
+
+    return sector_cache_get(&gdi_mount->cache, &run, fad);
+}
 
-            LOG_DBG("Select track %d (%u blocks starting from %u)\n",
-                     track_idx + 1, track_fad_count, (unsigned)trackp->fad_start);
-            LOG_DBG("read 1 sector starting at byte %u\n", byte_offset);
-
-            // TODO: don't ignore the offset
-            if (washdc_hostfile_seek(gdi_mount->track_streams[track_idx],
-                                     byte_offset,
-                                     WASHDC_HOSTFILE_SEEK_BEG) != 0) {
-                goto return_err;
-            }
+static int mount_read_sector(struct mount *mount, void *buf, unsigned fad) {
+    return mount_gdi_read_sectors(mount, buf, fad, 1);
+}
 
-            if (washdc_hostfile_read(gdi_mount->track_streams[track_idx], buf,
-                                     2048) != 2048)
-                goto return_err;
+static int mount_gdi_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned sector_count) {
+    struct gdi_mount *gdi_mount = (struct gdi_mount*)mount->state;
+    uint8_t *outp = (uint8_t*)buf;
+
+    // TODO: support MODE2 FORM1, MODE2 FORM2, CDDA, etc...
+    while (sector_count--) {
+        uint8_t const *frame = gdi_get_frame(gdi_mount, fad++);
+        if (!frame)
+            return -1;
+        memcpy(outp, frame + CDROM_MODE1_DATA_OFFSET, CDROM_FRAME_DATA_SIZE);
+        outp += CDROM_FRAME_DATA_SIZE;
+    }
 
-            return 0;
-        }
+    return 0;
+}
+
+static int mount_gdi_read_raw_sectors(struct mount *mount, void *buf,
+                                      unsigned fad, unsigned sector_count) {
+    struct gdi_mount *gdi_mount = (struct gdi_mount*)mount->state;
+    uint8_t *outp = (uint8_t*)buf;
+
+    while (sector_count--) {
+        uint8_t const *frame = gdi_get_frame(gdi_mount, fad++);
+        if (!frame)
+            return -1;
+        memcpy(outp, frame, CDROM_FRAME_SIZE);
+        outp += CDROM_FRAME_SIZE;
     }
 
-return_err:
-    return -1;
+    return 0;
+}
+
+static void const *mount_gdi_map_sector(struct mount *mount, unsigned fad) {
+    struct gdi_mount *gdi_mount = (struct gdi_mount*)mount->state;
+
+    int track_idx = gdi_find_track(gdi_mount, fad);
+    if (track_idx < 0 || !gdi_mount->track_maps[track_idx])
+        return NULL;
+
+    unsigned fad_relative = fad - gdi_mount->meta.tracks[track_idx].fad_start;
+    return gdi_mount->track_maps[track_idx] +
+        (size_t)fad_relative * CDROM_FRAME_SIZE + CDROM_MODE1_DATA_OFFSET;
+}
+
+static uint8_t const *gdi_map_track(washdc_hostfile stream, size_t len,
+                                    char const *path) {
+    if (!len)
+        return NULL;
+
+    size_t map_len;
+    void const *map = washdc_hostfile_map(stream, &map_len);
+    if (!map) {
+        LOG_WARN("unable to map \"%s\"; falling back to buffered reads\n",
+                 path);
+        return NULL;
+    }
+
+    if (map_len != len) {
+        // the file changed size underneath us
+        washdc_hostfile_unmap(stream, map, map_len);
+        return NULL;
+    }
+
+    return (uint8_t const*)map;
 }
 
 static int mount_gdi_get_meta(struct mount *mount, struct mount_meta *meta) {
-    struct gdi_mount const *gdi_mount = (struct gdi_mount const*)mount->state;
+    struct gdi_mount *gdi_mount = (struct gdi_mount*)mount->state;
     struct gdi_info const *info = &gdi_mount->meta;
     uint8_t buffer[256];
 
     if (info->n_tracks < 3)
         return -1;
 
-    if (washdc_hostfile_seek(gdi_mount->track_streams[2], 16,
-                             WASHDC_HOSTFILE_SEEK_BEG))
-        return -1;
+    // without pread, don't fight the prefetch thread for the stream
+    if (!washdc_hostfile_has_pread())
+        sector_cache_sync(&gdi_mount->cache);
 
-    if (washdc_hostfile_read(gdi_mount->track_streams[2], buffer,
-                             sizeof(buffer)) != sizeof(buffer))
+    if (washdc_hostfile_pread(gdi_mount->track_streams[2], buffer,
+                              sizeof(buffer), 16) != sizeof(buffer))
         return -1;
 
     memset(meta, 0, sizeof(*meta));
@@ -24,28 +24,227 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "washdc/win.h"
+#include "washdc/error.h"
 #include "dreamcast.h"
 #include "gfx/rend_common.h"
 #include "log.h"
 #include "config.h"
+#include "threading.h"
 
 // for the palette_tp stuff
 //#include "hw/pvr2/pvr2_core_reg.h"
 
 #include "gfx/gfx.h"
 
-// Only call gfx_thread_signal and gfx_thread_wait when you hold the lock.
+/*
+ * When the render thread is enabled, gfx_il commands are recorded into a
+ * packet on the emulation thread and executed on the render thread.  There
+ * are two packets so that the emulation thread can record the next frame
+ * while the render thread is still drawing the previous one.
+ *
+ * Any pointers to caller-owned data (vertex arrays and object data) get
+ * copied into the packet because the caller is free to reuse that memory as
+ * soon as rend_exec_il returns.  The exception is vertex arrays in persistent
+ * vertex buffers, which the caller can't reuse until after it has been
+ * released and its fence has been signaled.  Commands that write back into caller-owned
+ * memory (GFX_IL_READ_OBJ, GFX_IL_GRAB_FRAMEBUFFER) are synchronous.
+ *
+ * If the present_mailbox config option is set, a third packet is used.  When
+ * the render thread falls behind, the emulation thread can queue up a new
+ * frame instead of waiting.  Any frame that already has a newer frame queued
+ * behind it gets drawn but is never presented, so one slow swap doesn't hold
+ * back emulation.
+ */
+#define GFX_PACKET_MAX 3
+#define GFX_PACKET_INIT_CMDS 1024
+#define GFX_PACKET_INIT_DAT (1024 * 1024)
+#define GFX_PACKET_DAT_ALIGN 16
+#define GFX_PACKET_NO_DAT ((size_t)-1)
+
+struct gfx_packet {
+    struct gfx_il_inst *cmds;
+    size_t *dat_offs; // offset of each command's payload into dat
+    unsigned n_cmds, max_cmds;
+
+    char *dat;
+    size_t dat_len, dat_max;
+
+    // optional function to call on the render thread after the commands
+    void (*func)(void);
+
+    // true if the packet contains a GFX_IL_POST_FRAMEBUFFER
+    bool has_frame;
+
+    // true while the render thread owns this packet
+    bool pending;
+};
+
+static struct gfx_packet packets[GFX_PACKET_MAX];
+static unsigned n_packets;
+static bool present_mailbox;
+static unsigned n_frames_dropped;
+
+// pkt_wr is only touched by the emulation thread, pkt_rd by the render thread
+static unsigned pkt_wr, pkt_rd;
+
+static bool gfx_threaded;
+static bool gfx_thread_quit;
+static bool gfx_thread_ready;
+static washdc_thread gfx_thread;
+
+// Only wait on or signal the cvars when you hold gfx_thread_lock.
+static washdc_mutex gfx_thread_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar gfx_thread_work_cvar = WASHDC_CVAR_STATIC_INIT;
+static washdc_cvar gfx_thread_done_cvar = WASHDC_CVAR_STATIC_INIT;
+
+/*
+ * persistent vertex buffers.
+ *
+ * Each buffer is either FREE, IN_USE (owned by whoever acquired it) or
+ * RETIRED (released, but the GPU might still be reading from it).  A RETIRED
+ * buffer becomes FREE again once the renderer reports that the fence sent
+ * when it was released has been signaled.
+ */
+#define GFX_VERT_BUF_MAX 16
+
+enum gfx_vert_buf_state {
+    GFX_VERT_BUF_FREE,
+    GFX_VERT_BUF_IN_USE,
+    GFX_VERT_BUF_RETIRED
+};
+
+struct gfx_vert_buf {
+    enum gfx_vert_buf_state state;
+
+    // true once the buffer's GFX_IL_FENCE_VERT_BUF has been executed
+    bool fenced;
+
+    // used to find whichever buffer was retired first
+    unsigned retire_stamp;
+};
+
+static struct gfx_vert_buf vert_bufs[GFX_VERT_BUF_MAX];
+static unsigned n_vert_bufs, vert_buf_stamp;
+static size_t vert_buf_len;
+static char *vert_buf_base;
+
+// protects the state and fenced members of vert_bufs
+static washdc_mutex vert_buf_lock = WASHDC_MUTEX_STATIC_INIT;
+
+// arguments and return values for the functions passed to gfx_run_sync
+static unsigned vert_buf_map_count, vert_buf_wait_no;
+static size_t vert_buf_map_len;
+static void *vert_buf_map_ret;
+
+static void gfx_vert_bufs_do_map(void);
+static void gfx_vert_bufs_do_unmap(void);
+static void gfx_vert_buf_do_wait(void);
+static void gfx_vert_bufs_poll(void);
+
 static void gfx_do_init(struct gfx_rend_if const * rend_if);
 
+static void gfx_thread_main(void *argp);
+static void gfx_thread_flush(void);
+static void gfx_thread_sync(void);
+
+static void gfx_packet_init(struct gfx_packet *pkt);
+static void gfx_packet_cleanup(struct gfx_packet *pkt);
+static void gfx_packet_reset(struct gfx_packet *pkt);
+static void gfx_packet_push(struct gfx_packet *pkt,
+                            struct gfx_il_inst const *cmd);
+static void gfx_packet_exec(struct gfx_packet *pkt, bool drop_frame);
+static bool gfx_newer_frame_pending(void);
+
 void gfx_init(struct gfx_rend_if const * rend_if) {
-    LOG_INFO("GFX: rendering graphics from within the main emulation thread\n");
-    gfx_do_init(rend_if);
+    if (!config_get_rend_thread()) {
+        LOG_INFO("GFX: rendering graphics from within the main emulation thread\n");
+        gfx_do_init(rend_if);
+        return;
+    }
+
+    LOG_INFO("GFX: rendering graphics from a separate render thread\n");
+
+    present_mailbox = config_get_present_mailbox();
+    n_packets = present_mailbox ? GFX_PACKET_MAX : 2;
+    n_frames_dropped = 0;
+
+    unsigned pkt_no;
+    for (pkt_no = 0; pkt_no < n_packets; pkt_no++)
+        gfx_packet_init(packets + pkt_no);
+    pkt_wr = pkt_rd = 0;
+    gfx_thread_quit = false;
+    gfx_thread_ready = false;
+
+    washdc_thread_create(&gfx_thread, gfx_thread_main, (void*)rend_if);
+
+    washdc_mutex_lock(&gfx_thread_lock);
+    while (!gfx_thread_ready)
+        washdc_cvar_wait(&gfx_thread_done_cvar, &gfx_thread_lock);
+    washdc_mutex_unlock(&gfx_thread_lock);
+
+    gfx_threaded = true;
 }
 
 void gfx_cleanup(void) {
-    rend_cleanup();
+    if (!gfx_threaded) {
+        rend_cleanup();
+        return;
+    }
+
+    gfx_thread_sync();
+
+    washdc_mutex_lock(&gfx_thread_lock);
+    gfx_thread_quit = true;
+    washdc_cvar_signal(&gfx_thread_work_cvar);
+    washdc_mutex_unlock(&gfx_thread_lock);
+
+    washdc_thread_join(&gfx_thread);
+    gfx_threaded = false;
+
+    if (n_frames_dropped)
+        LOG_INFO("GFX: %u frames were never presented\n", n_frames_dropped);
+
+    unsigned pkt_no;
+    for (pkt_no = 0; pkt_no < n_packets; pkt_no++)
+        gfx_packet_cleanup(packets + pkt_no);
+}
+
+bool gfx_is_threaded(void) {
+    return gfx_threaded;
+}
+
+void gfx_thread_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
+    while (n_cmd--) {
+        gfx_packet_push(packets + pkt_wr, cmd);
+
+        switch (cmd->op) {
+        case GFX_IL_READ_OBJ:
+        case GFX_IL_GRAB_FRAMEBUFFER:
+            // the caller expects the results to be there when we return
+            gfx_thread_sync();
+            break;
+        case GFX_IL_POST_FRAMEBUFFER:
+            // end of the frame; let the render thread have at it
+            gfx_thread_flush();
+            break;
+        default:
+            break;
+        }
+
+        cmd++;
+    }
+}
+
+void gfx_run_sync(void (*func)(void)) {
+    if (gfx_threaded) {
+        packets[pkt_wr].func = func;
+        gfx_thread_sync();
+    } else {
+        func();
+    }
 }
 
 static void gfx_do_init(struct gfx_rend_if const * rend_if) {
@@ -53,3 +252,376 @@ static void gfx_do_init(struct gfx_rend_if const * rend_if) {
 
     rend_init(rend_if);
 }
+
+static void gfx_thread_main(void *argp) {
+    washdc_thread_pin_self("render", config_get_rend_cpus());
+
+    gfx_do_init((struct gfx_rend_if const*)argp);
+
+    washdc_mutex_lock(&gfx_thread_lock);
+    gfx_thread_ready = true;
+    washdc_cvar_signal(&gfx_thread_done_cvar);
+
+    for (;;) {
+        struct gfx_packet *pkt = packets + pkt_rd;
+        while (!pkt->pending && !gfx_thread_quit)
+            washdc_cvar_wait(&gfx_thread_work_cvar, &gfx_thread_lock);
+        if (!pkt->pending)
+            break;
+
+        bool drop_frame = present_mailbox && pkt->has_frame &&
+            gfx_newer_frame_pending();
+
+        washdc_mutex_unlock(&gfx_thread_lock);
+        gfx_packet_exec(pkt, drop_frame);
+        washdc_mutex_lock(&gfx_thread_lock);
+
+        if (drop_frame)
+            n_frames_dropped++;
+        pkt->pending = false;
+        pkt_rd = (pkt_rd + 1) % n_packets;
+        washdc_cvar_signal(&gfx_thread_done_cvar);
+    }
+
+    washdc_mutex_unlock(&gfx_thread_lock);
+
+    rend_cleanup();
+}
+
+/*
+ * hand the current packet off to the render thread and wait for the next one
+ * to become available.  This does not wait for the render thread to finish.
+ */
+static void gfx_thread_flush(void) {
+    struct gfx_packet *pkt = packets + pkt_wr;
+    if (!pkt->n_cmds && !pkt->func)
+        return;
+
+    washdc_mutex_lock(&gfx_thread_lock);
+    pkt->pending = true;
+    washdc_cvar_signal(&gfx_thread_work_cvar);
+
+    pkt_wr = (pkt_wr + 1) % n_packets;
+    pkt = packets + pkt_wr;
+    while (pkt->pending)
+        washdc_cvar_wait(&gfx_thread_done_cvar, &gfx_thread_lock);
+    washdc_mutex_unlock(&gfx_thread_lock);
+
+    gfx_packet_reset(pkt);
+}
+
+// flush the current packet and wait for the render thread to go idle
+static void gfx_thread_sync(void) {
+    gfx_thread_flush();
+
+    washdc_mutex_lock(&gfx_thread_lock);
+    unsigned pkt_no;
+    for (pkt_no = 0; pkt_no < n_packets; pkt_no++)
+        while (packets[pkt_no].pending)
+            washdc_cvar_wait(&gfx_thread_done_cvar, &gfx_thread_lock);
+    washdc_mutex_unlock(&gfx_thread_lock);
+}
+
+static void gfx_packet_init(struct gfx_packet *pkt) {
+    memset(pkt, 0, sizeof(*pkt));
+
+    pkt->max_cmds = GFX_PACKET_INIT_CMDS;
+    pkt->dat_max = GFX_PACKET_INIT_DAT;
+    pkt->cmds = (struct gfx_il_inst*)malloc(pkt->max_cmds * sizeof(*pkt->cmds));
+    pkt->dat_offs = (size_t*)malloc(pkt->max_cmds * sizeof(*pkt->dat_offs));
+    pkt->dat = (char*)malloc(pkt->dat_max);
+
+    if (!pkt->cmds || !pkt->dat_offs || !pkt->dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+}
+
+static void gfx_packet_cleanup(struct gfx_packet *pkt) {
+    free(pkt->dat);
+    free(pkt->dat_offs);
+    free(pkt->cmds);
+    memset(pkt, 0, sizeof(*pkt));
+}
+
+static void gfx_packet_reset(struct gfx_packet *pkt) {
+    pkt->n_cmds = 0;
+    pkt->dat_len = 0;
+    pkt->func = NULL;
+    pkt->has_frame = false;
+}
+
+static void gfx_packet_push(struct gfx_packet *pkt,
+                            struct gfx_il_inst const *cmd) {
+    if (pkt->n_cmds >= pkt->max_cmds) {
+        unsigned max_cmds = pkt->max_cmds * 2;
+        struct gfx_il_inst *cmds =
+            (struct gfx_il_inst*)realloc(pkt->cmds, max_cmds * sizeof(*cmds));
+        if (!cmds)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        pkt->cmds = cmds;
+        size_t *dat_offs =
+            (size_t*)realloc(pkt->dat_offs, max_cmds * sizeof(*dat_offs));
+        if (!dat_offs)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        pkt->dat_offs = dat_offs;
+        pkt->max_cmds = max_cmds;
+    }
+
+    void const *src;
+    size_t n_bytes;
+    switch (cmd->op) {
+    case GFX_IL_SET_VERT_ARRAY:
+        if (cmd->arg.set_vert_array.buf_no >= 0) {
+            // persistent vertex buffers don't need to be copied
+            src = NULL;
+            n_bytes = 0;
+        } else {
+            src = cmd->arg.set_vert_array.verts;
+            n_bytes = cmd->arg.set_vert_array.n_verts *
+                GFX_VERT_SIZE(cmd->arg.set_vert_array.fmt);
+        }
+        break;
+    case GFX_IL_WRITE_OBJ:
+        src = cmd->arg.write_obj.dat;
+        n_bytes = cmd->arg.write_obj.n_bytes;
+        break;
+    case GFX_IL_SET_PALETTE:
+        src = cmd->arg.set_palette.dat;
+        n_bytes = GFX_PALETTE_LEN * sizeof(uint32_t);
+        break;
+    case GFX_IL_SET_INDEX_ARRAY:
+        src = cmd->arg.set_index_array.idx;
+        n_bytes = cmd->arg.set_index_array.n_idx * sizeof(uint32_t);
+        break;
+    default:
+        src = NULL;
+        n_bytes = 0;
+    }
+
+    size_t dat_off = GFX_PACKET_NO_DAT;
+    if (src && n_bytes) {
+        dat_off = (pkt->dat_len + GFX_PACKET_DAT_ALIGN - 1) &
+            ~(size_t)(GFX_PACKET_DAT_ALIGN - 1);
+        if (dat_off + n_bytes > pkt->dat_max) {
+            size_t dat_max = pkt->dat_max;
+            while (dat_off + n_bytes > dat_max)
+                dat_max *= 2;
+            char *dat = (char*)realloc(pkt->dat, dat_max);
+            if (!dat)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            pkt->dat = dat;
+            pkt->dat_max = dat_max;
+        }
+        memcpy(pkt->dat + dat_off, src, n_bytes);
+        pkt->dat_len = dat_off + n_bytes;
+    }
+
+    pkt->cmds[pkt->n_cmds] = *cmd;
+    pkt->dat_offs[pkt->n_cmds] = dat_off;
+    pkt->n_cmds++;
+
+    if (cmd->op == GFX_IL_POST_FRAMEBUFFER)
+        pkt->has_frame = true;
+}
+
+/*
+ * returns true if a packet queued up behind pkt_rd contains a frame.  Only
+ * call this from the render thread while holding gfx_thread_lock.
+ */
+static bool gfx_newer_frame_pending(void) {
+    unsigned pkt_no = (pkt_rd + 1) % n_packets;
+    while (pkt_no != pkt_rd && packets[pkt_no].pending) {
+        if (packets[pkt_no].has_frame)
+            return true;
+        pkt_no = (pkt_no + 1) % n_packets;
+    }
+    return false;
+}
+
+static void gfx_packet_exec(struct gfx_packet *pkt, bool drop_frame) {
+    /*
+     * the dat buffer may have moved while the packet was being recorded, so
+     * the payload pointers aren't fixed up until now.
+     */
+    unsigned idx;
+    for (idx = 0; idx < pkt->n_cmds; idx++) {
+        struct gfx_il_inst *cmd = pkt->cmds + idx;
+        size_t dat_off = pkt->dat_offs[idx];
+        if (dat_off == GFX_PACKET_NO_DAT)
+            continue;
+        if (cmd->op == GFX_IL_SET_VERT_ARRAY)
+            cmd->arg.set_vert_array.verts = (float const*)(pkt->dat + dat_off);
+        else if (cmd->op == GFX_IL_WRITE_OBJ)
+            cmd->arg.write_obj.dat = pkt->dat + dat_off;
+        else if (cmd->op == GFX_IL_SET_PALETTE)
+            cmd->arg.set_palette.dat = (uint32_t const*)(pkt->dat + dat_off);
+        else if (cmd->op == GFX_IL_SET_INDEX_ARRAY)
+            cmd->arg.set_index_array.idx = (uint32_t const*)(pkt->dat + dat_off);
+    }
+
+    if (drop_frame) {
+        // execute everything except for the GFX_IL_POST_FRAMEBUFFER commands
+        unsigned first = 0;
+        for (idx = 0; idx < pkt->n_cmds; idx++) {
+            if (pkt->cmds[idx].op != GFX_IL_POST_FRAMEBUFFER)
+                continue;
+            if (idx > first)
+                gfx_rend_ifp->exec_gfx_il(pkt->cmds + first, idx - first);
+            first = idx + 1;
+        }
+        if (first < pkt->n_cmds)
+            gfx_rend_ifp->exec_gfx_il(pkt->cmds + first, pkt->n_cmds - first);
+    } else if (pkt->n_cmds) {
+        gfx_rend_ifp->exec_gfx_il(pkt->cmds, pkt->n_cmds);
+    }
+
+    if (n_vert_bufs) {
+        washdc_mutex_lock(&vert_buf_lock);
+        for (idx = 0; idx < pkt->n_cmds; idx++) {
+            struct gfx_il_inst const *cmd = pkt->cmds + idx;
+            if (cmd->op == GFX_IL_FENCE_VERT_BUF)
+                vert_bufs[cmd->arg.fence_vert_buf.buf_no].fenced = true;
+        }
+        washdc_mutex_unlock(&vert_buf_lock);
+
+        gfx_vert_bufs_poll();
+    }
+
+    if (pkt->func)
+        pkt->func();
+}
+
+bool gfx_vert_bufs_init(unsigned n_bufs, size_t buf_len) {
+    if (n_bufs > GFX_VERT_BUF_MAX || !n_bufs)
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+
+    vert_buf_map_count = n_bufs;
+    vert_buf_map_len = buf_len;
+    gfx_run_sync(gfx_vert_bufs_do_map);
+
+    if (!vert_buf_map_ret) {
+        LOG_INFO("GFX: renderer does not support persistent vertex buffers\n");
+        return false;
+    }
+
+    memset(vert_bufs, 0, sizeof(vert_bufs));
+    vert_buf_base = (char*)vert_buf_map_ret;
+    vert_buf_len = buf_len;
+    vert_buf_stamp = 0;
+    n_vert_bufs = n_bufs;
+
+    LOG_INFO("GFX: using %u persistent vertex buffers\n", n_bufs);
+    return true;
+}
+
+void gfx_vert_bufs_cleanup(void) {
+    if (!n_vert_bufs)
+        return;
+
+    gfx_run_sync(gfx_vert_bufs_do_unmap);
+
+    n_vert_bufs = 0;
+    vert_buf_base = NULL;
+    vert_buf_len = 0;
+}
+
+float *gfx_vert_buf_acquire(unsigned *buf_no) {
+    for (;;) {
+        // without a render thread, nothing else is going to poll the fences
+        if (!gfx_threaded)
+            gfx_vert_bufs_poll();
+
+        unsigned idx, oldest = n_vert_bufs, oldest_age = 0;
+
+        washdc_mutex_lock(&vert_buf_lock);
+        for (idx = 0; idx < n_vert_bufs; idx++) {
+            struct gfx_vert_buf *buf = vert_bufs + idx;
+            if (buf->state == GFX_VERT_BUF_FREE) {
+                buf->state = GFX_VERT_BUF_IN_USE;
+                washdc_mutex_unlock(&vert_buf_lock);
+                *buf_no = idx;
+                return (float*)(vert_buf_base + idx * vert_buf_len);
+            } else if (buf->state == GFX_VERT_BUF_RETIRED) {
+                unsigned age = vert_buf_stamp - buf->retire_stamp;
+                if (oldest == n_vert_bufs || age > oldest_age) {
+                    oldest = idx;
+                    oldest_age = age;
+                }
+            }
+        }
+        washdc_mutex_unlock(&vert_buf_lock);
+
+        // every buffer is owned by somebody
+        if (oldest == n_vert_bufs)
+            RAISE_ERROR(ERROR_OVERFLOW);
+
+        // the GPU's still busy with all of them, so wait for the oldest one
+        vert_buf_wait_no = oldest;
+        gfx_run_sync(gfx_vert_buf_do_wait);
+    }
+}
+
+void gfx_vert_buf_release(unsigned buf_no) {
+    if (buf_no >= n_vert_bufs)
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+
+    washdc_mutex_lock(&vert_buf_lock);
+    struct gfx_vert_buf *buf = vert_bufs + buf_no;
+    buf->state = GFX_VERT_BUF_RETIRED;
+    buf->fenced = false;
+    buf->retire_stamp = vert_buf_stamp++;
+    washdc_mutex_unlock(&vert_buf_lock);
+
+    struct gfx_il_inst cmd = {
+        .op = GFX_IL_FENCE_VERT_BUF,
+        .arg = { .fence_vert_buf = { .buf_no = buf_no } }
+    };
+    rend_exec_il(&cmd, 1);
+
+    if (!gfx_threaded) {
+        washdc_mutex_lock(&vert_buf_lock);
+        buf->fenced = true;
+        washdc_mutex_unlock(&vert_buf_lock);
+    }
+}
+
+static void gfx_vert_bufs_do_map(void) {
+    if (gfx_rend_ifp->map_vert_bufs && gfx_rend_ifp->unmap_vert_bufs &&
+        gfx_rend_ifp->vert_buf_done) {
+        vert_buf_map_ret = gfx_rend_ifp->map_vert_bufs(vert_buf_map_count,
+                                                       vert_buf_map_len);
+    } else {
+        vert_buf_map_ret = NULL;
+    }
+}
+
+static void gfx_vert_bufs_do_unmap(void) {
+    gfx_rend_ifp->unmap_vert_bufs();
+}
+
+/*
+ * this gets called by gfx_run_sync, so the buffer's fence has already been
+ * executed by the time we get here.
+ */
+static void gfx_vert_buf_do_wait(void) {
+    gfx_rend_ifp->vert_buf_done(vert_buf_wait_no, true);
+
+    washdc_mutex_lock(&vert_buf_lock);
+    vert_bufs[vert_buf_wait_no].state = GFX_VERT_BUF_FREE;
+    vert_bufs[vert_buf_wait_no].fenced = false;
+    washdc_mutex_unlock(&vert_buf_lock);
+}
+
+// free any retired buffers the GPU is done with
+static void gfx_vert_bufs_poll(void) {
+    unsigned idx;
+    washdc_mutex_lock(&vert_buf_lock);
+    for (idx = 0; idx < n_vert_bufs; idx++) {
+        struct gfx_vert_buf *buf = vert_bufs + idx;
+        if (buf->state == GFX_VERT_BUF_RETIRED && buf->fenced &&
+            gfx_rend_ifp->vert_buf_done(idx, false)) {
+            buf->state = GFX_VERT_BUF_FREE;
+            buf->fenced = false;
+        }
+    }
+    washdc_mutex_unlock(&vert_buf_lock);
+}
@@ -24,6 +24,8 @@
 #define GFX_THREAD_H_
 
 #include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #include "washdc/washdc.h"
 #include "washdc/gfx/def.h"
@@ -37,4 +39,38 @@ struct gfx_rend_if;
 void gfx_init(struct gfx_rend_if const * rend_if);
 void gfx_cleanup(void);
 
+/*
+ * true if gfx_il commands are being executed on a separate render thread
+ * (see the rend_thread config option).
+ */
+bool gfx_is_threaded(void);
+
+// queue up commands for the render thread
+void gfx_thread_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd);
+
+/*
+ * call func from whichever thread owns the graphics context and wait for it
+ * to return.
+ */
+void gfx_run_sync(void (*func)(void));
+
+/*
+ * Persistent vertex buffers (see the persistent_verts config option).  These
+ * let the caller write vertex arrays directly into memory the GPU can read,
+ * so GFX_IL_SET_VERT_ARRAY doesn't have to copy or upload anything.
+ *
+ * gfx_vert_bufs_init asks the renderer for n_bufs buffers of buf_len bytes
+ * each.  It returns false if the renderer doesn't support them, in which
+ * case none of the other functions may be called.
+ *
+ * gfx_vert_buf_acquire returns a buffer the GPU is not using, waiting for
+ * one if it has to.  gfx_vert_buf_release hands the buffer back once the
+ * caller has submitted every draw that uses it; it won't be handed out again
+ * until the GPU is done with it.
+ */
+bool gfx_vert_bufs_init(unsigned n_bufs, size_t buf_len);
+void gfx_vert_bufs_cleanup(void);
+float *gfx_vert_buf_acquire(unsigned *buf_no);
+void gfx_vert_buf_release(unsigned buf_no);
+
 #endif
@@ -58,7 +58,10 @@ void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
         gfx_log_il_cmd(cmd++);
 #endif
 
-    gfx_rend_ifp->exec_gfx_il(cmd_tmp, n_cmd_tmp);
+    if (gfx_is_threaded())
+        gfx_thread_exec_il(cmd_tmp, n_cmd_tmp);
+    else
+        gfx_rend_ifp->exec_gfx_il(cmd_tmp, n_cmd_tmp);
 }
 
 #ifdef ENABLE_LOG_DEBUG
@@ -73,6 +76,10 @@ static void gfx_log_il_cmd(struct gfx_il_inst const *cmd) {
         LOG_DBG(GFX_IL_TAG "\ttex_no %u\n", arg->bind_tex.tex_no);
         LOG_DBG(GFX_IL_TAG "\twidth %u\n", arg->bind_tex.width);
         LOG_DBG(GFX_IL_TAG "\theight %u\n", arg->bind_tex.height);
+        LOG_DBG(GFX_IL_TAG "\tmipmap %s\n",
+                arg->bind_tex.mipmap ? "true" : "false");
+        LOG_DBG(GFX_IL_TAG "\talias %s\n",
+                arg->bind_tex.alias ? "true" : "false");
         break;
     case GFX_IL_UNBIND_TEX:
         LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_UNBIND_TEX\n");
@@ -304,12 +311,28 @@ static void gfx_log_il_cmd(struct gfx_il_inst const *cmd) {
         LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_SET_VERT_ARRAY\n");
         LOG_DBG(GFX_IL_TAG "\tn_verts %u\n", cmd->arg.set_vert_array.n_verts);
         LOG_DBG(GFX_IL_TAG "\tverts %p\n", cmd->arg.set_vert_array.verts);
+        LOG_DBG(GFX_IL_TAG "\tbuf_no %d\n", cmd->arg.set_vert_array.buf_no);
+        LOG_DBG(GFX_IL_TAG "\tfmt %s\n",
+                cmd->arg.set_vert_array.fmt == GFX_VERT_FMT_PACKED ?
+                "packed" : "float");
         break;
     case GFX_IL_DRAW_VERT_ARRAY:
         LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_DRAW_VERT_ARRAY\n");
         LOG_DBG(GFX_IL_TAG "\tfirst_idx %u\n", cmd->arg.draw_vert_array.first_idx);
         LOG_DBG(GFX_IL_TAG "\tn_verts %u\n", cmd->arg.draw_vert_array.n_verts);
         break;
+    case GFX_IL_SET_INDEX_ARRAY:
+        LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_SET_INDEX_ARRAY\n");
+        LOG_DBG(GFX_IL_TAG "\tn_idx %u\n", cmd->arg.set_index_array.n_idx);
+        LOG_DBG(GFX_IL_TAG "\tidx %p\n", cmd->arg.set_index_array.idx);
+        break;
+    case GFX_IL_DRAW_INDEXED_VERT_ARRAY:
+        LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_DRAW_INDEXED_VERT_ARRAY\n");
+        LOG_DBG(GFX_IL_TAG "\tfirst_idx %u\n",
+                cmd->arg.draw_indexed_vert_array.first_idx);
+        LOG_DBG(GFX_IL_TAG "\tn_idx %u\n",
+                cmd->arg.draw_indexed_vert_array.n_idx);
+        break;
     case GFX_IL_INIT_OBJ:
         LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_INIT_OBJ\n");
         LOG_DBG(GFX_IL_TAG "\tobj_no %d\n", cmd->arg.init_obj.obj_no);
@@ -355,6 +378,18 @@ static void gfx_log_il_cmd(struct gfx_il_inst const *cmd) {
     case GFX_IL_END_DEPTH_SORT:
         LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_END_DEPTH_SORT\n");
         break;
+    case GFX_IL_SET_PALETTE:
+        LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_SET_PALETTE\n");
+        LOG_DBG(GFX_IL_TAG "\tdat %p\n", cmd->arg.set_palette.dat);
+        break;
+    case GFX_IL_FENCE_VERT_BUF:
+        LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_FENCE_VERT_BUF\n");
+        LOG_DBG(GFX_IL_TAG "\tbuf_no %u\n", cmd->arg.fence_vert_buf.buf_no);
+        break;
+    case GFX_IL_PREFETCH_OBJ:
+        LOG_DBG(GFX_IL_TAG " COMMAND GFX_IL_PREFETCH_OBJ\n");
+        LOG_DBG(GFX_IL_TAG "\tobj_no %d\n", cmd->arg.prefetch_obj.obj_no);
+        break;
     default:
         LOG_DBG(GFX_IL_TAG "UNKNOWN COMMAND %d\n", (int)cmd->op);
     }
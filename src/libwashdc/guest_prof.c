@@ -0,0 +1,380 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "dc_sched.h"
+#include "hw/sh4/sh4.h"
+#include "threading.h"
+#include "config.h"
+#include "log.h"
+#include "elf_syms.h"
+
+#include "guest_prof.h"
+
+#define GUEST_PROF_MAX_DEPTH 32
+#define GUEST_PROF_DEFAULT_INTERVAL_US 100
+
+// symbols and frames are compared by physical address so mirrors match up
+#define GUEST_PROF_ADDR_MASK 0x1fffffff
+
+enum node_kind {
+    NODE_ROOT,
+
+    // a function that was entered through a call the profiler saw
+    NODE_CALL,
+
+    // the caller named by PR, for samples taken with an empty shadow stack
+    NODE_PR,
+
+    // where the SH4 was when the sample was taken
+    NODE_PC
+};
+
+/*
+ * samples are kept in a call tree.  Every node is one frame, and a sample
+ * gets counted in the node for its PC under the nodes for its stack.
+ */
+struct prof_node {
+    uint32_t addr;
+    enum node_kind kind;
+    unsigned parent, first_child, next_sibling;
+    uint64_t n_samples;
+};
+
+bool guest_prof_enabled;
+
+static struct Sh4 *prof_sh4;
+static struct dc_clock *prof_clk;
+static struct SchedEvent sample_event;
+static dc_cycle_stamp_t sample_period;
+
+static struct prof_node *nodes;
+static unsigned n_nodes, nodes_alloc;
+static uint64_t n_samples_total;
+
+static struct elf_syms syms;
+
+static struct shadow_stack {
+    uint32_t dst[GUEST_PROF_MAX_DEPTH];
+    uint32_t ret[GUEST_PROF_MAX_DEPTH];
+    unsigned depth;
+} shadow;
+
+static washdc_mutex pending_lock = WASHDC_MUTEX_STATIC_INIT;
+static bool pending_start, pending_stop, pending_reset, pending_dump;
+static char pending_dump_path[CONFIG_STR_LEN];
+
+static void sample_handler(struct SchedEvent *event);
+
+/*
+ * with symbols, every address in a function gets filed under the start of
+ * that function so that samples from the same function end up in one frame.
+ */
+static uint32_t frame_addr(uint32_t addr) {
+    struct elf_sym const *sym = elf_syms_find(&syms, addr);
+    return sym ? sym->addr : (addr & GUEST_PROF_ADDR_MASK);
+}
+
+static unsigned node_alloc(unsigned parent, enum node_kind kind,
+                           uint32_t addr) {
+    if (n_nodes >= nodes_alloc) {
+        unsigned new_alloc = nodes_alloc ? nodes_alloc * 2 : 1024;
+        struct prof_node *new_nodes = (struct prof_node*)
+            realloc(nodes, new_alloc * sizeof(struct prof_node));
+        if (!new_nodes)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        nodes = new_nodes;
+        nodes_alloc = new_alloc;
+    }
+
+    unsigned idx = n_nodes++;
+    struct prof_node *node = nodes + idx;
+    node->addr = addr;
+    node->kind = kind;
+    node->parent = parent;
+    node->first_child = 0;
+    node->n_samples = 0;
+
+    if (idx) {
+        node->next_sibling = nodes[parent].first_child;
+        nodes[parent].first_child = idx;
+    } else {
+        node->next_sibling = 0;
+    }
+
+    return idx;
+}
+
+static unsigned node_child(unsigned parent, enum node_kind kind,
+                           uint32_t addr) {
+    unsigned idx;
+    for (idx = nodes[parent].first_child; idx; idx = nodes[idx].next_sibling)
+        if (nodes[idx].addr == addr && nodes[idx].kind == kind)
+            return idx;
+    return node_alloc(parent, kind, addr);
+}
+
+static void reset_tree(void) {
+    n_nodes = 0;
+    n_samples_total = 0;
+    node_alloc(0, NODE_ROOT, 0);
+}
+
+static void take_sample(void) {
+    unsigned node = 0, depth;
+
+    if (shadow.depth) {
+        for (depth = 0; depth < shadow.depth; depth++)
+            node = node_child(node, NODE_CALL, frame_addr(shadow.dst[depth]));
+    } else {
+        node = node_child(node, NODE_PR,
+                          frame_addr(prof_sh4->reg[SH4_REG_PR]));
+    }
+
+    node = node_child(node, NODE_PC, frame_addr(prof_sh4->reg[SH4_REG_PC]));
+    nodes[node].n_samples++;
+    n_samples_total++;
+}
+
+static void sample_handler(struct SchedEvent *event) {
+    if (!guest_prof_enabled)
+        return;
+
+    take_sample();
+
+    sample_event.when = clock_cycle_stamp(prof_clk) + sample_period;
+    sched_event(prof_clk, &sample_event);
+}
+
+static void start(void) {
+    if (guest_prof_enabled)
+        return;
+
+    guest_prof_enabled = true;
+    shadow.depth = 0;
+
+    sample_event.when = clock_cycle_stamp(prof_clk) + sample_period;
+    sched_event(prof_clk, &sample_event);
+
+    LOG_INFO("guest profiler: sampling every %u microseconds\n",
+             (unsigned)(sample_period / (SCHED_FREQUENCY / 1000000)));
+}
+
+static void stop(void) {
+    if (!guest_prof_enabled)
+        return;
+
+    guest_prof_enabled = false;
+    if (sample_event.scheduled)
+        cancel_event(prof_clk, &sample_event);
+}
+
+static void put_frame_name(washdc_hostfile file, struct prof_node const *node) {
+    struct elf_sym const *sym = elf_syms_find(&syms, node->addr);
+    if (sym && sym->addr == node->addr)
+        washdc_hostfile_puts(file, sym->name);
+    else if (node->kind == NODE_PR)
+        washdc_hostfile_printf(file, "[pr 0x%08x]", (unsigned)node->addr);
+    else
+        washdc_hostfile_printf(file, "0x%08x", (unsigned)node->addr);
+}
+
+static void put_stack(washdc_hostfile file, unsigned idx) {
+    if (nodes[idx].parent) {
+        put_stack(file, nodes[idx].parent);
+        washdc_hostfile_putc(file, ';');
+    }
+    put_frame_name(file, nodes + idx);
+}
+
+static int write_profile(char const *path) {
+    washdc_hostfile file =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                             WASHDC_HOSTFILE_TEXT);
+    if (file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("%s - unable to open \"%s\"\n", __func__, path);
+        return -1;
+    }
+
+    unsigned idx;
+    for (idx = 1; idx < n_nodes; idx++) {
+        if (!nodes[idx].n_samples)
+            continue;
+        put_stack(file, idx);
+        washdc_hostfile_printf(file, " %llu\n",
+                               (unsigned long long)nodes[idx].n_samples);
+    }
+
+    washdc_hostfile_close(file);
+
+    LOG_INFO("guest profiler: wrote %llu samples to \"%s\"\n",
+             (unsigned long long)n_samples_total, path);
+    return 0;
+}
+
+void guest_prof_init(struct Sh4 *sh4, struct dc_clock *clk) {
+    prof_sh4 = sh4;
+    prof_clk = clk;
+
+    int interval_us = config_get_guest_prof_interval();
+    if (interval_us <= 0)
+        interval_us = GUEST_PROF_DEFAULT_INTERVAL_US;
+    sample_period = (SCHED_FREQUENCY / 1000000) * interval_us;
+
+    memset(&sample_event, 0, sizeof(sample_event));
+    sample_event.handler = sample_handler;
+    sample_event.name = "guest_prof";
+    sched_event_register(&sample_event, "guest_prof");
+
+    reset_tree();
+
+    char const *sym_path = config_get_guest_prof_syms();
+    if (sym_path && strlen(sym_path) && elf_syms_load(&syms, sym_path) == 0) {
+        LOG_INFO("guest profiler: %u function symbols from \"%s\"\n",
+                 syms.n_syms, sym_path);
+    }
+
+    char const *out_path = config_get_guest_prof_path();
+    if (out_path && strlen(out_path))
+        start();
+}
+
+void guest_prof_cleanup(void) {
+    stop();
+
+    char const *out_path = config_get_guest_prof_path();
+    if (out_path && strlen(out_path))
+        write_profile(out_path);
+
+    elf_syms_cleanup(&syms);
+
+    free(nodes);
+    nodes = NULL;
+    n_nodes = nodes_alloc = 0;
+}
+
+void guest_prof_request_start(void) {
+    washdc_mutex_lock(&pending_lock);
+    pending_start = true;
+    pending_stop = false;
+    washdc_mutex_unlock(&pending_lock);
+}
+
+void guest_prof_request_stop(void) {
+    washdc_mutex_lock(&pending_lock);
+    pending_stop = true;
+    pending_start = false;
+    washdc_mutex_unlock(&pending_lock);
+}
+
+void guest_prof_request_reset(void) {
+    washdc_mutex_lock(&pending_lock);
+    pending_reset = true;
+    washdc_mutex_unlock(&pending_lock);
+}
+
+void guest_prof_request_dump(char const *path) {
+    washdc_mutex_lock(&pending_lock);
+    strncpy(pending_dump_path, path, sizeof(pending_dump_path));
+    pending_dump_path[sizeof(pending_dump_path) - 1] = '\0';
+    pending_dump = true;
+    washdc_mutex_unlock(&pending_lock);
+}
+
+bool guest_prof_run_pending(void) {
+    char dump_path[CONFIG_STR_LEN];
+    bool do_start, do_stop, do_reset, do_dump;
+
+    washdc_mutex_lock(&pending_lock);
+    do_start = pending_start;
+    do_stop = pending_stop;
+    do_reset = pending_reset;
+    do_dump = pending_dump;
+    if (do_dump)
+        memcpy(dump_path, pending_dump_path, sizeof(dump_path));
+    pending_start = pending_stop = pending_reset = pending_dump = false;
+    washdc_mutex_unlock(&pending_lock);
+
+    if (do_dump)
+        write_profile(dump_path);
+    if (do_reset)
+        reset_tree();
+    if (do_stop)
+        stop();
+
+    bool started = false;
+    if (do_start && !guest_prof_enabled) {
+        start();
+        started = true;
+    }
+
+    // loading a save-state replaces the scheduler's event list
+    if (guest_prof_enabled && !sample_event.scheduled) {
+        sample_event.when = clock_cycle_stamp(prof_clk) + sample_period;
+        sched_event(prof_clk, &sample_event);
+    }
+
+    return started;
+}
+
+void guest_prof_on_call(void *cpu, uint32_t dst) {
+    if (!guest_prof_enabled)
+        return;
+
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
+
+    // when the stack is full, the outermost frame gets forgotten
+    if (shadow.depth == GUEST_PROF_MAX_DEPTH) {
+        memmove(shadow.dst, shadow.dst + 1,
+                (GUEST_PROF_MAX_DEPTH - 1) * sizeof(shadow.dst[0]));
+        memmove(shadow.ret, shadow.ret + 1,
+                (GUEST_PROF_MAX_DEPTH - 1) * sizeof(shadow.ret[0]));
+        shadow.depth--;
+    }
+
+    shadow.dst[shadow.depth] = dst;
+    shadow.ret[shadow.depth] = sh4->reg[SH4_REG_PR];
+    shadow.depth++;
+}
+
+void guest_prof_on_ret(void *cpu, uint32_t dst) {
+    if (!guest_prof_enabled)
+        return;
+
+    /*
+     * unwind to the frame that's being returned to.  If there isn't one then
+     * this is either a return from something that was called before the
+     * profiler started or some kind of trick with PR, so leave the stack
+     * alone.
+     */
+    unsigned depth = shadow.depth;
+    while (depth--) {
+        if (shadow.ret[depth] == dst) {
+            shadow.depth = depth;
+            return;
+        }
+    }
+}
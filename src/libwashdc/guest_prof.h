@@ -0,0 +1,86 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef GUEST_PROF_H_
+#define GUEST_PROF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * statistical guest profiler.
+ *
+ * While it's running, a scheduler event samples the SH4's PC every
+ * config_get_guest_prof_interval microseconds of guest time.  Each sample is
+ * filed under a shadow call stack that gets built from the JSR, BSR, BSRF and
+ * RTS instructions the SH4 executes, and the results are written out in the
+ * folded-stack format that flamegraph.pl, speedscope and friends all read.
+ *
+ * Because the jit only stops between blocks, samples land at block
+ * boundaries rather than on arbitrary instructions.
+ *
+ * If config_get_guest_prof_syms names an SH ELF (homebrew usually has one),
+ * its function symbols are used to name the frames; otherwise they're just
+ * addresses.
+ */
+
+struct Sh4;
+struct dc_clock;
+
+/*
+ * this is checked by the call/return hooks and by the jit when it decides
+ * whether to emit them.  Only the emulation thread changes it.
+ */
+extern bool guest_prof_enabled;
+
+void guest_prof_init(struct Sh4 *sh4, struct dc_clock *clk);
+
+// writes the profile to config_get_guest_prof_path if that's set
+void guest_prof_cleanup(void);
+
+/*
+ * these can be called from any thread.  They take effect the next time the
+ * emulation thread calls guest_prof_run_pending.
+ */
+void guest_prof_request_start(void);
+void guest_prof_request_stop(void);
+void guest_prof_request_reset(void);
+void guest_prof_request_dump(char const *path);
+
+/*
+ * carry out pending requests.  This should only be called from the emulation
+ * thread, between frames.  Returns true if the profiler just started, in
+ * which case the caller needs to throw out the jit's code cache so that every
+ * block gets recompiled with the call/return hooks.
+ */
+bool guest_prof_run_pending(void);
+
+/*
+ * hooks for the SH4's calls and returns.  on_call should be called after PR
+ * has been set to the return address, with the address being called.  on_ret
+ * gets called with the address being returned to.  These have the signature
+ * of jit_call_func callbacks so the jit can call them directly.
+ */
+void guest_prof_on_call(void *cpu, uint32_t dst);
+void guest_prof_on_ret(void *cpu, uint32_t dst);
+
+#endif
@@ -0,0 +1,386 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/MemoryMap.h"
+#include "hw/sh4/sh4.h"
+#include "jit/code_cache.h"
+#include "memory.h"
+#include "elf_syms.h"
+#include "config.h"
+#include "log.h"
+
+#include "hle_func.h"
+
+/*
+ * anything shorter than this is likely to show up inside unrelated code, and
+ * anything longer doesn't make the match any more certain.
+ */
+#define HLE_FUNC_SIG_MIN_WORDS 6
+#define HLE_FUNC_SIG_MAX_WORDS 16
+
+#define HLE_FUNC_ADDR_MASK 0x1fffffff
+
+enum hle_func_fpu {
+    HLE_FUNC_FPU_ANY,
+    HLE_FUNC_FPU_SINGLE,
+    HLE_FUNC_FPU_DOUBLE
+};
+
+struct hle_func_impl {
+    char const *name;
+
+    // returns an estimate of how many sh4 cycles the guest routine takes
+    unsigned (*exec)(struct Sh4 *sh4);
+
+    enum hle_func_fpu fpu;
+};
+
+struct hle_func_sig {
+    unsigned impl;
+    unsigned n_words;
+    uint16_t words[HLE_FUNC_SIG_MAX_WORDS];
+    uint16_t masks[HLE_FUNC_SIG_MAX_WORDS];
+};
+
+uint32_t hle_func_cycles;
+
+static struct hle_func_sig *sigs;
+static unsigned n_sigs;
+
+/*
+ * host pointer to the len bytes of main RAM at addr, or NULL if they aren't
+ * all in RAM.  *ram_offs is set to where they start in RAM.
+ */
+static uint8_t *ram_ptr(struct Sh4 *sh4, uint32_t addr, uint32_t len,
+                        uint32_t *ram_offs) {
+    if (!len || len > MEMORY_SIZE)
+        return NULL;
+
+    addr &= HLE_FUNC_ADDR_MASK;
+    struct memory_map_region *region =
+        memory_map_get_region(sh4->mem.map, addr, len);
+    if (!region || region->id != MEMORY_MAP_REGION_RAM || !region->host)
+        return NULL;
+
+    // the range can't wrap around to the start of a mirror
+    uint32_t offs = addr & region->mask;
+    if ((uint64_t)offs + (len - 1) > region->mask)
+        return NULL;
+
+    *ram_offs = offs;
+    return region->host + offs;
+}
+
+static void notify_write(uint32_t ram_offs, uint32_t len) {
+    code_cache_notify_ram_range(ram_offs, ram_offs + (len - 1));
+}
+
+static void guest_move(struct Sh4 *sh4, uint32_t dst, uint32_t src,
+                       uint32_t len) {
+    uint32_t dst_offs, src_offs;
+    uint8_t *dst_ptr = ram_ptr(sh4, dst, len, &dst_offs);
+    uint8_t const *src_ptr = ram_ptr(sh4, src, len, &src_offs);
+
+    if (dst_ptr && src_ptr) {
+        memmove(dst_ptr, src_ptr, len);
+        notify_write(dst_offs, len);
+    } else if (dst - src >= len) {
+        uint32_t idx;
+        for (idx = 0; idx < len; idx++) {
+            memory_map_write_8(sh4->mem.map, dst + idx,
+                               memory_map_read_8(sh4->mem.map, src + idx));
+        }
+    } else {
+        // dst overlaps the end of src, so go backwards
+        uint32_t idx = len;
+        while (idx--) {
+            memory_map_write_8(sh4->mem.map, dst + idx,
+                               memory_map_read_8(sh4->mem.map, src + idx));
+        }
+    }
+}
+
+/*
+ * the cycle estimates below are for the usual compiled loops: one longword
+ * every two cycles when everything is aligned, and two cycles per byte when
+ * it isn't.
+ */
+static unsigned hle_move(struct Sh4 *sh4) {
+    uint32_t dst = *sh4_gen_reg(sh4, 4);
+    uint32_t src = *sh4_gen_reg(sh4, 5);
+    uint32_t len = *sh4_gen_reg(sh4, 6);
+
+    if (len)
+        guest_move(sh4, dst, src, len);
+    *sh4_gen_reg(sh4, 0) = dst;
+
+    if (!((dst | src | len) & 3))
+        return 12 + len / 2;
+    return 12 + 2 * len;
+}
+
+static unsigned hle_memset(struct Sh4 *sh4) {
+    uint32_t dst = *sh4_gen_reg(sh4, 4);
+    uint8_t val = *sh4_gen_reg(sh4, 5);
+    uint32_t len = *sh4_gen_reg(sh4, 6);
+
+    if (len) {
+        uint32_t dst_offs;
+        uint8_t *dst_ptr = ram_ptr(sh4, dst, len, &dst_offs);
+        if (dst_ptr) {
+            memset(dst_ptr, val, len);
+            notify_write(dst_offs, len);
+        } else {
+            uint32_t idx;
+            for (idx = 0; idx < len; idx++)
+                memory_map_write_8(sh4->mem.map, dst + idx, val);
+        }
+    }
+    *sh4_gen_reg(sh4, 0) = dst;
+
+    if (!((dst | len) & 3))
+        return 12 + len / 4;
+    return 12 + len;
+}
+
+static unsigned hle_strlen(struct Sh4 *sh4) {
+    uint32_t str = *sh4_gen_reg(sh4, 4);
+    uint32_t len = 0;
+
+    uint32_t offs;
+    uint8_t const *ptr = ram_ptr(sh4, str, 1, &offs);
+    uint8_t const *end = ptr ? memchr(ptr, 0, MEMORY_SIZE - offs) : NULL;
+    if (end) {
+        len = end - ptr;
+    } else {
+        // a string that runs off the end of RAM or that's somewhere else
+        while (len < MEMORY_SIZE &&
+               memory_map_read_8(sh4->mem.map, str + len))
+            len++;
+    }
+
+    *sh4_gen_reg(sh4, 0) = len;
+    return 8 + 2 * len;
+}
+
+static unsigned hle_sqrtf(struct Sh4 *sh4) {
+    *sh4_fpu_fr(sh4, 0) = sqrtf(*sh4_fpu_fr(sh4, 4));
+    return 24;
+}
+
+static unsigned hle_sqrt(struct Sh4 *sh4) {
+    *sh4_fpu_dr(sh4, 0) = sqrt(*sh4_fpu_dr(sh4, 2));
+    return 36;
+}
+
+/*
+ * the KallistiOS matrix routines keep the current matrix in XMTRX (XF0-XF15)
+ * for FTRV, and move it to and from memory with paired FMOVs in XF order.
+ */
+static unsigned hle_mat_identity(struct Sh4 *sh4) {
+    unsigned idx;
+    for (idx = 0; idx < 16; idx++)
+        *sh4_fpu_xf(sh4, idx) = (idx % 5) ? 0.0f : 1.0f;
+    return 16;
+}
+
+static unsigned hle_mat_load(struct Sh4 *sh4) {
+    uint32_t src = *sh4_gen_reg(sh4, 4);
+    uint32_t offs;
+    uint8_t const *ptr = ram_ptr(sh4, src, 64, &offs);
+    unsigned idx;
+    for (idx = 0; idx < 16; idx++) {
+        uint32_t val;
+        if (ptr)
+            memcpy(&val, ptr + 4 * idx, sizeof(val));
+        else
+            val = memory_map_read_32(sh4->mem.map, src + 4 * idx);
+        sh4->reg[SH4_REG_XF0 + idx] = val;
+    }
+    return 16;
+}
+
+static unsigned hle_mat_store(struct Sh4 *sh4) {
+    uint32_t dst = *sh4_gen_reg(sh4, 4);
+    uint32_t offs;
+    uint8_t *ptr = ram_ptr(sh4, dst, 64, &offs);
+    unsigned idx;
+    for (idx = 0; idx < 16; idx++) {
+        uint32_t val = sh4->reg[SH4_REG_XF0 + idx];
+        if (ptr)
+            memcpy(ptr + 4 * idx, &val, sizeof(val));
+        else
+            memory_map_write_32(sh4->mem.map, dst + 4 * idx, val);
+    }
+    if (ptr)
+        notify_write(offs, 64);
+    return 16;
+}
+
+static struct hle_func_impl const impls[] = {
+    { "memcpy", hle_move, HLE_FUNC_FPU_ANY },
+    { "memmove", hle_move, HLE_FUNC_FPU_ANY },
+    { "memset", hle_memset, HLE_FUNC_FPU_ANY },
+    { "strlen", hle_strlen, HLE_FUNC_FPU_ANY },
+    { "sqrtf", hle_sqrtf, HLE_FUNC_FPU_SINGLE },
+    { "sqrt", hle_sqrt, HLE_FUNC_FPU_DOUBLE },
+    { "mat_identity", hle_mat_identity, HLE_FUNC_FPU_ANY },
+    { "mat_load", hle_mat_load, HLE_FUNC_FPU_ANY },
+    { "mat_store", hle_mat_store, HLE_FUNC_FPU_ANY }
+};
+
+#define N_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+static int find_impl(char const *name) {
+    // older SH toolchains put an underscore in front of C names
+    if (name[0] == '_')
+        name++;
+
+    unsigned idx;
+    for (idx = 0; idx < N_IMPLS; idx++)
+        if (strcmp(impls[idx].name, name) == 0)
+            return idx;
+    return -1;
+}
+
+static uint16_t sig_mask(uint16_t inst) {
+    // BRA and BSR
+    if ((inst & 0xe000) == 0xa000)
+        return 0xf000;
+    return 0xffff;
+}
+
+static void add_sig(struct elf_syms const *syms, struct elf_sym const *sym,
+                    unsigned impl) {
+    if (sym->file_offs == ELF_SYM_NO_DATA ||
+        sym->len < HLE_FUNC_SIG_MIN_WORDS * 2)
+        return;
+
+    struct hle_func_sig sig = { .impl = impl };
+    sig.n_words = sym->len / 2;
+    if (sig.n_words > HLE_FUNC_SIG_MAX_WORDS)
+        sig.n_words = HLE_FUNC_SIG_MAX_WORDS;
+
+    unsigned idx;
+    for (idx = 0; idx < sig.n_words; idx++) {
+        uint8_t const *ptr = syms->dat + sym->file_offs + 2 * idx;
+        sig.words[idx] = ptr[0] | (ptr[1] << 8);
+        sig.masks[idx] = sig_mask(sig.words[idx]);
+        sig.words[idx] &= sig.masks[idx];
+    }
+
+    // the same routine can be in the file more than once
+    for (idx = 0; idx < n_sigs; idx++) {
+        if (sigs[idx].n_words == sig.n_words &&
+            !memcmp(sigs[idx].words, sig.words, sizeof(sig.words))) {
+            if (sigs[idx].impl != impl) {
+                LOG_WARN("%s - %s and %s have the same signature\n", __func__,
+                         impls[sigs[idx].impl].name, impls[impl].name);
+            }
+            return;
+        }
+    }
+
+    struct hle_func_sig *new_sigs = (struct hle_func_sig*)
+        realloc(sigs, (n_sigs + 1) * sizeof(struct hle_func_sig));
+    if (!new_sigs)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    sigs = new_sigs;
+    sigs[n_sigs++] = sig;
+
+    LOG_INFO("HLE: %s signature from %s (%u instructions)\n",
+             impls[impl].name, sym->name, sig.n_words);
+}
+
+void hle_func_init(void) {
+    char const *path = config_get_hle_func_syms();
+    if (!path || !strlen(path))
+        return;
+
+    struct elf_syms syms;
+    if (elf_syms_load(&syms, path) != 0)
+        return;
+
+    unsigned idx;
+    for (idx = 0; idx < syms.n_syms; idx++) {
+        int impl = find_impl(syms.syms[idx].name);
+        if (impl >= 0)
+            add_sig(&syms, syms.syms + idx, impl);
+    }
+
+    elf_syms_cleanup(&syms);
+}
+
+void hle_func_cleanup(void) {
+    free(sigs);
+    sigs = NULL;
+    n_sigs = 0;
+}
+
+int hle_func_match(struct Sh4 *sh4, uint32_t addr, bool pr_bit,
+                   unsigned *n_bytes) {
+    if (!n_sigs)
+        return -1;
+
+#ifdef ENABLE_MMU
+    if (sh4_mmu_at(sh4))
+        return -1;
+#endif
+
+    uint32_t offs;
+    uint8_t const *code =
+        ram_ptr(sh4, addr, HLE_FUNC_SIG_MAX_WORDS * 2, &offs);
+    if (!code)
+        return -1;
+
+    unsigned sig_no;
+    for (sig_no = 0; sig_no < n_sigs; sig_no++) {
+        struct hle_func_sig const *sig = sigs + sig_no;
+        enum hle_func_fpu fpu = impls[sig->impl].fpu;
+        if ((fpu == HLE_FUNC_FPU_SINGLE && pr_bit) ||
+            (fpu == HLE_FUNC_FPU_DOUBLE && !pr_bit))
+            continue;
+
+        unsigned idx;
+        for (idx = 0; idx < sig->n_words; idx++) {
+            uint16_t inst = code[2 * idx] | (code[2 * idx + 1] << 8);
+            if ((inst & sig->masks[idx]) != sig->words[idx])
+                break;
+        }
+        if (idx == sig->n_words) {
+            *n_bytes = sig->n_words * 2;
+            return sig->impl;
+        }
+    }
+
+    return -1;
+}
+
+void hle_func_exec(void *cpu, uint32_t func) {
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
+    hle_func_cycles = impls[func].exec(sh4) * SH4_CLOCK_SCALE;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef HLE_FUNC_H_
+#define HLE_FUNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * high-level emulation of guest library routines (memcpy, memset, strlen,
+ * sqrt and the KallistiOS matrix helpers).  The jit checks the start of every
+ * block it compiles against a list of signatures, and when one matches it
+ * compiles the whole routine as a call to hle_func_exec followed by a return
+ * through PR.
+ *
+ * The signatures come from the ELF named by config_get_hle_func_syms, which
+ * can be anything linked against (or part of) the same library build as the
+ * game: the game's own unstripped executable or the library's object files.
+ * A signature is the first few instructions of the routine, with the
+ * displacements of BRA and BSR masked off since those change with where the
+ * routine gets linked.
+ *
+ * The host implementations work on main RAM directly when the whole range is
+ * in RAM, and go through the memory map one byte at a time otherwise.  Each
+ * call leaves an estimate of what the guest routine would have cost in
+ * hle_func_cycles, which the jit block adds to its cycle count (see
+ * il_code_block.dyn_cycles).
+ */
+
+struct Sh4;
+
+// scheduler cycles the last hle_func_exec call took
+extern uint32_t hle_func_cycles;
+
+void hle_func_init(void);
+void hle_func_cleanup(void);
+
+/*
+ * returns the index of the routine whose signature matches the code at addr,
+ * or -1.  pr_bit is FPSCR.PR for the block being compiled; routines which
+ * take floating-point arguments only match under the precision they were
+ * written for.  n_bytes is set to the length of the signature so the code
+ * cache can drop the block if the routine gets overwritten.
+ */
+int hle_func_match(struct Sh4 *sh4, uint32_t addr, bool pr_bit,
+                   unsigned *n_bytes);
+
+// run the routine hle_func_match returned.  This is called from jit code.
+void hle_func_exec(void *cpu, uint32_t func);
+
+#endif
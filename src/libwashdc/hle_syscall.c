@@ -0,0 +1,427 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "log.h"
+#include "mount.h"
+#include "cdrom.h"
+#include "mem_areas.h"
+#include "dreamcast.h"
+#include "hw/sh4/sh4.h"
+
+#include "hle_syscall.h"
+
+/*
+ * High-level emulation of the firmware's system calls.
+ *
+ * Each system call vector points to a three-instruction stub: the HLE opcode,
+ * RTS and a NOP in the delay slot.  The HLE opcode is handled by
+ * hle_syscall_dispatch, which identifies the system call based on which stub
+ * it was issued from and leaves the return value in R0.  Everything completes
+ * synchronously, so a GD-ROM command has already finished by the time the
+ * program checks on it.
+ *
+ * Like deep_syscall_trace.c, names and indices of these system calls were
+ * obtained from Marcus Comstedt's page at http://mc.pp.se/dc/syscalls.html .
+ */
+
+// the GD-ROM stub comes first, see HLE_STUB_FIRST
+enum hle_vector {
+    HLE_VECTOR_GDROM,
+    HLE_VECTOR_SYSINFO,
+    HLE_VECTOR_ROMFONT,
+    HLE_VECTOR_FLASHROM,
+    HLE_VECTOR_MISC,
+
+    HLE_VECTOR_COUNT
+};
+
+// offset of each vector relative to ADDR_SYSCALLS
+static unsigned const vector_offs[HLE_VECTOR_COUNT] = {
+    [HLE_VECTOR_GDROM] = 0xbc,
+    [HLE_VECTOR_SYSINFO] = 0xb0,
+    [HLE_VECTOR_ROMFONT] = 0xb4,
+    [HLE_VECTOR_FLASHROM] = 0xb8,
+    [HLE_VECTOR_MISC] = 0xe0
+};
+
+/*
+ * the stubs go where the firmware keeps its GD-ROM system call code, so that
+ * the GD-ROM vector has the same value it would have on real hardware.
+ */
+#define HLE_STUB_FIRST (ADDR_SYSCALLS + 0x1000)
+#define HLE_STUB_LEN 0x10
+
+#define HLE_ADDR_SYSINFO_ID  0x8c000068
+#define HLE_ADDR_ROMFONT     0xa0100020
+
+// flash partitions, relative to the start of flash memory
+#define HLE_FLASH_ADDR  (0xa0000000 | ADDR_FLASH_FIRST)
+#define HLE_FLASH_PART_COUNT 5
+static uint32_t const flash_parts[HLE_FLASH_PART_COUNT][2] = {
+    { 0x1a000, 0x2000 }, // factory
+    { 0x18000, 0x2000 }, // reserved
+    { 0x1c000, 0x4000 }, // user
+    { 0x10000, 0x8000 }, // game
+    { 0x00000, 0x10000 } // unknown
+};
+
+#define GDROM_CMD_READ_PIO     16
+#define GDROM_CMD_READ_DMA     17
+#define GDROM_CMD_GET_TOC      18
+#define GDROM_CMD_GET_TOC_2    19
+#define GDROM_CMD_PLAY         20
+#define GDROM_CMD_PLAY_2       21
+#define GDROM_CMD_PAUSE        22
+#define GDROM_CMD_RELEASE      23
+#define GDROM_CMD_INIT         24
+#define GDROM_CMD_SEEK         27
+#define GDROM_CMD_STOP         33
+
+#define GDROM_STAT_PAUSE   1
+#define GDROM_STAT_NO_DISC 7
+
+#define GDROM_CMD_STAT_FAILED    -1
+#define GDROM_CMD_STAT_NONE       0
+#define GDROM_CMD_STAT_COMPLETED  2
+
+// sense keys reported through CHECK_COMMAND
+#define GDROM_ERR_NOT_READY       2
+#define GDROM_ERR_ILLEGAL_REQUEST 5
+
+static struct memory_map *mem_map;
+static bool enabled;
+
+/*
+ * only the most recent GD-ROM command is tracked since every command finishes
+ * before SEND_COMMAND returns.
+ */
+static struct hle_gdrom_req {
+    uint32_t id;
+    int stat;
+    uint32_t err;
+    uint32_t n_bytes;
+} gdrom_req;
+static uint32_t gdrom_next_id;
+
+static uint8_t sector_buf[CDROM_FRAME_DATA_SIZE];
+
+static void put16(uint8_t *dst, uint16_t val) {
+    dst[0] = val & 0xff;
+    dst[1] = val >> 8;
+}
+
+static void put32(uint8_t *dst, uint32_t val) {
+    put16(dst, val & 0xffff);
+    put16(dst + 2, val >> 16);
+}
+
+void hle_syscall_init(struct memory_map *map) {
+    mem_map = map;
+    enabled = false;
+    memset(&gdrom_req, 0, sizeof(gdrom_req));
+    gdrom_next_id = 1;
+}
+
+void hle_syscall_cleanup(void) {
+    mem_map = NULL;
+    enabled = false;
+}
+
+bool hle_syscall_enabled(void) {
+    return enabled;
+}
+
+void hle_syscall_build(uint8_t *image) {
+    memset(image, 0, LEN_SYSCALLS);
+
+    unsigned vec;
+    for (vec = 0; vec < HLE_VECTOR_COUNT; vec++) {
+        uint32_t stub = HLE_STUB_FIRST + vec * HLE_STUB_LEN;
+        uint8_t *stubp = image + (stub - ADDR_SYSCALLS);
+
+        put32(image + vector_offs[vec], stub);
+        put16(stubp, HLE_SYSCALL_OPCODE);
+        put16(stubp + 2, 0x000b); // RTS
+        put16(stubp + 4, 0x0009); // NOP
+    }
+
+    enabled = true;
+}
+
+static void copy_to_guest(uint32_t dst, uint8_t const *src, unsigned len) {
+    while (len--)
+        memory_map_write_8(mem_map, dst++, *src++);
+}
+
+static void copy_from_guest(uint8_t *dst, uint32_t src, unsigned len) {
+    while (len--)
+        *dst++ = memory_map_read_8(mem_map, src++);
+}
+
+static int32_t hle_sysinfo(Sh4 *sh4) {
+    uint8_t id[8];
+
+    switch (*sh4_gen_reg(sh4, 7)) {
+    case 0:
+        // SYSINFO_INIT: copy the system ID out of the factory partition
+        copy_from_guest(id, HLE_FLASH_ADDR + 0x1a056, sizeof(id));
+        copy_to_guest(HLE_ADDR_SYSINFO_ID, id, sizeof(id));
+        return 0;
+    case 3:
+        // SYSINFO_ID
+        return HLE_ADDR_SYSINFO_ID;
+    default:
+        LOG_WARN("%s - unsupported SYSINFO call %u\n", __func__,
+                 (unsigned)*sh4_gen_reg(sh4, 7));
+        return -1;
+    }
+}
+
+static int32_t hle_romfont(Sh4 *sh4) {
+    switch (*sh4_gen_reg(sh4, 1)) {
+    case 0:
+        // ROMFONT_ADDRESS
+        return HLE_ADDR_ROMFONT;
+    case 1:
+    case 2:
+        // ROMFONT_LOCK and ROMFONT_UNLOCK; nothing else ever holds the lock
+        return 0;
+    default:
+        LOG_WARN("%s - unsupported ROMFONT call %u\n", __func__,
+                 (unsigned)*sh4_gen_reg(sh4, 1));
+        return -1;
+    }
+}
+
+static int32_t hle_flashrom(Sh4 *sh4) {
+    uint32_t r4 = *sh4_gen_reg(sh4, 4);
+    uint32_t r5 = *sh4_gen_reg(sh4, 5);
+    uint32_t r6 = *sh4_gen_reg(sh4, 6);
+
+    switch (*sh4_gen_reg(sh4, 7)) {
+    case 0:
+        // FLASHROM_INFO
+        if (r4 >= HLE_FLASH_PART_COUNT)
+            return -1;
+        memory_map_write_32(mem_map, r5, flash_parts[r4][0]);
+        memory_map_write_32(mem_map, r5 + 4, flash_parts[r4][1]);
+        return 0;
+    case 1:
+        // FLASHROM_READ
+        while (r6--)
+            memory_map_write_8(mem_map, r5++,
+                               memory_map_read_8(mem_map,
+                                                 HLE_FLASH_ADDR + r4++));
+        return 0;
+    default:
+        /*
+         * writing and erasing would have to go through flash_mem's command
+         * state machine; programs that need to save will have to boot the
+         * real firmware.
+         */
+        LOG_WARN("%s - unsupported FLASHROM call %u\n", __func__,
+                 (unsigned)*sh4_gen_reg(sh4, 7));
+        return -1;
+    }
+}
+
+static void gdrom_cmd_fail(uint32_t err) {
+    gdrom_req.stat = GDROM_CMD_STAT_FAILED;
+    gdrom_req.err = err;
+}
+
+static void gdrom_cmd_read(uint32_t params) {
+    uint32_t fad = memory_map_read_32(mem_map, params);
+    uint32_t n_sectors = memory_map_read_32(mem_map, params + 4);
+    uint32_t dst = memory_map_read_32(mem_map, params + 8);
+
+    while (n_sectors--) {
+        if (mount_read_sectors(sector_buf, fad++, 1) < 0) {
+            gdrom_cmd_fail(GDROM_ERR_ILLEGAL_REQUEST);
+            return;
+        }
+        copy_to_guest(dst, sector_buf, CDROM_FRAME_DATA_SIZE);
+        dst += CDROM_FRAME_DATA_SIZE;
+        gdrom_req.n_bytes += CDROM_FRAME_DATA_SIZE;
+    }
+}
+
+static void gdrom_cmd_get_toc(uint32_t params) {
+    uint32_t area = memory_map_read_32(mem_map, params);
+    uint32_t dst = memory_map_read_32(mem_map, params + 4);
+    struct mount_toc toc;
+
+    memset(&toc, 0, sizeof(toc));
+    if (mount_read_toc(&toc, area) < 0) {
+        gdrom_cmd_fail(GDROM_ERR_ILLEGAL_REQUEST);
+        return;
+    }
+
+    copy_to_guest(dst, mount_encode_toc(&toc), CDROM_TOC_SIZE);
+    gdrom_req.n_bytes = CDROM_TOC_SIZE;
+}
+
+// returns the request ID, or 0 if the command was not accepted
+static int32_t gdrom_send_command(uint32_t cmd, uint32_t params) {
+    memset(&gdrom_req, 0, sizeof(gdrom_req));
+    gdrom_req.id = gdrom_next_id++;
+    if (!gdrom_next_id)
+        gdrom_next_id = 1;
+    gdrom_req.stat = GDROM_CMD_STAT_COMPLETED;
+
+    if (!mount_check()) {
+        gdrom_cmd_fail(GDROM_ERR_NOT_READY);
+        return gdrom_req.id;
+    }
+
+    switch (cmd) {
+    case GDROM_CMD_READ_PIO:
+    case GDROM_CMD_READ_DMA:
+        gdrom_cmd_read(params);
+        break;
+    case GDROM_CMD_GET_TOC:
+    case GDROM_CMD_GET_TOC_2:
+        gdrom_cmd_get_toc(params);
+        break;
+    case GDROM_CMD_PLAY:
+    case GDROM_CMD_PLAY_2:
+    case GDROM_CMD_PAUSE:
+    case GDROM_CMD_RELEASE:
+    case GDROM_CMD_INIT:
+    case GDROM_CMD_SEEK:
+    case GDROM_CMD_STOP:
+        // there's no CD audio or head position to speak of
+        break;
+    default:
+        LOG_WARN("%s - unsupported GD-ROM command %u\n",
+                 __func__, (unsigned)cmd);
+        gdrom_cmd_fail(GDROM_ERR_ILLEGAL_REQUEST);
+    }
+
+    return gdrom_req.id;
+}
+
+static int32_t gdrom_check_command(uint32_t id, uint32_t stat_out) {
+    if (!id || id != gdrom_req.id)
+        return GDROM_CMD_STAT_NONE;
+
+    memory_map_write_32(mem_map, stat_out, gdrom_req.err);
+    memory_map_write_32(mem_map, stat_out + 4, 0);
+    memory_map_write_32(mem_map, stat_out + 8, gdrom_req.n_bytes);
+    memory_map_write_32(mem_map, stat_out + 12, 0);
+
+    return gdrom_req.stat;
+}
+
+static int32_t gdrom_check_drive(uint32_t out) {
+    if (mount_check()) {
+        memory_map_write_32(mem_map, out, GDROM_STAT_PAUSE);
+        memory_map_write_32(mem_map, out + 4,
+                            (uint32_t)mount_get_disc_type() << 4);
+    } else {
+        memory_map_write_32(mem_map, out, GDROM_STAT_NO_DISC);
+        memory_map_write_32(mem_map, out + 4, 0);
+    }
+    return 0;
+}
+
+static int32_t hle_gdrom(Sh4 *sh4) {
+    uint32_t r4 = *sh4_gen_reg(sh4, 4);
+    uint32_t r5 = *sh4_gen_reg(sh4, 5);
+    int32_t r6 = *sh4_gen_reg(sh4, 6);
+    uint32_t r7 = *sh4_gen_reg(sh4, 7);
+
+    if (r6 == -1) {
+        // MISC_INIT and MISC_SETVECTOR
+        return 0;
+    } else if (r6 != 0) {
+        LOG_WARN("%s - unsupported GD-ROM super-function %d\n",
+                 __func__, (int)r6);
+        return -1;
+    }
+
+    switch (r7) {
+    case 0:
+        // SEND_COMMAND
+        return gdrom_send_command(r4, r5);
+    case 1:
+        // CHECK_COMMAND
+        return gdrom_check_command(r4, r5);
+    case 4:
+        // CHECK_DRIVE
+        return gdrom_check_drive(r4);
+    case 2:  // MAINLOOP
+    case 3:  // INIT
+    case 6:  // DMA_BEGIN
+    case 7:  // DMA_CHECK
+    case 8:  // ABORT
+    case 9:  // RESET
+    case 10: // SECTOR_MODE
+        return 0;
+    default:
+        LOG_WARN("%s - unsupported GD-ROM call %u\n", __func__, (unsigned)r7);
+        return -1;
+    }
+}
+
+static int32_t hle_misc(Sh4 *sh4) {
+    /*
+     * the only thing programs use this for is exiting to the firmware's menu,
+     * and there's no firmware to exit to.
+     */
+    LOG_WARN("%s - unsupported system call %d\n",
+             __func__, (int)*sh4_gen_reg(sh4, 4));
+    return -1;
+}
+
+int hle_syscall_dispatch(struct Sh4 *sh4, uint32_t pc) {
+    if (!enabled || !mem_map)
+        return -1;
+
+    uint32_t offs = (pc & ADDR_AREA3_MASK) - (HLE_STUB_FIRST & ADDR_AREA3_MASK);
+    if (offs % HLE_STUB_LEN || offs / HLE_STUB_LEN >= HLE_VECTOR_COUNT)
+        return -1;
+
+    int32_t ret;
+    switch ((enum hle_vector)(offs / HLE_STUB_LEN)) {
+    case HLE_VECTOR_GDROM:
+        ret = hle_gdrom(sh4);
+        break;
+    case HLE_VECTOR_SYSINFO:
+        ret = hle_sysinfo(sh4);
+        break;
+    case HLE_VECTOR_ROMFONT:
+        ret = hle_romfont(sh4);
+        break;
+    case HLE_VECTOR_FLASHROM:
+        ret = hle_flashrom(sh4);
+        break;
+    default:
+        ret = hle_misc(sh4);
+    }
+
+    *sh4_gen_reg(sh4, 0) = ret;
+    return 0;
+}
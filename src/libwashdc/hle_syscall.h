@@ -0,0 +1,60 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef HLE_SYSCALL_H_
+#define HLE_SYSCALL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "washdc/MemoryMap.h"
+
+/*
+ * high-level emulation of the firmware's system calls.  This is used when
+ * direct-booting without a syscalls.bin dump.  hle_syscall_build fills in a
+ * LEN_SYSCALLS-byte image that gets loaded at ADDR_SYSCALLS in place of the
+ * dump; every system call vector in that image points to a stub that issues
+ * HLE_SYSCALL_OPCODE, which the sh4 forwards to hle_syscall_dispatch.
+ */
+
+/*
+ * this opcode is undefined on real hardware; the sh4 only treats it as a
+ * system call trap when hle_syscall_enabled returns true.
+ */
+#define HLE_SYSCALL_OPCODE 0xfffd
+
+struct Sh4;
+
+void hle_syscall_init(struct memory_map *map);
+void hle_syscall_cleanup(void);
+
+// fill in a system call image of LEN_SYSCALLS bytes
+void hle_syscall_build(uint8_t *image);
+
+bool hle_syscall_enabled(void);
+
+/*
+ * called by the sh4 when it executes HLE_SYSCALL_OPCODE.  pc is the address of
+ * the opcode.  Returns 0 if pc belongs to a known stub, else -1.
+ */
+int hle_syscall_dispatch(struct Sh4 *sh4, uint32_t pc);
+
+#endif
@@ -0,0 +1,101 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "hostmem.h"
+
+#define HUGE_PAGE_MASK ((uintptr_t)HOSTMEM_HUGE_PAGE_SIZE - 1)
+
+static size_t huge_round_up(size_t len) {
+    return (len + HUGE_PAGE_MASK) & ~(size_t)HUGE_PAGE_MASK;
+}
+
+#ifdef _WIN32
+
+// large pages need special privileges on Windows, so don't bother
+void *hostmem_alloc(size_t len) {
+    return calloc(1, len);
+}
+
+void hostmem_free(void *ptr, size_t len) {
+    free(ptr);
+}
+
+void hostmem_advise_huge(void *ptr, size_t len) {
+}
+
+#else
+
+void *hostmem_alloc(size_t len) {
+    len = huge_round_up(len);
+
+#ifdef MAP_HUGETLB
+    void *huge = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED)
+        return huge;
+#endif
+
+    /*
+     * no huge pages were reserved, so map extra and trim the ends off to get
+     * something aligned that transparent huge pages can be used for.
+     */
+    size_t map_len = len + HOSTMEM_HUGE_PAGE_SIZE;
+    uint8_t *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    uint8_t *ptr = (uint8_t*)(((uintptr_t)map + HUGE_PAGE_MASK) &
+                              ~HUGE_PAGE_MASK);
+    size_t head = ptr - map;
+    size_t tail = map_len - head - len;
+    if (head)
+        munmap(map, head);
+    if (tail)
+        munmap(ptr + len, tail);
+
+    hostmem_advise_huge(ptr, len);
+    return ptr;
+}
+
+void hostmem_free(void *ptr, size_t len) {
+    if (ptr)
+        munmap(ptr, huge_round_up(len));
+}
+
+void hostmem_advise_huge(void *ptr, size_t len) {
+#ifdef MADV_HUGEPAGE
+    uintptr_t first = ((uintptr_t)ptr + HUGE_PAGE_MASK) & ~HUGE_PAGE_MASK;
+    uintptr_t last = ((uintptr_t)ptr + len) & ~HUGE_PAGE_MASK;
+    if (last > first)
+        madvise((void*)first, last - first, MADV_HUGEPAGE);
+#endif
+}
+
+#endif
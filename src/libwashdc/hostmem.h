@@ -0,0 +1,55 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef HOSTMEM_H_
+#define HOSTMEM_H_
+
+/*
+ * hostmem.h
+ *
+ * Allocation of the big emulated memories (guest RAM, VRAM, wave memory and
+ * the jit's code arena).  These get accessed all over the place, so they're
+ * aligned to HOSTMEM_HUGE_PAGE_SIZE and backed by huge pages when the host
+ * allows it to cut down on TLB misses.  Explicit huge pages (MAP_HUGETLB) are
+ * tried first, then transparent huge pages, then normal pages.
+ */
+
+#include <stddef.h>
+
+#define HOSTMEM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/*
+ * returns len bytes of zeroed memory, or NULL if the allocation failed.  The
+ * memory must be freed with hostmem_free and the same len.
+ */
+void *hostmem_alloc(size_t len);
+
+void hostmem_free(void *ptr, size_t len);
+
+/*
+ * ask the host to back whichever whole huge pages fall inside the given
+ * mapping with transparent huge pages.  This is for mappings that can't come
+ * from hostmem_alloc because they're shared or executable.  It does nothing
+ * if the host doesn't support it.
+ */
+void hostmem_advise_huge(void *ptr, size_t len);
+
+#endif
@@ -42,8 +42,14 @@
 #include "adpcm.h"
 #include "intmath.h"
 #include "compiler_bullshit.h"
+#include "bench.h"
+#include "perf_cnt.h"
+#include "hw/gdrom/cdda.h"
 
 #include "aica.h"
+#include "config.h"
+#include "dreamcast.h"
+#include "savestate.h"
 
 // fixed-point format used for attenuation scaling
 typedef uint32_t aica_atten;
@@ -64,6 +70,13 @@ typedef uint32_t aica_atten;
  */
 #define TICKS_PER_SAMPLE (SCHED_FREQUENCY / AICA_SAMPLE_FREQ)
 
+/*
+ * registers which don't depend on the rendered output don't make the AICA
+ * render anything, but the output isn't allowed to fall more than this many
+ * samples behind when the guest is polling them.
+ */
+#define AICA_SYNC_MAX_LAG (4 * AICA_SAMPLE_BLOCK_LEN)
+
 #define AICA_CHAN_PLAY_CTRL 0x0000
 #define AICA_CHAN_SAMPLE_ADDR_LOW 0x0004
 #define AICA_CHAN_LOOP_START 0x0008
@@ -228,6 +241,8 @@ static void aica_unsched_timer(struct aica *aica, unsigned tim_idx);
 static void aica_sched_timer(struct aica *aica, unsigned tim_idx);
 
 static void aica_sync_timer(struct aica *aica, unsigned tim_idx);
+static void aica_resched_timers(struct aica *aica);
+static void aica_raise_timer_ints(struct aica *aica, uint32_t mask);
 static dc_cycle_stamp_t aica_get_sample_count(struct aica *aica);
 
 static void
@@ -247,16 +262,38 @@ static unsigned aica_read_sci(struct aica *aica, unsigned bit);
 static char const *fmt_name(enum aica_fmt fmt);
 
 static void aica_sync(struct aica *aica);
+static void aica_sync_timers(struct aica *aica);
+static void aica_sync_samples(struct aica *aica);
 
 static unsigned aica_chan_effective_rate(struct aica const *aica, unsigned chan_no);
 
 static unsigned aica_samples_per_step(unsigned effective_rate, unsigned step_no);
 
-static void aica_process_sample(struct aica *aica);
-
 static int get_octave_signed(struct aica_chan const *chan);
 static aica_sample_pos get_sample_rate_multiplier(struct aica_chan const *chan);
 
+/*
+ * operations which can't be performed until the next timeslice boundary when
+ * the ARM7 is running on its own thread.
+ */
+#define AICA_DEFER_ARM7_RESET    (1 << 0)
+#define AICA_DEFER_CLEAR_FIQ     (1 << 1)
+#define AICA_DEFER_RAISE_SH4_INT (1 << 2)
+#define AICA_DEFER_CLEAR_SH4_INT (1 << 3)
+#define AICA_DEFER_TIMER(idx)    (1 << (4 + (idx)))
+#define AICA_DEFER_TIMER_SCHED   (1 << 7)
+
+/*
+ * returns true if op belongs to the other CPU's thread, in which case it gets
+ * recorded so that aica_sync_threads can do it later.
+ */
+static inline bool aica_defer(struct aica *aica, unsigned op) {
+    if (!aica->threaded)
+        return false;
+    aica->deferred |= op;
+    return true;
+}
+
 static void aica_chan_reset_adpcm(struct aica_chan *chan) {
     chan->step = 0;
     chan->predictor = 0;
@@ -286,7 +323,9 @@ void aica_init(struct aica *aica, struct arm7 *arm7,
     aica->arm7 = arm7;
 
     aica->aica_sh4_raise_event.handler = post_delay_raise_aica_sh4_int;
+    aica->aica_sh4_raise_event.name = "post_delay_raise_aica_sh4_int";
     aica->aica_sh4_raise_event.arg_ptr = aica;
+    sched_event_register(&aica->aica_sh4_raise_event, "aica_sh4_int");
 
     // HACK
     aica->int_enable = AICA_INT_TIMA_MASK;
@@ -299,21 +338,137 @@ void aica_init(struct aica *aica, struct arm7 *arm7,
     aica->sys_reg[AICA_SCILV2 / 4] = 0x08;
 
     aica->timers[0].evt.handler = aica_timer_a_handler;
+    aica->timers[0].evt.name = "aica_timer_a_handler";
     aica->timers[1].evt.handler = aica_timer_b_handler;
+    aica->timers[1].evt.name = "aica_timer_b_handler";
     aica->timers[2].evt.handler = aica_timer_c_handler;
+    aica->timers[2].evt.name = "aica_timer_c_handler";
     aica->timers[0].evt.arg_ptr = aica;
     aica->timers[1].evt.arg_ptr = aica;
     aica->timers[2].evt.arg_ptr = aica;
+    sched_event_register(&aica->timers[0].evt, "aica_timer_a");
+    sched_event_register(&aica->timers[1].evt, "aica_timer_b");
+    sched_event_register(&aica->timers[2].evt, "aica_timer_c");
 
     aica_sched_all_timers(aica);
 
     aica_wave_mem_init(&aica->mem);
+    aica_dsp_init(&aica->dsp);
+
+    washdc_mutex_init(&aica->lock);
 }
 
 void aica_cleanup(struct aica *aica) {
+    washdc_mutex_cleanup(&aica->lock);
     aica_wave_mem_cleanup(&aica->mem);
 }
 
+static int aica_state_xfer(struct savestate_buf *buf, struct aica *aica,
+                           bool load) {
+    return SAVESTATE_XFER(buf, load, aica->int_enable) ||
+        SAVESTATE_XFER(buf, load, aica->int_pending) ||
+        SAVESTATE_XFER(buf, load, aica->int_enable_sh4) ||
+        SAVESTATE_XFER(buf, load, aica->int_pending_sh4) ||
+        SAVESTATE_XFER(buf, load, aica->irq_line) ||
+        SAVESTATE_XFER(buf, load, aica->ringbuffer_addr) ||
+        SAVESTATE_XFER(buf, load, aica->ringbuffer_size) ||
+        SAVESTATE_XFER(buf, load, aica->ringbuffer_bit15) ||
+        SAVESTATE_XFER(buf, load, aica->dsp.temp) ||
+        SAVESTATE_XFER(buf, load, aica->dsp.mems) ||
+        SAVESTATE_XFER(buf, load, aica->dsp.dec) ||
+        SAVESTATE_XFER(buf, load, aica->aica_sh4_int_scheduled) ||
+        SAVESTATE_XFER(buf, load, aica->chan_sel) ||
+        SAVESTATE_XFER(buf, load, aica->afsel) ||
+        SAVESTATE_XFER(buf, load, aica->sys_reg) ||
+        SAVESTATE_XFER(buf, load, aica->channels) ||
+        SAVESTATE_XFER(buf, load, aica->last_sample_sync) ||
+        SAVESTATE_XFER(buf, load, aica->timers) ||
+        SAVESTATE_XFER(buf, load, aica->deferred) ||
+        SAVESTATE_XFER(buf, load, aica->deferred_arm7_rst) ||
+        SAVESTATE_XFER(buf, load, aica->deferred_timer_ctrl) ||
+        SAVESTATE_XFER(buf, load, aica->deferred_int_enable_new);
+}
+
+void aica_state_save(struct savestate_buf *buf, void *ctxt) {
+    aica_state_xfer(buf, (struct aica*)ctxt, false);
+}
+
+int aica_state_load(struct savestate_buf *buf, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    bool muted[AICA_CHAN_COUNT];
+    unsigned chan_no;
+
+    // muting is the user's choice, not part of the machine's state
+    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++)
+        muted[chan_no] = aica->channels[chan_no].is_muted;
+
+    int err = aica_state_xfer(buf, aica, true);
+
+    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++)
+        aica->channels[chan_no].is_muted = muted[chan_no];
+
+    // the DSP program comes from MPRO, COEF and MADRS, which were just loaded
+    aica->dsp.dirty = true;
+
+    return err;
+}
+
+bool aica_busy(struct aica *aica) {
+    unsigned chan_no;
+    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++)
+        if (aica->channels[chan_no].playing)
+            return true;
+    return aica->aica_sh4_int_scheduled;
+}
+
+void aica_set_threaded(struct aica *aica, bool threaded) {
+    aica_sync_threads(aica);
+    aica->threaded = threaded;
+    aica->slice_stamp = clock_cycle_stamp(aica->clk);
+}
+
+void aica_sync_threads(struct aica *aica) {
+    if (!aica->threaded)
+        return;
+
+    // neither CPU is running, so it's safe to use the real ARM7 clock here
+    aica->from_sh4 = false;
+
+    unsigned deferred = aica->deferred;
+    aica->deferred = 0;
+
+    /*
+     * clear threaded while the deferred operations run so that they don't
+     * get deferred again.
+     */
+    aica->threaded = false;
+
+    if (deferred & AICA_DEFER_ARM7_RESET)
+        arm7_reset(aica->arm7, !(aica->deferred_arm7_rst & 1));
+
+    unsigned tim_idx;
+    for (tim_idx = 0; tim_idx < 3; tim_idx++)
+        if (deferred & AICA_DEFER_TIMER(tim_idx))
+            on_timer_ctrl_write(aica, tim_idx,
+                                aica->deferred_timer_ctrl[tim_idx]);
+    if (deferred & AICA_DEFER_TIMER_SCHED) {
+        aica_resched_timers(aica);
+        aica_raise_timer_ints(aica, aica->deferred_int_enable_new);
+        aica->deferred_int_enable_new = 0;
+        aica_update_interrupts(aica);
+    }
+
+    if (deferred & AICA_DEFER_CLEAR_FIQ)
+        arm7_clear_fiq(aica->arm7);
+    if (deferred & AICA_DEFER_CLEAR_SH4_INT)
+        holly_clear_ext_int(HOLLY_EXT_INT_AICA);
+    if (deferred & AICA_DEFER_RAISE_SH4_INT)
+        raise_aica_sh4_int(aica);
+
+    aica->threaded = true;
+    aica->slice_stamp = clock_cycle_stamp(aica->clk);
+}
+
 static float aica_sys_read_float(addr32_t addr, void *ctxt) {
     addr &= AICA_SYS_MASK;
 
@@ -350,10 +505,32 @@ static void
 aica_sys_reg_pre_read(struct aica *aica, unsigned idx, bool from_sh4) {
 
     /*
-     * TODO: this only really needs to be called for registers which may have
-     * changed due to time, such as PLAYPOS and the timer registers.
+     * only PLAYPOS and PLAYSTATUS depend on the rendered samples, and the
+     * timers can be brought up to date without rendering anything.
      */
-    aica_sync(aica);
+    switch (4 * idx) {
+    case AICA_PLAYPOS:
+    case AICA_PLAYSTATUS:
+        aica_sync_samples(aica);
+        break;
+    case AICA_SCIPD:
+        aica_sync_timers(aica);
+        break;
+    case AICA_TIMERA_CTRL:
+        aica_sync_timer(aica, 0);
+        break;
+    case AICA_TIMERB_CTRL:
+        aica_sync_timer(aica, 1);
+        break;
+    case AICA_TIMERC_CTRL:
+        aica_sync_timer(aica, 2);
+        break;
+    default:
+        break;
+    }
+    if (aica_get_sample_count(aica) - aica->last_sample_sync >=
+        AICA_SYNC_MAX_LAG)
+        aica_sync_samples(aica);
 
     uint32_t val;
     struct aica_chan *chan;
@@ -473,6 +650,7 @@ static void
 aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
     uint32_t val;
     uint32_t mcire;
+    uint32_t newly_enabled;
 
     switch (idx * 4) {
     case AICA_MASTER_VOLUME:
@@ -481,7 +659,11 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
     case AICA_ARM7_RST:
         memcpy(&val, aica->sys_reg + (AICA_ARM7_RST/4), sizeof(val));
         if (from_sh4) {
-            arm7_reset(aica->arm7, !(val & 1));
+            aica->xfer_count++;
+            if (aica_defer(aica, AICA_DEFER_ARM7_RESET))
+                aica->deferred_arm7_rst = val;
+            else
+                arm7_reset(aica->arm7, !(val & 1));
         } else {
             LOG_ERROR("ARM7 suicide unimplemented\n");
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
@@ -497,9 +679,12 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
         break;
     case AICA_MCIRE:
         memcpy(&val, aica->sys_reg + (AICA_MCIRE/4), sizeof(val));
+        if (!from_sh4)
+            aica->xfer_count++;
         aica->int_pending_sh4 &= ~val;
         aica_update_interrupts(aica);
-        if (val & (1<<5))
+        if ((val & (1<<5)) &&
+            (from_sh4 || !aica_defer(aica, AICA_DEFER_CLEAR_SH4_INT)))
             holly_clear_ext_int(HOLLY_EXT_INT_AICA);
         break;
     case AICA_SCIPD:
@@ -525,13 +710,30 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
         if ((val & (1<<5)) && !(mcire & (1<<5)))
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         if (val & (1<<5)) {
-            raise_aica_sh4_int(aica);
+            if (!from_sh4)
+                aica->xfer_count++;
+            if (from_sh4 || !aica_defer(aica, AICA_DEFER_RAISE_SH4_INT))
+                raise_aica_sh4_int(aica);
         }
         break;
     case AICA_SCIEB:
         memcpy(&val, aica->sys_reg + (AICA_SCIEB/4), sizeof(val));
+        if (from_sh4)
+            aica->xfer_count++;
+        newly_enabled = val & ~aica->int_enable;
         aica->int_enable = val;
-        aica_update_interrupts(aica);
+        /*
+         * a timer whose interrupt was disabled only notices that it overflowed
+         * when it gets synced, so the timers have to be caught up before the
+         * FIQ gets checked.
+         */
+        if (from_sh4 && aica_defer(aica, AICA_DEFER_TIMER_SCHED)) {
+            aica->deferred_int_enable_new |= newly_enabled;
+        } else {
+            aica_resched_timers(aica);
+            aica_raise_timer_ints(aica, newly_enabled);
+            aica_update_interrupts(aica);
+        }
         break;
     case AICA_MCIEB:
         memcpy(&val, aica->sys_reg + (AICA_MCIEB/4), sizeof(val));
@@ -565,17 +767,26 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
     case AICA_TIMERA_CTRL:
         LOG_DBG("AICA: write to TIMERA_CTRL\n");
         memcpy(&val, aica->sys_reg + (AICA_TIMERA_CTRL/4), sizeof(val));
-        on_timer_ctrl_write(aica, 0, val);
+        if (from_sh4 && aica_defer(aica, AICA_DEFER_TIMER(0)))
+            aica->deferred_timer_ctrl[0] = val;
+        else
+            on_timer_ctrl_write(aica, 0, val);
         break;
     case AICA_TIMERB_CTRL:
         LOG_DBG("AICA: write to TIMERA_CTRL\n");
         memcpy(&val, aica->sys_reg + (AICA_TIMERB_CTRL/4), sizeof(val));
-        on_timer_ctrl_write(aica, 1, val);
+        if (from_sh4 && aica_defer(aica, AICA_DEFER_TIMER(1)))
+            aica->deferred_timer_ctrl[1] = val;
+        else
+            on_timer_ctrl_write(aica, 1, val);
         break;
     case AICA_TIMERC_CTRL:
         LOG_DBG("AICA: write to TIMERA_CTRL\n");
         memcpy(&val, aica->sys_reg + (AICA_TIMERC_CTRL/4), sizeof(val));
-        on_timer_ctrl_write(aica, 2, val);
+        if (from_sh4 && aica_defer(aica, AICA_DEFER_TIMER(2)))
+            aica->deferred_timer_ctrl[2] = val;
+        else
+            on_timer_ctrl_write(aica, 2, val);
         break;
 
     case AICA_SCILV0:
@@ -594,7 +805,8 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
     case AICA_INTCLEAR:
         memcpy(&val, aica->sys_reg + (AICA_INTCLEAR/4), sizeof(val));
         LOG_DBG("Writing 0x%08x to AICA_INTCLEAR\n", (unsigned)val);
-        if ((val & 0xff) == 1)
+        if ((val & 0xff) == 1 &&
+            (!from_sh4 || !aica_defer(aica, AICA_DEFER_CLEAR_FIQ)))
             arm7_clear_fiq(aica->arm7);
         break;
 
@@ -938,9 +1150,13 @@ static void aica_dsp_reg_write(struct aica *aica, void const *src,
                 len, (unsigned)addr);
     }
     memcpy(((uint8_t*)aica->sys_reg) + addr, src, len);
+
+    // COEF, MADRS and MPRO all get baked into the compiled program
+    if (addr_first <= AICA_DSP_MPRO_LAST)
+        aica->dsp.dirty = true;
 }
 
-static uint32_t aica_sys_read_32(addr32_t addr, void *ctxt) {
+static uint32_t aica_sys_do_read_32(addr32_t addr, void *ctxt) {
     struct aica *aica = (struct aica*)ctxt;
     bool from_sh4 = (addr & 0x00f00000) == 0x00700000;
 
@@ -978,7 +1194,7 @@ static uint32_t aica_sys_read_32(addr32_t addr, void *ctxt) {
     RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
 
-static void aica_sys_write_32(addr32_t addr, uint32_t val, void *ctxt) {
+static void aica_sys_do_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     struct aica *aica = (struct aica*)ctxt;
     bool from_sh4 = (addr & 0x00f00000) == 0x00700000;
 
@@ -1011,7 +1227,7 @@ static void aica_sys_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     }
 }
 
-static uint16_t aica_sys_read_16(addr32_t addr, void *ctxt) {
+static uint16_t aica_sys_do_read_16(addr32_t addr, void *ctxt) {
     struct aica *aica = (struct aica*)ctxt;
     bool from_sh4 = (addr & 0x00f00000) == 0x00700000;
 
@@ -1049,7 +1265,7 @@ static uint16_t aica_sys_read_16(addr32_t addr, void *ctxt) {
     RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
 
-static void aica_sys_write_16(addr32_t addr, uint16_t val, void *ctxt) {
+static void aica_sys_do_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     struct aica *aica = (struct aica*)ctxt;
     bool from_sh4 = (addr & 0x00f00000) == 0x00700000;
 
@@ -1082,7 +1298,7 @@ static void aica_sys_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     }
 }
 
-static uint8_t aica_sys_read_8(addr32_t addr, void *ctxt) {
+static uint8_t aica_sys_do_read_8(addr32_t addr, void *ctxt) {
     struct aica *aica = (struct aica*)ctxt;
     bool from_sh4 = (addr & 0x00f00000) == 0x00700000;
 
@@ -1120,7 +1336,7 @@ static uint8_t aica_sys_read_8(addr32_t addr, void *ctxt) {
     RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
 
-static void aica_sys_write_8(addr32_t addr, uint8_t val, void *ctxt) {
+static void aica_sys_do_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     struct aica *aica = (struct aica*)ctxt;
     bool from_sh4 = (addr & 0x00f00000) == 0x00700000;
 
@@ -1153,6 +1369,66 @@ static void aica_sys_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     }
 }
 
+static inline void aica_lock(struct aica *aica, bool from_sh4) {
+    if (aica->threaded)
+        washdc_mutex_lock(&aica->lock);
+    aica->from_sh4 = from_sh4;
+}
+
+static inline void aica_unlock(struct aica *aica) {
+    if (aica->threaded)
+        washdc_mutex_unlock(&aica->lock);
+}
+
+static inline bool aica_addr_from_sh4(addr32_t addr) {
+    return (addr & 0x00f00000) == 0x00700000;
+}
+
+static uint32_t aica_sys_read_32(addr32_t addr, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    aica_lock(aica, aica_addr_from_sh4(addr));
+    uint32_t ret = aica_sys_do_read_32(addr, ctxt);
+    aica_unlock(aica);
+    return ret;
+}
+
+static void aica_sys_write_32(addr32_t addr, uint32_t val, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    aica_lock(aica, aica_addr_from_sh4(addr));
+    aica_sys_do_write_32(addr, val, ctxt);
+    aica_unlock(aica);
+}
+
+static uint16_t aica_sys_read_16(addr32_t addr, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    aica_lock(aica, aica_addr_from_sh4(addr));
+    uint16_t ret = aica_sys_do_read_16(addr, ctxt);
+    aica_unlock(aica);
+    return ret;
+}
+
+static void aica_sys_write_16(addr32_t addr, uint16_t val, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    aica_lock(aica, aica_addr_from_sh4(addr));
+    aica_sys_do_write_16(addr, val, ctxt);
+    aica_unlock(aica);
+}
+
+static uint8_t aica_sys_read_8(addr32_t addr, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    aica_lock(aica, aica_addr_from_sh4(addr));
+    uint8_t ret = aica_sys_do_read_8(addr, ctxt);
+    aica_unlock(aica);
+    return ret;
+}
+
+static void aica_sys_write_8(addr32_t addr, uint8_t val, void *ctxt) {
+    struct aica *aica = (struct aica*)ctxt;
+    aica_lock(aica, aica_addr_from_sh4(addr));
+    aica_sys_do_write_8(addr, val, ctxt);
+    aica_unlock(aica);
+}
+
 static void aica_update_interrupts(struct aica *aica) {
     /*
      * this is really just a placeholder in case I ever want to put some logging
@@ -1182,20 +1458,29 @@ static void aica_unsched_timer(struct aica *aica, unsigned tim_idx) {
     }
 }
 
+static inline uint32_t aica_timer_int_mask(unsigned tim_idx) {
+    return AICA_INT_TIMA_MASK << tim_idx;
+}
+
+/*
+ * Only timers whose interrupt is enabled get an event.  The others are
+ * brought up to date by aica_sync_timer when somebody reads the counter or
+ * SCIPD, which saves the scheduler from handling an overflow event every 256
+ * ticks for a timer that nobody is listening to.
+ */
 static void aica_sched_timer(struct aica *aica, unsigned tim_idx) {
     struct aica_timer *timer = aica->timers + tim_idx;
 
-    if (timer->scheduled)
+    if (timer->scheduled || !(aica->int_enable & aica_timer_int_mask(tim_idx)))
         return;
 
     struct SchedEvent *evt = &timer->evt;
-    struct dc_clock *clk = aica->clk;
 
     unsigned prescale = 1 << timer->prescale_log;
     unsigned ticks_to_go = 256 - timer->counter;
-    dc_cycle_stamp_t clk_ticks = TICKS_PER_SAMPLE * ticks_to_go * prescale;
 
-    evt->when = clock_cycle_stamp(clk) + clk_ticks;
+    evt->when = (timer->last_sample_sync + ticks_to_go * prescale) *
+        TICKS_PER_SAMPLE;
 
     sched_event(aica->clk, evt);
 
@@ -1205,16 +1490,34 @@ static void aica_sched_timer(struct aica *aica, unsigned tim_idx) {
 static void aica_sync_timer(struct aica *aica, unsigned tim_idx) {
     struct aica_timer *timer = aica->timers + tim_idx;
     unsigned prescale = 1 << timer->prescale_log;
-    dc_cycle_stamp_t sample_delta =
-        aica_get_sample_count(aica) - timer->last_sample_sync;
+    dc_cycle_stamp_t sample_count = aica_get_sample_count(aica);
 
-    if (sample_delta) {
+    // the SH4 side lags behind the ARM7 by up to a timeslice when threaded
+    if (sample_count > timer->last_sample_sync) {
+        dc_cycle_stamp_t sample_delta = sample_count - timer->last_sample_sync;
         unsigned clock_tick_delta = sample_delta / prescale;
 
         if (clock_tick_delta) {
+            if (timer->counter + clock_tick_delta >= 256)
+                aica->int_pending |= aica_timer_int_mask(tim_idx);
             timer->counter += clock_tick_delta;
             timer->counter %= 256;
-            timer->last_sample_sync = aica_get_sample_count(aica);
+
+            // leftover samples count towards the next tick
+            timer->last_sample_sync += clock_tick_delta * prescale;
+        }
+    }
+}
+
+// schedule or cancel timer events to match SCIEB
+static void aica_resched_timers(struct aica *aica) {
+    unsigned tim_idx;
+    for (tim_idx = 0; tim_idx < 3; tim_idx++) {
+        if (aica->int_enable & aica_timer_int_mask(tim_idx)) {
+            aica_sync_timer(aica, tim_idx);
+            aica_sched_timer(aica, tim_idx);
+        } else {
+            aica_unsched_timer(aica, tim_idx);
         }
     }
 }
@@ -1223,11 +1526,12 @@ static void
 on_timer_ctrl_write(struct aica *aica, unsigned tim_idx, uint32_t val) {
     struct aica_timer *timer = aica->timers + tim_idx;
 
-    aica_sync(aica);
+    aica_sync_timer(aica, tim_idx);
     aica_unsched_timer(aica, tim_idx);
 
     timer->counter = val & 0xff;
     timer->prescale_log = (val >> 8) & 0x7;
+    timer->last_sample_sync = aica_get_sample_count(aica);
 
     aica_sched_timer(aica, tim_idx);
 
@@ -1239,19 +1543,25 @@ on_timer_ctrl_write(struct aica *aica, unsigned tim_idx, uint32_t val) {
 static void
 aica_timer_a_handler(struct SchedEvent *evt) {
     struct aica *aica = (struct aica*)evt->arg_ptr;
+    aica_lock(aica, false);
     aica_timer_handler(aica, 0);
+    aica_unlock(aica);
 }
 
 static void
 aica_timer_b_handler(struct SchedEvent *evt) {
     struct aica *aica = (struct aica*)evt->arg_ptr;
+    aica_lock(aica, false);
     aica_timer_handler(aica, 1);
+    aica_unlock(aica);
 }
 
 static void
 aica_timer_c_handler(struct SchedEvent *evt) {
     struct aica *aica = (struct aica*)evt->arg_ptr;
+    aica_lock(aica, false);
     aica_timer_handler(aica, 2);
+    aica_unlock(aica);
 }
 
 static void aica_timer_handler(struct aica *aica, unsigned tim_idx) {
@@ -1265,36 +1575,28 @@ static void aica_timer_handler(struct aica *aica, unsigned tim_idx) {
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
+    aica->int_pending |= aica_timer_int_mask(tim_idx);
+    aica_raise_timer_ints(aica, aica_timer_int_mask(tim_idx));
+
+    aica_sched_timer(aica, tim_idx);
+}
+
+// raise the FIQ for any timer in mask whose interrupt is pending and enabled
+static void aica_raise_timer_ints(struct aica *aica, uint32_t mask) {
+    mask &= aica->int_pending & aica->int_enable;
+
     /*
      * it is not a mistake that timer B and timer C both share pin 7 scilv.
      * the corlett doc says that bit 7 of scilv referes to bits 7, 8, 9 and 10
      * of SCIPD all at the same time.
      */
-    switch (tim_idx) {
-    case 0:
-        aica->int_pending |= AICA_INT_TIMA_MASK;
-        if (aica->int_enable & AICA_INT_TIMA_MASK) {
-            aica->sys_reg[AICA_INTREQ/4] = aica_read_sci(aica, 6);
-            arm7_set_fiq(aica->arm7);
-        }
-        break;
-    case 1:
-        aica->int_pending |= AICA_INT_TIMB_MASK;
-        if (aica->int_enable & AICA_INT_TIMB_MASK) {
-            aica->sys_reg[AICA_INTREQ/4] = aica_read_sci(aica, 7);
-            arm7_set_fiq(aica->arm7);
-        }
-        break;
-    case 2:
-        aica->int_pending |= AICA_INT_TIMC_MASK;
-        if (aica->int_enable & AICA_INT_TIMC_MASK) {
-            aica->sys_reg[AICA_INTREQ/4] = aica_read_sci(aica, 7);
-            arm7_set_fiq(aica->arm7);
-        }
-        break;
+    if (mask & AICA_INT_TIMA_MASK) {
+        aica->sys_reg[AICA_INTREQ/4] = aica_read_sci(aica, 6);
+        arm7_set_fiq(aica->arm7);
+    } else if (mask & (AICA_INT_TIMB_MASK | AICA_INT_TIMC_MASK)) {
+        aica->sys_reg[AICA_INTREQ/4] = aica_read_sci(aica, 7);
+        arm7_set_fiq(aica->arm7);
     }
-
-    aica_sched_timer(aica, tim_idx);
 }
 
 static unsigned aica_read_sci(struct aica *aica, unsigned bit) {
@@ -1323,15 +1625,26 @@ static char const *fmt_name(enum aica_fmt fmt) {
 }
 
 static dc_cycle_stamp_t aica_get_sample_count(struct aica *aica) {
+    if (aica->threaded && aica->from_sh4)
+        return aica->slice_stamp / TICKS_PER_SAMPLE;
     return clock_cycle_stamp(aica->clk) / TICKS_PER_SAMPLE;
 }
 
 static void aica_sync(struct aica *aica) {
+    aica_sync_timers(aica);
+    aica_sync_samples(aica);
+}
+
+static void aica_sync_timers(struct aica *aica) {
     aica_sync_timer(aica, 0);
     aica_sync_timer(aica, 1);
     aica_sync_timer(aica, 2);
+}
 
-    if (aica->last_sample_sync != aica_get_sample_count(aica)) {
+static void aica_sync_samples(struct aica *aica) {
+    PERF_TIMER_BEGIN(PERF_AICA_SYNC);
+
+    if (aica->last_sample_sync < aica_get_sample_count(aica)) {
         /*
          * process all samples between aica->last_sample_sync and aica_get
          * sample_count(aica)
@@ -1339,11 +1652,19 @@ static void aica_sync(struct aica *aica) {
         dc_cycle_stamp_t n_samples = AICA_FREQ_RATIO *
             (aica_get_sample_count(aica) - aica->last_sample_sync);
 
-        while (n_samples--)
-            aica_process_sample(aica);
+        enum bench_sect bench_prev = bench_enter(BENCH_AICA);
+        while (n_samples) {
+            unsigned n_block = n_samples < AICA_SAMPLE_BLOCK_LEN ?
+                n_samples : AICA_SAMPLE_BLOCK_LEN;
+            aica_process_samples(aica, n_block);
+            n_samples -= n_block;
+        }
+        bench_leave(bench_prev);
 
         aica->last_sample_sync = aica_get_sample_count(aica);
     }
+
+    PERF_TIMER_END(PERF_AICA_SYNC);
 }
 
 static unsigned aica_chan_effective_rate(struct aica const *aica, unsigned chan_no) {
@@ -1594,12 +1915,25 @@ static unsigned const decay_step_delta[][4] = {
     { 8, 8, 8, 8 }  // 0x3c
 };
 
-static inline int32_t add_sample32(int32_t s1, int32_t s2) {
-    if ((s2 > 0) && (s1 > INT32_MAX - s2))
-        return INT32_MAX;
-    if ((s2 < 0) && (s1 < INT32_MIN - s2))
-        return INT32_MIN;
-    return s1 + s2;
+/*
+ * saturating add of every sample in src to the corresponding sample in dst.
+ * This is kept branch-free so that the compiler can vectorize it.
+ */
+static void aica_mix_block(int32_t *restrict dst, int32_t const *restrict src,
+                           unsigned n_samples) {
+    unsigned idx;
+    for (idx = 0; idx < n_samples; idx++) {
+        int32_t s1 = dst[idx], s2 = src[idx];
+        int32_t sum = (int32_t)((uint32_t)s1 + (uint32_t)s2);
+
+        // all ones if the sum overflowed, else zero
+        int32_t ovf = ((s1 ^ sum) & (s2 ^ sum)) >> 31;
+
+        // INT32_MAX if s1 (and therefore s2) is positive, else INT32_MIN
+        int32_t sat = (s1 >> 31) ^ INT32_MAX;
+
+        dst[idx] = (sum & ~ovf) | (sat & ovf);
+    }
 }
 
 static aica_sample_pos get_sample_rate_multiplier(struct aica_chan const *chan) {
@@ -1640,19 +1974,32 @@ static aica_atten atten_scale(unsigned atten) {
     return scale;
 }
 
-static void aica_process_sample(struct aica *aica) {
-    unsigned chan_no;
-
-    int32_t sample_total = 0;
+/*
+ * render n_samples samples of the given channel and mix them into samples.
+ *
+ * Channels don't interact with each other, so rendering one channel at a time
+ * across the whole buffer produces the same output as rendering every channel
+ * for one sample at a time; samples are still mixed in channel order.
+ */
+static void aica_process_chan(struct aica *aica, unsigned chan_no,
+                              int32_t *samples, unsigned n_samples) {
+    struct aica_chan *chan = aica->channels + chan_no;
+    int32_t chan_samples[AICA_SAMPLE_BLOCK_LEN];
 
-    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++) {
-        struct aica_chan *chan = aica->channels + chan_no;
+    // the pitch registers can't change in the middle of a sync
+    aica_sample_pos sample_rate =
+        get_sample_rate_multiplier(chan) / AICA_FREQ_RATIO;
 
-        if (!chan->playing)
-            continue;
+    /*
+     * each byte of ADPCM data holds two nibbles, so remember the last byte we
+     * read instead of going back to wave memory for the second one.
+     */
+    uint32_t adpcm_byte_addr = 0;
+    uint8_t adpcm_byte = 0;
+    bool have_adpcm_byte = false;
 
-        aica_sample_pos sample_rate =
-            get_sample_rate_multiplier(chan) / AICA_FREQ_RATIO;
+    unsigned sample_no;
+    for (sample_no = 0; sample_no < n_samples && chan->playing; sample_no++) {
         unsigned effective_rate = aica_chan_effective_rate(aica, chan_no);
         unsigned samples_per_step = aica_samples_per_step(effective_rate,
                                                           chan->step_no);
@@ -1663,8 +2010,7 @@ static void aica_process_sample(struct aica *aica) {
                 (int32_t)(int16_t)aica_wave_mem_read_16(chan->addr_cur,
                                                         &aica->mem);
             // TODO: linear interpolation
-            if (!chan->is_muted)
-                sample_total = add_sample32(sample_total, sample);
+            chan_samples[sample_no] = sample;
 
             chan->sample_partial += sample_rate;
             while (chan->sample_partial >= AICA_SAMPLE_POS_UNIT) {
@@ -1680,8 +2026,7 @@ static void aica_process_sample(struct aica *aica) {
             sample = sat_shift(sample, 8);
 
             // TODO: linear interpolation
-            if (!chan->is_muted)
-                sample_total = add_sample32(sample_total, sample);
+            chan_samples[sample_no] = sample;
 
             chan->sample_partial += sample_rate;
             while (chan->sample_partial >= AICA_SAMPLE_POS_UNIT) {
@@ -1693,7 +2038,13 @@ static void aica_process_sample(struct aica *aica) {
         } else {
             // 4-bit ADPCM
             if (chan->adpcm_next_step) {
-                uint8_t sample = aica_wave_mem_read_8(chan->addr_cur, &aica->mem);
+                if (!have_adpcm_byte || adpcm_byte_addr != chan->addr_cur) {
+                    adpcm_byte = aica_wave_mem_read_8(chan->addr_cur,
+                                                      &aica->mem);
+                    adpcm_byte_addr = chan->addr_cur;
+                    have_adpcm_byte = true;
+                }
+                uint8_t sample = adpcm_byte;
                 if (chan->sample_pos & 1)
                     sample = (sample >> 4) & 0xf;
                 else
@@ -1705,8 +2056,7 @@ static void aica_process_sample(struct aica *aica) {
 
             int32_t sample = chan->adpcm_sample;
 
-            if (!chan->is_muted)
-                sample_total = add_sample32(sample_total, sample);
+            chan_samples[sample_no] = sample;
 
             chan->sample_partial += sample_rate;
             if (chan->sample_partial >= AICA_SAMPLE_POS_UNIT) {
@@ -1786,7 +2136,76 @@ static void aica_process_sample(struct aica *aica) {
         }
     }
 
-    dc_submit_sound_samples(&sample_total, 1);
+    // samples is NULL when the sound is getting thrown away
+    if (chan->is_muted || !samples)
+        return;
+
+    // the channel may have stopped partway through the block
+    if (sample_no < n_samples) {
+        memset(chan_samples + sample_no, 0,
+               (n_samples - sample_no) * sizeof(chan_samples[0]));
+    }
+
+    aica_mix_block(samples, chan_samples, n_samples);
+
+    if (aica_dsp_active(&aica->dsp)) {
+        uint32_t send;
+        memcpy(&send, chan->raw + AICA_CHAN_DSP_SEND, sizeof(send));
+        aica_dsp_send(&aica->dsp, send & 0xf, (send >> 4) & 0xf,
+                      chan_samples, n_samples);
+    }
+}
+
+void aica_process_samples(struct aica *aica, unsigned n_samples) {
+    int32_t samples[AICA_SAMPLE_BLOCK_LEN];
+
+#ifdef INVARIANTS
+    if (n_samples > AICA_SAMPLE_BLOCK_LEN)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    /*
+     * in turbo mode and after a rollback, the channels still have to advance
+     * because the guest can see where they are, but nothing gets mixed or
+     * submitted.
+     */
+    bool discard = dc_skip_sound();
+
+    if (!discard)
+        memset(samples, 0, n_samples * sizeof(samples[0]));
+
+    if (aica->dsp.dirty)
+        aica_dsp_compile(&aica->dsp, aica->sys_reg);
+
+    unsigned chan_no;
+    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++)
+        if (aica->channels[chan_no].playing)
+            aica_process_chan(aica, chan_no, discard ? NULL : samples,
+                              n_samples);
+
+    if (!discard && aica_dsp_active(&aica->dsp)) {
+        int32_t effects[AICA_SAMPLE_BLOCK_LEN];
+        aica_dsp_process(&aica->dsp, &aica->mem, aica->sys_reg,
+                         aica->ringbuffer_addr,
+                         8192 << aica->ringbuffer_size, effects, n_samples);
+        aica_mix_block(samples, effects, n_samples);
+    }
+
+    /*
+     * CDDA goes straight to the output at the EFSDL levels of mixer entries
+     * 16 and 17.  The output is mono, so EFPAN doesn't matter here.
+     */
+    int32_t cdda[AICA_SAMPLE_BLOCK_LEN];
+    int32_t cdda_gain_l = aica_dsp_level_gain(
+        aica->sys_reg[AICA_DSP_EFSDL_CDDA_L / 4] >> 8);
+    int32_t cdda_gain_r = aica_dsp_level_gain(
+        aica->sys_reg[AICA_DSP_EFSDL_CDDA_R / 4] >> 8);
+    if (cdda_consume(discard ? NULL : cdda, n_samples,
+                     cdda_gain_l, cdda_gain_r) && !discard)
+        aica_mix_block(samples, cdda, n_samples);
+
+    if (!discard)
+        dc_submit_sound_samples(samples, n_samples);
 }
 
 static void raise_aica_sh4_int(struct aica *aica) {
@@ -26,7 +26,9 @@
 #include <stdint.h>
 
 #include "dc_sched.h"
+#include "threading.h"
 #include "aica_wave_mem.h"
+#include "aica_dsp.h"
 #include "washdc/gameconsole.h"
 
 struct arm7;
@@ -172,6 +174,8 @@ struct aica {
     enum ringbuffer_size ringbuffer_size;
     bool ringbuffer_bit15;
 
+    struct aica_dsp dsp;
+
     bool aica_sh4_int_scheduled;
     struct SchedEvent aica_sh4_raise_event;
 
@@ -213,12 +217,72 @@ struct aica {
 
     struct dc_clock *clk;
     struct dc_clock *sh4_clk;
+
+    /*
+     * When the ARM7 runs on its own thread, register accesses from both CPUs
+     * are serialized by lock.  Anything that one CPU does to the other CPU's
+     * state or clock is deferred to the next timeslice boundary (see
+     * aica_sync_threads).
+     */
+    bool threaded;
+    washdc_mutex lock;
+
+    // true if the current lock holder is the SH4
+    bool from_sh4;
+
+    // ARM7 clock at the start of the current timeslice; used by the SH4 side
+    dc_cycle_stamp_t slice_stamp;
+
+    unsigned deferred;
+    uint32_t deferred_arm7_rst;
+    uint32_t deferred_timer_ctrl[3];
+
+    // SCIEB bits the SH4 turned on since the last timeslice boundary
+    uint32_t deferred_int_enable_new;
+
+    /*
+     * number of writes so far in which one CPU poked at the other one's
+     * interrupts or reset line.  The adaptive timeslice uses this to tell
+     * when the two CPUs are talking to each other.
+     */
+    unsigned long xfer_count;
 };
 
 void aica_init(struct aica *aica, struct arm7 *arm7,
                struct dc_clock *clk, struct dc_clock *sh4_clk);
 void aica_cleanup(struct aica *aica);
 
+/*
+ * save-state section for the AICA's registers, channels and timers (ctxt is
+ * the aica).  Wave memory is saved separately.
+ */
+struct savestate_buf;
+void aica_state_save(struct savestate_buf *buf, void *ctxt);
+int aica_state_load(struct savestate_buf *buf, void *ctxt);
+
+// true if any channel is playing or an interrupt to the SH4 is pending
+bool aica_busy(struct aica *aica);
+
+// maximum number of samples rendered and submitted to the sound server at once
+#define AICA_SAMPLE_BLOCK_LEN AICA_DSP_BLOCK_LEN
+
+/*
+ * mix n_samples (which must be <= AICA_SAMPLE_BLOCK_LEN) samples from every
+ * playing channel and submit them to the sound server.  Normally this only
+ * gets called by the AICA's own sync logic; it's only public so that the
+ * microbenchmarks can drive it directly.
+ */
+void aica_process_samples(struct aica *aica, unsigned n_samples);
+
+// this must only be called when neither CPU is running
+void aica_set_threaded(struct aica *aica, bool threaded);
+
+/*
+ * apply any operations that were deferred during the last timeslice.  This
+ * must be called between timeslices while the ARM7 thread is not running.
+ */
+void aica_sync_threads(struct aica *aica);
+
 extern struct memory_interface aica_sys_intf;
 
 extern bool aica_log_verbose_val;
@@ -0,0 +1,344 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <string.h>
+
+#include "aica_dsp.h"
+
+/*
+ * send levels (IMXL) and effect output levels (EFSDL) are both 4-bit fields
+ * where 0 is off and every step below 0xf is another -3dB.  This table holds
+ * the corresponding gain with 12 bits of fraction.
+ */
+static int32_t const level_gain[16] = {
+    0, 32, 45, 64, 91, 128, 181, 256,
+    362, 512, 724, 1024, 1448, 2048, 2896, 4096
+};
+
+int32_t aica_dsp_level_gain(unsigned level) {
+    return level_gain[level & 0xf];
+}
+
+static inline int32_t sext24(int32_t val) {
+    return ((int32_t)((uint32_t)val << 8)) >> 8;
+}
+
+static inline int32_t sext13(int32_t val) {
+    return ((int32_t)((uint32_t)val << 19)) >> 19;
+}
+
+static inline int32_t clamp24(int32_t val) {
+    if (val > 0x7fffff)
+        return 0x7fffff;
+    if (val < -0x800000)
+        return -0x800000;
+    return val;
+}
+
+static inline int32_t clamp20(int32_t val) {
+    if (val > 0x7ffff)
+        return 0x7ffff;
+    if (val < -0x80000)
+        return -0x80000;
+    return val;
+}
+
+// convert a 24-bit value to the DSP's 16-bit floating-point ringbuffer format
+static uint16_t dsp_pack(int32_t val) {
+    unsigned sign = (val >> 23) & 1;
+    uint32_t tmp = ((uint32_t)val ^ ((uint32_t)val << 1)) & 0xffffff;
+    unsigned exponent = 0;
+
+    while (exponent < 12 && !(tmp & 0x800000)) {
+        tmp <<= 1;
+        exponent++;
+    }
+
+    uint32_t mantissa;
+    if (exponent < 12)
+        mantissa = ((uint32_t)val << exponent) & 0x3fffff;
+    else
+        mantissa = (uint32_t)val << 11;
+    mantissa = (mantissa >> 11) & 0x7ff;
+
+    return (uint16_t)((sign << 15) | (exponent << 11) | mantissa);
+}
+
+static int32_t dsp_unpack(uint16_t val) {
+    unsigned sign = (val >> 15) & 1;
+    unsigned exponent = (val >> 11) & 0xf;
+    uint32_t uval = (uint32_t)(val & 0x7ff) << 11;
+
+    if (exponent > 11) {
+        exponent = 11;
+        uval |= sign << 22;
+    } else {
+        uval |= (sign ^ 1) << 22;
+    }
+    uval |= sign << 23;
+
+    return sext24((int32_t)uval) >> exponent;
+}
+
+void aica_dsp_init(struct aica_dsp *dsp) {
+    memset(dsp, 0, sizeof(*dsp));
+}
+
+void aica_dsp_compile(struct aica_dsp *dsp, uint32_t const *sys_reg) {
+    uint32_t const *mpro = sys_reg + AICA_DSP_MPRO_FIRST / 4;
+    uint32_t const *coef = sys_reg + AICA_DSP_COEF_FIRST / 4;
+    uint32_t const *madrs = sys_reg + AICA_DSP_MADRS_FIRST / 4;
+
+    // trailing steps that are all zero don't affect any output
+    unsigned n_steps = AICA_DSP_STEP_COUNT;
+    while (n_steps) {
+        uint32_t const *inst = mpro + (n_steps - 1) * 4;
+        if ((inst[0] | inst[1] | inst[2] | inst[3]) & 0xffff)
+            break;
+        n_steps--;
+    }
+
+    unsigned step_no;
+    for (step_no = 0; step_no < n_steps; step_no++) {
+        struct aica_dsp_step *step = dsp->prog + step_no;
+        uint32_t const *inst = mpro + step_no * 4;
+        unsigned w0 = inst[0] & 0xffff, w1 = inst[1] & 0xffff,
+            w2 = inst[2] & 0xffff, w3 = inst[3] & 0xffff;
+
+        step->tra = (w0 >> 8) & 0x7f;
+        step->twt = (w0 >> 7) & 1;
+        step->twa = w0 & 0x7f;
+
+        step->xsel = (w1 >> 15) & 1;
+        step->ysel = (w1 >> 13) & 3;
+        step->ira = (w1 >> 7) & 0x3f;
+        step->iwt = (w1 >> 6) & 1;
+        step->iwa = (w1 >> 1) & 0x1f;
+
+        step->table = (w2 >> 15) & 1;
+        step->mwt = (w2 >> 14) & 1;
+        step->mrd = (w2 >> 13) & 1;
+        step->ewt = (w2 >> 12) & 1;
+        step->ewa = (w2 >> 8) & 0xf;
+        step->adrl = (w2 >> 7) & 1;
+        step->frcl = (w2 >> 6) & 1;
+        step->shift = (w2 >> 4) & 3;
+        step->yrl = (w2 >> 3) & 1;
+        step->negb = (w2 >> 2) & 1;
+        if ((w2 >> 1) & 1)
+            step->bsel = AICA_DSP_BSEL_ZERO;
+        else if (w2 & 1)
+            step->bsel = AICA_DSP_BSEL_ACC;
+        else
+            step->bsel = AICA_DSP_BSEL_TEMP;
+
+        step->nofl = (w3 >> 15) & 1;
+        step->adreb = (w3 >> 8) & 1;
+        step->nxadr = (w3 >> 7) & 1;
+        step->madrs = madrs[(w3 >> 9) & 0x1f] & 0xffff;
+
+        // COEF is a 13-bit signed value in the upper bits of the register
+        step->coef = ((int32_t)(int16_t)(coef[step_no] & 0xffff)) >> 3;
+    }
+
+    dsp->n_steps = n_steps;
+    dsp->dirty = false;
+}
+
+void aica_dsp_send(struct aica_dsp *dsp, unsigned isel, unsigned imxl,
+                   int32_t const *src, unsigned n_samples) {
+    int32_t gain = level_gain[imxl & 0xf];
+    int32_t *dst = dsp->mixs[isel & 0xf];
+    uint32_t bit = 1 << (isel & 0xf);
+    unsigned idx;
+
+    if (!gain)
+        return;
+
+    // MIXS is 20 bits wide; the extra four bits are below the 16-bit sample
+    if (dsp->mixs_mask & bit) {
+        for (idx = 0; idx < n_samples; idx++)
+            dst[idx] += (src[idx] * gain) >> 8;
+    } else {
+        for (idx = 0; idx < n_samples; idx++)
+            dst[idx] = (src[idx] * gain) >> 8;
+        dsp->mixs_mask |= bit;
+    }
+}
+
+void aica_dsp_process(struct aica_dsp *dsp, struct aica_wave_mem *mem,
+                      uint32_t const *sys_reg, unsigned rb_addr,
+                      unsigned rb_words, int32_t *out, unsigned n_samples) {
+    int32_t efgain[AICA_DSP_EFREG_COUNT];
+    unsigned rb_base = rb_addr / 2;
+    unsigned rb_mask = rb_words - 1;
+    unsigned idx;
+
+    for (idx = 0; idx < AICA_DSP_EFREG_COUNT; idx++)
+        efgain[idx] =
+            level_gain[(sys_reg[AICA_DSP_EFSDL_FIRST / 4 + idx] >> 8) & 0xf];
+
+    unsigned sample_no;
+    for (sample_no = 0; sample_no < n_samples; sample_no++) {
+        int32_t acc = 0, shifted = 0, inputs = 0, memval = 0;
+        int32_t frc_reg = 0, y_reg = 0;
+        unsigned adrs_reg = 0;
+        int32_t efreg[AICA_DSP_EFREG_COUNT] = { 0 };
+        unsigned dec = dsp->dec;
+
+        struct aica_dsp_step const *step = dsp->prog;
+        struct aica_dsp_step const *last = dsp->prog + dsp->n_steps;
+        for (; step != last; step++) {
+            int32_t x, y, b;
+
+            if (step->ira < 0x20) {
+                inputs = dsp->mems[step->ira];
+            } else if (step->ira < 0x30) {
+                unsigned row = step->ira - 0x20;
+                if (dsp->mixs_mask & (1 << row))
+                    inputs = clamp20(dsp->mixs[row][sample_no]) * 16;
+                else
+                    inputs = 0;
+            } else {
+                // EXTS (CD-DA input) isn't emulated
+                inputs = 0;
+            }
+            inputs = sext24(inputs);
+
+            if (step->iwt) {
+                dsp->mems[step->iwa] = memval;
+                if (step->ira == step->iwa)
+                    inputs = memval;
+            }
+
+            if (step->bsel == AICA_DSP_BSEL_ZERO)
+                b = 0;
+            else if (step->bsel == AICA_DSP_BSEL_ACC)
+                b = acc;
+            else
+                b = sext24(dsp->temp[(step->tra + dec) & 0x7f]);
+            if (step->negb)
+                b = -b;
+
+            if (step->xsel)
+                x = inputs;
+            else
+                x = sext24(dsp->temp[(step->tra + dec) & 0x7f]);
+
+            switch (step->ysel) {
+            case AICA_DSP_YSEL_FRC:
+                y = frc_reg;
+                break;
+            case AICA_DSP_YSEL_COEF:
+                y = step->coef;
+                break;
+            case AICA_DSP_YSEL_Y_HI:
+                y = (y_reg >> 11) & 0x1fff;
+                break;
+            default:
+                y = (y_reg >> 4) & 0xfff;
+                break;
+            }
+            y = sext13(y);
+
+            if (step->yrl)
+                y_reg = inputs;
+
+            switch (step->shift) {
+            case 0:
+                shifted = clamp24(acc);
+                break;
+            case 1:
+                shifted = clamp24(acc * 2);
+                break;
+            case 2:
+                shifted = sext24(acc * 2);
+                break;
+            default:
+                shifted = sext24(acc);
+                break;
+            }
+
+            acc = (int32_t)(((int64_t)x * y) >> 12) + b;
+
+            if (step->twt)
+                dsp->temp[(step->twa + dec) & 0x7f] = shifted;
+
+            if (step->frcl) {
+                if (step->shift == 3)
+                    frc_reg = shifted & 0xfff;
+                else
+                    frc_reg = (shifted >> 11) & 0x1fff;
+            }
+
+            if (step->mrd || step->mwt) {
+                unsigned addr = step->madrs;
+                if (!step->table)
+                    addr += dec;
+                if (step->adreb)
+                    addr += adrs_reg & 0xfff;
+                if (step->nxadr)
+                    addr++;
+                addr &= step->table ? 0xffff : rb_mask;
+
+                addr32_t byte_addr = ((rb_base + addr) * 2) & AICA_WAVE_MEM_MASK;
+                if (step->mrd) {
+                    uint16_t val = aica_wave_mem_read_16(byte_addr, mem);
+                    if (step->nofl)
+                        memval = sext24((int32_t)val << 8);
+                    else
+                        memval = dsp_unpack(val);
+                }
+                if (step->mwt) {
+                    uint16_t val = step->nofl ?
+                        (uint16_t)(shifted >> 8) : dsp_pack(shifted);
+                    aica_wave_mem_write_16(byte_addr, val, mem);
+                }
+            }
+
+            if (step->adrl) {
+                if (step->shift == 3)
+                    adrs_reg = (shifted >> 12) & 0xfff;
+                else
+                    adrs_reg = inputs >> 16;
+            }
+
+            if (step->ewt)
+                efreg[step->ewa] += shifted >> 8;
+        }
+
+        dsp->dec--;
+
+        int32_t sum = 0;
+        for (idx = 0; idx < AICA_DSP_EFREG_COUNT; idx++) {
+            // EFREG is only 16 bits wide
+            int32_t val = efreg[idx];
+            if (val > INT16_MAX)
+                val = INT16_MAX;
+            else if (val < INT16_MIN)
+                val = INT16_MIN;
+            sum += (val * efgain[idx]) >> 12;
+        }
+        out[sample_no] = sum;
+    }
+
+    dsp->mixs_mask = 0;
+}
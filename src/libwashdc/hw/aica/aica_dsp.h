@@ -0,0 +1,133 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef AICA_DSP_H_
+#define AICA_DSP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aica_wave_mem.h"
+
+/*
+ * AICA effects DSP.
+ *
+ * The DSP runs a 128-step microprogram (MPRO) once per output sample.  Rather
+ * than pulling the bitfields out of MPRO for every step of every sample, the
+ * program gets decoded into a compact step list whenever the guest rewrites
+ * MPRO, COEF or MADRS, and the list is trimmed to the last step that actually
+ * does anything.  When no program is loaded the DSP costs nothing.
+ */
+
+#define AICA_DSP_STEP_COUNT 128
+#define AICA_DSP_MADRS_COUNT 64
+#define AICA_DSP_TEMP_COUNT 128
+#define AICA_DSP_MEMS_COUNT 32
+#define AICA_DSP_MIXS_COUNT 16
+#define AICA_DSP_EFREG_COUNT 16
+
+// maximum number of samples passed to aica_dsp_process at once
+#define AICA_DSP_BLOCK_LEN 512
+
+// byte offsets of the DSP's register banks in the AICA's system registers
+#define AICA_DSP_EFSDL_FIRST 0x2000
+
+// the two EFSDL entries after the DSP's 16 belong to the CDDA inputs
+#define AICA_DSP_EFSDL_CDDA_L 0x2040
+#define AICA_DSP_EFSDL_CDDA_R 0x2044
+#define AICA_DSP_COEF_FIRST 0x3000
+#define AICA_DSP_MADRS_FIRST 0x3200
+#define AICA_DSP_MPRO_FIRST 0x3400
+#define AICA_DSP_MPRO_LAST 0x3bff
+
+enum aica_dsp_ysel {
+    AICA_DSP_YSEL_FRC,
+    AICA_DSP_YSEL_COEF,
+    AICA_DSP_YSEL_Y_HI,
+    AICA_DSP_YSEL_Y_LO
+};
+
+enum aica_dsp_bsel {
+    AICA_DSP_BSEL_TEMP,
+    AICA_DSP_BSEL_ACC,
+    AICA_DSP_BSEL_ZERO
+};
+
+struct aica_dsp_step {
+    int32_t coef;
+    uint16_t madrs;
+
+    uint8_t tra, twa, ira, iwa, ewa, shift;
+    uint8_t ysel, bsel;
+
+    bool twt, xsel, iwt, table, mwt, mrd, ewt, adrl, frcl, yrl, negb, nofl,
+        adreb, nxadr;
+};
+
+struct aica_dsp {
+    struct aica_dsp_step prog[AICA_DSP_STEP_COUNT];
+    unsigned n_steps;
+
+    // set when the guest writes MPRO, COEF or MADRS
+    bool dirty;
+
+    int32_t temp[AICA_DSP_TEMP_COUNT];
+    int32_t mems[AICA_DSP_MEMS_COUNT];
+    unsigned dec;
+
+    /*
+     * per-sample input from the channels' DSP sends.  Rows that haven't been
+     * sent to since the last aica_dsp_process are stale; mixs_mask says which
+     * rows are valid.
+     */
+    int32_t mixs[AICA_DSP_MIXS_COUNT][AICA_DSP_BLOCK_LEN];
+    uint32_t mixs_mask;
+};
+
+void aica_dsp_init(struct aica_dsp *dsp);
+
+// gain (with 12 bits of fraction) of a 4-bit IMXL or EFSDL level
+int32_t aica_dsp_level_gain(unsigned level);
+
+// rebuild the step list from the MPRO, COEF and MADRS registers
+void aica_dsp_compile(struct aica_dsp *dsp, uint32_t const *sys_reg);
+
+static inline bool aica_dsp_active(struct aica_dsp const *dsp) {
+    return dsp->n_steps != 0;
+}
+
+/*
+ * mix n_samples of a channel's output into MIXS input isel at send level
+ * imxl (the ISEL and IMXL fields of the channel's DSP send register).
+ */
+void aica_dsp_send(struct aica_dsp *dsp, unsigned isel, unsigned imxl,
+                   int32_t const *src, unsigned n_samples);
+
+/*
+ * run the program once for each of n_samples samples and write the sum of
+ * the EFREG outputs (scaled by EFSDL) to out.  rb_addr is the byte address of
+ * the ring buffer in wave memory and rb_words is its length in 16-bit words.
+ */
+void aica_dsp_process(struct aica_dsp *dsp, struct aica_wave_mem *mem,
+                      uint32_t const *sys_reg, unsigned rb_addr,
+                      unsigned rb_words, int32_t *out, unsigned n_samples);
+
+#endif
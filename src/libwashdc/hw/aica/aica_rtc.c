@@ -96,6 +96,11 @@ void aica_rtc_init(struct aica_rtc *rtc, struct dc_clock *clock,
 
     rtc->aica_rtc_clk = clock;
 
+    rtc->aica_rtc_event.handler = aica_rtc_event_handler;
+    rtc->aica_rtc_event.name = "aica_rtc_event_handler";
+    rtc->aica_rtc_event.arg_ptr = rtc;
+    sched_event_register(&rtc->aica_rtc_event, "aica_rtc");
+
     sched_aica_rtc_event(rtc);
 }
 
@@ -274,8 +279,6 @@ static void aica_rtc_event_handler(SchedEvent *ev) {
 static void sched_aica_rtc_event(struct aica_rtc *rtc) {
     rtc->aica_rtc_event.when =
         clock_cycle_stamp(rtc->aica_rtc_clk) + SCHED_FREQUENCY;
-    rtc->aica_rtc_event.handler = aica_rtc_event_handler;
-    rtc->aica_rtc_event.arg_ptr = rtc;
     sched_event(rtc->aica_rtc_clk, &rtc->aica_rtc_event);
 }
 
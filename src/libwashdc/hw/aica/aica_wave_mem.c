@@ -31,6 +31,8 @@
 #include "config.h"
 #include "log.h"
 #include "compiler_bullshit.h"
+#include "savestate.h"
+#include "hostmem.h"
 
 #include "aica_wave_mem.h"
 
@@ -41,10 +43,14 @@ void aica_log_verbose(bool verbose) {
 }
 
 void aica_wave_mem_init(struct aica_wave_mem *wm) {
-    memset(wm->mem, 0, sizeof(wm->mem));
+    wm->mem = (uint8_t*)hostmem_alloc(AICA_WAVE_MEM_LEN);
+    if (!wm->mem)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
 }
 
 void aica_wave_mem_cleanup(struct aica_wave_mem *wm) {
+    hostmem_free(wm->mem, AICA_WAVE_MEM_LEN);
+    wm->mem = NULL;
 }
 
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt) {
@@ -118,6 +124,7 @@ void aica_wave_mem_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     }
 
     *outp = val;
+    savestate_notify_wave_write(addr, sizeof(val));
 }
 
 uint16_t aica_wave_mem_read_16(addr32_t addr, void *ctxt) {
@@ -165,6 +172,7 @@ void aica_wave_mem_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     }
 
     memcpy(wm->mem + addr, &val, sizeof(val));
+    savestate_notify_wave_write(addr, sizeof(val));
 }
 
 void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
@@ -187,6 +195,26 @@ void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     }
 
     memcpy(wm->mem + addr, &val, sizeof(val));
+    savestate_notify_wave_write(addr, sizeof(val));
+}
+
+void aica_wave_mem_write_dwords(addr32_t addr, uint32_t const *src,
+                                unsigned n_dwords, void *ctxt) {
+    struct aica_wave_mem *wm = (struct aica_wave_mem*)ctxt;
+    size_t n_bytes = n_dwords * sizeof(uint32_t);
+
+    if (!n_bytes)
+        return;
+
+    if (n_bytes > AICA_WAVE_MEM_LEN || addr > AICA_WAVE_MEM_LEN - n_bytes) {
+        error_set_feature("out-of-bounds AICA memory access");
+        error_set_address(addr);
+        error_set_length(n_bytes);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    memcpy(wm->mem + addr, src, n_bytes);
+    savestate_mark_range(savestate_wave_dirty, addr, addr + (n_bytes - 1));
 }
 
 struct memory_interface aica_wave_mem_intf = {
@@ -200,5 +228,7 @@ struct memory_interface aica_wave_mem_intf = {
     .write16 = aica_wave_mem_write_16,
     .write8 = aica_wave_mem_write_8,
     .writefloat = aica_wave_mem_write_float,
-    .writedouble = aica_wave_mem_write_double
+    .writedouble = aica_wave_mem_write_double,
+
+    .write_dwords = aica_wave_mem_write_dwords
 };
@@ -33,6 +33,7 @@
 #include "washdc/MemoryMap.h"
 #include "dreamcast.h"
 #include "compiler_bullshit.h"
+#include "log.h"
 
 #define AICA_WAVE_MEM_LEN (0x009fffff - 0x00800000 + 1)
 
@@ -42,7 +43,8 @@ static_assert(!(AICA_WAVE_MEM_LEN & (AICA_WAVE_MEM_LEN - 1)),
 #define AICA_WAVE_MEM_MASK (AICA_WAVE_MEM_LEN - 1)
 
 struct aica_wave_mem {
-    uint8_t mem[AICA_WAVE_MEM_LEN];
+    // AICA_WAVE_MEM_LEN bytes from hostmem_alloc
+    uint8_t *mem;
 };
 
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt);
@@ -54,6 +56,8 @@ void aica_wave_mem_write_8(addr32_t addr, uint8_t val, void *ctxt);
 uint16_t aica_wave_mem_read_16(addr32_t addr, void *ctxt);
 void aica_wave_mem_write_16(addr32_t addr, uint16_t val, void *ctxt);
 void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt);
+void aica_wave_mem_write_dwords(addr32_t addr, uint32_t const *src,
+                                unsigned n_dwords, void *ctxt);
 
 
 extern bool aica_log_verbose_val;
@@ -28,6 +28,7 @@
 #include "washdc/error.h"
 #include "intmath.h"
 #include "compiler_bullshit.h"
+#include "config.h"
 
 #include "arm7.h"
 
@@ -305,6 +306,10 @@ void arm7_init(struct arm7 *arm7,
     arm7->inst_mem = inst_mem;
     arm7->reg[ARM7_REG_CPSR] = ARM7_MODE_SVC;
 
+    unsigned idx;
+    for (idx = 0; idx < ARM7_DECODE_CACHE_LEN; idx++)
+        arm7->decode_cache[idx].pc = ARM7_DECODE_CACHE_INVALID;
+
     arm7_error_callback.arg = arm7;
     arm7_error_callback.callback_fn = arm7_error_set_regs;
     error_add_callback(&arm7_error_callback);
@@ -771,10 +776,10 @@ DEF_BRANCH_INST(nv)
                 if (rd == 15)                                           \
                     val += 4;                                           \
                 addr &= ~3;                                             \
-                memory_map_write_32(arm7->map, addr, val);              \
+                arm7_write_32(arm7, addr, val);                         \
             } else {                                                    \
                 uint32_t addr_read = addr & ~3;                         \
-                uint32_t val = memory_map_read_32(arm7->map, addr_read); \
+                uint32_t val = arm7_read_32(arm7, addr_read);           \
                                                                         \
                 /* Deal with unaligned offsets.  It does the load */    \
                 /* from the aligned address (ie address with bits */    \
@@ -798,10 +803,10 @@ DEF_BRANCH_INST(nv)
                 uint32_t val = *arm7_gen_reg(arm7, rd);                 \
                 if (rd == 15)                                           \
                     val += 4;                                           \
-                memory_map_write_8(arm7->map, addr, val);               \
+                arm7_write_8(arm7, addr, val);                          \
             } else {                                                    \
                 *arm7_gen_reg(arm7, rd) =                               \
-                    (uint32_t)memory_map_read_8(arm7->map, addr);       \
+                    (uint32_t)arm7_read_8(arm7, addr);                  \
             }                                                           \
         }                                                               \
                                                                         \
@@ -971,10 +976,10 @@ DEF_LDR_STR_INST(nv)
                         if (bank == ARM7_MODE_USER) {                   \
                             *arm7_gen_reg_bank(arm7, reg_no,            \
                                                ARM7_MODE_USER) =        \
-                                memory_map_read_32(arm7->map, base);    \
+                                arm7_read_32(arm7, base);               \
                         } else {                                        \
                             *arm7_gen_reg(arm7, reg_no) =               \
-                                memory_map_read_32(arm7->map, base);    \
+                                arm7_read_32(arm7, base);               \
                         }                                               \
                         if (!pre)                                       \
                             base += 4;                                  \
@@ -992,7 +997,7 @@ DEF_LDR_STR_INST(nv)
                     if (pre)                                            \
                         base += 4;                                      \
                     arm7->reg[ARM7_REG_PC] =                            \
-                        memory_map_read_32(arm7->map, base);            \
+                        arm7_read_32(arm7, base);                       \
                     if (!pre)                                           \
                         base += 4;                                      \
                 }                                                       \
@@ -1003,14 +1008,14 @@ DEF_LDR_STR_INST(nv)
                         if (pre)                                        \
                             base += 4;                                  \
                         if (bank == ARM7_MODE_USER) {                   \
-                            memory_map_write_32(arm7->map, base,        \
+                            arm7_write_32(arm7, base,                   \
                                 *arm7_gen_reg_bank(arm7,                \
                                 reg_no,                                 \
                                 ARM7_MODE_USER));                       \
                         } else {                                        \
-                            memory_map_write_32(arm7->map, base,        \
-                                                *arm7_gen_reg(arm7,     \
-                                                              reg_no)); \
+                            arm7_write_32(arm7, base,                   \
+                                          *arm7_gen_reg(arm7,           \
+                                                        reg_no));       \
                         }                                               \
                         if (!pre)                                       \
                             base += 4;                                  \
@@ -1019,8 +1024,8 @@ DEF_LDR_STR_INST(nv)
                 if (reg_list & (1 << 15)) {                             \
                     if (pre)                                            \
                         base += 4;                                      \
-                    memory_map_write_32(arm7->map, base,                \
-                                        arm7->reg[ARM7_REG_PC] + 4);    \
+                    arm7_write_32(arm7, base,                           \
+                                  arm7->reg[ARM7_REG_PC] + 4);          \
                     if (!pre)                                           \
                         base += 4;                                      \
                 }                                                       \
@@ -1049,7 +1054,7 @@ DEF_LDR_STR_INST(nv)
                     if (pre)                                            \
                         base -= 4;                                      \
                     arm7->reg[ARM7_REG_PC] =                            \
-                        memory_map_read_32(arm7->map, base);            \
+                        arm7_read_32(arm7, base);                       \
                     if (!pre)                                           \
                         base -= 4;                                      \
                 }                                                       \
@@ -1059,10 +1064,10 @@ DEF_LDR_STR_INST(nv)
                             base -= 4;                                  \
                         if (bank == ARM7_MODE_USER) {                   \
                             *arm7_gen_reg_bank(arm7, reg_no, ARM7_MODE_USER) = \
-                                memory_map_read_32(arm7->map, base);    \
+                                arm7_read_32(arm7, base);               \
                         } else {                                        \
                             *arm7_gen_reg(arm7, reg_no) =               \
-                                memory_map_read_32(arm7->map, base);    \
+                                arm7_read_32(arm7, base);               \
                         }                                               \
                         if (!pre)                                       \
                             base -= 4;                                  \
@@ -1074,8 +1079,8 @@ DEF_LDR_STR_INST(nv)
                         RAISE_ERROR(ERROR_UNIMPLEMENTED);               \
                     if (pre)                                            \
                         base -= 4;                                      \
-                    memory_map_write_32(arm7->map, base,                \
-                                        arm7->reg[ARM7_REG_PC] + 4);    \
+                    arm7_write_32(arm7, base,                           \
+                                  arm7->reg[ARM7_REG_PC] + 4);          \
                     if (!pre)                                           \
                         base -= 4;                                      \
                 }                                                       \
@@ -1085,14 +1090,14 @@ DEF_LDR_STR_INST(nv)
                         if (pre)                                        \
                             base -= 4;                                  \
                         if (bank == ARM7_MODE_USER) {                   \
-                            memory_map_write_32(arm7->map, base,        \
-                                                *arm7_gen_reg_bank(arm7, \
-                                                                   reg_no, \
-                                                                   ARM7_MODE_USER)); \
+                            arm7_write_32(arm7, base,                   \
+                                          *arm7_gen_reg_bank(arm7,      \
+                                                             reg_no,    \
+                                                             ARM7_MODE_USER)); \
                         } else {                                        \
-                            memory_map_write_32(arm7->map, base,        \
-                                                *arm7_gen_reg(arm7,     \
-                                                              reg_no)); \
+                            arm7_write_32(arm7, base,                   \
+                                          *arm7_gen_reg(arm7,           \
+                                                        reg_no));       \
                         }                                               \
                         if (!pre)                                       \
                             base -= 4;                                  \
@@ -1515,14 +1520,14 @@ DEF_SWI_INST(nv)
             LOG_ERROR("TODO: unaligned ARM7 word swaps");       \
                                                                 \
         if (n_bytes == 4) {                                         \
-            uint32_t dat_in = memory_map_read_32(arm7->map, addr);  \
+            uint32_t dat_in = arm7_read_32(arm7, addr);             \
             uint32_t dat_out = *arm7_gen_reg(arm7, src_reg);        \
-            memory_map_write_32(arm7->map, addr, dat_out);          \
+            arm7_write_32(arm7, addr, dat_out);                     \
             *arm7_gen_reg(arm7, dst_reg) = dat_in;                  \
         } else {                                                    \
-            uint8_t dat_in = memory_map_read_8(arm7->map, addr);    \
+            uint8_t dat_in = arm7_read_8(arm7, addr);               \
             uint8_t dat_out = *arm7_gen_reg(arm7, src_reg);         \
-            memory_map_write_8(arm7->map, addr, dat_out);           \
+            arm7_write_8(arm7, addr, dat_out);                      \
             *arm7_gen_reg(arm7, dst_reg) = dat_in;                  \
         }                                                           \
     cond_fail:                                                      \
@@ -2015,3 +2020,116 @@ void arm7_excp_refresh(struct arm7 *arm7) {
         arm7->excp &= ~ARM7_EXCP_SWI;
     }
 }
+
+// register masks for arm7_idle_loop.  Bits 0-14 are R0-R14 of the current mode.
+#define ARM7_IDLE_REG(n) (1 << (n))
+#define ARM7_IDLE_FLAGS (1 << 15)
+
+// longest loop body arm7_idle_loop will look at, not counting the branch
+#define ARM7_IDLE_MAX_INSTS 8
+
+/*
+ * classify one instruction for arm7_idle_loop.  Only data-processing
+ * instructions and loads which don't touch R15, the CPSR or memory-mapped
+ * state other than by reading it are accepted.  *rd and *wr are set to the
+ * registers the instruction reads and writes.
+ */
+static bool arm7_idle_inst(arm7_inst inst, uint32_t *rd, uint32_t *wr) {
+    unsigned cond = inst >> ARM7_INST_COND_SHIFT;
+    unsigned rn = (inst >> 16) & 0xf;
+    unsigned rdst = (inst >> 12) & 0xf;
+    unsigned rm = inst & 0xf;
+    bool imm = inst & (1 << 25);
+
+    *rd = *wr = 0;
+
+    if (cond == 0xf)
+        return false;
+    if (cond != 0xe)
+        *rd |= ARM7_IDLE_FLAGS;
+
+    switch ((inst >> 26) & 3) {
+    case 0: {
+        // data processing
+        unsigned opcode = (inst >> 21) & 0xf;
+        bool s_flag = inst & (1 << 20);
+        bool is_cmp = opcode >= 8 && opcode <= 11;
+
+        // register-specified shifts, multiplies, swaps and halfword transfers
+        if (!imm && (inst & (1 << 4)))
+            return false;
+        // with S clear these are MRS and MSR
+        if (is_cmp && !s_flag)
+            return false;
+        if (rn == 15 || (!imm && rm == 15) || (!is_cmp && rdst == 15))
+            return false;
+
+        if (opcode != 13 && opcode != 15)
+            *rd |= ARM7_IDLE_REG(rn);
+        if (!imm) {
+            *rd |= ARM7_IDLE_REG(rm);
+            // RRX
+            if ((inst & 0xff0) == 0x060)
+                *rd |= ARM7_IDLE_FLAGS;
+        }
+        // ADC, SBC, RSC
+        if (opcode >= 5 && opcode <= 7)
+            *rd |= ARM7_IDLE_FLAGS;
+        if (s_flag)
+            *wr |= ARM7_IDLE_FLAGS;
+        if (!is_cmp)
+            *wr |= ARM7_IDLE_REG(rdst);
+        return true;
+    }
+    case 1: {
+        // LDR and LDRB, pre-indexed without writeback
+        bool pre = inst & (1 << 24);
+        bool writeback = inst & (1 << 21);
+        bool load = inst & (1 << 20);
+        if (!load || !pre || writeback || rn == 15 || rdst == 15)
+            return false;
+        if (imm) {
+            if ((inst & (1 << 4)) || rm == 15)
+                return false;
+            *rd |= ARM7_IDLE_REG(rm);
+            if ((inst & 0xff0) == 0x060)
+                *rd |= ARM7_IDLE_FLAGS;
+        }
+        *rd |= ARM7_IDLE_REG(rn);
+        *wr |= ARM7_IDLE_REG(rdst);
+        return true;
+    }
+    }
+    return false;
+}
+
+bool arm7_idle_loop(struct arm7 *arm7, uint32_t pc) {
+    if (!config_get_arm7_idle_skip())
+        return false;
+
+    arm7_inst branch = arm7_do_fetch_inst(arm7, pc);
+    unsigned cond = branch >> ARM7_INST_COND_SHIFT;
+
+    // B, but not BL
+    if ((branch & 0x0f000000) != 0x0a000000 || cond == 0xf)
+        return false;
+
+    uint32_t tgt = arm7_idle_target(pc, branch);
+    if (tgt > pc || pc - tgt > 4 * ARM7_IDLE_MAX_INSTS)
+        return false;
+
+    uint32_t read_first = 0, written = 0, rd, wr;
+    uint32_t addr;
+    for (addr = tgt; addr != pc; addr += 4) {
+        if (!arm7_idle_inst(arm7_do_fetch_inst(arm7, addr), &rd, &wr))
+            return false;
+        read_first |= rd & ~written;
+        written |= wr;
+    }
+
+    /*
+     * if the loop modifies anything that it reads before writing, then the
+     * next iteration won't be the same as this one.
+     */
+    return !(read_first & written);
+}
@@ -25,11 +25,13 @@
 
 #include <stdbool.h>
 #include <assert.h>
+#include <string.h>
 
 #include "washdc/error.h"
 #include "dc_sched.h"
 #include "washdc/MemoryMap.h"
 #include "hw/aica/aica_wave_mem.h"
+#include "savestate.h"
 #include "washdc/hw/arm7/arm7_reg_idx.h"
 
 /*
@@ -108,6 +110,32 @@ typedef uint32_t arm7_inst;
 
 typedef bool(*arm7_irq_fn)(void *dat);
 
+struct arm7;
+
+typedef unsigned(*arm7_op_fn)(struct arm7*,arm7_inst);
+
+/*
+ * direct-mapped cache of decoded instructions, indexed by PC.  Each entry
+ * also remembers the instruction word it was decoded from, so an entry is
+ * only used if the instruction the pipeline fetched still matches it.  That
+ * means writes to wave memory never need to invalidate anything.
+ */
+#define ARM7_DECODE_CACHE_SHIFT 13
+#define ARM7_DECODE_CACHE_LEN (1 << ARM7_DECODE_CACHE_SHIFT)
+#define ARM7_DECODE_CACHE_MASK (ARM7_DECODE_CACHE_LEN - 1)
+
+// PCs are always word-aligned, so this can never match
+#define ARM7_DECODE_CACHE_INVALID 0xffffffff
+
+struct arm7_decode_ent {
+    uint32_t pc;
+    arm7_inst inst;
+    arm7_op_fn fn;
+
+    // set if inst is the branch at the end of an idle loop (arm7_idle_loop)
+    bool idle;
+};
+
 struct arm7 {
     /*
      * For the sake of instruction-fetching, ARM7 disregards the memory_map and
@@ -146,6 +174,8 @@ struct arm7 {
     bool enabled;
 
     bool fiq_line;
+
+    struct arm7_decode_ent decode_cache[ARM7_DECODE_CACHE_LEN];
 };
 
 void arm7_init(struct arm7 *arm7, struct dc_clock *clk, struct aica_wave_mem *inst_mem);
@@ -166,9 +196,56 @@ void arm7_excp_refresh(struct arm7 *arm7);
 
 ERROR_INT_ATTR(arm7_execution_mode);
 
-typedef unsigned(*arm7_op_fn)(struct arm7*,arm7_inst);
 arm7_op_fn arm7_decode(struct arm7 *arm7, arm7_inst inst);
 
+/*
+ * returns true if the instruction at pc is a B which jumps backwards to the
+ * start of a short loop that does the same thing every time around until
+ * memory changes underneath it, like a sound driver polling for a command.
+ * When such a loop branches back to itself, nothing can change until the next
+ * scheduled event (which is also the only thing that can raise an FIQ), so
+ * the ARM7 clock can skip right to it.  This always returns false unless
+ * config_get_arm7_idle_skip() is set.
+ */
+bool arm7_idle_loop(struct arm7 *arm7, uint32_t pc);
+
+// target of the B instruction inst at pc
+static inline uint32_t arm7_idle_target(uint32_t pc, arm7_inst inst) {
+    uint32_t offs = inst & ((1 << 24) - 1);
+    if (offs & (1 << 23))
+        offs |= 0xff000000;
+    return pc + 8 + (offs << 2);
+}
+
+// same as arm7_decode, but goes through the decode cache first
+static inline arm7_op_fn
+arm7_decode_cached(struct arm7 *arm7, uint32_t pc, arm7_inst inst) {
+    struct arm7_decode_ent *ent =
+        arm7->decode_cache + ((pc >> 2) & ARM7_DECODE_CACHE_MASK);
+    if (ent->pc != pc || ent->inst != inst) {
+        ent->fn = arm7_decode(arm7, inst);
+        ent->pc = pc;
+        ent->inst = inst;
+        ent->idle = arm7_idle_loop(arm7, pc);
+    }
+    return ent->fn;
+}
+
+/*
+ * call this after executing the instruction at pc.  Returns true if it was
+ * the branch of an idle loop and it went back to the top of the loop.
+ *
+ * The decode cache only checks the branch itself, so the rest of the loop
+ * gets checked again here in case it's been overwritten since.
+ */
+static inline bool arm7_idle_hit(struct arm7 *arm7, uint32_t pc) {
+    struct arm7_decode_ent const *ent =
+        arm7->decode_cache + ((pc >> 2) & ARM7_DECODE_CACHE_MASK);
+    return ent->idle && ent->pc == pc &&
+        arm7->pipeline_pc[1] == arm7_idle_target(pc, ent->inst) &&
+        arm7_idle_loop(arm7, pc);
+}
+
 static inline uint32_t arm7_do_fetch_inst(struct arm7 *arm7, uint32_t addr);
 
 /*
@@ -201,7 +278,71 @@ static inline uint32_t arm7_do_fetch_inst(struct arm7 *arm7, uint32_t addr) {
     return ~0;
 }
 
-static inline arm7_inst arm7_fetch_inst(struct arm7 *arm7, int *extra_cycles) {
+/*
+ * data accesses.  Nearly all ARM7 traffic goes to wave memory, so anything
+ * that lands in it goes straight to inst_mem instead of through the
+ * memory_map.  AICA's registers (and anything out-of-bounds, which the
+ * memory_map will raise an error for) still take the callback path.
+ *
+ * When verbose AICA logging is on, everything goes through the memory_map so
+ * that the wave memory callbacks get to log it.
+ */
+#define ARM7_WAVE_MEM_LAST 0x007fffff
+
+#ifdef ENABLE_LOG_DEBUG
+#define ARM7_WAVE_FAST_PATH_ENABLED() (!aica_log_verbose_val)
+#else
+#define ARM7_WAVE_FAST_PATH_ENABLED() true
+#endif
+
+static inline bool arm7_wave_fast_path(uint32_t addr, unsigned n_bytes) {
+    return ARM7_WAVE_FAST_PATH_ENABLED() && addr <= ARM7_WAVE_MEM_LAST &&
+        (addr & AICA_WAVE_MEM_MASK) <= AICA_WAVE_MEM_LEN - n_bytes;
+}
+
+static inline uint32_t arm7_read_32(struct arm7 *arm7, uint32_t addr) {
+    if (arm7_wave_fast_path(addr, sizeof(uint32_t))) {
+        uint32_t val;
+        memcpy(&val, arm7->inst_mem->mem + (addr & AICA_WAVE_MEM_MASK),
+               sizeof(val));
+        return val;
+    }
+    return memory_map_read_32(arm7->map, addr);
+}
+
+static inline uint8_t arm7_read_8(struct arm7 *arm7, uint32_t addr) {
+    if (arm7_wave_fast_path(addr, sizeof(uint8_t)))
+        return arm7->inst_mem->mem[addr & AICA_WAVE_MEM_MASK];
+    return memory_map_read_8(arm7->map, addr);
+}
+
+static inline void
+arm7_write_32(struct arm7 *arm7, uint32_t addr, uint32_t val) {
+    if (arm7_wave_fast_path(addr, sizeof(uint32_t))) {
+        addr &= AICA_WAVE_MEM_MASK;
+        memcpy(arm7->inst_mem->mem + addr, &val, sizeof(val));
+        savestate_notify_wave_write(addr, sizeof(val));
+    } else {
+        memory_map_write_32(arm7->map, addr, val);
+    }
+}
+
+static inline void arm7_write_8(struct arm7 *arm7, uint32_t addr, uint8_t val) {
+    if (arm7_wave_fast_path(addr, sizeof(uint8_t))) {
+        addr &= AICA_WAVE_MEM_MASK;
+        arm7->inst_mem->mem[addr] = val;
+        savestate_notify_wave_write(addr, sizeof(val));
+    } else {
+        memory_map_write_8(arm7->map, addr, val);
+    }
+}
+
+/*
+ * returns the instruction at the execution stage of the pipeline.  If pc_out
+ * is not NULL, the address of that instruction is written to it.
+ */
+static inline arm7_inst
+arm7_fetch_inst(struct arm7 *arm7, int *extra_cycles, uint32_t *pc_out) {
     uint32_t pc = arm7->reg[ARM7_REG_PC];
 
     arm7_inst inst_fetched = arm7_do_fetch_inst(arm7, pc);
@@ -209,6 +350,9 @@ static inline arm7_inst arm7_fetch_inst(struct arm7 *arm7, int *extra_cycles) {
     arm7_inst newinst = arm7->pipeline[0];
     arm7_inst ret = arm7->pipeline[1];
 
+    if (pc_out)
+        *pc_out = arm7->pipeline_pc[1];
+
     arm7->pipeline_pc[0] = pc;
     arm7->pipeline[0] = inst_fetched;
     arm7->pipeline_pc[1] = newpc;
@@ -0,0 +1,358 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "washdc/error.h"
+#include "jit/jit_il.h"
+#include "jit/code_block.h"
+#include "jit/optimize.h"
+#include "jit/code_cache.h"
+#include "jit/jit_intp/code_block_intp.h"
+
+#include "arm7_jit.h"
+
+// 2S + 1N, same as the interpreter's data-processing instructions
+#define ARM7_JIT_DATA_OP_CYCLES 3
+
+// initial size of the arena that holds il while a block is being compiled
+#define ARM7_JIT_IL_ARENA_LEN (16 * 1024)
+
+// data-processing opcodes, bits 21-24 of the instruction
+enum arm7_data_op {
+    ARM7_DATA_OP_AND = 0,
+    ARM7_DATA_OP_EOR = 1,
+    ARM7_DATA_OP_SUB = 2,
+    ARM7_DATA_OP_RSB = 3,
+    ARM7_DATA_OP_ADD = 4,
+    ARM7_DATA_OP_ORR = 12,
+    ARM7_DATA_OP_MOV = 13,
+    ARM7_DATA_OP_BIC = 14,
+    ARM7_DATA_OP_MVN = 15
+};
+
+static struct code_cache arm7_jit_cache;
+static struct jit_arena arm7_jit_il_arena;
+
+/*
+ * cycles spent in the interpreter by the block that's currently executing.
+ * This can't be known at compile-time.
+ */
+static unsigned arm7_jit_dyn_cycles;
+
+struct arm7_jit_ctx {
+    struct arm7 *arm7;
+    struct il_code_block *il_blk;
+
+    // slots that hold R0-R14 within the block, or -1
+    int reg_slot[15];
+    bool reg_dirty[15];
+};
+
+static void
+arm7_jit_compile(struct arm7 *arm7, struct jit_code_block *blk, uint32_t addr);
+
+void arm7_jit_init(struct arm7 *arm7) {
+    // the ARM7 only ever uses the interpreter backend
+    code_cache_init(&arm7_jit_cache, ARM7_JIT_CACHE_TBL_SHIFT, false);
+    jit_arena_init(&arm7_jit_il_arena, ARM7_JIT_IL_ARENA_LEN);
+}
+
+void arm7_jit_cleanup(struct arm7 *arm7) {
+    jit_arena_cleanup(&arm7_jit_il_arena);
+    code_cache_cleanup(&arm7_jit_cache);
+}
+
+void arm7_jit_gc(void) {
+    code_cache_gc(&arm7_jit_cache);
+}
+
+static bool
+arm7_jit_check(struct arm7 *arm7, struct jit_code_block const *blk,
+               uint32_t addr) {
+    unsigned idx;
+    for (idx = 0; idx < blk->src_len; idx++)
+        if (arm7_do_fetch_inst(arm7, addr + 4 * idx) != blk->src[idx])
+            return false;
+    return true;
+}
+
+struct jit_code_block *arm7_jit_get_block(struct arm7 *arm7) {
+    uint32_t addr = arm7->pipeline_pc[1];
+    struct cache_entry *ent = code_cache_find(&arm7_jit_cache, addr);
+
+    if (ent->valid && !arm7_jit_check(arm7, &ent->blk, addr)) {
+        // looking it up again gets a freshly init'd block
+        code_cache_invalidate_entry(&arm7_jit_cache, ent);
+        ent = code_cache_find(&arm7_jit_cache, addr);
+    }
+
+    if (!ent->valid) {
+        arm7_jit_compile(arm7, &ent->blk, addr);
+        code_cache_set_valid(&arm7_jit_cache, ent);
+    }
+
+    return &ent->blk;
+}
+
+unsigned arm7_jit_exec(struct arm7 *arm7, struct jit_code_block *blk) {
+    // pipeline refill penalty from whatever jumped here
+    arm7_jit_dyn_cycles = arm7->extra_cycles;
+    arm7->extra_cycles = 0;
+
+    unsigned n_cycles;
+    code_block_intp_exec(arm7, &blk->intp, &n_cycles);
+
+    return n_cycles + arm7_jit_dyn_cycles;
+}
+
+/*
+ * runs the instruction in the pipeline's execution stage through the
+ * interpreter.
+ */
+static void arm7_jit_fallback(void *cpu, cpu_inst_param inst) {
+    struct arm7 *arm7 = (struct arm7*)cpu;
+    int extra_cycles;
+    uint32_t pc;
+    arm7_inst fetched = arm7_fetch_inst(arm7, &extra_cycles, &pc);
+    arm7_op_fn handler = arm7_decode_cached(arm7, pc, fetched);
+    arm7_jit_dyn_cycles += handler(arm7, fetched) + extra_cycles;
+}
+
+/*
+ * translated instructions don't touch the pipeline, so this puts it where it
+ * would have been if the interpreter had executed them.
+ */
+static void arm7_jit_advance(void *cpu, uint32_t n_insts) {
+    struct arm7 *arm7 = (struct arm7*)cpu;
+    uint32_t pc = arm7->reg[ARM7_REG_PC] + 4 * n_insts;
+
+    arm7->reg[ARM7_REG_PC] = pc;
+    arm7->pipeline_pc[1] = pc - 8;
+    arm7->pipeline[1] = arm7_do_fetch_inst(arm7, pc - 8);
+    arm7->pipeline_pc[0] = pc - 4;
+    arm7->pipeline[0] = arm7_do_fetch_inst(arm7, pc - 4);
+}
+
+static unsigned
+arm7_jit_reg_slot(struct arm7_jit_ctx *ctx, unsigned reg, bool load) {
+    if (ctx->reg_slot[reg] < 0) {
+        unsigned slot = alloc_slot(ctx->il_blk, WASHDC_JIT_SLOT_GEN);
+        if (load)
+            jit_load_slot(ctx->il_blk, slot, ctx->arm7->reg + ARM7_REG_R0 + reg);
+        ctx->reg_slot[reg] = slot;
+    }
+    return ctx->reg_slot[reg];
+}
+
+static void arm7_jit_flush_regs(struct arm7_jit_ctx *ctx) {
+    unsigned reg;
+    for (reg = 0; reg < 15; reg++) {
+        if (ctx->reg_slot[reg] < 0)
+            continue;
+        if (ctx->reg_dirty[reg]) {
+            jit_store_slot(ctx->il_blk, ctx->reg_slot[reg],
+                           ctx->arm7->reg + ARM7_REG_R0 + reg);
+        }
+        jit_discard_slot(ctx->il_blk, ctx->reg_slot[reg]);
+        ctx->reg_slot[reg] = -1;
+        ctx->reg_dirty[reg] = false;
+    }
+}
+
+static inline uint32_t arm7_jit_ror(uint32_t in, unsigned n_bits) {
+    n_bits %= 32;
+    return n_bits ? ((in >> n_bits) | (in << (32 - n_bits))) : in;
+}
+
+/*
+ * translate data-processing instructions that always execute, don't set
+ * flags, don't involve R15 and whose second operand is either an immediate or
+ * a register shifted by a constant that doesn't need special-casing.
+ *
+ * returns false if the instruction has to go through the interpreter.
+ */
+static bool arm7_jit_data_op(struct arm7_jit_ctx *ctx, arm7_inst inst) {
+    struct il_code_block *il_blk = ctx->il_blk;
+
+    if ((inst >> 28) != 0xe || (inst & (3 << 26)) || (inst & (1 << 20)))
+        return false;
+
+    bool i_flag = inst & (1 << 25);
+    enum arm7_data_op opcode = (enum arm7_data_op)((inst >> 21) & 0xf);
+    unsigned rn = (inst >> 16) & 0xf;
+    unsigned rd = (inst >> 12) & 0xf;
+    unsigned rm = inst & 0xf;
+    unsigned shift_fn = (inst >> 5) & 3;
+    unsigned shift_amt = (inst >> 7) & 0x1f;
+
+    switch (opcode) {
+    case ARM7_DATA_OP_AND:
+    case ARM7_DATA_OP_EOR:
+    case ARM7_DATA_OP_SUB:
+    case ARM7_DATA_OP_RSB:
+    case ARM7_DATA_OP_ADD:
+    case ARM7_DATA_OP_ORR:
+    case ARM7_DATA_OP_BIC:
+        if (rn == 15)
+            return false;
+        break;
+    case ARM7_DATA_OP_MOV:
+    case ARM7_DATA_OP_MVN:
+        break;
+    default:
+        return false;
+    }
+
+    if (rd == 15)
+        return false;
+
+    if (!i_flag) {
+        // bit 4 is shift-by-register, or it's actually a MUL or SWP
+        if ((inst & (1 << 4)) || rm == 15)
+            return false;
+
+        // LSR #0 and ASR #0 mean 32, and ROR can't be done in the IL
+        if (shift_fn == 3 || (shift_fn != 0 && !shift_amt))
+            return false;
+    }
+
+    unsigned op2 = alloc_slot(il_blk, WASHDC_JIT_SLOT_GEN);
+    if (i_flag) {
+        jit_set_slot(il_blk, op2,
+                     arm7_jit_ror(inst & 0xff, ((inst >> 8) & 0xf) * 2));
+    } else {
+        jit_mov(il_blk, arm7_jit_reg_slot(ctx, rm, true), op2);
+        if (shift_amt) {
+            if (shift_fn == 0)
+                jit_shll(il_blk, op2, shift_amt);
+            else if (shift_fn == 1)
+                jit_shlr(il_blk, op2, shift_amt);
+            else
+                jit_shar(il_blk, op2, shift_amt);
+        }
+    }
+
+    unsigned res;
+    if (opcode == ARM7_DATA_OP_MOV || opcode == ARM7_DATA_OP_MVN) {
+        res = op2;
+        if (opcode == ARM7_DATA_OP_MVN)
+            jit_not(il_blk, res);
+    } else {
+        res = alloc_slot(il_blk, WASHDC_JIT_SLOT_GEN);
+        unsigned rn_slot = arm7_jit_reg_slot(ctx, rn, true);
+        if (opcode == ARM7_DATA_OP_RSB) {
+            jit_mov(il_blk, op2, res);
+            jit_sub(il_blk, rn_slot, res);
+        } else {
+            jit_mov(il_blk, rn_slot, res);
+            switch (opcode) {
+            case ARM7_DATA_OP_AND:
+                jit_and(il_blk, op2, res);
+                break;
+            case ARM7_DATA_OP_EOR:
+                jit_xor(il_blk, op2, res);
+                break;
+            case ARM7_DATA_OP_SUB:
+                jit_sub(il_blk, op2, res);
+                break;
+            case ARM7_DATA_OP_ADD:
+                jit_add(il_blk, op2, res);
+                break;
+            case ARM7_DATA_OP_ORR:
+                jit_or(il_blk, op2, res);
+                break;
+            case ARM7_DATA_OP_BIC:
+                jit_not(il_blk, op2);
+                jit_and(il_blk, op2, res);
+                break;
+            default:
+                RAISE_ERROR(ERROR_INTEGRITY);
+            }
+        }
+        jit_discard_slot(il_blk, op2);
+    }
+
+    jit_mov(il_blk, res, arm7_jit_reg_slot(ctx, rd, false));
+    jit_discard_slot(il_blk, res);
+    ctx->reg_dirty[rd] = true;
+
+    return true;
+}
+
+static void
+arm7_jit_compile(struct arm7 *arm7, struct jit_code_block *blk, uint32_t addr) {
+    struct il_code_block il_blk;
+    struct arm7_jit_ctx ctx = {
+        .arm7 = arm7,
+        .il_blk = &il_blk
+    };
+    unsigned reg;
+    for (reg = 0; reg < 15; reg++) {
+        ctx.reg_slot[reg] = -1;
+        ctx.reg_dirty[reg] = false;
+    }
+
+    blk->src = (uint32_t*)malloc(ARM7_JIT_MAX_INSTS * sizeof(blk->src[0]));
+    if (!blk->src)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    il_code_block_init_arena(&il_blk, &arm7_jit_il_arena);
+
+#ifdef JIT_PROFILE
+    il_blk.profile = blk->profile;
+#endif
+
+    unsigned n_insts = 0, n_translated = 0;
+    bool fallback = false;
+    while (n_insts < ARM7_JIT_MAX_INSTS) {
+        arm7_inst inst = arm7_do_fetch_inst(arm7, addr + 4 * n_insts);
+        blk->src[n_insts++] = inst;
+        if (!arm7_jit_data_op(&ctx, inst)) {
+            fallback = true;
+            break;
+        }
+        n_translated++;
+    }
+    blk->src_len = n_insts;
+
+    arm7_jit_flush_regs(&ctx);
+    if (n_translated)
+        jit_call_func_imm32(&il_blk, arm7_jit_advance, n_translated);
+    if (fallback)
+        jit_fallback(&il_blk, arm7_jit_fallback, blk->src[n_insts - 1]);
+
+    unsigned pc_slot = alloc_slot(&il_blk, WASHDC_JIT_SLOT_GEN);
+    jit_load_slot(&il_blk, pc_slot, arm7->pipeline_pc + 1);
+    jit_jump(&il_blk, pc_slot, pc_slot);
+
+    jit_optimize(&il_blk);
+
+#ifdef INVARIANTS
+    jit_sanity_checks(il_blk.inst_list, il_blk.inst_count);
+#endif
+
+    code_block_intp_compile(arm7, &blk->intp, &il_blk,
+                            n_translated * ARM7_JIT_DATA_OP_CYCLES);
+    il_code_block_cleanup(&il_blk);
+    jit_arena_reset(&arm7_jit_il_arena);
+}
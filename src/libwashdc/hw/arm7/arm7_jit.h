@@ -0,0 +1,70 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ARM7_JIT_H_
+#define ARM7_JIT_H_
+
+#include <stdint.h>
+
+#include "jit/code_block.h"
+#include "arm7.h"
+
+/*
+ * ARM7 frontend for the IL.
+ *
+ * A block is a run of instructions which can be translated directly into IL
+ * followed by at most one instruction which can't.  The untranslated
+ * instruction always goes through the interpreter and always ends the block,
+ * since it might branch, raise an exception or write to an AICA register
+ * that triggers an FIQ.  Translated instructions never touch R15 or the CPSR.
+ */
+
+// upper-limit on the number of ARM7 instructions in a block
+#define ARM7_JIT_MAX_INSTS 32
+
+// log2 of the number of entries in the ARM7 code cache's hash table
+#define ARM7_JIT_CACHE_TBL_SHIFT 12
+
+void arm7_jit_init(struct arm7 *arm7);
+void arm7_jit_cleanup(struct arm7 *arm7);
+
+// call this periodically from outside of ARM7 context
+void arm7_jit_gc(void);
+
+/*
+ * return the block for the instruction in the pipeline's execution stage,
+ * compiling it first if necessary.
+ *
+ * Each block keeps a copy of the instructions it was compiled from in its
+ * src array.  These get compared against wave memory every time the block is
+ * looked up, which keeps blocks coherent with SH4 writes and DMA without any
+ * invalidation hooks.
+ */
+struct jit_code_block *arm7_jit_get_block(struct arm7 *arm7);
+
+/*
+ * run a block returned by arm7_jit_get_block and return the number of ARM7
+ * cycles it took.
+ */
+unsigned arm7_jit_exec(struct arm7 *arm7, struct jit_code_block *blk);
+
+#endif
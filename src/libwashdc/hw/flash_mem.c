@@ -111,11 +111,24 @@ void flash_mem_init(struct flash_mem *mem, char const *path, bool writeable) {
     strncpy(mem->file_path, path, sizeof(mem->file_path));
     mem->file_path[WASHDC_PATH_LEN - 1] = '\0';
 
+    mem->flash_mem = mem->flash_buf;
     flash_mem_load(mem);
+
+    /*
+     * writes to a mapped image go straight to the backing file, so it never
+     * has to be rewritten as a whole.
+     */
+    if (writeable &&
+        mapped_file_open(&mem->map, mem->file_path, FLASH_MEM_SZ) == 0)
+        mem->flash_mem = mem->map.dat;
 }
 
 void flash_mem_cleanup(struct flash_mem *mem) {
-    if (mem->writeable) {
+    if (mem->map.dat) {
+        LOG_INFO("Syncing flash memory to %s\n", mem->file_path);
+        mapped_file_close(&mem->map);
+        mem->flash_mem = mem->flash_buf;
+    } else if (mem->writeable) {
         LOG_INFO("Saving flash memory to %s\n", mem->file_path);
         washdc_hostfile backing_file =
             washdc_hostfile_open(mem->file_path,
@@ -410,6 +423,7 @@ static void flash_mem_do_erase(struct flash_mem *mem, addr32_t addr) {
     FLASH_MEM_TRACE("FLASH_CMD_ERASE - ERASE SECTOR 0x%08x\n", (unsigned)addr);
 
     memset(mem->flash_mem + addr, 0xff, FLASH_SECTOR_SIZE);
+    mapped_file_mark(&mem->map, addr, FLASH_SECTOR_SIZE);
 }
 
 static void
@@ -422,6 +436,7 @@ flash_mem_do_write_cmd(struct flash_mem *mem, addr32_t addr, uint8_t val) {
     memcpy(&tmp, mem->flash_mem + (addr - ADDR_FLASH_FIRST), sizeof(tmp));
     tmp &= val;
     memcpy(mem->flash_mem + (addr - ADDR_FLASH_FIRST), &tmp, sizeof(tmp));
+    mapped_file_mark(&mem->map, addr - ADDR_FLASH_FIRST, sizeof(tmp));
 
     mem->state = FLASH_STATE_AA;
 }
@@ -27,6 +27,7 @@
 #include "mem_areas.h"
 #include "washdc/MemoryMap.h"
 #include "washdc/washdc.h"
+#include "mapped_file.h"
 
 #define FLASH_MEM_SZ (ADDR_FLASH_LAST - ADDR_FLASH_FIRST + 1)
 
@@ -51,7 +52,13 @@ struct flash_mem {
     // if true, the backing file will be written to from flash_mem_cleanup
     bool writeable;
 
-    uint8_t flash_mem[FLASH_MEM_SZ];
+    /*
+     * points into map when the backing file is writeable and could be mapped,
+     * otherwise it points to flash_buf.
+     */
+    uint8_t *flash_mem;
+    uint8_t flash_buf[FLASH_MEM_SZ];
+    struct mapped_file map;
 
     // path to the backing file
     char file_path[WASHDC_PATH_LEN];
@@ -346,7 +346,6 @@ g2_dma_ad_xfer(uint32_t src_addr, uint32_t dst_addr, unsigned n_bytes) {
 
     sh4_dmac_transfer_words(dreamcast_get_cpu(), src_addr, dst_addr, n_words);
 
-    aica_dma_raise_event.handler = post_delay_aica_dma_int;
     aica_dma_raise_event.when =
         clock_cycle_stamp(&sh4_clock) + AICA_DMA_COMPLETE_INT_DELAY(n_bytes);
     sched_event(&sh4_clock, &aica_dma_raise_event);
@@ -673,6 +672,10 @@ static void ddlen_reg_write(struct mmio_region_g2_reg_32 *region,
 }
 
 void g2_reg_init(void) {
+    aica_dma_raise_event.handler = post_delay_aica_dma_int;
+    aica_dma_raise_event.name = "post_delay_aica_dma_int";
+    sched_event_register(&aica_dma_raise_event, "aica_dma_int");
+
     init_mmio_region_g2_reg_32(&mmio_region_g2_reg_32, (void*)reg_backing);
 
     mmio_region_g2_reg_32_init_cell(&mmio_region_g2_reg_32,
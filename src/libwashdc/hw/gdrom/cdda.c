@@ -0,0 +1,279 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "cdrom.h"
+#include "mount.h"
+#include "log.h"
+#include "threading.h"
+#include "perf_cnt.h"
+#include "trace.h"
+
+#include "cdda.h"
+
+/*
+ * 32 frames is a little under half a second of audio, which is plenty of
+ * slack for a disc image that's sitting on a host filesystem.
+ */
+#define CDDA_RING_FRAMES 32
+
+// each frame is 588 samples of 16-bit little-endian stereo
+#define CDDA_FRAME_SAMPLES (CDROM_FRAME_SIZE / 4)
+
+static struct cdda_stream {
+    washdc_mutex lock;
+    washdc_cvar req_cvar;
+    washdc_thread thread;
+    bool quit;
+
+    enum cdda_state state;
+
+    /*
+     * incremented every time the ring gets flushed so that the read thread
+     * knows to throw away a frame that was in flight when that happened.
+     */
+    unsigned gen;
+
+    unsigned fad_first, fad_last, n_repeat;
+
+    // next frame for the read thread, and the frame that's playing now
+    unsigned fad_next, fad_cur;
+
+    // true once the read thread has read the last frame it's going to read
+    bool eof;
+
+    /*
+     * frames [head, head + n_frames) are ready to be played.  The read thread
+     * owns the slot right after those, and nothing else touches it.
+     */
+    unsigned head, n_frames, sample_no;
+    unsigned ring_fad[CDDA_RING_FRAMES];
+    uint8_t ring[CDDA_RING_FRAMES][CDROM_FRAME_SIZE];
+} cdda;
+
+static void cdda_read_thread_main(void *argp);
+static void cdda_flush(unsigned fad);
+
+void cdda_init(void) {
+    memset(&cdda, 0, sizeof(cdda));
+
+    washdc_mutex_init(&cdda.lock);
+    washdc_cvar_init(&cdda.req_cvar);
+    washdc_thread_create(&cdda.thread, cdda_read_thread_main, NULL);
+}
+
+void cdda_cleanup(void) {
+    washdc_mutex_lock(&cdda.lock);
+    cdda.quit = true;
+    washdc_cvar_signal(&cdda.req_cvar);
+    washdc_mutex_unlock(&cdda.lock);
+    washdc_thread_join(&cdda.thread);
+
+    washdc_cvar_cleanup(&cdda.req_cvar);
+    washdc_mutex_cleanup(&cdda.lock);
+}
+
+static bool cdda_want_read(void) {
+    return (cdda.state == CDDA_STATE_PLAYING ||
+            cdda.state == CDDA_STATE_PAUSED) &&
+        !cdda.eof && cdda.n_frames < CDDA_RING_FRAMES;
+}
+
+static void cdda_read_thread_main(void *argp) {
+    washdc_mutex_lock(&cdda.lock);
+    for (;;) {
+        while (!cdda.quit && !cdda_want_read())
+            washdc_cvar_wait(&cdda.req_cvar, &cdda.lock);
+        if (cdda.quit)
+            break;
+
+        unsigned gen = cdda.gen;
+        unsigned fad = cdda.fad_next;
+        unsigned slot = (cdda.head + cdda.n_frames) % CDDA_RING_FRAMES;
+        washdc_mutex_unlock(&cdda.lock);
+
+        struct trace_span span;
+        trace_begin(&span, TRACE_NO_CYCLE);
+        PERF_TIMER_BEGIN(PERF_GDROM_READ);
+        int err = mount_read_raw_sectors(cdda.ring[slot], fad, 1);
+        PERF_TIMER_END(PERF_GDROM_READ);
+        trace_end(&span, TRACE_TRACK_GDROM, "cdda_read", TRACE_NO_CYCLE);
+
+        washdc_mutex_lock(&cdda.lock);
+        if (gen != cdda.gen)
+            continue;
+
+        if (err < 0) {
+            // let whatever's already in the ring play out, then stop
+            LOG_ERROR("CDDA: failed to read fad %u\n", fad);
+            cdda.eof = true;
+            continue;
+        }
+
+        cdda.ring_fad[slot] = fad;
+        cdda.n_frames++;
+
+        if (++cdda.fad_next >= cdda.fad_last) {
+            if (cdda.n_repeat) {
+                if (cdda.n_repeat != CDDA_REPEAT_FOREVER)
+                    cdda.n_repeat--;
+                cdda.fad_next = cdda.fad_first;
+            } else {
+                cdda.eof = true;
+            }
+        }
+    }
+    washdc_mutex_unlock(&cdda.lock);
+}
+
+// cdda.lock must be held
+static void cdda_flush(unsigned fad) {
+    cdda.gen++;
+    cdda.head = cdda.n_frames = cdda.sample_no = 0;
+    cdda.eof = false;
+    cdda.fad_next = cdda.fad_cur = fad;
+}
+
+void cdda_play(unsigned fad_first, unsigned fad_last, unsigned n_repeat) {
+    washdc_mutex_lock(&cdda.lock);
+    cdda_flush(fad_first);
+    cdda.fad_first = fad_first;
+    cdda.fad_last = fad_last;
+    cdda.n_repeat = n_repeat;
+    cdda.eof = fad_first >= fad_last;
+    cdda.state = cdda.eof ? CDDA_STATE_DONE : CDDA_STATE_PLAYING;
+    washdc_cvar_signal(&cdda.req_cvar);
+    washdc_mutex_unlock(&cdda.lock);
+}
+
+void cdda_seek(unsigned fad) {
+    washdc_mutex_lock(&cdda.lock);
+    cdda_flush(fad);
+    // a seek doesn't say where to stop, so play to the end of the disc
+    if (mount_check())
+        cdda.fad_last = cdrom_lba_to_fad(mount_get_leadout());
+    else
+        cdda.fad_last = fad;
+    cdda.fad_first = fad;
+    cdda.n_repeat = 0;
+    cdda.eof = fad >= cdda.fad_last;
+    cdda.state = CDDA_STATE_PAUSED;
+    washdc_cvar_signal(&cdda.req_cvar);
+    washdc_mutex_unlock(&cdda.lock);
+}
+
+void cdda_pause(void) {
+    washdc_mutex_lock(&cdda.lock);
+    if (cdda.state == CDDA_STATE_PLAYING)
+        cdda.state = CDDA_STATE_PAUSED;
+    washdc_mutex_unlock(&cdda.lock);
+}
+
+void cdda_resume(void) {
+    washdc_mutex_lock(&cdda.lock);
+    if (cdda.state == CDDA_STATE_PAUSED) {
+        cdda.state = CDDA_STATE_PLAYING;
+        washdc_cvar_signal(&cdda.req_cvar);
+    }
+    washdc_mutex_unlock(&cdda.lock);
+}
+
+void cdda_stop(void) {
+    washdc_mutex_lock(&cdda.lock);
+    cdda_flush(cdda.fad_cur);
+    cdda.state = CDDA_STATE_STOPPED;
+    washdc_mutex_unlock(&cdda.lock);
+}
+
+enum cdda_state cdda_get_state(void) {
+    washdc_mutex_lock(&cdda.lock);
+    enum cdda_state state = cdda.state;
+    washdc_mutex_unlock(&cdda.lock);
+    return state;
+}
+
+unsigned cdda_get_fad(void) {
+    washdc_mutex_lock(&cdda.lock);
+    unsigned fad = cdda.fad_cur;
+    washdc_mutex_unlock(&cdda.lock);
+    return fad;
+}
+
+static inline int32_t cdda_sample(uint8_t const *src) {
+    return (int16_t)(uint16_t)(src[0] | (src[1] << 8));
+}
+
+bool cdda_consume(int32_t *out, unsigned n_samples,
+                  int32_t gain_l, int32_t gain_r) {
+    unsigned idx = 0;
+    bool freed = false;
+
+    washdc_mutex_lock(&cdda.lock);
+
+    if (cdda.state != CDDA_STATE_PLAYING) {
+        washdc_mutex_unlock(&cdda.lock);
+        return false;
+    }
+
+    while (idx < n_samples && cdda.n_frames) {
+        uint8_t const *src = cdda.ring[cdda.head] + 4 * cdda.sample_no;
+        unsigned count = CDDA_FRAME_SAMPLES - cdda.sample_no;
+        if (count > n_samples - idx)
+            count = n_samples - idx;
+
+        if (out) {
+            // the 12 bits of gain plus one more to average the two channels
+            unsigned last = idx + count;
+            for (; idx < last; idx++, src += 4)
+                out[idx] = (cdda_sample(src) * gain_l +
+                            cdda_sample(src + 2) * gain_r) >> 13;
+        } else {
+            idx += count;
+        }
+
+        cdda.fad_cur = cdda.ring_fad[cdda.head];
+        cdda.sample_no += count;
+        if (cdda.sample_no == CDDA_FRAME_SAMPLES) {
+            cdda.sample_no = 0;
+            cdda.head = (cdda.head + 1) % CDDA_RING_FRAMES;
+            cdda.n_frames--;
+            freed = true;
+        }
+    }
+
+    if (!cdda.n_frames && cdda.eof) {
+        cdda.state = CDDA_STATE_DONE;
+    } else if (idx < n_samples) {
+        LOG_DBG("CDDA: underrun (%u samples)\n", n_samples - idx);
+    }
+
+    if (freed)
+        washdc_cvar_signal(&cdda.req_cvar);
+
+    washdc_mutex_unlock(&cdda.lock);
+
+    if (out && idx < n_samples)
+        memset(out + idx, 0, (n_samples - idx) * sizeof(out[0]));
+
+    return true;
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef CDDA_H_
+#define CDDA_H_
+
+/*
+ * CDDA playback.
+ *
+ * Audio frames are read ahead of the playback position on a background thread
+ * into a small ring, and the AICA pulls samples out of that ring a block at a
+ * time.  The AICA never waits on the disc image; if the ring runs dry it just
+ * gets silence for that block.
+ *
+ * There's only ever one stream since there's only ever one disc.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum cdda_state {
+    CDDA_STATE_STOPPED,
+    CDDA_STATE_PLAYING,
+    CDDA_STATE_PAUSED,
+
+    // reached the end of the requested range and ran out of repeats
+    CDDA_STATE_DONE
+};
+
+// passing this as n_repeat to cdda_play makes it repeat forever
+#define CDDA_REPEAT_FOREVER 0xf
+
+void cdda_init(void);
+void cdda_cleanup(void);
+
+/*
+ * play frames [fad_first, fad_last).  The range gets played another n_repeat
+ * times after the first time.
+ */
+void cdda_play(unsigned fad_first, unsigned fad_last, unsigned n_repeat);
+
+// move to the given fad and pause there
+void cdda_seek(unsigned fad);
+
+void cdda_pause(void);
+
+// resume from a pause.  This does nothing unless playback is paused.
+void cdda_resume(void);
+
+void cdda_stop(void);
+
+enum cdda_state cdda_get_state(void);
+
+// fad of the frame that's currently playing
+unsigned cdda_get_fad(void);
+
+/*
+ * Fill out with the next n_samples samples of mono audio.  gain_l and gain_r
+ * are applied to the left and right channels; they have 12 bits of fraction.
+ * If out is NULL the samples still get consumed but they're thrown away.
+ *
+ * Returns false if nothing is playing, in which case out is left alone.
+ * Otherwise any samples which aren't ready yet are filled in with silence.
+ */
+bool cdda_consume(int32_t *out, unsigned n_samples,
+                  int32_t gain_l, int32_t gain_r);
+
+#endif
@@ -20,6 +20,7 @@
  *
  ******************************************************************************/
 
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,10 +32,17 @@
 #include "hw/sys/holly_intc.h"
 #include "washdc/error.h"
 #include "gdrom_response.h"
+#include "cdda.h"
 #include "dc_sched.h"
 #include "hw/g1/g1_reg.h"
 #include "intmath.h"
+#include "perf_cnt.h"
+#include "trace.h"
 #include "compiler_bullshit.h"
+#include "washdc/MemoryMap.h"
+#include "jit/code_cache.h"
+#include "savestate.h"
+#include "bench.h"
 
 #include "gdrom.h"
 
@@ -97,6 +105,15 @@ static DEF_ERROR_INT_ATTR(gdrom_seek_seek_pt)
 
 static bool bufq_empty(struct gdrom_ctxt *gdrom);
 
+static void gdrom_read_job_init(struct gdrom_read_job *job);
+static void gdrom_read_job_cleanup(struct gdrom_read_job *job);
+static void gdrom_read_job_submit(struct gdrom_read_job *job,
+                                  unsigned fad, unsigned n_sectors);
+static void gdrom_read_job_wait(struct gdrom_read_job *job);
+static int gdrom_read_job_finish(struct gdrom_ctxt *gdrom);
+static void gdrom_read_thread_main(void *argp);
+static void gdrom_set_read_error(struct gdrom_ctxt *gdrom);
+
 static void gdrom_delayed_processing(struct gdrom_ctxt *gdrom, dc_cycle_stamp_t delay);
 
 static void post_delay_gdrom_delayed_processing(struct SchedEvent *event);
@@ -106,6 +123,8 @@ static void post_delay_gdrom_delayed_processing(struct SchedEvent *event);
 // TODO: come up with some latency measurements on real hardware.
 #define GDROM_INT_DELAY (SCHED_FREQUENCY / 1024)
 
+static unsigned long long dma_bytes_total;
+
 /* static bool gdrom_int_scheduled; */
 /* struct SchedEvent gdrom_int_raise_event = { */
 /*     .handler = post_delay_gdrom_delayed_processing */
@@ -160,6 +179,11 @@ static void post_delay_gdrom_delayed_processing(struct SchedEvent *event) {
         GDROM_TRACE("%s - PIO read complete\n", __func__);
         gdrom->meta.read.bytes_read = 0;
 
+        if (gdrom_read_job_finish(gdrom) != 0) {
+            gdrom_set_read_error(gdrom);
+            gdrom->meta.read.byte_count = 0;
+        }
+
         if (gdrom->meta.read.byte_count == 0) {
             /*
              * This case will only happen if the byte_count parameter in
@@ -281,9 +305,20 @@ struct gdrom_bufq_node {
     // len is the number of bytes which are valid
     // when idx == len, this buffer is empty and should be removed
     unsigned idx, len;
+
+    /*
+     * if this is non-NULL then the data is read straight out of the disc
+     * image's mapping instead of dat, and dat is not allocated.
+     */
+    uint8_t const *map;
     uint8_t dat[GDROM_BUFQ_LEN];
 };
 
+static inline uint8_t const *
+bufq_node_dat(struct gdrom_bufq_node const *node) {
+    return node->map ? node->map : node->dat;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // ATA commands
@@ -453,7 +488,9 @@ void gdrom_init(struct gdrom_ctxt *gdrom, struct dc_clock *gdrom_clk) {
     memset(gdrom, 0, sizeof(*gdrom));
 
     gdrom->gdrom_int_raise_event.handler = post_delay_gdrom_delayed_processing;
+    gdrom->gdrom_int_raise_event.name = "post_delay_gdrom_delayed_processing";
     gdrom->gdrom_int_raise_event.arg_ptr = gdrom;
+    sched_event_register(&gdrom->gdrom_int_raise_event, "gdrom_int");
 
     gdrom->clk = gdrom_clk;
     gdrom->gdapro_reg = GDROM_GDAPRO_DEFAULT;
@@ -473,6 +510,8 @@ void gdrom_init(struct gdrom_ctxt *gdrom, struct dc_clock *gdrom_clk) {
     gdrom->data_byte_count = GDROM_DATA_BYTE_COUNT_DEFAULT;
 
     fifo_init(&gdrom->bufq);
+    gdrom_read_job_init(&gdrom->read_job);
+    cdda_init();
 
     gdrom_reg_init(gdrom);
 }
@@ -521,12 +560,177 @@ void gdrom_reg_cleanup(struct gdrom_ctxt *gdrom) {
 }
 
 void gdrom_cleanup(struct gdrom_ctxt *gdrom) {
+    cdda_cleanup();
+    gdrom_read_job_finish(gdrom);
+    gdrom_read_job_cleanup(&gdrom->read_job);
     gdrom_reg_cleanup(gdrom);
 }
 
+static void gdrom_read_job_init(struct gdrom_read_job *job) {
+    washdc_mutex_init(&job->lock);
+    washdc_cvar_init(&job->req_cvar);
+    washdc_cvar_init(&job->done_cvar);
+    washdc_thread_create(&job->thread, gdrom_read_thread_main, job);
+}
+
+static void gdrom_read_job_cleanup(struct gdrom_read_job *job) {
+    washdc_mutex_lock(&job->lock);
+    job->quit = true;
+    washdc_cvar_signal(&job->req_cvar);
+    washdc_mutex_unlock(&job->lock);
+    washdc_thread_join(&job->thread);
+
+    washdc_cvar_cleanup(&job->done_cvar);
+    washdc_cvar_cleanup(&job->req_cvar);
+    washdc_mutex_cleanup(&job->lock);
+
+    free(job->nodes);
+    job->nodes = NULL;
+    job->n_nodes = job->n_nodes_alloc = 0;
+}
+
+static void gdrom_read_thread_main(void *argp) {
+    struct gdrom_read_job *job = (struct gdrom_read_job*)argp;
+
+    washdc_mutex_lock(&job->lock);
+    for (;;) {
+        while (!job->pending && !job->quit)
+            washdc_cvar_wait(&job->req_cvar, &job->lock);
+        if (job->quit)
+            break;
+
+        unsigned n_nodes = job->n_nodes;
+        unsigned fad = job->fad;
+        washdc_mutex_unlock(&job->lock);
+
+        unsigned idx;
+        for (idx = 0; idx < n_nodes; idx++) {
+            if (job->nodes[idx]->map)
+                continue;
+
+            struct trace_span span;
+            trace_begin(&span, TRACE_NO_CYCLE);
+            PERF_TIMER_BEGIN(PERF_GDROM_READ);
+            int err = mount_read_sectors(job->nodes[idx]->dat, fad + idx, 1);
+            PERF_TIMER_END(PERF_GDROM_READ);
+            trace_end(&span, TRACE_TRACK_GDROM, "read_sectors", TRACE_NO_CYCLE);
+            if (err < 0)
+                break;
+        }
+
+        washdc_mutex_lock(&job->lock);
+        job->n_read = idx;
+        job->failed = idx < n_nodes;
+        job->pending = false;
+        washdc_cvar_signal(&job->done_cvar);
+    }
+    washdc_mutex_unlock(&job->lock);
+}
+
+static void gdrom_read_job_submit(struct gdrom_read_job *job,
+                                  unsigned fad, unsigned n_sectors) {
+#ifdef INVARIANTS
+    if (job->active)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    if (n_sectors > job->n_nodes_alloc) {
+        struct gdrom_bufq_node **nodes = (struct gdrom_bufq_node**)
+            realloc(job->nodes, n_sectors * sizeof(struct gdrom_bufq_node*));
+        if (!nodes)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        job->nodes = nodes;
+        job->n_nodes_alloc = n_sectors;
+    }
+
+    /*
+     * sectors that are mapped into memory don't need to be read; their nodes
+     * just point into the mapping and the worker skips over them.
+     */
+    unsigned idx, n_mapped = 0;
+    for (idx = 0; idx < n_sectors; idx++) {
+        uint8_t const *map = (uint8_t const*)mount_map_sector(fad + idx);
+        struct gdrom_bufq_node *node = (struct gdrom_bufq_node*)
+            malloc(map ? offsetof(struct gdrom_bufq_node, dat) :
+                   sizeof(struct gdrom_bufq_node));
+        if (!node)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        node->idx = 0;
+        node->len = CDROM_FRAME_DATA_SIZE;
+        node->map = map;
+        job->nodes[idx] = node;
+        if (map)
+            n_mapped++;
+    }
+
+    job->n_nodes = n_sectors;
+    job->fad = fad;
+    job->active = true;
+
+    washdc_mutex_lock(&job->lock);
+    if (n_mapped == n_sectors) {
+        job->n_read = n_sectors;
+        job->failed = false;
+    } else {
+        job->pending = true;
+        washdc_cvar_signal(&job->req_cvar);
+    }
+    washdc_mutex_unlock(&job->lock);
+}
+
+// block until the worker is done, but leave the results where they are.
+static void gdrom_read_job_wait(struct gdrom_read_job *job) {
+    if (!job->active)
+        return;
+
+    enum bench_sect bench_prev = bench_enter(BENCH_GDROM);
+    washdc_mutex_lock(&job->lock);
+    while (job->pending)
+        washdc_cvar_wait(&job->done_cvar, &job->lock);
+    washdc_mutex_unlock(&job->lock);
+    bench_leave(bench_prev);
+}
+
+/*
+ * wait for the outstanding read (if there is one) and move the sectors it
+ * read into the bufq.  Returns non-zero if any of them could not be read, in
+ * which case none of them make it into the bufq.
+ */
+static int gdrom_read_job_finish(struct gdrom_ctxt *gdrom) {
+    struct gdrom_read_job *job = &gdrom->read_job;
+
+    if (!job->active)
+        return 0;
+
+    gdrom_read_job_wait(job);
+    job->active = false;
+
+    unsigned idx;
+    if (job->failed) {
+        GDROM_ERROR("GD-ROM failed to read fad %u\n", job->fad + job->n_read);
+        for (idx = 0; idx < job->n_nodes; idx++)
+            free(job->nodes[idx]);
+        job->n_nodes = 0;
+        return -1;
+    }
+
+    for (idx = 0; idx < job->n_nodes; idx++)
+        fifo_push(&gdrom->bufq, &job->nodes[idx]->fifo_node);
+    job->n_nodes = 0;
+    return 0;
+}
+
+static void gdrom_set_read_error(struct gdrom_ctxt *gdrom) {
+    gdrom->error_reg.sense_key = SENSE_KEY_ILLEGAL_REQ;
+    gdrom->stat_reg.check = true;
+}
+
 static void bufq_clear(struct gdrom_ctxt *gdrom) {
     size_t len = 0;
 
+    // nobody wants the results of a read that's still in flight
+    gdrom_read_job_finish(gdrom);
+
     while (!fifo_empty(&gdrom->bufq)) {
         struct gdrom_bufq_node *bufq_node =
             &FIFO_DEREF(fifo_pop(&gdrom->bufq), struct gdrom_bufq_node, fifo_node);
@@ -549,7 +753,7 @@ static int bufq_consume_byte(struct gdrom_ctxt *gdrom, unsigned *byte) {
         struct gdrom_bufq_node *bufq_node =
             &FIFO_DEREF(node, struct gdrom_bufq_node, fifo_node);
 
-        *byte = (unsigned)bufq_node->dat[bufq_node->idx++];
+        *byte = (unsigned)bufq_node_dat(bufq_node)[bufq_node->idx++];
 
         if (bufq_node->idx >= bufq_node->len) {
             fifo_pop(&gdrom->bufq);
@@ -578,6 +782,25 @@ static void gdrom_complete_dma(struct gdrom_ctxt *gdrom) {
     unsigned bytes_to_transmit = gdrom->dma_len_reg;
     unsigned addr = gdrom->dma_start_addr_reg;
 
+    // this is the last point where the data can arrive from the read thread
+    int read_err = gdrom_read_job_finish(gdrom);
+
+    /*
+     * when the destination is system memory the sectors get copied straight
+     * into it, and the JIT only gets notified once for the whole range.
+     */
+    uint8_t *ram = NULL;
+    uint32_t ram_mask = 0;
+    struct memory_map_region *region =
+        memory_map_get_region(dreamcast_get_cpu()->mem.map,
+                              addr & ~0xe0000000, bytes_to_transmit);
+    if (bytes_to_transmit && region && region->id == MEMORY_MAP_REGION_RAM &&
+        region->host &&
+        ((addr & region->mask) + (bytes_to_transmit - 1)) <= region->mask) {
+        ram = region->host;
+        ram_mask = region->mask;
+    }
+
     struct fifo_node *fifo_node = fifo_peek(&gdrom->bufq);
 
     while (bytes_transmitted < bytes_to_transmit) {
@@ -627,8 +850,13 @@ static void gdrom_complete_dma(struct gdrom_ctxt *gdrom) {
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), addr, chunk_sz,
-                                 1, bufq_node->dat + bufq_node->idx);
+        if (ram) {
+            memcpy(ram + (addr & ram_mask),
+                   bufq_node_dat(bufq_node) + bufq_node->idx, chunk_sz);
+        } else {
+            sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), addr, chunk_sz, 1,
+                                     bufq_node_dat(bufq_node) + bufq_node->idx);
+        }
 
         bufq_node->idx += chunk_sz;
 
@@ -642,6 +870,12 @@ static void gdrom_complete_dma(struct gdrom_ctxt *gdrom) {
     }
 
 done:
+    if (ram && bytes_transmitted) {
+        addr32_t first = gdrom->dma_start_addr_reg & ram_mask;
+        code_cache_notify_ram_range(first, first + (bytes_transmitted - 1));
+        savestate_notify_ram_range(first, first + (bytes_transmitted - 1));
+    }
+
     if (bytes_transmitted)
         GDROM_TRACE("GD-ROM DMA transfer %u bytes to %08X\n",
                     bytes_transmitted, gdrom->dma_start_addr_reg);
@@ -658,6 +892,7 @@ done:
     }
 
     gdrom->gdlend_final = bytes_transmitted;
+    dma_bytes_total += bytes_transmitted;
     gdrom->dma_start_stamp = clock_cycle_stamp(gdrom->clk);
 
     /*
@@ -682,6 +917,8 @@ done:
     gdrom_state_transition(gdrom, GDROM_STATE_DMA_READING);
     gdrom->stat_reg.check = false;
     gdrom_clear_error(gdrom);
+    if (read_err)
+        gdrom_set_read_error(gdrom);
 
     gdrom_delayed_processing(gdrom, gdrom->dma_delay);
 }
@@ -736,30 +973,11 @@ static void gdrom_input_read_packet(struct gdrom_ctxt *gdrom) {
     if (!gdrom->feat_reg.dma_enable && gdrom->data_byte_count > UINT16_MAX)
         GDROM_WARN("OVERFLOW: Reading %u bytes from gdrom PIO!\n", gdrom->data_byte_count);
 
-    unsigned fad_offs = 0;
-    while (trans_len--) {
-        struct gdrom_bufq_node *node =
-            (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
-
-        if (!node)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        if (mount_read_sectors(node->dat, start_addr + fad_offs++, 1) < 0) {
-            GDROM_ERROR("GD-ROM failed to read fad %u\n", fad_offs);
-
-            free(node);
-
-            gdrom->error_reg.sense_key = SENSE_KEY_ILLEGAL_REQ;
-            gdrom->stat_reg.check = true;
-            gdrom_state_transition(gdrom, GDROM_STATE_NORM);
-            return;
-        }
-
-        node->idx = 0;
-        node->len = CDROM_FRAME_DATA_SIZE;
-
-        fifo_push(&gdrom->bufq, &node->fifo_node);
-    }
+    /*
+     * the sectors get read in the background, and they'll be waited on when
+     * the transfer actually needs them.
+     */
+    gdrom_read_job_submit(&gdrom->read_job, start_addr, trans_len);
 
     if (gdrom->feat_reg.dma_enable) {
         // wait for them to write 1 to GDST before doing something
@@ -783,6 +1001,9 @@ static void gdrom_input_read_packet(struct gdrom_ctxt *gdrom) {
  * GDROM_STATE_INPUT_PKT
  */
 static void gdrom_input_packet(struct gdrom_ctxt *gdrom) {
+    // the mount layer can't be used while the read thread is using it
+    gdrom_read_job_wait(&gdrom->read_job);
+
     gdrom->stat_reg.drq = false;
     gdrom->stat_reg.bsy = false;
 
@@ -927,6 +1148,7 @@ void gdrom_cmd_identify(struct gdrom_ctxt *gdrom) {
         RAISE_ERROR(ERROR_FAILED_ALLOC);
 
     node->idx = 0;
+    node->map = NULL;
     node->len = GDROM_IDENT_RESP_LEN;
     memcpy(node->dat, gdrom_ident_resp, sizeof(gdrom_ident_resp));
 
@@ -1003,6 +1225,7 @@ static void gdrom_input_req_error_packet(struct gdrom_ctxt *gdrom) {
         struct gdrom_bufq_node *node =
             (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
         node->idx = 0;
+        node->map = NULL;
         node->len = len;
         memcpy(&node->dat, dat_out, len);
         fifo_push(&gdrom->bufq, &node->fifo_node);
@@ -1065,6 +1288,7 @@ static void gdrom_input_req_session_packet(struct gdrom_ctxt *gdrom) {
 
     memcpy(node->dat, reply, sizeof(reply));
     node->idx = 0;
+    node->map = NULL;
     node->len = alloc_len < 6 ? alloc_len : 6;
     fifo_push(&gdrom->bufq, &node->fifo_node);
 
@@ -1119,6 +1343,7 @@ static void gdrom_input_packet_71(struct gdrom_ctxt *gdrom) {
     struct gdrom_bufq_node *node =
         (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
     node->idx = 0;
+    node->map = NULL;
     node->len = GDROM_PKT_71_RESP_LEN;
 
     /*
@@ -1182,6 +1407,7 @@ static void gdrom_input_req_mode_packet(struct gdrom_ctxt *gdrom) {
             (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
 
         node->idx = 0;
+        node->map = NULL;
         node->len = last_idx - first_idx + 1;
         memcpy(&node->dat, gdrom_req_mode_resp + first_idx,
                node->len * sizeof(uint8_t));
@@ -1220,6 +1446,7 @@ static void gdrom_input_read_toc_packet(struct gdrom_ctxt *gdrom) {
         len = CDROM_TOC_SIZE;
 
     node->idx = 0;
+    node->map = NULL;
     node->len = len;
     memcpy(node->dat, ptr, len);
 
@@ -1241,65 +1468,110 @@ static void gdrom_input_read_subcode_packet(struct gdrom_ctxt *gdrom) {
         (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
 
     node->idx = 0;
+    node->map = NULL;
     node->len = len;
 
-    // TODO: fill in with real data instead of all zeroes
+    // TODO: fill in the rest of the Q subchannel instead of all zeroes
     memset(node->dat, 0, len);
 
+    uint8_t resp[14] = { 0 };
+    switch (cdda_get_state()) {
+    case CDDA_STATE_PLAYING:
+        resp[1] = 0x11;
+        break;
+    case CDDA_STATE_PAUSED:
+        resp[1] = 0x12;
+        break;
+    case CDDA_STATE_DONE:
+        resp[1] = 0x13;
+        break;
+    default:
+        resp[1] = 0x15;
+    }
+
+    // absolute position of the frame that's playing
+    unsigned fad = cdda_get_fad();
+    resp[3] = sizeof(resp);
+    resp[11] = (fad >> 16) & 0xff;
+    resp[12] = (fad >> 8) & 0xff;
+    resp[13] = fad & 0xff;
+    memcpy(node->dat, resp, len < sizeof(resp) ? len : sizeof(resp));
+
     fifo_push(&gdrom->bufq, &node->fifo_node);
 
     gdrom_state_transfer_pio_read(gdrom, len);
 }
 
+// position arguments are big-endian, either as a FAD or as minute/second/frame
+static unsigned gdrom_pkt_fad(uint8_t const *pos) {
+    return (((unsigned)pos[0]) << 16) | (((unsigned)pos[1]) << 8) | pos[2];
+}
+
+static unsigned gdrom_pkt_msf(uint8_t const *pos) {
+    return (pos[0] * 60 + pos[1]) * 75 + pos[2];
+}
+
 static void gdrom_input_seek_packet(struct gdrom_ctxt *gdrom) {
     unsigned param_tp = gdrom->pkt_buf[1] & 0xf;
-    unsigned seek_pt = (((unsigned)gdrom->pkt_buf[2]) << 16) |
-        (((unsigned)gdrom->pkt_buf[3]) << 8) |
-        (((unsigned)gdrom->pkt_buf[4]) << 24);
+    unsigned seek_pt = gdrom_pkt_fad(gdrom->pkt_buf + 2);
+
+    GDROM_TRACE("%s - CDDA SEEK command received.\n", __func__);
+    GDROM_TRACE("\tparam_tp = %u\n", param_tp);
+    GDROM_TRACE("\tseek_pt = %06X\n", seek_pt);
 
-    char const *param_tp_str;
     switch (param_tp) {
     case 1:
-        param_tp_str = "FAD";
+        cdda_seek(seek_pt);
         break;
     case 2:
-        param_tp_str = "MSF";
+        cdda_seek(gdrom_pkt_msf(gdrom->pkt_buf + 2));
         break;
     case 3:
-        param_tp_str = "STOP";
+        cdda_stop();
         break;
     case 4:
-        param_tp_str = "PAUSE";
+        cdda_pause();
         break;
     default:
-        param_tp_str = "UNKNOWN/CORRUPT";
+        GDROM_WARN("%s - unknown param_tp %u\n", __func__, param_tp);
     }
 
-    // CDDA playback isn't implemented yet, so we can't do anything here.
-    GDROM_INFO("%s - CDDA SEEK command received.\n", __func__);
-    GDROM_INFO("\tparam_tp = %s (%u)\n", param_tp_str, param_tp);
-    GDROM_INFO("\tseek_pt = %06X\n", seek_pt);
-
     gdrom_delayed_processing(gdrom, GDROM_INT_DELAY);
 }
 
 static void gdrom_input_play_packet(struct gdrom_ctxt *gdrom) {
     unsigned param_tp = gdrom->pkt_buf[1] & 0x7;
-    unsigned start = (((unsigned)gdrom->pkt_buf[2]) << 16) |
-        (((unsigned)gdrom->pkt_buf[3]) << 8) |
-        (((unsigned)gdrom->pkt_buf[4]) << 24);
+    unsigned start = gdrom_pkt_fad(gdrom->pkt_buf + 2);
     unsigned n_repeat = gdrom->pkt_buf[6] & 0xf;
-    unsigned end = (((unsigned)gdrom->pkt_buf[8]) << 16) |
-        (((unsigned)gdrom->pkt_buf[9]) << 8) |
-        (((unsigned)gdrom->pkt_buf[10]) << 24);
+    unsigned end = gdrom_pkt_fad(gdrom->pkt_buf + 8);
+
+    GDROM_TRACE("%s - CDDA PLAY command received.\n", __func__);
+    GDROM_TRACE("\tparam_tp = 0x%02x\n", param_tp);
+    GDROM_TRACE("\tstart = 0x%06x\n", start);
+    GDROM_TRACE("\tend = 0x%06x\n", end);
+    GDROM_TRACE("\tn_repeat = %u\n", n_repeat);
+
+    switch (param_tp) {
+    case 1:
+        cdda_play(start, end, n_repeat);
+        break;
+    case 2:
+        cdda_play(gdrom_pkt_msf(gdrom->pkt_buf + 2),
+                  gdrom_pkt_msf(gdrom->pkt_buf + 8), n_repeat);
+        break;
+    case 7:
+        // continue from wherever the last pause or seek left off
+        cdda_resume();
+        break;
+    default:
+        GDROM_WARN("%s - unknown param_tp %u\n", __func__, param_tp);
+    }
 
     gdrom_delayed_processing(gdrom, GDROM_INT_DELAY);
+}
 
-    GDROM_INFO("%s - CDDA PLAY command received.\n", __func__);
-    GDROM_INFO("\tparam_tp = 0x%02x\n", param_tp);
-    GDROM_INFO("\tstart = 0x%04x\n", start);
-    GDROM_INFO("\tend = 0x%04x\n", end);
-    GDROM_INFO("\tn_repeat = %u\n", n_repeat);
+unsigned long long gdrom_dma_bytes(void) {
+    return dma_bytes_total;
 }
 
 unsigned gdrom_dma_prot_top(struct gdrom_ctxt *gdrom) {
@@ -1413,6 +1685,8 @@ enum mount_disc_type gdrom_get_disc_type(void) {
  */
 enum gdrom_disc_state gdrom_get_drive_state(void) {
     if (mount_check()) {
+        if (cdda_get_state() == CDDA_STATE_PLAYING)
+            return GDROM_STATE_PLAY;
         return GDROM_STATE_PAUSE;
     }
     return GDROM_STATE_NODISC;
@@ -2080,3 +2354,112 @@ gdrom_gdstard_reg_read_handler(struct mmio_region_g1_reg_32 *region,
     GDROM_TRACE("read %08x from GDSTARD\n", val);
     return val;
 }
+
+static int gdrom_state_xfer(struct savestate_buf *buf, struct gdrom_ctxt *gdrom,
+                            bool load) {
+    return SAVESTATE_XFER(buf, load, gdrom->regs) ||
+        SAVESTATE_XFER(buf, load, gdrom->gdrom_int_scheduled) ||
+        SAVESTATE_XFER(buf, load, gdrom->stat_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->error_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->feat_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->sect_cnt_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->int_reason_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->dev_ctrl_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->data_byte_count) ||
+        SAVESTATE_XFER(buf, load, gdrom->gdapro_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->g1gdrc_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_start_addr_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_len_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_dir_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_en_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_start_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->gdlend_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->gdlend_final) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_start_stamp) ||
+        SAVESTATE_XFER(buf, load, gdrom->dma_delay) ||
+        SAVESTATE_XFER(buf, load, gdrom->drive_sel_reg) ||
+        SAVESTATE_XFER(buf, load, gdrom->additional_sense) ||
+        SAVESTATE_XFER(buf, load, gdrom->trans_mode_vals) ||
+        SAVESTATE_XFER(buf, load, gdrom->state) ||
+        SAVESTATE_XFER(buf, load, gdrom->meta) ||
+        SAVESTATE_XFER(buf, load, gdrom->set_mode_bytes_remaining) ||
+        SAVESTATE_XFER(buf, load, gdrom->pkt_buf) ||
+        SAVESTATE_XFER(buf, load, gdrom->n_bytes_received) ||
+        SAVESTATE_XFER(buf, load, gdrom->additional_dma_delay);
+}
+
+/*
+ * after the registers comes the read that's in flight (if any), followed by
+ * whatever is left in the bufq.  The read doesn't get saved, it gets redone
+ * from the disc when the section is loaded.
+ */
+void gdrom_state_save(struct savestate_buf *buf, void *ctxt) {
+    struct gdrom_ctxt *gdrom = (struct gdrom_ctxt*)ctxt;
+    struct gdrom_read_job const *job = &gdrom->read_job;
+
+    gdrom_state_xfer(buf, gdrom, false);
+
+    uint32_t job_fad = job->fad;
+    uint32_t job_len = job->active ? job->n_nodes : 0;
+    savestate_buf_put(buf, &job_fad, sizeof(job_fad));
+    savestate_buf_put(buf, &job_len, sizeof(job_len));
+
+    uint32_t n_nodes = fifo_len(&gdrom->bufq);
+    savestate_buf_put(buf, &n_nodes, sizeof(n_nodes));
+
+    struct fifo_node *curs;
+    FIFO_FOREACH(gdrom->bufq, curs) {
+        struct gdrom_bufq_node const *node =
+            &FIFO_DEREF(curs, struct gdrom_bufq_node, fifo_node);
+        uint32_t len = node->len - node->idx;
+        savestate_buf_put(buf, &len, sizeof(len));
+        savestate_buf_put(buf, bufq_node_dat(node) + node->idx, len);
+    }
+}
+
+int gdrom_state_load(struct savestate_buf *buf, void *ctxt) {
+    struct gdrom_ctxt *gdrom = (struct gdrom_ctxt*)ctxt;
+    uint32_t job_fad, job_len, n_nodes, idx;
+
+    // throw out this session's read and bufq; they're about to be replaced
+    gdrom_read_job_finish(gdrom);
+    while (!fifo_empty(&gdrom->bufq))
+        free(&FIFO_DEREF(fifo_pop(&gdrom->bufq),
+                         struct gdrom_bufq_node, fifo_node));
+
+    if (gdrom_state_xfer(buf, gdrom, true) != 0 ||
+        savestate_buf_get(buf, &job_fad, sizeof(job_fad)) != 0 ||
+        savestate_buf_get(buf, &job_len, sizeof(job_len)) != 0 ||
+        savestate_buf_get(buf, &n_nodes, sizeof(n_nodes)) != 0)
+        return -1;
+
+    for (idx = 0; idx < n_nodes; idx++) {
+        uint32_t len;
+        if (savestate_buf_get(buf, &len, sizeof(len)) != 0 ||
+            len > GDROM_BUFQ_LEN)
+            return -1;
+
+        struct gdrom_bufq_node *node =
+            (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
+        if (!node)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        node->idx = 0;
+        node->map = NULL;
+        node->len = len;
+        if (savestate_buf_get(buf, node->dat, len) != 0) {
+            free(node);
+            return -1;
+        }
+        fifo_push(&gdrom->bufq, &node->fifo_node);
+    }
+
+    if (job_len)
+        gdrom_read_job_submit(&gdrom->read_job, job_fad, job_len);
+
+    return 0;
+}
+
+bool gdrom_busy(struct gdrom_ctxt *gdrom) {
+    return gdrom->state != GDROM_STATE_NORM || gdrom->gdrom_int_scheduled ||
+        gdrom->read_job.active || !fifo_empty(&gdrom->bufq);
+}
@@ -30,6 +30,7 @@
 #include "log.h"
 #include "dc_sched.h"
 #include "mount.h"
+#include "threading.h"
 
 struct gdrom_status {
     // get off the phone!
@@ -131,6 +132,39 @@ union state_meta {
     struct gdrom_read_meta read;
 };
 
+struct gdrom_bufq_node;
+
+/*
+ * disc reads requested by GDROM_PKT_READ get serviced by a worker thread
+ * while the emulated drive delay elapses; the emulation thread only blocks
+ * if it needs the data before the worker is done.
+ */
+struct gdrom_read_job {
+    /*
+     * one node per sector, allocated before the job is submitted.  The worker
+     * owns these from submission until gdrom_read_job_finish.
+     */
+    struct gdrom_bufq_node **nodes;
+    unsigned n_nodes, n_nodes_alloc;
+    unsigned fad;
+
+    // true from submission until the emulation thread collects the results
+    bool active;
+
+    // everything below here is protected by lock
+    washdc_mutex lock;
+    washdc_cvar req_cvar, done_cvar;
+    washdc_thread thread;
+
+    // true while the worker has not finished the submitted job
+    bool pending;
+    bool quit;
+
+    // number of sectors read successfully, and whether the rest failed
+    unsigned n_read;
+    bool failed;
+};
+
 struct gdrom_ctxt {
     struct dc_clock *clk;
 
@@ -195,6 +229,8 @@ struct gdrom_ctxt {
 
     struct fifo_head bufq;
 
+    struct gdrom_read_job read_job;
+
     /*
      * this is the delay applied to DMA transfers.  Generally the way this is
      * implemented is that the first transfer after a read command has a large
@@ -266,6 +302,20 @@ void gdrom_start_dma(struct gdrom_ctxt *gdrom);
 void gdrom_input_cmd(struct gdrom_ctxt *ctxt, unsigned cmd);
 
 unsigned gdrom_dma_prot_top(struct gdrom_ctxt *gdrom);
+
+// total bytes written to memory by GD-ROM DMA
+unsigned long long gdrom_dma_bytes(void);
 unsigned gdrom_dma_prot_bot(struct gdrom_ctxt *gdrom);
 
+// save-state section (ctxt is the gdrom_ctxt)
+struct savestate_buf;
+void gdrom_state_save(struct savestate_buf *buf, void *ctxt);
+int gdrom_state_load(struct savestate_buf *buf, void *ctxt);
+
+/*
+ * true if the drive is in the middle of a command, or has data or an
+ * interrupt waiting to be picked up.
+ */
+bool gdrom_busy(struct gdrom_ctxt *gdrom);
+
 #endif
@@ -34,6 +34,7 @@
 #include "dc_sched.h"
 #include "dreamcast.h"
 #include "maple_reg.h"
+#include "replay.h"
 
 #include "maple.h"
 
@@ -191,18 +192,38 @@ maple_handle_getcond(struct maple *ctxt, struct maple_frame *frame) {
     struct maple_device *dev = maple_device_get(ctxt, frame->maple_addr);
 
     if (dev->enable) {
-        struct maple_cond cond;
-
-        maple_device_cond(dev, &cond);
-        maple_compile_cond(&cond, frame->output_data);
-        switch (cond.tp) {
-        case MAPLE_COND_TYPE_CONTROLLER:
-            frame->output_len = MAPLE_CONTROLLER_COND_SIZE;
-            break;
-        case MAPLE_COND_TYPE_KEYBOARD:
-            frame->output_len = MAPLE_KEYBOARD_COND_SIZE;
-            break;
+        unsigned len = frame->output_len;
+        if (replay_play_cond(frame->maple_addr, frame->output_data, &len,
+                             sizeof(frame->output_data)) != 0) {
+            if (dev->cond_cached &&
+                (dev->tp != MAPLE_DEVICE_CONTROLLER ||
+                 maple_controller_cond_current(dev))) {
+                // nothing has changed since the last time it was polled
+                len = dev->cond_len;
+                memcpy(frame->output_data, dev->cond_cache, len);
+            } else {
+                struct maple_cond cond;
+
+                maple_device_cond(dev, &cond);
+                maple_compile_cond(&cond, frame->output_data);
+                switch (cond.tp) {
+                case MAPLE_COND_TYPE_CONTROLLER:
+                    len = MAPLE_CONTROLLER_COND_SIZE;
+                    dev->cond_cached = true;
+                    break;
+                case MAPLE_COND_TYPE_KEYBOARD:
+                    len = MAPLE_KEYBOARD_COND_SIZE;
+                    dev->cond_cached = true;
+                    break;
+                }
+                if (dev->cond_cached) {
+                    dev->cond_len = len;
+                    memcpy(dev->cond_cache, frame->output_data, len);
+                }
+            }
+            replay_record_cond(frame->maple_addr, frame->output_data, len);
         }
+        frame->output_len = len;
         maple_write_frame_resp(ctxt, frame, MAPLE_RESP_DATATRF);
     } else {
         error_set_feature("proper response for when the guest tries to send "
@@ -225,6 +246,7 @@ static void maple_handle_bread(struct maple *ctxt, struct maple_frame *frame) {
 
     if (dev->enable) {
         struct maple_bread bread;
+        uint32_t dat[MAPLE_FRAME_INPUT_DATA_LEN / sizeof(uint32_t)];
 
         bread.n_dwords_in = frame->input_len / sizeof(uint32_t);
         size_t n_bytes = sizeof(uint32_t) * bread.n_dwords_in;
@@ -236,10 +258,8 @@ static void maple_handle_bread(struct maple *ctxt, struct maple_frame *frame) {
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        bread.dat_in = malloc(n_bytes);
-        if (!bread.dat_in)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(bread.dat_in, frame->input_data, n_bytes);
+        bread.dat_in = dat;
+        memcpy(dat, frame->input_data, n_bytes);
 
         maple_device_bread(dev, &bread);
 
@@ -256,8 +276,6 @@ static void maple_handle_bread(struct maple *ctxt, struct maple_frame *frame) {
                n_bytes_out - 2 * sizeof(uint32_t));
 
         maple_write_frame_resp(ctxt, frame, MAPLE_RESP_DATATRF);
-
-        free(bread.dat_in);
     } else {
         error_set_feature("proper response for when the guest tries to send "
                           "the BREAD command to an empty maple port");
@@ -285,6 +303,7 @@ static void maple_handle_bwrite(struct maple *ctxt, struct maple_frame *frame) {
 
     if (dev->enable) {
         struct maple_bwrite bwrite;
+        uint32_t dat[MAPLE_FRAME_INPUT_DATA_LEN / sizeof(uint32_t)];
 
         bwrite.n_dwords = frame->input_len / sizeof(uint32_t);
         size_t n_bytes = sizeof(uint32_t) * bwrite.n_dwords;
@@ -296,17 +315,13 @@ static void maple_handle_bwrite(struct maple *ctxt, struct maple_frame *frame) {
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        bwrite.dat = malloc(n_bytes);
-        if (!bwrite.dat)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(bwrite.dat, frame->input_data, n_bytes);
+        bwrite.dat = dat;
+        memcpy(dat, frame->input_data, n_bytes);
 
         maple_device_bwrite(dev, &bwrite);
 
         frame->output_len = 0;
         maple_write_frame_resp(ctxt, frame, MAPLE_RESP_OK);
-
-        free(bwrite.dat);
     } else {
         error_set_feature("proper response for when the guest tries to send "
                           "the BWRITE command to an empty maple port");
@@ -329,6 +344,7 @@ maple_handle_setcond(struct maple *ctxt, struct maple_frame *frame) {
 
     if (dev->enable) {
         struct maple_setcond setcond;
+        uint32_t dat[MAPLE_FRAME_INPUT_DATA_LEN / sizeof(uint32_t)];
 
         setcond.n_dwords = frame->input_len / sizeof(uint32_t);
         size_t n_bytes = sizeof(uint32_t) * setcond.n_dwords;
@@ -340,17 +356,14 @@ maple_handle_setcond(struct maple *ctxt, struct maple_frame *frame) {
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        setcond.dat = malloc(n_bytes);
-        if (!setcond.dat)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(setcond.dat, frame->input_data, n_bytes);
+        setcond.dat = dat;
+        memcpy(dat, frame->input_data, n_bytes);
 
         maple_device_setcond(dev, &setcond);
+        maple_device_cond_changed(dev);
 
         frame->output_len = 0;
         maple_write_frame_resp(ctxt, frame, MAPLE_RESP_DATATRF);
-
-        free(setcond.dat);
     } else {
         error_set_feature("proper response for when the guest tries to send "
                           "the BWRITE command to an empty maple port");
@@ -404,6 +417,7 @@ static void maple_handle_bsync(struct maple *ctxt, struct maple_frame *frame) {
 
     if (dev->enable) {
         struct maple_bsync bsync;
+        uint32_t dat[MAPLE_FRAME_INPUT_DATA_LEN / sizeof(uint32_t)];
 
         bsync.n_dwords = frame->input_len / sizeof(uint32_t);
         size_t n_bytes = sizeof(uint32_t) * bsync.n_dwords;
@@ -415,17 +429,13 @@ static void maple_handle_bsync(struct maple *ctxt, struct maple_frame *frame) {
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        bsync.dat = malloc(n_bytes);
-        if (!bsync.dat)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(bsync.dat, frame->input_data, n_bytes);
+        bsync.dat = dat;
+        memcpy(dat, frame->input_data, n_bytes);
 
         maple_device_bsync(dev, &bsync);
 
         frame->output_len = 0;
         maple_write_frame_resp(ctxt, frame, MAPLE_RESP_OK);
-
-        free(bsync.dat);
     } else {
         error_set_feature("proper response for when the guest tries to send "
                           "the MEMINFO command to an empty maple port");
@@ -451,12 +461,15 @@ static void maple_write_frame_resp(struct maple *ctxt,
         ((len << MAPLE_PACK_LEN_SHIFT) & MAPLE_PACK_LEN_MASK) |
         (subdevs << MAPLE_PORT_SHIFT);
 
-    sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), frame->recv_addr,
-                             sizeof(pkt_hdr), 1, &pkt_hdr);
-    if (len) {
-        sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), frame->recv_addr + 4, 1,
-                                 frame->output_len, frame->output_data);
-    }
+    // the header and the payload go out together as a single transfer
+    uint32_t resp[1 + MAPLE_FRAME_OUTPUT_DATA_LEN / sizeof(uint32_t)];
+    resp[0] = pkt_hdr;
+    if (len)
+        memcpy(resp + 1, frame->output_data, frame->output_len);
+
+    sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), frame->recv_addr, 1,
+                             sizeof(pkt_hdr) + (len ? frame->output_len : 0),
+                             resp);
 }
 
 static void maple_decode_frame(struct maple_frame *frame_out,
@@ -583,9 +596,6 @@ unsigned maple_addr_pack(unsigned port, unsigned unit) {
 static void maple_dma_complete(struct maple *ctxt) {
     if (!ctxt->dma_complete_int_event_scheduled) {
         ctxt->dma_complete_int_event_scheduled = true;
-        ctxt->dma_complete_int_event.arg_ptr = ctxt;
-        ctxt->dma_complete_int_event.handler =
-            maple_dma_complete_int_event_handler;
         ctxt->dma_complete_int_event.when =
             clock_cycle_stamp(ctxt->maple_clk) + MAPLE_DMA_COMPLETE_DELAY;
         sched_event(ctxt->maple_clk, &ctxt->dma_complete_int_event);
@@ -605,6 +615,14 @@ void maple_init(struct maple *maple_ctxt, struct dc_clock *clk) {
     maple_ctxt->maple_dma_prot_top = (0x1 << 27) | (0x7f << 20);
     maple_ctxt->maple_clk = clk;
 
+    maple_ctxt->dma_complete_int_event.arg_ptr = maple_ctxt;
+    maple_ctxt->dma_complete_int_event.handler =
+        maple_dma_complete_int_event_handler;
+    maple_ctxt->dma_complete_int_event.name =
+        "maple_dma_complete_int_event_handler";
+    sched_event_register(&maple_ctxt->dma_complete_int_event,
+                         "maple_dma_complete_int");
+
     maple_reg_init(maple_ctxt);
 }
 
@@ -46,6 +46,10 @@ static void controller_dev_info(struct maple_device *dev,
                                 struct maple_devinfo *output);
 static void controller_dev_get_cond(struct maple_device *dev,
                                     struct maple_cond *cond);
+static struct maple_controller *
+controller_get(struct maple *maple, unsigned port_no);
+static void controller_write_begin(struct maple_controller *cont);
+static void controller_write_end(struct maple_controller *cont);
 
 struct maple_switch_table maple_controller_switch_table = {
     .device_type = "controller",
@@ -58,10 +62,18 @@ int maple_controller_init(struct maple_device *dev) {
     if (!(dev->enable && (dev->tp == MAPLE_DEVICE_CONTROLLER)))
         RAISE_ERROR(ERROR_INTEGRITY);
 
-    dev->ctxt.cont.btns = 0;
-    memset(dev->ctxt.cont.axes, 0, sizeof(dev->ctxt.cont.axes));
-    dev->ctxt.cont.axes[MAPLE_CONTROLLER_AXIS_JOY1_X] = 128;
-    dev->ctxt.cont.axes[MAPLE_CONTROLLER_AXIS_JOY1_Y] = 128;
+    struct maple_controller *cont = &dev->ctxt.cont;
+    unsigned axis;
+
+    washdc_atomic_int_init(&cont->seq, 0);
+    washdc_atomic_flag_clear(&cont->write_lock);
+    washdc_atomic_int_init(&cont->btns, 0);
+    for (axis = 0; axis < MAPLE_CONTROLLER_N_AXES; axis++)
+        washdc_atomic_int_init(cont->axes + axis, 0);
+    washdc_atomic_int_init(cont->axes + MAPLE_CONTROLLER_AXIS_JOY1_X, 128);
+    washdc_atomic_int_init(cont->axes + MAPLE_CONTROLLER_AXIS_JOY1_Y, 128);
+    cont->cond_seq = 0;
+    maple_device_cond_changed(dev);
 
     return 0;
 }
@@ -105,6 +117,21 @@ static void controller_dev_get_cond(struct maple_device *dev,
         RAISE_ERROR(ERROR_INTEGRITY);
 
     struct maple_controller *cont = &dev->ctxt.cont;
+    int seq;
+    uint32_t btns;
+    unsigned axes[MAPLE_CONTROLLER_N_AXES];
+
+    do {
+        while ((seq = washdc_atomic_int_load_acquire(&cont->seq)) & 1)
+            ;
+        btns = washdc_atomic_int_load_relaxed(&cont->btns);
+        unsigned axis;
+        for (axis = 0; axis < MAPLE_CONTROLLER_N_AXES; axis++)
+            axes[axis] = washdc_atomic_int_load_relaxed(cont->axes + axis);
+        washdc_atomic_fence_acquire();
+    } while (washdc_atomic_int_load_relaxed(&cont->seq) != seq);
+
+    cont->cond_seq = seq;
 
     memset(cond, 0, sizeof(*cond));
     cond->tp = MAPLE_COND_TYPE_CONTROLLER;
@@ -112,66 +139,86 @@ static void controller_dev_get_cond(struct maple_device *dev,
     cond->cont.func = MAPLE_FUNC_CONTROLLER;
 
     // invert because Dreamcast controller has active-low buttons
-    cond->cont.btn = ~cont->btns;
+    cond->cont.btn = ~btns;
 
-    cond->cont.trig_r = cont->axes[MAPLE_CONTROLLER_AXIS_R_TRIG];
-    cond->cont.trig_l = cont->axes[MAPLE_CONTROLLER_AXIS_L_TRIG];
+    cond->cont.trig_r = axes[MAPLE_CONTROLLER_AXIS_R_TRIG];
+    cond->cont.trig_l = axes[MAPLE_CONTROLLER_AXIS_L_TRIG];
 
-    cond->cont.js_x = cont->axes[MAPLE_CONTROLLER_AXIS_JOY1_X];
-    cond->cont.js_y = cont->axes[MAPLE_CONTROLLER_AXIS_JOY1_Y];
-    cond->cont.js_x2 = cont->axes[MAPLE_CONTROLLER_AXIS_JOY2_X];
-    cond->cont.js_y2 = cont->axes[MAPLE_CONTROLLER_AXIS_JOY2_X];
+    cond->cont.js_x = axes[MAPLE_CONTROLLER_AXIS_JOY1_X];
+    cond->cont.js_y = axes[MAPLE_CONTROLLER_AXIS_JOY1_Y];
+    cond->cont.js_x2 = axes[MAPLE_CONTROLLER_AXIS_JOY2_X];
+    cond->cont.js_y2 = axes[MAPLE_CONTROLLER_AXIS_JOY2_X];
 }
 
-// mark all buttons in btns as being pressed
-void maple_controller_press_btns(struct maple *maple, unsigned port_no,
-                                 uint32_t btns) {
+bool maple_controller_cond_current(struct maple_device *dev) {
+    return washdc_atomic_int_load_acquire(&dev->ctxt.cont.seq) ==
+        dev->ctxt.cont.cond_seq;
+}
+
+static struct maple_controller *
+controller_get(struct maple *maple, unsigned port_no) {
     unsigned addr = maple_addr_pack(port_no, 0);
     struct maple_device *dev = maple_device_get(maple, addr);
 
     if (!(dev->enable && (dev->tp == MAPLE_DEVICE_CONTROLLER))) {
         LOG_ERROR("Error: unable to press buttons on port %u because "
                   "there is no controller plugged in.\n", port_no);
-        return;
+        return NULL;
     }
 
-    struct maple_controller *cont = &dev->ctxt.cont;
+    return &dev->ctxt.cont;
+}
+
+static void controller_write_begin(struct maple_controller *cont) {
+    while (washdc_atomic_flag_test_and_set(&cont->write_lock))
+        ;
+    int seq = washdc_atomic_int_load_relaxed(&cont->seq);
+    washdc_atomic_int_store_relaxed(&cont->seq, seq + 1);
+    washdc_atomic_fence_release();
+}
+
+static void controller_write_end(struct maple_controller *cont) {
+    int seq = washdc_atomic_int_load_relaxed(&cont->seq);
+    washdc_atomic_int_store_release(&cont->seq, seq + 1);
+    washdc_atomic_flag_clear(&cont->write_lock);
+}
+
+// mark all buttons in btns as being pressed
+void maple_controller_press_btns(struct maple *maple, unsigned port_no,
+                                 uint32_t btns) {
+    struct maple_controller *cont = controller_get(maple, port_no);
+    if (!cont)
+        return;
 
-    cont->btns |= btns;
+    controller_write_begin(cont);
+    int cur = washdc_atomic_int_load_relaxed(&cont->btns);
+    washdc_atomic_int_store_relaxed(&cont->btns, cur | btns);
+    controller_write_end(cont);
 }
 
 // mark all buttons in btns as being released
 void maple_controller_release_btns(struct maple *maple, unsigned port_no,
                                    uint32_t btns) {
-    unsigned addr = maple_addr_pack(port_no, 0);
-    struct maple_device *dev = maple_device_get(maple, addr);
-
-    if (!(dev->enable && (dev->tp == MAPLE_DEVICE_CONTROLLER))) {
-        LOG_ERROR("Error: unable to press buttons on port %u because "
-                  "there is no controller plugged in.\n", port_no);
+    struct maple_controller *cont = controller_get(maple, port_no);
+    if (!cont)
         return;
-    }
 
-    struct maple_controller *cont = &dev->ctxt.cont;
-
-    cont->btns &= ~btns;
+    controller_write_begin(cont);
+    int cur = washdc_atomic_int_load_relaxed(&cont->btns);
+    washdc_atomic_int_store_relaxed(&cont->btns, cur & ~btns);
+    controller_write_end(cont);
 }
 
 void maple_controller_set_axis(struct maple *maple, unsigned port_no,
                                unsigned axis, unsigned val) {
-    unsigned addr = maple_addr_pack(port_no, 0);
-    struct maple_device *dev = maple_device_get(maple, addr);
-
-    if (!(dev->enable && (dev->tp == MAPLE_DEVICE_CONTROLLER))) {
-        LOG_ERROR("Error: unable to press buttons on port %u because "
-                  "there is no controller plugged in.\n", port_no);
-        return;
-    }
-
-    struct maple_controller *cont = &dev->ctxt.cont;
-
     if (axis >= MAPLE_CONTROLLER_N_AXES)
         RAISE_ERROR(ERROR_INTEGRITY);
 
-    cont->axes[axis] = val;
+    struct maple_controller *cont = controller_get(maple, port_no);
+    if (!cont)
+        return;
+
+    controller_write_begin(cont);
+    washdc_atomic_int_store_relaxed(cont->axes + axis, val);
+    controller_write_end(cont);
 }
@@ -23,6 +23,11 @@
 #ifndef MAPLE_CONTROLLER_H_
 #define MAPLE_CONTROLLER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atomics.h"
+
 #define MAPLE_CONT_BTN_C_SHIFT 0
 #define MAPLE_CONT_BTN_C_MASK (1 << MAPLE_CONT_BTN_C_SHIFT)
 
@@ -84,16 +89,28 @@ enum {
 
 extern struct maple_switch_table maple_controller_switch_table;
 
+/*
+ * The controller's state is written by the frontend and read whenever the
+ * guest sends GETCOND, and those don't need to happen on the same thread.
+ * Writers serialize on write_lock and hold seq at an odd value while they
+ * update the state; readers retry if seq was odd or changed underneath them.
+ */
 struct maple_controller {
-    uint32_t btns;
-    unsigned axes[MAPLE_CONTROLLER_N_AXES];
+    washdc_atomic_int seq;
+    washdc_atomic_flag write_lock;
+
+    washdc_atomic_int btns;
+    washdc_atomic_int axes[MAPLE_CONTROLLER_N_AXES];
+
+    // value of seq when the device's cached GETCOND response was compiled
+    int cond_seq;
 };
 
 struct maple;
 
 /*
  * CONTROLLER API
- * These two functions can be safely called from any thread.
+ * These three functions can be safely called from any thread.
  */
 // mark all buttons in btns as being pressed
 void maple_controller_press_btns(struct maple *maple, unsigned port_no,
@@ -111,4 +128,7 @@ struct maple_device;
 
 int maple_controller_init(struct maple_device *dev);
 
+// false if the controller has changed since its GETCOND response was cached
+bool maple_controller_cond_current(struct maple_device *dev);
+
 #endif
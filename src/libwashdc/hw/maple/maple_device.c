@@ -109,6 +109,7 @@ void maple_device_cleanup(struct maple *maple, unsigned addr) {
     if (dev->sw->dev_cleanup)
         dev->sw->dev_cleanup(dev);
     dev->enable = false;
+    maple_device_cond_changed(dev);
 }
 
 void maple_device_info(struct maple_device *dev,
@@ -62,6 +62,10 @@ struct maple;
 
 #define MAPLE_KEYBOARD_COND_SIZE (sizeof(uint32_t) + sizeof(uint8_t) * 8)
 
+#define MAPLE_COND_MAX_SIZE                                     \
+    (MAPLE_CONTROLLER_COND_SIZE > MAPLE_KEYBOARD_COND_SIZE ?    \
+     MAPLE_CONTROLLER_COND_SIZE : MAPLE_KEYBOARD_COND_SIZE)
+
 // device information (response to MAPLE_CMD_DEVINFO)
 struct maple_devinfo {
     uint32_t func;
@@ -209,8 +213,21 @@ struct maple_device {
     bool enable;
 
     union maple_device_ctxt ctxt;
+
+    /*
+     * GETCOND response compiled from the device's state, which is only valid
+     * while cond_cached is true.  Anything that changes the state of a device
+     * has to call maple_device_cond_changed.
+     */
+    bool cond_cached;
+    unsigned cond_len;
+    uint8_t cond_cache[MAPLE_COND_MAX_SIZE];
 };
 
+static inline void maple_device_cond_changed(struct maple_device *dev) {
+    dev->cond_cached = false;
+}
+
 int maple_device_init_controller(struct maple *maple, unsigned maple_addr);
 int maple_device_init_keyboard_us(struct maple *maple, unsigned maple_addr);
 int maple_device_init_purupuru(struct maple *maple, unsigned maple_addr);
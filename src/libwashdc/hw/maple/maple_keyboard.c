@@ -51,6 +51,7 @@ int maple_keyboard_init(struct maple_device *dev) {
         RAISE_ERROR(ERROR_INTEGRITY);
 
     memset(&dev->ctxt.kbd, 0, sizeof(dev->ctxt.kbd));
+    maple_device_cond_changed(dev);
 
     return 0;
 }
@@ -137,6 +138,8 @@ maple_keyboard_press_key(struct maple *maple, unsigned port_no,
     else if (which_key == 0x47)
         dev->ctxt.kbd.scroll_lock_led = is_pressed;
 
+    maple_device_cond_changed(dev);
+
     uint8_t *key_states = dev->ctxt.kbd.key_states;
     int idx;
     if (is_pressed) {
@@ -168,6 +171,7 @@ maple_keyboard_press_special(struct maple *maple, unsigned port_no,
     }
 
     dev->ctxt.kbd.special_keys |= which;
+    maple_device_cond_changed(dev);
 }
 
 void
@@ -183,4 +187,5 @@ maple_keyboard_release_special(struct maple *maple, unsigned port_no,
     }
 
     dev->ctxt.kbd.special_keys &= ~which;
+    maple_device_cond_changed(dev);
 }
@@ -106,6 +106,13 @@ int maple_vmu_init(struct maple_device *dev, char const *backing_path) {
         washdc_hostfile_close(file);
     }
 
+    if (dev->ctxt.vmu.backing_path &&
+        mapped_file_open(&dev->ctxt.vmu.map, dev->ctxt.vmu.backing_path,
+                         MAPLE_VMU_DAT_LEN) == 0) {
+        free(dev->ctxt.vmu.datp);
+        dev->ctxt.vmu.datp = dev->ctxt.vmu.map.dat;
+    }
+
     return 0;
 }
 
@@ -113,13 +120,28 @@ static void vmu_dev_cleanup(struct maple_device *dev) {
     if (!(dev->enable && (dev->tp == MAPLE_DEVICE_VMU)))
         RAISE_ERROR(ERROR_INTEGRITY);
 
-    flush_vmu(dev);
-
-    free(dev->ctxt.vmu.datp);
+    if (dev->ctxt.vmu.map.dat) {
+        mapped_file_close(&dev->ctxt.vmu.map);
+    } else {
+        if (dev->ctxt.vmu.dirty)
+            flush_vmu(dev);
+        free(dev->ctxt.vmu.datp);
+    }
     free(dev->ctxt.vmu.backing_path);
 }
 
+/*
+ * only the bwrite-ed pages of a mapped image get written back, and they're
+ * just queued up for the host to take care of so that games which save
+ * frequently don't stall on the disk.
+ */
 static void flush_vmu(struct maple_device *dev) {
+    if (dev->ctxt.vmu.map.dat) {
+        mapped_file_sync(&dev->ctxt.vmu.map, false);
+        dev->ctxt.vmu.dirty = false;
+        return;
+    }
+
     if (!dev->ctxt.vmu.backing_path)
         return;
 
@@ -135,6 +157,8 @@ static void flush_vmu(struct maple_device *dev) {
                                   MAPLE_VMU_DAT_LEN) != MAPLE_VMU_DAT_LEN) {
             LOG_ERROR("Unable to write to VMU image file \"%s\"\n",
                       dev->ctxt.vmu.backing_path);
+        } else {
+            dev->ctxt.vmu.dirty = false;
         }
         washdc_hostfile_close(file);
     }
@@ -264,6 +288,8 @@ vmu_dev_bwrite(struct maple_device *dev, struct maple_bwrite *bwrite) {
             memcpy(dev->ctxt.vmu.datp + sizeof(uint8_t) * byteoffs,
                    bwrite->dat + 2,
                    128);
+            mapped_file_mark(&dev->ctxt.vmu.map, byteoffs, 128);
+            dev->ctxt.vmu.dirty = true;
         } else {
             LOG_ERROR("%s - malformed request (unknown function %08X)\n", __func__, bwrite->dat[0]);
         }
@@ -304,7 +330,8 @@ vmu_dev_bsync(struct maple_device *dev, struct maple_bsync *bsync) {
     if (!(dev->enable && (dev->tp == MAPLE_DEVICE_VMU)))
         RAISE_ERROR(ERROR_INTEGRITY);
 
-    flush_vmu(dev);
+    if (dev->ctxt.vmu.dirty)
+        flush_vmu(dev);
 }
 
 static void
@@ -24,6 +24,9 @@
 #define MAPLE_VMU_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "mapped_file.h"
 
 extern struct maple_switch_table maple_vmu_switch_table;
 
@@ -34,6 +37,14 @@ extern struct maple_switch_table maple_vmu_switch_table;
 struct maple_vmu {
     unsigned char *datp;
     char *backing_path;
+
+    /*
+     * if the backing file could be mapped then datp points into it and
+     * writes are tracked by map.  Otherwise datp is a private buffer, and dirty
+     * is set when it has to be rewritten to the backing file.
+     */
+    struct mapped_file map;
+    bool dirty;
 };
 
 struct maple_device;
@@ -25,6 +25,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <zlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "washdc/types.h"
 #include "washdc/error.h"
 #include "hw/pvr2/pvr2.h"
@@ -38,6 +50,7 @@
 #include "washdc/gfx/obj.h"
 #include "log.h"
 #include "title.h"
+#include "config.h"
 
 #include "framebuffer.h"
 
@@ -59,6 +72,8 @@ enum fb_pix_fmt {
     FB_PIX_FMT_ARGB_1555
 };
 
+#define TEX_MIRROR_MASK 0x7fffff
+
 static unsigned bytes_per_pix(uint32_t fb_r_ctrl) {
     unsigned px_tp = (fb_r_ctrl & 0xc) >> 2;
 
@@ -80,29 +95,53 @@ static unsigned bytes_per_pix(uint32_t fb_r_ctrl) {
  * in FB_R_CTRL; it is appended as the lower 3/2 bits to each color component
  * to convert that component from 5/6 bits to 8 bits.
  *
- * One "gotcha" to note about the below functions is that
- * conv_rgb555_to_argb8888 and conv_rgb565_to_rgb8888 expect their inputs to be
- * arrays of uint16_t with each element representing one pixel, and
- * conv_rgb0888_to_argb8888 expects its input to be uint32_t with each element
- * representing one pixel BUT conv_rgb888_to_argb8888 expects its input to be
- * uint8_t with every *three* elements representing one pixel.
+ * These all convert a single row which has already been read out of texture
+ * memory.  conv_rgb555_to_rgba8888 and conv_rgb565_to_rgba8888 expect their
+ * inputs to be packed 16-bit pixels, conv_rgb0888_to_rgba8888 expects packed
+ * 32-bit pixels and conv_rgb888_to_rgba8888 expects *three* bytes per pixel.
+ * 888 and 0888 ignore concat.
  */
+typedef void(*fb_conv_fn)(uint32_t *pixels_out, void const *pixels_in,
+                          unsigned n_pixels, uint8_t concat);
+
+static void
+conv_rgb565_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
+                        unsigned n_pixels, uint8_t concat);
 static void
-conv_rgb565_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                        uint32_t addr_pixels_in,
+conv_rgb555_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
                         unsigned n_pixels, uint8_t concat);
 static void
-conv_rgb555_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                        uint32_t addr_pixels_in,
+conv_rgb888_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
                         unsigned n_pixels, uint8_t concat);
 static void
-conv_rgb888_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                        uint32_t addr_pixels_in,
-                        unsigned n_pixels);
+conv_rgb0888_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
+                         unsigned n_pixels, uint8_t concat);
+
+/*
+ * read n_rows rows of fb_width pixels out of texture memory and convert them
+ * into dst.  For interlaced framebuffers n_fields is 2 and the rows from each
+ * field are woven together in the same pass; for progressive-scan framebuffers
+ * n_fields is 1.  field_adv is the distance in bytes between the start of one
+ * row and the start of the next row within the same field.
+ *
+ * If the gpu_fb_conv config is set, the rows are copied as-is, one field
+ * after the other, and the renderer takes care of the rest.
+ *
+ * If pvr2->fb.conv_partial is set, dst already holds the last conversion and
+ * only the rows which touch a page in pvr2->fb.conv_dirty get redone.
+ */
 static void
-conv_rgb0888_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                         uint32_t addr_pixels_in,
-                         unsigned n_pixels);
+conv_fb_rows(struct pvr2 *pvr2, uint32_t *dst, unsigned fb_width,
+             unsigned n_rows, uint32_t const *sof, unsigned n_fields,
+             unsigned field_adv, unsigned pix_sz, fb_conv_fn conv,
+             uint8_t concat);
+
+static void
+fb_mark_range(uint64_t *pages, uint32_t first_byte, uint32_t last_byte);
+static void fb_mark_pages(uint64_t *pages, struct framebuffer const *fb);
+static void fb_rebuild_pages(struct pvr2 *pvr2);
+static bool
+fb_pages_hit(uint64_t const *pages, uint32_t first_byte, uint32_t last_byte);
 
 static void
 sync_fb_from_tex_mem_rgb565_intl(struct pvr2 *pvr2, struct framebuffer *fb,
@@ -147,16 +186,9 @@ sync_fb_from_tex_mem_rgb565_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
 
-    unsigned row;
-    for (row = 0; row < rows_per_field; row++) {
-        uint32_t addr_row1 = sof1 + row * field_adv;
-        uint32_t addr_row2 = sof2 + row * field_adv;
-
-        conv_rgb565_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
-                                addr_row1, fb_width, concat);
-        conv_rgb565_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
-                                addr_row2, fb_width, concat);
-    }
+    uint32_t const sof[2] = { sof1, sof2 };
+    conv_fb_rows(pvr2, dst_fb, fb_width, rows_per_field * 2, sof, 2,
+                 field_adv, 2, conv_rgb565_to_rgba8888, concat);
 
     fb->addr_key = first_addr_field1  < first_addr_field2 ?
         first_addr_field1 : first_addr_field2;
@@ -174,6 +206,7 @@ sync_fb_from_tex_mem_rgb565_intl(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_RGB_565;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -189,7 +222,6 @@ static void
 sync_fb_from_tex_mem_rgb565_prog(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
                                  uint32_t sof1, unsigned concat) {
-    unsigned field_adv = fb_width;
     /*
      * bounds checking
      *
@@ -214,16 +246,11 @@ sync_fb_from_tex_mem_rgb565_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     }
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
-    memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
+    if (!pvr2->fb.conv_partial)
+        memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
 
-    unsigned row;
-    for (row = 0; row < fb_height; row++) {
-        uint32_t in_col_start_addr = sof1 + field_adv * row * 2;
-        uint32_t *out_col_start = dst_fb + row * fb_width;
-
-        conv_rgb565_to_rgba8888(pvr2, out_col_start, in_col_start_addr,
-                                fb_width, concat);
-    }
+    conv_fb_rows(pvr2, dst_fb, fb_width, fb_height, &sof1, 1,
+                 fb_width * 2, 2, conv_rgb565_to_rgba8888, concat);
 
     fb->fb_read_width = fb_width;
     fb->fb_read_height = fb_height;
@@ -238,6 +265,7 @@ sync_fb_from_tex_mem_rgb565_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_RGB_565;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -292,16 +320,9 @@ sync_fb_from_tex_mem_rgb555_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
 
-    unsigned row;
-    for (row = 0; row < rows_per_field; row++) {
-        uint32_t addr_row1 = sof1 + row * field_adv;
-        uint32_t addr_row2 = sof2 + row * field_adv;
-
-        conv_rgb555_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
-                                addr_row1, fb_width, concat);
-        conv_rgb555_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
-                                addr_row2, fb_width, concat);
-    }
+    uint32_t const sof[2] = { sof1, sof2 };
+    conv_fb_rows(pvr2, dst_fb, fb_width, rows_per_field * 2, sof, 2,
+                 field_adv, 2, conv_rgb555_to_rgba8888, concat);
 
     fb->addr_key = first_addr_field1  < first_addr_field2 ?
         first_addr_field1 : first_addr_field2;
@@ -319,6 +340,7 @@ sync_fb_from_tex_mem_rgb555_intl(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_RGB_555;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -373,16 +395,9 @@ sync_fb_from_tex_mem_rgb888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
 
-    unsigned row;
-    for (row = 0; row < rows_per_field; row++) {
-        uint32_t addr_row1 = sof1 + row * field_adv;
-        uint32_t addr_row2 = sof2 + row * field_adv;
-
-        conv_rgb888_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
-                                addr_row1, fb_width);
-        conv_rgb888_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
-                                addr_row2, fb_width);
-    }
+    uint32_t const sof[2] = { sof1, sof2 };
+    conv_fb_rows(pvr2, dst_fb, fb_width, rows_per_field * 2, sof, 2,
+                 field_adv, 3, conv_rgb888_to_rgba8888, 0);
 
     fb->addr_key = first_addr_field1  < first_addr_field2 ?
         first_addr_field1 : first_addr_field2;
@@ -400,6 +415,7 @@ sync_fb_from_tex_mem_rgb888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_RGB_888;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -415,7 +431,6 @@ static void
 sync_fb_from_tex_mem_rgb555_prog(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
                                  uint32_t sof1, unsigned concat) {
-    unsigned field_adv = fb_width;
     /*
      * bounds checking
      *
@@ -440,16 +455,11 @@ sync_fb_from_tex_mem_rgb555_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     }
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
-    memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
+    if (!pvr2->fb.conv_partial)
+        memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
 
-    unsigned row;
-    for (row = 0; row < fb_height; row++) {
-        uint32_t in_col_start_addr = sof1 + field_adv * row * 2;
-        uint32_t *out_col_start = dst_fb + row * fb_width;
-
-        conv_rgb555_to_rgba8888(pvr2, out_col_start, in_col_start_addr,
-                                fb_width, concat);
-    }
+    conv_fb_rows(pvr2, dst_fb, fb_width, fb_height, &sof1, 1,
+                 fb_width * 2, 2, conv_rgb555_to_rgba8888, concat);
 
     fb->fb_read_width = fb_width;
     fb->fb_read_height = fb_height;
@@ -464,6 +474,7 @@ sync_fb_from_tex_mem_rgb555_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_RGB_555;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -518,17 +529,9 @@ sync_fb_from_tex_mem_rgb0888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
 
-    unsigned row;
-    for (row = 0; row < rows_per_field; row++) {
-        uint32_t addr_row1 = sof1 + row * field_adv;
-        uint32_t addr_row2 = sof2 + row * field_adv;
-
-        conv_rgb0888_to_rgba8888(pvr2, dst_fb + (row << 1) * fb_width,
-                                 addr_row1, fb_width);
-        conv_rgb0888_to_rgba8888(pvr2,
-                                 dst_fb + ((row << 1) + 1) * fb_width,
-                                 addr_row2, fb_width);
-    }
+    uint32_t const sof[2] = { sof1, sof2 };
+    conv_fb_rows(pvr2, dst_fb, fb_width, rows_per_field * 2, sof, 2,
+                 field_adv, 4, conv_rgb0888_to_rgba8888, 0);
 
     fb->fb_read_width = fb_width;
     fb->fb_read_height = fb_height;
@@ -546,6 +549,7 @@ sync_fb_from_tex_mem_rgb0888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_0RGB_0888;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -585,14 +589,8 @@ sync_fb_from_tex_mem_rgb0888_prog(struct pvr2 *pvr2, struct framebuffer *fb,
 
     uint32_t *dst_fb = pvr2->fb.ogl_fb;
 
-    unsigned row;
-    for (row = 0; row < fb_height; row++) {
-        uint32_t addr_in_col_start = sof1 + fb_width * row * 4;
-        uint32_t *out_col_start = dst_fb + row * fb_width;
-
-        conv_rgb0888_to_rgba8888(pvr2, out_col_start,
-                                 addr_in_col_start, fb_width);
-    }
+    conv_fb_rows(pvr2, dst_fb, fb_width, fb_height, &sof1, 1,
+                 fb_width * 4, 4, conv_rgb0888_to_rgba8888, 0);
 
     fb->fb_read_width = fb_width;
     fb->fb_read_height = fb_height;
@@ -607,6 +605,7 @@ sync_fb_from_tex_mem_rgb0888_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     fb->flags.vert_flip = true;
     fb->stamp = pvr2->fb.stamp;
     fb->flags.fmt = FB_PIX_FMT_0RGB_0888;
+    fb->flags.raw = config_get_gpu_fb_conv();
 
     struct gfx_il_inst cmd;
 
@@ -628,6 +627,24 @@ sync_fb_from_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb,
     uint32_t fb_r_sof2 = get_fb_r_sof2(pvr2) & ~3;
 
     uint32_t fb_r_ctrl = get_fb_r_ctrl(pvr2);
+
+    /*
+     * ogl_fb can be brought up to date instead of converted from scratch if
+     * it still holds this framebuffer and none of the registers that decide
+     * how to read it have changed.
+     */
+    int fb_idx = fb - pvr2->fb.fb_heap;
+    uint32_t const conv_key[4] = {
+        fb_r_ctrl,
+        get_fb_r_size(pvr2),
+        fb_r_sof1 | (interlace ? 1 : 0) | (config_get_gpu_fb_conv() ? 2 : 0),
+        interlace ? fb_r_sof2 : 0
+    };
+    pvr2->fb.conv_partial = pvr2->fb.conv_owner == fb_idx &&
+        memcmp(conv_key, pvr2->fb.conv_key, sizeof(conv_key)) == 0;
+    pvr2->fb.conv_owner = fb_idx;
+    memcpy(pvr2->fb.conv_key, conv_key, sizeof(conv_key));
+
     unsigned px_tp = (fb_r_ctrl & 0xc) >> 2;
     switch (px_tp) {
     case 0:
@@ -670,6 +687,11 @@ sync_fb_from_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb,
                                               fb_r_sof1);
         }
     }
+
+    pvr2->fb.conv_partial = false;
+    memset(pvr2->fb.conv_dirty, 0, sizeof(pvr2->fb.conv_dirty));
+
+    fb_mark_pages(pvr2->fb.host_pages, fb);
 }
 
 /*
@@ -681,67 +703,235 @@ sync_fb_from_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb,
 static void copy_to_tex_mem(struct pvr2 *pvr2, void const *in,
                             addr32_t offs, size_t len);
 
+#ifdef __SSE2__
+static inline __m128i
+conv_16bit_to_rgba8888_x4(__m128i pix, __m128i r_mask, __m128i g_mask,
+                          __m128i b_mask, __m128i fill) {
+    __m128i r = _mm_and_si128(_mm_srli_epi32(pix, 8), r_mask);
+    __m128i g = _mm_and_si128(_mm_slli_epi32(pix, 5), g_mask);
+    __m128i b = _mm_and_si128(_mm_slli_epi32(pix, 19), b_mask);
+    return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, fill));
+}
+#endif
+
+/*
+ * 555 and 565 only differ in which bits they keep from each component, so
+ * they share this.  Each component is shifted into its byte and masked, and
+ * then fill supplies the alpha channel and the concat bits.
+ */
 static void
-conv_rgb565_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                        uint32_t addr_pixels_in, unsigned n_pixels,
-                        uint8_t concat) {
-    for (unsigned idx = 0; idx < n_pixels; idx++) {
-        uint32_t pix_addr = addr_pixels_in + idx * 2;
-        uint16_t pix = pvr2_tex_mem_32bit_read16(pvr2, pix_addr);
-        uint32_t r = (((pix & 0xf800) >> 11) << 3) | concat;
-        uint32_t g = (((pix & 0x07e0) >> 5) << 2) | (concat & 0x3);
-        uint32_t b = ((pix & 0x001f) << 3) | concat;
-
-        pixels_out[idx] = (255 << 24) | (b << 16) | (g << 8) | r;
+conv_16bit_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
+                       unsigned n_pixels, uint32_t r_mask, uint32_t g_mask,
+                       uint32_t b_mask, uint32_t fill) {
+    uint8_t const *in = (uint8_t const*)pixels_in;
+    unsigned idx = 0;
+
+#ifdef __AVX2__
+    __m256i r_mask8 = _mm256_set1_epi32(r_mask);
+    __m256i g_mask8 = _mm256_set1_epi32(g_mask);
+    __m256i b_mask8 = _mm256_set1_epi32(b_mask);
+    __m256i fill8 = _mm256_set1_epi32(fill);
+    for (; idx + 8 <= n_pixels; idx += 8) {
+        __m256i pix = _mm256_cvtepu16_epi32(
+            _mm_loadu_si128((__m128i const*)(in + idx * 2)));
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(pix, 8), r_mask8);
+        __m256i g = _mm256_and_si256(_mm256_slli_epi32(pix, 5), g_mask8);
+        __m256i b = _mm256_and_si256(_mm256_slli_epi32(pix, 19), b_mask8);
+        __m256i out = _mm256_or_si256(_mm256_or_si256(r, g),
+                                      _mm256_or_si256(b, fill8));
+        _mm256_storeu_si256((__m256i*)(pixels_out + idx), out);
+    }
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i r_mask4 = _mm_set1_epi32(r_mask);
+    __m128i g_mask4 = _mm_set1_epi32(g_mask);
+    __m128i b_mask4 = _mm_set1_epi32(b_mask);
+    __m128i fill4 = _mm_set1_epi32(fill);
+    for (; idx + 8 <= n_pixels; idx += 8) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(in + idx * 2));
+        __m128i lo = conv_16bit_to_rgba8888_x4(_mm_unpacklo_epi16(pix, zero),
+                                               r_mask4, g_mask4,
+                                               b_mask4, fill4);
+        __m128i hi = conv_16bit_to_rgba8888_x4(_mm_unpackhi_epi16(pix, zero),
+                                               r_mask4, g_mask4,
+                                               b_mask4, fill4);
+        _mm_storeu_si128((__m128i*)(pixels_out + idx), lo);
+        _mm_storeu_si128((__m128i*)(pixels_out + idx + 4), hi);
+    }
+#endif
+
+    for (; idx < n_pixels; idx++) {
+        uint16_t pix16;
+        memcpy(&pix16, in + idx * 2, sizeof(pix16));
+        uint32_t pix = pix16;
+        pixels_out[idx] = ((pix >> 8) & r_mask) | ((pix << 5) & g_mask) |
+            ((pix << 19) & b_mask) | fill;
     }
 }
 
 static void
-conv_rgb555_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                        uint32_t addr_pixels_in,
+conv_rgb565_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
                         unsigned n_pixels, uint8_t concat) {
-    for (unsigned idx = 0; idx < n_pixels; idx++) {
-        uint32_t pix_addr = addr_pixels_in + idx * 2;
-        uint16_t pix = pvr2_tex_mem_32bit_read16(pvr2, pix_addr);
-        uint32_t b = ((pix & 0x001f) << 3) | concat;
-        uint32_t g = (((pix & 0x03e0) >> 5) << 2) | (concat & 3);
-        uint32_t r = (((pix & 0xec00) >> 10) << 2) | concat;
-
-        pixels_out[idx] = (255 << 24) | (b << 16) | (g << 8) | r;
-    }
+    uint32_t fill = 0xff000000 | (concat << 16) | ((concat & 3) << 8) | concat;
+    conv_16bit_to_rgba8888(pixels_out, pixels_in, n_pixels,
+                           0xf8, 0xfc00, 0xf80000, fill);
+}
+
+static void
+conv_rgb555_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
+                        unsigned n_pixels, uint8_t concat) {
+    uint32_t fill = 0xff000000 | (concat << 16) | ((concat & 3) << 8) | concat;
+    conv_16bit_to_rgba8888(pixels_out, pixels_in, n_pixels,
+                           0xec, 0x7c00, 0xf80000, fill);
 }
 
 static void
-conv_rgb888_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                        uint32_t addr_pixels_in,
-                        unsigned n_pixels) {
-    for (unsigned idx = 0; idx < n_pixels; idx++) {
-        uint8_t pix[3];
-        pvr2_tex_mem_32bit_read_raw(pvr2, pix, addr_pixels_in + idx * 3, 3);
-        uint32_t r = pix[0];
-        uint32_t g = pix[1];
-        uint32_t b = pix[2];
-
-        pixels_out[idx] = (255 << 24) | (r << 16) | (g << 8) | b;
+conv_rgb888_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
+                        unsigned n_pixels, uint8_t concat) {
+    uint8_t const *in = (uint8_t const*)pixels_in;
+    unsigned idx = 0;
+
+#ifdef __SSSE3__
+    /*
+     * Each 16-byte load covers four pixels plus four bytes of the next pixel,
+     * so these can read up to four bytes past the end of the row.  The row
+     * buffer in conv_fb_rows has slack for that.
+     */
+    __m128i shuf = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1,
+                                 8, 7, 6, -1, 11, 10, 9, -1);
+    __m128i alpha = _mm_set1_epi32(0xff000000);
+#ifdef __AVX2__
+    __m256i shuf8 = _mm256_broadcastsi128_si256(shuf);
+    __m256i alpha8 = _mm256_set1_epi32(0xff000000);
+    for (; idx + 8 <= n_pixels; idx += 8) {
+        __m128i lo = _mm_loadu_si128((__m128i const*)(in + idx * 3));
+        __m128i hi = _mm_loadu_si128((__m128i const*)(in + idx * 3 + 12));
+        __m256i pix =
+            _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        __m256i out = _mm256_or_si256(_mm256_shuffle_epi8(pix, shuf8), alpha8);
+        _mm256_storeu_si256((__m256i*)(pixels_out + idx), out);
+    }
+#endif
+    for (; idx + 4 <= n_pixels; idx += 4) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(in + idx * 3));
+        __m128i out = _mm_or_si128(_mm_shuffle_epi8(pix, shuf), alpha);
+        _mm_storeu_si128((__m128i*)(pixels_out + idx), out);
+    }
+#endif
+
+    for (; idx < n_pixels; idx++) {
+        uint32_t r = in[idx * 3];
+        uint32_t g = in[idx * 3 + 1];
+        uint32_t b = in[idx * 3 + 2];
+
+        pixels_out[idx] = 0xff000000 | (r << 16) | (g << 8) | b;
     }
 }
 
 static void
-conv_rgb0888_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
-                         uint32_t addr_pixels_in,
-                         unsigned n_pixels) {
-    for (unsigned idx = 0; idx < n_pixels; idx++) {
-        uint32_t pix = pvr2_tex_mem_32bit_read32(pvr2, addr_pixels_in + idx * 4);
+conv_rgb0888_to_rgba8888(uint32_t *pixels_out, void const *pixels_in,
+                         unsigned n_pixels, uint8_t concat) {
+    uint8_t const *in = (uint8_t const*)pixels_in;
+    unsigned idx = 0;
+
+#ifdef __SSSE3__
+    // swap the red and blue channels and replace the pad byte with alpha
+    __m128i shuf = _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1,
+                                 10, 9, 8, -1, 14, 13, 12, -1);
+    __m128i alpha = _mm_set1_epi32(0xff000000);
+#ifdef __AVX2__
+    __m256i shuf8 = _mm256_broadcastsi128_si256(shuf);
+    __m256i alpha8 = _mm256_set1_epi32(0xff000000);
+    for (; idx + 8 <= n_pixels; idx += 8) {
+        __m256i pix = _mm256_loadu_si256((__m256i const*)(in + idx * 4));
+        __m256i out = _mm256_or_si256(_mm256_shuffle_epi8(pix, shuf8), alpha8);
+        _mm256_storeu_si256((__m256i*)(pixels_out + idx), out);
+    }
+#endif
+    for (; idx + 4 <= n_pixels; idx += 4) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(in + idx * 4));
+        __m128i out = _mm_or_si128(_mm_shuffle_epi8(pix, shuf), alpha);
+        _mm_storeu_si128((__m128i*)(pixels_out + idx), out);
+    }
+#elif defined(__SSE2__)
+    __m128i g_mask = _mm_set1_epi32(0x0000ff00);
+    __m128i byte_mask = _mm_set1_epi32(0x000000ff);
+    __m128i alpha = _mm_set1_epi32(0xff000000);
+    for (; idx + 4 <= n_pixels; idx += 4) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(in + idx * 4));
+        __m128i r = _mm_and_si128(_mm_srli_epi32(pix, 16), byte_mask);
+        __m128i g = _mm_and_si128(pix, g_mask);
+        __m128i b = _mm_slli_epi32(_mm_and_si128(pix, byte_mask), 16);
+        __m128i out = _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, alpha));
+        _mm_storeu_si128((__m128i*)(pixels_out + idx), out);
+    }
+#endif
+
+    for (; idx < n_pixels; idx++) {
+        uint32_t pix;
+        memcpy(&pix, in + idx * 4, sizeof(pix));
         uint32_t r = (pix & 0x00ff0000) >> 16;
         uint32_t g = (pix & 0x0000ff00) >> 8;
         uint32_t b = (pix & 0x000000ff);
-        pixels_out[idx] = (255 << 24) | (b << 16) | (g << 8) | r;
+        pixels_out[idx] = 0xff000000 | (b << 16) | (g << 8) | r;
+    }
+}
+
+static void
+conv_fb_rows(struct pvr2 *pvr2, uint32_t *dst, unsigned fb_width,
+             unsigned n_rows, uint32_t const *sof, unsigned n_fields,
+             unsigned field_adv, unsigned pix_sz, fb_conv_fn conv,
+             uint8_t concat) {
+    /*
+     * FB_R_SIZE limits each row to 0x400 32-bit words.  The extra four words
+     * are slack for the vector loads in conv_rgb888_to_rgba8888.
+     */
+    uint32_t row_buf[OGL_FB_W_MAX + 4];
+    unsigned row_len = fb_width * pix_sz;
+
+#ifdef INVARIANTS
+    if (row_len > OGL_FB_W_MAX * sizeof(uint32_t))
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    uint64_t const *dirty = pvr2->fb.conv_partial ? pvr2->fb.conv_dirty : NULL;
+
+    /*
+     * Reading a whole row at once means pvr2_tex_mem_32bit_read_raw only has
+     * to check for overlapping framebuffers once per row instead of once per
+     * pixel.
+     */
+    unsigned row;
+    if (config_get_gpu_fb_conv()) {
+        uint8_t *dst_raw = (uint8_t*)dst;
+        unsigned rows_per_field = n_rows / n_fields;
+        for (row = 0; row < n_rows; row++) {
+            unsigned field = row % n_fields, field_row = row / n_fields;
+            uint32_t addr = sof[field] + field_row * field_adv;
+            if (dirty && !fb_pages_hit(dirty, addr & TEX_MIRROR_MASK,
+                                       addr + row_len - 1))
+                continue;
+            pvr2_tex_mem_32bit_read_raw(pvr2, dst_raw + row_len *
+                                        (field * rows_per_field + field_row),
+                                        addr, row_len);
+        }
+        return;
+    }
+
+    for (row = 0; row < n_rows; row++) {
+        uint32_t addr = sof[row % n_fields] + (row / n_fields) * field_adv;
+        if (dirty && !fb_pages_hit(dirty, addr & TEX_MIRROR_MASK,
+                                   addr + row_len - 1))
+            continue;
+        pvr2_tex_mem_32bit_read_raw(pvr2, row_buf, addr, row_len);
+        conv(dst + row * fb_width, row_buf, fb_width, concat);
     }
 }
 
 static int
 pick_fb(struct pvr2 *pvr2, unsigned width, unsigned height, uint32_t addr);
 
+
 // reset all members except the gfx_obj handle
 static void fb_reset(struct framebuffer *fb) {
     fb->fb_read_width = 0;
@@ -762,12 +952,22 @@ static void fb_reset(struct framebuffer *fb) {
     fb->flags.state = FB_STATE_INVALID;
     fb->flags.fmt = FB_PIX_FMT_RGB_555;
     fb->flags.vert_flip = false;
+    fb->flags.read_back = false;
+    fb->flags.scanned_out = false;
+    fb->flags.stale = false;
+    fb->flags.raw = false;
 }
 
 void pvr2_framebuffer_init(struct pvr2 *pvr2) {
     struct gfx_il_inst cmd;
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
 
+    memset(pvr2->fb.gfx_pages, 0, sizeof(pvr2->fb.gfx_pages));
+    memset(pvr2->fb.host_pages, 0, sizeof(pvr2->fb.host_pages));
+    pvr2->fb.cur_tgt = -1;
+    pvr2->fb.conv_owner = -1;
+    pvr2->fb.conv_partial = false;
+
     int fb_no;
     for (fb_no = 0; fb_no < FB_HEAP_SIZE; fb_no++) {
         fb_reset(fb_heap + fb_no);
@@ -846,6 +1046,7 @@ void framebuffer_render(struct pvr2 *pvr2) {
 
 submit_the_fb:
     pvr2->fb.stamp++;
+    fb_heap[fb_idx].flags.scanned_out = true;
 
     cmd.op = GFX_IL_POST_FRAMEBUFFER;
     cmd.arg.post_framebuffer.obj_handle = fb_heap[fb_idx].obj_handle;
@@ -853,6 +1054,26 @@ submit_the_fb:
     cmd.arg.post_framebuffer.height = fb_heap[fb_idx].fb_read_height;
     cmd.arg.post_framebuffer.vert_flip = fb_heap[fb_idx].flags.vert_flip;
     cmd.arg.post_framebuffer.interlaced = interlace;
+    cmd.arg.post_framebuffer.raw_fmt = GFX_FB_RAW_NONE;
+    cmd.arg.post_framebuffer.concat = concat;
+    if (fb_heap[fb_idx].flags.raw) {
+        switch (fb_heap[fb_idx].flags.fmt) {
+        case FB_PIX_FMT_RGB_555:
+            cmd.arg.post_framebuffer.raw_fmt = GFX_FB_RAW_RGB555;
+            break;
+        case FB_PIX_FMT_RGB_565:
+            cmd.arg.post_framebuffer.raw_fmt = GFX_FB_RAW_RGB565;
+            break;
+        case FB_PIX_FMT_RGB_888:
+            cmd.arg.post_framebuffer.raw_fmt = GFX_FB_RAW_RGB888;
+            break;
+        case FB_PIX_FMT_0RGB_0888:
+            cmd.arg.post_framebuffer.raw_fmt = GFX_FB_RAW_RGB0888;
+            break;
+        default:
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+    }
 
     /*
      * double the height for interlace mode because we submit both fields
@@ -889,77 +1110,201 @@ submit_the_fb:
     rend_exec_il(&cmd, 1);
 }
 
-static void
-fb_sync_from_host_0565_krgb(struct pvr2 *pvr2, struct framebuffer *fb) {
-    unsigned x_min = fb->x_clip_min;
-    unsigned y_min = fb->y_clip_min;
-    unsigned width = fb->tile_w;
-    unsigned height = fb->tile_h;
-    unsigned x_max = width < fb->x_clip_max ? width : fb->x_clip_max;
-    unsigned y_max = height < fb->y_clip_max ? height : fb->y_clip_max;
+uint32_t framebuffer_hash(struct pvr2 *pvr2) {
+    uint32_t fb_r_ctrl = get_fb_r_ctrl(pvr2);
+    if (!(fb_r_ctrl & 1))
+        return 0;
 
-    unsigned stride = fb->linestride;
-    uint32_t const *addr = fb->addr_first;
+    bool interlace = get_spg_control(pvr2) & (1 << 4);
+    uint32_t fb_r_size = get_fb_r_size(pvr2);
+    unsigned modulus = (fb_r_size >> 20) & 0x3ff;
+    unsigned row_bytes = ((fb_r_size & 0x3ff) + 1) * 4;
+    unsigned height = ((fb_r_size >> 10) & 0x3ff) + 1;
+    unsigned field_adv = row_bytes + modulus * 4 - 4;
 
-    uint16_t const k_val = 0;
+    uint32_t const sof[2] = {
+        get_fb_r_sof1(pvr2) & ~3, get_fb_r_sof2(pvr2) & ~3
+    };
+    unsigned n_fields = interlace ? 2 : 1;
+
+    static uint8_t row[OGL_FB_W_MAX * 4];
+    uLong crc = crc32(0, Z_NULL, 0);
+
+    unsigned field_no, row_no;
+    for (field_no = 0; field_no < n_fields; field_no++) {
+        for (row_no = 0; row_no < height; row_no++) {
+            uint32_t addr = sof[field_no] + row_no * field_adv;
+            if (addr + row_bytes > PVR2_TEX32_MEM_LEN)
+                break;
+            pvr2_tex_mem_32bit_read_raw(pvr2, row, addr, row_bytes);
+            crc = crc32(crc, row, row_bytes);
+        }
+    }
 
-#ifdef INVARIANTS
-    if (width * height * 4 >= OGL_FB_BYTES)
-        RAISE_ERROR(ERROR_INTEGRITY);
+    return crc;
+}
+
+/*
+ * These convert rows read back from the host (which are always RGBA8888) into
+ * the framebuffer's packed format.
+ */
+typedef void(*fb_host_conv_fn)(void *pixels_out, uint32_t const *pixels_in,
+                               unsigned n_pixels);
+
+#ifdef __SSE2__
+static inline __m128i
+conv_rgba8888_to_16bit_x4(__m128i pix, __m128i shift0, __m128i shift1,
+                          __m128i shift2, __m128i mask0, __m128i mask1,
+                          __m128i mask2, __m128i alpha_bit) {
+    __m128i c0 = _mm_and_si128(_mm_srl_epi32(pix, shift0), mask0);
+    __m128i c1 = _mm_and_si128(_mm_srl_epi32(pix, shift1), mask1);
+    __m128i c2 = _mm_and_si128(_mm_sll_epi32(pix, shift2), mask2);
+    __m128i transparent =
+        _mm_cmpeq_epi32(_mm_srli_epi32(pix, 24), _mm_setzero_si128());
+    __m128i alpha = _mm_andnot_si128(transparent, alpha_bit);
+    __m128i out = _mm_or_si128(_mm_or_si128(c0, c1), _mm_or_si128(c2, alpha));
+
+    // sign-extend so that _mm_packs_epi32 doesn't saturate the alpha bit
+    return _mm_srai_epi32(_mm_slli_epi32(out, 16), 16);
+}
 #endif
 
-    unsigned row, col;
-    unsigned char *ogl_fb = (unsigned char*)pvr2->fb.ogl_fb;
-    for (row = y_min; row <= y_max; row++) {
-        unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
-        for (col = x_min; col <= x_max; col++) {
-            unsigned fb_idx = row * width + col;
-            uint16_t pix_out = ((ogl_fb[4 * fb_idx + 2] & 0xf8) >> 3) |
-                ((ogl_fb[4 * fb_idx + 1] & 0xfc) << 3) |
-                ((ogl_fb[4 * fb_idx] & 0xf8) << 8) | k_val;
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 2 * col, sizeof(pix_out));
+/*
+ * Every 16-bit format is built out of (pix >> shift0) & mask0,
+ * (pix >> shift1) & mask1 and (pix << shift2) & mask2.  alpha_bit gets set for
+ * any pixel whose alpha isn't zero.
+ */
+static void
+conv_rgba8888_to_16bit(void *pixels_out, uint32_t const *pixels_in,
+                       unsigned n_pixels, unsigned shift0, uint32_t mask0,
+                       unsigned shift1, uint32_t mask1,
+                       unsigned shift2, uint32_t mask2, uint32_t alpha_bit) {
+    uint8_t *out = (uint8_t*)pixels_out;
+    unsigned idx = 0;
+
+#ifdef __AVX2__
+    __m128i shift0_v = _mm_cvtsi32_si128(shift0);
+    __m128i shift1_v = _mm_cvtsi32_si128(shift1);
+    __m128i shift2_v = _mm_cvtsi32_si128(shift2);
+    __m256i mask0_8 = _mm256_set1_epi32(mask0);
+    __m256i mask1_8 = _mm256_set1_epi32(mask1);
+    __m256i mask2_8 = _mm256_set1_epi32(mask2);
+    __m256i alpha_bit8 = _mm256_set1_epi32(alpha_bit);
+    for (; idx + 16 <= n_pixels; idx += 16) {
+        __m256i halves[2];
+        unsigned half;
+        for (half = 0; half < 2; half++) {
+            __m256i pix = _mm256_loadu_si256((__m256i const*)
+                                             (pixels_in + idx + half * 8));
+            __m256i c0 =
+                _mm256_and_si256(_mm256_srl_epi32(pix, shift0_v), mask0_8);
+            __m256i c1 =
+                _mm256_and_si256(_mm256_srl_epi32(pix, shift1_v), mask1_8);
+            __m256i c2 =
+                _mm256_and_si256(_mm256_sll_epi32(pix, shift2_v), mask2_8);
+            __m256i transparent =
+                _mm256_cmpeq_epi32(_mm256_srli_epi32(pix, 24),
+                                   _mm256_setzero_si256());
+            __m256i alpha = _mm256_andnot_si256(transparent, alpha_bit8);
+            __m256i res = _mm256_or_si256(_mm256_or_si256(c0, c1),
+                                          _mm256_or_si256(c2, alpha));
+            halves[half] =
+                _mm256_srai_epi32(_mm256_slli_epi32(res, 16), 16);
         }
+        // _mm256_packs_epi32 packs within each 128-bit lane
+        __m256i packed = _mm256_permute4x64_epi64(
+            _mm256_packs_epi32(halves[0], halves[1]), 0xd8);
+        _mm256_storeu_si256((__m256i*)(out + idx * 2), packed);
+    }
+#elif defined(__SSE2__)
+    __m128i shift0_v = _mm_cvtsi32_si128(shift0);
+    __m128i shift1_v = _mm_cvtsi32_si128(shift1);
+    __m128i shift2_v = _mm_cvtsi32_si128(shift2);
+    __m128i mask0_4 = _mm_set1_epi32(mask0);
+    __m128i mask1_4 = _mm_set1_epi32(mask1);
+    __m128i mask2_4 = _mm_set1_epi32(mask2);
+    __m128i alpha_bit4 = _mm_set1_epi32(alpha_bit);
+    for (; idx + 8 <= n_pixels; idx += 8) {
+        __m128i lo = conv_rgba8888_to_16bit_x4(
+            _mm_loadu_si128((__m128i const*)(pixels_in + idx)),
+            shift0_v, shift1_v, shift2_v, mask0_4, mask1_4, mask2_4,
+            alpha_bit4);
+        __m128i hi = conv_rgba8888_to_16bit_x4(
+            _mm_loadu_si128((__m128i const*)(pixels_in + idx + 4)),
+            shift0_v, shift1_v, shift2_v, mask0_4, mask1_4, mask2_4,
+            alpha_bit4);
+        _mm_storeu_si128((__m128i*)(out + idx * 2), _mm_packs_epi32(lo, hi));
+    }
+#endif
+
+    for (; idx < n_pixels; idx++) {
+        uint32_t pix = pixels_in[idx];
+        uint16_t pix_out = ((pix >> shift0) & mask0) |
+            ((pix >> shift1) & mask1) | ((pix << shift2) & mask2) |
+            ((pix >> 24) ? alpha_bit : 0);
+        memcpy(out + idx * 2, &pix_out, sizeof(pix_out));
     }
 }
 
 static void
-fb_sync_from_host_0555_krgb(struct pvr2 *pvr2, struct framebuffer *fb) {
-    unsigned x_min = fb->x_clip_min;
-    unsigned y_min = fb->y_clip_min;
-    unsigned width = fb->tile_w;
-    unsigned height = fb->tile_h;
-    unsigned x_max = width < fb->x_clip_max ? width : fb->x_clip_max;
-    unsigned y_max = height < fb->y_clip_max ? height : fb->y_clip_max;
+conv_rgba8888_to_krgb0565(void *pixels_out, uint32_t const *pixels_in,
+                          unsigned n_pixels) {
+    conv_rgba8888_to_16bit(pixels_out, pixels_in, n_pixels,
+                           19, 0x1f, 5, 0x7e0, 8, 0xf800, 0);
+}
 
-    unsigned stride = fb->linestride;
-    uint32_t const *addr = fb->addr_first;
+static void
+conv_rgba8888_to_krgb0555(void *pixels_out, uint32_t const *pixels_in,
+                          unsigned n_pixels) {
+    conv_rgba8888_to_16bit(pixels_out, pixels_in, n_pixels,
+                           19, 0x1f, 5, 0x7c0, 7, 0x7c00, 0);
+}
 
-    uint16_t const k_val = 0;
+static void
+conv_rgba8888_to_argb1555(void *pixels_out, uint32_t const *pixels_in,
+                          unsigned n_pixels) {
+    conv_rgba8888_to_16bit(pixels_out, pixels_in, n_pixels,
+                           19, 0x1f, 6, 0x3e0, 7, 0x7c00, 0x8000);
+}
 
-#ifdef INVARIANTS
-    if ((width * height * 4) >= OGL_FB_BYTES)
-        RAISE_ERROR(ERROR_INTEGRITY);
+static void
+conv_rgba8888_to_rgb0888(void *pixels_out, uint32_t const *pixels_in,
+                         unsigned n_pixels) {
+    uint8_t *out = (uint8_t*)pixels_out;
+    unsigned idx = 0;
+
+#ifdef __AVX2__
+    __m256i mask8 = _mm256_set1_epi32(0x00ffffff);
+    for (; idx + 8 <= n_pixels; idx += 8) {
+        __m256i pix = _mm256_loadu_si256((__m256i const*)(pixels_in + idx));
+        _mm256_storeu_si256((__m256i*)(out + idx * 4),
+                            _mm256_and_si256(pix, mask8));
+    }
+#elif defined(__SSE2__)
+    __m128i mask4 = _mm_set1_epi32(0x00ffffff);
+    for (; idx + 4 <= n_pixels; idx += 4) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(pixels_in + idx));
+        _mm_storeu_si128((__m128i*)(out + idx * 4), _mm_and_si128(pix, mask4));
+    }
 #endif
 
-    unsigned row, col;
-    unsigned char *ogl_fb = (unsigned char*)pvr2->fb.ogl_fb;
-    for (row = y_min; row <= y_max; row++) {
-        unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
-        for (col = x_min; col <= x_max; col++) {
-            unsigned fb_idx = row * width + col;
-            uint16_t pix_out = ((ogl_fb[4 * fb_idx + 2] & 0xf8) >> 3) |
-                ((ogl_fb[4 * fb_idx + 1] & 0xf8) << 3) |
-                ((ogl_fb[4 * fb_idx] & 0xf8) << 7) | k_val;
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 2 * col, sizeof(pix_out));
-        }
+    for (; idx < n_pixels; idx++) {
+        uint32_t pix_out = pixels_in[idx] & 0x00ffffff;
+        memcpy(out + idx * 4, &pix_out, sizeof(pix_out));
     }
 }
 
+// number of pixels fb_sync_from_host converts at a time
+#define FB_HOST_CHUNK 256
 
+/*
+ * write the host's copy of the framebuffer back to texture memory one row at
+ * a time.  conv can be NULL if the framebuffer's format is the same as the
+ * host's.
+ */
 static void
-fb_sync_from_host_1555_argb(struct pvr2 *pvr2, struct framebuffer *fb) {
+fb_sync_from_host(struct pvr2 *pvr2, struct framebuffer *fb,
+                  unsigned pix_sz, fb_host_conv_fn conv) {
     unsigned x_min = fb->x_clip_min;
     unsigned y_min = fb->y_clip_min;
     unsigned width = fb->tile_w;
@@ -975,97 +1320,38 @@ fb_sync_from_host_1555_argb(struct pvr2 *pvr2, struct framebuffer *fb) {
         RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
-    unsigned row, col;
-    unsigned char *ogl_fb = (unsigned char *)pvr2->fb.ogl_fb;
+    uint32_t chunk[FB_HOST_CHUNK];
+    unsigned row;
     for (row = y_min; row <= y_max; row++) {
         /*
          * TODO: figure out how this is supposed to work with interlacing.
          *
          * The below code implements this as if it was progressive-scan, and
-         * it works perfectly.  Obviously this means that either my
-         * understanding of interlace-scan is incorrect, or it's actually
+         * it works perfectly for ARGB1555.  Obviously this means that either
+         * my understanding of interlace-scan is incorrect, or it's actually
          * supposed to be progressive-scan and WashingtonDC is not figuring
          * that out right.
          */
         unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
-        for (col = x_min; col <= x_max; col++) {
-            unsigned fb_idx = row * width + col;
-
-            unsigned char const *pix_in = ogl_fb + 4 * fb_idx;
-            uint16_t red = (pix_in[0] & 0xf8) >> 3;
-            uint16_t green = (pix_in[1] & 0xf8) >> 3;
-            uint16_t blue = (pix_in[2] * 0xf8) >> 3;
-            uint16_t alpha = pix_in[3] ? 1 : 0;
+        uint32_t const *row_in = pvr2->fb.ogl_fb + row * width;
 
-            uint16_t pix_out =
-                (alpha << 15) | (red << 10) | (green << 5) | blue;
-
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 2 * col, sizeof(pix_out));
-        }
-    }
-}
-
-static void fb_sync_from_host_rgb0888(struct pvr2 *pvr2, struct framebuffer *fb) {
-    // TODO: this code is untested lol
-    unsigned x_min = fb->x_clip_min;
-    unsigned y_min = fb->y_clip_min;
-    unsigned width = fb->tile_w;
-    unsigned height = fb->tile_h;
-    unsigned x_max = width < fb->x_clip_max ? width : fb->x_clip_max;
-    unsigned y_max = height < fb->y_clip_max ? height : fb->y_clip_max;
-
-    unsigned stride = fb->linestride;
-    uint32_t const *addr = fb->addr_first;
-
-#ifdef INVARIANTS
-    if ((width * height * 4) >= OGL_FB_BYTES)
-        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-
-    unsigned row, col;
-    unsigned char *ogl_fb = (unsigned char*)pvr2->fb.ogl_fb;
-    for (row = y_min; row <= y_max; row++) {
-        unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
-        for (col = x_min; col <= x_max; col++) {
-            uint32_t pix_in;
-            unsigned fb_idx = row * width + col;
-            memcpy(&pix_in, ogl_fb + sizeof(uint32_t) * fb_idx, sizeof(pix_in));
-            uint32_t pix_out = pix_in & 0x00ffffff;
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 4 * col, sizeof(pix_out));
+        if (!conv) {
+            if (x_min <= x_max) {
+                copy_to_tex_mem(pvr2, row_in + x_min, line_offs + pix_sz * x_min,
+                                (x_max - x_min + 1) * pix_sz);
+            }
+            continue;
         }
-    }
-}
-
-static void fb_sync_from_host_argb8888(struct pvr2 *pvr2, struct framebuffer *fb) {
-    // TODO: this code is untested lol
-    unsigned x_min = fb->x_clip_min;
-    unsigned y_min = fb->y_clip_min;
-    unsigned width = fb->tile_w;
-    unsigned height = fb->tile_h;
-    unsigned x_max = width < fb->x_clip_max ? width : fb->x_clip_max;
-    unsigned y_max = height < fb->y_clip_max ? height : fb->y_clip_max;
-
-    unsigned stride = fb->linestride;
-    uint32_t const *addr = fb->addr_first;
-
-#ifdef INVARIANTS
-    if ((width * height * 4) >= OGL_FB_BYTES)
-        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
 
-    unsigned row, col;
-    char *ogl_fb = (char*)pvr2->fb.ogl_fb;
-    for (row = y_min; row <= y_max; row++) {
-        unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
-        for (col = x_min; col <= x_max; col++) {
-            uint32_t pix_in;
-            unsigned fb_idx = row * width + col;
-            memcpy(&pix_in, ogl_fb + sizeof(uint32_t) * fb_idx, sizeof(pix_in));
-            uint32_t pix_out = pix_in;
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 4 * col, sizeof(pix_out));
+        unsigned col = x_min;
+        while (col <= x_max) {
+            unsigned n_pixels = x_max - col + 1;
+            if (n_pixels > FB_HOST_CHUNK)
+                n_pixels = FB_HOST_CHUNK;
+            conv(chunk, row_in + col, n_pixels);
+            copy_to_tex_mem(pvr2, chunk, line_offs + pix_sz * col,
+                            n_pixels * pix_sz);
+            col += n_pixels;
         }
     }
 }
@@ -1076,6 +1362,19 @@ sync_fb_to_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb) {
         return;
 
     fb->flags.state |= ~FB_STATE_VIRT;
+    fb->flags.read_back = true;
+
+    /*
+     * this can't be helped because there's no way to know a framebuffer is
+     * going to be read back until it actually is.  read_back keeps turbo mode
+     * from skipping it again.
+     */
+    if (fb->flags.stale)
+        LOG_DBG("%s - reading back a framebuffer with a skipped render\n",
+                __func__);
+
+    // ogl_fb won't hold a conversion from texture memory anymore
+    pvr2->fb.conv_owner = -1;
 
     struct gfx_il_inst cmd = {
         .op = GFX_IL_READ_OBJ,
@@ -1088,19 +1387,19 @@ sync_fb_to_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb) {
     rend_exec_il(&cmd, 1);
     switch (fb->flags.fmt) {
     case FB_PIX_FMT_RGB_555:
-        fb_sync_from_host_0555_krgb(pvr2, fb);
+        fb_sync_from_host(pvr2, fb, 2, conv_rgba8888_to_krgb0555);
         break;
     case FB_PIX_FMT_RGB_565:
-        fb_sync_from_host_0565_krgb(pvr2, fb);
+        fb_sync_from_host(pvr2, fb, 2, conv_rgba8888_to_krgb0565);
         break;
     case FB_PIX_FMT_0RGB_0888:
-        fb_sync_from_host_rgb0888(pvr2, fb);
+        fb_sync_from_host(pvr2, fb, 4, conv_rgba8888_to_rgb0888);
         break;
     case FB_PIX_FMT_ARGB_8888:
-        fb_sync_from_host_argb8888(pvr2, fb);
+        fb_sync_from_host(pvr2, fb, 4, NULL);
         break;
     case FB_PIX_FMT_ARGB_1555:
-        fb_sync_from_host_1555_argb(pvr2, fb);
+        fb_sync_from_host(pvr2, fb, 2, conv_rgba8888_to_argb1555);
         break;
     default:
         LOG_ERROR("fb->flags.fmt is %d\n", fb->flags.fmt);
@@ -1123,8 +1422,6 @@ static uint32_t get_tex_mem_offs(addr32_t addr) {
     }
 }
 
-#define TEX_MIRROR_MASK 0x7fffff
-
 static void copy_to_tex_mem(struct pvr2 *pvr2, void const *in,
                             addr32_t offs, size_t len) {
     addr32_t last_byte = offs - 1 + len;
@@ -1195,6 +1492,21 @@ pick_fb(struct pvr2 *pvr2, unsigned width, unsigned height, uint32_t addr) {
     return idx;
 }
 
+static void get_render_target_key(struct pvr2 *pvr2, unsigned *width_out,
+                                  unsigned *height_out, uint32_t *addr_out) {
+    unsigned pix_sz = bytes_per_pix(get_fb_r_ctrl(pvr2));
+    uint32_t fb_r_size = get_fb_r_size(pvr2);
+    unsigned width = (((fb_r_size & 0x3ff) + 1) * 4);
+    if (width % pix_sz) {
+        LOG_ERROR("fb x size is %u\n", width);
+        LOG_ERROR("px_sz is %u\n", pix_sz);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+    *width_out = width / pix_sz;
+    *height_out = ((fb_r_size >> 10) & 0x3ff) + 1;
+    *addr_out = get_fb_w_sof1(pvr2) & ~3;
+}
+
 int framebuffer_set_render_target(struct pvr2 *pvr2) {
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
 
@@ -1215,18 +1527,11 @@ int framebuffer_set_render_target(struct pvr2 *pvr2) {
      * interrupt, but I don't know any better way to solve this problem.  This is
      * something to keep in mind for the future.
      */
-    unsigned pix_sz = bytes_per_pix(get_fb_r_ctrl(pvr2));
+    unsigned width, height;
+    uint32_t addr_key;
+    get_render_target_key(pvr2, &width, &height, &addr_key);
     uint32_t fb_r_size = get_fb_r_size(pvr2);
-    unsigned width = (((fb_r_size & 0x3ff) + 1) * 4);
-    if (width % pix_sz) {
-        LOG_ERROR("fb x size is %u\n", width);
-        LOG_ERROR("px_sz is %u\n", pix_sz);
-        RAISE_ERROR(ERROR_UNIMPLEMENTED);
-    }
-    width /= pix_sz;
-    unsigned height = ((fb_r_size >> 10) & 0x3ff) + 1;
-    uint32_t sof1 = get_fb_w_sof1(pvr2) & ~3;
-    uint32_t addr_key = sof1;
+    uint32_t sof1 = addr_key;
 
     int idx = pick_fb(pvr2, width, height, addr_key);
 
@@ -1234,6 +1539,8 @@ int framebuffer_set_render_target(struct pvr2 *pvr2) {
 
     fb->flags.state = FB_STATE_GFX;
     fb->flags.vert_flip = false;
+    fb->flags.stale = false;
+    fb->flags.raw = false;
     fb->fb_read_width = width;
     fb->fb_read_height = height;
     fb->stamp = pvr2->fb.stamp;
@@ -1359,6 +1666,10 @@ int framebuffer_set_render_target(struct pvr2 *pvr2) {
     fb->y_clip_min = get_fb_y_clip_min(pvr2);
     fb->y_clip_max = get_fb_y_clip_max(pvr2);
 
+    fb_mark_pages(pvr2->fb.gfx_pages, fb);
+    fb_mark_pages(pvr2->fb.host_pages, fb);
+    pvr2->fb.cur_tgt = idx;
+
     /*
      * It's safe to re-bind an object that is already bound as a render target
      * without first unbinding it.
@@ -1371,6 +1682,52 @@ int framebuffer_set_render_target(struct pvr2 *pvr2) {
     return fb_heap[idx].obj_handle;
 }
 
+bool framebuffer_render_skippable(struct pvr2 *pvr2) {
+    unsigned width, height;
+    uint32_t addr_key;
+    get_render_target_key(pvr2, &width, &height, &addr_key);
+
+    /*
+     * anything that isn't already a framebuffer that's been displayed is
+     * probably a render-to-texture target.
+     */
+    unsigned fb_idx;
+    struct framebuffer const *fb_heap = pvr2->fb.fb_heap;
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
+        struct framebuffer const *fb = fb_heap + fb_idx;
+        if (fb->flags.state == FB_STATE_GFX &&
+            fb->fb_read_width == width &&
+            fb->fb_read_height == height &&
+            fb->addr_key == addr_key)
+            return fb->flags.scanned_out && !fb->flags.read_back;
+    }
+
+    return false;
+}
+
+void framebuffer_skip_render(struct pvr2 *pvr2) {
+    if (pvr2->fb.cur_tgt >= 0)
+        pvr2->fb.fb_heap[pvr2->fb.cur_tgt].flags.stale = true;
+}
+
+void framebuffer_end_render(struct pvr2 *pvr2) {
+    if (!config_get_async_readback() || pvr2->fb.cur_tgt < 0)
+        return;
+
+    /*
+     * framebuffers that have been read back before will probably get read
+     * back again, so get the copy started now while the CPU is busy with
+     * other things.
+     */
+    struct framebuffer const *fb = pvr2->fb.fb_heap + pvr2->fb.cur_tgt;
+    if (fb->flags.state == FB_STATE_GFX && fb->flags.read_back) {
+        struct gfx_il_inst cmd;
+        cmd.op = GFX_IL_PREFETCH_OBJ;
+        cmd.arg.prefetch_obj.obj_no = fb->obj_handle;
+        rend_exec_il(&cmd, 1);
+    }
+}
+
 void framebuffer_get_render_target_dims(struct pvr2 *pvr2, int tgt,
                                         unsigned *width, unsigned *height) {
     struct framebuffer *fb = pvr2->fb.fb_heap + tgt;
@@ -1396,6 +1753,14 @@ void pvr2_framebuffer_notify_write(struct pvr2 *pvr2, uint32_t addr_32bit,
     uint32_t first_byte = addr_32bit;
     uint32_t last_byte = n_bytes - 1 + first_byte;
 
+    if (pvr2->fb.conv_owner >= 0)
+        fb_mark_range(pvr2->fb.conv_dirty, first_byte, last_byte);
+
+    if (!fb_pages_hit(pvr2->fb.host_pages, first_byte & TEX_MIRROR_MASK,
+                      last_byte))
+        return;
+
+    bool invalidated = false;
     unsigned fb_idx;
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
     for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
@@ -1416,8 +1781,12 @@ void pvr2_framebuffer_notify_write(struct pvr2 *pvr2, uint32_t addr_32bit,
                           fb->addr_first[1],
                           fb->addr_last[1]))) {
             fb->flags.state = FB_STATE_VIRT;
+            invalidated = true;
         }
     }
+
+    if (invalidated)
+        fb_rebuild_pages(pvr2);
 }
 
 void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
@@ -1425,6 +1794,11 @@ void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
     first_tex_addr &= TEX_MIRROR_MASK;
     last_tex_addr &= TEX_MIRROR_MASK;
 
+    // 64-bit framebuffers are marked at half their 64-bit offsets
+    if (!fb_pages_hit(pvr2->fb.gfx_pages, first_tex_addr / 2,
+                      last_tex_addr / 2))
+        return;
+
     int sync_count = 0;
     unsigned fb_idx;
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
@@ -1466,4 +1840,154 @@ void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
             sync_count++;
         }
     }
+
+    if (sync_count)
+        fb_rebuild_pages(pvr2);
+}
+
+static void
+fb_mark_range(uint64_t *pages, uint32_t first_byte, uint32_t last_byte) {
+    unsigned page_no = (first_byte & TEX_MIRROR_MASK) >> FB_PAGE_SHIFT;
+    unsigned last_page = (last_byte & TEX_MIRROR_MASK) >> FB_PAGE_SHIFT;
+    for (; page_no <= last_page; page_no++)
+        pages[page_no / 64] |= ((uint64_t)1) << (page_no % 64);
+}
+
+static void fb_mark_pages(uint64_t *pages, struct framebuffer const *fb) {
+    bool area64 = get_tex_mem_offs(fb->addr_first[0] + ADDR_TEX32_FIRST) ==
+        ADDR_TEX64_FIRST;
+
+    unsigned field;
+    for (field = 0; field < 2; field++) {
+        uint32_t first = fb->addr_first[field] & TEX_MIRROR_MASK;
+        uint32_t last = fb->addr_last[field] & TEX_MIRROR_MASK;
+        if (area64) {
+            // the 64-bit area is interleaved across the two 32-bit banks
+            fb_mark_range(pages, first / 2, last / 2);
+            fb_mark_range(pages, PVR2_TEX_MEM_BANK_SIZE + first / 2,
+                          PVR2_TEX_MEM_BANK_SIZE + last / 2);
+        } else {
+            fb_mark_range(pages, first, last);
+        }
+    }
+}
+
+static bool
+fb_pages_hit(uint64_t const *pages, uint32_t first_byte, uint32_t last_byte) {
+    unsigned page_no = first_byte >> FB_PAGE_SHIFT;
+    unsigned last_page = (last_byte & TEX_MIRROR_MASK) >> FB_PAGE_SHIFT;
+    for (; page_no <= last_page; page_no++)
+        if (pages[page_no / 64] & (((uint64_t)1) << (page_no % 64)))
+            return true;
+    return false;
+}
+
+void pvr2_framebuffer_notify_read(struct pvr2 *pvr2, uint32_t addr_32bit,
+                                  unsigned n_bytes) {
+    uint32_t first_byte = addr_32bit & TEX_MIRROR_MASK;
+    uint32_t last_byte = n_bytes - 1 + first_byte;
+
+    if (!fb_pages_hit(pvr2->fb.gfx_pages, first_byte, last_byte))
+        return;
+
+    /*
+     * framebuffers in the 64-bit area are tracked by their 64-bit offsets.
+     * Only the first byte gets translated, which is exact for reads that don't
+     * cross a 32-bit word.  Anything bigger is an approximation.
+     */
+    uint32_t first_byte64 = pvr2_tex_mem_addr_32_to_64(first_byte);
+    uint32_t last_byte64 = n_bytes - 1 + first_byte64;
+
+    unsigned fb_idx;
+    struct framebuffer *fb_heap = pvr2->fb.fb_heap;
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
+        struct framebuffer *fb = fb_heap + fb_idx;
+        if (fb->flags.state != FB_STATE_GFX)
+            continue;
+
+        uint32_t first = first_byte, last = last_byte;
+        if (get_tex_mem_offs(fb->addr_first[0] + ADDR_TEX32_FIRST) ==
+            ADDR_TEX64_FIRST) {
+            first = first_byte64;
+            last = last_byte64;
+        }
+
+        if (check_overlap(first, last,
+                          fb->addr_first[0] & TEX_MIRROR_MASK,
+                          fb->addr_last[0] & TEX_MIRROR_MASK) ||
+            check_overlap(first, last,
+                          fb->addr_first[1] & TEX_MIRROR_MASK,
+                          fb->addr_last[1] & TEX_MIRROR_MASK)) {
+            sync_fb_to_tex_mem(pvr2, fb);
+            fb->flags.state = FB_STATE_VIRT_AND_GFX;
+        }
+    }
+
+    // drop the pages of anything that isn't host-only anymore
+    fb_rebuild_pages(pvr2);
+}
+
+static void fb_rebuild_pages(struct pvr2 *pvr2) {
+    memset(pvr2->fb.gfx_pages, 0, sizeof(pvr2->fb.gfx_pages));
+    memset(pvr2->fb.host_pages, 0, sizeof(pvr2->fb.host_pages));
+
+    unsigned fb_idx;
+    struct framebuffer const *fb_heap = pvr2->fb.fb_heap;
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
+        struct framebuffer const *fb = fb_heap + fb_idx;
+        if (fb->flags.state == FB_STATE_GFX)
+            fb_mark_pages(pvr2->fb.gfx_pages, fb);
+        if (fb->flags.state & FB_STATE_GFX)
+            fb_mark_pages(pvr2->fb.host_pages, fb);
+    }
+}
+
+int pvr2_framebuffer_alias_texture(struct pvr2 *pvr2,
+                                   struct pvr2_tex_meta const *meta) {
+    unsigned fb_fmt;
+    switch (meta->tex_fmt) {
+    case TEX_CTRL_PIX_FMT_RGB_565:
+        fb_fmt = FB_PIX_FMT_RGB_565;
+        break;
+    case TEX_CTRL_PIX_FMT_ARGB_1555:
+        fb_fmt = FB_PIX_FMT_ARGB_1555;
+        break;
+    default:
+        return -1;
+    }
+
+    // the PVR2 only ever writes framebuffers in scan order
+    if (meta->twiddled || meta->vq_compression || meta->mipmap)
+        return -1;
+
+    uint32_t tex_addr = meta->addr_first & TEX_MIRROR_MASK;
+    unsigned tex_w = meta->linestride;
+    unsigned tex_h = 1 << meta->h_shift;
+
+    /*
+     * the framebuffer that's about to be rendered can't be sampled from at
+     * the same time.  Those still go through texture memory.
+     */
+    uint32_t tgt_addr = get_fb_w_sof1(pvr2) & ~3;
+
+    unsigned fb_idx;
+    struct framebuffer *fb_heap = pvr2->fb.fb_heap;
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
+        struct framebuffer const *fb = fb_heap + fb_idx;
+        if (!(fb->flags.state & FB_STATE_GFX) || fb->addr_key == tgt_addr ||
+            fb->flags.stale || fb->flags.raw)
+            continue;
+
+        if (get_tex_mem_offs(fb->addr_first[0] + ADDR_TEX32_FIRST) !=
+            ADDR_TEX64_FIRST)
+            continue;
+
+        if ((fb->addr_first[0] & TEX_MIRROR_MASK) == tex_addr &&
+            fb->flags.fmt == fb_fmt &&
+            fb->tile_w == tex_w && fb->tile_h == tex_h &&
+            fb->linestride == tex_w * 2)
+            return fb->obj_handle;
+    }
+
+    return -1;
 }
@@ -24,8 +24,12 @@
 #define PVR2_FRAMEBUFFER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "mem_areas.h"
 
 struct pvr2;
+struct pvr2_tex_meta;
 
 /*
  * The framebuffer runs in the Dreamcast thread.  On vsync events, it is called
@@ -90,6 +94,22 @@ struct fb_flags {
     uint8_t state : 2;
     uint8_t fmt : 3;
     uint8_t vert_flip : 1;
+
+    // set once the framebuffer has been copied back to texture memory
+    uint8_t read_back : 1;
+
+    // set once the framebuffer has been sent to the display
+    uint8_t scanned_out : 1;
+
+    // set if the last render to this framebuffer was skipped by turbo mode
+    uint8_t stale : 1;
+
+    /*
+     * set if the gfx_obj holds the pixels in the guest's format because the
+     * gpu_fb_conv config is set.  Only ever set on framebuffers that came
+     * from texture memory.
+     */
+    uint8_t raw : 1;
 };
 
 #define FB_HEAP_SIZE 8
@@ -116,10 +136,45 @@ struct framebuffer {
 #define OGL_FB_H_MAX (0x3ff + 1)
 #define OGL_FB_BYTES (OGL_FB_W_MAX * OGL_FB_H_MAX * 4)
 
+/*
+ * The 32-bit texture memory area is divided into pages for the sake of
+ * tracking which parts of it might be covered by a framebuffer that lives on
+ * the host.  Reads and writes to pages whose bit is clear don't need to look at
+ * the fb_heap at all.  Bits only get cleared when the bitmaps are rebuilt, so
+ * there can be false positives but never false negatives.
+ */
+#define FB_PAGE_SHIFT 12
+#define FB_PAGE_COUNT ((ADDR_TEX32_LAST - ADDR_TEX32_FIRST + 1) >> FB_PAGE_SHIFT)
+#define FB_PAGE_WORDS (FB_PAGE_COUNT / 64)
+
 struct pvr2_fb {
     uint32_t ogl_fb[OGL_FB_BYTES / sizeof(uint32_t)];
     struct framebuffer fb_heap[FB_HEAP_SIZE];
     unsigned stamp;
+
+    // pages covered by a framebuffer that hasn't been copied back from the host
+    uint64_t gfx_pages[FB_PAGE_WORDS];
+
+    // pages covered by any framebuffer that has a copy on the host
+    uint64_t host_pages[FB_PAGE_WORDS];
+
+    // index into fb_heap of the last render target, or -1
+    int cur_tgt;
+
+    /*
+     * index into fb_heap of the framebuffer whose pixels ogl_fb was last
+     * converted into from texture memory, or -1 if ogl_fb has been used for
+     * anything else since then.  conv_key is the display registers it was
+     * converted with.  Texture memory writes get recorded in conv_dirty so that
+     * converting the same framebuffer again only has to redo the rows on those
+     * pages.
+     */
+    int conv_owner;
+    uint32_t conv_key[4];
+    uint64_t conv_dirty[FB_PAGE_WORDS];
+
+    // set while a conversion is only redoing the rows on conv_dirty pages
+    bool conv_partial;
 };
 
 void pvr2_framebuffer_init(struct pvr2 *pvr2);
@@ -127,12 +182,36 @@ void pvr2_framebuffer_cleanup(struct pvr2 *pvr2);
 
 void framebuffer_render(struct pvr2 *pvr2);
 
+/*
+ * CRC32 of the rows of texture memory that the display is currently scanning
+ * out (both fields if interlaced).  Frames which only exist on the host get
+ * written back to texture memory first.  Returns 0 if the framebuffer is
+ * disabled.
+ */
+uint32_t framebuffer_hash(struct pvr2 *pvr2);
+
 // old deprecated function that should not be called anymore
 static inline void framebuffer_sync_from_host_maybe(void) {
 }
 
 int framebuffer_set_render_target(struct pvr2 *pvr2);
 
+/*
+ * returns true if the next render target is a framebuffer that has only ever
+ * been sent to the display, so nothing the guest can see depends on its
+ * contents.  That makes it safe for turbo mode to skip rendering it.
+ */
+bool framebuffer_render_skippable(struct pvr2 *pvr2);
+
+/*
+ * call this instead of rendering to the target from
+ * framebuffer_set_render_target when the render is skipped.
+ */
+void framebuffer_skip_render(struct pvr2 *pvr2);
+
+// call this after the render target from framebuffer_set_render_target is done
+void framebuffer_end_render(struct pvr2 *pvr2);
+
 void framebuffer_get_render_target_dims(struct pvr2 *pvr2, int tgt,
                                         unsigned *width, unsigned *height);
 
@@ -142,4 +221,21 @@ void pvr2_framebuffer_notify_write(struct pvr2 *pvr2, uint32_t addr,
 void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
                                      uint32_t last_tex_addr);
 
+/*
+ * called before the CPU reads from the 32-bit texture memory area.  Any
+ * framebuffer that's only on the host and overlaps the read gets copied back
+ * to texture memory first.
+ */
+void pvr2_framebuffer_notify_read(struct pvr2 *pvr2, uint32_t addr_32bit,
+                                  unsigned n_bytes);
+
+/*
+ * If the given texture exactly matches a framebuffer that is current on the
+ * host, return that framebuffer's gfx_obj so it can be bound as the texture
+ * directly.  Otherwise return -1.  This does not sync anything back to texture
+ * memory.
+ */
+int pvr2_framebuffer_alias_texture(struct pvr2 *pvr2,
+                                   struct pvr2_tex_meta const *meta);
+
 #endif
@@ -36,6 +36,7 @@ void pvr2_init(struct pvr2 *pvr2, struct dc_clock *clk, struct maple *maple) {
     memset(pvr2, 0, sizeof(*pvr2));
 
     pvr2->clk = clk;
+    pvr2_tex_mem_init(pvr2);
     pvr2_reg_init(pvr2);
     spg_init(pvr2, maple);
     pvr2_tex_cache_init(pvr2);
@@ -53,4 +54,5 @@ void pvr2_cleanup(struct pvr2 *pvr2) {
     pvr2_tex_cache_cleanup(pvr2);
     spg_cleanup(pvr2);
     pvr2_reg_cleanup(pvr2);
+    pvr2_tex_mem_cleanup(pvr2);
 }
@@ -41,6 +41,15 @@ struct pvr2_stat {
     // performance counters that get reset on a per-frame basis
     struct {
         unsigned vert_count[PVR2_POLY_TYPE_COUNT];
+
+        // polygon headers that didn't change the render state
+        unsigned dup_rend_param_count;
+
+        // draws that got merged into the draw before them
+        unsigned merged_draw_count;
+
+        // texture binds that sampled a host framebuffer directly
+        unsigned fb_tex_alias_count;
     } per_frame_counters;
 
     // performance counters that don't get reset ever
@@ -77,15 +86,29 @@ struct pvr2_stat {
         unsigned fresh_texture_upload_count;
 
         /*
-         * number of times a texture got kicked out of the cache because it got
-         * invalidated but it wasn't immediately needed so we just ignored it.
+         * number of times a texture got kicked out of the cache while it was
+         * still dirty, meaning it got invalidated and then never bound again
+         * so it was never re-decoded.
          *
-         * For the sake of simplicity, this counter is included in the
-         * tex_xmit_count even though it probably shouldn't since the texture
-         * doesn't get transmitted.  It also overlaps with tex_invalidate_count
-         * since that's generally how textures end up in this situation.
+         * This overlaps with texture_overwrite_count and
+         * tex_invalidate_count since that's generally how textures end up in
+         * this situation.
          */
         unsigned tex_eviction_count;
+
+        /*
+         * overwrites of textures which were used in the previous frame.  If
+         * this keeps going up then the cache is too small for what the game
+         * is drawing.
+         */
+        unsigned tex_thrash_count;
+
+        // lookups in pvr2_tex_cache_find that did/didn't find a texture
+        unsigned tex_cache_hit_count;
+        unsigned tex_cache_miss_count;
+
+        // frames that sent the previous frame's gfx_il stream again
+        unsigned list_cache_hit_count;
     } persistent_counters;
 };
 
@@ -22,6 +22,9 @@
 
 #include <limits.h>
 #include <math.h>
+#include <string.h>
+
+#include <zlib.h>
 
 #include "pvr2_core.h"
 #include "pvr2.h"
@@ -29,9 +32,13 @@
 #include "washdc/error.h"
 #include "log.h"
 #include "intmath.h"
+#include "config.h"
+#include "dreamcast.h"
 #include "hw/sys/holly_intc.h"
+#include "threading.h"
 
-#define PVR2_GFX_IL_INST_BUF_LEN (1024 * 256)
+// initial capacity of a gfx_il stream; it doubles whenever it runs out
+#define PVR2_GFX_IL_INST_CHUNK (1024 * 4)
 
 #define ISP_BACKGND_T_ADDR_SHIFT 1
 #define ISP_BACKGND_T_ADDR_MASK (0x7ffffc << ISP_BACKGND_T_ADDR_SHIFT)
@@ -57,56 +64,123 @@ static DEF_ERROR_INT_ATTR(src_blend_factor);
 static DEF_ERROR_INT_ATTR(dst_blend_factor);
 
 static void
-display_list_exec_header(struct pvr2 *pvr2,
+display_list_exec_group(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                        struct pvr2_display_list const *listp,
+                        unsigned group_no, int32_t const *group_tex);
+static void
+display_list_exec_sorted(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                         struct pvr2_display_list const *listp,
+                         struct pvr2_display_list_group const *group,
+                         int32_t const *group_tex);
+static bool
+display_list_exec_parallel(struct pvr2 *pvr2,
+                           struct pvr2_display_list const *listp);
+static int32_t
+display_list_bind_tex(struct pvr2 *pvr2,
+                      struct pvr2_display_list_command const *cmd);
+static void
+display_list_exec_header(struct pvr2 *pvr2, struct pvr2_il_buf *il,
                          struct pvr2_display_list_command const *cmd,
-                         bool punch_through, bool blend_enable);
+                         bool punch_through, bool blend_enable, int32_t tex);
 static void
-display_list_exec_quad(struct pvr2 *pvr2,
+display_list_exec_quad(struct pvr2 *pvr2, struct pvr2_il_buf *il,
                        struct pvr2_display_list_command const *cmd);
 
 static void
-display_list_exec_user_clip(struct pvr2 *pvr2,
+display_list_exec_user_clip(struct pvr2_il_buf *il,
                             struct pvr2_display_list_command const *cmd);
 static void
-display_list_exec_tri_strip(struct pvr2 *pvr2,
+display_list_exec_tri_strip(struct pvr2 *pvr2, struct pvr2_il_buf *il,
                             struct pvr2_display_list_command const *cmd);
+static void
+display_list_exec_mod_vol(struct pvr2_il_buf *il,
+                          struct pvr2_display_list_command const *cmd);
+static bool display_list_skip_group(struct pvr2 const *pvr2, unsigned group_no);
+
+static inline void
+pvr2_core_push_gfx_il(struct pvr2_il_buf *il, struct gfx_il_inst inst);
 
 static inline void
-pvr2_core_push_gfx_il(struct pvr2 *pvr2, struct gfx_il_inst inst);
+pvr2_core_emit_gfx_il(struct pvr2_il_buf *il, struct gfx_il_inst const *inst);
+
+static void
+pvr2_core_push_draw(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                    unsigned first_vtx, unsigned n_verts);
+
+static void pvr2_core_flush_draws(struct pvr2_il_buf *il);
+
+static void pvr2_il_buf_reset(struct pvr2_il_buf *il);
+static void pvr2_il_buf_cleanup(struct pvr2_il_buf *il);
+
+static void pvr2_list_workers_init(struct pvr2 *pvr2);
+static void pvr2_list_workers_cleanup(struct pvr2 *pvr2);
+
+static bool rend_param_eq(struct gfx_rend_param const *lhs,
+                          struct gfx_rend_param const *rhs);
 
 static void render_frame_init(struct pvr2 *pvr2);
+static void
+prep_display_list(struct pvr2 *pvr2, struct pvr2_display_list const *listp);
 
 void pvr2_core_init(struct pvr2 *pvr2) {
     struct pvr2_core *core = &pvr2->core;
 
     core->pvr2_render_complete_int_event.handler =
         pvr2_render_complete_int_event_handler;
+    core->pvr2_render_complete_int_event.name =
+        "pvr2_render_complete_int_event_handler";
     core->pvr2_render_complete_int_event.arg_ptr = pvr2;
+    sched_event_register(&core->pvr2_render_complete_int_event,
+                         "pvr2_render_complete_int");
+
+    core->vert_fmt = config_get_packed_verts() ?
+        GFX_VERT_FMT_PACKED : GFX_VERT_FMT_FLOAT;
+    size_t vert_array_len =
+        PVR2_DISPLAY_LIST_MAX_VERTS * GFX_VERT_SIZE(core->vert_fmt);
+
+    bool persistent_verts = config_get_persistent_verts() &&
+        gfx_vert_bufs_init(PVR2_MAX_FRAMES_IN_FLIGHT + PVR2_SPARE_VERT_BUFS,
+                           vert_array_len);
 
     int list_idx;
     for (list_idx = 0; list_idx < PVR2_MAX_FRAMES_IN_FLIGHT; list_idx++) {
         struct pvr2_display_list *disp_list = core->disp_lists + list_idx;
         int group_idx;
 
-        disp_list->vert_array = malloc(PVR2_DISPLAY_LIST_MAX_VERTS *
-                                       sizeof(float) * GFX_VERT_LEN);
-        if (!disp_list->vert_array)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        if (persistent_verts) {
+            unsigned buf_no;
+            disp_list->vert_array = gfx_vert_buf_acquire(&buf_no);
+            disp_list->vert_buf_no = buf_no;
+            disp_list->vert_cap = PVR2_DISPLAY_LIST_MAX_VERTS;
+        } else {
+            // this gets allocated the first time the TA needs it
+            disp_list->vert_array = NULL;
+            disp_list->vert_buf_no = -1;
+            disp_list->vert_cap = 0;
+        }
+        disp_list->verts_submitted = false;
 
         for (group_idx = 0; group_idx < PVR2_POLY_TYPE_COUNT; group_idx++) {
-            disp_list->poly_groups[group_idx].cmds =
-                malloc(sizeof(struct pvr2_display_list_command) *
-                       PVR2_DISPLAY_LIST_MAX_LEN);
+            disp_list->poly_groups[group_idx].cmds = NULL;
+            disp_list->poly_groups[group_idx].cmd_cap = 0;
         }
         pvr2_display_list_init(disp_list);
     }
 
     core->disp_list_counter = 0;
 
-    core->gfx_il_inst_buf = (struct gfx_il_inst*)malloc(PVR2_GFX_IL_INST_BUF_LEN *
-                                                        sizeof(struct gfx_il_inst));
-    if (!core->gfx_il_inst_buf)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    memset(&core->il, 0, sizeof(core->il));
+
+    core->list_cache = config_get_list_cache();
+    core->cache_valid = false;
+
+    core->mod_vols = config_get_mod_vols();
+    core->merge_draws = config_get_merge_draws();
+    core->poly_sort = config_get_poly_sort();
+
+    core->workers = NULL;
+    if (config_get_list_exec_threads())
+        pvr2_list_workers_init(pvr2);
 
     render_frame_init(pvr2);
     core->pt_alpha_ref = 0xff;
@@ -115,8 +189,8 @@ void pvr2_core_init(struct pvr2 *pvr2) {
 void pvr2_core_cleanup(struct pvr2 *pvr2) {
     struct pvr2_core *core = &pvr2->core;
 
-    free(core->gfx_il_inst_buf);
-    core->gfx_il_inst_buf = NULL;
+    pvr2_list_workers_cleanup(pvr2);
+    pvr2_il_buf_cleanup(&core->il);
 
     int list_idx;
     for (list_idx = 0; list_idx < PVR2_MAX_FRAMES_IN_FLIGHT; list_idx++) {
@@ -124,30 +198,106 @@ void pvr2_core_cleanup(struct pvr2 *pvr2) {
         int group_idx;
         for (group_idx = 0; group_idx < PVR2_POLY_TYPE_COUNT; group_idx++)
             free(disp_list->poly_groups[group_idx].cmds);
-        free(disp_list->vert_array);
+        if (disp_list->vert_buf_no >= 0)
+            gfx_vert_buf_release(disp_list->vert_buf_no);
+        else
+            free(disp_list->vert_array);
+        disp_list->vert_array = NULL;
     }
+
+    gfx_vert_bufs_cleanup();
 }
 
 static void render_frame_init(struct pvr2 *pvr2) {
-    // free up gfx_il commands
-    pvr2->core.gfx_il_inst_buf_count = 0;
-
     memset(&pvr2->stat.per_frame_counters, 0,
            sizeof(pvr2->stat.per_frame_counters));
 }
 
 void pvr2_display_list_init(struct pvr2_display_list *list) {
+    if (list->vert_buf_no >= 0 && list->verts_submitted) {
+        /*
+         * the GPU might still be reading the old vertices, so the new ones go
+         * into a different buffer.
+         */
+        unsigned buf_no;
+        gfx_vert_buf_release(list->vert_buf_no);
+        list->vert_array = gfx_vert_buf_acquire(&buf_no);
+        list->vert_buf_no = buf_no;
+    }
+    list->verts_submitted = false;
+
     list->valid = false;
     unsigned idx;
     for (idx = 0; idx < PVR2_POLY_TYPE_COUNT; idx++) {
         struct pvr2_display_list_group *group = list->poly_groups + idx;
         group->valid = false;
         group->n_cmds = 0;
+        group->n_cmds_hashed = 0;
     }
 
     list->n_verts = 0;
     list->clip_min = 0.0f;
     list->clip_max = 0.0f;
+
+    list->hash = crc32(0, Z_NULL, 0);
+    list->n_verts_hashed = 0;
+}
+
+bool pvr2_display_list_grow_verts(struct pvr2 *pvr2,
+                                  struct pvr2_display_list *list,
+                                  unsigned n_verts) {
+    if (list->vert_buf_no >= 0 ||
+        n_verts > UINT_MAX / 2 - list->n_verts)
+        return false;
+
+    unsigned want = list->n_verts + n_verts;
+    unsigned cap = list->vert_cap ?
+        list->vert_cap : PVR2_DISPLAY_LIST_VERT_CHUNK;
+    while (cap < want)
+        cap *= 2;
+
+    size_t n_bytes = cap * GFX_VERT_SIZE(pvr2->core.vert_fmt);
+    float *vert_array = (float*)realloc(list->vert_array, n_bytes);
+    if (!vert_array)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    list->vert_array = vert_array;
+    list->vert_cap = cap;
+    return true;
+}
+
+void pvr2_display_list_hash_group(struct pvr2 *pvr2,
+                                  struct pvr2_display_list *listp,
+                                  enum pvr2_poly_type poly_tp) {
+    if (!pvr2->core.list_cache)
+        return;
+
+    if (poly_tp >= PVR2_POLY_TYPE_COUNT || poly_tp < 0)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    struct pvr2_display_list_group *group = listp->poly_groups + poly_tp;
+    size_t vert_len = GFX_VERT_SIZE(pvr2->core.vert_fmt);
+    uint32_t group_no = poly_tp;
+    uLong crc = listp->hash;
+
+    /*
+     * cmds and vert_array can still be NULL here, and crc32 treats a NULL
+     * buffer as a request for the initial value.
+     */
+    crc = crc32(crc, (Bytef const*)&group_no, sizeof(group_no));
+    if (group->n_cmds > group->n_cmds_hashed) {
+        crc = crc32(crc, (Bytef const*)(group->cmds + group->n_cmds_hashed),
+                    (group->n_cmds - group->n_cmds_hashed) *
+                    sizeof(struct pvr2_display_list_command));
+    }
+    if (listp->n_verts > listp->n_verts_hashed) {
+        crc = crc32(crc, (Bytef const*)listp->vert_array +
+                    vert_len * listp->n_verts_hashed,
+                    (listp->n_verts - listp->n_verts_hashed) * vert_len);
+    }
+
+    listp->hash = crc;
+    group->n_cmds_hashed = group->n_cmds;
+    listp->n_verts_hashed = listp->n_verts;
 }
 
 struct pvr2_display_list_command *
@@ -159,14 +309,23 @@ pvr2_list_alloc_new_cmd(struct pvr2_display_list *listp,
     struct pvr2_display_list_group *group = listp->poly_groups + poly_tp;
     group->valid = true;
 
-    if (group->n_cmds >= PVR2_DISPLAY_LIST_MAX_LEN) {
-        // TODO: come up with a better solution than hardcoding a buffer length
-        // ie some sort of pool/zone allocator might be a good idea
-        LOG_ERROR("command capacity exceeded for display list!\n");
-        return NULL;
+    if (group->n_cmds >= group->cmd_cap) {
+        unsigned cap = group->cmd_cap ?
+            2 * group->cmd_cap : PVR2_DISPLAY_LIST_CMD_CHUNK;
+        struct pvr2_display_list_command *cmds =
+            (struct pvr2_display_list_command*)
+            realloc(group->cmds,
+                    cap * sizeof(struct pvr2_display_list_command));
+        if (!cmds)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        group->cmds = cmds;
+        group->cmd_cap = cap;
     }
 
-    return group->cmds + group->n_cmds++;
+    // zeroed so that union padding doesn't end up in the list's hash
+    struct pvr2_display_list_command *cmd = group->cmds + group->n_cmds++;
+    memset(cmd, 0, sizeof(*cmd));
+    return cmd;
 }
 
 unsigned pvr2_list_age(struct pvr2 const *pvr2,
@@ -240,134 +399,409 @@ void pvr2_inc_age_counter(struct pvr2 *pvr2) {
 
 void
 display_list_exec(struct pvr2 *pvr2, struct pvr2_display_list const *listp) {
+    struct pvr2_core *core = &pvr2->core;
     unsigned group_no;
 
+    if (core->workers && display_list_exec_parallel(pvr2, listp))
+        return;
+
     for (group_no = PVR2_POLY_TYPE_OPAQUE;
          group_no <= PVR2_POLY_TYPE_PUNCH_THROUGH; group_no++) {
 
-        // TODO: implement modifier volumes
-        if (group_no == PVR2_POLY_TYPE_OPAQUE_MOD ||
-            group_no == PVR2_POLY_TYPE_TRANS_MOD)
+        if (display_list_skip_group(pvr2, group_no))
             continue;
 
-        struct pvr2_display_list_group const *group =
-            listp->poly_groups + group_no;
-
-        if (!group->valid)
+        if (!listp->poly_groups[group_no].valid)
             continue;
 
-        pvr2->core.cur_poly_group = group_no;
+        core->cur_poly_group = group_no;
+        display_list_exec_group(pvr2, &core->il, listp, group_no, NULL);
+    }
+}
 
-        bool sort_mode = false;
-        if ((group_no == PVR2_POLY_TYPE_TRANS) &&
-            !(pvr2->reg_backing[PVR2_ISP_FEED_CFG] & 1)) {
-            /*
-             * order-independent transparency is enabled when bit 0 of
-             * ISP_FEED_CFG is 0.
-             */
-            sort_mode = true;
-            struct gfx_il_inst gfx_cmd;
-            gfx_cmd.op = GFX_IL_BEGIN_DEPTH_SORT;
-            pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+/*
+ * translucent modifier volumes aren't implemented, and opaque ones only get
+ * drawn if the mod_vols config option is set.
+ */
+static bool display_list_skip_group(struct pvr2 const *pvr2, unsigned group_no) {
+    if (group_no == PVR2_POLY_TYPE_TRANS_MOD)
+        return true; // TODO: implement translucent modifier volumes
+    if (group_no != PVR2_POLY_TYPE_OPAQUE_MOD)
+        return false;
+    if (!pvr2->core.mod_vols)
+        return true;
+
+    /*
+     * bit 8 of FPU_SHAD_SCALE selects cheap shadows.  Otherwise the volumes
+     * pick between the two sets of parameters of two-volumes mode polygons.
+     */
+    if (!(pvr2->reg_backing[PVR2_FPU_SHAD_SCALE] & (1 << 8))) {
+        LOG_DBG("Unimplemented parameter selection modifier volumes!\n");
+        return true;
+    }
+    return false;
+}
+
+static void
+display_list_exec_group(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                        struct pvr2_display_list const *listp,
+                        unsigned group_no, int32_t const *group_tex) {
+    struct pvr2_display_list_group const *group = listp->poly_groups + group_no;
+
+    // sort mode and group transitions can clobber the renderer's state
+    il->last_rend_param_valid = false;
+    il->last_blend_enable_valid = false;
+
+    bool sort_mode = false;
+    if ((group_no == PVR2_POLY_TYPE_TRANS) &&
+        !(pvr2->reg_backing[PVR2_ISP_FEED_CFG] & 1)) {
+        /*
+         * order-independent transparency is enabled when bit 0 of
+         * ISP_FEED_CFG is 0.
+         */
+        if (pvr2->core.poly_sort) {
+            display_list_exec_sorted(pvr2, il, listp, group, group_tex);
+            return;
         }
 
-        unsigned cmd_no;
-        unsigned n_cmds = group->n_cmds;
-        bool punch_through = (group_no == PVR2_POLY_TYPE_PUNCH_THROUGH);
-        bool blend_enable = (group_no == PVR2_POLY_TYPE_TRANS);
-
-        for (cmd_no = 0; cmd_no < n_cmds; cmd_no++) {
-            struct pvr2_display_list_command const *cmd = group->cmds + cmd_no;
-            switch (cmd->tp) {
-            case PVR2_DISPLAY_LIST_COMMAND_TP_HEADER:
-                display_list_exec_header(pvr2, cmd, punch_through, blend_enable);
-                break;
-            case PVR2_DISPLAY_LIST_COMMAND_TP_QUAD:
-                display_list_exec_quad(pvr2, cmd);
-                break;
-            case PVR2_DISPLAY_LIST_COMMAND_TP_USER_CLIP:
-                display_list_exec_user_clip(pvr2, cmd);
-                break;
-            case PVR2_DISPLAY_LIST_COMMAND_TP_TRI_STRIP:
-                display_list_exec_tri_strip(pvr2, cmd);
-                break;
-            default:
-                RAISE_ERROR(ERROR_UNIMPLEMENTED);
-            }
+        sort_mode = true;
+        struct gfx_il_inst gfx_cmd;
+        gfx_cmd.op = GFX_IL_BEGIN_DEPTH_SORT;
+        pvr2_core_push_gfx_il(il, gfx_cmd);
+    }
+
+    unsigned cmd_no;
+    unsigned n_cmds = group->n_cmds;
+    bool punch_through = (group_no == PVR2_POLY_TYPE_PUNCH_THROUGH);
+    bool blend_enable = (group_no == PVR2_POLY_TYPE_TRANS);
+
+    for (cmd_no = 0; cmd_no < n_cmds; cmd_no++) {
+        struct pvr2_display_list_command const *cmd = group->cmds + cmd_no;
+        switch (cmd->tp) {
+        case PVR2_DISPLAY_LIST_COMMAND_TP_HEADER:
+            display_list_exec_header(pvr2, il, cmd, punch_through,
+                                     blend_enable,
+                                     group_tex ? group_tex[cmd_no] :
+                                     display_list_bind_tex(pvr2, cmd));
+            break;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_QUAD:
+            display_list_exec_quad(pvr2, il, cmd);
+            break;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_USER_CLIP:
+            display_list_exec_user_clip(il, cmd);
+            break;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_TRI_STRIP:
+            display_list_exec_tri_strip(pvr2, il, cmd);
+            break;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_MOD_VOL:
+            display_list_exec_mod_vol(il, cmd);
+            break;
+        default:
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
+        }
+    }
+
+    pvr2_core_flush_draws(il);
+
+    if (group_no == PVR2_POLY_TYPE_OPAQUE_MOD) {
+        // shadowed pixels get scaled by the low 8 bits of FPU_SHAD_SCALE
+        struct gfx_il_inst gfx_cmd;
+        gfx_cmd.op = GFX_IL_APPLY_MOD_VOL;
+        gfx_cmd.arg.apply_mod_vol.scale =
+            (pvr2->reg_backing[PVR2_FPU_SHAD_SCALE] & 0xff) / 256.0f;
+        pvr2_core_emit_gfx_il(il, &gfx_cmd);
+    }
+
+    if (sort_mode) {
+        struct gfx_il_inst gfx_cmd;
+        gfx_cmd.op = GFX_IL_END_DEPTH_SORT;
+        pvr2_core_push_gfx_il(il, gfx_cmd);
+    }
+}
+
+// make room for at least n_polys polygons in il's sort scratch space
+static void pvr2_il_buf_reserve_sort(struct pvr2_il_buf *il, unsigned n_polys) {
+    if (n_polys <= il->sort_cap)
+        return;
+
+    unsigned cap = il->sort_cap ? il->sort_cap : 1024;
+    while (cap < n_polys)
+        cap *= 2;
+
+    struct pvr2_sort_poly *polys = (struct pvr2_sort_poly*)
+        realloc(il->sort_polys, cap * sizeof(struct pvr2_sort_poly));
+    if (!polys)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    il->sort_polys = polys;
+
+    uint64_t *keys = (uint64_t*)realloc(il->sort_keys,
+                                        2 * cap * sizeof(uint64_t));
+    if (!keys)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    il->sort_keys = keys;
+
+    il->sort_cap = cap;
+}
+
+/*
+ * map a float onto a 32-bit integer which sorts in the opposite order, so
+ * that an ascending sort puts the largest floats first.
+ */
+static inline uint32_t sort_key_from_float(float val) {
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    bits = (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+    return ~bits;
+}
+
+/*
+ * stable LSD radix sort on the upper 32 bits of each key, one byte at a time.
+ * tmp has to have room for n_keys entries.  Returns whichever of keys or tmp
+ * the sorted keys ended up in.
+ */
+static uint64_t *
+pvr2_radix_sort_keys(uint64_t *keys, uint64_t *tmp, unsigned n_keys) {
+    unsigned hist[4][256];
+    unsigned key_no, pass;
+
+    memset(hist, 0, sizeof(hist));
+    for (key_no = 0; key_no < n_keys; key_no++) {
+        uint32_t key = keys[key_no] >> 32;
+        hist[0][key & 0xff]++;
+        hist[1][(key >> 8) & 0xff]++;
+        hist[2][(key >> 16) & 0xff]++;
+        hist[3][key >> 24]++;
+    }
+
+    for (pass = 0; pass < 4; pass++) {
+        unsigned shift = 32 + 8 * pass;
+        unsigned *counts = hist[pass];
+
+        // every key has the same byte here, so this pass wouldn't move anything
+        if (counts[(keys[0] >> shift) & 0xff] == n_keys)
+            continue;
+
+        unsigned bucket, offs = 0;
+        for (bucket = 0; bucket < 256; bucket++) {
+            unsigned count = counts[bucket];
+            counts[bucket] = offs;
+            offs += count;
         }
 
-        if (sort_mode) {
-            struct gfx_il_inst gfx_cmd;
-            gfx_cmd.op = GFX_IL_END_DEPTH_SORT;
-            pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+        for (key_no = 0; key_no < n_keys; key_no++) {
+            uint64_t key = keys[key_no];
+            tmp[counts[(key >> shift) & 0xff]++] = key;
         }
+
+        uint64_t *swap = keys;
+        keys = tmp;
+        tmp = swap;
     }
+
+    return keys;
 }
 
+/*
+ * draw a translucent polygon group back-to-front (see the poly_sort config
+ * option).  Each polygon's depth is the mean of 1/z over its vertices, which
+ * is the same thing gfxgl3 used to sort by.  Polygons at the same depth stay
+ * in the order they were submitted.
+ */
 static void
-display_list_exec_header(struct pvr2 *pvr2,
-                         struct pvr2_display_list_command const *cmd,
-                         bool punch_through, bool blend_enable) {
+display_list_exec_sorted(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                         struct pvr2_display_list const *listp,
+                         struct pvr2_display_list_group const *group,
+                         int32_t const *group_tex) {
+    unsigned cmd_no, n_cmds = group->n_cmds;
+    unsigned n_polys = 0;
+    unsigned hdr_cmd = UINT_MAX, clip_cmd = UINT_MAX;
+    int32_t tex = -1;
+    size_t vert_stride = GFX_VERT_SIZE(pvr2->core.vert_fmt) / sizeof(float);
+    float const *pos = listp->vert_array + GFX_VERT_POS_OFFSET;
+
+    pvr2_il_buf_reserve_sort(il, n_cmds);
+
+    for (cmd_no = 0; cmd_no < n_cmds; cmd_no++) {
+        struct pvr2_display_list_command const *cmd = group->cmds + cmd_no;
+        unsigned first_vtx, n_verts;
+        switch (cmd->tp) {
+        case PVR2_DISPLAY_LIST_COMMAND_TP_HEADER:
+            hdr_cmd = cmd_no;
+            tex = group_tex ? group_tex[cmd_no] :
+                display_list_bind_tex(pvr2, cmd);
+            continue;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_USER_CLIP:
+            clip_cmd = cmd_no;
+            continue;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_QUAD:
+            first_vtx = cmd->quad.first_vtx;
+            n_verts = 4;
+            break;
+        case PVR2_DISPLAY_LIST_COMMAND_TP_TRI_STRIP:
+            first_vtx = cmd->strip.first_vtx;
+            n_verts = cmd->strip.vtx_count;
+            break;
+        default:
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
+        }
+
+        if (!n_verts)
+            continue;
+
+        float depth = 0.0f;
+        unsigned vert_no;
+        for (vert_no = first_vtx; vert_no < first_vtx + n_verts; vert_no++)
+            depth += 1.0f / pos[vert_no * vert_stride + 2];
+        depth /= n_verts;
+
+        struct pvr2_sort_poly *poly = il->sort_polys + n_polys;
+        poly->first_vtx = first_vtx;
+        poly->n_verts = n_verts;
+        poly->hdr_cmd = hdr_cmd;
+        poly->clip_cmd = clip_cmd;
+        poly->tex = tex;
+        il->sort_keys[n_polys] =
+            ((uint64_t)sort_key_from_float(depth) << 32) | n_polys;
+        n_polys++;
+    }
+
+    if (!n_polys)
+        return;
+
+    uint64_t const *sorted =
+        pvr2_radix_sort_keys(il->sort_keys, il->sort_keys + il->sort_cap,
+                             n_polys);
+
+    unsigned poly_no;
+    hdr_cmd = UINT_MAX;
+    clip_cmd = UINT_MAX;
+    for (poly_no = 0; poly_no < n_polys; poly_no++) {
+        struct pvr2_sort_poly const *poly =
+            il->sort_polys + (uint32_t)sorted[poly_no];
+
+        /*
+         * exec_header drops headers that don't change anything, so polygons
+         * with the same render state still end up next to each other.
+         */
+        if (poly->hdr_cmd != hdr_cmd && poly->hdr_cmd != UINT_MAX) {
+            display_list_exec_header(pvr2, il, group->cmds + poly->hdr_cmd,
+                                     false, true, poly->tex);
+        }
+        hdr_cmd = poly->hdr_cmd;
+
+        /*
+         * there's no way to go back to the clip rectangle from before the
+         * group, so polygons ahead of the group's first user clip command
+         * just keep whichever one is current.
+         */
+        if (poly->clip_cmd != clip_cmd && poly->clip_cmd != UINT_MAX)
+            display_list_exec_user_clip(il, group->cmds + poly->clip_cmd);
+        clip_cmd = poly->clip_cmd;
+
+        pvr2_core_push_draw(pvr2, il, poly->first_vtx, poly->n_verts);
+    }
+
+    pvr2_core_flush_draws(il);
+}
+
+/*
+ * look up and bind the texture for a polygon header.  Returns -1 if the
+ * polygon is untextured, or else the texture's index shifted left by one and
+ * ORed with 1 if the texture aliases a framebuffer.
+ *
+ * This touches the texture cache and sends gfx_il of its own, so it always
+ * happens on the emulation thread.
+ */
+static int32_t
+display_list_bind_tex(struct pvr2 *pvr2,
+                      struct pvr2_display_list_command const *cmd) {
     struct pvr2_core *core = &pvr2->core;
     struct pvr2_display_list_command_header const *cmd_hdr = &cmd->hdr;
-    struct gfx_il_inst gfx_cmd;
 
-    if (cmd_hdr->tex_enable) {
-        PVR2_TRACE("texture enabled\n");
-        PVR2_TRACE("the texture format is %d\n", (int)cmd_hdr->pix_fmt);
-        PVR2_TRACE("The texture address ix 0x%08x\n", cmd_hdr->tex_addr);
+    core->stride_sel = cmd_hdr->stride_sel;
+    core->tex_width_shift = cmd_hdr->tex_width_shift;
+    core->tex_height_shift = cmd_hdr->tex_height_shift;
+
+    if (!cmd_hdr->tex_enable)
+        return -1;
+
+    PVR2_TRACE("texture enabled\n");
+    PVR2_TRACE("the texture format is %d\n", (int)cmd_hdr->pix_fmt);
+    PVR2_TRACE("The texture address ix 0x%08x\n", cmd_hdr->tex_addr);
+
+    if (cmd_hdr->tex_twiddle)
+        PVR2_TRACE("not twiddled\n");
+    else
+        PVR2_TRACE("twiddled\n");
+
+    unsigned linestride = cmd_hdr->stride_sel ?
+        32 * (pvr2->reg_backing[PVR2_TEXT_CONTROL] & BIT_RANGE(0, 4)) :
+        (1 << cmd_hdr->tex_width_shift);
+    if (!linestride || linestride > (1 << cmd_hdr->tex_width_shift))
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+
+    struct pvr2_tex *ent =
+        pvr2_tex_cache_find(pvr2, cmd_hdr->tex_addr, cmd_hdr->tex_palette_start,
+                            cmd_hdr->tex_width_shift,
+                            cmd_hdr->tex_height_shift,
+                            linestride,
+                            cmd_hdr->pix_fmt, cmd_hdr->tex_twiddle,
+                            cmd_hdr->tex_vq_compression,
+                            cmd_hdr->tex_mipmap,
+                            cmd_hdr->stride_sel);
+
+    PVR2_TRACE("texture dimensions are (%u, %u)\n",
+               1 << cmd_hdr->tex_width_shift,
+               1 << cmd_hdr->tex_height_shift);
+    if (ent) {
+        PVR2_TRACE("Texture 0x%08x found in cache\n",
+                   cmd_hdr->tex_addr);
+    } else {
+        PVR2_TRACE("Adding 0x%08x to texture cache...\n",
+                   cmd_hdr->tex_addr);
+        ent = pvr2_tex_cache_add(pvr2,
+                                 cmd_hdr->tex_addr, cmd_hdr->tex_palette_start,
+                                 cmd_hdr->tex_width_shift,
+                                 cmd_hdr->tex_height_shift,
+                                 linestride,
+                                 cmd_hdr->pix_fmt,
+                                 cmd_hdr->tex_twiddle,
+                                 cmd_hdr->tex_vq_compression,
+                                 cmd_hdr->tex_mipmap,
+                                 cmd_hdr->stride_sel);
+    }
 
-        if (cmd_hdr->tex_twiddle)
-            PVR2_TRACE("not twiddled\n");
-        else
-            PVR2_TRACE("twiddled\n");
+    if (!ent) {
+        LOG_WARN("WARNING: failed to add texture 0x%08x to "
+                 "the texture cache\n", cmd_hdr->tex_addr);
+        core->cache_taint = true;
+        return -1;
+    }
 
-        unsigned linestride = cmd_hdr->stride_sel ?
-            32 * (pvr2->reg_backing[PVR2_TEXT_CONTROL] & BIT_RANGE(0, 4)) :
-            (1 << cmd_hdr->tex_width_shift);
-        if (!linestride || linestride > (1 << cmd_hdr->tex_width_shift))
-            RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    pvr2_tex_cache_bind(pvr2, ent);
+    bool tex_alias = ent->alias_obj >= 0;
 
-        struct pvr2_tex *ent =
-            pvr2_tex_cache_find(pvr2, cmd_hdr->tex_addr, cmd_hdr->tex_palette_start,
-                                cmd_hdr->tex_width_shift,
-                                cmd_hdr->tex_height_shift,
-                                linestride,
-                                cmd_hdr->pix_fmt, cmd_hdr->tex_twiddle,
-                                cmd_hdr->tex_vq_compression,
-                                cmd_hdr->tex_mipmap,
-                                cmd_hdr->stride_sel);
-
-        PVR2_TRACE("texture dimensions are (%u, %u)\n",
-                   1 << cmd_hdr->tex_width_shift,
-                   1 << cmd_hdr->tex_height_shift);
-        if (ent) {
-            PVR2_TRACE("Texture 0x%08x found in cache\n",
-                       cmd_hdr->tex_addr);
-        } else {
-            PVR2_TRACE("Adding 0x%08x to texture cache...\n",
-                       cmd_hdr->tex_addr);
-            ent = pvr2_tex_cache_add(pvr2,
-                                     cmd_hdr->tex_addr, cmd_hdr->tex_palette_start,
-                                     cmd_hdr->tex_width_shift,
-                                     cmd_hdr->tex_height_shift,
-                                     linestride,
-                                     cmd_hdr->pix_fmt,
-                                     cmd_hdr->tex_twiddle,
-                                     cmd_hdr->tex_vq_compression,
-                                     cmd_hdr->tex_mipmap,
-                                     cmd_hdr->stride_sel);
-        }
+    unsigned slot = ent - pvr2->tex_cache.tex_cache;
+    core->cache_tex[slot / 64] |= ((uint64_t)1) << (slot % 64);
+    if (tex_alias)
+        core->cache_tex_alias[slot / 64] |= ((uint64_t)1) << (slot % 64);
 
-        if (!ent) {
-            LOG_WARN("WARNING: failed to add texture 0x%08x to "
-                     "the texture cache\n", cmd_hdr->tex_addr);
-            gfx_cmd.arg.set_rend_param.param.tex_enable = false;
-        } else {
-            unsigned tex_idx = pvr2_tex_cache_get_idx(pvr2, ent);
-            gfx_cmd.arg.set_rend_param.param.tex_enable = true;
-            gfx_cmd.arg.set_rend_param.param.tex_idx = tex_idx;
-        }
+    return (pvr2_tex_cache_get_idx(pvr2, ent) << 1) | (tex_alias ? 1 : 0);
+}
+
+static void
+display_list_exec_header(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                         struct pvr2_display_list_command const *cmd,
+                         bool punch_through, bool blend_enable, int32_t tex) {
+    struct pvr2_core *core = &pvr2->core;
+    struct pvr2_display_list_command_header const *cmd_hdr = &cmd->hdr;
+    struct gfx_il_inst gfx_cmd;
+    bool tex_alias = false;
+
+    if (tex >= 0) {
+        tex_alias = tex & 1;
+        gfx_cmd.arg.set_rend_param.param.tex_enable = true;
+        gfx_cmd.arg.set_rend_param.param.tex_idx = tex >> 1;
     } else {
         gfx_cmd.arg.set_rend_param.param.tex_enable = false;
     }
@@ -423,6 +857,8 @@ display_list_exec_header(struct pvr2 *pvr2,
 
     gfx_cmd.arg.set_rend_param.param.pt_mode = punch_through;
     gfx_cmd.arg.set_rend_param.param.pt_ref = core->pt_alpha_ref & 0xff;
+    gfx_cmd.arg.set_rend_param.param.shadow =
+        core->mod_vols && cmd_hdr->shadow;
 
     float *tex_transform = gfx_cmd.arg.set_rend_param.param.tex_transform;
     if (cmd_hdr->stride_sel) {
@@ -437,31 +873,48 @@ display_list_exec_header(struct pvr2 *pvr2,
     tex_transform[2] = 0.0f;
     tex_transform[3] = 1.0f;
 
-    // enqueue the configuration command
-    pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+    float *tex_offset = gfx_cmd.arg.set_rend_param.param.tex_offset;
+    tex_offset[0] = 0.0f;
+    tex_offset[1] = 0.0f;
+    if (tex_alias) {
+        // host render targets are stored bottom-to-top
+        tex_transform[3] = -1.0f;
+        tex_offset[1] = 1.0f;
+    }
 
-    // TODO: this only needs to be done once per group, not once per polygon group
-    gfx_cmd.op = GFX_IL_SET_BLEND_ENABLE;
-    gfx_cmd.arg.set_blend_enable.do_enable = blend_enable;
-    pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+    /*
+     * enqueue the configuration command.  Lots of games send the same header
+     * over and over again, and leaving those out is what allows the draws
+     * on either side of them to be merged.
+     */
+    if (!il->last_rend_param_valid ||
+        !rend_param_eq(&il->last_rend_param,
+                       &gfx_cmd.arg.set_rend_param.param)) {
+        pvr2_core_push_gfx_il(il, gfx_cmd);
+        il->last_rend_param = gfx_cmd.arg.set_rend_param.param;
+        il->last_rend_param_valid = true;
+    } else {
+        il->dup_rend_param_count++;
+    }
 
-    pvr2->core.stride_sel = cmd_hdr->stride_sel;
-    pvr2->core.tex_width_shift = cmd_hdr->tex_width_shift;
-    pvr2->core.tex_height_shift = cmd_hdr->tex_height_shift;
+    if (!il->last_blend_enable_valid ||
+        il->last_blend_enable != blend_enable) {
+        gfx_cmd.op = GFX_IL_SET_BLEND_ENABLE;
+        gfx_cmd.arg.set_blend_enable.do_enable = blend_enable;
+        pvr2_core_push_gfx_il(il, gfx_cmd);
+        il->last_blend_enable = blend_enable;
+        il->last_blend_enable_valid = true;
+    }
 }
 
 static void
-display_list_exec_quad(struct pvr2 *pvr2,
+display_list_exec_quad(struct pvr2 *pvr2, struct pvr2_il_buf *il,
                        struct pvr2_display_list_command const *cmd) {
-    struct gfx_il_inst gfx_cmd;
-    gfx_cmd.op = GFX_IL_DRAW_VERT_ARRAY;
-    gfx_cmd.arg.draw_vert_array.first_idx = cmd->quad.first_vtx;
-    gfx_cmd.arg.draw_vert_array.n_verts = 4;
-    pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+    pvr2_core_push_draw(pvr2, il, cmd->quad.first_vtx, 4);
 }
 
 static void
-display_list_exec_user_clip(struct pvr2 *pvr2,
+display_list_exec_user_clip(struct pvr2_il_buf *il,
                             struct pvr2_display_list_command const *cmd) {
     struct gfx_il_inst gfx_cmd;
 
@@ -471,31 +924,516 @@ display_list_exec_user_clip(struct pvr2 *pvr2,
     gfx_cmd.arg.set_user_clip.x_max = cmd->user_clip.x_max * 32 + 31;
     gfx_cmd.arg.set_user_clip.y_max = cmd->user_clip.y_max * 32 + 31;
 
-    pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+    pvr2_core_push_gfx_il(il, gfx_cmd);
 }
 
 static void
-display_list_exec_tri_strip(struct pvr2 *pvr2,
+display_list_exec_tri_strip(struct pvr2 *pvr2, struct pvr2_il_buf *il,
                             struct pvr2_display_list_command const *cmd) {
     unsigned n_verts = cmd->strip.vtx_count;
 
-    if (n_verts) {
+    if (n_verts)
+        pvr2_core_push_draw(pvr2, il, cmd->strip.first_vtx, n_verts);
+}
+
+static void
+display_list_exec_mod_vol(struct pvr2_il_buf *il,
+                          struct pvr2_display_list_command const *cmd) {
+    if (cmd->mod_vol.outside) {
+        LOG_DBG("Unimplemented outside-last modifier volume!\n");
+        return;
+    }
+
+    struct gfx_il_inst gfx_cmd;
+    gfx_cmd.op = GFX_IL_DRAW_MOD_VOL;
+    gfx_cmd.arg.draw_mod_vol.first_idx = cmd->mod_vol.first_vtx;
+    gfx_cmd.arg.draw_mod_vol.n_verts = cmd->mod_vol.vtx_count;
+    pvr2_core_push_gfx_il(il, gfx_cmd);
+}
+
+static bool rend_param_eq(struct gfx_rend_param const *lhs,
+                          struct gfx_rend_param const *rhs) {
+    // tex_idx is uninitialized when textures are disabled, so no memcmp
+    if (lhs->tex_enable != rhs->tex_enable ||
+        (lhs->tex_enable && lhs->tex_idx != rhs->tex_idx))
+        return false;
+
+    return lhs->tex_inst == rhs->tex_inst &&
+        lhs->tex_filter == rhs->tex_filter &&
+        lhs->tex_wrap_mode[0] == rhs->tex_wrap_mode[0] &&
+        lhs->tex_wrap_mode[1] == rhs->tex_wrap_mode[1] &&
+        lhs->user_clip_mode == rhs->user_clip_mode &&
+        lhs->src_blend_factor == rhs->src_blend_factor &&
+        lhs->dst_blend_factor == rhs->dst_blend_factor &&
+        lhs->enable_depth_writes == rhs->enable_depth_writes &&
+        lhs->depth_func == rhs->depth_func &&
+        lhs->pt_mode == rhs->pt_mode &&
+        lhs->pt_ref == rhs->pt_ref &&
+        lhs->shadow == rhs->shadow &&
+        memcmp(lhs->tex_transform, rhs->tex_transform,
+               sizeof(lhs->tex_transform)) == 0 &&
+        memcmp(lhs->tex_offset, rhs->tex_offset,
+               sizeof(lhs->tex_offset)) == 0;
+}
+
+// make room for at least n_idx more indices in il->idx_buf
+static void pvr2_il_buf_reserve_idx(struct pvr2_il_buf *il, unsigned n_idx) {
+    unsigned want = il->n_idx + n_idx;
+    if (want <= il->idx_buf_cap)
+        return;
+
+    unsigned cap = il->idx_buf_cap ? il->idx_buf_cap : 1024;
+    while (cap < want)
+        cap *= 2;
+    if (cap > PVR2_IDX_BUF_LEN)
+        cap = PVR2_IDX_BUF_LEN;
+
+    uint32_t *idx_buf = (uint32_t*)realloc(il->idx_buf, cap * sizeof(uint32_t));
+    if (!idx_buf)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    il->idx_buf = idx_buf;
+    il->idx_buf_cap = cap;
+}
+
+static void
+pvr2_core_push_draw(struct pvr2 *pvr2, struct pvr2_il_buf *il,
+                    unsigned first_vtx, unsigned n_verts) {
+    if (!pvr2->core.merge_draws) {
         struct gfx_il_inst gfx_cmd;
         gfx_cmd.op = GFX_IL_DRAW_VERT_ARRAY;
-        gfx_cmd.arg.draw_vert_array.first_idx = cmd->strip.first_vtx;
+        gfx_cmd.arg.draw_vert_array.first_idx = first_vtx;
         gfx_cmd.arg.draw_vert_array.n_verts = n_verts;
-        pvr2_core_push_gfx_il(pvr2, gfx_cmd);
+        pvr2_core_emit_gfx_il(il, &gfx_cmd);
+        return;
+    }
+
+    /*
+     * a batch with only one strip in it doesn't need any indices, so don't
+     * write anything into idx_buf until a second strip comes along.
+     */
+    if (il->batch_n_strips == 1) {
+        if (il->n_idx + il->batch_n_verts + 1 + n_verts >
+            PVR2_IDX_BUF_LEN) {
+            pvr2_core_flush_draws(il);
+        } else {
+            unsigned idx;
+            pvr2_il_buf_reserve_idx(il, il->batch_n_verts + 1 + n_verts);
+            il->batch_first_idx = il->n_idx;
+            for (idx = 0; idx < il->batch_n_verts; idx++)
+                il->idx_buf[il->n_idx++] = il->batch_first_vtx + idx;
+        }
+    } else if (il->batch_n_strips > 1 &&
+               il->n_idx + 1 + n_verts > PVR2_IDX_BUF_LEN) {
+        pvr2_core_flush_draws(il);
     }
+
+    if (il->batch_n_strips == 0) {
+        il->batch_first_vtx = first_vtx;
+        il->batch_n_verts = n_verts;
+        il->batch_n_strips = 1;
+        return;
+    }
+
+    unsigned idx;
+    pvr2_il_buf_reserve_idx(il, 1 + n_verts);
+    il->idx_buf[il->n_idx++] = GFX_IL_RESTART_IDX;
+    for (idx = 0; idx < n_verts; idx++)
+        il->idx_buf[il->n_idx++] = first_vtx + idx;
+    il->batch_n_strips++;
+}
+
+static void pvr2_core_flush_draws(struct pvr2_il_buf *il) {
+    struct gfx_il_inst gfx_cmd;
+
+    if (il->batch_n_strips == 1) {
+        gfx_cmd.op = GFX_IL_DRAW_VERT_ARRAY;
+        gfx_cmd.arg.draw_vert_array.first_idx = il->batch_first_vtx;
+        gfx_cmd.arg.draw_vert_array.n_verts = il->batch_n_verts;
+        pvr2_core_emit_gfx_il(il, &gfx_cmd);
+    } else if (il->batch_n_strips > 1) {
+        gfx_cmd.op = GFX_IL_DRAW_INDEXED_VERT_ARRAY;
+        gfx_cmd.arg.draw_indexed_vert_array.first_idx = il->batch_first_idx;
+        gfx_cmd.arg.draw_indexed_vert_array.n_idx =
+            il->n_idx - il->batch_first_idx;
+        pvr2_core_emit_gfx_il(il, &gfx_cmd);
+        il->merged_draw_count += il->batch_n_strips - 1;
+    }
+
+    il->batch_n_strips = 0;
 }
 
 static inline void
-pvr2_core_push_gfx_il(struct pvr2 *pvr2, struct gfx_il_inst inst) {
+pvr2_core_emit_gfx_il(struct pvr2_il_buf *il, struct gfx_il_inst const *inst) {
+    if (il->gfx_il_inst_buf_count >= il->gfx_il_inst_buf_cap) {
+        unsigned cap = il->gfx_il_inst_buf_cap ?
+            2 * il->gfx_il_inst_buf_cap : PVR2_GFX_IL_INST_CHUNK;
+
+        struct gfx_il_inst *buf = (struct gfx_il_inst*)
+            realloc(il->gfx_il_inst_buf, cap * sizeof(struct gfx_il_inst));
+        if (!buf)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        il->gfx_il_inst_buf = buf;
+        il->gfx_il_inst_buf_cap = cap;
+    }
+
+    il->gfx_il_inst_buf[il->gfx_il_inst_buf_count++] = *inst;
+}
+
+static inline void
+pvr2_core_push_gfx_il(struct pvr2_il_buf *il, struct gfx_il_inst inst) {
+    // pending draws have to go out before anything that might affect them
+    pvr2_core_flush_draws(il);
+    pvr2_core_emit_gfx_il(il, &inst);
+}
+
+static void pvr2_il_buf_reset(struct pvr2_il_buf *il) {
+    il->gfx_il_inst_buf_count = 0;
+    il->n_idx = 0;
+    il->batch_n_strips = 0;
+    il->dup_rend_param_count = 0;
+    il->merged_draw_count = 0;
+}
+
+static void pvr2_il_buf_cleanup(struct pvr2_il_buf *il) {
+    free(il->gfx_il_inst_buf);
+    il->gfx_il_inst_buf = NULL;
+    il->gfx_il_inst_buf_cap = 0;
+
+    free(il->idx_buf);
+    il->idx_buf = NULL;
+    il->idx_buf_cap = 0;
+
+    free(il->sort_polys);
+    free(il->sort_keys);
+    il->sort_polys = NULL;
+    il->sort_keys = NULL;
+    il->sort_cap = 0;
+}
+
+// append src to the end of dst
+static void
+pvr2_il_buf_append(struct pvr2_il_buf *dst, struct pvr2_il_buf const *src) {
+    unsigned idx_base = dst->n_idx;
+    unsigned inst_no;
+
+    if (src->n_idx) {
+        pvr2_il_buf_reserve_idx(dst, src->n_idx);
+        if (dst->n_idx + src->n_idx > dst->idx_buf_cap)
+            RAISE_ERROR(ERROR_OVERFLOW);
+        memcpy(dst->idx_buf + dst->n_idx, src->idx_buf,
+               src->n_idx * sizeof(uint32_t));
+        dst->n_idx += src->n_idx;
+    }
+
+    for (inst_no = 0; inst_no < src->gfx_il_inst_buf_count; inst_no++) {
+        struct gfx_il_inst inst = src->gfx_il_inst_buf[inst_no];
+        if (inst.op == GFX_IL_DRAW_INDEXED_VERT_ARRAY)
+            inst.arg.draw_indexed_vert_array.first_idx += idx_base;
+        pvr2_core_emit_gfx_il(dst, &inst);
+    }
+
+    dst->dup_rend_param_count += src->dup_rend_param_count;
+    dst->merged_draw_count += src->merged_draw_count;
+}
+
+/*
+ * PARALLEL DISPLAY LIST EXECUTION
+ *
+ * Every polygon group that's going to be drawn is a job.  The emulation
+ * thread and the workers all pull jobs until there are none left, and then
+ * the emulation thread appends the groups' streams to core->il in order.
+ */
+#define PVR2_LIST_EXEC_WORKERS 2
+
+struct pvr2_list_workers {
+    washdc_mutex lock;
+    washdc_cvar work_cvar, done_cvar;
+    washdc_thread threads[PVR2_LIST_EXEC_WORKERS];
+    bool quit;
+
+    // incremented every time a new set of jobs is posted
+    unsigned gen;
+
+    struct pvr2 *pvr2;
+    struct pvr2_display_list const *listp;
+    unsigned jobs[PVR2_POLY_TYPE_COUNT];
+    unsigned n_jobs, next_job, n_done;
+};
+
+// call with workers->lock held
+static void pvr2_list_workers_run_jobs(struct pvr2_list_workers *workers) {
+    while (workers->next_job < workers->n_jobs) {
+        unsigned group_no = workers->jobs[workers->next_job++];
+        struct pvr2 *pvr2 = workers->pvr2;
+        struct pvr2_core *core = &pvr2->core;
+
+        washdc_mutex_unlock(&workers->lock);
+        pvr2_il_buf_reset(core->group_il + group_no);
+        display_list_exec_group(pvr2, core->group_il + group_no,
+                                workers->listp, group_no,
+                                core->group_tex[group_no]);
+        washdc_mutex_lock(&workers->lock);
+
+        if (++workers->n_done == workers->n_jobs)
+            washdc_cvar_signal(&workers->done_cvar);
+    }
+}
+
+static void pvr2_list_worker_main(void *argp) {
+    struct pvr2_list_workers *workers = (struct pvr2_list_workers*)argp;
+    unsigned gen = 0;
+
+    washdc_mutex_lock(&workers->lock);
+    for (;;) {
+        while (!workers->quit && workers->gen == gen)
+            washdc_cvar_wait(&workers->work_cvar, &workers->lock);
+        if (workers->quit)
+            break;
+        gen = workers->gen;
+        pvr2_list_workers_run_jobs(workers);
+    }
+    washdc_mutex_unlock(&workers->lock);
+}
+
+static void pvr2_list_workers_init(struct pvr2 *pvr2) {
+    struct pvr2_core *core = &pvr2->core;
+    struct pvr2_list_workers *workers =
+        (struct pvr2_list_workers*)calloc(1, sizeof(*workers));
+    if (!workers)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    unsigned group_no;
+    for (group_no = 0; group_no < PVR2_POLY_TYPE_COUNT; group_no++) {
+        core->group_tex[group_no] = NULL;
+        core->group_tex_cap[group_no] = 0;
+        memset(core->group_il + group_no, 0, sizeof(core->group_il[group_no]));
+    }
+
+    washdc_mutex_init(&workers->lock);
+    washdc_cvar_init(&workers->work_cvar);
+    washdc_cvar_init(&workers->done_cvar);
+    workers->pvr2 = pvr2;
+
+    unsigned td_no;
+    for (td_no = 0; td_no < PVR2_LIST_EXEC_WORKERS; td_no++) {
+        washdc_thread_create(workers->threads + td_no,
+                             pvr2_list_worker_main, workers);
+    }
+
+    core->workers = workers;
+}
+
+static void pvr2_list_workers_cleanup(struct pvr2 *pvr2) {
     struct pvr2_core *core = &pvr2->core;
+    struct pvr2_list_workers *workers = core->workers;
+
+    if (!workers)
+        return;
+
+    washdc_mutex_lock(&workers->lock);
+    workers->quit = true;
+    washdc_cvar_broadcast(&workers->work_cvar);
+    washdc_mutex_unlock(&workers->lock);
+
+    unsigned td_no;
+    for (td_no = 0; td_no < PVR2_LIST_EXEC_WORKERS; td_no++)
+        washdc_thread_join(workers->threads + td_no);
 
-    if (core->gfx_il_inst_buf_count >= PVR2_GFX_IL_INST_BUF_LEN)
-        RAISE_ERROR(ERROR_OVERFLOW);
+    washdc_cvar_cleanup(&workers->done_cvar);
+    washdc_cvar_cleanup(&workers->work_cvar);
+    washdc_mutex_cleanup(&workers->lock);
+    free(workers);
+    core->workers = NULL;
 
-    core->gfx_il_inst_buf[core->gfx_il_inst_buf_count++] = inst;
+    unsigned group_no;
+    for (group_no = 0; group_no < PVR2_POLY_TYPE_COUNT; group_no++) {
+        pvr2_il_buf_cleanup(core->group_il + group_no);
+        free(core->group_tex[group_no]);
+        core->group_tex[group_no] = NULL;
+        core->group_tex_cap[group_no] = 0;
+    }
+}
+
+/*
+ * returns false without doing anything if there's only one group to draw,
+ * since that's faster to do on the emulation thread by itself.
+ */
+static bool
+display_list_exec_parallel(struct pvr2 *pvr2,
+                           struct pvr2_display_list const *listp) {
+    struct pvr2_core *core = &pvr2->core;
+    struct pvr2_list_workers *workers = core->workers;
+    unsigned jobs[PVR2_POLY_TYPE_COUNT];
+    unsigned n_jobs = 0;
+    unsigned group_no, job_no;
+
+    for (group_no = PVR2_POLY_TYPE_OPAQUE;
+         group_no <= PVR2_POLY_TYPE_PUNCH_THROUGH; group_no++) {
+        if (display_list_skip_group(pvr2, group_no))
+            continue;
+
+        if (listp->poly_groups[group_no].valid)
+            jobs[n_jobs++] = group_no;
+    }
+
+    if (n_jobs < 2)
+        return false;
+
+    /*
+     * texture lookups go through the texture cache and can send gfx_il of
+     * their own, so they all get done here in the same order
+     * display_list_exec would have done them in.
+     */
+    for (job_no = 0; job_no < n_jobs; job_no++) {
+        group_no = jobs[job_no];
+        struct pvr2_display_list_group const *group =
+            listp->poly_groups + group_no;
+        unsigned cmd_no;
+
+        if (group->n_cmds > core->group_tex_cap[group_no]) {
+            int32_t *new_tex = (int32_t*)realloc(core->group_tex[group_no],
+                                                 group->cmd_cap *
+                                                 sizeof(int32_t));
+            if (!new_tex)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            core->group_tex[group_no] = new_tex;
+            core->group_tex_cap[group_no] = group->cmd_cap;
+        }
+        int32_t *group_tex = core->group_tex[group_no];
+
+        core->cur_poly_group = group_no;
+        for (cmd_no = 0; cmd_no < group->n_cmds; cmd_no++) {
+            struct pvr2_display_list_command const *cmd =
+                group->cmds + cmd_no;
+            if (cmd->tp == PVR2_DISPLAY_LIST_COMMAND_TP_HEADER)
+                group_tex[cmd_no] = display_list_bind_tex(pvr2, cmd);
+        }
+    }
+
+    washdc_mutex_lock(&workers->lock);
+    workers->listp = listp;
+    memcpy(workers->jobs, jobs, sizeof(jobs));
+    workers->n_jobs = n_jobs;
+    workers->next_job = 0;
+    workers->n_done = 0;
+    workers->gen++;
+    washdc_cvar_broadcast(&workers->work_cvar);
+
+    pvr2_list_workers_run_jobs(workers);
+    while (workers->n_done < workers->n_jobs)
+        washdc_cvar_wait(&workers->done_cvar, &workers->lock);
+    washdc_mutex_unlock(&workers->lock);
+
+    for (job_no = 0; job_no < n_jobs; job_no++)
+        pvr2_il_buf_append(&core->il, core->group_il + jobs[job_no]);
+
+    return true;
+}
+
+/*
+ * returns false if some of listp's commands or vertices never made it into its
+ * hash, which happens when a polygon group isn't closed before STARTRENDER.
+ */
+static bool
+list_cache_get_key(struct pvr2 *pvr2, struct pvr2_display_list const *listp,
+                   struct pvr2_list_cache_key *key) {
+    if (listp->n_verts_hashed != listp->n_verts)
+        return false;
+
+    unsigned group_no;
+    for (group_no = 0; group_no < PVR2_POLY_TYPE_COUNT; group_no++) {
+        struct pvr2_display_list_group const *group =
+            listp->poly_groups + group_no;
+        if (group->valid && group->n_cmds_hashed != group->n_cmds)
+            return false;
+    }
+
+    memset(key, 0, sizeof(*key));
+    key->list_hash = listp->hash;
+    key->n_verts = listp->n_verts;
+    key->isp_feed_cfg = pvr2->reg_backing[PVR2_ISP_FEED_CFG] & 1;
+    key->text_control =
+        pvr2->reg_backing[PVR2_TEXT_CONTROL] & BIT_RANGE(0, 4);
+    key->pt_alpha_ref = pvr2->core.pt_alpha_ref & 0xff;
+    return true;
+}
+
+/*
+ * send the stream that's already in gfx_il_inst_buf again if it was built from
+ * a list with the same key.  Returns false if it has to be rebuilt.
+ */
+static bool
+list_cache_replay(struct pvr2 *pvr2, struct pvr2_list_cache_key const *key) {
+    struct pvr2_core *core = &pvr2->core;
+
+    if (!core->cache_valid ||
+        memcmp(key, &core->cache_key, sizeof(*key)) != 0)
+        return false;
+
+    /*
+     * the textures still need to be bound so that anything that got written
+     * to texture memory or rendered on top of them since the last frame gets
+     * picked up.  Binding can change whether a texture aliases a framebuffer,
+     * and that changes the render state inside the stream.
+     */
+    bool alias_changed = false;
+    unsigned slot;
+    for (slot = 0; slot < GFX_TEX_CACHE_SIZE; slot++) {
+        uint64_t mask = ((uint64_t)1) << (slot % 64);
+        if (!(core->cache_tex[slot / 64] & mask))
+            continue;
+
+        struct pvr2_tex *tex = pvr2->tex_cache.tex_cache + slot;
+        if (tex->state == PVR2_TEX_INVALID)
+            return false;
+
+        pvr2_tex_cache_touch(pvr2, tex);
+        pvr2_tex_cache_bind(pvr2, tex);
+
+        bool was_alias = core->cache_tex_alias[slot / 64] & mask;
+        if (was_alias != (tex->alias_obj >= 0))
+            alias_changed = true;
+    }
+
+    if (alias_changed)
+        return false;
+
+    pvr2->stat.per_frame_counters.dup_rend_param_count =
+        core->il.dup_rend_param_count;
+    pvr2->stat.per_frame_counters.merged_draw_count =
+        core->il.merged_draw_count;
+    pvr2->stat.persistent_counters.list_cache_hit_count++;
+    return true;
+}
+
+// fill gfx_il_inst_buf and idx_buf with the stream for listp
+static void
+prep_display_list(struct pvr2 *pvr2, struct pvr2_display_list const *listp) {
+    struct pvr2_core *core = &pvr2->core;
+    struct pvr2_list_cache_key key;
+    bool cacheable = core->list_cache && list_cache_get_key(pvr2, listp, &key);
+
+    if (cacheable && list_cache_replay(pvr2, &key))
+        return;
+
+    pvr2_il_buf_reset(&core->il);
+
+    core->cache_valid = false;
+    core->cache_taint = false;
+    memset(core->cache_tex, 0, sizeof(core->cache_tex));
+    memset(core->cache_tex_alias, 0, sizeof(core->cache_tex_alias));
+
+    display_list_exec(pvr2, listp);
+
+    pvr2->stat.per_frame_counters.dup_rend_param_count =
+        core->il.dup_rend_param_count;
+    pvr2->stat.per_frame_counters.merged_draw_count =
+        core->il.merged_draw_count;
+
+    if (cacheable && !core->cache_taint) {
+        core->cache_key = key;
+        core->cache_valid = true;
+    }
 }
 
 static DEF_ERROR_INT_ATTR(screen_width)
@@ -511,6 +1449,14 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
 
     render_frame_init(pvr2);
 
+    /*
+     * frames that will never be presented don't need to be drawn unless the
+     * guest might be able to see them.  The display list is still consumed
+     * and the render-complete interrupt still gets raised.
+     */
+    bool skip_render = dc_skip_render() &&
+        framebuffer_render_skippable(pvr2);
+
     /*
      * Algorithm here is to find the youngest display list which is within a
      * certain range of where PVR2_PARAM_BASE points.  The reason for this is
@@ -567,8 +1513,8 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
         pvr2_inc_age_counter(pvr2);
         listp->age_counter = core->disp_list_counter;
 
-        display_list_exec(pvr2, listp);
-        pvr2_tex_cache_xmit(pvr2);
+        if (!skip_render)
+            prep_display_list(pvr2, listp);
     } else {
         LOG_ERROR("PVR2 unable to locate display list for key %08X\n",
                   (unsigned)key);
@@ -638,6 +1584,10 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     /* memcpy(&geo->bgdepth, &backgnd_depth_as_int, sizeof(float)); */
 
     int tgt = framebuffer_set_render_target(pvr2);
+    if (skip_render) {
+        framebuffer_skip_render(pvr2);
+        goto end_render;
+    }
 
     /*
      * This is really driving me insane and I don't know what to do about it.
@@ -701,10 +1651,20 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
         cmd.op = GFX_IL_SET_VERT_ARRAY;
         cmd.arg.set_vert_array.n_verts = listp->n_verts;
         cmd.arg.set_vert_array.verts = listp->vert_array;
+        cmd.arg.set_vert_array.buf_no = listp->vert_buf_no;
+        cmd.arg.set_vert_array.fmt = core->vert_fmt;
         rend_exec_il(&cmd, 1);
+        listp->verts_submitted = true;
+
+        if (core->il.n_idx) {
+            cmd.op = GFX_IL_SET_INDEX_ARRAY;
+            cmd.arg.set_index_array.n_idx = core->il.n_idx;
+            cmd.arg.set_index_array.idx = core->il.idx_buf;
+            rend_exec_il(&cmd, 1);
+        }
 
         // execute queued gfx_il commands
-        rend_exec_il(core->gfx_il_inst_buf, core->gfx_il_inst_buf_count);
+        rend_exec_il(core->il.gfx_il_inst_buf, core->il.gfx_il_inst_buf_count);
     }
 
     // tear down rendering context
@@ -712,6 +1672,9 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     cmd.arg.end_rend.rend_tgt_obj = tgt;
     rend_exec_il(&cmd, 1);
 
+end_render:
+    framebuffer_end_render(pvr2);
+
     core->next_frame_stamp++;
 
     if (!core->pvr2_render_complete_int_event_scheduled) {
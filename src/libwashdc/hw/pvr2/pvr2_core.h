@@ -28,6 +28,7 @@
 
 #include "pvr2_def.h"
 #include "gfx/gfx.h" // for enum tex_filter
+#include "washdc/gfx/tex_cache.h"
 #include "dc_sched.h"
 
 /*
@@ -84,7 +85,8 @@ enum pvr2_display_list_command_tp {
     PVR2_DISPLAY_LIST_COMMAND_TP_HEADER,
     PVR2_DISPLAY_LIST_COMMAND_TP_QUAD,
     PVR2_DISPLAY_LIST_COMMAND_TP_USER_CLIP,
-    PVR2_DISPLAY_LIST_COMMAND_TP_TRI_STRIP
+    PVR2_DISPLAY_LIST_COMMAND_TP_TRI_STRIP,
+    PVR2_DISPLAY_LIST_COMMAND_TP_MOD_VOL
 };
 
 struct pvr2_display_list_command_header {
@@ -119,6 +121,9 @@ struct pvr2_display_list_command_header {
 
     bool enable_depth_writes;
     enum Pvr2DepthFunc depth_func;
+
+    // polygon can be darkened by modifier volumes
+    bool shadow;
 };
 
 struct pvr2_display_list_quad {
@@ -138,6 +143,18 @@ struct pvr2_display_list_tri_strip {
     unsigned first_vtx, vtx_count;
 };
 
+/*
+ * a modifier volume, which is a closed triangle mesh.  The triangles are in
+ * the vertex array as a triangle list (not a strip), and only the positions
+ * are meaningful.
+ */
+struct pvr2_display_list_mod_vol {
+    unsigned first_vtx, vtx_count;
+
+    // the volume was closed with outside-last rather than inside-last
+    bool outside;
+};
+
 struct pvr2_display_list_command {
     enum pvr2_display_list_command_tp tp;
     union {
@@ -145,6 +162,7 @@ struct pvr2_display_list_command {
         struct pvr2_display_list_quad quad;
         struct pvr2_display_list_user_clip user_clip;
         struct pvr2_display_list_tri_strip strip;
+        struct pvr2_display_list_mod_vol mod_vol;
     };
 };
 
@@ -152,9 +170,17 @@ struct pvr2_display_list_group {
     // if false, this polygon group is not used by the display list
     bool valid;
 
-    unsigned n_cmds;
+    unsigned n_cmds, cmd_cap;
 
-#define PVR2_DISPLAY_LIST_MAX_LEN (128*1024) // TODO: made up bullshit limit
+    // number of cmds that have been folded into the display list's hash
+    unsigned n_cmds_hashed;
+
+    /*
+     * this grows as needed and keeps its capacity when the list gets
+     * reinitialized, so once a game's biggest scene has come through nothing
+     * gets reallocated.
+     */
+#define PVR2_DISPLAY_LIST_CMD_CHUNK 1024
     struct pvr2_display_list_command *cmds;
 };
 
@@ -172,14 +198,118 @@ struct pvr2_display_list {
 
     struct pvr2_display_list_group poly_groups[PVR2_POLY_TYPE_COUNT];
 
-    // TODO: made up bullshit limit, probably way higher than it needs to be
+    /*
+     * vert_array grows the same way the groups' cmds do, starting at
+     * PVR2_DISPLAY_LIST_VERT_CHUNK vertices.  Persistent vertex buffers can't
+     * grow, so those are always PVR2_DISPLAY_LIST_MAX_VERTS long.
+     */
+#define PVR2_DISPLAY_LIST_VERT_CHUNK (8*1024)
 #define PVR2_DISPLAY_LIST_MAX_VERTS (128*1024)
-    float *vert_array;
-    unsigned n_verts;
+    float *vert_array; // in pvr2_core's vert_fmt
+    unsigned n_verts, vert_cap;
+
+    /*
+     * persistent vertex buffer that vert_array points into, or -1 if
+     * vert_array was allocated with malloc.
+     */
+    int vert_buf_no;
+
+    // true if vert_array has been sent to gfx since the list was initialized
+    bool verts_submitted;
+
+    /*
+     * crc32 of every group's commands and vertices, updated each time a group
+     * gets closed.  Only maintained when the list_cache config is set.
+     */
+    uint32_t hash;
+    unsigned n_verts_hashed;
+};
+
+/*
+ * everything the gfx_il stream built out of a display list depends on.  Two
+ * lists with the same key produce the same stream.
+ */
+struct pvr2_list_cache_key {
+    uint32_t list_hash;
+    uint32_t n_verts;
+    uint32_t isp_feed_cfg;
+    uint32_t text_control;
+    uint32_t pt_alpha_ref;
 };
 
 #define PVR2_MAX_FRAMES_IN_FLIGHT 4
 
+/*
+ * number of persistent vertex buffers on top of the ones owned by the display
+ * lists.  These are for the GPU to read from while the TA is already writing
+ * the next frame's vertices.
+ */
+#define PVR2_SPARE_VERT_BUFS 3
+
+#define PVR2_IDX_BUF_LEN (2 * PVR2_DISPLAY_LIST_MAX_VERTS)
+
+/*
+ * a translucent polygon waiting to be sorted (see the poly_sort config
+ * option).  hdr_cmd and clip_cmd are the indices of the last header and user
+ * clip commands before the polygon in its group, or UINT_MAX if there weren't
+ * any.
+ */
+struct pvr2_sort_poly {
+    unsigned first_vtx, n_verts;
+    unsigned hdr_cmd, clip_cmd;
+    int32_t tex;
+};
+
+/*
+ * a gfx_il stream that's being built out of a display list.  Normally there's
+ * only the one in pvr2_core, but with the list_exec_threads config each
+ * polygon group gets built into its own and they're appended afterwards.
+ */
+struct pvr2_il_buf {
+    // here's where we buffer gfx_il instructions
+    struct gfx_il_inst *gfx_il_inst_buf;
+    unsigned gfx_il_inst_buf_count, gfx_il_inst_buf_cap;
+
+    /*
+     * last render state sent to gfx in the current polygon group.  Headers
+     * that don't change anything are dropped.
+     */
+    struct gfx_rend_param last_rend_param;
+    bool last_rend_param_valid;
+    bool last_blend_enable;
+    bool last_blend_enable_valid;
+
+    /*
+     * draw merging (see the merge_draws config option).  Consecutive strips
+     * with the same render state get concatenated into idx_buf with
+     * GFX_IL_RESTART_IDX between them and sent as a single
+     * GFX_IL_DRAW_INDEXED_VERT_ARRAY.
+     */
+    uint32_t *idx_buf;
+    unsigned n_idx, idx_buf_cap;
+
+    // the batch that hasn't been pushed into gfx_il_inst_buf yet
+    unsigned batch_n_strips;
+    unsigned batch_first_vtx, batch_n_verts; // only valid if batch_n_strips == 1
+    unsigned batch_first_idx; // only valid if batch_n_strips > 1
+
+    unsigned dup_rend_param_count;
+    unsigned merged_draw_count;
+
+    /*
+     * scratch space for sorting translucent polygons.  sort_keys holds two
+     * arrays of sort_cap entries each; the depth key goes in the upper 32 bits
+     * of each entry and the index into sort_polys goes in the lower 32 bits.
+     * These only grow, so once the biggest scene has come through nothing
+     * gets reallocated.
+     */
+    struct pvr2_sort_poly *sort_polys;
+    uint64_t *sort_keys;
+    unsigned sort_cap;
+};
+
+struct pvr2_list_workers;
+
 struct pvr2_core {
     // textures - this will change throught display list execution
     bool stride_sel;
@@ -193,15 +323,51 @@ struct pvr2_core {
     unsigned pvr2_core_vert_buf_count;
     unsigned pvr2_core_vert_buf_start;
 
-    // here's where we buffer gfx_il instructions
-    struct gfx_il_inst *gfx_il_inst_buf;
-    unsigned gfx_il_inst_buf_count;
+    // the stream that gets sent to gfx
+    struct pvr2_il_buf il;
 
     // reference alpha value for punch-through polygons
     unsigned pt_alpha_ref;
 
+    // format of every display list's vert_array
+    enum gfx_vert_fmt vert_fmt;
+
+    // see the merge_draws config option
+    bool merge_draws;
+
+    // see the mod_vols config option
+    bool mod_vols;
+
+    // see the poly_sort config option
+    bool poly_sort;
+
     unsigned next_frame_stamp;
 
+    /*
+     * parallel display list execution (see the list_exec_threads config
+     * option).  Texture lookups happen up front on the emulation thread and
+     * their results go in group_tex, one entry per command.  Then each
+     * polygon group gets turned into gfx_il in its own group_il.
+     */
+    struct pvr2_list_workers *workers;
+    struct pvr2_il_buf group_il[PVR2_POLY_TYPE_COUNT];
+    int32_t *group_tex[PVR2_POLY_TYPE_COUNT];
+    unsigned group_tex_cap[PVR2_POLY_TYPE_COUNT];
+
+    /*
+     * display list caching (see the list_cache config option).  If a list has
+     * the same key as the one il was built from, il gets sent again as it is
+     * instead of being rebuilt.
+     */
+    bool list_cache;
+    bool cache_valid;
+    bool cache_taint; // set while building a stream which can't be reused
+    struct pvr2_list_cache_key cache_key;
+
+    // textures bound by the cached stream, and which of those were aliased
+    uint64_t cache_tex[GFX_TEX_CACHE_SIZE / 64];
+    uint64_t cache_tex_alias[GFX_TEX_CACHE_SIZE / 64];
+
     /*
      * DISPLAY LIST TRACKING
      */
@@ -236,6 +402,22 @@ display_list_exec(struct pvr2 *pvr2, struct pvr2_display_list const *listp);
 
 void pvr2_display_list_init(struct pvr2_display_list *list);
 
+/*
+ * grow the list's vert_array so that it can hold at least n_verts more
+ * vertices.  Returns false if it can't.
+ */
+bool pvr2_display_list_grow_verts(struct pvr2 *pvr2,
+                                  struct pvr2_display_list *list,
+                                  unsigned n_verts);
+
+/*
+ * fold the commands and vertices that were added to listp since the last
+ * call into its hash.  This gets called whenever a polygon group is closed.
+ */
+void pvr2_display_list_hash_group(struct pvr2 *pvr2,
+                                  struct pvr2_display_list *listp,
+                                  enum pvr2_poly_type poly_tp);
+
 unsigned get_cur_frame_stamp(struct pvr2 *pvr2);
 
 #endif
@@ -37,6 +37,7 @@
 #include "pvr2_yuv.h"
 #include "intmath.h"
 #include "pvr2.h"
+#include "trace.h"
 
 #include "pvr2_reg.h"
 
@@ -133,7 +134,12 @@ pvr2_reg_do_write(struct pvr2 *pvr2, unsigned addr, uint32_t val) {
         break;
     case PVR2_STARTRENDER:
         reg_backing[PVR2_STARTRENDER] = val;
-        pvr2_ta_startrender(pvr2);
+        {
+            struct trace_span span;
+            trace_begin(&span, clock_cycle_stamp(pvr2->clk));
+            pvr2_ta_startrender(pvr2);
+            trace_end(&span, TRACE_TRACK_RENDER, "startrender", span.cycle);
+        }
         break;
     case PVR2_FB_R_CTRL:
         reg_backing[PVR2_FB_R_CTRL] = val;
@@ -46,6 +46,9 @@
 #include "pvr2.h"
 #include "pvr2_reg.h"
 #include "intmath.h"
+#include "bench.h"
+#include "perf_cnt.h"
+#include "savestate.h"
 
 #include "pvr2_ta.h"
 
@@ -107,18 +110,27 @@ next_poly_group(struct pvr2 *pvr2, enum pvr2_poly_type poly_type);
 
 static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
 static int decode_end_of_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
-static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
 static int decode_quad(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
 static int decode_input_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
 static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
 
 static void close_tri_strip(struct pvr2 *pvr2);
+static void close_mod_vol(struct pvr2_ta *ta);
+
+static void on_mod_vol_hdr_received(struct pvr2 *pvr2,
+                                    struct pvr2_pkt_hdr const *hdr);
+static void on_mod_vol_tri_received(struct pvr2 *pvr2, uint32_t const *src);
 
 // call this whenever a packet has been processed
 static void ta_fifo_finish_packet(struct pvr2_ta *ta);
 
 static void unpack_uv16(float *u_coord, float *v_coord, void const *input);
-static void unpack_rgba_8888(uint32_t const *ta_fifo32, float *rgba, uint32_t input);
+static void unpack_rgba_8888(float *rgba, uint32_t input);
+
+static void on_vtx_received(struct pvr2 *pvr2, uint32_t const *src);
+static pvr2_vtx_emit_func
+select_vtx_emitter(struct pvr2_fifo_state const *fifo_state,
+                   enum gfx_vert_fmt vert_fmt);
 
 /*
  * the delay between when a list is rendered and when the list-complete
@@ -167,14 +179,22 @@ void pvr2_ta_init(struct pvr2 *pvr2) {
 
     ta->pvr2_op_complete_int_event.handler =
         pvr2_op_complete_int_event_handler;
+    ta->pvr2_op_complete_int_event.name = "pvr2_op_complete_int_event_handler";
     ta->pvr2_op_mod_complete_int_event.handler =
         pvr2_op_mod_complete_int_event_handler;
+    ta->pvr2_op_mod_complete_int_event.name =
+        "pvr2_op_mod_complete_int_event_handler";
     ta->pvr2_trans_complete_int_event.handler =
         pvr2_trans_complete_int_event_handler;
+    ta->pvr2_trans_complete_int_event.name =
+        "pvr2_trans_complete_int_event_handler";
     ta->pvr2_trans_mod_complete_int_event.handler =
         pvr2_trans_mod_complete_int_event_handler;
+    ta->pvr2_trans_mod_complete_int_event.name =
+        "pvr2_trans_mod_complete_int_event_handler";
     ta->pvr2_pt_complete_int_event.handler =
         pvr2_pt_complete_int_event_handler;
+    ta->pvr2_pt_complete_int_event.name = "pvr2_pt_complete_int_event_handler";
 
     ta->pvr2_op_complete_int_event.arg_ptr = pvr2;
     ta->pvr2_op_mod_complete_int_event.arg_ptr = pvr2;
@@ -182,12 +202,74 @@ void pvr2_ta_init(struct pvr2 *pvr2) {
     ta->pvr2_trans_mod_complete_int_event.arg_ptr = pvr2;
     ta->pvr2_pt_complete_int_event.arg_ptr = pvr2;
 
+    sched_event_register(&ta->pvr2_op_complete_int_event,
+                         "pvr2_op_complete_int");
+    sched_event_register(&ta->pvr2_op_mod_complete_int_event,
+                         "pvr2_op_mod_complete_int");
+    sched_event_register(&ta->pvr2_trans_complete_int_event,
+                         "pvr2_trans_complete_int");
+    sched_event_register(&ta->pvr2_trans_mod_complete_int_event,
+                         "pvr2_trans_mod_complete_int");
+    sched_event_register(&ta->pvr2_pt_complete_int_event,
+                         "pvr2_pt_complete_int");
+
     ta->cur_list_idx = 0;
 }
 
 void pvr2_ta_cleanup(struct pvr2 *pvr2) {
 }
 
+static int pvr2_ta_state_xfer(struct savestate_buf *buf, struct pvr2_ta *ta,
+                              bool load) {
+    return SAVESTATE_XFER(buf, load, ta->fifo_state) ||
+        SAVESTATE_XFER(buf, load, ta->cur_list_idx) ||
+        SAVESTATE_XFER(buf, load, ta->pvr2_op_complete_int_event_scheduled) ||
+        SAVESTATE_XFER(buf, load,
+                       ta->pvr2_op_mod_complete_int_event_scheduled) ||
+        SAVESTATE_XFER(buf, load,
+                       ta->pvr2_trans_complete_int_event_scheduled) ||
+        SAVESTATE_XFER(buf, load,
+                       ta->pvr2_trans_mod_complete_int_event_scheduled) ||
+        SAVESTATE_XFER(buf, load, ta->pvr2_pt_complete_int_event_scheduled);
+}
+
+void pvr2_ta_state_save(struct savestate_buf *buf, void *ctxt) {
+    struct pvr2_ta *ta = &((struct pvr2*)ctxt)->ta;
+
+    // the emitter is a host pointer; it gets picked again on load
+    pvr2_vtx_emit_func vtx_emit = ta->fifo_state.vtx_emit;
+    ta->fifo_state.vtx_emit = NULL;
+    pvr2_ta_state_xfer(buf, ta, false);
+    ta->fifo_state.vtx_emit = vtx_emit;
+
+    uint8_t have_emit = vtx_emit != NULL;
+    savestate_buf_put(buf, &have_emit, sizeof(have_emit));
+}
+
+int pvr2_ta_state_load(struct savestate_buf *buf, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    struct pvr2_ta *ta = &pvr2->ta;
+    uint8_t have_emit;
+
+    if (pvr2_ta_state_xfer(buf, ta, true) != 0 ||
+        savestate_buf_get(buf, &have_emit, sizeof(have_emit)) != 0)
+        return -1;
+
+    ta->fifo_state.vtx_emit = have_emit ?
+        select_vtx_emitter(&ta->fifo_state, pvr2->core.vert_fmt) : NULL;
+    return 0;
+}
+
+bool pvr2_ta_busy(struct pvr2 *pvr2) {
+    struct pvr2_ta const *ta = &pvr2->ta;
+    return ta->fifo_state.open_group || ta->fifo_state.ta_fifo_word_count ||
+        ta->pvr2_op_complete_int_event_scheduled ||
+        ta->pvr2_op_mod_complete_int_event_scheduled ||
+        ta->pvr2_trans_complete_int_event_scheduled ||
+        ta->pvr2_trans_mod_complete_int_event_scheduled ||
+        ta->pvr2_pt_complete_int_event_scheduled;
+}
+
 uint32_t pvr2_ta_fifo_poly_read_32(addr32_t addr, void *ctxt) {
 #ifdef PVR2_LOG_VERBOSE
     LOG_DBG("WARNING: trying to read 4 bytes from the TA polygon FIFO "
@@ -202,6 +284,13 @@ void pvr2_ta_fifo_poly_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     pvr2_tafifo_input(pvr2, val);
 }
 
+void pvr2_ta_fifo_poly_write_dwords(addr32_t addr, uint32_t const *src,
+                                    unsigned n_dwords, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    PVR2_TRACE("writing %u bytes to TA polygon FIFO\n", 4 * n_dwords);
+    pvr2_tafifo_input_burst(pvr2, src, n_dwords);
+}
+
 uint16_t pvr2_ta_fifo_poly_read_16(addr32_t addr, void *ctxt) {
 #ifdef PVR2_LOG_VERBOSE
     LOG_DBG("WARNING: trying to read 2 bytes from the TA polygon FIFO "
@@ -377,6 +466,15 @@ static void on_pkt_hdr_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
      * able to disable textures if the cache is full, but hdr is const.
      */
     ta->fifo_state.vtx_len = hdr->vtx_len;
+
+    enum pvr2_poly_type cur_poly_type = ta->fifo_state.cur_poly_type;
+    ta->fifo_state.mod_vol = cur_poly_type == PVR2_POLY_TYPE_OPAQUE_MOD ||
+        cur_poly_type == PVR2_POLY_TYPE_TRANS_MOD;
+    if (ta->fifo_state.mod_vol) {
+        on_mod_vol_hdr_received(pvr2, hdr);
+        return;
+    }
+
     ta->fifo_state.tex_enable = pvr2_hdr_tex_enable(hdr);
     ta->fifo_state.geo_tp = hdr->tp;
     ta->fifo_state.tex_coord_16_bit_enable = pvr2_hdr_tex_coord_16_bit(hdr);
@@ -391,6 +489,8 @@ static void on_pkt_hdr_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     ta->fifo_state.depth_func = pvr2_hdr_depth_func(hdr);
     ta->fifo_state.tex_inst = pvr2_hdr_tex_inst(hdr);
     ta->fifo_state.tex_filter = pvr2_hdr_tex_filter(hdr);
+    ta->fifo_state.vtx_emit = select_vtx_emitter(&ta->fifo_state,
+                                                 core->vert_fmt);
 
     // queue up in a display list
     struct pvr2_display_list *cur_list = core->disp_lists + ta->cur_list_idx;
@@ -426,6 +526,30 @@ static void on_pkt_hdr_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     cmd_hdr->tex_vq_compression = pvr2_hdr_vq_compression(hdr);
     cmd_hdr->tex_mipmap = pvr2_hdr_tex_mipmap(hdr);
     cmd_hdr->user_clip_mode = pvr2_hdr_user_clip_mode(hdr);
+    cmd_hdr->shadow = pvr2_hdr_shadow(hdr);
+}
+
+/*
+ * modifier volume headers don't go into the display list.  All they do is say
+ * where one volume ends and the next begins.
+ */
+static void on_mod_vol_hdr_received(struct pvr2 *pvr2,
+                                    struct pvr2_pkt_hdr const *hdr) {
+    struct pvr2_fifo_state *fifo_state = &pvr2->ta.fifo_state;
+
+    // the triangles after the previous header were the end of a volume
+    if (fifo_state->mod_vol_last)
+        close_mod_vol(&pvr2->ta);
+
+    enum pvr2_mod_vol_inst inst = pvr2_hdr_mod_vol_inst(hdr);
+    fifo_state->mod_vol_last = inst == PVR2_MOD_VOL_INST_INSIDE_LAST ||
+        inst == PVR2_MOD_VOL_INST_OUTSIDE_LAST;
+    fifo_state->mod_vol_outside = inst == PVR2_MOD_VOL_INST_OUTSIDE_LAST;
+}
+
+static void close_mod_vol(struct pvr2_ta *ta) {
+    ta->fifo_state.open_mod_vol = false;
+    ta->fifo_state.mod_vol_last = false;
 }
 
 static void
@@ -508,9 +632,10 @@ on_pkt_end_of_list_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
 
-    finish_poly_group(pvr2, ta->fifo_state.cur_poly_type);
-    set_poly_type_state(ta, ta->fifo_state.cur_poly_type,
-                        PVR2_POLY_TYPE_STATE_SUBMITTED);
+    enum pvr2_poly_type poly_type = ta->fifo_state.cur_poly_type;
+    finish_poly_group(pvr2, poly_type);
+    close_mod_vol(ta);
+    set_poly_type_state(ta, poly_type, PVR2_POLY_TYPE_STATE_SUBMITTED);
     ta->fifo_state.cur_poly_type = PVR2_POLY_TYPE_NONE;
 
     // queue up in a display list
@@ -518,21 +643,54 @@ on_pkt_end_of_list_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     if (ta->cur_list_idx >= PVR2_MAX_FRAMES_IN_FLIGHT || !cur_list->valid)
         RAISE_ERROR(ERROR_INTEGRITY);
 
-    ta->fifo_state.cur_poly_type = PVR2_POLY_TYPE_NONE;
+    pvr2_display_list_hash_group(pvr2, cur_list, poly_type);
 }
 
-static float *
-alloc_disp_list_verts(struct pvr2_display_list *listp, unsigned n_verts) {
-    if (listp->n_verts + n_verts > PVR2_DISPLAY_LIST_MAX_VERTS) {
+static void *
+alloc_disp_list_verts(struct pvr2 *pvr2,
+                      struct pvr2_display_list *listp, unsigned n_verts) {
+    if (listp->n_verts + n_verts > listp->vert_cap &&
+        !pvr2_display_list_grow_verts(pvr2, listp, n_verts)) {
         LOG_ERROR("PVR2 CORE display list vertex buffer overflow\n");
         return NULL;
     }
 
-    float *outp = listp->vert_array + GFX_VERT_LEN * listp->n_verts;
+    char *outp = (char*)listp->vert_array +
+        GFX_VERT_SIZE(pvr2->core.vert_fmt) * listp->n_verts;
     listp->n_verts += n_verts;
     return outp;
 }
 
+static inline uint8_t pack_unorm8(float val) {
+    // the negated comparison also catches NaN
+    if (!(val > 0.0f))
+        return 0;
+    if (val >= 1.0f)
+        return 255;
+    return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+static void pack_color(uint8_t *dst, float const *src) {
+    dst[0] = pack_unorm8(src[0]);
+    dst[1] = pack_unorm8(src[1]);
+    dst[2] = pack_unorm8(src[2]);
+    dst[3] = pack_unorm8(src[3]);
+}
+
+// write a single vertex in GFX_VERT_FMT_PACKED
+static void pack_vert(void *dst, float const *pos, float const *base_color,
+                      float const *offs_color, float const *uv) {
+    uint8_t *dst8 = (uint8_t*)dst;
+    float const one = 1.0f;
+
+    memcpy(dst8 + GFX_PACKED_VERT_POS_OFFSET, pos, 3 * sizeof(float));
+    memcpy(dst8 + GFX_PACKED_VERT_POS_OFFSET + 3 * sizeof(float),
+           &one, sizeof(one));
+    pack_color(dst8 + GFX_PACKED_VERT_BASE_COLOR_OFFSET, base_color);
+    pack_color(dst8 + GFX_PACKED_VERT_OFFS_COLOR_OFFSET, offs_color);
+    memcpy(dst8 + GFX_PACKED_VERT_TEX_COORD_OFFSET, uv, 2 * sizeof(float));
+}
+
 static void
 on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     struct pvr2_ta *ta = &pvr2->ta;
@@ -546,11 +704,19 @@ on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     struct pvr2_display_list *cur_list = core->disp_lists + ta->cur_list_idx;
     if (ta->cur_list_idx >= PVR2_MAX_FRAMES_IN_FLIGHT || !cur_list->valid)
         RAISE_ERROR(ERROR_INTEGRITY);
-    float *verts_out = alloc_disp_list_verts(cur_list, 4);
+    void *verts_out = alloc_disp_list_verts(pvr2, cur_list, 4);
 
     if (!verts_out)
         return;
 
+    /*
+     * in the packed format, the vertices get built as floats on the stack and
+     * then packed into the display list at the end.
+     */
+    bool packed = core->vert_fmt == GFX_VERT_FMT_PACKED;
+    float quad_verts[4 * GFX_VERT_LEN];
+    float *quad_out = packed ? quad_verts : (float*)verts_out;
+
     close_tri_strip(pvr2);
     struct pvr2_display_list_command *cmd =
         pvr2_list_alloc_new_cmd(cur_list, ta->fifo_state.cur_poly_type);
@@ -562,10 +728,10 @@ on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     cmd->quad.first_vtx = cur_list->n_verts - 4;
 
     float *vp[4] = {
-        verts_out,
-        verts_out + GFX_VERT_LEN,
-        verts_out + GFX_VERT_LEN * 2,
-        verts_out + GFX_VERT_LEN * 3
+        quad_out,
+        quad_out + GFX_VERT_LEN,
+        quad_out + GFX_VERT_LEN * 2,
+        quad_out + GFX_VERT_LEN * 3
     };
     vp[0][GFX_VERT_POS_OFFSET + 0] = quad->vert_pos[1][0];
     vp[0][GFX_VERT_POS_OFFSET + 1] = quad->vert_pos[1][1];
@@ -629,6 +795,17 @@ on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     vp[3][GFX_VERT_TEX_COORD_OFFSET + 1] =
         vp[0][GFX_VERT_TEX_COORD_OFFSET + 1] + uv_vec[0][1] + uv_vec[1][1];
 
+    if (packed) {
+        unsigned vert_no;
+        for (vert_no = 0; vert_no < 4; vert_no++) {
+            pack_vert((char*)verts_out + vert_no * GFX_PACKED_VERT_SIZE,
+                      vp[vert_no] + GFX_VERT_POS_OFFSET,
+                      vp[vert_no] + GFX_VERT_BASE_COLOR_OFFSET,
+                      vp[vert_no] + GFX_VERT_OFFS_COLOR_OFFSET,
+                      vp[vert_no] + GFX_VERT_TEX_COORD_OFFSET);
+        }
+    }
+
     // update display list depth clipping
     if (!isinf(quad->vert_pos[0][2]) &&
         !isnan(quad->vert_pos[0][2]) &&
@@ -664,11 +841,13 @@ on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     }
 }
 
-static void
-on_pkt_vtx_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
+/*
+ * src points to a complete vertex parameter, which is either in ta_fifo32 or
+ * still in the buffer that was handed to pvr2_tafifo_input_burst.
+ */
+static void on_vtx_received(struct pvr2 *pvr2, uint32_t const *src) {
     struct pvr2_ta *ta = &pvr2->ta;
     struct pvr2_core *core = &pvr2->core;
-    struct pvr2_pkt_vtx const *vtx = &pkt->dat.vtx;
 
 #ifdef INVARIANTS
     if (ta->fifo_state.geo_tp != PVR2_HDR_TRIANGLE_STRIP)
@@ -677,6 +856,11 @@ on_pkt_vtx_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
 
     ta->fifo_state.open_group = true;
 
+    if (ta->fifo_state.mod_vol) {
+        on_mod_vol_tri_received(pvr2, src);
+        return;
+    }
+
     if (ta->fifo_state.cur_poly_type >= PVR2_POLY_TYPE_FIRST &&
         ta->fifo_state.cur_poly_type <= PVR2_POLY_TYPE_LAST) {
         // queue up in a display list
@@ -716,7 +900,8 @@ on_pkt_vtx_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
          * actually be a situation with an unreasonably large depth range so we'd
          * ideally want to let that through.
          */
-        float depth = vtx->pos[2];
+        float depth;
+        memcpy(&depth, src + 3, sizeof(depth));
         if (!isinf(depth) && !isnan(depth) && fabsf(depth) < 1024 * 1024) {
             if (depth < cur_list->clip_min)
                 cur_list->clip_min = depth;
@@ -724,16 +909,12 @@ on_pkt_vtx_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
                 cur_list->clip_max = depth;
         }
 
-        float *vtx_out = alloc_disp_list_verts(cur_list, 1);
+        void *vtx_dst = alloc_disp_list_verts(pvr2, cur_list, 1);
 
-        if (!vtx_out)
+        if (!vtx_dst)
             return;
 
-        memcpy(vtx_out + GFX_VERT_POS_OFFSET, vtx->pos, sizeof(float) * 3);
-        vtx_out[GFX_VERT_POS_OFFSET + 3] = 1.0f;
-        memcpy(vtx_out + GFX_VERT_BASE_COLOR_OFFSET, vtx->base_color, sizeof(float) * 4);
-        memcpy(vtx_out + GFX_VERT_OFFS_COLOR_OFFSET, vtx->offs_color, sizeof(float) * 4);
-        memcpy(vtx_out + GFX_VERT_TEX_COORD_OFFSET, vtx->uv, sizeof(float) * 2);
+        ta->fifo_state.vtx_emit(&ta->fifo_state, src, vtx_dst);
 
         if (!ta->fifo_state.open_tri_strip) {
             ta->fifo_state.cur_tri_strip_start = cur_list->n_verts - 1;
@@ -742,11 +923,84 @@ on_pkt_vtx_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
         }
         ta->fifo_state.cur_tri_strip_len++;
 
-        if (vtx->end_of_strip)
+        if (src[0] & TA_CMD_END_OF_STRIP_MASK)
             close_tri_strip(pvr2);
     }
 }
 
+/*
+ * modifier volume vertex parameters are a single triangle.  Consecutive
+ * triangles from the same volume get a single display list command.
+ */
+static void on_mod_vol_tri_received(struct pvr2 *pvr2, uint32_t const *src) {
+    struct pvr2_ta *ta = &pvr2->ta;
+    struct pvr2_core *core = &pvr2->core;
+    enum pvr2_poly_type poly_type = ta->fifo_state.cur_poly_type;
+
+    if (poly_type < PVR2_POLY_TYPE_FIRST || poly_type > PVR2_POLY_TYPE_LAST)
+        return;
+
+    struct pvr2_display_list *cur_list = core->disp_lists + ta->cur_list_idx;
+    if (ta->cur_list_idx >= PVR2_MAX_FRAMES_IN_FLIGHT || !cur_list->valid)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    void *verts_out = alloc_disp_list_verts(pvr2, cur_list, 3);
+    if (!verts_out)
+        return;
+    unsigned first_vtx = cur_list->n_verts - 3;
+
+    struct pvr2_display_list_group *group = cur_list->poly_groups + poly_type;
+    struct pvr2_display_list_command *cmd = NULL;
+    if (ta->fifo_state.open_mod_vol &&
+        ta->fifo_state.mod_vol_cmd < group->n_cmds) {
+        cmd = group->cmds + ta->fifo_state.mod_vol_cmd;
+
+        // the volume's vertices need to be contiguous
+        if (cmd->tp != PVR2_DISPLAY_LIST_COMMAND_TP_MOD_VOL ||
+            cmd->mod_vol.first_vtx + cmd->mod_vol.vtx_count != first_vtx) {
+            LOG_DBG("PVR2: splitting modifier volume\n");
+            cmd = NULL;
+        }
+    }
+
+    if (!cmd) {
+        cmd = pvr2_list_alloc_new_cmd(cur_list, poly_type);
+        if (!cmd) {
+            LOG_ERROR("%s unable to allocate display list entry!\n", __func__);
+            return;
+        }
+        cmd->tp = PVR2_DISPLAY_LIST_COMMAND_TP_MOD_VOL;
+        cmd->mod_vol.first_vtx = first_vtx;
+        cmd->mod_vol.vtx_count = 0;
+        ta->fifo_state.open_mod_vol = true;
+        ta->fifo_state.mod_vol_cmd = cmd - group->cmds;
+    }
+    cmd->mod_vol.vtx_count += 3;
+    cmd->mod_vol.outside = ta->fifo_state.mod_vol_outside;
+
+    /*
+     * only the positions matter.  These don't go into the display list's
+     * depth clipping because volumes tend to extend well past the geometry
+     * they're shadowing, and GL_DEPTH_CLAMP takes care of that.
+     */
+    float const zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    unsigned vert_no;
+    for (vert_no = 0; vert_no < 3; vert_no++) {
+        float pos[4];
+        memcpy(pos, src + 1 + 3 * vert_no, 3 * sizeof(float));
+        pos[3] = 1.0f;
+
+        if (core->vert_fmt == GFX_VERT_FMT_PACKED) {
+            pack_vert((char*)verts_out + vert_no * GFX_PACKED_VERT_SIZE,
+                      pos, zero, zero, zero);
+        } else {
+            float *vert = (float*)verts_out + vert_no * GFX_VERT_LEN;
+            memset(vert, 0, GFX_VERT_LEN * sizeof(float));
+            memcpy(vert + GFX_VERT_POS_OFFSET, pos, sizeof(pos));
+        }
+    }
+}
+
 static void close_tri_strip(struct pvr2 *pvr2) {
     struct pvr2_ta *ta = &pvr2->ta;
     struct pvr2_core *core = &pvr2->core;
@@ -833,9 +1087,14 @@ static void handle_packet(struct pvr2 *pvr2) {
         break;
     case TA_CMD_TYPE_VERTEX:
         if (ta->fifo_state.geo_tp == PVR2_HDR_TRIANGLE_STRIP) {
-            if (decode_vtx(pvr2, &pkt) == 0) {
+            unsigned word_count = ta->fifo_state.ta_fifo_word_count;
+            if (word_count > ta->fifo_state.vtx_len) {
+                LOG_ERROR("byte count is %u, vtx_len is %u\n",
+                          word_count * 4, ta->fifo_state.vtx_len * 4);
+                RAISE_ERROR(ERROR_INTEGRITY);
+            } else if (word_count == ta->fifo_state.vtx_len) {
                 PVR2_TRACE("vertex packet received\n");
-                on_pkt_vtx_received(pvr2, &pkt);
+                on_vtx_received(pvr2, ta_fifo32);
                 ta_fifo_finish_packet(ta);
             }
         } else {
@@ -890,8 +1149,59 @@ void pvr2_tafifo_input(struct pvr2 *pvr2, uint32_t dword) {
     struct pvr2_ta *ta = &pvr2->ta;
     ta->fifo_state.ta_fifo32[ta->fifo_state.ta_fifo_word_count++] = dword;
 
-    if (!(ta->fifo_state.ta_fifo_word_count % 8))
+    if (!(ta->fifo_state.ta_fifo_word_count % 8)) {
+        enum bench_sect bench_prev = bench_enter(BENCH_TA);
+        PERF_TIMER_BEGIN(PERF_TA_PACKET);
         handle_packet(pvr2);
+        PERF_TIMER_END(PERF_TA_PACKET);
+        bench_leave(bench_prev);
+    }
+}
+
+void pvr2_tafifo_input_burst(struct pvr2 *pvr2, uint32_t const *dwords,
+                             unsigned n_dwords) {
+    struct pvr2_ta *ta = &pvr2->ta;
+    enum bench_sect bench_prev = bench_enter(BENCH_TA);
+
+    while (n_dwords) {
+        unsigned word_count = ta->fifo_state.ta_fifo_word_count;
+        unsigned vtx_len = ta->fifo_state.vtx_len;
+
+        /*
+         * complete triangle-strip vertices at a packet boundary get decoded
+         * straight out of the caller's buffer instead of being staged in
+         * ta_fifo32 first.
+         */
+        if (!word_count && vtx_len && n_dwords >= vtx_len &&
+            ta->fifo_state.geo_tp == PVR2_HDR_TRIANGLE_STRIP &&
+            ((dwords[0] & TA_CMD_TYPE_MASK) >> TA_CMD_TYPE_SHIFT) ==
+            TA_CMD_TYPE_VERTEX) {
+            PVR2_TRACE("vertex packet received\n");
+            on_vtx_received(pvr2, dwords);
+            dwords += vtx_len;
+            n_dwords -= vtx_len;
+            continue;
+        }
+
+        // copy up to the next 32-byte boundary, which is where packets end
+        unsigned n_copy = 8 - word_count % 8;
+        if (n_copy > n_dwords)
+            n_copy = n_dwords;
+
+        memcpy(ta->fifo_state.ta_fifo32 + word_count, dwords,
+               n_copy * sizeof(uint32_t));
+        ta->fifo_state.ta_fifo_word_count = word_count + n_copy;
+        dwords += n_copy;
+        n_dwords -= n_copy;
+
+        if (!(ta->fifo_state.ta_fifo_word_count % 8)) {
+            PERF_TIMER_BEGIN(PERF_TA_PACKET);
+            handle_packet(pvr2);
+            PERF_TIMER_END(PERF_TA_PACKET);
+        }
+    }
+
+    bench_leave(bench_prev);
 }
 
 static void dump_fifo(struct pvr2 *pvr2) {
@@ -1025,168 +1335,221 @@ static int decode_quad(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
     return 0;
 }
 
-static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
-    struct pvr2_ta *ta = &pvr2->ta;
-    uint32_t const *ta_fifo32 = (uint32_t const*)ta->fifo_state.ta_fifo32;
-
-    if (ta->fifo_state.ta_fifo_word_count < ta->fifo_state.vtx_len)
-        return -1;
-    else if (ta->fifo_state.ta_fifo_word_count > ta->fifo_state.vtx_len) {
-        LOG_ERROR("byte count is %u, vtx_len is %u\n",
-                  ta->fifo_state.ta_fifo_word_count * 4, ta->fifo_state.vtx_len * 4);
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
+enum vtx_tex_mode {
+    VTX_TEX_NONE,
+    VTX_TEX_FLOAT,
+    VTX_TEX_UV16,
 
-    pkt->tp = PVR2_PKT_VTX;
-    struct pvr2_pkt_vtx *vtx = &pkt->dat.vtx;
+    VTX_TEX_MODE_COUNT
+};
 
-    vtx->end_of_strip = (bool)(ta_fifo32[0] & TA_CMD_END_OF_STRIP_MASK);
+enum vtx_color_mode {
+    VTX_COLOR_PACKED,
+    VTX_COLOR_FLOAT,
+    VTX_COLOR_INTENSITY,
 
-    memcpy(vtx->pos, ta_fifo32 + 1, 3 * sizeof(float));
+    VTX_COLOR_MODE_COUNT
+};
 
-    if (ta->fifo_state.tex_enable) {
-        if (ta->fifo_state.tex_coord_16_bit_enable)
-            unpack_uv16(vtx->uv, vtx->uv + 1, ta_fifo32 + 4);
-        else
-            memcpy(vtx->uv, ta_fifo32 + 4, 2 * sizeof(float));
+/*
+ * the vertex formats are all decoded here.  Every parameter after vert_out is
+ * always a compile-time constant so that each of the emitters instantiated
+ * below only contains the code for its own format.
+ */
+static inline void
+decode_vtx_common(struct pvr2_fifo_state const *fifo_state,
+                  uint32_t const *src, float *vert_out,
+                  enum vtx_tex_mode tex_mode, enum vtx_color_mode color_mode,
+                  bool two_volumes, bool offset_color_enable) {
+    float *pos = vert_out + GFX_VERT_POS_OFFSET;
+    float *base_color = vert_out + GFX_VERT_BASE_COLOR_OFFSET;
+    float *offs_color = vert_out + GFX_VERT_OFFS_COLOR_OFFSET;
+    float *uv = vert_out + GFX_VERT_TEX_COORD_OFFSET;
+    bool tex_enable = tex_mode != VTX_TEX_NONE;
+
+    memcpy(pos, src + 1, 3 * sizeof(float));
+    pos[3] = 1.0f;
+
+    if (tex_mode == VTX_TEX_UV16) {
+        unpack_uv16(uv, uv + 1, src + 4);
+    } else if (tex_mode == VTX_TEX_FLOAT) {
+        memcpy(uv, src + 4, 2 * sizeof(float));
+    } else {
+        uv[0] = 0.0f;
+        uv[1] = 0.0f;
     }
 
-    if (ta->fifo_state.two_volumes_mode) {
-        switch (ta->fifo_state.ta_color_fmt) {
-        case TA_COLOR_TYPE_PACKED:
-            if (ta->fifo_state.tex_enable)
-                unpack_rgba_8888(ta_fifo32, vtx->base_color, ta_fifo32[6]);
-            else
-                unpack_rgba_8888(ta_fifo32, vtx->base_color, ta_fifo32[4]);
-            if (ta->fifo_state.offset_color_enable && ta->fifo_state.tex_enable) {
-                unpack_rgba_8888(ta_fifo32, vtx->offs_color, ta_fifo32[7]);
+    /*
+     * untextured two-volume vertices put the color where the texture
+     * coordinates would have been; everything else has it in word 6.
+     */
+    unsigned color_idx = (two_volumes && !tex_enable) ? 4 : 6;
+
+    switch (color_mode) {
+    case VTX_COLOR_PACKED:
+        unpack_rgba_8888(base_color, src[color_idx]);
+        if (offset_color_enable && (tex_enable || !two_volumes))
+            unpack_rgba_8888(offs_color, src[color_idx + 1]);
+        else
+            memset(offs_color, 0, 4 * sizeof(float));
+        break;
+    case VTX_COLOR_INTENSITY:
+        {
+            float base_intensity, offs_intensity;
+            memcpy(&base_intensity, src + color_idx, sizeof(float));
+            memcpy(&offs_intensity, src + color_idx + 1, sizeof(float));
+            base_color[0] = base_intensity * fifo_state->poly_base_color_rgba[0];
+            base_color[1] = base_intensity * fifo_state->poly_base_color_rgba[1];
+            base_color[2] = base_intensity * fifo_state->poly_base_color_rgba[2];
+            base_color[3] = fifo_state->poly_base_color_rgba[3];
+            if (offset_color_enable) {
+                offs_color[0] =
+                    offs_intensity * fifo_state->poly_offs_color_rgba[0];
+                offs_color[1] =
+                    offs_intensity * fifo_state->poly_offs_color_rgba[1];
+                offs_color[2] =
+                    offs_intensity * fifo_state->poly_offs_color_rgba[2];
+                offs_color[3] = fifo_state->poly_offs_color_rgba[3];
             } else {
-                vtx->offs_color[0] = 0.0f;
-                vtx->offs_color[1] = 0.0f;
-                vtx->offs_color[2] = 0.0f;
-                vtx->offs_color[3] = 0.0f;
-            }
-            break;
-        case TA_COLOR_TYPE_INTENSITY_MODE_1:
-        case TA_COLOR_TYPE_INTENSITY_MODE_2:
-            {
-                float base_intensity, offs_intensity;
-                if (ta->fifo_state.tex_enable) {
-                    memcpy(&base_intensity, ta_fifo32 + 6, sizeof(float));
-                    memcpy(&offs_intensity, ta_fifo32 + 7, sizeof(float));
-                } else {
-                    memcpy(&base_intensity, ta_fifo32 + 4, sizeof(float));
-                    memcpy(&offs_intensity, ta_fifo32 + 5, sizeof(float));
-                }
-                vtx->base_color[0] =
-                    base_intensity * ta->fifo_state.poly_base_color_rgba[0];
-                vtx->base_color[1] =
-                    base_intensity * ta->fifo_state.poly_base_color_rgba[1];
-                vtx->base_color[2] =
-                    base_intensity * ta->fifo_state.poly_base_color_rgba[2];
-                vtx->base_color[3] = ta->fifo_state.poly_base_color_rgba[3];
-                if (ta->fifo_state.offset_color_enable) {
-                    vtx->offs_color[0] =
-                        offs_intensity * ta->fifo_state.poly_offs_color_rgba[0];
-                    vtx->offs_color[1] =
-                        offs_intensity * ta->fifo_state.poly_offs_color_rgba[1];
-                    vtx->offs_color[2] =
-                        offs_intensity * ta->fifo_state.poly_offs_color_rgba[2];
-                    vtx->offs_color[3] = ta->fifo_state.poly_offs_color_rgba[3];
-                } else {
-                    vtx->offs_color[0] = 0.0f;
-                    vtx->offs_color[1] = 0.0f;
-                    vtx->offs_color[2] = 0.0f;
-                    vtx->offs_color[3] = 0.0f;
-                }
+                memset(offs_color, 0, 4 * sizeof(float));
             }
-            break;
-        case TA_COLOR_TYPE_FLOAT:
-            // this is not supported, AFAIK
-        default:
-            RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
-    } else {
-        switch (ta->fifo_state.ta_color_fmt) {
-        case TA_COLOR_TYPE_PACKED:
-            unpack_rgba_8888(ta_fifo32, vtx->base_color, ta_fifo32[6]);
-            if (ta->fifo_state.offset_color_enable) {
-                unpack_rgba_8888(ta_fifo32, vtx->offs_color, ta_fifo32[7]);
-            } else {
-                vtx->offs_color[0] = 0.0f;
-                vtx->offs_color[1] = 0.0f;
-                vtx->offs_color[2] = 0.0f;
-                vtx->offs_color[3] = 0.0f;
-            }
-            break;
-        case TA_COLOR_TYPE_FLOAT:
-            if (ta->fifo_state.tex_enable) {
-                memcpy(vtx->base_color + 3, ta_fifo32 + 8, sizeof(float));
-                memcpy(vtx->base_color + 0, ta_fifo32 + 9, sizeof(float));
-                memcpy(vtx->base_color + 1, ta_fifo32 + 10, sizeof(float));
-                memcpy(vtx->base_color + 2, ta_fifo32 + 11, sizeof(float));
-                if (ta->fifo_state.offset_color_enable) {
-                    memcpy(vtx->offs_color + 3, ta_fifo32 + 12,
-                           sizeof(float));
-                    memcpy(vtx->offs_color + 0, ta_fifo32 + 13,
-                           sizeof(float));
-                    memcpy(vtx->offs_color + 1, ta_fifo32 + 14,
-                           sizeof(float));
-                    memcpy(vtx->offs_color + 2, ta_fifo32 + 15,
-                           sizeof(float));
-                } else {
-                    vtx->offs_color[0] = 0.0f;
-                    vtx->offs_color[1] = 0.0f;
-                    vtx->offs_color[2] = 0.0f;
-                    vtx->offs_color[3] = 0.0f;
-                }
+        break;
+    case VTX_COLOR_FLOAT:
+        // this is not supported in two-volumes mode, AFAIK
+        if (two_volumes)
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
+
+        if (tex_enable) {
+            memcpy(base_color + 3, src + 8, sizeof(float));
+            memcpy(base_color, src + 9, 3 * sizeof(float));
+            if (offset_color_enable) {
+                memcpy(offs_color + 3, src + 12, sizeof(float));
+                memcpy(offs_color, src + 13, 3 * sizeof(float));
             } else {
-                memcpy(vtx->base_color + 3, ta_fifo32 + 4, sizeof(float));
-                memcpy(vtx->base_color + 0, ta_fifo32 + 5, sizeof(float));
-                memcpy(vtx->base_color + 1, ta_fifo32 + 6, sizeof(float));
-                memcpy(vtx->base_color + 2, ta_fifo32 + 7, sizeof(float));
-
-                vtx->offs_color[0] = 0.0f;
-                vtx->offs_color[1] = 0.0f;
-                vtx->offs_color[2] = 0.0f;
-                vtx->offs_color[3] = 0.0f;
+                memset(offs_color, 0, 4 * sizeof(float));
             }
-            break;
-        case TA_COLOR_TYPE_INTENSITY_MODE_1:
-        case TA_COLOR_TYPE_INTENSITY_MODE_2:
-            {
-                float base_intensity, offs_intensity;
-                memcpy(&base_intensity, ta_fifo32 + 6, sizeof(float));
-                memcpy(&offs_intensity, ta_fifo32 + 7, sizeof(float));
-                vtx->base_color[0] =
-                    base_intensity * ta->fifo_state.poly_base_color_rgba[0];
-                vtx->base_color[1] =
-                    base_intensity * ta->fifo_state.poly_base_color_rgba[1];
-                vtx->base_color[2] =
-                    base_intensity * ta->fifo_state.poly_base_color_rgba[2];
-                vtx->base_color[3] = ta->fifo_state.poly_base_color_rgba[3];
-                if (ta->fifo_state.offset_color_enable) {
-                    vtx->offs_color[0] =
-                        offs_intensity * ta->fifo_state.poly_offs_color_rgba[0];
-                    vtx->offs_color[1] =
-                        offs_intensity * ta->fifo_state.poly_offs_color_rgba[1];
-                    vtx->offs_color[2] =
-                        offs_intensity * ta->fifo_state.poly_offs_color_rgba[2];
-                    vtx->offs_color[3] = ta->fifo_state.poly_offs_color_rgba[3];
-                } else {
-                    vtx->offs_color[0] = 0.0f;
-                    vtx->offs_color[1] = 0.0f;
-                    vtx->offs_color[2] = 0.0f;
-                    vtx->offs_color[3] = 0.0f;
-                }
-            }
-            break;
-        default:
-            RAISE_ERROR(ERROR_INTEGRITY);
+        } else {
+            memcpy(base_color + 3, src + 4, sizeof(float));
+            memcpy(base_color, src + 5, 3 * sizeof(float));
+            memset(offs_color, 0, 4 * sizeof(float));
         }
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
     }
+}
 
-    return 0;
+// decode a vertex and write it to vert_out in the display list's format
+static inline void
+emit_vtx_common(struct pvr2_fifo_state const *fifo_state,
+                uint32_t const *src, void *vert_out,
+                enum vtx_tex_mode tex_mode, enum vtx_color_mode color_mode,
+                bool two_volumes, bool offset_color_enable, bool packed) {
+    if (packed) {
+        float vert[GFX_VERT_LEN];
+        decode_vtx_common(fifo_state, src, vert, tex_mode, color_mode,
+                          two_volumes, offset_color_enable);
+        pack_vert(vert_out, vert + GFX_VERT_POS_OFFSET,
+                  vert + GFX_VERT_BASE_COLOR_OFFSET,
+                  vert + GFX_VERT_OFFS_COLOR_OFFSET,
+                  vert + GFX_VERT_TEX_COORD_OFFSET);
+    } else {
+        decode_vtx_common(fifo_state, src, (float*)vert_out, tex_mode,
+                          color_mode, two_volumes, offset_color_enable);
+    }
+}
+
+#define DEF_VTX_EMITTER(name, tex_mode, color_mode, two_volumes, offs, packed) \
+    static void name(struct pvr2_fifo_state const *fifo_state,          \
+                     uint32_t const *src, void *vert_out) {             \
+        emit_vtx_common(fifo_state, src, vert_out, tex_mode,            \
+                        color_mode, two_volumes, offs, packed);         \
+    }
+
+// one emitter for each texture coordinate format
+#define DEF_VTX_EMITTERS_TEX(name, color_mode, two_volumes, offs, packed) \
+    DEF_VTX_EMITTER(name, VTX_TEX_NONE,                                 \
+                    color_mode, two_volumes, offs, packed)              \
+    DEF_VTX_EMITTER(name##_tex, VTX_TEX_FLOAT,                          \
+                    color_mode, two_volumes, offs, packed)              \
+    DEF_VTX_EMITTER(name##_uv16, VTX_TEX_UV16,                          \
+                    color_mode, two_volumes, offs, packed)
+
+// ...and each color format
+#define DEF_VTX_EMITTERS(name, two_volumes, offs, packed)               \
+    DEF_VTX_EMITTERS_TEX(name##_packed, VTX_COLOR_PACKED,               \
+                         two_volumes, offs, packed)                     \
+    DEF_VTX_EMITTERS_TEX(name##_float, VTX_COLOR_FLOAT,                 \
+                         two_volumes, offs, packed)                     \
+    DEF_VTX_EMITTERS_TEX(name##_intensity, VTX_COLOR_INTENSITY,         \
+                         two_volumes, offs, packed)
+
+DEF_VTX_EMITTERS(emit_vtx, false, false, false)
+DEF_VTX_EMITTERS(emit_vtx_offs, false, true, false)
+DEF_VTX_EMITTERS(emit_vtx_two_vol, true, false, false)
+DEF_VTX_EMITTERS(emit_vtx_two_vol_offs, true, true, false)
+DEF_VTX_EMITTERS(emit_packed_vtx, false, false, true)
+DEF_VTX_EMITTERS(emit_packed_vtx_offs, false, true, true)
+DEF_VTX_EMITTERS(emit_packed_vtx_two_vol, true, false, true)
+DEF_VTX_EMITTERS(emit_packed_vtx_two_vol_offs, true, true, true)
+
+#define VTX_EMITTERS_TEX(name) { name, name##_tex, name##_uv16 }
+
+#define VTX_EMITTERS(name)                                              \
+    {                                                                   \
+        [VTX_COLOR_PACKED] = VTX_EMITTERS_TEX(name##_packed),           \
+        [VTX_COLOR_FLOAT] = VTX_EMITTERS_TEX(name##_float),             \
+        [VTX_COLOR_INTENSITY] = VTX_EMITTERS_TEX(name##_intensity)      \
+    }
+
+// indexed by [packed][two_volumes][offset_color][color_mode][tex_mode]
+static pvr2_vtx_emit_func const
+vtx_emitters[2][2][2][VTX_COLOR_MODE_COUNT][VTX_TEX_MODE_COUNT] = {
+    {
+        { VTX_EMITTERS(emit_vtx), VTX_EMITTERS(emit_vtx_offs) },
+        { VTX_EMITTERS(emit_vtx_two_vol), VTX_EMITTERS(emit_vtx_two_vol_offs) }
+    },
+    {
+        { VTX_EMITTERS(emit_packed_vtx), VTX_EMITTERS(emit_packed_vtx_offs) },
+        {
+            VTX_EMITTERS(emit_packed_vtx_two_vol),
+            VTX_EMITTERS(emit_packed_vtx_two_vol_offs)
+        }
+    }
+};
+
+static pvr2_vtx_emit_func
+select_vtx_emitter(struct pvr2_fifo_state const *fifo_state,
+                   enum gfx_vert_fmt vert_fmt) {
+    enum vtx_tex_mode tex_mode;
+    enum vtx_color_mode color_mode;
+
+    if (!fifo_state->tex_enable)
+        tex_mode = VTX_TEX_NONE;
+    else if (fifo_state->tex_coord_16_bit_enable)
+        tex_mode = VTX_TEX_UV16;
+    else
+        tex_mode = VTX_TEX_FLOAT;
+
+    switch (fifo_state->ta_color_fmt) {
+    case TA_COLOR_TYPE_PACKED:
+        color_mode = VTX_COLOR_PACKED;
+        break;
+    case TA_COLOR_TYPE_FLOAT:
+        color_mode = VTX_COLOR_FLOAT;
+        break;
+    case TA_COLOR_TYPE_INTENSITY_MODE_1:
+    case TA_COLOR_TYPE_INTENSITY_MODE_2:
+        color_mode = VTX_COLOR_INTENSITY;
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    return vtx_emitters[vert_fmt == GFX_VERT_FMT_PACKED]
+        [fifo_state->two_volumes_mode][fifo_state->offset_color_enable]
+        [color_mode][tex_mode];
 }
 
 static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
@@ -1363,11 +1726,11 @@ static int decode_input_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
     return 0;
 }
 
-static void unpack_rgba_8888(uint32_t const *ta_fifo32, float *rgba, uint32_t input) {
-    float alpha = (float)((ta_fifo32[6] & 0xff000000) >> 24) / 255.0f;
-    float red = (float)((ta_fifo32[6] & 0x00ff0000) >> 16) / 255.0f;
-    float green = (float)((ta_fifo32[6] & 0x0000ff00) >> 8) / 255.0f;
-    float blue = (float)((ta_fifo32[6] & 0x000000ff) >> 0) / 255.0f;
+static void unpack_rgba_8888(float *rgba, uint32_t input) {
+    float alpha = (float)((input & 0xff000000) >> 24) / 255.0f;
+    float red = (float)((input & 0x00ff0000) >> 16) / 255.0f;
+    float green = (float)((input & 0x0000ff00) >> 8) / 255.0f;
+    float blue = (float)((input & 0x000000ff) >> 0) / 255.0f;
 
     rgba[0] = red;
     rgba[1] = green;
@@ -1419,6 +1782,7 @@ void pvr2_ta_reinit(struct pvr2 *pvr2) {
         set_poly_type_state(ta, poly_type, PVR2_POLY_TYPE_STATE_NOT_OPENED);
     ta->fifo_state.open_group = false;
     ta->fifo_state.cur_poly_type = PVR2_POLY_TYPE_NONE;
+    close_mod_vol(ta);
 
     pvr2_display_list_key key = pvr2->reg_backing[PVR2_TA_VERTBUF_POS];
     struct pvr2_display_list *cur_list = NULL;
@@ -1528,7 +1892,8 @@ struct memory_interface pvr2_ta_fifo_intf = {
     .writefloat = pvr2_ta_fifo_poly_write_float,
     .write32 = pvr2_ta_fifo_poly_write_32,
     .write16 = pvr2_ta_fifo_poly_write_16,
-    .write8 = pvr2_ta_fifo_poly_write_8
+    .write8 = pvr2_ta_fifo_poly_write_8,
+    .write_dwords = pvr2_ta_fifo_poly_write_dwords
 };
 
 unsigned pvr2_ta_fifo_rem_bytes(void) {
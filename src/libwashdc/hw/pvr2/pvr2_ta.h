@@ -54,6 +54,8 @@ double pvr2_ta_fifo_poly_read_double(addr32_t addr, void *ctxt);
 void pvr2_ta_fifo_poly_write_double(addr32_t addr, double val, void *ctxt);
 uint32_t pvr2_ta_fifo_poly_read_32(addr32_t addr, void *ctxt);
 void pvr2_ta_fifo_poly_write_32(addr32_t addr, uint32_t val, void *ctxt);
+void pvr2_ta_fifo_poly_write_dwords(addr32_t addr, uint32_t const *src,
+                                    unsigned n_dwords, void *ctxt);
 uint16_t pvr2_ta_fifo_poly_read_16(addr32_t addr, void *ctxt);
 void pvr2_ta_fifo_poly_write_16(addr32_t addr, uint16_t val, void *ctxt);
 uint8_t pvr2_ta_fifo_poly_read_8(addr32_t addr, void *ctxt);
@@ -72,23 +74,25 @@ void pvr2_ta_reinit(struct pvr2 *pvr2);
 void pvr2_ta_init(struct pvr2 *pvr2);
 void pvr2_ta_cleanup(struct pvr2 *pvr2);
 
+/*
+ * save-state section for the TA (ctxt is the pvr2).  The display list that's
+ * being built lives on the host, so it doesn't get saved; a checkpoint taken
+ * while a polygon group is open loses whatever was already put into it.
+ */
+struct savestate_buf;
+void pvr2_ta_state_save(struct savestate_buf *buf, void *ctxt);
+int pvr2_ta_state_load(struct savestate_buf *buf, void *ctxt);
+
+// true if a polygon group is open or an end-of-list interrupt is pending
+bool pvr2_ta_busy(struct pvr2 *pvr2);
+
 enum pvr2_pkt_tp {
     PVR2_PKT_HDR,
-    PVR2_PKT_VTX,
     PVR2_PKT_END_OF_LIST,
     PVR2_PKT_INPUT_LIST,
     PVR2_PKT_USER_CLIP
 };
 
-struct pvr2_pkt_vtx {
-    float pos[3];
-    float base_color[4];
-    float offs_color[4];
-    float uv[2];
-
-    bool end_of_strip;
-};
-
 struct pvr2_pkt_quad {
     /*
      * four vertices consisting of 3-component poistions
@@ -177,6 +181,25 @@ pvr2_hdr_shadow(struct pvr2_pkt_hdr const *hdr) {
     return hdr->param[0] & TA_CMD_SHADOW_MASK;
 }
 
+/*
+ * in modifier volume headers, this says whether the triangles after the header
+ * are the last ones in their volume, and if so whether the volume affects the
+ * pixels inside of it or the pixels outside of it.
+ */
+enum pvr2_mod_vol_inst {
+    PVR2_MOD_VOL_INST_NORMAL = 0,
+    PVR2_MOD_VOL_INST_INSIDE_LAST = 1,
+    PVR2_MOD_VOL_INST_OUTSIDE_LAST = 2
+};
+
+#define ISP_MOD_VOL_INST_SHIFT 29
+#define ISP_MOD_VOL_INST_MASK (7 << ISP_MOD_VOL_INST_SHIFT)
+static inline enum pvr2_mod_vol_inst
+pvr2_hdr_mod_vol_inst(struct pvr2_pkt_hdr const *hdr) {
+    return (enum pvr2_mod_vol_inst)((hdr->param[1] & ISP_MOD_VOL_INST_MASK) >>
+                                    ISP_MOD_VOL_INST_SHIFT);
+}
+
 #define TEX_CTRL_VQ_SHIFT 30
 #define TEX_CTRL_VQ_MASK (1 << TEX_CTRL_VQ_SHIFT)
 static inline bool
@@ -384,7 +407,6 @@ struct pvr2_pkt_user_clip {
 };
 
 union pvr2_pkt_inner {
-    struct pvr2_pkt_vtx vtx;
     struct pvr2_pkt_quad quad;
     struct pvr2_pkt_hdr hdr;
     struct pvr2_pkt_user_clip user_clip;
@@ -428,6 +450,15 @@ enum pvr2_poly_type_state {
  * would be updated by processing the display lists generated by the FIFO
  * packets in a STARTRENDER command does not belong here.
  */
+struct pvr2_fifo_state;
+
+/*
+ * decodes a triangle-strip vertex parameter from src and writes it to
+ * vert_out in the display list's vertex format.
+ */
+typedef void (*pvr2_vtx_emit_func)(struct pvr2_fifo_state const *fifo_state,
+                                   uint32_t const *src, void *vert_out);
+
 struct pvr2_fifo_state {
     /**************************************************************************
      *
@@ -492,12 +523,30 @@ struct pvr2_fifo_state {
     // if there's an open group, this is the length of the vertex packets
     unsigned vtx_len;
 
+    /*
+     * chosen when the header is received based on the vertex parameter type
+     * so that the per-vertex path doesn't need to look at the header state.
+     */
+    pvr2_vtx_emit_func vtx_emit;
+
     // current geometry type (either triangle strips or quads)
     enum pvr2_hdr_tp geo_tp;
 
     bool open_tri_strip;
     unsigned cur_tri_strip_start, cur_tri_strip_len;
 
+    // the vertices are modifier volume triangles
+    bool mod_vol;
+
+    /*
+     * if open_mod_vol is true then mod_vol_cmd is the index of the volume's
+     * command in the current polygon group.  mod_vol_last means the triangles
+     * after the most recent header are the last ones in that volume.
+     */
+    bool open_mod_vol;
+    unsigned mod_vol_cmd;
+    bool mod_vol_last, mod_vol_outside;
+
 
     /**************************************************************************
      *
@@ -552,6 +601,10 @@ struct pvr2_ta_param_dims pvr2_ta_get_param_dims(unsigned control_word);
  */
 void pvr2_tafifo_input(struct pvr2 *pvr2, uint32_t dword);
 
+// same as calling pvr2_tafifo_input for each of the n_dwords in dwords
+void pvr2_tafifo_input_burst(struct pvr2 *pvr2, uint32_t const *dwords,
+                             unsigned n_dwords);
+
 void pvr2_ta_list_continue(struct pvr2 *pvr2);
 
 #endif
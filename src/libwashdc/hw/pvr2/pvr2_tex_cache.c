@@ -26,6 +26,10 @@
 #include <string.h>
 #include <stdint.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "pvr2.h"
 #include "pvr2_tex_mem.h"
 #include "pvr2_gfx_obj.h"
@@ -36,7 +40,12 @@
 #include "washdc/gfx/gfx_il.h"
 #include "washdc/gfx/tex_cache.h"
 #include "dreamcast.h"
+#include "config.h"
 #include "pvr2_reg.h"
+#include "bench.h"
+#include "perf_cnt.h"
+#include "xxh64.h"
+#include "pvr2_tex_pack.h"
 
 #include "pvr2_tex_cache.h"
 
@@ -48,6 +57,7 @@ static DEF_ERROR_INT_ATTR(tex_fmt);
                             PVR2_CODE_BOOK_ENTRY_SIZE)
 
 static enum gfx_tex_fmt pvr2_tex_fmt_to_gfx(enum TexCtrlPixFmt in_fmt);
+static void pvr2_tex_free_hd(struct pvr2 *pvr2, struct pvr2_tex *tex);
 
 unsigned static const pixel_sizes[TEX_CTRL_PIX_FMT_COUNT] = {
     [TEX_CTRL_PIX_FMT_ARGB_1555] = 2,
@@ -79,9 +89,6 @@ static bool pvr2_tex_valid(enum pvr2_tex_state state) {
     return state == PVR2_TEX_READY || state == PVR2_TEX_DIRTY;
 }
 
-static unsigned tex_twiddle(unsigned x, unsigned y,
-                            unsigned w_shift, unsigned h_shift);
-
 static enum gfx_tex_fmt
 translate_palette_to_pix_format(enum palette_tp palette_tp);
 
@@ -104,44 +111,68 @@ translate_palette_to_pix_format(enum palette_tp palette_tp);
  * themselves are stored in order from left to right (when width > height)
  * or from top to bottom (when height > width).
  */
-static unsigned tex_twiddle(unsigned x, unsigned y, unsigned w_shift, unsigned h_shift) {
-    unsigned twid_idx = 0;
-
-    unsigned w = 1 << w_shift;
-    unsigned h = 1 << h_shift;
-    unsigned min_square, min_square_shift;
-    if (w < h) {
-        min_square = w;
-        min_square_shift = w_shift;
-    } else {
-        min_square = h;
-        min_square_shift = h_shift;
-    }
+// largest texture side length is 1024 texels
+#define PVR2_TEX_MAX_SIDE_SHIFT 10
+#define PVR2_TEX_MAX_SIDE (1 << PVR2_TEX_MAX_SIDE_SHIFT)
 
-    unsigned x_resid = x & ~(min_square - 1);
-    unsigned y_resid = y & ~(min_square - 1);
-    unsigned x_sq = x & (min_square - 1);
-    unsigned y_sq = y & (min_square - 1);
+/*
+ * twiddle_spread[n] is n with each bit k moved to bit 2k.  A texel's offset
+ * within a twiddled square is
+ * (twiddle_spread[x_sq] << 1) | twiddle_spread[y_sq].
+ */
+static uint32_t twiddle_spread[PVR2_TEX_MAX_SIDE];
 
-    unsigned shift;
+static void twiddle_tbl_init(void) {
+    unsigned idx;
+    for (idx = 0; idx < PVR2_TEX_MAX_SIDE; idx++) {
+        uint32_t spread = 0;
+        unsigned bit;
+        for (bit = 0; bit < PVR2_TEX_MAX_SIDE_SHIFT; bit++)
+            if (idx & (1 << bit))
+                spread |= 1 << (bit * 2);
+        twiddle_spread[idx] = spread;
+    }
+}
 
-    for (shift = 0; shift <= min_square_shift; shift++) {
-        unsigned mask = (1 << (shift + 1)) - 1;
-        unsigned pow = 1 << shift;
+/*
+ * maps from a normal row-major configuration to the
+ * pvr2's own "twiddled" format.
+ *
+ * The twiddled format is a recursive way of ordering pixels in which the image
+ * is divided up into four sub-images.  Those four subimages are stored in the
+ * following order: upper-left, lower-left, upper-right, lower-right.  Each of
+ * these subimages are themselves twiddled into four smaller subimages, and this
+ * recursion continues until you reach the point where each subimage is a single
+ * pixel.
+ *
+ * twiddled rectangular textures are stored as a series of squares each
+ * with a width and height of min(w, h) (where w and h denote the width and
+ * height of the full rectangular texture).
+ *
+ * Each one of these squares is twiddled internally, but the squares
+ * themselves are stored in order from left to right (when width > height)
+ * or from top to bottom (when height > width).
+ *
+ * The twiddled index is separable into a part that depends only on the
+ * column and a part that depends only on the row, so this fills col_offs and
+ * row_offs with those parts; texel (x, y) is at col_offs[x] + row_offs[y].
+ * Only one of the two axes can ever have a non-zero square offset.
+ */
+static void tex_twiddle_offsets(unsigned *col_offs, unsigned *row_offs,
+                                unsigned w_shift, unsigned h_shift) {
+    unsigned sq_shift = w_shift < h_shift ? w_shift : h_shift;
+    unsigned sq_mask = (1 << sq_shift) - 1;
+    unsigned tex_w = 1 << w_shift, tex_h = 1 << h_shift;
 
-        if ((x_sq & mask) >= pow)
-            twid_idx |= 1 << (shift * 2 + 1);
-        if ((y_sq & mask) >= pow)
-            twid_idx |= 1 << (shift * 2);
+    unsigned idx;
+    for (idx = 0; idx < tex_w; idx++) {
+        col_offs[idx] = (twiddle_spread[idx & sq_mask] << 1) +
+            ((idx >> sq_shift) << (2 * sq_shift));
     }
-
-    if (x_resid) {
-        twid_idx += (x / min_square) * min_square * min_square;
-    } else if (y_resid) {
-        twid_idx += (y / min_square) * min_square * min_square;
+    for (idx = 0; idx < tex_h; idx++) {
+        row_offs[idx] = twiddle_spread[idx & sq_mask] +
+            ((idx >> sq_shift) << (2 * sq_shift));
     }
-
-    return twid_idx;
 }
 
 void pvr2_tex_cache_init(struct pvr2 *pvr2) {
@@ -151,18 +182,72 @@ void pvr2_tex_cache_init(struct pvr2 *pvr2) {
     for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
         memset(cache->tex_cache + idx, 0, sizeof(cache->tex_cache[idx]));
         cache->tex_cache[idx].obj_no = -1;
+        cache->tex_cache[idx].alias_obj = -1;
+        cache->tex_cache[idx].hash_next = -1;
+        cache->tex_cache[idx].hd_obj = -1;
+        cache->tex_cache[idx].hd_req = -1;
+        cache->tex_cache[idx].lru_prev = -1;
+        cache->tex_cache[idx].lru_next =
+            idx + 1 < PVR2_TEX_CACHE_SIZE ? (int)idx + 1 : -1;
     }
+    cache->n_hd_objs = 0;
+
+    cache->free_head = 0;
+    cache->lru_head = cache->lru_tail = -1;
+
+    for (idx = 0; idx < PVR2_TEX_HASH_LEN; idx++)
+        cache->hash_tbl[idx] = -1;
+    cache->last_hit = -1;
+
+    memset(cache->dirty_pages, 0, sizeof(cache->dirty_pages));
+    memset(cache->scratch, 0, sizeof(cache->scratch));
+    cache->pages_dirty = false;
+    cache->palette_dirty = true;
+    cache->pal_banks_stale = ~(uint64_t)0;
 
-    memset(cache->page_stamps, 0, sizeof(cache->page_stamps));
+    twiddle_tbl_init();
+
+    pvr2_tex_pack_init(config_get_tex_dump_dir(), config_get_tex_pack_dir());
 }
 
 void pvr2_tex_cache_cleanup(struct pvr2 *pvr2) {
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
 
     unsigned idx;
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++)
+    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
         if (cache->tex_cache[idx].obj_no >= 0)
             pvr2_free_gfx_obj(cache->tex_cache[idx].obj_no);
+        if (cache->tex_cache[idx].hd_obj >= 0)
+            pvr2_free_gfx_obj(cache->tex_cache[idx].hd_obj);
+    }
+
+    for (idx = 0; idx < PVR2_TEX_SCRATCH_COUNT; idx++) {
+        free(cache->scratch[idx].dat);
+        cache->scratch[idx].dat = NULL;
+        cache->scratch[idx].len = 0;
+    }
+
+    pvr2_tex_pack_cleanup();
+}
+
+/*
+ * return one of the texture cache's scratch buffers with room for at least
+ * n_bytes.  These only ever grow, so decoding stops allocating once the
+ * largest texture the game uses has been seen.  Growing the buffer keeps what
+ * was already in it.
+ */
+static void *pvr2_tex_scratch(struct pvr2 *pvr2,
+                              enum pvr2_tex_scratch_buf which,
+                              size_t n_bytes) {
+    struct pvr2_tex_scratch *buf = pvr2->tex_cache.scratch + which;
+    if (n_bytes > buf->len) {
+        void *dat = realloc(buf->dat, n_bytes);
+        if (!dat)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        buf->dat = dat;
+        buf->len = n_bytes;
+    }
+    return buf->dat;
 }
 
 struct pvr2_tex_hash {
@@ -170,6 +255,7 @@ struct pvr2_tex_hash {
     unsigned w_shift, h_shift, linestride;
     int tex_fmt;
     uint32_t tex_palette_start;
+    uint64_t palette_version;
     bool twiddled : 1;
     bool vq_compression : 1;
     bool mipmap : 1;
@@ -196,13 +282,163 @@ static inline bool pvr2_tex_hash_eq(struct pvr2_tex_hash const *hash1,
 
     if (hash1->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
         hash1->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-        if (hash1->tex_palette_start != hash2->tex_palette_start)
+        if (hash1->tex_palette_start != hash2->tex_palette_start ||
+            hash1->palette_version != hash2->palette_version)
             return false;
     }
 
     return true;
 }
 
+static void pvr2_tex_hash_from_meta(struct pvr2_tex_hash *hash,
+                                    struct pvr2_tex_meta const *meta) {
+    hash->addr_first = meta->addr_first;
+    hash->w_shift = meta->w_shift;
+    hash->h_shift = meta->h_shift;
+    hash->linestride = meta->linestride;
+    hash->tex_fmt = meta->tex_fmt;
+    hash->twiddled = meta->twiddled;
+    hash->vq_compression = meta->vq_compression;
+    hash->mipmap = meta->mipmap;
+    hash->tex_palette_start = meta->tex_palette_start;
+    hash->palette_version = meta->tex_palette_version;
+}
+
+/*
+ * map a pvr2_tex_hash to a bucket in the hash index.  Everything that
+ * pvr2_tex_hash_eq compares gets mixed in, so the palette is only included for
+ * paletted textures.
+ */
+static unsigned pvr2_tex_hash_idx(struct pvr2_tex_hash const *hash) {
+    uint32_t key = hash->addr_first;
+
+    key ^= hash->w_shift | (hash->h_shift << 4) | (hash->tex_fmt << 8) |
+        (hash->twiddled << 11) | (hash->vq_compression << 12) |
+        (hash->mipmap << 13) | (hash->linestride << 14);
+
+    if (hash->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
+        hash->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
+        key ^= hash->tex_palette_start << 24;
+        key ^= (uint32_t)hash->palette_version ^
+            (uint32_t)(hash->palette_version >> 32);
+    }
+
+    // fibonacci hashing, the upper bits are the well-mixed ones
+    key *= 2654435769u;
+    return (key >> 16) & (PVR2_TEX_HASH_LEN - 1);
+}
+
+/*
+ * returns the version of the palette banks a texture with the given format
+ * and palette address would be decoded with (see pvr2_tex_cache).
+ */
+static uint64_t pvr2_tex_palette_version(struct pvr2 *pvr2, int tex_fmt,
+                                         uint32_t pal_addr) {
+    unsigned bank_first, n_banks;
+    if (tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
+        bank_first = pal_addr & 0x3f;
+        n_banks = 1;
+    } else if (tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+        bank_first = pal_addr & 0x30;
+        n_banks = 256 / PVR2_PAL_BANK_LEN;
+    } else {
+        return 0;
+    }
+
+    if (config_get_gpu_palette())
+        return 0;
+
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    uint64_t mask = (((uint64_t)1 << n_banks) - 1) << bank_first;
+    if (cache->pal_banks_stale & mask) {
+        uint8_t const *pal_ram = pvr2_get_palette_ram(pvr2);
+        unsigned bank;
+        for (bank = bank_first; bank < bank_first + n_banks; bank++) {
+            if (cache->pal_banks_stale & ((uint64_t)1 << bank)) {
+                cache->pal_bank_version[bank] =
+                    washdc_xxh64(pal_ram + bank * PVR2_PAL_BANK_LEN * 4,
+                                 PVR2_PAL_BANK_LEN * 4, bank);
+            }
+        }
+        cache->pal_banks_stale &= ~mask;
+    }
+
+    if (n_banks == 1)
+        return cache->pal_bank_version[bank_first];
+    return washdc_xxh64(cache->pal_bank_version + bank_first,
+                        n_banks * sizeof(cache->pal_bank_version[0]), 0);
+}
+
+static void pvr2_tex_hash_insert(struct pvr2_tex_cache *cache, unsigned idx) {
+    struct pvr2_tex *tex = cache->tex_cache + idx;
+    struct pvr2_tex_hash hash;
+    pvr2_tex_hash_from_meta(&hash, &tex->meta);
+    unsigned bucket = pvr2_tex_hash_idx(&hash);
+
+    tex->hash_next = cache->hash_tbl[bucket];
+    cache->hash_tbl[bucket] = idx;
+}
+
+static void pvr2_tex_hash_remove(struct pvr2_tex_cache *cache, unsigned idx) {
+    struct pvr2_tex *tex = cache->tex_cache + idx;
+    struct pvr2_tex_hash hash;
+    pvr2_tex_hash_from_meta(&hash, &tex->meta);
+    int *link = cache->hash_tbl + pvr2_tex_hash_idx(&hash);
+
+    while (*link >= 0) {
+        if (*link == (int)idx) {
+            *link = tex->hash_next;
+            tex->hash_next = -1;
+            if (cache->last_hit == (int)idx)
+                cache->last_hit = -1;
+            return;
+        }
+        link = &cache->tex_cache[*link].hash_next;
+    }
+
+    // every valid texture should be in the hash index
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
+
+static void pvr2_tex_lru_unlink(struct pvr2_tex_cache *cache, unsigned idx) {
+    struct pvr2_tex *tex = cache->tex_cache + idx;
+
+    if (tex->lru_prev >= 0)
+        cache->tex_cache[tex->lru_prev].lru_next = tex->lru_next;
+    else
+        cache->lru_head = tex->lru_next;
+
+    if (tex->lru_next >= 0)
+        cache->tex_cache[tex->lru_next].lru_prev = tex->lru_prev;
+    else
+        cache->lru_tail = tex->lru_prev;
+
+    tex->lru_prev = tex->lru_next = -1;
+}
+
+static void pvr2_tex_lru_push(struct pvr2_tex_cache *cache, unsigned idx) {
+    struct pvr2_tex *tex = cache->tex_cache + idx;
+
+    tex->lru_prev = -1;
+    tex->lru_next = cache->lru_head;
+    if (cache->lru_head >= 0)
+        cache->tex_cache[cache->lru_head].lru_prev = idx;
+    else
+        cache->lru_tail = idx;
+    cache->lru_head = idx;
+}
+
+void pvr2_tex_cache_touch(struct pvr2 *pvr2, struct pvr2_tex *tex) {
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    unsigned idx = tex - cache->tex_cache;
+
+    tex->frame_stamp_last_used = get_cur_frame_stamp(pvr2);
+    if (cache->lru_head != (int)idx) {
+        pvr2_tex_lru_unlink(cache, idx);
+        pvr2_tex_lru_push(cache, idx);
+    }
+}
+
 struct pvr2_tex *pvr2_tex_cache_find(struct pvr2 *pvr2,
                                      uint32_t addr, uint32_t pal_addr,
                                      unsigned w_shift, unsigned h_shift,
@@ -210,9 +446,10 @@ struct pvr2_tex *pvr2_tex_cache_find(struct pvr2 *pvr2,
                                      int tex_fmt, bool twiddled,
                                      bool vq_compression, bool mipmap,
                                      bool stride_sel) {
-    unsigned idx;
     struct pvr2_tex *tex;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    struct pvr2_tex *tex_cache = cache->tex_cache;
+    struct pvr2_tex_hash tex_hash;
 
     struct pvr2_tex_hash search_hash = {
         .addr_first = addr,
@@ -223,35 +460,40 @@ struct pvr2_tex *pvr2_tex_cache_find(struct pvr2 *pvr2,
         .twiddled = twiddled,
         .vq_compression = vq_compression,
         .mipmap = mipmap,
-        .tex_palette_start = pal_addr
+        .tex_palette_start = pal_addr,
+        .palette_version = pvr2_tex_palette_version(pvr2, tex_fmt, pal_addr)
     };
 
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
-        tex = tex_cache + idx;
-
-        if (!pvr2_tex_valid(tex->state))
-            continue;
-
-        struct pvr2_tex_meta *meta = &tex->meta;
+    /*
+     * consecutive polygons very often use the same texture, so check the last
+     * one we found before going to the hash index.
+     */
+    if (cache->last_hit >= 0) {
+        tex = tex_cache + cache->last_hit;
+        pvr2_tex_hash_from_meta(&tex_hash, &tex->meta);
+        if (pvr2_tex_hash_eq(&search_hash, &tex_hash)) {
+            pvr2_tex_cache_touch(pvr2, tex);
+            pvr2->stat.persistent_counters.tex_cache_hit_count++;
+            return tex;
+        }
+    }
 
-        struct pvr2_tex_hash tex_hash = {
-            .addr_first = meta->addr_first,
-            .w_shift = meta->w_shift,
-            .h_shift = meta->h_shift,
-            .linestride = meta->linestride,
-            .tex_fmt = meta->tex_fmt,
-            .twiddled = meta->twiddled,
-            .vq_compression = meta->vq_compression,
-            .mipmap = meta->mipmap,
-            .tex_palette_start = meta->tex_palette_start
-        };
+    int idx = cache->hash_tbl[pvr2_tex_hash_idx(&search_hash)];
+    while (idx >= 0) {
+        tex = tex_cache + idx;
 
+        pvr2_tex_hash_from_meta(&tex_hash, &tex->meta);
         if (pvr2_tex_hash_eq(&search_hash, &tex_hash)) {
-            tex->frame_stamp_last_used = get_cur_frame_stamp(pvr2);
+            pvr2_tex_cache_touch(pvr2, tex);
+            cache->last_hit = idx;
+            pvr2->stat.persistent_counters.tex_cache_hit_count++;
             return tex;
         }
+
+        idx = tex->hash_next;
     }
 
+    pvr2->stat.persistent_counters.tex_cache_miss_count++;
     return NULL;
 }
 
@@ -276,33 +518,38 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
     }
 #endif
 
-    unsigned idx;// = addr & PVR2_TEX_CACHE_MASK;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
-    struct pvr2_tex *tex, *oldest_tex = NULL;
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    struct pvr2_tex *tex_cache = cache->tex_cache;
+    struct pvr2_tex *tex;
+    int idx = cache->free_head;
+
+    if (idx >= 0) {
         tex = tex_cache + idx;
+        cache->free_head = tex->lru_next;
 
-        if (!pvr2_tex_valid(tex->state))
-            break;
+        pvr2->stat.persistent_counters.fresh_texture_upload_count++;
+    } else {
+        // kick the least recently used tex out of the cache to make room
+        idx = cache->lru_tail;
+        tex = tex_cache + idx;
 
-        if (tex->frame_stamp_last_used < cur_frame_stamp) {
-            if (!oldest_tex ||
-                tex->frame_stamp_last_used < oldest_tex->frame_stamp_last_used)
-                oldest_tex = tex;
+        // everything in the cache is needed by the current frame
+        if (tex->frame_stamp_last_used >= cur_frame_stamp) {
+            LOG_ERROR("ERROR: TEXTURE CACHE OVERFLOW\n");
+            return NULL;
         }
-    }
-
-    if (idx >= PVR2_TEX_CACHE_SIZE) {
-        // kick the oldest tex out of the cache to make room
 
         pvr2->stat.persistent_counters.texture_overwrite_count++;
 
-        if (oldest_tex) {
-            tex = oldest_tex;
-        } else {
-            LOG_ERROR("ERROR: TEXTURE CACHE OVERFLOW\n");
-            return NULL;
-        }
+        // it was needed by the last frame, so it'll probably be back soon
+        if (tex->frame_stamp_last_used + 1 >= cur_frame_stamp)
+            pvr2->stat.persistent_counters.tex_thrash_count++;
+
+        if (tex->state == PVR2_TEX_DIRTY)
+            pvr2->stat.persistent_counters.tex_eviction_count++;
+
+        pvr2_tex_lru_unlink(cache, idx);
+        pvr2_tex_hash_remove(cache, idx);
 
         if (tex->obj_no >= 0) {
             struct gfx_il_inst cmd;
@@ -311,8 +558,7 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
             rend_exec_il(&cmd, 1);
             pvr2_free_gfx_obj(tex->obj_no);
         }
-    } else {
-        pvr2->stat.persistent_counters.fresh_texture_upload_count++;
+        pvr2_tex_free_hd(pvr2, tex);
     }
 
     tex->meta.addr_first = addr;
@@ -325,8 +571,13 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
     tex->meta.mipmap = mipmap;
     tex->meta.stride_sel = stride_sel;
     tex->meta.tex_palette_start = pal_addr;
+    tex->meta.tex_palette_version =
+        pvr2_tex_palette_version(pvr2, tex_fmt, pal_addr);
     tex->frame_stamp_last_used = cur_frame_stamp;
     tex->obj_no = -1;
+    tex->alias_obj = -1;
+    tex->hd_obj = -1;
+    tex->hd_req = -1;
 
     if (tex_fmt != TEX_CTRL_PIX_FMT_4_BPP_PAL &&
         tex_fmt != TEX_CTRL_PIX_FMT_8_BPP_PAL) {
@@ -355,6 +606,8 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
         }
         tex->meta.addr_last = addr - 1 + PVR2_CODE_BOOK_LEN +
             sizeof(uint8_t) * side_len * side_len / 4;
+        if (tex->meta.mipmap)
+            tex->meta.addr_last += mipmap_byte_offset_vq[w_shift];
     } else {
         if (tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
             tex->meta.addr_last = addr - 1 +
@@ -369,32 +622,29 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
                                   "mipmaps on a rectangular texture");
                 RAISE_ERROR(ERROR_UNIMPLEMENTED);
             }
-            if (tex->meta.vq_compression) {
-                tex->meta.addr_last += mipmap_byte_offset_vq[w_shift];
-            } else {
-                switch (tex->meta.tex_fmt) {
-                case TEX_CTRL_PIX_FMT_ARGB_1555:
-                case TEX_CTRL_PIX_FMT_RGB_565:
-                case TEX_CTRL_PIX_FMT_YUV_422:
-                case TEX_CTRL_PIX_FMT_ARGB_4444:
-                    tex->meta.addr_last += mipmap_byte_offset_norm[w_shift];
-                    break;
-                case TEX_CTRL_PIX_FMT_4_BPP_PAL:
-                    tex->meta.addr_last += mipmap_byte_offset_palette[w_shift] / 2;
-                    break;
-                case TEX_CTRL_PIX_FMT_8_BPP_PAL:
-                    tex->meta.addr_last += mipmap_byte_offset_palette[w_shift];
-                    break;
-                default:
-                case TEX_CTRL_PIX_FMT_BUMP_MAP:
-                    RAISE_ERROR(ERROR_UNIMPLEMENTED);
-                }
+            switch (tex->meta.tex_fmt) {
+            case TEX_CTRL_PIX_FMT_ARGB_1555:
+            case TEX_CTRL_PIX_FMT_RGB_565:
+            case TEX_CTRL_PIX_FMT_YUV_422:
+            case TEX_CTRL_PIX_FMT_ARGB_4444:
+                tex->meta.addr_last += mipmap_byte_offset_norm[w_shift];
+                break;
+            case TEX_CTRL_PIX_FMT_4_BPP_PAL:
+                tex->meta.addr_last += mipmap_byte_offset_palette[w_shift] / 2;
+                break;
+            case TEX_CTRL_PIX_FMT_8_BPP_PAL:
+                tex->meta.addr_last += mipmap_byte_offset_palette[w_shift];
+                break;
+            default:
+            case TEX_CTRL_PIX_FMT_BUMP_MAP:
+                RAISE_ERROR(ERROR_UNIMPLEMENTED);
             }
         }
     }
 
     tex->state = PVR2_TEX_DIRTY;
-    tex->last_update = 0;
+    pvr2_tex_hash_insert(cache, idx);
+    pvr2_tex_lru_push(cache, idx);
     /*
      * We defer reading the actual data from texture memory until we're ready
      * to transmit this to the rendering thread.
@@ -417,29 +667,99 @@ void pvr2_tex_cache_notify_write(struct pvr2 *pvr2,
     uint32_t addr_last = addr_64bit + (len - 1);
     unsigned page_first = addr_64bit / PVR2_TEX_PAGE_SIZE;
     unsigned page_last = addr_last / PVR2_TEX_PAGE_SIZE;
-    dc_cycle_stamp_t time = clock_cycle_stamp(pvr2->clk);
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
-    dc_cycle_stamp_t *page_stamps = cache->page_stamps;
+    uint64_t *dirty_pages = cache->dirty_pages;
 
     unsigned page_no;
     for (page_no = page_first; page_no <= page_last; page_no++)
-        page_stamps[page_no] = time;
+        dirty_pages[page_no / 64] |= ((uint64_t)1) << (page_no % 64);
+    cache->pages_dirty = true;
+}
+
+// returns true if any of the pages from page_first to page_last are dirty
+static bool
+pvr2_tex_pages_dirty(struct pvr2_tex_cache const *cache,
+                     unsigned page_first, unsigned page_last) {
+    uint64_t const *dirty_pages = cache->dirty_pages;
+    unsigned word_first = page_first / 64, word_last = page_last / 64;
+    uint64_t mask_first = ~((uint64_t)0) << (page_first % 64);
+    uint64_t mask_last = ~((uint64_t)0) >> (63 - page_last % 64);
+
+    if (word_first == word_last)
+        return dirty_pages[word_first] & mask_first & mask_last;
+
+    if (dirty_pages[word_first] & mask_first)
+        return true;
+
+    unsigned word;
+    for (word = word_first + 1; word < word_last; word++)
+        if (dirty_pages[word])
+            return true;
+
+    return dirty_pages[word_last] & mask_last;
+}
+
+/*
+ * mark every texture which references a page that's been written to since
+ * the last flush as dirty, then clear the dirty-page bitmap.
+ */
+static void pvr2_tex_cache_flush_writes(struct pvr2 *pvr2) {
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+
+    if (!cache->pages_dirty)
+        return;
+
+    unsigned idx;
+    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
+        struct pvr2_tex *tex = cache->tex_cache + idx;
+        if (tex->state != PVR2_TEX_READY)
+            continue;
+
+        if (pvr2_tex_pages_dirty(cache,
+                                 tex->meta.addr_first / PVR2_TEX_PAGE_SIZE,
+                                 tex->meta.addr_last / PVR2_TEX_PAGE_SIZE)) {
+            pvr2->stat.persistent_counters.tex_invalidate_count++;
+            tex->state = PVR2_TEX_DIRTY;
+        }
+    }
+
+    memset(cache->dirty_pages, 0, sizeof(cache->dirty_pages));
+    cache->pages_dirty = false;
 }
 
 void
 pvr2_tex_cache_notify_palette_write(struct pvr2 *pvr2,
                                     uint32_t addr_first, uint32_t len) {
+    if (!len)
+        return;
+
     /*
-     * TODO: all paletted textures will be invalidated whenever there is a
-     * write to the PVR2's palette memory.  Obviously this is suboptimal
-     * compared to only invalidating the textures that reference the part of
-     * palette memory which is being written to, but I'm keeping it this way
-     * for now because it is simpler.
+     * nothing gets invalidated here.  Textures that were decoded with the old
+     * contents of these banks just stop matching in pvr2_tex_cache_find.
      */
-    pvr2_tex_cache_notify_palette_tp_change(pvr2);
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    unsigned first = (addr_first - PVR2_PALETTE_RAM_FIRST) /
+        (4 * PVR2_PAL_BANK_LEN);
+    unsigned last = (addr_first + (len - 1) - PVR2_PALETTE_RAM_FIRST) /
+        (4 * PVR2_PAL_BANK_LEN);
+    unsigned bank;
+    for (bank = first; bank <= last && bank < PVR2_PAL_N_BANKS; bank++)
+        cache->pal_banks_stale |= (uint64_t)1 << bank;
+
+    if (config_get_gpu_palette())
+        cache->palette_dirty = true;
 }
 
 void pvr2_tex_cache_notify_palette_tp_change(struct pvr2 *pvr2) {
+    /*
+     * when gfx does its own palette lookups, textures only hold palette
+     * indices so nothing needs to be decoded again.
+     */
+    if (config_get_gpu_palette()) {
+        pvr2->tex_cache.palette_dirty = true;
+        return;
+    }
+
     unsigned idx;
     struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
     for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
@@ -454,29 +774,69 @@ void pvr2_tex_cache_notify_palette_tp_change(struct pvr2 *pvr2) {
 }
 
 /*
- * de-twiddle src into dst.  Both src and dst must be preallocated buffers with
- * a length of (1 << tex_w_shift) * (1 << tex_h_shift) * bytes_per_pix.
+ * de-twiddle src into dst.  dst must be a preallocated buffer with a length of
+ * (1 << tex_w_shift) * (1 << tex_h_shift) * bytes_per_pix.
+ *
+ * The twiddled image is copied out of texture memory in one pass and then
+ * permuted row-by-row.
  */
 static void pvr2_tex_detwiddle(struct pvr2 *pvr2, void *dst,
                                uint32_t src_addr, unsigned tex_w_shift,
                                unsigned tex_h_shift, unsigned bytes_per_pix) {
-    uint8_t *dst8 = (uint8_t*)dst;
     unsigned tex_w = 1 << tex_w_shift, tex_h = 1 << tex_h_shift;
-    unsigned row, col;
-    for (row = 0; row < tex_h; row++) {
-        for (col = 0; col < tex_w; col++) {
-            unsigned twid_idx = tex_twiddle(col, row, tex_w_shift, tex_h_shift);
+    unsigned col_offs[PVR2_TEX_MAX_SIDE], row_offs[PVR2_TEX_MAX_SIDE];
+    size_t n_bytes = (size_t)tex_w * tex_h * bytes_per_pix;
 
-#ifdef INVARIANTS
-            if (twid_idx >= tex_w * tex_h)
-                RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    if (tex_w_shift > PVR2_TEX_MAX_SIDE_SHIFT ||
+        tex_h_shift > PVR2_TEX_MAX_SIDE_SHIFT) {
+        error_set_width(tex_w);
+        error_set_height(tex_h);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
 
-            pvr2_tex_mem_64bit_read_raw(pvr2, dst8 +
-                                        (row * tex_w + col) * bytes_per_pix,
-                                        src_addr + twid_idx * bytes_per_pix,
-                                        bytes_per_pix);
+    uint8_t *src = (uint8_t*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_SRC,
+                                              n_bytes);
+    pvr2_tex_mem_64bit_read_raw(pvr2, src, src_addr, n_bytes);
+
+    tex_twiddle_offsets(col_offs, row_offs, tex_w_shift, tex_h_shift);
+
+    unsigned row, col;
+    switch (bytes_per_pix) {
+    case 1:
+        {
+            uint8_t *dst8 = (uint8_t*)dst;
+            for (row = 0; row < tex_h; row++) {
+                uint8_t const *src_row = src + row_offs[row];
+                for (col = 0; col < tex_w; col++)
+                    *dst8++ = src_row[col_offs[col]];
+            }
         }
+        break;
+    case 2:
+        {
+            uint16_t *dst16 = (uint16_t*)dst;
+            uint16_t const *src16 = (uint16_t const*)src;
+            for (row = 0; row < tex_h; row++) {
+                uint16_t const *src_row = src16 + row_offs[row];
+                for (col = 0; col < tex_w; col++)
+                    *dst16++ = src_row[col_offs[col]];
+            }
+        }
+        break;
+    default:
+        {
+            uint8_t *dst8 = (uint8_t*)dst;
+            for (row = 0; row < tex_h; row++) {
+                unsigned row_offs_cur = row_offs[row];
+                for (col = 0; col < tex_w; col++) {
+                    memcpy(dst8, src +
+                           (row_offs_cur + col_offs[col]) * bytes_per_pix,
+                           bytes_per_pix);
+                    dst8 += bytes_per_pix;
+                }
+            }
+        }
+        break;
     }
 }
 
@@ -491,40 +851,77 @@ pvr2_tex_detwiddle_4bpp(struct pvr2 *pvr2, void *dst, uint32_t src_addr,
                         unsigned tex_w_shift, unsigned tex_h_shift) {
     uint8_t *dst8 = (uint8_t*)dst;
     unsigned tex_w = 1 << tex_w_shift, tex_h = 1 << tex_h_shift;
+    unsigned col_offs[PVR2_TEX_MAX_SIDE], row_offs[PVR2_TEX_MAX_SIDE];
+    size_t n_bytes = ((size_t)tex_w * tex_h + 1) / 2;
+
+    if (tex_w_shift > PVR2_TEX_MAX_SIDE_SHIFT ||
+        tex_h_shift > PVR2_TEX_MAX_SIDE_SHIFT) {
+        error_set_width(tex_w);
+        error_set_height(tex_h);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    uint8_t *src = (uint8_t*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_SRC,
+                                              n_bytes);
+    pvr2_tex_mem_64bit_read_raw(pvr2, src, src_addr, n_bytes);
+
+    tex_twiddle_offsets(col_offs, row_offs, tex_w_shift, tex_h_shift);
+
+    if (tex_w == 1) {
+        // only for the 1x1 mipmap
+        dst8[0] = src[0] & 0xf;
+        return;
+    }
+
+    // each output byte is a pair of columns
     unsigned row, col;
     for (row = 0; row < tex_h; row++) {
-        for (col = 0; col < tex_w; col++) {
-            unsigned twid_idx = tex_twiddle(col, row, tex_w_shift, tex_h_shift);
-
-#ifdef INVARIANTS
-            if (twid_idx >= tex_w * tex_h)
-                RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-            unsigned dst_idx = row * tex_w + col;
-
-            uint8_t in_px;
-            uint32_t byteaddr = src_addr + twid_idx / 2;
-            if (twid_idx % 2 == 0)
-                in_px = pvr2_tex_mem_64bit_read8(pvr2, byteaddr) & 0xf;
-            else
-                in_px = pvr2_tex_mem_64bit_read8(pvr2, byteaddr) >> 4;
-
-            if (dst_idx % 2 == 0) {
-                dst8[dst_idx / 2] &= ~0xf;
-                dst8[dst_idx / 2] |= in_px;
-            } else {
-                dst8[dst_idx / 2] &= ~0xf0;
-                dst8[dst_idx / 2] |= (in_px << 4);
-            }
+        unsigned row_offs_cur = row_offs[row];
+        for (col = 0; col < tex_w; col += 2) {
+            unsigned idx_lo = row_offs_cur + col_offs[col];
+            unsigned idx_hi = row_offs_cur + col_offs[col + 1];
+            uint8_t px_lo = (src[idx_lo / 2] >> ((idx_lo & 1) * 4)) & 0xf;
+            uint8_t px_hi = (src[idx_hi / 2] >> ((idx_hi & 1) * 4)) & 0xf;
+            *dst8++ = px_lo | (px_hi << 4);
         }
     }
 }
 
+/*
+ * VQ code book rearranged for decompression.  Each entry in the PVR2's code
+ * book is a 2x2 block stored as upper-left, lower-left, upper-right,
+ * lower-right.  top[idx] holds the upper-left and upper-right texels of entry
+ * idx packed together the way they'll sit in the destination image, and
+ * bot[idx] holds the lower-left and lower-right texels.  That way each code
+ * expands to exactly two 32-bit stores.
+ *
+ * The code book is shared by every mipmap level of a texture, so this only
+ * needs to be built once per texture.
+ */
+struct pvr2_tex_vq_code_book {
+    uint32_t top[PVR2_CODE_BOOK_ENTRY_COUNT];
+    uint32_t bot[PVR2_CODE_BOOK_ENTRY_COUNT];
+};
+
+static void
+pvr2_tex_vq_code_book_load(struct pvr2 *pvr2,
+                           struct pvr2_tex_vq_code_book *code_book,
+                           unsigned code_book_addr) {
+    uint16_t raw[PVR2_CODE_BOOK_ENTRY_COUNT][4];
+    pvr2_tex_mem_64bit_read_raw(pvr2, raw, code_book_addr, sizeof(raw));
+
+    unsigned idx;
+    for (idx = 0; idx < PVR2_CODE_BOOK_ENTRY_COUNT; idx++) {
+        code_book->top[idx] = ((uint32_t)raw[idx][2] << 16) | raw[idx][0];
+        code_book->bot[idx] = ((uint32_t)raw[idx][3] << 16) | raw[idx][1];
+    }
+}
+
 /*
  * decompress src into dst.
  *
- * src must be a VQ-encoded texture with a length of
- * PVR2_CODE_BOOK_LEN + (1 << side_shift) * (1 << side_shift) / 4.
+ * src must be a VQ-encoded texture index array (not including the code book)
+ * with a length of (1 << side_shift) * (1 << side_shift) / 4.
  *
  * dst must be a buffer with a length of
  * 2 * (1 << side_shift) * (1 << side_shift) bytes.  This is because the data
@@ -534,77 +931,79 @@ pvr2_tex_detwiddle_4bpp(struct pvr2 *pvr2, void *dst, uint32_t src_addr,
  */
 static void
 pvr2_tex_vq_decompress(struct pvr2 *pvr2, void *dst,
-                       unsigned code_book_addr, unsigned src_addr,
-                       unsigned side_shift) {
+                       struct pvr2_tex_vq_code_book const *code_book,
+                       unsigned src_addr, unsigned side_shift) {
     unsigned dst_side = 1 << side_shift;
     unsigned src_side_shift = side_shift - 1;
     unsigned src_side = 1 << src_side_shift;
     unsigned row, col;
     uint16_t *dst_img = (uint16_t*)dst;
+    unsigned col_offs[PVR2_TEX_MAX_SIDE], row_offs[PVR2_TEX_MAX_SIDE];
+    uint32_t const *top = code_book->top, *bot = code_book->bot;
 
-    for (row = 0; row < src_side; row++) {
-        for (col = 0; col < src_side; col++) {
-            unsigned twid_idx = tex_twiddle(col, row,
-                                            src_side_shift, src_side_shift);
-
-            // code book index
-            unsigned idx = pvr2_tex_mem_64bit_read8(pvr2, twid_idx + src_addr);
-            unsigned offs = PVR2_CODE_BOOK_ENTRY_SIZE * idx + code_book_addr;
-            uint16_t color[4] = {
-                pvr2_tex_mem_64bit_read16(pvr2, offs),
-                pvr2_tex_mem_64bit_read16(pvr2, offs + 2),
-                pvr2_tex_mem_64bit_read16(pvr2, offs + 4),
-                pvr2_tex_mem_64bit_read16(pvr2, offs + 6)
-            };
-
-            unsigned dst_row = row * 2, dst_col = col * 2;
-            memcpy(dst_img + dst_row * dst_side + dst_col,
-                   color, sizeof(color[0]));
-            memcpy(dst_img + (dst_row + 1) * dst_side + dst_col,
-                   color + 1, sizeof(color[1]));
-            memcpy(dst_img + dst_row * dst_side + dst_col + 1,
-                   color + 2, sizeof(color[2]));
-            memcpy(dst_img + (dst_row + 1) * dst_side + dst_col + 1,
-                   color + 3, sizeof(color[3]));
-        }
+    if (!side_shift || side_shift > PVR2_TEX_MAX_SIDE_SHIFT) {
+        error_set_width(dst_side);
+        error_set_height(dst_side);
+        RAISE_ERROR(ERROR_INTEGRITY);
     }
-}
 
-void pvr2_tex_cache_read(struct pvr2 *pvr2,
-                         void **tex_dat_out, size_t *n_bytes_out,
-                         struct pvr2_tex_meta const *meta) {
-    unsigned tex_w = meta->linestride, tex_h = 1 << meta->h_shift;
+    uint8_t *src = (uint8_t*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_SRC,
+                                              src_side * src_side);
+    pvr2_tex_mem_64bit_read_raw(pvr2, src, src_addr, src_side * src_side);
 
-    if (tex_w % 8 || tex_h % 8) {
-        /*
-         * there are two ways to specify a texture width: either as a
-         * power-of-two greater than or equal to 8 (most common), or as a
-         * multiple of 32 (usually only used for pre-rendered FMV videos and
-         * sometimes homebrews that emulate a framebuffer).
-         *
-         * Either way, the texture width should be a multiple of 8.
-         *
-         * Texture height can only be specified as a power-of-two greater than
-         * or equal to 8 so it also should be a multiple of 8.
-         *
-         * this is important because some of the code below assumes that the
-         * total size of the texture is a multiple of 4 bytes..
-         */
-        error_set_width(tex_w);
-        error_set_height(tex_h);
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
+    tex_twiddle_offsets(col_offs, row_offs, src_side_shift, src_side_shift);
 
-    // TODO: better error-handling
-    if ((ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1) <=
-        (meta->addr_last - meta->addr_first + 1)) {
-        abort();
+    for (row = 0; row < src_side; row++) {
+        uint8_t const *src_row = src + row_offs[row];
+        uint16_t *dst_row0 = dst_img + row * 2 * dst_side;
+        uint16_t *dst_row1 = dst_row0 + dst_side;
+
+#ifdef __SSE2__
+        // src_side is only less than 4 for the smallest mipmaps
+        if (src_side >= 4) {
+            for (col = 0; col < src_side; col += 4) {
+                unsigned code0 = src_row[col_offs[col]];
+                unsigned code1 = src_row[col_offs[col + 1]];
+                unsigned code2 = src_row[col_offs[col + 2]];
+                unsigned code3 = src_row[col_offs[col + 3]];
+
+                __m128i top4 = _mm_set_epi32(top[code3], top[code2],
+                                             top[code1], top[code0]);
+                __m128i bot4 = _mm_set_epi32(bot[code3], bot[code2],
+                                             bot[code1], bot[code0]);
+                _mm_storeu_si128((__m128i*)(dst_row0 + col * 2), top4);
+                _mm_storeu_si128((__m128i*)(dst_row1 + col * 2), bot4);
+            }
+            continue;
+        }
+#endif
+        for (col = 0; col < src_side; col++) {
+            unsigned code = src_row[col_offs[col]];
+            memcpy(dst_row0 + col * 2, top + code, sizeof(top[code]));
+            memcpy(dst_row1 + col * 2, bot + code, sizeof(bot[code]));
+        }
     }
+}
 
+/*
+ * read a single level of a texture from texture memory and decode it into the
+ * PVR2_TEX_SCRATCH_OUT buffer at out_offs, returning the number of bytes
+ * written.  beg_addr points to the first byte of the level.  code_book is only
+ * used for VQ textures.  tex_w is the row length of the level, which is only
+ * different from (1 << w_shift) for stride textures.
+ */
+static size_t
+pvr2_tex_read_level(struct pvr2 *pvr2, size_t out_offs,
+                    struct pvr2_tex_meta const *meta,
+                    unsigned beg_addr,
+                    struct pvr2_tex_vq_code_book const *code_book,
+                    unsigned tex_w, unsigned w_shift, unsigned h_shift) {
+    unsigned tex_h = 1 << h_shift;
     size_t n_bytes;
 
     if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-        n_bytes = (tex_w * tex_h) / 2;
+        // round up for the 1x1 mipmap
+        n_bytes = (tex_w * tex_h + 1) / 2;
     } else {
         unsigned px_sz = pixel_sizes[meta->tex_fmt];
         if (!px_sz) {
@@ -615,84 +1014,21 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
         n_bytes = tex_w * tex_h * px_sz;
     }
 
-#ifdef INVARIANTS
-    /*
-     * tex_w and tex_h are both divisible by 8 so this ought to be divisible by
-     * 4 in any case
-     */
-    if (n_bytes % 4) {
-        error_set_length(n_bytes);
+    if (!n_bytes)
         RAISE_ERROR(ERROR_INTEGRITY);
-    }
-#endif
-    uint32_t *tex_dat = NULL;
-    if (n_bytes)
-        tex_dat = malloc(n_bytes);
-
-    if (!tex_dat)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-    unsigned beg_addr;
-    unsigned code_book_addr; // points to the code book if this is VQ
 
     /*
-     * handle mipmaps.
-     *
-     * Currently they're not actually implemented, I just select the
-     * highest-order mipmap (which is the one at the end).  To
-     * accomplish this, we have to offset the addr_first by the offset
-     * to the highest-order mipmap.
+     * paletted textures get read into PVR2_TEX_SCRATCH_LEVEL and then
+     * expanded into the output.  Everything else gets decoded in place.
      */
-    if (meta->mipmap) {
-        if (meta->w_shift != meta->h_shift) {
-            error_set_feature("proper response for attempting to "
-                              "enable mipmapping on a rectangular "
-                              "texture");
-            RAISE_ERROR(ERROR_UNIMPLEMENTED);
-        }
-
-        if (meta->tex_fmt == TEX_CTRL_PIX_FMT_YUV_422) {
-            error_set_feature("mipmapped YUV422 textures\n");
-            RAISE_ERROR(ERROR_UNIMPLEMENTED);
-        }
-
-        unsigned side_shift = meta->w_shift;
-
-        if (meta->vq_compression) {
-            code_book_addr = meta->addr_first;
-            beg_addr = code_book_addr + PVR2_CODE_BOOK_LEN +
-                mipmap_byte_offset_vq[side_shift];
-        } else {
-            switch (meta->tex_fmt) {
-            case TEX_CTRL_PIX_FMT_ARGB_1555:
-            case TEX_CTRL_PIX_FMT_RGB_565:
-            case TEX_CTRL_PIX_FMT_YUV_422:
-            case TEX_CTRL_PIX_FMT_ARGB_4444:
-                beg_addr =
-                    meta->addr_first + mipmap_byte_offset_norm[meta->w_shift];
-                break;
-            case TEX_CTRL_PIX_FMT_4_BPP_PAL:
-                beg_addr =
-                    meta->addr_first + mipmap_byte_offset_palette[meta->w_shift] / 2;
-                break;
-            case TEX_CTRL_PIX_FMT_8_BPP_PAL:
-                beg_addr =
-                    meta->addr_first + mipmap_byte_offset_palette[meta->w_shift];
-                break;
-            default:
-                RAISE_ERROR(ERROR_UNIMPLEMENTED);
-            }
-        }
+    bool paletted = meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL;
+    void *tex_dat;
+    if (paletted) {
+        tex_dat = pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_LEVEL, n_bytes);
     } else {
-        /*
-         * mipmaps are disabled, tex_in->addr_first is actually the
-         * first byte of the texture.
-         */
-        beg_addr = meta->addr_first;
-        if (meta->vq_compression) {
-            code_book_addr = beg_addr;
-            beg_addr += PVR2_CODE_BOOK_LEN;
-        }
+        tex_dat = (char*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_OUT,
+                                          out_offs + n_bytes) + out_offs;
     }
 
     if (meta->vq_compression) {
@@ -720,34 +1056,68 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        if (meta->w_shift != meta->h_shift) {
+        if (w_shift != h_shift) {
             error_set_feature("proper response for an attempt to use "
                               "VQ compression on a non-square texture");
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
-        pvr2_tex_vq_decompress(pvr2, tex_dat, code_book_addr,
-                               beg_addr, meta->w_shift);
+        if (w_shift) {
+            pvr2_tex_vq_decompress(pvr2, tex_dat, code_book,
+                                   beg_addr, w_shift);
+        } else {
+            // 1x1 mipmap, use the upper-left texel of its code
+            uint16_t texel = code_book->top[pvr2_tex_mem_64bit_read8(pvr2,
+                                                                     beg_addr)];
+            memcpy(tex_dat, &texel, sizeof(texel));
+        }
     } else if (meta->twiddled) {
         if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-            pvr2_tex_detwiddle_4bpp(pvr2, tex_dat, beg_addr, meta->w_shift, meta->h_shift);
+            pvr2_tex_detwiddle_4bpp(pvr2, tex_dat, beg_addr, w_shift, h_shift);
         } else {
             pvr2_tex_detwiddle(pvr2, tex_dat, beg_addr,
-                               meta->w_shift, meta->h_shift,
+                               w_shift, h_shift,
                                pixel_sizes[meta->tex_fmt]);
         }
+    } else if (n_bytes % 4) {
+        // only the smallest mipmaps aren't a multiple of 4 bytes
+        pvr2_tex_mem_64bit_read_raw(pvr2, tex_dat, beg_addr, n_bytes);
     } else {
-#ifdef INVARIANTS
-        if (n_bytes % 4) {
-            error_set_length(n_bytes);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-#endif
-
         pvr2_tex_mem_64bit_read_dwords(pvr2, tex_dat, beg_addr, n_bytes / 4);
     }
 
-    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+    if (meta->pix_fmt == GFX_TEX_FMT_PAL_INDEX16) {
+        /*
+         * gfx does the palette lookup itself, so all that's needed here is to
+         * put the palette bank into every index.
+         */
+        bool four_bpp = meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL;
+        if (!four_bpp && meta->tex_fmt != TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+            error_set_tex_fmt(meta->tex_fmt);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        n_bytes = sizeof(uint16_t) * tex_w * tex_h;
+        uint16_t *tex_dat_idx = (uint16_t*)
+            ((char*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_OUT,
+                                     out_offs + n_bytes) + out_offs);
+
+        uint8_t const *tex_dat8 = (uint8_t const*)tex_dat;
+        unsigned n_pix = tex_w * tex_h, pix_idx;
+        if (four_bpp) {
+            uint16_t pal_start = meta->tex_palette_start << 4;
+            for (pix_idx = 0; pix_idx < n_pix; pix_idx++) {
+                uint8_t pix_in = tex_dat8[pix_idx / 2];
+                if (pix_idx % 2)
+                    pix_in >>= 4;
+                tex_dat_idx[pix_idx] = pal_start | (pix_in & 0xf);
+            }
+        } else {
+            uint16_t pal_start = (meta->tex_palette_start & 0x30) << 4;
+            for (pix_idx = 0; pix_idx < n_pix; pix_idx++)
+                tex_dat_idx[pix_idx] = pal_start | tex_dat8[pix_idx];
+        }
+    } else if (meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
         uint32_t tex_size_actual;
         enum palette_tp palette_tp = get_palette_tp(pvr2);
         switch (palette_tp) {
@@ -767,13 +1137,12 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
             RAISE_ERROR(ERROR_INTEGRITY);
         }
         n_bytes = tex_size_actual * tex_w * tex_h;
-        uint32_t *tex_dat_no_palette = malloc(n_bytes);
-        if (!tex_dat_no_palette)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        char *tex_dat_no_palette8 =
+            (char*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_OUT,
+                                    out_offs + n_bytes) + out_offs;
 
         uint32_t pal_start = (meta->tex_palette_start & 0x30) << 4;
         char const *tex_dat8 = (char const*)tex_dat;
-        char *tex_dat_no_palette8 = (char*)tex_dat_no_palette;
 
         unsigned row, col;
         uint8_t *pal_ram = pvr2_get_palette_ram(pvr2);
@@ -788,8 +1157,6 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
                 memcpy(pix_out, pal_ram + palette_addr, tex_size_actual);
             }
         }
-        free(tex_dat);
-        tex_dat = tex_dat_no_palette;
         LOG_DBG("PVR2 paletted texture: tex_palette_start is 0x%04x\n",
                (unsigned)meta->tex_palette_start);
     } else if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
@@ -812,13 +1179,12 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
             RAISE_ERROR(ERROR_INTEGRITY);
         }
         n_bytes = tex_size_actual * tex_w * tex_h;
-        uint32_t *tex_dat_no_palette = malloc(n_bytes);
-        if (!tex_dat_no_palette)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        char *tex_dat_no_palette8 =
+            (char*)pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_OUT,
+                                    out_offs + n_bytes) + out_offs;
 
         uint32_t pal_start = meta->tex_palette_start << 4;
         char const *tex_dat8 = (char const*)tex_dat;
-        char *tex_dat_no_palette8 = (char*)tex_dat_no_palette;
 
         uint8_t *pal_ram = pvr2_get_palette_ram(pvr2);
         unsigned row, col;
@@ -840,143 +1206,532 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
                 memcpy(pix_out, pal_ram + palette_addr, tex_size_actual);
             }
         }
-        free(tex_dat);
-        tex_dat = tex_dat_no_palette;
         LOG_DBG("PVR2 paletted texture: tex_palette_start is 0x%04x\n",
                (unsigned)meta->tex_palette_start);
     }
 
-    *tex_dat_out = tex_dat;
-    *n_bytes_out = n_bytes;
+    return n_bytes;
 }
 
-void pvr2_tex_cache_xmit_one(struct pvr2 *pvr2, unsigned idx) {
-    unsigned cur_frame_stamp = get_cur_frame_stamp(pvr2);
-    struct gfx_il_inst cmd;
-    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
-    dc_cycle_stamp_t *page_stamps = cache->page_stamps;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
-    struct pvr2_tex *tex_in = tex_cache + idx;
-
-    if (tex_in->state != PVR2_TEX_INVALID) {
-        pvr2_framebuffer_notify_texture(pvr2,
-                                        tex_in->meta.addr_first +
-                                        ADDR_TEX64_FIRST,
-                                        tex_in->meta.addr_last +
-                                        ADDR_TEX64_FIRST);
+/*
+ * hash the guest data a texture gets decoded from.  This hashes what's in
+ * texture memory and palette RAM instead of the decoded texture so that the
+ * hash doesn't depend on how the texture gets decoded (for example, whether
+ * the gpu_palette config is set).
+ */
+static uint64_t pvr2_tex_hash_guest(struct pvr2 *pvr2,
+                                    struct pvr2_tex_meta const *meta) {
+    uint64_t seed = (uint64_t)meta->tex_fmt |
+        ((uint64_t)meta->w_shift << 4) | ((uint64_t)meta->h_shift << 8) |
+        ((uint64_t)meta->linestride << 12) |
+        ((uint64_t)meta->twiddled << 24) |
+        ((uint64_t)meta->vq_compression << 25) |
+        ((uint64_t)meta->mipmap << 26) | ((uint64_t)meta->stride_sel << 27);
+
+    unsigned n_bytes = meta->addr_last - meta->addr_first + 1;
+    void *dat = pvr2_tex_scratch(pvr2, PVR2_TEX_SCRATCH_SRC, n_bytes);
+    pvr2_tex_mem_64bit_read_raw(pvr2, dat, meta->addr_first, n_bytes);
+    uint64_t hash = washdc_xxh64(dat, n_bytes, seed);
+
+    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+        unsigned pal_first, pal_len;
+        if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
+            pal_first = meta->tex_palette_start << 4;
+            pal_len = 16;
+        } else {
+            pal_first = (meta->tex_palette_start & 0x30) << 4;
+            pal_len = 256;
+        }
+        uint8_t const *pal_ram = pvr2_get_palette_ram(pvr2);
+        hash = washdc_xxh64(pal_ram + pal_first * 4, pal_len * 4,
+                            hash ^ get_palette_tp(pvr2));
+    }
+
+    return hash;
+}
+
+/*
+ * decode the given texture into the PVR2_TEX_SCRATCH_OUT buffer and return
+ * it.  The returned pointer is only valid until the next texture gets decoded.
+ */
+static void *pvr2_tex_cache_decode(struct pvr2 *pvr2, size_t *n_bytes_out,
+                                   struct pvr2_tex_meta const *meta,
+                                   uint64_t *hash_out) {
+    unsigned tex_w = meta->linestride, tex_h = 1 << meta->h_shift;
+
+    if (tex_w % 8 || tex_h % 8) {
+        /*
+         * there are two ways to specify a texture width: either as a
+         * power-of-two greater than or equal to 8 (most common), or as a
+         * multiple of 32 (usually only used for pre-rendered FMV videos and
+         * sometimes homebrews that emulate a framebuffer).
+         *
+         * Either way, the texture width should be a multiple of 8.
+         *
+         * Texture height can only be specified as a power-of-two greater than
+         * or equal to 8 so it also should be a multiple of 8.
+         *
+         * this is important because some of the code below assumes that the
+         * total size of the texture is a multiple of 4 bytes..
+         */
+        error_set_width(tex_w);
+        error_set_height(tex_h);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    // TODO: better error-handling
+    if ((ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1) <=
+        (meta->addr_last - meta->addr_first + 1)) {
+        abort();
+    }
+
+    if (hash_out)
+        *hash_out = pvr2_tex_hash_guest(pvr2, meta);
+
+    unsigned beg_addr;
+    unsigned code_book_addr = 0; // points to the code book if this is VQ
+    struct pvr2_tex_vq_code_book code_book;
+
+    if (!meta->mipmap) {
+        /*
+         * mipmaps are disabled, tex_in->addr_first is actually the
+         * first byte of the texture.
+         */
+        beg_addr = meta->addr_first;
+        if (meta->vq_compression) {
+            code_book_addr = beg_addr;
+            beg_addr += PVR2_CODE_BOOK_LEN;
+            pvr2_tex_vq_code_book_load(pvr2, &code_book, code_book_addr);
+        }
+
+        *n_bytes_out = pvr2_tex_read_level(pvr2, 0, meta, beg_addr,
+                                           &code_book, tex_w, meta->w_shift,
+                                           meta->h_shift);
+        return pvr2->tex_cache.scratch[PVR2_TEX_SCRATCH_OUT].dat;
     }
 
-    bool need_update = false;
-    if (tex_in->state == PVR2_TEX_DIRTY)
-        need_update = true;
-    else if (tex_in->state == PVR2_TEX_READY) {
-        unsigned page = tex_in->meta.addr_first / PVR2_TEX_PAGE_SIZE;
-        unsigned last_page = tex_in->meta.addr_last / PVR2_TEX_PAGE_SIZE;
-        while (page <= last_page) {
-            if (page_stamps[page++] > tex_in->last_update) {
-                pvr2->stat.persistent_counters.tex_invalidate_count++;
-                need_update = true;
+    /*
+     * handle mipmaps.
+     *
+     * The guest stores every level of the mip chain, starting with the 1x1
+     * level and ending with the full-size texture.  Each level is decoded on
+     * its own and the output holds all of them, starting with the full-size
+     * level and halving down to 1x1.
+     */
+    if (meta->w_shift != meta->h_shift) {
+        error_set_feature("proper response for attempting to "
+                          "enable mipmapping on a rectangular "
+                          "texture");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_YUV_422) {
+        error_set_feature("mipmapped YUV422 textures\n");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    if (meta->vq_compression) {
+        code_book_addr = meta->addr_first;
+        pvr2_tex_vq_code_book_load(pvr2, &code_book, code_book_addr);
+    }
+
+    size_t n_bytes = 0;
+    unsigned side_shift = meta->w_shift;
+    unsigned level;
+
+    if (side_shift > PVR2_TEX_MAX_SIDE_SHIFT) {
+        error_set_width(tex_w);
+        error_set_height(tex_h);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    for (level = 0; level <= side_shift; level++) {
+        unsigned level_shift = side_shift - level;
+
+        if (meta->vq_compression) {
+            beg_addr = code_book_addr + PVR2_CODE_BOOK_LEN +
+                mipmap_byte_offset_vq[level_shift];
+        } else {
+            switch (meta->tex_fmt) {
+            case TEX_CTRL_PIX_FMT_ARGB_1555:
+            case TEX_CTRL_PIX_FMT_RGB_565:
+            case TEX_CTRL_PIX_FMT_ARGB_4444:
+                beg_addr =
+                    meta->addr_first + mipmap_byte_offset_norm[level_shift];
+                break;
+            case TEX_CTRL_PIX_FMT_4_BPP_PAL:
+                /*
+                 * the 1x1 level actually starts halfway through this byte,
+                 * but that's close enough for a 1x1 texture.
+                 */
+                beg_addr = meta->addr_first +
+                    mipmap_byte_offset_palette[level_shift] / 2;
+                break;
+            case TEX_CTRL_PIX_FMT_8_BPP_PAL:
+                beg_addr = meta->addr_first +
+                    mipmap_byte_offset_palette[level_shift];
                 break;
+            default:
+                RAISE_ERROR(ERROR_UNIMPLEMENTED);
             }
         }
+
+        // each level is appended to the ones before it
+        n_bytes += pvr2_tex_read_level(pvr2, n_bytes, meta, beg_addr,
+                                       &code_book, 1 << level_shift,
+                                       level_shift, level_shift);
     }
 
-    if (need_update) {
-        pvr2->stat.persistent_counters.tex_xmit_count++;
+    *n_bytes_out = n_bytes;
+    return pvr2->tex_cache.scratch[PVR2_TEX_SCRATCH_OUT].dat;
+}
 
-        /*
-         * If the texture has been written to this frame but it is not
-         * actively in use then tell the gfx system to evict it from the
-         * cache.
-         */
-        if (tex_in->frame_stamp_last_used != cur_frame_stamp) {
-            pvr2->stat.persistent_counters.tex_eviction_count++;
+void pvr2_tex_cache_read(struct pvr2 *pvr2,
+                         void **tex_dat_out, size_t *n_bytes_out,
+                         struct pvr2_tex_meta const *meta, uint64_t *hash_out) {
+    size_t n_bytes;
+    void const *dat = pvr2_tex_cache_decode(pvr2, &n_bytes, meta, hash_out);
+    void *tex_dat = malloc(n_bytes);
+    if (!tex_dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    memcpy(tex_dat, dat, n_bytes);
 
-            tex_in->state = PVR2_TEX_INVALID;
+    *tex_dat_out = tex_dat;
+    *n_bytes_out = n_bytes;
+}
 
-            cmd.op = GFX_IL_UNBIND_TEX;
-            cmd.arg.unbind_tex.tex_no = idx;
-            rend_exec_il(&cmd, 1);
+// expand a palette entry to GFX_TEX_FMT_ARGB_8888
+static uint32_t pvr2_tex_palette_to_argb8888(enum palette_tp palette_tp,
+                                             uint32_t ent) {
+    uint32_t a, r, g, b;
+    switch (palette_tp) {
+    case PALETTE_TP_ARGB_1555:
+        a = (ent & 0x8000) ? 0xff : 0;
+        r = (ent >> 10) & 0x1f;
+        g = (ent >> 5) & 0x1f;
+        b = ent & 0x1f;
+        r = (r << 3) | (r >> 2);
+        g = (g << 3) | (g >> 2);
+        b = (b << 3) | (b >> 2);
+        break;
+    case PALETTE_TP_RGB_565:
+        a = 0xff;
+        r = (ent >> 11) & 0x1f;
+        g = (ent >> 5) & 0x3f;
+        b = ent & 0x1f;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        break;
+    case PALETTE_TP_ARGB_4444:
+        a = ((ent >> 12) & 0xf) * 0x11;
+        r = ((ent >> 8) & 0xf) * 0x11;
+        g = ((ent >> 4) & 0xf) * 0x11;
+        b = (ent & 0xf) * 0x11;
+        break;
+    case PALETTE_TP_ARGB_8888:
+        return ent;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
 
-            cmd.op = GFX_IL_FREE_OBJ;
-            cmd.arg.free_obj.obj_no = tex_in->obj_no;
-            rend_exec_il(&cmd, 1);
+// expand all GFX_PALETTE_LEN entries of palette RAM to GFX_TEX_FMT_ARGB_8888
+static void pvr2_tex_palette_argb8888(struct pvr2 *pvr2, uint32_t *palette) {
+    uint8_t const *pal_ram = pvr2_get_palette_ram(pvr2);
+    enum palette_tp palette_tp = get_palette_tp(pvr2);
+
+    unsigned idx;
+    for (idx = 0; idx < GFX_PALETTE_LEN; idx++) {
+        uint32_t ent;
+        memcpy(&ent, pal_ram + idx * sizeof(ent), sizeof(ent));
+        palette[idx] = pvr2_tex_palette_to_argb8888(palette_tp, ent);
+    }
+}
+
+// send the whole palette over to gfx for GFX_TEX_FMT_PAL_INDEX16 textures
+static void pvr2_tex_cache_xmit_palette(struct pvr2 *pvr2) {
+    static uint32_t palette[GFX_PALETTE_LEN];
+    pvr2_tex_palette_argb8888(pvr2, palette);
 
-            pvr2_free_gfx_obj(tex_in->obj_no);
-            tex_in->obj_no = -1;
+    struct gfx_il_inst cmd;
+    cmd.op = GFX_IL_SET_PALETTE;
+    cmd.arg.set_palette.dat = palette;
+    rend_exec_il(&cmd, 1);
 
+    pvr2->tex_cache.palette_dirty = false;
+}
+
+// the caller is responsible for binding something else to the texture
+static void pvr2_tex_free_hd(struct pvr2 *pvr2, struct pvr2_tex *tex) {
+    if (tex->hd_obj >= 0) {
+        struct gfx_il_inst cmd;
+        cmd.op = GFX_IL_FREE_OBJ;
+        cmd.arg.free_obj.obj_no = tex->hd_obj;
+        rend_exec_il(&cmd, 1);
+        pvr2_free_gfx_obj(tex->hd_obj);
+        tex->hd_obj = -1;
+        pvr2->tex_cache.n_hd_objs--;
+    }
+    tex->hd_req = -1;
+}
+
+static void
+pvr2_tex_bind_obj(unsigned idx, int obj_no, enum gfx_tex_fmt pix_fmt,
+                  unsigned width, unsigned height, bool mipmap) {
+    struct gfx_il_inst cmd;
+    cmd.op = GFX_IL_BIND_TEX;
+    cmd.arg.bind_tex.gfx_obj_handle = obj_no;
+    cmd.arg.bind_tex.tex_no = idx;
+    cmd.arg.bind_tex.pix_fmt = pix_fmt;
+    cmd.arg.bind_tex.width = width;
+    cmd.arg.bind_tex.height = height;
+    cmd.arg.bind_tex.mipmap = mipmap;
+    cmd.arg.bind_tex.alias = false;
+    rend_exec_il(&cmd, 1);
+}
+
+/*
+ * check on a replacement from the texture pack, and bind it in place of the
+ * original texture if it's done decoding.
+ */
+static void pvr2_tex_poll_hd(struct pvr2 *pvr2, struct pvr2_tex *tex) {
+    struct pvr2_tex_pack_img img;
+    int status = pvr2_tex_pack_take(tex->hd_req, &img);
+    if (status == 0)
+        return;
+    tex->hd_req = -1;
+    if (status < 0)
+        return;
+
+    if (pvr2->tex_cache.n_hd_objs >= PVR2_TEX_MAX_HD_OBJS) {
+        free(img.dat);
+        return;
+    }
+
+    struct gfx_il_inst cmd;
+    tex->hd_obj = pvr2_alloc_gfx_obj();
+    pvr2->tex_cache.n_hd_objs++;
+
+    cmd.op = GFX_IL_INIT_OBJ;
+    cmd.arg.init_obj.obj_no = tex->hd_obj;
+    cmd.arg.init_obj.n_bytes = img.n_bytes;
+    rend_exec_il(&cmd, 1);
+
+    cmd.op = GFX_IL_WRITE_OBJ;
+    cmd.arg.write_obj.dat = img.dat;
+    cmd.arg.write_obj.obj_no = tex->hd_obj;
+    cmd.arg.write_obj.n_bytes = img.n_bytes;
+    rend_exec_il(&cmd, 1);
+    free(img.dat);
+
+    tex->hd_width = img.width;
+    tex->hd_height = img.height;
+    tex->hd_mipmap = tex->meta.mipmap && img.mipmap;
+    pvr2_tex_bind_obj(tex - pvr2->tex_cache.tex_cache, tex->hd_obj,
+                      GFX_TEX_FMT_ARGB_8888, tex->hd_width, tex->hd_height,
+                      tex->hd_mipmap);
+}
+
+/*
+ * called after a texture is decoded with the hash of its new contents.  This
+ * dumps it and swaps its replacement in or out.
+ */
+static void pvr2_tex_update_pack(struct pvr2 *pvr2, struct pvr2_tex *tex,
+                                 uint64_t hash, void const *tex_dat,
+                                 enum gfx_tex_fmt pix_fmt) {
+    struct pvr2_tex_meta const *meta = &tex->meta;
+
+    // only the normal power-of-two widths are supported
+    if (meta->linestride != (1u << meta->w_shift))
+        return;
+
+    if (pvr2_tex_pack_dumping()) {
+        static uint32_t palette[GFX_PALETTE_LEN];
+        if (pix_fmt == GFX_TEX_FMT_PAL_INDEX16)
+            pvr2_tex_palette_argb8888(pvr2, palette);
+        pvr2_tex_pack_dump(hash, tex_dat, pix_fmt, meta->linestride,
+                           1 << meta->h_shift, palette);
+    }
+
+    unsigned idx = tex - pvr2->tex_cache.tex_cache;
+    if (tex->hd_obj >= 0) {
+        if (tex->pack_hash == hash) {
+            // the original texture might have been bound over hd_obj
+            pvr2_tex_bind_obj(idx, tex->hd_obj, GFX_TEX_FMT_ARGB_8888,
+                              tex->hd_width, tex->hd_height, tex->hd_mipmap);
             return;
         }
 
-        if (tex_in->obj_no < 0) {
-            /*
-             * This is a new texture; we need to create a data store,
-             * upload the texture and bind the store to the texture object.
-             */
-            tex_in->obj_no = pvr2_alloc_gfx_obj();
-
-            void *tex_dat;
-            size_t n_bytes;
-            struct pvr2_tex_meta tmp = tex_in->meta;
-            if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
-                tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-                tmp.pix_fmt =
-                    translate_palette_to_pix_format(get_palette_tp(pvr2));
-            }
-            pvr2_tex_cache_read(pvr2, &tex_dat, &n_bytes, &tmp);
+        // the replacement is stale, so go back to the original
+        pvr2_tex_free_hd(pvr2, tex);
+        pvr2_tex_bind_obj(idx, tex->obj_no, pix_fmt, meta->linestride,
+                          1 << meta->h_shift, meta->mipmap);
+    }
 
-            cmd.op = GFX_IL_INIT_OBJ;
-            cmd.arg.init_obj.obj_no = tex_in->obj_no;
-            cmd.arg.init_obj.n_bytes = n_bytes;
-            rend_exec_il(&cmd, 1);
+    tex->hd_req = -1;
+    tex->pack_hash = hash;
+    tex->hd_req = pvr2_tex_pack_request(hash);
+    if (tex->hd_req >= 0)
+        pvr2_tex_poll_hd(pvr2, tex);
+}
+
+void pvr2_tex_cache_bind(struct pvr2 *pvr2, struct pvr2_tex *tex_in) {
+    struct gfx_il_inst cmd;
+    unsigned idx = tex_in - pvr2->tex_cache.tex_cache;
+
+    int alias_obj = -1;
+    if (config_get_fb_tex_alias())
+        alias_obj = pvr2_framebuffer_alias_texture(pvr2, &tex_in->meta);
 
-            cmd.op = GFX_IL_WRITE_OBJ;
-            cmd.arg.write_obj.dat = tex_dat;
-            cmd.arg.write_obj.obj_no = tex_in->obj_no;
-            cmd.arg.write_obj.n_bytes = n_bytes;
+    if (alias_obj >= 0) {
+        if (tex_in->alias_obj != alias_obj) {
+            cmd.op = GFX_IL_BIND_TEX;
+            cmd.arg.bind_tex.gfx_obj_handle = alias_obj;
+            cmd.arg.bind_tex.tex_no = idx;
+            cmd.arg.bind_tex.pix_fmt = tex_in->meta.pix_fmt;
+            cmd.arg.bind_tex.width = tex_in->meta.linestride;
+            cmd.arg.bind_tex.height = 1 << tex_in->meta.h_shift;
+            cmd.arg.bind_tex.mipmap = false;
+            cmd.arg.bind_tex.alias = true;
             rend_exec_il(&cmd, 1);
-            free(tex_dat);
+            tex_in->alias_obj = alias_obj;
+        }
+        pvr2->stat.per_frame_counters.fb_tex_alias_count++;
+        return;
+    }
+
+    /*
+     * the renderer's texture slot still points at the framebuffer, so the
+     * texture's own gfx_obj needs to be refreshed and bound again.
+     */
+    bool rebind = tex_in->alias_obj >= 0;
+    if (rebind) {
+        tex_in->alias_obj = -1;
+        tex_in->state = PVR2_TEX_DIRTY;
+    }
+
+    /*
+     * this can write the contents of a framebuffer back to texture memory, so
+     * it has to come before the flush below.
+     */
+    pvr2_framebuffer_notify_texture(pvr2,
+                                    tex_in->meta.addr_first +
+                                    ADDR_TEX64_FIRST,
+                                    tex_in->meta.addr_last +
+                                    ADDR_TEX64_FIRST);
+
+    pvr2_tex_cache_flush_writes(pvr2);
+
+    bool paletted = tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
+        tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL;
+    bool gpu_palette = paletted && config_get_gpu_palette();
+
+    if (gpu_palette && pvr2->tex_cache.palette_dirty)
+        pvr2_tex_cache_xmit_palette(pvr2);
+
+    if (tex_in->hd_req >= 0)
+        pvr2_tex_poll_hd(pvr2, tex_in);
+
+    if (tex_in->state != PVR2_TEX_DIRTY)
+        return;
+
+    pvr2->stat.persistent_counters.tex_xmit_count++;
+
+    bool pack = pvr2_tex_pack_active();
+    uint64_t hash;
 
+    if (tex_in->obj_no < 0) {
+        /*
+         * This is a new texture; we need to create a data store,
+         * upload the texture and bind the store to the texture object.
+         */
+        tex_in->obj_no = pvr2_alloc_gfx_obj();
+
+        void *tex_dat;
+        size_t n_bytes;
+        struct pvr2_tex_meta tmp = tex_in->meta;
+        if (gpu_palette) {
+            tmp.pix_fmt = GFX_TEX_FMT_PAL_INDEX16;
+        } else if (paletted) {
+            tmp.pix_fmt =
+                translate_palette_to_pix_format(get_palette_tp(pvr2));
+        }
+        enum bench_sect bench_prev = bench_enter(BENCH_TEX);
+        PERF_TIMER_BEGIN(PERF_TEX_DECODE);
+        tex_dat = pvr2_tex_cache_decode(pvr2, &n_bytes, &tmp,
+                                        pack ? &hash : NULL);
+        PERF_TIMER_END(PERF_TEX_DECODE);
+        bench_leave(bench_prev);
+
+        cmd.op = GFX_IL_INIT_OBJ;
+        cmd.arg.init_obj.obj_no = tex_in->obj_no;
+        cmd.arg.init_obj.n_bytes = n_bytes;
+        rend_exec_il(&cmd, 1);
+
+        cmd.op = GFX_IL_WRITE_OBJ;
+        cmd.arg.write_obj.dat = tex_dat;
+        cmd.arg.write_obj.obj_no = tex_in->obj_no;
+        cmd.arg.write_obj.n_bytes = n_bytes;
+        rend_exec_il(&cmd, 1);
+
+        cmd.op = GFX_IL_BIND_TEX;
+        cmd.arg.bind_tex.gfx_obj_handle = tex_in->obj_no;
+        cmd.arg.bind_tex.tex_no = idx;
+        cmd.arg.bind_tex.pix_fmt = tmp.pix_fmt;
+        cmd.arg.bind_tex.width = tex_in->meta.linestride;
+        cmd.arg.bind_tex.height = 1 << tex_in->meta.h_shift;
+        cmd.arg.bind_tex.mipmap = tex_in->meta.mipmap;
+        cmd.arg.bind_tex.alias = false;
+
+        rend_exec_il(&cmd, 1);
+
+        if (pack)
+            pvr2_tex_update_pack(pvr2, tex_in, hash, tex_dat, tmp.pix_fmt);
+    } else {
+        /*
+         * This is a pre-existing texture; since the data-store has
+         * already been created and bound, all we have to do is write
+         * to it.
+         */
+        struct pvr2_tex_meta tmp = tex_in->meta;
+        if (gpu_palette)
+            tmp.pix_fmt = GFX_TEX_FMT_PAL_INDEX16;
+        else if (paletted)
+            tmp.pix_fmt = translate_palette_to_pix_format(get_palette_tp(pvr2));
+        void *tex_dat;
+        size_t n_bytes;
+        enum bench_sect bench_prev = bench_enter(BENCH_TEX);
+        PERF_TIMER_BEGIN(PERF_TEX_DECODE);
+        tex_dat = pvr2_tex_cache_decode(pvr2, &n_bytes, &tmp,
+                                        pack ? &hash : NULL);
+        PERF_TIMER_END(PERF_TEX_DECODE);
+        bench_leave(bench_prev);
+        cmd.op = GFX_IL_WRITE_OBJ;
+        cmd.arg.write_obj.dat = tex_dat;
+        cmd.arg.write_obj.obj_no = tex_in->obj_no;
+        cmd.arg.write_obj.n_bytes = n_bytes;
+        rend_exec_il(&cmd, 1);
+
+        if (rebind) {
             cmd.op = GFX_IL_BIND_TEX;
             cmd.arg.bind_tex.gfx_obj_handle = tex_in->obj_no;
             cmd.arg.bind_tex.tex_no = idx;
             cmd.arg.bind_tex.pix_fmt = tmp.pix_fmt;
             cmd.arg.bind_tex.width = tex_in->meta.linestride;
             cmd.arg.bind_tex.height = 1 << tex_in->meta.h_shift;
-
+            cmd.arg.bind_tex.mipmap = tex_in->meta.mipmap;
+            cmd.arg.bind_tex.alias = false;
             rend_exec_il(&cmd, 1);
-        } else {
-            /*
-             * This is a pre-existing texture; since the data-store has
-             * already been created and bound, all we have to do is write
-             * to it.
-             */
-            struct pvr2_tex_meta tmp = tex_in->meta;
-            if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
-                tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-                tmp.pix_fmt = translate_palette_to_pix_format(get_palette_tp(pvr2));
-            }
-            void *tex_dat;
-            size_t n_bytes;
-            pvr2_tex_cache_read(pvr2, &tex_dat, &n_bytes, &tmp);
-            cmd.op = GFX_IL_WRITE_OBJ;
-            cmd.arg.write_obj.dat = tex_dat;
-            cmd.arg.write_obj.obj_no = tex_in->obj_no;
-            cmd.arg.write_obj.n_bytes = n_bytes;
-            rend_exec_il(&cmd, 1);
-            free(tex_dat);
         }
 
-        tex_in->state = PVR2_TEX_READY;
-        tex_in->last_update = clock_cycle_stamp(pvr2->clk);
+        if (pack)
+            pvr2_tex_update_pack(pvr2, tex_in, hash, tex_dat, tmp.pix_fmt);
     }
-}
-
-void pvr2_tex_cache_xmit(struct pvr2 *pvr2) {
-    unsigned idx;
 
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++)
-        pvr2_tex_cache_xmit_one(pvr2, idx);
+    tex_in->state = PVR2_TEX_READY;
 }
 
 int pvr2_tex_cache_get_idx(struct pvr2 *pvr2, struct pvr2_tex const *tex) {
@@ -75,6 +75,14 @@ struct pvr2_tex_meta {
      */
     uint32_t tex_palette_start;
 
+    /*
+     * version of the palette banks this texture was decoded with (see
+     * pvr2_tex_cache).  This is always 0 for textures which aren't paletted
+     * and when the gpu_palette config is set, since then the palette isn't
+     * part of the decoded texture.
+     */
+    uint64_t tex_palette_version;
+
     bool twiddled;
 
     bool stride_sel;
@@ -101,35 +109,150 @@ enum pvr2_tex_state {
 };
 
 struct pvr2_tex {
-    dc_cycle_stamp_t last_update;
     struct pvr2_tex_meta meta;
 
     // this refers to the gfx_obj bound to the texture
     int obj_no;
 
+    /*
+     * if this is not -1, then the texture aliases a framebuffer that only
+     * exists on the host and the renderer's texture slot is bound to that
+     * framebuffer's gfx_obj instead of obj_no.
+     */
+    int alias_obj;
+
     // the frame stamp from the last time this texture was referenced
     unsigned frame_stamp_last_used;
 
     enum pvr2_tex_state state;
+
+    /*
+     * index of the next texture in the same hash bucket, or -1.  Only
+     * meaningful for textures which are in a valid state, since those are the
+     * only ones kept in the hash index.
+     */
+    int hash_next;
+
+    /*
+     * neighbors in the cache's LRU list, or -1.  Free slots are kept in a
+     * separate list which is linked through lru_next.
+     */
+    int lru_prev, lru_next;
+
+    /*
+     * gfx_obj holding this texture's replacement from the texture pack, or -1.
+     * When this isn't -1, the renderer's texture slot is bound to it instead
+     * of obj_no.  pack_hash is the hash of the guest data it replaced.
+     */
+    int hd_obj;
+    uint64_t pack_hash;
+    unsigned hd_width, hd_height;
+    bool hd_mipmap;
+
+    // handle of a replacement that's still being decoded, or -1
+    int hd_req;
 };
 
 /*
  * For the purposes of texture cache invalidation, we divide texture memory
- * into a number of distinct pages.  When a texture is updated, we remember the
- * time-stamp at which that update happened.  When texture-memory is written to,
- * we set the timestamp of that page to the current timestamp.  When a texture
- * is used for rendering, we update it if its timestamp is behind the timestamps
- * of any of the pages it references.
+ * into a number of distinct pages.  When texture-memory is written to, we set
+ * the bit for that page in the cache's dirty-page bitmap.  The next time a
+ * texture gets bound by a polygon header, every texture whose pages intersect
+ * the bitmap is marked dirty and the bitmap is cleared.  Dirty textures only
+ * get decoded and uploaded to the renderer when they're bound, so textures
+ * which get written to but never sampled don't cost anything.
  *
  * This macro defines the page size in bytes.  It must be a power of two.
  */
 #define PVR2_TEX_PAGE_SIZE 512
 #define PVR2_TEX_MEM_LEN (ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1)
 #define PVR2_TEX_N_PAGES (PVR2_TEX_MEM_LEN / PVR2_TEX_PAGE_SIZE)
+#define PVR2_TEX_PAGE_WORDS (PVR2_TEX_N_PAGES / 64)
+
+/*
+ * number of buckets in the texture cache's hash index.  This must be a power
+ * of two.
+ */
+#define PVR2_TEX_HASH_LEN (2 * PVR2_TEX_CACHE_SIZE)
+
+/*
+ * maximum number of textures which can have a replacement from the texture
+ * pack bound at once.  Every replacement costs a gfx_obj on top of the
+ * original texture's, so this keeps the cache from running gfx out of them.
+ */
+#define PVR2_TEX_MAX_HD_OBJS 128
+
+/*
+ * palette RAM gets versioned in banks of 16 entries.  A 4BPP texture uses one
+ * bank and an 8BPP texture uses 16 of them.
+ */
+#define PVR2_PAL_BANK_LEN 16
+#define PVR2_PAL_N_BANKS (1024 / PVR2_PAL_BANK_LEN)
+
+/*
+ * scratch buffers used while decoding textures.  SRC holds raw data read out
+ * of texture memory, LEVEL holds a paletted mipmap level before it's run
+ * through the palette and OUT holds the decoded texture.
+ */
+enum pvr2_tex_scratch_buf {
+    PVR2_TEX_SCRATCH_SRC,
+    PVR2_TEX_SCRATCH_LEVEL,
+    PVR2_TEX_SCRATCH_OUT,
+
+    PVR2_TEX_SCRATCH_COUNT
+};
+
+struct pvr2_tex_scratch {
+    void *dat;
+    size_t len;
+};
 
 struct pvr2_tex_cache {
-    dc_cycle_stamp_t page_stamps[PVR2_TEX_N_PAGES];
+    // one bit per page written to since the last flush
+    uint64_t dirty_pages[PVR2_TEX_PAGE_WORDS];
+    bool pages_dirty;
+
+    /*
+     * only used when the gpu_palette config is set.  true if palette RAM or
+     * the palette format changed since the palette was last sent to gfx.
+     */
+    bool palette_dirty;
+
+    /*
+     * paletted textures are looked up by the version of the banks they use
+     * instead of getting invalidated when palette RAM is written to.  A
+     * bank's version is the hash of what's in it, so a palette that goes back
+     * to something it was before finds the textures that were decoded with it
+     * still in the cache.  pal_banks_stale has a bit for every bank that's
+     * been written to since its version was last computed.
+     */
+    uint64_t pal_bank_version[PVR2_PAL_N_BANKS];
+    uint64_t pal_banks_stale;
+
     struct pvr2_tex tex_cache[PVR2_TEX_CACHE_SIZE];
+
+    /*
+     * hash index of all valid textures, indexed by pvr2_tex_hash_idx.  Each
+     * bucket holds the index of the first texture in its chain, or -1.
+     */
+    int hash_tbl[PVR2_TEX_HASH_LEN];
+
+    // index of the texture returned by the last successful find, or -1
+    int last_hit;
+
+    /*
+     * every valid texture is in the LRU list, most recently used first.  The
+     * rest are in the free list.  The next texture that gets added goes into
+     * the first free slot if there is one, and otherwise it replaces the
+     * texture at lru_tail.
+     */
+    int lru_head, lru_tail;
+    int free_head;
+
+    // number of textures with a replacement bound (see PVR2_TEX_MAX_HD_OBJS)
+    unsigned n_hd_objs;
+
+    struct pvr2_tex_scratch scratch[PVR2_TEX_SCRATCH_COUNT];
 };
 
 /*
@@ -167,9 +290,18 @@ void pvr2_tex_cache_notify_palette_tp_change(struct pvr2 *pvr2);
 
 int pvr2_tex_cache_get_idx(struct pvr2 *pvr2, struct pvr2_tex const *tex);
 
-// this function sends the texture cache over to gfx by way of the gfx_il
-void pvr2_tex_cache_xmit(struct pvr2 *pvr2);
-void pvr2_tex_cache_xmit_one(struct pvr2 *pvr2, unsigned idx);
+/*
+ * mark the given texture as used in the current frame.  pvr2_tex_cache_find
+ * does this on its own.
+ */
+void pvr2_tex_cache_touch(struct pvr2 *pvr2, struct pvr2_tex *tex);
+
+/*
+ * called when a polygon header binds the given texture.  This is where the
+ * texture gets decoded and sent over to gfx by way of the gfx_il if it's
+ * dirty.
+ */
+void pvr2_tex_cache_bind(struct pvr2 *pvr2, struct pvr2_tex *tex);
 
 /*
  * Read the meta-information of the given texture.  This function will return
@@ -179,9 +311,16 @@ void pvr2_tex_cache_xmit_one(struct pvr2 *pvr2, unsigned idx);
 int pvr2_tex_get_meta(struct pvr2 *pvr2,
                       struct pvr2_tex_meta *meta, unsigned tex_idx);
 
+/*
+ * decode the given texture into a newly allocated buffer which the caller
+ * frees.  The texture cache itself decodes into scratch buffers instead, so
+ * this is only for the debugger and the microbenchmarks.  If hash_out is not NULL, it gets an XXH64 hash
+ * of the guest data the texture was decoded from (including its palette, if
+ * it has one) for the texture pack.
+ */
 void pvr2_tex_cache_read(struct pvr2 *pvr2,
                          void **tex_dat_out, size_t *n_bytes_out,
-                         struct pvr2_tex_meta const *meta);
+                         struct pvr2_tex_meta const *meta, uint64_t *hash_out);
 
 void pvr2_tex_cache_init(struct pvr2 *pvr2);
 void pvr2_tex_cache_cleanup(struct pvr2 *pvr2);
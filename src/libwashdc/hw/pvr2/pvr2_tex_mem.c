@@ -22,6 +22,10 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "pvr2.h"
 #include "washdc/error.h"
 #include "mem_code.h"
@@ -29,25 +33,23 @@
 #include "pvr2_reg.h"
 #include "pvr2_tex_cache.h"
 #include "framebuffer.h"
+#include "savestate.h"
+#include "hostmem.h"
 
+/*
+ * framebuffers that were rendered on the host don't get copied back to texture
+ * memory until something actually reads them.
+ */
 static inline void
 pvr2_tex_mem_sync_fb(struct pvr2 *pvr2, uint32_t addr_32bit, size_t n_bytes) {
-    /*
-     * TODO: don't call framebuffer_sync_from_host_maybe if addr is beyond the
-     * end of the framebuffer
-     */
-    uint32_t sof1 = get_fb_w_sof1(pvr2);
-    uint32_t sof2 = get_fb_w_sof2(pvr2);
-    if ((addr_32bit + ADDR_TEX32_FIRST + n_bytes) >= sof1 ||
-        (addr_32bit + ADDR_TEX32_FIRST + n_bytes) >= sof2)
-        framebuffer_sync_from_host_maybe();
+    pvr2_framebuffer_notify_read(pvr2, addr_32bit, n_bytes);
 }
 
 static inline void
 pvr2_tex_mem_notify_writes(struct pvr2 *pvr2,
                            uint32_t addr_32bit, size_t n_bytes) {
-    pvr2_tex_mem_sync_fb(pvr2, addr_32bit, n_bytes);
     pvr2_framebuffer_notify_write(pvr2, addr_32bit, n_bytes);
+    savestate_notify_vram_write(addr_32bit, n_bytes);
 
     /*
      * TODO: calling pvr2_tex_mem_addr_32_to_64 is suboptimal because if this
@@ -59,6 +61,17 @@ pvr2_tex_mem_notify_writes(struct pvr2 *pvr2,
                                 n_bytes);
 }
 
+void pvr2_tex_mem_init(struct pvr2 *pvr2) {
+    pvr2->mem.tex32 = (uint8_t*)hostmem_alloc(PVR2_TEX32_MEM_LEN);
+    if (!pvr2->mem.tex32)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+}
+
+void pvr2_tex_mem_cleanup(struct pvr2 *pvr2) {
+    hostmem_free(pvr2->mem.tex32, PVR2_TEX32_MEM_LEN);
+    pvr2->mem.tex32 = NULL;
+}
+
 double
 pvr2_tex_mem_32bit_read_double(struct pvr2 *pvr2, unsigned addr) {
     double ret;
@@ -70,6 +83,7 @@ pvr2_tex_mem_32bit_read_double(struct pvr2 *pvr2, unsigned addr) {
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
+    pvr2_tex_mem_sync_fb(pvr2, addr, sizeof(ret));
     memcpy(&ret, pvr2->mem.tex32 + addr, sizeof(ret));
     return ret;
 }
@@ -403,10 +417,53 @@ void pvr2_tex_mem_64bit_write_dwords(struct pvr2 *pvr2,
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
-    while (n_dwords--) {
+    if (addr % 8 && n_dwords) {
         pvr2_tex_mem_64bit_write32(pvr2, addr, *srcp++);
         addr += 4;
+        n_dwords--;
+    }
+
+    /*
+     * now that addr is 8-byte aligned, the even dwords are contiguous in one
+     * bank of 32-bit memory and the odd dwords are contiguous in the other,
+     * so each bank only needs to be notified once for the whole transfer.
+     */
+    unsigned n_pairs = n_dwords / 2;
+    if (n_pairs) {
+        unsigned offs0 = pvr2_tex_mem_addr_64_to_32(addr);
+        unsigned offs1 = pvr2_tex_mem_addr_64_to_32(addr + 4);
+        unsigned len = n_pairs * sizeof(uint32_t);
+        uint8_t *bank0 = pvr2->mem.tex32 + offs0;
+        uint8_t *bank1 = pvr2->mem.tex32 + offs1;
+
+        pvr2_tex_mem_notify_writes(pvr2, offs0, len);
+        pvr2_tex_mem_notify_writes(pvr2, offs1, len);
+
+        unsigned idx = 0;
+#ifdef __SSE2__
+        for (; idx + 4 <= n_pairs; idx += 4) {
+            __m128i lo = _mm_loadu_si128((__m128i const*)(srcp + 2 * idx));
+            __m128i hi = _mm_loadu_si128((__m128i const*)(srcp + 2 * idx + 4));
+            lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+            hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i*)(bank0 + 4 * idx),
+                             _mm_unpacklo_epi64(lo, hi));
+            _mm_storeu_si128((__m128i*)(bank1 + 4 * idx),
+                             _mm_unpackhi_epi64(lo, hi));
+        }
+#endif
+        for (; idx < n_pairs; idx++) {
+            memcpy(bank0 + 4 * idx, srcp + 2 * idx, sizeof(uint32_t));
+            memcpy(bank1 + 4 * idx, srcp + 2 * idx + 1, sizeof(uint32_t));
+        }
+
+        srcp += 2 * n_pairs;
+        addr += 8 * n_pairs;
+        n_dwords -= 2 * n_pairs;
     }
+
+    if (n_dwords)
+        pvr2_tex_mem_64bit_write32(pvr2, addr, *srcp);
 }
 
 void
@@ -624,6 +681,20 @@ static void
 pvr2_tex_mem_unused_write_double(addr32_t addr, double val, void *ctxt) {
 }
 
+static void
+pvr2_tex_mem_area32_write_dwords(addr32_t addr, uint32_t const *src,
+                                 unsigned n_dwords, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    pvr2_tex_mem_32bit_write_raw(pvr2, addr, src, n_dwords * sizeof(uint32_t));
+}
+
+static void
+pvr2_tex_mem_area64_write_dwords(addr32_t addr, uint32_t const *src,
+                                 unsigned n_dwords, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    pvr2_tex_mem_64bit_write_dwords(pvr2, addr, src, n_dwords);
+}
+
 struct memory_interface pvr2_tex_mem_area32_intf = {
     .readdouble = pvr2_tex_mem_area32_read_double,
     .readfloat = pvr2_tex_mem_area32_read_float,
@@ -635,7 +706,8 @@ struct memory_interface pvr2_tex_mem_area32_intf = {
     .writefloat = pvr2_tex_mem_area32_write_float,
     .write32 = pvr2_tex_mem_area32_write_32,
     .write16 = pvr2_tex_mem_area32_write_16,
-    .write8 = pvr2_tex_mem_area32_write_8
+    .write8 = pvr2_tex_mem_area32_write_8,
+    .write_dwords = pvr2_tex_mem_area32_write_dwords
 };
 
 struct memory_interface pvr2_tex_mem_area64_intf = {
@@ -649,7 +721,8 @@ struct memory_interface pvr2_tex_mem_area64_intf = {
     .writefloat = pvr2_tex_mem_area64_write_float,
     .write32 = pvr2_tex_mem_area64_write_32,
     .write16 = pvr2_tex_mem_area64_write_16,
-    .write8 = pvr2_tex_mem_area64_write_8
+    .write8 = pvr2_tex_mem_area64_write_8,
+    .write_dwords = pvr2_tex_mem_area64_write_dwords
 };
 
 struct memory_interface pvr2_tex_mem_unused_intf = {
@@ -34,7 +34,8 @@
 struct pvr2;
 
 struct pvr2_tex_mem {
-    uint8_t tex32[ADDR_TEX32_LAST - ADDR_TEX32_FIRST + 1];
+    // PVR2_TEX32_MEM_LEN bytes from hostmem_alloc
+    uint8_t *tex32;
 };
 
 #define PVR2_TEX32_MEM_LEN (ADDR_TEX32_LAST - ADDR_TEX32_FIRST + 1)
@@ -68,6 +69,9 @@ pvr2_tex_mem_addr_64_to_32(unsigned offs) {
     return offs32 | (offs & 3);
 }
 
+void pvr2_tex_mem_init(struct pvr2 *pvr2);
+void pvr2_tex_mem_cleanup(struct pvr2 *pvr2);
+
 // generic read/write functions for emulator code to use (ie not part of memory map
 double
 pvr2_tex_mem_32bit_read_double(struct pvr2 *pvr2, unsigned addr);
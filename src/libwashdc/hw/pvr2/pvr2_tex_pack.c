@@ -0,0 +1,853 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <png.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "washdc/pix_conv.h"
+#include "threading.h"
+#include "log.h"
+
+#include "pvr2_tex_pack.h"
+
+#define TEX_PACK_PATH_LEN 1024
+#define TEX_PACK_N_WORKERS 2
+
+// replacements bigger than this on either side get ignored
+#define TEX_PACK_MAX_SIDE 4096
+
+/*
+ * dumps get dropped (and retried the next time the texture gets decoded)
+ * when the workers are this far behind, so that dumping a texture-heavy scene
+ * can't eat all of the host's memory.
+ */
+#define TEX_PACK_MAX_DUMPS_QUEUED 256
+
+enum tex_pack_ent_state {
+    TEX_PACK_ENT_IDLE,
+    TEX_PACK_ENT_QUEUED,
+    TEX_PACK_ENT_READY,
+    TEX_PACK_ENT_FAILED
+};
+
+struct tex_pack_ent {
+    uint64_t hash;
+    char *path;
+
+    // state and img are protected by queue_lock
+    enum tex_pack_ent_state state;
+    struct pvr2_tex_pack_img img;
+};
+
+enum tex_pack_job_tp {
+    TEX_PACK_JOB_LOAD,
+    TEX_PACK_JOB_DUMP
+};
+
+struct tex_pack_job {
+    struct tex_pack_job *next;
+    enum tex_pack_job_tp tp;
+
+    // TEX_PACK_JOB_LOAD
+    int ent_no;
+
+    // TEX_PACK_JOB_DUMP
+    uint64_t hash;
+    enum gfx_tex_fmt fmt;
+    unsigned width, height;
+    void *dat;
+    uint32_t *palette;
+};
+
+static bool dump_en, pack_en;
+static char dump_dir[TEX_PACK_PATH_LEN], pack_dir[TEX_PACK_PATH_LEN];
+
+// pack index, with an open-addressed table from hashes to ents
+static struct tex_pack_ent *ents;
+static unsigned n_ents, ents_alloc;
+static int *ent_tbl;
+static unsigned ent_tbl_mask;
+
+/*
+ * hashes of every texture which has been dumped (or queued to be dumped).
+ * This is only touched by the emulation thread.  0 marks an empty slot, so
+ * the hash 0 is tracked separately.
+ */
+static uint64_t *dumped;
+static unsigned dumped_count, dumped_mask;
+static bool dumped_zero;
+
+// the dump directory's index, protected by dump_idx_lock
+static washdc_hostfile dump_idx;
+static washdc_mutex dump_idx_lock = WASHDC_MUTEX_STATIC_INIT;
+
+/*
+ * loads go on the front of the queue and dumps go on the back, since getting
+ * replacements on the screen is more urgent.
+ */
+static struct tex_pack_job *queue_head, *queue_tail;
+static unsigned n_dumps_queued;
+static bool workers_running, workers_quit;
+static washdc_thread workers[TEX_PACK_N_WORKERS];
+static washdc_mutex queue_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar queue_cvar = WASHDC_CVAR_STATIC_INIT;
+
+static void worker_main(void *argp);
+static int load_png(char const *path, struct pvr2_tex_pack_img *img);
+static int dump_png(struct tex_pack_job const *job);
+static void build_mip_chain(struct pvr2_tex_pack_img *img);
+
+static void join_path(char *dst, char const *dir, char const *name) {
+    snprintf(dst, TEX_PACK_PATH_LEN, "%s%c%s", dir,
+             washdc_hostfile_pathsep(), name);
+    dst[TEX_PACK_PATH_LEN - 1] = '\0';
+}
+
+static inline unsigned hash_slot(uint64_t hash, unsigned mask) {
+    return (unsigned)(hash ^ (hash >> 32)) & mask;
+}
+
+static bool dumped_contains(uint64_t hash) {
+    if (!hash)
+        return dumped_zero;
+    if (!dumped)
+        return false;
+    unsigned slot = hash_slot(hash, dumped_mask);
+    while (dumped[slot]) {
+        if (dumped[slot] == hash)
+            return true;
+        slot = (slot + 1) & dumped_mask;
+    }
+    return false;
+}
+
+static void dumped_insert(uint64_t hash) {
+    if (!hash) {
+        dumped_zero = true;
+        return;
+    }
+
+    // keep the table at most half full
+    if (!dumped || 2 * (dumped_count + 1) > dumped_mask + 1) {
+        unsigned new_len = dumped ? 2 * (dumped_mask + 1) : 1024;
+        uint64_t *new_tbl = (uint64_t*)calloc(new_len, sizeof(uint64_t));
+        if (!new_tbl)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        unsigned idx;
+        for (idx = 0; dumped && idx <= dumped_mask; idx++) {
+            if (dumped[idx]) {
+                unsigned slot = hash_slot(dumped[idx], new_len - 1);
+                while (new_tbl[slot])
+                    slot = (slot + 1) & (new_len - 1);
+                new_tbl[slot] = dumped[idx];
+            }
+        }
+        free(dumped);
+        dumped = new_tbl;
+        dumped_mask = new_len - 1;
+    }
+
+    unsigned slot = hash_slot(hash, dumped_mask);
+    while (dumped[slot]) {
+        if (dumped[slot] == hash)
+            return;
+        slot = (slot + 1) & dumped_mask;
+    }
+    dumped[slot] = hash;
+    dumped_count++;
+}
+
+static int ent_find(uint64_t hash) {
+    if (!ent_tbl)
+        return -1;
+    unsigned slot = hash_slot(hash, ent_tbl_mask);
+    while (ent_tbl[slot] >= 0) {
+        if (ents[ent_tbl[slot]].hash == hash)
+            return ent_tbl[slot];
+        slot = (slot + 1) & ent_tbl_mask;
+    }
+    return -1;
+}
+
+static void ent_tbl_build(void) {
+    unsigned len = 16;
+    while (len < 2 * n_ents)
+        len *= 2;
+
+    ent_tbl = (int*)malloc(len * sizeof(int));
+    if (!ent_tbl)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    ent_tbl_mask = len - 1;
+
+    unsigned idx;
+    for (idx = 0; idx < len; idx++)
+        ent_tbl[idx] = -1;
+
+    for (idx = 0; idx < n_ents; idx++) {
+        unsigned slot = hash_slot(ents[idx].hash, ent_tbl_mask);
+        while (ent_tbl[slot] >= 0)
+            slot = (slot + 1) & ent_tbl_mask;
+        ent_tbl[slot] = idx;
+    }
+}
+
+// read an entire file into a nul-terminated buffer
+static char *read_text_file(char const *path) {
+    washdc_hostfile fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                              WASHDC_HOSTFILE_BINARY);
+    if (fp == WASHDC_HOSTFILE_INVALID)
+        return NULL;
+
+    char *txt = NULL;
+    if (washdc_hostfile_seek(fp, 0, WASHDC_HOSTFILE_SEEK_END) == 0) {
+        long len = washdc_hostfile_tell(fp);
+        if (len >= 0 &&
+            washdc_hostfile_seek(fp, 0, WASHDC_HOSTFILE_SEEK_BEG) == 0 &&
+            (txt = (char*)malloc(len + 1))) {
+            if (washdc_hostfile_read(fp, txt, len) == (size_t)len) {
+                txt[len] = '\0';
+            } else {
+                free(txt);
+                txt = NULL;
+            }
+        }
+    }
+
+    washdc_hostfile_close(fp);
+    return txt;
+}
+
+/*
+ * call on_ent for every entry in the index text.  This modifies txt, and the
+ * paths passed to on_ent point into it.
+ */
+static void parse_index(char *txt, char const *idx_path,
+                        void (*on_ent)(uint64_t hash, char const *path)) {
+    unsigned line_no = 0;
+    char *line = txt;
+    while (line && *line) {
+        char *next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        line_no++;
+
+        while (isspace((unsigned char)*line))
+            line++;
+        size_t len = strlen(line);
+        while (len && isspace((unsigned char)line[len - 1]))
+            line[--len] = '\0';
+
+        if (len && line[0] != '#') {
+            char *endp;
+            uint64_t hash = strtoull(line, &endp, 16);
+            char const *path = endp;
+            while (isspace((unsigned char)*path))
+                path++;
+            if (endp == line || !isspace((unsigned char)*endp) || !*path) {
+                LOG_ERROR("%s line %u: expected a hash and a path\n",
+                          idx_path, line_no);
+            } else {
+                on_ent(hash, path);
+            }
+        }
+
+        line = next;
+    }
+}
+
+static void add_pack_ent(uint64_t hash, char const *path) {
+    if (n_ents == ents_alloc) {
+        unsigned new_alloc = ents_alloc ? 2 * ents_alloc : 256;
+        struct tex_pack_ent *new_ents = (struct tex_pack_ent*)
+            realloc(ents, new_alloc * sizeof(struct tex_pack_ent));
+        if (!new_ents)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        ents = new_ents;
+        ents_alloc = new_alloc;
+    }
+
+    struct tex_pack_ent *ent = ents + n_ents++;
+    memset(ent, 0, sizeof(*ent));
+    ent->hash = hash;
+    ent->state = TEX_PACK_ENT_IDLE;
+    ent->path = (char*)malloc(TEX_PACK_PATH_LEN);
+    if (!ent->path)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    join_path(ent->path, pack_dir, path);
+}
+
+static void add_dumped_ent(uint64_t hash, char const *path) {
+    if (dumped_contains(hash))
+        return;
+    dumped_insert(hash);
+    washdc_hostfile_printf(dump_idx, "%016llx %s\n",
+                           (unsigned long long)hash, path);
+}
+
+static void load_pack(void) {
+    char idx_path[TEX_PACK_PATH_LEN];
+    join_path(idx_path, pack_dir, PVR2_TEX_PACK_INDEX);
+
+    char *txt = read_text_file(idx_path);
+    if (!txt) {
+        LOG_ERROR("unable to read texture pack index %s\n", idx_path);
+        pack_en = false;
+        return;
+    }
+    parse_index(txt, idx_path, add_pack_ent);
+    free(txt);
+
+    ent_tbl_build();
+    LOG_INFO("%u textures in the pack at %s\n", n_ents, pack_dir);
+}
+
+/*
+ * there's no way to append to a hostfile, so the dump index gets read in and
+ * then written back out before anything new goes into it.
+ */
+static void open_dump_idx(void) {
+    char idx_path[TEX_PACK_PATH_LEN];
+    join_path(idx_path, dump_dir, PVR2_TEX_PACK_INDEX);
+
+    char *txt = read_text_file(idx_path);
+    dump_idx = washdc_hostfile_open(idx_path, WASHDC_HOSTFILE_WRITE |
+                                    WASHDC_HOSTFILE_TEXT);
+    if (dump_idx == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open %s; texture dumping is disabled\n",
+                  idx_path);
+        free(txt);
+        dump_en = false;
+        return;
+    }
+
+    if (txt) {
+        parse_index(txt, idx_path, add_dumped_ent);
+        free(txt);
+    }
+    washdc_hostfile_flush(dump_idx);
+    LOG_INFO("dumping textures to %s (%u already there)\n",
+             dump_dir, dumped_count + (dumped_zero ? 1 : 0));
+}
+
+void pvr2_tex_pack_init(char const *dump_dir_path, char const *pack_dir_path) {
+    dump_en = dump_dir_path && dump_dir_path[0];
+    pack_en = pack_dir_path && pack_dir_path[0];
+    if (!dump_en && !pack_en)
+        return;
+
+    if (pack_en) {
+        strncpy(pack_dir, pack_dir_path, TEX_PACK_PATH_LEN);
+        pack_dir[TEX_PACK_PATH_LEN - 1] = '\0';
+        load_pack();
+    }
+
+    if (dump_en) {
+        strncpy(dump_dir, dump_dir_path, TEX_PACK_PATH_LEN);
+        dump_dir[TEX_PACK_PATH_LEN - 1] = '\0';
+        open_dump_idx();
+    }
+
+    if (!dump_en && !pack_en)
+        return;
+
+    queue_head = queue_tail = NULL;
+    n_dumps_queued = 0;
+    workers_quit = false;
+    workers_running = true;
+    unsigned idx;
+    for (idx = 0; idx < TEX_PACK_N_WORKERS; idx++)
+        washdc_thread_create(workers + idx, worker_main, NULL);
+}
+
+void pvr2_tex_pack_cleanup(void) {
+    if (workers_running) {
+        // anything that's still queued gets finished (or dropped) first
+        washdc_mutex_lock(&queue_lock);
+        workers_quit = true;
+        washdc_cvar_broadcast(&queue_cvar);
+        washdc_mutex_unlock(&queue_lock);
+
+        unsigned idx;
+        for (idx = 0; idx < TEX_PACK_N_WORKERS; idx++)
+            washdc_thread_join(workers + idx);
+        workers_running = false;
+    }
+
+    if (dump_idx != WASHDC_HOSTFILE_INVALID) {
+        washdc_hostfile_close(dump_idx);
+        dump_idx = WASHDC_HOSTFILE_INVALID;
+    }
+
+    unsigned idx;
+    for (idx = 0; idx < n_ents; idx++) {
+        free(ents[idx].path);
+        free(ents[idx].img.dat);
+    }
+    free(ents);
+    ents = NULL;
+    n_ents = ents_alloc = 0;
+    free(ent_tbl);
+    ent_tbl = NULL;
+
+    free(dumped);
+    dumped = NULL;
+    dumped_count = dumped_mask = 0;
+    dumped_zero = false;
+
+    dump_en = pack_en = false;
+}
+
+bool pvr2_tex_pack_active(void) {
+    return dump_en || pack_en;
+}
+
+bool pvr2_tex_pack_dumping(void) {
+    return dump_en;
+}
+
+static size_t tex_fmt_bytes_per_pix(enum gfx_tex_fmt fmt) {
+    return fmt == GFX_TEX_FMT_ARGB_8888 ? 4 : 2;
+}
+
+void pvr2_tex_pack_dump(uint64_t hash, void const *dat, enum gfx_tex_fmt fmt,
+                        unsigned width, unsigned height,
+                        uint32_t const *palette) {
+    if (!dump_en || dumped_contains(hash))
+        return;
+
+    // a texture that's in the pack doesn't need to be dumped again
+    if (pack_en && ent_find(hash) >= 0)
+        return;
+
+    washdc_mutex_lock(&queue_lock);
+    bool full = n_dumps_queued >= TEX_PACK_MAX_DUMPS_QUEUED;
+    washdc_mutex_unlock(&queue_lock);
+    if (full)
+        return;
+
+    struct tex_pack_job *job =
+        (struct tex_pack_job*)calloc(1, sizeof(struct tex_pack_job));
+    if (!job)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    size_t n_bytes = tex_fmt_bytes_per_pix(fmt) * width * height;
+    job->tp = TEX_PACK_JOB_DUMP;
+    job->hash = hash;
+    job->fmt = fmt;
+    job->width = width;
+    job->height = height;
+    job->dat = malloc(n_bytes);
+    if (!job->dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    memcpy(job->dat, dat, n_bytes);
+
+    if (fmt == GFX_TEX_FMT_PAL_INDEX16) {
+        job->palette = (uint32_t*)malloc(GFX_PALETTE_LEN * sizeof(uint32_t));
+        if (!job->palette)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        memcpy(job->palette, palette, GFX_PALETTE_LEN * sizeof(uint32_t));
+    }
+
+    dumped_insert(hash);
+
+    washdc_mutex_lock(&queue_lock);
+    if (queue_tail)
+        queue_tail->next = job;
+    else
+        queue_head = job;
+    queue_tail = job;
+    n_dumps_queued++;
+    washdc_cvar_signal(&queue_cvar);
+    washdc_mutex_unlock(&queue_lock);
+}
+
+int pvr2_tex_pack_request(uint64_t hash) {
+    if (!pack_en)
+        return -1;
+
+    int ent_no = ent_find(hash);
+    if (ent_no < 0)
+        return -1;
+
+    struct tex_pack_ent *ent = ents + ent_no;
+    washdc_mutex_lock(&queue_lock);
+    if (ent->state == TEX_PACK_ENT_IDLE) {
+        struct tex_pack_job *job =
+            (struct tex_pack_job*)calloc(1, sizeof(struct tex_pack_job));
+        if (!job)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        job->tp = TEX_PACK_JOB_LOAD;
+        job->ent_no = ent_no;
+
+        job->next = queue_head;
+        queue_head = job;
+        if (!queue_tail)
+            queue_tail = job;
+
+        ent->state = TEX_PACK_ENT_QUEUED;
+        washdc_cvar_signal(&queue_cvar);
+    }
+    bool failed = ent->state == TEX_PACK_ENT_FAILED;
+    washdc_mutex_unlock(&queue_lock);
+
+    return failed ? -1 : ent_no;
+}
+
+int pvr2_tex_pack_take(int handle, struct pvr2_tex_pack_img *img) {
+    struct tex_pack_ent *ent = ents + handle;
+    int ret;
+
+    washdc_mutex_lock(&queue_lock);
+    switch (ent->state) {
+    case TEX_PACK_ENT_READY:
+        *img = ent->img;
+        memset(&ent->img, 0, sizeof(ent->img));
+        ent->state = TEX_PACK_ENT_IDLE;
+        ret = 1;
+        break;
+    case TEX_PACK_ENT_QUEUED:
+        ret = 0;
+        break;
+    default:
+        ret = -1;
+    }
+    washdc_mutex_unlock(&queue_lock);
+
+    return ret;
+}
+
+static void worker_main(void *argp) {
+    washdc_mutex_lock(&queue_lock);
+    for (;;) {
+        while (!queue_head && !workers_quit)
+            washdc_cvar_wait(&queue_cvar, &queue_lock);
+        if (!queue_head)
+            break;
+
+        struct tex_pack_job *job = queue_head;
+        queue_head = job->next;
+        if (!queue_head)
+            queue_tail = NULL;
+        if (job->tp == TEX_PACK_JOB_DUMP)
+            n_dumps_queued--;
+
+        // nobody's going to look at replacements once it's time to quit
+        bool skip = workers_quit && job->tp == TEX_PACK_JOB_LOAD;
+        washdc_mutex_unlock(&queue_lock);
+
+        if (job->tp == TEX_PACK_JOB_LOAD) {
+            struct tex_pack_ent *ent = ents + job->ent_no;
+            struct pvr2_tex_pack_img img;
+            int err = skip ? -1 : load_png(ent->path, &img);
+
+            washdc_mutex_lock(&queue_lock);
+            if (err == 0) {
+                ent->img = img;
+                ent->state = TEX_PACK_ENT_READY;
+            } else {
+                if (!skip)
+                    LOG_ERROR("unable to load replacement texture %s\n",
+                              ent->path);
+                ent->state = TEX_PACK_ENT_FAILED;
+            }
+            washdc_mutex_unlock(&queue_lock);
+        } else {
+            if (dump_png(job) != 0) {
+                LOG_ERROR("unable to dump texture %016llx\n",
+                          (unsigned long long)job->hash);
+            }
+            free(job->dat);
+            free(job->palette);
+        }
+        free(job);
+
+        washdc_mutex_lock(&queue_lock);
+    }
+    washdc_mutex_unlock(&queue_lock);
+}
+
+static void read_wrapper_png(png_structp png, png_bytep dat, png_size_t len) {
+    washdc_hostfile fp = (washdc_hostfile)png_get_io_ptr(png);
+    if (washdc_hostfile_read(fp, dat, len) != len)
+        png_error(png, "unexpected end of file");
+}
+
+static void write_wrapper_png(png_structp png, png_bytep dat, png_size_t len) {
+    washdc_hostfile fp = (washdc_hostfile)png_get_io_ptr(png);
+    washdc_hostfile_write(fp, dat, len);
+}
+
+static void flush_wrapper_png(png_structp png) {
+    washdc_hostfile fp = (washdc_hostfile)png_get_io_ptr(png);
+    washdc_hostfile_flush(fp);
+}
+
+static int load_png(char const *path, struct pvr2_tex_pack_img *img) {
+    washdc_hostfile fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                              WASHDC_HOSTFILE_BINARY);
+    if (fp == WASHDC_HOSTFILE_INVALID)
+        return -1;
+
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                                 NULL, NULL, NULL);
+    png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+    if (!info_ptr) {
+        png_destroy_read_struct(&png_ptr, NULL, NULL);
+        washdc_hostfile_close(fp);
+        return -1;
+    }
+
+    // these need to be volatile since they change after the setjmp
+    uint8_t *volatile rgba = NULL;
+    png_bytepp volatile rows = NULL;
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        free(rgba);
+        free(rows);
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        washdc_hostfile_close(fp);
+        return -1;
+    }
+
+    png_set_read_fn(png_ptr, fp, read_wrapper_png);
+    png_read_info(png_ptr, info_ptr);
+
+    // convert whatever's in the file to 8-bit RGBA
+    png_set_expand(png_ptr);
+    png_set_strip_16(png_ptr);
+    png_set_gray_to_rgb(png_ptr);
+    png_set_add_alpha(png_ptr, 0xff, PNG_FILLER_AFTER);
+    png_read_update_info(png_ptr, info_ptr);
+
+    unsigned width = png_get_image_width(png_ptr, info_ptr);
+    unsigned height = png_get_image_height(png_ptr, info_ptr);
+    if (png_get_channels(png_ptr, info_ptr) != 4 || !width || !height ||
+        width > TEX_PACK_MAX_SIDE || height > TEX_PACK_MAX_SIDE)
+        png_error(png_ptr, "unsupported image");
+
+    rgba = (uint8_t*)malloc((size_t)width * height * 4);
+    rows = (png_bytepp)malloc(height * sizeof(png_bytep));
+    if (!rgba || !rows)
+        png_error(png_ptr, "out of memory");
+    unsigned row;
+    for (row = 0; row < height; row++)
+        rows[row] = rgba + (size_t)row * width * 4;
+
+    png_read_image(png_ptr, rows);
+    png_read_end(png_ptr, NULL);
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    washdc_hostfile_close(fp);
+    free(rows);
+
+    // ARGB8888 is a native-endian 0xAARRGGBB, so this works in place
+    size_t n_pix = (size_t)width * height, pix_no;
+    uint32_t *argb = (uint32_t*)rgba;
+    for (pix_no = 0; pix_no < n_pix; pix_no++) {
+        uint8_t const *px = rgba + pix_no * 4;
+        argb[pix_no] = ((uint32_t)px[3] << 24) | ((uint32_t)px[0] << 16) |
+            ((uint32_t)px[1] << 8) | (uint32_t)px[2];
+    }
+
+    img->dat = rgba;
+    img->n_bytes = n_pix * sizeof(uint32_t);
+    img->width = width;
+    img->height = height;
+    img->mipmap = false;
+    build_mip_chain(img);
+
+    return 0;
+}
+
+// box-filter a square power-of-two image down to 1x1
+static void build_mip_chain(struct pvr2_tex_pack_img *img) {
+    unsigned side = img->width;
+    if (side != img->height || (side & (side - 1)))
+        return;
+
+    size_t n_pix = 0;
+    unsigned level_side;
+    for (level_side = side; level_side; level_side /= 2)
+        n_pix += (size_t)level_side * level_side;
+
+    uint32_t *chain = (uint32_t*)realloc(img->dat, n_pix * sizeof(uint32_t));
+    if (!chain)
+        return;
+
+    uint32_t const *src = chain;
+    uint32_t *dst = chain + (size_t)side * side;
+    for (level_side = side / 2; level_side; level_side /= 2) {
+        unsigned src_side = level_side * 2, row, col;
+        for (row = 0; row < level_side; row++) {
+            for (col = 0; col < level_side; col++) {
+                uint32_t const *quad = src + 2 * row * src_side + 2 * col;
+                uint32_t texels[4] = {
+                    quad[0], quad[1], quad[src_side], quad[src_side + 1]
+                };
+                uint32_t out = 0;
+                unsigned shift;
+                for (shift = 0; shift < 32; shift += 8) {
+                    unsigned sum = 2;
+                    unsigned idx;
+                    for (idx = 0; idx < 4; idx++)
+                        sum += (texels[idx] >> shift) & 0xff;
+                    out |= (uint32_t)(sum / 4) << shift;
+                }
+                dst[row * level_side + col] = out;
+            }
+        }
+        src = dst;
+        dst += (size_t)level_side * level_side;
+    }
+
+    img->dat = chain;
+    img->n_bytes = n_pix * sizeof(uint32_t);
+    img->mipmap = true;
+}
+
+static inline void argb_to_rgba(uint8_t *dst, uint32_t argb) {
+    dst[0] = argb >> 16;
+    dst[1] = argb >> 8;
+    dst[2] = argb;
+    dst[3] = argb >> 24;
+}
+
+static inline uint32_t expand_bits(uint32_t val, unsigned n_bits) {
+    return (val << (8 - n_bits)) | (val >> (2 * n_bits - 8));
+}
+
+// convert the first level of a decoded texture to 8-bit RGBA
+static void job_to_rgba(uint8_t *dst, struct tex_pack_job const *job) {
+    size_t n_pix = (size_t)job->width * job->height, pix_no;
+    uint16_t const *dat16 = (uint16_t const*)job->dat;
+    uint32_t const *dat32 = (uint32_t const*)job->dat;
+
+    switch (job->fmt) {
+    case GFX_TEX_FMT_ARGB_1555:
+        for (pix_no = 0; pix_no < n_pix; pix_no++, dst += 4) {
+            uint16_t px = dat16[pix_no];
+            dst[0] = expand_bits((px >> 10) & 0x1f, 5);
+            dst[1] = expand_bits((px >> 5) & 0x1f, 5);
+            dst[2] = expand_bits(px & 0x1f, 5);
+            dst[3] = (px & 0x8000) ? 0xff : 0;
+        }
+        break;
+    case GFX_TEX_FMT_RGB_565:
+        for (pix_no = 0; pix_no < n_pix; pix_no++, dst += 4) {
+            uint16_t px = dat16[pix_no];
+            dst[0] = expand_bits((px >> 11) & 0x1f, 5);
+            dst[1] = expand_bits((px >> 5) & 0x3f, 6);
+            dst[2] = expand_bits(px & 0x1f, 5);
+            dst[3] = 0xff;
+        }
+        break;
+    case GFX_TEX_FMT_ARGB_4444:
+        for (pix_no = 0; pix_no < n_pix; pix_no++, dst += 4) {
+            uint16_t px = dat16[pix_no];
+            dst[0] = ((px >> 8) & 0xf) * 0x11;
+            dst[1] = ((px >> 4) & 0xf) * 0x11;
+            dst[2] = (px & 0xf) * 0x11;
+            dst[3] = ((px >> 12) & 0xf) * 0x11;
+        }
+        break;
+    case GFX_TEX_FMT_ARGB_8888:
+        for (pix_no = 0; pix_no < n_pix; pix_no++, dst += 4)
+            argb_to_rgba(dst, dat32[pix_no]);
+        break;
+    case GFX_TEX_FMT_YUV_422:
+        washdc_conv_yuv422_rgba8888(dst, job->dat, job->width, job->height);
+        break;
+    case GFX_TEX_FMT_PAL_INDEX16:
+        for (pix_no = 0; pix_no < n_pix; pix_no++, dst += 4)
+            argb_to_rgba(dst, job->palette[dat16[pix_no] % GFX_PALETTE_LEN]);
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+static int dump_png(struct tex_pack_job const *job) {
+    char name[32], path[TEX_PACK_PATH_LEN];
+    snprintf(name, sizeof(name), "%016llx.png", (unsigned long long)job->hash);
+    join_path(path, dump_dir, name);
+
+    uint8_t *rgba = (uint8_t*)malloc((size_t)job->width * job->height * 4);
+    png_bytepp rows = (png_bytepp)malloc(job->height * sizeof(png_bytep));
+    if (!rgba || !rows) {
+        free(rgba);
+        free(rows);
+        return -1;
+    }
+    job_to_rgba(rgba, job);
+    unsigned row;
+    for (row = 0; row < job->height; row++)
+        rows[row] = rgba + (size_t)row * job->width * 4;
+
+    int err_val = -1;
+    washdc_hostfile fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                                              WASHDC_HOSTFILE_BINARY);
+    png_structp png_ptr = NULL;
+    png_infop info_ptr = NULL;
+    if (fp == WASHDC_HOSTFILE_INVALID)
+        goto done;
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png_ptr)
+        goto close_file;
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr)
+        goto destroy_png;
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+        goto destroy_png;
+
+    png_set_write_fn(png_ptr, fp, write_wrapper_png, flush_wrapper_png);
+    png_set_IHDR(png_ptr, info_ptr, job->width, job->height, 8,
+                 PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+    png_write_image(png_ptr, rows);
+    png_write_end(png_ptr, info_ptr);
+    err_val = 0;
+
+destroy_png:
+    png_destroy_write_struct(&png_ptr, info_ptr ? &info_ptr : NULL);
+close_file:
+    washdc_hostfile_close(fp);
+done:
+    free(rows);
+    free(rgba);
+
+    if (err_val == 0) {
+        washdc_mutex_lock(&dump_idx_lock);
+        washdc_hostfile_printf(dump_idx, "%016llx %s\n",
+                               (unsigned long long)job->hash, name);
+        washdc_hostfile_flush(dump_idx);
+        washdc_mutex_unlock(&dump_idx_lock);
+    }
+
+    return err_val;
+}
@@ -0,0 +1,99 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef PVR2_TEX_PACK_H_
+#define PVR2_TEX_PACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "washdc/gfx/tex_cache.h"
+
+/*
+ * texture dumping and replacement packs.
+ *
+ * Textures are identified by an XXH64 hash of their guest-side contents (see
+ * pvr2_tex_cache_read), which doesn't depend on where they are in texture
+ * memory or how the renderer is configured.  A pack is a directory holding
+ * PNG images and an index file named PVR2_TEX_PACK_INDEX, which has one line
+ * for each replacement:
+ *
+ *     <16 hex digit hash> <path of the PNG, relative to the pack directory>
+ *
+ * Blank lines and lines starting with # are ignored.  Dumping writes
+ * <hash>.png for every texture it hasn't seen before along with a matching
+ * index, so a dump directory is also a pack that replaces every texture with
+ * itself until somebody edits the images.
+ *
+ * Images are written and decoded on a pool of worker threads.  Replacements
+ * are decoded into ARGB8888 with a full mip chain (when they're square and a
+ * power of two), so they can be uploaded as-is; until that's done, the
+ * original texture gets used.
+ */
+
+#define PVR2_TEX_PACK_INDEX "textures.idx"
+
+// either directory may be NULL or empty to turn that feature off
+void pvr2_tex_pack_init(char const *dump_dir, char const *pack_dir);
+void pvr2_tex_pack_cleanup(void);
+
+// true if either dumping or replacement is enabled
+bool pvr2_tex_pack_active(void);
+bool pvr2_tex_pack_dumping(void);
+
+/*
+ * queue the first level of a decoded texture to be written to the dump
+ * directory, unless a texture with the same hash has already been dumped.
+ * The data gets copied.  palette is only used for GFX_TEX_FMT_PAL_INDEX16,
+ * and it holds GFX_PALETTE_LEN entries in GFX_TEX_FMT_ARGB_8888 format.
+ */
+void pvr2_tex_pack_dump(uint64_t hash, void const *dat, enum gfx_tex_fmt fmt,
+                        unsigned width, unsigned height,
+                        uint32_t const *palette);
+
+/*
+ * look up the replacement for the given hash.  This returns -1 if there isn't
+ * one; otherwise it starts decoding the replacement if that hasn't been done
+ * already and returns a handle for pvr2_tex_pack_take.
+ */
+int pvr2_tex_pack_request(uint64_t hash);
+
+// a decoded replacement in GFX_TEX_FMT_ARGB_8888
+struct pvr2_tex_pack_img {
+    void *dat;
+    size_t n_bytes;
+    unsigned width, height;
+
+    // if true, dat holds every level down to 1x1, starting with the largest
+    bool mipmap;
+};
+
+/*
+ * returns 1 and hands img over to the caller (who has to free img->dat) if
+ * the replacement is done decoding, 0 if it isn't, and -1 if it couldn't be
+ * loaded.  After this returns 1, the replacement needs to be requested again
+ * to get another copy of it.
+ */
+int pvr2_tex_pack_take(int handle, struct pvr2_tex_pack_img *img);
+
+#endif
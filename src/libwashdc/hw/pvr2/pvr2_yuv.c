@@ -20,6 +20,10 @@
  *
  ******************************************************************************/
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "log.h"
 #include "washdc/error.h"
 #include "pvr2_tex_mem.h"
@@ -33,14 +37,18 @@
 
 #include "pvr2_yuv.h"
 
-static void pvr2_yuv_input_byte(struct pvr2 *pvr2, unsigned byte);
+static void pvr2_yuv_macroblock(struct pvr2 *pvr2, uint8_t const *mb);
 static void
 pvr2_yuv_complete_int_event_handler(struct SchedEvent *event);
 
 void pvr2_yuv_init(struct pvr2 *pvr2) {
     pvr2->yuv.pvr2_yuv_complete_int_event.handler =
         pvr2_yuv_complete_int_event_handler;
+    pvr2->yuv.pvr2_yuv_complete_int_event.name =
+        "pvr2_yuv_complete_int_event_handler";
     pvr2->yuv.pvr2_yuv_complete_int_event.arg_ptr = pvr2;
+    sched_event_register(&pvr2->yuv.pvr2_yuv_complete_int_event,
+                         "pvr2_yuv_complete_int");
 }
 
 void pvr2_yuv_cleanup(struct pvr2 *pvr2) {
@@ -117,74 +125,98 @@ void pvr2_yuv_input_data(struct pvr2 *pvr2, void const *dat, unsigned n_bytes) {
     if ((pvr2->yuv.dst_addr + 3) >= (ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1))
         RAISE_ERROR(ERROR_INTEGRITY);
 
+    struct pvr2_yuv *yuv = &pvr2->yuv;
+    if (yuv->fmt != PVR2_YUV_FMT_420)
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+
     uint8_t const *dat8 = (uint8_t const*)dat;
 
     while (n_bytes) {
-        uint8_t dat_byte;
-        memcpy(&dat_byte, dat8, sizeof(dat_byte));
-        pvr2_yuv_input_byte(pvr2, dat_byte);
-        dat8++;
-        n_bytes--;
+        if (!yuv->macroblock_offset &&
+            n_bytes >= PVR2_YUV_420_MACROBLOCK_BYTES) {
+            // whole macroblocks get converted straight out of the input
+            pvr2_yuv_macroblock(pvr2, dat8);
+            dat8 += PVR2_YUV_420_MACROBLOCK_BYTES;
+            n_bytes -= PVR2_YUV_420_MACROBLOCK_BYTES;
+        } else {
+            unsigned n_copy =
+                PVR2_YUV_420_MACROBLOCK_BYTES - yuv->macroblock_offset;
+            if (n_copy > n_bytes)
+                n_copy = n_bytes;
+            memcpy(yuv->macroblock_buf + yuv->macroblock_offset,
+                   dat8, n_copy);
+            yuv->macroblock_offset += n_copy;
+            dat8 += n_copy;
+            n_bytes -= n_copy;
+
+            if (yuv->macroblock_offset == PVR2_YUV_420_MACROBLOCK_BYTES) {
+                yuv->macroblock_offset = 0;
+                pvr2_yuv_macroblock(pvr2, yuv->macroblock_buf);
+            }
+        }
     }
 }
 
-static void pvr2_yuv_macroblock(struct pvr2 *pvr2) {
+/*
+ * convert one row of a macroblock to YUV422.  lum_left and lum_right each
+ * point to eight luminance samples, and u_row and v_row each point to eight
+ * chrominance samples.
+ */
+static inline void
+pvr2_yuv_row(uint32_t out[8], uint8_t const *lum_left,
+             uint8_t const *lum_right, uint8_t const *u_row,
+             uint8_t const *v_row) {
+#ifdef __SSE2__
+    __m128i lum = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i const*)lum_left),
+                                     _mm_loadl_epi64((__m128i const*)lum_right));
+    __m128i chrom = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const*)u_row),
+                                      _mm_loadl_epi64((__m128i const*)v_row));
+
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(chrom, lum));
+    _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi8(chrom, lum));
+#else
+    unsigned col;
+    for (col = 0; col < 8; col++) {
+        uint8_t const *lum = col < 4 ?
+            lum_left + col * 2 : lum_right + (col - 4) * 2;
+        out[col] = u_row[col] | (lum[0] << 8) |
+            (v_row[col] << 16) | ((uint32_t)lum[1] << 24);
+    }
+#endif
+}
+
+static DEF_ERROR_INT_ATTR(macroblock_count_x)
+static DEF_ERROR_INT_ATTR(macroblock_count_y)
+static DEF_ERROR_INT_ATTR(cur_macroblock_x)
+static DEF_ERROR_INT_ATTR(cur_macroblock_y)
+
+// convert a complete 16x16 macroblock and write it to texture memory
+static void pvr2_yuv_macroblock(struct pvr2 *pvr2, uint8_t const *mb) {
     struct pvr2_yuv *yuv = &pvr2->yuv;
     uint32_t block[16][8];
 
-    if (yuv->cur_macroblock_x >= yuv->macroblock_count_x) {
-        LOG_ERROR("yuv->cur_macroblock_x is %u\n", yuv->cur_macroblock_x);
-        LOG_ERROR("yuv->macroblock_count_x is %u\n", yuv->macroblock_count_x);
+    if (yuv->cur_macroblock_x >= yuv->macroblock_count_x ||
+        yuv->cur_macroblock_y >= yuv->macroblock_count_y) {
+        error_set_cur_macroblock_x(yuv->cur_macroblock_x);
+        error_set_cur_macroblock_y(yuv->cur_macroblock_y);
+        error_set_macroblock_count_x(yuv->macroblock_count_x);
+        error_set_macroblock_count_y(yuv->macroblock_count_y);
         RAISE_ERROR(ERROR_INTEGRITY);
     }
-    if (yuv->cur_macroblock_y >= yuv->macroblock_count_y) {
-        // TODO: should reset to zero here
-        LOG_ERROR("yuv->cur_macroblock_y is %u\n", yuv->cur_macroblock_y);
-        LOG_ERROR("yuv->macroblock_count_y is %u\n", yuv->macroblock_count_y);
-        RAISE_ERROR(ERROR_UNIMPLEMENTED);
-    }
-
-    unsigned row, col;
-    for (row = 0; row < 16; row++) {
-        for (col = 0; col < 8; col++) {
-            /*
-             * For the luminance component, each macro block is stored as four
-             * 8x8 sub-macroblocks, each of which is contiguous.
-             */
-            unsigned col_lum, row_lum;
-            unsigned lum_start;
-            if (row < 8) {
-                if (col < 4) {
-                    lum_start = 0;
-                    col_lum = col;
-                    row_lum = row;
-                } else {
-                    lum_start = 0x40;
-                    col_lum = col - 4;
-                    row_lum = row;
-                }
-            } else {
-                if (col < 4) {
-                    lum_start = 0x80;
-                    col_lum = col;
-                    row_lum = row - 8;
-                } else {
-                    lum_start = 0xc0;
-                    col_lum = col - 4;
-                    row_lum = row - 8;
-                }
-            }
-
-            unsigned lum[2] = {
-                yuv->y_buf[row_lum * 8 + col_lum * 2 + lum_start],
-                yuv->y_buf[row_lum * 8 + col_lum * 2 + lum_start + 1],
-            };
 
-            unsigned u_val = yuv->u_buf[(row / 2) * 8 + col];
-            unsigned v_val = yuv->v_buf[(row / 2) * 8 + col];
+    uint8_t const *u_buf = mb;
+    uint8_t const *v_buf = mb + 64;
+    uint8_t const *y_buf = mb + 128;
 
-            block[row][col] = (lum[0] << 8) | (lum[1] << 24) | u_val | (v_val << 16);
-        }
+    unsigned row;
+    for (row = 0; row < 16; row++) {
+        /*
+         * For the luminance component, each macro block is stored as four
+         * 8x8 sub-macroblocks, each of which is contiguous.
+         */
+        uint8_t const *lum = y_buf + (row % 8) * 8 + (row < 8 ? 0 : 0x80);
+        pvr2_yuv_row(block[row], lum, lum + 0x40,
+                     u_buf + (row / 2) * 8, v_buf + (row / 2) * 8);
     }
 
     unsigned linestride = 2 * 16 * yuv->macroblock_count_x;
@@ -210,42 +242,6 @@ static void pvr2_yuv_macroblock(struct pvr2 *pvr2) {
     }
 }
 
-static DEF_ERROR_INT_ATTR(macroblock_count_x)
-static DEF_ERROR_INT_ATTR(macroblock_count_y)
-static DEF_ERROR_INT_ATTR(cur_macroblock_x)
-static DEF_ERROR_INT_ATTR(cur_macroblock_y)
-
-static void pvr2_yuv_input_byte(struct pvr2 *pvr2, unsigned dat) {
-    struct pvr2_yuv *yuv = &pvr2->yuv;
-    if (yuv->fmt != PVR2_YUV_FMT_420)
-        RAISE_ERROR(ERROR_UNIMPLEMENTED);
-
-    if (yuv->macroblock_offset < 64) {
-        yuv->u_buf[yuv->macroblock_offset++] = dat;
-    } else if (yuv->macroblock_offset < 128) {
-        yuv->v_buf[yuv->macroblock_offset++ - 64] = dat;
-    } else if (yuv->macroblock_offset < 384) {
-        yuv->y_buf[yuv->macroblock_offset++ - 128] = dat;
-    } else {
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
-
-    if (yuv->macroblock_offset == 384) {
-        yuv->macroblock_offset = 0;
-
-        if (yuv->cur_macroblock_x >= yuv->macroblock_count_x ||
-            yuv->cur_macroblock_y >= yuv->macroblock_count_y) {
-            error_set_cur_macroblock_x(yuv->cur_macroblock_x);
-            error_set_cur_macroblock_y(yuv->cur_macroblock_y);
-            error_set_macroblock_count_x(yuv->macroblock_count_x);
-            error_set_macroblock_count_y(yuv->macroblock_count_y);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-
-        pvr2_yuv_macroblock(pvr2);
-    }
-}
-
 static uint32_t pvr2_ta_fifo_yuv_read_32(addr32_t addr, void *ctxt) {
     error_set_length(4);
     error_set_address(addr);
@@ -278,21 +274,21 @@ static double pvr2_ta_fifo_yuv_read_double(addr32_t addr, void *ctxt) {
 
 static void pvr2_ta_fifo_yuv_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     struct pvr2 *pvr2 = (struct pvr2*)ctxt;
-    pvr2_yuv_input_byte(pvr2, val & 0xff);
-    pvr2_yuv_input_byte(pvr2, (val >> 8) & 0xff);
-    pvr2_yuv_input_byte(pvr2, (val >> 16) & 0xff);
-    pvr2_yuv_input_byte(pvr2, (val >> 24) & 0xff);
+    uint8_t dat[4] = {
+        val & 0xff, (val >> 8) & 0xff, (val >> 16) & 0xff, (val >> 24) & 0xff
+    };
+    pvr2_yuv_input_data(pvr2, dat, sizeof(dat));
 }
 
 static void pvr2_ta_fifo_yuv_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     struct pvr2 *pvr2 = (struct pvr2*)ctxt;
-    pvr2_yuv_input_byte(pvr2, val & 0xff);
-    pvr2_yuv_input_byte(pvr2, (val >> 8) & 0xff);
+    uint8_t dat[2] = { val & 0xff, (val >> 8) & 0xff };
+    pvr2_yuv_input_data(pvr2, dat, sizeof(dat));
 }
 
 static void pvr2_ta_fifo_yuv_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     struct pvr2 *pvr2 = (struct pvr2*)ctxt;
-    pvr2_yuv_input_byte(pvr2, val);
+    pvr2_yuv_input_data(pvr2, &val, sizeof(val));
 }
 
 static void pvr2_ta_fifo_yuv_write_float(addr32_t addr, float val, void *ctxt) {
@@ -33,6 +33,9 @@ void pvr2_yuv_set_tex_ctrl(struct pvr2 *pvr2, uint32_t new_tex_ctrl);
 
 void pvr2_yuv_input_data(struct pvr2 *pvr2, void const *dat, unsigned n_bytes);
 
+// size of a single 16x16 YUV420 macroblock when it's sent to the FIFO
+#define PVR2_YUV_420_MACROBLOCK_BYTES 384
+
 enum pvr2_yuv_fmt {
     PVR2_YUV_FMT_420,
     PVR2_YUV_FMT_422
@@ -48,9 +51,11 @@ struct pvr2_yuv {
     // width and height, in terms of 16x16 macroblocks
     unsigned macroblock_count_x, macroblock_count_y;
 
-    uint8_t u_buf[64];
-    uint8_t v_buf[64];
-    uint8_t y_buf[256];
+    /*
+     * partially-received macroblock.  The first 64 bytes are U, the next 64
+     * are V and the final 256 are Y, stored as four 8x8 blocks.
+     */
+    uint8_t macroblock_buf[PVR2_YUV_420_MACROBLOCK_BYTES];
 
     bool yuv_complete_event_scheduled;
 
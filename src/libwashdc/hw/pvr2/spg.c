@@ -121,6 +121,9 @@ static void spg_handle_pre_vblank_out(SchedEvent *event);
 
 static void spg_unsched_all(struct pvr2 *pvr2);
 
+static void spg_hblank_mask_change(void *arg, bool unmasked);
+static bool spg_hblank_poll(void *arg);
+
 static inline bool get_interlace(struct pvr2 *pvr2);
 static inline unsigned get_pclk_div(struct pvr2 *pvr2);
 
@@ -137,15 +140,26 @@ void spg_init(struct pvr2 *pvr2, struct maple *maple) {
     spg->reg[SPG_LOAD] = (0x106 << 16) | 0x359;
 
     spg->hblank_event.handler = spg_handle_hblank;
+    spg->hblank_event.name = "spg_handle_hblank";
     spg->vblank_in_event.handler = spg_handle_vblank_in;
+    spg->vblank_in_event.name = "spg_handle_vblank_in";
     spg->vblank_out_event.handler = spg_handle_vblank_out;
+    spg->vblank_out_event.name = "spg_handle_vblank_out";
     spg->pre_vblank_out_event.handler = spg_handle_pre_vblank_out;
+    spg->pre_vblank_out_event.name = "spg_handle_pre_vblank_out";
 
     spg->hblank_event.arg_ptr = pvr2;
     spg->vblank_in_event.arg_ptr = pvr2;
     spg->vblank_out_event.arg_ptr = pvr2;
     spg->pre_vblank_out_event.arg_ptr = pvr2;
 
+    sched_event_register(&spg->hblank_event, "spg_hblank");
+    sched_event_register(&spg->vblank_in_event, "spg_vblank_in");
+    sched_event_register(&spg->vblank_out_event, "spg_vblank_out");
+    sched_event_register(&spg->pre_vblank_out_event, "spg_pre_vblank_out");
+
+    holly_intc_set_hblank_hooks(spg_hblank_mask_change, spg_hblank_poll, pvr2);
+
     sched_next_hblank_event(pvr2);
     sched_next_vblank_in_event(pvr2);
     sched_next_vblank_out_event(pvr2);
@@ -153,6 +167,7 @@ void spg_init(struct pvr2 *pvr2, struct maple *maple) {
 }
 
 void spg_cleanup(struct pvr2 *pvr2) {
+    holly_intc_set_hblank_hooks(NULL, NULL, NULL);
 }
 
 static void spg_unsched_all(struct pvr2 *pvr2) {
@@ -277,6 +292,11 @@ static void spg_handle_pre_vblank_out(SchedEvent *event) {
 /*
  * Make sure you call spg_sync before calling this function
  * also make sure the event isn't already scheduled
+ *
+ * In mode 2 there's an H-BLANK on every line, which is a lot of events for
+ * something that most games keep masked.  The event only gets scheduled when
+ * the interrupt is unmasked; otherwise hblank_event.when is just remembered so
+ * that spg_hblank_poll can tell if an H-BLANK went by.
  */
 static void sched_next_hblank_event(struct pvr2 *pvr2) {
     struct pvr2_spg *spg = &pvr2->spg;
@@ -321,8 +341,38 @@ static void sched_next_hblank_event(struct pvr2 *pvr2) {
     spg->hblank_event.when = (SPG_VCLK_DIV * get_pclk_div(pvr2)) *
         (next_hblank_pclk + clock_cycle_stamp(pvr2->clk) / (SPG_VCLK_DIV * get_pclk_div(pvr2)));
 
-    sched_event(pvr2->clk, &spg->hblank_event);
-    spg->hblank_event_scheduled = true;
+    if (holly_nrm_int_unmasked(HOLLY_NRM_INT_HBLANK)) {
+        sched_event(pvr2->clk, &spg->hblank_event);
+        spg->hblank_event_scheduled = true;
+    }
+}
+
+static void spg_hblank_mask_change(void *arg, bool unmasked) {
+    struct pvr2 *pvr2 = (struct pvr2*)arg;
+    struct pvr2_spg *spg = &pvr2->spg;
+
+    if (unmasked) {
+        if (!spg->hblank_event_scheduled) {
+            spg_sync(pvr2);
+            sched_next_hblank_event(pvr2);
+        }
+    } else if (spg->hblank_event_scheduled) {
+        cancel_event(pvr2->clk, &spg->hblank_event);
+        spg->hblank_event_scheduled = false;
+    }
+}
+
+static bool spg_hblank_poll(void *arg) {
+    struct pvr2 *pvr2 = (struct pvr2*)arg;
+    struct pvr2_spg *spg = &pvr2->spg;
+
+    if (spg->hblank_event_scheduled ||
+        clock_cycle_stamp(pvr2->clk) < spg->hblank_event.when)
+        return false;
+
+    spg_sync(pvr2);
+    sched_next_hblank_event(pvr2);
+    return true;
 }
 
 /*
@@ -31,6 +31,7 @@
 #include "washdc/error.h"
 #include "dreamcast.h"
 #include "sh4_jit.h"
+#include "config.h"
 
 #include "sh4.h"
 
@@ -40,6 +41,7 @@ static struct error_callback sh4_error_callback;
 
 void sh4_init(Sh4 *sh4, struct dc_clock *clk) {
     memset(sh4, 0, sizeof(*sh4));
+    sh4->intc.pending_prio = -1;
     sh4->reg_area = (uint8_t*)malloc(sizeof(uint8_t) * (SH4_P4_REGEND - SH4_P4_REGSTART));
     sh4->clk = clk;
 
@@ -49,6 +51,8 @@ void sh4_init(Sh4 *sh4, struct dc_clock *clk) {
 
     sh4_ocache_init(&sh4->ocache);
 
+    sh4_icache_init(&sh4->icache);
+
     sh4_tmu_init(sh4);
 
     sh4_scif_init(sh4);
@@ -59,7 +63,7 @@ void sh4_init(Sh4 *sh4, struct dc_clock *clk) {
 
     sh4_on_hard_reset(sh4);
 
-    sh4_init_inst_lut();
+    sh4_inst_set_fpu_pedantic(config_get_fpu_pedantic());
 
     sh4_jit_init(sh4);
 
@@ -100,6 +104,8 @@ void sh4_on_hard_reset(Sh4 *sh4) {
 
     sh4_set_fpscr(sh4, 0x40001);
 
+    sh4_icache_invalidate_all(&sh4->icache);
+
     unsigned idx;
     for (idx = 0; idx < SH4_N_FLOAT_REGS; idx++) {
         *sh4_fpu_fr(sh4, idx) = 0.0f;
@@ -169,6 +175,12 @@ void sh4_on_sr_change(Sh4 *sh4, reg32_t old_sr) {
 
     sh4_bank_switch_maybe(sh4, old_sr, new_sr);
 
+#ifdef ENABLE_MMU
+    // asid_check looks at SR.MD
+    if ((old_sr ^ new_sr) & SH4_SR_MD_MASK)
+        sh4_soft_tlb_flush(sh4);
+#endif
+
     if ((old_sr & SH4_INTC_SR_BITS) != (new_sr & SH4_INTC_SR_BITS))
         sh4_refresh_intc_deferred(sh4);
 }
@@ -35,11 +35,13 @@
 #include "sh4_mem.h"
 #include "sh4_tmu.h"
 #include "sh4_ocache.h"
+#include "sh4_icache.h"
 #include "sh4_excp.h"
 #include "sh4_scif.h"
 #include "sh4_dmac.h"
 #include "dc_sched.h"
 #include "atomics.h"
+#include "jit/jit_arena.h"
 
 #ifdef JIT_PROFILE
 #include "jit/jit_profile.h"
@@ -59,6 +61,8 @@ static_assert(SCHED_FREQUENCY % (200 * 1000 * 1000) == 0,
 
 /* Hitachi SuperH-4 interpreter */
 
+struct code_cache;
+
 #define SH4_N_FLOAT_REGS 16
 #define SH4_N_DOUBLE_REGS 8
 
@@ -69,29 +73,19 @@ enum Sh4ExecState {
 };
 typedef enum Sh4ExecState Sh4ExecState;
 
-struct Sh4 {
-    struct dc_clock *clk;
-
-    Sh4ExecState exec_state;
-
-    reg32_t reg[SH4_REGISTER_COUNT];
+// size of a host cache line, used for laying out struct Sh4
+#define SH4_HOST_CACHE_LINE 64
 
+struct Sh4 {
     /*
-     * read/write handlers for implementing the PDTRA register; this register
-     * corresponds to external I/O pins on the SH4.  The PCTRA register is
-     * used to set these pins to input or output mode.
-     *
-     * On Dreamcast, PDTRA is connected to video hardware, and is used to
-     * determine what type of video cable is being used.
-     *
-     * On Hikaru, PDTRA is used for IRQ multiplexing; when IRL 2 is raised, the
-     * IRQ handler will individually check bits 0x40, 0x80, 0x100, and 0x200
-     * (see PC=0c001748 in hikaru firmware).
+     * Hot state - everything from here to the end of reg[] gets touched by
+     * every instruction the interpreter runs and by most native blocks, so
+     * it's kept together at the front of the struct and away from the
+     * per-module state below.
      */
+    struct dc_clock *clk;
 
-    uint32_t(*pdtra_read_handler)(struct Sh4 *);
-    void(*pdtra_write_handler)(struct Sh4*, uint32_t);
-
+    Sh4ExecState exec_state;
 
     /*
      * If the CPU is executing a delayed branch instruction, then
@@ -117,6 +111,39 @@ struct Sh4 {
      */
     bool dont_increment_pc;
 
+    /*
+     * this is used by sh4_count_inst_cycles to track the type of the last
+     * instruction that was executed.  This is used to determine if the next
+     * instruction to be executed should advance the cycle count, or if it
+     * would have been executed by the second pipeline on a real sh4.
+     */
+    sh4_inst_group_t last_inst_type;
+
+    /*
+     * The register file starts on a cache line of its own.  The jit addresses
+     * it relative to sh4->reg, and everything it touches (R0-R15, the banked
+     * registers, both FPU banks, FPSCR, FPUL, SR through PC) is at the front
+     * of the array so that it fits in five lines.  The rest of the array is
+     * memory-mapped registers which are rarely accessed.
+     */
+    _Alignas(SH4_HOST_CACHE_LINE) reg32_t reg[SH4_REGISTER_COUNT];
+
+    /*
+     * read/write handlers for implementing the PDTRA register; this register
+     * corresponds to external I/O pins on the SH4.  The PCTRA register is
+     * used to set these pins to input or output mode.
+     *
+     * On Dreamcast, PDTRA is connected to video hardware, and is used to
+     * determine what type of video cable is being used.
+     *
+     * On Hikaru, PDTRA is used for IRQ multiplexing; when IRL 2 is raised, the
+     * IRQ handler will individually check bits 0x40, 0x80, 0x100, and 0x200
+     * (see PC=0c001748 in hikaru firmware).
+     */
+
+    uint32_t(*pdtra_read_handler)(struct Sh4 *);
+    void(*pdtra_write_handler)(struct Sh4*, uint32_t);
+
     struct sh4_tmu tmu;
 
     /*
@@ -125,6 +152,8 @@ struct Sh4 {
      */
     struct sh4_ocache ocache;
 
+    struct sh4_icache icache;
+
     struct sh4_intc intc;
 
     struct sh4_scif scif;
@@ -137,24 +166,28 @@ struct Sh4 {
     struct jit_profile_ctxt jit_profile;
 #endif
 
+    /*
+     * code cache that holds the jit's SH4 blocks.  This is NULL when the jit
+     * is not in use.
+     */
+    struct code_cache *code_cache;
+
+    // scratch space for the il of whatever block the jit is compiling
+    struct jit_arena il_arena;
+
     /*
      * pointer to place where memory-mapped registers are stored.
      * RegReadHandlers and RegWriteHandlers do not need to use this as long as
      * they are consistent.
      */
     uint8_t *reg_area;
-
-    /*
-     * this is used by sh4_count_inst_cycles to track the type of the last
-     * instruction that was executed.  This is used to determine if the next
-     * instruction to be executed should advance the cycle count, or if it
-     * would have been executed by the second pipeline on a real sh4.
-     */
-     sh4_inst_group_t last_inst_type;
 };
 
 typedef struct Sh4 Sh4;
 
+static_assert((SH4_REG_PC + 1) * sizeof(reg32_t) <= 5 * SH4_HOST_CACHE_LINE,
+              "hot SH4 registers no longer fit in five cache lines");
+
 void sh4_init(Sh4 *sh4, struct dc_clock *clk);
 void sh4_cleanup(Sh4 *sh4);
 
@@ -321,7 +354,20 @@ dc_cycle_stamp_t sh4_get_cycles(struct Sh4 *sh4);
 
 // Fetches the given instruction's metadata and returns it.
 static inline InstOpcode const *sh4_decode_inst(cpu_inst_param inst) {
-    return sh4_inst_lut[inst & 0xffff];
+    return sh4_opcode_list + sh4_inst_lut[inst & 0xffff];
+}
+
+/*
+ * return the handler that executes inst.  This is the same as
+ * sh4_decode_inst(inst)->func except for opcodes that have a version
+ * specialized on inst's operands.
+ */
+static inline opcode_func_t sh4_decode_inst_func(cpu_inst_param inst) {
+    unsigned op_no = sh4_inst_lut[inst & 0xffff];
+    opcode_func_t const *spec = sh4_inst_spec[op_no];
+    if (spec)
+        return spec[(inst >> 4) & 0xff];
+    return sh4_opcode_list[op_no].func;
 }
 
 /*
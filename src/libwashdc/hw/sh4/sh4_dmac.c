@@ -36,18 +36,30 @@
 #include "dc_sched.h"
 #include "dreamcast.h"
 #include "sh4_read_inst.h"
+#include "jit/code_cache.h"
+#include "savestate.h"
+
+#ifdef ENABLE_WATCHPOINTS
+#include "washdc/debugger.h"
+#endif
 
 static void raise_ch2_dma_int_event_handler(struct SchedEvent *event);
 
 struct SchedEvent raise_ch2_dma_int_event = {
-    .handler = raise_ch2_dma_int_event_handler
+    .handler = raise_ch2_dma_int_event_handler,
+    .name = "raise_ch2_dma_int_event_handler"
 };
 
 static bool ch2_dma_scheduled;
 
+static unsigned long long ch2_bytes_total;
+
 static int sh4_dmac_irq_line(Sh4ExceptionCode *code, void *ctx);
 
 void sh4_dmac_init(Sh4 *sh4) {
+    raise_ch2_dma_int_event.arg_ptr = sh4;
+    sched_event_register(&raise_ch2_dma_int_event, "sh4_dmac_ch2_int");
+
     sh4_register_irq_line(sh4, SH4_IRQ_DMAC, sh4_dmac_irq_line, sh4);
 }
 
@@ -335,6 +347,16 @@ void sh4_dmac_transfer_to_mem(Sh4 *sh4, addr32_t transfer_dst, size_t unit_sz,
     uint32_t addr_mask = region->mask;
     void *ctx = region->ctxt;
 
+    // system memory gets one memcpy and one JIT notification for the lot
+    if (total_len && region->id == MEMORY_MAP_REGION_RAM && region->host &&
+        (transfer_dst & addr_mask) + (total_len - 1) <= addr_mask) {
+        addr32_t first = transfer_dst & addr_mask;
+        memcpy(region->host + first, dat, total_len);
+        code_cache_notify_ram_range(first, first + (total_len - 1));
+        savestate_notify_ram_range(first, first + (total_len - 1));
+        return;
+    }
+
     if (total_len % 4 == 0) {
         memory_map_write32_func write32 = region->intf->write32;
         total_len /= 4;
@@ -429,6 +451,23 @@ void sh4_dmac_transfer_words(Sh4 *sh4, addr32_t transfer_src,
     void *src_ctx = src_region->ctxt;
     void *dst_ctx = dst_region->ctxt;
 
+    /*
+     * transfers out of system memory into a region that can take a whole
+     * block of dwords at once (such as AICA wave memory) get done in one call
+     * as long as neither side wraps around its mirror.
+     */
+    uint64_t n_bytes = (uint64_t)n_words * sizeof(uint32_t);
+    memory_map_write_dwords_func write_dwords = dst_region->intf->write_dwords;
+    if (n_words && write_dwords && src_region->id == MEMORY_MAP_REGION_RAM &&
+        src_region->host && !(transfer_src & 3) && !(transfer_dst & 3) &&
+        (transfer_src & src_mask) + n_bytes <= (uint64_t)src_mask + 1 &&
+        (transfer_dst & dst_mask) + n_bytes <= (uint64_t)dst_mask + 1) {
+        uint32_t const *src =
+            (uint32_t const*)(src_region->host + (transfer_src & src_mask));
+        write_dwords(transfer_dst & dst_mask, src, n_words, dst_ctx);
+        return;
+    }
+
     for (counter = 0; counter < n_words; counter++) {
         CHECK_R_WATCHPOINT(transfer_src, uint32_t);
         CHECK_W_WATCHPOINT(transfer_dst, uint32_t);
@@ -519,6 +558,7 @@ void sh4_dmac_channel2(Sh4 *sh4, addr32_t transfer_dst, unsigned n_bytes) {
             "0x%08x\n", n_bytes, transfer_src, transfer_dst);
 
     sh4->dmac.sar_pending[2] = transfer_src + n_bytes;
+    ch2_bytes_total += n_bytes;
 
     /*
      * TODO: replace this function call with a hook of some sort so that other
@@ -535,10 +575,31 @@ void sh4_dmac_channel2(Sh4 *sh4, addr32_t transfer_dst, unsigned n_bytes) {
      * be different for different dma destinations.
      */
     raise_ch2_dma_int_event.when = clock_cycle_stamp(sh4->clk) + n_cycles;
-    raise_ch2_dma_int_event.arg_ptr = sh4;
     sched_event(sh4->clk, &raise_ch2_dma_int_event);
 }
 
+unsigned long long sh4_dmac_ch2_bytes(void) {
+    return ch2_bytes_total;
+}
+
+static int sh4_dmac_state_xfer(struct savestate_buf *buf, Sh4 *sh4,
+                               bool load) {
+    return SAVESTATE_XFER(buf, load, sh4->dmac) ||
+        SAVESTATE_XFER(buf, load, ch2_dma_scheduled);
+}
+
+void sh4_dmac_state_save(struct savestate_buf *buf, void *ctxt) {
+    sh4_dmac_state_xfer(buf, (Sh4*)ctxt, false);
+}
+
+int sh4_dmac_state_load(struct savestate_buf *buf, void *ctxt) {
+    return sh4_dmac_state_xfer(buf, (Sh4*)ctxt, true);
+}
+
+bool sh4_dmac_busy(Sh4 *sh4) {
+    return ch2_dma_scheduled;
+}
+
 static void raise_ch2_dma_int_event_handler(struct SchedEvent *event) {
     Sh4 *sh4 = event->arg_ptr;
 
@@ -112,7 +112,18 @@ void sh4_dmac_transfer_words(Sh4 *sh4, addr32_t transfer_src,
 // perform a DMA transfer using channel 2's settings
 void sh4_dmac_channel2(Sh4 *sh4, addr32_t transfer_dst, unsigned n_bytes);
 
+// total bytes transferred through sh4_dmac_channel2
+unsigned long long sh4_dmac_ch2_bytes(void);
+
 void sh4_dmac_init(Sh4 *sh4);
 void sh4_dmac_cleanup(Sh4 *sh4);
 
+// save-state section for the DMAC (ctxt is the Sh4)
+struct savestate_buf;
+void sh4_dmac_state_save(struct savestate_buf *buf, void *ctxt);
+int sh4_dmac_state_load(struct savestate_buf *buf, void *ctxt);
+
+// true if a channel 2 transfer is still waiting to raise its interrupt
+bool sh4_dmac_busy(Sh4 *sh4);
+
 #endif
@@ -239,7 +239,8 @@ static void do_sh4_refresh_intc_deferred(SchedEvent *event) {
 }
 
 static SchedEvent sh4_refresh_intc_event = {
-    .handler = do_sh4_refresh_intc_deferred
+    .handler = do_sh4_refresh_intc_deferred,
+    .name = "do_sh4_refresh_intc_deferred"
 };
 
 void sh4_refresh_intc_deferred(Sh4 *sh4) {
@@ -251,10 +252,12 @@ void sh4_refresh_intc_deferred(Sh4 *sh4) {
     }
 }
 
-int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
-    if (sh4->reg[SH4_REG_SR] & SH4_SR_BL_MASK)
-        return -1;
-
+/*
+ * return the priority of the highest-priority IRQ line that's active and
+ * above imask, or -1 if there are none.  This ignores SR.BL.
+ */
+static int
+sh4_intc_scan(Sh4 const *sh4, int imask, struct sh4_irq_meta *irq_meta) {
     /* TODO - NMIs */
 
     int max_prio = -1;
@@ -300,13 +303,14 @@ int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
         }
 
         /* check the sh4's interrupt mask */
-        if (prio > (int)((sh4->reg[SH4_REG_SR] & SH4_SR_IMASK_MASK) >>
-                         SH4_SR_IMASK_SHIFT)) {
+        if (prio > imask) {
             // only take the highest priority irq
             // TODO: priority order
-            if (sh4_irq_line(sh4, line, &max_prio_code) && (prio > max_prio)) {
+            Sh4ExceptionCode line_code;
+            if (sh4_irq_line(sh4, line, &line_code) && (prio > max_prio)) {
                 max_prio = prio;
                 max_prio_line = line;
+                max_prio_code = line_code;
             }
         }
     }
@@ -395,9 +399,7 @@ int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
             }
 
             // TODO: priority order
-            if (prio > max_prio &&
-                (prio > (int)((sh4->reg[SH4_REG_SR] & SH4_SR_IMASK_MASK) >>
-                              SH4_SR_IMASK_SHIFT))) {
+            if (prio > max_prio && prio > imask) {
                 irq_meta->code = code;
                 return prio;
             }
@@ -416,6 +418,17 @@ int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
     return -1;
 }
 
+int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
+    if (sh4->reg[SH4_REG_SR] & SH4_SR_BL_MASK)
+        return -1;
+    return sh4_intc_scan(sh4, sh4_intc_imask(sh4), irq_meta);
+}
+
+void sh4_intc_update(Sh4 *sh4) {
+    struct sh4_irq_meta irq_meta;
+    sh4->intc.pending_prio = sh4_intc_scan(sh4, 0, &irq_meta);
+}
+
 void sh4_excp_icr_reg_write_handler(Sh4 *sh4,
                                     struct Sh4MemMappedReg const *reg_info,
                                     sh4_reg_val val) {
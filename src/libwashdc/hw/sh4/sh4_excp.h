@@ -155,6 +155,16 @@ struct sh4_intc {
 
     sh4_irl_line_fn irl_line;
     void *irl_line_arg;
+
+    /*
+     * priority of the highest-priority active IRQ line as of the last
+     * sh4_intc_update, regardless of SR, or -1 if there are none.  Anything
+     * that raises an IRQ line has to go through sh4_refresh_intc (or
+     * sh4_refresh_intc_deferred) so that this gets updated; lines that drop
+     * without going through there just cost an extra scan the next time
+     * interrupts are checked.
+     */
+    int pending_prio;
 };
 
 void
@@ -202,4 +212,7 @@ void sh4_refresh_intc_deferred(Sh4 *sh4);
 // return the highest-priority pending IRQ, or -1 if there are none.
 int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta);
 
+// poll every IRQ line and update sh4->intc.pending_prio
+void sh4_intc_update(Sh4 *sh4);
+
 #endif
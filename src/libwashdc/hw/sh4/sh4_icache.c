@@ -22,7 +22,8 @@
 
 /*
  * SH-4 Instruction cache.
- * Currently this is not emulated, and it probably never will be.
+ * This is only emulated when config_get_sh4_icache() is set, otherwise the
+ * interpreter and the jit both fetch instructions straight from memory.
  *
  * The instruction cache address array allows programs to query what's in the
  * cache and selectively invalidate certain lines, so we do have to at least
@@ -34,18 +35,74 @@
  * that's not how VF3tb rolls.
  */
 
+#include <string.h>
+
+#include "sh4.h"
 #include "sh4_icache.h"
 #include "jit/code_cache.h"
 #include "config.h"
+#include "intmath.h"
 #include "log.h"
 
+void sh4_icache_init(struct sh4_icache *icache) {
+    icache->emulate = config_get_sh4_icache();
+    sh4_icache_invalidate_all(icache);
+}
+
+void sh4_icache_invalidate_all(struct sh4_icache *icache) {
+    unsigned line_no;
+    for (line_no = 0; line_no < SH4_IC_N_LINES; line_no++)
+        icache->tag[line_no] = SH4_IC_TAG_INVALID;
+}
+
+void sh4_icache_fill(Sh4 *sh4, unsigned line_no, addr32_t paddr) {
+    struct sh4_icache *icache = &sh4->icache;
+    addr32_t line_addr = paddr & ~(addr32_t)(SH4_IC_LINE_LEN - 1);
+    unsigned idx;
+    for (idx = 0; idx < SH4_IC_LINE_LEN / 2; idx++) {
+        icache->line[line_no][idx] =
+            memory_map_read_16(sh4->mem.map, line_addr + idx * 2);
+    }
+    icache->tag[line_no] = line_addr;
+}
+
+/*
+ * the address array holds the tag (bits 10-28 of the physical address) and
+ * the valid bit for the line selected by bits 5-12 of paddr.
+ */
+static uint32_t sh4_icache_addr_array_ent(Sh4 *sh4, addr32_t paddr) {
+    unsigned line_no = (paddr >> SH4_IC_LINE_SHIFT) & (SH4_IC_N_LINES - 1);
+    uint32_t tag = sh4->icache.tag[line_no];
+    if (!sh4->icache.emulate || tag == SH4_IC_TAG_INVALID)
+        return 0;
+    return (tag & BIT_RANGE(10, 28)) | 1;
+}
+
+/*
+ * writing a cleared valid bit invalidates the line.  In associative mode
+ * (bit 3 of the address) that only happens if the tag matches.  Writes with
+ * the valid bit set are ignored since there's no way to know what should be
+ * in the line.
+ */
+static void
+sh4_icache_addr_array_write(Sh4 *sh4, addr32_t paddr, uint32_t val) {
+    struct sh4_icache *icache = &sh4->icache;
+    unsigned line_no = (paddr >> SH4_IC_LINE_SHIFT) & (SH4_IC_N_LINES - 1);
+    uint32_t tag = icache->tag[line_no];
+
+    if (!icache->emulate || (val & 1) || tag == SH4_IC_TAG_INVALID)
+        return;
+    if ((paddr & (1 << 3)) &&
+        (tag & BIT_RANGE(10, 28)) != (val & BIT_RANGE(10, 28)))
+        return;
+    icache->tag[line_no] = SH4_IC_TAG_INVALID;
+}
+
 #define SH4_ICACHE_READ_ADDR_ARRAY_TMPL(type, postfix)                  \
     type sh4_icache_read_addr_array_##postfix(Sh4 *sh4,                 \
                                               addr32_t paddr) {         \
-        /* return 0 because I'm not implementing the icache. */         \
-        /* Ideally this would return data corresponding to a cache */   \
-        /* entry in the i-cache. */                                     \
-        return (type)0;                                                 \
+        /* always 0 unless the icache is being emulated */              \
+        return (type)sh4_icache_addr_array_ent(sh4, paddr);             \
     }
 
 SH4_ICACHE_READ_ADDR_ARRAY_TMPL(float, float)
@@ -64,16 +121,17 @@ SH4_ICACHE_READ_ADDR_ARRAY_TMPL(uint8_t, 8)
                                                                         \
         /* according to SH4 hardware manual, programs can write to */   \
         /* the IC address array to invalidate specific cache */         \
-        /* entries. */                                                  \
-        /* TODO: only invalidate the parts that need to be */           \
-        /* invalidated instead of the entire cache.  Also, check the */ \
-        /* v-bit in the value being written.  I think the invalidate */ \
-        /* is only if the v-bit being written is zero, but then that */ \
-        /* makes me wonder why they even let you specify a non-zero */  \
-        /* V bit if that does nothing. */                               \
+        /* entries.  Blocks compiled from main RAM are already */       \
+        /* invalidated whenever their memory gets written to, so */     \
+        /* only the blocks outside of main RAM need to be dropped. */   \
+        /* TODO: check the v-bit in the value being written.  I */      \
+        /* think the invalidate is only if the v-bit being written */   \
+        /* is zero, but then that makes me wonder why they even let */  \
+        /* you specify a non-zero V bit if that does nothing. */        \
                                                                         \
-        if (config_get_jit())                                           \
-            code_cache_invalidate_all();                                \
+        if (sh4->code_cache)                                            \
+            code_cache_invalidate_untracked(sh4->code_cache);           \
+        sh4_icache_addr_array_write(sh4, paddr, (uint32_t)val);         \
     }
 
 SH4_ICACHE_WRITE_ADDR_ARRAY_TMPL(float, float)
@@ -23,12 +23,43 @@
 #ifndef SH4_ICACHE_H_
 #define SH4_ICACHE_H_
 
-#include "sh4.h"
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "washdc/types.h"
 
+struct Sh4;
+typedef struct Sh4 Sh4;
+
 #define SH4_IC_ADDR_ARRAY_FIRST 0xf0000000
 #define SH4_IC_ADDR_ARRAY_LAST  0xf0ffffff
 
+/*
+ * 8KB direct-mapped, 32-byte lines.  This is only emulated when
+ * config_get_sh4_icache() is set, and even then only by the interpreter.
+ * Otherwise instruction fetches go straight to memory.
+ */
+#define SH4_IC_LINE_SHIFT 5
+#define SH4_IC_LINE_LEN (1 << SH4_IC_LINE_SHIFT)
+#define SH4_IC_N_LINES 256
+
+#define SH4_IC_TAG_INVALID 0xffffffff
+
+struct sh4_icache {
+    bool emulate;
+
+    // physical address of the start of each line, or SH4_IC_TAG_INVALID
+    uint32_t tag[SH4_IC_N_LINES];
+    uint16_t line[SH4_IC_N_LINES][SH4_IC_LINE_LEN / 2];
+};
+
+void sh4_icache_init(struct sh4_icache *icache);
+
+void sh4_icache_invalidate_all(struct sh4_icache *icache);
+
+// fill the line that paddr belongs to
+void sh4_icache_fill(Sh4 *sh4, unsigned line_no, addr32_t paddr);
+
 void sh4_icache_write_addr_array_float(Sh4 *sh4, addr32_t paddr, float val);
 void sh4_icache_write_addr_array_double(Sh4 *sh4, addr32_t paddr, double val);
 void sh4_icache_write_addr_array_32(Sh4 *sh4, addr32_t paddr, uint32_t val);
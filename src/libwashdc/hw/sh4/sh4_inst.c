@@ -38,6 +38,9 @@
 #include "sh4_jit.h"
 #include "log.h"
 #include "intmath.h"
+#include "hle_syscall.h"
+#include "guest_prof.h"
+#include "compiler_bullshit.h"
 
 #ifdef ENABLE_DEBUGGER
 #include "washdc/debugger.h"
@@ -48,6 +51,7 @@
 #endif
 
 #include "sh4_inst.h"
+#include "sh4_inst_spec.h"
 
 static DEF_ERROR_STRING_ATTR(opcode_format)
 static DEF_ERROR_STRING_ATTR(opcode_name)
@@ -480,7 +484,6 @@ static inline uint16_t inst_imm4(int inst) {
     return inst & 0xf;
 }
 
-#ifdef SH4_FPU_PEDANTIC
 /*
  * set the FPU's invalid operation flag in FPSCR and maybe raise an exception
  *
@@ -488,9 +491,6 @@ static inline uint16_t inst_imm4(int inst) {
  * It will be set to qNaN if the exceptions are disabled.
  */
 static void sh4_fr_invalid(Sh4 *sh4, unsigned dst_reg);
-#endif
-
-static InstOpcode const* sh4_decode_inst_slow(cpu_inst_param inst);
 
 #ifdef INVARIANTS
 #define CHECK_INST(inst, mask, val) \
@@ -540,966 +540,45 @@ static inline void sh4_branch_delayed(Sh4 *sh4, uint32_t pc) {
     sh4->delayed_branch_addr = pc;
 }
 
-static struct InstOpcode opcode_list[] = {
-    // RTS
-    { &sh4_inst_rts, sh4_jit_rts, true, SH4_GROUP_CO, 2, 0xffff, 0x000b },
-
-    // CLRMAC
-    { &sh4_inst_clrmac, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xffff, 0x0028 },
-
-    // CLRS
-    { &sh4_inst_clrs, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xffff, 0x0048 },
-
-    // CLRT
-    { &sh4_inst_clrt, sh4_jit_clrt, false,
-      SH4_GROUP_MT, 1, 0xffff, 0x0008 },
-
-    // LDTLB
-    { &sh4_inst_ldtlb, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xffff, 0x0038 },
-
-    // NOP
-    { &sh4_inst_nop, sh4_jit_nop, false,
-      SH4_GROUP_MT, 1, 0xffff, 0x0009 },
-
-    /*
-     * NOP (undocumented)
-     *
-     * I've verified on real hardware that this is a real opcode that does not
-     * raise any exceptions.  Not 100% sure it should be NOP but I can't see any
-     * side-effects.
-     *
-     * Samba De Amigo ver 2000 does this in a delay slot.
-     */
-    { &sh4_inst_nop, sh4_jit_nop, false,
-      SH4_GROUP_MT, 1, 0xffff, 0x0000 },
-
-    // RTE
-    { &sh4_inst_rte, sh4_jit_rte, true, SH4_GROUP_CO, 5, 0xffff, 0x002b },
-
-    // SETS
-    { &sh4_inst_sets, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xffff, 0x0058 },
-
-    // SETT
-    { &sh4_inst_sett, sh4_jit_sett, false,
-      SH4_GROUP_MT, 1, 0xffff, 0x0018 },
-
-    // SLEEP
-    { &sh4_inst_sleep, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 4, 0xffff, 0x001b },
-
-    // FRCHG
-    { &sh4_inst_frchg, sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xffff, 0xfbfd },
-
-    // FSCHG
-    { &sh4_inst_fschg, sh4_jit_fschg, false,
-      SH4_GROUP_FE, 1, 0xffff, 0xf3fd },
-
-    // MOVT Rn
-    { &sh4_inst_unary_movt_gen, sh4_jit_movt, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x0029 },
-
-    // CMP/PZ
-    { &sh4_inst_unary_cmppz_gen, sh4_jit_cmppz_rn, false,
-      SH4_GROUP_MT, 1, 0xf0ff, 0x4011 },
-
-    // CMP/PL
-    { &sh4_inst_unary_cmppl_gen, sh4_jit_cmppl_rn, false,
-      SH4_GROUP_MT, 1, 0xf0ff, 0x4015 },
-
-    // DT
-    { &sh4_inst_unary_dt_gen, sh4_jit_dt_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4010 },
-
-    // ROTL Rn
-    { &sh4_inst_unary_rotl_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4004 },
-
-    // ROTR Rn
-    { &sh4_inst_unary_rotr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4005 },
-
-    // ROTCL Rn
-    { &sh4_inst_unary_rotcl_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4024 },
-
-    // ROTCR Rn
-    { &sh4_inst_unary_rotcr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4025 },
-
-    // SHAL Rn
-    { &sh4_inst_unary_shal_gen, sh4_jit_shal_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4020 },
-
-    // SHAR Rn
-    { &sh4_inst_unary_shar_gen, sh4_jit_shar_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4021 },
-
-    // SHLL Rn
-    { &sh4_inst_unary_shll_gen, sh4_jit_shll_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4000 },
-
-    // SHLR Rn
-    { &sh4_inst_unary_shlr_gen, sh4_jit_shlr_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4001 },
-
-    // SHLL2 Rn
-    { &sh4_inst_unary_shll2_gen, sh4_jit_shll2_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4008 },
-
-    // SHLR2 Rn
-    { &sh4_inst_unary_shlr2_gen, sh4_jit_shlr2_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4009 },
-
-    // SHLL8 Rn
-    { &sh4_inst_unary_shll8_gen, sh4_jit_shll8_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4018 },
-
-    // SHLR8 Rn
-    { &sh4_inst_unary_shlr8_gen, sh4_jit_shlr8_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4019 },
-
-    // SHLL16 Rn
-    { &sh4_inst_unary_shll16_gen, sh4_jit_shll16_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4028 },
-
-    // SHLR16 Rn
-    { &sh4_inst_unary_shlr16_gen, sh4_jit_shlr16_rn, false,
-      SH4_GROUP_EX, 1, 0xf0ff, 0x4029 },
-
-    // BRAF Rn
-    { &sh4_inst_unary_braf_gen, sh4_jit_braf_rn, true, SH4_GROUP_CO, 2, 0xf0ff, 0x0023 },
-
-    // BSRF Rn
-    { &sh4_inst_unary_bsrf_gen, sh4_jit_bsrf_rn, true, SH4_GROUP_CO, 2, 0xf0ff, 0x0003 },
-
-    // CMP/EQ #imm, R0
-    { &sh4_inst_binary_cmpeq_imm_r0, sh4_jit_fallback, false,
-      SH4_GROUP_MT, 1, 0xff00, 0x8800 },
-
-    // AND.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_andb_imm_r0_gbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 4, 0xff00, 0xcd00 },
-
-    // AND #imm, R0
-    { &sh4_inst_binary_and_imm_r0, sh4_inst_binary_andb_imm_r0, false,
-      SH4_GROUP_EX, 1, 0xff00, 0xc900 },
-
-    // OR.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_orb_imm_r0_gbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 4, 0xff00, 0xcf00 },
-
-    // OR #imm, R0
-    { &sh4_inst_binary_or_imm_r0, sh4_jit_or_imm8_r0, false,
-      SH4_GROUP_EX, 1, 0xff00, 0xcb00 },
-
-    // TST #imm, R0
-    { &sh4_inst_binary_tst_imm_r0, sh4_jit_tst_imm8_r0, false,
-      SH4_GROUP_MT, 1, 0xff00, 0xc800 },
-
-    // TST.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_tstb_imm_r0_gbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 3, 0xff00, 0xcc00 },
-
-    // XOR #imm, R0
-    { &sh4_inst_binary_xor_imm_r0, sh4_jit_xor_imm8_r0, false,
-      SH4_GROUP_EX, 1, 0xff00, 0xca00 },
-
-    // XOR.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_xorb_imm_r0_gbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 4, 0xff00, 0xce00 },
-
-    // BF label
-    { &sh4_inst_unary_bf_disp, sh4_jit_bf, true,
-      SH4_GROUP_BR, 1, 0xff00, 0x8b00 },
-
-    // BF/S label
-    { &sh4_inst_unary_bfs_disp, sh4_jit_bfs, true,
-      SH4_GROUP_BR, 1, 0xff00, 0x8f00 },
-
-    // BT label
-    { &sh4_inst_unary_bt_disp, sh4_jit_bt, true,
-      SH4_GROUP_BR, 1, 0xff00, 0x8900 },
-
-    // BT/S label
-    { &sh4_inst_unary_bts_disp, sh4_jit_bts, true,
-      SH4_GROUP_BR, 1, 0xff00, 0x8d00 },
-
-    // BRA label
-    { &sh4_inst_unary_bra_disp, sh4_jit_bra, true,
-      SH4_GROUP_BR, 1, 0xf000, 0xa000 },
-
-    // BSR label
-    { &sh4_inst_unary_bsr_disp, sh4_jit_bsr, true,
-      SH4_GROUP_BR, 1, 0xf000, 0xb000 },
-
-    // TRAPA #immed
-    { &sh4_inst_unary_trapa_disp, sh4_jit_trapa_imm, false,
-      SH4_GROUP_CO, 7, 0xff00, 0xc300 },
-
-    // TAS.B @Rn
-    { &sh4_inst_unary_tasb_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 5, 0xf0ff, 0x401b },
-
-    // OCBI @Rn
-    { &sh4_inst_unary_ocbi_indgen, sh4_jit_ocbi_arn, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0x0093 },
-
-    // OCBP @Rn
-    { &sh4_inst_unary_ocbp_indgen, sh4_jit_ocbp_arn, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0x00a3 },
-
-    // OCBWB @Rn
-    { &sh4_inst_unary_ocbwb_indgen, sh4_jit_ocbwb_arn, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0x00b3 },
-
-    // PREF @Rn
-    { &sh4_inst_unary_pref_indgen, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0x0083 },
-
-    // JMP @Rn
-    { &sh4_inst_unary_jmp_indgen, sh4_jit_jmp_arn, true,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x402b },
-
-    // JSR @Rn
-    { &sh4_inst_unary_jsr_indgen, sh4_jit_jsr_arn, true, SH4_GROUP_CO, 2, 0xf0ff, 0x400b },
-
-    // LDC Rm, SR
-    { &sh4_inst_binary_ldc_gen_sr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 4, 0xf0ff, 0x400e },
-
-    // LDC Rm, GBR
-    { &sh4_inst_binary_ldc_gen_gbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 3, 0xf0ff, 0x401e },
-
-    // LDC Rm, VBR
-    { &sh4_inst_binary_ldc_gen_vbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x402e },
-
-    // LDC Rm, SSR
-    { &sh4_inst_binary_ldc_gen_ssr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x403e },
-
-    // LDC Rm, SPC
-    { &sh4_inst_binary_ldc_gen_spc, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x404e },
-
-    // LDC Rm, DBR
-    { &sh4_inst_binary_ldc_gen_dbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x40fa },
-
-    // STC SR, Rn
-    { &sh4_inst_binary_stc_sr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x0002 },
-
-    // STC GBR, Rn
-    { &sh4_inst_binary_stc_gbr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x0012 },
-
-    // STC VBR, Rn
-    { &sh4_inst_binary_stc_vbr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x0022 },
-
-    // STC SSR, Rn
-    { &sh4_inst_binary_stc_ssr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x0032 },
-
-    // STC SPC, Rn
-    { &sh4_inst_binary_stc_spc_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x0042 },
-
-    // STC SGR, Rn
-    { &sh4_inst_binary_stc_sgr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 3, 0xf0ff, 0x003a },
-
-    // STC DBR, Rn
-    { &sh4_inst_binary_stc_dbr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x00fa },
-
-    // LDC.L @Rm+, SR
-    { &sh4_inst_binary_ldcl_indgeninc_sr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 4, 0xf0ff, 0x4007 },
-
-    // LDC.L @Rm+, GBR
-    { &sh4_inst_binary_ldcl_indgeninc_gbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 3, 0xf0ff, 0x4017 },
-
-    // LDC.L @Rm+, VBR
-    { &sh4_inst_binary_ldcl_indgeninc_vbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4027 },
-
-    // LDC.L @Rm+, SSR
-    { &sh4_inst_binary_ldcl_indgenic_ssr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4037 },
-
-    // LDC.L @Rm+, SPC
-    { &sh4_inst_binary_ldcl_indgeninc_spc, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4047 },
-
-    // LDC.L @Rm+, DBR
-    { &sh4_inst_binary_ldcl_indgeninc_dbr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x40f6 },
+#define SH4_INST(func, disas, pc_relative, group, issue, mask, val, regs) \
+    { (func), (disas), (pc_relative), (group), (issue), (mask), (val), \
+      (regs) },
 
-    // STC.L SR, @-Rn
-    { &sh4_inst_binary_stcl_sr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4003 },
-
-    // STC.L GBR, @-Rn
-    { &sh4_inst_binary_stcl_gbr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4013 },
-
-    // STC.L VBR, @-Rn
-    { &sh4_inst_binary_stcl_vbr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4023 },
-
-    // STC.L SSR, @-Rn
-    { &sh4_inst_binary_stcl_ssr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4033 },
-
-    // STC.L SPC, @-Rn
-    { &sh4_inst_binary_stcl_spc_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4043 },
-
-    // STC.L SGR, @-Rn
-    { &sh4_inst_binary_stcl_sgr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 3, 0xf0ff, 0x4032 },
-
-    // STC.L DBR, @-Rn
-    { &sh4_inst_binary_stcl_dbr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x40f2 },
-
-    // MOV #imm, Rn
-    { &sh4_inst_binary_mov_imm_gen, sh4_jit_mov_imm8_rn, false,
-      SH4_GROUP_EX, 1, 0xf000, 0xe000 },
-
-    // ADD #imm, Rn
-    { &sh4_inst_binary_add_imm_gen, sh4_jit_add_imm_rn, false,
-      SH4_GROUP_EX, 1, 0xf000, 0x7000 },
-
-    // MOV.W @(disp, PC), Rn
-    { &sh4_inst_binary_movw_binind_disp_pc_gen, sh4_jit_movw_a_disp_pc_rn,
-      true, SH4_GROUP_LS, 1, 0xf000, 0x9000 },
-
-    // MOV.L @(disp, PC), Rn
-    { &sh4_inst_binary_movl_binind_disp_pc_gen, sh4_jit_movl_a_disp_pc_rn,
-      true, SH4_GROUP_LS, 1, 0xf000, 0xd000 },
-
-    // MOV Rm, Rn
-    { &sh4_inst_binary_mov_gen_gen, sh4_jit_mov_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x6003 },
-
-    // SWAP.B Rm, Rn
-    { &sh4_inst_binary_swapb_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x6008 },
-
-    // SWAP.W Rm, Rn
-    { &sh4_inst_binary_swapw_gen_gen, sh4_jit_swapw_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x6009 },
-
-    // XTRCT Rm, Rn
-    { &sh4_inst_binary_xtrct_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x200d },
-
-    // ADD Rm, Rn
-    { &sh4_inst_binary_add_gen_gen, sh4_jit_add_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x300c },
-
-    // ADDC Rm, Rn
-    { &sh4_inst_binary_addc_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x300e },
-
-    // ADDV Rm, Rn
-    { &sh4_inst_binary_addv_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x300f },
-
-    // CMP/EQ Rm, Rn
-    { &sh4_inst_binary_cmpeq_gen_gen, sh4_jit_cmpeq_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x3000 },
-
-    // CMP/HS Rm, Rn
-    { &sh4_inst_binary_cmphs_gen_gen, sh4_jit_cmphs_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x3002 },
-
-    // CMP/GE Rm, Rn
-    { &sh4_inst_binary_cmpge_gen_gen, sh4_jit_cmpge_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x3003 },
-
-    // CMP/HI Rm, Rn
-    { &sh4_inst_binary_cmphi_gen_gen, sh4_jit_cmphi_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x3006 },
-
-    // CMP/GT Rm, Rn
-    { &sh4_inst_binary_cmpgt_gen_gen, sh4_jit_cmpgt_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x3007 },
-
-    // CMP/STR Rm, Rn
-    { &sh4_inst_binary_cmpstr_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x200c },
-
-    // DIV1 Rm, Rn
-    { &sh4_inst_binary_div1_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x3004 },
-
-    // DIV0S Rm, Rn
-    { &sh4_inst_binary_div0s_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x2007 },
-
-    // DIV0U
-    { &sh4_inst_noarg_div0u, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xffff, 0x0019 },
-
-    // DMULS.L Rm, Rn
-    { &sh4_inst_binary_dmulsl_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf00f, 0x300d },
-
-    // DMULU.L Rm, Rn
-    { &sh4_inst_binary_dmulul_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf00f, 0x3005 },
-
-    // EXTS.B Rm, Rn
-    { &sh4_inst_binary_extsb_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x600e },
-
-    // EXTS.W Rm, Rn
-    { &sh4_inst_binary_extsw_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x600f },
-
-    // EXTU.B Rm, Rn
-    { &sh4_inst_binary_extub_gen_gen, sh4_jit_extub_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x600c },
-
-    // EXTU.W Rm, Rn
-    { &sh4_inst_binary_extuw_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x600d },
-
-    // MUL.L Rm, Rn
-    { &sh4_inst_binary_mull_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf00f, 0x0007 },
-
-    // MULS.W Rm, Rn
-    { &sh4_inst_binary_mulsw_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf00f, 0x200f },
-
-    // MULU.W Rm, Rn
-    { &sh4_inst_binary_muluw_gen_gen, sh4_jit_muluw_rm_rn, false,
-      SH4_GROUP_CO, 2, 0xf00f, 0x200e },
-
-    // NEG Rm, Rn
-    { &sh4_inst_binary_neg_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x600b },
-
-    // NEGC Rm, Rn
-    { &sh4_inst_binary_negc_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x600a },
-
-    // SUB Rm, Rn
-    { &sh4_inst_binary_sub_gen_gen, sh4_jit_sub_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x3008 },
-
-    // SUBC Rm, Rn
-    { &sh4_inst_binary_subc_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x300a },
-
-    // SUBV Rm, Rn
-    { &sh4_inst_binary_subv_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x300b },
-
-    // AND Rm, Rn
-    { &sh4_inst_binary_and_gen_gen, sh4_jit_and_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x2009 },
-
-    // NOT Rm, Rn
-    { &sh4_inst_binary_not_gen_gen, sh4_jit_not_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x6007 },
-
-    // OR Rm, Rn
-    { &sh4_inst_binary_or_gen_gen, sh4_jit_or_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x200b },
-
-    // TST Rm, Rn
-    { &sh4_inst_binary_tst_gen_gen, sh4_jit_tst_rm_rn, false,
-      SH4_GROUP_MT, 1, 0xf00f, 0x2008 },
-
-    // XOR Rm, Rn
-    { &sh4_inst_binary_xor_gen_gen, sh4_jit_xor_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x200a },
-
-    // SHAD Rm, Rn
-    { &sh4_inst_binary_shad_gen_gen, sh4_jit_shad_rm_rn, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x400c },
-
-    // SHLD Rm, Rn
-    { &sh4_inst_binary_shld_gen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_EX, 1, 0xf00f, 0x400d },
-
-    // LDC Rm, Rn_BANK
-    { &sh4_inst_binary_ldc_gen_bank, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf08f, 0x408e },
-
-    // LDC.L @Rm+, Rn_BANK
-    { &sh4_inst_binary_ldcl_indgeninc_bank, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf08f, 0x4087 },
-
-    // STC Rm_BANK, Rn
-    { &sh4_inst_binary_stc_bank_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf08f, 0x0082 },
-
-    // STC.L Rm_BANK, @-Rn
-    { &sh4_inst_binary_stcl_bank_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf08f, 0x4083 },
-
-    // LDS Rm, MACH
-    { &sh4_inst_binary_lds_gen_mach, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x400a },
-
-    // LDS Rm, MACL
-    { &sh4_inst_binary_lds_gen_macl, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x401a },
-
-    // STS MACH, Rn
-    { &sh4_inst_binary_sts_mach_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x000a },
-
-    // STS MACL, Rn
-    { &sh4_inst_binary_sts_macl_gen, sh4_jit_sts_macl_rn, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x001a },
-
-    // LDS Rm, PR
-    { &sh4_inst_binary_lds_gen_pr, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x402a },
-
-    // STS PR, Rn
-    { &sh4_inst_binary_sts_pr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x002a },
-
-    // LDS.L @Rm+, MACH
-    { &sh4_inst_binary_ldsl_indgeninc_mach, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4006 },
-
-    // LDS.L @Rm+, MACL
-    { &sh4_inst_binary_ldsl_indgeninc_macl, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4016 },
-
-    // STS.L MACH, @-Rn
-    { &sh4_inst_binary_stsl_mach_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4002 },
-
-    // STS.L MACL, @-Rn
-    { &sh4_inst_binary_stsl_macl_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4012 },
-
-    // LDS.L @Rm+, PR
-    { &sh4_inst_binary_ldsl_indgeninc_pr, sh4_jit_ldsl_armp_pr, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4026 },
-
-    // STS.L PR, @-Rn
-    { &sh4_inst_binary_stsl_pr_inddecgen, sh4_jit_stsl_pr_amrn, false,
-      SH4_GROUP_CO, 2, 0xf0ff, 0x4022 },
-
-    // MOV.B Rm, @Rn
-    { &sh4_inst_binary_movb_gen_indgen, sh4_jit_movb_rm_arn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x2000 },
-
-    // MOV.W Rm, @Rn
-    { &sh4_inst_binary_movw_gen_indgen, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x2001 },
-
-    // MOV.L Rm, @Rn
-    { &sh4_inst_binary_movl_gen_indgen, sh4_jit_movl_rm_arn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x2002 },
-
-    // MOV.B @Rm, Rn
-    { &sh4_inst_binary_movb_indgen_gen, sh4_jit_movb_arm_rn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x6000 },
-
-    // MOV.W @Rm, Rn
-    { &sh4_inst_binary_movw_indgen_gen, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x6001 },
-
-    // MOV.L @Rm, Rn
-    { &sh4_inst_binary_movl_indgen_gen, sh4_jit_movl_arm_rn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x6002 },
-
-    // MOV.B Rm, @-Rn
-    { &sh4_inst_binary_movb_gen_inddecgen, sh4_jit_movb_rm_amrn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x2004 },
-
-    // MOV.W Rm, @-Rn
-    { &sh4_inst_binary_movw_gen_inddecgen, sh4_jit_movw_rm_amrn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x2005 },
-
-    // MOV.L Rm, @-Rn
-    { &sh4_inst_binary_movl_gen_inddecgen, sh4_jit_movl_rm_amrn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x2006 },
-
-    // MOV.B @Rm+, Rn
-    { &sh4_inst_binary_movb_indgeninc_gen, sh4_jit_movb_armp_rn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x6004 },
-
-    // MOV.W @Rm+, Rn
-    { &sh4_inst_binary_movw_indgeninc_gen, sh4_jit_movw_armp_rn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x6005 },
-
-    // MOV.L @Rm+, Rn
-    { &sh4_inst_binary_movl_indgeninc_gen, sh4_jit_movl_armp_rn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0x6006 },
+/*
+ * the invalid opcode goes right after the last real one, which is where
+ * sh4_inst_lut points any instruction that doesn't match anything.
+ */
+struct InstOpcode sh4_opcode_list[] = {
+#include "sh4_inst_list.h"
 
-    // MAC.L @Rm+, @Rn+
-    { &sh4_inst_binary_macl_indgeninc_indgeninc, sh4_jit_fallback,
-      false, SH4_GROUP_CO, 2, 0xf00f, 0x000f },
-
-    // MAC.W @Rm+, @Rn+
-    { &sh4_inst_binary_macw_indgeninc_indgeninc, sh4_jit_fallback,
-      false, SH4_GROUP_CO, 2, 0xf00f, 0x400f },
-
-    // MOV.B R0, @(disp, Rn)
-    { &sh4_inst_binary_movb_r0_binind_disp_gen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0x8000 },
-
-    // MOV.W R0, @(disp, Rn)
-    { &sh4_inst_binary_movw_r0_binind_disp_gen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0x8100 },
-
-    // MOV.L Rm, @(disp, Rn)
-    { &sh4_inst_binary_movl_gen_binind_disp_gen, sh4_jit_movl_rm_a_disp4_rn,
-      false, SH4_GROUP_LS, 1, 0xf000, 0x1000 },
-
-    // MOV.B @(disp, Rm), R0
-    { &sh4_inst_binary_movb_binind_disp_gen_r0, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0x8400 },
-
-    // MOV.W @(disp, Rm), R0
-    { &sh4_inst_binary_movw_binind_disp_gen_r0, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0x8500 },
-
-    // MOV.L @(disp, Rm), Rn
-    { &sh4_inst_binary_movl_binind_disp_gen_gen, sh4_jit_movl_a_disp4_rm_rn,
-      false, SH4_GROUP_LS, 1, 0xf000, 0x5000 },
-
-    // MOV.B Rm, @(R0, Rn)
-    { &sh4_inst_binary_movb_gen_binind_r0_gen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xf00f, 0x0004 },
-
-    // MOV.W Rm, @(R0, Rn)
-    { &sh4_inst_binary_movw_gen_binind_r0_gen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xf00f, 0x0005 },
-
-    // MOV.L Rm, @(R0, Rn)
-    { &sh4_inst_binary_movl_gen_binind_r0_gen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xf00f, 0x0006 },
-
-    // MOV.B @(R0, Rm), Rn
-    { &sh4_inst_binary_movb_binind_r0_gen_gen, sh4_jit_movb_a_r0_rm_rn,
-      false, SH4_GROUP_LS, 1, 0xf00f, 0x000c },
-
-    // MOV.W @(R0, Rm), Rn
-    { &sh4_inst_binary_movw_binind_r0_gen_gen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xf00f, 0x000d },
-
-    // MOV.L @(R0, Rm), Rn
-    { &sh4_inst_binary_movl_binind_r0_gen_gen, sh4_jit_movl_a_r0_rm_rn,
-      false, SH4_GROUP_LS, 1, 0xf00f, 0x000e },
-
-    // MOV.B R0, @(disp, GBR)
-    { &sh4_inst_binary_movb_r0_binind_disp_gbr, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0xc000 },
-
-    // MOV.W R0, @(disp, GBR)
-    { &sh4_inst_binary_movw_r0_binind_disp_gbr, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0xc100 },
-
-    // MOV.L R0, @(disp, GBR)
-    { &sh4_inst_binary_movl_r0_binind_disp_gbr, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0xc200 },
-
-    // MOV.B @(disp, GBR), R0
-    { &sh4_inst_binary_movb_binind_disp_gbr_r0, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xff00, 0xc400 },
-
-    // MOV.W @(disp, GBR), R0
-    { &sh4_inst_binary_movw_binind_disp_gbr_r0, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xff00, 0xc500 },
-
-    // MOV.L @(disp, GBR), R0
-    { &sh4_inst_binary_movl_binind_disp_gbr_r0, sh4_jit_movl_a_disp8_gbr_r0,
-      false, SH4_GROUP_LS, 1, 0xff00, 0xc600 },
-
-    // MOVA @(disp, PC), R0
-    { &sh4_inst_binary_mova_binind_disp_pc_r0, sh4_jit_mova_a_disp_pc_r0,
-      true, SH4_GROUP_EX, 1, 0xff00, 0xc700 },
-
-    // MOVCA.L R0, @Rn
-    { &sh4_inst_binary_movcal_r0_indgen, sh4_jit_fallback,
-      false, SH4_GROUP_LS, 1, 0xf0ff, 0x00c3 },
-
-    // FLDI0 FRn
-    { FPU_HANDLER(fldi0), sh4_jit_fldi0_frn, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0xf08d },
-
-    // FLDI1 Frn
-    { FPU_HANDLER(fldi1), sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0xf09d },
-
-    // FMOV FRm, FRn
-    // 1111nnnnmmmm1100
-    // FMOV DRm, DRn
-    // 1111nnn0mmm01100
-    // FMOV XDm, DRn
-    // 1111nnn0mmm11100
-    // FMOV DRm, XDn
-    // 1111nnn1mmm01100
-    // FMOV XDm, XDn
-    // 1111nnn1mmm11100
-    { FPU_HANDLER(fmov_gen), sh4_jit_fmov_frm_frn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf00c },
-
-    // FMOV.S @Rm, FRn
-    // 1111nnnnmmmm1000
-    // FMOV @Rm, DRn
-    // 1111nnn0mmmm1000
-    // FMOV @Rm, XDn
-    // 1111nnn1mmmm1000
-    { FPU_HANDLER(fmovs_ind_gen), sh4_jit_fmov_arm_fpu, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf008 },
-
-    // FMOV.S @(R0, Rm), FRn
-    // 1111nnnnmmmm0110
-    // FMOV @(R0, Rm), DRn
-    // 1111nnn0mmmm0110
-    // FMOV @(R0, Rm), XDn
-    // 1111nnn1mmmm0110
-    { FPU_HANDLER(fmov_binind_r0_gen_fpu), sh4_jit_fmovs_a_r0_rm_fpu, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf006 },
-
-    // FMOV.S @Rm+, FRn
-    // 1111nnnnmmmm1001
-    // FMOV @Rm+, DRn
-    // 1111nnn0mmmm1001
-    // FMOV @Rm+, XDn
-    // 1111nnn1mmmm1001
-    { FPU_HANDLER(fmov_indgeninc_fpu), sh4_jit_fmov_fpu_armp_fpu, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf009 },
-
-    // FMOV.S FRm, @Rn
-    // 1111nnnnmmmm1010
-    // FMOV DRm, @Rn
-    // 1111nnnnmmm01010
-    // FMOV XDm, @Rn
-    // 1111nnnnmmm11010
-    { FPU_HANDLER(fmov_fpu_indgen), sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf00a },
-
-    // FMOV.S FRm, @-Rn
-    // 1111nnnnmmmm1011
-    // FMOV DRm, @-Rn
-    // 1111nnnnmmm01011
-    // FMOV XDm, @-Rn
-    // 1111nnnnmmm11011
-    { FPU_HANDLER(fmov_fpu_inddecgen), sh4_jit_fmov_fpu_amrn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf00b },
-
-    // FMOV.S FRm, @(R0, Rn)
-    // 1111nnnnmmmm0111
-    // FMOV DRm, @(R0, Rn)
-    // 1111nnnnmmm00111
-    // FMOV XDm, @(R0, Rn)
-    // 1111nnnnmmm10111
-    { FPU_HANDLER(fmov_fpu_binind_r0_gen), sh4_jit_fmov_fpu_a_r0_rn, false,
-      SH4_GROUP_LS, 1, 0xf00f, 0xf007 },
-
-    // FLDS FRm, FPUL
-    // XXX Should this check the SZ or PR bits of FPSCR ?
-    { &sh4_inst_binary_flds_fr_fpul, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0xf01d },
-
-    // FSTS FPUL, FRn
-    // XXX Should this check the SZ or PR bits of FPSCR ?
-    { &sh4_inst_binary_fsts_fpul_fr, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0xf00d },
-
-    // FABS FRn
-    // 1111nnnn01011101
-    // FABS DRn
-    // 1111nnn001011101
-    { FPU_HANDLER(fabs_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0xf05d },
-
-    // FADD FRm, FRn
-    // 1111nnnnmmmm0000
-    // FADD DRm, DRn
-    // 1111nnn0mmm00000
-    { FPU_HANDLER(fadd_fpu), sh4_jit_fadd_frm_frn, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf000 },
-
-    // FCMP/EQ FRm, FRn
-    // 1111nnnnmmmm0100
-    // FCMP/EQ DRm, DRn
-    // 1111nnn0mmm00100
-    { FPU_HANDLER(fcmpeq_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf004 },
-
-    // FCMP/GT FRm, FRn
-    // 1111nnnnmmmm0101
-    // FCMP/GT DRm, DRn
-    // 1111nnn0mmm00101
-    { FPU_HANDLER(fcmpgt_fpu), sh4_jit_fcmpgt_frm_frn, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf005 },
-
-    // FDIV FRm, FRn
-    // 1111nnnnmmmm0011
-    // FDIV DRm, DRn
-    // 1111nnn0mmm00011
-    { FPU_HANDLER(fdiv_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf003 },
-
-    // FLOAT FPUL, FRn
-    // 1111nnnn00101101
-    // FLOAT FPUL, DRn
-    // 1111nnn000101101
-    { FPU_HANDLER(float_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf0ff, 0xf02d },
-
-    // FMAC FR0, FRm, FRn
-    // 1111nnnnmmmm1110
-    { FPU_HANDLER(fmac_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf00e },
-
-    // FMUL FRm, FRn
-    // 1111nnnnmmmm0010
-    // FMUL DRm, DRn
-    // 1111nnn0mmm00010
-    { FPU_HANDLER(fmul_fpu), sh4_jit_fmul_frm_frn, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf002 },
-
-    // FNEG FRn
-    // 1111nnnn01001101
-    // FNEG DRn
-    // 1111nnn001001101
-    { FPU_HANDLER(fneg_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0xf04d },
-
-    // FSQRT FRn
-    // 1111nnnn01101101
-    // FSQRT DRn
-    // 1111nnn001101101
-    { FPU_HANDLER(fsqrt_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf0ff, 0xf06d },
-
-    // FSUB FRm, FRn
-    // 1111nnnnmmmm0001
-    // FSUB DRm, DRn
-    // 1111nnn0mmm00001
-    { FPU_HANDLER(fsub_fpu), sh4_jit_fsub_frm_frn, false,
-      SH4_GROUP_FE, 1, 0xf00f, 0xf001 },
-
-    // FTRC FRm, FPUL
-    // 1111mmmm00111101
-    // FTRC DRm, FPUL
-    // 1111mmm000111101
-    { FPU_HANDLER(ftrc_fpu), sh4_jit_ftrc_frm_fpul, false,
-      SH4_GROUP_FE, 1, 0xf0ff, 0xf03d },
-
-    // FCNVDS DRm, FPUL
-    // 1111mmm010111101
-    { FPU_HANDLER(fcnvds_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf1ff, 0xf0bd },
-
-    // FCNVSD FPUL, DRn
-    // 1111nnn010101101
-    { FPU_HANDLER(fcnvsd_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf1ff, 0xf0ad },
-
-    // LDS Rm, FPSCR
-    { &sh4_inst_binary_lds_gen_fpscr, sh4_jit_lds_rm_fpscr, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x406a },
-
-    // LDS Rm, FPUL
-    { &sh4_inst_binary_gen_fpul, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0x405a },
-
-    // LDS.L @Rm+, FPSCR
-    { &sh4_inst_binary_ldsl_indgeninc_fpscr, sh4_jit_ldsl_armp_fpscr, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4066 },
-
-    // LDS.L @Rm+, FPUL
-    { &sh4_inst_binary_ldsl_indgeninc_fpul, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4056 },
-
-    // STS FPSCR, Rn
-    { &sh4_inst_binary_sts_fpscr_gen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x006a },
-
-    // STS FPUL, Rn
-    { &sh4_inst_binary_sts_fpul_gen, sh4_jit_fallback, false,
-      SH4_GROUP_LS, 1, 0xf0ff, 0x005a },
-
-    // STS.L FPSCR, @-Rn
-    { &sh4_inst_binary_stsl_fpscr_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4062 },
-
-    // STS.L FPUL, @-Rn
-    { &sh4_inst_binary_stsl_fpul_inddecgen, sh4_jit_fallback, false,
-      SH4_GROUP_CO, 1, 0xf0ff, 0x4052 },
-
-    // FIPR FVm, FVn - vector dot product
-    { &sh4_inst_binary_fipr_fv_fv, sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf0ff, 0xf0ed },
-
-    // FTRV XMTRX, FVn - multiple vector by matrix
-    { &sh4_inst_binary_fitrv_mxtrx_fv, sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf3ff, 0xf1fd },
-
-    // FSCA FPUL, DRn - sine/cosine table lookup
-    // TODO: the issue cycle count here might be wrong, I couldn't find that
-    //       value for this instruction
-    { FPU_HANDLER(fsca_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf1ff, 0xf0fd },
-
-    // FSRRA FRn
-    // 1111nnnn01111101
-    // TODO: the issue cycle for this opcode might be wrong as well
-    { FPU_HANDLER(fsrra_fpu), sh4_jit_fallback, false,
-      SH4_GROUP_FE, 1, 0xf0ff, 0xf07d },
+    { &sh4_inst_invalid, sh4_jit_fallback, false,
+      (sh4_inst_group_t)0, 0, 0, 0, SH4_FB_ALL },
 
     { NULL }
 };
 
-static InstOpcode invalid_opcode = {
-    &sh4_inst_invalid, sh4_jit_fallback, false, (sh4_inst_group_t)0, 0, 0, 0
-};
+#undef SH4_INST
 
 #define SH4_INST_RAISE_ERROR(sh4, error_tp)     \
     do {                                        \
         RAISE_ERROR(error_tp);                  \
     } while (0)
 
-InstOpcode const *sh4_inst_lut[1 << 16];
-
-void sh4_init_inst_lut() {
-    cpu_inst_param inst;
-    for (inst = 0; inst < (1 << 16); inst++)
-        sh4_inst_lut[inst] = sh4_decode_inst_slow(inst);
-}
-
-// used to initialize the sh4_inst_lut
-static InstOpcode const* sh4_decode_inst_slow(cpu_inst_param inst) {
-    InstOpcode const *op = opcode_list;
-
-    while (op->func) {
-        if ((op->mask & inst) == op->val) {
-            return op;
+void sh4_inst_persist_register(void) {
+    InstOpcode const *op;
+    unsigned op_no, idx;
+    for (op = sh4_opcode_list, op_no = 0; op->func; op++, op_no++) {
+        jit_persist_register((void const*)op->func, 1);
+        opcode_func_t const *spec = sh4_inst_spec[op_no];
+        if (spec) {
+            // SPEC_FMT_IMM_RN tables repeat each handler 16 times
+            for (idx = 0; idx < 256; idx++)
+                if (!idx || spec[idx] != spec[idx - 1])
+                    jit_persist_register((void const*)spec[idx], 1);
         }
-        op++;
     }
-
-    return &invalid_opcode;
 }
 
-#ifdef SH4_FPU_PEDANTIC
 #define SH4_FPU_QNAN 0x7fbfffff
 
 static void sh4_fr_invalid(Sh4 *sh4, unsigned dst_reg) {
@@ -1517,7 +596,28 @@ static void sh4_fpu_error(Sh4 *sh4) {
     sh4->reg[SH4_REG_FPSCR] |= SH4_FPSCR_CAUSE_E_MASK;
     sh4_set_exception(sh4, SH4_EXCP_FPU);
 }
-#endif
+
+/*
+ * FPU handlers that have error-checking get built twice from one _impl
+ * function: once with pedantic set to false, which compiles the checks out,
+ * and once with it set to true.  sh4_inst_set_fpu_pedantic picks which set
+ * goes in sh4_opcode_list.
+ */
+#define DEF_FPU_VARIANTS(name)                                          \
+    void name(void *cpu, cpu_inst_param inst) {                         \
+        name##_impl(cpu, inst, false);                                  \
+    }                                                                   \
+    void name##_pedantic(void *cpu, cpu_inst_param inst) {              \
+        name##_impl(cpu, inst, true);                                   \
+    }
+
+// the pedantic variants always keep the cause bits up to date
+static inline void sh4_fpu_variant_clear_cause(Sh4 *sh4, bool pedantic) {
+    if (pedantic)
+        sh4->reg[SH4_REG_FPSCR] &= ~SH4_FPSCR_CAUSE_MASK;
+    else
+        sh4_fpu_clear_cause(sh4);
+}
 
 #define INST_MASK_0000000000001011 0xffff
 #define INST_CONS_0000000000001011 0x000b
@@ -1530,6 +630,8 @@ void sh4_inst_rts(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
+    if (guest_prof_enabled)
+        guest_prof_on_ret(sh4, sh4->reg[SH4_REG_PR]);
     sh4_branch_delayed(sh4, sh4->reg[SH4_REG_PR]);
 }
 
@@ -2192,10 +1294,12 @@ void sh4_inst_unary_bsrf_gen(void *cpu, cpu_inst_param inst) {
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
     int reg_no = (inst >> 8) & 0xf;
+    addr32_t dst = sh4->reg[SH4_REG_PC] + *sh4_gen_reg(sh4, reg_no) + 4;
 
     sh4->reg[SH4_REG_PR] = sh4->reg[SH4_REG_PC] + 4;
-    sh4_branch_delayed(sh4,
-                       sh4->reg[SH4_REG_PC] + *sh4_gen_reg(sh4, reg_no) + 4);
+    if (guest_prof_enabled)
+        guest_prof_on_call(sh4, dst);
+    sh4_branch_delayed(sh4, dst);
 }
 
 #define INST_MASK_10001000iiiiiiii 0xff00
@@ -2465,10 +1569,13 @@ void sh4_inst_unary_bsr_disp(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
+    addr32_t dst = sh4->reg[SH4_REG_PC] +
+        (((int32_t)inst_simm12(inst)) << 1) + 4;
+
     sh4->reg[SH4_REG_PR] = sh4->reg[SH4_REG_PC] + 4;
-    sh4_branch_delayed(sh4,
-                       sh4->reg[SH4_REG_PC] +
-                       (((int32_t)inst_simm12(inst)) << 1) + 4);
+    if (guest_prof_enabled)
+        guest_prof_on_call(sh4, dst);
+    sh4_branch_delayed(sh4, dst);
 }
 
 #define INST_MASK_11000011iiiiiiii 0xff00
@@ -2610,8 +1717,12 @@ void sh4_inst_unary_jsr_indgen(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
+    addr32_t dst = *sh4_gen_reg(sh4, (inst >> 8) & 0xf);
+
     sh4->reg[SH4_REG_PR] = sh4->reg[SH4_REG_PC] + 4;
-    sh4_branch_delayed(sh4, *sh4_gen_reg(sh4, (inst >> 8) & 0xf));
+    if (guest_prof_enabled)
+        guest_prof_on_call(sh4, dst);
+    sh4_branch_delayed(sh4, dst);
 }
 
 #define INST_MASK_0100mmmm00001110 0xf0ff
@@ -3292,7 +2403,7 @@ void sh4_inst_binary_mov_imm_gen(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    *sh4_gen_reg(sh4, (inst >> 8) & 0xf) = (int32_t)((int8_t)inst_imm8(inst));
+    sh4_inst_body_binary_mov_imm_gen(sh4, (inst >> 8) & 0xf, inst);
 }
 
 #define INST_MASK_0111nnnniiiiiiii 0xf000
@@ -3306,7 +2417,7 @@ void sh4_inst_binary_add_imm_gen(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    *sh4_gen_reg(sh4, (inst >> 8) & 0xf) += (int32_t)((int8_t)(inst_imm8(inst)));
+    sh4_inst_body_binary_add_imm_gen(sh4, (inst >> 8) & 0xf, inst);
 }
 
 #define INST_MASK_1001nnnndddddddd 0xf000
@@ -3360,7 +2471,7 @@ void sh4_inst_binary_mov_gen_gen(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    *sh4_gen_reg(sh4, (inst >> 8) & 0xf) = *sh4_gen_reg(sh4, (inst >> 4) & 0xf);
+    sh4_inst_body_binary_mov_gen_gen(sh4, (inst >> 8) & 0xf, (inst >> 4) & 0xf);
 }
 
 #define INST_MASK_0110nnnnmmmm1000 0xf00f
@@ -3437,7 +2548,7 @@ void sh4_inst_binary_add_gen_gen(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    *sh4_gen_reg(sh4, (inst >> 8) & 0xf) += *sh4_gen_reg(sh4, (inst >> 4) & 0xf);
+    sh4_inst_body_binary_add_gen_gen(sh4, (inst >> 8) & 0xf, (inst >> 4) & 0xf);
 }
 
 #define INST_MASK_0011nnnnmmmm1110 0xf00f
@@ -3496,11 +2607,8 @@ void sh4_inst_binary_cmpeq_gen_gen(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    sh4->reg[SH4_REG_SR] &= ~SH4_SR_FLAG_T_MASK;
-    sh4->reg[SH4_REG_SR] |=
-        ((*sh4_gen_reg(sh4, (inst >> 4) & 0xf) ==
-          *sh4_gen_reg(sh4, (inst >> 8) & 0xf)) <<
-               SH4_SR_FLAG_T_SHIFT);
+    sh4_inst_body_binary_cmpeq_gen_gen(sh4, (inst >> 8) & 0xf,
+                                       (inst >> 4) & 0xf);
 }
 
 #define INST_MASK_0011nnnnmmmm0010 0xf00f
@@ -5697,7 +4805,8 @@ void sh4_inst_unary_fabs_fr(void *cpu, cpu_inst_param inst) {
 
 // FADD FRm, FRn
 // 1111nnnnmmmm0000
-void sh4_inst_binary_fadd_fr_fr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fadd_fr_fr_impl(void *cpu, cpu_inst_param inst, bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmmm0000, INST_CONS_1111nnnnmmmm0000);
 
@@ -5710,7 +4819,7 @@ void sh4_inst_binary_fadd_fr_fr(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     float *srcp = sh4_fpu_fr(sh4, (inst >> 4) & 0xf);
     float *dstp = sh4_fpu_fr(sh4, (inst >> 8) & 0xf);
@@ -5718,37 +4827,39 @@ void sh4_inst_binary_fadd_fr_fr(void *cpu, cpu_inst_param inst) {
     float src = *srcp;
     float dst = *dstp;
 
-#ifdef SH4_FPU_PEDANTIC
-
-    if (issignaling(src) || issignaling(dst)) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
-    }
+    if (pedantic) {
+        if (issignaling(src) || issignaling(dst)) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
+            return;
+        }
 
-    int src_class = fpclassify(src);
-    int dst_class = fpclassify(dst);
+        int src_class = fpclassify(src);
+        int dst_class = fpclassify(dst);
 
-    if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
-        sh4_fpu_error(sh4);
-        return;
-    }
+        if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
+            sh4_fpu_error(sh4);
+            return;
+        }
 
-    if (src_class == FP_INFINITE && dst_class == FP_INFINITE) {
-        sh4_fpu_error(sh4);
-        return;
+        if (src_class == FP_INFINITE && dst_class == FP_INFINITE) {
+            sh4_fpu_error(sh4);
+            return;
+        }
     }
 
-#endif
-
     *dstp = dst + src;
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fadd_fr_fr)
+
 #define INST_MASK_1111nnnnmmmm0100 0xf00f
 #define INST_CONS_1111nnnnmmmm0100 0xf004
 
 // FCMP/EQ FRm, FRn
 // 1111nnnnmmmm0100
-void sh4_inst_binary_fcmpeq_fr_fr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fcmpeq_fr_fr_impl(void *cpu, cpu_inst_param inst,
+                                  bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmmm0100, INST_CONS_1111nnnnmmmm0100);
 
@@ -5761,7 +4872,7 @@ void sh4_inst_binary_fcmpeq_fr_fr(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     float *srcp = sh4_fpu_fr(sh4, (inst >> 4) & 0xf);
     float *dstp = sh4_fpu_fr(sh4, (inst >> 8) & 0xf);
@@ -5769,27 +4880,31 @@ void sh4_inst_binary_fcmpeq_fr_fr(void *cpu, cpu_inst_param inst) {
     float src = *srcp;
     float dst = *dstp;
 
-#ifdef SH4_FPU_PEDANTIC
-    int src_class = fpclassify(src);
-    int dst_class = fpclassify(dst);
+    if (pedantic) {
+        int src_class = fpclassify(src);
+        int dst_class = fpclassify(dst);
 
-    if (src_class == FP_NAN || dst_class == FP_NAN) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
+        if (src_class == FP_NAN || dst_class == FP_NAN) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
+            return;
+        }
     }
-#endif
 
     unsigned t_flag = (dst == src);
     sh4->reg[SH4_REG_SR] &= ~SH4_SR_FLAG_T_MASK;
     sh4->reg[SH4_REG_SR] |= (t_flag << SH4_SR_FLAG_T_SHIFT);
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fcmpeq_fr_fr)
+
 #define INST_MASK_1111nnnnmmmm0101 0xf00f
 #define INST_CONS_1111nnnnmmmm0101 0xf005
 
 // FCMP/GT FRm, FRn
 // 1111nnnnmmmm0101
-void sh4_inst_binary_fcmpgt_fr_fr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fcmpgt_fr_fr_impl(void *cpu, cpu_inst_param inst,
+                                  bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmmm0101, INST_CONS_1111nnnnmmmm0101);
 
@@ -5802,7 +4917,7 @@ void sh4_inst_binary_fcmpgt_fr_fr(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     float *srcp = sh4_fpu_fr(sh4, (inst >> 4) & 0xf);
     float *dstp = sh4_fpu_fr(sh4, (inst >> 8) & 0xf);
@@ -5810,27 +4925,30 @@ void sh4_inst_binary_fcmpgt_fr_fr(void *cpu, cpu_inst_param inst) {
     float src = *srcp;
     float dst = *dstp;
 
-#ifdef SH4_FPU_PEDANTIC
-    int src_class = fpclassify(src);
-    int dst_class = fpclassify(dst);
+    if (pedantic) {
+        int src_class = fpclassify(src);
+        int dst_class = fpclassify(dst);
 
-    if (src_class == FP_NAN || dst_class == FP_NAN) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
+        if (src_class == FP_NAN || dst_class == FP_NAN) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
+            return;
+        }
     }
-#endif
 
     unsigned t_flag = (dst > src);
     sh4->reg[SH4_REG_SR] &= ~SH4_SR_FLAG_T_MASK;
     sh4->reg[SH4_REG_SR] |= (t_flag << SH4_SR_FLAG_T_SHIFT);
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fcmpgt_fr_fr)
+
 #define INST_MASK_1111nnnnmmmm0011 0xf00f
 #define INST_CONS_1111nnnnmmmm0011 0xf003
 
 // FDIV FRm, FRn
 // 1111nnnnmmmm0011
-void sh4_inst_binary_fdiv_fr_fr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fdiv_fr_fr_impl(void *cpu, cpu_inst_param inst, bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmmm0011, INST_CONS_1111nnnnmmmm0011);
 
@@ -5843,7 +4961,7 @@ void sh4_inst_binary_fdiv_fr_fr(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     float *srcp = sh4_fpu_fr(sh4, (inst >> 4) & 0xf);
     float *dstp = sh4_fpu_fr(sh4, (inst >> 8) & 0xf);
@@ -5851,38 +4969,40 @@ void sh4_inst_binary_fdiv_fr_fr(void *cpu, cpu_inst_param inst) {
     float src = *srcp;
     float dst = *dstp;
 
-#ifdef SH4_FPU_PEDANTIC
-    if (issignaling(src) || issignaling(dst)) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
-    }
-
-    int src_class = fpclassify(src);
-    int dst_class = fpclassify(dst);
+    if (pedantic) {
+        if (issignaling(src) || issignaling(dst)) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
+            return;
+        }
 
-    if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
-        sh4_fpu_error(sh4);
-        return;
-    }
+        int src_class = fpclassify(src);
+        int dst_class = fpclassify(dst);
 
-    if (src_class == FP_ZERO && dst_class == FP_ZERO) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
-    }
+        if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
+            sh4_fpu_error(sh4);
+            return;
+        }
 
-    if (src_class == FP_ZERO) {
-        sh4->reg[SH4_REG_FPSCR] |=
-            (SH4_FPSCR_FLAG_Z_MASK | SH4_FPSCR_CAUSE_Z_MASK);
-        if (sh4->reg[SH4_REG_FPSCR] & SH4_FPSCR_ENABLE_Z_MASK) {
-            sh4_set_exception(sh4, SH4_EXCP_FPU);
+        if (src_class == FP_ZERO && dst_class == FP_ZERO) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
             return;
         }
+
+        if (src_class == FP_ZERO) {
+            sh4->reg[SH4_REG_FPSCR] |=
+                (SH4_FPSCR_FLAG_Z_MASK | SH4_FPSCR_CAUSE_Z_MASK);
+            if (sh4->reg[SH4_REG_FPSCR] & SH4_FPSCR_ENABLE_Z_MASK) {
+                sh4_set_exception(sh4, SH4_EXCP_FPU);
+                return;
+            }
+        }
     }
-#endif
 
     *dstp = dst / src;
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fdiv_fr_fr)
+
 #define INST_MASK_1111nnnn00101101 0xf0ff
 #define INST_CONS_1111nnnn00101101 0xf02d
 
@@ -5942,7 +5062,8 @@ void sh4_inst_trinary_fmac_fr0_fr_fr(void *cpu, cpu_inst_param inst) {
 
 // FMUL FRm, FRn
 // 1111nnnnmmmm0010
-void sh4_inst_binary_fmul_fr_fr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fmul_fr_fr_impl(void *cpu, cpu_inst_param inst, bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmmm0010, INST_CONS_1111nnnnmmmm0010);
 
@@ -5955,7 +5076,7 @@ void sh4_inst_binary_fmul_fr_fr(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     float *srcp = sh4_fpu_fr(sh4, (inst >> 4) & 0xf);
     float *dstp = sh4_fpu_fr(sh4, (inst >> 8) & 0xf);
@@ -5963,30 +5084,32 @@ void sh4_inst_binary_fmul_fr_fr(void *cpu, cpu_inst_param inst) {
     float src = *srcp;
     float dst = *dstp;
 
-#ifdef SH4_FPU_PEDANTIC
-    if (issignaling(src) || issignaling(dst)) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
-    }
+    if (pedantic) {
+        if (issignaling(src) || issignaling(dst)) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
+            return;
+        }
 
-    int src_class = fpclassify(src);
-    int dst_class = fpclassify(dst);
+        int src_class = fpclassify(src);
+        int dst_class = fpclassify(dst);
 
-    if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
-        sh4_fpu_error(sh4);
-        return;
-    }
+        if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
+            sh4_fpu_error(sh4);
+            return;
+        }
 
-    if ((src_class == FP_ZERO && dst_class == FP_INFINITE) ||
-        (src_class == FP_INFINITE && dst_class == FP_ZERO)) {
-        sh4_fr_invalid(sh4, inst.fr_dst);
-        return;
+        if ((src_class == FP_ZERO && dst_class == FP_INFINITE) ||
+            (src_class == FP_INFINITE && dst_class == FP_ZERO)) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + ((inst >> 8) & 0xf));
+            return;
+        }
     }
-#endif
 
     *dstp = src * dst;
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fmul_fr_fr)
+
 #define INST_MASK_1111nnnn01001101 0xf0ff
 #define INST_CONS_1111nnnn01001101 0xf04d
 
@@ -6060,7 +5183,8 @@ void sh4_inst_unary_fsqrt_fr(void *cpu, cpu_inst_param inst) {
 
 // FSUB FRm, FRn
 // 1111nnnnmmmm0001
-void sh4_inst_binary_fsub_fr_fr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fsub_fr_fr_impl(void *cpu, cpu_inst_param inst, bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmmm0001, INST_CONS_1111nnnnmmmm0001);
 
@@ -6073,7 +5197,7 @@ void sh4_inst_binary_fsub_fr_fr(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     int fr_src = (inst >> 4) & 0xf;
     int fr_dst = (inst >> 8) & 0xf;
@@ -6084,31 +5208,31 @@ void sh4_inst_binary_fsub_fr_fr(void *cpu, cpu_inst_param inst) {
     float src = *srcp;
     float dst = *dstp;
 
-#ifdef SH4_FPU_PEDANTIC
-
-    if (issignaling(src) || issignaling(dst)) {
-        sh4_fr_invalid(sh4, fr_dst);
-        return;
-    }
+    if (pedantic) {
+        if (issignaling(src) || issignaling(dst)) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + fr_dst);
+            return;
+        }
 
-    int src_class = fpclassify(src);
-    int dst_class = fpclassify(dst);
+        int src_class = fpclassify(src);
+        int dst_class = fpclassify(dst);
 
-    if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
-        sh4_fpu_error(sh4);
-        return;
-    }
+        if (src_class == FP_SUBNORMAL || dst_class == FP_SUBNORMAL) {
+            sh4_fpu_error(sh4);
+            return;
+        }
 
-    if (src_class == FP_INFINITE && dst_class == FP_INFINITE) {
-        sh4_fpu_error(sh4);
-        return;
+        if (src_class == FP_INFINITE && dst_class == FP_INFINITE) {
+            sh4_fpu_error(sh4);
+            return;
+        }
     }
 
-#endif
-
     *dstp = dst - src;
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fsub_fr_fr)
+
 #define INST_MASK_1111mmmm00111101 0xf0ff
 #define INST_CONS_1111mmmm00111101 0xf03d
 
@@ -6581,7 +5705,9 @@ void sh4_inst_binary_ftrc_dr_fpul(void *cpu, cpu_inst_param inst) {
 
 // FSCA FPUL, DRn
 // 1111nnn011111101
-void sh4_inst_binary_fsca_fpul_dr(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fsca_fpul_dr_impl(void *cpu, cpu_inst_param inst,
+                                  bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnn011111101, INST_CONS_1111nnn011111101);
 
@@ -6595,11 +5721,11 @@ void sh4_inst_binary_fsca_fpul_dr(void *cpu, cpu_inst_param inst) {
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
     // TODO: should I really be calling sh4_fpu_clear_cause here ?
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
-#ifdef SH4_FPU_PEDANTIC
-    sh4->reg[SH4_REG_FPSCR] |= (SH4_FPSCR_CAUSE_I_MASK | SH4_FPSCR_FLAG_I_MASK);
-#endif
+    if (pedantic) {
+        sh4->reg[SH4_REG_FPSCR] |= (SH4_FPSCR_CAUSE_I_MASK | SH4_FPSCR_FLAG_I_MASK);
+    }
 
     unsigned sin_reg_no = ((inst >> 9) & 0x7) * 2;
     unsigned cos_reg_no = sin_reg_no + 1;
@@ -6611,6 +5737,8 @@ void sh4_inst_binary_fsca_fpul_dr(void *cpu, cpu_inst_param inst) {
            sizeof(float));
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fsca_fpul_dr)
+
 #define INST_MASK_0100mmmm01101010 0xf0ff
 #define INST_CONS_0100mmmm01101010 0x406a
 
@@ -7033,7 +6161,8 @@ void sh4_inst_binary_fmov_xs_binind_r0_gen(void *cpu, cpu_inst_param inst) {
 
 // FIPR FVm, FVn - vector dot product
 // 1111nnmm11101101
-void sh4_inst_binary_fipr_fv_fv(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fipr_fv_fv_impl(void *cpu, cpu_inst_param inst, bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnmm11101101, INST_CONS_1111nnmm11101101);
 
@@ -7044,24 +6173,24 @@ void sh4_inst_binary_fipr_fv_fv(void *cpu, cpu_inst_param inst) {
         return;
 #endif
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
-#ifdef SH4_FPU_PEDANTIC
-    if (sh4->reg[SH4_REG_FPSCR] & (SH4_FPSCR_ENABLE_V_MASK |
-                                   SH4_FPSCR_ENABLE_O_MASK |
-                                   SH4_FPSCR_ENABLE_U_MASK |
-                                   SH4_FPSCR_ENABLE_I_MASK)) {
-        sh4_set_exception(sh4, SH4_EXCP_FPU);
-        return;
+    if (pedantic) {
+        if (sh4->reg[SH4_REG_FPSCR] & (SH4_FPSCR_ENABLE_V_MASK |
+                                       SH4_FPSCR_ENABLE_O_MASK |
+                                       SH4_FPSCR_ENABLE_U_MASK |
+                                       SH4_FPSCR_ENABLE_I_MASK)) {
+            sh4_set_exception(sh4, SH4_EXCP_FPU);
+            return;
+        }
+        /*
+         * TODO:
+         * There's quite alot of error-checking/exception-raising/flag-setting to
+         * be done here.  For now I'm committing without it becuase it looks like a
+         * real headache to write, and I'm honestly of the opinion that going this
+         * deep with the pedantry is a waste of time anyways.
+         */
     }
-    /*
-     * TODO:
-     * There's quite alot of error-checking/exception-raising/flag-setting to
-     * be done here.  For now I'm committing without it becuase it looks like a
-     * real headache to write, and I'm honestly of the opinion that going this
-     * deep with the pedantry is a waste of time anyways.
-     */
-#endif
     unsigned reg_src_idx = ((inst >> 8) & 0x3) * 4;
     unsigned reg_dst_idx = ((inst >> 10) & 0x3) * 4;
 
@@ -7076,12 +6205,16 @@ void sh4_inst_binary_fipr_fv_fv(void *cpu, cpu_inst_param inst) {
     memcpy(sh4->reg + SH4_REG_FR0 + reg_dst_idx + 3, &dst, sizeof(dst));
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fipr_fv_fv)
+
 #define INST_MASK_1111nn0111111101 0xf3ff
 #define INST_CONS_1111nn0111111101 0xf1fd
 
 // FTRV XMTRX, FVn - multiple vector by matrix
 // 1111nn0111111101
-void sh4_inst_binary_fitrv_mxtrx_fv(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_binary_fitrv_mxtrx_fv_impl(void *cpu, cpu_inst_param inst,
+                                    bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nn0111111101, INST_CONS_1111nn0111111101);
 
@@ -7092,24 +6225,24 @@ void sh4_inst_binary_fitrv_mxtrx_fv(void *cpu, cpu_inst_param inst) {
         return;
 #endif
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
-#ifdef SH4_FPU_PEDANTIC
-    if (sh4->reg[SH4_REG_FPSCR] & (SH4_FPSCR_ENABLE_V_MASK |
-                                   SH4_FPSCR_ENABLE_O_MASK |
-                                   SH4_FPSCR_ENABLE_U_MASK |
-                                   SH4_FPSCR_ENABLE_I_MASK)) {
-        sh4_set_exception(sh4, SH4_EXCP_FPU);
-        return;
+    if (pedantic) {
+        if (sh4->reg[SH4_REG_FPSCR] & (SH4_FPSCR_ENABLE_V_MASK |
+                                       SH4_FPSCR_ENABLE_O_MASK |
+                                       SH4_FPSCR_ENABLE_U_MASK |
+                                       SH4_FPSCR_ENABLE_I_MASK)) {
+            sh4_set_exception(sh4, SH4_EXCP_FPU);
+            return;
+        }
+        /*
+         * TODO:
+         * There's quite alot of error-checking/exception-raising/flag-setting to
+         * be done here.  For now I'm committing without it becuase it looks like a
+         * real headache to write, and I'm honestly of the opinion that going this
+         * deep with the pedantry is a waste of time anyways.
+         */
     }
-    /*
-     * TODO:
-     * There's quite alot of error-checking/exception-raising/flag-setting to
-     * be done here.  For now I'm committing without it becuase it looks like a
-     * real headache to write, and I'm honestly of the opinion that going this
-     * deep with the pedantry is a waste of time anyways.
-     */
-#endif
 
     unsigned reg_idx = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
     float tmp[4];
@@ -7159,12 +6292,15 @@ void sh4_inst_binary_fitrv_mxtrx_fv(void *cpu, cpu_inst_param inst) {
     memcpy(sh4->reg + reg_idx, tmp_out, sizeof(tmp_out));
 }
 
+DEF_FPU_VARIANTS(sh4_inst_binary_fitrv_mxtrx_fv)
+
 #define INST_MASK_1111nnnn01111101 0xf0ff
 #define INST_CONS_1111nnnn01111101 0xf07d
 
 // FSRRA FRn
 // 1111nnnn01111101
-void sh4_inst_unary_fsrra_frn(void *cpu, cpu_inst_param inst) {
+static WASHDC_ALWAYS_INLINE void
+sh4_inst_unary_fsrra_frn_impl(void *cpu, cpu_inst_param inst, bool pedantic) {
 
     CHECK_INST(inst, INST_MASK_1111nnnn01111101, INST_CONS_1111nnnn01111101);
 
@@ -7177,35 +6313,45 @@ void sh4_inst_unary_fsrra_frn(void *cpu, cpu_inst_param inst) {
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_PR_MASK, 0);
 
-    sh4_fpu_clear_cause(sh4);
+    sh4_fpu_variant_clear_cause(sh4, pedantic);
 
     int fr_reg = (inst >> 8) & 0xf;
     float *srcp = sh4_fpu_fr(sh4, fr_reg);
     float src = *srcp;
 
-#ifdef SH4_FPU_PEDANTIC
-    if ((src < 0.0f) || issignaling(src)) {
-        sh4_fr_invalid(sh4, fr_reg);
-        return;
-    }
+    if (pedantic) {
+        if ((src < 0.0f) || issignaling(src)) {
+            sh4_fr_invalid(sh4, SH4_REG_FR0 + fr_reg);
+            return;
+        }
 
-    int class = fpclassify(src);
+        int class = fpclassify(src);
 
-    if (class == FP_SUBNORMAL) {
-        // TODO: do I raise an exception here?
-        sh4->reg[SH4_REG_FPSCR] |= (SH4_FPSCR_CAUSE_E_MASK |
-                                    SH4_FPSCR_FLAG_E_MASK);
-        return;
-    }
+        if (class == FP_SUBNORMAL) {
+            // TODO: do I raise an exception here?
+            sh4->reg[SH4_REG_FPSCR] |= SH4_FPSCR_CAUSE_E_MASK;
+            return;
+        }
 
-    sh4->reg[SH4_REG_FPSCR] |= (SH4_FPSCR_ENABLE_I_MASK | SH4_FPSCR_CAUSE_I_MASK);
-    if (sh4->reg[SH4_REG_FPSCR] & SH4_FPSCR_ENABLE_I_MASK)
-        sh4_set_exception(sh4, SH4_EXCP_FPU);
-#endif
+        sh4->reg[SH4_REG_FPSCR] |=
+            (SH4_FPSCR_FLAG_I_MASK | SH4_FPSCR_CAUSE_I_MASK);
+        if (sh4->reg[SH4_REG_FPSCR] & SH4_FPSCR_ENABLE_I_MASK)
+            sh4_set_exception(sh4, SH4_EXCP_FPU);
+    }
 
     *srcp = 1.0 / sqrt(src);
 }
 
+DEF_FPU_VARIANTS(sh4_inst_unary_fsrra_frn)
+
+void sh4_inst_hle_syscall(void *cpu, cpu_inst_param inst) {
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
+
+    // outside of HLE direct-boots this opcode is as undefined as it ever was
+    if (hle_syscall_dispatch(sh4, sh4->reg[SH4_REG_PC]) != 0)
+        sh4_inst_invalid(cpu, inst);
+}
+
 void sh4_inst_invalid(void *cpu, cpu_inst_param inst) {
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
@@ -7603,3 +6749,61 @@ DEF_FPU_HANDLER(fsca_fpu, SH4_FPSCR_PR_MASK,
 // 1111nnnn01111101
 DEF_FPU_HANDLER(fsrra_fpu, SH4_FPSCR_PR_MASK,
                 sh4_inst_unary_fsrra_frn, sh4_inst_invalid);
+
+// pedantic versions of the handlers above which have pedantic variants
+DEF_FPU_HANDLER(fadd_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fadd_fr_fr_pedantic,
+                sh4_inst_binary_fadd_dr_dr)
+DEF_FPU_HANDLER(fcmpeq_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fcmpeq_fr_fr_pedantic,
+                sh4_inst_binary_fcmpeq_dr_dr)
+DEF_FPU_HANDLER(fcmpgt_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fcmpgt_fr_fr_pedantic,
+                sh4_inst_binary_fcmpgt_dr_dr)
+DEF_FPU_HANDLER(fdiv_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fdiv_fr_fr_pedantic,
+                sh4_inst_binary_fdiv_dr_dr)
+DEF_FPU_HANDLER(fmul_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fmul_fr_fr_pedantic,
+                sh4_inst_binary_fmul_dr_dr)
+DEF_FPU_HANDLER(fsub_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fsub_fr_fr_pedantic,
+                sh4_inst_binary_fsub_dr_dr)
+DEF_FPU_HANDLER(fsca_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_binary_fsca_fpul_dr_pedantic,
+                sh4_inst_invalid)
+DEF_FPU_HANDLER(fsrra_fpu_pedantic, SH4_FPSCR_PR_MASK,
+                sh4_inst_unary_fsrra_frn_pedantic, sh4_inst_invalid)
+
+static struct sh4_fpu_variant {
+    opcode_func_t fast, pedantic;
+} const sh4_fpu_variants[] = {
+    { FPU_HANDLER(fadd_fpu), FPU_HANDLER(fadd_fpu_pedantic) },
+    { FPU_HANDLER(fcmpeq_fpu), FPU_HANDLER(fcmpeq_fpu_pedantic) },
+    { FPU_HANDLER(fcmpgt_fpu), FPU_HANDLER(fcmpgt_fpu_pedantic) },
+    { FPU_HANDLER(fdiv_fpu), FPU_HANDLER(fdiv_fpu_pedantic) },
+    { FPU_HANDLER(fmul_fpu), FPU_HANDLER(fmul_fpu_pedantic) },
+    { FPU_HANDLER(fsub_fpu), FPU_HANDLER(fsub_fpu_pedantic) },
+    { FPU_HANDLER(fsca_fpu), FPU_HANDLER(fsca_fpu_pedantic) },
+    { FPU_HANDLER(fsrra_fpu), FPU_HANDLER(fsrra_fpu_pedantic) },
+    { sh4_inst_binary_fipr_fv_fv, sh4_inst_binary_fipr_fv_fv_pedantic },
+    { sh4_inst_binary_fitrv_mxtrx_fv,
+      sh4_inst_binary_fitrv_mxtrx_fv_pedantic }
+};
+
+#define SH4_N_FPU_VARIANTS \
+    (sizeof(sh4_fpu_variants) / sizeof(sh4_fpu_variants[0]))
+
+void sh4_inst_set_fpu_pedantic(bool pedantic) {
+    InstOpcode *op;
+    unsigned idx;
+    for (op = sh4_opcode_list; op->func; op++) {
+        for (idx = 0; idx < SH4_N_FPU_VARIANTS; idx++) {
+            struct sh4_fpu_variant const *var = sh4_fpu_variants + idx;
+            if (op->func == var->fast || op->func == var->pedantic) {
+                op->func = pedantic ? var->pedantic : var->fast;
+                break;
+            }
+        }
+    }
+}
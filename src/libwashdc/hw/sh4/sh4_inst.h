@@ -34,12 +34,10 @@ struct Sh4;
 typedef struct Sh4 Sh4;
 
 /*
- * the lut is a static (global) table that will be shared by all sh4
- * instances even if there's more than one of them, but sh4_init_lut
- * will always initialize it in the exact same way so it's safe to call this
- * function more than once.
+ * register every opcode handler with the persistent jit cache so that
+ * fallbacks can be relocated.
  */
-void sh4_init_inst_lut();
+void sh4_inst_persist_register(void);
 
 typedef void (*opcode_func_t)(void*, cpu_inst_param);
 
@@ -86,6 +84,43 @@ struct InstOpcode;
 struct il_code_block;
 struct sh4_jit_compile_ctx;
 
+/*
+ * register classes for InstOpcode's fallback_regs.  FPU covers every
+ * floating-point register along with FPSCR and FPUL, BANK covers R0_BANK
+ * through R7_BANK, and MAC covers both MACH and MACL.
+ */
+enum sh4_fb_reg {
+    SH4_FB_RN,  // general-purpose register in bits 8-11
+    SH4_FB_RM,  // general-purpose register in bits 4-7
+    SH4_FB_R0,
+    SH4_FB_FRN, // floating-point register in bits 8-11
+    SH4_FB_BANK,
+    SH4_FB_FPU,
+    SH4_FB_SR,
+    SH4_FB_GBR,
+    SH4_FB_VBR,
+    SH4_FB_SSR,
+    SH4_FB_SPC,
+    SH4_FB_SGR,
+    SH4_FB_DBR,
+    SH4_FB_MAC,
+    SH4_FB_PR,
+    SH4_FB_FPUL,
+    SH4_FB_FPSCR,
+
+    SH4_FB_N_REGS
+};
+
+#define SH4_FB_RD(reg) (((uint64_t)1) << SH4_FB_##reg)
+#define SH4_FB_WR(reg) (((uint64_t)1) << (SH4_FB_N_REGS + SH4_FB_##reg))
+#define SH4_FB_RW(reg) (SH4_FB_RD(reg) | SH4_FB_WR(reg))
+
+/*
+ * the opcode could do anything at all (bank-switching, exceptions, HLE calls,
+ * etc).  This is also what every opcode with a native jit implementation uses.
+ */
+#define SH4_FB_ALL (~(uint64_t)0)
+
 /*
  * these functions return true if the jit frontend should keep going, or false
  * if the dissassembler should end the current block.
@@ -124,15 +159,44 @@ struct InstOpcode {
     // by anding with mask and checking for equality with val
     cpu_inst_param mask;
     cpu_inst_param val;
+
+    /*
+     * registers which func reads and writes, as SH4_FB_* flags.  The jit uses
+     * this to decide which registers have to be written back to the reg array
+     * before a fallback, and which ones it has to reload afterwards.
+     */
+    uint64_t fallback_regs;
 };
 
 typedef struct InstOpcode InstOpcode;
 
 /*
- * maps 16-bit instructions to InstOpcodes for O(1) decoding
- * this array looks big but it's really only half a megabyte
+ * every opcode, followed by the invalid opcode and then a NULL terminator.
+ * See sh4_inst_list.h.
  */
-extern InstOpcode const *sh4_inst_lut[1 << 16];
+extern InstOpcode sh4_opcode_list[];
+
+/*
+ * maps 16-bit instructions to indices in sh4_opcode_list for O(1) decoding.
+ * This is generated at build time by sh4_inst_lut_gen.c.
+ */
+extern uint8_t const sh4_inst_lut[1 << 16];
+
+/*
+ * for opcodes that have operand-specialized handlers, sh4_inst_spec points to
+ * an array of 256 of them indexed by bits 4-11 of the instruction.  Every
+ * other entry is NULL.  This is also generated at build time by
+ * sh4_inst_lut_gen.c; see sh4_inst_spec.h.
+ */
+extern opcode_func_t const *const sh4_inst_spec[];
+
+/*
+ * Select between the fast and pedantic variants of the FPU handlers which
+ * have them.  The pedantic variants check for denormals and invalid
+ * operations and keep the FPSCR cause bits up to date.  This patches
+ * sh4_opcode_list, so call it before anything is decoded.
+ */
+void sh4_inst_set_fpu_pedantic(bool pedantic);
 
 void sh4_compile_instructions(Sh4 *sh4);
 void sh4_compile_instruction(Sh4 *sh4, struct InstOpcode *op);
@@ -904,18 +968,22 @@ void sh4_inst_unary_fabs_fr(void *cpu, cpu_inst_param inst);
 // FADD FRm, FRn
 // 1111nnnnmmmm0000
 void sh4_inst_binary_fadd_fr_fr(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fadd_fr_fr_pedantic(void *cpu, cpu_inst_param inst);
 
 // FCMP/EQ FRm, FRn
 // 1111nnnnmmmm0100
 void sh4_inst_binary_fcmpeq_fr_fr(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fcmpeq_fr_fr_pedantic(void *cpu, cpu_inst_param inst);
 
 // FCMP/GT FRm, FRn
 // 1111nnnnmmmm0101
 void sh4_inst_binary_fcmpgt_fr_fr(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fcmpgt_fr_fr_pedantic(void *cpu, cpu_inst_param inst);
 
 // FDIV FRm, FRn
 // 1111nnnnmmmm0011
 void sh4_inst_binary_fdiv_fr_fr(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fdiv_fr_fr_pedantic(void *cpu, cpu_inst_param inst);
 
 // FLOAT FPUL, FRn
 // 1111nnnn00101101
@@ -928,6 +996,7 @@ void sh4_inst_trinary_fmac_fr0_fr_fr(void *cpu, cpu_inst_param inst);
 // FMUL FRm, FRn
 // 1111nnnnmmmm0010
 void sh4_inst_binary_fmul_fr_fr(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fmul_fr_fr_pedantic(void *cpu, cpu_inst_param inst);
 
 // FNEG FRn
 // 1111nnnn01001101
@@ -940,6 +1009,7 @@ void sh4_inst_unary_fsqrt_fr(void *cpu, cpu_inst_param inst);
 // FSUB FRm, FRn
 // 1111nnnnmmmm0001
 void sh4_inst_binary_fsub_fr_fr(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fsub_fr_fr_pedantic(void *cpu, cpu_inst_param inst);
 
 // FTRC FRm, FPUL
 // 1111mmmm00111101
@@ -1068,14 +1138,17 @@ void sh4_inst_binary_fmov_xs_binind_r0_gen(void *cpu, cpu_inst_param inst);
 // FIPR FVm, FVn - vector dot product
 // 1111nnmm11101101
 void sh4_inst_binary_fipr_fv_fv(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fipr_fv_fv_pedantic(void *cpu, cpu_inst_param inst);
 
 // FTRV MXTRX, FVn - multiple vector by matrix
 // 1111nn0111111101
 void sh4_inst_binary_fitrv_mxtrx_fv(void *cpu, cpu_inst_param inst);
+void sh4_inst_binary_fitrv_mxtrx_fv_pedantic(void *cpu, cpu_inst_param inst);
 
 // FSRRA FRn
 // 1111nnnn01111101
 void sh4_inst_unary_fsrra_frn(void *cpu, cpu_inst_param inst);
+void sh4_inst_unary_fsrra_frn_pedantic(void *cpu, cpu_inst_param inst);
 
 /*
  * fake opcode used for implementing softbreaks and errors.
@@ -1087,6 +1160,8 @@ void sh4_inst_unary_fsrra_frn(void *cpu, cpu_inst_param inst);
  */
 void sh4_inst_invalid(void *cpu, cpu_inst_param inst);
 
+void sh4_inst_hle_syscall(void *cpu, cpu_inst_param inst);
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // The following handlers are for floating-point opcodes that share their
@@ -1251,4 +1326,13 @@ DECL_FPU_HANDLER(fsca_fpu);
 // 1111nnnn01111101
 DECL_FPU_HANDLER(fsrra_fpu);
 
+DECL_FPU_HANDLER(fadd_fpu_pedantic);
+DECL_FPU_HANDLER(fcmpeq_fpu_pedantic);
+DECL_FPU_HANDLER(fcmpgt_fpu_pedantic);
+DECL_FPU_HANDLER(fdiv_fpu_pedantic);
+DECL_FPU_HANDLER(fmul_fpu_pedantic);
+DECL_FPU_HANDLER(fsub_fpu_pedantic);
+DECL_FPU_HANDLER(fsca_fpu_pedantic);
+DECL_FPU_HANDLER(fsrra_fpu_pedantic);
+
 #endif
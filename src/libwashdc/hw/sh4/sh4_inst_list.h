@@ -0,0 +1,998 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+/*
+ * sh4_inst_list.h
+ *
+ * The table of every SH4 opcode.  This file gets included by both sh4_inst.c
+ * and sh4_inst_lut_gen.c, each of which defines SH4_INST to expand to
+ * whatever it needs from each entry:
+ *
+ *     SH4_INST(func, disas, pc_relative, group, issue, mask, val, regs)
+ *
+ * regs is the set of registers func touches (see SH4_FB_RD and friends in
+ * sh4_inst.h).  It only matters when the jit calls func as a fallback, so
+ * opcodes which have a native implementation just say SH4_FB_ALL.
+ *
+ * Instructions are matched against the entries in order, so when two
+ * patterns overlap the one that comes first wins.
+ */
+
+    // RTS
+    SH4_INST(&sh4_inst_rts, sh4_jit_rts, true, SH4_GROUP_CO, 2, 0xffff, 0x000b,
+        SH4_FB_ALL)
+
+    // CLRMAC
+    SH4_INST(&sh4_inst_clrmac, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xffff, 0x0028, SH4_FB_WR(MAC))
+
+    // CLRS
+    SH4_INST(&sh4_inst_clrs, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xffff, 0x0048, SH4_FB_RW(SR))
+
+    // CLRT
+    SH4_INST(&sh4_inst_clrt, sh4_jit_clrt, false,
+        SH4_GROUP_MT, 1, 0xffff, 0x0008, SH4_FB_ALL)
+
+    // LDTLB
+    SH4_INST(&sh4_inst_ldtlb, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xffff, 0x0038, SH4_FB_ALL)
+
+    // NOP
+    SH4_INST(&sh4_inst_nop, sh4_jit_nop, false,
+        SH4_GROUP_MT, 1, 0xffff, 0x0009, SH4_FB_ALL)
+
+    /*
+     * NOP (undocumented)
+     *
+     * I've verified on real hardware that this is a real opcode that does not
+     * raise any exceptions.  Not 100% sure it should be NOP but I can't see any
+     * side-effects.
+     *
+     * Samba De Amigo ver 2000 does this in a delay slot.
+     */
+    SH4_INST(&sh4_inst_nop, sh4_jit_nop, false,
+        SH4_GROUP_MT, 1, 0xffff, 0x0000, SH4_FB_ALL)
+
+    // RTE
+    SH4_INST(&sh4_inst_rte, sh4_jit_rte, true, SH4_GROUP_CO, 5, 0xffff, 0x002b,
+        SH4_FB_ALL)
+
+    // SETS
+    SH4_INST(&sh4_inst_sets, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xffff, 0x0058, SH4_FB_RW(SR))
+
+    // SETT
+    SH4_INST(&sh4_inst_sett, sh4_jit_sett, false,
+        SH4_GROUP_MT, 1, 0xffff, 0x0018, SH4_FB_ALL)
+
+    // SLEEP
+    SH4_INST(&sh4_inst_sleep, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 4, 0xffff, 0x001b, SH4_FB_ALL)
+
+    // FRCHG
+    SH4_INST(&sh4_inst_frchg, sh4_jit_fallback, false,
+        SH4_GROUP_FE, 1, 0xffff, 0xfbfd, SH4_FB_ALL)
+
+    // FSCHG
+    SH4_INST(&sh4_inst_fschg, sh4_jit_fschg, false,
+        SH4_GROUP_FE, 1, 0xffff, 0xf3fd, SH4_FB_ALL)
+
+    // MOVT Rn
+    SH4_INST(&sh4_inst_unary_movt_gen, sh4_jit_movt, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x0029, SH4_FB_ALL)
+
+    // CMP/PZ
+    SH4_INST(&sh4_inst_unary_cmppz_gen, sh4_jit_cmppz_rn, false,
+        SH4_GROUP_MT, 1, 0xf0ff, 0x4011, SH4_FB_ALL)
+
+    // CMP/PL
+    SH4_INST(&sh4_inst_unary_cmppl_gen, sh4_jit_cmppl_rn, false,
+        SH4_GROUP_MT, 1, 0xf0ff, 0x4015, SH4_FB_ALL)
+
+    // DT
+    SH4_INST(&sh4_inst_unary_dt_gen, sh4_jit_dt_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4010, SH4_FB_ALL)
+
+    // ROTL Rn
+    SH4_INST(&sh4_inst_unary_rotl_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4004, SH4_FB_RW(RN) | SH4_FB_RW(SR))
+
+    // ROTR Rn
+    SH4_INST(&sh4_inst_unary_rotr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4005, SH4_FB_RW(RN) | SH4_FB_RW(SR))
+
+    // ROTCL Rn
+    SH4_INST(&sh4_inst_unary_rotcl_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4024, SH4_FB_RW(RN) | SH4_FB_RW(SR))
+
+    // ROTCR Rn
+    SH4_INST(&sh4_inst_unary_rotcr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4025, SH4_FB_RW(RN) | SH4_FB_RW(SR))
+
+    // SHAL Rn
+    SH4_INST(&sh4_inst_unary_shal_gen, sh4_jit_shal_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4020, SH4_FB_ALL)
+
+    // SHAR Rn
+    SH4_INST(&sh4_inst_unary_shar_gen, sh4_jit_shar_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4021, SH4_FB_ALL)
+
+    // SHLL Rn
+    SH4_INST(&sh4_inst_unary_shll_gen, sh4_jit_shll_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4000, SH4_FB_ALL)
+
+    // SHLR Rn
+    SH4_INST(&sh4_inst_unary_shlr_gen, sh4_jit_shlr_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4001, SH4_FB_ALL)
+
+    // SHLL2 Rn
+    SH4_INST(&sh4_inst_unary_shll2_gen, sh4_jit_shll2_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4008, SH4_FB_ALL)
+
+    // SHLR2 Rn
+    SH4_INST(&sh4_inst_unary_shlr2_gen, sh4_jit_shlr2_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4009, SH4_FB_ALL)
+
+    // SHLL8 Rn
+    SH4_INST(&sh4_inst_unary_shll8_gen, sh4_jit_shll8_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4018, SH4_FB_ALL)
+
+    // SHLR8 Rn
+    SH4_INST(&sh4_inst_unary_shlr8_gen, sh4_jit_shlr8_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4019, SH4_FB_ALL)
+
+    // SHLL16 Rn
+    SH4_INST(&sh4_inst_unary_shll16_gen, sh4_jit_shll16_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4028, SH4_FB_ALL)
+
+    // SHLR16 Rn
+    SH4_INST(&sh4_inst_unary_shlr16_gen, sh4_jit_shlr16_rn, false,
+        SH4_GROUP_EX, 1, 0xf0ff, 0x4029, SH4_FB_ALL)
+
+    // BRAF Rn
+    SH4_INST(&sh4_inst_unary_braf_gen, sh4_jit_braf_rn, true, SH4_GROUP_CO, 2,
+        0xf0ff, 0x0023, SH4_FB_ALL)
+
+    // BSRF Rn
+    SH4_INST(&sh4_inst_unary_bsrf_gen, sh4_jit_bsrf_rn, true, SH4_GROUP_CO, 2,
+        0xf0ff, 0x0003, SH4_FB_ALL)
+
+    // CMP/EQ #imm, R0
+    SH4_INST(&sh4_inst_binary_cmpeq_imm_r0, sh4_jit_fallback, false,
+        SH4_GROUP_MT, 1, 0xff00, 0x8800, SH4_FB_RD(R0) | SH4_FB_RW(SR))
+
+    // AND.B #imm, @(R0, GBR)
+    SH4_INST(&sh4_inst_binary_andb_imm_r0_gbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 4, 0xff00, 0xcd00, SH4_FB_RD(R0) | SH4_FB_RD(GBR))
+
+    // AND #imm, R0
+    SH4_INST(&sh4_inst_binary_and_imm_r0, sh4_inst_binary_andb_imm_r0, false,
+        SH4_GROUP_EX, 1, 0xff00, 0xc900, SH4_FB_ALL)
+
+    // OR.B #imm, @(R0, GBR)
+    SH4_INST(&sh4_inst_binary_orb_imm_r0_gbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 4, 0xff00, 0xcf00, SH4_FB_RD(R0) | SH4_FB_RD(GBR))
+
+    // OR #imm, R0
+    SH4_INST(&sh4_inst_binary_or_imm_r0, sh4_jit_or_imm8_r0, false,
+        SH4_GROUP_EX, 1, 0xff00, 0xcb00, SH4_FB_ALL)
+
+    // TST #imm, R0
+    SH4_INST(&sh4_inst_binary_tst_imm_r0, sh4_jit_tst_imm8_r0, false,
+        SH4_GROUP_MT, 1, 0xff00, 0xc800, SH4_FB_ALL)
+
+    // TST.B #imm, @(R0, GBR)
+    SH4_INST(&sh4_inst_binary_tstb_imm_r0_gbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 3, 0xff00, 0xcc00,
+        SH4_FB_RD(R0) | SH4_FB_RD(GBR) | SH4_FB_RW(SR))
+
+    // XOR #imm, R0
+    SH4_INST(&sh4_inst_binary_xor_imm_r0, sh4_jit_xor_imm8_r0, false,
+        SH4_GROUP_EX, 1, 0xff00, 0xca00, SH4_FB_ALL)
+
+    // XOR.B #imm, @(R0, GBR)
+    SH4_INST(&sh4_inst_binary_xorb_imm_r0_gbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 4, 0xff00, 0xce00, SH4_FB_RD(R0) | SH4_FB_RD(GBR))
+
+    // BF label
+    SH4_INST(&sh4_inst_unary_bf_disp, sh4_jit_bf, true,
+        SH4_GROUP_BR, 1, 0xff00, 0x8b00, SH4_FB_ALL)
+
+    // BF/S label
+    SH4_INST(&sh4_inst_unary_bfs_disp, sh4_jit_bfs, true,
+        SH4_GROUP_BR, 1, 0xff00, 0x8f00, SH4_FB_ALL)
+
+    // BT label
+    SH4_INST(&sh4_inst_unary_bt_disp, sh4_jit_bt, true,
+        SH4_GROUP_BR, 1, 0xff00, 0x8900, SH4_FB_ALL)
+
+    // BT/S label
+    SH4_INST(&sh4_inst_unary_bts_disp, sh4_jit_bts, true,
+        SH4_GROUP_BR, 1, 0xff00, 0x8d00, SH4_FB_ALL)
+
+    // BRA label
+    SH4_INST(&sh4_inst_unary_bra_disp, sh4_jit_bra, true,
+        SH4_GROUP_BR, 1, 0xf000, 0xa000, SH4_FB_ALL)
+
+    // BSR label
+    SH4_INST(&sh4_inst_unary_bsr_disp, sh4_jit_bsr, true,
+        SH4_GROUP_BR, 1, 0xf000, 0xb000, SH4_FB_ALL)
+
+    // TRAPA #immed
+    SH4_INST(&sh4_inst_unary_trapa_disp, sh4_jit_trapa_imm, false,
+        SH4_GROUP_CO, 7, 0xff00, 0xc300, SH4_FB_ALL)
+
+    // HLE system call trap, see hle_syscall.h
+    SH4_INST(&sh4_inst_hle_syscall, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xffff, HLE_SYSCALL_OPCODE, SH4_FB_ALL)
+
+    // TAS.B @Rn
+    SH4_INST(&sh4_inst_unary_tasb_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 5, 0xf0ff, 0x401b, SH4_FB_RD(RN) | SH4_FB_RW(SR))
+
+    // OCBI @Rn
+    SH4_INST(&sh4_inst_unary_ocbi_indgen, sh4_jit_ocbi_arn, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0x0093, SH4_FB_ALL)
+
+    // OCBP @Rn
+    SH4_INST(&sh4_inst_unary_ocbp_indgen, sh4_jit_ocbp_arn, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0x00a3, SH4_FB_ALL)
+
+    // OCBWB @Rn
+    SH4_INST(&sh4_inst_unary_ocbwb_indgen, sh4_jit_ocbwb_arn, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0x00b3, SH4_FB_ALL)
+
+    // PREF @Rn
+    SH4_INST(&sh4_inst_unary_pref_indgen, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0x0083, SH4_FB_RD(RN))
+
+    // JMP @Rn
+    SH4_INST(&sh4_inst_unary_jmp_indgen, sh4_jit_jmp_arn, true,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x402b, SH4_FB_ALL)
+
+    // JSR @Rn
+    SH4_INST(&sh4_inst_unary_jsr_indgen, sh4_jit_jsr_arn, true, SH4_GROUP_CO,
+        2, 0xf0ff, 0x400b, SH4_FB_ALL)
+
+    // LDC Rm, SR
+    SH4_INST(&sh4_inst_binary_ldc_gen_sr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 4, 0xf0ff, 0x400e, SH4_FB_ALL)
+
+    // LDC Rm, GBR
+    SH4_INST(&sh4_inst_binary_ldc_gen_gbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 3, 0xf0ff, 0x401e, SH4_FB_RD(RN) | SH4_FB_WR(GBR))
+
+    // LDC Rm, VBR
+    SH4_INST(&sh4_inst_binary_ldc_gen_vbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x402e, SH4_FB_RD(RN) | SH4_FB_WR(VBR))
+
+    // LDC Rm, SSR
+    SH4_INST(&sh4_inst_binary_ldc_gen_ssr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x403e, SH4_FB_RD(RN) | SH4_FB_WR(SSR))
+
+    // LDC Rm, SPC
+    SH4_INST(&sh4_inst_binary_ldc_gen_spc, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x404e, SH4_FB_RD(RN) | SH4_FB_WR(SPC))
+
+    // LDC Rm, DBR
+    SH4_INST(&sh4_inst_binary_ldc_gen_dbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x40fa, SH4_FB_RD(RN) | SH4_FB_WR(DBR))
+
+    // STC SR, Rn
+    SH4_INST(&sh4_inst_binary_stc_sr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x0002, SH4_FB_RD(SR) | SH4_FB_WR(RN))
+
+    // STC GBR, Rn
+    SH4_INST(&sh4_inst_binary_stc_gbr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x0012, SH4_FB_RD(GBR) | SH4_FB_WR(RN))
+
+    // STC VBR, Rn
+    SH4_INST(&sh4_inst_binary_stc_vbr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x0022, SH4_FB_RD(VBR) | SH4_FB_WR(RN))
+
+    // STC SSR, Rn
+    SH4_INST(&sh4_inst_binary_stc_ssr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x0032, SH4_FB_RD(SSR) | SH4_FB_WR(RN))
+
+    // STC SPC, Rn
+    SH4_INST(&sh4_inst_binary_stc_spc_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x0042, SH4_FB_RD(SPC) | SH4_FB_WR(RN))
+
+    // STC SGR, Rn
+    SH4_INST(&sh4_inst_binary_stc_sgr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 3, 0xf0ff, 0x003a, SH4_FB_RD(SGR) | SH4_FB_WR(RN))
+
+    // STC DBR, Rn
+    SH4_INST(&sh4_inst_binary_stc_dbr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x00fa, SH4_FB_RD(DBR) | SH4_FB_WR(RN))
+
+    // LDC.L @Rm+, SR
+    SH4_INST(&sh4_inst_binary_ldcl_indgeninc_sr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 4, 0xf0ff, 0x4007, SH4_FB_ALL)
+
+    // LDC.L @Rm+, GBR
+    SH4_INST(&sh4_inst_binary_ldcl_indgeninc_gbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 3, 0xf0ff, 0x4017, SH4_FB_RW(RN) | SH4_FB_WR(GBR))
+
+    // LDC.L @Rm+, VBR
+    SH4_INST(&sh4_inst_binary_ldcl_indgeninc_vbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4027, SH4_FB_RW(RN) | SH4_FB_WR(VBR))
+
+    // LDC.L @Rm+, SSR
+    SH4_INST(&sh4_inst_binary_ldcl_indgenic_ssr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4037, SH4_FB_RW(RN) | SH4_FB_WR(SSR))
+
+    // LDC.L @Rm+, SPC
+    SH4_INST(&sh4_inst_binary_ldcl_indgeninc_spc, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4047, SH4_FB_RW(RN) | SH4_FB_WR(SPC))
+
+    // LDC.L @Rm+, DBR
+    SH4_INST(&sh4_inst_binary_ldcl_indgeninc_dbr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x40f6, SH4_FB_RW(RN) | SH4_FB_WR(DBR))
+
+    // STC.L SR, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_sr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4003, SH4_FB_RW(RN) | SH4_FB_RD(SR))
+
+    // STC.L GBR, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_gbr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4013, SH4_FB_RW(RN) | SH4_FB_RD(GBR))
+
+    // STC.L VBR, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_vbr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4023, SH4_FB_RW(RN) | SH4_FB_RD(VBR))
+
+    // STC.L SSR, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_ssr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4033, SH4_FB_RW(RN) | SH4_FB_RD(SSR))
+
+    // STC.L SPC, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_spc_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4043, SH4_FB_RW(RN) | SH4_FB_RD(SPC))
+
+    // STC.L SGR, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_sgr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 3, 0xf0ff, 0x4032, SH4_FB_RW(RN) | SH4_FB_RD(SGR))
+
+    // STC.L DBR, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_dbr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x40f2, SH4_FB_RW(RN) | SH4_FB_RD(DBR))
+
+    // MOV #imm, Rn
+    SH4_INST(&sh4_inst_binary_mov_imm_gen, sh4_jit_mov_imm8_rn, false,
+        SH4_GROUP_EX, 1, 0xf000, 0xe000, SH4_FB_ALL)
+
+    // ADD #imm, Rn
+    SH4_INST(&sh4_inst_binary_add_imm_gen, sh4_jit_add_imm_rn, false,
+        SH4_GROUP_EX, 1, 0xf000, 0x7000, SH4_FB_ALL)
+
+    // MOV.W @(disp, PC), Rn
+    SH4_INST(&sh4_inst_binary_movw_binind_disp_pc_gen,
+        sh4_jit_movw_a_disp_pc_rn,
+        true, SH4_GROUP_LS, 1, 0xf000, 0x9000, SH4_FB_ALL)
+
+    // MOV.L @(disp, PC), Rn
+    SH4_INST(&sh4_inst_binary_movl_binind_disp_pc_gen,
+        sh4_jit_movl_a_disp_pc_rn,
+        true, SH4_GROUP_LS, 1, 0xf000, 0xd000, SH4_FB_ALL)
+
+    // MOV Rm, Rn
+    SH4_INST(&sh4_inst_binary_mov_gen_gen, sh4_jit_mov_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x6003, SH4_FB_ALL)
+
+    // SWAP.B Rm, Rn
+    SH4_INST(&sh4_inst_binary_swapb_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x6008, SH4_FB_RD(RM) | SH4_FB_WR(RN))
+
+    // SWAP.W Rm, Rn
+    SH4_INST(&sh4_inst_binary_swapw_gen_gen, sh4_jit_swapw_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x6009, SH4_FB_ALL)
+
+    // XTRCT Rm, Rn
+    SH4_INST(&sh4_inst_binary_xtrct_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x200d, SH4_FB_RW(RN) | SH4_FB_RD(RM))
+
+    // ADD Rm, Rn
+    SH4_INST(&sh4_inst_binary_add_gen_gen, sh4_jit_add_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x300c, SH4_FB_ALL)
+
+    // ADDC Rm, Rn
+    SH4_INST(&sh4_inst_binary_addc_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x300e,
+        SH4_FB_RW(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // ADDV Rm, Rn
+    SH4_INST(&sh4_inst_binary_addv_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x300f,
+        SH4_FB_RW(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // CMP/EQ Rm, Rn
+    SH4_INST(&sh4_inst_binary_cmpeq_gen_gen, sh4_jit_cmpeq_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x3000, SH4_FB_ALL)
+
+    // CMP/HS Rm, Rn
+    SH4_INST(&sh4_inst_binary_cmphs_gen_gen, sh4_jit_cmphs_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x3002, SH4_FB_ALL)
+
+    // CMP/GE Rm, Rn
+    SH4_INST(&sh4_inst_binary_cmpge_gen_gen, sh4_jit_cmpge_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x3003, SH4_FB_ALL)
+
+    // CMP/HI Rm, Rn
+    SH4_INST(&sh4_inst_binary_cmphi_gen_gen, sh4_jit_cmphi_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x3006, SH4_FB_ALL)
+
+    // CMP/GT Rm, Rn
+    SH4_INST(&sh4_inst_binary_cmpgt_gen_gen, sh4_jit_cmpgt_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x3007, SH4_FB_ALL)
+
+    // CMP/STR Rm, Rn
+    SH4_INST(&sh4_inst_binary_cmpstr_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x200c,
+        SH4_FB_RD(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // DIV1 Rm, Rn
+    SH4_INST(&sh4_inst_binary_div1_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x3004,
+        SH4_FB_RW(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // DIV0S Rm, Rn
+    SH4_INST(&sh4_inst_binary_div0s_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x2007,
+        SH4_FB_RD(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // DIV0U
+    SH4_INST(&sh4_inst_noarg_div0u, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xffff, 0x0019, SH4_FB_RW(SR))
+
+    // DMULS.L Rm, Rn
+    SH4_INST(&sh4_inst_binary_dmulsl_gen_gen, sh4_jit_dmulsl_rm_rn, false,
+        SH4_GROUP_CO, 2, 0xf00f, 0x300d, SH4_FB_ALL)
+
+    // DMULU.L Rm, Rn
+    SH4_INST(&sh4_inst_binary_dmulul_gen_gen, sh4_jit_dmulul_rm_rn, false,
+        SH4_GROUP_CO, 2, 0xf00f, 0x3005, SH4_FB_ALL)
+
+    // EXTS.B Rm, Rn
+    SH4_INST(&sh4_inst_binary_extsb_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x600e, SH4_FB_RD(RM) | SH4_FB_WR(RN))
+
+    // EXTS.W Rm, Rn
+    SH4_INST(&sh4_inst_binary_extsw_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x600f, SH4_FB_RD(RM) | SH4_FB_WR(RN))
+
+    // EXTU.B Rm, Rn
+    SH4_INST(&sh4_inst_binary_extub_gen_gen, sh4_jit_extub_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x600c, SH4_FB_ALL)
+
+    // EXTU.W Rm, Rn
+    SH4_INST(&sh4_inst_binary_extuw_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x600d, SH4_FB_RD(RM) | SH4_FB_WR(RN))
+
+    // MUL.L Rm, Rn
+    SH4_INST(&sh4_inst_binary_mull_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf00f, 0x0007,
+        SH4_FB_RD(RN) | SH4_FB_RD(RM) | SH4_FB_WR(MAC))
+
+    // MULS.W Rm, Rn
+    SH4_INST(&sh4_inst_binary_mulsw_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf00f, 0x200f,
+        SH4_FB_RD(RN) | SH4_FB_RD(RM) | SH4_FB_WR(MAC))
+
+    // MULU.W Rm, Rn
+    SH4_INST(&sh4_inst_binary_muluw_gen_gen, sh4_jit_muluw_rm_rn, false,
+        SH4_GROUP_CO, 2, 0xf00f, 0x200e, SH4_FB_ALL)
+
+    // NEG Rm, Rn
+    SH4_INST(&sh4_inst_binary_neg_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x600b, SH4_FB_RD(RM) | SH4_FB_WR(RN))
+
+    // NEGC Rm, Rn
+    SH4_INST(&sh4_inst_binary_negc_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x600a,
+        SH4_FB_RD(RM) | SH4_FB_WR(RN) | SH4_FB_RW(SR))
+
+    // SUB Rm, Rn
+    SH4_INST(&sh4_inst_binary_sub_gen_gen, sh4_jit_sub_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x3008, SH4_FB_ALL)
+
+    // SUBC Rm, Rn
+    SH4_INST(&sh4_inst_binary_subc_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x300a,
+        SH4_FB_RW(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // SUBV Rm, Rn
+    SH4_INST(&sh4_inst_binary_subv_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x300b,
+        SH4_FB_RW(RN) | SH4_FB_RD(RM) | SH4_FB_RW(SR))
+
+    // AND Rm, Rn
+    SH4_INST(&sh4_inst_binary_and_gen_gen, sh4_jit_and_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x2009, SH4_FB_ALL)
+
+    // NOT Rm, Rn
+    SH4_INST(&sh4_inst_binary_not_gen_gen, sh4_jit_not_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x6007, SH4_FB_ALL)
+
+    // OR Rm, Rn
+    SH4_INST(&sh4_inst_binary_or_gen_gen, sh4_jit_or_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x200b, SH4_FB_ALL)
+
+    // TST Rm, Rn
+    SH4_INST(&sh4_inst_binary_tst_gen_gen, sh4_jit_tst_rm_rn, false,
+        SH4_GROUP_MT, 1, 0xf00f, 0x2008, SH4_FB_ALL)
+
+    // XOR Rm, Rn
+    SH4_INST(&sh4_inst_binary_xor_gen_gen, sh4_jit_xor_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x200a, SH4_FB_ALL)
+
+    // SHAD Rm, Rn
+    SH4_INST(&sh4_inst_binary_shad_gen_gen, sh4_jit_shad_rm_rn, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x400c, SH4_FB_ALL)
+
+    // SHLD Rm, Rn
+    SH4_INST(&sh4_inst_binary_shld_gen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_EX, 1, 0xf00f, 0x400d, SH4_FB_RW(RN) | SH4_FB_RD(RM))
+
+    // LDC Rm, Rn_BANK
+    SH4_INST(&sh4_inst_binary_ldc_gen_bank, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf08f, 0x408e,
+        SH4_FB_RD(RN) | SH4_FB_RD(SR) | SH4_FB_WR(BANK))
+
+    // LDC.L @Rm+, Rn_BANK
+    SH4_INST(&sh4_inst_binary_ldcl_indgeninc_bank, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf08f, 0x4087,
+        SH4_FB_RW(RN) | SH4_FB_RD(SR) | SH4_FB_WR(BANK))
+
+    // STC Rm_BANK, Rn
+    SH4_INST(&sh4_inst_binary_stc_bank_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf08f, 0x0082,
+        SH4_FB_RD(BANK) | SH4_FB_RD(SR) | SH4_FB_WR(RN))
+
+    // STC.L Rm_BANK, @-Rn
+    SH4_INST(&sh4_inst_binary_stcl_bank_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf08f, 0x4083,
+        SH4_FB_RW(RN) | SH4_FB_RD(BANK) | SH4_FB_RD(SR))
+
+    // LDS Rm, MACH
+    SH4_INST(&sh4_inst_binary_lds_gen_mach, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x400a, SH4_FB_RD(RN) | SH4_FB_WR(MAC))
+
+    // LDS Rm, MACL
+    SH4_INST(&sh4_inst_binary_lds_gen_macl, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x401a, SH4_FB_RD(RN) | SH4_FB_WR(MAC))
+
+    // STS MACH, Rn
+    SH4_INST(&sh4_inst_binary_sts_mach_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x000a, SH4_FB_RD(MAC) | SH4_FB_WR(RN))
+
+    // STS MACL, Rn
+    SH4_INST(&sh4_inst_binary_sts_macl_gen, sh4_jit_sts_macl_rn, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x001a, SH4_FB_ALL)
+
+    // LDS Rm, PR
+    SH4_INST(&sh4_inst_binary_lds_gen_pr, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x402a, SH4_FB_RD(RN) | SH4_FB_WR(PR))
+
+    // STS PR, Rn
+    SH4_INST(&sh4_inst_binary_sts_pr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x002a, SH4_FB_RD(PR) | SH4_FB_WR(RN))
+
+    // LDS.L @Rm+, MACH
+    SH4_INST(&sh4_inst_binary_ldsl_indgeninc_mach, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4006, SH4_FB_RW(RN) | SH4_FB_WR(MAC))
+
+    // LDS.L @Rm+, MACL
+    SH4_INST(&sh4_inst_binary_ldsl_indgeninc_macl, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4016, SH4_FB_RW(RN) | SH4_FB_WR(MAC))
+
+    // STS.L MACH, @-Rn
+    SH4_INST(&sh4_inst_binary_stsl_mach_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4002, SH4_FB_RW(RN) | SH4_FB_RD(MAC))
+
+    // STS.L MACL, @-Rn
+    SH4_INST(&sh4_inst_binary_stsl_macl_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4012, SH4_FB_RW(RN) | SH4_FB_RD(MAC))
+
+    // LDS.L @Rm+, PR
+    SH4_INST(&sh4_inst_binary_ldsl_indgeninc_pr, sh4_jit_ldsl_armp_pr, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4026, SH4_FB_ALL)
+
+    // STS.L PR, @-Rn
+    SH4_INST(&sh4_inst_binary_stsl_pr_inddecgen, sh4_jit_stsl_pr_amrn, false,
+        SH4_GROUP_CO, 2, 0xf0ff, 0x4022, SH4_FB_ALL)
+
+    // MOV.B Rm, @Rn
+    SH4_INST(&sh4_inst_binary_movb_gen_indgen, sh4_jit_movb_rm_arn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x2000, SH4_FB_ALL)
+
+    // MOV.W Rm, @Rn
+    SH4_INST(&sh4_inst_binary_movw_gen_indgen, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x2001, SH4_FB_RD(RN) | SH4_FB_RD(RM))
+
+    // MOV.L Rm, @Rn
+    SH4_INST(&sh4_inst_binary_movl_gen_indgen, sh4_jit_movl_rm_arn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x2002, SH4_FB_ALL)
+
+    // MOV.B @Rm, Rn
+    SH4_INST(&sh4_inst_binary_movb_indgen_gen, sh4_jit_movb_arm_rn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x6000, SH4_FB_ALL)
+
+    // MOV.W @Rm, Rn
+    SH4_INST(&sh4_inst_binary_movw_indgen_gen, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x6001, SH4_FB_RD(RM) | SH4_FB_WR(RN))
+
+    // MOV.L @Rm, Rn
+    SH4_INST(&sh4_inst_binary_movl_indgen_gen, sh4_jit_movl_arm_rn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x6002, SH4_FB_ALL)
+
+    // MOV.B Rm, @-Rn
+    SH4_INST(&sh4_inst_binary_movb_gen_inddecgen, sh4_jit_movb_rm_amrn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x2004, SH4_FB_ALL)
+
+    // MOV.W Rm, @-Rn
+    SH4_INST(&sh4_inst_binary_movw_gen_inddecgen, sh4_jit_movw_rm_amrn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x2005, SH4_FB_ALL)
+
+    // MOV.L Rm, @-Rn
+    SH4_INST(&sh4_inst_binary_movl_gen_inddecgen, sh4_jit_movl_rm_amrn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x2006, SH4_FB_ALL)
+
+    // MOV.B @Rm+, Rn
+    SH4_INST(&sh4_inst_binary_movb_indgeninc_gen, sh4_jit_movb_armp_rn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x6004, SH4_FB_ALL)
+
+    // MOV.W @Rm+, Rn
+    SH4_INST(&sh4_inst_binary_movw_indgeninc_gen, sh4_jit_movw_armp_rn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x6005, SH4_FB_ALL)
+
+    // MOV.L @Rm+, Rn
+    SH4_INST(&sh4_inst_binary_movl_indgeninc_gen, sh4_jit_movl_armp_rn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0x6006, SH4_FB_ALL)
+
+    // MAC.L @Rm+, @Rn+
+    SH4_INST(&sh4_inst_binary_macl_indgeninc_indgeninc, sh4_jit_macl_armp_arnp,
+        false, SH4_GROUP_CO, 2, 0xf00f, 0x000f, SH4_FB_ALL)
+
+    // MAC.W @Rm+, @Rn+
+    SH4_INST(&sh4_inst_binary_macw_indgeninc_indgeninc, sh4_jit_macw_armp_arnp,
+        false, SH4_GROUP_CO, 2, 0xf00f, 0x400f, SH4_FB_ALL)
+
+    // MOV.B R0, @(disp, Rn)
+    SH4_INST(&sh4_inst_binary_movb_r0_binind_disp_gen, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0x8000, SH4_FB_RD(R0) | SH4_FB_RD(RM))
+
+    // MOV.W R0, @(disp, Rn)
+    SH4_INST(&sh4_inst_binary_movw_r0_binind_disp_gen, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0x8100, SH4_FB_RD(R0) | SH4_FB_RD(RM))
+
+    // MOV.L Rm, @(disp, Rn)
+    SH4_INST(&sh4_inst_binary_movl_gen_binind_disp_gen,
+        sh4_jit_movl_rm_a_disp4_rn,
+        false, SH4_GROUP_LS, 1, 0xf000, 0x1000, SH4_FB_ALL)
+
+    // MOV.B @(disp, Rm), R0
+    SH4_INST(&sh4_inst_binary_movb_binind_disp_gen_r0, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0x8400, SH4_FB_RD(RM) | SH4_FB_WR(R0))
+
+    // MOV.W @(disp, Rm), R0
+    SH4_INST(&sh4_inst_binary_movw_binind_disp_gen_r0, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0x8500, SH4_FB_RD(RM) | SH4_FB_WR(R0))
+
+    // MOV.L @(disp, Rm), Rn
+    SH4_INST(&sh4_inst_binary_movl_binind_disp_gen_gen,
+        sh4_jit_movl_a_disp4_rm_rn,
+        false, SH4_GROUP_LS, 1, 0xf000, 0x5000, SH4_FB_ALL)
+
+    // MOV.B Rm, @(R0, Rn)
+    SH4_INST(&sh4_inst_binary_movb_gen_binind_r0_gen, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xf00f, 0x0004,
+        SH4_FB_RD(RM) | SH4_FB_RD(R0) | SH4_FB_RD(RN))
+
+    // MOV.W Rm, @(R0, Rn)
+    SH4_INST(&sh4_inst_binary_movw_gen_binind_r0_gen, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xf00f, 0x0005,
+        SH4_FB_RD(RM) | SH4_FB_RD(R0) | SH4_FB_RD(RN))
+
+    // MOV.L Rm, @(R0, Rn)
+    SH4_INST(&sh4_inst_binary_movl_gen_binind_r0_gen, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xf00f, 0x0006,
+        SH4_FB_RD(RM) | SH4_FB_RD(R0) | SH4_FB_RD(RN))
+
+    // MOV.B @(R0, Rm), Rn
+    SH4_INST(&sh4_inst_binary_movb_binind_r0_gen_gen, sh4_jit_movb_a_r0_rm_rn,
+        false, SH4_GROUP_LS, 1, 0xf00f, 0x000c, SH4_FB_ALL)
+
+    // MOV.W @(R0, Rm), Rn
+    SH4_INST(&sh4_inst_binary_movw_binind_r0_gen_gen, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xf00f, 0x000d,
+        SH4_FB_RD(RM) | SH4_FB_RD(R0) | SH4_FB_WR(RN))
+
+    // MOV.L @(R0, Rm), Rn
+    SH4_INST(&sh4_inst_binary_movl_binind_r0_gen_gen, sh4_jit_movl_a_r0_rm_rn,
+        false, SH4_GROUP_LS, 1, 0xf00f, 0x000e, SH4_FB_ALL)
+
+    // MOV.B R0, @(disp, GBR)
+    SH4_INST(&sh4_inst_binary_movb_r0_binind_disp_gbr, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0xc000, SH4_FB_RD(R0) | SH4_FB_RD(GBR))
+
+    // MOV.W R0, @(disp, GBR)
+    SH4_INST(&sh4_inst_binary_movw_r0_binind_disp_gbr, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0xc100, SH4_FB_RD(R0) | SH4_FB_RD(GBR))
+
+    // MOV.L R0, @(disp, GBR)
+    SH4_INST(&sh4_inst_binary_movl_r0_binind_disp_gbr, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0xc200, SH4_FB_RD(R0) | SH4_FB_RD(GBR))
+
+    // MOV.B @(disp, GBR), R0
+    SH4_INST(&sh4_inst_binary_movb_binind_disp_gbr_r0, sh4_jit_fallback,
+        false, SH4_GROUP_LS, 1, 0xff00, 0xc400, SH4_FB_RD(GBR) | SH4_FB_WR(R0))
+
+    // MOV.W @(disp, GBR), R0
+    SH4_INST(&sh4_inst_binary_movw_binind_disp_gbr_r0, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xff00, 0xc500, SH4_FB_RD(GBR) | SH4_FB_WR(R0))
+
+    // MOV.L @(disp, GBR), R0
+    SH4_INST(&sh4_inst_binary_movl_binind_disp_gbr_r0,
+        sh4_jit_movl_a_disp8_gbr_r0,
+        false, SH4_GROUP_LS, 1, 0xff00, 0xc600, SH4_FB_ALL)
+
+    // MOVA @(disp, PC), R0
+    SH4_INST(&sh4_inst_binary_mova_binind_disp_pc_r0, sh4_jit_mova_a_disp_pc_r0,
+        true, SH4_GROUP_EX, 1, 0xff00, 0xc700, SH4_FB_ALL)
+
+    // MOVCA.L R0, @Rn
+    SH4_INST(&sh4_inst_binary_movcal_r0_indgen, sh4_jit_movcal_r0_arn,
+        false, SH4_GROUP_LS, 1, 0xf0ff, 0x00c3, SH4_FB_ALL)
+
+    // FLDI0 FRn
+    SH4_INST(FPU_HANDLER(fldi0), sh4_jit_fldi0_frn, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0xf08d, SH4_FB_ALL)
+
+    // FLDI1 Frn
+    SH4_INST(FPU_HANDLER(fldi1), sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0xf09d, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FMOV FRm, FRn
+    // 1111nnnnmmmm1100
+    // FMOV DRm, DRn
+    // 1111nnn0mmm01100
+    // FMOV XDm, DRn
+    // 1111nnn0mmm11100
+    // FMOV DRm, XDn
+    // 1111nnn1mmm01100
+    // FMOV XDm, XDn
+    // 1111nnn1mmm11100
+    SH4_INST(FPU_HANDLER(fmov_gen), sh4_jit_fmov_frm_frn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf00c, SH4_FB_ALL)
+
+    // FMOV.S @Rm, FRn
+    // 1111nnnnmmmm1000
+    // FMOV @Rm, DRn
+    // 1111nnn0mmmm1000
+    // FMOV @Rm, XDn
+    // 1111nnn1mmmm1000
+    SH4_INST(FPU_HANDLER(fmovs_ind_gen), sh4_jit_fmov_arm_fpu, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf008, SH4_FB_ALL)
+
+    // FMOV.S @(R0, Rm), FRn
+    // 1111nnnnmmmm0110
+    // FMOV @(R0, Rm), DRn
+    // 1111nnn0mmmm0110
+    // FMOV @(R0, Rm), XDn
+    // 1111nnn1mmmm0110
+    SH4_INST(FPU_HANDLER(fmov_binind_r0_gen_fpu), sh4_jit_fmovs_a_r0_rm_fpu,
+        false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf006, SH4_FB_ALL)
+
+    // FMOV.S @Rm+, FRn
+    // 1111nnnnmmmm1001
+    // FMOV @Rm+, DRn
+    // 1111nnn0mmmm1001
+    // FMOV @Rm+, XDn
+    // 1111nnn1mmmm1001
+    SH4_INST(FPU_HANDLER(fmov_indgeninc_fpu), sh4_jit_fmov_fpu_armp_fpu, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf009, SH4_FB_ALL)
+
+    // FMOV.S FRm, @Rn
+    // 1111nnnnmmmm1010
+    // FMOV DRm, @Rn
+    // 1111nnnnmmm01010
+    // FMOV XDm, @Rn
+    // 1111nnnnmmm11010
+    SH4_INST(FPU_HANDLER(fmov_fpu_indgen), sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf00a,
+        SH4_FB_RD(RN) | SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FMOV.S FRm, @-Rn
+    // 1111nnnnmmmm1011
+    // FMOV DRm, @-Rn
+    // 1111nnnnmmm01011
+    // FMOV XDm, @-Rn
+    // 1111nnnnmmm11011
+    SH4_INST(FPU_HANDLER(fmov_fpu_inddecgen), sh4_jit_fmov_fpu_amrn, false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf00b, SH4_FB_ALL)
+
+    // FMOV.S FRm, @(R0, Rn)
+    // 1111nnnnmmmm0111
+    // FMOV DRm, @(R0, Rn)
+    // 1111nnnnmmm00111
+    // FMOV XDm, @(R0, Rn)
+    // 1111nnnnmmm10111
+    SH4_INST(FPU_HANDLER(fmov_fpu_binind_r0_gen), sh4_jit_fmov_fpu_a_r0_rn,
+        false,
+        SH4_GROUP_LS, 1, 0xf00f, 0xf007, SH4_FB_ALL)
+
+    // FLDS FRm, FPUL
+    // XXX Should this check the SZ or PR bits of FPSCR ?
+    SH4_INST(&sh4_inst_binary_flds_fr_fpul, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0xf01d, SH4_FB_RD(FRN) | SH4_FB_WR(FPUL))
+
+    // FSTS FPUL, FRn
+    // XXX Should this check the SZ or PR bits of FPSCR ?
+    SH4_INST(&sh4_inst_binary_fsts_fpul_fr, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0xf00d, SH4_FB_RD(FPUL) | SH4_FB_WR(FRN))
+
+    // FABS FRn
+    // 1111nnnn01011101
+    // FABS DRn
+    // 1111nnn001011101
+    SH4_INST(FPU_HANDLER(fabs_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0xf05d, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FADD FRm, FRn
+    // 1111nnnnmmmm0000
+    // FADD DRm, DRn
+    // 1111nnn0mmm00000
+    SH4_INST(FPU_HANDLER(fadd_fpu), sh4_jit_fadd_frm_frn, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf000, SH4_FB_ALL)
+
+    // FCMP/EQ FRm, FRn
+    // 1111nnnnmmmm0100
+    // FCMP/EQ DRm, DRn
+    // 1111nnn0mmm00100
+    SH4_INST(FPU_HANDLER(fcmpeq_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf004, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FCMP/GT FRm, FRn
+    // 1111nnnnmmmm0101
+    // FCMP/GT DRm, DRn
+    // 1111nnn0mmm00101
+    SH4_INST(FPU_HANDLER(fcmpgt_fpu), sh4_jit_fcmpgt_frm_frn, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf005, SH4_FB_ALL)
+
+    // FDIV FRm, FRn
+    // 1111nnnnmmmm0011
+    // FDIV DRm, DRn
+    // 1111nnn0mmm00011
+    SH4_INST(FPU_HANDLER(fdiv_fpu), sh4_jit_fdiv_frm_frn, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf003, SH4_FB_ALL)
+
+    // FLOAT FPUL, FRn
+    // 1111nnnn00101101
+    // FLOAT FPUL, DRn
+    // 1111nnn000101101
+    SH4_INST(FPU_HANDLER(float_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_FE, 1, 0xf0ff, 0xf02d, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FMAC FR0, FRm, FRn
+    // 1111nnnnmmmm1110
+    SH4_INST(FPU_HANDLER(fmac_fpu), sh4_jit_fmac_fr0_frm_frn, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf00e, SH4_FB_ALL)
+
+    // FMUL FRm, FRn
+    // 1111nnnnmmmm0010
+    // FMUL DRm, DRn
+    // 1111nnn0mmm00010
+    SH4_INST(FPU_HANDLER(fmul_fpu), sh4_jit_fmul_frm_frn, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf002, SH4_FB_ALL)
+
+    // FNEG FRn
+    // 1111nnnn01001101
+    // FNEG DRn
+    // 1111nnn001001101
+    SH4_INST(FPU_HANDLER(fneg_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0xf04d, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FSQRT FRn
+    // 1111nnnn01101101
+    // FSQRT DRn
+    // 1111nnn001101101
+    SH4_INST(FPU_HANDLER(fsqrt_fpu), sh4_jit_fsqrt_frn, false,
+        SH4_GROUP_FE, 1, 0xf0ff, 0xf06d, SH4_FB_ALL)
+
+    // FSUB FRm, FRn
+    // 1111nnnnmmmm0001
+    // FSUB DRm, DRn
+    // 1111nnn0mmm00001
+    SH4_INST(FPU_HANDLER(fsub_fpu), sh4_jit_fsub_frm_frn, false,
+        SH4_GROUP_FE, 1, 0xf00f, 0xf001, SH4_FB_ALL)
+
+    // FTRC FRm, FPUL
+    // 1111mmmm00111101
+    // FTRC DRm, FPUL
+    // 1111mmm000111101
+    SH4_INST(FPU_HANDLER(ftrc_fpu), sh4_jit_ftrc_frm_fpul, false,
+        SH4_GROUP_FE, 1, 0xf0ff, 0xf03d, SH4_FB_ALL)
+
+    // FCNVDS DRm, FPUL
+    // 1111mmm010111101
+    SH4_INST(FPU_HANDLER(fcnvds_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_FE, 1, 0xf1ff, 0xf0bd, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FCNVSD FPUL, DRn
+    // 1111nnn010101101
+    SH4_INST(FPU_HANDLER(fcnvsd_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_FE, 1, 0xf1ff, 0xf0ad, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // LDS Rm, FPSCR
+    SH4_INST(&sh4_inst_binary_lds_gen_fpscr, sh4_jit_lds_rm_fpscr, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x406a, SH4_FB_ALL)
+
+    // LDS Rm, FPUL
+    SH4_INST(&sh4_inst_binary_gen_fpul, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0x405a, SH4_FB_RD(RN) | SH4_FB_WR(FPUL))
+
+    // LDS.L @Rm+, FPSCR
+    SH4_INST(&sh4_inst_binary_ldsl_indgeninc_fpscr, sh4_jit_ldsl_armp_fpscr,
+        false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4066, SH4_FB_ALL)
+
+    // LDS.L @Rm+, FPUL
+    SH4_INST(&sh4_inst_binary_ldsl_indgeninc_fpul, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4056, SH4_FB_RW(RN) | SH4_FB_WR(FPUL))
+
+    // STS FPSCR, Rn
+    SH4_INST(&sh4_inst_binary_sts_fpscr_gen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x006a, SH4_FB_RD(FPSCR) | SH4_FB_WR(RN))
+
+    // STS FPUL, Rn
+    SH4_INST(&sh4_inst_binary_sts_fpul_gen, sh4_jit_fallback, false,
+        SH4_GROUP_LS, 1, 0xf0ff, 0x005a, SH4_FB_RD(FPUL) | SH4_FB_WR(RN))
+
+    // STS.L FPSCR, @-Rn
+    SH4_INST(&sh4_inst_binary_stsl_fpscr_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4062, SH4_FB_RW(RN) | SH4_FB_RD(FPSCR))
+
+    // STS.L FPUL, @-Rn
+    SH4_INST(&sh4_inst_binary_stsl_fpul_inddecgen, sh4_jit_fallback, false,
+        SH4_GROUP_CO, 1, 0xf0ff, 0x4052, SH4_FB_RW(RN) | SH4_FB_RD(FPUL))
+
+    // FIPR FVm, FVn - vector dot product
+    SH4_INST(&sh4_inst_binary_fipr_fv_fv, sh4_jit_fipr_fvm_fvn, false,
+        SH4_GROUP_FE, 1, 0xf0ff, 0xf0ed, SH4_FB_ALL)
+
+    // FTRV XMTRX, FVn - multiple vector by matrix
+    SH4_INST(&sh4_inst_binary_fitrv_mxtrx_fv, sh4_jit_ftrv_xmtrx_fvn, false,
+        SH4_GROUP_FE, 1, 0xf3ff, 0xf1fd, SH4_FB_ALL)
+
+    // FSCA FPUL, DRn - sine/cosine table lookup
+    // TODO: the issue cycle count here might be wrong, I couldn't find that
+    //       value for this instruction
+    SH4_INST(FPU_HANDLER(fsca_fpu), sh4_jit_fallback, false,
+        SH4_GROUP_FE, 1, 0xf1ff, 0xf0fd, SH4_FB_RW(FPU) | SH4_FB_RW(SR))
+
+    // FSRRA FRn
+    // 1111nnnn01111101
+    // TODO: the issue cycle for this opcode might be wrong as well
+    SH4_INST(FPU_HANDLER(fsrra_fpu), sh4_jit_fsrra_frn, false,
+        SH4_GROUP_FE, 1, 0xf0ff, 0xf07d, SH4_FB_ALL)
@@ -0,0 +1,213 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+/*
+ * sh4_inst_lut_gen.c
+ *
+ * build-time generator for sh4_inst_lut.  This runs on the build host and
+ * writes out a C file containing the index into the opcode table of every
+ * 16-bit instruction so that decoding never has to search the opcode table
+ * at runtime.  The table is const, so it ends up in read-only pages that are
+ * shared by every process which loads libwashdc.
+ *
+ * It also writes out sh4_inst_spec.c, which has a copy of the handler for
+ * each of the hottest opcodes (see specs below) for every combination of
+ * register operands.  The operands are constants in each copy, so they don't
+ * have to be decoded when the handler runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hle_syscall.h"
+
+struct pattern {
+    unsigned mask, val;
+    char const *func;
+};
+
+#define SH4_INST(func, disas, pc_relative, group, issue, mask, val, regs) \
+    { (mask), (val), #func },
+
+static struct pattern const patterns[] = {
+#include "sh4_inst_list.h"
+};
+
+#define N_PATTERNS (sizeof(patterns) / sizeof(patterns[0]))
+
+enum spec_fmt {
+    // 0bxxxxnnnnmmmmxxxx, one handler per Rn/Rm pair
+    SPEC_FMT_RM_RN,
+
+    // 0bxxxxnnnniiiiiiii, one handler per Rn
+    SPEC_FMT_IMM_RN
+};
+
+/*
+ * opcodes that get specialized handlers.  name is the handler's name in
+ * sh4_inst_list.h without the sh4_inst_ prefix, and sh4_inst_spec.h has to
+ * have a matching sh4_inst_body_<name>.
+ */
+static struct spec {
+    char const *name;
+    enum spec_fmt fmt;
+} const specs[] = {
+    { "binary_mov_gen_gen", SPEC_FMT_RM_RN },
+    { "binary_add_gen_gen", SPEC_FMT_RM_RN },
+    { "binary_cmpeq_gen_gen", SPEC_FMT_RM_RN },
+    { "binary_movl_indgen_gen", SPEC_FMT_RM_RN },
+    { "binary_mov_imm_gen", SPEC_FMT_IMM_RN },
+    { "binary_add_imm_gen", SPEC_FMT_IMM_RN }
+};
+
+#define N_SPECS (sizeof(specs) / sizeof(specs[0]))
+
+static int write_lut(FILE *out, char const *argv0) {
+    fprintf(out, "/* generated by sh4_inst_lut_gen.c - do not edit */\n\n"
+            "#include <stdint.h>\n\n"
+            "uint8_t const sh4_inst_lut[1 << 16] = {\n");
+
+    unsigned inst;
+    for (inst = 0; inst < (1 << 16); inst++) {
+        unsigned idx;
+        for (idx = 0; idx < N_PATTERNS; idx++)
+            if ((inst & patterns[idx].mask) == patterns[idx].val)
+                break;
+
+        fprintf(out, "%s%u,%s", inst % 16 ? "" : "    ", idx,
+                inst % 16 == 15 ? "\n" : " ");
+    }
+
+    fprintf(out, "};\n");
+    return 0;
+}
+
+static int find_spec_pattern(struct spec const *spec) {
+    char func[128];
+    snprintf(func, sizeof(func), "&sh4_inst_%s", spec->name);
+
+    unsigned idx;
+    for (idx = 0; idx < N_PATTERNS; idx++)
+        if (strcmp(patterns[idx].func, func) == 0)
+            return idx;
+    return -1;
+}
+
+/*
+ * every table has 256 entries indexed by bits 4-11 of the instruction.  For
+ * SPEC_FMT_IMM_RN, that means each handler shows up 16 times in a row.
+ */
+static int write_spec(FILE *out, char const *argv0) {
+    int pattern_no[N_SPECS];
+    unsigned spec_no, op;
+
+    fprintf(out, "/* generated by sh4_inst_lut_gen.c - do not edit */\n\n"
+            "#include <stddef.h>\n\n"
+            "#include \"sh4_inst_spec.h\"\n");
+
+    for (spec_no = 0; spec_no < N_SPECS; spec_no++) {
+        struct spec const *spec = specs + spec_no;
+        pattern_no[spec_no] = find_spec_pattern(spec);
+        if (pattern_no[spec_no] < 0) {
+            fprintf(stderr, "%s - no opcode named sh4_inst_%s\n",
+                    argv0, spec->name);
+            return 1;
+        }
+
+        unsigned rn, rm;
+        fprintf(out, "\n");
+        for (rn = 0; rn < 16; rn++) {
+            if (spec->fmt == SPEC_FMT_IMM_RN) {
+                fprintf(out, "static void %s_r%u(void *cpu, "
+                        "cpu_inst_param inst) {\n"
+                        "    sh4_inst_body_%s((Sh4*)cpu, %u, inst);\n"
+                        "}\n", spec->name, rn, spec->name, rn);
+                continue;
+            }
+            for (rm = 0; rm < 16; rm++) {
+                fprintf(out, "static void %s_r%u_r%u(void *cpu, "
+                        "cpu_inst_param inst) {\n"
+                        "    sh4_inst_body_%s((Sh4*)cpu, %u, %u);\n"
+                        "}\n", spec->name, rn, rm, spec->name, rn, rm);
+            }
+        }
+
+        fprintf(out, "\nstatic opcode_func_t const %s_tbl[256] = {\n",
+                spec->name);
+        for (op = 0; op < 256; op++) {
+            rn = op >> 4;
+            rm = op & 0xf;
+            if (spec->fmt == SPEC_FMT_IMM_RN)
+                fprintf(out, "    %s_r%u,\n", spec->name, rn);
+            else
+                fprintf(out, "    %s_r%u_r%u,\n", spec->name, rn, rm);
+        }
+        fprintf(out, "};\n");
+    }
+
+    // one extra entry for the invalid opcode
+    fprintf(out, "\nopcode_func_t const *const sh4_inst_spec[%u] = {\n",
+            (unsigned)N_PATTERNS + 1);
+    for (spec_no = 0; spec_no < N_SPECS; spec_no++) {
+        fprintf(out, "    [%d] = %s_tbl,\n",
+                pattern_no[spec_no], specs[spec_no].name);
+    }
+    fprintf(out, "};\n");
+
+    return 0;
+}
+
+static int write_file(char const *argv0, char const *path,
+                      int (*func)(FILE*, char const*)) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "%s - unable to open \"%s\"\n", argv0, path);
+        return 1;
+    }
+
+    int err = func(out, argv0);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "%s - error writing \"%s\"\n", argv0, path);
+        return 1;
+    }
+
+    return err;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <lut.c> <spec.c>\n", argv[0]);
+        return 1;
+    }
+
+    // the invalid opcode goes at index N_PATTERNS, so that has to fit too
+    if (N_PATTERNS > 255) {
+        fprintf(stderr, "%s - too many opcodes (%u) for 8-bit indices\n",
+                argv[0], (unsigned)N_PATTERNS);
+        return 1;
+    }
+
+    if (write_file(argv[0], argv[1], write_lut) != 0)
+        return 1;
+    return write_file(argv[0], argv[2], write_spec);
+}
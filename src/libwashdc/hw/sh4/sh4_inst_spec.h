@@ -0,0 +1,92 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef SH4_INST_SPEC_H_
+#define SH4_INST_SPEC_H_
+
+/*
+ * bodies of the opcodes that have operand-specialized handlers.  Each one
+ * takes its operands as arguments instead of decoding them from the
+ * instruction, so when sh4_inst_spec.c calls them with constants the compiler
+ * folds the register offsets into the loads and stores.  The handlers in
+ * sh4_inst.c call these too so that both versions stay identical.
+ *
+ * sh4_inst_spec.c is written at build time by sh4_inst_lut_gen.c; see
+ * sh4_decode_inst_func in sh4.h for how the specialized handlers get found.
+ */
+
+#include <stdint.h>
+
+#include "sh4.h"
+#include "sh4_inst.h"
+#include "washdc/MemoryMap.h"
+
+// MOV Rm, Rn
+static inline void
+sh4_inst_body_binary_mov_gen_gen(Sh4 *sh4, unsigned rn, unsigned rm) {
+    *sh4_gen_reg(sh4, rn) = *sh4_gen_reg(sh4, rm);
+}
+
+// ADD Rm, Rn
+static inline void
+sh4_inst_body_binary_add_gen_gen(Sh4 *sh4, unsigned rn, unsigned rm) {
+    *sh4_gen_reg(sh4, rn) += *sh4_gen_reg(sh4, rm);
+}
+
+// CMP/EQ Rm, Rn
+static inline void
+sh4_inst_body_binary_cmpeq_gen_gen(Sh4 *sh4, unsigned rn, unsigned rm) {
+    sh4->reg[SH4_REG_SR] &= ~SH4_SR_FLAG_T_MASK;
+    sh4->reg[SH4_REG_SR] |=
+        ((*sh4_gen_reg(sh4, rm) == *sh4_gen_reg(sh4, rn)) <<
+         SH4_SR_FLAG_T_SHIFT);
+}
+
+/*
+ * MOV.L @Rm, Rn
+ *
+ * with the MMU enabled the read has to go through address translation, so
+ * this just hands the instruction back to the regular handler.
+ */
+static inline void
+sh4_inst_body_binary_movl_indgen_gen(Sh4 *sh4, unsigned rn, unsigned rm) {
+#ifdef ENABLE_MMU
+    sh4_inst_binary_movl_indgen_gen(sh4, 0x6002 | (rn << 8) | (rm << 4));
+#else
+    *sh4_gen_reg(sh4, rn) =
+        memory_map_read_32(sh4->mem.map, *sh4_gen_reg(sh4, rm));
+#endif
+}
+
+// MOV #imm, Rn
+static inline void
+sh4_inst_body_binary_mov_imm_gen(Sh4 *sh4, unsigned rn, cpu_inst_param inst) {
+    *sh4_gen_reg(sh4, rn) = (int32_t)((int8_t)(inst & 0xff));
+}
+
+// ADD #imm, Rn
+static inline void
+sh4_inst_body_binary_add_imm_gen(Sh4 *sh4, unsigned rn, cpu_inst_param inst) {
+    *sh4_gen_reg(sh4, rn) += (int32_t)((int8_t)(inst & 0xff));
+}
+
+#endif
@@ -25,12 +25,16 @@
 #include "jit/jit_il.h"
 #include "jit/code_block.h"
 #include "jit/jit_mem.h"
+#include "jit/jit_persist.h"
 
 #ifdef JIT_PROFILE
 #include "jit/jit_profile.h"
 #endif
 
 #include "log.h"
+#include "config.h"
+#include "guest_prof.h"
+#include "hle_func.h"
 #include "sh4.h"
 #include "sh4_read_inst.h"
 #include "sh4_jit.h"
@@ -39,17 +43,39 @@
 #include "jit/x86_64/native_dispatch.h"
 #endif
 
+#ifdef ENABLE_JIT_AARCH64
+#include "jit/aarch64/native_dispatch.h"
+#endif
+
 #include "washdc/hostfile.h"
 
 static jit_hash sh4_jit_hash_wrapper(void *sh4, uint32_t addr);
 
-#ifdef ENABLE_JIT_X86_64
+// constant for FSRRA, which the il loads from memory
+static float const sh4_jit_one_f = 1.0f;
+
+#ifdef ENABLE_JIT_NATIVE
 void sh4_jit_set_native_dispatch_meta(struct native_dispatch_meta *meta) {
 #ifdef JIT_PROFILE
     meta->profile_notify = sh4_jit_profile_notify;
 #endif
     meta->on_compile = sh4_jit_compile_native;
     meta->hash_func = sh4_jit_hash_wrapper;
+
+    if (config_get_jit_tiered()) {
+        meta->on_compile_intp = sh4_jit_compile_intp;
+        meta->tier_threshold = SH4_JIT_TIER_THRESHOLD;
+    } else {
+        meta->on_compile_intp = NULL;
+        meta->tier_threshold = 0;
+    }
+
+#ifndef JIT_PROFILE
+    meta->on_submit = jit_bg_compile_running() ? sh4_jit_submit_native : NULL;
+#else
+    // blocks' profiles get filled in by sh4_jit_compile_native
+    meta->on_submit = NULL;
+#endif
 }
 #endif
 
@@ -89,6 +115,14 @@ struct residency {
 // this is a temporary space the il uses to map sh4 registers to slots
 static struct residency reg_map[SH4_REGISTER_COUNT];
 
+/*
+ * slot which holds the T flag (as 0 or 1) when it has been written but not
+ * yet merged back into SR, or -1 if SR's bit 0 is current.  Keeping T in its
+ * own slot means a T write which gets overwritten before anything reads SR
+ * is a dead write that the IL optimizer can remove.
+ */
+static int t_flag_slot = -1;
+
 static void sh4_jit_set_sr(void *ctx, uint32_t new_sr_val);
 
 static void res_associate_reg(unsigned reg_no, unsigned slot_no);
@@ -152,6 +186,18 @@ sh4_jit_hash_slot_known_fpscr(struct Sh4 *sh4,
                               struct il_code_block *block,
                               unsigned jmp_addr_slot, unsigned hash_slot);
 
+/*
+ * emit a jump whose destination is known to be one of the addresses in
+ * targets.  This lets the backend link the block directly to the
+ * destination.  This should only be used when the values of fpscr's PR and SZ
+ * bits are known.
+ */
+static void
+sh4_jit_jump_static(struct Sh4 *sh4, struct sh4_jit_compile_ctx const *ctx,
+                    struct il_code_block *block, unsigned jmp_addr_slot,
+                    unsigned hash_slot, unsigned n_targets,
+                    uint32_t const *targets);
+
 static unsigned
 get_regbase_slot(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                  struct il_code_block *block) {
@@ -163,14 +209,38 @@ get_regbase_slot(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
     return ctx->reg_slot;
 }
 
+// initial size of the arena that holds il while a block is being compiled
+#define SH4_JIT_IL_ARENA_LEN (64 * 1024)
+
 void sh4_jit_init(struct Sh4 *sh4) {
+    jit_arena_init(&sh4->il_arena, SH4_JIT_IL_ARENA_LEN);
+
 #ifdef JIT_PROFILE
     jit_profile_ctxt_init(&sh4->jit_profile, sizeof(uint16_t));
     sh4->jit_profile.disas = sh4_jit_profile_disas;
 #endif
 }
 
+static void sh4_set_exception_proxy(void *sh4, unsigned excp_code);
+static void sh4_jit_div_exec(void *cpu, uint32_t idiom);
+
+void sh4_jit_persist_register(struct Sh4 *sh4) {
+    jit_persist_register(sh4->reg, sizeof(sh4->reg));
+    jit_persist_register(sh4->mem.map, sizeof(*sh4->mem.map));
+    jit_persist_register(&sh4_jit_one_f, sizeof(sh4_jit_one_f));
+    jit_persist_register((void const*)sh4_jit_set_sr, 1);
+    jit_persist_register((void const*)sh4_set_exception_proxy, 1);
+    jit_persist_register((void const*)sh4_set_fpscr, 1);
+    jit_persist_register((void const*)sh4_jit_div_exec, 1);
+    jit_persist_register((void const*)guest_prof_on_call, 1);
+    jit_persist_register((void const*)guest_prof_on_ret, 1);
+    jit_persist_register((void const*)hle_func_exec, 1);
+    sh4_inst_persist_register();
+}
+
 void sh4_jit_cleanup(struct Sh4 *sh4) {
+    jit_arena_cleanup(&sh4->il_arena);
+
 #ifdef JIT_PROFILE
     washdc_hostfile outfile =
         washdc_hostfile_open("sh4_profile.txt",
@@ -186,6 +256,18 @@ void sh4_jit_cleanup(struct Sh4 *sh4) {
 }
 
 #ifdef JIT_PROFILE
+int sh4_jit_profile_export(struct Sh4 *sh4, char const *path) {
+    washdc_hostfile outfile =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE | WASHDC_HOSTFILE_TEXT);
+    if (outfile == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("Failure to open %s for writing\n", path);
+        return -1;
+    }
+    jit_profile_export_json(&sh4->jit_profile, outfile);
+    washdc_hostfile_close(outfile);
+    return 0;
+}
+
 static washdc_hostfile jit_profile_out;
 
 static void
@@ -203,9 +285,71 @@ static void sh4_jit_profile_emit_fn(char ch) {
 }
 #endif
 
+// record slot_no as the new value of the T flag
+static void res_set_t(struct il_code_block *block, unsigned slot_no) {
+    if (t_flag_slot >= 0)
+        free_slot(block, t_flag_slot);
+    t_flag_slot = slot_no;
+}
+
+/*
+ * merge a pending T flag back into SR.  Returns the slot which held T, which
+ * the caller is then responsible for freeing, or -1 if T was not pending.
+ */
+static int res_merge_t(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                       struct il_code_block *block) {
+    int slot_t = t_flag_slot;
+    if (slot_t < 0)
+        return -1;
+    t_flag_slot = -1;
+
+    unsigned slot_sr =
+        reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    jit_and_const32(block, slot_sr, ~1);
+    jit_or(block, slot_t, slot_sr);
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    return slot_t;
+}
+
+static void res_flush_t(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                        struct il_code_block *block) {
+    int slot_t = res_merge_t(sh4, ctx, block);
+    if (slot_t >= 0)
+        free_slot(block, slot_t);
+}
+
+// throw away a pending T flag because SR is about to be overwritten
+static void res_discard_t(struct il_code_block *block) {
+    if (t_flag_slot >= 0) {
+        free_slot(block, t_flag_slot);
+        t_flag_slot = -1;
+    }
+}
+
+/*
+ * return a slot holding the T flag in bit 0 which is not associated with any
+ * register, so it stays valid even if SR is written afterwards (eg by a delay
+ * slot).  The caller is responsible for freeing it.
+ */
+static unsigned res_claim_t(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                            struct il_code_block *block) {
+    int slot_t = res_merge_t(sh4, ctx, block);
+    if (slot_t >= 0)
+        return slot_t;
+
+    unsigned flag_slot =
+        reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
+    return flag_slot;
+}
+
 static void
 res_drain_reg(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
               struct il_code_block *block, unsigned reg_no) {
+    if (reg_no == SH4_REG_SR)
+        res_flush_t(sh4, ctx, block);
+
     struct residency *res = reg_map + reg_no;
     if (res->stat == REG_STATUS_SLOT) {
         unsigned regbase_slot = get_regbase_slot(sh4, ctx, block);
@@ -238,6 +382,9 @@ res_drain_all_regs(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
  * This does not write it back to the reg array.
  */
 static void res_invalidate_reg(struct il_code_block *block, unsigned reg_no) {
+    if (reg_no == SH4_REG_SR)
+        res_discard_t(block);
+
     struct residency *res = reg_map + reg_no;
     if (res->stat != REG_STATUS_SH4) {
         res->stat = REG_STATUS_SH4;
@@ -254,6 +401,7 @@ static void res_invalidate_all_regs(struct il_code_block *block) {
     for (reg_no = 0; reg_no < SH4_REGISTER_COUNT; reg_no++)
         if (reg_map[reg_no].stat != REG_STATUS_SH4)
             res_invalidate_reg(block, reg_no);
+    res_discard_t(block);
 }
 
 void sh4_jit_new_block(void) {
@@ -264,6 +412,558 @@ void sh4_jit_new_block(void) {
         reg_map[reg_no].last_read = 0;
         reg_map[reg_no].last_write = 0;
     }
+    t_flag_slot = -1;
+}
+
+/*
+ * register masks for idle-loop detection.  Bits 0-15 are the general-purpose
+ * registers of whichever bank is active.
+ */
+#define IDLE_REG_T (1 << 16)
+#define IDLE_REG_GBR (1 << 17)
+#define IDLE_REG(n) (1 << (n))
+
+// longest block that gets considered for idle-loop detection
+#define IDLE_MAX_INSTS 16
+
+enum idle_inst_tp {
+    IDLE_INST_INVALID,
+    IDLE_INST_OK,
+    IDLE_INST_BRANCH,
+    IDLE_INST_DELAYED_BRANCH
+};
+
+/*
+ * classify one instruction for sh4_jit_idle_loop.  Only instructions that
+ * load from memory, compare or shuffle registers around are accepted; *rd and
+ * *wr are set to the registers it reads and writes.  For branches, *disp is
+ * the displacement from (pc + 4) to the branch target.
+ */
+static enum idle_inst_tp
+idle_inst_decode(uint16_t inst, uint32_t *rd, uint32_t *wr, int32_t *disp) {
+    unsigned rn = (inst >> 8) & 0xf;
+    unsigned rm = (inst >> 4) & 0xf;
+
+    *rd = 0;
+    *wr = 0;
+
+    switch (inst >> 12) {
+    case 0x0:
+        if (inst == 0x0009)
+            return IDLE_INST_OK; // NOP
+        switch (inst & 0xf) {
+        case 0xc:
+        case 0xd:
+        case 0xe:
+            // MOV.{B,W,L} @(R0, Rm), Rn
+            *rd = IDLE_REG(0) | IDLE_REG(rm);
+            *wr = IDLE_REG(rn);
+            return IDLE_INST_OK;
+        }
+        return IDLE_INST_INVALID;
+    case 0x2:
+        switch (inst & 0xf) {
+        case 0x8:
+            // TST Rm, Rn
+            *rd = IDLE_REG(rm) | IDLE_REG(rn);
+            *wr = IDLE_REG_T;
+            return IDLE_INST_OK;
+        case 0x9:
+            // AND Rm, Rn
+            *rd = IDLE_REG(rm) | IDLE_REG(rn);
+            *wr = IDLE_REG(rn);
+            return IDLE_INST_OK;
+        }
+        return IDLE_INST_INVALID;
+    case 0x3:
+        switch (inst & 0xf) {
+        case 0x0:
+        case 0x2:
+        case 0x3:
+        case 0x6:
+        case 0x7:
+            // CMP/EQ, CMP/HS, CMP/GE, CMP/HI, CMP/GT
+            *rd = IDLE_REG(rm) | IDLE_REG(rn);
+            *wr = IDLE_REG_T;
+            return IDLE_INST_OK;
+        }
+        return IDLE_INST_INVALID;
+    case 0x4:
+        if ((inst & 0xff) == 0x11 || (inst & 0xff) == 0x15) {
+            // CMP/PZ Rn, CMP/PL Rn
+            *rd = IDLE_REG(rn);
+            *wr = IDLE_REG_T;
+            return IDLE_INST_OK;
+        }
+        return IDLE_INST_INVALID;
+    case 0x5:
+        // MOV.L @(disp, Rm), Rn
+        *rd = IDLE_REG(rm);
+        *wr = IDLE_REG(rn);
+        return IDLE_INST_OK;
+    case 0x6:
+        switch (inst & 0xf) {
+        case 0x0:
+        case 0x1:
+        case 0x2:
+        case 0x3:
+        case 0xc:
+        case 0xd:
+        case 0xe:
+        case 0xf:
+            // MOV.{B,W,L} @Rm, Rn, MOV Rm, Rn, EXTU.{B,W}, EXTS.{B,W}
+            *rd = IDLE_REG(rm);
+            *wr = IDLE_REG(rn);
+            return IDLE_INST_OK;
+        }
+        return IDLE_INST_INVALID;
+    case 0x8:
+        switch (rn) {
+        case 0x4:
+        case 0x5:
+            // MOV.{B,W} @(disp, Rm), R0
+            *rd = IDLE_REG(rm);
+            *wr = IDLE_REG(0);
+            return IDLE_INST_OK;
+        case 0x8:
+            // CMP/EQ #imm, R0
+            *rd = IDLE_REG(0);
+            *wr = IDLE_REG_T;
+            return IDLE_INST_OK;
+        case 0x9:
+        case 0xb:
+        case 0xd:
+        case 0xf:
+            // BT, BF, BT/S, BF/S
+            *rd = IDLE_REG_T;
+            *disp = 2 * (int32_t)(int8_t)(inst & 0xff);
+            return (rn & 4) ? IDLE_INST_DELAYED_BRANCH : IDLE_INST_BRANCH;
+        }
+        return IDLE_INST_INVALID;
+    case 0x9:
+    case 0xd:
+    case 0xe:
+        // MOV.W @(disp, PC), Rn, MOV.L @(disp, PC), Rn, MOV #imm, Rn
+        *wr = IDLE_REG(rn);
+        return IDLE_INST_OK;
+    case 0xa:
+        // BRA
+        *disp = 2 * (((int32_t)(inst & 0xfff) ^ 0x800) - 0x800);
+        return IDLE_INST_DELAYED_BRANCH;
+    case 0xc:
+        switch (rn) {
+        case 0x4:
+        case 0x5:
+        case 0x6:
+            // MOV.{B,W,L} @(disp, GBR), R0
+            *rd = IDLE_REG_GBR;
+            *wr = IDLE_REG(0);
+            return IDLE_INST_OK;
+        case 0x8:
+            // TST #imm, R0
+            *rd = IDLE_REG(0);
+            *wr = IDLE_REG_T;
+            return IDLE_INST_OK;
+        case 0x9:
+            // AND #imm, R0
+            *rd = IDLE_REG(0);
+            *wr = IDLE_REG(0);
+            return IDLE_INST_OK;
+        }
+        return IDLE_INST_INVALID;
+    }
+    return IDLE_INST_INVALID;
+}
+
+bool
+sh4_jit_hle_func(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                 struct jit_code_block *jit_blk, struct il_code_block *block,
+                 addr32_t addr) {
+#ifdef ENABLE_DEBUGGER
+    // breakpoints inside the routine would never get hit
+    if (config_get_dbg_enable())
+        return false;
+#endif
+
+    unsigned n_bytes;
+    int func = hle_func_match(sh4, addr, ctx->pr_bit, &n_bytes);
+    if (func < 0)
+        return false;
+
+    sh4_jit_new_block();
+
+    /*
+     * nothing is cached in slots yet, so the host implementation can work on
+     * the register file directly.  Then return through PR the same way RTS
+     * does.  All of the routine's cycles come from hle_func_cycles.
+     */
+    jit_call_func_imm32(block, hle_func_exec, func);
+
+    unsigned jmp_addr_slot = reg_slot(sh4, ctx, block, SH4_REG_PR,
+                                      WASHDC_JIT_SLOT_GEN);
+    unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    sh4_jit_hash_slot_known_fpscr(sh4, ctx, block, jmp_addr_slot, hash_slot);
+
+    res_drain_all_regs(sh4, ctx, block);
+    if (guest_prof_enabled)
+        jit_call_func(block, guest_prof_on_ret, jmp_addr_slot);
+    jit_jump(block, jmp_addr_slot, hash_slot);
+
+    free_slot(block, hash_slot);
+    free_slot(block, jmp_addr_slot);
+
+    block->dyn_cycles = &hle_func_cycles;
+    ctx->cycle_count = 0;
+    sh4_jit_set_blk_range(sh4, jit_blk, addr & BIT_RANGE(0, 28), n_bytes);
+    jit_blk->idle_loop = false;
+    block->idle_loop = false;
+    return true;
+}
+
+bool sh4_jit_idle_loop(struct Sh4 *sh4, addr32_t addr, unsigned n_bytes) {
+    if (!config_get_jit_idle_skip())
+        return false;
+
+    /*
+     * n_bytes includes the instruction after the last one, so the branch
+     * which ends the block is the second-to-last instruction.
+     */
+    unsigned n_insts = n_bytes / 2;
+    if (n_insts < 2 || n_insts > IDLE_MAX_INSTS + 1)
+        return false;
+
+    uint32_t read_first = 0, written = 0;
+    unsigned idx;
+    for (idx = 0; idx < n_insts - 1; idx++) {
+        addr32_t pc = addr + 2 * idx;
+        uint16_t inst = memory_map_read_16(sh4->mem.map, pc & BIT_RANGE(0, 28));
+        uint32_t rd, wr;
+        int32_t disp;
+        enum idle_inst_tp tp = idle_inst_decode(inst, &rd, &wr, &disp);
+
+        read_first |= rd & ~written;
+        written |= wr;
+
+        if (idx == n_insts - 2) {
+            if (tp != IDLE_INST_BRANCH && tp != IDLE_INST_DELAYED_BRANCH)
+                return false;
+            if (pc + 4 + disp != addr)
+                return false;
+            if (tp == IDLE_INST_DELAYED_BRANCH) {
+                uint16_t slot = memory_map_read_16(sh4->mem.map,
+                                                   (pc + 2) & BIT_RANGE(0, 28));
+                if (idle_inst_decode(slot, &rd, &wr, &disp) != IDLE_INST_OK)
+                    return false;
+                read_first |= rd & ~written;
+                written |= wr;
+            }
+        } else if (tp != IDLE_INST_OK) {
+            return false;
+        }
+    }
+
+    /*
+     * if the loop modifies any register that it reads before writing, then
+     * the next iteration won't be the same as this one.
+     */
+    return !(read_first & written);
+}
+
+#define PIPE_GPR(n) (1u << (n))
+#define PIPE_FPR(n) (1u << (16 + (n)))
+
+/*
+ * result latencies, in cycles after issue.  These are the single-precision
+ * figures; double-precision is treated the same.
+ */
+#define PIPE_LAT_LOAD 2
+#define PIPE_LAT_FPU 3
+#define PIPE_LAT_FIPR 4
+#define PIPE_LAT_FTRV 5
+#define PIPE_LAT_FSQRT 11
+#define PIPE_LAT_FDIV 12
+
+/*
+ * work out which registers inst reads and writes for the stall model.
+ * Writes with a latency of 1 are reported with *lat == 0 so that the
+ * register's stale latency gets cleared.  Registers which aren't tracked (the
+ * system registers, FPUL, T, etc) are ignored.
+ */
+static void
+pipe_inst_decode(uint16_t inst, uint32_t *rd, uint32_t *wr, unsigned *lat) {
+    unsigned rn = (inst >> 8) & 0xf;
+    unsigned rm = (inst >> 4) & 0xf;
+
+    *rd = 0;
+    *wr = 0;
+    *lat = 0;
+
+    switch (inst >> 12) {
+    case 0x0:
+        switch (inst & 0xf) {
+        case 0x2:
+        case 0xa:
+            // STC, STS
+            *wr = PIPE_GPR(rn);
+            break;
+        case 0x3:
+            // BSRF, BRAF, PREF, OCBI, etc
+            *rd = PIPE_GPR(rn);
+            break;
+        case 0x4:
+        case 0x5:
+        case 0x6:
+            // MOV.{B,W,L} Rm, @(R0, Rn)
+            *rd = PIPE_GPR(0) | PIPE_GPR(rm) | PIPE_GPR(rn);
+            break;
+        case 0x7:
+            // MUL.L
+            *rd = PIPE_GPR(rm) | PIPE_GPR(rn);
+            break;
+        case 0x9:
+            // MOVT
+            if (rm == 2)
+                *wr = PIPE_GPR(rn);
+            break;
+        case 0xc:
+        case 0xd:
+        case 0xe:
+            // MOV.{B,W,L} @(R0, Rm), Rn
+            *rd = PIPE_GPR(0) | PIPE_GPR(rm);
+            *wr = PIPE_GPR(rn);
+            *lat = PIPE_LAT_LOAD;
+            break;
+        }
+        break;
+    case 0x1:
+        // MOV.L Rm, @(disp, Rn)
+        *rd = PIPE_GPR(rm) | PIPE_GPR(rn);
+        break;
+    case 0x2:
+    case 0x3:
+        // stores, logic ops, comparisons and arithmetic between Rm and Rn
+        *rd = PIPE_GPR(rm) | PIPE_GPR(rn);
+        break;
+    case 0x4:
+        // shifts, JMP, JSR, LDC, LDS, etc
+        *rd = PIPE_GPR(rn);
+        break;
+    case 0x5:
+        // MOV.L @(disp, Rm), Rn
+        *rd = PIPE_GPR(rm);
+        *wr = PIPE_GPR(rn);
+        *lat = PIPE_LAT_LOAD;
+        break;
+    case 0x6:
+        *rd = PIPE_GPR(rm);
+        *wr = PIPE_GPR(rn);
+        if ((inst & 0xb) <= 2) {
+            // MOV.{B,W,L} @Rm, Rn and MOV.{B,W,L} @Rm+, Rn
+            *lat = PIPE_LAT_LOAD;
+        }
+        break;
+    case 0x7:
+        // ADD #imm, Rn
+        *rd = PIPE_GPR(rn);
+        break;
+    case 0x8:
+        switch (rn) {
+        case 0x0:
+        case 0x1:
+            // MOV.{B,W} R0, @(disp, Rn)
+            *rd = PIPE_GPR(0) | PIPE_GPR(rm);
+            break;
+        case 0x4:
+        case 0x5:
+            // MOV.{B,W} @(disp, Rm), R0
+            *rd = PIPE_GPR(rm);
+            *wr = PIPE_GPR(0);
+            *lat = PIPE_LAT_LOAD;
+            break;
+        case 0x8:
+            // CMP/EQ #imm, R0
+            *rd = PIPE_GPR(0);
+            break;
+        }
+        break;
+    case 0x9:
+    case 0xd:
+        // MOV.W @(disp, PC), Rn, MOV.L @(disp, PC), Rn
+        *wr = PIPE_GPR(rn);
+        *lat = PIPE_LAT_LOAD;
+        break;
+    case 0xc:
+        switch (rn) {
+        case 0x4:
+        case 0x5:
+        case 0x6:
+            // MOV.{B,W,L} @(disp, GBR), R0
+            *wr = PIPE_GPR(0);
+            *lat = PIPE_LAT_LOAD;
+            break;
+        case 0x7:
+            // MOVA
+            *wr = PIPE_GPR(0);
+            break;
+        case 0x0:
+        case 0x1:
+        case 0x2:
+            // MOV.{B,W,L} R0, @(disp, GBR)
+        case 0x8:
+        case 0x9:
+        case 0xa:
+        case 0xb:
+        case 0xc:
+        case 0xd:
+        case 0xe:
+        case 0xf:
+            // TST, AND, XOR and OR with R0 or @(R0, GBR)
+            *rd = PIPE_GPR(0);
+            break;
+        }
+        break;
+    case 0xe:
+        // MOV #imm, Rn
+        *wr = PIPE_GPR(rn);
+        break;
+    case 0xf:
+        switch (inst & 0xf) {
+        case 0x0:
+        case 0x1:
+        case 0x2:
+            // FADD, FSUB, FMUL
+            *rd = PIPE_FPR(rm) | PIPE_FPR(rn);
+            *wr = PIPE_FPR(rn);
+            *lat = PIPE_LAT_FPU;
+            break;
+        case 0x3:
+            // FDIV
+            *rd = PIPE_FPR(rm) | PIPE_FPR(rn);
+            *wr = PIPE_FPR(rn);
+            *lat = PIPE_LAT_FDIV;
+            break;
+        case 0x4:
+        case 0x5:
+            // FCMP/EQ, FCMP/GT
+            *rd = PIPE_FPR(rm) | PIPE_FPR(rn);
+            break;
+        case 0x6:
+            // FMOV @(R0, Rm), FRn
+            *rd = PIPE_GPR(0) | PIPE_GPR(rm);
+            *wr = PIPE_FPR(rn);
+            *lat = PIPE_LAT_LOAD;
+            break;
+        case 0x7:
+            // FMOV FRm, @(R0, Rn)
+            *rd = PIPE_FPR(rm) | PIPE_GPR(0) | PIPE_GPR(rn);
+            break;
+        case 0x8:
+        case 0x9:
+            // FMOV @Rm, FRn and FMOV @Rm+, FRn
+            *rd = PIPE_GPR(rm);
+            *wr = PIPE_FPR(rn);
+            *lat = PIPE_LAT_LOAD;
+            break;
+        case 0xa:
+        case 0xb:
+            // FMOV FRm, @Rn and FMOV FRm, @-Rn
+            *rd = PIPE_FPR(rm) | PIPE_GPR(rn);
+            break;
+        case 0xc:
+            // FMOV FRm, FRn
+            *rd = PIPE_FPR(rm);
+            *wr = PIPE_FPR(rn);
+            break;
+        case 0xd:
+            switch (rm) {
+            case 0x0:
+            case 0x8:
+            case 0x9:
+                // FSTS, FLDI0, FLDI1
+                *wr = PIPE_FPR(rn);
+                break;
+            case 0x1:
+            case 0x3:
+                // FLDS, FTRC
+                *rd = PIPE_FPR(rn);
+                break;
+            case 0x2:
+                // FLOAT
+                *wr = PIPE_FPR(rn);
+                *lat = PIPE_LAT_FPU;
+                break;
+            case 0x4:
+            case 0x5:
+                // FNEG, FABS
+                *rd = PIPE_FPR(rn);
+                *wr = PIPE_FPR(rn);
+                break;
+            case 0x6:
+                // FSQRT
+                *rd = PIPE_FPR(rn);
+                *wr = PIPE_FPR(rn);
+                *lat = PIPE_LAT_FSQRT;
+                break;
+            case 0xe:
+                // FIPR FVm, FVn
+                *rd = (0xfu << (16 + 4 * (rn & 3))) |
+                    (0xfu << (16 + 4 * ((rn >> 2) & 3)));
+                *wr = PIPE_FPR(4 * (rn >> 2) + 3);
+                *lat = PIPE_LAT_FIPR;
+                break;
+            case 0xf:
+                if ((rn & 3) == 1) {
+                    // FTRV XMTRX, FVn
+                    *rd = 0xfu << (16 + 4 * (rn >> 2));
+                    *wr = *rd;
+                    *lat = PIPE_LAT_FTRV;
+                }
+                break;
+            }
+            break;
+        case 0xe:
+            // FMAC FR0, FRm, FRn
+            *rd = PIPE_FPR(0) | PIPE_FPR(rm) | PIPE_FPR(rn);
+            *wr = PIPE_FPR(rn);
+            *lat = PIPE_LAT_FPU;
+            break;
+        }
+        break;
+    }
+}
+
+unsigned sh4_jit_pipe_cycles(unsigned *reg_ready, unsigned now,
+                             cpu_inst_param inst, unsigned issue_cycles) {
+    uint32_t rd, wr;
+    unsigned lat;
+    pipe_inst_decode(inst, &rd, &wr, &lat);
+
+    // the instruction can't issue until all of its inputs are ready
+    unsigned issue_at = now;
+    unsigned reg_no;
+    for (reg_no = 0; reg_no < SH4_JIT_PIPE_N_REGS; reg_no++) {
+        if ((rd & (1u << reg_no)) && reg_ready[reg_no] > issue_at)
+            issue_at = reg_ready[reg_no];
+    }
+
+    for (reg_no = 0; reg_no < SH4_JIT_PIPE_N_REGS; reg_no++) {
+        if (wr & (1u << reg_no))
+            reg_ready[reg_no] = issue_at + lat;
+    }
+
+    return (issue_at - now) + issue_cycles;
+}
+
+// cycle count for the next instruction in the block
+static unsigned
+sh4_jit_count_cycles(struct sh4_jit_compile_ctx *ctx,
+                     struct InstOpcode const *inst_op, cpu_inst_param inst) {
+    unsigned n_cycles = sh4_count_inst_cycles(inst_op, &ctx->last_inst_type);
+    if (config_get_jit_stall_model()) {
+        n_cycles = sh4_jit_pipe_cycles(ctx->reg_ready, ctx->cycle_count,
+                                       inst, n_cycles);
+    }
+    return n_cycles;
 }
 
 static void
@@ -295,8 +995,7 @@ sh4_jit_delay_slot(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
     ctx->in_delay_slot = false;
     unsigned old_cycle_count = ctx->cycle_count;
-    ctx->cycle_count += sh4_count_inst_cycles(inst_op,
-                                              &ctx->last_inst_type);
+    ctx->cycle_count += sh4_jit_count_cycles(ctx, inst_op, inst);
     if (old_cycle_count > ctx->cycle_count)
         LOG_ERROR("*** JIT DETECTED CYCLE COUNT OVERFLOW ***\n");
 }
@@ -324,25 +1023,539 @@ sh4_jit_compile_inst(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     struct InstOpcode const *inst_op = sh4_decode_inst(inst);
 
     unsigned old_cycle_count = ctx->cycle_count;
-    ctx->cycle_count += sh4_count_inst_cycles(inst_op,
-                                              &ctx->last_inst_type);
+    ctx->cycle_count += sh4_jit_count_cycles(ctx, inst_op, inst);
     if (old_cycle_count > ctx->cycle_count)
         LOG_ERROR("*** JIT DETECTED CYCLE COUNT OVERFLOW ***\n");
 
     return inst_op->disas(sh4, ctx, block, pc, inst_op, inst);
 }
 
+/*
+ * The DIV0U/DIV0S + DIV1 sequences that compilers emit for integer division.
+ * It gets matched at compile time and then packed into the imm32 of a single
+ * JIT_OP_CALL_FUNC_IMM32 which runs the whole thing on the host.
+ *
+ * bits 0-7 - the Rn and Rm fields of the DIV1 instruction
+ * bits 8-11 - quotient register for the ROTCL instructions
+ * bits 12-17 - number of DIV1 steps
+ * bit 18 - each DIV1 is preceded by a ROTCL
+ * bit 19 - there is one more ROTCL after the last DIV1
+ * bit 20 - the sequence starts with DIV0S instead of DIV0U
+ * bits 24-31 - the Rn and Rm fields of the DIV0S instruction
+ */
+#define SH4_DIV_IDIOM_DIV1_SHIFT 0
+#define SH4_DIV_IDIOM_ROTCL_SHIFT 8
+#define SH4_DIV_IDIOM_STEPS_SHIFT 12
+#define SH4_DIV_IDIOM_ROTCL_EACH (1 << 18)
+#define SH4_DIV_IDIOM_ROTCL_LAST (1 << 19)
+#define SH4_DIV_IDIOM_DIV0S (1 << 20)
+#define SH4_DIV_IDIOM_DIV0S_SHIFT 24
+
+// shortest run of DIV1 steps that's worth fusing
+#define SH4_DIV_IDIOM_MIN_STEPS 8
+#define SH4_DIV_IDIOM_MAX_STEPS 32
+
+#define SH4_INST_IS_DIV0U(inst) ((inst) == 0x0019)
+#define SH4_INST_IS_DIV0S(inst) (((inst) & 0xf00f) == 0x2007)
+#define SH4_INST_IS_DIV1(inst) (((inst) & 0xf00f) == 0x3004)
+#define SH4_INST_IS_ROTCL(inst) (((inst) & 0xf0ff) == 0x4024)
+
+static void sh4_jit_div_exec(void *cpu, uint32_t idiom) {
+    Sh4 *sh4 = (Sh4*)cpu;
+    cpu_inst_param div1 = 0x3004 |
+        (((idiom >> SH4_DIV_IDIOM_DIV1_SHIFT) & 0xff) << 4);
+    cpu_inst_param rotcl = 0x4024 |
+        (((idiom >> SH4_DIV_IDIOM_ROTCL_SHIFT) & 0xf) << 8);
+    unsigned n_steps = (idiom >> SH4_DIV_IDIOM_STEPS_SHIFT) & 0x3f;
+    unsigned reg_rem = (div1 >> 8) & 0xf;
+    unsigned reg_div = (div1 >> 4) & 0xf;
+    unsigned reg_quot = (rotcl >> 8) & 0xf;
+
+    if (idiom & SH4_DIV_IDIOM_DIV0S) {
+        sh4_inst_binary_div0s_gen_gen(sh4, 0x2007 |
+                                      ((idiom >> SH4_DIV_IDIOM_DIV0S_SHIFT) << 4));
+    } else if (n_steps == 32 && (idiom & SH4_DIV_IDIOM_ROTCL_EACH) &&
+               (idiom & SH4_DIV_IDIOM_ROTCL_LAST) &&
+               reg_rem != reg_div && reg_rem != reg_quot &&
+               reg_quot != reg_div) {
+        /*
+         * unsigned 64/32 division of Rn:Rq by Rm.  When Rn < Rm the quotient
+         * fits in 32 bits and the final register and flag state can be worked
+         * out directly from the host's division.
+         */
+        reg32_t *remp = sh4_gen_reg(sh4, reg_rem);
+        reg32_t *quotp = sh4_gen_reg(sh4, reg_quot);
+        reg32_t divisor = *sh4_gen_reg(sh4, reg_div);
+
+        if (*remp < divisor) {
+            uint64_t dividend = (((uint64_t)*remp) << 32) | *quotp;
+            reg32_t quot = dividend / divisor;
+            reg32_t rem = dividend % divisor;
+            bool q_flag = !(quot & 1);
+
+            *quotp = quot;
+            *remp = q_flag ? rem - divisor : rem;
+            sh4->reg[SH4_REG_SR] =
+                (sh4->reg[SH4_REG_SR] &
+                 ~(SH4_SR_M_MASK | SH4_SR_Q_MASK | SH4_SR_FLAG_T_MASK)) |
+                (q_flag ? SH4_SR_Q_MASK : 0);
+            return;
+        }
+        sh4_inst_noarg_div0u(sh4, 0x0019);
+    } else {
+        sh4_inst_noarg_div0u(sh4, 0x0019);
+    }
+
+    unsigned step;
+    for (step = 0; step < n_steps; step++) {
+        if (idiom & SH4_DIV_IDIOM_ROTCL_EACH)
+            sh4_inst_unary_rotcl_gen(sh4, rotcl);
+        sh4_inst_binary_div1_gen_gen(sh4, div1);
+    }
+    if (idiom & SH4_DIV_IDIOM_ROTCL_LAST)
+        sh4_inst_unary_rotcl_gen(sh4, rotcl);
+}
+
+// whether the sequence at pc can be compiled as a single operation
+static bool sh4_jit_can_fuse(struct Sh4 *sh4, addr32_t pc) {
+#ifdef JIT_PROFILE
+    // the profiler wants to see every instruction
+    return false;
+#else
+#ifdef ENABLE_DEBUGGER
+    // there might be a breakpoint in the middle of the sequence
+    if (config_get_dbg_enable())
+        return false;
+#endif
+
+    return !sh4_ocache_in_ram_area(pc);
+#endif
+}
+
+unsigned
+sh4_jit_div_idiom(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                  struct il_code_block *block, addr32_t pc) {
+    if (!sh4_jit_can_fuse(sh4, pc))
+        return 0;
+
+    struct memory_map *map = sh4->mem.map;
+    cpu_inst_param div0 = memory_map_read_16(map, pc & BIT_RANGE(0, 28));
+    if (!SH4_INST_IS_DIV0U(div0) && !SH4_INST_IS_DIV0S(div0))
+        return 0;
+
+    addr32_t addr = pc + 2;
+    cpu_inst_param inst = memory_map_read_16(map, addr & BIT_RANGE(0, 28));
+    cpu_inst_param rotcl = 0, div1 = 0;
+    if (SH4_INST_IS_ROTCL(inst)) {
+        rotcl = inst;
+        addr += 2;
+        inst = memory_map_read_16(map, addr & BIT_RANGE(0, 28));
+    }
+    if (!SH4_INST_IS_DIV1(inst))
+        return 0;
+    div1 = inst;
+
+    unsigned n_steps = 0;
+    bool rotcl_last = false;
+    for (;;) {
+        // addr points to the DIV1 of the current step
+        n_steps++;
+        addr += 2;
+        if (n_steps == SH4_DIV_IDIOM_MAX_STEPS)
+            break;
+        inst = memory_map_read_16(map, addr & BIT_RANGE(0, 28));
+        if (rotcl) {
+            if (inst != rotcl)
+                break;
+            inst = memory_map_read_16(map, (addr + 2) & BIT_RANGE(0, 28));
+            if (inst != div1) {
+                rotcl_last = true;
+                addr += 2;
+                break;
+            }
+            addr += 2;
+        } else if (inst != div1) {
+            break;
+        }
+    }
+
+    if (n_steps < SH4_DIV_IDIOM_MIN_STEPS)
+        return 0;
+
+    if (rotcl && !rotcl_last &&
+        memory_map_read_16(map, addr & BIT_RANGE(0, 28)) == rotcl) {
+        rotcl_last = true;
+        addr += 2;
+    }
+
+    uint32_t idiom = (((div1 >> 4) & 0xff) << SH4_DIV_IDIOM_DIV1_SHIFT) |
+        (n_steps << SH4_DIV_IDIOM_STEPS_SHIFT);
+    if (rotcl) {
+        idiom |= ((rotcl >> 8) & 0xf) << SH4_DIV_IDIOM_ROTCL_SHIFT;
+        idiom |= SH4_DIV_IDIOM_ROTCL_EACH;
+        if (rotcl_last)
+            idiom |= SH4_DIV_IDIOM_ROTCL_LAST;
+    }
+    if (SH4_INST_IS_DIV0S(div0)) {
+        idiom |= SH4_DIV_IDIOM_DIV0S;
+        idiom |= ((div0 >> 4) & 0xff) << SH4_DIV_IDIOM_DIV0S_SHIFT;
+    }
+
+    // every instruction in the sequence still costs its cycles
+    addr32_t cur;
+    for (cur = pc; cur != addr; cur += 2) {
+        inst = memory_map_read_16(map, cur & BIT_RANGE(0, 28));
+        ctx->cycle_count += sh4_jit_count_cycles(ctx, sh4_decode_inst(inst),
+                                                 inst);
+    }
+
+    // the helper only touches SR and the registers named in the sequence
+    unsigned reg_rem = SH4_REG_R0 + ((div1 >> 8) & 0xf);
+    unsigned reg_div = SH4_REG_R0 + ((div1 >> 4) & 0xf);
+    res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+    res_drain_reg(sh4, ctx, block, reg_rem);
+    res_drain_reg(sh4, ctx, block, reg_div);
+    if (rotcl)
+        res_drain_reg(sh4, ctx, block, SH4_REG_R0 + ((rotcl >> 8) & 0xf));
+    if (SH4_INST_IS_DIV0S(div0)) {
+        res_drain_reg(sh4, ctx, block, SH4_REG_R0 + ((div0 >> 8) & 0xf));
+        res_drain_reg(sh4, ctx, block, SH4_REG_R0 + ((div0 >> 4) & 0xf));
+    }
+
+    jit_call_func_imm32(block, sh4_jit_div_exec, idiom);
+
+    res_invalidate_reg(block, SH4_REG_SR);
+    res_invalidate_reg(block, reg_rem);
+    if (rotcl)
+        res_invalidate_reg(block, SH4_REG_R0 + ((rotcl >> 8) & 0xf));
+
+    return addr - pc;
+}
+
+/*
+ * straight-line runs of 32-bit loads or stores through the same base register,
+ * like the ones compilers emit for pushing and popping callee-saved registers
+ * and for unrolled memcpy and memset.  Each run becomes one
+ * JIT_OP_READ_32_BLOCK or JIT_OP_WRITE_32_BLOCK so the backend only has to
+ * check once whether the whole thing is in main RAM.
+ */
+enum sh4_mem_run_tp {
+    SH4_MEM_RUN_NONE,
+
+    // MOV.L @Rm+, Rn and LDS.L @Rm+, PR
+    SH4_MEM_RUN_READ_INC,
+
+    // MOV.L Rm, @-Rn and STS.L PR, @-Rn
+    SH4_MEM_RUN_WRITE_DEC,
+
+    // MOV.L @(disp, Rm), Rn and MOV.L @Rm, Rn
+    SH4_MEM_RUN_READ_DISP,
+
+    // MOV.L Rm, @(disp, Rn), MOV.L Rm, @Rn and MOVCA.L R0, @Rn
+    SH4_MEM_RUN_WRITE_DISP
+};
+
+// shortest run that's worth fusing
+#define SH4_MEM_RUN_MIN_WORDS 2
+
+/*
+ * decode inst as one word of a run.  base_reg is the register holding the
+ * address, data_reg is the register being loaded or stored and disp is the
+ * displacement for the *_DISP types.
+ */
+static enum sh4_mem_run_tp
+sh4_mem_run_decode(cpu_inst_param inst, unsigned *base_reg,
+                   unsigned *data_reg, int *disp) {
+    unsigned reg_n = ((inst >> 8) & 0xf) + SH4_REG_R0;
+    unsigned reg_m = ((inst >> 4) & 0xf) + SH4_REG_R0;
+
+    *disp = 0;
+    if ((inst & 0xf00f) == 0x6006) {
+        *base_reg = reg_m;
+        *data_reg = reg_n;
+        return SH4_MEM_RUN_READ_INC;
+    } else if ((inst & 0xf0ff) == 0x4026) {
+        *base_reg = reg_n;
+        *data_reg = SH4_REG_PR;
+        return SH4_MEM_RUN_READ_INC;
+    } else if ((inst & 0xf00f) == 0x2006) {
+        *base_reg = reg_n;
+        *data_reg = reg_m;
+        return SH4_MEM_RUN_WRITE_DEC;
+    } else if ((inst & 0xf0ff) == 0x4022) {
+        *base_reg = reg_n;
+        *data_reg = SH4_REG_PR;
+        return SH4_MEM_RUN_WRITE_DEC;
+    } else if ((inst & 0xf000) == 0x5000 || (inst & 0xf00f) == 0x6002) {
+        if ((inst & 0xf000) == 0x5000)
+            *disp = (inst & 0xf) << 2;
+        *base_reg = reg_m;
+        *data_reg = reg_n;
+        return SH4_MEM_RUN_READ_DISP;
+    } else if ((inst & 0xf000) == 0x1000 || (inst & 0xf00f) == 0x2002) {
+        if ((inst & 0xf000) == 0x1000)
+            *disp = (inst & 0xf) << 2;
+        *base_reg = reg_n;
+        *data_reg = reg_m;
+        return SH4_MEM_RUN_WRITE_DISP;
+    } else if ((inst & 0xf0ff) == 0x00c3) {
+        *base_reg = reg_n;
+        *data_reg = SH4_REG_R0;
+        return SH4_MEM_RUN_WRITE_DISP;
+    }
+    return SH4_MEM_RUN_NONE;
+}
+
+unsigned
+sh4_jit_mem_run(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                struct il_code_block *block, addr32_t pc) {
+    if (!sh4_jit_can_fuse(sh4, pc))
+        return 0;
+
+    struct memory_map *map = sh4->mem.map;
+    unsigned base_reg, data_reg[JIT_BLOCK_MAX_WORDS];
+    int disp;
+
+    enum sh4_mem_run_tp tp =
+        sh4_mem_run_decode(memory_map_read_16(map, pc & BIT_RANGE(0, 28)),
+                           &base_reg, data_reg, &disp);
+    if (tp == SH4_MEM_RUN_NONE)
+        return 0;
+
+    bool is_read = tp == SH4_MEM_RUN_READ_INC || tp == SH4_MEM_RUN_READ_DISP;
+    bool is_disp = tp == SH4_MEM_RUN_READ_DISP || tp == SH4_MEM_RUN_WRITE_DISP;
+    int first, stride;
+    if (tp == SH4_MEM_RUN_WRITE_DEC) {
+        first = -4;
+        stride = -4;
+    } else {
+        first = disp;
+        stride = 4;
+    }
+
+    /*
+     * loads can't overwrite the base register or each other, and pre-decrement
+     * stores can't store the base register since the stored value would depend
+     * on where it is in the run.
+     */
+    if (data_reg[0] == base_reg && tp != SH4_MEM_RUN_WRITE_DISP)
+        return 0;
+
+    unsigned n_words;
+    for (n_words = 1; n_words < JIT_BLOCK_MAX_WORDS; n_words++) {
+        addr32_t addr = pc + 2 * n_words;
+        unsigned next_base, next_data;
+        int next_disp;
+        if (sh4_mem_run_decode(memory_map_read_16(map, addr & BIT_RANGE(0, 28)),
+                               &next_base, &next_data, &next_disp) != tp ||
+            next_base != base_reg)
+            break;
+        if (next_data == base_reg && tp != SH4_MEM_RUN_WRITE_DISP)
+            break;
+
+        if (is_disp) {
+            // displacements have to go up or down by one word at a time
+            if (n_words == 1) {
+                if (next_disp == disp + 4)
+                    stride = 4;
+                else if (next_disp == disp - 4)
+                    stride = -4;
+                else
+                    break;
+            } else if (next_disp != disp + (int)n_words * stride) {
+                break;
+            }
+        }
+
+        if (is_read) {
+            unsigned idx;
+            for (idx = 0; idx < n_words; idx++)
+                if (data_reg[idx] == next_data)
+                    break;
+            if (idx < n_words)
+                break;
+        }
+
+        data_reg[n_words] = next_data;
+    }
+
+    if (n_words < SH4_MEM_RUN_MIN_WORDS)
+        return 0;
+
+    // every instruction in the run still costs its cycles
+    unsigned idx;
+    for (idx = 0; idx < n_words; idx++) {
+        cpu_inst_param inst =
+            memory_map_read_16(map, (pc + 2 * idx) & BIT_RANGE(0, 28));
+        ctx->cycle_count += sh4_jit_count_cycles(ctx, sh4_decode_inst(inst),
+                                                 inst);
+    }
+
+    unsigned base_slot = reg_slot(sh4, ctx, block, base_reg,
+                                  WASHDC_JIT_SLOT_GEN);
+    unsigned data_slot[JIT_BLOCK_MAX_WORDS];
+    for (idx = 0; idx < n_words; idx++) {
+        if (is_read) {
+            data_slot[idx] = reg_slot_noload(sh4, block, data_reg[idx],
+                                             WASHDC_JIT_SLOT_GEN);
+        } else {
+            data_slot[idx] = reg_slot(sh4, ctx, block, data_reg[idx],
+                                      WASHDC_JIT_SLOT_GEN);
+        }
+    }
+
+    if (is_read) {
+        jit_read_32_block(block, map, base_slot, first, stride, n_words,
+                          data_slot);
+        for (idx = 0; idx < n_words; idx++)
+            reg_map[data_reg[idx]].stat = REG_STATUS_SLOT;
+    } else {
+        jit_write_32_block(block, map, base_slot, first, stride, n_words,
+                           data_slot);
+    }
+
+    if (!is_disp) {
+        jit_add_const32(block, base_slot, stride * (int)n_words);
+        reg_map[base_reg].stat = REG_STATUS_SLOT;
+    }
+
+    return 2 * n_words;
+}
+
+void
+sh4_jit_split_block(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                    struct il_code_block *block, addr32_t pc) {
+    unsigned addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, addr_slot, pc);
+
+    unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    if (ctx->dirty_fpscr) {
+        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                       WASHDC_JIT_SLOT_GEN);
+        sh4_jit_hash_slot(sh4, block, addr_slot, hash_slot, fpscr_slot);
+        free_slot(block, fpscr_slot);
+    } else {
+        sh4_jit_hash_slot_known_fpscr(sh4, ctx, block, addr_slot, hash_slot);
+    }
+
+    res_drain_all_regs(sh4, ctx, block);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc };
+        sh4_jit_jump_static(sh4, ctx, block, addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
+
+    free_slot(block, hash_slot);
+    free_slot(block, addr_slot);
+}
+
+static_assert(SH4_REG_FPSCR == SH4_REG_XF15 + 1 &&
+              SH4_REG_FPUL == SH4_REG_FPSCR + 1,
+              "incorrect FPU register layout");
+static_assert(SH4_REG_MACL == SH4_REG_MACH + 1,
+              "incorrect MAC register layout");
+
+// sh4 register indices covered by one of the SH4_FB_* register classes
+static void fallback_reg_range(unsigned cls, cpu_inst_param inst,
+                               unsigned *first, unsigned *count) {
+    *count = 1;
+    switch (cls) {
+    case SH4_FB_RN:
+        *first = SH4_REG_R0 + ((inst >> 8) & 0xf);
+        break;
+    case SH4_FB_RM:
+        *first = SH4_REG_R0 + ((inst >> 4) & 0xf);
+        break;
+    case SH4_FB_R0:
+        *first = SH4_REG_R0;
+        break;
+    case SH4_FB_FRN:
+        *first = SH4_REG_FR0 + ((inst >> 8) & 0xf);
+        break;
+    case SH4_FB_BANK:
+        *first = SH4_REG_R0_BANK;
+        *count = 8;
+        break;
+    case SH4_FB_FPU:
+        *first = SH4_REG_FR0;
+        *count = SH4_REG_FPUL - SH4_REG_FR0 + 1;
+        break;
+    case SH4_FB_SR:
+        *first = SH4_REG_SR;
+        break;
+    case SH4_FB_GBR:
+        *first = SH4_REG_GBR;
+        break;
+    case SH4_FB_VBR:
+        *first = SH4_REG_VBR;
+        break;
+    case SH4_FB_SSR:
+        *first = SH4_REG_SSR;
+        break;
+    case SH4_FB_SPC:
+        *first = SH4_REG_SPC;
+        break;
+    case SH4_FB_SGR:
+        *first = SH4_REG_SGR;
+        break;
+    case SH4_FB_DBR:
+        *first = SH4_REG_DBR;
+        break;
+    case SH4_FB_MAC:
+        *first = SH4_REG_MACH;
+        *count = 2;
+        break;
+    case SH4_FB_PR:
+        *first = SH4_REG_PR;
+        break;
+    case SH4_FB_FPUL:
+        *first = SH4_REG_FPUL;
+        break;
+    case SH4_FB_FPSCR:
+        *first = SH4_REG_FPSCR;
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
 bool
 sh4_jit_fallback(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                  struct il_code_block *block, unsigned pc,
                  struct InstOpcode const *op, cpu_inst_param inst) {
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
-    il_inst.immed.fallback.fallback_fn = op->func;
+    il_inst.immed.fallback.fallback_fn = sh4_decode_inst_func(inst);
     il_inst.immed.fallback.inst = inst;
 
     il_code_block_push_inst(block, &il_inst);
@@ -370,6 +1583,8 @@ bool sh4_jit_rts(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
+    if (guest_prof_enabled)
+        jit_call_func(block, guest_prof_on_ret, jmp_addr_slot);
     jit_jump(block, jmp_addr_slot, hash_slot);
 
     free_slot(block, hash_slot);
@@ -478,6 +1693,8 @@ bool sh4_jit_bsrf_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
+    if (guest_prof_enabled)
+        jit_call_func(block, guest_prof_on_call, addr_slot_no);
     jit_jump(block, addr_slot_no, hash_slot);
 
     free_slot(block, hash_slot);
@@ -486,14 +1703,49 @@ bool sh4_jit_bsrf_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return false;
 }
 
+/*
+ * superblocks: instead of ending the block on a forward BT/BF, emit a side-exit
+ * for the taken path and keep compiling along the fall-through path.  Backward
+ * branches are assumed to be loops and still end the block.  Returns false if
+ * the branch needs to be compiled the normal way.
+ */
+static bool
+sh4_jit_side_exit(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  int jump_offs, unsigned t_flag) {
+    if (!config_get_jit_superblocks() || ctx->dirty_fpscr || jump_offs <= 0 ||
+        ctx->n_side_exits >= SH4_JIT_MAX_SIDE_EXITS)
+        return false;
+
+    addr32_t jmp_addr = pc + jump_offs;
+
+    // test T directly if it's still in its own slot
+    int t_slot = res_merge_t(sh4, ctx, block);
+    unsigned flag_slot = t_slot >= 0 ? (unsigned)t_slot :
+        reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+
+    // the side-exit leaves the block, so everything has to be in the reg array
+    res_drain_all_regs(sh4, ctx, block);
+    jit_exit_cond(block, flag_slot, t_flag, jmp_addr,
+                  sh4_jit_hash(sh4, jmp_addr, ctx->pr_bit, ctx->sz_bit),
+                  ctx->cycle_count * SH4_CLOCK_SCALE);
+    ctx->n_side_exits++;
+
+    if (t_slot >= 0)
+        free_slot(block, t_slot);
+
+    return true;
+}
+
 bool sh4_jit_bf(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                 struct il_code_block *block, unsigned pc,
                 struct InstOpcode const *op, cpu_inst_param inst) {
     int jump_offs = (int)((int8_t)(inst & 0x00ff)) * 2 + 4;
 
-    unsigned flag_slot = reg_slot(sh4, ctx, block, SH4_REG_SR,
-                                  WASHDC_JIT_SLOT_GEN);
-    res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
+    if (sh4_jit_side_exit(sh4, ctx, block, pc, jump_offs, 0))
+        return true;
+
+    unsigned flag_slot = res_claim_t(sh4, ctx, block);
 
     unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, jmp_addr_slot, pc + jump_offs);
@@ -510,7 +1762,13 @@ bool sh4_jit_bf(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, jmp_addr_slot, hash_slot);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, jmp_addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc + jump_offs, pc + 2 };
+        sh4_jit_jump_static(sh4, ctx, block, jmp_addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
 
     free_slot(block, hash_slot);
     free_slot(block, jmp_addr_slot);
@@ -524,9 +1782,10 @@ bool sh4_jit_bt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                 struct InstOpcode const *op, cpu_inst_param inst) {
     int jump_offs = (int)((int8_t)(inst & 0x00ff)) * 2 + 4;
 
-    unsigned flag_slot =
-        reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
-    res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
+    if (sh4_jit_side_exit(sh4, ctx, block, pc, jump_offs, 1))
+        return true;
+
+    unsigned flag_slot = res_claim_t(sh4, ctx, block);
 
     unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, jmp_addr_slot, pc + jump_offs);
@@ -543,7 +1802,13 @@ bool sh4_jit_bt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, jmp_addr_slot, hash_slot);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, jmp_addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc + jump_offs, pc + 2 };
+        sh4_jit_jump_static(sh4, ctx, block, jmp_addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
 
     free_slot(block, hash_slot);
     free_slot(block, jmp_addr_slot);
@@ -557,9 +1822,7 @@ bool sh4_jit_bfs(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                  struct InstOpcode const *op, cpu_inst_param inst) {
     int jump_offs = (int)((int8_t)(inst & 0x00ff)) * 2 + 4;
 
-    unsigned flag_slot = reg_slot(sh4, ctx, block, SH4_REG_SR,
-                                  WASHDC_JIT_SLOT_GEN);
-    res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
+    unsigned flag_slot = res_claim_t(sh4, ctx, block);
 
     sh4_jit_delay_slot(sh4, ctx, block, pc + 2);
 
@@ -578,7 +1841,13 @@ bool sh4_jit_bfs(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, jmp_addr_slot, hash_slot);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, jmp_addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc + jump_offs, pc + 4 };
+        sh4_jit_jump_static(sh4, ctx, block, jmp_addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
 
     free_slot(block, hash_slot);
     free_slot(block, jmp_addr_slot);
@@ -592,9 +1861,7 @@ bool sh4_jit_bts(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                  struct InstOpcode const *op, cpu_inst_param inst) {
     int jump_offs = (int)((int8_t)(inst & 0x00ff)) * 2 + 4;
 
-    unsigned flag_slot = reg_slot(sh4, ctx, block, SH4_REG_SR,
-                                  WASHDC_JIT_SLOT_GEN);
-    res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
+    unsigned flag_slot = res_claim_t(sh4, ctx, block);
 
     sh4_jit_delay_slot(sh4, ctx, block, pc + 2);
 
@@ -613,7 +1880,13 @@ bool sh4_jit_bts(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, jmp_addr_slot, hash_slot);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, jmp_addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc + jump_offs, pc + 4 };
+        sh4_jit_jump_static(sh4, ctx, block, jmp_addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
 
     free_slot(block, hash_slot);
     free_slot(block, jmp_addr_slot);
@@ -646,7 +1919,15 @@ bool sh4_jit_bra(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, addr_slot, hash_slot);
+    if (guest_prof_enabled)
+        jit_call_func_imm32(block, guest_prof_on_call, pc + disp);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc + disp };
+        sh4_jit_jump_static(sh4, ctx, block, addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
 
     free_slot(block, hash_slot);
     free_slot(block, addr_slot);
@@ -682,7 +1963,13 @@ bool sh4_jit_bsr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, addr_slot, hash_slot);
+    if (ctx->dirty_fpscr) {
+        jit_jump(block, addr_slot, hash_slot);
+    } else {
+        uint32_t const targets[] = { pc + disp };
+        sh4_jit_jump_static(sh4, ctx, block, addr_slot, hash_slot,
+                            sizeof(targets) / sizeof(targets[0]), targets);
+    }
 
     free_slot(block, hash_slot);
     free_slot(block, addr_slot);
@@ -746,6 +2033,8 @@ bool sh4_jit_jsr_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     res_drain_all_regs(sh4, ctx, block);
+    if (guest_prof_enabled)
+        jit_call_func(block, guest_prof_on_call, addr_slot_no);
     jit_jump(block, addr_slot_no, hash_slot);
 
     free_slot(block, hash_slot);
@@ -1007,19 +2296,13 @@ bool sh4_jit_tst_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
 
     res_disassociate_reg(sh4, ctx, block, reg_dst);
     jit_and(block, slot_src, slot_dst);
 
     jit_slot_to_bool_inv(block, slot_dst);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_or(block, slot_dst, slot_sr);
-
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
-
-    free_slot(block, slot_dst);
+    res_set_t(block, slot_dst);
 
     return true;
 }
@@ -1030,19 +2313,13 @@ bool sh4_jit_tst_imm8_r0(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                          struct il_code_block *block, unsigned pc,
                          struct InstOpcode const *op, cpu_inst_param inst) {
     unsigned slot_r0 = reg_slot(sh4, ctx, block, SH4_REG_R0, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
 
     res_disassociate_reg(sh4, ctx, block, SH4_REG_R0);
     jit_and_const32(block, slot_r0, inst & 0xff);
 
     jit_slot_to_bool_inv(block, slot_r0);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_or(block, slot_r0, slot_sr);
-
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
-
-    free_slot(block, slot_r0);
+    res_set_t(block, slot_r0);
 
     return true;
 }
@@ -1180,6 +2457,26 @@ bool sh4_jit_movl_rm_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+/*
+ * MOVCA.L R0, @Rn
+ * 0000nnnn11000011
+ *
+ * The operand cache isn't emulated, so this is just a 32-bit store.
+ */
+bool sh4_jit_movcal_r0_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_dst = ((inst >> 8) & 0xf) + SH4_REG_R0;
+
+    unsigned slot_src = reg_slot(sh4, ctx, block, SH4_REG_R0,
+                                 WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+
+    jit_write_32_slot(block, sh4->mem.map, slot_src, slot_dst);
+
+    return true;
+}
+
 // MOV.L @(disp, Rm), Rn
 // 0101nnnnmmmmdddd
 bool
@@ -1461,16 +2758,11 @@ bool sh4_jit_shar_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
     unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
     unsigned tmp_cpy = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
 
-    // set the T-bit in SR from the shift-out.a
+    // set the T-bit from the shift-out
     jit_mov(block, slot_no, tmp_cpy);
     jit_and_const32(block, tmp_cpy, 1);
-    jit_and_const32(block, sr_slot, ~1);
-    jit_or(block, tmp_cpy, sr_slot);
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
-
-    free_slot(block, tmp_cpy);
+    res_set_t(block, tmp_cpy);
 
     jit_shar(block, slot_no, 1);
 
@@ -1487,16 +2779,11 @@ bool sh4_jit_shlr_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
     unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
     unsigned tmp_cpy = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
 
-    // set the T-bit in SR from the shift-out.a
+    // set the T-bit from the shift-out
     jit_mov(block, slot_no, tmp_cpy);
     jit_and_const32(block, tmp_cpy, 1);
-    jit_and_const32(block, sr_slot, ~1);
-    jit_or(block, tmp_cpy, sr_slot);
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
-
-    free_slot(block, tmp_cpy);
+    res_set_t(block, tmp_cpy);
 
     jit_shlr(block, slot_no, 1);
 
@@ -1513,17 +2800,12 @@ bool sh4_jit_shll_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
     unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
     unsigned tmp_cpy = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
 
-    // set the T-bit in SR from the shift-out.
+    // set the T-bit from the shift-out
     jit_mov(block, slot_no, tmp_cpy);
     jit_and_const32(block, tmp_cpy, 1<<31);
     jit_shlr(block, tmp_cpy, 31);
-    jit_and_const32(block, sr_slot, ~1);
-    jit_or(block, tmp_cpy, sr_slot);
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
-
-    free_slot(block, tmp_cpy);
+    res_set_t(block, tmp_cpy);
 
     jit_shll(block, slot_no, 1);
 
@@ -1642,12 +2924,12 @@ bool sh4_jit_cmphi_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_gt_unsigned(block, slot_dst, slot_src, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_gt_unsigned(block, slot_dst, slot_src, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1662,12 +2944,12 @@ bool sh4_jit_cmpgt_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_gt_signed(block, slot_dst, slot_src, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_gt_signed(block, slot_dst, slot_src, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1682,12 +2964,12 @@ bool sh4_jit_cmpeq_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_eq(block, slot_dst, slot_src, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_eq(block, slot_dst, slot_src, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1702,12 +2984,12 @@ bool sh4_jit_cmphs_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_ge_unsigned(block, slot_dst, slot_src, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_ge_unsigned(block, slot_dst, slot_src, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1766,6 +3048,112 @@ bool sh4_jit_sts_macl_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+static void
+emit_dmul(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+          struct il_code_block *block, cpu_inst_param inst, bool sign) {
+    unsigned reg_rhs = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_lhs = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_lhs = reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = reg_slot(sh4, ctx, block, reg_rhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_mach = reg_slot_noload(sh4, block, SH4_REG_MACH,
+                                         WASHDC_JIT_SLOT_GEN);
+    unsigned slot_macl = reg_slot_noload(sh4, block, SH4_REG_MACL,
+                                         WASHDC_JIT_SLOT_GEN);
+
+    if (sign)
+        jit_mul_s32_wide(block, slot_lhs, slot_rhs, slot_mach, slot_macl);
+    else
+        jit_mul_u32_wide(block, slot_lhs, slot_rhs, slot_mach, slot_macl);
+}
+
+// DMULS.L Rm, Rn
+// 0011nnnnmmmm1101
+bool sh4_jit_dmulsl_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    emit_dmul(sh4, ctx, block, inst, true);
+    return true;
+}
+
+// DMULU.L Rm, Rn
+// 0011nnnnmmmm0101
+bool sh4_jit_dmulul_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    emit_dmul(sh4, ctx, block, inst, false);
+    return true;
+}
+
+/*
+ * MAC.L and MAC.W.  Both operands get read before either register is
+ * incremented, so when Rm and Rn are the same register the same address gets
+ * read twice and the register is incremented twice, just like the interpreter.
+ */
+static void
+emit_mac(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+         struct il_code_block *block, cpu_inst_param inst, bool word) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    int n_bytes = word ? 2 : 4;
+
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_mach = reg_slot(sh4, ctx, block, SH4_REG_MACH,
+                                  WASHDC_JIT_SLOT_GEN);
+    unsigned slot_macl = reg_slot(sh4, ctx, block, SH4_REG_MACL,
+                                  WASHDC_JIT_SLOT_GEN);
+
+    unsigned slot_lhs = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sat = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    // a pending T flag doesn't matter here since S lives in the SR slot
+    jit_mov(block, slot_sr, slot_sat);
+    jit_and_const32(block, slot_sat, SH4_SR_FLAG_S_MASK);
+
+    if (word) {
+        jit_read_16_slot(block, sh4->mem.map, slot_dst, slot_lhs);
+        jit_read_16_slot(block, sh4->mem.map, slot_src, slot_rhs);
+        jit_macw(block, slot_lhs, slot_rhs, slot_mach, slot_macl, slot_sat);
+    } else {
+        jit_read_32_slot(block, sh4->mem.map, slot_dst, slot_lhs);
+        jit_read_32_slot(block, sh4->mem.map, slot_src, slot_rhs);
+        jit_macl(block, slot_lhs, slot_rhs, slot_mach, slot_macl, slot_sat);
+    }
+
+    jit_add_const32(block, slot_dst, n_bytes);
+    jit_add_const32(block, slot_src, n_bytes);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[reg_src].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_MACH].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_MACL].stat = REG_STATUS_SLOT;
+
+    free_slot(block, slot_sat);
+    free_slot(block, slot_rhs);
+    free_slot(block, slot_lhs);
+}
+
+// MAC.L @Rm+, @Rn+
+// 0000nnnnmmmm1111
+bool sh4_jit_macl_armp_arnp(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    emit_mac(sh4, ctx, block, inst, false);
+    return true;
+}
+
+// MAC.W @Rm+, @Rn+
+// 0100nnnnmmmm1111
+bool sh4_jit_macw_armp_arnp(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    emit_mac(sh4, ctx, block, inst, true);
+    return true;
+}
+
 // CMP/GE Rm, Rn
 // 0011nnnnmmmm0011
 bool sh4_jit_cmpge_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
@@ -1776,12 +3164,12 @@ bool sh4_jit_cmpge_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_ge_signed(block, slot_dst, slot_src, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_ge_signed(block, slot_dst, slot_src, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1794,12 +3182,12 @@ bool sh4_jit_cmppl_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned reg_lhs = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
 
     unsigned slot_lhs = reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_gt_signed_const(block, slot_lhs, 0, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_gt_signed_const(block, slot_lhs, 0, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1812,12 +3200,12 @@ bool sh4_jit_cmppz_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned reg_lhs = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
 
     unsigned slot_lhs = reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_GEN);
-    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, slot_sr, ~1);
-    jit_set_ge_signed_const(block, slot_lhs, 0, slot_sr);
+    jit_set_slot(block, slot_t, 0);
+    jit_set_ge_signed_const(block, slot_lhs, 0, slot_t);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1848,17 +3236,14 @@ bool sh4_jit_dt_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                    struct InstOpcode const *op, cpu_inst_param inst) {
     unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
     unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
     unsigned tmp_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, sr_slot, ~1);
     jit_add_const32(block, slot_no, ~(uint32_t)0);
     jit_mov(block, slot_no, tmp_slot);
     jit_slot_to_bool_inv(block, tmp_slot);
-    jit_or(block, tmp_slot, sr_slot);
 
     reg_map[reg_no].stat = REG_STATUS_SLOT;
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, tmp_slot);
 
     return true;
 }
@@ -1868,11 +3253,11 @@ bool sh4_jit_dt_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_clrt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                   struct il_code_block *block, unsigned pc,
                   struct InstOpcode const *op, cpu_inst_param inst) {
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_and_const32(block, sr_slot, ~1);
+    jit_set_slot(block, slot_t, 0);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1882,11 +3267,11 @@ bool sh4_jit_clrt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_sett(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                   struct il_code_block *block, unsigned pc,
                   struct InstOpcode const *op, cpu_inst_param inst) {
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    jit_or_const32(block, sr_slot, 1);
+    jit_set_slot(block, slot_t, 1);
 
-    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+    res_set_t(block, slot_t);
 
     return true;
 }
@@ -1898,13 +3283,16 @@ bool sh4_jit_movt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                   struct InstOpcode const *op, cpu_inst_param inst) {
     unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
 
-    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
-    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
-
-    jit_mov(block, sr_slot, slot_no);
-    jit_and_const32(block, slot_no, 1);
+    unsigned slot_no = reg_slot_noload(sh4, block, reg_no, WASHDC_JIT_SLOT_GEN);
 
-    reg_map[reg_no].stat = REG_STATUS_SLOT;
+    if (t_flag_slot >= 0) {
+        jit_mov(block, t_flag_slot, slot_no);
+    } else {
+        unsigned sr_slot =
+            reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+        jit_mov(block, sr_slot, slot_no);
+        jit_and_const32(block, slot_no, 1);
+    }
 
     return true;
 }
@@ -2021,28 +3409,12 @@ bool sh4_jit_lds_rm_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     free_slot(block, slot_src);
 
+    /*
+     * PR and SZ aren't known anymore.  The block can keep going until it gets
+     * to an instruction which depends on them (see
+     * sh4_jit_il_code_block_compile), and block exits will hash the new FPSCR.
+     */
     ctx->dirty_fpscr = true;
-    if (!ctx->in_delay_slot) {
-        /*
-         * since the code hash (which includes SZ and PR) just changed, we need to
-         * handle this like a jmp instruction.
-         */
-        unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        jit_set_slot(block, jmp_addr_slot, pc + 2);
-
-        unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
-                                       WASHDC_JIT_SLOT_GEN);
-        sh4_jit_hash_slot(sh4, block, jmp_addr_slot, hash_slot, fpscr_slot);
-
-        res_drain_all_regs(sh4, ctx, block);
-        jit_jump(block, jmp_addr_slot, hash_slot);
-
-        free_slot(block, hash_slot);
-        free_slot(block, jmp_addr_slot);
-
-        return false;
-    }
 
     return true;
 }
@@ -2073,28 +3445,12 @@ bool sh4_jit_ldsl_armp_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     free_slot(block, new_val_slot);
 
+    /*
+     * PR and SZ aren't known anymore.  The block can keep going until it gets
+     * to an instruction which depends on them (see
+     * sh4_jit_il_code_block_compile), and block exits will hash the new FPSCR.
+     */
     ctx->dirty_fpscr = true;
-    if (!ctx->in_delay_slot) {
-        /*
-         * since the code hash (which includes SZ and PR) just changed, we need to
-         * handle this like a jmp instruction.
-         */
-        unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        jit_set_slot(block, jmp_addr_slot, pc + 2);
-
-        unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
-                                       WASHDC_JIT_SLOT_GEN);
-        sh4_jit_hash_slot(sh4, block, jmp_addr_slot, hash_slot, fpscr_slot);
-
-        res_drain_all_regs(sh4, ctx, block);
-        jit_jump(block, jmp_addr_slot, hash_slot);
-
-        free_slot(block, hash_slot);
-        free_slot(block, jmp_addr_slot);
-
-        return false;
-    }
 
     return true;
 }
@@ -2104,49 +3460,18 @@ bool sh4_jit_ldsl_armp_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fschg(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                    struct il_code_block *block, unsigned pc,
                    struct InstOpcode const *op, cpu_inst_param inst) {
-    unsigned new_val_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
-                                     WASHDC_JIT_SLOT_GEN);
-    res_disassociate_reg(sh4, ctx, block, SH4_REG_FPSCR);
-
-    jit_xor_const32(block, new_val_slot, SH4_FPSCR_SZ_MASK);
-    ctx->sz_bit = !ctx->sz_bit;
-
     /*
-     * there are a few different ways editing the FPSCR can cause side-effects (for
-     * example by initiating a bank-switch) so we need to make sure everything
-     * is committed to the reg array and we also need to make sure we reload any
-     * registers referenced after the jit_restore_sr operation.
+     * SZ doesn't bank-switch anything or change the rounding mode, so there's
+     * no need to go through sh4_set_fpscr or end the block.  The new value of
+     * SZ is known as long as the old one was.
      */
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
-
-    jit_call_func(block, sh4_set_fpscr, new_val_slot);
-
-    free_slot(block, new_val_slot);
-
-    ctx->dirty_fpscr = true;
-    if (!ctx->in_delay_slot) {
-        /*
-         * since the code hash (which includes SZ and PR) just changed, we need to
-         * handle this like a jmp instruction.
-         */
-        unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        jit_set_slot(block, jmp_addr_slot, pc + 2);
-
-        unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
-                                       WASHDC_JIT_SLOT_GEN);
-        sh4_jit_hash_slot(sh4, block, jmp_addr_slot, hash_slot, fpscr_slot);
-        free_slot(block, fpscr_slot);
-
-        res_drain_all_regs(sh4, ctx, block);
-        jit_jump(block, jmp_addr_slot, hash_slot);
-
-        free_slot(block, hash_slot);
-        free_slot(block, jmp_addr_slot);
+    unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                   WASHDC_JIT_SLOT_GEN);
+    jit_xor_const32(block, fpscr_slot, SH4_FPSCR_SZ_MASK);
+    reg_map[SH4_REG_FPSCR].stat = REG_STATUS_SLOT;
 
-        return false;
-    }
+    if (!ctx->dirty_fpscr)
+        ctx->sz_bit = !ctx->sz_bit;
 
     return true;
 }
@@ -2173,9 +3498,33 @@ bool sh4_jit_fmov_fpu_a_r0_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
@@ -2220,9 +3569,33 @@ bool sh4_jit_fmov_fpu_armp_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
    }
 
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
@@ -2264,9 +3637,33 @@ bool sh4_jit_fmov_arm_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
    }
 
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
@@ -2309,9 +3706,33 @@ bool sh4_jit_fmov_fpu_amrn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
    }
 
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
@@ -2329,6 +3750,9 @@ bool sh4_jit_fmov_fpu_amrn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fmul_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                           struct il_code_block *block, unsigned pc,
                           struct InstOpcode const *op, cpu_inst_param inst) {
+    if (config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
     struct jit_inst il_inst;
 
     if (ctx->pr_bit) {
@@ -2364,6 +3788,9 @@ bool sh4_jit_fmul_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fcmpgt_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                             struct il_code_block *block, unsigned pc,
                             struct InstOpcode const *op, cpu_inst_param inst) {
+    if (config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
     if (ctx->pr_bit) {
         struct jit_inst il_inst;
 
@@ -2383,13 +3810,12 @@ bool sh4_jit_fcmpgt_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
             reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_FLOAT);
         unsigned slot_rhs =
             reg_slot(sh4, ctx, block, reg_rhs, WASHDC_JIT_SLOT_FLOAT);
-        unsigned slot_sr =
-            reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+        unsigned slot_t = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-        jit_and_const32(block, slot_sr, ~1);
-        jit_set_gt_float(block, slot_lhs, slot_rhs, slot_sr);
+        jit_set_slot(block, slot_t, 0);
+        jit_set_gt_float(block, slot_lhs, slot_rhs, slot_t);
 
-        reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+        res_set_t(block, slot_t);
     }
 
     return true;
@@ -2402,6 +3828,9 @@ bool sh4_jit_fcmpgt_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fsub_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                           struct il_code_block *block, unsigned pc,
                           struct InstOpcode const *op, cpu_inst_param inst) {
+    if (config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
     struct jit_inst il_inst;
 
     if (ctx->pr_bit) {
@@ -2437,6 +3866,9 @@ bool sh4_jit_fsub_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fadd_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                           struct il_code_block *block, unsigned pc,
                           struct InstOpcode const *op, cpu_inst_param inst) {
+    if (config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
     void (*handler)(void*, cpu_inst_param);
 
     struct jit_inst il_inst;
@@ -2484,9 +3916,33 @@ bool sh4_jit_ftrc_frm_fpul(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
         handler = sh4_inst_binary_ftrc_fr_fpul;
 
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
@@ -2537,9 +3993,33 @@ bool sh4_jit_fmovs_a_r0_rm_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     }
 
     struct jit_inst il_inst;
+    uint64_t regs = op->fallback_regs;
 
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    if (regs == SH4_FB_ALL) {
+        res_drain_all_regs(sh4, ctx, block);
+        res_invalidate_all_regs(block);
+    } else {
+        unsigned cls, first, count, reg_no;
+
+        /*
+         * memory accesses and exceptions look at SR, so write it back even if
+         * the opcode doesn't use it directly.
+         */
+        res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+
+        for (cls = 0; cls < SH4_FB_N_REGS; cls++) {
+            bool rd = regs & (((uint64_t)1) << cls);
+            bool wr = regs & (((uint64_t)1) << (SH4_FB_N_REGS + cls));
+            if (!rd && !wr)
+                continue;
+            fallback_reg_range(cls, inst, &first, &count);
+            for (reg_no = first; reg_no < first + count; reg_no++) {
+                res_drain_reg(sh4, ctx, block, reg_no);
+                if (wr)
+                    res_invalidate_reg(block, reg_no);
+            }
+        }
+    }
 
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
@@ -2563,24 +4043,26 @@ bool sh4_jit_fmovs_a_r0_rm_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fmov_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                           struct il_code_block *block, unsigned pc,
                           struct InstOpcode const *op, cpu_inst_param inst) {
-    void (*handler)(void*, cpu_inst_param);
-
     if (ctx->sz_bit) {
-        switch (inst & ((1 << 8) | (1 << 4))) {
-        case 0:
-            handler = sh4_inst_binary_fmov_dr_dr;
-            break;
-        case (1 << 4):
-            handler = sh4_inst_binary_fmov_xd_dr;
-            break;
-        case (1 << 8):
-            handler = sh4_inst_binary_fmov_dr_xd;
-            break;
-        case (1 << 8) | (1 << 4):
-            handler = sh4_inst_binary_fmov_xd_xd;
-            break;
-        default:
-            RAISE_ERROR(ERROR_INTEGRITY); // should never happen
+        /*
+         * 64-bit moves are just a pair of 32-bit moves; the bits get copied
+         * as-is so it doesn't matter that the halves aren't really floats.
+         */
+        unsigned src_reg = ((inst >> 5) & 0x7) * 2 +
+            ((inst & (1 << 4)) ? SH4_REG_XF0 : SH4_REG_FR0);
+        unsigned dst_reg = ((inst >> 9) & 0x7) * 2 +
+            ((inst & (1 << 8)) ? SH4_REG_XF0 : SH4_REG_FR0);
+        unsigned half;
+
+        for (half = 0; half < 2; half++) {
+            unsigned src_slot = reg_slot(sh4, ctx, block, src_reg + half,
+                                         WASHDC_JIT_SLOT_FLOAT);
+            unsigned dst_slot = reg_slot_noload(sh4, block, dst_reg + half,
+                                                WASHDC_JIT_SLOT_FLOAT);
+
+            jit_mov_float(block, src_slot, dst_slot);
+
+            reg_map[dst_reg + half].stat = REG_STATUS_SLOT;
         }
     } else {
         unsigned fr_src_reg = ((inst >> 4) & 0xf) + SH4_REG_FR0;
@@ -2594,21 +4076,8 @@ bool sh4_jit_fmov_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
         jit_mov_float(block, fr_src_slot, fr_dst_slot);
 
         reg_map[fr_dst_reg].stat = REG_STATUS_SLOT;
-
-        return true;
     }
 
-    struct jit_inst il_inst;
-
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
-
-    il_inst.op = JIT_OP_FALLBACK;
-    il_inst.immed.fallback.fallback_fn = handler;
-    il_inst.immed.fallback.inst = inst;
-
-    il_code_block_push_inst(block, &il_inst);
-
     return true;
 }
 
@@ -2635,9 +4104,206 @@ bool sh4_jit_fldi0_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+// FDIV FRm, FRn
+// 1111nnnnmmmm0011
+// FDIV DRm, DRn
+// 1111nnn0mmm00011
+bool sh4_jit_fdiv_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit || config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fr_src_reg = ((inst >> 4) & 0xf) + SH4_REG_FR0;
+    unsigned fr_dst_reg = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+
+    unsigned fr_src_slot =
+        reg_slot(sh4, ctx, block, fr_src_reg, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fr_dst_slot =
+        reg_slot(sh4, ctx, block, fr_dst_reg, WASHDC_JIT_SLOT_FLOAT);
+
+    jit_div_float(block, fr_src_slot, fr_dst_slot);
+
+    reg_map[fr_dst_reg].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+/*
+ * FSQRT FRn
+ * 1111nnnn01101101
+ * FSQRT DRn
+ * 1111nnn001101101
+ *
+ * Unlike the interpreter, this does not set the V flag in FPSCR for negative
+ * inputs (the result is still a NaN).
+ */
+bool sh4_jit_fsqrt_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_no = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_FLOAT);
+
+    jit_sqrt_float(block, slot_no);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSRRA FRn
+// 1111nnnn01111101
+bool sh4_jit_fsrra_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit || config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_no = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_FLOAT);
+    unsigned tmp_slot = alloc_slot(block, WASHDC_JIT_SLOT_FLOAT);
+
+    jit_sqrt_float(block, slot_no);
+    jit_load_float_slot(block, tmp_slot, &sh4_jit_one_f);
+    jit_div_float(block, slot_no, tmp_slot);
+    jit_mov_float(block, tmp_slot, slot_no);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+    free_slot(block, tmp_slot);
+
+    return true;
+}
+
+// FMAC FR0, FRm, FRn
+// 1111nnnnmmmm1110
+bool sh4_jit_fmac_fr0_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                              struct il_code_block *block, unsigned pc,
+                              struct InstOpcode const *op,
+                              cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fr_src_reg = ((inst >> 4) & 0xf) + SH4_REG_FR0;
+    unsigned fr_dst_reg = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+
+    unsigned fr0_slot =
+        reg_slot(sh4, ctx, block, SH4_REG_FR0, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fr_src_slot =
+        reg_slot(sh4, ctx, block, fr_src_reg, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fr_dst_slot =
+        reg_slot(sh4, ctx, block, fr_dst_reg, WASHDC_JIT_SLOT_FLOAT);
+    unsigned tmp_slot = alloc_slot(block, WASHDC_JIT_SLOT_FLOAT);
+
+    jit_mov_float(block, fr0_slot, tmp_slot);
+    jit_mul_float(block, fr_src_slot, tmp_slot);
+    jit_add_float(block, tmp_slot, fr_dst_slot);
+
+    reg_map[fr_dst_reg].stat = REG_STATUS_SLOT;
+    free_slot(block, tmp_slot);
+
+    return true;
+}
+
+/*
+ * emit il to compute the dot product of the four float registers starting at
+ * lhs_reg with the four registers starting at rhs_reg (spaced rhs_stride
+ * apart) into dst_slot.  the terms are summed left to right to match the
+ * interpreter.
+ */
+static void
+sh4_jit_dot4(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+             struct il_code_block *block, unsigned lhs_reg,
+             unsigned rhs_reg, unsigned rhs_stride, unsigned dst_slot) {
+    unsigned tmp_slot = alloc_slot(block, WASHDC_JIT_SLOT_FLOAT);
+    unsigned idx;
+
+    for (idx = 0; idx < 4; idx++) {
+        unsigned lhs_slot = reg_slot(sh4, ctx, block, lhs_reg + idx,
+                                     WASHDC_JIT_SLOT_FLOAT);
+        unsigned rhs_slot = reg_slot(sh4, ctx, block,
+                                     rhs_reg + idx * rhs_stride,
+                                     WASHDC_JIT_SLOT_FLOAT);
+        if (idx == 0) {
+            jit_mov_float(block, lhs_slot, dst_slot);
+            jit_mul_float(block, rhs_slot, dst_slot);
+        } else {
+            jit_mov_float(block, lhs_slot, tmp_slot);
+            jit_mul_float(block, rhs_slot, tmp_slot);
+            jit_add_float(block, tmp_slot, dst_slot);
+        }
+    }
+
+    free_slot(block, tmp_slot);
+}
+
+// FIPR FVm, FVn
+// 1111nnmm11101101
+bool sh4_jit_fipr_fvm_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    if (config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fv_src_reg = ((inst >> 8) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned fv_dst_reg = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
+
+    unsigned dot_slot = alloc_slot(block, WASHDC_JIT_SLOT_FLOAT);
+    sh4_jit_dot4(sh4, ctx, block, fv_src_reg, fv_dst_reg, 1, dot_slot);
+
+    unsigned dst_slot = reg_slot_noload(sh4, block, fv_dst_reg + 3,
+                                        WASHDC_JIT_SLOT_FLOAT);
+    jit_mov_float(block, dot_slot, dst_slot);
+    reg_map[fv_dst_reg + 3].stat = REG_STATUS_SLOT;
+
+    free_slot(block, dot_slot);
+
+    return true;
+}
+
+/*
+ * FTRV XMTRX, FVn
+ * 1111nn0111111101
+ *
+ * XMTRX is stored column-major in XF0-XF15, so row i of the matrix is
+ * XF(i), XF(i+4), XF(i+8), XF(i+12).
+ */
+bool sh4_jit_ftrv_xmtrx_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    if (config_get_fpu_pedantic())
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fv_reg = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned out_slots[4];
+    unsigned row;
+
+    // FVn is an input to every row, so it can't be written until the end
+    for (row = 0; row < 4; row++) {
+        out_slots[row] = alloc_slot(block, WASHDC_JIT_SLOT_FLOAT);
+        sh4_jit_dot4(sh4, ctx, block, fv_reg, SH4_REG_XF0 + row, 4,
+                     out_slots[row]);
+    }
+
+    for (row = 0; row < 4; row++) {
+        unsigned dst_slot = reg_slot_noload(sh4, block, fv_reg + row,
+                                            WASHDC_JIT_SLOT_FLOAT);
+        jit_mov_float(block, out_slots[row], dst_slot);
+        reg_map[fv_reg + row].stat = REG_STATUS_SLOT;
+        free_slot(block, out_slots[row]);
+    }
+
+    return true;
+}
+
 static unsigned reg_slot(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                          struct il_code_block *block, unsigned reg_no,
                          enum washdc_jit_slot_tp tp) {
+    if (reg_no == SH4_REG_SR)
+        res_flush_t(sh4, ctx, block);
+
     struct residency *res = reg_map + reg_no;
 
     if (res->stat == REG_STATUS_SH4) {
@@ -2665,6 +4331,9 @@ static unsigned reg_slot(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
 
 static unsigned reg_slot_noload(Sh4 *sh4, struct il_code_block *block,
                                 unsigned reg_no, enum washdc_jit_slot_tp tp) {
+    if (reg_no == SH4_REG_SR)
+        res_discard_t(block);
+
     struct residency *res = reg_map + reg_no;
     if (res->stat == REG_STATUS_SH4) {
         unsigned slot_no = alloc_slot(block, tp);
@@ -2743,6 +4412,24 @@ sh4_jit_hash_slot_known_fpscr(struct Sh4 *sh4,
         jit_or_const32(block, hash_slot, SH4_JIT_HASH_SZ_MASK);
 }
 
+static void
+sh4_jit_jump_static(struct Sh4 *sh4, struct sh4_jit_compile_ctx const *ctx,
+                    struct il_code_block *block, unsigned jmp_addr_slot,
+                    unsigned hash_slot, unsigned n_targets,
+                    uint32_t const *targets) {
+    jit_hash hashes[JIT_JUMP_MAX_STATIC_TARGETS];
+    unsigned idx;
+
+    if (n_targets > JIT_JUMP_MAX_STATIC_TARGETS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+
+    for (idx = 0; idx < n_targets; idx++)
+        hashes[idx] = sh4_jit_hash(sh4, targets[idx], ctx->pr_bit, ctx->sz_bit);
+
+    jit_jump_static(block, jmp_addr_slot, hash_slot,
+                    n_targets, targets, hashes);
+}
+
 static jit_hash sh4_jit_hash_wrapper(void *ctx, uint32_t addr) {
     struct Sh4 *sh4 = (Sh4*)ctx;
     return sh4_jit_hash(sh4, addr, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
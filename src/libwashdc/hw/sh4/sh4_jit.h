@@ -33,15 +33,31 @@
 #include "jit/code_block.h"
 #include "jit/optimize.h"
 #include "jit/code_cache.h"
+#include "jit/jit_persist.h"
+#include "jit/jit_perf_map.h"
+#include "config.h"
+#include "perf_cnt.h"
+
+#ifdef ENABLE_DEBUGGER
+#include "washdc/debugger.h"
+#endif
 
 #ifdef JIT_PROFILE
 #include "jit/jit_profile.h"
 #endif
 
+#ifdef ENABLE_JIT_NATIVE
+#include "jit/jit_bg_compile.h"
+#endif
+
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/code_block_x86_64.h"
 #endif
 
+#ifdef ENABLE_JIT_AARCH64
+#include "jit/aarch64/code_block_aarch64.h"
+#endif
+
 struct InstOpcode;
 struct il_code_block;
 struct Sh4;
@@ -52,10 +68,26 @@ struct Sh4;
  */
 void sh4_jit_new_block(void);
 
+/*
+ * registers tracked by the stall model (see sh4_jit_pipe_cycles).  0-15 are
+ * the general-purpose registers of whichever bank is active and 16-31 are
+ * FR0-FR15 of whichever bank is active.
+ */
+#define SH4_JIT_PIPE_N_REGS 32
+
 struct sh4_jit_compile_ctx {
     unsigned last_inst_type;
     unsigned cycle_count;
 
+    /*
+     * value of cycle_count when each register's pending result becomes
+     * available.  Only used when config_get_jit_stall_model() is set.
+     */
+    unsigned reg_ready[SH4_JIT_PIPE_N_REGS];
+
+    // number of conditional side-exits emitted so far (see superblocks)
+    unsigned n_side_exits;
+
     // only valid if have_reg_slot is true
     unsigned reg_slot;
 
@@ -91,29 +123,237 @@ sh4_jit_compile_inst(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                      struct il_code_block *block, cpu_inst_param inst,
                      unsigned pc);
 
+/*
+ * if the code at pc is a DIV0U or DIV0S followed by a run of DIV1 steps (as
+ * emitted by compilers for integer division), compile the whole sequence as a
+ * single operation.  Returns the number of bytes of guest code consumed, or 0
+ * if there's no such sequence at pc.
+ */
+unsigned
+sh4_jit_div_idiom(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                  struct il_code_block *block, addr32_t pc);
+
+/*
+ * if the code at pc is a run of 32-bit loads or stores through the same base
+ * register at consecutive addresses (pushes and pops, unrolled copies), compile
+ * up to JIT_BLOCK_MAX_WORDS of them as a single operation.  Returns the number
+ * of bytes of guest code consumed, or 0 if there's no such run at pc.
+ */
+unsigned
+sh4_jit_mem_run(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                struct il_code_block *block, addr32_t pc);
+
+/*
+ * if the block at addr is the start of a library routine that hle_func knows
+ * about, compile it as a call to the host implementation and return true.
+ */
+bool
+sh4_jit_hle_func(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                 struct jit_code_block *jit_blk, struct il_code_block *block,
+                 addr32_t addr);
+
+/*
+ * returns true if the n_bytes of guest code at addr (as returned by
+ * sh4_jit_il_code_block_compile) are a loop which branches back to addr and
+ * does the same thing every time around until memory changes underneath it.
+ * The dispatcher can skip ahead to the next scheduled event when such a
+ * block loops back to itself.  This always returns false unless
+ * config_get_jit_idle_skip() is set.
+ */
+bool sh4_jit_idle_loop(struct Sh4 *sh4, addr32_t addr, unsigned n_bytes);
+
+/*
+ * return the number of cycles inst takes when it gets issued at cycle now of
+ * the block, given that it takes issue_cycles without any stalls.  reg_ready
+ * is updated with the latency of whichever registers inst writes.
+ */
+unsigned sh4_jit_pipe_cycles(unsigned *reg_ready, unsigned now,
+                             cpu_inst_param inst, unsigned issue_cycles);
+
+// end the block with a jump to pc, without compiling the instruction there
+void
+sh4_jit_split_block(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                    struct il_code_block *block, addr32_t pc);
+
+/*
+ * record which part of main RAM (if any) the block was compiled from so the
+ * code cache can drop it when the guest overwrites it.
+ */
 static inline void
+sh4_jit_set_blk_range(struct Sh4 *sh4, struct jit_code_block *jit_blk,
+                      addr32_t first_addr, unsigned n_bytes) {
+    struct memory_map_region *region =
+        memory_map_get_region(sh4->mem.map, first_addr, n_bytes);
+    if (region && region->id == MEMORY_MAP_REGION_RAM) {
+        jit_blk->ram_first = first_addr & region->mask;
+        jit_blk->ram_last = jit_blk->ram_first + (n_bytes - 1);
+        jit_blk->in_ram = true;
+    } else {
+        jit_blk->in_ram = false;
+    }
+}
+
+/*
+ * returns true if the il the jit generates for inst depends on FPSCR.PR or
+ * FPSCR.SZ.  FSCHG and FRCHG are the only FPU instructions that don't.
+ */
+static inline bool sh4_jit_inst_uses_fpu_mode(cpu_inst_param inst) {
+    return (inst & 0xf000) == 0xf000 && inst != 0xf3fd && inst != 0xfbfd;
+}
+
+/*
+ * returns the number of bytes of guest code the block covers, including the
+ * instruction after the last one (see below).
+ */
+static inline unsigned
 sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                               struct jit_code_block *jit_blk,
                               struct il_code_block *block, addr32_t addr) {
     bool do_continue;
+    addr32_t first_addr = addr & BIT_RANGE(0, 28);
+#ifdef ENABLE_DEBUGGER
+    addr32_t const blk_pc = addr;
+    bool const split_at_break = config_get_dbg_enable();
+#endif
 
     sh4_jit_new_block();
 
     do {
+#ifdef ENABLE_DEBUGGER
+        // the debugger only checks for breakpoints in between blocks
+        if (split_at_break && addr != blk_pc &&
+            debug_is_break(DEBUG_CONTEXT_SH4, addr)) {
+            sh4_jit_split_block(sh4, ctx, block, addr);
+            break;
+        }
+#endif
+
         cpu_inst_param inst =
             memory_map_read_16(sh4->mem.map, addr & BIT_RANGE(0, 28));
 
+        /*
+         * after a write to FPSCR the block keeps going until it gets to an
+         * instruction that needs to know PR or SZ, or to a branch with one of
+         * those in its delay slot.  Then it ends so that the rest of the code
+         * can be looked up under the new FPSCR.
+         */
+        if (ctx->dirty_fpscr &&
+            (sh4_jit_inst_uses_fpu_mode(inst) ||
+             (sh4_decode_inst(inst)->pc_relative &&
+              sh4_jit_inst_uses_fpu_mode(
+                  memory_map_read_16(sh4->mem.map,
+                                     (addr + 2) & BIT_RANGE(0, 28)))))) {
+            sh4_jit_split_block(sh4, ctx, block, addr);
+            break;
+        }
+
 #ifdef JIT_PROFILE
         uint16_t inst16 = inst;
         jit_profile_push_inst(&sh4->jit_profile, jit_blk->profile, &inst16);
 #endif
 
+        unsigned div_len = sh4_jit_div_idiom(sh4, ctx, block, addr);
+        if (div_len) {
+            addr += div_len;
+            do_continue = true;
+            continue;
+        }
+
+        unsigned run_len = sh4_jit_mem_run(sh4, ctx, block, addr);
+        if (run_len) {
+            addr += run_len;
+            do_continue = true;
+            continue;
+        }
+
         do_continue = sh4_jit_compile_inst(sh4, ctx, block, inst, addr);
         addr += 2;
     } while (do_continue);
+
+    /*
+     * addr now points to the instruction after the last one, which will be
+     * the delay slot if the block ended on a delayed branch.  It's included in
+     * the range either way since that's cheaper than figuring out which kind
+     * of instruction ended the block.
+     */
+    unsigned n_bytes = (addr & BIT_RANGE(0, 28)) - first_addr + 2;
+    sh4_jit_set_blk_range(sh4, jit_blk, first_addr, n_bytes);
+
+    return n_bytes;
 }
 
-#ifdef ENABLE_JIT_X86_64
+// hash of the guest code a block covers, for the persistent jit cache
+static inline uint32_t
+sh4_jit_src_hash(struct Sh4 *sh4, addr32_t first_addr, unsigned n_bytes) {
+    uint32_t hash = JIT_PERSIST_HASH_INIT;
+    unsigned offs;
+    for (offs = 0; offs < n_bytes; offs += 2) {
+        uint16_t inst = memory_map_read_16(sh4->mem.map, first_addr + offs);
+        hash = jit_persist_hash16(hash, inst);
+    }
+    return hash;
+}
+
+static inline uint32_t sh4_jit_persist_flags(void) {
+    return (config_get_jit_superblocks() ? 1 : 0) |
+        (config_get_jit_stall_model() ? 2 : 0) |
+        (config_get_fpu_pedantic() ? 4 : 0);
+}
+
+/*
+ * generate optimized il for the block at addr, taking it from the persistent
+ * jit cache when there's a record whose guest code still matches.
+ */
+static inline void
+sh4_jit_compile_il(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                   struct jit_code_block *jit_blk,
+                   struct il_code_block *block, addr32_t addr) {
+    if (sh4_jit_hle_func(sh4, ctx, jit_blk, block, addr))
+        return;
+
+#ifndef JIT_PROFILE
+    bool persist = config_get_jit_persist_cache();
+#ifdef ENABLE_DEBUGGER
+    // cached blocks weren't split at breakpoints
+    if (config_get_dbg_enable())
+        persist = false;
+#endif
+    addr32_t first_addr = addr & BIT_RANGE(0, 28);
+    jit_hash hash = sh4_jit_hash(sh4, addr, ctx->pr_bit, ctx->sz_bit);
+
+    if (persist) {
+        struct jit_persist_rec const *rec = jit_persist_find(hash);
+        if (rec && rec->src_hash ==
+            sh4_jit_src_hash(sh4, first_addr, rec->n_bytes) &&
+            jit_persist_restore(rec, block) == 0) {
+            ctx->cycle_count = rec->cycle_count;
+            sh4_jit_set_blk_range(sh4, jit_blk, first_addr, rec->n_bytes);
+            jit_blk->idle_loop = sh4_jit_idle_loop(sh4, addr, rec->n_bytes);
+            block->idle_loop = jit_blk->idle_loop;
+            block->idle_pc = addr;
+            return;
+        }
+    }
+#endif
+
+    unsigned n_bytes = sh4_jit_il_code_block_compile(sh4, ctx, jit_blk,
+                                                     block, addr);
+    jit_optimize(block);
+    jit_blk->idle_loop = sh4_jit_idle_loop(sh4, addr, n_bytes);
+    block->idle_loop = jit_blk->idle_loop;
+    block->idle_pc = addr;
+
+#ifndef JIT_PROFILE
+    if (persist) {
+        jit_persist_store(hash, sh4_jit_src_hash(sh4, first_addr, n_bytes),
+                          n_bytes, ctx->cycle_count, block);
+    }
+#else
+    (void)n_bytes;
+#endif
+}
+
+#ifdef ENABLE_JIT_NATIVE
 
 #ifdef JIT_PROFILE
 static void sh4_jit_profile_notify(void *cpu, struct jit_profile_per_block *blk_profile) {
@@ -125,12 +365,17 @@ static void sh4_jit_profile_notify(void *cpu, struct jit_profile_per_block *blk_
 static inline void
 sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
                        struct jit_code_block *jit_blk, uint32_t pc) {
-    struct Sh4 const *sh4 = (struct Sh4*)cpu;
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
     struct il_code_block il_blk;
+#ifdef ENABLE_JIT_X86_64
     struct code_block_x86_64 *blk = &jit_blk->x86_64;
+#else
+    struct code_block_aarch64 *blk = &jit_blk->aarch64;
+#endif
     struct sh4_jit_compile_ctx ctx = {
         .last_inst_type = SH4_GROUP_NONE,
         .cycle_count = 0,
+        .n_side_exits = 0,
         .sz_bit = sh4_fpscr_sz(sh4),
         .pr_bit = sh4_fpscr_pr(sh4),
         .in_delay_slot = false,
@@ -138,15 +383,14 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
         .have_reg_slot = false
     };
 
-    il_code_block_init(&il_blk);
+    PERF_TIMER_BEGIN(PERF_JIT_COMPILE_NATIVE);
+    il_code_block_init_arena(&il_blk, &sh4->il_arena);
 
 #ifdef JIT_PROFILE
     il_blk.profile = jit_blk->profile;
 #endif
 
-    sh4_jit_il_code_block_compile(cpu, &ctx, jit_blk, &il_blk, pc);
-
-    jit_optimize(&il_blk);
+    sh4_jit_compile_il(cpu, &ctx, jit_blk, &il_blk, pc);
 
 #ifdef INVARIANTS
     jit_sanity_checks(il_blk.inst_list, il_blk.inst_count);
@@ -158,31 +402,81 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
         jit_profile_push_il_inst(&sh4->jit_profile, jit_blk->profile,
                                  il_blk.inst_list + inst_no);
     }
+    jit_blk->profile->cycle_count = ctx.cycle_count;
 #endif
+#ifdef ENABLE_JIT_X86_64
     code_block_x86_64_compile(cpu, blk, &il_blk, meta,
                               ctx.cycle_count * SH4_CLOCK_SCALE);
+#else
+    code_block_aarch64_compile(cpu, blk, &il_blk, meta,
+                               ctx.cycle_count * SH4_CLOCK_SCALE);
+#endif
 
-#ifdef JIT_PROFILE
     ptrdiff_t wasted_bytes = 0;
     if (blk->native != blk->exec_mem_alloc_start)
         wasted_bytes = ((char*)blk->native) - ((char*)blk->exec_mem_alloc_start);
+
+#ifdef JIT_PROFILE
     jit_profile_set_native_insts(&sh4->jit_profile, jit_blk->profile,
                                  blk->bytes_used - wasted_bytes, blk->native);
 #endif
 
+    if (config_get_jit_perf_map())
+        jit_perf_map_add(blk->native, blk->bytes_used - wasted_bytes, pc);
+
     il_code_block_cleanup(&il_blk);
+    jit_arena_reset(&sh4->il_arena);
+    PERF_TIMER_END(PERF_JIT_COMPILE_NATIVE);
+}
+
+/*
+ * the jit_bg_compile version of sh4_jit_compile_native.  The il gets generated
+ * here on the emulation thread, and everything after that happens on the
+ * worker.  The entry already has a block compiled from this address, so the
+ * frontend writes its bookkeeping into a throwaway block instead.
+ */
+static inline struct jit_bg_job *
+sh4_jit_submit_native(void *cpu, struct native_dispatch_meta const *meta,
+                      uint32_t pc) {
+    struct Sh4 const *sh4 = (struct Sh4*)cpu;
+    struct il_code_block il_blk;
+    struct jit_code_block scratch;
+    struct sh4_jit_compile_ctx ctx = {
+        .last_inst_type = SH4_GROUP_NONE,
+        .cycle_count = 0,
+        .n_side_exits = 0,
+        .sz_bit = sh4_fpscr_sz(sh4),
+        .pr_bit = sh4_fpscr_pr(sh4),
+        .in_delay_slot = false,
+        .dirty_fpscr = false,
+        .have_reg_slot = false
+    };
+
+    il_code_block_init(&il_blk);
+    jit_code_block_init(&scratch, pc, false);
+
+    sh4_jit_compile_il(cpu, &ctx, &scratch, &il_blk, pc);
+    jit_code_block_cleanup(&scratch, false);
+
+#ifdef INVARIANTS
+    jit_sanity_checks(il_blk.inst_list, il_blk.inst_count);
+#endif
+
+    return jit_bg_compile_submit(cpu, meta, &il_blk,
+                                 ctx.cycle_count * SH4_CLOCK_SCALE, pc);
 }
 #endif
 
 static inline void
 sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
-    struct Sh4 const *sh4 = (struct Sh4*)cpu;
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
     struct il_code_block il_blk;
     struct jit_code_block *jit_blk = (struct jit_code_block*)blk_ptr;
     struct code_block_intp *blk = &jit_blk->intp;
     struct sh4_jit_compile_ctx ctx = {
         .last_inst_type = SH4_GROUP_NONE,
         .cycle_count = 0,
+        .n_side_exits = 0,
         .sz_bit = sh4_fpscr_sz(sh4),
         .pr_bit = sh4_fpscr_pr(sh4),
         .in_delay_slot = false,
@@ -190,15 +484,14 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
         .have_reg_slot = false
     };
 
-    il_code_block_init(&il_blk);
+    PERF_TIMER_BEGIN(PERF_JIT_COMPILE_INTP);
+    il_code_block_init_arena(&il_blk, &sh4->il_arena);
 
 #ifdef JIT_PROFILE
     il_blk.profile = jit_blk->profile;
 #endif
 
-    sh4_jit_il_code_block_compile(cpu, &ctx, jit_blk, &il_blk, pc);
-
-    jit_optimize(&il_blk);
+    sh4_jit_compile_il(cpu, &ctx, jit_blk, &il_blk, pc);
 
 #ifdef INVARIANTS
     jit_sanity_checks(il_blk.inst_list, il_blk.inst_count);
@@ -210,10 +503,13 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
         jit_profile_push_il_inst(&sh4->jit_profile, jit_blk->profile,
                                  il_blk.inst_list + inst_no);
     }
+    jit_blk->profile->cycle_count = ctx.cycle_count;
 #endif
 
     code_block_intp_compile(cpu, blk, &il_blk, ctx.cycle_count * SH4_CLOCK_SCALE);
     il_code_block_cleanup(&il_blk);
+    jit_arena_reset(&sh4->il_arena);
+    PERF_TIMER_END(PERF_JIT_COMPILE_INTP);
 }
 
 /*
@@ -225,7 +521,31 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
 void sh4_jit_init(struct Sh4 *sh4);
 void sh4_jit_cleanup(struct Sh4 *sh4);
 
-#ifdef ENABLE_JIT_X86_64
+/*
+ * register every host pointer the sh4 frontend can put into the il with the
+ * persistent jit cache.  This needs to be called after the sh4's memory map
+ * has been set.
+ */
+void sh4_jit_persist_register(struct Sh4 *sh4);
+
+#ifdef JIT_PROFILE
+// write the profiler's blocks to path as JSON.  Returns 0 on success.
+int sh4_jit_profile_export(struct Sh4 *sh4, char const *path);
+#endif
+
+/*
+ * maximum number of conditional branches a single block may continue past
+ * when superblocks are enabled.
+ */
+#define SH4_JIT_MAX_SIDE_EXITS 8
+
+#ifdef ENABLE_JIT_NATIVE
+/*
+ * number of times a block runs through the interpreter before it gets compiled
+ * with the native backend when tiering is enabled.
+ */
+#define SH4_JIT_TIER_THRESHOLD 32
+
 void sh4_jit_set_native_dispatch_meta(struct native_dispatch_meta *meta);
 #endif
 
@@ -556,6 +876,30 @@ bool sh4_jit_muluw_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                          struct il_code_block *block, unsigned pc,
                          struct InstOpcode const *op, cpu_inst_param inst);
 
+// DMULS.L Rm, Rn
+// 0011nnnnmmmm1101
+bool sh4_jit_dmulsl_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// DMULU.L Rm, Rn
+// 0011nnnnmmmm0101
+bool sh4_jit_dmulul_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// MAC.L @Rm+, @Rn+
+// 0000nnnnmmmm1111
+bool sh4_jit_macl_armp_arnp(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst);
+
+// MAC.W @Rm+, @Rn+
+// 0100nnnnmmmm1111
+bool sh4_jit_macw_armp_arnp(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst);
+
 // STS MACL, Rn
 // 0000nnnn00011010
 bool sh4_jit_sts_macl_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
@@ -592,6 +936,12 @@ bool sh4_jit_movl_rm_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                          struct il_code_block *block, unsigned pc,
                          struct InstOpcode const *op, cpu_inst_param inst);
 
+// MOVCA.L R0, @Rn
+// 0000nnnn11000011
+bool sh4_jit_movcal_r0_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
 // CMP/EQ Rm, Rn
 // 0011nnnnmmmm0000
 bool sh4_jit_cmpeq_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
@@ -819,4 +1169,45 @@ bool sh4_jit_trapa_imm(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fldi0_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                        struct il_code_block *block, unsigned pc,
                        struct InstOpcode const *op, cpu_inst_param inst);
+
+// FDIV FRm, FRn
+// 1111nnnnmmmm0011
+// FDIV DRm, DRn
+// 1111nnn0mmm00011
+bool sh4_jit_fdiv_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSQRT FRn
+// 1111nnnn01101101
+// FSQRT DRn
+// 1111nnn001101101
+bool sh4_jit_fsqrt_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSRRA FRn
+// 1111nnnn01111101
+bool sh4_jit_fsrra_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMAC FR0, FRm, FRn
+// 1111nnnnmmmm1110
+bool sh4_jit_fmac_fr0_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                              struct il_code_block *block, unsigned pc,
+                              struct InstOpcode const *op,
+                              cpu_inst_param inst);
+
+// FIPR FVm, FVn
+// 1111nnmm11101101
+bool sh4_jit_fipr_fvm_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// FTRV XMTRX, FVn
+// 1111nn0111111101
+bool sh4_jit_ftrv_xmtrx_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst);
 #endif
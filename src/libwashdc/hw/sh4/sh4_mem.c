@@ -110,6 +110,7 @@ struct memory_interface sh4_p4_intf = {
 
 void sh4_mem_init(Sh4 *sh4) {
     sh4->mem.map = NULL;
+    sh4_soft_tlb_flush(sh4);
 }
 
 void sh4_mem_cleanup(Sh4 *sh4) {
@@ -465,11 +466,73 @@ sh4_itlb_find_ent_associative(struct Sh4 *sh4, uint32_t vpn) {
     return ent;
 }
 
+/*
+ * find the range of main RAM which instruction fetches can read directly.
+ * This is the first RAM region plus any mirrors which come right after it,
+ * as long as nothing else in the map takes priority over any part of it.
+ */
+static void sh4_find_fetch_range(struct Sh4 *sh4) {
+    struct memory_map const *map = sh4->mem.map;
+    unsigned region_no, next_no;
+
+    sh4->mem.fetch_host = NULL;
+    sh4->mem.fetch_first = 1;
+    sh4->mem.fetch_last = 0;
+    sh4->mem.fetch_mask = 0;
+
+    for (region_no = 0; region_no < map->n_regions; region_no++)
+        if (map->regions[region_no].id == MEMORY_MAP_REGION_RAM)
+            break;
+    if (region_no >= map->n_regions)
+        return;
+
+    struct memory_map_region const *ram = map->regions + region_no;
+    if (!ram->host || (ram->range_mask & 0x1fffffff) != 0x1fffffff ||
+        ram->last_addr > 0x1fffffff)
+        return;
+
+    uint32_t first = ram->first_addr, last = ram->last_addr;
+    for (next_no = region_no + 1; next_no < map->n_regions; next_no++) {
+        struct memory_map_region const *next = map->regions + next_no;
+        if (next->id != MEMORY_MAP_REGION_RAM || next->host != ram->host ||
+            next->mask != ram->mask || next->range_mask != ram->range_mask ||
+            next->first_addr != last + 1)
+            break;
+        last = next->last_addr;
+    }
+
+    // every page in the range needs to belong to one of those regions
+    if ((first & (MEMORY_MAP_PAGE_SIZE - 1)) ||
+        ((last + 1) & (MEMORY_MAP_PAGE_SIZE - 1)))
+        return;
+    uint32_t page;
+    for (page = first >> MEMORY_MAP_PAGE_SHIFT;
+         page <= (last >> MEMORY_MAP_PAGE_SHIFT); page++) {
+        unsigned ent = map->page_tbl[page];
+        if (ent < region_no || ent >= next_no)
+            return;
+    }
+
+    sh4->mem.fetch_host = ram->host;
+    sh4->mem.fetch_first = first;
+    sh4->mem.fetch_last = last - 1;
+    sh4->mem.fetch_mask = ram->mask;
+}
+
 void sh4_set_mem_map(struct Sh4 *sh4, struct memory_map *map) {
     sh4->mem.map = map;
+    sh4_find_fetch_range(sh4);
+}
+
+void sh4_soft_tlb_flush(struct Sh4 *sh4) {
+    unsigned idx;
+    for (idx = 0; idx < SH4_SOFT_TLB_LEN; idx++)
+        sh4->mem.soft_tlb[idx].page = SH4_SOFT_TLB_INVALID;
 }
 
 static void sh4_utlb_addr_array_write(struct Sh4 *sh4, addr32_t addr, uint32_t val) {
+    sh4_soft_tlb_flush(sh4);
+
     struct sh4_utlb_ent *ent;
     bool associative = (addr >> 7) & 1 ? true : false;
     bool valid = (val >> 8) & 1 ? true : false;
@@ -563,6 +626,8 @@ static uint32_t sh4_utlb_addr_array_read(struct Sh4 *sh4, addr32_t addr) {
 
 static void
 sh4_utlb_data_array_1_write(struct Sh4 *sh4, addr32_t addr, uint32_t val) {
+    sh4_soft_tlb_flush(sh4);
+
     SH4_MEM_TRACE("UTLB DATA ARRAY 1 WRITE %08X TO %08X\n",
                   (unsigned)val, (unsigned)addr);
 
@@ -645,6 +710,8 @@ static uint32_t sh4_utlb_data_array_2_read(struct Sh4 *sh4, addr32_t addr) {
 
 static void
 sh4_itlb_addr_array_write(struct Sh4 *sh4, addr32_t addr, uint32_t val) {
+    sh4_soft_tlb_flush(sh4);
+
     unsigned idx = (addr >> 8) & 3;
     struct sh4_itlb_ent *ent = sh4->mem.itlb + idx;
 
@@ -671,6 +738,8 @@ static uint32_t sh4_itlb_addr_array_read(struct Sh4 *sh4, addr32_t addr) {
 
 static void
 sh4_itlb_data_array_1_write(struct Sh4 *sh4, addr32_t addr, uint32_t val) {
+    sh4_soft_tlb_flush(sh4);
+
     unsigned idx = (addr >> 8) & 3;
     struct sh4_itlb_ent *ent = sh4->mem.itlb + idx;
 
@@ -762,13 +831,29 @@ static void sh4_utlb_increment_urc(struct Sh4 *sh4) {
     sh4->reg[SH4_REG_MMUCR] |= ((urc << 10) & BIT_RANGE(10, 15));
 }
 
+static struct sh4_utlb_ent *
+sh4_utlb_find_ent_cached(struct Sh4 *sh4, uint32_t addr) {
+    uint32_t page = addr >> 10;
+    struct sh4_soft_tlb_ent *soft =
+        sh4->mem.soft_tlb + (page & (SH4_SOFT_TLB_LEN - 1));
+    if (soft->page == page)
+        return soft->ent;
+
+    struct sh4_utlb_ent *ent = sh4_utlb_find_ent_associative(sh4, addr);
+    if (ent) {
+        soft->page = page;
+        soft->ent = ent;
+    }
+    return ent;
+}
+
 enum sh4_utlb_translate_result
 sh4_utlb_translate_address(struct Sh4 *sh4, uint32_t *addrp, bool write) {
     uint32_t addr = *addrp;
     unsigned area = (addr >> 29) & 7;
     if (sh4_mmu_at(sh4) && (sh4_addr_in_sq_area(addr) ||
                             (area != 4 && area != 5 && area != 7))) {
-        struct sh4_utlb_ent *ent = sh4_utlb_find_ent_associative(sh4, addr);
+        struct sh4_utlb_ent *ent = sh4_utlb_find_ent_cached(sh4, addr);
         sh4_utlb_increment_urc(sh4);
         if (!ent)
             return SH4_UTLB_MISS;
@@ -945,6 +1030,7 @@ void sh4_mmu_invalidate_tlb(struct Sh4 *sh4) {
         sh4->mem.utlb[idx].valid = false;
     for (idx = 0; idx < SH4_ITLB_LEN; idx++)
         sh4->mem.itlb[idx].valid = false;
+    sh4_soft_tlb_flush(sh4);
 }
 
 void sh4_mmu_do_ldtlb(struct Sh4 *sh4) {
@@ -954,6 +1040,8 @@ void sh4_mmu_do_ldtlb(struct Sh4 *sh4) {
     uint32_t ptel = sh4->reg[SH4_REG_PTEL];
     uint32_t ptea = sh4->reg[SH4_REG_PTEA];
 
+    sh4_soft_tlb_flush(sh4);
+
     ent->asid = pteh & BIT_RANGE(0, 7);
     ent->vpn = pteh & BIT_RANGE(10,31);
     ent->ppn = ptel & BIT_RANGE(10, 28);
@@ -160,15 +160,45 @@ struct sh4_itlb_ent {
     bool tc; // i sincerely hope i never need to understand what this is.
 };
 
+/*
+ * direct-mapped cache in front of sh4_utlb_find_ent_associative, indexed by
+ * 1KB virtual page.  Only hits get cached.  Anything that can change the
+ * result of the associative search (TLB array writes, LDTLB, the ASID in
+ * PTEH, MMUCR.SV or SR.MD) needs to call sh4_soft_tlb_flush.
+ */
+#define SH4_SOFT_TLB_SHIFT 8
+#define SH4_SOFT_TLB_LEN (1 << SH4_SOFT_TLB_SHIFT)
+#define SH4_SOFT_TLB_INVALID 0xffffffff
+
+struct sh4_soft_tlb_ent {
+    uint32_t page; // addr >> 10, or SH4_SOFT_TLB_INVALID
+    struct sh4_utlb_ent *ent;
+};
+
 struct sh4_mem {
     struct memory_map *map;
 
     struct sh4_utlb_ent utlb[SH4_UTLB_LEN];
     struct sh4_itlb_ent itlb[SH4_ITLB_LEN];
+
+    struct sh4_soft_tlb_ent soft_tlb[SH4_SOFT_TLB_LEN];
+
+    /*
+     * main RAM, so that instruction fetches can read straight from the host
+     * buffer instead of going through the memory map.  Any physical address
+     * (after masking off the top three bits) between fetch_first and
+     * fetch_last (inclusive, and already adjusted so that the whole
+     * instruction fits) maps to fetch_host + (addr & fetch_mask).  The range is
+     * empty if the map has no RAM.
+     */
+    uint8_t *fetch_host;
+    uint32_t fetch_first, fetch_last, fetch_mask;
 };
 
 void sh4_set_mem_map(struct Sh4 *sh4, struct memory_map *map);
 
+void sh4_soft_tlb_flush(struct Sh4 *sh4);
+
 extern struct memory_interface sh4_p4_intf;
 
 #ifdef ENABLE_MMU
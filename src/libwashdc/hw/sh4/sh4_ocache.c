@@ -36,6 +36,10 @@
 
 #include "sh4_ocache.h"
 
+#ifdef ENABLE_WATCHPOINTS
+#include "washdc/debugger.h"
+#endif
+
 /*
  * read to/write from the operand cache's RAM-space in situations where we
  * don't actually have a real operand cache available.  It is up to the
@@ -308,6 +312,19 @@ int sh4_sq_pref(Sh4 *sh4, addr32_t addr) {
         memory_map_write32_func write32 = intf->write32;
         uint32_t *sq = sh4->ocache.sq + sq_idx;
 
+        if (intf->write_dwords) {
+            CHECK_W_WATCHPOINT(addr_actual + 0, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 4, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 8, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 12, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 16, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 20, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 24, uint32_t);
+            CHECK_W_WATCHPOINT(addr_actual + 28, uint32_t);
+            intf->write_dwords(addr_actual & mask, sq, 8, ctxt);
+            return MEM_ACCESS_SUCCESS;
+        }
+
         CHECK_W_WATCHPOINT(addr_actual + 0, uint32_t);
         write32((addr_actual + 0) & mask, sq[0], ctxt);
         CHECK_W_WATCHPOINT(addr_actual + 4, uint32_t);
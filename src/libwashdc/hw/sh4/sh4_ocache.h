@@ -58,6 +58,18 @@ void sh4_ocache_cleanup(struct sh4_ocache *ocache);
 
 void sh4_ocache_clear(struct sh4_ocache *ocache);
 
+/*
+ * When the CCR has OCE and ORA set and OIX cleared, bit 13 of an ORA address
+ * selects the half of oc_ram_area and the lower 12 bits are the offset within
+ * that half, so the offset into oc_ram_area is just address &
+ * SH4_ORA_DIRECT_ADDR_MASK.  The native JIT uses this to skip the
+ * memory_interface for ORA accesses.
+ */
+#define SH4_ORA_DIRECT_CCR_MASK \
+    (SH4_CCR_OCE_MASK | SH4_CCR_ORA_MASK | SH4_CCR_OIX_MASK)
+#define SH4_ORA_DIRECT_CCR_VAL (SH4_CCR_OCE_MASK | SH4_CCR_ORA_MASK)
+#define SH4_ORA_DIRECT_ADDR_MASK (SH4_OC_RAM_AREA_SIZE - 1)
+
 /*
  * if ((addr & SH4_SQ_AREA_MASK) == SH4_SQ_AREA_VAL), then the address is a
  * store queue address.
@@ -0,0 +1,148 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+
+#include "washdc/error.h"
+#include "config.h"
+#include "sh4.h"
+#include "sh4_inst.h"
+#include "sh4_read_inst.h"
+#include "sh4_jit.h"
+
+#ifdef DEEP_SYSCALL_TRACE
+#include "deep_syscall_trace.h"
+#endif
+
+#include "sh4_predecode.h"
+
+void sh4_predecode_compile(struct Sh4 *sh4, struct jit_code_block *blk,
+                           addr32_t pc) {
+    struct il_code_block il_blk;
+    struct sh4_jit_compile_ctx ctx = {
+        .last_inst_type = SH4_GROUP_NONE,
+        .cycle_count = 0,
+        .n_side_exits = 0,
+        .sz_bit = sh4_fpscr_sz(sh4),
+        .pr_bit = sh4_fpscr_pr(sh4),
+        .in_delay_slot = false,
+        .dirty_fpscr = false,
+        .have_reg_slot = false
+    };
+
+    /*
+     * the il is thrown away, this is only done so that the jit's disassembler
+     * can find the end of the block and record which pages of main RAM it
+     * came from.
+     */
+    il_code_block_init_arena(&il_blk, &sh4->il_arena);
+#ifdef JIT_PROFILE
+    il_blk.profile = blk->profile;
+#endif
+    unsigned n_insts = sh4_jit_il_code_block_compile(sh4, &ctx, blk,
+                                                     &il_blk, pc) / 2;
+    il_code_block_cleanup(&il_blk);
+    jit_arena_reset(&sh4->il_arena);
+    blk->idle_loop = sh4_jit_idle_loop(sh4, pc, n_insts * 2);
+
+    /*
+     * The last instruction is the one after the end of the block.  It only
+     * gets executed if it's the delay slot of the one before it.
+     */
+    struct predecode_inst *insts =
+        (struct predecode_inst*)malloc(n_insts * sizeof(insts[0]));
+    if (!insts)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    unsigned last_inst_type = SH4_GROUP_NONE;
+    unsigned reg_ready[SH4_JIT_PIPE_N_REGS] = { 0 };
+    bool stall_model = config_get_jit_stall_model();
+    unsigned now = 0;
+    unsigned idx;
+    for (idx = 0; idx < n_insts; idx++) {
+        cpu_inst_param inst =
+            memory_map_read_16(sh4->mem.map, (pc + 2 * idx) & BIT_RANGE(0, 28));
+        InstOpcode const *op = sh4_decode_inst(inst);
+
+        insts[idx].func = sh4_decode_inst_func(inst);
+        insts[idx].inst = inst;
+        unsigned n_cycles = sh4_count_inst_cycles(op, &last_inst_type);
+        if (stall_model)
+            n_cycles = sh4_jit_pipe_cycles(reg_ready, now, inst, n_cycles);
+        insts[idx].cycles = n_cycles;
+        now += n_cycles;
+    }
+
+    blk->predecoded = insts;
+    blk->predecoded_len = n_insts;
+}
+
+unsigned sh4_predecode_exec(struct Sh4 *sh4, struct jit_code_block const *blk) {
+    struct predecode_inst const *inst = blk->predecoded;
+    struct predecode_inst const *last = inst + (blk->predecoded_len - 1);
+    unsigned n_cycles = 0;
+
+#ifdef INVARIANTS
+    if (sh4->delayed_branch || sh4->dont_increment_pc)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    for (; inst != last; inst++) {
+        reg32_t pc = sh4->reg[SH4_REG_PC];
+
+#ifdef DEEP_SYSCALL_TRACE
+        deep_syscall_notify_jump(pc);
+#endif
+
+        n_cycles += inst->cycles;
+        inst->func(sh4, inst->inst);
+
+        if (sh4->dont_increment_pc) {
+            // an exception was just raised
+            sh4->dont_increment_pc = false;
+            sh4->delayed_branch = false;
+            break;
+        }
+
+        if (sh4->delayed_branch) {
+            // the jit never lets a delayed branch go anywhere but the end
+            inst++;
+            n_cycles += inst->cycles;
+            inst->func(sh4, inst->inst);
+            sh4->delayed_branch = false;
+
+            if (sh4->dont_increment_pc) {
+                sh4->dont_increment_pc = false;
+                break;
+            }
+            sh4->reg[SH4_REG_PC] = sh4->delayed_branch_addr;
+            sh4_check_interrupts_no_delay_branch_check(sh4);
+            break;
+        }
+
+        sh4->reg[SH4_REG_PC] += 2;
+        if (sh4->reg[SH4_REG_PC] != pc + 2)
+            break; // non-delayed branch
+    }
+
+    return n_cycles;
+}
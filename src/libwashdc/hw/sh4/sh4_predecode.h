@@ -0,0 +1,48 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef SH4_PREDECODE_H_
+#define SH4_PREDECODE_H_
+
+#include "washdc/types.h"
+#include "jit/code_block.h"
+
+/*
+ * Predecoding interpreter.  This executes the same opcode handlers as
+ * sh4_do_exec_inst, except blocks get fetched and decoded once and then cached
+ * in the jit's code cache as arrays of predecoded instructions.  Block
+ * boundaries are the same ones the jit uses, and blocks get invalidated the
+ * same way jit blocks do.
+ */
+
+struct Sh4;
+
+void sh4_predecode_compile(struct Sh4 *sh4, struct jit_code_block *blk,
+                           addr32_t pc);
+
+/*
+ * execute blk starting from the current PC and return the number of SH4
+ * cycles it took.  The PC will point to the next instruction to execute.
+ */
+unsigned sh4_predecode_exec(struct Sh4 *sh4, struct jit_code_block const *blk);
+
+#endif
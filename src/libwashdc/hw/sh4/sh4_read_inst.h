@@ -61,11 +61,33 @@ sh4_enter_irq_from_meta(Sh4 *sh4, struct sh4_irq_meta *irq_meta) {
     sh4->exec_state = SH4_EXEC_STATE_NORM;
 }
 
-/* check IRQ lines and enter interrupt state if necessary */
+static inline int sh4_intc_imask(Sh4 const *sh4) {
+    return (sh4->reg[SH4_REG_SR] & SH4_SR_IMASK_MASK) >> SH4_SR_IMASK_SHIFT;
+}
+
+/*
+ * returns true if sh4->intc.pending_prio says there might be an IRQ that can
+ * be taken right now.
+ */
+static inline bool sh4_intc_maybe_pending(Sh4 const *sh4) {
+    return !(sh4->reg[SH4_REG_SR] & SH4_SR_BL_MASK) &&
+        sh4->intc.pending_prio > sh4_intc_imask(sh4);
+}
+
+/*
+ * check IRQ lines and enter interrupt state if necessary.  This only has to
+ * poll the lines when the cached summary says something might be pending.
+ */
 static inline void sh4_check_interrupts_no_delay_branch_check(Sh4 *sh4) {
     struct sh4_irq_meta irq_meta;
+    if (!sh4_intc_maybe_pending(sh4))
+        return;
+
+    // the summary is stale if a line dropped without a refresh
     if (sh4_get_next_irq_line(sh4, &irq_meta) >= 0)
         sh4_enter_irq_from_meta(sh4, &irq_meta);
+    else
+        sh4_intc_update(sh4);
 }
 
 /*
@@ -82,11 +104,48 @@ static inline void sh4_refresh_intc(Sh4 *sh4) {
         RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
+    sh4_intc_update(sh4);
     sh4_check_interrupts_no_delay_branch_check(sh4);
 }
 
+static inline uint16_t sh4_fetch_phys(Sh4 *sh4, addr32_t paddr) {
+    if (paddr >= sh4->mem.fetch_first && paddr <= sh4->mem.fetch_last) {
+        uint16_t inst;
+        CHECK_R_WATCHPOINT(paddr, uint16_t);
+        memcpy(&inst, sh4->mem.fetch_host + (paddr & sh4->mem.fetch_mask),
+               sizeof(inst));
+        return inst;
+    }
+    return memory_map_read_16(sh4->mem.map, paddr);
+}
+
+/*
+ * P2 is the only uncacheable area that code can run from (P4 raises an error
+ * in sh4_read_inst).
+ */
+static inline uint16_t
+sh4_fetch_icache(Sh4 *sh4, addr32_t vaddr, addr32_t paddr) {
+    if (!(sh4->reg[SH4_REG_CCR] & SH4_CCR_ICE_MASK) ||
+        (vaddr & BIT_RANGE(29, 31)) == 0xa0000000)
+        return sh4_fetch_phys(sh4, paddr);
+
+    unsigned line_no;
+    if (sh4->reg[SH4_REG_CCR] & SH4_CCR_IIX_MASK) {
+        line_no = ((paddr >> SH4_IC_LINE_SHIFT) & 0x7f) |
+            ((paddr >> (25 - 7)) & 0x80);
+    } else {
+        line_no = (paddr >> SH4_IC_LINE_SHIFT) & (SH4_IC_N_LINES - 1);
+    }
+
+    if (sh4->icache.tag[line_no] !=
+        (paddr & ~(addr32_t)(SH4_IC_LINE_LEN - 1)))
+        sh4_icache_fill(sh4, line_no, paddr);
+    return sh4->icache.line[line_no][(paddr & (SH4_IC_LINE_LEN - 1)) >> 1];
+}
+
 static inline int
 sh4_do_read_inst(Sh4 *sh4, addr32_t addr, cpu_inst_param *inst_p) {
+    WASHDC_UNUSED addr32_t vaddr = addr;
 #ifdef ENABLE_MMU
     switch (sh4_itlb_translate_address(sh4, &addr)) {
     case SH4_ITLB_SUCCESS:
@@ -128,28 +187,15 @@ sh4_do_read_inst(Sh4 *sh4, addr32_t addr, cpu_inst_param *inst_p) {
 #endif
 
     /*
-     * XXX for the interpreter, this function is actually a pretty big
-     * bottleneck.  The problem is that 99.999% of the time when we want to
-     * read an instruction, that instruction comes from the system memory, and
-     * the other 0.001% of the time it comes from the bootrom.  This function
-     * used to speed things up by explicitly checking the address to see if
-     * it's in memory, and if so it would read directly from memory instead of
-     * wasting time parsing through the memory map.
-     *
-     * In the interests of portability and modularity, I had to take out that
-     * optimization because SH4 doesn't have a memory pointer, just a
-     * memory-map pointer.  This only impacts performance on the interpreter, on
-     * the dynarec performance impact is either negligible or nonexistant.
-     *
-     * Actually the dynarec is running a little faster since I removed this
-     * optimization, but I don't understand why.  It shouldn't have had a
-     * positive impact at all, I was expecting either a negligibly small
-     * negative impact or no impact at all.  I can't explain that but I guess
-     * it's good that things are faster lol.
+     * nearly every instruction comes from main RAM, so sh4_fetch_phys checks
+     * for that first and reads it straight out of the host buffer.
      */
     addr &= 0x1fffffff;
 
-    *inst_p = memory_map_read_16(sh4->mem.map, addr);
+    if (sh4->icache.emulate)
+        *inst_p = sh4_fetch_icache(sh4, vaddr, addr);
+    else
+        *inst_p = sh4_fetch_phys(sh4, addr);
     return 0;
 }
 
@@ -209,7 +255,7 @@ sh4_do_exec_inst(Sh4 *sh4) {
     InstOpcode const *op = sh4_decode_inst(inst);
 
     unsigned n_cycles = sh4_count_inst_cycles(op, &sh4->last_inst_type);
-    op->func(sh4, inst);
+    sh4_decode_inst_func(inst)(sh4, inst);
 
     if (sh4->dont_increment_pc) {
         // an exception was just raised
@@ -231,7 +277,7 @@ sh4_do_exec_inst(Sh4 *sh4) {
             sh4_set_exception(sh4, SH4_EXCP_SLOT_ILLEGAL_INST);
             goto the_end;
         }
-        op->func(sh4, inst);
+        sh4_decode_inst_func(inst)(sh4, inst);
 
         if (sh4->dont_increment_pc) {
             sh4->dont_increment_pc = false;
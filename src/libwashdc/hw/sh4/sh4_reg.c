@@ -34,15 +34,8 @@
 #include "config.h"
 #include "sh4_mem.h"
 #include "compiler_bullshit.h"
-
-static struct avl_tree sh4_reg_tree;
-
-struct sh4_avl_node {
-    struct avl_node node;
-
-    // TODO: remove pointer indirection
-    struct Sh4MemMappedReg *reg_info;
-};
+#include "savestate.h"
+#include "intmath.h"
 
 static sh4_reg_val
 sh4_default_read_handler(Sh4 *sh4, struct Sh4MemMappedReg const *reg_info);
@@ -62,6 +55,9 @@ sh4_mmucr_read_handler(Sh4 *sh4,
 static void sh4_mmucr_write_handler(Sh4 *sh4,
                                     struct Sh4MemMappedReg const *reg_info,
                                     sh4_reg_val val);
+static void sh4_pteh_write_handler(Sh4 *sh4,
+                                   struct Sh4MemMappedReg const *reg_info,
+                                   sh4_reg_val val);
 static void
 sh4_ccr_write_handler(Sh4 *sh4,
                       struct Sh4MemMappedReg const *reg_info,
@@ -154,7 +150,7 @@ static struct Sh4MemMappedReg mem_mapped_regs[] = {
     { "QACR1", 0xff00003c, 4, SH4_REG_QACR1, false,
       sh4_default_read_handler, sh4_default_write_handler, 0, 0 },
     { "PTEH", 0xff000000, 4, SH4_REG_PTEH, false,
-      sh4_warn_read_handler, sh4_warn_write_handler, 0, 0 },
+      sh4_warn_read_handler, sh4_pteh_write_handler, 0, 0 },
     { "PTEL", 0xff000004, 4, SH4_REG_PTEL, false,
       sh4_warn_read_handler, sh4_warn_write_handler, 0, 0 },
     { "TTB", 0xff000008, 4, SH4_REG_TTB, false,
@@ -487,32 +483,46 @@ static struct Sh4MemMappedReg mem_mapped_regs[] = {
     { NULL }
 };
 
-static struct avl_node *sh4_reg_avl_ctor(avl_key_type key) {
-    struct sh4_avl_node *node =
-        (struct sh4_avl_node*)calloc(1, sizeof(struct sh4_avl_node));
+/*
+ * direct-indexed lookup table for the on-chip registers.  Every register sits
+ * at 0xff000000 | (module << 18) | offset, where the module number is less
+ * than 64 and the offset is less than 0x100.  That leaves bits 8-17 clear, so
+ * the module and offset together make a 14-bit index.  Each entry is the
+ * register's position in mem_mapped_regs plus one, or 0 if there's no
+ * register at that address.
+ */
+#define SH4_REG_TBL_SHIFT 14
+#define SH4_REG_TBL_LEN (1 << SH4_REG_TBL_SHIFT)
+#define SH4_REG_TBL_ADDR_MASK 0xff03ff00
+#define SH4_REG_TBL_ADDR_VAL  0xff000000
 
-    if (!node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    return &node->node;
-}
+static uint8_t sh4_reg_tbl[SH4_REG_TBL_LEN];
 
-static void sh4_reg_avl_dtor(struct avl_node *node) {
-    struct sh4_avl_node *avl_node = &AVL_DEREF(node, struct sh4_avl_node, node);
-    free(avl_node);
+static inline unsigned sh4_reg_tbl_idx(addr32_t addr) {
+    return ((addr >> 10) & 0x3f00) | (addr & 0xff);
 }
 
 void sh4_init_regs(Sh4 *sh4) {
     sh4_poweron_reset_regs(sh4);
 
-    avl_init(&sh4_reg_tree, sh4_reg_avl_ctor, sh4_reg_avl_dtor);
+    memset(sh4_reg_tbl, 0, sizeof(sh4_reg_tbl));
 
     Sh4MemMappedReg *curs = mem_mapped_regs;
     while (curs->reg_name) {
-        struct avl_node *avl_node = avl_find(&sh4_reg_tree, curs->addr);
-        struct sh4_avl_node *sh4_reg_node = &AVL_DEREF(avl_node,
-                                                       struct sh4_avl_node,
-                                                       node);
-        sh4_reg_node->reg_info = curs;
+        unsigned pos = curs - mem_mapped_regs + 1;
+        if ((curs->addr & SH4_REG_TBL_ADDR_MASK) != SH4_REG_TBL_ADDR_VAL ||
+            pos > UINT8_MAX) {
+            error_set_address(curs->addr);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        uint8_t *ent = sh4_reg_tbl + sh4_reg_tbl_idx(curs->addr);
+        if (*ent) {
+            // two registers at the same address
+            error_set_address(curs->addr);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+        *ent = pos;
         curs++;
     }
 }
@@ -568,10 +578,38 @@ void sh4_poweron_reset_regs(Sh4 *sh4) {
     *sh4_gen_reg(sh4, 15) = 0x8c00f400;
 }
 
+void sh4_reg_area_save(struct savestate_buf *buf, void *ctxt) {
+    Sh4 *sh4 = (Sh4*)ctxt;
+    Sh4MemMappedReg const *curs;
+
+    for (curs = mem_mapped_regs; curs->reg_name; curs++) {
+        if (curs->reg_idx == (sh4_reg_idx_t)-1) {
+            savestate_buf_put(buf, curs->addr - SH4_P4_REGSTART + sh4->reg_area,
+                              curs->len);
+        }
+    }
+}
+
+int sh4_reg_area_load(struct savestate_buf *buf, void *ctxt) {
+    Sh4 *sh4 = (Sh4*)ctxt;
+    Sh4MemMappedReg const *curs;
+
+    for (curs = mem_mapped_regs; curs->reg_name; curs++) {
+        if (curs->reg_idx == (sh4_reg_idx_t)-1 &&
+            savestate_buf_get(buf, curs->addr - SH4_P4_REGSTART + sh4->reg_area,
+                              curs->len) != 0)
+            return -1;
+    }
+
+    return buf->pos == buf->len ? 0 : -1;
+}
+
 static struct Sh4MemMappedReg *find_reg_by_addr(addr32_t addr) {
-    struct avl_node *node = avl_find_noinsert(&sh4_reg_tree, addr);
-    if (node)
-        return AVL_DEREF(node, struct sh4_avl_node, node).reg_info;
+    if ((addr & SH4_REG_TBL_ADDR_MASK) == SH4_REG_TBL_ADDR_VAL) {
+        unsigned pos = sh4_reg_tbl[sh4_reg_tbl_idx(addr)];
+        if (pos)
+            return mem_mapped_regs + (pos - 1);
+    }
 
     if ((addr & SH4_REG_SDMR2_MASK) == SH4_REG_SDMR2_ADDR)
         return &sh4_sdmr2_reg;
@@ -611,6 +649,10 @@ double sh4_read_mem_mapped_reg_double(Sh4 *sh4, addr32_t addr) {
             RAISE_ERROR(ERROR_INVALID_PARAM);                           \
         }                                                               \
                                                                         \
+        /* plain storage, no need to go through the handler */          \
+        if (handler == sh4_default_read_handler)                        \
+            return (type)sh4->reg[mm_reg->reg_idx];                     \
+                                                                        \
         return (type)handler(sh4, mm_reg);                              \
     }
 
@@ -638,6 +680,12 @@ SH4_READ_MEM_MAPPED_REG_TMPL(uint8_t, 8)
             RAISE_ERROR(ERROR_INVALID_PARAM);                           \
         }                                                               \
                                                                         \
+        /* plain storage, no need to go through the handler */          \
+        if (handler == sh4_default_write_handler) {                     \
+            sh4->reg[mm_reg->reg_idx] = val;                            \
+            return;                                                     \
+        }                                                               \
+                                                                        \
         handler(sh4, mm_reg, val);                                      \
     }
 
@@ -710,6 +758,9 @@ static void sh4_mmucr_write_handler(Sh4 *sh4,
             (unsigned)val, (unsigned)sh4->reg[SH4_REG_PC]);
     sh4->reg[SH4_REG_MMUCR] = val;
 
+    // MMUCR.SV changes the results of the UTLB search
+    sh4_soft_tlb_flush(sh4);
+
     if (val & SH4_MMUCR_TI_MASK)
         sh4_mmu_invalidate_tlb(sh4);
 
@@ -738,8 +789,14 @@ static void
 sh4_ccr_write_handler(Sh4 *sh4,
                       struct Sh4MemMappedReg const *reg_info,
                       sh4_reg_val val) {
-    if (config_get_jit())
-        code_cache_invalidate_all();
+    /*
+     * blocks compiled from main RAM get invalidated when something writes to
+     * them, so only the other blocks need to be dropped here.
+     */
+    if (sh4->code_cache)
+        code_cache_invalidate_untracked(sh4->code_cache);
+    if (val & SH4_CCR_ICI_MASK)
+        sh4_icache_invalidate_all(&sh4->icache);
     sh4->reg[SH4_REG_CCR] = val;
 }
 
@@ -796,6 +853,15 @@ sh4_warn_write_handler(Sh4 *sh4, struct Sh4MemMappedReg const *reg_info,
     sh4->reg[reg_info->reg_idx] = val;
 }
 
+static void sh4_pteh_write_handler(Sh4 *sh4,
+                                   struct Sh4MemMappedReg const *reg_info,
+                                   sh4_reg_val val) {
+    // the soft TLB only caches lookups for the current ASID
+    if ((sh4->reg[SH4_REG_PTEH] ^ val) & BIT_RANGE(0, 7))
+        sh4_soft_tlb_flush(sh4);
+    sh4_warn_write_handler(sh4, reg_info, val);
+}
+
 static sh4_reg_val
 sh4_ignore_read_handler(Sh4 *sh4,
                         struct Sh4MemMappedReg const *reg_info) {
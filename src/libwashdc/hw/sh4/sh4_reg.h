@@ -55,12 +55,9 @@ void(*sh4_reg_write_handler)(Sh4 *sh4,
                              sh4_reg_val val);
 
 /*
- * TODO: turn this into a radix tree of some sort.
- *
- * Alternatively, I could turn this into a simple lookup array; this
- * would incur a huge memory overhead (hundreds of MB), but it looks like
- * it would be feasible in the $CURRENT_YEAR and it would net a
- * beautiful O(1) mapping from addr32_t to MemMappedReg.
+ * registers are looked up through a direct-indexed table (see sh4_reg_tbl in
+ * sh4_reg.c), so every register's addr needs to fit the layout described
+ * there.
  */
 struct Sh4MemMappedReg {
     char const *reg_name;
@@ -106,6 +103,14 @@ void sh4_init_regs(Sh4 *sh4);
 // set up the memory-mapped registers for a reset;
 void sh4_poweron_reset_regs(Sh4 *sh4);
 
+/*
+ * save-state section for the registers which don't have a place in sh4->reg
+ * and keep their values in sh4->reg_area instead.  ctxt is the Sh4.
+ */
+struct savestate_buf;
+void sh4_reg_area_save(struct savestate_buf *buf, void *ctxt);
+int sh4_reg_area_load(struct savestate_buf *buf, void *ctxt);
+
 /*
  * called for P4 area write ops that
  * fall in the memory-mapped register range
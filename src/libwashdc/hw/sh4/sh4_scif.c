@@ -47,11 +47,13 @@ static void sh4_scif_rxi_int_handler(struct SchedEvent *event);
 static void sh4_scif_txi_int_handler(struct SchedEvent *event);
 
 static struct SchedEvent sh4_scif_rxi_int_event = {
-    .handler = sh4_scif_rxi_int_handler
+    .handler = sh4_scif_rxi_int_handler,
+    .name = "sh4_scif_rxi_int_handler"
 };
 
 static struct SchedEvent sh4_scif_txi_int_event = {
-    .handler = sh4_scif_txi_int_handler
+    .handler = sh4_scif_txi_int_handler,
+    .name = "sh4_scif_txi_int_handler"
 };
 
 static bool sh4_scif_rxi_int_event_scheduled;
@@ -86,51 +88,39 @@ static inline bool rx_err_interrupt_enabled(Sh4 *sh4) {
     return (bool)(sh4->reg[SH4_REG_SCSCR2] & SH4_SCSCR2_REIE_MASK);
 }
 
-/*
- * receive a character from the rxq into the rx_buf.
- * This function will return true if the operation succeeded.
- */
-static bool recv_char(struct sh4_scif *scif) {
-    if (scif->rx_buf_len >= SCIF_BUF_LEN)
-        return false;
-
-    struct text_ring *rxq = &scif->rxq;
+//  move as much data from the rxq into the rx_buf as will fit
+static void fill_rx_buf(struct sh4_scif *scif) {
+    unsigned n_free = SCIF_BUF_LEN - scif->rx_buf_len;
+    if (!n_free)
+        return;
 
-    if (!text_ring_consume(rxq, scif->rx_buf + scif->rx_buf_len))
-        return false;
-    scif->rx_buf_len++;
+    unsigned n_recv = scif_ring_consume_n(&scif->rxq,
+                                          scif->rx_buf + scif->rx_buf_len,
+                                          n_free);
+    scif->rx_buf_len += n_recv;
 
-    return true;
+#ifdef ENABLE_TCP_SERIAL
+    if (n_recv)
+        serial_server_notify_rx_space();
+#endif
 }
 
 /*
- * similar to recv_char, but for the txq.  This function moves a character from
- * the tx_buf into the txq.  If the operation succeeded, it returns true.  If
- * the operation failed, it returns false.
+ * move as much data from the tx_buf into the txq as will fit.  If the txq is
+ * full then the data stays in the tx_buf, so the software sees a full FIFO
+ * instead of having its data dropped.
  */
-static bool send_char(struct sh4_scif *scif) {
-    if (scif->tx_buf_len <= 0)
-        return false;
-
-    struct text_ring *txq = &scif->txq;
-
-    text_ring_produce(txq, scif->tx_buf[0]);
-    memmove(scif->tx_buf, scif->tx_buf + 1,
-            (SCIF_BUF_LEN - 1) * sizeof(scif->tx_buf[0]));
-    scif->tx_buf_len--;
-
-    return true;
-}
-
-//  get data in the rx_buf if possible
-static void fill_rx_buf(struct sh4_scif *scif) {
-    while (recv_char(scif))
-        ;
-}
-
 static void drain_tx_buf(struct sh4_scif *scif) {
-    while (send_char(scif))
-        ;
+    if (!scif->tx_buf_len)
+        return;
+
+    unsigned n_sent = scif_ring_produce_n(&scif->txq, scif->tx_buf,
+                                          scif->tx_buf_len);
+    if (n_sent) {
+        memmove(scif->tx_buf, scif->tx_buf + n_sent,
+                (scif->tx_buf_len - n_sent) * sizeof(scif->tx_buf[0]));
+        scif->tx_buf_len -= n_sent;
+    }
 }
 
 /*
@@ -144,7 +134,7 @@ static bool read_char(struct sh4_scif *scif, char *char_out) {
     if (scif->rx_buf_len > 0) {
         *char_out = scif->rx_buf[0];
         memmove(scif->rx_buf, scif->rx_buf + 1,
-                (SCIF_BUF_LEN - 1) * sizeof(scif->rx_buf[0]));
+                (scif->rx_buf_len - 1) * sizeof(scif->rx_buf[0]));
         scif->rx_buf_len--;
 
         fill_rx_buf(scif);
@@ -207,8 +197,8 @@ void sh4_scif_init(Sh4 *sh4) {
     sh4_scif *scif = &sh4->scif;
     memset(scif, 0, sizeof(*scif));
 
-    text_ring_init(&scif->rxq);
-    text_ring_init(&scif->txq);
+    scif_ring_init(&scif->rxq);
+    scif_ring_init(&scif->txq);
 
     sh4_register_irq_line(sh4, SH4_IRQ_SCIF, sh4_scif_irq_line, sh4);
     washdc_atomic_flag_test_and_set(&scif->nothing_pending);
@@ -258,6 +248,13 @@ sh4_scfrdr2_reg_read_handler(Sh4 *sh4,
            sh4->scif.dr_read = false;
        }
 
+       /*
+        * re-check the trigger now instead of waiting for the next periodic
+        * event so that a receive ISR can keep going for as long as the rxq has
+        * data.
+        */
+       check_rx_trig(sh4);
+
        return val;
    }
 
@@ -277,6 +274,9 @@ sh4_scftdr2_reg_write_handler(Sh4 *sh4,
         write_char(scif, (char)dat);
 
         serial_server_notify_tx_ready();
+
+        // see the comment in sh4_scfrdr2_reg_read_handler
+        check_tx_trig(sh4);
     }
 #endif
 }
@@ -61,6 +61,14 @@
 
 #define SCIF_BUF_LEN 16
 
+/*
+ * queues between the SCIF and the serial server.  These are a lot bigger than
+ * the text_rings used for logging so that bulk transfers (dcload-style uploads)
+ * don't stall waiting on the io thread.
+ */
+#define SCIF_RING_LOG 16
+DEF_RING(scif_ring, char, SCIF_RING_LOG)
+
 enum sh4_scif_irq_state {
     SH4_SCIF_IRQ_NONE,
     SH4_SCIF_IRQ_RXI = 1,
@@ -70,7 +78,7 @@ enum sh4_scif_irq_state {
 struct sh4_scif {
     // for txq, the SCIF is the producer
     // for rxq, the SCIF is the consumer
-    struct text_ring txq, rxq;
+    struct scif_ring txq, rxq;
 
     /*
      * We dequeue stuff from txq and rxq as often as we can into these two
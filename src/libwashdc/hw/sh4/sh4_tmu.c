@@ -48,7 +48,7 @@ static inline tmu_cycle_t tmu_cycle_stamp();
 static inline bool chan_enabled(Sh4 *sh4, unsigned chan);
 static inline bool chan_int_enabled(Sh4 *sh4, unsigned chan);
 static inline bool chan_enabled(Sh4 *sh4, unsigned chan);
-static inline unsigned chan_clock_div(Sh4 *sh4, unsigned chan);
+static inline unsigned chan_clock_shift(Sh4 *sh4, unsigned chan);
 static void tmu_chan_event_handler(SchedEvent *ev);
 static tmu_cycle_t next_chan_event(Sh4 *sh4, unsigned chan);
 static void chan_event_sched_next(Sh4 *sh4, unsigned chan);
@@ -98,21 +98,18 @@ static inline bool chan_int_enabled(Sh4 *sh4, unsigned chan) {
 }
 
 /*
- * returns the amount by which the TMU clock divides to get he channel clock.
- * multiply this by TMU_DIV to get the SH4 clock.
+ * returns the base-2 log of the amount by which the TMU clock divides to get
+ * the channel clock.  The dividers are 4, 16, 64, 256 and 1024.
  */
-static inline unsigned chan_clock_div(Sh4 *sh4, unsigned chan) {
-    switch(sh4->reg[chan_tcr[chan]] & SH4_TCR_TPSC_MASK) {
+static inline unsigned chan_clock_shift(Sh4 *sh4, unsigned chan) {
+    unsigned tpsc = sh4->reg[chan_tcr[chan]] & SH4_TCR_TPSC_MASK;
+    switch(tpsc) {
     case 0:
-        return 4;
     case 1:
-        return 16;
     case 2:
-        return 64;
     case 3:
-        return 256;
     case 4:
-        return 1024;
+        return 2 * (tpsc + 1);
     default:
         // software shouldn't be doing this anyways
         error_set_value(sh4->reg[chan_tcr[chan]] & SH4_TCR_TPSC_MASK);
@@ -128,10 +125,6 @@ static void tmu_chan_event_handler(SchedEvent *ev) {
     chan_event_sched_next(sh4, chan);
 }
 
-static DEF_ERROR_INT_ATTR(tmu_chan);
-static DEF_ERROR_INT_ATTR(accumulated_ticks);
-static DEF_ERROR_INT_ATTR(clock_divider);
-
 /*
  * TODO: need to hook into the sh4->exec_state so we know to do a tmu_sync
  * when it enters standby, and also not to sync again (other than updating
@@ -148,38 +141,31 @@ static void tmu_chan_sync(Sh4 *sh4, unsigned chan) {
     if (!chan_enabled(sh4, chan))
         return;
 
+    unsigned shift = chan_clock_shift(sh4, chan);
+    tmu_cycle_t accum = sh4->tmu.chan_accum[chan] + elapsed;
+    tmu_cycle_t chan_cycles = accum >> shift;
+    sh4->tmu.chan_accum[chan] = accum & ((1 << shift) - 1);
+
+    if (!chan_cycles)
+        return;
+
     /*
-     * TODO: These clock dividers are all powers of two,
-     * I could be right-shifting here instead of dividing
+     * the flag is set on undeflow, so there are (tcnt + 1) ticks until tcnt
+     * undeflows and the undeflow flag gets set.
+     *
+     * Channels that don't have their interrupt enabled don't get an event at
+     * every underflow, so any number of underflows may have happened since
+     * the last sync.
      */
-    unsigned div = chan_clock_div(sh4, chan);
-    sh4->tmu.chan_accum[chan] += elapsed;
-
-    if (sh4->tmu.chan_accum[chan] >= div) {
-        tmu_cycle_t chan_cycles = sh4->tmu.chan_accum[chan] / div;
-
-        /*
-         * the reason for the + 1 in these comparisions is that the flag is set
-         * on undeflow.  Therefore, there are (tcnt + 1) ticks until tcnt
-         * undeflows and the undeflow flag gets set.
-         */
-        if (chan_cycles == (1 + chan_get_tcnt(sh4, chan))) {
-            chan_set_tcnt(sh4, chan, sh4->reg[chan_tcor[chan]]);
-            sh4->reg[chan_tcr[chan]] |= SH4_TCR_UNF_MASK;
-            sh4_refresh_intc(sh4);
-        } else if (chan_cycles < (1 + chan_get_tcnt(sh4, chan))) {
-            chan_set_tcnt(sh4, chan, chan_get_tcnt(sh4, chan) - chan_cycles);
-        } else {
-            /*
-             * This is considered an error condition because it means that
-             * we're raising the interrupt late.
-             */
-            error_set_tmu_chan(chan);
-            error_set_accumulated_ticks(sh4->tmu.chan_accum[chan]);
-            error_set_clock_divider(div);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-        sh4->tmu.chan_accum[chan] %= div;
+    tmu_cycle_t tcnt = chan_get_tcnt(sh4, chan);
+    if (chan_cycles <= tcnt) {
+        chan_set_tcnt(sh4, chan, tcnt - chan_cycles);
+    } else {
+        tmu_cycle_t period = (tmu_cycle_t)sh4->reg[chan_tcor[chan]] + 1;
+        tmu_cycle_t into_period = (chan_cycles - (tcnt + 1)) % period;
+        chan_set_tcnt(sh4, chan, sh4->reg[chan_tcor[chan]] - into_period);
+        sh4->reg[chan_tcr[chan]] |= SH4_TCR_UNF_MASK;
+        sh4_refresh_intc(sh4);
     }
 }
 
@@ -188,10 +174,13 @@ void sh4_tmu_init(Sh4 *sh4) {
 
     memset(tmu, 0, sizeof(*tmu));
 
+    static char const *ids[3] = { "sh4_tmu0", "sh4_tmu1", "sh4_tmu2" };
     unsigned chan;
     for (chan = 0; chan < 3; chan++) {
         sh4->tmu.tmu_chan_event[chan].handler = tmu_chan_event_handler;
+        sh4->tmu.tmu_chan_event[chan].name = "tmu_chan_event_handler";
         sh4->tmu.tmu_chan_event[chan].arg_ptr = sh4;
+        sched_event_register(sh4->tmu.tmu_chan_event + chan, ids[chan]);
     }
 
     sh4_register_irq_line(sh4, SH4_IRQ_TMU0, sh4_tmu0_irq_line, sh4);
@@ -217,8 +206,9 @@ void sh4_tmu_cleanup(Sh4 *sh4) {
  * function.
  */
 static tmu_cycle_t next_chan_event(Sh4 *sh4, unsigned chan) {
-    tmu_cycle_t clk_div = chan_clock_div(sh4, chan);
-    return (chan_get_tcnt(sh4, chan) + (tmu_cycle_t)1) * clk_div - (tmu_cycle_t)sh4->tmu.chan_accum[chan];
+    unsigned shift = chan_clock_shift(sh4, chan);
+    return ((chan_get_tcnt(sh4, chan) + (tmu_cycle_t)1) << shift) -
+        (tmu_cycle_t)sh4->tmu.chan_accum[chan];
 }
 
 /*
@@ -228,18 +218,17 @@ static tmu_cycle_t next_chan_event(Sh4 *sh4, unsigned chan) {
  * This function will check to make sure that the given channel is
  * enabled and that interrupts are enabled for that channel before it schedules
  * the interrupt.
+ *
+ * Channels without UNIE set don't need an event because nothing can observe
+ * the underflow until TCNT or TCR gets read, and those reads call
+ * tmu_chan_sync, which catches up on however many underflows they missed.
+ * This matters because games commonly leave a channel free-running as a
+ * timebase.
  */
 static void chan_event_sched_next(Sh4 *sh4, unsigned chan) {
     SchedEvent *ev = sh4->tmu.tmu_chan_event + chan;
 
-    /*
-     * It is not a mistake that the following line checks chan_enabled but not
-     * chan_int_enabled.  If the use has enabled the timer channel but not
-     * interrupts for the timer channel, then we want to schedule an event to
-     * reset the TCNT and set the underflow flag.  It's up to the handler to
-     * decide if there needs to be an interrupt when the timer underflows.
-     */
-    if (!chan_enabled(sh4, chan)) {
+    if (!chan_enabled(sh4, chan) || !chan_int_enabled(sh4, chan)) {
         sh4->tmu.chan_event_scheduled[chan] = false;
         return;
     }
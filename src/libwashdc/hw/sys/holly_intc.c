@@ -34,6 +34,10 @@ static reg32_t reg_iml2nrm, reg_iml2ext, reg_iml2err;
 static reg32_t reg_iml4nrm, reg_iml4ext, reg_iml4err;
 static reg32_t reg_iml6nrm, reg_iml6ext, reg_iml6err;
 
+static void (*hblank_on_mask_change)(void*, bool);
+static bool (*hblank_poll)(void*);
+static void *hblank_hook_arg;
+
 struct holly_intp_info {
     char const *desc;
     reg32_t mask;
@@ -141,6 +145,43 @@ void holly_clear_ext_int(HollyExtInt int_type) {
     reg_istext &= ~mask;
 }
 
+bool holly_nrm_int_unmasked(HollyNrmInt int_type) {
+    reg32_t mask = nrm_intp_tbl[int_type].mask;
+    return (reg_iml2nrm | reg_iml4nrm | reg_iml6nrm) & mask;
+}
+
+void holly_intc_set_hblank_hooks(void (*on_mask_change)(void*, bool),
+                                 bool (*poll)(void*), void *arg) {
+    hblank_on_mask_change = on_mask_change;
+    hblank_poll = poll;
+    hblank_hook_arg = arg;
+}
+
+/*
+ * this sets the pending bit directly instead of going through
+ * holly_raise_nrm_int because it gets called from register handlers, and the
+ * interrupt is masked anyways.
+ */
+static void holly_hblank_poll(void) {
+    if (hblank_poll && !holly_nrm_int_unmasked(HOLLY_NRM_INT_HBLANK) &&
+        hblank_poll(hblank_hook_arg))
+        reg_istnrm |= HOLLY_REG_ISTNRM_HBLANK_MASK;
+}
+
+static void holly_set_iml_nrm(reg32_t *reg, reg32_t val) {
+    bool was_unmasked = holly_nrm_int_unmasked(HOLLY_NRM_INT_HBLANK);
+    holly_hblank_poll();
+
+    *reg = val & 0x3fffff;
+
+    bool unmasked = holly_nrm_int_unmasked(HOLLY_NRM_INT_HBLANK);
+    if (unmasked != was_unmasked && hblank_on_mask_change)
+        hblank_on_mask_change(hblank_hook_arg, unmasked);
+
+    // unmasking an interrupt that's already pending raises the IRL line
+    sh4_refresh_intc_deferred(dreamcast_get_cpu());
+}
+
 int holly_intc_irl_line_fn(void *ctx) {
     if ((reg_iml6ext & reg_istext) || (reg_iml6nrm & reg_istnrm))
         return 9;
@@ -154,6 +195,8 @@ int holly_intc_irl_line_fn(void *ctx) {
 
 uint32_t holly_reg_istnrm_mmio_read(struct mmio_region_sys_block *region,
                                     unsigned idx, void *ctxt) {
+    holly_hblank_poll();
+
     reg32_t istnrm_out = reg_istnrm & 0x3fffff;
 
     istnrm_out |= (!!reg_istext) << 30;
@@ -201,7 +244,7 @@ uint32_t holly_reg_iml2nrm_mmio_read(struct mmio_region_sys_block *region,
 
 void holly_reg_iml2nrm_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
-    reg_iml2nrm = val & 0x3fffff;
+    holly_set_iml_nrm(&reg_iml2nrm, val);
 }
 
 uint32_t holly_reg_iml2err_mmio_read(struct mmio_region_sys_block *region,
@@ -222,6 +265,7 @@ uint32_t holly_reg_iml2ext_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml2ext_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml2ext = val & 0xf;
+    sh4_refresh_intc_deferred(dreamcast_get_cpu());
 }
 
 uint32_t holly_reg_iml4nrm_mmio_read(struct mmio_region_sys_block *region,
@@ -231,7 +275,7 @@ uint32_t holly_reg_iml4nrm_mmio_read(struct mmio_region_sys_block *region,
 
 void holly_reg_iml4nrm_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
-    reg_iml4nrm = val & 0x3fffff;
+    holly_set_iml_nrm(&reg_iml4nrm, val);
 }
 
 uint32_t holly_reg_iml4err_mmio_read(struct mmio_region_sys_block *region,
@@ -252,6 +296,7 @@ uint32_t holly_reg_iml4ext_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml4ext_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml4ext = val & 0xf;
+    sh4_refresh_intc_deferred(dreamcast_get_cpu());
 }
 
 uint32_t holly_reg_iml6nrm_mmio_read(struct mmio_region_sys_block *region,
@@ -261,7 +306,7 @@ uint32_t holly_reg_iml6nrm_mmio_read(struct mmio_region_sys_block *region,
 
 void holly_reg_iml6nrm_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
-    reg_iml6nrm = val & 0x3fffff;
+    holly_set_iml_nrm(&reg_iml6nrm, val);
 }
 
 uint32_t holly_reg_iml6err_mmio_read(struct mmio_region_sys_block *region,
@@ -282,4 +327,5 @@ uint32_t holly_reg_iml6ext_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml6ext_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml6ext = val & 0xf;
+    sh4_refresh_intc_deferred(dreamcast_get_cpu());
 }
@@ -24,6 +24,7 @@
 #define HOLLY_INTC_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "washdc/types.h"
 #include "sys_block.h"
@@ -145,6 +146,22 @@ void holly_raise_nrm_int(HollyNrmInt int_type);
 void holly_clear_ext_int(HollyExtInt int_type);
 void holly_clear_nrm_int(HollyNrmInt int_type);
 
+// true if the given interrupt is unmasked in IML2NRM, IML4NRM or IML6NRM
+bool holly_nrm_int_unmasked(HollyNrmInt int_type);
+
+/*
+ * The SPG only schedules H-BLANK events while the H-BLANK interrupt is
+ * unmasked, so it registers these hooks to find out when that changes.
+ *
+ * on_mask_change gets called after an IML*NRM write changes whether H-BLANK
+ * is unmasked.  poll gets called before ISTNRM is read (and before H-BLANK
+ * gets unmasked) while H-BLANK is masked; it returns true if an H-BLANK
+ * happened since the last time the pending bit was set so that software which
+ * polls ISTNRM still sees it.
+ */
+void holly_intc_set_hblank_hooks(void (*on_mask_change)(void*, bool),
+                                 bool (*poll)(void*), void *arg);
+
 uint32_t holly_reg_istnrm_mmio_read(struct mmio_region_sys_block *region,
                                     unsigned idx, void *ctxt);
 void holly_reg_istnrm_mmio_write(struct mmio_region_sys_block *region,
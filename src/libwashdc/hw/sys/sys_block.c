@@ -387,7 +387,11 @@ sys_block_init(struct sys_block_ctxt *ctxt, struct dc_clock *clk,
 
     ctxt->sort_dma_complete_int_event.handler =
         sys_block_sort_dma_complete_int_event_handler;
+    ctxt->sort_dma_complete_int_event.name =
+        "sys_block_sort_dma_complete_int_event_handler";
     ctxt->sort_dma_complete_int_event.arg_ptr = ctxt;
+    sched_event_register(&ctxt->sort_dma_complete_int_event,
+                         "sort_dma_complete_int");
 
     init_mmio_region_sys_block(&ctxt->mmio_region_sys_block, ctxt->reg_backing);
 
@@ -31,8 +31,17 @@ extern "C" {
 #endif
 
 #ifdef ENABLE_WATCHPOINTS
-#define CHECK_R_WATCHPOINT(addr, type) debug_is_r_watch(addr, sizeof(type))
-#define CHECK_W_WATCHPOINT(addr, type) debug_is_w_watch(addr, sizeof(type))
+// see debug_r_watch_pages and debug_w_watch_pages in debugger.h
+#define CHECK_R_WATCHPOINT(addr, type)                                  \
+    do {                                                                \
+        if (debug_is_watch_page(debug_r_watch_pages, (addr)))           \
+            debug_is_r_watch((addr), sizeof(type));                     \
+    } while (0)
+#define CHECK_W_WATCHPOINT(addr, type)                                  \
+    do {                                                                \
+        if (debug_is_watch_page(debug_w_watch_pages, (addr)))           \
+            debug_is_w_watch((addr), sizeof(type));                     \
+    } while (0)
 #else
 #define CHECK_R_WATCHPOINT(addr, type)
 #define CHECK_W_WATCHPOINT(addr, type)
@@ -60,6 +69,15 @@ void(*memory_map_write16_func)(uint32_t addr, uint16_t val, void *ctxt);
 typedef
 void(*memory_map_write8_func)(uint32_t addr, uint8_t val, void *ctxt);
 
+/*
+ * optional handler for writing n_dwords consecutive 32-bit values at once.
+ * Store-queue flushes use this instead of calling write32 for every dword
+ * when the region provides it.
+ */
+typedef
+void(*memory_map_write_dwords_func)(uint32_t addr, uint32_t const *src,
+                                    unsigned n_dwords, void *ctxt);
+
 /*
  * read/write functions which will return an error instead of crashing if the
  * requested address has not been implemented.
@@ -95,7 +113,20 @@ int(*memory_map_try_write8_func)(uint32_t addr, uint8_t val, void *ctxt);
 
 enum memory_map_region_id {
     MEMORY_MAP_REGION_UNKNOWN,
-    MEMORY_MAP_REGION_RAM
+    MEMORY_MAP_REGION_RAM,
+
+    /*
+     * memory which can never be written to, so the value at any given address
+     * is always the same.  The jit can read these at compile-time using the
+     * region's try_read handlers.
+     */
+    MEMORY_MAP_REGION_ROM,
+
+    /*
+     * the SH4's operand-cache RAM.  ctxt is the Sh4, the native JIT uses that
+     * to access the RAM directly when the CCR allows it.
+     */
+    MEMORY_MAP_REGION_ORA
 };
 
 struct memory_interface {
@@ -116,6 +147,9 @@ struct memory_interface {
     memory_map_write16_func write16;
     memory_map_write8_func write8;
 
+    // this can be NULL
+    memory_map_write_dwords_func write_dwords;
+
     memory_map_try_readdouble_func try_readdouble;
     memory_map_try_readfloat_func try_readfloat;
     memory_map_try_read32_func try_read32;
@@ -140,14 +174,40 @@ struct memory_map_region {
     enum memory_map_region_id id;
 
     struct memory_interface const *intf;
+
+    /*
+     * host memory backing this region, for regions which can be accessed
+     * directly instead of going through intf.  Right now this is only set for
+     * MEMORY_MAP_REGION_RAM.
+     */
+    uint8_t *host;
 };
 
 #define MAX_MEM_MAP_REGIONS 64
 
+/*
+ * The page table divides the 32-bit address space into 64KB pages.  Each entry
+ * is either the index of the one region that covers the entire page, or one of
+ * the two values below.  MEMORY_MAP_PAGE_MIXED means that the page is shared
+ * between more than one region (or only partially covered by one), so the
+ * regions need to be searched linearly.  MEMORY_MAP_PAGE_UNMAPPED means that
+ * there are no regions anywhere in the page.
+ */
+#define MEMORY_MAP_PAGE_SHIFT 16
+#define MEMORY_MAP_PAGE_SIZE (1 << MEMORY_MAP_PAGE_SHIFT)
+#define MEMORY_MAP_PAGE_MASK (MEMORY_MAP_PAGE_SIZE - 1)
+#define MEMORY_MAP_N_PAGES (1 << (32 - MEMORY_MAP_PAGE_SHIFT))
+
+#define MEMORY_MAP_PAGE_MIXED 0xfe
+#define MEMORY_MAP_PAGE_UNMAPPED 0xff
+
 struct memory_map {
     struct memory_map_region regions[MAX_MEM_MAP_REGIONS];
     unsigned n_regions;
 
+    // built by memory_map_add, see above
+    uint8_t page_tbl[MEMORY_MAP_N_PAGES];
+
     /*
      * Called when software tries to read/write to an address that is not in
      * any of the regions.
@@ -234,6 +294,16 @@ static inline struct memory_map_region *
 memory_map_get_region(struct memory_map *map,
                       uint32_t first_addr, unsigned n_bytes) {
     uint32_t last_addr = first_addr + (n_bytes - 1);
+
+    // accesses which straddle two pages always take the slow path
+    if (!((first_addr ^ last_addr) >> MEMORY_MAP_PAGE_SHIFT)) {
+        unsigned ent = map->page_tbl[first_addr >> MEMORY_MAP_PAGE_SHIFT];
+        if (ent == MEMORY_MAP_PAGE_UNMAPPED)
+            return NULL;
+        else if (ent != MEMORY_MAP_PAGE_MIXED)
+            return map->regions + ent;
+    }
+
     unsigned region_no;
     for (region_no = 0; region_no < map->n_regions; region_no++) {
         struct memory_map_region *reg = map->regions + region_no;
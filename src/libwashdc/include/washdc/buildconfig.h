@@ -33,6 +33,10 @@ extern "C" {
 
 bool washdc_have_debugger(void);
 bool washdc_have_x86_64_jit(void);
+bool washdc_have_aarch64_jit(void);
+
+// true if either of the native jit backends was built
+bool washdc_have_native_jit(void);
 
 #ifdef __cplusplus
 }
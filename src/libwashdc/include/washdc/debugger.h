@@ -210,6 +210,11 @@ void debug_on_softbreak(cpu_inst_param inst, addr32_t pc);
 int debug_add_break(enum dbg_context_id id, addr32_t addr);
 int debug_remove_break(enum dbg_context_id id, addr32_t addr);
 
+// return true if there's an enabled breakpoint at addr
+bool debug_is_break(enum dbg_context_id id, addr32_t addr);
+
+enum debug_state debug_get_state(enum dbg_context_id id);
+
 // these functions return 0 on success, nonzer on failure
 int debug_add_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len);
 int debug_remove_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len);
@@ -224,6 +229,21 @@ debug_is_w_watch(addr32_t addr, unsigned len);
 bool
 debug_is_r_watch(addr32_t addr, unsigned len);
 
+/*
+ * one bit for every page that an enabled watchpoint could be hit from.  These
+ * let CHECK_R_WATCHPOINT and CHECK_W_WATCHPOINT skip the call to
+ * debug_is_r_watch/debug_is_w_watch for everything else.
+ */
+#define DEBUG_WATCH_PAGE_WORDS (MEMORY_MAP_N_PAGES / 32)
+extern uint32_t debug_r_watch_pages[DEBUG_WATCH_PAGE_WORDS];
+extern uint32_t debug_w_watch_pages[DEBUG_WATCH_PAGE_WORDS];
+
+static inline bool
+debug_is_watch_page(uint32_t const *bitmap, addr32_t addr) {
+    uint32_t page = addr >> MEMORY_MAP_PAGE_SHIFT;
+    return bitmap[page / 32] & (1u << (page % 32));
+}
+
 /*
  * called by the dreamcast code to notify the debugger that a new instruction
  * is about to execute.  This should check for hardware breakpoints and set the
@@ -258,7 +278,9 @@ void debug_request_break(void);
 /*
  * These functions can be called from any thread.  debug_signal will wake up
  * the emulation thread when it is blocking on a debugging-related event.
- * debug_lock must be held when you call debug_signal.
+ * Frontends should call it whenever they have queued up work for their
+ * run_once callback, because the emulation thread sleeps between calls to
+ * debug_run_once instead of polling.
  */
 void debug_lock(void);
 void debug_unlock(void);
@@ -268,7 +290,8 @@ void debug_signal(void);
  * this is called from the emu thread's main loop whenever the dreamcast state
  * is DC_STATE_DEBUG.
  *
- * it is called repeatedly until the dreamcast's state is no longer DC_STATE_DEBUG
+ * it is called repeatedly until the dreamcast's state is no longer
+ * DC_STATE_DEBUG, sleeping in between calls until debug_signal is called.
  */
 void debug_run_once(void);
 
@@ -301,6 +324,20 @@ int debug_read_mem(enum dbg_context_id id, void *out,
 int debug_write_mem(enum dbg_context_id id, void const *input,
                     addr32_t addr, unsigned len);
 
+struct debug_mem_range {
+    addr32_t first, last;
+    bool rom;
+};
+
+/*
+ * fill ranges with up to max_ranges contiguous address ranges which are
+ * mapped in the given context's memory map, in ascending order.  Returns the
+ * total number of ranges, which may be greater than max_ranges.
+ */
+unsigned debug_get_mem_ranges(enum dbg_context_id id,
+                              struct debug_mem_range *ranges,
+                              unsigned max_ranges);
+
 uint32_t debug_pc_next(enum dbg_context_id id);
 
 #ifdef ENABLE_MMU
@@ -108,6 +108,8 @@ static inline void fifo_erase(struct fifo_head *fifo, struct fifo_node *node) {
     }
 
     if (*cursp) {
+        if (fifo->plast == &node->next)
+            fifo->plast = cursp;
         *cursp = node->next;
         node->next = NULL;
     } else {
@@ -155,6 +155,23 @@ void washdc_gameconsole_inject_irq(struct washdc_gameconsole const *cons,
 
 void washdc_dump_main_memory(char const *path);
 
+/*
+ * write the SH4 jit's per-block profile to path as JSON.  This returns
+ * nonzero if the jit isn't running or WashingtonDC wasn't built with
+ * -DJIT_PROFILE=On.
+ */
+int washdc_dump_jit_profile(char const *path);
+
+/*
+ * control the sampling guest profiler.  These all take effect at the end of
+ * the current frame.  washdc_guest_prof_dump writes the samples collected so
+ * far to path as folded stacks.
+ */
+void washdc_guest_prof_start(void);
+void washdc_guest_prof_stop(void);
+void washdc_guest_prof_reset(void);
+void washdc_guest_prof_dump(char const *path);
+
 
 #ifdef __cplusplus
 }
@@ -25,6 +25,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +47,32 @@ extern "C" {
  */
 #define GFX_VERT_LEN 14
 
+/*
+ * vertex array formats.
+ *
+ * GFX_VERT_FMT_FLOAT is the layout described above.
+ *
+ * GFX_VERT_FMT_PACKED is GFX_PACKED_VERT_SIZE bytes per vertex.  The position
+ * is still 4 floats, but the base and offset colors are each 4 unsigned
+ * normalized bytes (in RGBA order) and the texture coordinates are 2 floats.
+ * The offsets below are in terms of bytes.
+ */
+enum gfx_vert_fmt {
+    GFX_VERT_FMT_FLOAT,
+    GFX_VERT_FMT_PACKED
+};
+
+#define GFX_PACKED_VERT_POS_OFFSET 0
+#define GFX_PACKED_VERT_BASE_COLOR_OFFSET 16
+#define GFX_PACKED_VERT_OFFS_COLOR_OFFSET 20
+#define GFX_PACKED_VERT_TEX_COORD_OFFSET 24
+#define GFX_PACKED_VERT_SIZE 32
+
+// size of a single vertex in bytes
+#define GFX_VERT_SIZE(fmt)                                              \
+    ((fmt) == GFX_VERT_FMT_PACKED ?                                     \
+     (size_t)GFX_PACKED_VERT_SIZE : sizeof(float) * (size_t)GFX_VERT_LEN)
+
 /*
  * how to combine a polygon's vertex color with a texture
  */
@@ -134,6 +161,18 @@ struct gfx_rend_param {
 
     // 2x2 texture matrix, row-major
     float tex_transform[4];
+
+    /*
+     * added to texture coordinates after tex_transform.  This is only nonzero
+     * for textures bound with bind_tex.alias.
+     */
+    float tex_offset[2];
+
+    /*
+     * the polygon can be darkened by modifier volumes.  This only gets set
+     * when the mod_vols config option is set.
+     */
+    bool shadow;
 };
 
 #ifdef __cplusplus
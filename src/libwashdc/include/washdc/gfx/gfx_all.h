@@ -23,6 +23,9 @@
 #ifndef WASHDC_GFX_H_
 #define WASHDC_GFX_H_
 
+#include <stddef.h>
+#include <stdbool.h>
+
 #include "config.h"
 #include "def.h"
 #include "washdc/gfx/gfx_il.h"
@@ -37,6 +40,23 @@ struct gfx_rend_if {
     void (*cleanup)(void);
 
     void (*exec_gfx_il)(struct gfx_il_inst *cmd, unsigned n_cmd);
+
+    /*
+     * Optional persistently-mapped vertex buffers.  These are only ever called
+     * from whichever thread owns the graphics context.
+     *
+     * map_vert_bufs allocates n_bufs buffers of buf_len bytes each which stay
+     * mapped for as long as the renderer is running, and returns a pointer to
+     * the first one (the rest follow it contiguously).  It returns NULL if the
+     * renderer can't do this.
+     *
+     * vert_buf_done returns true if the GPU has finished every draw that was
+     * submitted before the last GFX_IL_FENCE_VERT_BUF for buf_no.  If wait is
+     * true, it blocks until that happens.
+     */
+    void *(*map_vert_bufs)(unsigned n_bufs, size_t buf_len);
+    void (*unmap_vert_bufs)(void);
+    bool (*vert_buf_done)(unsigned buf_no, bool wait);
 };
 
 #ifdef __cplusplus
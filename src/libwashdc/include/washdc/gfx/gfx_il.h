@@ -24,6 +24,7 @@
 #define GFX_IL_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "washdc/gfx/def.h"
 #include "washdc/gfx/obj.h"
@@ -104,7 +105,75 @@ enum gfx_il {
      * GFX_IL_END_DEPTH_SORT will be depth-sorted.
      */
     GFX_IL_BEGIN_DEPTH_SORT,
-    GFX_IL_END_DEPTH_SORT
+    GFX_IL_END_DEPTH_SORT,
+
+    /*
+     * upload the palette used by GFX_TEX_FMT_PAL_INDEX16 textures.  This only
+     * gets sent to renderers that do their own palette lookups.
+     */
+    GFX_IL_SET_PALETTE,
+
+    /*
+     * mark the point after which the GPU is done reading from a persistent
+     * vertex buffer (see gfx_vert_buf_release).  This only gets sent to
+     * renderers that implement map_vert_bufs.
+     */
+    GFX_IL_FENCE_VERT_BUF,
+
+    /*
+     * upload an array of vertex indices for GFX_IL_DRAW_INDEXED_VERT_ARRAY.
+     * This only gets sent when the merge_draws config option is set.
+     */
+    GFX_IL_SET_INDEX_ARRAY,
+
+    /*
+     * render triangle strips from the vertex array using a subset of the index
+     * array.  GFX_IL_RESTART_IDX separates one strip from the next.
+     */
+    GFX_IL_DRAW_INDEXED_VERT_ARRAY,
+
+    /*
+     * start copying a render target back to host memory without waiting for
+     * it to finish.  A GFX_IL_READ_OBJ of the same obj can use the result if
+     * nothing has been rendered into the obj in the meantime.  This only
+     * gets sent when the async_readback config option is set.
+     */
+    GFX_IL_PREFETCH_OBJ,
+
+    /*
+     * rasterize a modifier volume from the vertex array as a triangle list
+     * and mark every pixel of the current frame which is inside of it.  This
+     * doesn't write to the color or depth buffers.  This only gets sent when
+     * the mod_vols config option is set.
+     */
+    GFX_IL_DRAW_MOD_VOL,
+
+    /*
+     * darken every pixel which is inside of a modifier volume and which was
+     * last drawn by a polygon with gfx_rend_param.shadow set, and then forget
+     * about all the modifier volumes drawn so far.  This only gets sent when
+     * the mod_vols config option is set.
+     */
+    GFX_IL_APPLY_MOD_VOL
+};
+
+// primitive restart index for GFX_IL_DRAW_INDEXED_VERT_ARRAY
+#define GFX_IL_RESTART_IDX 0xffffffff
+
+// pixel formats for post_framebuffer.raw_fmt
+enum gfx_fb_raw_fmt {
+    // already converted to RGBA8888
+    GFX_FB_RAW_NONE,
+
+    // 16-bit pixels
+    GFX_FB_RAW_RGB555,
+    GFX_FB_RAW_RGB565,
+
+    // three bytes per pixel, blue first
+    GFX_FB_RAW_RGB888,
+
+    // 32-bit 0x00RRGGBB pixels
+    GFX_FB_RAW_RGB0888
 };
 
 struct gfx_framebuffer {
@@ -120,6 +189,21 @@ union gfx_il_arg {
         unsigned tex_no;
         enum gfx_tex_fmt pix_fmt;
         int width, height;
+
+        /*
+         * if true, the gfx_obj holds the full mip chain, starting with the
+         * width x height level and halving it down to 1x1.
+         */
+        bool mipmap;
+
+        /*
+         * if true, the gfx_obj is a render target and the texture samples
+         * whatever was last rendered into it.  Writes to the gfx_obj don't
+         * update the texture, and the renderer does not need to honor
+         * pix_fmt.  This only gets sent when the fb_tex_alias config option
+         * is set.
+         */
+        bool alias;
     } bind_tex;
 
     struct {
@@ -185,12 +269,20 @@ union gfx_il_arg {
         /*
          * each vert has a len of GFX_IL_VERT_LEN; ergo the total length of
          * verts (in terms of sizeof float) is n_verts * GFX_IL_VERT_LEN.
+         * That's for GFX_VERT_FMT_FLOAT; in general each vert is
+         * GFX_VERT_SIZE(fmt) bytes.
          *
          * note that the contents of verts can be modified by the gfx_il
          * implementation; contents after drawing are undefined.
+         *
+         * if buf_no is not -1 then verts points into the persistent vertex
+         * buffer buf_no and the renderer reads it from there instead of
+         * uploading it.
          */
         unsigned n_verts;
         float const *verts;
+        int buf_no;
+        enum gfx_vert_fmt fmt;
     } set_vert_array;
 
     struct {
@@ -198,6 +290,35 @@ union gfx_il_arg {
         unsigned n_verts;
     } draw_vert_array;
 
+    struct {
+        unsigned n_idx;
+        uint32_t const *idx;
+    } set_index_array;
+
+    struct {
+        unsigned first_idx;
+        unsigned n_idx;
+    } draw_indexed_vert_array;
+
+    struct {
+        unsigned first_idx;
+        unsigned n_verts;
+    } draw_mod_vol;
+
+    struct {
+        // the shadowed pixels get multiplied by this (0.0 to 1.0)
+        float scale;
+    } apply_mod_vol;
+
+    struct {
+        // GFX_PALETTE_LEN entries in GFX_TEX_FMT_ARGB_8888 format
+        uint32_t const *dat;
+    } set_palette;
+
+    struct {
+        unsigned buf_no;
+    } fence_vert_buf;
+
     struct {
         int obj_no;
         size_t n_bytes;
@@ -215,6 +336,10 @@ union gfx_il_arg {
         size_t n_bytes;
     } read_obj;
 
+    struct {
+        int obj_no;
+    } prefetch_obj;
+
     struct {
         int obj_no;
     } free_obj;
@@ -224,6 +349,16 @@ union gfx_il_arg {
         unsigned width, height;
         bool vert_flip;
         bool interlaced;
+
+        /*
+         * if this is not GFX_FB_RAW_NONE then the obj holds the framebuffer
+         * exactly as it was in texture memory, with rows packed together.
+         * Interlaced framebuffers have all of the first field's rows
+         * followed by all of the second field's.  concat is FB_R_CTRL's
+         * fb_concat, which only matters for the 16-bit formats.
+         */
+        enum gfx_fb_raw_fmt raw_fmt;
+        unsigned concat;
     } post_framebuffer;
 
     struct {
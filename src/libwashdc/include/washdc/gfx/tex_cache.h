@@ -36,9 +36,18 @@ enum gfx_tex_fmt {
     GFX_TEX_FMT_ARGB_8888,
     GFX_TEX_FMT_YUV_422,
 
+    /*
+     * 16-bit indices into the palette most recently sent with
+     * GFX_IL_SET_PALETTE.  The renderer does the palette lookup itself.
+     */
+    GFX_TEX_FMT_PAL_INDEX16,
+
     GFX_TEX_FMT_COUNT
 };
 
+// number of entries in the palette sent with GFX_IL_SET_PALETTE
+#define GFX_PALETTE_LEN 1024
+
 /*
  * This is the gfx_thread's copy of the texture cache.  It mirrors the one
  * in the geo_buf code, and is updated every time a new geo_buf is submitted by
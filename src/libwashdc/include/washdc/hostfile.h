@@ -23,6 +23,7 @@
 #ifndef WASHDC_HOSTFILE_H_
 #define WASHDC_HOSTFILE_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -48,6 +49,25 @@ enum washdc_hostfile_seek_origin {
 
 #define WASHDC_HOSTFILE_EOF 0xfeedface
 
+// one buffer of a scatter read
+struct washdc_hostfile_iov {
+    void *outp;
+    size_t len;
+};
+
+/*
+ * an asynchronous read of len bytes at offset offs into outp.  The caller
+ * fills in outp, len and offs; priv belongs to the implementation until the
+ * read has been waited on, and n_read is only valid after that.
+ */
+struct washdc_hostfile_aio {
+    void *outp;
+    size_t len;
+    long offs;
+    size_t n_read;
+    void *priv;
+};
+
 struct washdc_hostfile_api {
     washdc_hostfile(*open)(char const *path, enum washdc_hostfile_mode mode);
     void(*close)(washdc_hostfile file);
@@ -61,6 +81,29 @@ struct washdc_hostfile_api {
     washdc_hostfile(*open_cfg_file)(enum washdc_hostfile_mode mode);
     washdc_hostfile(*open_screenshot)(char const *name, enum washdc_hostfile_mode mode);
 
+    /*
+     * Everything from here down to pathsep is optional and may be NULL.
+     *
+     * pread and preadv read at an absolute offset without moving the file
+     * position, so more than one thread can read from a file at once.  They
+     * don't see data which is still sitting in a write buffer.
+     *
+     * map returns a read-only view of the entire file and its length, or
+     * NULL if the file can't be mapped.
+     *
+     * aio_submit starts a positional read and returns nonzero if it could
+     * not be submitted; aio_wait blocks until it finishes and returns the
+     * number of bytes read.  Every submitted read must be waited on.
+     */
+    size_t(*pread)(washdc_hostfile file, void *outp, size_t len, long offs);
+    size_t(*preadv)(washdc_hostfile file,
+                    struct washdc_hostfile_iov const *iov,
+                    unsigned n_iov, long offs);
+    void const*(*map)(washdc_hostfile file, size_t *len);
+    void(*unmap)(washdc_hostfile file, void const *map, size_t len);
+    int(*aio_submit)(washdc_hostfile file, struct washdc_hostfile_aio *aio);
+    size_t(*aio_wait)(washdc_hostfile file, struct washdc_hostfile_aio *aio);
+
     char pathsep;
 };
 
@@ -79,6 +122,32 @@ size_t washdc_hostfile_read(washdc_hostfile file, void *outp, size_t len);
 size_t washdc_hostfile_write(washdc_hostfile file, void const *inp, size_t len);
 int washdc_hostfile_flush(washdc_hostfile file);
 
+/*
+ * When the frontend doesn't provide pread, these fall back to a seek followed
+ * by a read.  That moves the file position and isn't safe to do from more
+ * than one thread at a time; washdc_hostfile_has_pread says which one you're
+ * going to get.
+ */
+bool washdc_hostfile_has_pread(void);
+size_t washdc_hostfile_pread(washdc_hostfile file, void *outp,
+                             size_t len, long offs);
+size_t washdc_hostfile_preadv(washdc_hostfile file,
+                              struct washdc_hostfile_iov const *iov,
+                              unsigned n_iov, long offs);
+
+// returns NULL if the frontend can't map files
+void const *washdc_hostfile_map(washdc_hostfile file, size_t *len);
+void washdc_hostfile_unmap(washdc_hostfile file, void const *map, size_t len);
+
+/*
+ * without frontend support the read happens synchronously inside
+ * washdc_hostfile_aio_submit.
+ */
+int washdc_hostfile_aio_submit(washdc_hostfile file,
+                               struct washdc_hostfile_aio *aio);
+size_t washdc_hostfile_aio_wait(washdc_hostfile file,
+                                struct washdc_hostfile_aio *aio);
+
 int washdc_hostfile_putc(washdc_hostfile file, char ch);
 int washdc_hostfile_puts(washdc_hostfile file, char const *str);
 int washdc_hostfile_getc(washdc_hostfile file);
@@ -39,8 +39,14 @@ extern "C" {
  * producer-side.
  *
  * This ringbuffer is SINGLE CONSUMER, SINGLE PRODUCER ONLY!
+ *
+ * prod_idx and cons_idx live on separate cache lines, each next to that
+ * side's private copy of the other side's index.  The producer only looks at
+ * cons_idx when its copy says the ring is full (and vice-versa), so in the
+ * common case neither side touches the other's cache line.
  */
 
+#define RING_CACHE_LINE 64
 
 #define RING_INITIALIZER                                                \
     { .prod_idx = WASHDC_ATOMIC_INT_INIT(0), .cons_idx = WASHDC_ATOMIC_INT_INIT(0) }
@@ -48,69 +54,106 @@ extern "C" {
 
 #define DEF_RING(name, tp, log)                                         \
     struct name {                                                       \
-        washdc_atomic_int prod_idx, cons_idx;                           \
+        char pad_head[RING_CACHE_LINE];                                 \
+                                                                        \
+        /* written by the producer */                                   \
+        washdc_atomic_int prod_idx;                                     \
+        int prod_cons_idx; /* the producer's last look at cons_idx */   \
+        char pad_prod[RING_CACHE_LINE];                                 \
+                                                                        \
+        /* written by the consumer */                                   \
+        washdc_atomic_int cons_idx;                                     \
+        int cons_prod_idx; /* the consumer's last look at prod_idx */   \
+        char pad_cons[RING_CACHE_LINE];                                 \
                                                                         \
         tp buf[1 << (log)];                                             \
     };                                                                  \
                                                                         \
     static inline void name##_init(struct name *ring) {                 \
-        ring->prod_idx = WASHDC_ATOMIC_INT_INIT(0);                     \
-        ring->cons_idx = WASHDC_ATOMIC_INT_INIT(0);                     \
+        washdc_atomic_int_init(&ring->prod_idx, 0);                     \
+        washdc_atomic_int_init(&ring->cons_idx, 0);                     \
+        ring->prod_cons_idx = 0;                                        \
+        ring->cons_prod_idx = 0;                                        \
     }                                                                   \
                                                                         \
-    /* return true if the operation succeeded, false if it failed. */   \
-    static inline bool                                                  \
-    name##_produce(struct name *ring, tp val) {                         \
-        int prod_idx = washdc_atomic_int_load(&ring->prod_idx);         \
-        /*memory_order_acquire); */                                     \
-        int cons_idx = washdc_atomic_int_load(&ring->cons_idx);         \
-        /* memory_order_acquire); */                                    \
-        int next_prod_idx = (prod_idx + 1) & ((1 << (log)) - 1);        \
+    /*                                                                  \
+     * produce up to n_vals elements at once.  This only publishes the  \
+     * producer index once, so it's much cheaper than calling produce   \
+     * in a loop.  Returns the number of elements actually produced,    \
+     * which may be less than n_vals if the ring fills up.  Unlike      \
+     * produce, this does not log anything when it runs out of space.   \
+     */                                                                 \
+    static inline unsigned                                              \
+    name##_produce_n(struct name *ring, tp const *vals,                 \
+                     unsigned n_vals) {                                 \
+        int const mask = (1 << (log)) - 1;                              \
+        int prod_idx = washdc_atomic_int_load_relaxed(&ring->prod_idx); \
+        unsigned n_free =                                               \
+            (unsigned)((ring->prod_cons_idx - prod_idx - 1) & mask);    \
+        unsigned n_done;                                                \
                                                                         \
-        if (next_prod_idx == cons_idx) {                                \
-            washdc_log_warn("WARNING: text_ring character dropped\n");  \
-            return false;                                               \
+        if (n_vals > n_free) {                                          \
+            ring->prod_cons_idx =                                       \
+                washdc_atomic_int_load_acquire(&ring->cons_idx);        \
+            n_free =                                                    \
+                (unsigned)((ring->prod_cons_idx - prod_idx - 1) & mask);\
+            if (n_vals > n_free)                                        \
+                n_vals = n_free;                                        \
         }                                                               \
+        for (n_done = 0; n_done < n_vals; n_done++)                     \
+            ring->buf[(prod_idx + n_done) & mask] = vals[n_done];       \
                                                                         \
-        ring->buf[prod_idx] = val;                                      \
-        if (!washdc_atomic_int_compare_exchange(&ring->prod_idx,        \
-                                                &prod_idx,              \
-                                                next_prod_idx)) {       \
-            washdc_log_error("%s failed to update ring - THIS IS FOR "  \
-                             "SINGLE-PRODUCER ONLY YOU DOOFUS\n",       \
-                             __func__);                                 \
-            return false;                                               \
+        if (n_done) {                                                   \
+            washdc_atomic_int_store_release(&ring->prod_idx,            \
+                                            (prod_idx + n_done) & mask);\
         }                                                               \
-                                                                        \
-        return true;                                                    \
+        return n_done;                                                  \
     }                                                                   \
                                                                         \
-    /* return true if the operation succeeded, false if it failed. */   \
-    static inline bool                                                  \
-    name##_consume(struct name *ring, tp *outp) {                       \
-        int prod_idx, cons_idx, next_cons_idx;                          \
+    /*                                                                  \
+     * consume up to max_vals elements at once.  Returns the number of  \
+     * elements actually consumed.                                      \
+     */                                                                 \
+    static inline unsigned                                              \
+    name##_consume_n(struct name *ring, tp *outp, unsigned max_vals) {  \
+        int const mask = (1 << (log)) - 1;                              \
+        int cons_idx = washdc_atomic_int_load_relaxed(&ring->cons_idx); \
+        unsigned n_avail =                                              \
+            (unsigned)((ring->cons_prod_idx - cons_idx) & mask);        \
+        unsigned n_done;                                                \
                                                                         \
-        /* TODO: can I use memory_order_relaxed to load cons_idx ?*/    \
-        cons_idx = washdc_atomic_int_load(&ring->cons_idx);             \
-        /* memory_order_acquire); */                                    \
-        prod_idx = washdc_atomic_int_load(&ring->prod_idx);             \
-        /* memory_order_acquire); */                                    \
-        next_cons_idx = (cons_idx + 1) & ((1 << (log)) - 1);            \
+        if (max_vals > n_avail) {                                       \
+            ring->cons_prod_idx =                                       \
+                washdc_atomic_int_load_acquire(&ring->prod_idx);        \
+            n_avail =                                                   \
+                (unsigned)((ring->cons_prod_idx - cons_idx) & mask);    \
+            if (max_vals > n_avail)                                     \
+                max_vals = n_avail;                                     \
+        }                                                               \
+        for (n_done = 0; n_done < max_vals; n_done++)                   \
+            outp[n_done] = ring->buf[(cons_idx + n_done) & mask];       \
                                                                         \
-        if (prod_idx == cons_idx)                                       \
-            return false;                                               \
+        if (n_done) {                                                   \
+            washdc_atomic_int_store_release(&ring->cons_idx,            \
+                                            (cons_idx + n_done) & mask);\
+        }                                                               \
+        return n_done;                                                  \
+    }                                                                   \
                                                                         \
-        *outp = ring->buf[ring->cons_idx];                              \
-        if (!washdc_atomic_int_compare_exchange(&ring->cons_idx,        \
-                                                &cons_idx,              \
-                                                next_cons_idx)) {       \
-            washdc_log_error("%s failed to update ring - THIS IS FOR "  \
-                             "SINGLE-CONSUMER ONLY YOU DOOFUS\n",       \
-                             __func__);                                 \
+    /* return true if the operation succeeded, false if it failed. */   \
+    static inline bool                                                  \
+    name##_produce(struct name *ring, tp val) {                         \
+        if (!name##_produce_n(ring, &val, 1)) {                         \
+            washdc_log_warn("WARNING: text_ring character dropped\n");  \
             return false;                                               \
         }                                                               \
-                                                                        \
         return true;                                                    \
+    }                                                                   \
+                                                                        \
+    /* return true if the operation succeeded, false if it failed. */   \
+    static inline bool                                                  \
+    name##_consume(struct name *ring, tp *outp) {                       \
+        return name##_consume_n(ring, outp, 1) == 1;                    \
     }                                                                   \
 
 DEF_RING(text_ring, char, 10)
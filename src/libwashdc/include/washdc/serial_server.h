@@ -30,11 +30,25 @@ extern "C" {
 void washdc_serial_server_rx(char ch);
 int washdc_serial_server_tx(char *ch); // returns 0 iff success
 
+/*
+ * bulk versions of the above.  These return the number of characters actually
+ * transferred.  If washdc_serial_server_rx_n can't take everything then
+ * notify_rx_space will get called once there's room for more.
+ */
+unsigned washdc_serial_server_rx_n(char const *dat, unsigned n_chars);
+unsigned washdc_serial_server_tx_n(char *buf, unsigned max_chars);
+
 void washdc_serial_server_cts(void);
 
 struct serial_server_intf {
     void (*attach)(void);
     void (*notify_tx_ready)(void);
+
+    /*
+     * called from the emulation thread when the SCIF frees up space after
+     * washdc_serial_server_rx_n came up short.
+     */
+    void (*notify_rx_space)(void);
 };
 
 #ifdef __cplusplus
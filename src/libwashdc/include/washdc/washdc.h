@@ -23,6 +23,7 @@
 #ifndef LIBWASHDC_H_
 #define LIBWASHDC_H_
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -113,14 +114,32 @@ struct washdc_launch_settings {
 
     bool log_to_stdout;
     bool log_verbose;
+
+    // drop log messages instead of stalling when the logger thread falls behind
+    bool log_drop_on_overflow;
     /* #ifdef ENABLE_DEBUGGER */
     bool dbg_enable;
     bool washdbg_enable;
     /* #endif */
     bool inline_mem;
     bool enable_jit;
-    /* #ifdef ENABLE_JIT_X86_64 */
+    /* #ifdef ENABLE_JIT_NATIVE */
     bool enable_native_jit;
+
+    // map jit code writable and executable through two different views
+    bool jit_dual_map;
+
+    // map guest RAM into host address space for the native jit
+    bool jit_fastmem;
+
+    // interpret blocks until they're hot enough to compile natively
+    bool jit_tiered;
+
+    // write native block addresses to /tmp/perf-<pid>.map for perf(1)
+    bool jit_perf_map;
+
+    // compile hot blocks natively on a background thread
+    bool jit_bg_compile;
     /* #endif */
     bool cmd_session;
     bool enable_serial;
@@ -130,12 +149,334 @@ struct washdc_launch_settings {
 
     bool dump_mem_on_error;
 
+    /*
+     * if true, the gfx_rend_if will be driven from a separate render thread.
+     * The frontend must not touch the graphics context from any other thread
+     * except through washdc_gfx_run_sync.
+     */
+    bool rend_thread;
+
+    // if true, the ARM7 will run on a separate thread from the SH4
+    bool arm7_thread;
+
+    // if true, the ARM7 will use the jit instead of the interpreter
+    bool arm7_jit;
+
+    // if true, ARM7 busy-wait loops skip ahead to the next scheduled event
+    bool arm7_idle_skip;
+
+    // if true, the SH4 interpreter emulates the instruction cache
+    bool sh4_icache;
+
+    // if true, SH4 FPU opcodes check for denormals and invalid operations
+    bool fpu_pedantic;
+
+    // if true, the SH4 interpreter will cache blocks of predecoded instructions
+    bool intp_predecode;
+
+    // if true, SH4 jit blocks can continue past forward conditional branches
+    bool jit_superblocks;
+
+    // if true, SH4 busy-wait loops skip ahead to the next scheduled event
+    bool jit_idle_skip;
+
+    // if true, SH4 jit blocks are charged for load-use and FPU latency stalls
+    bool jit_stall_model;
+
+    // if true, SH4 jit blocks are saved to path_jit_cache between runs
+    bool jit_persist_cache;
+    char const *path_jit_cache;
+
+    // megabytes the SH4 code cache can use before it starts over, 0 for no limit
+    int jit_cache_budget;
+
+    /*
+     * if true, paletted textures are sent to the renderer as palette indices
+     * and the renderer looks them up itself.  The renderer has to support
+     * GFX_IL_SET_PALETTE.
+     */
+    bool gpu_palette;
+
+    /*
+     * if true, display list vertices are written directly into GPU buffers.
+     * This is ignored if the renderer doesn't support persistent vertex
+     * buffers.
+     */
+    bool persistent_verts;
+
+    /*
+     * if true, display list vertices are sent to the renderer in
+     * GFX_VERT_FMT_PACKED.  The renderer has to support that format.
+     */
+    bool packed_verts;
+
+    /*
+     * if true, consecutive triangle strips with the same render state are
+     * merged into indexed draws.  The renderer has to support
+     * GFX_IL_DRAW_INDEXED_VERT_ARRAY.
+     */
+    bool merge_draws;
+
+    /*
+     * if true, opaque modifier volumes get drawn.  The renderer has to
+     * support GFX_IL_DRAW_MOD_VOL and GFX_IL_APPLY_MOD_VOL.
+     */
+    bool mod_vols;
+
+    /*
+     * if true, translucent polygons get sorted by depth before they're sent
+     * to the renderer, and GFX_IL_BEGIN_DEPTH_SORT/GFX_IL_END_DEPTH_SORT are
+     * never sent.  This is for renderers that don't have their own
+     * order-independent transparency.
+     */
+    bool poly_sort;
+
+    /*
+     * if true, the gfx_il stream for a display list is reused by the next
+     * frame when that frame's display list is identical.
+     */
+    bool list_cache;
+
+    /*
+     * if true, the polygon groups of each display list get turned into
+     * gfx_il on separate threads.
+     */
+    bool list_exec_threads;
+
+    /*
+     * if true, framebuffers that get sampled as textures stay on the host
+     * instead of being copied back to texture memory.  The renderer has to
+     * support bind_tex.alias.
+     */
+    bool fb_tex_alias;
+
+    /*
+     * if true, framebuffers which are likely to be read back get copied to
+     * host memory asynchronously when they finish rendering.  The renderer
+     * has to support GFX_IL_PREFETCH_OBJ.
+     */
+    bool async_readback;
+
+    /*
+     * if true, framebuffers read out of texture memory are posted in the
+     * guest's pixel format and the renderer does the conversion and the
+     * interlace weave.  The renderer has to support
+     * post_framebuffer.raw_fmt.
+     */
+    bool gpu_fb_conv;
+
+    /*
+     * if true, the emulation thread doesn't wait for the render thread to
+     * present the previous frame, and frames the render thread falls behind
+     * on are dropped.  This is ignored unless rend_thread is set.
+     */
+    bool present_mailbox;
+
+    /*
+     * if true, save-state checkpoints get written by a forked child process
+     * so that the emulator doesn't have to stop while memory is copied.  This
+     * is only supported on Linux.
+     */
+    bool savestate_fork;
+
+    /*
+     * take a rewind snapshot every rewind_interval frames and keep up to
+     * rewind_budget megabytes of them for washdc_rewind.  Rewind is disabled
+     * if either of these is 0.
+     */
+    int rewind_interval;
+    int rewind_budget;
+
+    /*
+     * if more than 0, keep in-memory snapshots of the last rollback_frames
+     * frames (up to 30) for washdc_rollback.  rollback_input gets called on
+     * the emulation thread before every frame, including frames that get
+     * simulated again after a rollback, with the number of that frame so
+     * that the frontend can set the controllers up the way they were (or
+     * should have been) on that frame.  It can be NULL.
+     */
+    int rollback_frames;
+    void (*rollback_input)(unsigned frame_no);
+
+    /*
+     * if non-NULL, controller input is recorded to path_replay_record, or
+     * played back from path_replay_play in place of the host's input.
+     */
+    char const *path_replay_record;
+    char const *path_replay_play;
+
+    /*
+     * if more than 0, run for this many frames, then exit and print a JSON
+     * report of the frame rate and where the host's time went to stdout.
+     */
+    int bench_frames;
+
+    /*
+     * if more than 0, count the heap allocations made on the emulation thread
+     * after this many frames and log where they came from.  The count goes
+     * into the bench_frames report.  This only works in builds with
+     * ENABLE_ALLOC_AUDIT.
+     */
+    int alloc_audit_frames;
+
+    /*
+     * if non-NULL, write a timeline of scheduler events, frame phases,
+     * rendering and GD-ROM reads to path_trace as Chrome trace-event JSON.
+     */
+    char const *path_trace;
+
+    /*
+     * if non-NULL, sample the guest's PC and call stack and write the samples
+     * to path_guest_prof at exit as folded stacks (one line per stack, the
+     * format flamegraph.pl takes).  Function names come from the ELF at
+     * path_guest_prof_syms if it's set.  guest_prof_interval_us is the time
+     * between samples, or 0 for the default.
+     */
+    char const *path_guest_prof;
+    char const *path_guest_prof_syms;
+    int guest_prof_interval_us;
+
+    /*
+     * if non-NULL, the jit replaces library routines like memcpy and memset
+     * with host implementations.  The routines are recognized by comparing
+     * them to the ones in this ELF, which can be the game's own unstripped
+     * executable or the object files of the library it was built with.
+     */
+    char const *path_hle_func_syms;
+
+    /*
+     * if more than 1, only present one out of every turbo_frames frames and
+     * throw away the sound.  Emulation is otherwise unaffected.
+     */
+    int turbo_frames;
+
+    /*
+     * if more than 0, skip drawing up to this many consecutive frames when
+     * the host can't keep up with real time.  Sound keeps running at full
+     * speed.
+     */
+    int frameskip_max;
+
+    /*
+     * if set, don't let frames go by faster than they would on real
+     * hardware.  This can be changed later with washdc_set_frame_limit.
+     */
+    bool frame_limit;
+
+    /*
+     * length of the timeslices that the SH4 and ARM7 take turns running for,
+     * in microseconds (0 means the default of 2500).  Shorter timeslices let
+     * the two CPUs respond to each other sooner at the cost of more overhead.
+     * If timeslice_adaptive is set, the timeslice gets shorter while the CPUs
+     * are interrupting each other and grows back to timeslice_us when they
+     * aren't.
+     */
+    int timeslice_us;
+    bool timeslice_adaptive;
+
+    /*
+     * screenshots are normally PNG, compressed at screenshot_png_level (1-9,
+     * or 0 for zlib's default).  If screenshot_qoi is set then screenshots
+     * saved with washdc_save_screenshot_dir are QOI instead, which is much
+     * faster to encode.  washdc_save_screenshot goes by the file extension.
+     */
+    bool screenshot_qoi;
+    int screenshot_png_level;
+
+    /*
+     * lists of CPUs ("0,2-3") to pin the emulation thread (the one that
+     * calls washdc_run), the render thread, the ARM7 thread and the
+     * background jit compiler to.  NULL or empty leaves that thread wherever
+     * the OS puts it.
+     */
+    char const *emu_cpus;
+    char const *rend_cpus;
+    char const *arm7_cpus;
+    char const *jit_cpus;
+
+    /*
+     * if tex_dump_dir is set, every texture the game uses gets saved there as
+     * a PNG along with an index.  If tex_pack_dir is set, textures listed in
+     * the index in that directory get replaced by the PNGs it points to.
+     * Either can be NULL or empty.
+     */
+    char const *tex_dump_dir;
+    char const *tex_pack_dir;
+
     struct washdc_controller_dev controllers[WASHDC_CONTROLLER_PORTS][WASHDC_CONTROLLER_UNITS];
 };
 
 int washdc_save_screenshot(char const *path);
 int washdc_save_screenshot_dir(void);
 
+/*
+ * append a checkpoint of the emulator's state to the save-state file at path.
+ * Only the pages which changed since the last checkpoint get written, unless
+ * path is a different file from last time.  The checkpoint is taken at the
+ * end of the current frame.
+ */
+void washdc_savestate_checkpoint(char const *path);
+
+/*
+ * roll the emulator back to the given checkpoint (counting from 0) in the
+ * save-state file at path.  The file must have been written by this session.
+ */
+void washdc_savestate_restore(char const *path, unsigned checkpoint_no);
+
+/*
+ * load a program into system memory and jump to it at the end of the current
+ * frame.  SH4 ELF executables are loaded according to their program headers;
+ * anything else is loaded at load_addr as a flat binary and started at entry.
+ * dat is copied, and this can be called from any thread.  Returns 0 on
+ * success or -1 if the program is malformed or doesn't fit in memory.
+ */
+int washdc_upload(void const *dat, size_t len,
+                  uint32_t load_addr, uint32_t entry);
+
+/*
+ * step back n_steps rewind snapshots at the end of the current frame.  If
+ * frames have run since the newest snapshot was taken then the first step
+ * only goes back to that snapshot.
+ */
+void washdc_rewind(unsigned n_steps);
+
+/*
+ * at the end of the current frame, go back to the start of frame_no and
+ * simulate everything from there up to the current frame again without
+ * rendering or sound.  This is for rollback netplay, where frame_no is the
+ * oldest frame whose input turned out to be different from what was
+ * predicted.  Frames older than the rollback window go back as far as they
+ * can.  This can be called from any thread, and it returns -1 if
+ * rollback_frames is 0.
+ */
+int washdc_rollback(unsigned frame_no);
+
+struct washdc_perf_probe {
+    char const *name;
+    bool is_timer;
+    uint64_t count;
+    double seconds; // host time spent inside the probe, only for timers
+};
+
+/*
+ * fill out with up to max hot-path probes and return how many there are;
+ * totals are since the last call to washdc_perf_reset.  This always returns
+ * 0 unless WashingtonDC was built with ENABLE_PERF_COUNTERS.
+ */
+unsigned washdc_perf_get(struct washdc_perf_probe *out, unsigned max);
+
+void washdc_perf_reset(void);
+
+#define WASHDC_SYSCALL_TRACE_MAX 64
+
+/*
+ * decode up to the last n_recs system calls and returns seen by the deep
+ * system call trace into buf, one line apiece, and return how many there
+ * were.  This always returns 0 unless WashingtonDC was built with
+ * DEEP_SYSCALL_TRACE.
+ */
+unsigned washdc_syscall_trace_dump(char *buf, size_t len, unsigned n_recs);
+
 char const *washdc_win_get_title(void);
 
 void washdc_gfx_toggle_wireframe(void);
@@ -243,6 +584,15 @@ enum washdc_pvr2_poly_group {
 struct washdc_pvr2_stat {
     unsigned vert_count[WASHDC_PVR2_POLY_GROUP_COUNT];
 
+    // polygon headers that were dropped because they didn't change anything
+    unsigned dup_rend_param_count;
+
+    // draws that were merged into the draw before them
+    unsigned merged_draw_count;
+
+    // texture binds that sampled a host framebuffer directly
+    unsigned fb_tex_alias_count;
+
     /*
      * number of times textures get transmitted to the gfx infra.
      * this includes both overwritten textures and new textures that aren't
@@ -284,20 +634,97 @@ struct washdc_pvr2_stat {
      * since that's generally how textures end up in this situation.
      */
     unsigned tex_eviction_count;
+
+    /*
+     * overwrites of textures which were used in the previous frame.  If this
+     * keeps climbing then the texture cache is too small for the game.
+     */
+    unsigned tex_thrash_count;
+
+    // number of slots in the texture cache
+    unsigned tex_cache_size;
+
+    // texture lookups that did/didn't find the texture in the cache
+    unsigned tex_cache_hit_count;
+    unsigned tex_cache_miss_count;
+
+    // frames that reused the previous frame's gfx_il stream
+    unsigned list_cache_hit_count;
 };
 
 void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat);
 
+struct washdc_perf_stat {
+    // SH4 code cache
+    unsigned code_cache_entries;
+    unsigned long jit_compiles;
+
+    // native JIT's executable memory; all 0 without the native JIT
+    size_t exec_mem_free_bytes;
+    size_t exec_mem_total_bytes;
+    unsigned exec_mem_allocations;
+    unsigned exec_mem_free_segs, exec_mem_segs;
+
+    // bytes moved by SH4 DMA channel 2 and by GD-ROM DMA since startup
+    unsigned long long ch2_dma_bytes;
+    unsigned long long gdrom_dma_bytes;
+
+    /*
+     * completed timeslices, and how far past their ends the CPUs ran in
+     * total and at worst in nanoseconds of emulated time.  The overrun gets
+     * taken out of the following timeslice.
+     */
+    unsigned long long sh4_timeslices, arm7_timeslices;
+    double sh4_ts_overrun_ns, sh4_ts_overrun_max_ns;
+    double arm7_ts_overrun_ns, arm7_ts_overrun_max_ns;
+
+    // length of the current timeslice in nanoseconds of emulated time
+    double timeslice_ns;
+};
+
+void washdc_get_perf_stat(struct washdc_perf_stat *stat);
+
 void washdc_pause(void);
 void washdc_resume(void);
 bool washdc_is_paused(void);
 void washdc_run_one_frame(void);
 
+/*
+ * resume from a pause and pause again after n_frames frames.  Returns -1 if
+ * the emulator isn't paused.
+ */
+int washdc_run_frames(unsigned n_frames);
+
+/*
+ * call func(arg) on the emulation thread at the end of the current frame, or
+ * as soon as possible if the emulator is paused.  Requests made before this
+ * (save-states, uploads, etc) will have been handled by the time func gets
+ * called.  This can be called from any thread; it returns -1 if too many
+ * calls are already waiting.
+ */
+int washdc_run_on_emu_thread(void (*func)(void*), void *arg);
+
+/*
+ * put the disc image at path in the GD-ROM drive instead of whatever's there
+ * now.  This must be called from the emulation thread.  Returns -1 if path
+ * isn't a GDI, CDI or DCZ image.
+ */
+int washdc_load_disc(char const *path);
+
 unsigned washdc_get_frame_count(void);
 
 double washdc_get_fps(void);
 double washdc_get_virt_fps(void);
 
+// should only be called from the emulation thread (eg from a win callback)
+void washdc_set_frame_limit(bool enable);
+
+/*
+ * call func from whichever thread owns the graphics context, and wait for it
+ * to return.  When the render thread is not enabled this just calls func.
+ */
+void washdc_gfx_run_sync(void (*func)(void));
+
 #ifdef __cplusplus
 }
 #endif
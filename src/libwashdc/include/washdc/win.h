@@ -23,12 +23,20 @@
 #ifndef WIN_H_
 #define WIN_H_
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct win_intf {
     void (*check_events)(void);
+
+    /*
+     * called periodically while the emulator is suspended.  This can be NULL
+     * if the window has nothing to service, in which case the emulation thread
+     * sleeps until it gets woken up instead of polling.
+     */
     void (*run_once_on_suspend)(void);
     void (*update)(void);
     void (*make_context_current)(void);
@@ -41,6 +49,7 @@ void win_set_intf(struct win_intf const *intf);
 
 void win_check_events(void);
 void win_run_once_on_suspend(void);
+bool win_needs_polling(void);
 void win_update(void);
 void win_make_context_current(void);
 void win_update_title(void);
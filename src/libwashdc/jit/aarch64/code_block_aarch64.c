@@ -0,0 +1,961 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "log.h"
+#include "washdc/error.h"
+#include "washdc/MemoryMap.h"
+#include "jit/code_block.h"
+#include "jit/jit_il.h"
+#include "exec_mem.h"
+#include "native_dispatch.h"
+#include "native_mem.h"
+#include "config.h"
+#include "washdc/cpu.h"
+
+#include "emit_aarch64.h"
+#include "code_block_aarch64.h"
+
+/*
+ * This is a template JIT: every slot lives in memory, and each IL instruction
+ * loads its operands into the scratch registers (w9-w12, s16 and s17), does
+ * its thing and stores the result back.  Slots are 8 bytes so that they can
+ * hold host pointers.
+ */
+static uint64_t slots[MAX_SLOTS];
+
+static unsigned const slot_base_reg = NATIVE_DISPATCH_SLOT_BASE_REG;
+
+// static destinations of the JIT_OP_JUMP in the block being compiled
+static unsigned n_jumps, n_jump_targets;
+static uint32_t jump_addr[JIT_JUMP_MAX_STATIC_TARGETS];
+static jit_hash jump_hash[JIT_JUMP_MAX_STATIC_TARGETS];
+
+/*
+ * JIT_OP_EXIT_COND side-exits in the block being compiled.  Each one gets
+ * emitted as a test-and-branch over a b (site) to code at the end of the
+ * block which leaves through native_check_cycles.
+ */
+#define MAX_SIDE_EXITS 32
+static struct side_exit {
+    void *site;
+    struct exit_cond_immed const *immed;
+} side_exits[MAX_SIDE_EXITS];
+static unsigned n_side_exits;
+
+void jit_aarch64_backend_init(void) {
+    memset(slots, 0, sizeof(slots));
+}
+
+void jit_aarch64_backend_cleanup(void) {
+}
+
+void *code_block_aarch64_slot_base(void) {
+    return slots;
+}
+
+#define AARCH64_ALLOC_SIZE 64
+
+void code_block_aarch64_init(struct code_block_aarch64 *blk) {
+    void *native = exec_mem_alloc(AARCH64_ALLOC_SIZE);
+    blk->cycle_count = 0;
+    blk->bytes_used = 0;
+    blk->links = NULL;
+    blk->n_links = 0;
+    blk->links_in = NULL;
+    blk->n_unchecked_out = blk->n_unchecked_in = 0;
+
+    if (!native) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    blk->native = native;
+    blk->exec_mem_alloc_start = native;
+}
+
+void code_block_aarch64_cleanup(struct code_block_aarch64 *blk) {
+    native_link_cleanup(blk);
+    exec_mem_free(blk->exec_mem_alloc_start);
+    memset(blk, 0, sizeof(*blk));
+}
+
+static void ld_slot(unsigned reg_no, unsigned slot_no) {
+    a64asm_ldr_w(reg_no, slot_base_reg, slot_no * sizeof(slots[0]));
+}
+
+static void st_slot(unsigned reg_no, unsigned slot_no) {
+    a64asm_str_w(reg_no, slot_base_reg, slot_no * sizeof(slots[0]));
+}
+
+static void ld_slot_ptr(unsigned reg_no, unsigned slot_no) {
+    a64asm_ldr_x(reg_no, slot_base_reg, slot_no * sizeof(slots[0]));
+}
+
+static void st_slot_ptr(unsigned reg_no, unsigned slot_no) {
+    a64asm_str_x(reg_no, slot_base_reg, slot_no * sizeof(slots[0]));
+}
+
+static void ld_slot_float(unsigned reg_no, unsigned slot_no) {
+    a64asm_ldr_s(reg_no, slot_base_reg, slot_no * sizeof(slots[0]));
+}
+
+static void st_slot_float(unsigned reg_no, unsigned slot_no) {
+    a64asm_str_s(reg_no, slot_base_reg, slot_no * sizeof(slots[0]));
+}
+
+// JIT_OP_FALLBACK implementation
+static void emit_fallback(void *cpu, struct jit_inst const *inst) {
+    a64asm_mov_imm64(A64_X0, (uintptr_t)cpu);
+    a64asm_mov_imm32(A64_X1, inst->immed.fallback.inst);
+    native_dispatch_call_emit((void*)inst->immed.fallback.fallback_fn);
+}
+
+// JIT_OP_JUMP implementation
+static void emit_jump(struct jit_inst const *inst) {
+    ld_slot(NATIVE_DISPATCH_PC_REG, inst->immed.jump.jmp_addr_slot);
+    ld_slot(NATIVE_DISPATCH_HASH_REG, inst->immed.jump.jmp_hash_slot);
+
+    n_jumps++;
+    n_jump_targets = inst->immed.jump.n_static_targets;
+    unsigned idx;
+    for (idx = 0; idx < n_jump_targets; idx++) {
+        jump_addr[idx] = inst->immed.jump.static_addr[idx];
+        jump_hash[idx] = inst->immed.jump.static_hash[idx];
+    }
+}
+
+// branch if (reg & 1) != t_flag
+static void *emit_skip_unless_flag(unsigned reg_no, unsigned t_flag) {
+    return t_flag ? a64asm_tbz_fwd(reg_no, 0) : a64asm_tbnz_fwd(reg_no, 0);
+}
+
+// JIT_CSET implementation
+static void emit_cset(struct jit_inst const *inst) {
+    ld_slot(A64_X9, inst->immed.cset.flag_slot);
+    void *skip = emit_skip_unless_flag(A64_X9, inst->immed.cset.t_flag);
+    a64asm_mov_imm32(A64_X10, inst->immed.cset.src_val);
+    st_slot(A64_X10, inst->immed.cset.dst_slot);
+    a64asm_fixup_here(skip);
+}
+
+// JIT_OP_EXIT_COND implementation
+static void emit_exit_cond(struct jit_inst const *inst) {
+    if (n_side_exits >= MAX_SIDE_EXITS)
+        RAISE_ERROR(ERROR_OVERFLOW);
+
+    ld_slot(A64_X9, inst->immed.exit_cond.flag_slot);
+    void *skip = emit_skip_unless_flag(A64_X9, inst->immed.exit_cond.t_flag);
+
+    struct side_exit *ent = side_exits + n_side_exits++;
+    ent->site = a64asm_b_fwd();
+    ent->immed = &inst->immed.exit_cond;
+
+    a64asm_fixup_here(skip);
+}
+
+static void emit_side_exits(struct native_dispatch_meta const *dispatch_meta) {
+    unsigned idx;
+    for (idx = 0; idx < n_side_exits; idx++) {
+        struct side_exit const *ent = side_exits + idx;
+
+        a64asm_fixup_here(ent->site);
+
+        a64asm_mov_imm32(NATIVE_DISPATCH_PC_REG, ent->immed->addr);
+        a64asm_mov_imm32(NATIVE_DISPATCH_HASH_REG, ent->immed->hash);
+        a64asm_mov_imm32(NATIVE_DISPATCH_CYCLE_COUNT_REG,
+                         ent->immed->cycle_count);
+        native_check_cycles_emit(dispatch_meta);
+    }
+}
+
+// JIT_OP_CALL_FUNC and JIT_OP_CALL_FUNC_IMM32 implementation
+static void emit_call_func(void *cpu, struct jit_inst const *inst) {
+    a64asm_mov_imm64(A64_X0, (uintptr_t)cpu);
+    if (inst->op == JIT_OP_CALL_FUNC) {
+        ld_slot(A64_X1, inst->immed.call_func.slot_no);
+        native_dispatch_call_emit((void*)inst->immed.call_func.func);
+    } else {
+        a64asm_mov_imm32(A64_X1, inst->immed.call_func_imm32.imm32);
+        native_dispatch_call_emit((void*)inst->immed.call_func_imm32.func);
+    }
+}
+
+// JIT_OP_MUL_S32_WIDE and JIT_OP_MUL_U32_WIDE implementation
+static void emit_mul_32_wide(struct mul_wide_immed const *immed, bool sign) {
+    ld_slot(A64_X9, immed->slot_lhs);
+    ld_slot(A64_X10, immed->slot_rhs);
+    if (sign)
+        a64asm_smull_x(A64_X9, A64_X9, A64_X10);
+    else
+        a64asm_umull_x(A64_X9, A64_X9, A64_X10);
+    st_slot(A64_X9, immed->slot_lo);
+    a64asm_lsr_imm_x(A64_X9, A64_X9, 32);
+    st_slot(A64_X9, immed->slot_hi);
+}
+
+// JIT_OP_MACL and JIT_OP_MACW implementation
+static void emit_mac(struct mac_immed const *immed, void *helper) {
+    ld_slot(A64_X9, immed->slot_lo);
+    ld_slot(A64_X10, immed->slot_hi);
+    a64asm_orr_lsl_x(A64_X0, A64_X9, A64_X10, 32);
+    ld_slot(A64_X1, immed->slot_lhs);
+    ld_slot(A64_X2, immed->slot_rhs);
+    ld_slot(A64_X3, immed->slot_sat);
+    native_dispatch_call_emit(helper);
+    st_slot(A64_X0, immed->slot_lo);
+    a64asm_lsr_imm_x(A64_X0, A64_X0, 32);
+    st_slot(A64_X0, immed->slot_hi);
+}
+
+// JIT_OP_READ_16_CONSTADDR and JIT_OP_READ_32_CONSTADDR implementation
+static void emit_read_constaddr(struct code_block_aarch64 *blk,
+                                struct memory_map const *map, addr32_t vaddr,
+                                unsigned slot_no, unsigned n_bytes) {
+    struct memory_map_region const *region =
+        memory_map_get_region((struct memory_map*)map, vaddr, n_bytes);
+
+    if (region && region->host) {
+        // the address is in RAM so it can be loaded directly from the host
+        a64asm_mov_imm64(A64_X9, (uintptr_t)(region->host +
+                                             (vaddr & region->mask)));
+        if (n_bytes == 2)
+            a64asm_ldrh_w(A64_X9, A64_X9, 0);
+        else
+            a64asm_ldr_w(A64_X9, A64_X9, 0);
+        st_slot(A64_X9, slot_no);
+        return;
+    }
+
+    void *handler = NULL;
+    if (region)
+        handler = n_bytes == 2 ? (void*)region->intf->read16 :
+            (void*)region->intf->read32;
+
+    if (handler) {
+        // call the region's handler directly
+        a64asm_mov_imm32(A64_X0, vaddr & region->mask);
+        a64asm_mov_imm64(A64_X1, (uintptr_t)region->ctxt);
+        native_dispatch_call_emit(handler);
+    } else if (config_get_inline_mem()) {
+        a64asm_mov_imm32(A64_X0, vaddr);
+        if (n_bytes == 2)
+            native_mem_read_16(blk, map);
+        else
+            native_mem_read_32(blk, map);
+    } else {
+        a64asm_mov_imm64(A64_X0, (uintptr_t)map);
+        a64asm_mov_imm32(A64_X1, vaddr);
+        native_dispatch_call_emit(n_bytes == 2 ? (void*)memory_map_read_16 :
+                                  (void*)memory_map_read_32);
+    }
+
+    if (n_bytes == 2)
+        a64asm_uxth_w(A64_X0, A64_X0);
+    st_slot(A64_X0, slot_no);
+}
+
+// JIT_OP_READ_*_SLOT implementation
+static void emit_read_slot(struct code_block_aarch64 *blk,
+                           struct memory_map const *map, unsigned addr_slot,
+                           unsigned dst_slot, unsigned n_bytes, bool is_float) {
+    if (config_get_inline_mem()) {
+        ld_slot(A64_X0, addr_slot);
+        if (is_float)
+            native_mem_read_float(blk, map);
+        else if (n_bytes == 1)
+            native_mem_read_8(blk, map);
+        else if (n_bytes == 2)
+            native_mem_read_16(blk, map);
+        else
+            native_mem_read_32(blk, map);
+    } else {
+        void *fn;
+        if (is_float)
+            fn = (void*)memory_map_read_float;
+        else if (n_bytes == 1)
+            fn = (void*)memory_map_read_8;
+        else if (n_bytes == 2)
+            fn = (void*)memory_map_read_16;
+        else
+            fn = (void*)memory_map_read_32;
+
+        ld_slot(A64_X1, addr_slot);
+        a64asm_mov_imm64(A64_X0, (uintptr_t)map);
+        native_dispatch_call_emit(fn);
+
+        // the upper bits of narrow return values are undefined
+        if (n_bytes == 1)
+            a64asm_uxtb_w(A64_X0, A64_X0);
+        else if (n_bytes == 2 && !is_float)
+            a64asm_uxth_w(A64_X0, A64_X0);
+    }
+
+    if (is_float)
+        st_slot_float(A64_S0, dst_slot);
+    else
+        st_slot(A64_X0, dst_slot);
+}
+
+// JIT_OP_WRITE_*_SLOT implementation
+static void emit_write_slot(struct code_block_aarch64 *blk,
+                            struct memory_map const *map, unsigned addr_slot,
+                            unsigned src_slot, unsigned n_bytes,
+                            bool is_float) {
+    if (config_get_inline_mem()) {
+        ld_slot(A64_X0, addr_slot);
+        if (is_float) {
+            ld_slot_float(A64_S0, src_slot);
+            native_mem_write_float(blk, map);
+        } else {
+            ld_slot(A64_X1, src_slot);
+            if (n_bytes == 1)
+                native_mem_write_8(blk, map);
+            else if (n_bytes == 2)
+                native_mem_write_16(blk, map);
+            else
+                native_mem_write_32(blk, map);
+        }
+        return;
+    }
+
+    void *fn;
+    ld_slot(A64_X1, addr_slot);
+    if (is_float) {
+        ld_slot_float(A64_S0, src_slot);
+        fn = (void*)memory_map_write_float;
+    } else {
+        ld_slot(A64_X2, src_slot);
+        if (n_bytes == 1) {
+            a64asm_uxtb_w(A64_X2, A64_X2);
+            fn = (void*)memory_map_write_8;
+        } else if (n_bytes == 2) {
+            a64asm_uxth_w(A64_X2, A64_X2);
+            fn = (void*)memory_map_write_16;
+        } else {
+            fn = (void*)memory_map_write_32;
+        }
+    }
+    a64asm_mov_imm64(A64_X0, (uintptr_t)map);
+    native_dispatch_call_emit(fn);
+}
+
+// put the address of a word in a JIT_OP_*_32_BLOCK into reg_no
+static void emit_block_addr(struct mem_block_32_immed const *run, int offs,
+                            unsigned reg_no, unsigned tmp_reg) {
+    ld_slot(reg_no, run->addr_slot);
+    if (offs) {
+        a64asm_mov_imm32(tmp_reg, (uint32_t)offs);
+        a64asm_add_w(reg_no, reg_no, tmp_reg);
+    }
+}
+
+// offset into RAM of a word in a block that passed native_mem_span_begin
+static unsigned emit_block_ram_offs(struct mem_block_32_immed const *run,
+                                    unsigned word) {
+    int disp = run->first + (int)word * run->stride -
+        jit_mem_block_32_lo(run);
+    if (!disp)
+        return A64_X9;
+    a64asm_add_imm_w(A64_X11, A64_X9, disp);
+    return A64_X11;
+}
+
+// JIT_OP_READ_32_BLOCK implementation
+static void emit_read_32_block(struct code_block_aarch64 *blk,
+                               struct mem_block_32_immed const *run) {
+    struct native_mem_fast_path fast;
+    unsigned word;
+
+    fast.active = false;
+
+    if (config_get_inline_mem()) {
+        emit_block_addr(run, jit_mem_block_32_lo(run), A64_X0, A64_X1);
+        if (native_mem_span_begin(&fast, run->map,
+                                  run->n_words * sizeof(uint32_t))) {
+            for (word = 0; word < run->n_words; word++) {
+                a64asm_ldr_w_uxtw(A64_X12, A64_X10,
+                                  emit_block_ram_offs(run, word));
+                st_slot(A64_X12, run->data_slot[word]);
+            }
+            native_mem_span_slow(&fast);
+        }
+    }
+
+    for (word = 0; word < run->n_words; word++) {
+        emit_block_addr(run, run->first + (int)word * run->stride,
+                        A64_X1, A64_X2);
+        a64asm_mov_imm64(A64_X0, (uintptr_t)run->map);
+        native_dispatch_call_emit((void*)memory_map_read_32);
+        st_slot(A64_X0, run->data_slot[word]);
+    }
+
+    native_mem_span_end(&fast);
+}
+
+// JIT_OP_WRITE_32_BLOCK implementation
+static void emit_write_32_block(struct code_block_aarch64 *blk,
+                                struct mem_block_32_immed const *run) {
+    struct native_mem_fast_path fast;
+    unsigned word;
+
+    fast.active = false;
+
+    if (config_get_inline_mem()) {
+        emit_block_addr(run, jit_mem_block_32_lo(run), A64_X0, A64_X1);
+        if (native_mem_span_begin(&fast, run->map,
+                                  run->n_words * sizeof(uint32_t))) {
+            for (word = 0; word < run->n_words; word++) {
+                ld_slot(A64_X12, run->data_slot[word]);
+                a64asm_str_w_uxtw(A64_X12, A64_X10,
+                                  emit_block_ram_offs(run, word));
+            }
+            native_mem_span_notify(run->n_words * sizeof(uint32_t));
+            native_mem_span_slow(&fast);
+        }
+    }
+
+    for (word = 0; word < run->n_words; word++) {
+        emit_block_addr(run, run->first + (int)word * run->stride,
+                        A64_X1, A64_X2);
+        ld_slot(A64_X2, run->data_slot[word]);
+        a64asm_mov_imm64(A64_X0, (uintptr_t)run->map);
+        native_dispatch_call_emit((void*)memory_map_write_32);
+    }
+
+    native_mem_span_end(&fast);
+}
+
+// dst = dst op src, for the two-operand integer ops
+static void emit_binop(struct jit_inst const *inst, unsigned src_slot,
+                       unsigned dst_slot) {
+    ld_slot(A64_X9, dst_slot);
+    ld_slot(A64_X10, src_slot);
+    switch (inst->op) {
+    case JIT_OP_ADD:
+        a64asm_add_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_SUB:
+        a64asm_sub_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_XOR:
+        a64asm_eor_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_AND:
+        a64asm_and_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_OR:
+        a64asm_orr_w(A64_X9, A64_X9, A64_X10);
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    st_slot(A64_X9, dst_slot);
+}
+
+// slot = slot op const32
+static void emit_binop_const(struct jit_inst const *inst, unsigned slot_no,
+                             uint32_t const32) {
+    ld_slot(A64_X9, slot_no);
+    a64asm_mov_imm32(A64_X10, const32);
+    switch (inst->op) {
+    case JIT_OP_ADD_CONST32:
+        a64asm_add_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_XOR_CONST32:
+        a64asm_eor_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_AND_CONST32:
+        a64asm_and_w(A64_X9, A64_X9, A64_X10);
+        break;
+    case JIT_OP_OR_CONST32:
+        a64asm_orr_w(A64_X9, A64_X9, A64_X10);
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    st_slot(A64_X9, slot_no);
+}
+
+// dst = dst op src, for floats.  MUL_FLOAT has its operands the other way
+static void emit_float_binop(struct jit_inst const *inst, unsigned src_slot,
+                             unsigned dst_slot) {
+    ld_slot_float(A64_S16, dst_slot);
+    ld_slot_float(A64_S17, src_slot);
+    switch (inst->op) {
+    case JIT_OP_ADD_FLOAT:
+        a64asm_fadd_s(A64_S16, A64_S16, A64_S17);
+        break;
+    case JIT_OP_SUB_FLOAT:
+        a64asm_fsub_s(A64_S16, A64_S16, A64_S17);
+        break;
+    case JIT_OP_MUL_FLOAT:
+        a64asm_fmul_s(A64_S16, A64_S17, A64_S16);
+        break;
+    case JIT_OP_DIV_FLOAT:
+        a64asm_fdiv_s(A64_S16, A64_S16, A64_S17);
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    st_slot_float(A64_S16, dst_slot);
+}
+
+// dst |= 1 if (lhs cond rhs).  rhs is in w10 (or s17) when this gets called
+static void emit_set_cond(unsigned lhs_slot, unsigned dst_slot,
+                          enum a64asm_cond cond, bool is_float) {
+    if (is_float) {
+        ld_slot_float(A64_S16, lhs_slot);
+        a64asm_fcmp_s(A64_S16, A64_S17);
+    } else {
+        ld_slot(A64_X9, lhs_slot);
+        a64asm_cmp_w(A64_X9, A64_X10);
+    }
+    a64asm_cset_w(A64_X11, cond);
+    ld_slot(A64_X12, dst_slot);
+    a64asm_orr_w(A64_X12, A64_X12, A64_X11);
+    st_slot(A64_X12, dst_slot);
+}
+
+static void emit_set_cond_slots(unsigned lhs_slot, unsigned rhs_slot,
+                                unsigned dst_slot, enum a64asm_cond cond) {
+    ld_slot(A64_X10, rhs_slot);
+    emit_set_cond(lhs_slot, dst_slot, cond, false);
+}
+
+static void emit_set_cond_const(unsigned lhs_slot, int32_t imm_rhs,
+                                unsigned dst_slot, enum a64asm_cond cond) {
+    a64asm_mov_imm32(A64_X10, (uint32_t)imm_rhs);
+    emit_set_cond(lhs_slot, dst_slot, cond, false);
+}
+
+// JIT_OP_SHAD implementation
+static void emit_shad(struct jit_inst const *inst) {
+    unsigned slot_val = inst->immed.shad.slot_val;
+
+    /*
+     * left-shift if the amount is positive, else arithmetic right-shift by its
+     * negation.  lslv and asrv both only look at the low five bits of the
+     * amount, same as the x86_64 backend's shifts.
+     */
+    ld_slot(A64_X9, slot_val);
+    ld_slot(A64_X10, inst->immed.shad.slot_shift_amt);
+    a64asm_neg_w(A64_X11, A64_X10);
+    a64asm_lslv_w(A64_X12, A64_X9, A64_X10);
+    a64asm_asrv_w(A64_X9, A64_X9, A64_X11);
+    a64asm_cmp_imm_w(A64_X10, 0);
+    a64asm_csel_w(A64_X9, A64_X12, A64_X9, A64_COND_GE);
+    st_slot(A64_X9, slot_val);
+}
+
+static void emit_inst(struct code_block_aarch64 *blk, void *cpu,
+                      struct jit_inst const *inst) {
+    union jit_immed const *immed = &inst->immed;
+
+    switch (inst->op) {
+    case JIT_OP_FALLBACK:
+        emit_fallback(cpu, inst);
+        break;
+    case JIT_OP_JUMP:
+        emit_jump(inst);
+        break;
+    case JIT_CSET:
+        emit_cset(inst);
+        break;
+    case JIT_OP_EXIT_COND:
+        emit_exit_cond(inst);
+        break;
+    case JIT_SET_SLOT:
+        a64asm_mov_imm32(A64_X9, immed->set_slot.new_val);
+        st_slot(A64_X9, immed->set_slot.slot_idx);
+        break;
+    case JIT_SET_SLOT_HOST_PTR:
+        a64asm_mov_imm64(A64_X9, (uintptr_t)immed->set_slot_host_ptr.ptr);
+        st_slot_ptr(A64_X9, immed->set_slot_host_ptr.slot_idx);
+        break;
+    case JIT_OP_CALL_FUNC:
+    case JIT_OP_CALL_FUNC_IMM32:
+        emit_call_func(cpu, inst);
+        break;
+    case JIT_OP_READ_16_CONSTADDR:
+        emit_read_constaddr(blk, immed->read_16_constaddr.map,
+                            immed->read_16_constaddr.addr,
+                            immed->read_16_constaddr.slot_no, 2);
+        break;
+    case JIT_OP_READ_32_CONSTADDR:
+        emit_read_constaddr(blk, immed->read_32_constaddr.map,
+                            immed->read_32_constaddr.addr,
+                            immed->read_32_constaddr.slot_no, 4);
+        break;
+    case JIT_OP_SIGN_EXTEND_8:
+        ld_slot(A64_X9, immed->sign_extend_8.slot_no);
+        a64asm_sxtb_w(A64_X9, A64_X9);
+        st_slot(A64_X9, immed->sign_extend_8.slot_no);
+        break;
+    case JIT_OP_SIGN_EXTEND_16:
+        ld_slot(A64_X9, immed->sign_extend_16.slot_no);
+        a64asm_sxth_w(A64_X9, A64_X9);
+        st_slot(A64_X9, immed->sign_extend_16.slot_no);
+        break;
+    case JIT_OP_READ_8_SLOT:
+        emit_read_slot(blk, immed->read_8_slot.map,
+                       immed->read_8_slot.addr_slot,
+                       immed->read_8_slot.dst_slot, 1, false);
+        break;
+    case JIT_OP_READ_16_SLOT:
+        emit_read_slot(blk, immed->read_16_slot.map,
+                       immed->read_16_slot.addr_slot,
+                       immed->read_16_slot.dst_slot, 2, false);
+        break;
+    case JIT_OP_READ_32_SLOT:
+        emit_read_slot(blk, immed->read_32_slot.map,
+                       immed->read_32_slot.addr_slot,
+                       immed->read_32_slot.dst_slot, 4, false);
+        break;
+    case JIT_OP_READ_FLOAT_SLOT:
+        emit_read_slot(blk, immed->read_float_slot.map,
+                       immed->read_float_slot.addr_slot,
+                       immed->read_float_slot.dst_slot, 4, true);
+        break;
+    case JIT_OP_WRITE_8_SLOT:
+        emit_write_slot(blk, immed->write_8_slot.map,
+                        immed->write_8_slot.addr_slot,
+                        immed->write_8_slot.src_slot, 1, false);
+        break;
+    case JIT_OP_WRITE_16_SLOT:
+        emit_write_slot(blk, immed->write_16_slot.map,
+                        immed->write_16_slot.addr_slot,
+                        immed->write_16_slot.src_slot, 2, false);
+        break;
+    case JIT_OP_WRITE_32_SLOT:
+        emit_write_slot(blk, immed->write_32_slot.map,
+                        immed->write_32_slot.addr_slot,
+                        immed->write_32_slot.src_slot, 4, false);
+        break;
+    case JIT_OP_WRITE_FLOAT_SLOT:
+        emit_write_slot(blk, immed->write_float_slot.map,
+                        immed->write_float_slot.addr_slot,
+                        immed->write_float_slot.src_slot, 4, true);
+        break;
+    case JIT_OP_READ_32_BLOCK:
+        emit_read_32_block(blk, &immed->read_32_block);
+        break;
+    case JIT_OP_WRITE_32_BLOCK:
+        emit_write_32_block(blk, &immed->write_32_block);
+        break;
+    case JIT_OP_LOAD_SLOT16:
+        a64asm_mov_imm64(A64_X9, (uintptr_t)immed->load_slot16.src);
+        a64asm_ldrh_w(A64_X9, A64_X9, 0);
+        st_slot(A64_X9, immed->load_slot16.slot_no);
+        break;
+    case JIT_OP_LOAD_SLOT:
+        a64asm_mov_imm64(A64_X9, (uintptr_t)immed->load_slot.src);
+        a64asm_ldr_w(A64_X9, A64_X9, 0);
+        st_slot(A64_X9, immed->load_slot.slot_no);
+        break;
+    case JIT_OP_LOAD_SLOT_OFFSET:
+        ld_slot_ptr(A64_X9, immed->load_slot_offset.slot_base);
+        a64asm_ldr_w(A64_X10, A64_X9,
+                     immed->load_slot_offset.index * sizeof(uint32_t));
+        st_slot(A64_X10, immed->load_slot_offset.slot_dst);
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT:
+        a64asm_mov_imm64(A64_X9, (uintptr_t)immed->load_float_slot.src);
+        a64asm_ldr_s(A64_S16, A64_X9, 0);
+        st_slot_float(A64_S16, immed->load_float_slot.slot_no);
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT_OFFSET:
+        ld_slot_ptr(A64_X9, immed->load_float_slot_offset.slot_base);
+        a64asm_ldr_s(A64_S16, A64_X9,
+                     immed->load_float_slot_offset.index * sizeof(float));
+        st_slot_float(A64_S16, immed->load_float_slot_offset.slot_dst);
+        break;
+    case JIT_OP_STORE_SLOT:
+        ld_slot(A64_X10, immed->store_slot.slot_no);
+        a64asm_mov_imm64(A64_X9, (uintptr_t)immed->store_slot.dst);
+        a64asm_str_w(A64_X10, A64_X9, 0);
+        break;
+    case JIT_OP_STORE_SLOT_OFFSET:
+        ld_slot_ptr(A64_X9, immed->store_slot_offset.slot_base);
+        ld_slot(A64_X10, immed->store_slot_offset.slot_src);
+        a64asm_str_w(A64_X10, A64_X9,
+                     immed->store_slot_offset.index * sizeof(uint32_t));
+        break;
+    case JIT_OP_STORE_FLOAT_SLOT:
+        ld_slot_float(A64_S16, immed->store_float_slot.slot_no);
+        a64asm_mov_imm64(A64_X9, (uintptr_t)immed->store_float_slot.dst);
+        a64asm_str_s(A64_S16, A64_X9, 0);
+        break;
+    case JIT_OP_STORE_FLOAT_SLOT_OFFSET:
+        ld_slot_ptr(A64_X9, immed->store_float_slot_offset.slot_base);
+        ld_slot_float(A64_S16, immed->store_float_slot_offset.slot_src);
+        a64asm_str_s(A64_S16, A64_X9,
+                     immed->store_float_slot_offset.index * sizeof(float));
+        break;
+    case JIT_OP_ADD:
+        emit_binop(inst, immed->add.slot_src, immed->add.slot_dst);
+        break;
+    case JIT_OP_SUB:
+        emit_binop(inst, immed->sub.slot_src, immed->sub.slot_dst);
+        break;
+    case JIT_OP_XOR:
+        emit_binop(inst, immed->xor.slot_src, immed->xor.slot_dst);
+        break;
+    case JIT_OP_AND:
+        emit_binop(inst, immed->and.slot_src, immed->and.slot_dst);
+        break;
+    case JIT_OP_OR:
+        emit_binop(inst, immed->or.slot_src, immed->or.slot_dst);
+        break;
+    case JIT_OP_ADD_CONST32:
+        emit_binop_const(inst, immed->add_const32.slot_dst,
+                         immed->add_const32.const32);
+        break;
+    case JIT_OP_XOR_CONST32:
+        emit_binop_const(inst, immed->xor_const32.slot_no,
+                         immed->xor_const32.const32);
+        break;
+    case JIT_OP_AND_CONST32:
+        emit_binop_const(inst, immed->and_const32.slot_no,
+                         immed->and_const32.const32);
+        break;
+    case JIT_OP_OR_CONST32:
+        emit_binop_const(inst, immed->or_const32.slot_no,
+                         immed->or_const32.const32);
+        break;
+    case JIT_OP_MOV:
+        ld_slot(A64_X9, immed->mov.slot_src);
+        st_slot(A64_X9, immed->mov.slot_dst);
+        break;
+    case JIT_OP_MOV_FLOAT:
+        ld_slot_float(A64_S16, immed->mov_float.slot_src);
+        st_slot_float(A64_S16, immed->mov_float.slot_dst);
+        break;
+    case JIT_OP_DISCARD_SLOT:
+        break;
+    case JIT_OP_SLOT_TO_BOOL_INV:
+        ld_slot(A64_X9, immed->slot_to_bool_inv.slot_no);
+        a64asm_cmp_imm_w(A64_X9, 0);
+        a64asm_cset_w(A64_X9, A64_COND_EQ);
+        st_slot(A64_X9, immed->slot_to_bool_inv.slot_no);
+        break;
+    case JIT_OP_NOT:
+        ld_slot(A64_X9, immed->not.slot_no);
+        a64asm_mvn_w(A64_X9, A64_X9);
+        st_slot(A64_X9, immed->not.slot_no);
+        break;
+    case JIT_OP_SHLL:
+        ld_slot(A64_X9, immed->shll.slot_no);
+        a64asm_lsl_imm_w(A64_X9, A64_X9, immed->shll.shift_amt & 31);
+        st_slot(A64_X9, immed->shll.slot_no);
+        break;
+    case JIT_OP_SHAR:
+        ld_slot(A64_X9, immed->shar.slot_no);
+        a64asm_asr_imm_w(A64_X9, A64_X9, immed->shar.shift_amt & 31);
+        st_slot(A64_X9, immed->shar.slot_no);
+        break;
+    case JIT_OP_SHLR:
+        ld_slot(A64_X9, immed->shlr.slot_no);
+        a64asm_lsr_imm_w(A64_X9, A64_X9, immed->shlr.shift_amt & 31);
+        st_slot(A64_X9, immed->shlr.slot_no);
+        break;
+    case JIT_OP_SHAD:
+        emit_shad(inst);
+        break;
+    case JIT_OP_SET_GT_UNSIGNED:
+        emit_set_cond_slots(immed->set_gt_unsigned.slot_lhs,
+                            immed->set_gt_unsigned.slot_rhs,
+                            immed->set_gt_unsigned.slot_dst, A64_COND_HI);
+        break;
+    case JIT_OP_SET_GT_SIGNED:
+        emit_set_cond_slots(immed->set_gt_signed.slot_lhs,
+                            immed->set_gt_signed.slot_rhs,
+                            immed->set_gt_signed.slot_dst, A64_COND_GT);
+        break;
+    case JIT_OP_SET_GT_SIGNED_CONST:
+        emit_set_cond_const(immed->set_gt_signed_const.slot_lhs,
+                            immed->set_gt_signed_const.imm_rhs,
+                            immed->set_gt_signed_const.slot_dst, A64_COND_GT);
+        break;
+    case JIT_OP_SET_EQ:
+        emit_set_cond_slots(immed->set_eq.slot_lhs, immed->set_eq.slot_rhs,
+                            immed->set_eq.slot_dst, A64_COND_EQ);
+        break;
+    case JIT_OP_SET_GE_UNSIGNED:
+        emit_set_cond_slots(immed->set_ge_unsigned.slot_lhs,
+                            immed->set_ge_unsigned.slot_rhs,
+                            immed->set_ge_unsigned.slot_dst, A64_COND_HS);
+        break;
+    case JIT_OP_SET_GE_SIGNED:
+        emit_set_cond_slots(immed->set_ge_signed.slot_lhs,
+                            immed->set_ge_signed.slot_rhs,
+                            immed->set_ge_signed.slot_dst, A64_COND_GE);
+        break;
+    case JIT_OP_SET_GE_SIGNED_CONST:
+        emit_set_cond_const(immed->set_ge_signed_const.slot_lhs,
+                            immed->set_ge_signed_const.imm_rhs,
+                            immed->set_ge_signed_const.slot_dst, A64_COND_GE);
+        break;
+    case JIT_OP_SET_GT_FLOAT:
+        // GT is false when fcmp's operands are unordered, same as C's >
+        ld_slot_float(A64_S17, immed->set_gt_float.slot_rhs);
+        emit_set_cond(immed->set_gt_float.slot_lhs,
+                      immed->set_gt_float.slot_dst, A64_COND_GT, true);
+        break;
+    case JIT_OP_MUL_U32:
+        ld_slot(A64_X9, immed->mul_u32.slot_lhs);
+        ld_slot(A64_X10, immed->mul_u32.slot_rhs);
+        a64asm_mul_w(A64_X9, A64_X9, A64_X10);
+        st_slot(A64_X9, immed->mul_u32.slot_dst);
+        break;
+    case JIT_OP_ADD_FLOAT:
+        emit_float_binop(inst, immed->add_float.slot_src,
+                         immed->add_float.slot_dst);
+        break;
+    case JIT_OP_SUB_FLOAT:
+        emit_float_binop(inst, immed->sub_float.slot_src,
+                         immed->sub_float.slot_dst);
+        break;
+    case JIT_OP_MUL_FLOAT:
+        emit_float_binop(inst, immed->mul_float.slot_lhs,
+                         immed->mul_float.slot_dst);
+        break;
+    case JIT_OP_DIV_FLOAT:
+        emit_float_binop(inst, immed->div_float.slot_src,
+                         immed->div_float.slot_dst);
+        break;
+    case JIT_OP_CLEAR_FLOAT:
+        st_slot(A64_ZR, immed->clear_float.slot_dst);
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        ld_slot_float(A64_S16, immed->sqrt_float.slot_dst);
+        a64asm_fsqrt_s(A64_S16, A64_S16);
+        st_slot_float(A64_S16, immed->sqrt_float.slot_dst);
+        break;
+    case JIT_OP_MUL_S32_WIDE:
+        emit_mul_32_wide(&immed->mul_s32_wide, true);
+        break;
+    case JIT_OP_MUL_U32_WIDE:
+        emit_mul_32_wide(&immed->mul_u32_wide, false);
+        break;
+    case JIT_OP_MACL:
+        emit_mac(&immed->macl, (void*)jit_macl_accum);
+        break;
+    case JIT_OP_MACW:
+        emit_mac(&immed->macw, (void*)jit_macw_accum);
+        break;
+    default:
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+}
+
+void
+code_block_aarch64_compile_call(void *arg, struct code_block_aarch64 *out,
+                                code_block_aarch64_call_fn fn,
+                                uint32_t const *hashp, uint32_t const *cyclesp,
+                                struct native_dispatch_meta const *dispatch_meta) {
+    out->cycle_count = 0;
+    out->native = out->exec_mem_alloc_start;
+
+    exec_mem_write_begin();
+    a64asm_set_dst(out->exec_mem_alloc_start, &out->bytes_used,
+                   AARCH64_ALLOC_SIZE);
+
+    a64asm_mov_imm64(A64_X0, (uintptr_t)arg);
+    a64asm_mov_imm64(A64_X1, (uintptr_t)dispatch_meta);
+    native_dispatch_call_emit((void*)fn);
+
+    // the PC is already in w0
+    a64asm_mov_imm64(A64_X9, (uintptr_t)hashp);
+    a64asm_ldr_w(NATIVE_DISPATCH_HASH_REG, A64_X9, 0);
+    a64asm_mov_imm64(A64_X9, (uintptr_t)cyclesp);
+    a64asm_ldr_w(NATIVE_DISPATCH_CYCLE_COUNT_REG, A64_X9, 0);
+
+    native_check_cycles_emit(dispatch_meta);
+
+    exec_mem_write_end();
+    exec_mem_flush(out->exec_mem_alloc_start, out->bytes_used);
+}
+
+void code_block_aarch64_compile(void *cpu, struct code_block_aarch64 *out,
+                                struct il_code_block const *il_blk,
+                                struct native_dispatch_meta const *dispatch_meta,
+                                unsigned cycle_count) {
+    struct jit_inst const* inst = il_blk->inst_list;
+    unsigned inst_count = il_blk->inst_count;
+    out->cycle_count = cycle_count;
+    out->native = out->exec_mem_alloc_start;
+
+    exec_mem_write_begin();
+    a64asm_set_dst(out->exec_mem_alloc_start, &out->bytes_used,
+                   AARCH64_ALLOC_SIZE);
+
+    n_jumps = 0;
+    n_jump_targets = 0;
+    n_side_exits = 0;
+
+    while (inst_count--) {
+        emit_inst(out, cpu, inst);
+
+        // code_block_intp stops at the jump, so this does too
+        if (inst->op == JIT_OP_JUMP)
+            break;
+        inst++;
+    }
+
+    if (il_blk->idle_loop) {
+        // see code_block_x86_64_compile
+        a64asm_mov_imm32(A64_X9, il_blk->idle_pc);
+        a64asm_cmp_w(NATIVE_DISPATCH_PC_REG, A64_X9);
+        void *not_idle = a64asm_b_cond_fwd(A64_COND_NE);
+        a64asm_mov_x(NATIVE_DISPATCH_COUNTDOWN_REG, A64_ZR);
+        a64asm_fixup_here(not_idle);
+    }
+
+    a64asm_mov_imm32(NATIVE_DISPATCH_CYCLE_COUNT_REG, out->cycle_count);
+    if (il_blk->dyn_cycles) {
+        a64asm_mov_imm64(A64_X9, (uintptr_t)il_blk->dyn_cycles);
+        a64asm_ldr_w(A64_X9, A64_X9, 0);
+        a64asm_add_w(NATIVE_DISPATCH_CYCLE_COUNT_REG,
+                     NATIVE_DISPATCH_CYCLE_COUNT_REG, A64_X9);
+    }
+
+    if (n_jumps == 1 && n_jump_targets) {
+        native_check_cycles_link_emit(dispatch_meta, out, n_jump_targets,
+                                      jump_addr, jump_hash);
+    } else {
+        native_check_cycles_emit(dispatch_meta);
+    }
+
+    emit_side_exits(dispatch_meta);
+
+    exec_mem_write_end();
+    exec_mem_flush(out->exec_mem_alloc_start, out->bytes_used);
+}
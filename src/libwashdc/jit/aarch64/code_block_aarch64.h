@@ -0,0 +1,86 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef CODE_BLOCK_AARCH64_H_
+#define CODE_BLOCK_AARCH64_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+struct il_code_block;
+struct native_dispatch_meta;
+struct native_link;
+
+struct code_block_aarch64 {
+    /*
+     * native points to the function where this code block is implemented.
+     * exec_mem_alloc_start points to the beginning of the actual allocation.
+     */
+    void *native; // void(*native)(void);
+    void *exec_mem_alloc_start;
+
+    uint32_t cycle_count;
+    unsigned bytes_used;
+
+    // see jit/x86_64/code_block_x86_64.h
+    struct native_link *links;
+    unsigned n_links;
+    struct native_link *links_in;
+    unsigned n_unchecked_out, n_unchecked_in;
+};
+
+void jit_aarch64_backend_init(void);
+void jit_aarch64_backend_cleanup(void);
+
+void code_block_aarch64_init(struct code_block_aarch64 *blk);
+void code_block_aarch64_cleanup(struct code_block_aarch64 *blk);
+
+void code_block_aarch64_compile(void *cpu, struct code_block_aarch64 *out,
+                                struct il_code_block const *il_blk,
+                                struct native_dispatch_meta const *dispatch_meta,
+                                unsigned cycle_count);
+
+typedef uint32_t(*code_block_aarch64_call_fn)(void*,
+                                              struct native_dispatch_meta const*);
+
+/*
+ * instead of compiling il, emit a block which calls fn(arg, dispatch_meta).
+ * fn returns the new PC, and it must leave the PC's hash in *hashp and the
+ * number of cycles it took in *cyclesp.
+ */
+void
+code_block_aarch64_compile_call(void *arg, struct code_block_aarch64 *out,
+                                code_block_aarch64_call_fn fn,
+                                uint32_t const *hashp, uint32_t const *cyclesp,
+                                struct native_dispatch_meta const *dispatch_meta);
+
+/*
+ * There's no register allocator yet, so every slot lives in memory.  This is
+ * where they are; native_dispatch keeps it in NATIVE_DISPATCH_SLOT_BASE_REG.
+ */
+void *code_block_aarch64_slot_base(void);
+
+#endif
@@ -0,0 +1,559 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "log.h"
+#include "washdc/error.h"
+#include "exec_mem.h"
+
+#include "emit_aarch64.h"
+
+#define AARCH64_GROW_SIZE 64
+
+static void *alloc_start;
+static unsigned alloc_len;
+
+static uint8_t *emitp;
+static unsigned *n_bytes_out;
+static unsigned emitp_len;
+
+static void try_grow(void) {
+    if (!alloc_start)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    if (exec_mem_grow(alloc_start, alloc_len + AARCH64_GROW_SIZE) != 0) {
+        LOG_ERROR("Unable to grow allocation to %u bytes\n",
+                  alloc_len + AARCH64_GROW_SIZE);
+        struct exec_mem_stats stats;
+        exec_mem_get_stats(&stats);
+        exec_mem_print_stats(&stats);
+        RAISE_ERROR(ERROR_OVERFLOW);
+    }
+
+    alloc_len += AARCH64_GROW_SIZE;
+    emitp_len += AARCH64_GROW_SIZE;
+}
+
+void a64asm_set_dst(void *out_ptr, unsigned *out_n_bytes, unsigned n_bytes) {
+    alloc_start = out_ptr;
+    alloc_len = n_bytes;
+    emitp = (uint8_t*)out_ptr;
+    emitp_len = n_bytes;
+    n_bytes_out = out_n_bytes;
+    if (n_bytes_out)
+        *n_bytes_out = 0;
+}
+
+void *a64asm_get_out_ptr(void) {
+    return emitp;
+}
+
+void a64asm_put32(uint32_t inst) {
+    if (emitp_len < sizeof(inst))
+        try_grow();
+    memcpy(exec_mem_rw(emitp), &inst, sizeof(inst));
+    emitp += sizeof(inst);
+    emitp_len -= sizeof(inst);
+    if (n_bytes_out)
+        *n_bytes_out += sizeof(inst);
+}
+
+#define REG(reg_no) ((uint32_t)((reg_no) & 31))
+
+static void movz(bool sf, unsigned rd, unsigned imm16, unsigned hw) {
+    a64asm_put32((sf ? 0xd2800000 : 0x52800000) |
+                 (hw << 21) | ((imm16 & 0xffff) << 5) | REG(rd));
+}
+
+static void movk(bool sf, unsigned rd, unsigned imm16, unsigned hw) {
+    a64asm_put32((sf ? 0xf2800000 : 0x72800000) |
+                 (hw << 21) | ((imm16 & 0xffff) << 5) | REG(rd));
+}
+
+static void movn_w(unsigned rd, unsigned imm16, unsigned hw) {
+    a64asm_put32(0x12800000 | (hw << 21) | ((imm16 & 0xffff) << 5) | REG(rd));
+}
+
+void a64asm_mov_imm32(unsigned rd, uint32_t imm) {
+    if (!(imm & 0xffff0000)) {
+        movz(false, rd, imm, 0);
+    } else if (!(imm & 0xffff)) {
+        movz(false, rd, imm >> 16, 1);
+    } else if (!(~imm & 0xffff0000)) {
+        movn_w(rd, ~imm, 0);
+    } else if (!(~imm & 0xffff)) {
+        movn_w(rd, ~imm >> 16, 1);
+    } else {
+        movz(false, rd, imm, 0);
+        movk(false, rd, imm >> 16, 1);
+    }
+}
+
+void a64asm_mov_imm64(unsigned rd, uint64_t imm) {
+    if (!(imm >> 32)) {
+        a64asm_mov_imm32(rd, imm);
+        return;
+    }
+
+    bool first = true;
+    unsigned hw;
+    for (hw = 0; hw < 4; hw++) {
+        unsigned imm16 = (imm >> (16 * hw)) & 0xffff;
+        if (!imm16)
+            continue;
+        if (first)
+            movz(true, rd, imm16, hw);
+        else
+            movk(true, rd, imm16, hw);
+        first = false;
+    }
+}
+
+void a64asm_mov_w(unsigned rd, unsigned rm) {
+    a64asm_put32(0x2a0003e0 | (REG(rm) << 16) | REG(rd));
+}
+
+void a64asm_mov_x(unsigned rd, unsigned rm) {
+    a64asm_put32(0xaa0003e0 | (REG(rm) << 16) | REG(rd));
+}
+
+static void addsub_imm(uint32_t opc, unsigned rd, unsigned rn, unsigned imm12) {
+    if (imm12 > 0xfff)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    a64asm_put32(opc | (imm12 << 10) | (REG(rn) << 5) | REG(rd));
+}
+
+void a64asm_add_imm_x(unsigned rd, unsigned rn, unsigned imm12) {
+    addsub_imm(0x91000000, rd, rn, imm12);
+}
+
+void a64asm_sub_imm_x(unsigned rd, unsigned rn, unsigned imm12) {
+    addsub_imm(0xd1000000, rd, rn, imm12);
+}
+
+void a64asm_add_imm_w(unsigned rd, unsigned rn, unsigned imm12) {
+    addsub_imm(0x11000000, rd, rn, imm12);
+}
+
+void a64asm_cmp_imm_w(unsigned rn, unsigned imm12) {
+    addsub_imm(0x71000000, A64_ZR, rn, imm12);
+}
+
+void a64asm_cmp_imm_x(unsigned rn, unsigned imm12) {
+    addsub_imm(0xf1000000, A64_ZR, rn, imm12);
+}
+
+static void three_reg(uint32_t opc, unsigned rd, unsigned rn, unsigned rm) {
+    a64asm_put32(opc | (REG(rm) << 16) | (REG(rn) << 5) | REG(rd));
+}
+
+void a64asm_add_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x0b000000, rd, rn, rm);
+}
+
+void a64asm_sub_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x4b000000, rd, rn, rm);
+}
+
+void a64asm_sub_x(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0xcb000000, rd, rn, rm);
+}
+
+void a64asm_subs_x(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0xeb000000, rd, rn, rm);
+}
+
+void a64asm_cmp_w(unsigned rn, unsigned rm) {
+    three_reg(0x6b000000, A64_ZR, rn, rm);
+}
+
+void a64asm_and_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x0a000000, rd, rn, rm);
+}
+
+void a64asm_orr_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x2a000000, rd, rn, rm);
+}
+
+void a64asm_eor_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x4a000000, rd, rn, rm);
+}
+
+void a64asm_mvn_w(unsigned rd, unsigned rm) {
+    three_reg(0x2a200000, rd, A64_ZR, rm);
+}
+
+void a64asm_neg_w(unsigned rd, unsigned rm) {
+    three_reg(0x4b000000, rd, A64_ZR, rm);
+}
+
+void a64asm_mul_w(unsigned rd, unsigned rn, unsigned rm) {
+    // madd rd, rn, rm, wzr
+    three_reg(0x1b007c00, rd, rn, rm);
+}
+
+void a64asm_smull_x(unsigned rd, unsigned rn, unsigned rm) {
+    // smaddl xd, wn, wm, xzr
+    three_reg(0x9b207c00, rd, rn, rm);
+}
+
+void a64asm_umull_x(unsigned rd, unsigned rn, unsigned rm) {
+    // umaddl xd, wn, wm, xzr
+    three_reg(0x9ba07c00, rd, rn, rm);
+}
+
+void a64asm_orr_lsl_x(unsigned rd, unsigned rn, unsigned rm, unsigned shift) {
+    three_reg(0xaa000000 | ((shift & 63) << 10), rd, rn, rm);
+}
+
+void a64asm_and_lowbits_w(unsigned rd, unsigned rn, unsigned n_bits) {
+    if (n_bits < 1 || n_bits > 31)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    // N=0, immr=0, imms=n_bits-1 is a run of n_bits ones
+    a64asm_put32(0x12000000 | ((n_bits - 1) << 10) |
+                 (REG(rn) << 5) | REG(rd));
+}
+
+void a64asm_lslv_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1ac02000, rd, rn, rm);
+}
+
+void a64asm_lsrv_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1ac02400, rd, rn, rm);
+}
+
+void a64asm_asrv_w(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1ac02800, rd, rn, rm);
+}
+
+static void bfm(uint32_t opc, unsigned rd, unsigned rn,
+                unsigned immr, unsigned imms) {
+    a64asm_put32(opc | ((immr & 31) << 16) | ((imms & 31) << 10) |
+                 (REG(rn) << 5) | REG(rd));
+}
+
+#define UBFM_W 0x53000000
+#define SBFM_W 0x13000000
+
+void a64asm_lsl_imm_w(unsigned rd, unsigned rn, unsigned shift) {
+    shift &= 31;
+    bfm(UBFM_W, rd, rn, (32 - shift) & 31, 31 - shift);
+}
+
+void a64asm_lsr_imm_w(unsigned rd, unsigned rn, unsigned shift) {
+    bfm(UBFM_W, rd, rn, shift & 31, 31);
+}
+
+void a64asm_asr_imm_w(unsigned rd, unsigned rn, unsigned shift) {
+    bfm(SBFM_W, rd, rn, shift & 31, 31);
+}
+
+void a64asm_lsr_imm_x(unsigned rd, unsigned rn, unsigned shift) {
+    // ubfm xd, xn, #shift, #63
+    a64asm_put32(0xd340fc00 | ((shift & 63) << 16) | (REG(rn) << 5) | REG(rd));
+}
+
+void a64asm_sxtb_w(unsigned rd, unsigned rn) {
+    bfm(SBFM_W, rd, rn, 0, 7);
+}
+
+void a64asm_sxth_w(unsigned rd, unsigned rn) {
+    bfm(SBFM_W, rd, rn, 0, 15);
+}
+
+void a64asm_uxtb_w(unsigned rd, unsigned rn) {
+    bfm(UBFM_W, rd, rn, 0, 7);
+}
+
+void a64asm_uxth_w(unsigned rd, unsigned rn) {
+    bfm(UBFM_W, rd, rn, 0, 15);
+}
+
+void a64asm_cset_w(unsigned rd, enum a64asm_cond cond) {
+    // csinc rd, wzr, wzr, !cond
+    a64asm_put32(0x1a9f07e0 | ((((unsigned)cond) ^ 1) << 12) | REG(rd));
+}
+
+void a64asm_csel_w(unsigned rd, unsigned rn, unsigned rm,
+                   enum a64asm_cond cond) {
+    a64asm_put32(0x1a800000 | (REG(rm) << 16) | (((unsigned)cond) << 12) |
+                 (REG(rn) << 5) | REG(rd));
+}
+
+/*
+ * opc_imm is the unsigned-offset form of the instruction and opc_reg is the
+ * register-offset form.  scale is log2 of the access size.
+ */
+static void ldst(uint32_t opc_imm, uint32_t opc_reg, unsigned scale,
+                 unsigned rt, unsigned rn, unsigned offs) {
+    if (!(offs & ((1 << scale) - 1)) && (offs >> scale) <= 0xfff) {
+        a64asm_put32(opc_imm | ((offs >> scale) << 10) |
+                     (REG(rn) << 5) | REG(rt));
+    } else {
+        // [rn + x17, lsl #0]
+        a64asm_mov_imm32(A64_X17, offs);
+        a64asm_put32(opc_reg | (3 << 13) | (REG(A64_X17) << 16) |
+                     (REG(rn) << 5) | REG(rt));
+    }
+}
+
+#define LDR_X  0xf9400000, 0xf8600800, 3
+#define LDR_W  0xb9400000, 0xb8600800, 2
+#define LDRH_W 0x79400000, 0x78600800, 1
+#define LDRB_W 0x39400000, 0x38600800, 0
+#define LDR_S  0xbd400000, 0xbc600800, 2
+#define STR_X  0xf9000000, 0xf8200800, 3
+#define STR_W  0xb9000000, 0xb8200800, 2
+#define STRH_W 0x79000000, 0x78200800, 1
+#define STRB_W 0x39000000, 0x38200800, 0
+#define STR_S  0xbd000000, 0xbc200800, 2
+
+void a64asm_ldr_x(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(LDR_X, rt, rn, offs);
+}
+
+void a64asm_ldr_w(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(LDR_W, rt, rn, offs);
+}
+
+void a64asm_ldrh_w(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(LDRH_W, rt, rn, offs);
+}
+
+void a64asm_ldrb_w(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(LDRB_W, rt, rn, offs);
+}
+
+void a64asm_ldr_s(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(LDR_S, rt, rn, offs);
+}
+
+void a64asm_str_x(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(STR_X, rt, rn, offs);
+}
+
+void a64asm_str_w(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(STR_W, rt, rn, offs);
+}
+
+void a64asm_strh_w(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(STRH_W, rt, rn, offs);
+}
+
+void a64asm_strb_w(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(STRB_W, rt, rn, offs);
+}
+
+void a64asm_str_s(unsigned rt, unsigned rn, unsigned offs) {
+    ldst(STR_S, rt, rn, offs);
+}
+
+// option=UXTW (010), S=0
+#define UXTW_OPTION (2 << 13)
+
+static void ldst_uxtw(uint32_t opc_reg, unsigned rt, unsigned rn, unsigned rm) {
+    a64asm_put32(opc_reg | UXTW_OPTION | (REG(rm) << 16) |
+                 (REG(rn) << 5) | REG(rt));
+}
+
+void a64asm_ldr_w_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0xb8600800, rt, rn, rm);
+}
+
+void a64asm_ldrh_w_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0x78600800, rt, rn, rm);
+}
+
+void a64asm_ldrb_w_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0x38600800, rt, rn, rm);
+}
+
+void a64asm_ldr_s_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0xbc600800, rt, rn, rm);
+}
+
+void a64asm_str_w_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0xb8200800, rt, rn, rm);
+}
+
+void a64asm_strh_w_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0x78200800, rt, rn, rm);
+}
+
+void a64asm_strb_w_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0x38200800, rt, rn, rm);
+}
+
+void a64asm_str_s_uxtw(unsigned rt, unsigned rn, unsigned rm) {
+    ldst_uxtw(0xbc200800, rt, rn, rm);
+}
+
+void a64asm_ldr_x_lsl3(unsigned rt, unsigned rn, unsigned rm) {
+    // UXTW with S=1 scales the index by 8
+    ldst_uxtw(0xf8601800, rt, rn, rm);
+}
+
+static void ldstp(uint32_t opc, unsigned rt, unsigned rt2,
+                  unsigned rn, int offs) {
+    if ((offs % 8) || offs < -512 || offs > 504)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    a64asm_put32(opc | ((((uint32_t)(offs / 8)) & 0x7f) << 15) |
+                 (REG(rt2) << 10) | (REG(rn) << 5) | REG(rt));
+}
+
+void a64asm_stp_x_pre(unsigned rt, unsigned rt2, unsigned rn, int offs) {
+    ldstp(0xa9800000, rt, rt2, rn, offs);
+}
+
+void a64asm_ldp_x_post(unsigned rt, unsigned rt2, unsigned rn, int offs) {
+    ldstp(0xa8c00000, rt, rt2, rn, offs);
+}
+
+void a64asm_stp_x(unsigned rt, unsigned rt2, unsigned rn, int offs) {
+    ldstp(0xa9000000, rt, rt2, rn, offs);
+}
+
+void a64asm_ldp_x(unsigned rt, unsigned rt2, unsigned rn, int offs) {
+    ldstp(0xa9400000, rt, rt2, rn, offs);
+}
+
+void a64asm_fadd_s(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1e202800, rd, rn, rm);
+}
+
+void a64asm_fsub_s(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1e203800, rd, rn, rm);
+}
+
+void a64asm_fmul_s(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1e200800, rd, rn, rm);
+}
+
+void a64asm_fdiv_s(unsigned rd, unsigned rn, unsigned rm) {
+    three_reg(0x1e201800, rd, rn, rm);
+}
+
+void a64asm_fsqrt_s(unsigned rd, unsigned rn) {
+    a64asm_put32(0x1e21c000 | (REG(rn) << 5) | REG(rd));
+}
+
+void a64asm_fcmp_s(unsigned rn, unsigned rm) {
+    a64asm_put32(0x1e202000 | (REG(rm) << 16) | (REG(rn) << 5));
+}
+
+void a64asm_b(void const *dst) {
+    void *site = a64asm_b_fwd();
+    a64asm_fixup(site, dst);
+}
+
+void a64asm_br(unsigned rn) {
+    a64asm_put32(0xd61f0000 | (REG(rn) << 5));
+}
+
+void a64asm_blr(unsigned rn) {
+    a64asm_put32(0xd63f0000 | (REG(rn) << 5));
+}
+
+void a64asm_ret(void) {
+    a64asm_put32(0xd65f03c0);
+}
+
+/*
+ * the forward branches initially point at themselves, which is at least an
+ * infinite loop instead of a jump into garbage if somebody forgets to fix
+ * them up.
+ */
+void *a64asm_b_fwd(void) {
+    void *site = emitp;
+    a64asm_put32(0x14000000);
+    return site;
+}
+
+void *a64asm_b_cond_fwd(enum a64asm_cond cond) {
+    void *site = emitp;
+    a64asm_put32(0x54000000 | (unsigned)cond);
+    return site;
+}
+
+void *a64asm_cbz_w_fwd(unsigned rt) {
+    void *site = emitp;
+    a64asm_put32(0x34000000 | REG(rt));
+    return site;
+}
+
+void *a64asm_tbz_fwd(unsigned rt, unsigned bit) {
+    void *site = emitp;
+    a64asm_put32(0x36000000 | ((bit >> 5) << 31) | ((bit & 31) << 19) |
+                 REG(rt));
+    return site;
+}
+
+void *a64asm_tbnz_fwd(unsigned rt, unsigned bit) {
+    void *site = emitp;
+    a64asm_put32(0x37000000 | ((bit >> 5) << 31) | ((bit & 31) << 19) |
+                 REG(rt));
+    return site;
+}
+
+void a64asm_fixup(void *site, void const *dst) {
+    uint32_t inst;
+    uint32_t *site_rw = (uint32_t*)exec_mem_rw(site);
+    memcpy(&inst, site_rw, sizeof(inst));
+
+    intptr_t disp = ((char const*)dst) - ((char const*)site);
+    if (disp % 4)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    disp /= 4;
+
+    unsigned n_bits, shift;
+    if ((inst & 0x7c000000) == 0x14000000) {
+        // b/bl
+        n_bits = 26;
+        shift = 0;
+    } else if ((inst & 0xff000010) == 0x54000000 ||
+               (inst & 0x7e000000) == 0x34000000) {
+        // b.cond, cbz/cbnz
+        n_bits = 19;
+        shift = 5;
+    } else if ((inst & 0x7e000000) == 0x36000000) {
+        // tbz/tbnz
+        n_bits = 14;
+        shift = 5;
+    } else {
+        LOG_ERROR("%s - 0x%08x at %p is not a branch\n",
+                  __func__, (unsigned)inst, site);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    intptr_t lim = ((intptr_t)1) << (n_bits - 1);
+    if (disp >= lim || disp < -lim)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    uint32_t field_mask = ((((uint32_t)1) << n_bits) - 1) << shift;
+    inst = (inst & ~field_mask) | ((((uint32_t)disp) << shift) & field_mask);
+    memcpy(site_rw, &inst, sizeof(inst));
+}
@@ -0,0 +1,222 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef EMIT_AARCH64_H_
+#define EMIT_AARCH64_H_
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * general-purpose registers.  Register 31 is either the zero register or the
+ * stack pointer depending on the instruction.
+ *
+ * X16 and X17 are the intra-procedure-call scratch registers.  The emitter
+ * uses X17 to build addresses which are too far away for an immediate offset,
+ * and native_dispatch uses X16 for calls and far jumps.  Nothing else should
+ * keep values in either of them.
+ */
+#define A64_X0   0
+#define A64_X1   1
+#define A64_X2   2
+#define A64_X3   3
+#define A64_X9   9
+#define A64_X10 10
+#define A64_X11 11
+#define A64_X12 12
+#define A64_X13 13
+#define A64_X16 16
+#define A64_X17 17
+#define A64_X19 19
+#define A64_X20 20
+#define A64_X21 21
+#define A64_X22 22
+#define A64_FP  29
+#define A64_LR  30
+#define A64_ZR  31
+#define A64_SP  31
+
+// floating-point registers
+#define A64_S0   0
+#define A64_S16 16
+#define A64_S17 17
+
+enum a64asm_cond {
+    A64_COND_EQ = 0,
+    A64_COND_NE = 1,
+    A64_COND_HS = 2,
+    A64_COND_LO = 3,
+    A64_COND_MI = 4,
+    A64_COND_PL = 5,
+    A64_COND_HI = 8,
+    A64_COND_LS = 9,
+    A64_COND_GE = 10,
+    A64_COND_LT = 11,
+    A64_COND_GT = 12,
+    A64_COND_LE = 13
+};
+
+/*
+ * Unlike the x86_64 emitter, every function here takes its operands in the
+ * same order as the assembly syntax: destination first.  The _w functions
+ * operate on the 32-bit views of the registers and the _x functions operate on
+ * all 64 bits.
+ *
+ * Code gets written through exec_mem_rw, so it's safe to emit into a
+ * dual-mapped arena.  Nothing here flushes the instruction cache; that's the
+ * caller's job once it's done emitting.
+ */
+void a64asm_set_dst(void *out_ptr, unsigned *out_n_bytes, unsigned n_bytes);
+void *a64asm_get_out_ptr(void);
+
+void a64asm_put32(uint32_t inst);
+
+void a64asm_mov_imm32(unsigned rd, uint32_t imm);
+void a64asm_mov_imm64(unsigned rd, uint64_t imm);
+void a64asm_mov_w(unsigned rd, unsigned rm);
+void a64asm_mov_x(unsigned rd, unsigned rm);
+
+// these two treat register 31 as SP rather than the zero register
+void a64asm_add_imm_x(unsigned rd, unsigned rn, unsigned imm12);
+void a64asm_sub_imm_x(unsigned rd, unsigned rn, unsigned imm12);
+
+void a64asm_add_imm_w(unsigned rd, unsigned rn, unsigned imm12);
+void a64asm_cmp_imm_w(unsigned rn, unsigned imm12);
+void a64asm_cmp_imm_x(unsigned rn, unsigned imm12);
+
+void a64asm_add_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_sub_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_sub_x(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_subs_x(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_cmp_w(unsigned rn, unsigned rm);
+void a64asm_and_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_orr_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_eor_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_mvn_w(unsigned rd, unsigned rm);
+void a64asm_neg_w(unsigned rd, unsigned rm);
+void a64asm_mul_w(unsigned rd, unsigned rn, unsigned rm);
+
+// 32x32->64 multiplies: xd = wn * wm
+void a64asm_smull_x(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_umull_x(unsigned rd, unsigned rn, unsigned rm);
+
+// xd = xn | (xm << shift)
+void a64asm_orr_lsl_x(unsigned rd, unsigned rn, unsigned rm, unsigned shift);
+
+// rd = rn & ((1 << n_bits) - 1), for 1 <= n_bits <= 31
+void a64asm_and_lowbits_w(unsigned rd, unsigned rn, unsigned n_bits);
+
+void a64asm_lslv_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_lsrv_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_asrv_w(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_lsl_imm_w(unsigned rd, unsigned rn, unsigned shift);
+void a64asm_lsr_imm_w(unsigned rd, unsigned rn, unsigned shift);
+void a64asm_asr_imm_w(unsigned rd, unsigned rn, unsigned shift);
+void a64asm_lsr_imm_x(unsigned rd, unsigned rn, unsigned shift);
+
+void a64asm_sxtb_w(unsigned rd, unsigned rn);
+void a64asm_sxth_w(unsigned rd, unsigned rn);
+void a64asm_uxtb_w(unsigned rd, unsigned rn);
+void a64asm_uxth_w(unsigned rd, unsigned rn);
+
+void a64asm_cset_w(unsigned rd, enum a64asm_cond cond);
+void a64asm_csel_w(unsigned rd, unsigned rn, unsigned rm,
+                   enum a64asm_cond cond);
+
+/*
+ * loads and stores at [rn + offs].  Offsets which don't fit in the scaled
+ * 12-bit immediate get built in X17.  The _s variants move single-precision
+ * floats.
+ */
+void a64asm_ldr_x(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_ldr_w(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_ldrh_w(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_ldrb_w(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_ldr_s(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_str_x(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_str_w(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_strh_w(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_strb_w(unsigned rt, unsigned rn, unsigned offs);
+void a64asm_str_s(unsigned rt, unsigned rn, unsigned offs);
+
+// loads and stores at [rn + zero-extended wm]
+void a64asm_ldr_w_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_ldrh_w_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_ldrb_w_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_ldr_s_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_str_w_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_strh_w_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_strb_w_uxtw(unsigned rt, unsigned rn, unsigned rm);
+void a64asm_str_s_uxtw(unsigned rt, unsigned rn, unsigned rm);
+
+// rt = *(uint64_t*)(rn + (wm << 3))
+void a64asm_ldr_x_lsl3(unsigned rt, unsigned rn, unsigned rm);
+
+// stp/ldp of 64-bit registers.  offs is in bytes.
+void a64asm_stp_x_pre(unsigned rt, unsigned rt2, unsigned rn, int offs);
+void a64asm_ldp_x_post(unsigned rt, unsigned rt2, unsigned rn, int offs);
+void a64asm_stp_x(unsigned rt, unsigned rt2, unsigned rn, int offs);
+void a64asm_ldp_x(unsigned rt, unsigned rt2, unsigned rn, int offs);
+
+void a64asm_fadd_s(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_fsub_s(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_fmul_s(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_fdiv_s(unsigned rd, unsigned rn, unsigned rm);
+void a64asm_fsqrt_s(unsigned rd, unsigned rn);
+void a64asm_fcmp_s(unsigned rn, unsigned rm);
+
+/*
+ * branches to a known address.  These raise ERROR_INTEGRITY if the
+ * destination is out of range; everything in exec_mem is within range of b.
+ */
+void a64asm_b(void const *dst);
+void a64asm_br(unsigned rn);
+void a64asm_blr(unsigned rn);
+void a64asm_ret(void);
+
+/*
+ * forward branches.  These emit a branch with no destination and return its
+ * address so that it can be pointed somewhere later with a64asm_fixup.
+ */
+void *a64asm_b_fwd(void);
+void *a64asm_b_cond_fwd(enum a64asm_cond cond);
+void *a64asm_cbz_w_fwd(unsigned rt);
+void *a64asm_tbz_fwd(unsigned rt, unsigned bit);
+void *a64asm_tbnz_fwd(unsigned rt, unsigned bit);
+
+/*
+ * point the branch at site to dst.  This works on b, b.cond, cbz/cbnz and
+ * tbz/tbnz, and it can be used on code that's already been emitted and
+ * isn't the current destination.
+ */
+void a64asm_fixup(void *site, void const *dst);
+
+// point a forward branch at the current output pointer
+static inline void a64asm_fixup_here(void *site) {
+    a64asm_fixup(site, a64asm_get_out_ptr());
+}
+
+#endif
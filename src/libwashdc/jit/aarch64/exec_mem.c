@@ -0,0 +1,592 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#ifdef _WIN32
+#error the AArch64 JIT backend does not support Windows yet
+#endif
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#ifdef __APPLE__
+#include <pthread.h>
+#include <libkern/OSCacheControl.h>
+#endif
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "log.h"
+#include "config.h"
+#include "washdc/error.h"
+#include "hostmem.h"
+#include "threading.h"
+
+#include "exec_mem.h"
+
+#define AARCH64_ALLOC_SIZE (128 * 1024 * 1024)
+
+// executable view of the arena
+static void *native;
+
+/*
+ * writable view of the arena.  Unless the arena is dual-mapped this is the
+ * same as native.
+ */
+static uint8_t *native_rw;
+static bool dual_map;
+
+// true if the arena is MAP_JIT and writes need to be bracketed
+static bool jit_protect;
+/*
+ * MAP_JIT write protection is per-thread, and the background compiler writes
+ * code on its own thread.
+ */
+static _Thread_local unsigned write_depth;
+
+ptrdiff_t exec_mem_rw_offs;
+
+/*
+ * the background compiler allocates blocks on its own thread while the
+ * emulation thread frees them, so everything below goes through this lock.
+ */
+static washdc_mutex exec_mem_lock = WASHDC_MUTEX_STATIC_INIT;
+
+#define EXEC_MEM_SEG_SHIFT 22
+#define EXEC_MEM_SEG_SIZE ((size_t)1 << EXEC_MEM_SEG_SHIFT)
+#define EXEC_MEM_N_SEGS (AARCH64_ALLOC_SIZE / EXEC_MEM_SEG_SIZE)
+
+// see the x86_64 exec_mem for why this exists
+#define EXEC_MEM_SEG_HEADROOM (256 * 1024)
+
+#define ALLOC_CHUNK_MAGIC 0xfeedface
+
+struct alloc_chunk {
+#ifdef INVARIANTS
+    unsigned magic;
+#endif
+    size_t len, len_req;
+};
+
+struct exec_mem_seg {
+    // offset of the first unused byte
+    size_t bump;
+
+    // number of allocations in this segment that haven't been freed yet
+    unsigned n_live;
+
+    // most recent allocation, or NULL if there isn't one that can grow
+    struct alloc_chunk *newest;
+
+    // next segment on the free list, or -1
+    int next_free;
+};
+
+static struct exec_mem_seg segs[EXEC_MEM_N_SEGS];
+static int free_segs;
+static unsigned free_seg_count;
+
+/*
+ * every lane has its own current segment, see exec_mem_set_lane.  cur_lane is
+ * the lane that the calling thread allocates out of.
+ */
+static int cur_seg[EXEC_MEM_N_LANES];
+static _Thread_local unsigned cur_lane;
+
+static size_t n_allocations;
+
+static void *get_alloc_start(void *alloc_ptr);
+static void get_stats_locked(struct exec_mem_stats *stats);
+
+static size_t alloc_hdr_len(void) {
+    size_t disp = sizeof(struct alloc_chunk);
+    while (disp % 8)
+        disp++;
+    return disp;
+}
+
+// length of an allocation including its header and padding
+static size_t alloc_full_len(size_t len_req) {
+    size_t len = len_req + alloc_hdr_len();
+    while (len % 8)
+        len++;
+    return len;
+}
+
+// all of the allocator's bookkeeping goes through the writable view
+static uint8_t *seg_base(int seg_no) {
+    return native_rw + ((size_t)seg_no << EXEC_MEM_SEG_SHIFT);
+}
+
+static int seg_of(void const *ptr) {
+    uintptr_t offs = (uintptr_t)ptr - (uintptr_t)native_rw;
+    if (offs >= AARCH64_ALLOC_SIZE)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    return offs >> EXEC_MEM_SEG_SHIFT;
+}
+
+static void seg_reset(int seg_no) {
+    segs[seg_no].bump = 0;
+    segs[seg_no].newest = NULL;
+}
+
+static void seg_push_free(int seg_no) {
+    seg_reset(seg_no);
+    segs[seg_no].next_free = free_segs;
+    free_segs = seg_no;
+    free_seg_count++;
+}
+
+static bool seg_is_current(int seg_no) {
+    unsigned lane;
+    for (lane = 0; lane < EXEC_MEM_N_LANES; lane++)
+        if (cur_seg[lane] == seg_no)
+            return true;
+    return false;
+}
+
+// returns false if there are no free segments left
+static bool seg_advance(unsigned lane) {
+    if (free_segs < 0)
+        return false;
+
+    int old_seg = cur_seg[lane];
+    cur_seg[lane] = free_segs;
+    free_segs = segs[cur_seg[lane]].next_free;
+    free_seg_count--;
+    segs[cur_seg[lane]].next_free = -1;
+
+    if (!segs[old_seg].n_live)
+        seg_push_free(old_seg);
+
+    return true;
+}
+
+#ifndef __APPLE__
+/*
+ * map the same shared memory object twice: once read/execute and once
+ * read/write.  AArch64 code never addresses data relative to the PC, so unlike
+ * the x86_64 version the two views don't need to be adjacent.  Returns zero on
+ * success.
+ */
+static int exec_mem_map_dual(void) {
+    int fd;
+#ifdef __linux__
+    fd = memfd_create("washdc_exec_mem", MFD_CLOEXEC);
+#else
+    char name[64];
+    snprintf(name, sizeof(name), "/washdc_exec_mem_%ld", (long)getpid());
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+        shm_unlink(name);
+#endif
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, AARCH64_ALLOC_SIZE) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *rx = mmap(NULL, AARCH64_ALLOC_SIZE, PROT_READ | PROT_EXEC,
+                    MAP_SHARED, fd, 0);
+    void *rw = mmap(NULL, AARCH64_ALLOC_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (rx == MAP_FAILED || rw == MAP_FAILED) {
+        if (rx != MAP_FAILED)
+            munmap(rx, AARCH64_ALLOC_SIZE);
+        if (rw != MAP_FAILED)
+            munmap(rw, AARCH64_ALLOC_SIZE);
+        return -1;
+    }
+
+    hostmem_advise_huge(rx, AARCH64_ALLOC_SIZE);
+    hostmem_advise_huge(rw, AARCH64_ALLOC_SIZE);
+
+    native = rx;
+    native_rw = rw;
+    return 0;
+}
+#endif
+
+void exec_mem_init(void) {
+    dual_map = false;
+    jit_protect = false;
+
+#ifdef __APPLE__
+    if (config_get_jit_dual_map())
+        LOG_WARN("%s - dual-mapped jit memory is not supported on this "
+                 "platform; using MAP_JIT instead\n", __func__);
+
+    native = mmap(NULL, AARCH64_ALLOC_SIZE,
+                  PROT_WRITE | PROT_EXEC | PROT_READ,
+                  MAP_ANONYMOUS | MAP_PRIVATE | MAP_JIT, -1, 0);
+    if (native == MAP_FAILED)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    native_rw = native;
+    jit_protect = true;
+    pthread_jit_write_protect_np(1);
+#else
+    if (!config_get_jit_dual_map()) {
+        native = mmap(NULL, AARCH64_ALLOC_SIZE,
+                      PROT_WRITE | PROT_EXEC | PROT_READ,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (native != MAP_FAILED) {
+            native_rw = native;
+            hostmem_advise_huge(native, AARCH64_ALLOC_SIZE);
+        } else {
+            // hardened kernels refuse mappings which are writable and executable
+            LOG_WARN("%s - unable to map W|X memory; falling back to a "
+                     "dual-mapped arena\n", __func__);
+            dual_map = true;
+        }
+    } else {
+        dual_map = true;
+    }
+
+    if (dual_map && exec_mem_map_dual() != 0)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+#endif
+
+    exec_mem_rw_offs = native_rw - (uint8_t*)native;
+
+    memset(segs, 0, sizeof(segs));
+    n_allocations = 0;
+
+    free_segs = -1;
+    free_seg_count = 0;
+    int seg_no;
+    for (seg_no = 0; seg_no < EXEC_MEM_N_LANES; seg_no++) {
+        cur_seg[seg_no] = seg_no;
+        segs[seg_no].next_free = -1;
+    }
+    for (seg_no = EXEC_MEM_N_SEGS - 1; seg_no >= EXEC_MEM_N_LANES; seg_no--)
+        seg_push_free(seg_no);
+}
+
+void exec_mem_set_lane(unsigned lane) {
+    if (lane >= EXEC_MEM_N_LANES)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    cur_lane = lane;
+}
+
+void exec_mem_cleanup(void) {
+    munmap(native, AARCH64_ALLOC_SIZE);
+    if (dual_map)
+        munmap(native_rw, AARCH64_ALLOC_SIZE);
+    native = NULL;
+    native_rw = NULL;
+    exec_mem_rw_offs = 0;
+}
+
+void exec_mem_write_begin(void) {
+#ifdef __APPLE__
+    if (jit_protect && !write_depth++)
+        pthread_jit_write_protect_np(0);
+#endif
+}
+
+void exec_mem_write_end(void) {
+#ifdef __APPLE__
+    if (!jit_protect)
+        return;
+    if (!write_depth)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    if (!--write_depth)
+        pthread_jit_write_protect_np(1);
+#endif
+}
+
+void exec_mem_flush(void const *ptr, size_t len) {
+#ifdef __APPLE__
+    sys_icache_invalidate((void*)ptr, len);
+#else
+    /*
+     * Data caches are physically tagged, so cleaning through the executable
+     * view also cleans whatever got written through the writable view.
+     */
+    __builtin___clear_cache((char*)ptr, ((char*)ptr) + len);
+#endif
+}
+
+// allocations are always aligned to 8 bytes, which is more than code needs
+static void *alloc_locked(size_t len_req) {
+    size_t len = alloc_full_len(len_req);
+
+    if (len + EXEC_MEM_SEG_HEADROOM > EXEC_MEM_SEG_SIZE) {
+        LOG_ERROR("%s - allocation of size %llu is too big\n",
+                  __func__, (unsigned long long)len);
+        return NULL;
+    }
+
+    unsigned lane = cur_lane;
+    struct exec_mem_seg *seg = segs + cur_seg[lane];
+    if (seg->bump + len + EXEC_MEM_SEG_HEADROOM > EXEC_MEM_SEG_SIZE) {
+        if (!seg_advance(lane)) {
+            struct exec_mem_stats stats;
+            LOG_ERROR("%s - failed alloc of size %llu\n",
+                      __func__, (unsigned long long)len);
+            LOG_ERROR("exec_mem stats dump follows\n");
+            get_stats_locked(&stats);
+            exec_mem_print_stats(&stats);
+            return NULL;
+        }
+        seg = segs + cur_seg[lane];
+    }
+
+    exec_mem_write_begin();
+
+    struct alloc_chunk *chunk =
+        (struct alloc_chunk*)(void*)(seg_base(cur_seg[lane]) + seg->bump);
+    seg->bump += len;
+    seg->n_live++;
+    seg->newest = chunk;
+
+    chunk->len = len;
+    chunk->len_req = len_req;
+#ifdef INVARIANTS
+    chunk->magic = ALLOC_CHUNK_MAGIC;
+#endif
+
+    n_allocations++;
+
+    uint8_t *ret = ((uint8_t*)chunk) + alloc_hdr_len();
+    memset(ret, 0, len_req);
+
+    exec_mem_write_end();
+
+    return ret - exec_mem_rw_offs;
+}
+
+static void free_locked(void *ptr) {
+    struct alloc_chunk *alloc = (struct alloc_chunk*)get_alloc_start(ptr);
+
+#ifdef INVARIANTS
+    if (((uintptr_t)alloc) % 8) {
+        LOG_ERROR("%p is not 8-byte aligned!\n", alloc);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    if (alloc->magic != ALLOC_CHUNK_MAGIC) {
+        LOG_ERROR("Corrupted alloc_chunk at %p\n", alloc);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    exec_mem_write_begin();
+    alloc->magic = 0;
+    exec_mem_write_end();
+#endif
+
+    int seg_no = seg_of(alloc);
+    struct exec_mem_seg *seg = segs + seg_no;
+
+    if (!seg->n_live)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    if (seg->newest == alloc) {
+        // give the tail back so it can be reused right away
+        seg->bump -= alloc->len;
+        seg->newest = NULL;
+    }
+
+    if (!--seg->n_live) {
+        if (seg_is_current(seg_no))
+            seg_reset(seg_no);
+        else
+            seg_push_free(seg_no);
+    }
+
+    n_allocations--;
+}
+
+static int grow_locked(void *ptr, size_t len_req) {
+    struct alloc_chunk *alloc = (struct alloc_chunk*)get_alloc_start(ptr);
+
+#ifdef INVARIANTS
+    if (alloc->magic != ALLOC_CHUNK_MAGIC)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    if (alloc->len_req >= len_req)
+        return 0; // nothing to do here, i suppose
+
+    int seg_no = seg_of(alloc);
+    struct exec_mem_seg *seg = segs + seg_no;
+
+    // something else has already been allocated after this
+    if (seg->newest != alloc)
+        return -1;
+
+    size_t offs = ((uint8_t*)alloc) - seg_base(seg_no);
+    size_t len = alloc_full_len(len_req);
+    if (offs + len > EXEC_MEM_SEG_SIZE)
+        return -1;
+
+    seg->bump = offs + len;
+
+    exec_mem_write_begin();
+    alloc->len = len;
+    alloc->len_req = len_req;
+    exec_mem_write_end();
+
+    return 0;
+}
+
+static void *get_alloc_start(void *alloc_ptr) {
+    uint8_t *as_rw = (uint8_t*)alloc_ptr;
+
+    if (as_rw < native_rw || as_rw >= native_rw + AARCH64_ALLOC_SIZE)
+        as_rw += exec_mem_rw_offs;
+
+    return as_rw - alloc_hdr_len();
+}
+
+static void get_stats_locked(struct exec_mem_stats *stats) {
+    size_t n_bytes = 0;
+    unsigned n_free_segs = 0;
+    int seg_no;
+    for (seg_no = 0; seg_no < EXEC_MEM_N_SEGS; seg_no++) {
+        n_bytes += EXEC_MEM_SEG_SIZE - segs[seg_no].bump;
+        if (!segs[seg_no].n_live)
+            n_free_segs++;
+    }
+
+    stats->total_bytes = AARCH64_ALLOC_SIZE;
+    stats->free_bytes = n_bytes;
+    stats->n_allocations = n_allocations;
+    stats->n_free_segs = n_free_segs;
+    stats->n_segs = EXEC_MEM_N_SEGS;
+}
+
+void exec_mem_print_stats(struct exec_mem_stats const *stats) {
+    double percent =
+        100.0 * (double)stats->free_bytes / (double)stats->total_bytes;
+
+    LOG_INFO("exec_mem: %llu free bytes out of %llu total (%f%%)\n",
+             (unsigned long long)stats->free_bytes,
+             (unsigned long long)stats->total_bytes,
+             percent);
+    LOG_INFO("exec_mem: There are %u active allocations\n",
+             stats->n_allocations);
+    LOG_INFO("exec_mem: %u out of %u segments are empty\n",
+             stats->n_free_segs, stats->n_segs);
+}
+
+#ifdef INVARIANTS
+static void check_integrity_locked(void) {
+    static bool on_free_list[EXEC_MEM_N_SEGS];
+    memset(on_free_list, 0, sizeof(on_free_list));
+
+    int seg_no;
+    for (seg_no = free_segs; seg_no >= 0; seg_no = segs[seg_no].next_free) {
+        if (seg_no >= EXEC_MEM_N_SEGS || on_free_list[seg_no] ||
+            seg_is_current(seg_no)) {
+            LOG_ERROR("exec_mem: corrupted segment free list\n");
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+        on_free_list[seg_no] = true;
+    }
+
+    size_t n_live = 0;
+    for (seg_no = 0; seg_no < EXEC_MEM_N_SEGS; seg_no++) {
+        struct exec_mem_seg const *seg = segs + seg_no;
+
+        if (seg->bump > EXEC_MEM_SEG_SIZE) {
+            LOG_ERROR("exec_mem: segment %d overflowed\n", seg_no);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        if (on_free_list[seg_no] && (seg->n_live || seg->bump)) {
+            LOG_ERROR("exec_mem: segment %d is on the free list but it is "
+                      "still in use\n", seg_no);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        if (!on_free_list[seg_no] && !seg_is_current(seg_no) &&
+            !seg->n_live) {
+            LOG_ERROR("exec_mem: segment %d leaked\n", seg_no);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        n_live += seg->n_live;
+    }
+
+    if (n_live != n_allocations) {
+        LOG_ERROR("exec_mem: %llu allocations but segments count %llu\n",
+                  (unsigned long long)n_allocations,
+                  (unsigned long long)n_live);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+#endif
+
+void *exec_mem_alloc(size_t len_req) {
+    washdc_mutex_lock(&exec_mem_lock);
+    void *ret = alloc_locked(len_req);
+    washdc_mutex_unlock(&exec_mem_lock);
+    return ret;
+}
+
+void exec_mem_free(void *ptr) {
+    // match behavior of the libc free function by ignoring NULL
+    if (!ptr)
+        return;
+
+    washdc_mutex_lock(&exec_mem_lock);
+    free_locked(ptr);
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+
+int exec_mem_grow(void *ptr, size_t len_req) {
+    washdc_mutex_lock(&exec_mem_lock);
+    int ret = grow_locked(ptr, len_req);
+    washdc_mutex_unlock(&exec_mem_lock);
+    return ret;
+}
+
+bool exec_mem_low(void) {
+    washdc_mutex_lock(&exec_mem_lock);
+    bool low = free_seg_count < EXEC_MEM_N_SEGS / 8;
+    washdc_mutex_unlock(&exec_mem_lock);
+    return low;
+}
+
+void exec_mem_get_stats(struct exec_mem_stats *stats) {
+    washdc_mutex_lock(&exec_mem_lock);
+    get_stats_locked(stats);
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+
+#ifdef INVARIANTS
+void exec_mem_check_integrity(void) {
+    washdc_mutex_lock(&exec_mem_lock);
+    check_integrity_locked();
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+#endif
@@ -0,0 +1,118 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef EXEC_MEM_H_
+#define EXEC_MEM_H_
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * This is the same segmented arena as the x86_64 backend's exec_mem, with a few
+ * differences for AArch64 hosts:
+ *
+ * - The arena is 128MB, which is as far as a b instruction can reach.  That
+ *   way every branch between two allocations fits in a single instruction,
+ *   and native_link can patch them with a single aligned store.
+ * - On Apple hosts the arena is mapped with MAP_JIT.  These mappings are either
+ *   writable or executable for any given thread, never both, so everything that
+ *   writes to the arena has to happen between exec_mem_write_begin and
+ *   exec_mem_write_end.
+ * - Instruction caches aren't coherent with data caches, so newly-written code
+ *   has to go through exec_mem_flush before it runs.
+ */
+
+void exec_mem_init(void);
+void exec_mem_cleanup(void);
+
+// see the x86_64 exec_mem.h for what lanes are for
+#define EXEC_MEM_LANE_MAIN 0
+#define EXEC_MEM_LANE_BG 1
+#define EXEC_MEM_N_LANES 2
+
+void exec_mem_set_lane(unsigned lane);
+
+// exec_mem_alloc returns a pointer into the executable view of the arena.
+void *exec_mem_alloc(size_t len_req);
+
+void exec_mem_free(void *ptr);
+
+/*
+ * When the arena is dual-mapped (because the host won't allow memory which is
+ * both writable and executable), code is executed from one view and written
+ * through a second view at a fixed offset from the first.  Otherwise the
+ * offset is zero.
+ */
+extern ptrdiff_t exec_mem_rw_offs;
+
+// return the writable alias of a pointer into the executable view
+static inline void *exec_mem_rw(void const *ptr) {
+    return ((uint8_t*)ptr) + exec_mem_rw_offs;
+}
+
+/*
+ * make the arena writable for the current thread.  Calls can be nested; the
+ * arena goes back to being executable at the outermost exec_mem_write_end.
+ * These do nothing unless the arena is mapped with MAP_JIT.
+ */
+void exec_mem_write_begin(void);
+void exec_mem_write_end(void);
+
+/*
+ * make code which was just written to [ptr, ptr + len) visible to instruction
+ * fetch.  ptr is a pointer into the executable view.
+ */
+void exec_mem_flush(void const *ptr, size_t len);
+
+/*
+ * attempt to grow the given allocation to the given size.  This funciton
+ * returns zero on success and nonzero on failure.  Like the x86_64 version,
+ * only the latest allocation in a segment can be grown, and allocations never
+ * move.
+ */
+int exec_mem_grow(void *ptr, size_t len_req);
+
+struct exec_mem_stats {
+    size_t free_bytes;
+    size_t total_bytes;
+    unsigned n_allocations;
+    unsigned n_free_segs, n_segs;
+};
+
+void exec_mem_get_stats(struct exec_mem_stats *stats);
+bool exec_mem_low(void);
+void exec_mem_print_stats(struct exec_mem_stats const *stats);
+
+#ifdef INVARIANTS
+/*
+ * This checks to make sure the segment free list is sane, no segment has
+ * overflowed and every empty segment is either current or on the free list.
+ */
+void exec_mem_check_integrity(void);
+#endif
+
+#endif
@@ -0,0 +1,641 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "dc_sched.h"
+#include "exec_mem.h"
+#include "jit/code_cache.h"
+#include "jit/jit_bg_compile.h"
+#include "jit/code_block.h"
+
+#include "emit_aarch64.h"
+#include "code_block_aarch64.h"
+#include "native_dispatch.h"
+
+#define BASIC_ALLOC 64
+
+static unsigned const countdown_reg = NATIVE_DISPATCH_COUNTDOWN_REG;
+static unsigned const cache_tbl_reg = NATIVE_DISPATCH_CACHE_TBL_REG;
+static unsigned const new_pc_reg = NATIVE_DISPATCH_PC_REG;
+static unsigned const hash_reg = NATIVE_DISPATCH_HASH_REG;
+static unsigned const cycle_stamp_reg = NATIVE_DISPATCH_CYCLE_COUNT_REG;
+
+// holds the struct cache_entry on the way into profile_code
+static unsigned const cachep_reg = A64_X22;
+
+static void native_dispatch_emit(struct native_dispatch_meta const *meta);
+static void create_return_fn(struct native_dispatch_meta *meta);
+static void native_dispatch_entry_create(struct native_dispatch_meta *meta);
+
+#ifdef JIT_PROFILE
+static void create_profile_code(struct native_dispatch_meta *meta);
+#endif
+
+static void
+native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta);
+
+static void
+native_dispatch_trampoline_create(struct native_dispatch_meta *meta);
+
+static void
+native_dispatch_create_link_slow_path(struct native_dispatch_meta *meta);
+
+static void link_site_patch(void *site, void const *dst);
+static void link_set(struct native_link *link, struct code_block_aarch64 *blk);
+static void link_clear(struct native_link *link);
+
+// list of every native_link which is currently linked
+static struct native_link *linked_head;
+
+/*
+ * hash of the PC that tier0_exec most recently returned, and the number of
+ * cycles the block took to get there.
+ */
+static uint32_t tier0_hash, tier0_cycles;
+
+/*
+ * the link that native_link_slow_path is currently resolving.  If the block
+ * which owns this link gets freed while the slow path is running then this
+ * gets set to NULL so that the slow path knows not to patch it.
+ */
+static struct native_link *pending_link;
+
+// the clock's countdown, which native code keeps in countdown_reg
+static dc_cycle_stamp_t *countdown_ptr;
+
+/*
+ * the code cache's hash table is indexed by the low bits of the hash, which
+ * have to be extracted with a single and_lowbits.
+ */
+static unsigned tbl_bits;
+
+static unsigned const native_offs =
+    offsetof(struct cache_entry, blk.aarch64.native);
+
+// start emitting one of the native_dispatch's fixed pieces of code
+static void *emit_begin(unsigned *n_bytes) {
+    void *ptr = exec_mem_alloc(BASIC_ALLOC);
+    if (!ptr)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    exec_mem_write_begin();
+    a64asm_set_dst(ptr, n_bytes, BASIC_ALLOC);
+    return ptr;
+}
+
+static void emit_end(void *ptr, unsigned n_bytes) {
+    exec_mem_write_end();
+    exec_mem_flush(ptr, n_bytes);
+}
+
+void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr) {
+    meta->ctx_ptr = ctx_ptr;
+
+    unsigned tbl_len = meta->cache->tbl_mask + 1;
+    if (!tbl_len || (tbl_len & (tbl_len - 1)))
+        RAISE_ERROR(ERROR_INTEGRITY);
+    for (tbl_bits = 0; (1u << tbl_bits) < tbl_len; tbl_bits++)
+        ;
+    if (!tbl_bits || tbl_bits > 31)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    /*
+     * unlike the x86_64 backend, nothing addresses the clock relative to the
+     * PC, so it doesn't need to live in the arena.
+     */
+    meta->clock_vals = (dc_cycle_stamp_t*)
+        calloc(WASHDC_CLOCK_IDX_COUNT, sizeof(meta->clock_vals[0]));
+    if (!meta->clock_vals)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    clock_set_ptrs_priv(meta->clk, meta->clock_vals);
+    countdown_ptr = meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN;
+
+    native_dispatch_create_slow_path_entry(meta);
+    native_dispatch_create_link_slow_path(meta);
+    create_return_fn(meta);
+#ifdef JIT_PROFILE
+    create_profile_code(meta);
+#endif
+    native_dispatch_entry_create(meta);
+
+    native_dispatch_trampoline_create(meta);
+}
+
+void native_dispatch_cleanup(struct native_dispatch_meta *meta) {
+    exec_mem_free(meta->entry);
+    exec_mem_free(meta->return_fn);
+    meta->return_fn = NULL;
+    exec_mem_free(meta->link_slow_path);
+    meta->link_slow_path = NULL;
+    exec_mem_free(meta->dispatch_slow_path);
+    meta->dispatch_slow_path = NULL;
+#ifdef JIT_PROFILE
+    exec_mem_free(meta->profile_code);
+#endif
+
+    clock_set_ptrs_priv(meta->clk, NULL);
+
+    free(meta->clock_vals);
+    meta->clock_vals = NULL;
+
+    exec_mem_free(meta->trampoline);
+    code_cache_set_default(meta->cache, NULL);
+}
+
+static void create_return_fn(struct native_dispatch_meta *meta) {
+    unsigned n_bytes;
+    void *ptr = emit_begin(&n_bytes);
+    meta->return_fn = ptr;
+
+    // the PC is already in w0, which is where the caller expects it
+
+    // store sched_tgt into cycle_stamp and clear the countdown
+    a64asm_mov_imm64(A64_X16, (uintptr_t)meta->clock_vals);
+    a64asm_ldr_x(A64_X9, A64_X16,
+                 WASHDC_CLOCK_IDX_TARGET * sizeof(dc_cycle_stamp_t));
+    a64asm_str_x(A64_X9, A64_X16,
+                 WASHDC_CLOCK_IDX_STAMP * sizeof(dc_cycle_stamp_t));
+    a64asm_str_x(A64_ZR, A64_X16,
+                 WASHDC_CLOCK_IDX_COUNTDOWN * sizeof(dc_cycle_stamp_t));
+
+    a64asm_ldp_x(A64_X21, A64_X22, A64_SP, 32);
+    a64asm_ldp_x(A64_X19, A64_X20, A64_SP, 16);
+    a64asm_ldp_x_post(A64_FP, A64_LR, A64_SP, 48);
+    a64asm_ret();
+
+    emit_end(ptr, n_bytes);
+}
+
+#ifdef JIT_PROFILE
+static void create_profile_code(struct native_dispatch_meta *meta) {
+    unsigned n_bytes;
+    void *ptr = emit_begin(&n_bytes);
+    meta->profile_code = ptr;
+
+    size_t const jit_profile_offs = offsetof(struct cache_entry, blk.profile);
+
+    // the trampoline block needs its PC, so keep the arguments around
+    a64asm_stp_x_pre(A64_X0, A64_X1, A64_SP, -16);
+
+    // the trampoline block has a null pointer here
+    a64asm_ldr_x(A64_X1, cachep_reg, jit_profile_offs);
+    a64asm_cmp_imm_x(A64_X1, 0);
+    void *skipit = a64asm_b_cond_fwd(A64_COND_EQ);
+
+    a64asm_mov_imm64(A64_X0, (uintptr_t)meta->ctx_ptr);
+    a64asm_mov_imm64(A64_X16, (uintptr_t)(void*)meta->profile_notify);
+    a64asm_blr(A64_X16);
+
+    a64asm_fixup_here(skipit);
+    a64asm_ldp_x_post(A64_X0, A64_X1, A64_SP, 16);
+    a64asm_ldr_x(A64_X16, cachep_reg, native_offs);
+    a64asm_br(A64_X16);
+
+    emit_end(ptr, n_bytes);
+}
+#endif
+
+static void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
+    unsigned n_bytes;
+    void *ptr = emit_begin(&n_bytes);
+
+    /*
+     * 48 bytes keeps the stack aligned to 16 bytes, and nothing between here
+     * and return_fn moves it, so code blocks can call C code without fixing
+     * the alignment.
+     */
+    a64asm_stp_x_pre(A64_FP, A64_LR, A64_SP, -48);
+    a64asm_add_imm_x(A64_FP, A64_SP, 0);
+    a64asm_stp_x(A64_X19, A64_X20, A64_SP, 16);
+    a64asm_stp_x(A64_X21, A64_X22, A64_SP, 32);
+
+    a64asm_mov_imm64(cache_tbl_reg, (uintptr_t)(void*)meta->cache->tbl);
+    a64asm_mov_imm64(NATIVE_DISPATCH_SLOT_BASE_REG,
+                     (uintptr_t)code_block_aarch64_slot_base());
+    a64asm_mov_imm64(A64_X16, (uintptr_t)countdown_ptr);
+    a64asm_ldr_x(countdown_reg, A64_X16, 0);
+
+    native_dispatch_emit(meta);
+
+    emit_end(ptr, n_bytes);
+
+    meta->entry = (native_dispatch_entry_func)ptr;
+}
+
+/*
+ * this is what blocks which haven't been promoted to the AArch64 backend yet
+ * call to run their code_block_intp.
+ */
+static uint32_t
+tier0_exec(void *arg, struct native_dispatch_meta const *meta) {
+    struct cache_entry *entry = (struct cache_entry*)arg;
+
+    if (++entry->n_execs >= meta->tier_threshold) {
+        // see jit/x86_64/native_dispatch.c for why this is safe
+        if (meta->on_submit) {
+            if (!entry->bg_job)
+                entry->bg_job = meta->on_submit(meta->ctx_ptr, meta, entry->pc);
+            else if (jit_bg_compile_done(entry->bg_job))
+                code_cache_evict_entry(meta->cache, entry);
+        } else {
+            entry->hot = 1;
+            code_cache_invalidate_entry(meta->cache, entry);
+        }
+    }
+
+    unsigned n_cycles;
+    uint32_t pc = code_block_intp_exec(meta->ctx_ptr, &entry->blk.intp,
+                                       &n_cycles);
+    tier0_hash = meta->hash_func(meta->ctx_ptr, pc);
+    tier0_cycles = n_cycles;
+    return pc;
+}
+
+static void compile_entry(struct native_dispatch_meta const *meta,
+                          struct cache_entry *entry, addr32_t pc) {
+    entry->pc = pc;
+    if (meta->on_compile_intp && !entry->hot) {
+        meta->on_compile_intp(meta->ctx_ptr, &entry->blk, pc);
+        jit_bg_compile_lock();
+        code_block_aarch64_compile_call(entry, &entry->blk.aarch64, tier0_exec,
+                                        &tier0_hash, &tier0_cycles, meta);
+        jit_bg_compile_unlock();
+    } else {
+        jit_bg_compile_lock();
+        meta->on_compile(meta->ctx_ptr, meta, &entry->blk, pc);
+        jit_bg_compile_unlock();
+    }
+    code_cache_set_valid(meta->cache, entry);
+}
+
+/*
+ * swap the native code from entry's finished background compile in for its
+ * tier0 stub.  Nothing can be running the stub because it always exits
+ * through the dispatcher, and we only get here while looking the entry up.
+ */
+static void install_bg_job(struct cache_entry *entry) {
+    struct jit_bg_job *job = entry->bg_job;
+    entry->bg_job = NULL;
+
+    code_block_aarch64_cleanup(&entry->blk.aarch64);
+    jit_bg_compile_finish(job, &entry->blk);
+    native_link_move(&entry->blk.aarch64);
+    entry->hot = 1;
+
+    /*
+     * the worker flushed the new code from the caches, but this core still
+     * needs a context synchronization before it can safely run it.
+     */
+    __asm__ volatile("isb" ::: "memory");
+}
+
+static struct cache_entry *
+dispatch_slow_path(uint32_t pc, struct native_dispatch_meta const *meta) {
+    void *ctx_ptr = meta->ctx_ptr;
+    struct code_cache *cache = meta->cache;
+    struct cache_entry *entry =
+        code_cache_find_slow(cache, meta->hash_func(ctx_ptr, pc));
+
+    cache->tbl[pc & cache->tbl_mask] = entry;
+
+    if (!entry->valid)
+        compile_entry(meta, entry, pc);
+    else if (entry->bg_job && jit_bg_compile_done(entry->bg_job))
+        install_bg_job(entry);
+
+    return entry;
+}
+
+// jump to the block whose cache_entry is in reg
+static void emit_enter_block(struct native_dispatch_meta const *meta,
+                             unsigned reg) {
+#ifdef JIT_PROFILE
+    a64asm_mov_x(cachep_reg, reg);
+    a64asm_b(meta->profile_code);
+#else
+    a64asm_ldr_x(A64_X16, reg, native_offs);
+    a64asm_br(A64_X16);
+#endif
+}
+
+static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
+    /*
+     * w0 holds the PC and w1 holds its hash.  The x9-x11 scratch registers
+     * can be clobbered freely because every block starts from scratch.
+     */
+    size_t const key_offs = offsetof(struct cache_entry, key);
+
+    a64asm_and_lowbits_w(A64_X9, hash_reg, tbl_bits);
+    a64asm_ldr_x_lsl3(A64_X10, cache_tbl_reg, A64_X9);
+    a64asm_ldr_w(A64_X11, A64_X10, key_offs);
+    a64asm_cmp_w(A64_X11, hash_reg);
+    void *slow_path = a64asm_b_cond_fwd(A64_COND_NE);
+
+    emit_enter_block(meta, A64_X10);
+
+    a64asm_fixup_here(slow_path);
+    a64asm_b(meta->dispatch_slow_path);
+}
+
+void native_dispatch_call_emit(void *fn) {
+    a64asm_mov_imm64(A64_X16, (uintptr_t)countdown_ptr);
+    a64asm_str_x(countdown_reg, A64_X16, 0);
+    a64asm_mov_imm64(A64_X16, (uintptr_t)fn);
+    a64asm_blr(A64_X16);
+    a64asm_mov_imm64(A64_X16, (uintptr_t)countdown_ptr);
+    a64asm_ldr_x(countdown_reg, A64_X16, 0);
+}
+
+void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
+    static_assert(sizeof(dc_cycle_stamp_t) == 8,
+                  "dc_cycle_stamp_t is not a quadword!");
+
+    /*
+     * signed comparison because the countdown can already be negative if the
+     * previous block's exit skipped its check (see native_link).
+     */
+    a64asm_subs_x(countdown_reg, countdown_reg, cycle_stamp_reg);
+    void *keep_going = a64asm_b_cond_fwd(A64_COND_GT);
+    a64asm_b(meta->return_fn);
+    a64asm_fixup_here(keep_going);
+
+    native_dispatch_emit(meta);
+}
+
+void
+native_check_cycles_link_emit(struct native_dispatch_meta const *meta,
+                              struct code_block_aarch64 *blk,
+                              unsigned n_targets, uint32_t const *addrs,
+                              jit_hash const *hashes) {
+#ifdef JIT_PROFILE
+    // the profiler gets notified from native_dispatch
+    native_check_cycles_emit(meta);
+#else
+    if (blk->links || !n_targets)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    blk->links =
+        (struct native_link*)calloc(n_targets, sizeof(struct native_link));
+    if (!blk->links)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    blk->n_links = n_targets;
+
+    // the gates check the countdown, so don't branch on it here
+    a64asm_sub_x(countdown_reg, countdown_reg, cycle_stamp_reg);
+
+    unsigned idx;
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link->addr = addrs[idx];
+        link->hash = hashes[idx];
+        link->owner = blk;
+
+        if (idx + 1 < n_targets) {
+            a64asm_mov_imm32(A64_X9, addrs[idx]);
+            a64asm_cmp_w(new_pc_reg, A64_X9);
+            void *next_target = a64asm_b_cond_fwd(A64_COND_NE);
+            link->site = a64asm_b_fwd();
+            a64asm_fixup_here(next_target);
+        } else {
+            link->site = a64asm_b_fwd();
+        }
+    }
+
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link->gate = a64asm_get_out_ptr();
+        a64asm_cmp_imm_x(countdown_reg, 0);
+        void *keep_going = a64asm_b_cond_fwd(A64_COND_GT);
+        a64asm_b(meta->return_fn);
+        a64asm_fixup_here(keep_going);
+        link->gate_site = a64asm_b_fwd();
+    }
+
+    // now the stubs, which is where the links go when they're not linked
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link->stub = a64asm_get_out_ptr();
+        a64asm_mov_imm64(A64_X0, (uintptr_t)link);
+        a64asm_b(meta->link_slow_path);
+    }
+
+    /*
+     * the caller flushes the whole block once it's done, so these don't need
+     * to go through link_site_patch.
+     */
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        a64asm_fixup(link->site, link->gate);
+        a64asm_fixup(link->gate_site, link->stub);
+    }
+#endif
+}
+
+static void *
+native_link_slow_path(struct native_link *link,
+                      struct native_dispatch_meta const *meta) {
+    uint32_t addr = link->addr;
+    jit_hash hash = link->hash;
+
+    /*
+     * code_cache_find_slow can clean up the block that link belongs to if that
+     * block was invalidated while it was running.
+     */
+    pending_link = link;
+
+    struct code_cache *cache = meta->cache;
+    struct cache_entry *entry = code_cache_find_slow(cache, hash);
+    cache->tbl[hash & cache->tbl_mask] = entry;
+
+    if (!entry->valid)
+        compile_entry(meta, entry, addr);
+    else if (entry->bg_job && jit_bg_compile_done(entry->bg_job))
+        install_bg_job(entry);
+
+    if (pending_link)
+        link_set(pending_link, &entry->blk.aarch64);
+    pending_link = NULL;
+
+    return entry->blk.aarch64.native;
+}
+
+static void
+native_dispatch_create_link_slow_path(struct native_dispatch_meta *meta) {
+    unsigned n_bytes;
+    void *ptr = emit_begin(&n_bytes);
+    meta->link_slow_path = ptr;
+
+    // the native_link is in x0
+    a64asm_mov_imm64(A64_X1, (uintptr_t)(void*)meta);
+    a64asm_mov_imm64(A64_X16, (uintptr_t)(void*)native_link_slow_path);
+    a64asm_blr(A64_X16);
+    a64asm_br(A64_X0);
+
+    emit_end(ptr, n_bytes);
+}
+
+static void link_site_patch(void *site, void const *dst) {
+    exec_mem_write_begin();
+    a64asm_fixup(site, dst);
+    exec_mem_write_end();
+    exec_mem_flush(site, sizeof(uint32_t));
+}
+
+static void link_set(struct native_link *link, struct code_block_aarch64 *blk) {
+    if (link->target)
+        link_clear(link);
+
+    struct code_block_aarch64 *owner = link->owner;
+    if (blk != owner && !blk->n_unchecked_out && !owner->n_unchecked_in) {
+        link_site_patch(link->site, blk->native);
+        link->unchecked = true;
+        owner->n_unchecked_out++;
+        blk->n_unchecked_in++;
+    } else {
+        link_site_patch(link->gate_site, blk->native);
+        link->unchecked = false;
+    }
+    link->target = blk;
+
+    link->prev_in = NULL;
+    link->next_in = blk->links_in;
+    if (blk->links_in)
+        blk->links_in->prev_in = link;
+    blk->links_in = link;
+
+    link->prev_linked = NULL;
+    link->next_linked = linked_head;
+    if (linked_head)
+        linked_head->prev_linked = link;
+    linked_head = link;
+}
+
+static void link_clear(struct native_link *link) {
+    struct code_block_aarch64 *blk = link->target;
+    if (!blk)
+        return;
+
+    if (link->unchecked) {
+        link_site_patch(link->site, link->gate);
+        link->owner->n_unchecked_out--;
+        blk->n_unchecked_in--;
+        link->unchecked = false;
+    } else {
+        link_site_patch(link->gate_site, link->stub);
+    }
+
+    if (link->prev_in)
+        link->prev_in->next_in = link->next_in;
+    else
+        blk->links_in = link->next_in;
+    if (link->next_in)
+        link->next_in->prev_in = link->prev_in;
+
+    if (link->prev_linked)
+        link->prev_linked->next_linked = link->next_linked;
+    else
+        linked_head = link->next_linked;
+    if (link->next_linked)
+        link->next_linked->prev_linked = link->prev_linked;
+
+    link->target = NULL;
+    link->next_in = link->prev_in = NULL;
+    link->next_linked = link->prev_linked = NULL;
+}
+
+void native_link_unlink_in(struct code_block_aarch64 *blk) {
+    while (blk->links_in)
+        link_clear(blk->links_in);
+}
+
+void native_link_unlink_all(void) {
+    while (linked_head)
+        link_clear(linked_head);
+}
+
+void native_link_move(struct code_block_aarch64 *blk) {
+    unsigned idx;
+    for (idx = 0; idx < blk->n_links; idx++)
+        blk->links[idx].owner = blk;
+}
+
+void native_link_cleanup(struct code_block_aarch64 *blk) {
+    native_link_unlink_in(blk);
+
+    unsigned idx;
+    for (idx = 0; idx < blk->n_links; idx++) {
+        struct native_link *link = blk->links + idx;
+        link_clear(link);
+        if (link == pending_link)
+            pending_link = NULL;
+    }
+
+    free(blk->links);
+    blk->links = NULL;
+    blk->n_links = 0;
+}
+
+static void
+native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta) {
+    unsigned n_bytes;
+    void *ptr = emit_begin(&n_bytes);
+    meta->dispatch_slow_path = ptr;
+
+    // pc is still in w0
+    a64asm_mov_imm64(A64_X1, (uintptr_t)(void*)meta);
+    a64asm_mov_imm64(A64_X16, (uintptr_t)(void*)dispatch_slow_path);
+    a64asm_blr(A64_X16);
+
+    emit_enter_block(meta, A64_X0);
+
+    emit_end(ptr, n_bytes);
+}
+
+static void
+native_dispatch_trampoline_create(struct native_dispatch_meta *meta) {
+    unsigned n_bytes;
+    void *ptr = emit_begin(&n_bytes);
+    meta->trampoline = ptr;
+
+    // PC should already be in w0
+    a64asm_b(meta->dispatch_slow_path);
+
+    emit_end(ptr, n_bytes);
+
+    // see jit/x86_64/native_dispatch.c for why the key is 0xa0000000
+    memset(&meta->fake_cache_entry, 0, sizeof(meta->fake_cache_entry));
+    meta->fake_cache_entry.valid = 1;
+    meta->fake_cache_entry.blk.aarch64.native = meta->trampoline;
+    meta->fake_cache_entry.key = 0xa0000000;
+
+    code_cache_set_default(meta->cache, &meta->fake_cache_entry);
+}
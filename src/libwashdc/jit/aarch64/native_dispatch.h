@@ -0,0 +1,187 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef NATIVE_DISPATCH_H_
+#define NATIVE_DISPATCH_H_
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "washdc/types.h"
+#include "dc_sched.h"
+#include "jit/defs.h"
+
+#ifdef JIT_PROFILE
+#include "jit/jit_profile.h"
+#endif
+
+#include "jit/code_cache.h"
+#include "emit_aarch64.h"
+
+struct native_dispatch_meta;
+
+void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr);
+void native_dispatch_cleanup(struct native_dispatch_meta *meta);
+
+#define NATIVE_DISPATCH_PC_REG A64_X0
+#define NATIVE_DISPATCH_HASH_REG A64_X1
+#define NATIVE_DISPATCH_CYCLE_COUNT_REG A64_X2
+
+/*
+ * Like the x86_64 backend, the clock's countdown lives in a callee-saved
+ * register for as long as native code is running.  Native code which calls
+ * into C code has to go through native_dispatch_call_emit.
+ */
+#define NATIVE_DISPATCH_COUNTDOWN_REG A64_X19
+
+// points to the code cache's hash table
+#define NATIVE_DISPATCH_CACHE_TBL_REG A64_X20
+
+// points to the slots of the block that's currently running
+#define NATIVE_DISPATCH_SLOT_BASE_REG A64_X21
+
+// the first uint32_t parameter is supposed to be the PC, second is the hash
+typedef uint32_t(*native_dispatch_entry_func)(uint32_t, uint32_t);
+
+struct jit_code_block;
+typedef
+void(*native_dispatch_compile_func)(void*,struct native_dispatch_meta const*,
+                                    struct jit_code_block*,addr32_t);
+
+typedef jit_hash(*native_dispatch_hash_func)(void*,uint32_t);
+
+// compiles a block for code_block_intp instead of the AArch64 backend
+typedef void(*native_dispatch_compile_intp_func)(void*,void*,addr32_t);
+
+// generates il for a block and submits it to jit_bg_compile
+struct jit_bg_job;
+typedef
+struct jit_bg_job*(*native_dispatch_submit_func)(void*,
+                                                 struct native_dispatch_meta const*,
+                                                 addr32_t);
+
+#ifdef JIT_PROFILE
+typedef
+void(*native_dispatch_profile_notify_func)(void*,
+                                           struct jit_profile_per_block *blk);
+#endif
+
+// see jit/x86_64/native_dispatch.h; the fields mean the same thing here
+struct native_dispatch_meta {
+    dc_cycle_stamp_t *clock_vals;
+
+    struct dc_clock *clk;
+    void *return_fn;
+    void *dispatch_slow_path;
+    void *link_slow_path;
+#ifdef JIT_PROFILE
+    void *profile_code;
+#endif
+
+    void *ctx_ptr;
+
+#ifdef JIT_PROFILE
+    native_dispatch_profile_notify_func profile_notify; // user-specified
+#endif
+    native_dispatch_compile_func on_compile; // user-specified
+
+    native_dispatch_compile_intp_func on_compile_intp; // user-specified
+    unsigned tier_threshold; // user-specified
+    native_dispatch_submit_func on_submit; // user-specified
+
+    struct code_cache *cache; // user-specified
+
+    native_dispatch_entry_func entry;
+
+    void *trampoline;
+
+    // cache_entry that points to trampoline
+    struct cache_entry fake_cache_entry;
+
+    native_dispatch_hash_func hash_func;
+};
+
+/*
+ * subtract the cycle count in NATIVE_DISPATCH_CYCLE_COUNT_REG from the
+ * countdown and either return to entry's caller or dispatch to the block at the
+ * PC in NATIVE_DISPATCH_PC_REG (whose hash is in NATIVE_DISPATCH_HASH_REG).
+ */
+void
+native_check_cycles_emit(struct native_dispatch_meta const *meta);
+
+/*
+ * emit a call to fn, saving NATIVE_DISPATCH_COUNTDOWN_REG to the clock before
+ * and reloading it after.  This clobbers X16 along with everything else the
+ * AAPCS64 lets a callee clobber.
+ */
+void native_dispatch_call_emit(void *fn);
+
+/*
+ * see jit/x86_64/native_dispatch.h for how links work.  Here every site is a
+ * 4-byte b instruction, and since the whole arena is within reach of b they can
+ * always be patched with a single aligned store.
+ */
+struct native_link {
+    void *site;
+
+    void *gate;
+    void *gate_site;
+
+    void *stub;
+
+    struct code_block_aarch64 *owner;
+
+    bool unchecked;
+
+    uint32_t addr;
+    jit_hash hash;
+
+    struct code_block_aarch64 *target;
+
+    struct native_link *next_in, *prev_in;
+
+    struct native_link *next_linked, *prev_linked;
+};
+
+void
+native_check_cycles_link_emit(struct native_dispatch_meta const *meta,
+                              struct code_block_aarch64 *blk,
+                              unsigned n_targets, uint32_t const *addrs,
+                              jit_hash const *hashes);
+
+// unlink every link that jumps into blk
+void native_link_unlink_in(struct code_block_aarch64 *blk);
+
+// unlink every link that's currently linked, in every block
+void native_link_unlink_all(void);
+
+// unlink everything going into or out of blk before it gets freed
+void native_link_cleanup(struct code_block_aarch64 *blk);
+
+// point blk's links back at it after it gets copied in from somewhere else
+void native_link_move(struct code_block_aarch64 *blk);
+
+#endif
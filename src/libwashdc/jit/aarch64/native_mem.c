@@ -0,0 +1,413 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "washdc/error.h"
+#include "washdc/fifo.h"
+#include "washdc/MemoryMap.h"
+#include "jit/code_cache.h"
+#include "savestate.h"
+
+#include "emit_aarch64.h"
+#include "native_dispatch.h"
+#include "code_block_aarch64.h"
+#include "native_mem.h"
+
+/*
+ * Unlike the x86_64 backend, there are no per-map lookup trampolines here.
+ * Main RAM gets checked inline, and everything else calls straight into the
+ * memory_map's own lookup.
+ */
+struct native_mem_map {
+    struct memory_map const *map;
+    struct fifo_node node;
+
+    /*
+     * main RAM, for the inline fast-path; see jit/x86_64/native_mem.c.  ram
+     * is NULL if the fast-path can't be used for this map.
+     */
+    struct memory_map_region const *ram;
+    uint32_t ram_first, ram_last;
+
+    // if non-zero, everything from here up belongs to some other region
+    uint32_t ram_top;
+};
+
+static struct fifo_head native_impl;
+static struct native_mem_map *mem_map_impl(struct memory_map const *map);
+static void find_ram(struct native_mem_map *native_map);
+
+void native_mem_init(void) {
+    fifo_init(&native_impl);
+}
+
+void native_mem_cleanup(void) {
+    while (fifo_len(&native_impl)) {
+        struct fifo_node *node = fifo_pop(&native_impl);
+        free(&FIFO_DEREF(node, struct native_mem_map, node));
+    }
+}
+
+/*
+ * branch to the slow-path unless the entire access at the address in w0 is in
+ * main RAM.  If it is, then this leaves the offset into RAM in w9 and the
+ * address of RAM in x10.
+ */
+static bool fast_path_begin(struct native_mem_fast_path *fast,
+                            struct native_mem_map const *native_map,
+                            unsigned n_bytes) {
+    fast->active = native_map->ram != NULL;
+    fast->n_miss = 0;
+    if (!fast->active)
+        return false;
+
+    if (native_map->ram_top) {
+        a64asm_mov_imm32(A64_X9, native_map->ram_top - (n_bytes - 1));
+        a64asm_cmp_w(A64_X0, A64_X9);
+        fast->miss[fast->n_miss++] = a64asm_b_cond_fwd(A64_COND_HS);
+    }
+
+    a64asm_mov_imm32(A64_X9, native_map->ram->range_mask);
+    a64asm_and_w(A64_X9, A64_X0, A64_X9);
+    a64asm_mov_imm32(A64_X10, native_map->ram_first);
+    a64asm_cmp_w(A64_X9, A64_X10);
+    fast->miss[fast->n_miss++] = a64asm_b_cond_fwd(A64_COND_LO);
+    a64asm_mov_imm32(A64_X10, native_map->ram_last - (n_bytes - 1));
+    a64asm_cmp_w(A64_X9, A64_X10);
+    fast->miss[fast->n_miss++] = a64asm_b_cond_fwd(A64_COND_HI);
+
+    a64asm_mov_imm32(A64_X9, native_map->ram->mask);
+    a64asm_and_w(A64_X9, A64_X0, A64_X9);
+    if (n_bytes > sizeof(uint32_t)) {
+        // a span can run off the end of one mirror and into the next one
+        a64asm_mov_imm32(A64_X10, native_map->ram->mask - (n_bytes - 1));
+        a64asm_cmp_w(A64_X9, A64_X10);
+        fast->miss[fast->n_miss++] = a64asm_b_cond_fwd(A64_COND_HI);
+    }
+    a64asm_mov_imm64(A64_X10, (uintptr_t)native_map->ram->host);
+
+    return true;
+}
+
+static void fast_path_slow(struct native_mem_fast_path *fast) {
+    fast->done = a64asm_b_fwd();
+    unsigned idx;
+    for (idx = 0; idx < fast->n_miss; idx++)
+        a64asm_fixup_here(fast->miss[idx]);
+}
+
+static void fast_path_end(struct native_mem_fast_path *fast) {
+    if (fast->active)
+        a64asm_fixup_here(fast->done);
+}
+
+#if SAVESTATE_PAGE_SHIFT != CODE_CACHE_PAGE_SHIFT
+#error emit_ram_write_notify assumes save-states and the code cache use the \
+    same page size
+#endif
+
+/*
+ * mark the page dirty for save-states and drop any code that was compiled from
+ * it.  The RAM offset of the write should be in w9.  Single accesses are
+ * aligned, so only the page of the first byte gets checked for them; spans
+ * from native_mem_span_begin also check the page of the last byte.
+ */
+static void emit_ram_write_notify(unsigned n_bytes) {
+    bool span = n_bytes > sizeof(uint32_t);
+
+    a64asm_lsr_imm_w(A64_X11, A64_X9, CODE_CACHE_PAGE_SHIFT);
+    if (span) {
+        a64asm_add_imm_w(A64_X13, A64_X9, n_bytes - 1);
+        a64asm_lsr_imm_w(A64_X13, A64_X13, CODE_CACHE_PAGE_SHIFT);
+    }
+
+    a64asm_mov_imm64(A64_X10, (uintptr_t)savestate_ram_dirty);
+    a64asm_mov_imm32(A64_X12, 1);
+    a64asm_strb_w_uxtw(A64_X12, A64_X10, A64_X11);
+    if (span)
+        a64asm_strb_w_uxtw(A64_X12, A64_X10, A64_X13);
+
+    a64asm_mov_imm64(A64_X10, (uintptr_t)code_cache_ram_pages);
+    a64asm_ldrb_w_uxtw(A64_X12, A64_X10, A64_X11);
+    if (span) {
+        a64asm_ldrb_w_uxtw(A64_X13, A64_X10, A64_X13);
+        a64asm_orr_w(A64_X12, A64_X12, A64_X13);
+    }
+    void *no_code = a64asm_cbz_w_fwd(A64_X12);
+
+    // call code_cache_invalidate_ram(owner, addr, addr + (n_bytes - 1))
+    a64asm_mov_w(A64_X1, A64_X9);
+    a64asm_add_imm_w(A64_X2, A64_X9, n_bytes - 1);
+    a64asm_mov_imm64(A64_X0, (uintptr_t)code_cache_ram_owner);
+    a64asm_mov_imm64(A64_X16, (uintptr_t)(void*)code_cache_invalidate_ram);
+    a64asm_blr(A64_X16);
+
+    a64asm_fixup_here(no_code);
+}
+
+static struct native_mem_map *checked_impl(struct memory_map const *map) {
+    struct native_mem_map *native_map = mem_map_impl(map);
+    if (!native_map)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    return native_map;
+}
+
+bool native_mem_span_begin(struct native_mem_fast_path *fast,
+                           struct memory_map const *map, unsigned n_bytes) {
+    return fast_path_begin(fast, checked_impl(map), n_bytes);
+}
+
+void native_mem_span_slow(struct native_mem_fast_path *fast) {
+    fast_path_slow(fast);
+}
+
+void native_mem_span_end(struct native_mem_fast_path *fast) {
+    fast_path_end(fast);
+}
+
+void native_mem_span_notify(unsigned n_bytes) {
+    emit_ram_write_notify(n_bytes);
+}
+
+// slow-path for reads: call fn(map, addr)
+static void emit_read_call(struct memory_map const *map, void *fn) {
+    a64asm_mov_w(A64_X1, A64_X0);
+    a64asm_mov_imm64(A64_X0, (uintptr_t)map);
+    native_dispatch_call_emit(fn);
+}
+
+// slow-path for writes: call fn(map, addr, val)
+static void emit_write_call(struct memory_map const *map, void *fn) {
+    a64asm_mov_w(A64_X2, A64_X1);
+    a64asm_mov_w(A64_X1, A64_X0);
+    a64asm_mov_imm64(A64_X0, (uintptr_t)map);
+    native_dispatch_call_emit(fn);
+}
+
+void native_mem_read_float(struct code_block_aarch64 *blk,
+                           struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(float))) {
+        a64asm_ldr_s_uxtw(A64_S0, A64_X10, A64_X9);
+        fast_path_slow(&fast);
+    }
+
+    emit_read_call(map, (void*)memory_map_read_float);
+    fast_path_end(&fast);
+}
+
+void native_mem_read_32(struct code_block_aarch64 *blk,
+                        struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint32_t))) {
+        a64asm_ldr_w_uxtw(A64_X0, A64_X10, A64_X9);
+        fast_path_slow(&fast);
+    }
+
+    emit_read_call(map, (void*)memory_map_read_32);
+    fast_path_end(&fast);
+}
+
+void native_mem_read_16(struct code_block_aarch64 *blk,
+                        struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint16_t))) {
+        a64asm_ldrh_w_uxtw(A64_X0, A64_X10, A64_X9);
+        fast_path_slow(&fast);
+    }
+
+    // the upper bits of narrow return values are undefined
+    emit_read_call(map, (void*)memory_map_read_16);
+    a64asm_uxth_w(A64_X0, A64_X0);
+    fast_path_end(&fast);
+}
+
+void native_mem_read_8(struct code_block_aarch64 *blk,
+                       struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint8_t))) {
+        a64asm_ldrb_w_uxtw(A64_X0, A64_X10, A64_X9);
+        fast_path_slow(&fast);
+    }
+
+    emit_read_call(map, (void*)memory_map_read_8);
+    a64asm_uxtb_w(A64_X0, A64_X0);
+    fast_path_end(&fast);
+}
+
+void native_mem_write_8(struct code_block_aarch64 *blk,
+                        struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    // Apple's ABI expects the caller to extend narrow arguments
+    a64asm_uxtb_w(A64_X1, A64_X1);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint8_t))) {
+        a64asm_strb_w_uxtw(A64_X1, A64_X10, A64_X9);
+        emit_ram_write_notify(sizeof(uint8_t));
+        fast_path_slow(&fast);
+    }
+
+    emit_write_call(map, (void*)memory_map_write_8);
+    fast_path_end(&fast);
+}
+
+void native_mem_write_16(struct code_block_aarch64 *blk,
+                         struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    a64asm_uxth_w(A64_X1, A64_X1);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint16_t))) {
+        a64asm_strh_w_uxtw(A64_X1, A64_X10, A64_X9);
+        emit_ram_write_notify(sizeof(uint16_t));
+        fast_path_slow(&fast);
+    }
+
+    emit_write_call(map, (void*)memory_map_write_16);
+    fast_path_end(&fast);
+}
+
+void native_mem_write_32(struct code_block_aarch64 *blk,
+                         struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint32_t))) {
+        a64asm_str_w_uxtw(A64_X1, A64_X10, A64_X9);
+        emit_ram_write_notify(sizeof(uint32_t));
+        fast_path_slow(&fast);
+    }
+
+    emit_write_call(map, (void*)memory_map_write_32);
+    fast_path_end(&fast);
+}
+
+void native_mem_write_float(struct code_block_aarch64 *blk,
+                            struct memory_map const *map) {
+    struct native_mem_map *native_map = checked_impl(map);
+
+    struct native_mem_fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(float))) {
+        a64asm_str_s_uxtw(A64_S0, A64_X10, A64_X9);
+        emit_ram_write_notify(sizeof(float));
+        fast_path_slow(&fast);
+    }
+
+    // the value is already in s0, which is where it gets passed
+    a64asm_mov_w(A64_X1, A64_X0);
+    a64asm_mov_imm64(A64_X0, (uintptr_t)map);
+    native_dispatch_call_emit((void*)memory_map_write_float);
+    fast_path_end(&fast);
+}
+
+// this is the same as the x86_64 backend's find_ram
+static void find_ram(struct native_mem_map *native_map) {
+    struct memory_map const *map = native_map->map;
+    unsigned region_no;
+
+    native_map->ram = NULL;
+    native_map->ram_top = 0;
+
+    for (region_no = 0; region_no < map->n_regions; region_no++)
+        if (map->regions[region_no].id == MEMORY_MAP_REGION_RAM)
+            break;
+    if (region_no >= map->n_regions)
+        return;
+
+    struct memory_map_region const *ram = map->regions + region_no;
+    if (!ram->host)
+        return;
+    uint32_t ram_first = ram->first_addr, ram_last = ram->last_addr;
+
+    // merge any mirrors which come immediately after
+    unsigned next_no;
+    for (next_no = region_no + 1; next_no < map->n_regions; next_no++) {
+        struct memory_map_region const *next = map->regions + next_no;
+        if (next->id != MEMORY_MAP_REGION_RAM || next->host != ram->host ||
+            next->mask != ram->mask || next->range_mask != ram->range_mask ||
+            next->first_addr != ram_last + 1)
+            break;
+        ram_last = next->last_addr;
+    }
+
+    unsigned prev_no;
+    uint32_t top = 0;
+    for (prev_no = 0; prev_no < region_no; prev_no++) {
+        struct memory_map_region const *prev = map->regions + prev_no;
+        if (prev->range_mask == ram->range_mask &&
+            (prev->last_addr < ram_first || prev->first_addr > ram_last))
+            continue;
+        if (prev->range_mask == 0xffffffff && prev->last_addr == 0xffffffff) {
+            if (!top || prev->first_addr < top)
+                top = prev->first_addr;
+            continue;
+        }
+        return;
+    }
+
+    native_map->ram = ram;
+    native_map->ram_first = ram_first;
+    native_map->ram_last = ram_last;
+    native_map->ram_top = top;
+}
+
+static struct native_mem_map *mem_map_impl(struct memory_map const *map) {
+    struct fifo_node *curs;
+    struct native_mem_map *native_map;
+    FIFO_FOREACH(native_impl, curs) {
+        native_map = &FIFO_DEREF(curs, struct native_mem_map, node);
+        if (native_map->map == map)
+            return native_map;
+    }
+
+    return NULL;
+}
+
+void native_mem_register(struct memory_map const *map) {
+    struct native_mem_map *native_map =
+        (struct native_mem_map*)malloc(sizeof(struct native_mem_map));
+    if (!native_map)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    native_map->map = map;
+    find_ram(native_map);
+
+    fifo_push(&native_impl, &native_map->node);
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef NATIVE_MEM_H_
+#define NATIVE_MEM_H_
+
+#ifndef ENABLE_JIT_AARCH64
+#error this file should not be built when the AArch64 JIT backend is disabled
+#endif
+
+#include <stdbool.h>
+
+#include "washdc/MemoryMap.h"
+
+struct code_block_aarch64;
+
+void native_mem_init(void);
+void native_mem_cleanup(void);
+
+void native_mem_register(struct memory_map const *map);
+
+/*
+ * The address goes in w0.  Values to write go in w1 (or s0 for floats), and
+ * values that were read come back in w0 (or s0), zero-extended to 32 bits.
+ * Accesses to main RAM are done inline, everything else calls into the
+ * memory_map.  Everything the AAPCS64 lets a callee clobber gets clobbered.
+ */
+void native_mem_read_8(struct code_block_aarch64 *blk,
+                       struct memory_map const *map);
+void native_mem_read_16(struct code_block_aarch64 *blk,
+                        struct memory_map const *map);
+void native_mem_read_32(struct code_block_aarch64 *blk,
+                        struct memory_map const *map);
+void native_mem_read_float(struct code_block_aarch64 *blk,
+                           struct memory_map const *map);
+void native_mem_write_8(struct code_block_aarch64 *blk,
+                        struct memory_map const *map);
+void native_mem_write_16(struct code_block_aarch64 *blk,
+                         struct memory_map const *map);
+void native_mem_write_32(struct code_block_aarch64 *blk,
+                         struct memory_map const *map);
+void native_mem_write_float(struct code_block_aarch64 *blk,
+                            struct memory_map const *map);
+
+#define NATIVE_MEM_MAX_MISSES 4
+
+/*
+ * The fast-path is an inline check for main RAM that skips to the slow-path
+ * when the address is somewhere else.  The address in w0 stays intact until
+ * the access is done so that the slow-path can start over from the beginning.
+ */
+struct native_mem_fast_path {
+    void *miss[NATIVE_MEM_MAX_MISSES];
+    unsigned n_miss;
+    void *done;
+    bool active;
+};
+
+/*
+ * for JIT_OP_READ_32_BLOCK and JIT_OP_WRITE_32_BLOCK: branch to the slow-path
+ * unless all n_bytes starting at the address in w0 are in main RAM.  If they
+ * are, this leaves the offset into RAM in w9 and the address of RAM in x10.
+ * Returns false without emitting anything if map has no inline fast-path.
+ *
+ * After the fast-path, call native_mem_span_slow and then emit the slow-path,
+ * and then call native_mem_span_end.  Writes need native_mem_span_notify at
+ * the end of their fast-path, while w9 still holds the offset.
+ */
+bool native_mem_span_begin(struct native_mem_fast_path *fast,
+                           struct memory_map const *map, unsigned n_bytes);
+void native_mem_span_slow(struct native_mem_fast_path *fast);
+void native_mem_span_end(struct native_mem_fast_path *fast);
+void native_mem_span_notify(unsigned n_bytes);
+
+#endif
@@ -28,7 +28,6 @@
 #include "dreamcast.h"
 
 #define DEFAULT_BLOCK_LEN 32
-#define BLOCK_GROW_LEN 1
 
 void il_code_block_init(struct il_code_block *block) {
     memset(block, 0, sizeof(*block));
@@ -36,27 +35,55 @@ void il_code_block_init(struct il_code_block *block) {
     block->inst_alloc = DEFAULT_BLOCK_LEN;
     block->inst_list = (struct jit_inst*)malloc(DEFAULT_BLOCK_LEN *
                                                 sizeof(struct jit_inst));
+    if (!block->inst_list)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+}
+
+void il_code_block_init_arena(struct il_code_block *block,
+                              struct jit_arena *arena) {
+    memset(block, 0, sizeof(*block));
+    block->inst_count = 0;
+    block->inst_alloc = DEFAULT_BLOCK_LEN;
+    block->arena = arena;
+    block->inst_list = (struct jit_inst*)
+        jit_arena_alloc(arena, DEFAULT_BLOCK_LEN * sizeof(struct jit_inst));
 }
 
 void il_code_block_cleanup(struct il_code_block *block) {
-    free(block->inst_list);
+    if (!block->arena)
+        free(block->inst_list);
     memset(block, 0, sizeof(*block));
 }
 
-void il_code_block_push_inst(struct il_code_block *block,
-                              struct jit_inst const *inst) {
-    if (block->inst_count >= block->inst_alloc) {
-        unsigned new_alloc = block->inst_alloc + BLOCK_GROW_LEN;
-        struct jit_inst *new_list =
-            (struct jit_inst*)realloc(block->inst_list,
-                                      new_alloc * sizeof(struct jit_inst));
+// double the length of inst_list
+static void il_code_block_grow(struct il_code_block *blk) {
+    unsigned new_alloc = blk->inst_alloc * 2;
+    size_t old_len = blk->inst_alloc * sizeof(struct jit_inst);
+    size_t new_len = new_alloc * sizeof(struct jit_inst);
+    struct jit_inst *new_list;
+
+    if (blk->arena) {
+        if (!jit_arena_extend(blk->arena, blk->inst_list, old_len, new_len)) {
+            new_list = (struct jit_inst*)jit_arena_alloc(blk->arena, new_len);
+            memcpy(new_list, blk->inst_list,
+                   blk->inst_count * sizeof(struct jit_inst));
+            blk->inst_list = new_list;
+        }
+    } else {
+        new_list = (struct jit_inst*)realloc(blk->inst_list, new_len);
         if (!new_list)
             RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        block->inst_list = new_list;
-        block->inst_alloc = new_alloc;
+        blk->inst_list = new_list;
     }
 
+    blk->inst_alloc = new_alloc;
+}
+
+void il_code_block_push_inst(struct il_code_block *block,
+                              struct jit_inst const *inst) {
+    if (block->inst_count >= block->inst_alloc)
+        il_code_block_grow(block);
+
     block->inst_list[block->inst_count++] = *inst;
 }
 
@@ -76,17 +103,8 @@ void il_code_block_insert_inst(struct il_code_block *blk,
         return;
     }
 
-    if (blk->inst_count >= blk->inst_alloc) {
-        unsigned new_alloc = blk->inst_alloc + BLOCK_GROW_LEN;
-        struct jit_inst *new_list =
-            (struct jit_inst*)realloc(blk->inst_list,
-                                      new_alloc * sizeof(struct jit_inst));
-        if (!new_list)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        blk->inst_list = new_list;
-        blk->inst_alloc = new_alloc;
-    }
+    if (blk->inst_count >= blk->inst_alloc)
+        il_code_block_grow(blk);
 
     unsigned n_insts_after = blk->inst_count - idx;
     if (n_insts_after)
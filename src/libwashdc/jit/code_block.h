@@ -24,15 +24,22 @@
 #define CODE_BLOCK_H_
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #include "jit_il.h"
+#include "jit_arena.h"
 #include "washdc/error.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "x86_64/code_block_x86_64.h"
 #endif
 
+#ifdef ENABLE_JIT_AARCH64
+#include "aarch64/code_block_aarch64.h"
+#endif
+
 #ifdef JIT_PROFILE
 #include "jit_profile.h"
 #endif
@@ -62,11 +69,32 @@ struct il_code_block {
     unsigned inst_count;
     unsigned inst_alloc;
 
+    /*
+     * if this is non-NULL, inst_list lives in arena and gets thrown away when
+     * the arena is reset instead of by il_code_block_cleanup.
+     */
+    struct jit_arena *arena;
+
     // this is a counter of how many slots the code block uses
     unsigned n_slots;
 
     struct il_slot slots[MAX_SLOTS];
 
+    /*
+     * set for idle loops, so the backend can make the block end its
+     * timeslice when it jumps back to idle_pc.
+     */
+    bool idle_loop;
+    uint32_t idle_pc;
+
+    /*
+     * if this is non-NULL, the block costs *dyn_cycles more scheduler cycles
+     * than the cycle count it was compiled with.  The backend reads it when
+     * the block exits, so the block's own code can set it.  This is for
+     * blocks that replace a whole guest routine (see hle_func.h).
+     */
+    uint32_t const *dyn_cycles;
+
 #ifdef JIT_PROFILE
     struct jit_profile_per_block *profile;
 #endif
@@ -81,13 +109,63 @@ check_slot(struct il_code_block *block, unsigned slot_no,
         RAISE_ERROR(ERROR_INTEGRITY);
 }
 
+/*
+ * one guest instruction for interpreters which execute blocks as arrays of
+ * predecoded opcode handlers instead of as il.
+ */
+struct predecode_inst {
+    void (*func)(void*, cpu_inst_param);
+    cpu_inst_param inst;
+    unsigned cycles;
+};
+
 struct jit_code_block {
-    union {
 #ifdef ENABLE_JIT_X86_64
-        struct code_block_x86_64 x86_64;
+    struct code_block_x86_64 x86_64;
 #endif
-        struct code_block_intp intp;
-    };
+#ifdef ENABLE_JIT_AARCH64
+    struct code_block_aarch64 aarch64;
+#endif
+
+    /*
+     * in native mode, this is only used by blocks that haven't been executed
+     * enough times to get compiled by the native backend yet.
+     */
+    struct code_block_intp intp;
+
+    /*
+     * offsets into main RAM of the first and last bytes of guest code that
+     * this block was compiled from.  These are only valid if in_ram is true.
+     * The code cache uses them to drop the block when the guest writes over
+     * its instructions.
+     */
+    uint32_t ram_first, ram_last;
+    bool in_ram;
+
+    /*
+     * copy of the guest instructions this block was compiled from, for
+     * frontends which check their blocks for self-modifying code on entry
+     * instead of relying on the code cache's RAM tracking.  This is NULL for
+     * frontends that don't use it.  It gets freed along with the block.
+     */
+    uint32_t *src;
+    unsigned src_len;
+
+    /*
+     * predecoded instructions for frontends that run blocks through a
+     * predecoding interpreter instead of through one of the jit backends.
+     * This is NULL for blocks that were compiled for a jit backend.  It gets
+     * freed along with the block.
+     */
+    struct predecode_inst *predecoded;
+    unsigned predecoded_len;
+
+    /*
+     * true if this block is a guest idle loop (see sh4_jit_idle_loop).  When
+     * the block branches back to its own start, the dispatcher skips ahead to
+     * the next scheduled event.
+     */
+    bool idle_loop;
 
 #ifdef JIT_PROFILE
     struct jit_profile_per_block *profile;
@@ -95,6 +173,13 @@ struct jit_code_block {
 };
 
 void il_code_block_init(struct il_code_block *block);
+
+/*
+ * same as il_code_block_init, but the il gets allocated from arena.  The
+ * block must not outlive the next jit_arena_reset.
+ */
+void il_code_block_init_arena(struct il_code_block *block,
+                              struct jit_arena *arena);
 void il_code_block_cleanup(struct il_code_block *block);
 
 void il_code_block_push_inst(struct il_code_block *block,
@@ -106,12 +191,22 @@ void il_code_block_insert_inst(struct il_code_block *blk,
 static inline void
 jit_code_block_init(struct jit_code_block *blk, uint32_t addr_first,
                     bool native_mode) {
-#ifdef ENABLE_JIT_X86_64
+#if defined(ENABLE_JIT_X86_64)
     if (native_mode)
         code_block_x86_64_init(&blk->x86_64);
-    else
+#elif defined(ENABLE_JIT_AARCH64)
+    if (native_mode)
+        code_block_aarch64_init(&blk->aarch64);
 #endif
-        code_block_intp_init(&blk->intp);
+    code_block_intp_init(&blk->intp);
+
+    blk->ram_first = blk->ram_last = 0;
+    blk->in_ram = false;
+    blk->src = NULL;
+    blk->src_len = 0;
+    blk->predecoded = NULL;
+    blk->predecoded_len = 0;
+    blk->idle_loop = false;
 
 #ifdef JIT_PROFILE
     blk->profile = jit_profile_create_block(addr_first);
@@ -124,12 +219,19 @@ jit_code_block_cleanup(struct jit_code_block *blk, bool native_mode) {
     jit_profile_free_block(blk->profile);
 #endif
 
-#ifdef ENABLE_JIT_X86_64
+#if defined(ENABLE_JIT_X86_64)
     if (native_mode)
         code_block_x86_64_cleanup(&blk->x86_64);
-    else
+#elif defined(ENABLE_JIT_AARCH64)
+    if (native_mode)
+        code_block_aarch64_cleanup(&blk->aarch64);
 #endif
-        code_block_intp_cleanup(&blk->intp);
+    code_block_intp_cleanup(&blk->intp);
+
+    free(blk->src);
+    blk->src = NULL;
+    free(blk->predecoded);
+    blk->predecoded = NULL;
 }
 
 /*
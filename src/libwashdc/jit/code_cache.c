@@ -24,56 +24,54 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <assert.h>
 
 #include "washdc/error.h"
 #include "code_block.h"
 #include "log.h"
 #include "config.h"
-#include "avl.h"
+#include "memory.h"
+#include "perf_cnt.h"
+
+#ifdef ENABLE_JIT_NATIVE
+#include "jit_bg_compile.h"
+#endif
 
 #ifdef ENABLE_JIT_X86_64
 #include "x86_64/exec_mem.h"
+#include "x86_64/native_dispatch.h"
+#endif
+
+#ifdef ENABLE_JIT_AARCH64
+#include "aarch64/exec_mem.h"
+#include "aarch64/native_dispatch.h"
 #endif
 
 #include "code_cache.h"
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
+static_assert(CODE_CACHE_RAM_SHIFT == MEMORY_SIZE_SHIFT,
+              "code cache page index does not cover main RAM");
 
-/*
- * This is a two-level cache.  The lower level is a binary search tree balanced
- * using the AVL algorithm.  The upper level is a hash-table.  Everything that
- * exists in the hash also exists in the tree, but not everything in the tree
- * exists in the hash.  When there is a collision in the hash, we discard
- * outdated values instead of trying to implement probing or chaining.
- */
+// number of entries allocated at a time
+#define SLAB_LEN 256
 
-/*
- * oldroot points to a list of trees invalid nodes.
- *
- * When code_cache_invalidate_all gets called from within CPU context
- * (typically due to a write to the SH4 CCR), all nodes need to be deleted.
- * This is not possible to due within CPU context because that would delete the
- * node which is currently executed.  As a workaround, the entire tree is
- * relocated to the oldroot pointer so that its nodes can be freed later when
- * the emulator exits CPU context.
- */
-struct oldroot_node {
-    struct avl_tree tree;
-    struct oldroot_node *next;
+struct code_cache_slab {
+    struct code_cache_slab *next;
+    unsigned n_used;
+    struct cache_entry ents[SLAB_LEN];
 };
-static struct oldroot_node *oldroot;
 
-static struct avl_tree tree;
-
-struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
-static void *dflt_entry;
+struct code_cache_oldgen {
+    struct code_cache_slab *slabs;
+    struct code_cache_bucket *ents;
+    unsigned ents_shift;
+    struct code_cache_oldgen *next;
+};
 
 /*
  * the maximum number of code-cache entries that can be created before the
- * cache assumes something is wrong.  This is completely arbitrary, and it may
- * need to be raised, lowered or removed entirely in the future.
+ * cache throws everything out and starts over.  This is completely arbitrary,
+ * and it may need to be raised, lowered or removed entirely in the future.
  *
  * The reason it is here is that my laptop doesn't have much memory, and when
  * the cache gets too big then my latop will thrash and become unresponsive.
@@ -81,76 +79,231 @@ static void *dflt_entry;
  * Under normal operation, I don't think the cache should get this big.  This
  * typically only happens when there's a bug in the cache that causes it to
  * keep making more and more cache entries because it is unable to find the
- * ones it has already created.  Dreamcast only has 16MB of memory, so it's
- * very unlikely (albeit not impossible) that this cache would hit 16-million
- * different jump-in points without getting reset via a write to the SH4's CCR
- * register.
+ * ones it has already created, or when a game keeps loading new code over old
+ * code for a very long time without ever writing to the SH4's CCR register.
  */
 #define MAX_ENTRIES (1024*1024)
-static unsigned n_entries;
 
-#ifdef ENABLE_JIT_X86_64
-static bool native_mode = true;
-#endif
+static uint8_t const no_ram_pages[CODE_CACHE_RAM_PAGE_COUNT];
 
-static struct avl_node*
-cache_entry_ctor(avl_key_type key) {
-    struct cache_entry *ent = calloc(1, sizeof(struct cache_entry));
+struct code_cache *code_cache_ram_owner;
+uint8_t const *code_cache_ram_pages = no_ram_pages;
 
-#ifdef ENABLE_JIT_X86_64
-    jit_code_block_init(&ent->blk, key, native_mode);
-#else
-    jit_code_block_init(&ent->blk, key, false);
-#endif
+static void ent_list_push(struct code_cache_ent_list *list,
+                          struct cache_entry *ent);
+static void ent_list_remove(struct code_cache_ent_list *list,
+                            struct cache_entry *ent);
+static void ent_list_clear(struct code_cache_ent_list *list);
+static void unindex_entry(struct code_cache *cache, struct cache_entry *ent);
+static void invalidate_entry(struct code_cache *cache, struct cache_entry *ent);
+static void cancel_bg_job(struct cache_entry *ent);
 
-    n_entries++;
-    if (n_entries >= MAX_ENTRIES)
-        RAISE_ERROR(ERROR_INTEGRITY);
-    return &ent->node;
+// fibonacci hashing, so that the entry table uses the high bits of the key
+static inline unsigned ent_tbl_idx(jit_hash key, unsigned shift) {
+    return (uint32_t)(key * 2654435769u) >> (32 - shift);
 }
 
+static struct code_cache_bucket *alloc_ent_tbl(unsigned shift) {
+    struct code_cache_bucket *ents = (struct code_cache_bucket*)
+        calloc(1 << shift, sizeof(struct code_cache_bucket));
+    if (!ents)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    return ents;
+}
+
+static void reinit_ent_tbl(struct code_cache *cache) {
+    cache->ents_shift = CODE_CACHE_ENT_TBL_SHIFT;
+    if (cache->spare_ents) {
+        cache->ents = cache->spare_ents;
+        cache->spare_ents = NULL;
+        memset(cache->ents, 0,
+               (1 << cache->ents_shift) * sizeof(cache->ents[0]));
+    } else {
+        cache->ents = alloc_ent_tbl(cache->ents_shift);
+    }
+    cache->slabs = NULL;
+}
+
+/*
+ * find the bucket for key.  If key isn't in the table, this returns the empty
+ * bucket where it belongs.
+ */
+static struct code_cache_bucket *
+ent_tbl_probe(struct code_cache_bucket *ents, unsigned shift, jit_hash key) {
+    unsigned mask = (1 << shift) - 1;
+    unsigned idx = ent_tbl_idx(key, shift);
+    while (ents[idx].ent && ents[idx].key != key)
+        idx = (idx + 1) & mask;
+    return ents + idx;
+}
+
+// double the size of the entry table.  The entries themselves don't move.
+static void grow_ent_tbl(struct code_cache *cache) {
+    unsigned old_len = 1 << cache->ents_shift;
+    unsigned new_shift = cache->ents_shift + 1;
+    struct code_cache_bucket *old_ents = cache->ents;
+    struct code_cache_bucket *new_ents = alloc_ent_tbl(new_shift);
+
+    unsigned idx;
+    for (idx = 0; idx < old_len; idx++) {
+        if (old_ents[idx].ent) {
+            *ent_tbl_probe(new_ents, new_shift, old_ents[idx].key) =
+                old_ents[idx];
+        }
+    }
+
+    free(old_ents);
+    cache->ents = new_ents;
+    cache->ents_shift = new_shift;
+}
+
+static struct cache_entry *alloc_entry(struct code_cache *cache, jit_hash key) {
+    struct code_cache_slab *slab = cache->slabs;
+    if (!slab || slab->n_used >= SLAB_LEN) {
+        if (cache->free_slabs) {
+            slab = cache->free_slabs;
+            cache->free_slabs = slab->next;
+        } else {
+            slab = (struct code_cache_slab*)
+                malloc(sizeof(struct code_cache_slab));
+            if (!slab)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+        }
+        slab->n_used = 0;
+        slab->next = cache->slabs;
+        cache->slabs = slab;
+    }
+
+    struct cache_entry *ent = slab->ents + slab->n_used++;
+    memset(ent, 0, sizeof(*ent));
+    ent->key = key;
+    jit_code_block_init(&ent->blk, key, cache->native_mode);
+
+    cache->n_entries++;
+    return ent;
+}
+
+// clean up every entry in a list of slabs and put the slabs on free_slabs
 static void
-cache_entry_dtor(struct avl_node *node) {
-    struct cache_entry *ent = &AVL_DEREF(node, struct cache_entry, node);
+recycle_slabs(struct code_cache *cache, struct code_cache_slab *slab) {
+    while (slab) {
+        struct code_cache_slab *next = slab->next;
+        unsigned idx;
+        for (idx = 0; idx < slab->n_used; idx++) {
+            cancel_bg_job(slab->ents + idx);
+            jit_code_block_cleanup(&slab->ents[idx].blk, cache->native_mode);
+        }
+        slab->n_used = 0;
+        slab->next = cache->free_slabs;
+        cache->free_slabs = slab;
+        slab = next;
+    }
+}
 
-#ifdef ENABLE_JIT_X86_64
-    jit_code_block_cleanup(&ent->blk, native_mode);
+static void reset_tbl(struct code_cache *cache) {
+    unsigned idx;
+    for (idx = 0; idx < cache->tbl_len; idx++)
+        cache->tbl[idx] = cache->dflt_entry;
+}
+
+void code_cache_init(struct code_cache *cache, unsigned tbl_shift,
+                     bool native_mode) {
+    memset(cache, 0, sizeof(*cache));
+
+#ifdef ENABLE_JIT_NATIVE
+    cache->native_mode = native_mode;
 #else
-    jit_code_block_cleanup(&ent->blk, false);
+    cache->native_mode = false;
 #endif
 
-    free(ent);
+    cache->tbl_len = 1 << tbl_shift;
+    cache->tbl_mask = cache->tbl_len - 1;
+    cache->tbl = (struct cache_entry**)malloc(cache->tbl_len *
+                                              sizeof(cache->tbl[0]));
+    cache->ram_pages = (struct code_cache_ent_list*)
+        calloc(CODE_CACHE_RAM_PAGE_COUNT, sizeof(cache->ram_pages[0]));
+    cache->ram_page_flags = (uint8_t*)calloc(CODE_CACHE_RAM_PAGE_COUNT,
+                                             sizeof(cache->ram_page_flags[0]));
+    if (!cache->tbl || !cache->ram_pages || !cache->ram_page_flags)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    reinit_ent_tbl(cache);
+    reset_tbl(cache);
 }
 
-static void reinit_tree(void) {
-    avl_init(&tree, cache_entry_ctor, cache_entry_dtor);
+void code_cache_cleanup(struct code_cache *cache) {
+    if (code_cache_ram_owner == cache)
+        code_cache_set_ram_owner(NULL);
+
+    code_cache_invalidate_all(cache);
+    code_cache_gc(cache);
+
+    while (cache->free_slabs) {
+        struct code_cache_slab *next = cache->free_slabs->next;
+        free(cache->free_slabs);
+        cache->free_slabs = next;
+    }
+    while (cache->free_oldgens) {
+        struct code_cache_oldgen *next = cache->free_oldgens->next;
+        free(cache->free_oldgens);
+        cache->free_oldgens = next;
+    }
+    free(cache->spare_ents);
+
+    unsigned page_no;
+    for (page_no = 0; page_no < CODE_CACHE_RAM_PAGE_COUNT; page_no++)
+        free(cache->ram_pages[page_no].ents);
+    free(cache->ram_pages);
+    free(cache->ram_page_flags);
+    free(cache->untracked.ents);
+    free(cache->ents);
+    free(cache->tbl);
+    memset(cache, 0, sizeof(*cache));
 }
 
-void code_cache_init(void) {
-    reinit_tree();
+void code_cache_set_budget(struct code_cache *cache, size_t budget) {
+    cache->budget = budget;
+}
 
-    unsigned idx;
-    for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+static bool over_budget(struct code_cache const *cache) {
+    if (cache->n_entries >= MAX_ENTRIES)
+        return true;
+    if (cache->budget && cache->n_bytes > cache->budget)
+        return true;
+#ifdef ENABLE_JIT_NATIVE
+    if (cache->native_mode && exec_mem_low())
+        return true;
+#endif
+    return false;
+}
 
-#ifdef ENABLE_JIT_X86_64
-    native_mode = config_get_native_jit();
+// approximately how much memory ent's block is using
+static unsigned entry_bytes(struct cache_entry const *ent) {
+    struct jit_code_block const *blk = &ent->blk;
+    size_t n_bytes = sizeof(*ent) +
+        blk->intp.inst_count * sizeof(blk->intp.inst_list[0]) +
+        blk->intp.n_slots * sizeof(blk->intp.slots[0]) +
+        blk->src_len * sizeof(blk->src[0]) +
+        blk->predecoded_len * sizeof(blk->predecoded[0]);
+#if defined(ENABLE_JIT_X86_64)
+    n_bytes += blk->x86_64.bytes_used;
+#elif defined(ENABLE_JIT_AARCH64)
+    n_bytes += blk->aarch64.bytes_used;
 #endif
+    return n_bytes;
 }
 
-void code_cache_cleanup(void) {
-    code_cache_invalidate_all();
-    code_cache_gc();
+void code_cache_set_ram_owner(struct code_cache *cache) {
+    code_cache_ram_owner = cache;
+    code_cache_ram_pages = cache ? cache->ram_page_flags : no_ram_pages;
 }
 
-void code_cache_set_default(void *dflt) {
-    dflt_entry = dflt;
-    unsigned idx;
-    for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+void code_cache_set_default(struct code_cache *cache, void *dflt) {
+    cache->dflt_entry = dflt;
+    reset_tbl(cache);
 }
 
-void code_cache_invalidate_all(void) {
+void code_cache_invalidate_all(struct code_cache *cache) {
     /*
      * this function gets called whenever something writes to the sh4 CCR.
      * Since we don't want to trash the block currently executing, we instead
@@ -158,58 +311,285 @@ void code_cache_invalidate_all(void) {
      */
     LOG_DBG("%s called - nuking cache\n", __func__);
 
+#ifdef ENABLE_JIT_NATIVE
+    // every block that's linked to another block is about to be invalid
+    if (cache->native_mode)
+        native_link_unlink_all();
+#endif
+
     /*
-     * Throw root onto the oldroot list to be cleared later.  It's not safe to
-     * clear out oldroot now because the current code block might be part of it.
-     * Also keep in mind that the current code block might be part of a
-     * pre-existing oldroot if this function got called more than once by the
-     * current code block.
+     * Throw the current generation onto the oldgen list to be cleared later.
+     * It's not safe to clear out oldgen now because the current code block
+     * might be part of it.  Also keep in mind that the current code block
+     * might be part of a pre-existing oldgen if this function got called more
+     * than once by the current code block.
      */
-    struct oldroot_node *list_node =
-        (struct oldroot_node*)malloc(sizeof(struct oldroot_node));
-    if (!list_node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    list_node->next = oldroot;
-    list_node->tree = tree;
-    oldroot = list_node;
+    struct code_cache_oldgen *list_node = cache->free_oldgens;
+    if (list_node) {
+        cache->free_oldgens = list_node->next;
+    } else {
+        list_node = (struct code_cache_oldgen*)
+            malloc(sizeof(struct code_cache_oldgen));
+        if (!list_node)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    list_node->next = cache->oldgen;
+    list_node->slabs = cache->slabs;
+    list_node->ents = cache->ents;
+    list_node->ents_shift = cache->ents_shift;
+    cache->oldgen = list_node;
+
+    reinit_ent_tbl(cache);
+    reset_tbl(cache);
+
+    // every entry in the page index belongs to the generation we just threw away
+    unsigned page_no;
+    for (page_no = 0; page_no < CODE_CACHE_RAM_PAGE_COUNT; page_no++)
+        ent_list_clear(cache->ram_pages + page_no);
+    memset(cache->ram_page_flags, 0,
+           CODE_CACHE_RAM_PAGE_COUNT * sizeof(cache->ram_page_flags[0]));
+    ent_list_clear(&cache->untracked);
+
+    cache->n_entries = 0;
+    cache->n_bytes = 0;
+}
+
+static void invalidate_ram_range(struct code_cache *cache,
+                                 addr32_t first, addr32_t last) {
+    unsigned page_no;
+    unsigned first_page = first >> CODE_CACHE_PAGE_SHIFT;
+    unsigned last_page = last >> CODE_CACHE_PAGE_SHIFT;
+    for (page_no = first_page; page_no <= last_page; page_no++) {
+        struct code_cache_ent_list *list = cache->ram_pages + page_no;
+        unsigned idx = 0;
+        while (idx < list->n_ents) {
+            struct cache_entry *ent = list->ents[idx];
+            if (ent->blk.ram_first <= last && ent->blk.ram_last >= first) {
+                LOG_DBG("%s - invalidating block at %08X\n",
+                        __func__, (unsigned)ent->key);
+                /*
+                 * unindex_entry removes ent from this list, which moves a
+                 * different entry into idx.
+                 */
+                unindex_entry(cache, ent);
+                invalidate_entry(cache, ent);
+            } else {
+                idx++;
+            }
+        }
+    }
+}
+
+void code_cache_invalidate_ram(struct code_cache *cache,
+                               addr32_t first, addr32_t last) {
+    first &= MEMORY_MASK;
+    last &= MEMORY_MASK;
+    if (last < first) {
+        // the write wrapped around the end of RAM
+        invalidate_ram_range(cache, first, MEMORY_MASK);
+        invalidate_ram_range(cache, 0, last);
+    } else {
+        invalidate_ram_range(cache, first, last);
+    }
+}
+
+void code_cache_invalidate_untracked(struct code_cache *cache) {
+    struct code_cache_ent_list *untracked = &cache->untracked;
+
+    LOG_DBG("%s called - dropping %u blocks\n", __func__, untracked->n_ents);
+
+    while (untracked->n_ents) {
+        struct cache_entry *ent = untracked->ents[untracked->n_ents - 1];
+        unindex_entry(cache, ent);
+        invalidate_entry(cache, ent);
+    }
+}
+
+void code_cache_invalidate_entry(struct code_cache *cache,
+                                 struct cache_entry *ent) {
+    if (ent->valid) {
+        unindex_entry(cache, ent);
+        invalidate_entry(cache, ent);
+    }
+}
+
+void code_cache_set_valid(struct code_cache *cache, struct cache_entry *ent) {
+    ent->valid = 1;
+    cache->n_compiles++;
+
+    ent->n_bytes = entry_bytes(ent);
+    cache->n_bytes += ent->n_bytes;
+
+    if (ent->blk.in_ram) {
+        unsigned page_no;
+        unsigned first_page = ent->blk.ram_first >> CODE_CACHE_PAGE_SHIFT;
+        unsigned last_page = ent->blk.ram_last >> CODE_CACHE_PAGE_SHIFT;
+        for (page_no = first_page; page_no <= last_page; page_no++) {
+            ent_list_push(cache->ram_pages + page_no, ent);
+            cache->ram_page_flags[page_no] = 1;
+        }
+    } else {
+        ent_list_push(&cache->untracked, ent);
+    }
+}
+
+static void unindex_entry(struct code_cache *cache, struct cache_entry *ent) {
+    if (ent->blk.in_ram) {
+        unsigned page_no;
+        unsigned first_page = ent->blk.ram_first >> CODE_CACHE_PAGE_SHIFT;
+        unsigned last_page = ent->blk.ram_last >> CODE_CACHE_PAGE_SHIFT;
+        for (page_no = first_page; page_no <= last_page; page_no++) {
+            ent_list_remove(cache->ram_pages + page_no, ent);
+            cache->ram_page_flags[page_no] =
+                cache->ram_pages[page_no].n_ents != 0;
+        }
+    } else {
+        ent_list_remove(&cache->untracked, ent);
+    }
+}
+
+void code_cache_evict_entry(struct code_cache *cache, struct cache_entry *ent) {
+    unsigned hash_idx = ent->key & cache->tbl_mask;
+    if (cache->tbl[hash_idx] == ent)
+        cache->tbl[hash_idx] = cache->dflt_entry;
+#if defined(ENABLE_JIT_X86_64)
+    if (cache->native_mode)
+        native_link_unlink_in(&ent->blk.x86_64);
+#elif defined(ENABLE_JIT_AARCH64)
+    if (cache->native_mode)
+        native_link_unlink_in(&ent->blk.aarch64);
+#endif
+}
+
+/*
+ * The entry stays in the entry table so that the probe sequences of other
+ * entries don't get broken, but it gets evicted so that the native dispatch
+ * code will take the slow path next time it jumps to this address.
+ * The block itself gets cleaned up later by code_cache_find_slow.
+ */
+static void invalidate_entry(struct code_cache *cache, struct cache_entry *ent) {
+    code_cache_evict_entry(cache, ent);
+    cancel_bg_job(ent);
+    cache->n_bytes -= ent->n_bytes;
+    ent->n_bytes = 0;
+    ent->valid = 0;
+    ent->stale = 1;
+}
+
+// a background compile of a block that's been invalidated is useless
+static void cancel_bg_job(struct cache_entry *ent) {
+#ifdef ENABLE_JIT_NATIVE
+    if (ent->bg_job) {
+        jit_bg_compile_cancel(ent->bg_job);
+        ent->bg_job = NULL;
+    }
+#else
+    (void)ent;
+#endif
+}
 
-    reinit_tree();
+static void ent_list_push(struct code_cache_ent_list *list,
+                          struct cache_entry *ent) {
+    if (list->n_ents >= list->n_alloc) {
+        unsigned n_alloc = list->n_alloc ? list->n_alloc * 2 : 8;
+        struct cache_entry **ents =
+            (struct cache_entry**)realloc(list->ents, n_alloc * sizeof(*ents));
+        if (!ents)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        list->ents = ents;
+        list->n_alloc = n_alloc;
+    }
+    list->ents[list->n_ents++] = ent;
+}
 
+static void ent_list_remove(struct code_cache_ent_list *list,
+                            struct cache_entry *ent) {
     unsigned idx;
-    for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+    for (idx = 0; idx < list->n_ents; idx++) {
+        if (list->ents[idx] == ent) {
+            list->ents[idx] = list->ents[--list->n_ents];
+            return;
+        }
+    }
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
 
-    n_entries = 0;
+static void ent_list_clear(struct code_cache_ent_list *list) {
+    list->n_ents = 0;
 }
 
-void code_cache_gc(void) {
-    while (oldroot) {
-        struct oldroot_node *next = oldroot->next;
-        avl_cleanup(&oldroot->tree);
-        free(oldroot);
-        oldroot = next;
+void code_cache_gc(struct code_cache *cache) {
+    while (cache->oldgen) {
+        struct code_cache_oldgen *gen = cache->oldgen;
+        cache->oldgen = gen->next;
+
+        recycle_slabs(cache, gen->slabs);
+
+        // tables that grew past the default size aren't worth keeping
+        if (!cache->spare_ents &&
+            gen->ents_shift == CODE_CACHE_ENT_TBL_SHIFT) {
+            cache->spare_ents = gen->ents;
+        } else {
+            free(gen->ents);
+        }
+
+        gen->next = cache->free_oldgens;
+        cache->free_oldgens = gen;
     }
 
 #ifdef INVARIANTS
-#ifdef ENABLE_JIT_X86_64
-    if (config_get_native_jit())
+#ifdef ENABLE_JIT_NATIVE
+    if (cache->native_mode)
         exec_mem_check_integrity();
 #endif
 #endif
 }
 
-struct cache_entry *code_cache_find(jit_hash hash) {
-    unsigned hash_idx = hash & CODE_CACHE_HASH_TBL_MASK;
-    struct cache_entry *maybe = code_cache_tbl[hash_idx];
-    if (maybe && maybe->node.key == hash)
+struct cache_entry *code_cache_find(struct code_cache *cache, jit_hash hash) {
+    unsigned hash_idx = hash & cache->tbl_mask;
+    struct cache_entry *maybe = cache->tbl[hash_idx];
+    if (maybe && maybe->key == hash)
         return maybe;
 
-    struct cache_entry *ret = code_cache_find_slow(hash);
-    code_cache_tbl[hash_idx] = ret;
+    PERF_TIMER_BEGIN(PERF_CODE_CACHE_MISS);
+    struct cache_entry *ret = code_cache_find_slow(cache, hash);
+    PERF_TIMER_END(PERF_CODE_CACHE_MISS);
+    cache->tbl[hash_idx] = ret;
     return ret;
 }
 
-struct cache_entry *code_cache_find_slow(jit_hash hash) {
-    struct avl_node *node = avl_find(&tree, hash);
-    return &AVL_DEREF(node, struct cache_entry, node);
+struct cache_entry *
+code_cache_find_slow(struct code_cache *cache, jit_hash hash) {
+    struct code_cache_bucket *bucket =
+        ent_tbl_probe(cache->ents, cache->ents_shift, hash);
+    struct cache_entry *ent = bucket->ent;
+
+    if (!ent) {
+        if (over_budget(cache)) {
+            LOG_INFO("code cache is over budget (%u entries, %llu bytes); "
+                     "starting over\n", cache->n_entries,
+                     (unsigned long long)cache->n_bytes);
+            code_cache_invalidate_all(cache);
+            bucket = ent_tbl_probe(cache->ents, cache->ents_shift, hash);
+        }
+        ent = alloc_entry(cache, hash);
+        bucket->key = hash;
+        bucket->ent = ent;
+        if (cache->n_entries * 2 >= (1u << cache->ents_shift))
+            grow_ent_tbl(cache);
+        return ent;
+    }
+
+    if (ent->stale) {
+        /*
+         * a write to main RAM invalidated this entry.  Nothing can be
+         * executing the old block anymore now that we're looking it up again,
+         * so it's safe to throw it away.
+         */
+        jit_code_block_cleanup(&ent->blk, cache->native_mode);
+        jit_code_block_init(&ent->blk, hash, cache->native_mode);
+        ent->stale = 0;
+    }
+
+    return ent;
 }
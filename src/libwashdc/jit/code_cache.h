@@ -23,13 +23,16 @@
 #ifndef CODE_CACHE_H_
 #define CODE_CACHE_H_
 
-#include "avl.h"
 #include "code_block.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "x86_64/code_block_x86_64.h"
 #endif
 
+#ifdef ENABLE_JIT_AARCH64
+#include "aarch64/code_block_aarch64.h"
+#endif
+
 #include "washdc/types.h"
 
 #include "defs.h"
@@ -39,13 +42,173 @@
  * Otherwise, this code will trip over anything that tries to switch
  * between single-precision and double-precision floating-point.
  */
+struct jit_bg_job;
+
 struct cache_entry {
-    struct avl_node node;
+    jit_hash key;
 
     uint8_t valid;
+
+    /*
+     * if this is set, then blk still holds code from a compilation that got
+     * invalidated by a write to main RAM.  It can't be cleaned up at the time
+     * of the write because the block might be the one that's executing, so
+     * instead it gets cleaned up the next time the entry is looked up.
+     */
+    uint8_t stale;
+
+    /*
+     * for the native jit's tiering.  n_execs counts how many times the block
+     * has run through the interpreter, and hot gets set once it's been run
+     * enough times to be worth compiling with the native backend.  These
+     * survive invalidation so that a hot block doesn't have to earn its way
+     * back up after getting recompiled.
+     */
+    uint8_t hot;
+    unsigned n_execs;
+
+    /*
+     * for background compilation (see jit_bg_compile.h).  bg_job is the
+     * pending native compile of a block which is still running through the
+     * interpreter, and pc is the guest address that the block starts at.
+     */
+    struct jit_bg_job *bg_job;
+    addr32_t pc;
+
+    // this entry's share of code_cache.n_bytes, see code_cache_set_budget
+    unsigned n_bytes;
+
     struct jit_code_block blk;
 };
 
+/*
+ * Blocks compiled from main RAM are tracked at a granularity of 4KB pages.
+ * This has to agree with MEMORY_SIZE in memory.h.
+ */
+#define CODE_CACHE_PAGE_SHIFT 12
+#define CODE_CACHE_RAM_SHIFT 24
+#define CODE_CACHE_RAM_PAGE_COUNT \
+    (1 << (CODE_CACHE_RAM_SHIFT - CODE_CACHE_PAGE_SHIFT))
+
+// default size of the hash table in front of the entry table
+#define CODE_CACHE_HASH_TBL_SHIFT 16
+
+// initial size of the entry table, it gets doubled whenever it's half full
+#define CODE_CACHE_ENT_TBL_SHIFT 14
+
+struct code_cache_ent_list {
+    struct cache_entry **ents;
+    unsigned n_ents, n_alloc;
+};
+
+// one bucket of the entry table.  ent is NULL if the bucket is empty.
+struct code_cache_bucket {
+    jit_hash key;
+    struct cache_entry *ent;
+};
+
+struct code_cache_slab;
+struct code_cache_oldgen;
+
+/*
+ * This is a two-level cache.  The lower level is an open-addressed hash table
+ * (the entry table) which uses linear probing and holds every entry.  The
+ * upper level is a direct-mapped hash-table.  Everything that exists in the
+ * upper level also exists in the entry table, but not everything in the entry
+ * table exists in the upper level.  When there is a collision in the upper
+ * level, we discard outdated values instead of trying to implement probing or
+ * chaining.
+ *
+ * Entries are allocated out of slabs so that they never move after they've
+ * been created, and so that a whole generation of them can be freed at once.
+ *
+ * Each CPU that runs through the jit gets its own code_cache.
+ */
+struct code_cache {
+    struct code_cache_bucket *ents;
+    unsigned ents_shift;
+
+    // slabs holding every entry in ents
+    struct code_cache_slab *slabs;
+
+    /*
+     * oldgen points to a list of old generations of invalid entries.
+     *
+     * When code_cache_invalidate_all gets called from within CPU context
+     * (typically due to a write to the SH4 CCR), all entries need to be
+     * deleted.  This is not possible to due within CPU context because that
+     * would delete the entry which is currently executed.  As a workaround,
+     * the slabs and the entry table are relocated to the oldgen list so that
+     * they can be freed later when the emulator exits CPU context.
+     */
+    struct code_cache_oldgen *oldgen;
+
+    /*
+     * slabs, oldgen nodes and a default-sized entry table left over from
+     * generations that code_cache_gc already threw out.  These get reused
+     * before anything new is allocated so that a recompile storm doesn't keep
+     * going back to malloc.
+     */
+    struct code_cache_slab *free_slabs;
+    struct code_cache_oldgen *free_oldgens;
+    struct code_cache_bucket *spare_ents;
+
+    unsigned n_entries;
+
+    // blocks compiled so far, see code_cache_set_valid
+    unsigned long n_compiles;
+
+    /*
+     * n_bytes is roughly how much memory the valid blocks are using, and
+     * budget is how high it's allowed to go before the cache starts over.
+     * A budget of zero means no limit.
+     */
+    size_t n_bytes, budget;
+
+    bool native_mode;
+
+    /*
+     * tbl is the hash table.  The native dispatch code indexes into it
+     * directly with tbl_mask.
+     */
+    struct cache_entry **tbl;
+    unsigned tbl_len, tbl_mask;
+    void *dflt_entry;
+
+    /*
+     * Index of valid cache entries by the 4KB pages of main RAM they were
+     * compiled from.  A block which straddles a page boundary is listed under
+     * every page it touches.  Blocks which were not compiled from main RAM (ie
+     * the BIOS) go on the untracked list instead.
+     *
+     * ram_page_flags has one byte for every page of main RAM, and that byte
+     * is non-zero if there are any valid blocks compiled from that page.
+     */
+    struct code_cache_ent_list *ram_pages;
+    struct code_cache_ent_list untracked;
+    uint8_t *ram_page_flags;
+};
+
+/*
+ * tbl_shift is the log2 of the number of entries in the hash table.
+ * native_mode determines which backend the cache's blocks get initialized for.
+ */
+void code_cache_init(struct code_cache *cache, unsigned tbl_shift,
+                     bool native_mode);
+void code_cache_cleanup(struct code_cache *cache);
+
+/*
+ * Once the cache's blocks are using more than budget bytes of memory, the
+ * next time it would have to create an entry it throws out every block it has
+ * and starts over with a new generation, the same as code_cache_invalidate_all.
+ * Blocks which are still needed just get compiled again.  The cache also
+ * starts over if it gets MAX_ENTRIES entries, or if it's in native mode and
+ * exec_mem is running low, regardless of the budget.
+ *
+ * Nothing in the old generation actually gets freed until code_cache_gc.
+ */
+void code_cache_set_budget(struct code_cache *cache, size_t budget);
+
 /*
  * this might return a pointer to an invalid cache_entry.  If so, that means
  * the cache entry needs to be filled in by the callee.  This function will
@@ -54,34 +217,88 @@ struct cache_entry {
  * That said, blk will already be init'd no matter what, even if valid is
  * false.
  */
-struct cache_entry *code_cache_find(jit_hash hash);
+struct cache_entry *code_cache_find(struct code_cache *cache, jit_hash hash);
 
 /*
  * This is like code_cache_find, but it skips the second-level hash table.
  * This function is intended for JIT code which handles that itself
  */
-struct cache_entry *code_cache_find_slow(jit_hash hash);
+struct cache_entry *
+code_cache_find_slow(struct code_cache *cache, jit_hash hash);
 
-void code_cache_invalidate_all(void);
+/*
+ * mark ent as valid after its block has been compiled.  This also records
+ * which pages of main RAM the block was compiled from so that it can be
+ * invalidated if any of them get written to.
+ */
+void code_cache_set_valid(struct code_cache *cache, struct cache_entry *ent);
 
-void code_cache_init(void);
-void code_cache_cleanup(void);
+/*
+ * drop a single entry.  Like every other invalidation, the block does not get
+ * freed until the next time it gets looked up.
+ */
+void code_cache_invalidate_entry(struct code_cache *cache,
+                                 struct cache_entry *ent);
+
+/*
+ * drop ent from the hash table and unlink every block that jumps directly to
+ * it, but leave it valid.  The next time the native dispatch code jumps to
+ * ent's address it will take the slow path.
+ */
+void code_cache_evict_entry(struct code_cache *cache, struct cache_entry *ent);
+
+void code_cache_invalidate_all(struct code_cache *cache);
+
+/*
+ * invalidate every block which was compiled from the given range of main RAM.
+ * first and last are offsets into main RAM, and the range is inclusive.
+ */
+void code_cache_invalidate_ram(struct code_cache *cache,
+                               addr32_t first, addr32_t last);
+
+/*
+ * invalidate every block which was not compiled from main RAM.  Blocks in main
+ * RAM are kept coherent by code_cache_notify_ram_write, so those don't need to
+ * be invalidated when the guest flushes the instruction cache.
+ */
+void code_cache_invalidate_untracked(struct code_cache *cache);
 
 /*
  * call this periodically from outside of CPU context to clear
  * out old cache entries.
  */
-void code_cache_gc(void);
+void code_cache_gc(struct code_cache *cache);
 
 /*
- * set the value that the code_cache_tbl gets overwritten with whenever there's
+ * set the value that the hash table gets overwritten with whenever there's
  * a nuke
  */
-void code_cache_set_default(void *dflt);
+void code_cache_set_default(struct code_cache *cache, void *dflt);
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
-extern struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
+/*
+ * Writes to main RAM go to whichever cache has been set as the RAM owner (the
+ * SH4's).  code_cache_ram_pages points to the owner's ram_page_flags, or to
+ * an array of zeroes if there is no owner.
+ */
+void code_cache_set_ram_owner(struct code_cache *cache);
+extern struct code_cache *code_cache_ram_owner;
+extern uint8_t const *code_cache_ram_pages;
+
+/*
+ * this gets called on every write to main RAM.  addr is an offset into
+ * main RAM.
+ */
+static inline void code_cache_notify_ram_write(addr32_t addr, unsigned n_bytes) {
+    addr32_t last = addr + (n_bytes - 1);
+    if (code_cache_ram_pages[addr >> CODE_CACHE_PAGE_SHIFT] ||
+        code_cache_ram_pages[last >> CODE_CACHE_PAGE_SHIFT])
+        code_cache_invalidate_ram(code_cache_ram_owner, addr, last);
+}
+
+// like code_cache_notify_ram_write, but for big writes (ie DMA)
+static inline void code_cache_notify_ram_range(addr32_t first, addr32_t last) {
+    if (code_cache_ram_owner)
+        code_cache_invalidate_ram(code_cache_ram_owner, first, last);
+}
 
 #endif
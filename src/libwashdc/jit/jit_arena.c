@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "washdc/error.h"
+
+#include "jit_arena.h"
+
+struct jit_arena_chunk {
+    struct jit_arena_chunk *next;
+    size_t len, used;
+    max_align_t data[];
+};
+
+#define JIT_ARENA_ALIGN (sizeof(max_align_t))
+
+static size_t jit_arena_round(size_t n_bytes) {
+    return (n_bytes + JIT_ARENA_ALIGN - 1) & ~(JIT_ARENA_ALIGN - 1);
+}
+
+static struct jit_arena_chunk *jit_arena_new_chunk(size_t len) {
+    struct jit_arena_chunk *chunk =
+        (struct jit_arena_chunk*)malloc(sizeof(*chunk) + len);
+    if (!chunk)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    chunk->next = NULL;
+    chunk->len = len;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void jit_arena_free_chunks(struct jit_arena_chunk *chunk) {
+    while (chunk) {
+        struct jit_arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void jit_arena_init(struct jit_arena *arena, size_t chunk_len) {
+    arena->chunk_len = jit_arena_round(chunk_len);
+    arena->chunks = jit_arena_new_chunk(arena->chunk_len);
+    arena->n_used = 0;
+}
+
+void jit_arena_cleanup(struct jit_arena *arena) {
+    jit_arena_free_chunks(arena->chunks);
+    arena->chunks = NULL;
+}
+
+void *jit_arena_alloc(struct jit_arena *arena, size_t n_bytes) {
+    n_bytes = jit_arena_round(n_bytes);
+
+    struct jit_arena_chunk *chunk = arena->chunks;
+    if (chunk->len - chunk->used < n_bytes) {
+        size_t len = n_bytes > arena->chunk_len ? n_bytes : arena->chunk_len;
+        chunk = jit_arena_new_chunk(len);
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    void *ret = ((char*)chunk->data) + chunk->used;
+    chunk->used += n_bytes;
+    arena->n_used += n_bytes;
+    return ret;
+}
+
+bool jit_arena_extend(struct jit_arena *arena, void *ptr,
+                      size_t old_len, size_t new_len) {
+    struct jit_arena_chunk *chunk = arena->chunks;
+    old_len = jit_arena_round(old_len);
+    new_len = jit_arena_round(new_len);
+
+    if (((char*)ptr) + old_len != ((char*)chunk->data) + chunk->used)
+        return false;
+    if (chunk->len - (chunk->used - old_len) < new_len)
+        return false;
+
+    chunk->used += new_len - old_len;
+    arena->n_used += new_len - old_len;
+    return true;
+}
+
+void jit_arena_reset(struct jit_arena *arena) {
+    struct jit_arena_chunk *chunk = arena->chunks;
+    if (chunk->next) {
+        /*
+         * the last block overflowed the first chunk, so replace everything
+         * with one chunk that would have been big enough.
+         */
+        if (arena->n_used > arena->chunk_len)
+            arena->chunk_len = arena->n_used;
+        jit_arena_free_chunks(chunk);
+        chunk = arena->chunks = jit_arena_new_chunk(arena->chunk_len);
+    }
+    chunk->used = 0;
+    arena->n_used = 0;
+}
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef JIT_ARENA_H_
+#define JIT_ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * bump allocator for memory that only lives as long as one block takes to
+ * compile.  Everything allocated out of an arena gets thrown away at once by
+ * jit_arena_reset, and nothing gets freed individually.
+ *
+ * The arena is a list of chunks.  When an allocation doesn't fit in the
+ * current chunk, a new one gets malloc'd; jit_arena_reset then replaces all of
+ * them with a single chunk big enough for everything, so once the arena has
+ * seen the biggest block it's going to see it never calls malloc again.
+ */
+
+struct jit_arena_chunk;
+
+struct jit_arena {
+    struct jit_arena_chunk *chunks;
+    size_t chunk_len;
+
+    // total bytes handed out since the last reset
+    size_t n_used;
+};
+
+void jit_arena_init(struct jit_arena *arena, size_t chunk_len);
+void jit_arena_cleanup(struct jit_arena *arena);
+
+void *jit_arena_alloc(struct jit_arena *arena, size_t n_bytes);
+
+/*
+ * try to grow ptr, which must be the most recent allocation, from old_len
+ * bytes to new_len bytes without moving it.  Returns false if there isn't
+ * room, in which case the caller needs to allocate somewhere else.
+ */
+bool jit_arena_extend(struct jit_arena *arena, void *ptr,
+                      size_t old_len, size_t new_len);
+
+void jit_arena_reset(struct jit_arena *arena);
+
+#endif
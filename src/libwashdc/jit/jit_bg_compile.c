@@ -0,0 +1,304 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "log.h"
+#include "config.h"
+#include "threading.h"
+#include "atomics.h"
+#include "code_block.h"
+#include "jit_perf_map.h"
+
+#ifdef ENABLE_JIT_X86_64
+#include "x86_64/code_block_x86_64.h"
+#include "x86_64/exec_mem.h"
+#endif
+
+#ifdef ENABLE_JIT_AARCH64
+#include "aarch64/code_block_aarch64.h"
+#include "aarch64/exec_mem.h"
+#endif
+
+#include "jit_bg_compile.h"
+
+enum job_state {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+struct jit_bg_job {
+    void *cpu;
+    struct native_dispatch_meta const *meta;
+    struct il_code_block il_blk;
+    unsigned cycle_count;
+    uint32_t guest_pc;
+
+#if defined(ENABLE_JIT_X86_64)
+    struct code_block_x86_64 native;
+#elif defined(ENABLE_JIT_AARCH64)
+    struct code_block_aarch64 native;
+#endif
+
+    /*
+     * state only ever moves forward, and it only changes with queue_lock held.
+     * It's atomic so that jit_bg_compile_done doesn't need the lock.
+     */
+    washdc_atomic_int state;
+
+    // set if the job got canceled while the worker was compiling it
+    bool canceled;
+
+    struct jit_bg_job *next;
+};
+
+static washdc_mutex backend_lock = WASHDC_MUTEX_STATIC_INIT;
+
+static washdc_mutex queue_lock;
+static washdc_cvar queue_cvar;
+static washdc_thread worker;
+static bool running, quit;
+
+static struct jit_bg_job *queue_head, *queue_tail;
+
+/*
+ * jobs which were canceled while they were running.  The worker leaves them
+ * here when it's done with them, and the emulation thread frees them.
+ */
+static struct jit_bg_job *graveyard;
+
+static void free_job(struct jit_bg_job *job) {
+    if (washdc_atomic_int_load(&job->state) == JOB_DONE) {
+#if defined(ENABLE_JIT_X86_64)
+        code_block_x86_64_cleanup(&job->native);
+#elif defined(ENABLE_JIT_AARCH64)
+        code_block_aarch64_cleanup(&job->native);
+#endif
+    } else {
+        il_code_block_cleanup(&job->il_blk);
+    }
+    free(job);
+}
+
+static void reap_graveyard(void) {
+    washdc_mutex_lock(&queue_lock);
+    struct jit_bg_job *job = graveyard;
+    graveyard = NULL;
+    washdc_mutex_unlock(&queue_lock);
+
+    while (job) {
+        struct jit_bg_job *next = job->next;
+        free_job(job);
+        job = next;
+    }
+}
+
+static void compile_job(struct jit_bg_job *job) {
+    jit_bg_compile_lock();
+#if defined(ENABLE_JIT_X86_64)
+    code_block_x86_64_init(&job->native);
+    code_block_x86_64_compile(job->cpu, &job->native, &job->il_blk,
+                              job->meta, job->cycle_count);
+#elif defined(ENABLE_JIT_AARCH64)
+    code_block_aarch64_init(&job->native);
+    code_block_aarch64_compile(job->cpu, &job->native, &job->il_blk,
+                               job->meta, job->cycle_count);
+#endif
+    jit_bg_compile_unlock();
+
+    il_code_block_cleanup(&job->il_blk);
+}
+
+static void worker_main(void *argp) {
+    (void)argp;
+
+    washdc_thread_pin_self("jit compiler", config_get_jit_cpus());
+
+    // allocations out of the main lane would keep the emitter from growing
+    exec_mem_set_lane(EXEC_MEM_LANE_BG);
+
+    washdc_mutex_lock(&queue_lock);
+    for (;;) {
+        while (!quit && !queue_head)
+            washdc_cvar_wait(&queue_cvar, &queue_lock);
+        if (quit)
+            break;
+
+        struct jit_bg_job *job = queue_head;
+        queue_head = job->next;
+        if (!queue_head)
+            queue_tail = NULL;
+        job->next = NULL;
+        washdc_atomic_int_store(&job->state, JOB_RUNNING);
+        washdc_mutex_unlock(&queue_lock);
+
+        compile_job(job);
+
+        washdc_mutex_lock(&queue_lock);
+        washdc_atomic_int_store(&job->state, JOB_DONE);
+        if (job->canceled) {
+            job->next = graveyard;
+            graveyard = job;
+        }
+    }
+    washdc_mutex_unlock(&queue_lock);
+}
+
+void jit_bg_compile_init(void) {
+    if (running)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    washdc_mutex_init(&queue_lock);
+    washdc_cvar_init(&queue_cvar);
+    queue_head = queue_tail = NULL;
+    graveyard = NULL;
+    quit = false;
+    running = true;
+
+    washdc_thread_create(&worker, worker_main, NULL);
+    LOG_INFO("background jit compilation enabled\n");
+}
+
+/*
+ * The code cache has to be cleaned up before this gets called, since it owns
+ * every job that hasn't been finished or canceled.
+ */
+void jit_bg_compile_cleanup(void) {
+    if (!running)
+        return;
+
+    washdc_mutex_lock(&queue_lock);
+    quit = true;
+    washdc_cvar_signal(&queue_cvar);
+    washdc_mutex_unlock(&queue_lock);
+    washdc_thread_join(&worker);
+
+    if (queue_head)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    reap_graveyard();
+
+    washdc_cvar_cleanup(&queue_cvar);
+    washdc_mutex_cleanup(&queue_lock);
+    running = false;
+}
+
+bool jit_bg_compile_running(void) {
+    return running;
+}
+
+void jit_bg_compile_lock(void) {
+    washdc_mutex_lock(&backend_lock);
+}
+
+void jit_bg_compile_unlock(void) {
+    washdc_mutex_unlock(&backend_lock);
+}
+
+struct jit_bg_job *
+jit_bg_compile_submit(void *cpu, struct native_dispatch_meta const *meta,
+                      struct il_code_block *il_blk, unsigned cycle_count,
+                      uint32_t guest_pc) {
+    if (!running)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    reap_graveyard();
+
+    struct jit_bg_job *job = (struct jit_bg_job*)malloc(sizeof(*job));
+    if (!job)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    job->cpu = cpu;
+    job->meta = meta;
+    memcpy(&job->il_blk, il_blk, sizeof(job->il_blk));
+    job->cycle_count = cycle_count;
+    job->guest_pc = guest_pc;
+    washdc_atomic_int_init(&job->state, JOB_QUEUED);
+    job->canceled = false;
+    job->next = NULL;
+
+    washdc_mutex_lock(&queue_lock);
+    if (queue_tail)
+        queue_tail->next = job;
+    else
+        queue_head = job;
+    queue_tail = job;
+    washdc_cvar_signal(&queue_cvar);
+    washdc_mutex_unlock(&queue_lock);
+
+    return job;
+}
+
+bool jit_bg_compile_done(struct jit_bg_job *job) {
+    return washdc_atomic_int_load(&job->state) == JOB_DONE;
+}
+
+void jit_bg_compile_finish(struct jit_bg_job *job, struct jit_code_block *blk) {
+    if (!jit_bg_compile_done(job))
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+#if defined(ENABLE_JIT_X86_64)
+    struct code_block_x86_64 *native = &blk->x86_64;
+#elif defined(ENABLE_JIT_AARCH64)
+    struct code_block_aarch64 *native = &blk->aarch64;
+#endif
+    *native = job->native;
+
+    if (config_get_jit_perf_map()) {
+        ptrdiff_t wasted_bytes =
+            ((char*)native->native) - ((char*)native->exec_mem_alloc_start);
+        jit_perf_map_add(native->native, native->bytes_used - wasted_bytes,
+                         job->guest_pc);
+    }
+
+    free(job);
+    reap_graveyard();
+}
+
+void jit_bg_compile_cancel(struct jit_bg_job *job) {
+    washdc_mutex_lock(&queue_lock);
+    int state = washdc_atomic_int_load(&job->state);
+    if (state == JOB_RUNNING) {
+        // the worker will put it in the graveyard when it's done
+        job->canceled = true;
+        washdc_mutex_unlock(&queue_lock);
+        return;
+    }
+
+    if (state == JOB_QUEUED) {
+        struct jit_bg_job **prevp = &queue_head;
+        struct jit_bg_job *prev = NULL;
+        while (*prevp != job) {
+            prev = *prevp;
+            prevp = &prev->next;
+        }
+        *prevp = job->next;
+        if (queue_tail == job)
+            queue_tail = prev;
+    }
+    washdc_mutex_unlock(&queue_lock);
+
+    free_job(job);
+}
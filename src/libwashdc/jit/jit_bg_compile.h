@@ -0,0 +1,87 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * background compilation for the native jit.
+ *
+ * When a tiered block gets hot, the frontend translates it to il on the
+ * emulation thread and hands the il to jit_bg_compile_submit.  A worker thread
+ * runs the native backend on it while the block keeps running through the
+ * interpreter, and once the job is done the dispatcher swaps the native code
+ * in the next time it looks the block up.
+ *
+ * Only the backend runs on the worker.  The frontends read guest memory and
+ * CPU state, so they stay on the emulation thread.  The backends keep their
+ * state in globals, so anything which emits native code has to hold
+ * jit_bg_compile_lock while it does so, whether or not the worker is running.
+ *
+ * Everything other than the lock is only meant to be called from the
+ * emulation thread.
+ */
+
+#ifndef JIT_BG_COMPILE_H_
+#define JIT_BG_COMPILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef ENABLE_JIT_NATIVE
+#error this file should not be built when the native JIT is disabled
+#endif
+
+struct jit_bg_job;
+struct jit_code_block;
+struct il_code_block;
+struct native_dispatch_meta;
+
+void jit_bg_compile_init(void);
+void jit_bg_compile_cleanup(void);
+
+// true between jit_bg_compile_init and jit_bg_compile_cleanup
+bool jit_bg_compile_running(void);
+
+void jit_bg_compile_lock(void);
+void jit_bg_compile_unlock(void);
+
+/*
+ * queue il_blk up to be compiled.  This takes ownership of the il, so the
+ * caller must not call il_code_block_cleanup on it.  guest_pc is only used for
+ * the perf map.
+ */
+struct jit_bg_job *
+jit_bg_compile_submit(void *cpu, struct native_dispatch_meta const *meta,
+                      struct il_code_block *il_blk, unsigned cycle_count,
+                      uint32_t guest_pc);
+
+// true if the job's native code is ready for jit_bg_compile_finish
+bool jit_bg_compile_done(struct jit_bg_job *job);
+
+/*
+ * move a finished job's native code into blk and free the job.  Whatever
+ * native code blk held before must already have been cleaned up.
+ */
+void jit_bg_compile_finish(struct jit_bg_job *job, struct jit_code_block *blk);
+
+// throw a job away, whether or not the worker has gotten to it yet
+void jit_bg_compile_cancel(struct jit_bg_job *job);
+
+#endif
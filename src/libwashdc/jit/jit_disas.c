@@ -45,6 +45,15 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                immed->cset.dst_slot, immed->cset.flag_slot,
                                immed->cset.t_flag);
         break;
+    case JIT_OP_EXIT_COND:
+        washdc_hostfile_printf(out,
+                               "%02X: EXIT_COND %08X (%u cycles) IF "
+                               "(<SLOT %02X> & 1) == %u\n", idx,
+                               (unsigned)immed->exit_cond.addr,
+                               immed->exit_cond.cycle_count,
+                               immed->exit_cond.flag_slot,
+                               immed->exit_cond.t_flag);
+        break;
     case JIT_SET_SLOT:
         washdc_hostfile_printf(out, "%02X: SET %08X, <SLOT %02X>\n", idx,
                                (unsigned)immed->set_slot.new_val,
@@ -135,6 +144,29 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                idx, immed->write_float_slot.src_slot,
                                immed->write_float_slot.addr_slot);
         break;
+    case JIT_OP_READ_32_BLOCK:
+        washdc_hostfile_printf(out, "%02X: READ_32_BLOCK *(U32*)(<SLOT %02X> "
+                               "+ %d), %u words, stride %d:", idx,
+                               immed->read_32_block.addr_slot,
+                               immed->read_32_block.first,
+                               immed->read_32_block.n_words,
+                               immed->read_32_block.stride);
+        for (unsigned word = 0; word < immed->read_32_block.n_words; word++)
+            washdc_hostfile_printf(out, " <SLOT %02X>",
+                                   immed->read_32_block.data_slot[word]);
+        washdc_hostfile_printf(out, "\n");
+        break;
+    case JIT_OP_WRITE_32_BLOCK:
+        washdc_hostfile_printf(out, "%02X: WRITE_32_BLOCK", idx);
+        for (unsigned word = 0; word < immed->write_32_block.n_words; word++)
+            washdc_hostfile_printf(out, " <SLOT %02X>",
+                                   immed->write_32_block.data_slot[word]);
+        washdc_hostfile_printf(out, ", *(U32*)(<SLOT %02X> + %d), "
+                               "stride %d\n",
+                               immed->write_32_block.addr_slot,
+                               immed->write_32_block.first,
+                               immed->write_32_block.stride);
+        break;
     case JIT_OP_LOAD_SLOT16:
         washdc_hostfile_printf(out, "%02X: LOAD_SLOT16 *(U16*)%p <SLOT %02X>\n",
                                idx, immed->load_slot16.src,
@@ -339,6 +371,47 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                "%02X: CLEAR_FLOAT <SLOT %02X>\n",
                                idx, immed->clear_float.slot_dst);
         break;
+    case JIT_OP_DIV_FLOAT:
+        washdc_hostfile_printf(out,
+                               "%02X: DIV_FLOAT <SLOT %02X>, <SLOT %02X>\n",
+                               idx, immed->div_float.slot_src,
+                               immed->div_float.slot_dst);
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        washdc_hostfile_printf(out,
+                               "%02X: SQRT_FLOAT <SLOT %02X>\n",
+                               idx, immed->sqrt_float.slot_dst);
+        break;
+    case JIT_OP_MUL_S32_WIDE:
+        washdc_hostfile_printf(out, "%02X: MUL_S32_WIDE <SLOT %02X>, "
+                               "<SLOT %02X>, <SLOT %02X>:<SLOT %02X>\n",
+                               idx, immed->mul_s32_wide.slot_lhs,
+                               immed->mul_s32_wide.slot_rhs,
+                               immed->mul_s32_wide.slot_hi,
+                               immed->mul_s32_wide.slot_lo);
+        break;
+    case JIT_OP_MUL_U32_WIDE:
+        washdc_hostfile_printf(out, "%02X: MUL_U32_WIDE <SLOT %02X>, "
+                               "<SLOT %02X>, <SLOT %02X>:<SLOT %02X>\n",
+                               idx, immed->mul_u32_wide.slot_lhs,
+                               immed->mul_u32_wide.slot_rhs,
+                               immed->mul_u32_wide.slot_hi,
+                               immed->mul_u32_wide.slot_lo);
+        break;
+    case JIT_OP_MACL:
+        washdc_hostfile_printf(out, "%02X: MACL <SLOT %02X>, <SLOT %02X>, "
+                               "<SLOT %02X>:<SLOT %02X>, SAT <SLOT %02X>\n",
+                               idx, immed->macl.slot_lhs, immed->macl.slot_rhs,
+                               immed->macl.slot_hi, immed->macl.slot_lo,
+                               immed->macl.slot_sat);
+        break;
+    case JIT_OP_MACW:
+        washdc_hostfile_printf(out, "%02X: MACW <SLOT %02X>, <SLOT %02X>, "
+                               "<SLOT %02X>:<SLOT %02X>, SAT <SLOT %02X>\n",
+                               idx, immed->macw.slot_lhs, immed->macw.slot_rhs,
+                               immed->macw.slot_hi, immed->macw.slot_lo,
+                               immed->macw.slot_sat);
+        break;
     case JIT_OP_DISCARD_SLOT:
         washdc_hostfile_printf(out, "%02X: DISCARD_SLOT <SLOT %02X>\n", idx,
                                immed->discard_slot.slot_no);
@@ -52,6 +52,32 @@ void jit_jump(struct il_code_block *block, unsigned jmp_addr_slot,
     op.op = JIT_OP_JUMP;
     op.immed.jump.jmp_addr_slot = jmp_addr_slot;
     op.immed.jump.jmp_hash_slot = jmp_hash_slot;
+    op.immed.jump.n_static_targets = 0;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_jump_static(struct il_code_block *block, unsigned jmp_addr_slot,
+                     unsigned jmp_hash_slot, unsigned n_targets,
+                     uint32_t const *addrs, jit_hash const *hashes) {
+    struct jit_inst op;
+
+    check_slot(block, jmp_addr_slot, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, jmp_hash_slot, WASHDC_JIT_SLOT_GEN);
+
+    if (!n_targets || n_targets > JIT_JUMP_MAX_STATIC_TARGETS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+
+    op.op = JIT_OP_JUMP;
+    op.immed.jump.jmp_addr_slot = jmp_addr_slot;
+    op.immed.jump.jmp_hash_slot = jmp_hash_slot;
+    op.immed.jump.n_static_targets = n_targets;
+
+    unsigned idx;
+    for (idx = 0; idx < n_targets; idx++) {
+        op.immed.jump.static_addr[idx] = addrs[idx];
+        op.immed.jump.static_hash[idx] = hashes[idx];
+    }
 
     il_code_block_push_inst(block, &op);
 }
@@ -72,6 +98,23 @@ void jit_cset(struct il_code_block *block, unsigned flag_slot,
     il_code_block_push_inst(block, &op);
 }
 
+void jit_exit_cond(struct il_code_block *block, unsigned flag_slot,
+                   unsigned t_flag, uint32_t addr, jit_hash hash,
+                   unsigned cycle_count) {
+    struct jit_inst op;
+
+    check_slot(block, flag_slot, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_EXIT_COND;
+    op.immed.exit_cond.flag_slot = flag_slot;
+    op.immed.exit_cond.t_flag = t_flag;
+    op.immed.exit_cond.addr = addr;
+    op.immed.exit_cond.hash = hash;
+    op.immed.exit_cond.cycle_count = cycle_count;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_set_slot(struct il_code_block *block, unsigned slot_idx,
                   uint32_t new_val) {
     struct jit_inst op;
@@ -292,6 +335,63 @@ void jit_write_float_slot(struct il_code_block *block, struct memory_map *map,
     il_code_block_push_inst(block, &op);
 }
 
+int jit_mem_block_32_lo(struct mem_block_32_immed const *immed) {
+    if (immed->stride > 0)
+        return immed->first;
+    return immed->first + immed->stride * (int)(immed->n_words - 1);
+}
+
+static void
+jit_mem_block_32(struct il_code_block *block, enum jit_opcode opcode,
+                 struct memory_map *map, unsigned addr_slot, int first,
+                 int stride, unsigned n_words, unsigned const *data_slots) {
+    struct jit_inst op;
+
+    if (n_words < 1 || n_words > JIT_BLOCK_MAX_WORDS ||
+        (stride != 4 && stride != -4))
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+
+    check_slot(block, addr_slot, WASHDC_JIT_SLOT_GEN);
+
+    op.op = opcode;
+    op.immed.read_32_block.map = map;
+    op.immed.read_32_block.addr_slot = addr_slot;
+    op.immed.read_32_block.first = first;
+    op.immed.read_32_block.stride = stride;
+    op.immed.read_32_block.n_words = n_words;
+
+    unsigned idx;
+    for (idx = 0; idx < n_words; idx++) {
+        check_slot(block, data_slots[idx], WASHDC_JIT_SLOT_GEN);
+        op.immed.read_32_block.data_slot[idx] = data_slots[idx];
+    }
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_read_32_block(struct il_code_block *block, struct memory_map *map,
+                       unsigned addr_slot, int first, int stride,
+                       unsigned n_words, unsigned const *dst_slots) {
+    unsigned idx, other;
+    for (idx = 0; idx < n_words; idx++) {
+        if (dst_slots[idx] == addr_slot)
+            RAISE_ERROR(ERROR_INVALID_PARAM);
+        for (other = 0; other < idx; other++)
+            if (dst_slots[other] == dst_slots[idx])
+                RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    jit_mem_block_32(block, JIT_OP_READ_32_BLOCK, map, addr_slot,
+                     first, stride, n_words, dst_slots);
+}
+
+void jit_write_32_block(struct il_code_block *block, struct memory_map *map,
+                        unsigned addr_slot, int first, int stride,
+                        unsigned n_words, unsigned const *src_slots) {
+    jit_mem_block_32(block, JIT_OP_WRITE_32_BLOCK, map, addr_slot,
+                     first, stride, n_words, src_slots);
+}
+
 void jit_load_slot16(struct il_code_block *block, unsigned slot_no,
                      uint16_t const *src) {
     struct jit_inst op;
@@ -852,6 +952,156 @@ void jit_clear_float(struct il_code_block *block, unsigned slot_dst) {
     il_code_block_push_inst(block, &op);
 }
 
+void jit_div_float(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst) {
+    struct jit_inst op;
+
+    check_slot(block, slot_src, WASHDC_JIT_SLOT_FLOAT);
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_FLOAT);
+
+    op.op = JIT_OP_DIV_FLOAT;
+    op.immed.div_float.slot_src = slot_src;
+    op.immed.div_float.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_sqrt_float(struct il_code_block *block, unsigned slot_dst) {
+    struct jit_inst op;
+
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_FLOAT);
+
+    op.op = JIT_OP_SQRT_FLOAT;
+    op.immed.sqrt_float.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_mul_s32_wide(struct il_code_block *block, unsigned slot_lhs,
+                      unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo) {
+    struct jit_inst op;
+
+    check_slot(block, slot_lhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_rhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_hi, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_lo, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_MUL_S32_WIDE;
+    op.immed.mul_s32_wide.slot_lhs = slot_lhs;
+    op.immed.mul_s32_wide.slot_rhs = slot_rhs;
+    op.immed.mul_s32_wide.slot_hi = slot_hi;
+    op.immed.mul_s32_wide.slot_lo = slot_lo;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_mul_u32_wide(struct il_code_block *block, unsigned slot_lhs,
+                      unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo) {
+    struct jit_inst op;
+
+    check_slot(block, slot_lhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_rhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_hi, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_lo, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_MUL_U32_WIDE;
+    op.immed.mul_u32_wide.slot_lhs = slot_lhs;
+    op.immed.mul_u32_wide.slot_rhs = slot_rhs;
+    op.immed.mul_u32_wide.slot_hi = slot_hi;
+    op.immed.mul_u32_wide.slot_lo = slot_lo;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_macl(struct il_code_block *block, unsigned slot_lhs,
+              unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo,
+              unsigned slot_sat) {
+    struct jit_inst op;
+
+    check_slot(block, slot_lhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_rhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_hi, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_lo, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_sat, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_MACL;
+    op.immed.macl.slot_lhs = slot_lhs;
+    op.immed.macl.slot_rhs = slot_rhs;
+    op.immed.macl.slot_hi = slot_hi;
+    op.immed.macl.slot_lo = slot_lo;
+    op.immed.macl.slot_sat = slot_sat;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_macw(struct il_code_block *block, unsigned slot_lhs,
+              unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo,
+              unsigned slot_sat) {
+    struct jit_inst op;
+
+    check_slot(block, slot_lhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_rhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_hi, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_lo, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_sat, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_MACW;
+    op.immed.macw.slot_lhs = slot_lhs;
+    op.immed.macw.slot_rhs = slot_rhs;
+    op.immed.macw.slot_hi = slot_hi;
+    op.immed.macw.slot_lo = slot_lo;
+    op.immed.macw.slot_sat = slot_sat;
+
+    il_code_block_push_inst(block, &op);
+}
+
+uint64_t jit_macl_accum(uint64_t mac, uint32_t lhs, uint32_t rhs,
+                        uint32_t sat) {
+    static const int64_t MAX48 = 0x7fffffffffff;
+    static const int64_t MIN48 = -0x800000000000;
+
+    int64_t product = (int64_t)(int32_t)lhs * (int64_t)(int32_t)rhs;
+    int64_t sum = (int64_t)(mac + (uint64_t)product);
+
+    if (sat) {
+        int64_t mac_signed = (int64_t)mac;
+        if (sum < 0) {
+            if (mac_signed >= 0 && product >= 0)
+                sum = MAX48; // overflow positive to negative
+            else if (sum < MIN48)
+                sum = MIN48;
+        } else {
+            if (mac_signed < 0 && product < 0)
+                sum = MIN48; // overflow negative to positive
+            else if (sum > MAX48)
+                sum = MAX48;
+        }
+    }
+
+    return (uint64_t)sum;
+}
+
+uint64_t jit_macw_accum(uint64_t mac, uint32_t lhs, uint32_t rhs,
+                        uint32_t sat) {
+    int64_t product = (int64_t)(int16_t)lhs * (int64_t)(int16_t)rhs;
+
+    if (!sat)
+        return mac + (uint64_t)product;
+
+    // saturation only applies to MACL, see sh4_inst_binary_macw_indgeninc_indgeninc
+    uint32_t mach = mac >> 32;
+    int64_t sum = product + (int64_t)(uint32_t)mac;
+    if (sum < INT32_MIN) {
+        sum = INT32_MIN;
+        mach |= 1;
+    } else if (sum > INT32_MAX) {
+        sum = INT32_MAX;
+        mach |= 1;
+    }
+
+    return (((uint64_t)mach) << 32) | (uint32_t)sum;
+}
+
 void jit_inst_get_read_slots(struct jit_inst const *inst,
                              int read_slots[JIT_IL_MAX_READ_SLOTS]) {
     for (int idx = 0; idx < JIT_IL_MAX_READ_SLOTS; idx++)
@@ -869,6 +1119,9 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
         read_slots[0] = immed->cset.flag_slot;
         read_slots[1] = immed->cset.dst_slot;
         break;
+    case JIT_OP_EXIT_COND:
+        read_slots[0] = immed->exit_cond.flag_slot;
+        break;
     case JIT_SET_SLOT:
         break;
     case JIT_SET_SLOT_HOST_PTR:
@@ -916,6 +1169,14 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
         read_slots[0] = immed->write_float_slot.addr_slot;
         read_slots[1] = immed->write_float_slot.src_slot;
         break;
+    case JIT_OP_READ_32_BLOCK:
+        read_slots[0] = immed->read_32_block.addr_slot;
+        break;
+    case JIT_OP_WRITE_32_BLOCK:
+        read_slots[0] = immed->write_32_block.addr_slot;
+        for (unsigned idx = 0; idx < immed->write_32_block.n_words; idx++)
+            read_slots[idx + 1] = immed->write_32_block.data_slot[idx];
+        break;
     case JIT_OP_LOAD_SLOT16:
         break;
     case JIT_OP_LOAD_SLOT:
@@ -1057,6 +1318,35 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
         break;
     case JIT_OP_CLEAR_FLOAT:
         break;
+    case JIT_OP_DIV_FLOAT:
+        read_slots[0] = immed->div_float.slot_src;
+        read_slots[1] = immed->div_float.slot_dst;
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        read_slots[0] = immed->sqrt_float.slot_dst;
+        break;
+    case JIT_OP_MUL_S32_WIDE:
+        read_slots[0] = immed->mul_s32_wide.slot_lhs;
+        read_slots[1] = immed->mul_s32_wide.slot_rhs;
+        break;
+    case JIT_OP_MUL_U32_WIDE:
+        read_slots[0] = immed->mul_u32_wide.slot_lhs;
+        read_slots[1] = immed->mul_u32_wide.slot_rhs;
+        break;
+    case JIT_OP_MACL:
+        read_slots[0] = immed->macl.slot_lhs;
+        read_slots[1] = immed->macl.slot_rhs;
+        read_slots[2] = immed->macl.slot_hi;
+        read_slots[3] = immed->macl.slot_lo;
+        read_slots[4] = immed->macl.slot_sat;
+        break;
+    case JIT_OP_MACW:
+        read_slots[0] = immed->macw.slot_lhs;
+        read_slots[1] = immed->macw.slot_rhs;
+        read_slots[2] = immed->macw.slot_hi;
+        read_slots[3] = immed->macw.slot_lo;
+        read_slots[4] = immed->macw.slot_sat;
+        break;
     default:
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
@@ -1087,6 +1377,8 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
     case JIT_CSET:
         write_slots[0] = immed->cset.dst_slot;
         break;
+    case JIT_OP_EXIT_COND:
+        break;
     case JIT_SET_SLOT:
         write_slots[0] = immed->set_slot.slot_idx;
         break;
@@ -1129,6 +1421,12 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
         break;
     case JIT_OP_WRITE_FLOAT_SLOT:
         break;
+    case JIT_OP_READ_32_BLOCK:
+        for (unsigned idx = 0; idx < immed->read_32_block.n_words; idx++)
+            write_slots[idx] = immed->read_32_block.data_slot[idx];
+        break;
+    case JIT_OP_WRITE_32_BLOCK:
+        break;
     case JIT_OP_LOAD_SLOT16:
         write_slots[0] = immed->load_slot16.slot_no;
         break;
@@ -1244,6 +1542,28 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
     case JIT_OP_CLEAR_FLOAT:
         write_slots[0] = immed->clear_float.slot_dst;
         break;
+    case JIT_OP_DIV_FLOAT:
+        write_slots[0] = immed->div_float.slot_dst;
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        write_slots[0] = immed->sqrt_float.slot_dst;
+        break;
+    case JIT_OP_MUL_S32_WIDE:
+        write_slots[0] = immed->mul_s32_wide.slot_hi;
+        write_slots[1] = immed->mul_s32_wide.slot_lo;
+        break;
+    case JIT_OP_MUL_U32_WIDE:
+        write_slots[0] = immed->mul_u32_wide.slot_hi;
+        write_slots[1] = immed->mul_u32_wide.slot_lo;
+        break;
+    case JIT_OP_MACL:
+        write_slots[0] = immed->macl.slot_hi;
+        write_slots[1] = immed->macl.slot_lo;
+        break;
+    case JIT_OP_MACW:
+        write_slots[0] = immed->macw.slot_hi;
+        write_slots[1] = immed->macw.slot_lo;
+        break;
     default:
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
@@ -28,6 +28,7 @@
 #include "washdc/cpu.h"
 #include "washdc/types.h"
 #include "washdc/MemoryMap.h"
+#include "defs.h"
 
 /*
  * Defines the number of slots available to IL programs.
@@ -46,6 +47,13 @@ enum jit_opcode {
     // conditionally set based on flag
     JIT_CSET,
 
+    /*
+     * conditionally leave the block based on flag.  This is a side-exit; the
+     * block keeps going if the condition isn't met, and it still needs to end
+     * with a JIT_OP_JUMP.
+     */
+    JIT_OP_EXIT_COND,
+
     // this will set a register to the given constant value
     JIT_SET_SLOT,
 
@@ -117,6 +125,18 @@ enum jit_opcode {
      */
     JIT_OP_WRITE_FLOAT_SLOT,
 
+    /*
+     * read several consecutive 32-bit ints from memory at an address
+     * contained in a slot into several slots
+     */
+    JIT_OP_READ_32_BLOCK,
+
+    /*
+     * write several 32-bit ints contained in slots to consecutive words in
+     * memory at an address contained in a slot
+     */
+    JIT_OP_WRITE_32_BLOCK,
+
     /*
      * load 16-bits from a host memory address into a jit register
      * upper 16-bits should be zero-extended.
@@ -240,6 +260,34 @@ enum jit_opcode {
     // set a floating-point slot to 0.0f
     JIT_OP_CLEAR_FLOAT,
 
+    // divide one 32-bit floating point slot by another
+    JIT_OP_DIV_FLOAT,
+
+    // replace a 32-bit floating point slot with its square root
+    JIT_OP_SQRT_FLOAT,
+
+    /*
+     * multiply two signed (or unsigned) 32-bit slots together and place the
+     * upper 32 bits of the 64-bit product in slot_hi and the lower 32 bits
+     * in slot_lo.
+     */
+    JIT_OP_MUL_S32_WIDE,
+    JIT_OP_MUL_U32_WIDE,
+
+    /*
+     * SH4 MAC.L accumulate: slot_hi:slot_lo += (s32)slot_lhs * (s32)slot_rhs.
+     * If slot_sat is nonzero the sum saturates to 48 bits.
+     */
+    JIT_OP_MACL,
+
+    /*
+     * SH4 MAC.W accumulate: like JIT_OP_MACL but the operands are the signed
+     * low 16 bits of slot_lhs and slot_rhs.  If slot_sat is nonzero only
+     * slot_lo accumulates, saturating to 32 bits and setting bit 0 of slot_hi
+     * on overflow.
+     */
+    JIT_OP_MACW,
+
     /*
      * This tells the backend that a given slot is no longer needed and its
      * value does not need to be preserved.
@@ -252,12 +300,25 @@ struct jit_fallback_immed {
     cpu_inst_param inst;
 };
 
+#define JIT_JUMP_MAX_STATIC_TARGETS 2
+
 struct jump_immed {
     // this should point to the slot where the jump address is stored
     unsigned jmp_addr_slot;
 
     // this should point to the slot where the jump hash is stored
     unsigned jmp_hash_slot;
+
+    /*
+     * if n_static_targets is non-zero, then the jump address is guaranteed to
+     * be one of the first n_static_targets values in static_addr, and the jump
+     * hash will be the corresponding value in static_hash.  Backends can use
+     * this to link blocks directly to each other.  The slots still need to be
+     * filled in either way.
+     */
+    unsigned n_static_targets;
+    uint32_t static_addr[JIT_JUMP_MAX_STATIC_TARGETS];
+    jit_hash static_hash[JIT_JUMP_MAX_STATIC_TARGETS];
 };
 
 struct cset_immed {
@@ -267,6 +328,17 @@ struct cset_immed {
     unsigned dst_slot;
 };
 
+struct exit_cond_immed {
+    unsigned flag_slot, t_flag;
+
+    // where to go if ((flag_slot & 1) == t_flag)
+    uint32_t addr;
+    jit_hash hash;
+
+    // the number of cycles the block takes when it leaves through this exit
+    unsigned cycle_count;
+};
+
 struct set_slot_immed {
     unsigned slot_idx;
     uint32_t new_val;
@@ -355,6 +427,24 @@ struct write_float_slot_immed {
     unsigned addr_slot;
 };
 
+/*
+ * a run of 32-bit accesses to memory.  Word idx is at the address in
+ * addr_slot plus (first + idx * stride), and stride is either 4 or -4.  The
+ * words are accessed in order; for reads, none of the data slots may be
+ * addr_slot or each other.
+ */
+#define JIT_BLOCK_MAX_WORDS 4
+struct mem_block_32_immed {
+    struct memory_map *map;
+    unsigned addr_slot;
+    int first, stride;
+    unsigned n_words;
+    unsigned data_slot[JIT_BLOCK_MAX_WORDS];
+};
+
+// offset from the address in addr_slot to the lowest word of the block
+int jit_mem_block_32_lo(struct mem_block_32_immed const *immed);
+
 struct load_slot16_immed {
     uint16_t const *src;
     unsigned slot_no;
@@ -556,14 +646,34 @@ struct mul_float_immed {
     unsigned slot_lhs, slot_dst;
 };
 
+struct mul_wide_immed {
+    unsigned slot_lhs, slot_rhs;
+    unsigned slot_hi, slot_lo;
+};
+
+struct mac_immed {
+    unsigned slot_lhs, slot_rhs;
+    unsigned slot_hi, slot_lo;
+    unsigned slot_sat;
+};
+
 struct clear_float_immed {
     unsigned slot_dst;
 };
 
+struct div_float_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct sqrt_float_immed {
+    unsigned slot_dst;
+};
+
 union jit_immed {
     struct jit_fallback_immed fallback;
     struct jump_immed jump;
     struct cset_immed cset;
+    struct exit_cond_immed exit_cond;
     struct set_slot_immed set_slot;
     struct set_slot_host_ptr_immed set_slot_host_ptr;
     struct call_func_immed call_func;
@@ -580,6 +690,8 @@ union jit_immed {
     struct write_16_slot_immed write_16_slot;
     struct write_32_slot_immed write_32_slot;
     struct write_float_slot_immed write_float_slot;
+    struct mem_block_32_immed read_32_block;
+    struct mem_block_32_immed write_32_block;
     struct load_slot16_immed load_slot16;
     struct load_slot_immed load_slot;
     struct load_slot_offset_immed load_slot_offset;
@@ -620,6 +732,12 @@ union jit_immed {
     struct mul_u32_immed mul_u32;
     struct mul_float_immed mul_float;
     struct clear_float_immed clear_float;
+    struct div_float_immed div_float;
+    struct sqrt_float_immed sqrt_float;
+    struct mul_wide_immed mul_s32_wide;
+    struct mul_wide_immed mul_u32_wide;
+    struct mac_immed macl;
+    struct mac_immed macw;
 };
 
 struct jit_inst {
@@ -635,13 +753,13 @@ void jit_sanity_checks(struct jit_inst const *inst_list, unsigned n_insts);
 #endif
 
 // return true if the instruction reads from the given slot, else return false
-#define JIT_IL_MAX_READ_SLOTS 3
+#define JIT_IL_MAX_READ_SLOTS 5
 void jit_inst_get_read_slots(struct jit_inst const *inst,
                              int read_slots[JIT_IL_MAX_READ_SLOTS]);
 bool jit_inst_is_read_slot(struct jit_inst const *inst, unsigned slot_no);
 
 // return true if the instruction writes to the given slot, else return false
-#define JIT_IL_MAX_WRITE_SLOTS 3
+#define JIT_IL_MAX_WRITE_SLOTS 4
 void jit_inst_get_write_slots(struct jit_inst const *inst,
                               int write_slots[JIT_IL_MAX_WRITE_SLOTS]);
 bool jit_inst_is_write_slot(struct jit_inst const *inst, unsigned slot_no);
@@ -649,8 +767,14 @@ bool jit_inst_is_write_slot(struct jit_inst const *inst, unsigned slot_no);
 void jit_fallback(struct il_code_block *block,
                   void(*fallback_fn)(void*,cpu_inst_param), cpu_inst_param inst);
 void jit_jump(struct il_code_block *block, unsigned jmp_addr_slot, unsigned jmp_hash_slot);
+void jit_jump_static(struct il_code_block *block, unsigned jmp_addr_slot,
+                     unsigned jmp_hash_slot, unsigned n_targets,
+                     uint32_t const *addrs, jit_hash const *hashes);
 void jit_cset(struct il_code_block *block, unsigned flag_slot,
               unsigned t_flag, uint32_t src_val, unsigned dst_slot);
+void jit_exit_cond(struct il_code_block *block, unsigned flag_slot,
+                   unsigned t_flag, uint32_t addr, jit_hash hash,
+                   unsigned cycle_count);
 void jit_set_slot(struct il_code_block *block, unsigned slot_idx,
                   uint32_t new_val);
 void jit_set_slot_host_ptr(struct il_code_block *block, unsigned slot_idx,
@@ -681,6 +805,12 @@ void jit_write_32_slot(struct il_code_block *block, struct memory_map *map,
                        unsigned src_slot, unsigned addr_slot);
 void jit_write_float_slot(struct il_code_block *block, struct memory_map *map,
                           unsigned src_slot, unsigned addr_slot);
+void jit_read_32_block(struct il_code_block *block, struct memory_map *map,
+                       unsigned addr_slot, int first, int stride,
+                       unsigned n_words, unsigned const *dst_slots);
+void jit_write_32_block(struct il_code_block *block, struct memory_map *map,
+                        unsigned addr_slot, int first, int stride,
+                        unsigned n_words, unsigned const *src_slots);
 void jit_load_slot(struct il_code_block *block, unsigned slot_no,
                    uint32_t const *src);
 void jit_load_slot_offset(struct il_code_block *block, unsigned slot_base,
@@ -758,5 +888,28 @@ void jit_mul_u32(struct il_code_block *block, unsigned slot_lhs,
 void jit_mul_float(struct il_code_block *block, unsigned slot_lhs,
                    unsigned slot_dst);
 void jit_clear_float(struct il_code_block *block, unsigned slot_dst);
+void jit_div_float(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst);
+void jit_sqrt_float(struct il_code_block *block, unsigned slot_dst);
+void jit_mul_s32_wide(struct il_code_block *block, unsigned slot_lhs,
+                      unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo);
+void jit_mul_u32_wide(struct il_code_block *block, unsigned slot_lhs,
+                      unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo);
+void jit_macl(struct il_code_block *block, unsigned slot_lhs,
+              unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo,
+              unsigned slot_sat);
+void jit_macw(struct il_code_block *block, unsigned slot_lhs,
+              unsigned slot_rhs, unsigned slot_hi, unsigned slot_lo,
+              unsigned slot_sat);
+
+/*
+ * the arithmetic behind JIT_OP_MACL and JIT_OP_MACW.  mac is slot_hi:slot_lo
+ * and the return value is the new slot_hi:slot_lo.  These are shared by the
+ * backends so that the saturation logic only exists in one place.
+ */
+uint64_t jit_macl_accum(uint64_t mac, uint32_t lhs, uint32_t rhs,
+                        uint32_t sat);
+uint64_t jit_macw_accum(uint64_t mac, uint32_t lhs, uint32_t rhs,
+                        uint32_t sat);
 
 #endif
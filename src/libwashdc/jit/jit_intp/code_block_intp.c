@@ -20,6 +20,7 @@
  *
  ******************************************************************************/
 
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -58,10 +59,12 @@ void code_block_intp_compile(void *cpu,
     out->cycle_count = cycle_count;
     out->inst_count = inst_count;
     out->n_slots = il_blk->n_slots;
+    out->dyn_cycles = il_blk->dyn_cycles;
     out->slots = (union slot_val*)malloc(out->n_slots * sizeof(out->slots[0]));
 }
 
-reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
+reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block,
+                             unsigned *n_cycles) {
     unsigned inst_count = block->inst_count;
     struct jit_inst const* inst = block->inst_list;
 
@@ -72,7 +75,18 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
             inst++;
             break;
         case JIT_OP_JUMP:
+            *n_cycles = block->cycle_count;
+            if (block->dyn_cycles)
+                *n_cycles += *block->dyn_cycles;
             return block->slots[inst->immed.jump.jmp_addr_slot].as_u32;
+        case JIT_OP_EXIT_COND:
+            if ((block->slots[inst->immed.exit_cond.flag_slot].as_u32 & 1) ==
+                inst->immed.exit_cond.t_flag) {
+                *n_cycles = inst->immed.exit_cond.cycle_count;
+                return inst->immed.exit_cond.addr;
+            }
+            inst++;
+            break;
         case JIT_CSET:
             if ((block->slots[inst->immed.cset.flag_slot].as_u32 & 1) ==
                 inst->immed.cset.t_flag) {
@@ -181,6 +195,36 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
                                    block->slots[inst->immed.write_float_slot.src_slot].as_float);
             inst++;
             break;
+        case JIT_OP_READ_32_BLOCK:
+            {
+                struct mem_block_32_immed const *run =
+                    &inst->immed.read_32_block;
+                uint32_t addr = block->slots[run->addr_slot].as_u32 +
+                    run->first;
+                unsigned word;
+                for (word = 0; word < run->n_words; word++) {
+                    block->slots[run->data_slot[word]].as_u32 =
+                        memory_map_read_32(run->map, addr);
+                    addr += run->stride;
+                }
+            }
+            inst++;
+            break;
+        case JIT_OP_WRITE_32_BLOCK:
+            {
+                struct mem_block_32_immed const *run =
+                    &inst->immed.write_32_block;
+                uint32_t addr = block->slots[run->addr_slot].as_u32 +
+                    run->first;
+                unsigned word;
+                for (word = 0; word < run->n_words; word++) {
+                    memory_map_write_32(run->map, addr,
+                                        block->slots[run->data_slot[word]].as_u32);
+                    addr += run->stride;
+                }
+            }
+            inst++;
+            break;
         case JIT_OP_LOAD_SLOT16:
             block->slots[inst->immed.load_slot16.slot_no].as_u32 =
                 *inst->immed.load_slot16.src;
@@ -396,6 +440,67 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
             block->slots[inst->immed.clear_float.slot_dst].as_float = 0.0f;
             inst++;
             break;
+        case JIT_OP_DIV_FLOAT:
+            block->slots[inst->immed.div_float.slot_dst].as_float /=
+                block->slots[inst->immed.div_float.slot_src].as_float;
+            inst++;
+            break;
+        case JIT_OP_SQRT_FLOAT:
+            block->slots[inst->immed.sqrt_float.slot_dst].as_float =
+                sqrtf(block->slots[inst->immed.sqrt_float.slot_dst].as_float);
+            inst++;
+            break;
+        case JIT_OP_MUL_S32_WIDE:
+            {
+                int64_t res =
+                    (int64_t)(int32_t)block->slots[inst->immed.mul_s32_wide.slot_lhs].as_u32 *
+                    (int64_t)(int32_t)block->slots[inst->immed.mul_s32_wide.slot_rhs].as_u32;
+                block->slots[inst->immed.mul_s32_wide.slot_hi].as_u32 =
+                    ((uint64_t)res) >> 32;
+                block->slots[inst->immed.mul_s32_wide.slot_lo].as_u32 =
+                    (uint32_t)res;
+            }
+            inst++;
+            break;
+        case JIT_OP_MUL_U32_WIDE:
+            {
+                uint64_t res =
+                    (uint64_t)block->slots[inst->immed.mul_u32_wide.slot_lhs].as_u32 *
+                    (uint64_t)block->slots[inst->immed.mul_u32_wide.slot_rhs].as_u32;
+                block->slots[inst->immed.mul_u32_wide.slot_hi].as_u32 = res >> 32;
+                block->slots[inst->immed.mul_u32_wide.slot_lo].as_u32 =
+                    (uint32_t)res;
+            }
+            inst++;
+            break;
+        case JIT_OP_MACL:
+            {
+                struct mac_immed const *mac = &inst->immed.macl;
+                uint64_t res =
+                    jit_macl_accum((((uint64_t)block->slots[mac->slot_hi].as_u32) << 32) |
+                                   block->slots[mac->slot_lo].as_u32,
+                                   block->slots[mac->slot_lhs].as_u32,
+                                   block->slots[mac->slot_rhs].as_u32,
+                                   block->slots[mac->slot_sat].as_u32);
+                block->slots[mac->slot_hi].as_u32 = res >> 32;
+                block->slots[mac->slot_lo].as_u32 = (uint32_t)res;
+            }
+            inst++;
+            break;
+        case JIT_OP_MACW:
+            {
+                struct mac_immed const *mac = &inst->immed.macw;
+                uint64_t res =
+                    jit_macw_accum((((uint64_t)block->slots[mac->slot_hi].as_u32) << 32) |
+                                   block->slots[mac->slot_lo].as_u32,
+                                   block->slots[mac->slot_lhs].as_u32,
+                                   block->slots[mac->slot_rhs].as_u32,
+                                   block->slots[mac->slot_sat].as_u32);
+                block->slots[mac->slot_hi].as_u32 = res >> 32;
+                block->slots[mac->slot_lo].as_u32 = (uint32_t)res;
+            }
+            inst++;
+            break;
         case JIT_OP_SHAD:
             if ((int32_t)block->slots[inst->immed.shad.slot_shift_amt].as_u32 >= 0) {
                 block->slots[inst->immed.shad.slot_val].as_u32 <<=
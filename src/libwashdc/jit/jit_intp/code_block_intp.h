@@ -46,6 +46,9 @@ struct code_block_intp {
      */
     unsigned n_slots;
     union slot_val *slots;
+
+    // see il_code_block
+    uint32_t const *dyn_cycles;
 };
 
 void code_block_intp_init(struct code_block_intp *block);
@@ -56,6 +59,12 @@ void code_block_intp_compile(void *cpu,
                              struct il_code_block const *il_blk,
                              unsigned cycle_count);
 
-reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block);
+/*
+ * returns the new PC.  n_cycles is where the number of cycles the block took
+ * gets written, which can be less than cycle_count if it left early through a
+ * side-exit.
+ */
+reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block,
+                             unsigned *n_cycles);
 
 #endif
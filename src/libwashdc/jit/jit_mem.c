@@ -31,34 +31,22 @@
 
 #include "jit_mem.h"
 
-/*
- * TODO: this only returns the first MEMORY_MAP_REGION_RAM it finds.  Right now
- * that's not a problem because there's only one MEMORY_MAP_REGION_RAM, but in
- * the future it will be a problem if I make the AICA or PVR2 memory identify
- * themselves as MEMORY_MAP_REGION_RAM.
- */
-static struct memory_map_region *find_ram(struct memory_map *map) {
-    unsigned region_no;
-    for (region_no = 0; region_no < map->n_regions; region_no++) {
-        struct memory_map_region *region = map->regions + region_no;
-        if (region->id == MEMORY_MAP_REGION_RAM)
-            return region;
-    }
-    return NULL;
-}
-
 void jit_mem_read_constaddr_32(struct memory_map *map, struct il_code_block *block,
                                addr32_t addr, unsigned slot_no) {
-    struct memory_map_region *ram = find_ram(map);
+    struct memory_map_region *region = memory_map_get_region(map, addr, 4);
 
-    if (ram) {
-        addr32_t addr_first = addr & ram->range_mask;
-        addr32_t addr_last = (addr + 3) & ram->range_mask;
-
-        struct Memory *mem = (struct Memory*)ram->ctxt;
-        if (addr_first >= ram->first_addr && addr_last <= ram->last_addr) {
-            void *ptr = mem->mem + (addr & ram->mask);
-            jit_load_slot(block, slot_no, ptr);
+    if (region && region->id == MEMORY_MAP_REGION_RAM) {
+        struct Memory *mem = (struct Memory*)region->ctxt;
+        void *ptr = mem->mem + (addr & region->mask);
+        jit_load_slot(block, slot_no, ptr);
+        return;
+    } else if (region && region->id == MEMORY_MAP_REGION_ROM) {
+        // the value can never change, so read it now
+        uint32_t val;
+        if (region->intf->try_read32 &&
+            region->intf->try_read32(addr & region->mask,
+                                     &val, region->ctxt) == 0) {
+            jit_set_slot(block, slot_no, val);
             return;
         }
     }
@@ -68,16 +56,19 @@ void jit_mem_read_constaddr_32(struct memory_map *map, struct il_code_block *blo
 
 void jit_mem_read_constaddr_16(struct memory_map *map, struct il_code_block *block,
                                addr32_t addr, unsigned slot_no) {
-    struct memory_map_region *ram = find_ram(map);
-
-    if (ram) {
-        addr32_t addr_first = addr & ram->range_mask;
-        addr32_t addr_last = (addr + 3) & ram->range_mask;
+    struct memory_map_region *region = memory_map_get_region(map, addr, 2);
 
-        struct Memory *mem = (struct Memory*)ram->ctxt;
-        if (addr_first >= ram->first_addr && addr_last <= ram->last_addr) {
-            void *ptr = mem->mem + (addr & ram->mask);
-            jit_load_slot16(block, slot_no, ptr);
+    if (region && region->id == MEMORY_MAP_REGION_RAM) {
+        struct Memory *mem = (struct Memory*)region->ctxt;
+        void *ptr = mem->mem + (addr & region->mask);
+        jit_load_slot16(block, slot_no, ptr);
+        return;
+    } else if (region && region->id == MEMORY_MAP_REGION_ROM) {
+        uint16_t val;
+        if (region->intf->try_read16 &&
+            region->intf->try_read16(addr & region->mask,
+                                     &val, region->ctxt) == 0) {
+            jit_set_slot(block, slot_no, val);
             return;
         }
     }
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "log.h"
+
+#include "jit_perf_map.h"
+
+#define JIT_PERF_MAP_BUF_LEN (64 * 1024)
+
+static FILE *perf_map;
+
+void jit_perf_map_init(void) {
+#ifdef _WIN32
+    LOG_WARN("the jit perf map is not supported on Windows\n");
+#else
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%ld.map", (long)getpid());
+    path[sizeof(path) - 1] = '\0';
+
+    perf_map = fopen(path, "w");
+    if (!perf_map) {
+        LOG_ERROR("unable to open \"%s\" to write the jit perf map\n", path);
+        return;
+    }
+
+    /*
+     * perf only reads this after the run is over, so there's no reason to
+     * flush every line.  Anything left in the buffer gets written out by
+     * jit_perf_map_cleanup.
+     */
+    setvbuf(perf_map, NULL, _IOFBF, JIT_PERF_MAP_BUF_LEN);
+    LOG_INFO("writing jit perf map to \"%s\"\n", path);
+#endif
+}
+
+void jit_perf_map_cleanup(void) {
+    if (perf_map) {
+        fclose(perf_map);
+        perf_map = NULL;
+    }
+}
+
+void jit_perf_map_add(void const *native, size_t len, uint32_t guest_pc) {
+    if (!perf_map || !len)
+        return;
+
+    fprintf(perf_map, "%" PRIxPTR " %zx sh4_%08" PRIx32 "\n",
+            (uintptr_t)native, len, guest_pc);
+}
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * perf(1) symbol map for native jit code.
+ *
+ * perf can't see symbols for code that gets generated at runtime, so every
+ * native block would show up as an anonymous address inside the exec_mem
+ * arena.  perf (and other profilers which understand the same format) will
+ * instead look for /tmp/perf-<pid>.map, which has one "<start> <size> <name>"
+ * line per symbol with start and size in hex.  Blocks get recompiled into the
+ * same memory after they're invalidated, so a given address can show up more
+ * than once; the later line is the one that's current.
+ */
+
+#ifndef JIT_PERF_MAP_H_
+#define JIT_PERF_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+void jit_perf_map_init(void);
+void jit_perf_map_cleanup(void);
+
+// add a symbol named sh4_<guest_pc> covering len bytes of native code
+void jit_perf_map_add(void const *native, size_t len, uint32_t guest_pc);
+
+#endif
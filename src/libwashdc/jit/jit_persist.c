@@ -0,0 +1,570 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "log.h"
+#include "jit/jit_il.h"
+#include "jit/code_block.h"
+
+#include "jit_persist.h"
+
+#define JIT_PERSIST_MAGIC 0x54494a57 // "WJIT"
+#define JIT_PERSIST_VERSION 1
+
+#define JIT_PERSIST_N_OPS (JIT_OP_DISCARD_SLOT + 1)
+
+#define JIT_PERSIST_TBL_SHIFT 12
+#define JIT_PERSIST_TBL_LEN (1 << JIT_PERSIST_TBL_SHIFT)
+#define JIT_PERSIST_TBL_MASK (JIT_PERSIST_TBL_LEN - 1)
+
+struct persist_region {
+    char const *base;
+    size_t len;
+};
+
+static struct persist_region *regions;
+static unsigned n_regions, regions_alloc;
+
+static struct jit_persist_rec *rec_tbl[JIT_PERSIST_TBL_LEN];
+
+struct persist_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t inst_size;
+    uint32_t n_ops;
+    uint32_t n_regions;
+    uint32_t region_sig;
+    uint32_t flags;
+    uint32_t n_records;
+};
+
+static void free_rec(struct jit_persist_rec *rec);
+static void insert_rec(struct jit_persist_rec *rec);
+static uint32_t region_sig(void);
+static bool inst_get_ptr(struct jit_inst const *inst, void const **ptrp);
+static void inst_set_ptr(struct jit_inst *inst, void *ptr);
+static int read_rec(washdc_hostfile file, struct jit_persist_rec *rec);
+static int write_rec(washdc_hostfile file, struct jit_persist_rec const *rec);
+
+void jit_persist_init(void) {
+    regions = NULL;
+    n_regions = regions_alloc = 0;
+    memset(rec_tbl, 0, sizeof(rec_tbl));
+}
+
+void jit_persist_cleanup(void) {
+    unsigned idx;
+    for (idx = 0; idx < JIT_PERSIST_TBL_LEN; idx++) {
+        struct jit_persist_rec *rec = rec_tbl[idx];
+        while (rec) {
+            struct jit_persist_rec *next = rec->next;
+            free_rec(rec);
+            rec = next;
+        }
+        rec_tbl[idx] = NULL;
+    }
+
+    free(regions);
+    regions = NULL;
+    n_regions = regions_alloc = 0;
+}
+
+void jit_persist_register(void const *base, size_t len) {
+    if (n_regions >= regions_alloc) {
+        unsigned new_alloc = regions_alloc ? 2 * regions_alloc : 64;
+        struct persist_region *new_regions =
+            realloc(regions, new_alloc * sizeof(struct persist_region));
+        if (!new_regions)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        regions = new_regions;
+        regions_alloc = new_alloc;
+    }
+
+    regions[n_regions].base = (char const*)base;
+    regions[n_regions].len = len;
+    n_regions++;
+}
+
+static uint32_t region_sig(void) {
+    uint32_t sig = JIT_PERSIST_HASH_INIT;
+    unsigned idx;
+    for (idx = 0; idx < n_regions; idx++) {
+        uint32_t len = regions[idx].len;
+        sig = jit_persist_hash16(sig, len & 0xffff);
+        sig = jit_persist_hash16(sig, len >> 16);
+    }
+    return sig;
+}
+
+static int find_region(void const *ptr, uint32_t *region_out,
+                       uint32_t *offs_out) {
+    char const *cptr = (char const*)ptr;
+    unsigned idx;
+    for (idx = 0; idx < n_regions; idx++) {
+        struct persist_region const *region = regions + idx;
+        if (cptr >= region->base && cptr < region->base + region->len) {
+            *region_out = idx;
+            *offs_out = cptr - region->base;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+struct jit_persist_rec const *jit_persist_find(jit_hash hash) {
+    struct jit_persist_rec const *rec = rec_tbl[hash & JIT_PERSIST_TBL_MASK];
+    while (rec) {
+        if (rec->hash == hash)
+            return rec;
+        rec = rec->next;
+    }
+    return NULL;
+}
+
+static void insert_rec(struct jit_persist_rec *rec) {
+    struct jit_persist_rec **prev = rec_tbl + (rec->hash & JIT_PERSIST_TBL_MASK);
+    while (*prev) {
+        if ((*prev)->hash == rec->hash) {
+            struct jit_persist_rec *old = *prev;
+            rec->next = old->next;
+            *prev = rec;
+            free_rec(old);
+            return;
+        }
+        prev = &(*prev)->next;
+    }
+    rec->next = NULL;
+    *prev = rec;
+}
+
+static void free_rec(struct jit_persist_rec *rec) {
+    free(rec->slot_tp);
+    free(rec->inst_list);
+    free(rec->reloc_region);
+    free(rec->reloc_offs);
+    free(rec);
+}
+
+int jit_persist_restore(struct jit_persist_rec const *rec,
+                        struct il_code_block *il_blk) {
+    unsigned idx;
+
+    if (rec->n_slots > MAX_SLOTS)
+        return -1;
+
+    for (idx = 0; idx < rec->n_slots; idx++)
+        alloc_slot(il_blk, (enum washdc_jit_slot_tp)rec->slot_tp[idx]);
+
+    for (idx = 0; idx < rec->inst_count; idx++) {
+        struct jit_inst inst = rec->inst_list[idx];
+        uint32_t region_no = rec->reloc_region[idx];
+        if (region_no != JIT_PERSIST_NO_RELOC) {
+            struct persist_region const *region = regions + region_no;
+            inst_set_ptr(&inst, (void*)(region->base + rec->reloc_offs[idx]));
+        }
+        il_code_block_push_inst(il_blk, &inst);
+    }
+
+    return 0;
+}
+
+int jit_persist_store(jit_hash hash, uint32_t src_hash, unsigned n_bytes,
+                      unsigned cycle_count, struct il_code_block const *il_blk) {
+    unsigned idx;
+    unsigned inst_count = il_blk->inst_count;
+    struct jit_persist_rec *rec = calloc(1, sizeof(struct jit_persist_rec));
+    if (!rec)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    rec->hash = hash;
+    rec->src_hash = src_hash;
+    rec->n_bytes = n_bytes;
+    rec->cycle_count = cycle_count;
+    rec->n_slots = il_blk->n_slots;
+    rec->inst_count = inst_count;
+
+    rec->slot_tp = malloc((rec->n_slots ? rec->n_slots : 1) * sizeof(uint32_t));
+    rec->inst_list = malloc((inst_count ? inst_count : 1) *
+                            sizeof(struct jit_inst));
+    rec->reloc_region = malloc((inst_count ? inst_count : 1) * sizeof(uint32_t));
+    rec->reloc_offs = malloc((inst_count ? inst_count : 1) * sizeof(uint32_t));
+    if (!rec->slot_tp || !rec->inst_list ||
+        !rec->reloc_region || !rec->reloc_offs)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    for (idx = 0; idx < rec->n_slots; idx++)
+        rec->slot_tp[idx] = il_blk->slots[idx].tp;
+
+    for (idx = 0; idx < inst_count; idx++) {
+        struct jit_inst *inst = rec->inst_list + idx;
+        void const *ptr;
+
+        *inst = il_blk->inst_list[idx];
+
+        if (inst_get_ptr(inst, &ptr)) {
+            if (find_region(ptr, rec->reloc_region + idx,
+                            rec->reloc_offs + idx) != 0) {
+                free_rec(rec);
+                return -1;
+            }
+            inst_set_ptr(inst, NULL);
+        } else {
+            rec->reloc_region[idx] = JIT_PERSIST_NO_RELOC;
+            rec->reloc_offs[idx] = 0;
+        }
+    }
+
+    insert_rec(rec);
+    return 0;
+}
+
+/*
+ * retrieve the host pointer (if any) from an instruction.  Returns false if
+ * the instruction doesn't have one.
+ */
+static bool inst_get_ptr(struct jit_inst const *inst, void const **ptrp) {
+    union jit_immed const *immed = &inst->immed;
+
+    switch (inst->op) {
+    case JIT_OP_FALLBACK:
+        *ptrp = (void const*)immed->fallback.fallback_fn;
+        return true;
+    case JIT_OP_CALL_FUNC:
+        *ptrp = (void const*)immed->call_func.func;
+        return true;
+    case JIT_OP_CALL_FUNC_IMM32:
+        *ptrp = (void const*)immed->call_func_imm32.func;
+        return true;
+    case JIT_SET_SLOT_HOST_PTR:
+        *ptrp = immed->set_slot_host_ptr.ptr;
+        return true;
+    case JIT_OP_READ_16_CONSTADDR:
+        *ptrp = immed->read_16_constaddr.map;
+        return true;
+    case JIT_OP_READ_32_CONSTADDR:
+        *ptrp = immed->read_32_constaddr.map;
+        return true;
+    case JIT_OP_READ_8_SLOT:
+        *ptrp = immed->read_8_slot.map;
+        return true;
+    case JIT_OP_READ_16_SLOT:
+        *ptrp = immed->read_16_slot.map;
+        return true;
+    case JIT_OP_READ_32_SLOT:
+        *ptrp = immed->read_32_slot.map;
+        return true;
+    case JIT_OP_READ_FLOAT_SLOT:
+        *ptrp = immed->read_float_slot.map;
+        return true;
+    case JIT_OP_WRITE_8_SLOT:
+        *ptrp = immed->write_8_slot.map;
+        return true;
+    case JIT_OP_WRITE_16_SLOT:
+        *ptrp = immed->write_16_slot.map;
+        return true;
+    case JIT_OP_WRITE_32_SLOT:
+        *ptrp = immed->write_32_slot.map;
+        return true;
+    case JIT_OP_WRITE_FLOAT_SLOT:
+        *ptrp = immed->write_float_slot.map;
+        return true;
+    case JIT_OP_READ_32_BLOCK:
+        *ptrp = immed->read_32_block.map;
+        return true;
+    case JIT_OP_WRITE_32_BLOCK:
+        *ptrp = immed->write_32_block.map;
+        return true;
+    case JIT_OP_LOAD_SLOT16:
+        *ptrp = immed->load_slot16.src;
+        return true;
+    case JIT_OP_LOAD_SLOT:
+        *ptrp = immed->load_slot.src;
+        return true;
+    case JIT_OP_LOAD_FLOAT_SLOT:
+        *ptrp = immed->load_float_slot.src;
+        return true;
+    case JIT_OP_STORE_SLOT:
+        *ptrp = immed->store_slot.dst;
+        return true;
+    case JIT_OP_STORE_FLOAT_SLOT:
+        *ptrp = immed->store_float_slot.dst;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void inst_set_ptr(struct jit_inst *inst, void *ptr) {
+    union jit_immed *immed = &inst->immed;
+
+    switch (inst->op) {
+    case JIT_OP_FALLBACK:
+        immed->fallback.fallback_fn = (void(*)(void*,cpu_inst_param))ptr;
+        break;
+    case JIT_OP_CALL_FUNC:
+        immed->call_func.func = (void(*)(void*,uint32_t))ptr;
+        break;
+    case JIT_OP_CALL_FUNC_IMM32:
+        immed->call_func_imm32.func = (void(*)(void*,uint32_t))ptr;
+        break;
+    case JIT_SET_SLOT_HOST_PTR:
+        immed->set_slot_host_ptr.ptr = ptr;
+        break;
+    case JIT_OP_READ_16_CONSTADDR:
+        immed->read_16_constaddr.map = ptr;
+        break;
+    case JIT_OP_READ_32_CONSTADDR:
+        immed->read_32_constaddr.map = ptr;
+        break;
+    case JIT_OP_READ_8_SLOT:
+        immed->read_8_slot.map = ptr;
+        break;
+    case JIT_OP_READ_16_SLOT:
+        immed->read_16_slot.map = ptr;
+        break;
+    case JIT_OP_READ_32_SLOT:
+        immed->read_32_slot.map = ptr;
+        break;
+    case JIT_OP_READ_FLOAT_SLOT:
+        immed->read_float_slot.map = ptr;
+        break;
+    case JIT_OP_WRITE_8_SLOT:
+        immed->write_8_slot.map = ptr;
+        break;
+    case JIT_OP_WRITE_16_SLOT:
+        immed->write_16_slot.map = ptr;
+        break;
+    case JIT_OP_WRITE_32_SLOT:
+        immed->write_32_slot.map = ptr;
+        break;
+    case JIT_OP_WRITE_FLOAT_SLOT:
+        immed->write_float_slot.map = ptr;
+        break;
+    case JIT_OP_READ_32_BLOCK:
+        immed->read_32_block.map = ptr;
+        break;
+    case JIT_OP_WRITE_32_BLOCK:
+        immed->write_32_block.map = ptr;
+        break;
+    case JIT_OP_LOAD_SLOT16:
+        immed->load_slot16.src = ptr;
+        break;
+    case JIT_OP_LOAD_SLOT:
+        immed->load_slot.src = ptr;
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT:
+        immed->load_float_slot.src = ptr;
+        break;
+    case JIT_OP_STORE_SLOT:
+        immed->store_slot.dst = ptr;
+        break;
+    case JIT_OP_STORE_FLOAT_SLOT:
+        immed->store_float_slot.dst = ptr;
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+static int read_u32(washdc_hostfile file, uint32_t *out) {
+    return washdc_hostfile_read(file, out, sizeof(*out)) == sizeof(*out) ?
+        0 : -1;
+}
+
+static int write_u32(washdc_hostfile file, uint32_t val) {
+    return washdc_hostfile_write(file, &val, sizeof(val)) == sizeof(val) ?
+        0 : -1;
+}
+
+static int read_rec(washdc_hostfile file, struct jit_persist_rec *rec) {
+    uint32_t hash, src_hash, n_bytes, cycle_count, n_slots, inst_count;
+    unsigned idx;
+
+    if (read_u32(file, &hash) != 0 || read_u32(file, &src_hash) != 0 ||
+        read_u32(file, &n_bytes) != 0 || read_u32(file, &cycle_count) != 0 ||
+        read_u32(file, &n_slots) != 0 || read_u32(file, &inst_count) != 0)
+        return -1;
+
+    if (n_slots > MAX_SLOTS || !inst_count || inst_count > 0x10000)
+        return -1;
+
+    rec->hash = hash;
+    rec->src_hash = src_hash;
+    rec->n_bytes = n_bytes;
+    rec->cycle_count = cycle_count;
+    rec->n_slots = n_slots;
+    rec->inst_count = inst_count;
+
+    rec->slot_tp = malloc((n_slots ? n_slots : 1) * sizeof(uint32_t));
+    rec->inst_list = malloc(inst_count * sizeof(struct jit_inst));
+    rec->reloc_region = malloc(inst_count * sizeof(uint32_t));
+    rec->reloc_offs = malloc(inst_count * sizeof(uint32_t));
+    if (!rec->slot_tp || !rec->inst_list ||
+        !rec->reloc_region || !rec->reloc_offs)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    for (idx = 0; idx < n_slots; idx++) {
+        if (read_u32(file, rec->slot_tp + idx) != 0 ||
+            rec->slot_tp[idx] > WASHDC_JIT_SLOT_HOST_PTR)
+            return -1;
+    }
+
+    for (idx = 0; idx < inst_count; idx++) {
+        struct jit_inst *inst = rec->inst_list + idx;
+        void const *ptr;
+        if (washdc_hostfile_read(file, inst, sizeof(*inst)) != sizeof(*inst))
+            return -1;
+        if (read_u32(file, rec->reloc_region + idx) != 0 ||
+            read_u32(file, rec->reloc_offs + idx) != 0)
+            return -1;
+        if ((unsigned)inst->op >= JIT_PERSIST_N_OPS)
+            return -1;
+
+        uint32_t region_no = rec->reloc_region[idx];
+        if (inst_get_ptr(inst, &ptr)) {
+            if (region_no >= n_regions ||
+                rec->reloc_offs[idx] >= regions[region_no].len)
+                return -1;
+        } else if (region_no != JIT_PERSIST_NO_RELOC) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int write_rec(washdc_hostfile file, struct jit_persist_rec const *rec) {
+    unsigned idx;
+
+    if (write_u32(file, rec->hash) != 0 || write_u32(file, rec->src_hash) != 0 ||
+        write_u32(file, rec->n_bytes) != 0 ||
+        write_u32(file, rec->cycle_count) != 0 ||
+        write_u32(file, rec->n_slots) != 0 ||
+        write_u32(file, rec->inst_count) != 0)
+        return -1;
+
+    for (idx = 0; idx < rec->n_slots; idx++)
+        if (write_u32(file, rec->slot_tp[idx]) != 0)
+            return -1;
+
+    for (idx = 0; idx < rec->inst_count; idx++) {
+        struct jit_inst const *inst = rec->inst_list + idx;
+        if (washdc_hostfile_write(file, inst, sizeof(*inst)) != sizeof(*inst))
+            return -1;
+        if (write_u32(file, rec->reloc_region[idx]) != 0 ||
+            write_u32(file, rec->reloc_offs[idx]) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static void fill_hdr(struct persist_hdr *hdr, uint32_t flags,
+                     uint32_t n_records) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = JIT_PERSIST_MAGIC;
+    hdr->version = JIT_PERSIST_VERSION;
+    hdr->inst_size = sizeof(struct jit_inst);
+    hdr->n_ops = JIT_PERSIST_N_OPS;
+    hdr->n_regions = n_regions;
+    hdr->region_sig = region_sig();
+    hdr->flags = flags;
+    hdr->n_records = n_records;
+}
+
+void jit_persist_load(char const *path, uint32_t flags) {
+    struct persist_hdr hdr, expect;
+    washdc_hostfile file =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_READ | WASHDC_HOSTFILE_BINARY);
+    if (file == WASHDC_HOSTFILE_INVALID) {
+        LOG_INFO("no jit cache at \"%s\"\n", path);
+        return;
+    }
+
+    if (washdc_hostfile_read(file, &hdr, sizeof(hdr)) != sizeof(hdr))
+        goto close_file;
+
+    fill_hdr(&expect, flags, hdr.n_records);
+    if (memcmp(&hdr, &expect, sizeof(hdr)) != 0) {
+        LOG_WARN("ignoring incompatible jit cache at \"%s\"\n", path);
+        goto close_file;
+    }
+
+    unsigned rec_no;
+    for (rec_no = 0; rec_no < hdr.n_records; rec_no++) {
+        struct jit_persist_rec *rec = calloc(1, sizeof(struct jit_persist_rec));
+        if (!rec)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        if (read_rec(file, rec) != 0) {
+            LOG_WARN("jit cache at \"%s\" is truncated or corrupt\n", path);
+            free_rec(rec);
+            break;
+        }
+        insert_rec(rec);
+    }
+
+    LOG_INFO("loaded %u blocks from jit cache \"%s\"\n", rec_no, path);
+
+close_file:
+    washdc_hostfile_close(file);
+}
+
+void jit_persist_save(char const *path, uint32_t flags) {
+    struct persist_hdr hdr;
+    unsigned idx;
+    uint32_t n_records = 0;
+
+    for (idx = 0; idx < JIT_PERSIST_TBL_LEN; idx++) {
+        struct jit_persist_rec const *rec;
+        for (rec = rec_tbl[idx]; rec; rec = rec->next)
+            n_records++;
+    }
+
+    washdc_hostfile file =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE | WASHDC_HOSTFILE_BINARY);
+    if (file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open \"%s\" to write jit cache\n", path);
+        return;
+    }
+
+    fill_hdr(&hdr, flags, n_records);
+    if (washdc_hostfile_write(file, &hdr, sizeof(hdr)) != sizeof(hdr))
+        goto on_error;
+
+    for (idx = 0; idx < JIT_PERSIST_TBL_LEN; idx++) {
+        struct jit_persist_rec const *rec;
+        for (rec = rec_tbl[idx]; rec; rec = rec->next)
+            if (write_rec(file, rec) != 0)
+                goto on_error;
+    }
+
+    washdc_hostfile_close(file);
+    return;
+
+on_error:
+    LOG_ERROR("error writing jit cache to \"%s\"\n", path);
+    washdc_hostfile_close(file);
+}
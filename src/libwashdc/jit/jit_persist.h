@@ -0,0 +1,122 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * persistent on-disk cache of optimized IL.
+ *
+ * Blocks are stored after jit_optimize has run so that a hit only needs to go
+ * through the backend.  The IL contains host pointers (register files, memory
+ * maps, opcode handlers, etc) which won't be at the same addresses the next
+ * time the emulator runs, so every pointer gets written out as an index into
+ * a table of registered host ranges plus an offset.  Blocks which reference a
+ * pointer that isn't covered by any registered range don't get persisted.
+ *
+ * The registry has to be built in the same order every time, since the file
+ * only stores indices into it.  The file header records the number and sizes
+ * of the registered ranges so that a stale cache gets thrown away instead of
+ * being relocated against the wrong table.
+ */
+
+#ifndef JIT_PERSIST_H_
+#define JIT_PERSIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "jit/defs.h"
+
+struct il_code_block;
+struct jit_inst;
+
+struct jit_persist_rec {
+    jit_hash hash;
+
+    // hash of the guest code that the block was compiled from
+    uint32_t src_hash;
+
+    // number of bytes of guest code the block covers
+    unsigned n_bytes;
+
+    unsigned cycle_count;
+
+    unsigned n_slots;
+    uint32_t *slot_tp;
+
+    unsigned inst_count;
+    struct jit_inst *inst_list;
+
+    /*
+     * one entry per instruction; JIT_PERSIST_NO_RELOC means the instruction
+     * doesn't contain a host pointer.
+     */
+    uint32_t *reloc_region;
+    uint32_t *reloc_offs;
+
+    struct jit_persist_rec *next;
+};
+
+#define JIT_PERSIST_NO_RELOC 0xffffffff
+
+void jit_persist_init(void);
+void jit_persist_cleanup(void);
+
+/*
+ * register a range of host memory that IL instructions may point into.
+ * Functions can be registered with a len of 1.
+ */
+void jit_persist_register(void const *base, size_t len);
+
+/*
+ * load records from the given path.  flags is a frontend-defined value that
+ * gets stored in the header; the file is ignored if it doesn't match (this is
+ * meant for config settings that change the IL a frontend generates).
+ */
+void jit_persist_load(char const *path, uint32_t flags);
+void jit_persist_save(char const *path, uint32_t flags);
+
+struct jit_persist_rec const *jit_persist_find(jit_hash hash);
+
+/*
+ * rebuild the IL for the given record into il_blk, which should have already
+ * been initialized with il_code_block_init.  Returns 0 on success.
+ */
+int jit_persist_restore(struct jit_persist_rec const *rec,
+                        struct il_code_block *il_blk);
+
+/*
+ * add a block to the cache, replacing any existing record with the same
+ * hash.  Returns 0 on success, or nonzero if the block can't be persisted.
+ */
+int jit_persist_store(jit_hash hash, uint32_t src_hash, unsigned n_bytes,
+                      unsigned cycle_count, struct il_code_block const *il_blk);
+
+// FNV-1a; pass JIT_PERSIST_HASH_INIT as the initial value
+#define JIT_PERSIST_HASH_INIT 0x811c9dc5
+
+static inline uint32_t jit_persist_hash16(uint32_t hash, uint16_t val) {
+    hash = (hash ^ (val & 0xff)) * 0x01000193;
+    hash = (hash ^ (val >> 8)) * 0x01000193;
+    return hash;
+}
+
+#endif
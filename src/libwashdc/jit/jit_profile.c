@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include <capstone/capstone.h>
 
@@ -224,6 +225,43 @@ void jit_profile_print(struct jit_profile_ctxt *ctxt, washdc_hostfile fout) {
     }
 }
 
+void jit_profile_export_json(struct jit_profile_ctxt *ctxt,
+                             washdc_hostfile fout) {
+    unsigned idx;
+    bool first = true;
+
+    washdc_hostfile_puts(fout, "[\n");
+    for (idx = 0; idx < JIT_PROFILE_N_BLOCKS; idx++) {
+        struct jit_profile_per_block const *profile = ctxt->high_score[idx];
+        if (!profile)
+            continue;
+
+        unsigned n_fallbacks = 0;
+        unsigned inst_no;
+        for (inst_no = 0; inst_no < profile->il_inst_count; inst_no++)
+            if (profile->il_insts[inst_no].op == JIT_OP_FALLBACK)
+                n_fallbacks++;
+
+        if (!first)
+            washdc_hostfile_puts(fout, ",\n");
+        first = false;
+
+        washdc_hostfile_printf(fout,
+                               "  { \"addr\": %u, \"hits\": %llu, "
+                               "\"guest_insts\": %u, \"cycles\": %u, "
+                               "\"total_cycles\": %llu, \"il_insts\": %u, "
+                               "\"fallbacks\": %u, \"native_bytes\": %u }",
+                               (unsigned)profile->first_addr,
+                               (unsigned long long)profile->hit_count,
+                               profile->inst_count, profile->cycle_count,
+                               (unsigned long long)profile->hit_count *
+                               profile->cycle_count,
+                               profile->il_inst_count, n_fallbacks,
+                               profile->native_bytes);
+    }
+    washdc_hostfile_puts(fout, "\n]\n");
+}
+
 void jit_profile_set_native_insts(struct jit_profile_ctxt *ctxt,
                                   struct jit_profile_per_block *blk,
                                   unsigned n_bytes,
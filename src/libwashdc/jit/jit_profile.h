@@ -59,6 +59,9 @@ struct jit_profile_per_block {
 
     unsigned native_bytes;
     void *native_dat;
+
+    // guest cycles charged each time the block runs
+    unsigned cycle_count;
 };
 
 typedef void(*jit_profile_disas_fn)(washdc_hostfile out, uint32_t addr, void const *instp);
@@ -103,6 +106,13 @@ void jit_profile_push_il_inst(struct jit_profile_ctxt *ctxt,
 
 void jit_profile_print(struct jit_profile_ctxt *ctxt, washdc_hostfile fout);
 
+/*
+ * write the same blocks as jit_profile_print as a JSON array, one object per
+ * block, without any disassembly.  This is meant for scripts.
+ */
+void jit_profile_export_json(struct jit_profile_ctxt *ctxt,
+                             washdc_hostfile fout);
+
 void jit_profile_set_native_insts(struct jit_profile_ctxt *ctxt,
                                   struct jit_profile_per_block *blk,
                                   unsigned n_bytes,
@@ -26,6 +26,9 @@
 #include "code_block.h"
 
 static void jit_optimize_nop(struct il_code_block *blk);
+static bool is_nop(struct jit_inst const *inst);
+static void forward_store(struct jit_inst const *store, struct jit_inst *load);
+static void jit_optimize_const_fold(struct il_code_block *blk);
 static void jit_optimize_dead_write(struct il_code_block *blk);
 static void jit_optimize_discard(struct il_code_block *blk);
 
@@ -34,6 +37,7 @@ check_for_reads_after(struct il_code_block *blk, unsigned inst_idx);
 
 void jit_optimize(struct il_code_block *blk) {
     jit_optimize_nop(blk);
+    jit_optimize_const_fold(blk);
     jit_optimize_dead_write(blk);
     jit_optimize_discard(blk);
 }
@@ -58,14 +62,313 @@ static void jit_optimize_nop(struct il_code_block *blk) {
             il_code_block_strike_inst(blk, inst_no);
             continue;
         }
+        if (inst_no)
+            forward_store(inst - 1, inst);
+        if (is_nop(inst)) {
+            il_code_block_strike_inst(blk, inst_no);
+            continue;
+        }
         inst_no++;
     }
 }
 
-// remove IL instructions which write to a slot which is not later read from
+// returns true if inst leaves every slot the way it found it
+static bool is_nop(struct jit_inst const *inst) {
+    switch (inst->op) {
+    case JIT_OP_MOV:
+        return inst->immed.mov.slot_src == inst->immed.mov.slot_dst;
+    case JIT_OP_MOV_FLOAT:
+        return inst->immed.mov_float.slot_src ==
+            inst->immed.mov_float.slot_dst;
+    case JIT_OP_ADD_CONST32:
+        return inst->immed.add_const32.const32 == 0;
+    case JIT_OP_OR_CONST32:
+        return inst->immed.or_const32.const32 == 0;
+    case JIT_OP_XOR_CONST32:
+        return inst->immed.xor_const32.const32 == 0;
+    case JIT_OP_AND_CONST32:
+        return inst->immed.and_const32.const32 == 0xffffffff;
+    case JIT_OP_SHLL:
+        return inst->immed.shll.shift_amt == 0;
+    case JIT_OP_SHLR:
+        return inst->immed.shlr.shift_amt == 0;
+    case JIT_OP_SHAR:
+        return inst->immed.shar.shift_amt == 0;
+    default:
+        return false;
+    }
+}
+
+/*
+ * if load reads back the host memory that store just wrote to, turn load into
+ * a MOV from the slot that got stored.  This happens whenever the frontend
+ * writes a guest register back to the register file and then immediately
+ * loads it again, and it lets the backend keep the value in a host register.
+ */
+static void forward_store(struct jit_inst const *store, struct jit_inst *load) {
+    if (store->op == JIT_OP_STORE_SLOT && load->op == JIT_OP_LOAD_SLOT &&
+        store->immed.store_slot.dst == load->immed.load_slot.src) {
+        unsigned slot_src = store->immed.store_slot.slot_no;
+        unsigned slot_dst = load->immed.load_slot.slot_no;
+        load->op = JIT_OP_MOV;
+        load->immed.mov.slot_src = slot_src;
+        load->immed.mov.slot_dst = slot_dst;
+    } else if (store->op == JIT_OP_STORE_FLOAT_SLOT &&
+               load->op == JIT_OP_LOAD_FLOAT_SLOT &&
+               store->immed.store_float_slot.dst ==
+               load->immed.load_float_slot.src) {
+        unsigned slot_src = store->immed.store_float_slot.slot_no;
+        unsigned slot_dst = load->immed.load_float_slot.slot_no;
+        load->op = JIT_OP_MOV_FLOAT;
+        load->immed.mov_float.slot_src = slot_src;
+        load->immed.mov_float.slot_dst = slot_dst;
+    }
+}
+
+/*
+ * slots whose values are known at compile-time.  This lives on the stack of
+ * jit_optimize_const_fold because the SH4 and ARM7 JITs can both be compiling
+ * at once.
+ */
+struct const_fold_state {
+    bool slot_known[MAX_SLOTS];
+    uint32_t slot_val[MAX_SLOTS];
+};
+
+static void fold_to_set_slot(struct const_fold_state *st,
+                             struct jit_inst *inst, unsigned slot_no,
+                             uint32_t val) {
+    inst->op = JIT_SET_SLOT;
+    inst->immed.set_slot.slot_idx = slot_no;
+    inst->immed.set_slot.new_val = val;
+    st->slot_known[slot_no] = true;
+    st->slot_val[slot_no] = val;
+}
+
+/*
+ * Constant propagation and folding.
+ *
+ * This tracks which slots hold constants as it walks through the block.
+ * Operations on constants get replaced by JIT_SET_SLOT, operations with one
+ * constant operand are replaced by their _CONST32 equivalents, and memory
+ * reads from constant addresses are replaced with their _CONSTADDR
+ * equivalents.  Any JIT_SET_SLOT that isn't needed anymore after this gets
+ * removed by jit_optimize_dead_write.
+ */
+static void jit_optimize_const_fold(struct il_code_block *blk) {
+    struct const_fold_state st;
+    unsigned inst_no, slot_no;
+
+    for (slot_no = 0; slot_no < blk->n_slots; slot_no++)
+        st.slot_known[slot_no] = false;
+
+    for (inst_no = 0; inst_no < blk->inst_count; inst_no++) {
+        struct jit_inst *inst = blk->inst_list + inst_no;
+        union jit_immed *immed = &inst->immed;
+        unsigned src, dst;
+
+        switch (inst->op) {
+        case JIT_SET_SLOT:
+            st.slot_known[immed->set_slot.slot_idx] = true;
+            st.slot_val[immed->set_slot.slot_idx] = immed->set_slot.new_val;
+            continue;
+        case JIT_OP_MOV:
+            src = immed->mov.slot_src;
+            dst = immed->mov.slot_dst;
+            if (st.slot_known[src]) {
+                fold_to_set_slot(&st, inst, dst, st.slot_val[src]);
+                continue;
+            }
+            break;
+        case JIT_OP_ADD:
+            src = immed->add.slot_src;
+            dst = immed->add.slot_dst;
+            if (st.slot_known[src] && st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] + st.slot_val[src]);
+                continue;
+            } else if (st.slot_known[src]) {
+                inst->op = JIT_OP_ADD_CONST32;
+                immed->add_const32.slot_dst = dst;
+                immed->add_const32.const32 = st.slot_val[src];
+            }
+            break;
+        case JIT_OP_SUB:
+            src = immed->sub.slot_src;
+            dst = immed->sub.slot_dst;
+            if (st.slot_known[src] && st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] - st.slot_val[src]);
+                continue;
+            } else if (st.slot_known[src]) {
+                inst->op = JIT_OP_ADD_CONST32;
+                immed->add_const32.slot_dst = dst;
+                immed->add_const32.const32 = -st.slot_val[src];
+            }
+            break;
+        case JIT_OP_XOR:
+            src = immed->xor.slot_src;
+            dst = immed->xor.slot_dst;
+            if (st.slot_known[src] && st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] ^ st.slot_val[src]);
+                continue;
+            } else if (st.slot_known[src]) {
+                inst->op = JIT_OP_XOR_CONST32;
+                immed->xor_const32.slot_no = dst;
+                immed->xor_const32.const32 = st.slot_val[src];
+            }
+            break;
+        case JIT_OP_AND:
+            src = immed->and.slot_src;
+            dst = immed->and.slot_dst;
+            if (st.slot_known[src] && st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] & st.slot_val[src]);
+                continue;
+            } else if (st.slot_known[src]) {
+                inst->op = JIT_OP_AND_CONST32;
+                immed->and_const32.slot_no = dst;
+                immed->and_const32.const32 = st.slot_val[src];
+            }
+            break;
+        case JIT_OP_OR:
+            src = immed->or.slot_src;
+            dst = immed->or.slot_dst;
+            if (st.slot_known[src] && st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] | st.slot_val[src]);
+                continue;
+            } else if (st.slot_known[src]) {
+                inst->op = JIT_OP_OR_CONST32;
+                immed->or_const32.slot_no = dst;
+                immed->or_const32.const32 = st.slot_val[src];
+            }
+            break;
+        case JIT_OP_ADD_CONST32:
+            dst = immed->add_const32.slot_dst;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] + immed->add_const32.const32);
+                continue;
+            }
+            break;
+        case JIT_OP_XOR_CONST32:
+            dst = immed->xor_const32.slot_no;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] ^ immed->xor_const32.const32);
+                continue;
+            }
+            break;
+        case JIT_OP_AND_CONST32:
+            dst = immed->and_const32.slot_no;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] & immed->and_const32.const32);
+                continue;
+            }
+            break;
+        case JIT_OP_OR_CONST32:
+            dst = immed->or_const32.slot_no;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] | immed->or_const32.const32);
+                continue;
+            }
+            break;
+        case JIT_OP_NOT:
+            dst = immed->not.slot_no;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst, ~st.slot_val[dst]);
+                continue;
+            }
+            break;
+        case JIT_OP_SHLL:
+            dst = immed->shll.slot_no;
+            if (st.slot_known[dst] && immed->shll.shift_amt < 32) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] << immed->shll.shift_amt);
+                continue;
+            }
+            break;
+        case JIT_OP_SHLR:
+            dst = immed->shlr.slot_no;
+            if (st.slot_known[dst] && immed->shlr.shift_amt < 32) {
+                fold_to_set_slot(&st, inst, dst,
+                                 st.slot_val[dst] >> immed->shlr.shift_amt);
+                continue;
+            }
+            break;
+        case JIT_OP_SHAR:
+            dst = immed->shar.slot_no;
+            if (st.slot_known[dst] && immed->shar.shift_amt < 32) {
+                fold_to_set_slot(&st, inst, dst,
+                                 (uint32_t)(((int32_t)st.slot_val[dst]) >>
+                                            immed->shar.shift_amt));
+                continue;
+            }
+            break;
+        case JIT_OP_SIGN_EXTEND_8:
+            dst = immed->sign_extend_8.slot_no;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 (uint32_t)(int32_t)(int8_t)st.slot_val[dst]);
+                continue;
+            }
+            break;
+        case JIT_OP_SIGN_EXTEND_16:
+            dst = immed->sign_extend_16.slot_no;
+            if (st.slot_known[dst]) {
+                fold_to_set_slot(&st, inst, dst,
+                                 (uint32_t)(int32_t)(int16_t)st.slot_val[dst]);
+                continue;
+            }
+            break;
+        case JIT_OP_READ_16_SLOT:
+            src = immed->read_16_slot.addr_slot;
+            if (st.slot_known[src]) {
+                struct memory_map *map = immed->read_16_slot.map;
+                dst = immed->read_16_slot.dst_slot;
+                inst->op = JIT_OP_READ_16_CONSTADDR;
+                immed->read_16_constaddr.map = map;
+                immed->read_16_constaddr.addr = st.slot_val[src];
+                immed->read_16_constaddr.slot_no = dst;
+            }
+            break;
+        case JIT_OP_READ_32_SLOT:
+            src = immed->read_32_slot.addr_slot;
+            if (st.slot_known[src]) {
+                struct memory_map *map = immed->read_32_slot.map;
+                dst = immed->read_32_slot.dst_slot;
+                inst->op = JIT_OP_READ_32_CONSTADDR;
+                immed->read_32_constaddr.map = map;
+                immed->read_32_constaddr.addr = st.slot_val[src];
+                immed->read_32_constaddr.slot_no = dst;
+            }
+            break;
+        default:
+            break;
+        }
+
+        // anything this instruction writes to is no longer known
+        int write_slots[JIT_IL_MAX_WRITE_SLOTS];
+        jit_inst_get_write_slots(inst, write_slots);
+        for (slot_no = 0; slot_no < JIT_IL_MAX_WRITE_SLOTS; slot_no++)
+            if (write_slots[slot_no] != -1)
+                st.slot_known[write_slots[slot_no]] = false;
+    }
+}
+
+/*
+ * remove IL instructions which write to a slot which is not later read from.
+ * This walks the block backwards so that once an instruction is removed, the
+ * instructions which only existed to compute its inputs are dead by the time
+ * they get checked.
+ */
 static void jit_optimize_dead_write(struct il_code_block *blk) {
-    unsigned src_inst = 0;
-    while (src_inst < blk->inst_count) {
+    unsigned src_inst = blk->inst_count;
+    while (src_inst--) {
         struct jit_inst *inst = blk->inst_list + src_inst;
         int write_slots[JIT_IL_MAX_WRITE_SLOTS];
         jit_inst_get_write_slots(inst, write_slots);
@@ -76,15 +379,11 @@ static void jit_optimize_dead_write(struct il_code_block *blk) {
         for (slot_no = 0; slot_no < JIT_IL_MAX_WRITE_SLOTS; slot_no++)
             if (write_slots[slot_no] != -1)
                 write_count++;
-        if (!write_count) {
-            src_inst++;
+        if (!write_count)
             continue;
-        }
 
         if (!check_for_reads_after(blk, src_inst))
             il_code_block_strike_inst(blk, src_inst);
-        else
-            src_inst++;
     }
 }
 
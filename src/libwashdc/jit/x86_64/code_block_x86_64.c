@@ -28,6 +28,8 @@
 #include <errno.h>
 #include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "log.h"
 #include "washdc/error.h"
@@ -152,7 +154,7 @@ static struct reg_stat const gen_regs_template[N_REGS] = {
     },
     [R14] = {
         /*
-         * pointer to code_cache_tbl.  This is the same on both Unix and
+         * pointer to the code cache's hash table.  This is the same on both Unix and
          * Microsoft ABI.
          */
         .locked = true,
@@ -161,7 +163,11 @@ static struct reg_stat const gen_regs_template[N_REGS] = {
         REGISTER_FLAG_REX_8BIT
     },
     [R15] = {
-        .locked = false,
+        /*
+         * the clock's countdown (NATIVE_DISPATCH_COUNTDOWN_REG).  This is the
+         * same on both Unix and Microsoft ABI.
+         */
+        .locked = true,
         .prio = 8,
         .flags = REGISTER_FLAG_PRESERVED | REGISTER_FLAG_REX |
         REGISTER_FLAG_REX_8BIT
@@ -337,6 +343,60 @@ struct slot {
  */
 static int rsp_offs; // offset from base pointer to stack pointer
 
+/*
+ * static destinations of the JIT_OP_JUMP in the block being compiled.
+ * n_jump_targets is zero if the destination can only be known at runtime.
+ */
+static unsigned n_jumps, n_jump_targets;
+static uint32_t jump_addr[JIT_JUMP_MAX_STATIC_TARGETS];
+static jit_hash jump_hash[JIT_JUMP_MAX_STATIC_TARGETS];
+
+/*
+ * JIT_OP_EXIT_COND side-exits in the block being compiled.  Each one gets
+ * emitted as a conditional jump over a jmp (site) to code at the end of the
+ * block which leaves through native_check_cycles.  The code at the end can't
+ * be emitted until everything else has been, so site gets patched afterwards.
+ */
+#define MAX_SIDE_EXITS 32
+static struct side_exit {
+    void *site;
+    struct exit_cond_immed const *immed;
+} side_exits[MAX_SIDE_EXITS];
+static unsigned n_side_exits;
+
+/*
+ * Liveness of every slot in the block being compiled.  This gets filled in by
+ * analyze_slots and linear_scan before any code is emitted.
+ *
+ * Slots are never reused within a block, so each slot has exactly one live
+ * range, which runs from the first IL instruction that references it to the
+ * last one.
+ */
+static struct slot_range {
+    unsigned first, last;
+    bool referenced;
+
+    // REGISTER_HINT_JUMP_ADDR and REGISTER_HINT_JUMP_HASH
+    enum register_hint jump_hints;
+
+    // the register the linear scan assigned to this slot, or -1
+    int pref_reg;
+} slot_ranges[MAX_SLOTS];
+
+/*
+ * calls_before[idx] is the number of IL instructions before idx which emit a
+ * function call.  This has one more element than the IL block.
+ */
+static unsigned *calls_before;
+static unsigned calls_before_alloc;
+
+/*
+ * scratch register sets used by linear_scan to keep track of which registers
+ * are assigned to live ranges.  These never hold the real state of the
+ * registers.
+ */
+static struct register_set lsra_gen_set, lsra_xmm_set;
+
 static void evict_register(struct code_block_x86_64 *blk,
                            struct register_state *reg_state, unsigned reg_no);
 
@@ -350,9 +410,19 @@ void jit_x86_64_backend_init(void) {
     register_set_init(&xmm_reg_state.set, N_XMM_REGS, xmm_regs_template);
     xmm_reg_state.n_regs = N_XMM_REGS;
     xmm_reg_state.reg_slots = (int*)malloc(sizeof(int) * N_XMM_REGS);
+
+    register_set_init(&lsra_gen_set, N_REGS, gen_regs_template);
+    register_set_init(&lsra_xmm_set, N_XMM_REGS, xmm_regs_template);
 }
 
 void jit_x86_64_backend_cleanup(void) {
+    register_set_cleanup(&lsra_xmm_set);
+    register_set_cleanup(&lsra_gen_set);
+
+    free(calls_before);
+    calls_before = NULL;
+    calls_before_alloc = 0;
+
     free(gen_reg_state.reg_slots);
     gen_reg_state.reg_slots = NULL;
     gen_reg_state.n_regs = 0;
@@ -724,6 +794,7 @@ move_slot_to_reg(struct code_block_x86_64 *blk, unsigned slot_no, unsigned reg_n
  */
 static bool does_inst_emit_call(struct jit_inst const *inst) {
     return inst->op == JIT_OP_FALLBACK || inst->op == JIT_OP_CALL_FUNC ||
+        inst->op == JIT_OP_MACL || inst->op == JIT_OP_MACW ||
         (inst->op == JIT_OP_READ_16_CONSTADDR ||
          inst->op == JIT_OP_READ_32_CONSTADDR ||
          inst->op == JIT_OP_READ_8_SLOT ||
@@ -733,33 +804,233 @@ static bool does_inst_emit_call(struct jit_inst const *inst) {
          inst->op == JIT_OP_WRITE_8_SLOT ||
          inst->op == JIT_OP_WRITE_16_SLOT ||
          inst->op == JIT_OP_WRITE_32_SLOT ||
-         inst->op == JIT_OP_WRITE_FLOAT_SLOT);
+         inst->op == JIT_OP_WRITE_FLOAT_SLOT ||
+         inst->op == JIT_OP_READ_32_BLOCK ||
+         inst->op == JIT_OP_WRITE_32_BLOCK);
+}
+
+/*
+ * hints for a slot which is being put into a register at IL instruction
+ * inst_idx.  This only considers what happens to the slot from inst_idx
+ * until the end of its live range.
+ */
+static enum register_hint slot_hints(unsigned slot_no, unsigned inst_idx) {
+    struct slot_range const *range = slot_ranges + slot_no;
+    enum register_hint hint = range->jump_hints;
+
+    if (range->referenced && inst_idx <= range->last) {
+        if (calls_before[range->last + 1] - calls_before[inst_idx])
+            hint |= REGISTER_HINT_FUNCTION;
+        else
+            hint |= REGISTER_HINT_VOLATILE;
+    }
+
+    return hint;
 }
 
 static enum register_hint suggested_register_hints(struct il_code_block const *blk,
                                          unsigned slot_no,
                                          struct jit_inst const *inst) {
-    unsigned beg = inst - blk->inst_list;
-    unsigned end = jit_code_block_slot_lifespan(blk, slot_no, beg);
+    return slot_hints(slot_no, inst - blk->inst_list);
+}
 
-    enum register_hint hint = REGISTER_HINT_NONE;
+static void note_slot_ref(unsigned slot_no, unsigned inst_idx) {
+    if (slot_no >= MAX_SLOTS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+    struct slot_range *range = slot_ranges + slot_no;
+    if (!range->referenced) {
+        range->referenced = true;
+        range->first = inst_idx;
+    }
+    range->last = inst_idx;
+}
 
-    while (beg <= end) {
-        struct jit_inst *cur_inst = blk->inst_list + beg;
+/*
+ * liveness pass.  This finds the live range of every slot and counts the
+ * function calls so that the hints for any part of a live range can be found
+ * without walking the IL again.
+ */
+static void analyze_slots(struct il_code_block const *il_blk) {
+    unsigned inst_count = il_blk->inst_count;
+    unsigned slot_no, inst_idx;
+
+    if (calls_before_alloc < inst_count + 1) {
+        unsigned *new_calls_before =
+            (unsigned*)realloc(calls_before,
+                               (inst_count + 1) * sizeof(calls_before[0]));
+        if (!new_calls_before)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        calls_before = new_calls_before;
+        calls_before_alloc = inst_count + 1;
+    }
 
-        if (does_inst_emit_call(cur_inst))
-            hint |= REGISTER_HINT_FUNCTION;
+    for (slot_no = 0; slot_no < il_blk->n_slots; slot_no++) {
+        slot_ranges[slot_no].referenced = false;
+        slot_ranges[slot_no].jump_hints = REGISTER_HINT_NONE;
+        slot_ranges[slot_no].pref_reg = -1;
+    }
 
-        if (cur_inst->op == JIT_OP_JUMP) {
-            if (cur_inst->immed.jump.jmp_addr_slot == slot_no)
-                hint |= REGISTER_HINT_JUMP_ADDR;
-            if (cur_inst->immed.jump.jmp_hash_slot == slot_no)
-                hint |= REGISTER_HINT_JUMP_HASH;
+    unsigned n_calls = 0;
+    for (inst_idx = 0; inst_idx < inst_count; inst_idx++) {
+        struct jit_inst const *inst = il_blk->inst_list + inst_idx;
+        int read_slots[JIT_IL_MAX_READ_SLOTS];
+        int write_slots[JIT_IL_MAX_WRITE_SLOTS];
+        unsigned idx;
+
+        calls_before[inst_idx] = n_calls;
+        if (does_inst_emit_call(inst))
+            n_calls++;
+
+        if (inst->op == JIT_OP_DISCARD_SLOT)
+            continue;
+
+        jit_inst_get_read_slots(inst, read_slots);
+        jit_inst_get_write_slots(inst, write_slots);
+        for (idx = 0; idx < JIT_IL_MAX_READ_SLOTS; idx++)
+            if (read_slots[idx] >= 0)
+                note_slot_ref(read_slots[idx], inst_idx);
+        for (idx = 0; idx < JIT_IL_MAX_WRITE_SLOTS; idx++)
+            if (write_slots[idx] >= 0)
+                note_slot_ref(write_slots[idx], inst_idx);
+
+        if (inst->op == JIT_OP_JUMP) {
+            slot_ranges[inst->immed.jump.jmp_addr_slot].jump_hints |=
+                REGISTER_HINT_JUMP_ADDR;
+            slot_ranges[inst->immed.jump.jmp_hash_slot].jump_hints |=
+                REGISTER_HINT_JUMP_HASH;
         }
+    }
+    calls_before[inst_count] = n_calls;
+}
 
-        beg++;
+static void lsra_expire(struct register_set *set, int *owner, unsigned inst_idx) {
+    int reg_no;
+    for (reg_no = 0; reg_no < set->n_regs; reg_no++) {
+        if (owner[reg_no] >= 0 && slot_ranges[owner[reg_no]].last < inst_idx) {
+            register_discard(set, reg_no);
+            owner[reg_no] = -1;
+        }
+    }
+}
+
+static void lsra_assign(struct register_set *set, int *owner,
+                        unsigned slot_no) {
+    struct slot_range *range = slot_ranges + slot_no;
+    int reg_no = register_pick_unused(set, slot_hints(slot_no, range->first));
+
+    if (reg_no >= 0) {
+        register_acquire(set, reg_no);
+        owner[reg_no] = slot_no;
+        range->pref_reg = reg_no;
+        return;
+    }
+
+    // out of registers; whichever range ends last goes without
+    int victim = -1;
+    unsigned victim_last = range->last;
+    for (reg_no = 0; reg_no < set->n_regs; reg_no++) {
+        if (owner[reg_no] >= 0 && slot_ranges[owner[reg_no]].last > victim_last) {
+            victim = reg_no;
+            victim_last = slot_ranges[owner[reg_no]].last;
+        }
+    }
+
+    if (victim >= 0) {
+        slot_ranges[owner[victim]].pref_reg = -1;
+        owner[victim] = slot_no;
+        range->pref_reg = victim;
+    }
+}
+
+/*
+ * Linear-scan register allocation over the whole block.  Live ranges get
+ * visited in order of where they start, and each one is assigned a register
+ * that isn't held by any overlapping range.  Ranges which span a function call
+ * are steered towards registers which the call won't clobber.
+ *
+ * The assignments are only preferences; grab_slot uses them when they're free,
+ * but instructions that need specific registers can still evict slots the way
+ * they always have.
+ */
+static void linear_scan(struct il_code_block const *il_blk) {
+    int gen_owner[N_REGS], xmm_owner[N_XMM_REGS];
+    unsigned inst_idx, reg_no;
+
+    register_set_reset(&lsra_gen_set);
+    register_set_reset(&lsra_xmm_set);
+    for (reg_no = 0; reg_no < N_REGS; reg_no++)
+        gen_owner[reg_no] = -1;
+    for (reg_no = 0; reg_no < N_XMM_REGS; reg_no++)
+        xmm_owner[reg_no] = -1;
+
+    for (inst_idx = 0; inst_idx < il_blk->inst_count; inst_idx++) {
+        struct jit_inst const *inst = il_blk->inst_list + inst_idx;
+        int slots_ref[JIT_IL_MAX_READ_SLOTS + JIT_IL_MAX_WRITE_SLOTS];
+        unsigned idx;
+
+        if (inst->op == JIT_OP_DISCARD_SLOT)
+            continue;
+
+        jit_inst_get_read_slots(inst, slots_ref);
+        jit_inst_get_write_slots(inst, slots_ref + JIT_IL_MAX_READ_SLOTS);
+
+        lsra_expire(&lsra_gen_set, gen_owner, inst_idx);
+        lsra_expire(&lsra_xmm_set, xmm_owner, inst_idx);
+
+        for (idx = 0; idx < JIT_IL_MAX_READ_SLOTS + JIT_IL_MAX_WRITE_SLOTS;
+             idx++) {
+            int slot_no = slots_ref[idx];
+            if (slot_no < 0 || slot_ranges[slot_no].first != inst_idx ||
+                slot_ranges[slot_no].pref_reg >= 0)
+                continue;
+
+            if (il_blk->slots[slot_no].tp == WASHDC_JIT_SLOT_FLOAT)
+                lsra_assign(&lsra_xmm_set, xmm_owner, slot_no);
+            else
+                lsra_assign(&lsra_gen_set, gen_owner, slot_no);
+        }
     }
-    return hint;
+}
+
+/*
+ * pick a register for a slot which is about to be moved into one.  This
+ * prefers the register picked by linear_scan.  If every register is in use,
+ * the one that gets spilled is the one whose slot stays live the longest.
+ */
+static unsigned pick_slot_register(struct register_state *reg_state,
+                                   struct il_code_block const *il_blk,
+                                   struct jit_inst const *inst,
+                                   unsigned slot_no) {
+    struct register_set *set = &reg_state->set;
+    int pref = slot_ranges[slot_no].pref_reg;
+
+    if (pref >= 0 && !register_in_use(set, pref) && !register_grabbed(set, pref))
+        return pref;
+
+    enum register_hint hints = suggested_register_hints(il_blk, slot_no, inst);
+    int reg_no = register_pick_unused(set, hints);
+    if (reg_no >= 0)
+        return reg_no;
+
+    int victim = -1;
+    unsigned victim_last = 0;
+    for (reg_no = 0; reg_no < set->n_regs; reg_no++) {
+        if (set->regs[reg_no].locked || register_grabbed(set, reg_no) ||
+            !register_in_use(set, reg_no) ||
+            (unsigned)reg_state->reg_slots[reg_no] >= MAX_SLOTS)
+            continue;
+        unsigned last = slot_ranges[reg_state->reg_slots[reg_no]].last;
+        if (victim < 0 || last > victim_last) {
+            victim = reg_no;
+            victim_last = last;
+        }
+    }
+
+    if (victim >= 0)
+        return victim;
+
+    // this will raise an error
+    return register_pick(set, hints);
 }
 
 /*
@@ -771,8 +1042,19 @@ static enum register_hint suggested_register_hints(struct il_code_block const *b
 static void evict_register(struct code_block_x86_64 *blk,
                            struct register_state *reg_state, unsigned reg_no) {
     if (register_in_use(&reg_state->set, reg_no)) {
-        // REGISTER_HINT_FUNCTION not necessary, just being used as a "default"
-        int reg_dst = register_pick_unused(&reg_state->set, REGISTER_HINT_FUNCTION);
+        unsigned slot_no = reg_state->reg_slots[reg_no];
+        int reg_dst = slot_ranges[slot_no].pref_reg;
+
+        /*
+         * move it to the register linear_scan picked if that's free;
+         * otherwise REGISTER_HINT_FUNCTION is just being used as a "default"
+         */
+        if (reg_dst < 0 || reg_dst == reg_no ||
+            register_in_use(&reg_state->set, reg_dst) ||
+            register_grabbed(&reg_state->set, reg_dst) ||
+            reg_state->set.regs[reg_dst].locked)
+            reg_dst = register_pick_unused(&reg_state->set,
+                                           REGISTER_HINT_FUNCTION);
         if (reg_dst == reg_no)
             RAISE_ERROR(ERROR_INTEGRITY);
 
@@ -822,11 +1104,12 @@ static void grab_slot(struct code_block_x86_64 *blk,
                 goto mark_grabbed;
         }
 
-        unsigned reg_no = register_pick(&slot->reg_state->set, suggested_register_hints(il_blk, slot_no, inst));
+        unsigned reg_no =
+            pick_slot_register(slot->reg_state, il_blk, inst, slot_no);
         move_slot_to_reg(blk, slot_no, reg_no);
         goto mark_grabbed;
     } else {
-        unsigned reg_no = register_pick(&reg_state->set, suggested_register_hints(il_blk, slot_no, inst));
+        unsigned reg_no = pick_slot_register(reg_state, il_blk, inst, slot_no);
         if (register_in_use(&reg_state->set, reg_no))
             move_slot_to_stack(blk, reg_state->reg_slots[reg_no]);
         register_acquire(&reg_state->set, reg_no);
@@ -859,6 +1142,10 @@ void code_block_x86_64_init(struct code_block_x86_64 *blk) {
     void *native = exec_mem_alloc(X86_64_ALLOC_SIZE);
     blk->cycle_count = 0;
     blk->bytes_used = 0;
+    blk->links = NULL;
+    blk->n_links = 0;
+    blk->links_in = NULL;
+    blk->n_unchecked_out = blk->n_unchecked_in = 0;
 
     if (!native) {
         error_set_errno_val(errno);
@@ -870,6 +1157,7 @@ void code_block_x86_64_init(struct code_block_x86_64 *blk) {
 }
 
 void code_block_x86_64_cleanup(struct code_block_x86_64 *blk) {
+    native_link_cleanup(blk);
     exec_mem_free(blk->exec_mem_alloc_start);
     memset(blk, 0, sizeof(*blk));
 }
@@ -954,7 +1242,7 @@ static void emit_fallback(struct code_block_x86_64 *blk,
 
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
-    x86asm_call_ptr(inst->immed.fallback.fallback_fn);
+    native_dispatch_call_emit(inst->immed.fallback.fallback_fn);
     ms_shadow_close();
 
     postfunc();
@@ -973,6 +1261,14 @@ static void emit_jump(struct code_block_x86_64 *blk,
 
     move_slot_to_reg(blk, jmp_addr_slot, NATIVE_DISPATCH_PC_REG);
     move_slot_to_reg(blk, jmp_hash_slot, NATIVE_DISPATCH_HASH_REG);
+
+    n_jumps++;
+    n_jump_targets = inst->immed.jump.n_static_targets;
+    unsigned idx;
+    for (idx = 0; idx < n_jump_targets; idx++) {
+        jump_addr[idx] = inst->immed.jump.static_addr[idx];
+        jump_hash[idx] = inst->immed.jump.static_hash[idx];
+    }
 }
 
 static void emit_cset(struct code_block_x86_64 *blk,
@@ -1005,6 +1301,66 @@ static void emit_cset(struct code_block_x86_64 *blk,
     x86asm_lbl8_cleanup(&lbl);
 }
 
+// JIT_OP_EXIT_COND implementation
+static void emit_exit_cond(struct code_block_x86_64 *blk,
+                           struct il_code_block const *il_blk,
+                           void *cpu, struct jit_inst const *inst) {
+    struct x86asm_lbl8 lbl;
+    x86asm_lbl8_init(&lbl);
+    unsigned flag_slot = inst->immed.exit_cond.flag_slot;
+
+    if (n_side_exits >= MAX_SIDE_EXITS)
+        RAISE_ERROR(ERROR_OVERFLOW);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, flag_slot, 4);
+
+    unsigned flag_reg = slots[flag_slot].reg_no;
+
+    x86asm_testb_imm8_reg8(1, flag_reg);
+    if (inst->immed.exit_cond.t_flag)
+        x86asm_jz_lbl8(&lbl);
+    else
+        x86asm_jnz_lbl8(&lbl);
+
+    struct side_exit *ent = side_exits + n_side_exits++;
+    ent->site = x86asm_get_out_ptr();
+    ent->immed = &inst->immed.exit_cond;
+    x86asm_jmpq_offs32(0);
+
+    x86asm_lbl8_define(&lbl);
+
+    ungrab_slot(flag_slot);
+    x86asm_lbl8_cleanup(&lbl);
+
+    // the exits close the stack frame, so it can't be skipped
+    blk->dirty_stack = true;
+}
+
+// point a jump emitted by x86asm_jmpq_offs32 at the current output position
+static void patch_jmp32_here(void *site) {
+    intptr_t disp = ((char*)x86asm_get_out_ptr()) - (((char*)site) + 5);
+    if (disp > INT32_MAX || disp < INT32_MIN)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    int32_t disp32 = disp;
+    memcpy(((char*)exec_mem_rw(site)) + 1, &disp32, sizeof(disp32));
+}
+
+static void emit_side_exits(struct native_dispatch_meta const *dispatch_meta) {
+    unsigned idx;
+    for (idx = 0; idx < n_side_exits; idx++) {
+        struct side_exit const *ent = side_exits + idx;
+
+        patch_jmp32_here(ent->site);
+
+        x86asm_mov_imm32_reg32(ent->immed->addr, NATIVE_DISPATCH_PC_REG);
+        x86asm_mov_imm32_reg32(ent->immed->hash, NATIVE_DISPATCH_HASH_REG);
+        x86asm_mov_imm32_reg32(ent->immed->cycle_count,
+                               NATIVE_DISPATCH_CYCLE_COUNT_REG);
+        emit_stack_frame_close();
+        native_check_cycles_emit(dispatch_meta);
+    }
+}
+
 // JIT_SET_SLOT implementation
 static void emit_set_slot(struct code_block_x86_64 *blk,
                           struct il_code_block const *il_blk,
@@ -1013,7 +1369,14 @@ static void emit_set_slot(struct code_block_x86_64 *blk,
     uint32_t new_val = inst->immed.set_slot.new_val;
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_idx, 4);
-    x86asm_mov_imm32_reg32(new_val, slots[slot_idx].reg_no);
+    /*
+     * xor is shorter than a mov.  It clobbers the flags, but nothing expects
+     * them to survive from one IL instruction to the next.
+     */
+    if (new_val)
+        x86asm_mov_imm32_reg32(new_val, slots[slot_idx].reg_no);
+    else
+        x86asm_xorl_reg32_reg32(slots[slot_idx].reg_no, slots[slot_idx].reg_no);
     ungrab_slot(slot_idx);
 }
 
@@ -1043,7 +1406,7 @@ static void emit_call_func(struct code_block_x86_64 *blk,
 
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
-    x86asm_call_ptr(inst->immed.call_func.func);
+    native_dispatch_call_emit(inst->immed.call_func.func);
     ms_shadow_close();
 
     postfunc();
@@ -1061,7 +1424,7 @@ static void emit_call_func_imm32(struct code_block_x86_64 *blk,
 
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
-    x86asm_call_ptr(inst->immed.call_func.func);
+    native_dispatch_call_emit(inst->immed.call_func.func);
     ms_shadow_close();
 
     postfunc();
@@ -1075,11 +1438,35 @@ static void emit_read_16_constaddr(struct code_block_x86_64 *blk,
     addr32_t vaddr = inst->immed.read_16_constaddr.addr;
     unsigned slot_no = inst->immed.read_16_constaddr.slot_no;
     struct memory_map const *map = inst->immed.read_16_constaddr.map;
+    struct memory_map_region const *region =
+        memory_map_get_region((struct memory_map*)map, vaddr, 2);
+
+    if (region && region->host) {
+        // the address is in RAM so it can be loaded directly from the host
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_no, 4);
+
+        unsigned reg_no = slots[slot_no].reg_no;
+        x86asm_mov_imm64_reg64((uintptr_t)(region->host +
+                                           (vaddr & region->mask)), reg_no);
+        x86asm_movzxw_indreg_reg(reg_no, reg_no);
+
+        ungrab_slot(slot_no);
+        return;
+    }
 
     // call memory_map_read_16(vaddr)
     prefunc(blk);
 
-    if (config_get_inline_mem()) {
+    if (region && region->intf->read16) {
+        // call the region's handler directly
+        x86asm_mov_imm32_reg32(vaddr & region->mask, REG_ARG0);
+        x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
+        ms_shadow_open(blk);
+        x86_64_align_stack(blk);
+        native_dispatch_call_emit((void*)region->intf->read16);
+        ms_shadow_close();
+        x86asm_andl_imm32_reg32(0xffff, REG_RET);
+    } else if (config_get_inline_mem()) {
         x86asm_mov_imm32_reg32(vaddr, REG_ARG0);
         native_mem_read_16(blk, map);
     } else {
@@ -1087,7 +1474,7 @@ static void emit_read_16_constaddr(struct code_block_x86_64 *blk,
         x86asm_mov_imm32_reg32(vaddr, REG_ARG1);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_read_16);
+        native_dispatch_call_emit(memory_map_read_16);
         ms_shadow_close();
     }
 
@@ -1135,12 +1522,35 @@ static void emit_read_32_constaddr(struct code_block_x86_64 *blk,
     addr32_t vaddr = inst->immed.read_32_constaddr.addr;
     unsigned slot_no = inst->immed.read_32_constaddr.slot_no;
     struct memory_map const *map = inst->immed.read_32_constaddr.map;
+    struct memory_map_region const *region =
+        memory_map_get_region((struct memory_map*)map, vaddr, 4);
+
+    if (region && region->host) {
+        // the address is in RAM so it can be loaded directly from the host
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_no, 4);
+
+        unsigned reg_no = slots[slot_no].reg_no;
+        x86asm_mov_imm64_reg64((uintptr_t)(region->host +
+                                           (vaddr & region->mask)), reg_no);
+        x86asm_mov_indreg32_reg32(reg_no, reg_no);
+
+        ungrab_slot(slot_no);
+        return;
+    }
 
     // call memory_map_read_32(vaddr)
 
     prefunc(blk);
 
-    if (config_get_inline_mem()) {
+    if (region && region->intf->read32) {
+        // call the region's handler directly
+        x86asm_mov_imm32_reg32(vaddr & region->mask, REG_ARG0);
+        x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
+        ms_shadow_open(blk);
+        x86_64_align_stack(blk);
+        native_dispatch_call_emit((void*)region->intf->read32);
+        ms_shadow_close();
+    } else if (config_get_inline_mem()) {
         x86asm_mov_imm32_reg32(vaddr, REG_ARG0);
         native_mem_read_32(blk, map);
     } else {
@@ -1148,7 +1558,7 @@ static void emit_read_32_constaddr(struct code_block_x86_64 *blk,
         x86asm_mov_imm32_reg32(vaddr, REG_ARG1);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_read_32);
+        native_dispatch_call_emit(memory_map_read_32);
         ms_shadow_close();
     }
 
@@ -1182,7 +1592,7 @@ static void emit_read_8_slot(struct code_block_x86_64 *blk,
         evict_register(blk, &gen_reg_state, REG_ARG1);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_read_8);
+        native_dispatch_call_emit(memory_map_read_8);
         ms_shadow_close();
     }
 
@@ -1216,7 +1626,7 @@ static void emit_read_16_slot(struct code_block_x86_64 *blk,
         evict_register(blk, &gen_reg_state, REG_ARG1);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_read_16);
+        native_dispatch_call_emit(memory_map_read_16);
         ms_shadow_close();
     }
 
@@ -1250,7 +1660,7 @@ static void emit_read_32_slot(struct code_block_x86_64 *blk,
         evict_register(blk, &gen_reg_state, REG_ARG1);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_read_32);
+        native_dispatch_call_emit(memory_map_read_32);
         ms_shadow_close();
     }
 
@@ -1291,7 +1701,7 @@ static void emit_write_8_slot(struct code_block_x86_64 *blk,
         x86asm_mov_imm64_reg64((uint64_t)map, REG_ARG0);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_write_8);
+        native_dispatch_call_emit(memory_map_write_8);
         ms_shadow_close();
     }
 
@@ -1328,7 +1738,7 @@ static void emit_write_16_slot(struct code_block_x86_64 *blk,
         x86asm_mov_imm64_reg64((uint64_t)map, REG_ARG0);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_write_16);
+        native_dispatch_call_emit(memory_map_write_16);
         ms_shadow_close();
     }
 
@@ -1365,7 +1775,7 @@ static void emit_write_32_slot(struct code_block_x86_64 *blk,
         x86asm_mov_imm64_reg64((uint64_t)map, REG_ARG0);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_write_32);
+        native_dispatch_call_emit(memory_map_write_32);
         ms_shadow_close();
     }
 
@@ -1428,7 +1838,7 @@ static void emit_write_float_slot(struct code_block_x86_64 *blk,
         x86asm_mov_imm64_reg64((uint64_t)map, REG_ARG0);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_write_float);
+        native_dispatch_call_emit(memory_map_write_float);
         ms_shadow_close();
     }
 
@@ -1436,6 +1846,244 @@ static void emit_write_float_slot(struct code_block_x86_64 *blk,
     ungrab_register(&gen_reg_state.set, REG_RET);
 }
 
+// movl <rbp_offs>(%rbp), <reg_no>
+static void emit_movl_rbp_reg(int rbp_offs, unsigned reg_no) {
+    if (rbp_offs > 127 || rbp_offs < -128)
+        x86asm_movl_disp32_reg_reg(rbp_offs, RBP, reg_no);
+    else
+        x86asm_movl_disp8_reg_reg(rbp_offs, RBP, reg_no);
+}
+
+// movl <reg_no>, <rbp_offs>(%rbp)
+static void emit_movl_reg_rbp(unsigned reg_no, int rbp_offs) {
+    if (rbp_offs > 127 || rbp_offs < -128)
+        x86asm_movl_reg_disp32_reg(reg_no, rbp_offs, RBP);
+    else
+        x86asm_movl_reg_disp8_reg(reg_no, rbp_offs, RBP);
+}
+
+/*
+ * copy a general-purpose slot into the given register without moving the
+ * slot.  This is for code that only runs some of the time, where nothing is
+ * allowed to change the register allocator's state.  The register should
+ * already be grabbed.
+ */
+static void copy_slot_to_reg(unsigned slot_no, unsigned reg_no) {
+    if (slot_no >= MAX_SLOTS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+    struct slot const *slot = slots + slot_no;
+    if (!slot->in_use || slot->reg_state != &gen_reg_state)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    if (slot->in_reg) {
+        if (slot->reg_no != reg_no)
+            x86asm_mov_reg32_reg32(slot->reg_no, reg_no);
+    } else {
+        emit_movl_rbp_reg(slot->rbp_offs, reg_no);
+    }
+}
+
+// put the address of a word in a JIT_OP_*_32_BLOCK into reg_no
+static void emit_block_addr(struct mem_block_32_immed const *run, int offs,
+                            unsigned reg_no) {
+    copy_slot_to_reg(run->addr_slot, reg_no);
+    if (offs > 127 || offs < -128)
+        x86asm_addl_imm32_reg32(offs, reg_no);
+    else if (offs)
+        x86asm_addl_imm8_reg32(offs, reg_no);
+}
+
+/*
+ * The check in native_mem_span_check is too far away from the end of a block's
+ * fast-path for an 8-bit jump, so the slow-path goes in between them:
+ *
+ *     check, jump to miss if it fails
+ *     jmp fast
+ * miss:
+ *     slow-path
+ *     jmp done
+ * fast:
+ *     fast-path
+ * done:
+ *
+ * Both paths have to leave the register allocator in the same state, so
+ * neither one can move slots around.  The stack also has to be aligned
+ * beforehand since aligning it moves rsp.
+ */
+struct block_fast_path {
+    struct x86asm_lbl8 miss;
+    void *skip_slow, *skip_fast;
+    bool active;
+};
+
+static void block_fast_path_begin(struct block_fast_path *fast,
+                                  struct mem_block_32_immed const *run) {
+    fast->active = false;
+    x86asm_lbl8_init(&fast->miss);
+    if (config_get_inline_mem()) {
+        emit_block_addr(run, jit_mem_block_32_lo(run), REG_ARG0);
+        fast->active = native_mem_span_check(run->map,
+                                             run->n_words * sizeof(uint32_t),
+                                             &fast->miss);
+    }
+    if (fast->active) {
+        fast->skip_slow = x86asm_get_out_ptr();
+        x86asm_jmpq_offs32(0);
+        x86asm_lbl8_define(&fast->miss);
+    }
+}
+
+// returns true if the fast-path should be emitted
+static bool block_fast_path_fast(struct block_fast_path *fast) {
+    if (fast->active) {
+        fast->skip_fast = x86asm_get_out_ptr();
+        x86asm_jmpq_offs32(0);
+        patch_jmp32_here(fast->skip_slow);
+    }
+    return fast->active;
+}
+
+static void block_fast_path_end(struct block_fast_path *fast) {
+    if (fast->active)
+        patch_jmp32_here(fast->skip_fast);
+    x86asm_lbl8_cleanup(&fast->miss);
+}
+
+// the slow-path for one word of a JIT_OP_READ_32_BLOCK; the word ends up in EAX
+static void emit_block_read_call(struct code_block_x86_64 *blk,
+                                 struct mem_block_32_immed const *run,
+                                 int offs) {
+    if (config_get_inline_mem()) {
+        emit_block_addr(run, offs, REG_ARG0);
+        native_mem_read_32_slow(blk, run->map);
+    } else {
+        emit_block_addr(run, offs, REG_ARG1);
+        x86asm_mov_imm64_reg64((uint64_t)run->map, REG_ARG0);
+        ms_shadow_open(blk);
+        x86_64_align_stack(blk);
+        native_dispatch_call_emit(memory_map_read_32);
+        ms_shadow_close();
+    }
+}
+
+// the slow-path for one word of a JIT_OP_WRITE_32_BLOCK
+static void emit_block_write_call(struct code_block_x86_64 *blk,
+                                  struct mem_block_32_immed const *run,
+                                  int offs, unsigned src_slot) {
+    if (config_get_inline_mem()) {
+        emit_block_addr(run, offs, REG_ARG0);
+        copy_slot_to_reg(src_slot, REG_ARG1);
+        native_mem_write_32_slow(blk, run->map);
+    } else {
+        emit_block_addr(run, offs, REG_ARG1);
+        copy_slot_to_reg(src_slot, REG_ARG2);
+        x86asm_mov_imm64_reg64((uint64_t)run->map, REG_ARG0);
+        ms_shadow_open(blk);
+        x86_64_align_stack(blk);
+        native_dispatch_call_emit(memory_map_write_32);
+        ms_shadow_close();
+    }
+}
+
+// JIT_OP_READ_32_BLOCK implementation
+static void emit_read_32_block(struct code_block_x86_64 *blk,
+                               struct il_code_block const *il_blk,
+                               void *cpu, struct jit_inst const *inst) {
+    struct mem_block_32_immed const *run = &inst->immed.read_32_block;
+    int lo = jit_mem_block_32_lo(run);
+    unsigned word;
+
+    /*
+     * The slow-path makes calls, so everything gets evicted from the volatile
+     * registers first.  After that the destination slots can go anywhere
+     * except the scratch registers because the slow-path keeps the words it
+     * reads on the stack until all of its calls are done.  The address slot
+     * stays wherever prefunc put it, which calls can't clobber.
+     */
+    prefunc(blk);
+    postfunc();
+    grab_register(&gen_reg_state.set, REG_ARG0);
+    grab_register(&gen_reg_state.set, REG_ARG1);
+    grab_register(&gen_reg_state.set, REG_ARG2);
+    grab_register(&gen_reg_state.set, REG_ARG3);
+    for (word = 0; word < run->n_words; word++)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, run->data_slot[word], 4);
+    x86_64_align_stack(blk);
+
+    struct block_fast_path fast;
+    block_fast_path_begin(&fast, run);
+
+    // somewhere to keep the words while the calls clobber their registers
+    x86asm_addq_imm8_reg(-16, RSP);
+    rsp_offs -= 16;
+    int stash = rsp_offs;
+    for (word = 0; word < run->n_words; word++) {
+        emit_block_read_call(blk, run, run->first + (int)word * run->stride);
+        emit_movl_reg_rbp(REG_RET, stash + 4 * (int)word);
+    }
+    for (word = 0; word < run->n_words; word++) {
+        emit_movl_rbp_reg(stash + 4 * (int)word,
+                          slots[run->data_slot[word]].reg_no);
+    }
+    x86asm_addq_imm8_reg(16, RSP);
+    rsp_offs += 16;
+
+    if (block_fast_path_fast(&fast)) {
+        for (word = 0; word < run->n_words; word++) {
+            x86asm_movl_disp8_reg_reg(run->first + (int)word * run->stride - lo,
+                                      REG_RET,
+                                      slots[run->data_slot[word]].reg_no);
+        }
+    }
+    block_fast_path_end(&fast);
+
+    for (word = 0; word < run->n_words; word++)
+        ungrab_slot(run->data_slot[word]);
+    ungrab_register(&gen_reg_state.set, REG_ARG3);
+    ungrab_register(&gen_reg_state.set, REG_ARG2);
+    ungrab_register(&gen_reg_state.set, REG_ARG1);
+    ungrab_register(&gen_reg_state.set, REG_ARG0);
+    ungrab_register(&gen_reg_state.set, REG_RET);
+}
+
+// JIT_OP_WRITE_32_BLOCK implementation
+static void emit_write_32_block(struct code_block_x86_64 *blk,
+                                struct il_code_block const *il_blk,
+                                void *cpu, struct jit_inst const *inst) {
+    struct mem_block_32_immed const *run = &inst->immed.write_32_block;
+    int lo = jit_mem_block_32_lo(run);
+    unsigned word;
+
+    /*
+     * after prefunc, all of the slots involved are somewhere calls can't
+     * clobber, so they can just be copied out as needed.
+     */
+    prefunc(blk);
+    x86_64_align_stack(blk);
+
+    struct block_fast_path fast;
+    block_fast_path_begin(&fast, run);
+
+    for (word = 0; word < run->n_words; word++) {
+        emit_block_write_call(blk, run, run->first + (int)word * run->stride,
+                              run->data_slot[word]);
+    }
+
+    if (block_fast_path_fast(&fast)) {
+        for (word = 0; word < run->n_words; word++) {
+            copy_slot_to_reg(run->data_slot[word], REG_ARG1);
+            x86asm_movl_reg_disp8_reg(REG_ARG1,
+                                      run->first + (int)word * run->stride - lo,
+                                      REG_RET);
+        }
+        native_mem_span_notify(blk, run->n_words * sizeof(uint32_t));
+    }
+    block_fast_path_end(&fast);
+
+    postfunc();
+    ungrab_register(&gen_reg_state.set, REG_RET);
+}
+
 static void
 emit_load_slot16(struct code_block_x86_64 *blk,
                  struct il_code_block const *il_blk,
@@ -2067,6 +2715,123 @@ static void emit_mul_u32(struct code_block_x86_64 *blk,
     ungrab_register(&gen_reg_state.set, REG_RET);
 }
 
+static void emit_mul_32_wide(struct code_block_x86_64 *blk,
+                             struct il_code_block const *il_blk,
+                             struct jit_inst const *inst,
+                             struct mul_wide_immed const *immed, bool sign) {
+    unsigned slot_lhs = immed->slot_lhs;
+    unsigned slot_rhs = immed->slot_rhs;
+    unsigned slot_hi = immed->slot_hi;
+    unsigned slot_lo = immed->slot_lo;
+
+    evict_register(blk, &gen_reg_state, REG_RET);
+    grab_register(&gen_reg_state.set, REG_RET);
+    evict_register(blk, &gen_reg_state, EDX);
+    grab_register(&gen_reg_state.set, EDX);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+
+    x86asm_mov_reg32_reg32(slots[slot_lhs].reg_no, REG_RET);
+    if (sign)
+        x86asm_imull_reg32(slots[slot_rhs].reg_no);
+    else
+        x86asm_mull_reg32(slots[slot_rhs].reg_no);
+
+    ungrab_slot(slot_rhs);
+    ungrab_slot(slot_lhs);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_hi, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lo, 4);
+
+#ifdef INVARIANTS
+    if (slots[slot_hi].reg_no == REG_RET || slots[slot_hi].reg_no == EDX ||
+        slots[slot_lo].reg_no == REG_RET || slots[slot_lo].reg_no == EDX)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    x86asm_mov_reg32_reg32(EDX, slots[slot_hi].reg_no);
+    x86asm_mov_reg32_reg32(REG_RET, slots[slot_lo].reg_no);
+
+    ungrab_slot(slot_lo);
+    ungrab_slot(slot_hi);
+    ungrab_register(&gen_reg_state.set, EDX);
+    ungrab_register(&gen_reg_state.set, REG_RET);
+}
+
+// JIT_OP_MUL_S32_WIDE implementation
+static void emit_mul_s32_wide(struct code_block_x86_64 *blk,
+                              struct il_code_block const *il_blk,
+                              void *cpu, struct jit_inst const *inst) {
+    emit_mul_32_wide(blk, il_blk, inst, &inst->immed.mul_s32_wide, true);
+}
+
+// JIT_OP_MUL_U32_WIDE implementation
+static void emit_mul_u32_wide(struct code_block_x86_64 *blk,
+                              struct il_code_block const *il_blk,
+                              void *cpu, struct jit_inst const *inst) {
+    emit_mul_32_wide(blk, il_blk, inst, &inst->immed.mul_u32_wide, false);
+}
+
+/*
+ * JIT_OP_MACL and JIT_OP_MACW implementation.
+ *
+ * The saturation logic is too branchy to be worth inlining, so this packs
+ * MACH:MACL into a 64-bit argument and calls the shared C helper.
+ */
+static void emit_mac(struct code_block_x86_64 *blk,
+                     struct il_code_block const *il_blk,
+                     struct jit_inst const *inst,
+                     struct mac_immed const *immed, void *helper) {
+    prefunc(blk);
+
+    move_slot_to_reg(blk, immed->slot_hi, REG_ARG0);
+    evict_register(blk, &gen_reg_state, REG_ARG0);
+    x86asm_sal_imm8_reg64(32, REG_ARG0);
+    move_slot_to_reg(blk, immed->slot_lo, REG_RET);
+    evict_register(blk, &gen_reg_state, REG_RET);
+    x86asm_or_reg64_reg64(REG_RET, REG_ARG0);
+
+    move_slot_to_reg(blk, immed->slot_lhs, REG_ARG1);
+    evict_register(blk, &gen_reg_state, REG_ARG1);
+    move_slot_to_reg(blk, immed->slot_rhs, REG_ARG2);
+    evict_register(blk, &gen_reg_state, REG_ARG2);
+    move_slot_to_reg(blk, immed->slot_sat, REG_ARG3);
+    evict_register(blk, &gen_reg_state, REG_ARG3);
+
+    ms_shadow_open(blk);
+    x86_64_align_stack(blk);
+    native_dispatch_call_emit(helper);
+    ms_shadow_close();
+
+    postfunc();
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, immed->slot_hi, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, immed->slot_lo, 4);
+
+    x86asm_mov_reg32_reg32(REG_RET, slots[immed->slot_lo].reg_no);
+    x86asm_shrq_imm8_reg64(32, REG_RET);
+    x86asm_mov_reg32_reg32(REG_RET, slots[immed->slot_hi].reg_no);
+
+    ungrab_slot(immed->slot_lo);
+    ungrab_slot(immed->slot_hi);
+    ungrab_register(&gen_reg_state.set, REG_RET);
+}
+
+// JIT_OP_MACL implementation
+static void emit_macl(struct code_block_x86_64 *blk,
+                      struct il_code_block const *il_blk,
+                      void *cpu, struct jit_inst const *inst) {
+    emit_mac(blk, il_blk, inst, &inst->immed.macl, jit_macl_accum);
+}
+
+// JIT_OP_MACW implementation
+static void emit_macw(struct code_block_x86_64 *blk,
+                      struct il_code_block const *il_blk,
+                      void *cpu, struct jit_inst const *inst) {
+    emit_mac(blk, il_blk, inst, &inst->immed.macw, jit_macw_accum);
+}
+
 static void emit_mul_float(struct code_block_x86_64 *blk,
                            struct il_code_block const *il_blk,
                            void *cpu, struct jit_inst const *inst) {
@@ -2181,7 +2946,7 @@ static void emit_read_float_slot(struct code_block_x86_64 *blk,
         evict_register(blk, &gen_reg_state, REG_ARG1);
         ms_shadow_open(blk);
         x86_64_align_stack(blk);
-        x86asm_call_ptr(memory_map_read_float);
+        native_dispatch_call_emit(memory_map_read_float);
         ms_shadow_close();
     }
 
@@ -2298,6 +3063,35 @@ emit_clear_float(struct code_block_x86_64 *blk,
     ungrab_slot(slot_dst);
 }
 
+static void emit_div_float(struct code_block_x86_64 *blk,
+                           struct il_code_block const *il_blk,
+                           void *cpu, struct jit_inst const *inst) {
+    unsigned slot_src = inst->immed.div_float.slot_src;
+    unsigned slot_dst = inst->immed.div_float.slot_dst;
+
+    grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_src, 4);
+    if (slot_src != slot_dst)
+        grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
+
+    x86asm_divss_xmm_xmm(slots[slot_src].reg_no, slots[slot_dst].reg_no);
+
+    if (slot_src != slot_dst)
+        ungrab_slot(slot_dst);
+    ungrab_slot(slot_src);
+}
+
+static void emit_sqrt_float(struct code_block_x86_64 *blk,
+                            struct il_code_block const *il_blk,
+                            void *cpu, struct jit_inst const *inst) {
+    unsigned slot_dst = inst->immed.sqrt_float.slot_dst;
+    grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
+
+    unsigned reg_dst = slots[slot_dst].reg_no;
+    x86asm_sqrtss_xmm_xmm(reg_dst, reg_dst);
+
+    ungrab_slot(slot_dst);
+}
+
 /*
  * pad the stack so that it is properly aligned for a function call.
  * At the beginning of the stack frame, the stack was aligned to a 16-byte
@@ -2345,6 +3139,42 @@ void ms_shadow_close(void) {
 #endif
 }
 
+void
+code_block_x86_64_compile_call(void *arg, struct code_block_x86_64 *out,
+                               code_block_x86_64_call_fn fn,
+                               uint32_t const *hashp, uint32_t const *cyclesp,
+                               struct native_dispatch_meta const *dispatch_meta) {
+    out->cycle_count = 0;
+    out->dirty_stack = false;
+
+    x86asm_set_dst(out->exec_mem_alloc_start, &out->bytes_used,
+                   X86_64_ALLOC_SIZE);
+
+    emit_stack_frame_open();
+
+    x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)arg, REG_ARG0);
+    x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)dispatch_meta, REG_ARG1);
+
+    ms_shadow_open(out);
+    x86_64_align_stack(out);
+    native_dispatch_call_emit((void*)fn);
+    ms_shadow_close();
+
+    x86asm_mov_reg32_reg32(REG_RET, NATIVE_DISPATCH_PC_REG);
+    x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)hashp,
+                           NATIVE_DISPATCH_HASH_REG);
+    x86asm_movl_disp8_reg_reg(0, NATIVE_DISPATCH_HASH_REG,
+                              NATIVE_DISPATCH_HASH_REG);
+    x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)cyclesp,
+                           NATIVE_DISPATCH_CYCLE_COUNT_REG);
+    x86asm_movl_disp8_reg_reg(0, NATIVE_DISPATCH_CYCLE_COUNT_REG,
+                              NATIVE_DISPATCH_CYCLE_COUNT_REG);
+
+    emit_stack_frame_close();
+
+    native_check_cycles_emit(dispatch_meta);
+}
+
 void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
                                struct il_code_block const *il_blk,
                                struct native_dispatch_meta const *dispatch_meta,
@@ -2358,6 +3188,12 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
                    X86_64_ALLOC_SIZE);
 
     reset_slots();
+    n_jumps = 0;
+    n_jump_targets = 0;
+    n_side_exits = 0;
+
+    analyze_slots(il_blk);
+    linear_scan(il_blk);
 
     emit_stack_frame_open();
 
@@ -2374,6 +3210,9 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_CSET:
             emit_cset(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_EXIT_COND:
+            emit_exit_cond(out, il_blk, cpu, inst);
+            break;
         case JIT_SET_SLOT:
             emit_set_slot(out, il_blk, cpu, inst);
             break;
@@ -2419,6 +3258,12 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_WRITE_FLOAT_SLOT:
             emit_write_float_slot(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_READ_32_BLOCK:
+            emit_read_32_block(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_WRITE_32_BLOCK:
+            emit_write_32_block(out, il_blk, cpu, inst);
+            break;
         case JIT_OP_LOAD_SLOT16:
             emit_load_slot16(out, il_blk, cpu, inst);
             break;
@@ -2542,14 +3387,53 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_CLEAR_FLOAT:
             emit_clear_float(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_DIV_FLOAT:
+            emit_div_float(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_SQRT_FLOAT:
+            emit_sqrt_float(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_MUL_S32_WIDE:
+            emit_mul_s32_wide(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_MUL_U32_WIDE:
+            emit_mul_u32_wide(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_MACL:
+            emit_macl(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_MACW:
+            emit_macw(out, il_blk, cpu, inst);
+            break;
         default:
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
         inst++;
     }
 
+    if (il_blk->idle_loop) {
+        /*
+         * the block spins in place until the next event, so zero the
+         * countdown when it loops back to itself.  That makes the cycle
+         * check go to return_fn, which moves the clock up to the target.
+         */
+        struct x86asm_lbl8 not_idle;
+        x86asm_lbl8_init(&not_idle);
+        x86asm_cmpl_imm32_reg32(il_blk->idle_pc, NATIVE_DISPATCH_PC_REG);
+        x86asm_jnz_lbl8(&not_idle);
+        x86asm_xorl_reg32_reg32(NATIVE_DISPATCH_COUNTDOWN_REG,
+                                NATIVE_DISPATCH_COUNTDOWN_REG);
+        x86asm_lbl8_define(&not_idle);
+        x86asm_lbl8_cleanup(&not_idle);
+    }
+
     x86asm_mov_imm32_reg32(out->cycle_count,
                            NATIVE_DISPATCH_CYCLE_COUNT_REG);
+    if (il_blk->dyn_cycles) {
+        x86asm_mov_imm64_reg64((uintptr_t)il_blk->dyn_cycles, REG_VOL0);
+        x86asm_mov_indreg32_reg32(REG_VOL0, REG_VOL0);
+        x86asm_addl_reg32_reg32(REG_VOL0, NATIVE_DISPATCH_CYCLE_COUNT_REG);
+    }
 
     if (out->dirty_stack) {
         emit_stack_frame_close();
@@ -2557,5 +3441,12 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         out->native = skip_stack_frame;
     }
 
-    native_check_cycles_emit(dispatch_meta);
+    if (n_jumps == 1 && n_jump_targets) {
+        native_check_cycles_link_emit(dispatch_meta, out, n_jump_targets,
+                                      jump_addr, jump_hash);
+    } else {
+        native_check_cycles_emit(dispatch_meta);
+    }
+
+    emit_side_exits(dispatch_meta);
 }
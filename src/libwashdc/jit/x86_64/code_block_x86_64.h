@@ -32,6 +32,7 @@
 
 struct il_code_block;
 struct native_dispatch_meta;
+struct native_link;
 
 struct code_block_x86_64 {
     /*
@@ -46,6 +47,21 @@ struct code_block_x86_64 {
     unsigned bytes_used;
 
     bool dirty_stack;
+
+    /*
+     * links is an array of the exits from this block which jump directly to
+     * other blocks (see native_dispatch.h).  links_in is a list of the exits
+     * from other blocks that are currently linked to this block.
+     */
+    struct native_link *links;
+    unsigned n_links;
+    struct native_link *links_in;
+
+    /*
+     * number of links out of/into this block which skip the cycle check (see
+     * native_dispatch.h).  A block can have one or the other but never both.
+     */
+    unsigned n_unchecked_out, n_unchecked_in;
 };
 
 void jit_x86_64_backend_init(void);
@@ -59,6 +75,20 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
                                struct native_dispatch_meta const *dispatch_meta,
                                unsigned cycle_count);
 
+typedef uint32_t(*code_block_x86_64_call_fn)(void*,
+                                             struct native_dispatch_meta const*);
+
+/*
+ * instead of compiling il, emit a block which calls fn(arg, dispatch_meta).
+ * fn returns the new PC, and it must leave the PC's hash in *hashp and the
+ * number of cycles it took in *cyclesp.
+ */
+void
+code_block_x86_64_compile_call(void *arg, struct code_block_x86_64 *out,
+                               code_block_x86_64_call_fn fn,
+                               uint32_t const *hashp, uint32_t const *cyclesp,
+                               struct native_dispatch_meta const *dispatch_meta);
+
 /*
  * if the stack is not 16-byte aligned, make it 16-byte aligned.
  * This way, when the CALL instruction is issued the stack will be off from
@@ -65,7 +65,7 @@ static void try_grow(void) {
 WASHDC_UNUSED
 static void put8(uint8_t val) {
     if (washdc_emitp_len >= 1) {
-        *washdc_emitp++ = val;
+        *(uint8_t*)exec_mem_rw(washdc_emitp++) = val;
         washdc_emitp_len--;
         if (n_bytes_out)
             *n_bytes_out += sizeof(uint8_t);
@@ -78,7 +78,7 @@ static void put8(uint8_t val) {
 WASHDC_UNUSED
 static void put16(uint16_t val) {
     if (washdc_emitp_len >= 2) {
-        memcpy(washdc_emitp, &val, sizeof(val));
+        memcpy(exec_mem_rw(washdc_emitp), &val, sizeof(val));
         washdc_emitp += 2;
         washdc_emitp_len -= 2;
         if (n_bytes_out)
@@ -92,7 +92,7 @@ static void put16(uint16_t val) {
 WASHDC_UNUSED
 static void put32(uint32_t val) {
     if (washdc_emitp_len >= 4) {
-        memcpy(washdc_emitp, &val, sizeof(val));
+        memcpy(exec_mem_rw(washdc_emitp), &val, sizeof(val));
         washdc_emitp += 4;
         washdc_emitp_len -= 4;
         if (n_bytes_out)
@@ -106,7 +106,7 @@ static void put32(uint32_t val) {
 WASHDC_UNUSED
 static void put64(uint64_t val) {
     if (washdc_emitp_len >= 8) {
-        memcpy(washdc_emitp, &val, sizeof(val));
+        memcpy(exec_mem_rw(washdc_emitp), &val, sizeof(val));
         washdc_emitp += 8;
         washdc_emitp_len -= 8;
         if (n_bytes_out)
@@ -437,14 +437,15 @@ void x86asm_mov_imm16_reg(unsigned imm16, unsigned reg_no) {
 
 void x86asm_mov_imm32_reg32(unsigned imm32, unsigned reg_no) {
     /*
-     * OPCODE: c7
-     * MOD: 3
-     * REG: 0
-     * R/M: register
+     * OPCODE: b8 + register
+     *
+     * this is one byte shorter than c7 /0 since there's no mod/reg/rm byte
      */
-
-    // literally just the 16-bit version without the prefix
-    emit_mod_reg_rm(0, 0xc7, 3, 0, reg_no);
+    if (reg_no >= R8) {
+        put8(0x40 | REX_B);
+        reg_no -= R8;
+    }
+    put8(0xb8 | reg_no);
     put32(imm32);
 }
 
@@ -460,6 +461,18 @@ void x86asm_sal_imm8_reg64(unsigned imm8, unsigned reg_no) {
     put8(imm8);
 }
 
+void x86asm_shrq_imm8_reg64(unsigned imm8, unsigned reg_no) {
+    /*
+     * PREFIX: 0x48 (64-bit operand REX)
+     * OPCODE: c1
+     * MOD: 3
+     * REG: 5
+     * R/M: register
+     */
+    emit_mod_reg_rm(REX_W, 0xc1, 3, 5, reg_no);
+    put8(imm8);
+}
+
 void x86asm_xor_reg64_reg64(unsigned reg_src, unsigned reg_dst) {
     /*
      * PREFIX: 0x48 (64-bit operand REX)
@@ -499,6 +512,21 @@ void x86asm_ret(void) {
 }
 
 void x86asm_mov_imm64_reg64(uint64_t imm64, unsigned reg_no) {
+    /*
+     * use the shortest encoding that gets the whole value into the register.
+     * 32-bit movs zero-extend, and c7 /0 with REX.W sign-extends.  Both are a
+     * lot shorter than the 10-byte movabs.
+     */
+    if (imm64 <= UINT32_MAX) {
+        x86asm_mov_imm32_reg32(imm64, reg_no);
+        return;
+    }
+    if ((int64_t)imm64 >= INT32_MIN && (int64_t)imm64 <= INT32_MAX) {
+        emit_mod_reg_rm(REX_W, 0xc7, 3, 0, reg_no);
+        put32((uint32_t)imm64);
+        return;
+    }
+
     unsigned rex = 0x40 | REX_W;
     if (reg_no >= R8) {
         reg_no -= R8;
@@ -1285,6 +1313,12 @@ void x86asm_jle_disp8(int disp8) {
     put8(disp8);
 }
 
+void x86asm_jle_disp32(uint32_t disp32) {
+    put8(0x0f);
+    put8(0x8e);
+    put32(disp32);
+}
+
 void x86asm_jle_lbl8(struct x86asm_lbl8 *lbl) {
     struct lbl_jmp_pt pt;
     put8(0x7e);
@@ -1425,7 +1459,7 @@ void x86asm_lbl8_define(struct x86asm_lbl8 *lbl) {
             RAISE_ERROR(ERROR_TOO_BIG);
         if (offs < INT8_MIN)
             RAISE_ERROR(ERROR_TOO_SMALL);
-        *pt->offs = offs;
+        *(int8_t*)exec_mem_rw(pt->offs) = offs;
     }
 }
 
@@ -1438,7 +1472,7 @@ void x86asm_lbl8_push_jmp_pt(struct x86asm_lbl8 *lbl,
             RAISE_ERROR(ERROR_TOO_BIG);
         if (offs < INT8_MIN)
             RAISE_ERROR(ERROR_TOO_SMALL);
-        *jmp_pt->offs = offs;
+        *(int8_t*)exec_mem_rw(jmp_pt->offs) = offs;
     } else {
         // save this jump point for when the label gets defined later
         if (lbl->n_jump_points >= MAX_LABEL_JUMPS)
@@ -1451,6 +1485,10 @@ void x86asm_mull_reg32(unsigned reg_no) {
     emit_mod_reg_rm(0, 0xf7, 3, 4, reg_no);
 }
 
+void x86asm_imull_reg32(unsigned reg_no) {
+    emit_mod_reg_rm(0, 0xf7, 3, 5, reg_no);
+}
+
 void x86asm_testl_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
     emit_mod_reg_rm(0, 0x85, 3, reg_src, reg_dst);
 }
@@ -1700,6 +1738,16 @@ void x86asm_addss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
     emit_mod_reg_rm_2(0, 0x0f, 0x58, 3, xmm_reg_dst, xmm_reg_src);
 }
 
+void x86asm_divss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf3);
+    emit_mod_reg_rm_2(0, 0x0f, 0x5e, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+void x86asm_sqrtss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf3);
+    emit_mod_reg_rm_2(0, 0x0f, 0x51, 3, xmm_reg_dst, xmm_reg_src);
+}
+
 // xorps %<xmm_reg_src>, %<xmm_reg_dst>
 void x86asm_xorps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
     put8(0x66);
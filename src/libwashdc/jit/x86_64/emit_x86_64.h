@@ -156,6 +156,9 @@ void x86asm_xorl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 
 void x86asm_sal_imm8_reg64(unsigned imm8, unsigned reg_no);
 
+// shrq $<imm8>, %reg_no
+void x86asm_shrq_imm8_reg64(unsigned imm8, unsigned reg_no);
+
 void x86asm_or_reg64_reg64(unsigned reg_src, unsigned reg_dst);
 
 // orl %<reg32>, %<reg32>
@@ -435,6 +438,7 @@ void x86asm_jl_lbl8(struct x86asm_lbl8 *lbl);
  * jump if less (signed)
  */
 void x86asm_jle_disp8(int disp8);
+void x86asm_jle_disp32(uint32_t disp32);
 void x86asm_jle_lbl8(struct x86asm_lbl8 *lbl);
 
 void x86asm_jmp_disp8(int disp8);
@@ -492,6 +496,9 @@ void* x86asm_get_outp(void);
  */
 void x86asm_mull_reg32(unsigned reg_no);
 
+// imull %reg_no - same as mull but signed
+void x86asm_imull_reg32(unsigned reg_no);
+
 void x86asm_testl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 void x86asm_testq_reg64_reg64(unsigned reg_src, unsigned reg_dst);
 
@@ -603,6 +610,12 @@ void x86asm_subss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
 // addss %<xmm_reg_src>, %<xmm_reg_dst>
 void x86asm_addss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
 
+// divss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_divss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// sqrtss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_sqrtss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
 // xorps %<xmm_reg_src>, %<xmm_reg_dst>
 void x86asm_xorps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
 
@@ -29,6 +29,9 @@
 #include <memoryapi.h>
 #else
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
 #endif
 
 #include <string.h>
@@ -36,28 +39,53 @@
 #include <stdbool.h>
 
 #include "log.h"
+#include "config.h"
 #include "washdc/error.h"
+#include "hostmem.h"
+#include "threading.h"
 
 #include "exec_mem.h"
 
 #define X86_64_ALLOC_SIZE (512 * 1024 * 1024)
 
+// executable view of the arena
 static void *native;
 
-#define FREE_CHUNK_MAGIC  0xca55e77e
-#define ALLOC_CHUNK_MAGIC 0xfeedface
+/*
+ * writable view of the arena.  Unless the arena is dual-mapped this is the
+ * same as native.
+ */
+static uint8_t *native_rw;
+static bool dual_map;
 
-#define MIN_FREE_CHUNK_SIZE sizeof(struct free_chunk)
+ptrdiff_t exec_mem_rw_offs;
 
-// this list should always be sorted from small addrs to large addrs
-static struct free_chunk {
-#ifdef INVARIANTS
-    unsigned magic;
-#endif
-    struct free_chunk *next;
-    struct free_chunk **pprev;
-    size_t len;
-} *free_mem;
+/*
+ * the background compiler allocates blocks on its own thread while the
+ * emulation thread frees them, so everything below goes through this lock.
+ */
+static washdc_mutex exec_mem_lock = WASHDC_MUTEX_STATIC_INIT;
+
+/*
+ * The arena is carved up into fixed-size segments.  Allocations get bumped
+ * linearly out of the current segment, and each segment keeps a count of its
+ * live allocations.  Once every allocation in a segment has been freed, the
+ * whole segment goes back onto the free list.  The code cache throws blocks
+ * away a generation at a time, so segments tend to empty out all at once.
+ */
+#define EXEC_MEM_SEG_SHIFT 22
+#define EXEC_MEM_SEG_SIZE ((size_t)1 << EXEC_MEM_SEG_SHIFT)
+#define EXEC_MEM_N_SEGS (X86_64_ALLOC_SIZE / EXEC_MEM_SEG_SIZE)
+
+/*
+ * exec_mem_grow can only grow the newest allocation in a segment, and it can't
+ * grow past the end of the segment.  exec_mem_alloc moves on to a new segment
+ * whenever there would be less than this much room left over so that the
+ * block being emitted always has space to grow.
+ */
+#define EXEC_MEM_SEG_HEADROOM (256 * 1024)
+
+#define ALLOC_CHUNK_MAGIC 0xfeedface
 
 struct alloc_chunk {
 #ifdef INVARIANTS
@@ -66,17 +94,169 @@ struct alloc_chunk {
     size_t len, len_req;
 };
 
+struct exec_mem_seg {
+    // offset of the first unused byte
+    size_t bump;
+
+    // number of allocations in this segment that haven't been freed yet
+    unsigned n_live;
+
+    // most recent allocation, or NULL if there isn't one that can grow
+    struct alloc_chunk *newest;
+
+    // next segment on the free list, or -1
+    int next_free;
+};
+
+static struct exec_mem_seg segs[EXEC_MEM_N_SEGS];
+static int free_segs;
+static unsigned free_seg_count;
+
+/*
+ * every lane has its own current segment, see exec_mem_set_lane.  cur_lane is
+ * the lane that the calling thread allocates out of.
+ */
+static int cur_seg[EXEC_MEM_N_LANES];
+static _Thread_local unsigned cur_lane;
+
 static size_t n_allocations;
-unsigned largest_alloc, smallest_alloc;
 
 /*
  * This returns a pointer to the true start of the allocation, which is its
  * struct alloc_chunk.
  */
 static void *get_alloc_start(void *alloc_ptr);
+static void get_stats_locked(struct exec_mem_stats *stats);
+
+static size_t alloc_hdr_len(void) {
+    size_t disp = sizeof(struct alloc_chunk);
+    while (disp % 8)
+        disp++;
+    return disp;
+}
+
+// length of an allocation including its header and padding
+static size_t alloc_full_len(size_t len_req) {
+    size_t len = len_req + alloc_hdr_len();
+    while (len % 8)
+        len++;
+    return len;
+}
+
+// all of the allocator's bookkeeping goes through the writable view
+static uint8_t *seg_base(int seg_no) {
+    return native_rw + ((size_t)seg_no << EXEC_MEM_SEG_SHIFT);
+}
+
+static int seg_of(void const *ptr) {
+    uintptr_t offs = (uintptr_t)ptr - (uintptr_t)native_rw;
+    if (offs >= X86_64_ALLOC_SIZE)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    return offs >> EXEC_MEM_SEG_SHIFT;
+}
+
+static void seg_reset(int seg_no) {
+    segs[seg_no].bump = 0;
+    segs[seg_no].newest = NULL;
+}
+
+static void seg_push_free(int seg_no) {
+    seg_reset(seg_no);
+    segs[seg_no].next_free = free_segs;
+    free_segs = seg_no;
+    free_seg_count++;
+}
+
+static bool seg_is_current(int seg_no) {
+    unsigned lane;
+    for (lane = 0; lane < EXEC_MEM_N_LANES; lane++)
+        if (cur_seg[lane] == seg_no)
+            return true;
+    return false;
+}
+
+// returns false if there are no free segments left
+static bool seg_advance(unsigned lane) {
+    if (free_segs < 0)
+        return false;
+
+    int old_seg = cur_seg[lane];
+    cur_seg[lane] = free_segs;
+    free_segs = segs[cur_seg[lane]].next_free;
+    free_seg_count--;
+    segs[cur_seg[lane]].next_free = -1;
+
+    /*
+     * if the old segment still has live allocations it gets put back on the
+     * free list when the last of them is freed.
+     */
+    if (!segs[old_seg].n_live)
+        seg_push_free(old_seg);
+
+    return true;
+}
+
+#ifndef _WIN32
+/*
+ * map the same shared memory object twice: once read/execute and once
+ * read/write.  The two views are placed back-to-back so that the writable view
+ * stays within reach of RIP-relative addressing from the executable view.
+ * Returns zero on success.
+ */
+static int exec_mem_map_dual(void) {
+    int fd;
+#ifdef __linux__
+    fd = memfd_create("washdc_exec_mem", MFD_CLOEXEC);
+#else
+    char name[64];
+    snprintf(name, sizeof(name), "/washdc_exec_mem_%ld", (long)getpid());
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+        shm_unlink(name);
+#endif
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, X86_64_ALLOC_SIZE) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    uint8_t *base = mmap(NULL, 2 * X86_64_ALLOC_SIZE, PROT_NONE,
+                         MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    void *rx = mmap(base, X86_64_ALLOC_SIZE, PROT_READ | PROT_EXEC,
+                    MAP_SHARED | MAP_FIXED, fd, 0);
+    void *rw = mmap(base + X86_64_ALLOC_SIZE, X86_64_ALLOC_SIZE,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);
+
+    if (rx == MAP_FAILED || rw == MAP_FAILED) {
+        munmap(base, 2 * X86_64_ALLOC_SIZE);
+        return -1;
+    }
+
+    hostmem_advise_huge(rx, X86_64_ALLOC_SIZE);
+    hostmem_advise_huge(rw, X86_64_ALLOC_SIZE);
+
+    native = rx;
+    native_rw = rw;
+    return 0;
+}
+#endif
 
 void exec_mem_init(void) {
+    dual_map = false;
+
 #ifdef _WIN32
+    if (config_get_jit_dual_map())
+        LOG_WARN("%s - dual-mapped jit memory is not supported on this "
+                 "platform\n", __func__);
+
     native = VirtualAlloc(NULL, X86_64_ALLOC_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
     if (!native)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
@@ -84,30 +264,63 @@ void exec_mem_init(void) {
     if (!VirtualProtect(native, X86_64_ALLOC_SIZE,
                         PAGE_EXECUTE_READWRITE, &garbage))
         RAISE_ERROR(ERROR_FAILED_ALLOC);
+    native_rw = native;
 #else
-    native = mmap(NULL, X86_64_ALLOC_SIZE, PROT_WRITE | PROT_EXEC | PROT_READ,
-                  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (native == MAP_FAILED)
+    if (!config_get_jit_dual_map()) {
+        native = mmap(NULL, X86_64_ALLOC_SIZE,
+                      PROT_WRITE | PROT_EXEC | PROT_READ,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (native != MAP_FAILED) {
+            native_rw = native;
+            hostmem_advise_huge(native, X86_64_ALLOC_SIZE);
+        } else {
+            // hardened kernels refuse mappings which are writable and executable
+            LOG_WARN("%s - unable to map W|X memory; falling back to a "
+                     "dual-mapped arena\n", __func__);
+            dual_map = true;
+        }
+    } else {
+        dual_map = true;
+    }
+
+    if (dual_map && exec_mem_map_dual() != 0)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
 #endif
 
-    free_mem = native;
-    free_mem->next = NULL;
-    free_mem->len = X86_64_ALLOC_SIZE;
-    free_mem->pprev = &free_mem;
+    exec_mem_rw_offs = native_rw - (uint8_t*)native;
 
-#ifdef INVARIANTS
-    free_mem->magic = FREE_CHUNK_MAGIC;
-#endif
+    memset(segs, 0, sizeof(segs));
+    n_allocations = 0;
+
+    free_segs = -1;
+    free_seg_count = 0;
+    int seg_no;
+    for (seg_no = 0; seg_no < EXEC_MEM_N_LANES; seg_no++) {
+        cur_seg[seg_no] = seg_no;
+        segs[seg_no].next_free = -1;
+    }
+    for (seg_no = EXEC_MEM_N_SEGS - 1; seg_no >= EXEC_MEM_N_LANES; seg_no--)
+        seg_push_free(seg_no);
+}
+
+void exec_mem_set_lane(unsigned lane) {
+    if (lane >= EXEC_MEM_N_LANES)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    cur_lane = lane;
 }
 
 void exec_mem_cleanup(void) {
 #ifdef _WIN32
     VirtualFree(native, 0, MEM_RELEASE);
 #else
-    munmap(native, X86_64_ALLOC_SIZE);
+    if (dual_map)
+        munmap(native, 2 * X86_64_ALLOC_SIZE);
+    else
+        munmap(native, X86_64_ALLOC_SIZE);
 #endif
     native = NULL;
+    native_rw = NULL;
+    exec_mem_rw_offs = 0;
 }
 
 /*
@@ -115,295 +328,93 @@ void exec_mem_cleanup(void) {
  * due to autism.  Strictly speaking, alignment is not needed on x86 but I like
  * it.
  */
-void* exec_mem_alloc(size_t len_req) {
-    struct free_chunk *curs;
-    struct free_chunk *candidate = NULL;
-    size_t len = len_req;
-
-    // add in metadata plus room for padding
-    len += sizeof(struct alloc_chunk) + 8;
-
-    // make sure the next chunk after the one we return is 8-byte aligned
-    while (len % 8)
-        len++;
-
-    /*
-     * pull off of the beginning of the largest available allocation.
-     * this way, reallocations are more likely to succeed.
-     */
-    for (curs = free_mem; curs; curs = curs->next) {
-#ifdef INVARIANTS
-        if (curs->magic != FREE_CHUNK_MAGIC) {
-            LOG_ERROR("%s - memory corruption detected at %p\n",
-                      __func__, curs);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-#endif
+static void *alloc_locked(size_t len_req) {
+    size_t len = alloc_full_len(len_req);
 
-        if (curs->len >= len) {
-            if (!candidate || curs->len > candidate->len)
-                candidate = curs;
-        }
-    }
-
-    if (!candidate) {
-        struct exec_mem_stats stats;
-        LOG_ERROR("%s - failed alloc of size %llu\n",
+    if (len + EXEC_MEM_SEG_HEADROOM > EXEC_MEM_SEG_SIZE) {
+        LOG_ERROR("%s - allocation of size %llu is too big\n",
                   __func__, (unsigned long long)len);
-        LOG_ERROR("exec_mem stats dump follows\n");
-        exec_mem_get_stats(&stats);
-        exec_mem_print_stats(&stats);
         return NULL;
     }
 
-    if (candidate->len == len) {
-        // easy case - just remove candidate from the pool
-        if (candidate->next)
-            candidate->next->pprev = candidate->pprev;
-        *candidate->pprev = candidate->next;
-    } else if (candidate->len - len < MIN_FREE_CHUNK_SIZE) {
-        /*
-         * remove the candidate from the pool and increase length because we
-         * can't possibly store another chunk after this.
-         */
-        len = candidate->len;
-        if (candidate->next)
-            candidate->next->pprev = candidate->pprev;
-        *candidate->pprev = candidate->next;
-    } else {
-        // split candidate allocation
-        struct free_chunk *new_chunk =
-            (struct free_chunk*)(((uint8_t*)candidate) + len/* sizeof(candidate) */);
-        new_chunk->next = candidate->next;
-        if (new_chunk->next)
-            new_chunk->next->pprev = &new_chunk->next;
-        new_chunk->pprev = candidate->pprev;
-        *new_chunk->pprev = new_chunk;
-        new_chunk->len = candidate->len - len;
-#ifdef INVARIANTS
-        new_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
+    unsigned lane = cur_lane;
+    struct exec_mem_seg *seg = segs + cur_seg[lane];
+    if (seg->bump + len + EXEC_MEM_SEG_HEADROOM > EXEC_MEM_SEG_SIZE) {
+        if (!seg_advance(lane)) {
+            struct exec_mem_stats stats;
+            LOG_ERROR("%s - failed alloc of size %llu\n",
+                      __func__, (unsigned long long)len);
+            LOG_ERROR("exec_mem stats dump follows\n");
+            get_stats_locked(&stats);
+            exec_mem_print_stats(&stats);
+            return NULL;
+        }
+        seg = segs + cur_seg[lane];
     }
 
-    struct alloc_chunk *chunk = (struct alloc_chunk*)(void*)candidate;
+    struct alloc_chunk *chunk =
+        (struct alloc_chunk*)(void*)(seg_base(cur_seg[lane]) + seg->bump);
+    seg->bump += len;
+    seg->n_live++;
+    seg->newest = chunk;
+
     chunk->len = len;
     chunk->len_req = len_req;
-
 #ifdef INVARIANTS
     chunk->magic = ALLOC_CHUNK_MAGIC;
 #endif
 
-    /*
-     * align the output.  This is safe to do because we reserved an extra
-     * 8 bytes earlier when we were determing the allocation length.
-     */
-    uintptr_t ret_ptr = (uintptr_t)(void*)candidate + sizeof(*chunk);
-    while (ret_ptr % 8)
-        ret_ptr++;
-
     n_allocations++;
 
-    void *ret = (void*)ret_ptr;
+    uint8_t *ret = ((uint8_t*)chunk) + alloc_hdr_len();
     memset(ret, 0, len_req);
-    return ret;
+    return ret - exec_mem_rw_offs;
 }
 
-void exec_mem_free(void *ptr) {
-    // match behavior of the libc free function by ignoring NULL
-    if (!ptr)
-        return;
-
-    void *alloc_start = get_alloc_start(ptr);
-    struct alloc_chunk *alloc = (struct alloc_chunk*)alloc_start;
-    struct free_chunk *free_chunk = (struct free_chunk*)alloc_start;
+void *exec_mem_alloc_data(size_t len_req) {
+    uint8_t *ret = exec_mem_alloc(len_req);
+    return ret ? exec_mem_rw(ret) : NULL;
+}
 
-    uintptr_t as_int = (uintptr_t)alloc_start;
+static void free_locked(void *ptr) {
+    struct alloc_chunk *alloc = (struct alloc_chunk*)get_alloc_start(ptr);
 
 #ifdef INVARIANTS
-    if (as_int % 8) {
-        LOG_ERROR("0x%08llx is not 8-byte aligned!\n", (long long)as_int);
+    if (((uintptr_t)alloc) % 8) {
+        LOG_ERROR("%p is not 8-byte aligned!\n", alloc);
         RAISE_ERROR(ERROR_INTEGRITY);
     }
-#endif
-
-#ifdef INVARIANTS
     if (alloc->magic != ALLOC_CHUNK_MAGIC) {
         LOG_ERROR("Corrupted alloc_chunk at %p\n", alloc);
         RAISE_ERROR(ERROR_INTEGRITY);
     }
+    alloc->magic = 0;
 #endif
 
-    size_t len = alloc->len;
+    int seg_no = seg_of(alloc);
+    struct exec_mem_seg *seg = segs + seg_no;
 
-    memset(free_chunk, 0, sizeof(*free_chunk));
-
-    if (!free_mem) {
-        // Oh wow, this is the only chunk.
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len;
-        free_chunk->pprev = &free_mem;
-        free_mem = free_chunk;
-        goto successful_free;
-    }
-
-    uintptr_t first_addr = as_int;
-    uintptr_t last_addr = first_addr + (len - 1);
-
-    uintptr_t free_mem_first = (uintptr_t)(void*)free_mem;
-    if ((free_mem_first - 1) > last_addr) {
-        // this is the new first chunk
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len;
-        free_chunk->pprev = &free_mem;
-        free_chunk->next = free_mem;
-        free_chunk->next->pprev = &free_chunk->next;
-        free_mem = free_chunk;
-        goto successful_free;
-    } else if ((free_mem_first - 1) == last_addr) {
-        // absorb free_mem into this chunk and make it the new free_mem
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len + free_mem->len;
-        free_chunk->next = free_mem->next;
-        if (free_chunk->next)
-            free_chunk->next->pprev = &free_chunk->next;
-        free_chunk->pprev = &free_mem;
-        free_mem = free_chunk;
-        goto successful_free;
-    }
-
-    struct free_chunk *curs, *pre = NULL, *post = NULL;
-    for (curs = free_mem; curs; curs = curs->next) {
-
-#ifdef INVARIANTS
-        if (curs->magic != FREE_CHUNK_MAGIC)
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-
-        struct free_chunk *next = curs->next;
-        if (next) {
-            uintptr_t next_first = (uintptr_t)(void*)next;
-            if (next_first > last_addr) {
-                pre = curs;
-                post = next;
-                break;
-            }
-        } else {
-            pre = curs;
-            post = NULL;
-            break;
-        }
-    }
-
-    if (!pre) {
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
-
-#ifdef INVARIANTS
-    if (pre->magic != FREE_CHUNK_MAGIC)
-        RAISE_ERROR(ERROR_INTEGRITY);
-    if (post && post->magic != FREE_CHUNK_MAGIC)
+    if (!seg->n_live)
         RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-
-    uintptr_t pre_first = (uintptr_t)(void*)pre;
-    uintptr_t pre_last = pre_first + (pre->len - 1);
-
-    if (post) {
-#ifdef INVARIANTS
-        if (post->pprev != &pre->next)
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-
-        // add the new free chunk inbetween pre and post
-        uintptr_t post_first = (uintptr_t)(void*)post;
-#ifdef INVARIANTS
-        uintptr_t post_last = post_first + (post->len - 1);
-
-        if (post_first <= last_addr) {
-            LOG_ERROR("pre range: 0x%08llx through 0x%08llx\n",
-                      (unsigned long long)pre_first,
-                      (unsigned long long)pre_last);
-            LOG_ERROR("new chunk: 0x%08llx through 0x%08llx\n",
-                      (unsigned long long)first_addr,
-                      (unsigned long long)last_addr);
-            LOG_ERROR("post range: 0x%08llx through 0x%08llx\n",
-                      (unsigned long long)post_first,
-                      (unsigned long long)post_last);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-#endif
 
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len;
-
-        if ((first_addr - 1) == pre_last) {
-            // absorb free_chunk into pre
-            pre->len += len;
-            free_chunk = pre;
-        } else {
-            // build a link from pre to free_chunk
-            pre->next = free_chunk;
-            free_chunk->pprev = &pre->next;
-        }
-
-        if ((post_first - 1) == last_addr) {
-            // absorb post into free_chunk
-            free_chunk->next = post->next;
-            if (free_chunk->next)
-                free_chunk->next->pprev = &free_chunk->next;
-            free_chunk->len += post->len;
-        } else {
-            // build a link from free_chunk to post
-            free_chunk->next = post;
-            post->pprev = &free_chunk->next;
-        }
-
-        goto successful_free;
-    } else if ((first_addr - 1) == pre_last) {
-        // this is easy, abosrb free_chunk into pre
-        // pre is the last chunk, and it will continue to be the last chunk
-        pre->len += len;
-        goto successful_free;
-    } else {
-        // free_chunk is the new last chunk
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len;
-        free_chunk->next = NULL;
-        free_chunk->pprev = &pre->next;
-        pre->next = free_chunk;
-        goto successful_free;
+    if (seg->newest == alloc) {
+        // give the tail back so it can be reused right away
+        seg->bump -= alloc->len;
+        seg->newest = NULL;
     }
 
-    RAISE_ERROR(ERROR_INTEGRITY);
+    if (!--seg->n_live) {
+        if (seg_is_current(seg_no))
+            seg_reset(seg_no);
+        else
+            seg_push_free(seg_no);
+    }
 
-successful_free:
     n_allocations--;
 }
 
-int exec_mem_grow(void *ptr, size_t len_req) {
+static int grow_locked(void *ptr, size_t len_req) {
     struct alloc_chunk *alloc = (struct alloc_chunk*)get_alloc_start(ptr);
-    uintptr_t alloc_first = (uintptr_t)alloc;
-    uintptr_t alloc_last = alloc_first + (alloc->len - 1);
-
-    /*
-     * len_req_aligned represents the size of the allocation post-growth
-     * including the size of the struct alloc_chunk and any necessary padding.
-     */
-    size_t grow_amt = len_req - alloc->len_req;
-    size_t len_req_aligned = alloc->len + grow_amt;
-    while (len_req_aligned % 8)
-        len_req_aligned++;
-    uintptr_t alloc_goal = alloc_first + len_req_aligned - 1;
 
 #ifdef INVARIANTS
     if (alloc->magic != ALLOC_CHUNK_MAGIC)
@@ -413,116 +424,55 @@ int exec_mem_grow(void *ptr, size_t len_req) {
     if (alloc->len_req >= len_req)
         return 0; // nothing to do here, i suppose
 
-    struct free_chunk *curs;
-    for (curs = free_mem; curs; curs = curs->next) {
-        uintptr_t curs_first = (uintptr_t)curs;
-        uintptr_t curs_last = curs_first + (curs->len - 1);
+    int seg_no = seg_of(alloc);
+    struct exec_mem_seg *seg = segs + seg_no;
 
-#ifdef INVARIANTS
-        // make sure the allocation doesn't overlap with the free chunk
-        if ((alloc_first >= curs_first && alloc_first <= curs_last) ||
-            (alloc_last >= curs_first && alloc_last <= curs_last))
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    // something else has already been allocated after this
+    if (seg->newest != alloc)
+        return -1;
 
-#ifdef INVARIANTS
-        if (curs->magic != FREE_CHUNK_MAGIC)
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    size_t offs = ((uint8_t*)alloc) - seg_base(seg_no);
+    size_t len = alloc_full_len(len_req);
+    if (offs + len > EXEC_MEM_SEG_SIZE)
+        return -1;
 
-        if ((curs_first - 1) == alloc_last) {
-            if (alloc_goal <= curs_last) {
-#ifdef INVARIANTS
-                if (*curs->pprev != curs)
-                    RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    seg->bump = offs + len;
+    alloc->len = len;
+    alloc->len_req = len_req;
 
-                // we can do it!
-                if (alloc->len - len_req_aligned + curs->len <
-                    MIN_FREE_CHUNK_SIZE) {
-                    // take the entire chunk
-                    if (curs->next)
-                        curs->next->pprev = curs->pprev;
-                    *curs->pprev = curs->next;
-                    alloc->len += curs->len;
-                    memset(curs, 0, sizeof(*curs));
-                    alloc->len_req = len_req;
-#ifdef INVARIANTS
-                    if (curs == free_mem)
-                        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-                    return 0;
-                } else {
-                    // split curs
-                    struct free_chunk *new_chunk =
-                        (struct free_chunk*)(void*)(alloc_goal + 1);
-                    memset(new_chunk, 0xaa, sizeof(*new_chunk));
-#ifdef INVARIANTS
-                    new_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-                    new_chunk->pprev = curs->pprev;
-                    *new_chunk->pprev = new_chunk;
-                    new_chunk->next = curs->next;
-                    if (new_chunk->next)
-                        new_chunk->next->pprev = &new_chunk->next;
-                    new_chunk->len = curs_last - (alloc_goal + 1) + 1;
-                    alloc->len_req = len_req;
-                    alloc->len = alloc_goal - alloc_first + 1;
-#ifdef INVARIANTS
-                    if (curs == free_mem)
-                        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-                    return 0;
-                }
-            } else {
-                /*
-                 * exec_mem_free always merges adjacent regions when it is
-                 * possible to do so.  This means that if curs isn't big enough
-                 * to grow the allocation, then it cannot be done.
-                 */
-                return -1;
-            }
-        } else if (curs_first > alloc_last) {
-            /*
-             * memory is too fragmented, the byte immediately following the
-             * allocation is already taken.
-             */
-            return -1;
-        }
-    }
-
-    return -1;
+    return 0;
 }
 
 static void *get_alloc_start(void *alloc_ptr) {
-    uintptr_t as_int = (uintptr_t)alloc_ptr;
+    uint8_t *as_rw = (uint8_t*)alloc_ptr;
+
+    // pointers from exec_mem_alloc_data are already in the writable view
+    if (as_rw < native_rw || as_rw >= native_rw + X86_64_ALLOC_SIZE)
+        as_rw += exec_mem_rw_offs;
 
     /*
-     * as_int will be aligned to eight bytes.
+     * alloc_ptr will be aligned to eight bytes.
      * the alloc_chunk will begin before that at the first 8-byte boundary
-     * which has enough space between it and as_int to hold alloc_chunk.
+     * which has enough space between it and alloc_ptr to hold alloc_chunk.
      */
-    size_t disp = sizeof(struct alloc_chunk);
-    while (disp % 8)
-        disp++;
-    as_int -= disp;
-
-    return (void*)as_int;
+    return as_rw - alloc_hdr_len();
 }
 
-void exec_mem_get_stats(struct exec_mem_stats *stats) {
+static void get_stats_locked(struct exec_mem_stats *stats) {
     size_t n_bytes = 0;
-    unsigned n_free_chunks = 0;
-    struct free_chunk *curs;
-    for (curs = free_mem; curs; curs = curs->next) {
-        n_bytes += curs->len;
-        n_free_chunks++;
+    unsigned n_free_segs = 0;
+    int seg_no;
+    for (seg_no = 0; seg_no < EXEC_MEM_N_SEGS; seg_no++) {
+        n_bytes += EXEC_MEM_SEG_SIZE - segs[seg_no].bump;
+        if (!segs[seg_no].n_live)
+            n_free_segs++;
     }
 
     stats->total_bytes = X86_64_ALLOC_SIZE;
     stats->free_bytes = n_bytes;
     stats->n_allocations = n_allocations;
-    stats->n_free_chunks = n_free_chunks;
+    stats->n_free_segs = n_free_segs;
+    stats->n_segs = EXEC_MEM_N_SEGS;
 }
 
 void exec_mem_print_stats(struct exec_mem_stats const *stats) {
@@ -535,47 +485,99 @@ void exec_mem_print_stats(struct exec_mem_stats const *stats) {
              percent);
     LOG_INFO("exec_mem: There are %u active allocations\n",
              stats->n_allocations);
-    LOG_INFO("exec_mem: There are %u total free chunks\n", stats->n_free_chunks);
+    LOG_INFO("exec_mem: %u out of %u segments are empty\n",
+             stats->n_free_segs, stats->n_segs);
 }
 
 #ifdef INVARIANTS
-void exec_mem_check_integrity(void) {
-    struct free_chunk *curs;
-    for (curs = free_mem; curs->next; curs = curs->next) {
-        struct free_chunk *next = curs->next;
-        uintptr_t curs_first = (uintptr_t)curs;
-        uintptr_t curs_last = curs_first + (curs->len - 1);
-        uintptr_t next_first = (uintptr_t)next;
-
-        if (next_first - 1 == curs_last) {
-            LOG_ERROR("exec_mem: needless memory fragmentation\n");
+static void check_integrity_locked(void) {
+    static bool on_free_list[EXEC_MEM_N_SEGS];
+    memset(on_free_list, 0, sizeof(on_free_list));
+
+    int seg_no;
+    for (seg_no = free_segs; seg_no >= 0; seg_no = segs[seg_no].next_free) {
+        if (seg_no >= EXEC_MEM_N_SEGS || on_free_list[seg_no] ||
+            seg_is_current(seg_no)) {
+            LOG_ERROR("exec_mem: corrupted segment free list\n");
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+        on_free_list[seg_no] = true;
+    }
+
+    size_t n_live = 0;
+    for (seg_no = 0; seg_no < EXEC_MEM_N_SEGS; seg_no++) {
+        struct exec_mem_seg const *seg = segs + seg_no;
+
+        if (seg->bump > EXEC_MEM_SEG_SIZE) {
+            LOG_ERROR("exec_mem: segment %d overflowed\n", seg_no);
             RAISE_ERROR(ERROR_INTEGRITY);
         }
 
-        struct free_chunk *curs2;
-        for (curs2 = next; curs2; curs2 = curs2->next) {
-            uintptr_t curs2_first = (uintptr_t)curs2;
-            uintptr_t curs2_last = curs2_first + (curs2->len - 1);
-
-            if (curs2_first <= curs_last || curs2_last <= curs_last) {
-                LOG_ERROR("exec_mem: out-of-order memory chunks\n");
-                LOG_ERROR("[0x%08llx-0x%08llx] should not come after "
-                          "[0x%08llx-0x%08llx]\n",
-                          (long long)curs_first, (long long)curs_last,
-                          (long long)curs2_first, (long long)curs2_last);
-                RAISE_ERROR(ERROR_INTEGRITY);
-            }
-
-            if ((curs_first >= curs2_first && curs_first <= curs2_last) ||
-                (curs_last >= curs2_first && curs_last <= curs2_first)) {
-                LOG_ERROR("exec_mem: memory overlap\n");
-                LOG_ERROR("[0x%08llx-0x%08llx] overlaps with "
-                          "[0x%08llx-0x%08llx]\n",
-                          (long long)curs_first, (long long)curs_last,
-                          (long long)curs2_first, (long long)curs2_last);
-                RAISE_ERROR(ERROR_INTEGRITY);
-            }
+        if (on_free_list[seg_no] && (seg->n_live || seg->bump)) {
+            LOG_ERROR("exec_mem: segment %d is on the free list but it is "
+                      "still in use\n", seg_no);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        if (!on_free_list[seg_no] && !seg_is_current(seg_no) &&
+            !seg->n_live) {
+            LOG_ERROR("exec_mem: segment %d leaked\n", seg_no);
+            RAISE_ERROR(ERROR_INTEGRITY);
         }
+
+        n_live += seg->n_live;
+    }
+
+    if (n_live != n_allocations) {
+        LOG_ERROR("exec_mem: %llu allocations but segments count %llu\n",
+                  (unsigned long long)n_allocations,
+                  (unsigned long long)n_live);
+        RAISE_ERROR(ERROR_INTEGRITY);
     }
 }
 #endif
+
+void *exec_mem_alloc(size_t len_req) {
+    washdc_mutex_lock(&exec_mem_lock);
+    void *ret = alloc_locked(len_req);
+    washdc_mutex_unlock(&exec_mem_lock);
+    return ret;
+}
+
+void exec_mem_free(void *ptr) {
+    // match behavior of the libc free function by ignoring NULL
+    if (!ptr)
+        return;
+
+    washdc_mutex_lock(&exec_mem_lock);
+    free_locked(ptr);
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+
+int exec_mem_grow(void *ptr, size_t len_req) {
+    washdc_mutex_lock(&exec_mem_lock);
+    int ret = grow_locked(ptr, len_req);
+    washdc_mutex_unlock(&exec_mem_lock);
+    return ret;
+}
+
+bool exec_mem_low(void) {
+    washdc_mutex_lock(&exec_mem_lock);
+    bool low = free_seg_count < EXEC_MEM_N_SEGS / 8;
+    washdc_mutex_unlock(&exec_mem_lock);
+    return low;
+}
+
+void exec_mem_get_stats(struct exec_mem_stats *stats) {
+    washdc_mutex_lock(&exec_mem_lock);
+    get_stats_locked(stats);
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+
+#ifdef INVARIANTS
+void exec_mem_check_integrity(void) {
+    washdc_mutex_lock(&exec_mem_lock);
+    check_integrity_locked();
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+#endif
@@ -28,13 +28,53 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 void exec_mem_init(void);
 void exec_mem_cleanup(void);
 
+/*
+ * Each lane bumps allocations out of its own segment, so a thread that only
+ * allocates out of its own lane always owns the newest allocation in that
+ * segment and can keep growing it while another thread allocates out of a
+ * different lane.  exec_mem_set_lane selects the lane for the calling thread;
+ * every thread starts out on EXEC_MEM_LANE_MAIN.
+ */
+#define EXEC_MEM_LANE_MAIN 0
+#define EXEC_MEM_LANE_BG 1
+#define EXEC_MEM_N_LANES 2
+
+void exec_mem_set_lane(unsigned lane);
+
+/*
+ * exec_mem_alloc returns a pointer into the executable view of the arena.
+ * Anything that writes to that memory needs to go through exec_mem_rw.
+ */
 void *exec_mem_alloc(size_t len_req);
+
+/*
+ * this returns a pointer into the writable view of the arena.  It's meant for
+ * data which jit code accesses with RIP-relative addressing.  The pointer can
+ * be passed to exec_mem_free.
+ */
+void *exec_mem_alloc_data(size_t len_req);
+
 void exec_mem_free(void *ptr);
 
+/*
+ * When the arena is dual-mapped (because the host won't allow memory which is
+ * both writable and executable), code is executed from one view and written
+ * through a second view at a fixed offset from the first.  Otherwise the
+ * offset is zero.
+ */
+extern ptrdiff_t exec_mem_rw_offs;
+
+// return the writable alias of a pointer into the executable view
+static inline void *exec_mem_rw(void const *ptr) {
+    return ((uint8_t*)ptr) + exec_mem_rw_offs;
+}
+
 /*
  * attempt to grow the given allocation to the given size.  This funciton
  * returns zero on success and nonzero on failure.
@@ -43,12 +83,11 @@ void exec_mem_free(void *ptr);
  * allocator is designed for executable code, and moving an allocation could
  * damage existing pointers and offsets; that is why this function can call.
  *
- * For best results, only attempt to grow the latest allocation.  The allocator
- * used by exec_mem_alloc will always pick an allocation at the beginning of the
- * largest contiguous area of memory; this means that growing the most recent
- * allocation will have a high probability of success, but growing older
- * allocations will have a high probability of failure.  I don't think the JIT
- * will ever have a good reason to grow an old allocation, anyways.
+ * Only the latest allocation can be grown.  exec_mem_alloc bumps allocations
+ * out of fixed-size segments, and it always leaves enough room at the end of
+ * the segment for the most recent allocation to grow into.  Growing an older
+ * allocation will always fail.  I don't think the JIT will ever have a good
+ * reason to grow an old allocation, anyways.
  */
 int exec_mem_grow(void *ptr, size_t len_req);
 
@@ -56,18 +95,26 @@ struct exec_mem_stats {
     size_t free_bytes;
     size_t total_bytes;
     unsigned n_allocations;
-    unsigned n_free_chunks;
+    unsigned n_free_segs, n_segs;
 };
 
 void exec_mem_get_stats(struct exec_mem_stats *stats);
+
+/*
+ * true once fewer than an eighth of the arena's segments are free.  Freed
+ * blocks don't come back until the next code_cache_gc, so the code cache uses
+ * this to start over before the arena actually runs dry.
+ */
+bool exec_mem_low(void);
 void exec_mem_print_stats(struct exec_mem_stats const *stats);
 
 #ifdef INVARIANTS
 /*
- * This checks to make sure no blocks overlap each other, and there is no
- * needless fragmentation.  It cannot check for "dangling pointer" situations
- * where some memory allocation that another component thinks is not free
- * actually is.  It also cannot prove there are no memory leaks.
+ * This checks to make sure the segment free list is sane, no segment has
+ * overflowed and every empty segment is either current or on the free list.
+ * It cannot check for "dangling pointer" situations where some memory
+ * allocation that another component thinks is not free actually is.  It also
+ * cannot prove there are no memory leaks.
  */
 void exec_mem_check_integrity(void);
 #endif
@@ -0,0 +1,362 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_JIT_X86_64
+#error this file should not be built when the x86_64 JIT backend is disabled
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "log.h"
+#include "washdc/error.h"
+#include "exec_mem.h"
+#include "hostmem.h"
+
+#include "fastmem.h"
+
+#define FASTMEM_SIZE (((uint64_t)1) << 32)
+
+// this needs to be a power of two
+#define FASTMEM_SITES_MIN 1024
+
+struct fastmem_site {
+    void *fault_pc, *patch_pc, *slow_path;
+};
+
+struct memory_map const *fastmem_map;
+uint8_t *fastmem_base;
+
+#ifdef __linux__
+
+/*
+ * open-addressed hash table of every access the jit has emitted, keyed by
+ * fault_pc.  Entries never get removed; when a block gets freed and its
+ * memory is reused, the new block's accesses replace the old ones.  An entry
+ * whose code has been freed is harmless because only fastmem accesses can
+ * fault inside the reservation.
+ */
+static struct fastmem_site *sites;
+static unsigned n_sites, sites_alloc;
+
+static void *ram_ptr;
+static size_t ram_len;
+static int ram_fd = -1;
+
+static struct sigaction old_segv_action;
+static bool handler_installed;
+
+static unsigned site_hash(void const *pc) {
+    uintptr_t val = (uintptr_t)pc;
+    val ^= val >> 17;
+    val *= 0xed5ad4bb;
+    val ^= val >> 11;
+    return (unsigned)val;
+}
+
+static struct fastmem_site *find_site(void const *pc) {
+    if (!sites_alloc)
+        return NULL;
+
+    unsigned mask = sites_alloc - 1;
+    unsigned idx = site_hash(pc) & mask;
+    while (sites[idx].fault_pc) {
+        if (sites[idx].fault_pc == pc)
+            return sites + idx;
+        idx = (idx + 1) & mask;
+    }
+    return NULL;
+}
+
+static void insert_site(struct fastmem_site const *site) {
+    unsigned mask = sites_alloc - 1;
+    unsigned idx = site_hash(site->fault_pc) & mask;
+    while (sites[idx].fault_pc && sites[idx].fault_pc != site->fault_pc)
+        idx = (idx + 1) & mask;
+    if (!sites[idx].fault_pc)
+        n_sites++;
+    sites[idx] = *site;
+}
+
+static void grow_sites(void) {
+    struct fastmem_site *old_sites = sites;
+    unsigned old_alloc = sites_alloc;
+    unsigned new_alloc = sites_alloc ? sites_alloc * 2 : FASTMEM_SITES_MIN;
+
+    struct fastmem_site *new_sites =
+        (struct fastmem_site*)calloc(new_alloc, sizeof(struct fastmem_site));
+    if (!new_sites)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    sites = new_sites;
+    sites_alloc = new_alloc;
+    n_sites = 0;
+
+    unsigned idx;
+    for (idx = 0; idx < old_alloc; idx++)
+        if (old_sites[idx].fault_pc)
+            insert_site(old_sites + idx);
+    free(old_sites);
+}
+
+void fastmem_add_site(void *patch_pc, void *fault_pc, void *slow_path) {
+    if ((n_sites + 1) * 2 > sites_alloc)
+        grow_sites();
+
+    struct fastmem_site site = {
+        .fault_pc = fault_pc,
+        .patch_pc = patch_pc,
+        .slow_path = slow_path
+    };
+    insert_site(&site);
+}
+
+static void fastmem_on_segv(int sig, siginfo_t *info, void *ctxt) {
+    ucontext_t *uc = (ucontext_t*)ctxt;
+    uint8_t const *addr = (uint8_t const*)info->si_addr;
+
+    if (fastmem_base && addr >= fastmem_base &&
+        addr < fastmem_base + FASTMEM_SIZE) {
+        struct fastmem_site const *site =
+            find_site((void*)uc->uc_mcontext.gregs[REG_RIP]);
+        if (site) {
+            /*
+             * replace the access with a jmp to the slow-path so that this site
+             * never faults again.
+             */
+            uint8_t *patch = (uint8_t*)exec_mem_rw(site->patch_pc);
+            int32_t disp = (uint8_t*)site->slow_path -
+                ((uint8_t*)site->patch_pc + 5);
+            patch[0] = 0xe9;
+            memcpy(patch + 1, &disp, sizeof(disp));
+
+            uc->uc_mcontext.gregs[REG_RIP] = (greg_t)site->slow_path;
+            return;
+        }
+    }
+
+    // not ours
+    if (old_segv_action.sa_flags & SA_SIGINFO) {
+        old_segv_action.sa_sigaction(sig, info, ctxt);
+    } else if (old_segv_action.sa_handler == SIG_DFL ||
+               old_segv_action.sa_handler == SIG_IGN) {
+        // put the old handler back and let the fault happen again
+        sigaction(SIGSEGV, &old_segv_action, NULL);
+        handler_installed = false;
+    } else {
+        old_segv_action.sa_handler(sig);
+    }
+}
+
+void *fastmem_alloc_ram(size_t len) {
+    if (ram_ptr)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    int fd = memfd_create("washdc_fastmem", MFD_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    if (ftruncate(fd, len) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    hostmem_advise_huge(ptr, len);
+
+    ram_ptr = ptr;
+    ram_len = len;
+    ram_fd = fd;
+    return ptr;
+}
+
+void fastmem_free_ram(void *ram) {
+    if (ram != ram_ptr)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    munmap(ram_ptr, ram_len);
+    close(ram_fd);
+    ram_ptr = NULL;
+    ram_len = 0;
+    ram_fd = -1;
+}
+
+// returns true if every page from addr to addr + len - 1 belongs to region
+static bool
+range_in_region(struct memory_map const *map,
+                struct memory_map_region const *region,
+                uint64_t addr, uint64_t len) {
+    uint64_t page;
+    for (page = addr; page < addr + len; page += MEMORY_MAP_PAGE_SIZE) {
+        if (memory_map_get_region((struct memory_map*)map, page,
+                                  MEMORY_MAP_PAGE_SIZE) != region)
+            return false;
+    }
+    return true;
+}
+
+static unsigned
+map_region(struct memory_map const *map,
+           struct memory_map_region const *region) {
+    uint64_t size = (uint64_t)region->mask + 1;
+    uint64_t first = region->first_addr, last = region->last_addr;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if ((size & (MEMORY_MAP_PAGE_SIZE - 1)) || (size % page_size) ||
+        size > ram_len || (first & region->mask) ||
+        ((last - first + 1) % size)) {
+        LOG_WARN("%s - unable to map region %08X-%08X\n",
+                 __func__, (unsigned)first, (unsigned)last);
+        return 0;
+    }
+
+    // the region also shows up wherever the bits outside range_mask are set
+    uint32_t mirror_bits = ~region->range_mask;
+    uint32_t mirror = 0;
+    unsigned n_mapped = 0;
+    do {
+        uint64_t chunk;
+        for (chunk = first; chunk <= last; chunk += size) {
+            uint64_t addr = chunk | mirror;
+            if (!range_in_region(map, region, addr, size))
+                continue;
+            void *ptr = mmap(fastmem_base + addr, size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_FIXED, ram_fd, 0);
+            if (ptr == MAP_FAILED)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            hostmem_advise_huge(ptr, size);
+            n_mapped++;
+        }
+        mirror = (mirror - mirror_bits) & mirror_bits;
+    } while (mirror);
+
+    return n_mapped;
+}
+
+bool fastmem_init(struct memory_map const *map) {
+    if (!ram_ptr) {
+        LOG_WARN("%s - RAM is not in shared memory; fastmem will not be "
+                 "used\n", __func__);
+        return false;
+    }
+
+    /*
+     * the reservation is aligned to a huge page so that the views of RAM in
+     * it can be backed by huge pages.
+     */
+    uint64_t const rsv_len = FASTMEM_SIZE + HOSTMEM_HUGE_PAGE_SIZE;
+    void *rsv = mmap(NULL, rsv_len, PROT_NONE,
+                     MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    if (rsv == MAP_FAILED) {
+        LOG_WARN("%s - unable to reserve address space for fastmem\n",
+                 __func__);
+        return false;
+    }
+    uint8_t *base = (uint8_t*)(((uintptr_t)rsv + HOSTMEM_HUGE_PAGE_SIZE - 1) &
+                               ~(uintptr_t)(HOSTMEM_HUGE_PAGE_SIZE - 1));
+    uint64_t head = base - (uint8_t*)rsv;
+    if (head)
+        munmap(rsv, head);
+    if (rsv_len - head - FASTMEM_SIZE)
+        munmap(base + FASTMEM_SIZE, rsv_len - head - FASTMEM_SIZE);
+    fastmem_base = base;
+
+    unsigned region_no, n_mapped = 0;
+    for (region_no = 0; region_no < map->n_regions; region_no++) {
+        struct memory_map_region const *region = map->regions + region_no;
+        if (region->host && region->host == ram_ptr)
+            n_mapped += map_region(map, region);
+    }
+
+    if (!n_mapped) {
+        fastmem_cleanup();
+        return false;
+    }
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = fastmem_on_segv;
+    act.sa_flags = SA_SIGINFO;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGSEGV, &act, &old_segv_action) != 0) {
+        fastmem_cleanup();
+        return false;
+    }
+    handler_installed = true;
+
+    fastmem_map = map;
+    LOG_INFO("fastmem enabled (%u mappings)\n", n_mapped);
+    return true;
+}
+
+void fastmem_cleanup(void) {
+    if (handler_installed) {
+        sigaction(SIGSEGV, &old_segv_action, NULL);
+        handler_installed = false;
+    }
+
+    if (fastmem_base)
+        munmap(fastmem_base, FASTMEM_SIZE);
+    fastmem_base = NULL;
+    fastmem_map = NULL;
+
+    free(sites);
+    sites = NULL;
+    n_sites = sites_alloc = 0;
+}
+
+#else
+
+void *fastmem_alloc_ram(size_t len) {
+    return NULL;
+}
+
+void fastmem_free_ram(void *ram) {
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
+
+bool fastmem_init(struct memory_map const *map) {
+    LOG_WARN("%s - fastmem is not supported on this platform\n", __func__);
+    return false;
+}
+
+void fastmem_cleanup(void) {
+}
+
+void fastmem_add_site(void *patch_pc, void *fault_pc, void *slow_path) {
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
+
+#endif
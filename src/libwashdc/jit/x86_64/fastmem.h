@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef FASTMEM_H_
+#define FASTMEM_H_
+
+#ifndef ENABLE_JIT_X86_64
+#error this file should not be built when the x86_64 JIT backend is disabled
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "washdc/MemoryMap.h"
+
+/*
+ * fastmem maps the guest's RAM (and all of its mirrors) into a 4GB reservation
+ * of host address space so that the jit can access guest memory with a single
+ * mov relative to fastmem_base.  Everything in the reservation that isn't RAM
+ * is left inaccessible, and accesses that land there cause a segfault.  The
+ * fault handler patches the faulting access into a jump to its slow-path and
+ * then resumes execution there.
+ *
+ * This is only supported on Linux right now.  fastmem_init returns false if it
+ * can't be used, and the jit goes back to inline RAM checks.
+ */
+
+/*
+ * allocate memory which backs the guest's RAM.  This needs to be shared memory
+ * so that it can be mapped into the reservation more than once.  Returns NULL
+ * if that's not possible.
+ */
+void *fastmem_alloc_ram(size_t len);
+void fastmem_free_ram(void *ram);
+
+/*
+ * reserve the address space and map in every region of map that is backed by
+ * the memory from fastmem_alloc_ram.  Returns true if fastmem is now enabled
+ * for map.
+ */
+bool fastmem_init(struct memory_map const *map);
+void fastmem_cleanup(void);
+
+// the memory_map that fastmem is enabled for, or NULL
+extern struct memory_map const *fastmem_map;
+extern uint8_t *fastmem_base;
+
+/*
+ * register an access emitted by the jit.  patch_pc is the start of the
+ * instruction sequence that can be overwritten with a jump to slow_path,
+ * fault_pc is the instruction which actually touches guest memory.  There
+ * needs to be at least five bytes between patch_pc and the end of the
+ * instruction at fault_pc.
+ */
+void fastmem_add_site(void *patch_pc, void *fault_pc, void *slow_path);
+
+#endif
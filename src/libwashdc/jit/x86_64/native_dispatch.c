@@ -23,12 +23,14 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "washdc/error.h"
 #include "dc_sched.h"
 #include "exec_mem.h"
 #include "jit/code_cache.h"
-#include "jit/jit.h"
+#include "jit/jit_bg_compile.h"
 #include "abi.h"
 
 #include "emit_x86_64.h"
@@ -41,11 +43,11 @@ static unsigned const cachep_reg = REG_NONVOL0;
 static unsigned const tmp_reg_1 = REG_NONVOL1;
 static unsigned const native_reg = REG_NONVOL2;
 static unsigned const code_cache_tbl_ptr_reg = REG_NONVOL3;
-static unsigned const code_hash_reg = REG_NONVOL4;
+static unsigned const code_hash_reg = REG_VOL0;
 
 // for native_check_cycles
 static unsigned const sched_tgt_reg = REG_NONVOL0;
-static unsigned const countdown_reg = REG_NONVOL0;
+static unsigned const countdown_reg = NATIVE_DISPATCH_COUNTDOWN_REG;
 static unsigned const new_pc_reg = NATIVE_DISPATCH_PC_REG;
 static unsigned const hash_reg = NATIVE_DISPATCH_HASH_REG;
 static unsigned const cycle_stamp_reg = NATIVE_DISPATCH_CYCLE_COUNT_REG;
@@ -59,7 +61,7 @@ static void create_return_fn(struct native_dispatch_meta *meta);
 
 static void jmp_to_addr(void *addr, unsigned clobber_reg);
 
-static void jmp_to_addr_jbe(void *addr, unsigned clobber_reg);
+static void jmp_to_addr_jle(void *addr, unsigned clobber_reg);
 
 void native_dispatch_entry_create(struct native_dispatch_meta *meta);
 
@@ -73,6 +75,34 @@ native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta);
 static void
 native_dispatch_trampoline_create(struct native_dispatch_meta *meta);
 
+static void
+native_dispatch_create_link_slow_path(struct native_dispatch_meta *meta);
+
+static void emit_countdown(struct native_dispatch_meta const *meta);
+
+static void link_site_patch(void *site, void const *dst);
+static void link_set(struct native_link *link, struct code_block_x86_64 *blk);
+static void link_clear(struct native_link *link);
+
+// list of every native_link which is currently linked
+static struct native_link *linked_head;
+
+/*
+ * hash of the PC that tier0_exec most recently returned, and the number of
+ * cycles the block took to get there.
+ */
+static uint32_t tier0_hash, tier0_cycles;
+
+/*
+ * the link that native_link_slow_path is currently resolving.  If the block
+ * which owns this link gets freed while the slow path is running then this
+ * gets set to NULL so that the slow path knows not to patch it.
+ */
+static struct native_link *pending_link;
+
+// the clock's countdown, which native code keeps in countdown_reg
+static dc_cycle_stamp_t *countdown_ptr;
+
 #ifdef ABI_MICROSOFT
 static void native_dispatch_ms_shadow_open(void) {
     x86asm_addq_imm8_reg(-32, RSP);
@@ -87,11 +117,14 @@ void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr) {
     meta->ctx_ptr = ctx_ptr;
 
     meta->clock_vals =
-        exec_mem_alloc(sizeof(meta->clock_vals[0]) * WASHDC_CLOCK_IDX_COUNT);
+        exec_mem_alloc_data(sizeof(meta->clock_vals[0]) *
+                            WASHDC_CLOCK_IDX_COUNT);
 
     clock_set_ptrs_priv(meta->clk, meta->clock_vals);
+    countdown_ptr = meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN;
 
     native_dispatch_create_slow_path_entry(meta);
+    native_dispatch_create_link_slow_path(meta);
     create_return_fn(meta);
 #ifdef JIT_PROFILE
     create_profile_code(meta);
@@ -105,6 +138,8 @@ void native_dispatch_cleanup(struct native_dispatch_meta *meta) {
     // TODO: free all executable memory pointers
     exec_mem_free(meta->entry);
     exec_mem_free(meta->return_fn);
+    exec_mem_free(meta->link_slow_path);
+    meta->link_slow_path = NULL;
 #ifdef JIT_PROFILE
     exec_mem_free(meta->profile_code);
 #endif
@@ -117,7 +152,7 @@ void native_dispatch_cleanup(struct native_dispatch_meta *meta) {
     meta->clock_vals = NULL;
 
     exec_mem_free(meta->trampoline);
-    code_cache_set_default(NULL);
+    code_cache_set_default(meta->cache, NULL);
 }
 
 static void create_return_fn(struct native_dispatch_meta *meta) {
@@ -185,8 +220,9 @@ static void create_profile_code(struct native_dispatch_meta *meta) {
     meta->profile_code = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(meta->profile_code, NULL, BASIC_ALLOC);
 
+    // blk.profile is too far into struct cache_entry for a disp8
     size_t const jit_profile_offs = offsetof(struct cache_entry, blk.profile);
-    x86asm_movq_disp8_reg_reg(jit_profile_offs, cachep_reg, REG_ARG1);
+    x86asm_movq_disp32_reg_reg(jit_profile_offs, cachep_reg, REG_ARG1);
 
     /*
      * ignore NULL pointers.
@@ -199,7 +235,7 @@ static void create_profile_code(struct native_dispatch_meta *meta) {
 
     // call jit_profile_notify
     x86asm_mov_imm64_reg64((uintptr_t)meta->ctx_ptr, REG_ARG0);
-    x86asm_movq_disp8_reg_reg(jit_profile_offs, cachep_reg, REG_ARG1);
+    x86asm_movq_disp32_reg_reg(jit_profile_offs, cachep_reg, REG_ARG1);
     x86asm_mov_imm64_reg64((uintptr_t)(void*)meta->profile_notify, REG_RET);
     x86asm_jmpq_reg64(REG_RET); // tail-call elimination
 
@@ -271,8 +307,9 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
      */
     x86asm_addq_imm8_reg(-8, RSP);
 
-    x86asm_mov_imm64_reg64((uintptr_t)(void*)code_cache_tbl,
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta->cache->tbl,
                            code_cache_tbl_ptr_reg);
+    load_quad_into_reg(countdown_ptr, countdown_reg);
 
     /*
      * JIT code is only expected to preserve the base pointer, and to leave the
@@ -283,17 +320,90 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
     meta->entry = (native_dispatch_entry_func)entry;
 }
 
+/*
+ * this is what blocks which haven't been promoted to the x86_64 backend yet
+ * call to run their code_block_intp.
+ */
+static uint32_t
+tier0_exec(void *arg, struct native_dispatch_meta const *meta) {
+    struct cache_entry *entry = (struct cache_entry*)arg;
+
+    if (++entry->n_execs >= meta->tier_threshold) {
+        if (meta->on_submit) {
+            /*
+             * keep interpreting the block until the native code is ready.
+             * Evicting the entry then sends the next jump to it through the
+             * slow path, which swaps the native code in.
+             */
+            if (!entry->bg_job)
+                entry->bg_job = meta->on_submit(meta->ctx_ptr, meta, entry->pc);
+            else if (jit_bg_compile_done(entry->bg_job))
+                code_cache_evict_entry(meta->cache, entry);
+        } else {
+            /*
+             * It's still safe to run the block one last time after this
+             * because invalidated blocks don't get freed until the next time
+             * they get looked up.  The next lookup will see that it's hot and
+             * compile it with the x86_64 backend.
+             */
+            entry->hot = 1;
+            code_cache_invalidate_entry(meta->cache, entry);
+        }
+    }
+
+    unsigned n_cycles;
+    uint32_t pc = code_block_intp_exec(meta->ctx_ptr, &entry->blk.intp,
+                                       &n_cycles);
+    tier0_hash = meta->hash_func(meta->ctx_ptr, pc);
+    tier0_cycles = n_cycles;
+    return pc;
+}
+
+static void compile_entry(struct native_dispatch_meta const *meta,
+                          struct cache_entry *entry, addr32_t pc) {
+    entry->pc = pc;
+    if (meta->on_compile_intp && !entry->hot) {
+        meta->on_compile_intp(meta->ctx_ptr, &entry->blk, pc);
+        jit_bg_compile_lock();
+        code_block_x86_64_compile_call(entry, &entry->blk.x86_64, tier0_exec,
+                                       &tier0_hash, &tier0_cycles, meta);
+        jit_bg_compile_unlock();
+    } else {
+        jit_bg_compile_lock();
+        meta->on_compile(meta->ctx_ptr, meta, &entry->blk, pc);
+        jit_bg_compile_unlock();
+    }
+    code_cache_set_valid(meta->cache, entry);
+}
+
+/*
+ * swap the native code from entry's finished background compile in for its
+ * tier0 stub.  Nothing can be running the stub because it always exits
+ * through the dispatcher, and we only get here while looking the entry up.
+ */
+static void install_bg_job(struct cache_entry *entry) {
+    struct jit_bg_job *job = entry->bg_job;
+    entry->bg_job = NULL;
+
+    code_block_x86_64_cleanup(&entry->blk.x86_64);
+    jit_bg_compile_finish(job, &entry->blk);
+    native_link_move(&entry->blk.x86_64);
+    entry->hot = 1;
+}
+
 static struct cache_entry *
 dispatch_slow_path(uint32_t pc, struct native_dispatch_meta const *meta) {
     void *ctx_ptr = meta->ctx_ptr;
-    struct cache_entry *entry = code_cache_find_slow(meta->hash_func(ctx_ptr, pc));
+    struct code_cache *cache = meta->cache;
+    struct cache_entry *entry =
+        code_cache_find_slow(cache, meta->hash_func(ctx_ptr, pc));
 
-    code_cache_tbl[pc & CODE_CACHE_HASH_TBL_MASK] = entry;
+    cache->tbl[pc & cache->tbl_mask] = entry;
 
-    if (!entry->valid) {
-        meta->on_compile(ctx_ptr, meta, &entry->blk, pc);
-        entry->valid = 1;
-    }
+    if (!entry->valid)
+        compile_entry(meta, entry, pc);
+    else if (entry->bg_job && jit_bg_compile_done(entry->bg_job))
+        install_bg_job(entry);
 
     return entry;
 }
@@ -310,7 +420,7 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
      * REGISTER ALLOCATION:
      *    RBX points to the struct cache_entry
      *    EDI holds the 32-bit SH4 PC address
-     *    ECX holds the index into the code_cache_tbl
+     *    ECX holds the index into the hash table
      *
      *    All other registers are considered to be "temporary" registers whose
      *    values change often.
@@ -320,12 +430,12 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
     x86asm_lbl8_init(&have_valid_ent);
 
     x86asm_mov_reg32_reg32(hash_reg, code_hash_reg);
-    x86asm_andl_imm32_reg32(CODE_CACHE_HASH_TBL_MASK, code_hash_reg);
+    x86asm_andl_imm32_reg32(meta->cache->tbl_mask, code_hash_reg);
 
     x86asm_movq_sib_reg(code_cache_tbl_ptr_reg, 8, code_hash_reg, cachep_reg);
 
     // now check the address against the one that's still in hash_reg
-    size_t const addr_offs = offsetof(struct cache_entry, node.key);
+    size_t const addr_offs = offsetof(struct cache_entry, key);
     if (addr_offs >= 256)
         RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
     x86asm_movl_disp8_reg_reg(addr_offs, cachep_reg, tmp_reg_1);
@@ -360,18 +470,30 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
     x86asm_lbl8_cleanup(&code_cache_slow_path);
 }
 
-void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
+static void emit_countdown(struct native_dispatch_meta const *meta) {
     static_assert(sizeof(dc_cycle_stamp_t) == 8,
                   "dc_cycle_stamp_t is not a quadword!");
 
-    load_quad_into_reg(meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN,
-                       countdown_reg);
     x86asm_subq_reg64_reg64(cycle_stamp_reg, countdown_reg);
 
-    jmp_to_addr_jbe(meta->return_fn, REG_VOL0);
+    /*
+     * this is a signed comparison because the countdown can already be
+     * negative if the previous block's exit skipped its check (see
+     * native_link).
+     *
+     * return_fn zeroes the countdown in clock_vals, so no need to save it
+     */
+    jmp_to_addr_jle(meta->return_fn, REG_VOL0);
+}
 
-    store_quad_from_reg(meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN,
-                        countdown_reg, REG_VOL1);
+void native_dispatch_call_emit(void *fn) {
+    store_quad_from_reg(countdown_ptr, countdown_reg, REG_VOL1);
+    x86asm_call_ptr(fn);
+    load_quad_into_reg(countdown_ptr, countdown_reg);
+}
+
+void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
+    emit_countdown(meta);
 
     // call native_dispatch
     native_dispatch_emit(meta);
@@ -382,6 +504,238 @@ void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
      */
 }
 
+void
+native_check_cycles_link_emit(struct native_dispatch_meta const *meta,
+                              struct code_block_x86_64 *blk,
+                              unsigned n_targets, uint32_t const *addrs,
+                              jit_hash const *hashes) {
+#ifdef JIT_PROFILE
+    /*
+     * the profiler gets notified from native_dispatch, so linked blocks would
+     * never get counted
+     */
+    native_check_cycles_emit(meta);
+#else
+    if (blk->links || !n_targets)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    blk->links =
+        (struct native_link*)calloc(n_targets, sizeof(struct native_link));
+    if (!blk->links)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    blk->n_links = n_targets;
+
+    // the gates check the countdown, so don't branch on it here
+    x86asm_subq_reg64_reg64(cycle_stamp_reg, countdown_reg);
+
+    /*
+     * The PC is still in new_pc_reg, so compare it against each target.  The
+     * last target doesn't need to be compared because the PC can't be
+     * anything else.
+     */
+    unsigned idx;
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link->addr = addrs[idx];
+        link->hash = hashes[idx];
+        link->owner = blk;
+
+        if (idx + 1 < n_targets) {
+            struct x86asm_lbl8 next_target;
+            x86asm_lbl8_init(&next_target);
+
+            x86asm_cmpl_imm32_reg32(addrs[idx], new_pc_reg);
+            x86asm_jnz_lbl8(&next_target);
+
+            link->site = x86asm_get_outp();
+            x86asm_jmpq_offs32(0);
+
+            x86asm_lbl8_define(&next_target);
+            x86asm_lbl8_cleanup(&next_target);
+        } else {
+            link->site = x86asm_get_outp();
+            x86asm_jmpq_offs32(0);
+        }
+    }
+
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link->gate = x86asm_get_outp();
+        x86asm_testq_reg64_reg64(countdown_reg, countdown_reg);
+        jmp_to_addr_jle(meta->return_fn, REG_VOL0);
+        link->gate_site = x86asm_get_outp();
+        x86asm_jmpq_offs32(0);
+    }
+
+    // now the stubs, which is where the links go when they're not linked
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link->stub = x86asm_get_outp();
+        x86asm_mov_imm64_reg64((uintptr_t)link, REG_ARG0);
+        jmp_to_addr(meta->link_slow_path, REG_RET);
+    }
+
+    for (idx = 0; idx < n_targets; idx++) {
+        struct native_link *link = blk->links + idx;
+        link_site_patch(link->site, link->gate);
+        link_site_patch(link->gate_site, link->stub);
+    }
+#endif
+}
+
+static void *
+native_link_slow_path(struct native_link *link,
+                      struct native_dispatch_meta const *meta) {
+    uint32_t addr = link->addr;
+    jit_hash hash = link->hash;
+
+    /*
+     * code_cache_find_slow can clean up the block that link belongs to if that
+     * block was invalidated while it was running.
+     */
+    pending_link = link;
+
+    struct code_cache *cache = meta->cache;
+    struct cache_entry *entry = code_cache_find_slow(cache, hash);
+    cache->tbl[hash & cache->tbl_mask] = entry;
+
+    if (!entry->valid)
+        compile_entry(meta, entry, addr);
+    else if (entry->bg_job && jit_bg_compile_done(entry->bg_job))
+        install_bg_job(entry);
+
+    if (pending_link)
+        link_set(pending_link, &entry->blk.x86_64);
+    pending_link = NULL;
+
+    return entry->blk.x86_64.native;
+}
+
+static void
+native_dispatch_create_link_slow_path(struct native_dispatch_meta *meta) {
+    meta->link_slow_path = exec_mem_alloc(BASIC_ALLOC);
+    x86asm_set_dst(meta->link_slow_path, NULL, BASIC_ALLOC);
+
+    /*
+     * the native_link is in REG_ARG0.  The stack is already aligned because
+     * this gets jumped to from the end of a code block.
+     */
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)native_link_slow_path, REG_RET);
+
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_open();
+#endif
+    x86asm_call_reg(REG_RET);
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_close();
+#endif
+
+    x86asm_jmpq_reg64(REG_RET); // tail-call elimination
+}
+
+static void link_site_patch(void *site, void const *dst) {
+    intptr_t disp = ((char const*)dst) - (((char*)site) + 5);
+    if (disp > INT32_MAX || disp < INT32_MIN)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    int32_t disp32 = disp;
+    memcpy(((char*)exec_mem_rw(site)) + 1, &disp32, sizeof(disp32));
+}
+
+static void link_set(struct native_link *link, struct code_block_x86_64 *blk) {
+    if (link->target)
+        link_clear(link);
+
+    struct code_block_x86_64 *owner = link->owner;
+    if (blk != owner && !blk->n_unchecked_out && !owner->n_unchecked_in) {
+        link_site_patch(link->site, blk->native);
+        link->unchecked = true;
+        owner->n_unchecked_out++;
+        blk->n_unchecked_in++;
+    } else {
+        link_site_patch(link->gate_site, blk->native);
+        link->unchecked = false;
+    }
+    link->target = blk;
+
+    link->prev_in = NULL;
+    link->next_in = blk->links_in;
+    if (blk->links_in)
+        blk->links_in->prev_in = link;
+    blk->links_in = link;
+
+    link->prev_linked = NULL;
+    link->next_linked = linked_head;
+    if (linked_head)
+        linked_head->prev_linked = link;
+    linked_head = link;
+}
+
+static void link_clear(struct native_link *link) {
+    struct code_block_x86_64 *blk = link->target;
+    if (!blk)
+        return;
+
+    if (link->unchecked) {
+        link_site_patch(link->site, link->gate);
+        link->owner->n_unchecked_out--;
+        blk->n_unchecked_in--;
+        link->unchecked = false;
+    } else {
+        link_site_patch(link->gate_site, link->stub);
+    }
+
+    if (link->prev_in)
+        link->prev_in->next_in = link->next_in;
+    else
+        blk->links_in = link->next_in;
+    if (link->next_in)
+        link->next_in->prev_in = link->prev_in;
+
+    if (link->prev_linked)
+        link->prev_linked->next_linked = link->next_linked;
+    else
+        linked_head = link->next_linked;
+    if (link->next_linked)
+        link->next_linked->prev_linked = link->prev_linked;
+
+    link->target = NULL;
+    link->next_in = link->prev_in = NULL;
+    link->next_linked = link->prev_linked = NULL;
+}
+
+void native_link_unlink_in(struct code_block_x86_64 *blk) {
+    while (blk->links_in)
+        link_clear(blk->links_in);
+}
+
+void native_link_unlink_all(void) {
+    while (linked_head)
+        link_clear(linked_head);
+}
+
+void native_link_move(struct code_block_x86_64 *blk) {
+    unsigned idx;
+    for (idx = 0; idx < blk->n_links; idx++)
+        blk->links[idx].owner = blk;
+}
+
+void native_link_cleanup(struct code_block_x86_64 *blk) {
+    native_link_unlink_in(blk);
+
+    unsigned idx;
+    for (idx = 0; idx < blk->n_links; idx++) {
+        struct native_link *link = blk->links + idx;
+        link_clear(link);
+        if (link == pending_link)
+            pending_link = NULL;
+    }
+
+    free(blk->links);
+    blk->links = NULL;
+    blk->n_links = 0;
+}
+
 static void
 native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta) {
     size_t const native_offs = offsetof(struct cache_entry, blk.x86_64.native);
@@ -446,9 +800,9 @@ static void native_dispatch_trampoline_create(struct native_dispatch_meta *meta)
     memset(&meta->fake_cache_entry, 0, sizeof(meta->fake_cache_entry));
     meta->fake_cache_entry.valid = 1;
     meta->fake_cache_entry.blk.x86_64.native = meta->trampoline;
-    meta->fake_cache_entry.node.key = 0xa0000000;
+    meta->fake_cache_entry.key = 0xa0000000;
 
-    code_cache_set_default(&meta->fake_cache_entry);
+    code_cache_set_default(meta->cache, &meta->fake_cache_entry);
 }
 
 static void load_quad_into_reg(void *qptr, unsigned reg_no) {
@@ -489,11 +843,11 @@ static void jmp_to_addr(void *addr, unsigned clobber_reg) {
     }
 }
 
-static void jmp_to_addr_jbe(void *addr, unsigned clobber_reg) {
+static void jmp_to_addr_jle(void *addr, unsigned clobber_reg) {
     char *base = ((char*)x86asm_get_outp()) + 6;
     intptr_t diff = ((char*)addr) - base;
     if (diff <= INT32_MAX && diff >= INT32_MIN)
-        x86asm_jbe_disp32(diff);
+        x86asm_jle_disp32(diff);
     else
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
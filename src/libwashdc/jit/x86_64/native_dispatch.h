@@ -24,6 +24,7 @@
 #define NATIVE_DISPATCH_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "washdc/types.h"
 #include "dc_sched.h"
@@ -45,6 +46,16 @@ void native_dispatch_cleanup(struct native_dispatch_meta *meta);
 #define NATIVE_DISPATCH_HASH_REG REG_ARG1
 #define NATIVE_DISPATCH_CYCLE_COUNT_REG REG_ARG2
 
+/*
+ * the clock's countdown lives in this register for as long as native code is
+ * running, so that blocks don't have to load and store it every time they
+ * check cycles.  It is callee-saved, so it survives calls into C code, but
+ * the copy in meta->clock_vals is stale the whole time.  Native code which
+ * calls into C code has to go through native_dispatch_call_emit so that the
+ * C code sees the right clock and any events it schedules are picked up.
+ */
+#define NATIVE_DISPATCH_COUNTDOWN_REG REG_NONVOL4
+
 // the first uint32_t parameter is supposed to be the PC, second is the hash
 typedef uint32_t(*native_dispatch_entry_func)(uint32_t, uint32_t);
 
@@ -55,6 +66,16 @@ void(*native_dispatch_compile_func)(void*,struct native_dispatch_meta const*,
 
 typedef jit_hash(*native_dispatch_hash_func)(void*,uint32_t);
 
+// compiles a block for code_block_intp instead of the x86_64 backend
+typedef void(*native_dispatch_compile_intp_func)(void*,void*,addr32_t);
+
+// generates il for a block and submits it to jit_bg_compile
+struct jit_bg_job;
+typedef
+struct jit_bg_job*(*native_dispatch_submit_func)(void*,
+                                                 struct native_dispatch_meta const*,
+                                                 addr32_t);
+
 #ifdef JIT_PROFILE
 typedef
 void(*native_dispatch_profile_notify_func)(void*,
@@ -73,6 +94,7 @@ struct native_dispatch_meta {
     struct dc_clock *clk;
     void *return_fn;
     void *dispatch_slow_path;
+    void *link_slow_path;
 #ifdef JIT_PROFILE
     void *profile_code;
 #endif
@@ -84,6 +106,25 @@ struct native_dispatch_meta {
 #endif
     native_dispatch_compile_func on_compile; // user-specified
 
+    /*
+     * If this is non-NULL, then blocks get compiled with on_compile_intp and
+     * run through code_block_intp_exec until they've been executed
+     * tier_threshold times, and only then do they get compiled with
+     * on_compile.  If this is NULL, every block goes straight to on_compile.
+     */
+    native_dispatch_compile_intp_func on_compile_intp; // user-specified
+    unsigned tier_threshold; // user-specified
+
+    /*
+     * If this is non-NULL, then hot blocks get handed to on_submit instead of
+     * on_compile, and they keep running through code_block_intp_exec until
+     * jit_bg_compile is done with them.  This only matters when
+     * on_compile_intp is non-NULL.
+     */
+    native_dispatch_submit_func on_submit; // user-specified
+
+    struct code_cache *cache; // user-specified
+
     /*
      * entry is a generated function which saves all call-stack registers which
      * ought to be saved, calls native_dispatch, and then returns after
@@ -94,12 +135,12 @@ struct native_dispatch_meta {
 
     /*
      * This is the default "invalid" code block that we fill out the
-     * code_cache_tbl with whenever the cache gets nuked.  The idea is that
+     * cache's hash table with whenever the cache gets nuked.  The idea is that
      * this will point to a fake code block which is equivalent to the slow-path
      * from the native_dispatch code.  The point of all this is to avoid
      * needing to check for NULL pointers in the code created by
      * native_dispatch_emit; otherwise there needs to be an additional branch to
-     * make sure that whatever we grab from the code_cache_tbl actually points
+     * make sure that whatever we grab from the hash table actually points
      * to a real code block.
      */
     void *trampoline;
@@ -126,4 +167,89 @@ struct native_dispatch_meta {
 void
 native_check_cycles_emit(struct native_dispatch_meta const *meta);
 
+/*
+ * emit a call to fn, saving NATIVE_DISPATCH_COUNTDOWN_REG to the clock before
+ * and reloading it after.  Like x86asm_call_ptr, this clobbers R10.  It also
+ * clobbers R11, which is never used to pass arguments.
+ */
+void native_dispatch_call_emit(void *fn);
+
+/*
+ * A native_link is an exit from a code block whose destination was known when
+ * the block was compiled.  Instead of going through native_dispatch, the exit
+ * is a jmp instruction that initially points to a stub which calls
+ * native_link_slow_path.  The slow path looks up (or compiles) the
+ * destination block and patches the jmp to go straight to it, so that next
+ * time the exit doesn't need to touch the code cache at all.
+ *
+ * Linked exits subtract the block's cycles from the countdown but don't check
+ * it themselves.  Normally site jumps to a gate which checks the countdown and
+ * then jumps to the destination (or the stub).  When the destination's own
+ * exits are all checked, site can jump straight to the destination instead,
+ * which lets the countdown get checked once for both blocks.  That's only
+ * allowed when nothing skips the check on the way into the source block, so
+ * at most two blocks ever run between checks.
+ *
+ * When the destination block gets invalidated, every link pointing to it gets
+ * patched back to its gate, and the gate gets patched back to the stub.
+ */
+struct native_link {
+    // the 5-byte jmp instruction that gets patched
+    void *site;
+
+    // the countdown check, and the 5-byte jmp at the end of it
+    void *gate;
+    void *gate_site;
+
+    // where gate_site jumps to when the link is not linked
+    void *stub;
+
+    // the block this link is an exit from
+    struct code_block_x86_64 *owner;
+
+    // true if site jumps straight to target without going through gate
+    bool unchecked;
+
+    uint32_t addr;
+    jit_hash hash;
+
+    // the block that site currently jumps to, or NULL
+    struct code_block_x86_64 *target;
+
+    // list of links into target
+    struct native_link *next_in, *prev_in;
+
+    // list of every link that is currently linked
+    struct native_link *next_linked, *prev_linked;
+};
+
+/*
+ * this is like native_check_cycles_emit, except it's for blocks which are
+ * guaranteed to jump to one of the n_targets addresses in addrs.  Each target
+ * gets its own native_link in blk.
+ */
+void
+native_check_cycles_link_emit(struct native_dispatch_meta const *meta,
+                              struct code_block_x86_64 *blk,
+                              unsigned n_targets, uint32_t const *addrs,
+                              jit_hash const *hashes);
+
+// unlink every link that jumps into blk
+void native_link_unlink_in(struct code_block_x86_64 *blk);
+
+// unlink every link that's currently linked, in every block
+void native_link_unlink_all(void);
+
+/*
+ * this gets called when blk is about to be freed.  It unlinks everything
+ * going into or out of blk.
+ */
+void native_link_cleanup(struct code_block_x86_64 *blk);
+
+/*
+ * blk was just copied in from somewhere else, so point its links back at it.
+ * None of them can be linked yet.
+ */
+void native_link_move(struct code_block_x86_64 *blk);
+
 #endif
@@ -28,26 +28,39 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "code_block_x86_64.h"
 #include "washdc/MemoryMap.h"
 #include "exec_mem.h"
 #include "dreamcast.h"
 #include "abi.h"
+#include "jit/code_cache.h"
+#include "savestate.h"
 
 #include "native_mem.h"
+#include "fastmem.h"
 #include "emit_x86_64.h"
+#include "native_dispatch.h"
 
 #define BASIC_ALLOC 32
 
-static void* emit_native_mem_read_float(struct memory_map const *map);
-static void* emit_native_mem_read_32(struct memory_map const *map);
-static void* emit_native_mem_read_8(struct memory_map const *map);
-static void* emit_native_mem_read_16(struct memory_map const *map);
-static void* emit_native_mem_write_8(struct memory_map const *map);
-static void* emit_native_mem_write_16(struct memory_map const *map);
-static void* emit_native_mem_write_32(struct memory_map const *map);
-static void* emit_native_mem_write_float(struct memory_map const *map);
+static void*
+emit_native_mem_read_float(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_read_32(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_read_8(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_read_16(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_write_8(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_write_16(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_write_32(struct memory_map const *map, void **jmp_tbl);
+static void*
+emit_native_mem_write_float(struct memory_map const *map, void **jmp_tbl);
 
 static void
 emit_ram_read_float(struct memory_map_region const *region, void *ctxt);
@@ -58,23 +71,65 @@ emit_ram_read_16(struct memory_map_region const *region, void *ctxt);
 static void
 emit_ram_read_8(struct memory_map_region const *region, void *ctxt);
 static void
-emit_ram_write_8(struct memory_map_region const *region, void *ctxt);
+emit_ram_write_8(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call);
 static void
-emit_ram_write_16(struct memory_map_region const *region, void *ctxt);
+emit_ram_write_16(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call);
 static void
-emit_ram_write_32(struct memory_map_region const *region, void *ctxt);
+emit_ram_write_32(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call);
 static void
-emit_ram_write_float(struct memory_map_region const *region, void *ctxt);
+emit_ram_write_float(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call);
+static void emit_ram_write_notify(unsigned n_bytes, bool tail_call);
+
+static void emit_ora_read_float(void *ctxt);
+static void emit_ora_read_32(void *ctxt);
+static void emit_ora_read_16(void *ctxt);
+static void emit_ora_read_8(void *ctxt);
+static void emit_ora_write_8(void *ctxt);
+static void emit_ora_write_16(void *ctxt);
+static void emit_ora_write_32(void *ctxt);
+static void emit_ora_write_float(void *ctxt);
+static void emit_page_dispatch(struct memory_map const *map, unsigned n_bytes,
+                               void **jmp_tbl);
+
+/*
+ * each handler has its own jump table, indexed by the memory_map's page_tbl
+ * entries.  Pages which belong to a single region go straight to the code for
+ * that region, everything else goes to the linear search.
+ */
+#define JMP_TBL_LEN 256
 
 struct native_mem_map {
     struct memory_map const *map;
     struct fifo_node node;
     void *read_float_impl, *read_32_impl, *read_16_impl, *read_8_impl,
         *write_8_impl, *write_16_impl, *write_32_impl, *write_float_impl;
+
+    /*
+     * main RAM, for the inline fast-path.  ram is the first region, and the
+     * range covers any adjacent regions which are mirrors of the same memory.
+     * ram is NULL if the fast-path can't be used for this map.
+     */
+    struct memory_map_region const *ram;
+    uint32_t ram_first, ram_last;
+
+    // if non-zero, everything from here up belongs to some other region
+    uint32_t ram_top;
+
+    void *read_float_tbl[JMP_TBL_LEN], *read_32_tbl[JMP_TBL_LEN],
+        *read_16_tbl[JMP_TBL_LEN], *read_8_tbl[JMP_TBL_LEN],
+        *write_8_tbl[JMP_TBL_LEN], *write_16_tbl[JMP_TBL_LEN],
+        *write_32_tbl[JMP_TBL_LEN], *write_float_tbl[JMP_TBL_LEN];
 };
 
 static struct fifo_head native_impl;
 static struct native_mem_map *mem_map_impl(struct memory_map const *map);
+static void find_ram(struct native_mem_map *native_map);
+static void emit_ram_check(struct native_mem_map const *native_map,
+                           unsigned n_bytes, struct x86asm_lbl8 *miss);
 
 void native_mem_init(void) {
     fifo_init(&native_impl);
@@ -99,6 +154,58 @@ void native_mem_cleanup(void) {
     }
 }
 
+/*
+ * The fast-path for an access comes before the call to the slow-path.  Without
+ * fastmem, it's an inline check for main RAM that skips over the fast-path when
+ * the address is somewhere else.  With fastmem, there's no check; the fault
+ * handler patches the start of the fast-path into a jump to the slow-path the
+ * first time it touches something which isn't RAM.
+ *
+ * Either way, the address in EDI needs to stay intact until the access is
+ * done so that the slow-path can start over from the beginning.
+ */
+struct fast_path {
+    struct x86asm_lbl8 slow_path, done;
+    bool active, fastmem;
+    void *patch_pc, *fault_pc;
+};
+
+static bool fast_path_begin(struct fast_path *fast,
+                            struct native_mem_map const *native_map,
+                            unsigned n_bytes) {
+    fast->active = native_map->ram != NULL;
+    if (!fast->active)
+        return false;
+
+    x86asm_lbl8_init(&fast->slow_path);
+    x86asm_lbl8_init(&fast->done);
+
+    fast->fastmem = fastmem_map && native_map->map == fastmem_map;
+    if (fast->fastmem) {
+        // make sure the upper half of RDI is clear
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+        fast->patch_pc = x86asm_get_out_ptr();
+    } else
+        emit_ram_check(native_map, n_bytes, &fast->slow_path);
+
+    return true;
+}
+
+static void fast_path_slow(struct fast_path *fast) {
+    x86asm_jmp_lbl8(&fast->done);
+    x86asm_lbl8_define(&fast->slow_path);
+    if (fast->fastmem)
+        fastmem_add_site(fast->patch_pc, fast->fault_pc, x86asm_get_out_ptr());
+}
+
+static void fast_path_end(struct fast_path *fast) {
+    if (fast->active) {
+        x86asm_lbl8_define(&fast->done);
+        x86asm_lbl8_cleanup(&fast->done);
+        x86asm_lbl8_cleanup(&fast->slow_path);
+    }
+}
+
 void native_mem_read_float(struct code_block_x86_64 *blk,
                            struct memory_map const *map) {
     ms_shadow_open(blk);
@@ -106,7 +213,21 @@ void native_mem_read_float(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_float_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(float))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_ARG1);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movss_sib_xmm(REG_ARG1, 1, REG_ARG0, REG_RET_XMM);
+        } else {
+            emit_ram_read_float(native_map->ram, native_map->ram->ctxt);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->read_float_impl);
+    fast_path_end(&fast);
     ms_shadow_close();
 }
 
@@ -117,18 +238,59 @@ void native_mem_read_32(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_32_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint32_t))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_ARG1);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movl_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+        } else {
+            emit_ram_read_32(native_map->ram, native_map->ram->ctxt);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->read_32_impl);
+    fast_path_end(&fast);
+    ms_shadow_close();
+}
+
+void native_mem_read_32_slow(struct code_block_x86_64 *blk,
+                             struct memory_map const *map) {
+    ms_shadow_open(blk);
+    x86_64_align_stack(blk);
+    struct native_mem_map *native_map = mem_map_impl(map);
+    if (!native_map)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    native_dispatch_call_emit(native_map->read_32_impl);
     ms_shadow_close();
 }
 
 void native_mem_read_8(struct code_block_x86_64 *blk,
-                        struct memory_map const *map) {
+                       struct memory_map const *map) {
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_8_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint8_t))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_ARG1);
+            x86asm_xorl_reg32_reg32(REG_RET, REG_RET);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movb_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+        } else {
+            emit_ram_read_8(native_map->ram, native_map->ram->ctxt);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->read_8_impl);
+    fast_path_end(&fast);
     x86asm_and_imm32_rax(0x0000ff);
     ms_shadow_close();
 }
@@ -140,7 +302,22 @@ void native_mem_read_16(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_16_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint16_t))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_ARG1);
+            x86asm_xorl_reg32_reg32(REG_RET, REG_RET);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movw_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+        } else {
+            emit_ram_read_16(native_map->ram, native_map->ram->ctxt);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->read_16_impl);
+    fast_path_end(&fast);
     x86asm_and_imm32_rax(0x0000ffff);
     ms_shadow_close();
 }
@@ -153,7 +330,24 @@ void native_mem_write_8(struct code_block_x86_64 *blk,
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
     x86asm_andl_imm32_reg32(0xff, REG_ARG1);
-    x86asm_call_ptr(native_map->write_8_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint8_t))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_RET);
+            x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+            x86asm_andl_imm32_reg32(native_map->ram->mask, REG_ARG0);
+            emit_ram_write_notify(sizeof(uint8_t), false);
+        } else {
+            emit_ram_write_8(native_map->ram, native_map->ram->ctxt, false);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->write_8_impl);
+    fast_path_end(&fast);
     ms_shadow_close();
 }
 
@@ -165,7 +359,24 @@ void native_mem_write_16(struct code_block_x86_64 *blk,
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
     x86asm_andl_imm32_reg32(0xffff, REG_ARG1);
-    x86asm_call_ptr(native_map->write_16_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint16_t))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_RET);
+            x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movw_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+            x86asm_andl_imm32_reg32(native_map->ram->mask, REG_ARG0);
+            emit_ram_write_notify(sizeof(uint16_t), false);
+        } else {
+            emit_ram_write_16(native_map->ram, native_map->ram->ctxt, false);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->write_16_impl);
+    fast_path_end(&fast);
     ms_shadow_close();
 }
 
@@ -176,7 +387,65 @@ void native_mem_write_32(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->write_32_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(uint32_t))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_RET);
+            fast.fault_pc = x86asm_get_out_ptr();
+            x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
+            x86asm_andl_imm32_reg32(native_map->ram->mask, REG_ARG0);
+            emit_ram_write_notify(sizeof(uint32_t), false);
+        } else {
+            emit_ram_write_32(native_map->ram, native_map->ram->ctxt, false);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->write_32_impl);
+    fast_path_end(&fast);
+    ms_shadow_close();
+}
+
+void native_mem_write_32_slow(struct code_block_x86_64 *blk,
+                              struct memory_map const *map) {
+    ms_shadow_open(blk);
+    x86_64_align_stack(blk);
+    struct native_mem_map *native_map = mem_map_impl(map);
+    if (!native_map)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    native_dispatch_call_emit(native_map->write_32_impl);
+    ms_shadow_close();
+}
+
+bool native_mem_span_check(struct memory_map const *map, unsigned n_bytes,
+                           struct x86asm_lbl8 *miss) {
+    struct native_mem_map *native_map = mem_map_impl(map);
+    if (!native_map)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    if (!native_map->ram)
+        return false;
+
+    struct memory_map_region const *ram = native_map->ram;
+    struct Memory *mem = (struct Memory*)ram->ctxt;
+
+    emit_ram_check(native_map, n_bytes, miss);
+
+    // the span can still run off the end of one mirror and into the next one
+    x86asm_andl_imm32_reg32(ram->mask, REG_ARG0);
+    x86asm_cmpl_imm32_reg32(ram->mask - (n_bytes - 1), REG_ARG0);
+    x86asm_ja_lbl8(miss);
+
+    x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
+    x86asm_addq_reg64_reg64(REG_ARG0, REG_RET);
+
+    return true;
+}
+
+void native_mem_span_notify(struct code_block_x86_64 *blk, unsigned n_bytes) {
+    ms_shadow_open(blk);
+    emit_ram_write_notify(n_bytes, false);
     ms_shadow_close();
 }
 
@@ -187,7 +456,29 @@ void native_mem_write_float(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->write_float_impl);
+
+    struct fast_path fast;
+    if (fast_path_begin(&fast, native_map, sizeof(float))) {
+        if (fast.fastmem) {
+            x86asm_mov_imm64_reg64((uintptr_t)fastmem_base, REG_RET);
+            fast.fault_pc = x86asm_get_out_ptr();
+#if defined(ABI_MICROSOFT)
+            x86asm_movss_xmm_sib(REG_ARG1_XMM, REG_RET, 1, REG_ARG0);
+#elif defined(ABI_UNIX)
+            x86asm_movss_xmm_sib(REG_ARG0_XMM, REG_RET, 1, REG_ARG0);
+#else
+#error unknown abi
+#endif
+            x86asm_andl_imm32_reg32(native_map->ram->mask, REG_ARG0);
+            emit_ram_write_notify(sizeof(float), false);
+        } else {
+            emit_ram_write_float(native_map->ram, native_map->ram->ctxt, false);
+        }
+        fast_path_slow(&fast);
+    }
+
+    native_dispatch_call_emit(native_map->write_float_impl);
+    fast_path_end(&fast);
     ms_shadow_close();
 }
 
@@ -195,10 +486,52 @@ static void error_func(void) {
     RAISE_ERROR(ERROR_INTEGRITY);
 }
 
-static void* emit_native_mem_read_8(struct memory_map const *map) {
+/*
+ * look up the page of the address in EDI in the memory_map's page_tbl and jump
+ * to the corresponding entry in jmp_tbl.  Accesses which straddle a page
+ * boundary fall through to whatever comes next (which will be the linear
+ * search).  Every entry in jmp_tbl gets pointed at the code that comes next,
+ * the caller then fills in the ones that belong to a single region.
+ *
+ * This clobbers EAX and REG_ARG3.
+ */
+static void emit_page_dispatch(struct memory_map const *map, unsigned n_bytes,
+                               void **jmp_tbl) {
+    struct x86asm_lbl8 slow_path;
+    x86asm_lbl8_init(&slow_path);
+
+    if (n_bytes > 1) {
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_RET);
+        x86asm_andl_imm32_reg32(MEMORY_MAP_PAGE_MASK, REG_RET);
+        x86asm_cmpl_imm32_reg32(MEMORY_MAP_PAGE_MASK - (n_bytes - 1), REG_RET);
+        x86asm_ja_lbl8(&slow_path);
+    }
+
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_RET);
+    x86asm_shrl_imm8_reg32(MEMORY_MAP_PAGE_SHIFT, REG_RET);
+    x86asm_mov_imm64_reg64((uintptr_t)map->page_tbl, REG_ARG3);
+    x86asm_movb_sib_reg(REG_ARG3, 1, REG_RET, REG_RET);
+    x86asm_movzbl_reg_reg(REG_RET, REG_RET);
+    x86asm_mov_imm64_reg64((uintptr_t)jmp_tbl, REG_ARG3);
+    x86asm_movq_sib_reg(REG_ARG3, 8, REG_RET, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
+
+    x86asm_lbl8_define(&slow_path);
+    x86asm_lbl8_cleanup(&slow_path);
+
+    void *slow_path_ptr = x86asm_get_out_ptr();
+    unsigned idx;
+    for (idx = 0; idx < JMP_TBL_LEN; idx++)
+        jmp_tbl[idx] = slow_path_ptr;
+}
+
+static void*
+emit_native_mem_read_8(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_read_8_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_read_8_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(uint8_t), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     static unsigned const func_call_reg = REG_ARG3;
@@ -222,11 +555,16 @@ static void* emit_native_mem_read_8(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
             emit_ram_read_8(region, region->ctxt);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_read_8(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -255,10 +593,13 @@ static void* emit_native_mem_read_8(struct memory_map const *map) {
     return native_mem_read_8_impl;
 }
 
-static void* emit_native_mem_read_16(struct memory_map const *map) {
+static void*
+emit_native_mem_read_16(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_read_16_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_read_16_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(uint16_t), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     static unsigned const func_call_reg = REG_ARG3;
@@ -282,11 +623,16 @@ static void* emit_native_mem_read_16(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
             emit_ram_read_16(region, region->ctxt);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_read_16(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -315,10 +661,13 @@ static void* emit_native_mem_read_16(struct memory_map const *map) {
     return native_mem_read_16_impl;
 }
 
-static void* emit_native_mem_read_float(struct memory_map const *map) {
+static void*
+emit_native_mem_read_float(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_read_float_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_read_float_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(float), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     // not actually used as an arg, I just need something volatile here
@@ -343,11 +692,16 @@ static void* emit_native_mem_read_float(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
             emit_ram_read_float(region, region->ctxt);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_read_float(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -376,10 +730,13 @@ static void* emit_native_mem_read_float(struct memory_map const *map) {
     return native_mem_read_float_impl;
 }
 
-static void* emit_native_mem_read_32(struct memory_map const *map) {
+static void*
+emit_native_mem_read_32(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_read_32_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_read_32_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(uint32_t), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     // not actually used as an arg, I just need something volatile here
@@ -404,11 +761,16 @@ static void* emit_native_mem_read_32(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
             emit_ram_read_32(region, region->ctxt);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_read_32(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -437,10 +799,13 @@ static void* emit_native_mem_read_32(struct memory_map const *map) {
     return native_mem_read_32_impl;
 }
 
-static void* emit_native_mem_write_8(struct memory_map const *map) {
+static void*
+emit_native_mem_write_8(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_write_8_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_write_8_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(uint8_t), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     // not actually used as an arg, I just need something volatile here
@@ -465,11 +830,16 @@ static void* emit_native_mem_write_8(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
-            emit_ram_write_8(region, region->ctxt);
+            emit_ram_write_8(region, region->ctxt, true);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_write_8(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call (the value to write is still in ESI)
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -498,10 +868,13 @@ static void* emit_native_mem_write_8(struct memory_map const *map) {
     return native_mem_write_8_impl;
 }
 
-static void* emit_native_mem_write_16(struct memory_map const *map) {
+static void*
+emit_native_mem_write_16(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_write_16_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_write_16_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(uint16_t), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     // not actually used as an arg, I just need something volatile here
@@ -526,11 +899,16 @@ static void* emit_native_mem_write_16(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
-            emit_ram_write_16(region, region->ctxt);
+            emit_ram_write_16(region, region->ctxt, true);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_write_16(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call (the value to write is still in ESI)
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -559,10 +937,13 @@ static void* emit_native_mem_write_16(struct memory_map const *map) {
     return native_mem_write_16_impl;
 }
 
-static void* emit_native_mem_write_32(struct memory_map const *map) {
+static void*
+emit_native_mem_write_32(struct memory_map const *map, void **jmp_tbl) {
     void *native_mem_write_32_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_write_32_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(uint32_t), jmp_tbl);
+
     static unsigned const addr_reg = REG_RET;
 
     // not actually used as an arg, I just need something volatile here
@@ -587,11 +968,16 @@ static void* emit_native_mem_write_32(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, addr_reg);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
-            emit_ram_write_32(region, region->ctxt);
+            emit_ram_write_32(region, region->ctxt, true);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_write_32(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call (the value to write is still in ESI)
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
@@ -620,7 +1006,8 @@ static void* emit_native_mem_write_32(struct memory_map const *map) {
     return native_mem_write_32_impl;
 }
 
-static void* emit_native_mem_write_float(struct memory_map const *map) {
+static void*
+emit_native_mem_write_float(struct memory_map const *map, void **jmp_tbl) {
     /*
      * XXX: if ADDR_REG is ever not REG_ARG0, this function will need to be
      * changed...
@@ -640,6 +1027,8 @@ static void* emit_native_mem_write_float(struct memory_map const *map) {
     void *native_mem_write_float_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_write_float_impl, NULL, BASIC_ALLOC);
 
+    emit_page_dispatch(map, sizeof(float), jmp_tbl);
+
     // this corresponds to the addr AND'd with the comparison mask
     static unsigned const CMP_ADDR_REG = REG_RET;
 
@@ -666,11 +1055,16 @@ static void* emit_native_mem_write_float(struct memory_map const *map) {
         x86asm_cmpl_imm32_reg32(region_end, CMP_ADDR_REG);
         x86asm_ja_lbl8(&check_next);
 
+        jmp_tbl[region_no] = x86asm_get_out_ptr();
+
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
-            emit_ram_write_float(region, region->ctxt);
+            emit_ram_write_float(region, region->ctxt, true);
             x86asm_ret();
             break;
+        case MEMORY_MAP_REGION_ORA:
+            emit_ora_write_float(region->ctxt);
+            // fall-through to the memory_interface if that didn't return
         default:
             // tail-call (the value to write is still in VAL_REG)
             x86asm_andl_imm32_reg32(region->mask, ADDR_REG);
@@ -740,7 +1134,8 @@ emit_ram_read_8(struct memory_map_region const *region, void *ctxt) {
 }
 
 static void
-emit_ram_write_8(struct memory_map_region const *region, void *ctxt) {
+emit_ram_write_8(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call) {
     // value to write should be in ESI
     // address should be in EDI
     struct Memory *mem = (struct Memory*)ctxt;
@@ -749,10 +1144,13 @@ emit_ram_write_8(struct memory_map_region const *region, void *ctxt) {
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
     x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+
+    emit_ram_write_notify(sizeof(uint8_t), tail_call);
 }
 
 static void
-emit_ram_write_16(struct memory_map_region const *region, void *ctxt) {
+emit_ram_write_16(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call) {
     // value to write should be in ESI
     // address should be in EDI
     struct Memory *mem = (struct Memory*)ctxt;
@@ -761,10 +1159,13 @@ emit_ram_write_16(struct memory_map_region const *region, void *ctxt) {
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
     x86asm_movw_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+
+    emit_ram_write_notify(sizeof(uint16_t), tail_call);
 }
 
 static void
-emit_ram_write_32(struct memory_map_region const *region, void *ctxt) {
+emit_ram_write_32(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call) {
     // value to write should be in ESI
     // address should be in EDI
     struct Memory *mem = (struct Memory*)ctxt;
@@ -772,10 +1173,13 @@ emit_ram_write_32(struct memory_map_region const *region, void *ctxt) {
     x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
+
+    emit_ram_write_notify(sizeof(uint32_t), tail_call);
 }
 
 static void
-emit_ram_write_float(struct memory_map_region const *region, void *ctxt) {
+emit_ram_write_float(struct memory_map_region const *region, void *ctxt,
+                 bool tail_call) {
     // address should be in EDI
     struct Memory *mem = (struct Memory*)ctxt;
 
@@ -789,6 +1193,262 @@ emit_ram_write_float(struct memory_map_region const *region, void *ctxt) {
 #else
 #error unknown abi
 #endif
+
+    emit_ram_write_notify(sizeof(float), tail_call);
+}
+
+/*
+ * inline access to the SH4's operand-cache RAM.  This only works when the CCR
+ * is set up the way sh4_ocache.h describes, anything else jumps to skip so the
+ * access can go through the region's memory_interface instead.  On success,
+ * EDI holds the offset into oc_ram_area and base_reg points to oc_ram_area.
+ * ORA never holds code, so writes don't need emit_ram_write_notify.
+ *
+ * This clobbers EAX.
+ */
+static void
+emit_ora_begin(void *ctxt, unsigned base_reg, struct x86asm_lbl8 *skip) {
+    struct Sh4 *sh4 = (struct Sh4*)ctxt;
+
+    x86asm_mov_imm64_reg64((uintptr_t)(sh4->reg + SH4_REG_CCR), REG_RET);
+    x86asm_movl_disp8_reg_reg(0, REG_RET, REG_RET);
+    x86asm_andl_imm32_reg32(SH4_ORA_DIRECT_CCR_MASK, REG_RET);
+    x86asm_cmpl_imm32_reg32(SH4_ORA_DIRECT_CCR_VAL, REG_RET);
+    x86asm_jnz_lbl8(skip);
+
+    x86asm_andl_imm32_reg32(SH4_ORA_DIRECT_ADDR_MASK, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)sh4->ocache.oc_ram_area, base_reg);
+}
+
+static void emit_ora_end(struct x86asm_lbl8 *skip) {
+    x86asm_ret();
+    x86asm_lbl8_define(skip);
+    x86asm_lbl8_cleanup(skip);
+}
+
+static void emit_ora_read_float(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_ARG1, &skip);
+    x86asm_movss_sib_xmm(REG_ARG1, 1, REG_ARG0, REG_RET_XMM);
+    emit_ora_end(&skip);
+}
+
+static void emit_ora_read_32(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_ARG1, &skip);
+    x86asm_movl_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+    emit_ora_end(&skip);
+}
+
+static void emit_ora_read_16(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_ARG1, &skip);
+    x86asm_xorl_reg32_reg32(REG_RET, REG_RET);
+    x86asm_movw_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+    emit_ora_end(&skip);
+}
+
+static void emit_ora_read_8(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_ARG1, &skip);
+    x86asm_xorl_reg32_reg32(REG_RET, REG_RET);
+    x86asm_movb_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+    emit_ora_end(&skip);
+}
+
+// value to write should be in ESI
+static void emit_ora_write_8(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_RET, &skip);
+    x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
+    x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+    emit_ora_end(&skip);
+}
+
+// value to write should be in ESI
+static void emit_ora_write_16(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_RET, &skip);
+    x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
+    x86asm_movw_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+    emit_ora_end(&skip);
+}
+
+// value to write should be in ESI
+static void emit_ora_write_32(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_RET, &skip);
+    x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
+    emit_ora_end(&skip);
+}
+
+static void emit_ora_write_float(void *ctxt) {
+    struct x86asm_lbl8 skip;
+    x86asm_lbl8_init(&skip);
+    emit_ora_begin(ctxt, REG_RET, &skip);
+#if defined(ABI_MICROSOFT)
+    x86asm_movss_xmm_sib(REG_ARG1_XMM, REG_RET, 1, REG_ARG0);
+#elif defined(ABI_UNIX)
+    x86asm_movss_xmm_sib(REG_ARG0_XMM, REG_RET, 1, REG_ARG0);
+#else
+#error unknown abi
+#endif
+    emit_ora_end(&skip);
+}
+
+/*
+ * check the code cache's page table to see if there are any compiled blocks
+ * in the page that was just written to, and call code_cache_invalidate_ram on
+ * the RAM owner if there are.  This is a tail-call when tail_call is set,
+ * otherwise it's a regular call and the stack needs to be aligned already.
+ * Either way, it falls through to whatever comes next.  The owner
+ * gets baked in when the code is emitted, so the owner needs to be set before
+ * the jit starts compiling anything.
+ *
+ * The RAM offset of the write should be in EDI.  This only checks the page of
+ * the first byte since the SH4 doesn't allow unaligned accesses.
+ */
+#if SAVESTATE_PAGE_SHIFT != CODE_CACHE_PAGE_SHIFT
+#error emit_ram_write_notify assumes save-states and the code cache use the \
+    same page size
+#endif
+
+static void emit_ram_write_notify(unsigned n_bytes, bool tail_call) {
+    struct x86asm_lbl8 no_code;
+    x86asm_lbl8_init(&no_code);
+
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG3);
+    x86asm_shrl_imm8_reg32(CODE_CACHE_PAGE_SHIFT, REG_ARG3);
+
+    /*
+     * single accesses are aligned, so they never span two pages.  Spans from
+     * native_mem_span_check can, but they're never bigger than a page so the
+     * last byte's page is the only other one they can touch.  ARG1 holds that
+     * page; the values were already written so it's free.
+     */
+    bool span = n_bytes > sizeof(uint32_t);
+    if (span) {
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+        x86asm_addl_imm8_reg32(n_bytes - 1, REG_ARG1);
+        x86asm_shrl_imm8_reg32(CODE_CACHE_PAGE_SHIFT, REG_ARG1);
+    }
+
+    /*
+     * mark the page dirty for save-states.  The value being written is dead
+     * by now, so its register is free to hold the 1.
+     */
+    x86asm_mov_imm64_reg64((uintptr_t)savestate_ram_dirty, REG_RET);
+    x86asm_mov_imm32_reg32(1, REG_ARG2);
+    x86asm_movb_reg_sib(REG_ARG2, REG_RET, 1, REG_ARG3);
+    if (span)
+        x86asm_movb_reg_sib(REG_ARG2, REG_RET, 1, REG_ARG1);
+
+    x86asm_mov_imm64_reg64((uintptr_t)code_cache_ram_pages, REG_RET);
+    if (span)
+        x86asm_movb_sib_reg(REG_RET, 1, REG_ARG1, REG_ARG2);
+    x86asm_movb_sib_reg(REG_RET, 1, REG_ARG3, REG_RET);
+    if (span)
+        x86asm_orl_reg32_reg32(REG_ARG2, REG_RET);
+    x86asm_testb_imm8_reg8(0xff, REG_RET);
+    x86asm_jz_lbl8(&no_code);
+
+    // call code_cache_invalidate_ram(owner, addr, addr + (n_bytes - 1))
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG2);
+    if (n_bytes > 1)
+        x86asm_addl_imm8_reg32(n_bytes - 1, REG_ARG2);
+    x86asm_mov_imm64_reg64((uintptr_t)code_cache_ram_owner, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)code_cache_invalidate_ram, REG_ARG3);
+    if (tail_call)
+        x86asm_jmpq_reg64(REG_ARG3);
+    else
+        x86asm_call_reg(REG_ARG3);
+
+    x86asm_lbl8_define(&no_code);
+    x86asm_lbl8_cleanup(&no_code);
+}
+
+/*
+ * find main RAM so it can be checked inline.
+ *
+ * Regions which come before RAM in the map take priority over it.  The only
+ * ones that can be handled are ones that don't overlap RAM at all and ones that
+ * cover everything from some address up to the top of the address space (which
+ * is how SH4_AREA_P4 works); those get an extra compare in emit_ram_check.  If
+ * there's anything else in front of RAM then the fast-path is disabled.
+ */
+static void find_ram(struct native_mem_map *native_map) {
+    struct memory_map const *map = native_map->map;
+    unsigned region_no;
+
+    native_map->ram = NULL;
+    native_map->ram_top = 0;
+
+    for (region_no = 0; region_no < map->n_regions; region_no++)
+        if (map->regions[region_no].id == MEMORY_MAP_REGION_RAM)
+            break;
+    if (region_no >= map->n_regions)
+        return;
+
+    struct memory_map_region const *ram = map->regions + region_no;
+    uint32_t ram_first = ram->first_addr, ram_last = ram->last_addr;
+
+    // merge any mirrors which come immediately after
+    unsigned next_no;
+    for (next_no = region_no + 1; next_no < map->n_regions; next_no++) {
+        struct memory_map_region const *next = map->regions + next_no;
+        if (next->id != MEMORY_MAP_REGION_RAM || next->host != ram->host ||
+            next->mask != ram->mask || next->range_mask != ram->range_mask ||
+            next->first_addr != ram_last + 1)
+            break;
+        ram_last = next->last_addr;
+    }
+
+    unsigned prev_no;
+    uint32_t top = 0;
+    for (prev_no = 0; prev_no < region_no; prev_no++) {
+        struct memory_map_region const *prev = map->regions + prev_no;
+        if (prev->range_mask == ram->range_mask &&
+            (prev->last_addr < ram_first || prev->first_addr > ram_last))
+            continue;
+        if (prev->range_mask == 0xffffffff && prev->last_addr == 0xffffffff) {
+            if (!top || prev->first_addr < top)
+                top = prev->first_addr;
+            continue;
+        }
+        return;
+    }
+
+    native_map->ram = ram;
+    native_map->ram_first = ram_first;
+    native_map->ram_last = ram_last;
+    native_map->ram_top = top;
+}
+
+/*
+ * jump to miss unless the entire access at the address in EDI is in main RAM.
+ * This clobbers EAX.
+ */
+static void emit_ram_check(struct native_mem_map const *native_map,
+                           unsigned n_bytes, struct x86asm_lbl8 *miss) {
+    if (native_map->ram_top) {
+        x86asm_cmpl_imm32_reg32(native_map->ram_top - (n_bytes - 1), REG_ARG0);
+        x86asm_jae_lbl8(miss);
+    }
+
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_RET);
+    x86asm_andl_imm32_reg32(native_map->ram->range_mask, REG_RET);
+    x86asm_cmpl_imm32_reg32(native_map->ram_first, REG_RET);
+    x86asm_jb_lbl8(miss);
+    x86asm_cmpl_imm32_reg32(native_map->ram_last - (n_bytes - 1), REG_RET);
+    x86asm_ja_lbl8(miss);
 }
 
 static struct native_mem_map *mem_map_impl(struct memory_map const *map) {
@@ -808,14 +1468,23 @@ void native_mem_register(struct memory_map const *map) {
         (struct native_mem_map*)malloc(sizeof(struct native_mem_map));
 
     native_map->map = map;
-    native_map->read_float_impl = emit_native_mem_read_float(map);
-    native_map->read_32_impl = emit_native_mem_read_32(map);
-    native_map->read_16_impl = emit_native_mem_read_16(map);
-    native_map->read_8_impl = emit_native_mem_read_8(map);
-    native_map->write_8_impl = emit_native_mem_write_8(map);
-    native_map->write_16_impl = emit_native_mem_write_16(map);
-    native_map->write_32_impl = emit_native_mem_write_32(map);
-    native_map->write_float_impl = emit_native_mem_write_float(map);
+    find_ram(native_map);
+    native_map->read_float_impl =
+        emit_native_mem_read_float(map, native_map->read_float_tbl);
+    native_map->read_32_impl =
+        emit_native_mem_read_32(map, native_map->read_32_tbl);
+    native_map->read_16_impl =
+        emit_native_mem_read_16(map, native_map->read_16_tbl);
+    native_map->read_8_impl =
+        emit_native_mem_read_8(map, native_map->read_8_tbl);
+    native_map->write_8_impl =
+        emit_native_mem_write_8(map, native_map->write_8_tbl);
+    native_map->write_16_impl =
+        emit_native_mem_write_16(map, native_map->write_16_tbl);
+    native_map->write_32_impl =
+        emit_native_mem_write_32(map, native_map->write_32_tbl);
+    native_map->write_float_impl =
+        emit_native_mem_write_float(map, native_map->write_float_tbl);
 
     fifo_push(&native_impl, &native_map->node);
 }
@@ -23,8 +23,12 @@
 #ifndef NATIVE_MEM_H_
 #define NATIVE_MEM_H_
 
+#include <stdbool.h>
+
 #include "washdc/MemoryMap.h"
 
+struct x86asm_lbl8;
+
 void native_mem_init(void);
 void native_mem_cleanup(void);
 
@@ -51,4 +55,32 @@ void native_mem_write_32(struct code_block_x86_64 *blk,
 void native_mem_write_float(struct code_block_x86_64 *blk,
                             struct memory_map const *map);
 
+/*
+ * just the call at the end of native_mem_read_32 and native_mem_write_32,
+ * without trying main RAM first.  For the accesses in JIT_OP_READ_32_BLOCK
+ * and JIT_OP_WRITE_32_BLOCK once their span has already missed.
+ */
+void native_mem_read_32_slow(struct code_block_x86_64 *blk,
+                             struct memory_map const *map);
+void native_mem_write_32_slow(struct code_block_x86_64 *blk,
+                              struct memory_map const *map);
+
+/*
+ * inline check for JIT_OP_READ_32_BLOCK and JIT_OP_WRITE_32_BLOCK.  If all
+ * n_bytes starting at the address in EDI are in main RAM, this falls through
+ * with the offset into RAM in EDI and a host pointer to that offset in RAX.
+ * Otherwise it jumps to miss.  This clobbers EAX either way.  If map has no
+ * inline fast-path then nothing gets emitted and this returns false.
+ *
+ * This always does the check, even when fastmem is enabled.
+ */
+bool native_mem_span_check(struct memory_map const *map, unsigned n_bytes,
+                           struct x86asm_lbl8 *miss);
+
+/*
+ * after writing to a span that passed native_mem_span_check.  EDI still needs
+ * to hold the offset into RAM, and the stack needs to be aligned.
+ */
+void native_mem_span_notify(struct code_block_x86_64 *blk, unsigned n_bytes);
+
 #endif
@@ -251,6 +251,21 @@ int register_pick_unused(struct register_set *set, enum register_hint hints) {
         if (reg_no >= 0)
             return reg_no;
     } else {
+        if (hints & REGISTER_HINT_VOLATILE) {
+            // volatile registers that don't need REX, then ones that do
+            reg_no =
+                pick_unused_reg_with_flags(set, REGISTER_FLAG_NONE,
+                                           REGISTER_FLAG_PRESERVED |
+                                           REGISTER_FLAG_REX);
+            if (reg_no >= 0)
+                return reg_no;
+            reg_no =
+                pick_unused_reg_with_flags(set, REGISTER_FLAG_NONE,
+                                           REGISTER_FLAG_PRESERVED);
+            if (reg_no >= 0)
+                return reg_no;
+        }
+
         /*
          * first look at registers that don't need a rex.
          * IDK why RAX gets top priority but this code
@@ -72,7 +72,13 @@ enum register_hint {
      * Tells the allocator that this slot will be used to access a the 8-bit
      * version of a register.
      */
-    REGISTER_HINT_8BIT = 8
+    REGISTER_HINT_8BIT = 8,
+
+    /*
+     * Tells the allocator that this slot won't be live across any function
+     * calls, so it should leave the preserved registers for slots that are.
+     */
+    REGISTER_HINT_VOLATILE = 16
 };
 
 struct reg_stat {
@@ -27,29 +27,123 @@
 #include "log.h"
 #include "washdc/log.h"
 #include "washdc/hostfile.h"
+#include "threading.h"
+#include "atomics.h"
+
+/*
+ * Messages get formatted on whatever thread logs them and then go through a
+ * ring to the logger thread, which is the only thing that writes them out.
+ *
+ * The ring is a bounded multi-producer queue.  Every slot has a sequence
+ * number; a producer can claim the slot at position pos when its sequence
+ * number is pos, and the consumer can take it once the sequence number is
+ * pos + 1.  Positions are free-running and only ever compared by their
+ * difference, so it doesn't matter when they wrap around.
+ */
+#define LOG_REC_LEN 1024
+#define LOG_RING_SHIFT 9
+#define LOG_RING_LEN (1 << LOG_RING_SHIFT)
+#define LOG_RING_MASK (LOG_RING_LEN - 1)
+
+// the logger thread wakes up anybody waiting on it at least this often
+#define LOG_DRAIN_BATCH 64
+
+struct log_rec {
+    washdc_atomic_int seq;
+    bool to_stdout;
+    char msg[LOG_REC_LEN];
+};
 
 static washdc_hostfile logfile;
 static bool also_stdout;
 static bool verbose_mode;
+static bool drop_on_overflow;
+
+static struct log_rec ring[LOG_RING_LEN];
+static washdc_atomic_int enq_pos, deq_pos, n_dropped;
+
+// set by the logger thread while it's waiting for something to do
+static washdc_atomic_int logger_idle;
+
+static bool logger_running;
+static washdc_thread logger_thread;
+static washdc_mutex logger_lock = WASHDC_MUTEX_STATIC_INIT;
+
+// signals the logger thread
+static washdc_cvar logger_cvar = WASHDC_CVAR_STATIC_INIT;
+
+// the logger thread signals this after making progress
+static washdc_cvar drain_cvar = WASHDC_CVAR_STATIC_INIT;
+
+// these are protected by logger_lock
+static bool logger_quit, flush_req;
 
 static void log_do_write_vararg(enum log_severity lvl,
                                 char const *fmt, va_list args);
+static void logger_main(void *argp);
+
+static inline int pos_add(int pos, int n) {
+    return (int)((unsigned)pos + (unsigned)n);
+}
+
+static inline int pos_diff(int lhs, int rhs) {
+    return (int)((unsigned)lhs - (unsigned)rhs);
+}
 
-void log_init(bool to_stdout, bool verbose) {
+void log_init(bool to_stdout, bool verbose, bool drop) {
     logfile =
         washdc_hostfile_open("wash.log",
                              WASHDC_HOSTFILE_WRITE | WASHDC_HOSTFILE_TEXT);
     also_stdout = to_stdout;
     verbose_mode = verbose;
+    drop_on_overflow = drop;
+
+    unsigned idx;
+    for (idx = 0; idx < LOG_RING_LEN; idx++)
+        washdc_atomic_int_init(&ring[idx].seq, idx);
+    washdc_atomic_int_init(&enq_pos, 0);
+    washdc_atomic_int_init(&deq_pos, 0);
+    washdc_atomic_int_init(&n_dropped, 0);
+    washdc_atomic_int_init(&logger_idle, 0);
+
+    logger_quit = false;
+    flush_req = false;
+    logger_running = true;
+    washdc_thread_create(&logger_thread, logger_main, NULL);
 }
 
 void log_cleanup(void) {
+    if (logger_running) {
+        washdc_mutex_lock(&logger_lock);
+        logger_quit = true;
+        washdc_cvar_signal(&logger_cvar);
+        washdc_mutex_unlock(&logger_lock);
+
+        washdc_thread_join(&logger_thread);
+        logger_running = false;
+    }
+
     washdc_hostfile_close(logfile);
     logfile = NULL;
 }
 
+// wait until everything logged so far has been written out
 void log_flush(void) {
-    washdc_hostfile_flush(logfile);
+    if (!logger_running) {
+        washdc_hostfile_flush(logfile);
+        return;
+    }
+
+    int target = washdc_atomic_int_load(&enq_pos);
+
+    washdc_mutex_lock(&logger_lock);
+    flush_req = true;
+    washdc_cvar_signal(&logger_cvar);
+    while (flush_req ||
+           pos_diff(washdc_atomic_int_load(&deq_pos), target) < 0) {
+        washdc_cvar_wait(&drain_cvar, &logger_lock);
+    }
+    washdc_mutex_unlock(&logger_lock);
 }
 
 washdc_hostfile log_get_file(void) {
@@ -64,22 +158,146 @@ void log_do_write(enum log_severity lvl, char const *fmt, ...) {
     va_end(args);
 }
 
+// returns NULL if the ring is full
+static struct log_rec *rec_claim(int *pos_out) {
+    int pos = washdc_atomic_int_load(&enq_pos);
+    for (;;) {
+        struct log_rec *rec = ring + (pos & LOG_RING_MASK);
+        int diff = pos_diff(washdc_atomic_int_load(&rec->seq), pos);
+        if (diff == 0) {
+            if (washdc_atomic_int_compare_exchange(&enq_pos, &pos,
+                                                   pos_add(pos, 1))) {
+                *pos_out = pos;
+                return rec;
+            }
+            // pos now holds the new value of enq_pos
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = washdc_atomic_int_load(&enq_pos);
+        }
+    }
+}
+
 static void log_do_write_vararg(enum log_severity lvl,
                                 char const *fmt, va_list args) {
-    static char buf[1024];
-    if (verbose_mode || lvl >= log_severity_info) {
+    if (!verbose_mode && lvl < log_severity_info)
+        return;
+
+    bool to_stdout = also_stdout || lvl >= log_severity_error;
+
+    if (!logger_running) {
+        static char buf[LOG_REC_LEN];
         va_list args2;
         va_copy(args2, args);
         vsnprintf(buf, sizeof(buf), fmt, args);
         buf[sizeof(buf) - 1] = '\0';
         washdc_hostfile_write(logfile, buf, strlen(buf));
 
-        if (also_stdout || lvl >= log_severity_error)
+        if (to_stdout)
             vprintf(fmt, args2);
         va_end(args2);
+        return;
+    }
+
+    int pos;
+    struct log_rec *rec = rec_claim(&pos);
+    if (!rec) {
+        if (drop_on_overflow) {
+            int n = washdc_atomic_int_load(&n_dropped);
+            while (!washdc_atomic_int_compare_exchange(&n_dropped, &n, n + 1))
+                ;
+            return;
+        }
+
+        // wait for the logger thread to make room
+        washdc_mutex_lock(&logger_lock);
+        while (!(rec = rec_claim(&pos))) {
+            washdc_cvar_signal(&logger_cvar);
+            washdc_cvar_wait(&drain_cvar, &logger_lock);
+        }
+        washdc_mutex_unlock(&logger_lock);
+    }
+
+    vsnprintf(rec->msg, sizeof(rec->msg), fmt, args);
+    rec->msg[sizeof(rec->msg) - 1] = '\0';
+    rec->to_stdout = to_stdout;
+    washdc_atomic_int_store(&rec->seq, pos_add(pos, 1));
+
+    if (washdc_atomic_int_load(&logger_idle)) {
+        washdc_mutex_lock(&logger_lock);
+        washdc_cvar_signal(&logger_cvar);
+        washdc_mutex_unlock(&logger_lock);
+    }
+}
+
+static bool ring_empty(void) {
+    int pos = washdc_atomic_int_load(&deq_pos);
+    struct log_rec *rec = ring + (pos & LOG_RING_MASK);
+    return pos_diff(washdc_atomic_int_load(&rec->seq), pos_add(pos, 1)) != 0;
+}
+
+static void report_dropped(void) {
+    int n = washdc_atomic_int_load(&n_dropped);
+    while (n && !washdc_atomic_int_compare_exchange(&n_dropped, &n, 0))
+        ;
+    if (n) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "*** %d LOG MESSAGES DROPPED ***\n", n);
+        washdc_hostfile_write(logfile, msg, strlen(msg));
     }
 }
 
+static void logger_main(void *argp) {
+    unsigned batch = 0;
+
+    for (;;) {
+        int pos = washdc_atomic_int_load(&deq_pos);
+        struct log_rec *rec = ring + (pos & LOG_RING_MASK);
+        if (pos_diff(washdc_atomic_int_load(&rec->seq), pos_add(pos, 1)) == 0) {
+            washdc_hostfile_write(logfile, rec->msg, strlen(rec->msg));
+            if (rec->to_stdout)
+                fputs(rec->msg, stdout);
+
+            washdc_atomic_int_store(&rec->seq, pos_add(pos, LOG_RING_LEN));
+            washdc_atomic_int_store(&deq_pos, pos_add(pos, 1));
+
+            if (++batch < LOG_DRAIN_BATCH)
+                continue;
+        }
+        batch = 0;
+
+        report_dropped();
+
+        washdc_mutex_lock(&logger_lock);
+        washdc_atomic_int_store(&logger_idle, 1);
+        if (ring_empty()) {
+            if (flush_req) {
+                washdc_hostfile_flush(logfile);
+                fflush(stdout);
+                flush_req = false;
+            }
+            washdc_cvar_broadcast(&drain_cvar);
+
+            while (ring_empty() && !logger_quit && !flush_req)
+                washdc_cvar_wait(&logger_cvar, &logger_lock);
+
+            if (ring_empty() && logger_quit) {
+                washdc_mutex_unlock(&logger_lock);
+                break;
+            }
+        } else {
+            washdc_cvar_broadcast(&drain_cvar);
+        }
+        washdc_atomic_int_store(&logger_idle, 0);
+        washdc_mutex_unlock(&logger_lock);
+    }
+
+    report_dropped();
+    washdc_hostfile_flush(logfile);
+    fflush(stdout);
+}
+
 void washdc_log(enum washdc_log_severity severity,
                 char const *fmt, va_list args) {
     enum log_severity lvl;
@@ -68,7 +68,11 @@ enum log_severity {
 
 void log_do_write(enum log_severity lvl, char const *fmt, ...);
 
-void log_init(bool to_stdout, bool verbose);
+/*
+ * if drop is true, messages logged while the logger thread is too far behind
+ * get thrown away instead of making the caller wait.
+ */
+void log_init(bool to_stdout, bool verbose, bool drop);
 void log_flush(void);
 void log_cleanup(void);
 
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "washdc/error.h"
+#include "log.h"
+
+#include "mapped_file.h"
+
+int mapped_file_open(struct mapped_file *mf, char const *path, size_t len) {
+    memset(mf, 0, sizeof(*mf));
+
+#ifdef _WIN32
+    return -1;
+#else
+    if (!len)
+        return -1;
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != len) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        LOG_WARN("unable to map \"%s\"; falling back to buffered writes\n",
+                 path);
+        return -1;
+    }
+
+    mf->dat = (uint8_t*)map;
+    mf->len = len;
+    mf->page_sz = sysconf(_SC_PAGESIZE);
+    mf->n_pages = (len + mf->page_sz - 1) / mf->page_sz;
+    mf->dirty = (uint32_t*)calloc((mf->n_pages + 31) / 32, sizeof(uint32_t));
+    if (!mf->dirty)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    return 0;
+#endif
+}
+
+void mapped_file_close(struct mapped_file *mf) {
+#ifndef _WIN32
+    if (!mf->dat)
+        return;
+
+    mapped_file_sync(mf, true);
+    munmap(mf->dat, mf->len);
+    free(mf->dirty);
+    memset(mf, 0, sizeof(*mf));
+#endif
+}
+
+void mapped_file_mark(struct mapped_file *mf, size_t offs, size_t len) {
+    if (!len || offs >= mf->len)
+        return;
+    if (len > mf->len - offs)
+        len = mf->len - offs;
+
+    unsigned page = offs / mf->page_sz;
+    unsigned last = (offs + len - 1) / mf->page_sz;
+    for (; page <= last; page++)
+        mf->dirty[page / 32] |= 1u << (page % 32);
+}
+
+void mapped_file_sync(struct mapped_file *mf, bool wait) {
+#ifndef _WIN32
+    int flags = wait ? MS_SYNC : MS_ASYNC;
+    unsigned page = 0;
+
+    // flush each run of consecutive dirty pages with a single msync
+    while (page < mf->n_pages) {
+        if (!(mf->dirty[page / 32] & (1u << (page % 32)))) {
+            page++;
+            continue;
+        }
+
+        unsigned first = page;
+        while (page < mf->n_pages &&
+               (mf->dirty[page / 32] & (1u << (page % 32)))) {
+            mf->dirty[page / 32] &= ~(1u << (page % 32));
+            page++;
+        }
+
+        size_t offs = first * mf->page_sz;
+        size_t len = (page - first) * mf->page_sz;
+        if (offs + len > mf->len)
+            len = mf->len - offs;
+        if (msync(mf->dat + offs, len, flags) != 0)
+            LOG_ERROR("%s - msync failed\n", __func__);
+    }
+#endif
+}
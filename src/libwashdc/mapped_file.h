@@ -0,0 +1,66 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+/*
+ * mapped_file.h
+ *
+ * Writable shared mappings for small backing stores like the VMU and flash
+ * images.  Writes land directly in the host's page cache, and the pages that
+ * were written get tracked so that a sync only has to flush those instead of
+ * rewriting the whole file.  This isn't available on Windows, so callers need
+ * to keep a buffered fallback for when mapped_file_open fails.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+struct mapped_file {
+    uint8_t *dat;
+    size_t len;
+
+    size_t page_sz;
+    unsigned n_pages;
+    uint32_t *dirty; // one bit per page
+};
+
+/*
+ * map the file at path, which must already exist and be exactly len bytes
+ * long.  Returns 0 on success or -1 if the file couldn't be mapped.
+ */
+int mapped_file_open(struct mapped_file *mf, char const *path, size_t len);
+
+// flushes everything and unmaps the file
+void mapped_file_close(struct mapped_file *mf);
+
+// call this after writing to [offs, offs + len) of mf->dat
+void mapped_file_mark(struct mapped_file *mf, size_t offs, size_t len);
+
+/*
+ * write back the pages that were marked since the last sync.  If wait is
+ * false then the writes are only scheduled.
+ */
+void mapped_file_sync(struct mapped_file *mf, bool wait);
+
+#endif
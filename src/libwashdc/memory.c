@@ -23,17 +23,48 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "hostmem.h"
 #include "memory.h"
 
+#ifdef ENABLE_JIT_X86_64
+#include "config.h"
+#include "jit/x86_64/fastmem.h"
+#endif
+
 void memory_init(struct Memory *mem) {
+    mem->mem = NULL;
+    mem->fastmem = false;
+
+#ifdef ENABLE_JIT_X86_64
+    if (config_get_native_jit() && config_get_jit_fastmem()) {
+        mem->mem = (uint8_t*)fastmem_alloc_ram(MEMORY_SIZE);
+        mem->fastmem = (mem->mem != NULL);
+    }
+#endif
+
+    if (!mem->mem) {
+        mem->mem = (uint8_t*)hostmem_alloc(MEMORY_SIZE);
+        if (!mem->mem)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
     memory_clear(mem);
 }
 
 void memory_cleanup(struct Memory *mem) {
+#ifdef ENABLE_JIT_X86_64
+    if (mem->fastmem)
+        fastmem_free_ram(mem->mem);
+    else
+#endif
+        hostmem_free(mem->mem, MEMORY_SIZE);
+    mem->mem = NULL;
 }
 
 void memory_clear(struct Memory *mem) {
     memset(mem->mem, 0, sizeof(mem->mem[0]) * MEMORY_SIZE);
+    code_cache_notify_ram_range(0, MEMORY_MASK);
+    savestate_notify_ram_range(0, MEMORY_MASK);
 }
 
 struct memory_interface ram_intf = {
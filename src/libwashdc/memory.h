@@ -25,18 +25,25 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "washdc/error.h"
 #include "washdc/types.h"
 #include "mem_code.h"
 #include "washdc/MemoryMap.h"
+#include "jit/code_cache.h"
+#include "savestate.h"
 
 #define MEMORY_SIZE_SHIFT 24
 #define MEMORY_SIZE (1 << MEMORY_SIZE_SHIFT)
 #define MEMORY_MASK (MEMORY_SIZE - 1)
 
 struct Memory {
-    uint8_t mem[MEMORY_SIZE];
+    // MEMORY_SIZE bytes
+    uint8_t *mem;
+
+    // true if mem came from fastmem_alloc_ram, otherwise it's from hostmem_alloc
+    bool fastmem;
 };
 
 void memory_init(struct Memory *mem);
@@ -72,6 +79,8 @@ memory_write(struct Memory *mem, void const *buf, size_t addr, size_t len) {
     }
 
     memcpy(mem->mem + addr, buf, len);
+    code_cache_notify_ram_range(addr, end_addr);
+    savestate_notify_ram_range(addr, end_addr);
 
     return 0;
 }
@@ -80,30 +89,40 @@ static inline void
 memory_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    code_cache_notify_ram_write(addr, sizeof(val));
+    savestate_notify_ram_write(addr, sizeof(val));
 }
 
 static inline void
 memory_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    code_cache_notify_ram_write(addr, sizeof(val));
+    savestate_notify_ram_write(addr, sizeof(val));
 }
 
 static inline void
 memory_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    code_cache_notify_ram_write(addr, sizeof(val));
+    savestate_notify_ram_write(addr, sizeof(val));
 }
 
 static inline void
 memory_write_float(addr32_t addr, float val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    code_cache_notify_ram_write(addr, sizeof(val));
+    savestate_notify_ram_write(addr, sizeof(val));
 }
 
 static inline void
 memory_write_double(addr32_t addr, double val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    code_cache_notify_ram_write(addr, sizeof(val));
+    savestate_notify_ram_write(addr, sizeof(val));
 }
 
 static inline uint8_t
@@ -0,0 +1,127 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * washdc_bench - microbenchmarks for the emulator's hot inner kernels.
+ *
+ * usage: washdc_bench [filter]
+ *
+ * if filter is given, only cases whose names contain it get run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "real_ticks.h"
+
+#include "microbench.h"
+
+#define MAX_CASES 128
+
+// keep doubling the iteration count until a run takes at least this long
+#define MIN_RUN_SECONDS 0.1
+
+#define MAX_ITER (1UL << 30)
+
+volatile uint32_t microbench_sink;
+
+static struct microbench_case cases[MAX_CASES];
+static unsigned n_cases;
+
+void microbench_add(struct microbench_case const *bench) {
+    if (n_cases >= MAX_CASES) {
+        fprintf(stderr, "%s - too many cases\n", __func__);
+        exit(1);
+    }
+    cases[n_cases++] = *bench;
+}
+
+static double time_run(struct microbench_case const *bench,
+                       unsigned long n_iter) {
+    washdc_real_time start, end, delta;
+
+    washdc_get_real_time(&start);
+    bench->run(bench->arg, n_iter);
+    washdc_get_real_time(&end);
+
+    washdc_real_time_diff(&delta, &end, &start);
+    return washdc_real_time_to_seconds(&delta);
+}
+
+static void run_case(struct microbench_case const *bench) {
+    unsigned long n_iter = 1;
+    double seconds;
+
+    if (bench->setup)
+        bench->setup(bench->arg);
+
+    for (;;) {
+        seconds = time_run(bench, n_iter);
+        if (seconds >= MIN_RUN_SECONDS || n_iter >= MAX_ITER)
+            break;
+        n_iter *= 2;
+    }
+
+    printf("%-40s %12lu %14.2f\n", bench->name, n_iter,
+           seconds * 1000000000.0 / n_iter);
+    fflush(stdout);
+
+    if (bench->teardown)
+        bench->teardown(bench->arg);
+}
+
+int main(int argc, char **argv) {
+    char const *filter = NULL;
+
+    if (argc > 2 || (argc == 2 && (strcmp(argv[1], "-h") == 0 ||
+                                   strcmp(argv[1], "--help") == 0))) {
+        fprintf(stderr, "usage: %s [filter]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2)
+        filter = argv[1];
+
+    mb_sched_register();
+    mb_memory_map_register();
+    mb_tex_register();
+    mb_sh4_register();
+    mb_aica_register();
+    mb_code_cache_register();
+
+    printf("%-40s %12s %14s\n", "case", "iterations", "ns/iter");
+
+    unsigned idx, n_run = 0;
+    for (idx = 0; idx < n_cases; idx++) {
+        if (filter && !strstr(cases[idx].name, filter))
+            continue;
+        run_case(cases + idx);
+        n_run++;
+    }
+
+    if (!n_run) {
+        fprintf(stderr, "no cases match \"%s\"\n", filter);
+        return 1;
+    }
+
+    return 0;
+}
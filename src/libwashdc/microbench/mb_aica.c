@@ -0,0 +1,143 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * AICA mixing microbenchmarks: one AICA_SAMPLE_BLOCK_LEN block through
+ * aica_process_samples per iteration with some number of looping channels
+ * playing out of random wave memory.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dc_sched.h"
+#include "sound.h"
+#include "hw/arm7/arm7.h"
+#include "hw/aica/aica.h"
+
+#include "microbench.h"
+
+#define AICA_CASE(n_chan, fmt) ((void*)(uintptr_t)((n_chan) | ((fmt) << 8)))
+#define AICA_CASE_N_CHAN(arg) ((uintptr_t)(arg) & 0xff)
+#define AICA_CASE_FMT(arg) ((enum aica_fmt)((uintptr_t)(arg) >> 8))
+
+static struct dc_clock clk;
+static struct arm7 arm7;
+static struct aica aica;
+
+static void null_snd_init(void) {
+}
+
+static void null_snd_cleanup(void) {
+}
+
+static void null_snd_submit(washdc_sample_type *samples, unsigned count) {
+    microbench_sink += samples[count - 1];
+}
+
+static struct washdc_sound_intf const null_snd_intf = {
+    .init = null_snd_init,
+    .cleanup = null_snd_cleanup,
+    .submit_samples = null_snd_submit
+};
+
+static void aica_setup(void *arg) {
+    unsigned n_chan = AICA_CASE_N_CHAN(arg);
+
+    dc_clock_init(&clk);
+    aica_init(&aica, &arm7, &clk, &clk);
+    dc_sound_init(&null_snd_intf);
+
+    unsigned idx;
+    for (idx = 0; idx < AICA_WAVE_MEM_LEN; idx++)
+        aica.mem.mem[idx] = rand();
+
+    // every channel gets its own 32KB of wave memory
+    unsigned chan_no;
+    for (chan_no = 0; chan_no < n_chan; chan_no++) {
+        struct aica_chan *chan = aica.channels + chan_no;
+        chan->fmt = AICA_CASE_FMT(arg);
+        chan->addr_start = chan->addr_cur = chan_no * 0x8000;
+        chan->loop_en = true;
+        chan->loop_start = 0;
+        switch (chan->fmt) {
+        case AICA_FMT_16_BIT_SIGNED:
+            chan->loop_end = 0x3fff;
+            break;
+        case AICA_FMT_8_BIT_SIGNED:
+            chan->loop_end = 0x7fff;
+            break;
+        default:
+            chan->loop_end = 0xffff;
+        }
+
+        /*
+         * zero envelope rates in the sustain state keep the channel from
+         * ever fading out on its own.
+         */
+        chan->atten_env_state = AICA_ENV_SUSTAIN;
+        chan->atten = 0;
+        chan->volume = 0xf;
+        chan->octave = 0;
+        chan->fns = 0;
+        chan->adpcm_next_step = true;
+        chan->playing = true;
+    }
+}
+
+static void aica_run(void *arg, unsigned long n_iter) {
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++)
+        aica_process_samples(&aica, AICA_SAMPLE_BLOCK_LEN);
+}
+
+static void aica_teardown(void *arg) {
+    dc_sound_cleanup();
+    aica_cleanup(&aica);
+    dc_clock_cleanup(&clk);
+}
+
+void mb_aica_register(void) {
+    static struct {
+        char const *name;
+        void *arg;
+    } const chan_cases[] = {
+        { "aica/mix_block_1ch_pcm16", AICA_CASE(1, AICA_FMT_16_BIT_SIGNED) },
+        { "aica/mix_block_16ch_pcm16", AICA_CASE(16, AICA_FMT_16_BIT_SIGNED) },
+        { "aica/mix_block_64ch_pcm16", AICA_CASE(64, AICA_FMT_16_BIT_SIGNED) },
+        { "aica/mix_block_64ch_pcm8", AICA_CASE(64, AICA_FMT_8_BIT_SIGNED) },
+        { "aica/mix_block_64ch_adpcm", AICA_CASE(64, AICA_FMT_4_BIT_ADPCM) }
+    };
+
+    unsigned idx;
+    for (idx = 0; idx < sizeof(chan_cases) / sizeof(chan_cases[0]); idx++) {
+        struct microbench_case bench = {
+            .name = chan_cases[idx].name,
+            .setup = aica_setup,
+            .run = aica_run,
+            .teardown = aica_teardown,
+            .arg = chan_cases[idx].arg
+        };
+        microbench_add(&bench);
+    }
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+/*
+ * code cache microbenchmarks: lookups through code_cache_find_slow, ie the
+ * path taken whenever the direct-mapped table in front of the cache misses.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "jit/code_cache.h"
+#include "washdc/error.h"
+
+#include "microbench.h"
+
+#define MAX_BLOCKS (64 * 1024)
+
+static struct code_cache cache;
+static jit_hash keys[MAX_BLOCKS];
+
+static void code_cache_setup(void *arg) {
+    unsigned n_blocks = (uintptr_t)arg;
+
+    code_cache_init(&cache, CODE_CACHE_HASH_TBL_SHIFT, false);
+
+    // block addresses scattered across main RAM, 2-byte aligned like SH4 code
+    unsigned idx;
+    for (idx = 0; idx < n_blocks; idx++) {
+        keys[idx] = 0x8c000000 | ((rand() << 1) & 0x00fffffe);
+        code_cache_find_slow(&cache, keys[idx]);
+    }
+}
+
+static void code_cache_run(void *arg, unsigned long n_iter) {
+    unsigned n_blocks = (uintptr_t)arg;
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++) {
+        jit_hash key = keys[iter % n_blocks];
+        struct cache_entry *ent = code_cache_find_slow(&cache, key);
+        if (ent->key != key)
+            RAISE_ERROR(ERROR_INTEGRITY);
+        microbench_sink += (uintptr_t)ent;
+    }
+}
+
+static void code_cache_teardown(void *arg) {
+    code_cache_cleanup(&cache);
+}
+
+void mb_code_cache_register(void) {
+    static char names[3][32];
+    static unsigned const counts[3] = { 1024, 16 * 1024, MAX_BLOCKS };
+    unsigned idx;
+    for (idx = 0; idx < 3; idx++) {
+        snprintf(names[idx], sizeof(names[idx]), "code_cache/find_slow_%u",
+                 counts[idx]);
+        struct microbench_case bench = {
+            .name = names[idx],
+            .setup = code_cache_setup,
+            .run = code_cache_run,
+            .teardown = code_cache_teardown,
+            .arg = (void*)(uintptr_t)counts[idx]
+        };
+        microbench_add(&bench);
+    }
+}
@@ -0,0 +1,117 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * memory_map_read_32 microbenchmarks, one per kind of page-table entry:
+ * host-backed RAM, a region that goes through its interface's callbacks, a
+ * page shared between two regions (which falls back to the linear search) and
+ * an unmapped page.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "washdc/MemoryMap.h"
+#include "memory.h"
+#include "mem_areas.h"
+
+#include "microbench.h"
+
+#define N_ADDRS 4096
+
+static struct memory_map map;
+static struct Memory mem;
+static uint32_t addrs[N_ADDRS];
+
+static uint32_t dummy_read32(uint32_t addr, void *ctxt) {
+    return addr;
+}
+
+static struct memory_interface dummy_intf = {
+    .read32 = dummy_read32
+};
+
+static void mem_map_setup(void *arg) {
+    uint32_t base = (uintptr_t)arg;
+
+    memory_init(&mem);
+    memory_map_init(&map);
+
+    memory_map_add(&map, 0x0c000000, 0x0cffffff,
+                   0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
+                   &ram_intf, &mem);
+    memory_map_add(&map, 0x00800000, 0x009fffff,
+                   0x1fffffff, 0x001fffff, MEMORY_MAP_REGION_UNKNOWN,
+                   &dummy_intf, NULL);
+
+    // two regions splitting a single page between them
+    memory_map_add(&map, 0x01000000, 0x01007fff,
+                   0x1fffffff, 0x7fff, MEMORY_MAP_REGION_UNKNOWN,
+                   &dummy_intf, NULL);
+    memory_map_add(&map, 0x01008000, 0x0100ffff,
+                   0x1fffffff, 0x7fff, MEMORY_MAP_REGION_UNKNOWN,
+                   &dummy_intf, NULL);
+
+    map.unmap = &dummy_intf;
+
+    // random dword-aligned offsets within a single 64KB page
+    unsigned idx;
+    for (idx = 0; idx < N_ADDRS; idx++)
+        addrs[idx] = base + ((rand() % MEMORY_MAP_PAGE_SIZE) & ~3);
+}
+
+static void mem_map_run(void *arg, unsigned long n_iter) {
+    uint32_t sum = 0;
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++)
+        sum += memory_map_read_32(&map, addrs[iter % N_ADDRS]);
+    microbench_sink = sum;
+}
+
+static void mem_map_teardown(void *arg) {
+    memory_map_cleanup(&map);
+    memory_cleanup(&mem);
+}
+
+void mb_memory_map_register(void) {
+    static struct {
+        char const *name;
+        uint32_t base;
+    } const regions[] = {
+        { "memory_map/read_32_ram", 0x0c010000 },
+        { "memory_map/read_32_intf", 0x00810000 },
+        { "memory_map/read_32_mixed_page", 0x01000000 },
+        { "memory_map/read_32_unmapped", 0x10000000 }
+    };
+
+    unsigned idx;
+    for (idx = 0; idx < sizeof(regions) / sizeof(regions[0]); idx++) {
+        struct microbench_case bench = {
+            .name = regions[idx].name,
+            .setup = mem_map_setup,
+            .run = mem_map_run,
+            .teardown = mem_map_teardown,
+            .arg = (void*)(uintptr_t)regions[idx].base
+        };
+        microbench_add(&bench);
+    }
+}
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * scheduler microbenchmarks: one sched_event/pop_event pair with depth - 1
+ * other events already sitting in the heap.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dc_sched.h"
+#include "washdc/error.h"
+
+#include "microbench.h"
+
+#define MAX_DEPTH 256
+
+static struct dc_clock clk;
+static struct SchedEvent filler[MAX_DEPTH];
+static struct SchedEvent evt;
+
+static void null_handler(struct SchedEvent *event) {
+}
+
+static void sched_setup(void *arg) {
+    unsigned depth = (uintptr_t)arg;
+
+    dc_clock_init(&clk);
+
+    /*
+     * the filler events go far off in the future so that the event being
+     * measured is always the one that comes back out of pop_event.
+     */
+    unsigned idx;
+    for (idx = 0; idx < depth - 1; idx++) {
+        filler[idx].handler = null_handler;
+        filler[idx].when = (((dc_cycle_stamp_t)1) << 48) + rand();
+        sched_event(&clk, filler + idx);
+    }
+
+    evt.handler = null_handler;
+}
+
+static void sched_run(void *arg, unsigned long n_iter) {
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++) {
+        evt.when = iter;
+        sched_event(&clk, &evt);
+        if (pop_event(&clk) != &evt)
+            RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+static void sched_teardown(void *arg) {
+    dc_clock_cleanup(&clk);
+}
+
+void mb_sched_register(void) {
+    static char names[9][32];
+    unsigned depth, idx = 0;
+    for (depth = 1; depth <= MAX_DEPTH; depth *= 2, idx++) {
+        snprintf(names[idx], sizeof(names[idx]), "sched/depth_%u", depth);
+        struct microbench_case bench = {
+            .name = names[idx],
+            .setup = sched_setup,
+            .run = sched_run,
+            .teardown = sched_teardown,
+            .arg = (void*)(uintptr_t)depth
+        };
+        microbench_add(&bench);
+    }
+}
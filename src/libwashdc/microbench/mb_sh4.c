@@ -0,0 +1,280 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * SH4 microbenchmarks.  Each case runs a short synthetic loop out of system
+ * memory, either one instruction at a time through the interpreter
+ * (sh4_do_exec_inst) or one whole block at a time through the IL interpreter
+ * (code_block_intp_exec).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dc_sched.h"
+#include "memory.h"
+#include "mem_areas.h"
+#include "washdc/MemoryMap.h"
+#include "hw/sh4/sh4.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/sh4_read_inst.h"
+#include "hw/sh4/sh4_jit.h"
+#include "jit/code_block.h"
+
+#include "microbench.h"
+
+#define PROG_ADDR 0x8c010000
+#define DATA_ADDR 0x8c100000
+
+struct sh4_prog {
+    uint16_t const *insts;
+    unsigned n_insts;
+};
+
+// integer ALU ops followed by a branch back to the start
+static uint16_t const alu_prog[] = {
+    0x7001, // ADD #1, R0
+    0x7101, // ADD #1, R1
+    0x3018, // SUB R1, R0
+    0x201a, // XOR R1, R0
+    0xaffa, // BRA PROG_ADDR
+    0x0009  // NOP
+};
+
+// a load and a store to system memory followed by a branch back to the start
+static uint16_t const mem_prog[] = {
+    0x6322, // MOV.L @R2, R3
+    0x2432, // MOV.L R3, @R4
+    0xaffc, // BRA PROG_ADDR
+    0x0009  // NOP
+};
+
+/*
+ * native ALU ops interleaved with ops the jit implements as interpreter
+ * fallbacks
+ */
+static uint16_t const mixed_prog[] = {
+    0x7001, // ADD #1, R0
+    0x312e, // ADDC R2, R1
+    0x330c, // ADD R0, R3
+    0x613b, // NEG R3, R1
+    0x203a, // XOR R3, R0
+    0xaff9, // BRA PROG_ADDR
+    0x0009  // NOP
+};
+
+// one step of an unsigned 32-bit division, quotient in R0 and remainder in R6
+#define DIV_STEP \
+    0x4024, /* ROTCL R0 */ \
+    0x3654  /* DIV1 R5, R6 */
+
+// the unrolled DIV0U/DIV1 sequence a compiler emits for unsigned division
+static uint16_t const div_prog[] = {
+    0xe600, // MOV #0, R6
+    0x0019, // DIV0U
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    DIV_STEP, DIV_STEP, DIV_STEP, DIV_STEP,
+    0x4024, // ROTCL R0
+    0xafbb, // BRA PROG_ADDR
+    0x0009  // NOP
+};
+
+// a function prologue's pushes followed by the matching epilogue's pops
+static uint16_t const stack_prog[] = {
+    0x4f22, // STS.L PR, @-R15
+    0x2fe6, // MOV.L R14, @-R15
+    0x2fd6, // MOV.L R13, @-R15
+    0x2fc6, // MOV.L R12, @-R15
+    0x6cf6, // MOV.L @R15+, R12
+    0x6df6, // MOV.L @R15+, R13
+    0x6ef6, // MOV.L @R15+, R14
+    0x4f26, // LDS.L @R15+, PR
+    0xaff6, // BRA PROG_ADDR
+    0x0009  // NOP
+};
+
+enum sh4_case {
+    SH4_CASE_ALU,
+    SH4_CASE_MEM,
+    SH4_CASE_MIXED,
+    SH4_CASE_DIV,
+    SH4_CASE_STACK,
+
+    SH4_CASE_COUNT
+};
+
+static struct sh4_prog const progs[SH4_CASE_COUNT] = {
+    [SH4_CASE_ALU] = { alu_prog, sizeof(alu_prog) / sizeof(alu_prog[0]) },
+    [SH4_CASE_MEM] = { mem_prog, sizeof(mem_prog) / sizeof(mem_prog[0]) },
+    [SH4_CASE_MIXED] = {
+        mixed_prog, sizeof(mixed_prog) / sizeof(mixed_prog[0])
+    },
+    [SH4_CASE_DIV] = { div_prog, sizeof(div_prog) / sizeof(div_prog[0]) },
+    [SH4_CASE_STACK] = {
+        stack_prog, sizeof(stack_prog) / sizeof(stack_prog[0])
+    }
+};
+
+static struct dc_clock clk;
+static struct Memory mem;
+static struct memory_map map;
+static Sh4 cpu;
+static struct jit_code_block blk;
+
+static void sh4_setup(void *arg) {
+    struct sh4_prog const *prog = progs + (uintptr_t)arg;
+
+    dc_clock_init(&clk);
+    memory_init(&mem);
+    memory_map_init(&map);
+    memory_map_add(&map, 0x0c000000, 0x0cffffff,
+                   0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
+                   &ram_intf, &mem);
+
+    sh4_init(&cpu, &clk);
+    sh4_set_mem_map(&cpu, &map);
+
+    unsigned idx;
+    for (idx = 0; idx < prog->n_insts; idx++) {
+        memory_map_write_16(&map, (PROG_ADDR & 0x1fffffff) + idx * 2,
+                            prog->insts[idx]);
+    }
+
+    cpu.reg[SH4_REG_PC] = PROG_ADDR;
+    *sh4_gen_reg(&cpu, 2) = DATA_ADDR;
+    *sh4_gen_reg(&cpu, 4) = DATA_ADDR + 0x100;
+    *sh4_gen_reg(&cpu, 5) = 7;
+    *sh4_gen_reg(&cpu, 15) = DATA_ADDR + 0x200;
+}
+
+static void sh4_teardown(void *arg) {
+    sh4_cleanup(&cpu);
+    memory_map_cleanup(&map);
+    memory_cleanup(&mem);
+    dc_clock_cleanup(&clk);
+}
+
+static void sh4_interp_run(void *arg, unsigned long n_iter) {
+    unsigned n_cycles = 0;
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++)
+        n_cycles += sh4_do_exec_inst(&cpu);
+    microbench_sink = n_cycles;
+}
+
+static void sh4_intp_setup(void *arg) {
+    sh4_setup(arg);
+    jit_code_block_init(&blk, PROG_ADDR, false);
+    sh4_jit_compile_intp(&cpu, &blk, PROG_ADDR);
+}
+
+static void sh4_intp_run(void *arg, unsigned long n_iter) {
+    unsigned n_cycles, total = 0;
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++) {
+        cpu.reg[SH4_REG_PC] = code_block_intp_exec(&cpu, &blk.intp, &n_cycles);
+        total += n_cycles;
+    }
+    microbench_sink = total;
+}
+
+static void sh4_intp_teardown(void *arg) {
+    jit_code_block_cleanup(&blk, false);
+    sh4_teardown(arg);
+}
+
+// translates the block to il and then to an interpreter block every iteration
+static void sh4_compile_run(void *arg, unsigned long n_iter) {
+    unsigned long iter;
+    unsigned total = 0;
+    for (iter = 0; iter < n_iter; iter++) {
+        jit_code_block_init(&blk, PROG_ADDR, false);
+        sh4_jit_compile_intp(&cpu, &blk, PROG_ADDR);
+        total += blk.intp.inst_count;
+        jit_code_block_cleanup(&blk, false);
+    }
+    microbench_sink = total;
+}
+
+void mb_sh4_register(void) {
+    static char const *interp_names[SH4_CASE_COUNT] = {
+        [SH4_CASE_ALU] = "sh4/interp_alu",
+        [SH4_CASE_MEM] = "sh4/interp_mem",
+        [SH4_CASE_MIXED] = "sh4/interp_mixed",
+        [SH4_CASE_DIV] = "sh4/interp_div",
+        [SH4_CASE_STACK] = "sh4/interp_stack"
+    };
+    static char const *intp_names[SH4_CASE_COUNT] = {
+        [SH4_CASE_ALU] = "sh4/il_intp_block_alu",
+        [SH4_CASE_MEM] = "sh4/il_intp_block_mem",
+        [SH4_CASE_MIXED] = "sh4/il_intp_block_mixed",
+        [SH4_CASE_DIV] = "sh4/il_intp_block_div",
+        [SH4_CASE_STACK] = "sh4/il_intp_block_stack"
+    };
+    static char const *compile_names[SH4_CASE_COUNT] = {
+        [SH4_CASE_ALU] = "sh4/il_compile_alu",
+        [SH4_CASE_MEM] = "sh4/il_compile_mem",
+        [SH4_CASE_MIXED] = "sh4/il_compile_mixed",
+        [SH4_CASE_DIV] = "sh4/il_compile_div",
+        [SH4_CASE_STACK] = "sh4/il_compile_stack"
+    };
+
+    unsigned idx;
+    for (idx = 0; idx < SH4_CASE_COUNT; idx++) {
+        struct microbench_case interp = {
+            .name = interp_names[idx],
+            .setup = sh4_setup,
+            .run = sh4_interp_run,
+            .teardown = sh4_teardown,
+            .arg = (void*)(uintptr_t)idx
+        };
+        microbench_add(&interp);
+    }
+
+    for (idx = 0; idx < SH4_CASE_COUNT; idx++) {
+        struct microbench_case intp = {
+            .name = intp_names[idx],
+            .setup = sh4_intp_setup,
+            .run = sh4_intp_run,
+            .teardown = sh4_intp_teardown,
+            .arg = (void*)(uintptr_t)idx
+        };
+        microbench_add(&intp);
+    }
+
+    for (idx = 0; idx < SH4_CASE_COUNT; idx++) {
+        struct microbench_case compile = {
+            .name = compile_names[idx],
+            .setup = sh4_setup,
+            .run = sh4_compile_run,
+            .teardown = sh4_teardown,
+            .arg = (void*)(uintptr_t)idx
+        };
+        microbench_add(&compile);
+    }
+}
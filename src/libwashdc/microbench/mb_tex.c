@@ -0,0 +1,174 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * texture-decoding microbenchmarks.  These go through pvr2_tex_cache_read, so
+ * each iteration includes the malloc for the decoded texture as well as the
+ * actual detwiddling/VQ decoding/palette expansion.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hw/pvr2/pvr2.h"
+#include "hw/pvr2/pvr2_def.h"
+#include "hw/pvr2/pvr2_tex_cache.h"
+
+#include "microbench.h"
+
+// 256 entries of four 16-bit texels each
+#define VQ_CODE_BOOK_LEN (256 * 4 * 2)
+
+static struct pvr2 pvr2;
+
+enum tex_case {
+    TEX_CASE_TWIDDLED_16BPP,
+    TEX_CASE_TWIDDLED_PAL8,
+    TEX_CASE_VQ,
+    TEX_CASE_LINEAR,
+
+    TEX_CASE_COUNT
+};
+
+// every case uses a 256x256 texture at the start of texture memory
+static struct pvr2_tex_meta const metas[TEX_CASE_COUNT] = {
+    [TEX_CASE_TWIDDLED_16BPP] = {
+        .addr_first = 0, .addr_last = 256 * 256 * 2 - 1,
+        .w_shift = 8, .h_shift = 8, .linestride = 256,
+        .pix_fmt = GFX_TEX_FMT_RGB_565, .tex_fmt = TEX_CTRL_PIX_FMT_RGB_565,
+        .twiddled = true
+    },
+    [TEX_CASE_TWIDDLED_PAL8] = {
+        .addr_first = 0, .addr_last = 256 * 256 - 1,
+        .w_shift = 8, .h_shift = 8, .linestride = 256,
+        .pix_fmt = GFX_TEX_FMT_PAL_INDEX16,
+        .tex_fmt = TEX_CTRL_PIX_FMT_8_BPP_PAL,
+        .twiddled = true
+    },
+    [TEX_CASE_VQ] = {
+        .addr_first = 0, .addr_last = VQ_CODE_BOOK_LEN + 128 * 128 - 1,
+        .w_shift = 8, .h_shift = 8, .linestride = 256,
+        .pix_fmt = GFX_TEX_FMT_RGB_565, .tex_fmt = TEX_CTRL_PIX_FMT_RGB_565,
+        .twiddled = true, .vq_compression = true
+    },
+    [TEX_CASE_LINEAR] = {
+        .addr_first = 0, .addr_last = 256 * 256 * 2 - 1,
+        .w_shift = 8, .h_shift = 8, .linestride = 256,
+        .pix_fmt = GFX_TEX_FMT_RGB_565, .tex_fmt = TEX_CTRL_PIX_FMT_RGB_565
+    }
+};
+
+static void tex_setup(void *arg) {
+    /*
+     * the rest of the pvr2 needs a renderer, and the texture decoding doesn't
+     * touch any of it.
+     */
+    memset(&pvr2, 0, sizeof(pvr2));
+    pvr2_tex_mem_init(&pvr2);
+    pvr2_tex_cache_init(&pvr2);
+
+    unsigned idx;
+    for (idx = 0; idx < PVR2_TEX32_MEM_LEN; idx++)
+        pvr2.mem.tex32[idx] = rand();
+}
+
+static void tex_run(void *arg, unsigned long n_iter) {
+    struct pvr2_tex_meta const *meta = metas + (uintptr_t)arg;
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++) {
+        void *dat;
+        size_t n_bytes;
+        pvr2_tex_cache_read(&pvr2, &dat, &n_bytes, meta, NULL);
+        microbench_sink += ((uint8_t*)dat)[iter % n_bytes];
+        free(dat);
+    }
+}
+
+static void tex_teardown(void *arg) {
+    pvr2_tex_cache_cleanup(&pvr2);
+}
+
+/*
+ * texture cache misses once the cache is full.  Every iteration is a new frame
+ * looking up a texture it's never seen, so each one is a find that fails
+ * followed by an add that evicts the least recently used texture.  None of the
+ * textures ever get bound, so there's never a gfx_obj to free.
+ */
+#define TEX_MISS_ADDR(n) (((n) % (4 * PVR2_TEX_CACHE_SIZE)) * 128)
+
+static void tex_miss_add(unsigned n) {
+    if (!pvr2_tex_cache_find(&pvr2, TEX_MISS_ADDR(n), 0, 3, 3, 8,
+                             TEX_CTRL_PIX_FMT_RGB_565, true,
+                             false, false, false))
+        pvr2_tex_cache_add(&pvr2, TEX_MISS_ADDR(n), 0, 3, 3, 8,
+                           TEX_CTRL_PIX_FMT_RGB_565, true,
+                           false, false, false);
+}
+
+static void tex_miss_setup(void *arg) {
+    memset(&pvr2, 0, sizeof(pvr2));
+    pvr2_tex_mem_init(&pvr2);
+    pvr2_tex_cache_init(&pvr2);
+
+    unsigned idx;
+    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++)
+        tex_miss_add(idx);
+}
+
+static void tex_miss_run(void *arg, unsigned long n_iter) {
+    unsigned long iter;
+    for (iter = 0; iter < n_iter; iter++) {
+        pvr2.core.next_frame_stamp++;
+        tex_miss_add(PVR2_TEX_CACHE_SIZE + iter);
+    }
+    microbench_sink += pvr2.stat.persistent_counters.texture_overwrite_count;
+}
+
+void mb_tex_register(void) {
+    static char const *names[TEX_CASE_COUNT] = {
+        [TEX_CASE_TWIDDLED_16BPP] = "tex/detwiddle_rgb565_256x256",
+        [TEX_CASE_TWIDDLED_PAL8] = "tex/detwiddle_pal8_256x256",
+        [TEX_CASE_VQ] = "tex/vq_rgb565_256x256",
+        [TEX_CASE_LINEAR] = "tex/linear_rgb565_256x256"
+    };
+
+    unsigned idx;
+    for (idx = 0; idx < TEX_CASE_COUNT; idx++) {
+        struct microbench_case bench = {
+            .name = names[idx],
+            .setup = tex_setup,
+            .run = tex_run,
+            .teardown = tex_teardown,
+            .arg = (void*)(uintptr_t)idx
+        };
+        microbench_add(&bench);
+    }
+
+    struct microbench_case miss_bench = {
+        .name = "tex/cache_miss_evict",
+        .setup = tex_miss_setup,
+        .run = tex_miss_run,
+        .teardown = tex_teardown
+    };
+    microbench_add(&miss_bench);
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef MICROBENCH_H_
+#define MICROBENCH_H_
+
+#include <stdint.h>
+
+/*
+ * Microbenchmarks for individual emulator kernels.  Each case gets called with
+ * an iteration count which the harness keeps doubling until the run takes long
+ * enough to time reliably; results are reported in nanoseconds per iteration.
+ */
+
+struct microbench_case {
+    char const *name;
+
+    // setup and teardown are optional and are not timed
+    void (*setup)(void *arg);
+    void (*run)(void *arg, unsigned long n_iter);
+    void (*teardown)(void *arg);
+
+    void *arg;
+};
+
+void microbench_add(struct microbench_case const *bench);
+
+/*
+ * cases should accumulate their results into this so the compiler can't throw
+ * away the work being measured.
+ */
+extern volatile uint32_t microbench_sink;
+
+void mb_sched_register(void);
+void mb_memory_map_register(void);
+void mb_tex_register(void);
+void mb_sh4_register(void);
+void mb_aica_register(void);
+void mb_code_cache_register(void);
+
+#endif
@@ -87,21 +87,47 @@
     void cleanup_mmio_region_##name(                                    \
         struct mmio_region_##name *region);                             \
 
+/*
+ * cells which use the silent handlers are plain storage, so
+ * mmio_region_*_read and mmio_region_*_write access their backing directly
+ * instead of making an indirect call.  The warn handlers only add a LOG_DBG on
+ * top of that, so they get the same treatment when debug logging is compiled
+ * out.
+ */
+#ifdef ENABLE_LOG_DEBUG
+#define MMIO_REGION_PLAIN_READ(name, handler)                           \
+    ((handler) == mmio_region_##name##_silent_read_handler)
+#define MMIO_REGION_PLAIN_WRITE(name, handler)                          \
+    ((handler) == mmio_region_##name##_silent_write_handler)
+#else
+#define MMIO_REGION_PLAIN_READ(name, handler)                           \
+    ((handler) == mmio_region_##name##_silent_read_handler ||           \
+     (handler) == mmio_region_##name##_warn_read_handler)
+#define MMIO_REGION_PLAIN_WRITE(name, handler)                          \
+    ((handler) == mmio_region_##name##_silent_write_handler ||          \
+     (handler) == mmio_region_##name##_warn_write_handler)
+#endif
+
 #define DEF_MMIO_REGION(name, len_bytes, beg_bytes, type)               \
     WASHDC_UNUSED static inline type                                    \
     mmio_region_##name##_read(struct mmio_region_##name *region,        \
                               addr32_t addr) {                          \
         unsigned idx = (addr - (beg_bytes)) / sizeof(type);             \
-        void *ctxt = region->ctxt_ptr[idx];                             \
-        return region->on_read[idx](region, idx, ctxt);                 \
+        mmio_region_##name##_read_handler handler = region->on_read[idx]; \
+        if (MMIO_REGION_PLAIN_READ(name, handler))                      \
+            return region->backing[idx];                                \
+        return handler(region, idx, region->ctxt_ptr[idx]);             \
     }                                                                   \
                                                                         \
     WASHDC_UNUSED static inline void                                    \
     mmio_region_##name##_write(struct mmio_region_##name *region,       \
                                addr32_t addr, type val) {               \
-        unsigned idx = (addr - beg_bytes) / sizeof(type);               \
-        void *ctxt = region->ctxt_ptr[idx];                             \
-        region->on_write[idx](region, idx, val, ctxt);                  \
+        unsigned idx = (addr - (beg_bytes)) / sizeof(type);             \
+        mmio_region_##name##_write_handler handler = region->on_write[idx]; \
+        if (MMIO_REGION_PLAIN_WRITE(name, handler))                     \
+            region->backing[idx] = val;                                 \
+        else                                                            \
+            handler(region, idx, val, region->ctxt_ptr[idx]);           \
     }                                                                   \
                                                                         \
     type                                                                \
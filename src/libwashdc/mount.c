@@ -24,12 +24,19 @@
 
 #include "washdc/error.h"
 #include "cdrom.h"
+#include "threading.h"
 
 #include "mount.h"
 
 static bool mounted;
 static struct mount img;
 
+/*
+ * the GD-ROM's read thread and the CDDA streaming thread both read from the
+ * image, and the backends' sector caches only have room for one consumer.
+ */
+static washdc_mutex read_lock = WASHDC_MUTEX_STATIC_INIT;
+
 void mount_insert(struct mount_ops const *ops, void *ptr) {
     if (img.state)
         mount_eject();
@@ -82,9 +89,12 @@ int mount_read_toc(struct mount_toc* out, unsigned region) {
     }
 }
 
-int mount_read_sectors(void *buf_out, unsigned fad_start,
-                       unsigned sector_count) {
-    if (!mount_check() || !img.ops->read_sector)
+static int mount_do_read_sectors(void *buf_out, unsigned fad_start,
+                                 unsigned sector_count) {
+    if (img.ops->read_sectors)
+        return img.ops->read_sectors(&img, buf_out, fad_start, sector_count);
+
+    if (!img.ops->read_sector)
         return -1;
 
     unsigned fad;
@@ -98,6 +108,42 @@ int mount_read_sectors(void *buf_out, unsigned fad_start,
     return 0;
 }
 
+int mount_read_sectors(void *buf_out, unsigned fad_start,
+                       unsigned sector_count) {
+    if (!mount_check())
+        return -1;
+
+    washdc_mutex_lock(&read_lock);
+    int err = mount_do_read_sectors(buf_out, fad_start, sector_count);
+    washdc_mutex_unlock(&read_lock);
+
+    return err;
+}
+
+int mount_read_raw_sectors(void *buf_out, unsigned fad_start,
+                           unsigned sector_count) {
+    if (!mount_check() || !img.ops->read_raw_sectors)
+        return -1;
+
+    washdc_mutex_lock(&read_lock);
+    int err = img.ops->read_raw_sectors(&img, buf_out,
+                                        fad_start, sector_count);
+    washdc_mutex_unlock(&read_lock);
+
+    return err;
+}
+
+void const *mount_map_sector(unsigned fad) {
+    if (!mount_check() || !img.ops->map_sector)
+        return NULL;
+
+    washdc_mutex_lock(&read_lock);
+    void const *sector = img.ops->map_sector(&img, fad);
+    washdc_mutex_unlock(&read_lock);
+
+    return sector;
+}
+
 void const* mount_encode_toc(struct mount_toc const *toc) {
     static uint8_t toc_out[CDROM_TOC_SIZE];
 
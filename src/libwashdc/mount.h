@@ -118,6 +118,26 @@ struct mount_ops {
 
     int(*read_sector)(struct mount*, void*, unsigned);
 
+    /*
+     * read several consecutive sectors at once.  This is optional; if it's
+     * NULL then read_sector gets called once for each sector.
+     */
+    int(*read_sectors)(struct mount*, void*, unsigned, unsigned);
+
+    /*
+     * read several consecutive sectors as whole CDROM_FRAME_SIZE frames
+     * instead of just the user data.  This is what CDDA playback uses.  It's
+     * optional; if it's NULL then the image can't play audio tracks.
+     */
+    int(*read_raw_sectors)(struct mount*, void*, unsigned, unsigned);
+
+    /*
+     * return a pointer to the user data of the given sector if the image is
+     * mapped into memory, else NULL.  The pointer stays valid until the image
+     * is ejected.  This is optional.
+     */
+    void const *(*map_sector)(struct mount*, unsigned);
+
     // release resources held by the mount
     void (*cleanup)(struct mount*);
 
@@ -154,7 +174,18 @@ enum mount_disc_type mount_get_disc_type(void);
 
 int mount_read_toc(struct mount_toc* out, unsigned session);
 
+/*
+ * reads are serialized internally, so these two can be called from more than
+ * one thread at a time.
+ */
 int mount_read_sectors(void *buf_out, unsigned fad, unsigned sector_count);
+int mount_read_raw_sectors(void *buf_out, unsigned fad, unsigned sector_count);
+
+/*
+ * return a pointer to the sector's user data inside the image's mapping, or
+ * NULL if it isn't mapped (in which case it has to be read normally).
+ */
+void const *mount_map_sector(unsigned fad);
 
 int mount_get_meta(struct mount_meta *meta);
 
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "washdc/error.h"
+
+#include "perf_cnt.h"
+
+static struct perf_cnt_info {
+    char const *name;
+    bool is_timer;
+} const probe_info[PERF_PROBE_COUNT] = {
+    [PERF_SCHED_TIMESLICE] = { "sched.timeslice", true },
+    [PERF_SCHED_EVENT] = { "sched.event", false },
+    [PERF_CODE_CACHE_MISS] = { "code_cache.find_slow", true },
+    [PERF_JIT_COMPILE_NATIVE] = { "jit.compile_native", true },
+    [PERF_JIT_COMPILE_INTP] = { "jit.compile_intp", true },
+    [PERF_TEX_DECODE] = { "pvr2.tex_cache_read", true },
+    [PERF_TA_PACKET] = { "pvr2.ta_packet", true },
+    [PERF_AICA_SYNC] = { "aica.sync", true },
+    [PERF_GDROM_READ] = { "gdrom.read_sectors", true }
+};
+
+char const *perf_cnt_name(enum perf_probe probe) {
+    if (probe >= PERF_PROBE_COUNT)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    return probe_info[probe].name;
+}
+
+bool perf_cnt_is_timer(enum perf_probe probe) {
+    if (probe >= PERF_PROBE_COUNT)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    return probe_info[probe].is_timer;
+}
+
+#ifdef ENABLE_PERF_COUNTERS
+
+#include "real_ticks.h"
+#include "threading.h"
+
+/*
+ * emulation thread, gdrom worker, arm7 thread, io thread and a few to spare.
+ * Any threads past this share the last buffer, which means their counts can
+ * get a little lossy but nothing worse than that.
+ */
+#define PERF_MAX_THREADS 16
+
+PERF_THREAD_LOCAL struct perf_thread_buf *perf_buf;
+
+static struct perf_thread_buf thread_bufs[PERF_MAX_THREADS];
+static unsigned n_thread_bufs;
+static washdc_mutex thread_buf_lock = WASHDC_MUTEX_STATIC_INIT;
+
+// totals as of the last perf_cnt_reset
+static struct perf_thread_buf baseline;
+
+// used to convert ticks to seconds
+static uint64_t ticks_start;
+static washdc_real_time real_start;
+
+void perf_cnt_init(void) {
+    washdc_get_real_time(&real_start);
+    ticks_start = perf_ticks();
+    perf_cnt_reset();
+}
+
+struct perf_thread_buf *perf_thread_attach(void) {
+    washdc_mutex_lock(&thread_buf_lock);
+    if (n_thread_bufs < PERF_MAX_THREADS)
+        perf_buf = thread_bufs + n_thread_bufs++;
+    else
+        perf_buf = thread_bufs + (PERF_MAX_THREADS - 1);
+    washdc_mutex_unlock(&thread_buf_lock);
+    return perf_buf;
+}
+
+uint64_t perf_ticks_slow(void) {
+    washdc_real_time now;
+    washdc_get_real_time(&now);
+    return washdc_real_time_to_seconds(&now) * 1000000000.0;
+}
+
+/*
+ * other threads keep writing to their buffers while this runs.  That's fine
+ * since the only consequence is that the totals aren't a perfect snapshot.
+ */
+static void perf_cnt_sum(struct perf_thread_buf *out) {
+    memset(out, 0, sizeof(*out));
+
+    washdc_mutex_lock(&thread_buf_lock);
+    unsigned n_bufs = n_thread_bufs;
+    washdc_mutex_unlock(&thread_buf_lock);
+
+    unsigned buf_no, probe;
+    for (buf_no = 0; buf_no < n_bufs; buf_no++) {
+        for (probe = 0; probe < PERF_PROBE_COUNT; probe++) {
+            out->count[probe] += thread_bufs[buf_no].count[probe];
+            out->ticks[probe] += thread_bufs[buf_no].ticks[probe];
+        }
+    }
+}
+
+void perf_cnt_get(enum perf_probe probe, uint64_t *count, double *seconds) {
+    if (probe >= PERF_PROBE_COUNT)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    struct perf_thread_buf total;
+    perf_cnt_sum(&total);
+
+    washdc_real_time real_now, real_delta;
+    uint64_t ticks_now = perf_ticks();
+    washdc_get_real_time(&real_now);
+    washdc_real_time_diff(&real_delta, &real_now, &real_start);
+
+    double secs_per_tick = 0.0;
+    if (ticks_now != ticks_start)
+        secs_per_tick = washdc_real_time_to_seconds(&real_delta) /
+            (double)(ticks_now - ticks_start);
+
+    *count = total.count[probe] - baseline.count[probe];
+    *seconds = (total.ticks[probe] - baseline.ticks[probe]) * secs_per_tick;
+}
+
+void perf_cnt_reset(void) {
+    perf_cnt_sum(&baseline);
+}
+
+#else
+
+void perf_cnt_init(void) {
+}
+
+void perf_cnt_get(enum perf_probe probe, uint64_t *count, double *seconds) {
+    if (probe >= PERF_PROBE_COUNT)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    *count = 0;
+    *seconds = 0.0;
+}
+
+void perf_cnt_reset(void) {
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef PERF_CNT_H_
+#define PERF_CNT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * hot-path performance counters.
+ *
+ * Each probe is either a plain counter (PERF_COUNT) or a scoped timer
+ * (PERF_TIMER_BEGIN/PERF_TIMER_END) which counts how many times the scope
+ * was entered and how many ticks were spent inside of it.  Every thread that
+ * hits a probe gets its own buffer so that the probes never need locks or
+ * atomics; perf_cnt_get adds up all the buffers when somebody asks.
+ *
+ * Unless ENABLE_PERF_COUNTERS is defined, all of the probe macros expand to
+ * nothing and perf_cnt_get always reports zero.
+ */
+
+enum perf_probe {
+    PERF_SCHED_TIMESLICE,
+    PERF_SCHED_EVENT,
+    PERF_CODE_CACHE_MISS,
+    PERF_JIT_COMPILE_NATIVE,
+    PERF_JIT_COMPILE_INTP,
+    PERF_TEX_DECODE,
+    PERF_TA_PACKET,
+    PERF_AICA_SYNC,
+    PERF_GDROM_READ,
+
+    PERF_PROBE_COUNT
+};
+
+void perf_cnt_init(void);
+
+char const *perf_cnt_name(enum perf_probe probe);
+
+// true if it's a timer, false if it's a plain counter
+bool perf_cnt_is_timer(enum perf_probe probe);
+
+// totals since the last call to perf_cnt_reset
+void perf_cnt_get(enum perf_probe probe, uint64_t *count, double *seconds);
+
+void perf_cnt_reset(void);
+
+#ifdef ENABLE_PERF_COUNTERS
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PERF_THREAD_LOCAL __declspec(thread)
+#else
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#define PERF_THREAD_LOCAL _Thread_local
+#endif
+
+struct perf_thread_buf {
+    uint64_t count[PERF_PROBE_COUNT];
+    uint64_t ticks[PERF_PROBE_COUNT];
+};
+
+extern PERF_THREAD_LOCAL struct perf_thread_buf *perf_buf;
+
+// hands the calling thread its buffer the first time it hits a probe
+struct perf_thread_buf *perf_thread_attach(void);
+
+uint64_t perf_ticks_slow(void);
+
+static inline struct perf_thread_buf *perf_get_buf(void) {
+    struct perf_thread_buf *buf = perf_buf;
+    return buf ? buf : perf_thread_attach();
+}
+
+static inline uint64_t perf_ticks(void) {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return perf_ticks_slow();
+#endif
+}
+
+static inline void perf_timer_end(enum perf_probe probe, uint64_t start) {
+    struct perf_thread_buf *buf = perf_get_buf();
+    buf->ticks[probe] += perf_ticks() - start;
+    buf->count[probe]++;
+}
+
+#define PERF_COUNT(probe) (perf_get_buf()->count[(probe)]++)
+#define PERF_TIMER_BEGIN(probe) uint64_t perf_start_##probe = perf_ticks()
+#define PERF_TIMER_END(probe) perf_timer_end((probe), perf_start_##probe)
+
+#else
+
+#define PERF_COUNT(probe) do { } while (0)
+#define PERF_TIMER_BEGIN(probe) do { } while (0)
+#define PERF_TIMER_END(probe) do { } while (0)
+
+#endif
+
+#endif
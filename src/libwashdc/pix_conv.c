@@ -22,6 +22,10 @@
 
 #include <stdint.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "washdc/pix_conv.h"
 
 // pix_conv.c: The future home of all texture and pixel conversion functions
@@ -88,23 +92,74 @@ washdc_yuv_to_rgba_2pixels(uint8_t *rgba_out, int lum1, int lum2,
     rgba_out[7] = (uint8_t)rgba[7];
 }
 
+#ifdef __SSE2__
+/*
+ * convert 8 pixels (4 YUV422 words) at a time.  This gives the same results
+ * as washdc_yuv_to_rgba_2pixels; the coefficients are scaled down so they fit
+ * in 16 bits and the shifts are reduced to match.
+ */
+static void
+washdc_yuv_to_rgba_8pixels(uint8_t *rgba_out, uint32_t const *yuv_in) {
+    __m128i in = _mm_loadu_si128((__m128i const*)yuv_in);
+
+    // 16-bit (chrom_b, chrom_r) pairs and (lum1, lum2) pairs for each word
+    __m128i chrom = _mm_sub_epi16(_mm_and_si128(in, _mm_set1_epi32(0x00ff00ff)),
+                                  _mm_set1_epi16(128));
+    __m128i lum = _mm_srli_epi16(in, 8);
+
+    __m128i add_r = _mm_srai_epi32(_mm_madd_epi16(chrom,
+                                                  _mm_set1_epi32(0x2c000000)),
+                                   13);
+    __m128i add_g = _mm_sub_epi32(_mm_setzero_si128(),
+                                  _mm_srai_epi32(_mm_madd_epi16(chrom,
+                                                                _mm_set1_epi32(0x2c001600)),
+                                                 14));
+    __m128i add_b = _mm_srai_epi32(_mm_madd_epi16(chrom,
+                                                  _mm_set1_epi32(0x00003700)),
+                                   13);
+
+    // each word's adds apply to both of its pixels
+    add_r = _mm_packs_epi32(add_r, add_r);
+    add_g = _mm_packs_epi32(add_g, add_g);
+    add_b = _mm_packs_epi32(add_b, add_b);
+    __m128i red = _mm_add_epi16(lum, _mm_unpacklo_epi16(add_r, add_r));
+    __m128i green = _mm_add_epi16(lum, _mm_unpacklo_epi16(add_g, add_g));
+    __m128i blue = _mm_add_epi16(lum, _mm_unpacklo_epi16(add_b, add_b));
+
+    // saturating packs take care of clamping to [0, 255]
+    __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(red, red),
+                                   _mm_packus_epi16(green, green));
+    __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(blue, blue),
+                                   _mm_set1_epi8(-1));
+
+    _mm_storeu_si128((__m128i*)rgba_out, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i*)(rgba_out + 16), _mm_unpackhi_epi16(rg, ba));
+}
+#endif
+
 void washdc_conv_yuv422_rgba8888(void *rgba_out, void const* yuv_in,
                                  unsigned width, unsigned height) {
     uint8_t *rgbap = (uint8_t*)rgba_out;
     uint32_t const *tex_in = (uint32_t const *)yuv_in;
-    unsigned half_width = width / 2;
-
-    unsigned col, row;
-    for (row = 0; row < height; row++) {
-        for (col = 0; col < half_width; col++) {
-            uint32_t in = *tex_in++;
-            unsigned lum[2] = { (in >> 8) & 0xff, (in >> 24) & 0xff };
-            int chrom_b = in & 0xff;
-            int chrom_r = (in >> 16) & 0xff;
-
-            washdc_yuv_to_rgba_2pixels(rgbap, lum[0], lum[1],
-                                       chrom_b - 128, chrom_r - 128);
-            rgbap += 8;
-        }
+    unsigned n_words = (width / 2) * height;
+
+#ifdef __SSE2__
+    while (n_words >= 4) {
+        washdc_yuv_to_rgba_8pixels(rgbap, tex_in);
+        tex_in += 4;
+        rgbap += 32;
+        n_words -= 4;
+    }
+#endif
+
+    while (n_words--) {
+        uint32_t in = *tex_in++;
+        unsigned lum[2] = { (in >> 8) & 0xff, (in >> 24) & 0xff };
+        int chrom_b = in & 0xff;
+        int chrom_r = (in >> 16) & 0xff;
+
+        washdc_yuv_to_rgba_2pixels(rgbap, lum[0], lum[1],
+                                   chrom_b - 128, chrom_r - 128);
+        rgbap += 8;
     }
 }
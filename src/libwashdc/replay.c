@@ -0,0 +1,171 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "washdc/hostfile.h"
+#include "dreamcast.h"
+#include "config.h"
+#include "log.h"
+
+#include "replay.h"
+
+#define REPLAY_MAGIC "WASHDCRP"
+#define REPLAY_VERSION 1
+
+/*
+ * the file is
+ *     char magic[8]              REPLAY_MAGIC
+ *     uint32_t version           REPLAY_VERSION
+ *     uint32_t rtc_val
+ *
+ * followed by a record for every GETCOND:
+ *     uint32_t frame, uint32_t addr, uint32_t len, data[len]
+ *
+ * in host byte order.
+ */
+#define REPLAY_HEADER_LEN 16
+
+#define REPLAY_MAX_COND_LEN 64
+
+static washdc_hostfile record_file = WASHDC_HOSTFILE_INVALID;
+static washdc_hostfile play_file = WASHDC_HOSTFILE_INVALID;
+
+static uint32_t n_records;
+
+static void replay_stop_playing(void);
+
+void replay_init(uint32_t *rtc_val) {
+    char const *record_path = config_get_replay_record_path();
+    char const *play_path = config_get_replay_play_path();
+    uint8_t header[REPLAY_HEADER_LEN];
+    uint32_t version = REPLAY_VERSION;
+
+    n_records = 0;
+
+    if (strlen(play_path)) {
+        play_file = washdc_hostfile_open(play_path, WASHDC_HOSTFILE_READ |
+                                         WASHDC_HOSTFILE_BINARY);
+        if (play_file == WASHDC_HOSTFILE_INVALID) {
+            LOG_ERROR("unable to open replay %s\n", play_path);
+        } else if (washdc_hostfile_read(play_file, header, sizeof(header)) !=
+                   sizeof(header) ||
+                   memcmp(header, REPLAY_MAGIC, 8) != 0 ||
+                   memcmp(header + 8, &version, sizeof(version)) != 0) {
+            LOG_ERROR("%s is not a replay from this version\n", play_path);
+            replay_stop_playing();
+        } else {
+            memcpy(rtc_val, header + 12, sizeof(*rtc_val));
+            LOG_INFO("playing replay %s\n", play_path);
+        }
+    }
+
+    if (strlen(record_path)) {
+        record_file = washdc_hostfile_open(record_path, WASHDC_HOSTFILE_WRITE |
+                                           WASHDC_HOSTFILE_BINARY);
+        if (record_file == WASHDC_HOSTFILE_INVALID) {
+            LOG_ERROR("unable to open %s to record a replay\n", record_path);
+            return;
+        }
+
+        memcpy(header, REPLAY_MAGIC, 8);
+        memcpy(header + 8, &version, sizeof(version));
+        memcpy(header + 12, rtc_val, sizeof(*rtc_val));
+        if (washdc_hostfile_write(record_file, header, sizeof(header)) !=
+            sizeof(header))
+            LOG_ERROR("failure to write replay header\n");
+        LOG_INFO("recording replay to %s\n", record_path);
+    }
+}
+
+void replay_cleanup(void) {
+    replay_stop_playing();
+
+    if (record_file != WASHDC_HOSTFILE_INVALID) {
+        LOG_INFO("%u replay records written\n", (unsigned)n_records);
+        washdc_hostfile_close(record_file);
+        record_file = WASHDC_HOSTFILE_INVALID;
+    }
+}
+
+bool replay_is_playing(void) {
+    return play_file != WASHDC_HOSTFILE_INVALID;
+}
+
+static void replay_stop_playing(void) {
+    if (play_file != WASHDC_HOSTFILE_INVALID) {
+        washdc_hostfile_close(play_file);
+        play_file = WASHDC_HOSTFILE_INVALID;
+    }
+}
+
+void replay_record_cond(unsigned addr, void const *dat, unsigned len) {
+    if (record_file == WASHDC_HOSTFILE_INVALID)
+        return;
+
+    uint32_t header[3] = { dc_get_frame_count(), addr, len };
+    if (washdc_hostfile_write(record_file, header, sizeof(header)) !=
+        sizeof(header) ||
+        washdc_hostfile_write(record_file, dat, len) != len) {
+        LOG_ERROR("failure to write replay record; recording stopped\n");
+        washdc_hostfile_close(record_file);
+        record_file = WASHDC_HOSTFILE_INVALID;
+        return;
+    }
+    n_records++;
+}
+
+int replay_play_cond(unsigned addr, void *dat, unsigned *len,
+                     unsigned max_len) {
+    if (play_file == WASHDC_HOSTFILE_INVALID)
+        return -1;
+
+    uint32_t header[3];
+    uint8_t cond[REPLAY_MAX_COND_LEN];
+    unsigned frame = dc_get_frame_count();
+
+    if (washdc_hostfile_read(play_file, header, sizeof(header)) !=
+        sizeof(header)) {
+        LOG_INFO("replay finished at frame %u\n", frame);
+        replay_stop_playing();
+        return -1;
+    }
+
+    if (header[2] > REPLAY_MAX_COND_LEN || header[2] > max_len ||
+        washdc_hostfile_read(play_file, cond, header[2]) != header[2]) {
+        LOG_ERROR("replay is truncated or corrupt\n");
+        replay_stop_playing();
+        return -1;
+    }
+
+    if (header[0] != frame || header[1] != addr) {
+        LOG_ERROR("replay desynced at frame %u: expected input from %02x on "
+                  "frame %u\n", frame, (unsigned)header[1],
+                  (unsigned)header[0]);
+        replay_stop_playing();
+        return -1;
+    }
+
+    memcpy(dat, cond, header[2]);
+    *len = header[2];
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * input replays.
+ *
+ * When config_get_replay_record_path is set, every maple GETCOND response gets
+ * written to that file along with the frame it happened on, and the RTC's
+ * starting value goes in the file's header.  When config_get_replay_play_path
+ * is set, those get fed back to the guest instead of the host's input, so a
+ * run can be repeated exactly.  Playback stops at the end of the file, or as
+ * soon as the guest asks for input on a different frame or port from the one
+ * that was recorded.
+ */
+
+/*
+ * rtc_val is the RTC's starting value.  It gets stored in the replay when
+ * recording, and overwritten with the recorded value when playing.
+ */
+void replay_init(uint32_t *rtc_val);
+void replay_cleanup(void);
+
+bool replay_is_playing(void);
+
+/*
+ * called by the maple bus for every GETCOND.  replay_play_cond fills in the
+ * next recorded response and returns 0, or returns non-zero if there's no
+ * replay being played.
+ */
+void replay_record_cond(unsigned addr, void const *dat, unsigned len);
+int replay_play_cond(unsigned addr, void *dat, unsigned *len,
+                     unsigned max_len);
+
+#endif
@@ -0,0 +1,341 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "washdc/error.h"
+#include "savestate.h"
+#include "threading.h"
+#include "config.h"
+#include "log.h"
+
+#include "rewind.h"
+
+#define REWIND_MAX_SNAPS 4096
+
+// terminates the list of pages in a delta
+#define REWIND_DELTA_END 0xffffffff
+
+/*
+ * a delta inflates to
+ *     uint32_t sect_len, data[sect_len]     the older snapshot's sections
+ *     then any number of:
+ *         uint32_t mem, uint32_t page_no, data[SAVESTATE_PAGE_SIZE]
+ *     uint32_t REWIND_DELTA_END
+ *
+ * Each page is XOR'd with the same page of the newer snapshot.
+ */
+struct rewind_delta {
+    uint8_t *comp;
+    size_t comp_len, raw_len;
+};
+
+static bool enabled;
+static unsigned interval, frames_since_snap;
+static size_t budget;
+
+// deltas, oldest first
+static struct rewind_delta deltas[REWIND_MAX_SNAPS];
+static unsigned delta_first, n_deltas;
+static size_t delta_bytes;
+
+// the newest snapshot
+static bool have_snap;
+static uint8_t *snap_mem[SAVESTATE_MEM_COUNT];
+static struct savestate_buf snap_sects;
+
+static washdc_mutex req_lock;
+static unsigned req_steps;
+
+static void rewind_snap(void);
+static void rewind_undo_delta(void);
+static void rewind_apply(void);
+static void rewind_drop_oldest(void);
+static void put_u32(struct savestate_buf *buf, uint32_t val);
+static void get_u32(struct savestate_buf *buf, uint32_t *val);
+
+void rewind_init(void) {
+    int interval_cfg = config_get_rewind_interval();
+    int budget_cfg = config_get_rewind_budget();
+    enabled = interval_cfg > 0 && budget_cfg > 0;
+    interval = enabled ? interval_cfg : 0;
+    budget = enabled ? (size_t)budget_cfg << 20 : 0;
+
+    frames_since_snap = 0;
+    delta_first = n_deltas = 0;
+    delta_bytes = 0;
+    have_snap = false;
+    memset(&snap_sects, 0, sizeof(snap_sects));
+    req_steps = 0;
+    washdc_mutex_init(&req_lock);
+
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        snap_mem[mem_no] = NULL;
+        if (enabled && savestate_get_mem(mem_no, &len, &dirty)) {
+            snap_mem[mem_no] = (uint8_t*)malloc(len);
+            if (!snap_mem[mem_no])
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+        }
+    }
+
+    if (enabled) {
+        LOG_INFO("rewind snapshots every %u frames with a %uMB budget\n",
+                 interval, (unsigned)(budget >> 20));
+    }
+}
+
+void rewind_cleanup(void) {
+    while (n_deltas)
+        rewind_drop_oldest();
+
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        free(snap_mem[mem_no]);
+        snap_mem[mem_no] = NULL;
+    }
+    free(snap_sects.dat);
+    memset(&snap_sects, 0, sizeof(snap_sects));
+    have_snap = false;
+
+    washdc_mutex_cleanup(&req_lock);
+}
+
+void rewind_frame(void) {
+    if (enabled && ++frames_since_snap >= interval) {
+        rewind_snap();
+        frames_since_snap = 0;
+    }
+}
+
+void rewind_request(unsigned n_steps) {
+    washdc_mutex_lock(&req_lock);
+    req_steps += n_steps;
+    washdc_mutex_unlock(&req_lock);
+}
+
+bool rewind_run_pending(void) {
+    washdc_mutex_lock(&req_lock);
+    unsigned n_steps = req_steps;
+    req_steps = 0;
+    washdc_mutex_unlock(&req_lock);
+
+    if (!n_steps || !enabled)
+        return false;
+    if (!have_snap) {
+        LOG_WARN("%s - nothing to rewind to yet\n", __func__);
+        return false;
+    }
+
+    /*
+     * the first step goes back to the newest snapshot if any frames have run
+     * since it was taken.
+     */
+    if (frames_since_snap)
+        n_steps--;
+    while (n_steps-- && n_deltas)
+        rewind_undo_delta();
+
+    rewind_apply();
+    frames_since_snap = 0;
+
+    LOG_INFO("rewound; %u snapshots left\n", n_deltas);
+    return true;
+}
+
+static void xor_page(uint8_t *dst, uint8_t const *src_a,
+                     uint8_t const *src_b) {
+    unsigned idx;
+    for (idx = 0; idx < SAVESTATE_PAGE_SIZE; idx += sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, src_a + idx, sizeof(a));
+        memcpy(&b, src_b + idx, sizeof(b));
+        a ^= b;
+        memcpy(dst + idx, &a, sizeof(a));
+    }
+}
+
+static void rewind_snap(void) {
+    struct savestate_buf sects;
+    memset(&sects, 0, sizeof(sects));
+    savestate_save_sections(&sects);
+
+    if (!have_snap) {
+        unsigned mem_no;
+        for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+            size_t len;
+            uint8_t *dirty;
+            uint8_t *dat = savestate_get_mem(mem_no, &len, &dirty);
+            if (dat)
+                memcpy(snap_mem[mem_no], dat, len);
+        }
+        snap_sects = sects;
+        have_snap = true;
+        return;
+    }
+
+    struct savestate_buf raw;
+    memset(&raw, 0, sizeof(raw));
+    put_u32(&raw, snap_sects.len);
+    savestate_buf_put(&raw, snap_sects.dat, snap_sects.len);
+
+    uint8_t page[SAVESTATE_PAGE_SIZE];
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        uint8_t *dat = savestate_get_mem(mem_no, &len, &dirty);
+        if (!dat)
+            continue;
+
+        size_t offs;
+        for (offs = 0; offs < len; offs += SAVESTATE_PAGE_SIZE) {
+            uint8_t *old = snap_mem[mem_no] + offs;
+            if (memcmp(old, dat + offs, SAVESTATE_PAGE_SIZE) == 0)
+                continue;
+            xor_page(page, old, dat + offs);
+            memcpy(old, dat + offs, SAVESTATE_PAGE_SIZE);
+
+            put_u32(&raw, mem_no);
+            put_u32(&raw, offs >> SAVESTATE_PAGE_SHIFT);
+            savestate_buf_put(&raw, page, SAVESTATE_PAGE_SIZE);
+        }
+    }
+    put_u32(&raw, REWIND_DELTA_END);
+
+    free(snap_sects.dat);
+    snap_sects = sects;
+
+    uLongf comp_len = compressBound(raw.len);
+    uint8_t *comp = (uint8_t*)malloc(comp_len);
+    if (!comp)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    if (compress2(comp, &comp_len, raw.dat, raw.len, Z_BEST_SPEED) != Z_OK)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    uint8_t *shrunk = (uint8_t*)realloc(comp, comp_len);
+    if (shrunk)
+        comp = shrunk;
+
+    if (n_deltas >= REWIND_MAX_SNAPS)
+        rewind_drop_oldest();
+    struct rewind_delta *delta =
+        deltas + (delta_first + n_deltas++) % REWIND_MAX_SNAPS;
+    delta->comp = comp;
+    delta->comp_len = comp_len;
+    delta->raw_len = raw.len;
+    delta_bytes += comp_len;
+    free(raw.dat);
+
+    while (delta_bytes > budget && n_deltas)
+        rewind_drop_oldest();
+}
+
+// turn the newest snapshot back into the one before it
+static void rewind_undo_delta(void) {
+    struct rewind_delta *delta =
+        deltas + (delta_first + --n_deltas) % REWIND_MAX_SNAPS;
+
+    struct savestate_buf raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.dat = (uint8_t*)malloc(delta->raw_len);
+    if (!raw.dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    raw.len = raw.alloc = delta->raw_len;
+
+    uLongf raw_len = delta->raw_len;
+    if (uncompress(raw.dat, &raw_len, delta->comp, delta->comp_len) != Z_OK ||
+        raw_len != delta->raw_len)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    uint32_t sect_len;
+    get_u32(&raw, &sect_len);
+    snap_sects.len = snap_sects.pos = 0;
+    savestate_buf_put(&snap_sects, raw.dat + raw.pos, sect_len);
+    raw.pos += sect_len;
+
+    uint8_t page[SAVESTATE_PAGE_SIZE];
+    for (;;) {
+        uint32_t mem_no, page_no;
+        get_u32(&raw, &mem_no);
+        if (mem_no == REWIND_DELTA_END)
+            break;
+        get_u32(&raw, &page_no);
+        if (mem_no >= SAVESTATE_MEM_COUNT || !snap_mem[mem_no] ||
+            savestate_buf_get(&raw, page, SAVESTATE_PAGE_SIZE) != 0)
+            RAISE_ERROR(ERROR_INTEGRITY);
+
+        uint8_t *dst = snap_mem[mem_no] + (page_no << SAVESTATE_PAGE_SHIFT);
+        xor_page(dst, dst, page);
+    }
+
+    free(raw.dat);
+    free(delta->comp);
+    delta_bytes -= delta->comp_len;
+}
+
+// copy the newest snapshot into the emulator
+static void rewind_apply(void) {
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        uint8_t *dat = savestate_get_mem(mem_no, &len, &dirty);
+        if (!dat)
+            continue;
+
+        // only touch what changed so incremental save-states stay small
+        size_t offs;
+        for (offs = 0; offs < len; offs += SAVESTATE_PAGE_SIZE) {
+            uint8_t const *snap = snap_mem[mem_no] + offs;
+            if (memcmp(dat + offs, snap, SAVESTATE_PAGE_SIZE) != 0) {
+                memcpy(dat + offs, snap, SAVESTATE_PAGE_SIZE);
+                dirty[offs >> SAVESTATE_PAGE_SHIFT] = 1;
+            }
+        }
+    }
+
+    snap_sects.pos = 0;
+    if (savestate_load_sections(&snap_sects) != 0)
+        LOG_ERROR("%s - failure to load sections\n", __func__);
+}
+
+static void rewind_drop_oldest(void) {
+    struct rewind_delta *delta = deltas + delta_first;
+    free(delta->comp);
+    delta_bytes -= delta->comp_len;
+    delta_first = (delta_first + 1) % REWIND_MAX_SNAPS;
+    n_deltas--;
+}
+
+static void put_u32(struct savestate_buf *buf, uint32_t val) {
+    savestate_buf_put(buf, &val, sizeof(val));
+}
+
+static void get_u32(struct savestate_buf *buf, uint32_t *val) {
+    if (savestate_buf_get(buf, val, sizeof(*val)) != 0)
+        RAISE_ERROR(ERROR_INTEGRITY);
+}
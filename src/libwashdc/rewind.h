@@ -0,0 +1,61 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef REWIND_H_
+#define REWIND_H_
+
+#include <stdbool.h>
+
+/*
+ * the rewind buffer.
+ *
+ * Every config_get_rewind_interval() frames the emulation thread takes a
+ * snapshot of everything savestate.c knows about.  The newest snapshot is kept
+ * whole, and every older one is kept as the deflated XOR of the pages that
+ * differ between it and the snapshot after it, so stepping back means undoing
+ * the newest delta.  The oldest deltas get thrown away once they add up to more
+ * than config_get_rewind_budget() megabytes.
+ *
+ * This has to be initialized after everything has been registered with
+ * savestate.c.
+ */
+
+void rewind_init(void);
+void rewind_cleanup(void);
+
+// called by the emulation thread at the end of every frame
+void rewind_frame(void);
+
+/*
+ * request to go back n_steps snapshots the next time rewind_run_pending is
+ * called.  This can be called from any thread.  If there aren't that many
+ * snapshots then it goes back to the oldest one.
+ */
+void rewind_request(unsigned n_steps);
+
+/*
+ * called by the emulation thread at the same point as savestate_run_pending.
+ * This returns true if the emulator's state was rolled back.
+ */
+bool rewind_run_pending(void);
+
+#endif
@@ -0,0 +1,370 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "threading.h"
+#include "config.h"
+#include "log.h"
+
+#include "rollback.h"
+
+/*
+ * one more than the number of frames that can be rolled back, since the
+ * newest snapshot is the frame that's about to run.
+ */
+#define ROLLBACK_MAX_SNAPS (ROLLBACK_MAX_FRAMES + 1)
+
+/*
+ * an undo log is any number of
+ *     uint32_t mem, uint32_t page_no, data[SAVESTATE_PAGE_SIZE]
+ *
+ * The buffers get reused from one snapshot to the next, so once they've grown
+ * big enough taking a snapshot doesn't allocate anything.
+ */
+struct rollback_snap {
+    unsigned frame_no;
+
+    // the hardware was in the middle of something that doesn't get saved
+    bool busy;
+
+    struct savestate_buf sects;
+
+    /*
+     * the pages that changed between this snapshot and the next one, as they
+     * were when this one was taken.
+     */
+    struct savestate_buf undo;
+};
+
+static bool enabled;
+static unsigned max_snaps;
+
+// snapshots, oldest first
+static struct rollback_snap snaps[ROLLBACK_MAX_SNAPS];
+static unsigned snap_first, n_snaps;
+
+// every memory as of the newest snapshot
+static uint8_t *shadow[SAVESTATE_MEM_COUNT];
+
+// pages written since the newest snapshot, or changed by the last rollback
+static uint8_t *changed[SAVESTATE_MEM_COUNT];
+
+static washdc_mutex req_lock;
+static bool req_pending;
+static unsigned req_frame;
+
+// true if the current request has been put off because the hardware is busy
+static bool req_deferred;
+
+static void (*input_fn)(unsigned);
+static bool (*busy_fn)(void);
+
+static struct rollback_snap *snap_at(unsigned idx);
+static void take_changed(void);
+static void undo_snap(struct rollback_snap *snap);
+
+void rollback_init(void) {
+    int frames = config_get_rollback_frames();
+    enabled = frames > 0;
+    if (frames > ROLLBACK_MAX_FRAMES) {
+        LOG_WARN("rollback is limited to %d frames\n", ROLLBACK_MAX_FRAMES);
+        frames = ROLLBACK_MAX_FRAMES;
+    }
+    max_snaps = enabled ? frames + 1 : 0;
+
+    snap_first = n_snaps = 0;
+    memset(snaps, 0, sizeof(snaps));
+    req_pending = false;
+    req_deferred = false;
+    washdc_mutex_init(&req_lock);
+
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        shadow[mem_no] = NULL;
+        changed[mem_no] = NULL;
+        if (enabled && savestate_get_mem(mem_no, &len, &dirty)) {
+            shadow[mem_no] = (uint8_t*)malloc(len);
+            changed[mem_no] =
+                (uint8_t*)calloc(len >> SAVESTATE_PAGE_SHIFT, 1);
+            if (!shadow[mem_no] || !changed[mem_no])
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+        }
+    }
+
+    if (enabled)
+        LOG_INFO("rollback enabled for up to %d frames\n", frames);
+}
+
+void rollback_cleanup(void) {
+    unsigned idx;
+    for (idx = 0; idx < ROLLBACK_MAX_SNAPS; idx++) {
+        free(snaps[idx].sects.dat);
+        free(snaps[idx].undo.dat);
+    }
+    memset(snaps, 0, sizeof(snaps));
+    snap_first = n_snaps = 0;
+
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        free(shadow[mem_no]);
+        free(changed[mem_no]);
+        shadow[mem_no] = changed[mem_no] = NULL;
+    }
+
+    washdc_mutex_cleanup(&req_lock);
+}
+
+bool rollback_enabled(void) {
+    return enabled;
+}
+
+static struct rollback_snap *snap_at(unsigned idx) {
+    return snaps + (snap_first + idx) % ROLLBACK_MAX_SNAPS;
+}
+
+// set changed to the pages written since the last time this was called
+static void take_changed(void) {
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        if (!savestate_get_mem(mem_no, &len, &dirty))
+            continue;
+        memset(changed[mem_no], 0, len >> SAVESTATE_PAGE_SHIFT);
+        savestate_take_dirty(mem_no, changed[mem_no]);
+    }
+}
+
+void rollback_frame(unsigned frame_no) {
+    if (!enabled)
+        return;
+
+    if (n_snaps >= max_snaps) {
+        snap_first = (snap_first + 1) % ROLLBACK_MAX_SNAPS;
+        n_snaps--;
+    }
+
+    struct rollback_snap *prev = n_snaps ? snap_at(n_snaps - 1) : NULL;
+    struct rollback_snap *snap = snap_at(n_snaps++);
+    snap->frame_no = frame_no;
+    snap->busy = busy_fn && busy_fn();
+    snap->sects.len = snap->sects.pos = 0;
+    snap->undo.len = snap->undo.pos = 0;
+
+    // sections go first since saving them can write to memory
+    savestate_save_sections(&snap->sects);
+
+    take_changed();
+
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        uint8_t *dat = savestate_get_mem(mem_no, &len, &dirty);
+        if (!dat)
+            continue;
+
+        if (!prev) {
+            memcpy(shadow[mem_no], dat, len);
+            continue;
+        }
+
+        uint8_t const *pages = changed[mem_no];
+        uint32_t page_no, n_pages = len >> SAVESTATE_PAGE_SHIFT;
+        for (page_no = 0; page_no < n_pages; page_no++) {
+            if (!pages[page_no])
+                continue;
+            size_t offs = (size_t)page_no << SAVESTATE_PAGE_SHIFT;
+            uint8_t *old = shadow[mem_no] + offs;
+            if (memcmp(old, dat + offs, SAVESTATE_PAGE_SIZE) == 0)
+                continue;
+
+            uint32_t ent[2] = { mem_no, page_no };
+            savestate_buf_put(&prev->undo, ent, sizeof(ent));
+            savestate_buf_put(&prev->undo, old, SAVESTATE_PAGE_SIZE);
+            memcpy(old, dat + offs, SAVESTATE_PAGE_SIZE);
+        }
+    }
+}
+
+void rollback_reset(void) {
+    n_snaps = 0;
+}
+
+int rollback_request(unsigned frame_no) {
+    if (!enabled)
+        return -1;
+
+    washdc_mutex_lock(&req_lock);
+    // if there's already a request, the older frame wins
+    if (!req_pending || frame_no < req_frame)
+        req_frame = frame_no;
+    req_pending = true;
+    washdc_mutex_unlock(&req_lock);
+    return 0;
+}
+
+// turn the shadow copy and the emulator's memory back into snap
+static void undo_snap(struct rollback_snap *snap) {
+    struct savestate_buf *undo = &snap->undo;
+    undo->pos = 0;
+    while (undo->pos < undo->len) {
+        uint32_t ent[2];
+        if (savestate_buf_get(undo, ent, sizeof(ent)) != 0 ||
+            ent[0] >= SAVESTATE_MEM_COUNT || !shadow[ent[0]] ||
+            undo->len - undo->pos < SAVESTATE_PAGE_SIZE)
+            RAISE_ERROR(ERROR_INTEGRITY);
+
+        size_t len;
+        uint8_t *dirty;
+        uint8_t *dat = savestate_get_mem(ent[0], &len, &dirty);
+        size_t offs = (size_t)ent[1] << SAVESTATE_PAGE_SHIFT;
+        memcpy(shadow[ent[0]] + offs, undo->dat + undo->pos,
+               SAVESTATE_PAGE_SIZE);
+        memcpy(dat + offs, undo->dat + undo->pos, SAVESTATE_PAGE_SIZE);
+        changed[ent[0]][ent[1]] = 1;
+        undo->pos += SAVESTATE_PAGE_SIZE;
+    }
+    undo->len = undo->pos = 0;
+}
+
+bool rollback_run_pending(unsigned *frame_no) {
+    washdc_mutex_lock(&req_lock);
+    bool pending = req_pending;
+    unsigned target = req_frame;
+    req_pending = false;
+    washdc_mutex_unlock(&req_lock);
+
+    if (!pending || !enabled || !n_snaps)
+        return false;
+
+    struct rollback_snap *newest = snap_at(n_snaps - 1);
+    if (target >= newest->frame_no) {
+        req_deferred = false;
+        return false;
+    }
+
+    /*
+     * restoring over hardware that's in the middle of something would lose
+     * whatever part of it doesn't get saved, so try again next frame.
+     */
+    if (busy_fn && busy_fn()) {
+        if (!req_deferred)
+            LOG_WARN("%s - hardware is busy; putting off rollback to frame "
+                     "%u\n", __func__, target);
+        req_deferred = true;
+        rollback_request(target);
+        return false;
+    }
+    req_deferred = false;
+
+    if (target < snap_at(0)->frame_no) {
+        LOG_WARN("%s - frame %u is too old to roll back to; using frame %u\n",
+                 __func__, target, snap_at(0)->frame_no);
+        target = snap_at(0)->frame_no;
+    }
+
+    // snapshots taken while the hardware was busy can't be restored
+    unsigned idx = n_snaps;
+    while (idx && (snap_at(idx - 1)->frame_no > target ||
+                   snap_at(idx - 1)->busy))
+        idx--;
+    if (!idx) {
+        LOG_WARN("%s - no snapshot at or before frame %u was taken while the "
+                 "hardware was idle; not rolling back\n", __func__, target);
+        return false;
+    }
+    if (snap_at(idx - 1)->frame_no != target) {
+        LOG_WARN("%s - hardware was busy at frame %u; using frame %u\n",
+                 __func__, target, snap_at(idx - 1)->frame_no);
+        target = snap_at(idx - 1)->frame_no;
+    }
+
+    // first undo whatever was written since the newest snapshot
+    take_changed();
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        uint8_t *dat = savestate_get_mem(mem_no, &len, &dirty);
+        if (!dat)
+            continue;
+        uint32_t page_no, n_pages = len >> SAVESTATE_PAGE_SHIFT;
+        for (page_no = 0; page_no < n_pages; page_no++) {
+            if (changed[mem_no][page_no]) {
+                size_t offs = (size_t)page_no << SAVESTATE_PAGE_SHIFT;
+                memcpy(dat + offs, shadow[mem_no] + offs, SAVESTATE_PAGE_SIZE);
+            }
+        }
+    }
+
+    while (snap_at(n_snaps - 1)->frame_no > target) {
+        n_snaps--;
+        undo_snap(snap_at(n_snaps - 1));
+    }
+
+    struct rollback_snap *snap = snap_at(n_snaps - 1);
+    snap->sects.pos = 0;
+    if (savestate_load_sections(&snap->sects) != 0)
+        LOG_ERROR("%s - failure to load sections\n", __func__);
+
+    /*
+     * the pages that just got restored have to be in the next checkpoint, but
+     * they shouldn't count as written to by the frames that run after this.
+     */
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        size_t len;
+        uint8_t *dirty;
+        if (!savestate_get_mem(mem_no, &len, &dirty))
+            continue;
+        uint32_t page_no, n_pages = len >> SAVESTATE_PAGE_SHIFT;
+        for (page_no = 0; page_no < n_pages; page_no++)
+            if (changed[mem_no][page_no])
+                dirty[page_no] = 1;
+        savestate_take_dirty(mem_no, changed[mem_no]);
+    }
+
+    *frame_no = target;
+    return true;
+}
+
+uint8_t const *rollback_changed_pages(enum savestate_mem mem) {
+    return mem < SAVESTATE_MEM_COUNT ? changed[mem] : NULL;
+}
+
+void rollback_set_input_fn(void (*fn)(unsigned)) {
+    input_fn = fn;
+}
+
+void rollback_set_busy_fn(bool (*fn)(void)) {
+    busy_fn = fn;
+}
+
+void rollback_input(unsigned frame_no) {
+    if (input_fn)
+        input_fn(frame_no);
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ROLLBACK_H_
+#define ROLLBACK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "savestate.h"
+
+/*
+ * in-memory snapshots for rollback netplay.
+ *
+ * When config_get_rollback_frames() is more than 0, a snapshot is taken at
+ * the start of every frame and the last rollback_frames of them are kept.
+ * Only the newest snapshot's memory is kept whole (as a shadow copy); every
+ * older one only holds its sections and the old contents of the pages that
+ * changed between it and the snapshot after it.  The dirty maps from
+ * savestate.c say which pages those are, so taking a snapshot only costs as
+ * much as the frame wrote.
+ *
+ * This has to be initialized after everything has been registered with
+ * savestate.c.
+ */
+
+#define ROLLBACK_MAX_FRAMES 30
+
+void rollback_init(void);
+void rollback_cleanup(void);
+
+bool rollback_enabled(void);
+
+/*
+ * called by the emulation thread once a frame is over and everything that
+ * might change the emulator's state in between frames has been done.
+ * frame_no is the number of the frame that's about to start.
+ */
+void rollback_frame(unsigned frame_no);
+
+/*
+ * throw away every snapshot.  This gets called whenever the emulator's state
+ * gets replaced by something other than rollback_run_pending.
+ */
+void rollback_reset(void);
+
+/*
+ * request to go back to the start of frame_no.  This can be called from any
+ * thread, and it returns -1 if rollback is disabled.
+ */
+int rollback_request(unsigned frame_no);
+
+/*
+ * called by the emulation thread right before rollback_frame.  If there's a
+ * request for a frame which is older than the newest snapshot then this
+ * restores that frame's snapshot, sets *frame_no to it and returns true.  If
+ * the frame is too old then the oldest snapshot gets restored instead.
+ *
+ * Nothing gets restored while the busy function says the hardware is busy;
+ * the request stays pending until the next frame instead.  Snapshots which
+ * were taken while it was busy get skipped in favor of the newest idle one
+ * before them, and if there isn't one then the request gets dropped.
+ */
+bool rollback_run_pending(unsigned *frame_no);
+
+/*
+ * the pages that the last call to rollback_run_pending changed, one byte per
+ * page as in savestate.h
+ */
+uint8_t const *rollback_changed_pages(enum savestate_mem mem);
+
+/*
+ * fn gets called on the emulation thread before every frame, including ones
+ * that get simulated again after a rollback, so that the frontend can set up
+ * the input for that frame.
+ */
+void rollback_set_input_fn(void (*fn)(unsigned));
+void rollback_input(unsigned frame_no);
+
+/*
+ * fn returns true when the hardware is in the middle of something that the
+ * snapshots don't capture well enough to restore.
+ */
+void rollback_set_busy_fn(bool (*fn)(void));
+
+#endif
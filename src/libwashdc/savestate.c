@@ -0,0 +1,981 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include <zlib.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "memory.h"
+#include "hw/pvr2/pvr2_tex_mem.h"
+#include "hw/aica/aica_wave_mem.h"
+#include "threading.h"
+#include "config.h"
+#include "log.h"
+
+#include "savestate.h"
+
+#define SAVESTATE_VERSION 2
+
+#define SAVESTATE_MAX_SECTIONS 32
+
+/*
+ * number of checkpoints that can be waiting on the writer thread before the
+ * emulation thread has to wait for it to catch up
+ */
+#define SAVESTATE_MAX_PENDING 4
+
+// set in a checkpoint's flags if it holds every page of every memory
+#define SAVESTATE_FLAG_FULL 1
+
+#define SAVESTATE_FILE_MAGIC "WASHDCST"
+#define SAVESTATE_CHECKPOINT_MAGIC 0x54504b43 // "CKPT"
+
+/*
+ * file header:
+ *     char magic[8]              SAVESTATE_FILE_MAGIC
+ *     uint32_t version           SAVESTATE_VERSION
+ *     uint32_t reserved
+ *     uint64_t session           session_id of the process that wrote it
+ *
+ * each checkpoint is a header followed by comp_len bytes of deflated data:
+ *     uint32_t magic             SAVESTATE_CHECKPOINT_MAGIC
+ *     uint32_t flags
+ *     uint32_t raw_len
+ *     uint32_t comp_len
+ *
+ * and the data inflates to
+ *     uint32_t n_sections
+ *     n_sections times:
+ *         uint32_t name_len, char name[name_len], uint32_t len, data[len]
+ *     uint32_t n_mems
+ *     n_mems times:
+ *         uint32_t mem, uint32_t n_pages
+ *         n_pages times:
+ *             uint32_t page_no, data[SAVESTATE_PAGE_SIZE]
+ *
+ * Everything is in host byte order since only the process that wrote the file
+ * can read it anyways.
+ */
+#define SAVESTATE_FILE_HEADER_LEN 24
+#define SAVESTATE_CHECKPOINT_HEADER_LEN 16
+
+uint8_t savestate_ram_dirty[MEMORY_SIZE >> SAVESTATE_PAGE_SHIFT];
+uint8_t savestate_vram_dirty[PVR2_TEX32_MEM_LEN >> SAVESTATE_PAGE_SHIFT];
+uint8_t savestate_wave_dirty[AICA_WAVE_MEM_LEN >> SAVESTATE_PAGE_SHIFT];
+
+/*
+ * pages that were dirty when savestate_take_dirty cleared them, so that the
+ * next checkpoint still includes them.
+ */
+static uint8_t ram_carry[sizeof(savestate_ram_dirty)];
+static uint8_t vram_carry[sizeof(savestate_vram_dirty)];
+static uint8_t wave_carry[sizeof(savestate_wave_dirty)];
+
+static struct savestate_mem_ent {
+    uint8_t *dat;
+    size_t len;
+    uint8_t *dirty, *carry;
+    bool shared;
+} mems[SAVESTATE_MEM_COUNT];
+
+// which memories put_pages and clear_dirty operate on
+enum mem_filter {
+    MEMS_ALL,
+    MEMS_SHARED,
+    MEMS_PRIVATE
+};
+
+static struct savestate_section_ent {
+    char const *name;
+    savestate_save_fn save;
+    savestate_load_fn load;
+    void *ctxt;
+
+    // for blocks, save and load are NULL
+    void *dat;
+    size_t len;
+} sections[SAVESTATE_MAX_SECTIONS];
+static unsigned n_sections;
+
+static uint64_t session_id;
+
+/*
+ * path of the stream that checkpoints are being appended to, and whether the
+ * next one needs to hold everything.  Only the emulation thread touches these.
+ */
+static char *stream_path;
+static bool stream_need_full;
+
+// a checkpoint that's waiting for the writer thread
+struct savestate_job {
+    struct savestate_buf raw;
+    unsigned flags;
+
+    // if non-NULL, close the current stream and start a new one here
+    char *new_path;
+};
+
+/*
+ * everything below is protected by lock.  The writer thread is the only one
+ * that touches out_file.
+ */
+static washdc_mutex lock;
+static washdc_cvar job_cvar, done_cvar;
+static washdc_thread writer_thread;
+static struct savestate_job jobs[SAVESTATE_MAX_PENDING];
+static unsigned job_first, n_jobs;
+static bool writer_busy, writer_quit;
+static washdc_hostfile out_file;
+
+// requests from outside of the emulation thread
+static char *req_checkpoint_path, *req_restore_path;
+static unsigned req_restore_no;
+
+#ifdef __linux__
+/*
+ * the child process that's writing the last checkpoint, when
+ * config_get_savestate_fork is set.  Only the emulation thread touches this.
+ */
+static pid_t child_pid;
+
+static void fork_checkpoint(struct savestate_job *job);
+static int child_write(struct savestate_job const *job);
+static void reap_child(void);
+#endif
+
+static void writer_main(void *argp);
+static void writer_write(struct savestate_job *job);
+static void make_file_header(uint8_t header[SAVESTATE_FILE_HEADER_LEN]);
+static uint8_t *compress_checkpoint(struct savestate_job const *job,
+                                    size_t *total);
+static void put_sections(struct savestate_buf *raw);
+static int validate_sections(struct savestate_buf *raw);
+static int apply_sections(struct savestate_buf *raw);
+static void put_pages(struct savestate_buf *raw, enum mem_filter filter);
+static void clear_dirty(enum mem_filter filter);
+static unsigned count_mems(void);
+static void savestate_checkpoint(char const *path);
+static int savestate_restore(char const *path, unsigned checkpoint_no);
+static void savestate_wait_idle(void);
+static char *savestate_strdup(char const *str);
+static void buf_put_u32(struct savestate_buf *buf, uint32_t val);
+static int buf_get_u32(struct savestate_buf *buf, uint32_t *val);
+
+void savestate_init(void) {
+    n_sections = 0;
+    memset(mems, 0, sizeof(mems));
+    mems[SAVESTATE_MEM_RAM].dirty = savestate_ram_dirty;
+    mems[SAVESTATE_MEM_VRAM].dirty = savestate_vram_dirty;
+    mems[SAVESTATE_MEM_WAVE].dirty = savestate_wave_dirty;
+    mems[SAVESTATE_MEM_RAM].carry = ram_carry;
+    mems[SAVESTATE_MEM_VRAM].carry = vram_carry;
+    mems[SAVESTATE_MEM_WAVE].carry = wave_carry;
+
+    session_id = ((uint64_t)time(NULL) << 32) ^ (uintptr_t)&session_id;
+
+    stream_path = NULL;
+    stream_need_full = true;
+
+    job_first = n_jobs = 0;
+    writer_busy = writer_quit = false;
+    out_file = WASHDC_HOSTFILE_INVALID;
+    req_checkpoint_path = req_restore_path = NULL;
+
+#ifdef __linux__
+    child_pid = -1;
+#endif
+
+    washdc_mutex_init(&lock);
+    washdc_cvar_init(&job_cvar);
+    washdc_cvar_init(&done_cvar);
+    washdc_thread_create(&writer_thread, writer_main, NULL);
+}
+
+void savestate_cleanup(void) {
+#ifdef __linux__
+    reap_child();
+#endif
+
+    washdc_mutex_lock(&lock);
+    writer_quit = true;
+    washdc_cvar_signal(&job_cvar);
+    washdc_mutex_unlock(&lock);
+    washdc_thread_join(&writer_thread);
+
+    if (out_file != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(out_file);
+    out_file = WASHDC_HOSTFILE_INVALID;
+
+    washdc_cvar_cleanup(&done_cvar);
+    washdc_cvar_cleanup(&job_cvar);
+    washdc_mutex_cleanup(&lock);
+
+    free(req_checkpoint_path);
+    free(req_restore_path);
+    free(stream_path);
+    req_checkpoint_path = req_restore_path = stream_path = NULL;
+}
+
+void savestate_add_mem(enum savestate_mem mem, uint8_t *dat, size_t len,
+                       bool shared) {
+    size_t n_pages = len >> SAVESTATE_PAGE_SHIFT;
+    if (mem >= SAVESTATE_MEM_COUNT || (len & (SAVESTATE_PAGE_SIZE - 1)) ||
+        (mem == SAVESTATE_MEM_RAM && n_pages > sizeof(savestate_ram_dirty)) ||
+        (mem == SAVESTATE_MEM_VRAM && n_pages > sizeof(savestate_vram_dirty)) ||
+        (mem == SAVESTATE_MEM_WAVE && n_pages > sizeof(savestate_wave_dirty)))
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+
+    mems[mem].dat = dat;
+    mems[mem].len = len;
+    mems[mem].shared = shared;
+}
+
+void savestate_add_section(char const *name, savestate_save_fn save,
+                           savestate_load_fn load, void *ctxt) {
+    if (n_sections >= SAVESTATE_MAX_SECTIONS)
+        RAISE_ERROR(ERROR_OVERFLOW);
+
+    struct savestate_section_ent *ent = sections + n_sections++;
+    memset(ent, 0, sizeof(*ent));
+    ent->name = name;
+    ent->save = save;
+    ent->load = load;
+    ent->ctxt = ctxt;
+}
+
+void savestate_add_block(char const *name, void *dat, size_t len) {
+    if (n_sections >= SAVESTATE_MAX_SECTIONS)
+        RAISE_ERROR(ERROR_OVERFLOW);
+
+    struct savestate_section_ent *ent = sections + n_sections++;
+    memset(ent, 0, sizeof(*ent));
+    ent->name = name;
+    ent->dat = dat;
+    ent->len = len;
+}
+
+void savestate_buf_put(struct savestate_buf *buf, void const *src, size_t len) {
+    if (buf->len + len > buf->alloc) {
+        size_t new_alloc = buf->alloc ? buf->alloc : 4096;
+        while (new_alloc < buf->len + len)
+            new_alloc *= 2;
+        uint8_t *new_dat = (uint8_t*)realloc(buf->dat, new_alloc);
+        if (!new_dat)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        buf->dat = new_dat;
+        buf->alloc = new_alloc;
+    }
+    memcpy(buf->dat + buf->len, src, len);
+    buf->len += len;
+}
+
+int savestate_buf_get(struct savestate_buf *buf, void *dst, size_t len) {
+    if (buf->len - buf->pos < len)
+        return -1;
+    memcpy(dst, buf->dat + buf->pos, len);
+    buf->pos += len;
+    return 0;
+}
+
+static void buf_put_u32(struct savestate_buf *buf, uint32_t val) {
+    savestate_buf_put(buf, &val, sizeof(val));
+}
+
+static int buf_get_u32(struct savestate_buf *buf, uint32_t *val) {
+    return savestate_buf_get(buf, val, sizeof(*val));
+}
+
+static char *savestate_strdup(char const *str) {
+    char *ret = (char*)malloc(strlen(str) + 1);
+    if (!ret)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    strcpy(ret, str);
+    return ret;
+}
+
+void savestate_request_checkpoint(char const *path) {
+    char *path_copy = savestate_strdup(path);
+
+    washdc_mutex_lock(&lock);
+    free(req_checkpoint_path);
+    req_checkpoint_path = path_copy;
+    washdc_mutex_unlock(&lock);
+}
+
+void savestate_request_restore(char const *path, unsigned checkpoint_no) {
+    char *path_copy = savestate_strdup(path);
+
+    washdc_mutex_lock(&lock);
+    free(req_restore_path);
+    req_restore_path = path_copy;
+    req_restore_no = checkpoint_no;
+    washdc_mutex_unlock(&lock);
+}
+
+bool savestate_run_pending(void) {
+    washdc_mutex_lock(&lock);
+    char *checkpoint_path = req_checkpoint_path;
+    char *restore_path = req_restore_path;
+    unsigned restore_no = req_restore_no;
+    req_checkpoint_path = req_restore_path = NULL;
+    washdc_mutex_unlock(&lock);
+
+    bool restored = false;
+
+    if (checkpoint_path) {
+        savestate_checkpoint(checkpoint_path);
+        free(checkpoint_path);
+    }
+
+    if (restore_path) {
+        if (savestate_restore(restore_path, restore_no) == 0) {
+            LOG_INFO("restored checkpoint %u of %s\n", restore_no, restore_path);
+            restored = true;
+        } else {
+            LOG_ERROR("unable to restore checkpoint %u of %s\n",
+                      restore_no, restore_path);
+        }
+        free(restore_path);
+    }
+
+    return restored;
+}
+
+static void savestate_checkpoint(char const *path) {
+    struct savestate_job job;
+    memset(&job, 0, sizeof(job));
+
+    if (!stream_path || strcmp(stream_path, path) != 0) {
+        free(stream_path);
+        stream_path = savestate_strdup(path);
+        job.new_path = savestate_strdup(path);
+        stream_need_full = true;
+    }
+
+    // sections go first since saving them can write to memory
+    put_sections(&job.raw);
+
+#ifdef __linux__
+    if (config_get_savestate_fork()) {
+        fork_checkpoint(&job);
+        return;
+    }
+#endif
+
+    buf_put_u32(&job.raw, count_mems());
+    put_pages(&job.raw, MEMS_ALL);
+    clear_dirty(MEMS_ALL);
+
+    if (stream_need_full)
+        job.flags |= SAVESTATE_FLAG_FULL;
+    stream_need_full = false;
+
+    LOG_DBG("%s - checkpoint is %llu bytes\n", __func__,
+            (unsigned long long)job.raw.len);
+
+    washdc_mutex_lock(&lock);
+    while (n_jobs >= SAVESTATE_MAX_PENDING)
+        washdc_cvar_wait(&done_cvar, &lock);
+    jobs[(job_first + n_jobs++) % SAVESTATE_MAX_PENDING] = job;
+    washdc_cvar_signal(&job_cvar);
+    washdc_mutex_unlock(&lock);
+}
+
+static void put_sections(struct savestate_buf *raw) {
+    buf_put_u32(raw, n_sections);
+    unsigned sect_no;
+    for (sect_no = 0; sect_no < n_sections; sect_no++) {
+        struct savestate_section_ent const *ent = sections + sect_no;
+        uint32_t name_len = strlen(ent->name);
+        buf_put_u32(raw, name_len);
+        savestate_buf_put(raw, ent->name, name_len);
+
+        size_t len_pos = raw->len;
+        buf_put_u32(raw, 0);
+        if (ent->save)
+            ent->save(raw, ent->ctxt);
+        else
+            savestate_buf_put(raw, ent->dat, ent->len);
+
+        uint32_t sect_len = raw->len - (len_pos + sizeof(uint32_t));
+        memcpy(raw->dat + len_pos, &sect_len, sizeof(sect_len));
+    }
+}
+
+static bool mem_in_filter(struct savestate_mem_ent const *mem,
+                          enum mem_filter filter) {
+    if (!mem->dat)
+        return false;
+    switch (filter) {
+    case MEMS_SHARED:
+        return mem->shared;
+    case MEMS_PRIVATE:
+        return !mem->shared;
+    default:
+        return true;
+    }
+}
+
+static unsigned count_mems(void) {
+    unsigned n_mems = 0, mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++)
+        if (mems[mem_no].dat)
+            n_mems++;
+    return n_mems;
+}
+
+/*
+ * append every dirty page of the memories in filter (or every page if
+ * stream_need_full is set).
+ */
+static void put_pages(struct savestate_buf *raw, enum mem_filter filter) {
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        struct savestate_mem_ent const *mem = mems + mem_no;
+        if (!mem_in_filter(mem, filter))
+            continue;
+
+        unsigned n_pages = mem->len >> SAVESTATE_PAGE_SHIFT;
+        unsigned page_no, n_dirty = 0;
+        if (stream_need_full) {
+            n_dirty = n_pages;
+        } else {
+            for (page_no = 0; page_no < n_pages; page_no++)
+                if (mem->dirty[page_no] || mem->carry[page_no])
+                    n_dirty++;
+        }
+
+        buf_put_u32(raw, mem_no);
+        buf_put_u32(raw, n_dirty);
+        for (page_no = 0; page_no < n_pages; page_no++) {
+            if (stream_need_full || mem->dirty[page_no] ||
+                mem->carry[page_no]) {
+                buf_put_u32(raw, page_no);
+                savestate_buf_put(raw,
+                                  mem->dat + (page_no << SAVESTATE_PAGE_SHIFT),
+                                  SAVESTATE_PAGE_SIZE);
+            }
+        }
+    }
+}
+
+void savestate_save_sections(struct savestate_buf *buf) {
+    put_sections(buf);
+}
+
+int savestate_load_sections(struct savestate_buf *buf) {
+    if (validate_sections(buf) != 0)
+        return -1;
+    return apply_sections(buf);
+}
+
+uint8_t *savestate_get_mem(enum savestate_mem mem, size_t *len,
+                           uint8_t **dirty) {
+    if (mem >= SAVESTATE_MEM_COUNT || !mems[mem].dat)
+        return NULL;
+    *len = mems[mem].len;
+    *dirty = mems[mem].dirty;
+    return mems[mem].dat;
+}
+
+void savestate_take_dirty(enum savestate_mem mem, uint8_t *out) {
+    if (mem >= SAVESTATE_MEM_COUNT || !mems[mem].dat)
+        return;
+
+    struct savestate_mem_ent const *ent = mems + mem;
+    unsigned n_pages = ent->len >> SAVESTATE_PAGE_SHIFT;
+    unsigned page_no;
+    for (page_no = 0; page_no < n_pages; page_no++) {
+        if (ent->dirty[page_no]) {
+            out[page_no] = 1;
+            ent->carry[page_no] = 1;
+            ent->dirty[page_no] = 0;
+        }
+    }
+}
+
+static void clear_dirty(enum mem_filter filter) {
+    unsigned mem_no;
+    for (mem_no = 0; mem_no < SAVESTATE_MEM_COUNT; mem_no++) {
+        struct savestate_mem_ent const *mem = mems + mem_no;
+        if (mem_in_filter(mem, filter)) {
+            memset(mem->dirty, 0, mem->len >> SAVESTATE_PAGE_SHIFT);
+            memset(mem->carry, 0, mem->len >> SAVESTATE_PAGE_SHIFT);
+        }
+    }
+}
+
+#ifdef __linux__
+/*
+ * fork a child process that copies memory out of its copy-on-write view and
+ * writes the checkpoint, so the emulation thread only waits for the fork.
+ * The sections have already been saved by this point since that can mean
+ * talking to the renderer, which the child can't do.  Memories that are
+ * MAP_SHARED don't get copied-on-write, so those get copied before the fork.
+ *
+ * The child only ever has this one thread and it exits without returning, so
+ * it doesn't touch any locks, the log, the JIT or the renderer.
+ */
+static void fork_checkpoint(struct savestate_job *job) {
+    // children append to the stream in order, so only one runs at a time
+    reap_child();
+
+    buf_put_u32(&job->raw, count_mems());
+    put_pages(&job->raw, MEMS_SHARED);
+
+    if (stream_need_full)
+        job->flags |= SAVESTATE_FLAG_FULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        put_pages(&job->raw, MEMS_PRIVATE);
+        _exit(child_write(job) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    } else if (pid < 0) {
+        LOG_WARN("%s - unable to fork; writing checkpoint synchronously\n",
+                 __func__);
+        put_pages(&job->raw, MEMS_PRIVATE);
+        if (child_write(job) != 0) {
+            LOG_ERROR("failure to write checkpoint to %s\n", stream_path);
+            stream_need_full = true;
+            goto done;
+        }
+    } else {
+        child_pid = pid;
+    }
+
+    clear_dirty(MEMS_ALL);
+    stream_need_full = false;
+
+done:
+    free(job->raw.dat);
+    free(job->new_path);
+}
+
+static int write_all(int fd, void const *dat, size_t len) {
+    uint8_t const *pos = (uint8_t const*)dat;
+    while (len) {
+        ssize_t n_written = write(fd, pos, len);
+        if (n_written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        pos += n_written;
+        len -= n_written;
+    }
+    return 0;
+}
+
+static int child_write(struct savestate_job const *job) {
+    int flags = O_WRONLY | O_CREAT | (job->new_path ? O_TRUNC : O_APPEND);
+    int fd = open(stream_path, flags, 0644);
+    if (fd < 0)
+        return -1;
+
+    int ret = 0;
+    if (job->new_path) {
+        uint8_t header[SAVESTATE_FILE_HEADER_LEN];
+        make_file_header(header);
+        ret = write_all(fd, header, sizeof(header));
+    }
+
+    size_t total;
+    uint8_t *comp = compress_checkpoint(job, &total);
+    if (!comp || write_all(fd, comp, total) != 0)
+        ret = -1;
+    free(comp);
+
+    if (close(fd) != 0)
+        ret = -1;
+    return ret;
+}
+
+static void reap_child(void) {
+    if (child_pid < 0)
+        return;
+
+    int status;
+    pid_t pid;
+    do {
+        pid = waitpid(child_pid, &status, 0);
+    } while (pid < 0 && errno == EINTR);
+    child_pid = -1;
+
+    if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        LOG_ERROR("failure to write checkpoint to %s\n", stream_path);
+        stream_need_full = true;
+    }
+}
+#endif
+
+// wait for the writer thread to finish every checkpoint handed to it
+static void savestate_wait_idle(void) {
+#ifdef __linux__
+    reap_child();
+#endif
+
+    washdc_mutex_lock(&lock);
+    while (n_jobs || writer_busy)
+        washdc_cvar_wait(&done_cvar, &lock);
+    washdc_mutex_unlock(&lock);
+}
+
+static void writer_main(void *argp) {
+    washdc_mutex_lock(&lock);
+    for (;;) {
+        while (!n_jobs && !writer_quit)
+            washdc_cvar_wait(&job_cvar, &lock);
+        if (!n_jobs)
+            break; // only quit once everything has been written
+
+        struct savestate_job job = jobs[job_first];
+        job_first = (job_first + 1) % SAVESTATE_MAX_PENDING;
+        n_jobs--;
+        writer_busy = true;
+        washdc_mutex_unlock(&lock);
+
+        writer_write(&job);
+        free(job.raw.dat);
+        free(job.new_path);
+
+        washdc_mutex_lock(&lock);
+        writer_busy = false;
+        washdc_cvar_broadcast(&done_cvar);
+    }
+    washdc_mutex_unlock(&lock);
+}
+
+static void writer_write(struct savestate_job *job) {
+    if (job->new_path) {
+        if (out_file != WASHDC_HOSTFILE_INVALID)
+            washdc_hostfile_close(out_file);
+
+        out_file = washdc_hostfile_open(job->new_path, WASHDC_HOSTFILE_WRITE |
+                                        WASHDC_HOSTFILE_BINARY);
+        if (out_file == WASHDC_HOSTFILE_INVALID) {
+            LOG_ERROR("unable to open %s for writing\n", job->new_path);
+            return;
+        }
+
+        uint8_t header[SAVESTATE_FILE_HEADER_LEN];
+        make_file_header(header);
+        if (washdc_hostfile_write(out_file, header, sizeof(header)) !=
+            sizeof(header))
+            LOG_ERROR("failure to write save-state header\n");
+    }
+
+    if (out_file == WASHDC_HOSTFILE_INVALID)
+        return;
+
+    size_t total;
+    uint8_t *comp = compress_checkpoint(job, &total);
+    if (!comp) {
+        LOG_ERROR("failure to compress checkpoint\n");
+        return;
+    }
+
+    if (washdc_hostfile_write(out_file, comp, total) != total)
+        LOG_ERROR("failure to write checkpoint\n");
+    washdc_hostfile_flush(out_file);
+
+    free(comp);
+}
+
+static void make_file_header(uint8_t header[SAVESTATE_FILE_HEADER_LEN]) {
+    uint32_t version = SAVESTATE_VERSION, reserved = 0;
+    memcpy(header, SAVESTATE_FILE_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 12, &reserved, sizeof(reserved));
+    memcpy(header + 16, &session_id, sizeof(session_id));
+}
+
+/*
+ * returns the checkpoint's header followed by its deflated data, or NULL if
+ * it couldn't be compressed.  *total is set to the length of all that.
+ */
+static uint8_t *compress_checkpoint(struct savestate_job const *job,
+                                    size_t *total) {
+    uLongf comp_len = compressBound(job->raw.len);
+    uint8_t *comp = (uint8_t*)malloc(SAVESTATE_CHECKPOINT_HEADER_LEN + comp_len);
+    if (!comp)
+        return NULL;
+
+    if (compress2(comp + SAVESTATE_CHECKPOINT_HEADER_LEN, &comp_len,
+                  job->raw.dat, job->raw.len, Z_BEST_SPEED) != Z_OK) {
+        free(comp);
+        return NULL;
+    }
+
+    uint32_t header[4] = {
+        SAVESTATE_CHECKPOINT_MAGIC, job->flags, job->raw.len, comp_len
+    };
+    memcpy(comp, header, sizeof(header));
+
+    *total = SAVESTATE_CHECKPOINT_HEADER_LEN + comp_len;
+    return comp;
+}
+
+/*
+ * make sure a checkpoint's data is well-formed so that it doesn't get
+ * half-applied.
+ */
+static int validate_sections(struct savestate_buf *raw) {
+    uint32_t n_sects, idx;
+
+    raw->pos = 0;
+    if (buf_get_u32(raw, &n_sects) != 0)
+        return -1;
+    for (idx = 0; idx < n_sects; idx++) {
+        uint32_t name_len, len;
+        if (buf_get_u32(raw, &name_len) != 0 ||
+            raw->len - raw->pos < name_len)
+            return -1;
+        raw->pos += name_len;
+        if (buf_get_u32(raw, &len) != 0 || raw->len - raw->pos < len)
+            return -1;
+        raw->pos += len;
+    }
+    return 0;
+}
+
+static int validate_checkpoint(struct savestate_buf *raw) {
+    uint32_t n_mems, idx;
+
+    if (validate_sections(raw) != 0)
+        return -1;
+
+    if (buf_get_u32(raw, &n_mems) != 0)
+        return -1;
+    for (idx = 0; idx < n_mems; idx++) {
+        uint32_t mem_no, n_pages, page_idx;
+        if (buf_get_u32(raw, &mem_no) != 0 || buf_get_u32(raw, &n_pages) != 0 ||
+            mem_no >= SAVESTATE_MEM_COUNT || !mems[mem_no].dat)
+            return -1;
+        for (page_idx = 0; page_idx < n_pages; page_idx++) {
+            uint32_t page_no;
+            if (buf_get_u32(raw, &page_no) != 0 ||
+                page_no >= (mems[mem_no].len >> SAVESTATE_PAGE_SHIFT) ||
+                raw->len - raw->pos < SAVESTATE_PAGE_SIZE)
+                return -1;
+            raw->pos += SAVESTATE_PAGE_SIZE;
+        }
+    }
+
+    return 0;
+}
+
+static void apply_pages(struct savestate_buf *raw) {
+    uint32_t n_sects = 0, n_mems = 0, idx;
+
+    // these were all checked by validate_checkpoint, so don't check them again
+    raw->pos = 0;
+    buf_get_u32(raw, &n_sects);
+    for (idx = 0; idx < n_sects; idx++) {
+        uint32_t len = 0;
+        buf_get_u32(raw, &len);
+        raw->pos += len;
+        buf_get_u32(raw, &len);
+        raw->pos += len;
+    }
+
+    buf_get_u32(raw, &n_mems);
+    for (idx = 0; idx < n_mems; idx++) {
+        uint32_t mem_no = 0, n_pages = 0, page_idx;
+        buf_get_u32(raw, &mem_no);
+        buf_get_u32(raw, &n_pages);
+        struct savestate_mem_ent *mem = mems + mem_no;
+        for (page_idx = 0; page_idx < n_pages; page_idx++) {
+            uint32_t page_no = 0;
+            buf_get_u32(raw, &page_no);
+            savestate_buf_get(raw, mem->dat + (page_no << SAVESTATE_PAGE_SHIFT),
+                              SAVESTATE_PAGE_SIZE);
+        }
+    }
+}
+
+static int apply_sections(struct savestate_buf *raw) {
+    uint32_t n_sects = 0, idx;
+    int ret = 0;
+
+    raw->pos = 0;
+    buf_get_u32(raw, &n_sects);
+    for (idx = 0; idx < n_sects; idx++) {
+        uint32_t name_len = 0, len = 0;
+        buf_get_u32(raw, &name_len);
+        char const *name = (char const*)raw->dat + raw->pos;
+        raw->pos += name_len;
+        buf_get_u32(raw, &len);
+
+        struct savestate_buf sect = {
+            .dat = raw->dat + raw->pos, .len = len, .alloc = len, .pos = 0
+        };
+        raw->pos += len;
+
+        unsigned sect_no;
+        for (sect_no = 0; sect_no < n_sections; sect_no++) {
+            if (strlen(sections[sect_no].name) == name_len &&
+                memcmp(sections[sect_no].name, name, name_len) == 0)
+                break;
+        }
+        if (sect_no >= n_sections) {
+            LOG_WARN("%s - unknown section \"%.*s\"\n", __func__,
+                     (int)name_len, name);
+            continue;
+        }
+
+        struct savestate_section_ent const *ent = sections + sect_no;
+        if (ent->load) {
+            if (ent->load(&sect, ent->ctxt) != 0) {
+                LOG_ERROR("%s - failure to load section \"%s\"\n",
+                          __func__, ent->name);
+                ret = -1;
+            }
+        } else if (len == ent->len) {
+            memcpy(ent->dat, sect.dat, len);
+        } else {
+            LOG_ERROR("%s - section \"%s\" has length %u, expected %u\n",
+                      __func__, ent->name, (unsigned)len, (unsigned)ent->len);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static int savestate_restore(char const *path, unsigned checkpoint_no) {
+    // everything needs to be on disk before it can be read back
+    savestate_wait_idle();
+
+    washdc_hostfile file =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                             WASHDC_HOSTFILE_BINARY);
+    if (file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open %s\n", path);
+        return -1;
+    }
+
+    int ret = -1;
+    unsigned n_raw = 0, idx;
+    long *offsets = NULL;
+    struct savestate_buf *raw = NULL;
+
+    uint8_t header[SAVESTATE_FILE_HEADER_LEN];
+    uint32_t version;
+    uint64_t session;
+    if (washdc_hostfile_read(file, header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, SAVESTATE_FILE_MAGIC, 8) != 0) {
+        LOG_ERROR("%s is not a save-state\n", path);
+        goto done;
+    }
+    memcpy(&version, header + 8, sizeof(version));
+    memcpy(&session, header + 16, sizeof(session));
+    if (version != SAVESTATE_VERSION || session != session_id) {
+        LOG_ERROR("%s was written by a different version or process\n", path);
+        goto done;
+    }
+
+    // find where every checkpoint up to checkpoint_no starts
+    offsets = (long*)malloc(sizeof(long) * (checkpoint_no + 1));
+    if (!offsets)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    unsigned first = 0;
+    uint32_t ckpt_header[4];
+    for (idx = 0; idx <= checkpoint_no; idx++) {
+        offsets[idx] = washdc_hostfile_tell(file);
+        if (washdc_hostfile_read(file, ckpt_header, sizeof(ckpt_header)) !=
+            sizeof(ckpt_header) ||
+            ckpt_header[0] != SAVESTATE_CHECKPOINT_MAGIC) {
+            LOG_ERROR("%s only has %u checkpoints\n", path, idx);
+            goto done;
+        }
+        if (ckpt_header[1] & SAVESTATE_FLAG_FULL)
+            first = idx;
+        if (washdc_hostfile_seek(file, ckpt_header[3],
+                                 WASHDC_HOSTFILE_SEEK_CUR) != 0)
+            goto done;
+    }
+
+    // decompress and check everything before touching any emulator state
+    n_raw = checkpoint_no - first + 1;
+    raw = (struct savestate_buf*)calloc(n_raw, sizeof(struct savestate_buf));
+    if (!raw)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    for (idx = 0; idx < n_raw; idx++) {
+        if (washdc_hostfile_seek(file, offsets[first + idx],
+                                 WASHDC_HOSTFILE_SEEK_BEG) != 0 ||
+            washdc_hostfile_read(file, ckpt_header, sizeof(ckpt_header)) !=
+            sizeof(ckpt_header))
+            goto done;
+
+        uint8_t *comp = (uint8_t*)malloc(ckpt_header[3]);
+        raw[idx].dat = (uint8_t*)malloc(ckpt_header[2]);
+        if (!comp || !raw[idx].dat)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        raw[idx].len = raw[idx].alloc = ckpt_header[2];
+
+        uLongf raw_len = ckpt_header[2];
+        int err = 0;
+        if (washdc_hostfile_read(file, comp, ckpt_header[3]) != ckpt_header[3] ||
+            uncompress(raw[idx].dat, &raw_len, comp, ckpt_header[3]) != Z_OK ||
+            raw_len != ckpt_header[2] || validate_checkpoint(raw + idx) != 0)
+            err = -1;
+        free(comp);
+
+        if (err) {
+            LOG_ERROR("checkpoint %u of %s is corrupt\n", first + idx, path);
+            goto done;
+        }
+    }
+
+    for (idx = 0; idx < n_raw; idx++)
+        apply_pages(raw + idx);
+    ret = apply_sections(raw + (n_raw - 1));
+
+    /*
+     * the last checkpoint in the stream might not be the one that was just
+     * restored, so the next one can't be relative to it.
+     */
+    stream_need_full = true;
+
+done:
+    if (raw) {
+        for (idx = 0; idx < n_raw; idx++)
+            free(raw[idx].dat);
+        free(raw);
+    }
+    free(offsets);
+    washdc_hostfile_close(file);
+    return ret;
+}
@@ -0,0 +1,183 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef SAVESTATE_H_
+#define SAVESTATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "washdc/types.h"
+
+/*
+ * save-states.
+ *
+ * A save-state file is a stream of checkpoints.  The first checkpoint in a
+ * stream holds every page of every memory, and each one after that only holds
+ * the pages which were written to since the checkpoint before it, so going
+ * back to checkpoint n means replaying the stream up to n starting from the
+ * last checkpoint before it that holds everything.  Everything else (CPU and
+ * device state) is small, so each checkpoint holds all of it.
+ *
+ * Checkpoints are taken on the emulation thread in between frames, but the
+ * compression and the writing happen on a separate thread.
+ *
+ * Scheduler events are saved by id (see sched_event_register), so a stream
+ * can be restored by a different process than the one that wrote it as long
+ * as the same disc is mounted.
+ */
+
+#define SAVESTATE_PAGE_SHIFT 12
+#define SAVESTATE_PAGE_SIZE (1 << SAVESTATE_PAGE_SHIFT)
+
+enum savestate_mem {
+    SAVESTATE_MEM_RAM,
+    SAVESTATE_MEM_VRAM,
+    SAVESTATE_MEM_WAVE,
+
+    SAVESTATE_MEM_COUNT
+};
+
+/*
+ * one byte per page, non-zero if the page was written to since the last
+ * checkpoint.  These are bytes instead of bits so that marking a page is a
+ * single store, which matters because it happens on every write.
+ */
+extern uint8_t savestate_ram_dirty[];
+extern uint8_t savestate_vram_dirty[];
+extern uint8_t savestate_wave_dirty[];
+
+static inline void
+savestate_mark_range(uint8_t *dirty, addr32_t first, addr32_t last) {
+    unsigned first_page = first >> SAVESTATE_PAGE_SHIFT;
+    unsigned last_page = last >> SAVESTATE_PAGE_SHIFT;
+    memset(dirty + first_page, 1, last_page - first_page + 1);
+}
+
+// addr is an offset into main RAM
+static inline void savestate_notify_ram_write(addr32_t addr, unsigned n_bytes) {
+    savestate_ram_dirty[addr >> SAVESTATE_PAGE_SHIFT] = 1;
+    savestate_ram_dirty[(addr + (n_bytes - 1)) >> SAVESTATE_PAGE_SHIFT] = 1;
+}
+
+// like savestate_notify_ram_write, but for big writes (ie DMA)
+static inline void savestate_notify_ram_range(addr32_t first, addr32_t last) {
+    savestate_mark_range(savestate_ram_dirty, first, last);
+}
+
+// addr is an offset into the 32-bit texture memory area
+static inline void
+savestate_notify_vram_write(addr32_t addr, unsigned n_bytes) {
+    if (n_bytes)
+        savestate_mark_range(savestate_vram_dirty, addr, addr + (n_bytes - 1));
+}
+
+static inline void
+savestate_notify_wave_write(addr32_t addr, unsigned n_bytes) {
+    savestate_wave_dirty[addr >> SAVESTATE_PAGE_SHIFT] = 1;
+    savestate_wave_dirty[(addr + (n_bytes - 1)) >> SAVESTATE_PAGE_SHIFT] = 1;
+}
+
+// growable buffer that sections save themselves into
+struct savestate_buf {
+    uint8_t *dat;
+    size_t len, alloc;
+
+    // read position, for loading
+    size_t pos;
+};
+
+void savestate_buf_put(struct savestate_buf *buf, void const *src, size_t len);
+
+// returns non-zero if there are fewer than len bytes left
+int savestate_buf_get(struct savestate_buf *buf, void *dst, size_t len);
+
+/*
+ * save or load a single field, for sections that have the same layout both
+ * ways.  This evaluates to non-zero if loading fails.
+ */
+#define SAVESTATE_XFER(buf, is_load, field)                             \
+    ((is_load) ? savestate_buf_get((buf), &(field), sizeof(field)) :    \
+     (savestate_buf_put((buf), &(field), sizeof(field)), 0))
+
+typedef void(*savestate_save_fn)(struct savestate_buf *buf, void *ctxt);
+typedef int(*savestate_load_fn)(struct savestate_buf *buf, void *ctxt);
+
+void savestate_init(void);
+void savestate_cleanup(void);
+
+/*
+ * these must be called after savestate_init and before any checkpoints are
+ * taken.  name has to stay valid until savestate_cleanup.
+ */
+/*
+ * shared should be true if dat is a MAP_SHARED mapping, because then a forked
+ * child wouldn't get its own copy of it (see config_get_savestate_fork).
+ */
+void savestate_add_mem(enum savestate_mem mem, uint8_t *dat, size_t len,
+                       bool shared);
+void savestate_add_section(char const *name, savestate_save_fn save,
+                           savestate_load_fn load, void *ctxt);
+
+// a section that just gets copied byte-for-byte
+void savestate_add_block(char const *name, void *dat, size_t len);
+
+/*
+ * for other modules that keep their own snapshots (see rewind.h).  These can
+ * only be called from the emulation thread, at the same point as
+ * savestate_run_pending.
+ *
+ * savestate_save_sections appends every section to buf, and
+ * savestate_load_sections loads a buffer written by savestate_save_sections,
+ * returning non-zero if it's malformed.  savestate_get_mem returns the memory
+ * registered as mem along with its length and dirty map, or NULL.
+ */
+void savestate_save_sections(struct savestate_buf *buf);
+int savestate_load_sections(struct savestate_buf *buf);
+uint8_t *savestate_get_mem(enum savestate_mem mem, size_t *len,
+                           uint8_t **dirty);
+
+/*
+ * for modules that need to know which pages were written to between two
+ * points in time (see rollback.h).  This sets out[page_no] for every page
+ * that's dirty and then clears it, but the next checkpoint will still include
+ * those pages.
+ */
+void savestate_take_dirty(enum savestate_mem mem, uint8_t *out);
+
+/*
+ * requests from outside of the emulation thread.  These get handled the next
+ * time savestate_run_pending is called.
+ */
+void savestate_request_checkpoint(char const *path);
+void savestate_request_restore(char const *path, unsigned checkpoint_no);
+
+/*
+ * call this from the emulation thread when it's safe to read and write
+ * emulator state.  returns true if a checkpoint was restored, in which case the
+ * caller needs to throw away anything it derived from memory.
+ */
+bool savestate_run_pending(void);
+
+#endif
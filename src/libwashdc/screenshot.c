@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <png.h>
 #include <time.h>
 #include <string.h>
@@ -29,33 +30,72 @@
 
 #include "washdc/hostfile.h"
 #include "washdc/gfx/gfx_il.h"
+#include "threading.h"
+#include "config.h"
 #include "log.h"
+#include "screenshot.h"
 
-static int do_save_screenshot(washdc_hostfile stream, char const *path);
+/*
+ * The framebuffer gets grabbed on the calling thread, but the encoding and
+ * the file I/O happen on a worker thread so that taking a screenshot doesn't
+ * make the emulator hitch.  The worker is started the first time a
+ * screenshot is taken.  If the worker falls SCREENSHOT_QUEUE_LEN screenshots
+ * behind then the caller waits for it instead of dropping anything.
+ */
+#define SCREENSHOT_QUEUE_LEN 8
+#define PATH_LEN 1024
+
+struct screenshot_job {
+    washdc_hostfile stream;
+    uint32_t *fb;
+    unsigned width, height;
+    bool do_flip;
+    enum screenshot_fmt fmt;
+    char path[PATH_LEN];
+};
+
+static struct screenshot_job queue[SCREENSHOT_QUEUE_LEN];
+static unsigned queue_head, queue_len;
+static bool worker_running, worker_quit;
+static washdc_thread worker_thread;
+static washdc_mutex queue_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar queue_cvar = WASHDC_CVAR_STATIC_INIT;
+
+static int queue_screenshot(washdc_hostfile stream, char const *path,
+                            enum screenshot_fmt fmt);
+static void worker_main(void *argp);
+static int save_png(struct screenshot_job const *job);
+static int save_qoi(struct screenshot_job const *job);
 static int grab_screen(uint32_t **fb_out, unsigned *fb_width_out,
                        unsigned *fb_height_out, bool *do_flip_out);
 
 static void write_wrapper_png(png_structp png, png_bytep dat, png_size_t len);
 static void flush_wrapper_png(png_structp png);
 
+static enum screenshot_fmt fmt_from_path(char const *path) {
+    char const *ext = strrchr(path, '.');
+    if (ext && strcmp(ext, ".qoi") == 0)
+        return SCREENSHOT_FMT_QOI;
+    return SCREENSHOT_FMT_PNG;
+}
+
 int save_screenshot(char const *path) {
     washdc_hostfile stream =
         washdc_hostfile_open(path,
                              WASHDC_HOSTFILE_WRITE | WASHDC_HOSTFILE_BINARY);
     if (stream == WASHDC_HOSTFILE_INVALID)
         return -1;
-    int ret = do_save_screenshot(stream, path);
-    washdc_hostfile_close(stream);
-    return ret;
+    return queue_screenshot(stream, path, fmt_from_path(path));
 }
 
 #define TIMESTR_LEN 32
-#define PATH_LEN 1024
 
 int save_screenshot_dir(void) {
     time_t rawtime;
     struct tm *timeinfo;
     char timestr[TIMESTR_LEN];
+    enum screenshot_fmt fmt = (enum screenshot_fmt)config_get_screenshot_fmt();
+    char const *ext = fmt == SCREENSHOT_FMT_QOI ? "qoi" : "png";
 
     time(&rawtime);
     timeinfo = localtime(&rawtime);
@@ -64,7 +104,7 @@ int save_screenshot_dir(void) {
     timestr[TIMESTR_LEN - 1] = '\0';
 
     static char filename[PATH_LEN];
-    snprintf(filename, PATH_LEN, "%s.png", timestr);
+    snprintf(filename, PATH_LEN, "%s.%s", timestr, ext);
     washdc_hostfile stream;
     int idx;
     for (idx = 0; idx < 16; idx++) {
@@ -75,40 +115,119 @@ int save_screenshot_dir(void) {
         if (stream != WASHDC_HOSTFILE_INVALID)
             break;
         else
-            snprintf(filename, PATH_LEN, "%s_%d.png", timestr, idx);
+            snprintf(filename, PATH_LEN, "%s_%d.%s", timestr, idx, ext);
     }
     if (stream == WASHDC_HOSTFILE_INVALID)
         return -1;
 
-    int ret = do_save_screenshot(stream, filename);
-    washdc_hostfile_close(stream);
-    return ret;
+    return queue_screenshot(stream, filename, fmt);
 }
 
-static int do_save_screenshot(washdc_hostfile stream, char const *path) {
-    int err_val = 0;
-    uint32_t *fb_tmp = NULL;
+void screenshot_cleanup(void) {
+    if (!worker_running)
+        return;
+
+    // the worker finishes everything in the queue before it exits
+    washdc_mutex_lock(&queue_lock);
+    worker_quit = true;
+    washdc_cvar_broadcast(&queue_cvar);
+    washdc_mutex_unlock(&queue_lock);
+
+    washdc_thread_join(&worker_thread);
+    worker_running = false;
+}
+
+static int queue_screenshot(washdc_hostfile stream, char const *path,
+                            enum screenshot_fmt fmt) {
+    uint32_t *fb;
     unsigned fb_width, fb_height;
     bool do_flip;
 
-    if (grab_screen(&fb_tmp, &fb_width, &fb_height, &do_flip) < 0) {
+    if (grab_screen(&fb, &fb_width, &fb_height, &do_flip) < 0) {
         LOG_ERROR("%s - Failed to capture screenshot\n", __func__);
+        washdc_hostfile_close(stream);
         return -1;
     }
 
-    if (!fb_tmp) {
+    if (!fb) {
         LOG_WARN("Unable to save screenshot to %s due to failure to obtain "
                  "screengrab\n", path);
-        err_val = -1;
-        goto free_screengrab;
+        washdc_hostfile_close(stream);
+        return -1;
+    }
+
+    if (!worker_running) {
+        worker_quit = false;
+        queue_head = queue_len = 0;
+        worker_running = true;
+        washdc_thread_create(&worker_thread, worker_main, NULL);
     }
 
+    washdc_mutex_lock(&queue_lock);
+    while (queue_len == SCREENSHOT_QUEUE_LEN)
+        washdc_cvar_wait(&queue_cvar, &queue_lock);
+
+    struct screenshot_job *job =
+        queue + (queue_head + queue_len) % SCREENSHOT_QUEUE_LEN;
+    job->stream = stream;
+    job->fb = fb;
+    job->width = fb_width;
+    job->height = fb_height;
+    job->do_flip = do_flip;
+    job->fmt = fmt;
+    strncpy(job->path, path, PATH_LEN);
+    job->path[PATH_LEN - 1] = '\0';
+    queue_len++;
+
+    washdc_cvar_broadcast(&queue_cvar);
+    washdc_mutex_unlock(&queue_lock);
+
+    return 0;
+}
+
+static void worker_main(void *argp) {
+    washdc_mutex_lock(&queue_lock);
+    for (;;) {
+        while (!queue_len && !worker_quit)
+            washdc_cvar_wait(&queue_cvar, &queue_lock);
+        if (!queue_len)
+            break;
+
+        struct screenshot_job job = queue[queue_head];
+        queue_head = (queue_head + 1) % SCREENSHOT_QUEUE_LEN;
+        queue_len--;
+        washdc_cvar_broadcast(&queue_cvar);
+        washdc_mutex_unlock(&queue_lock);
+
+        int err = job.fmt == SCREENSHOT_FMT_QOI ?
+            save_qoi(&job) : save_png(&job);
+        if (err != 0)
+            LOG_ERROR("Failed to save screenshot to %s\n", job.path);
+
+        washdc_hostfile_close(job.stream);
+        free(job.fb);
+
+        washdc_mutex_lock(&queue_lock);
+    }
+    washdc_mutex_unlock(&queue_lock);
+}
+
+// index of the framebuffer pixel that goes on the given row of the picture
+static inline unsigned
+pix_idx(struct screenshot_job const *job, unsigned row, unsigned col) {
+    if (!job->do_flip)
+        return (job->height - 1 - row) * job->width + col;
+    return row * job->width + col;
+}
+
+static int save_png(struct screenshot_job const *job) {
+    int err_val = 0;
+    unsigned fb_width = job->width, fb_height = job->height;
+
     png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
                                                   NULL, NULL, NULL);
-    if (!png_ptr) {
-        err_val = -1;
-        goto close_file;
-    }
+    if (!png_ptr)
+        return -1;
 
     png_infop info_ptr = png_create_info_struct(png_ptr);
 
@@ -122,11 +241,18 @@ static int do_save_screenshot(washdc_hostfile stream, char const *path) {
         goto cleanup_png;
     }
 
-    png_set_write_fn(png_ptr, stream, write_wrapper_png, flush_wrapper_png);
+    png_set_write_fn(png_ptr, job->stream, write_wrapper_png,
+                     flush_wrapper_png);
+
+    int level = config_get_screenshot_png_level();
+    if (level > 0 && level <= 9)
+        png_set_compression_level(png_ptr, level);
 
     png_bytepp row_pointers = (png_bytepp)calloc(fb_height, sizeof(png_bytep));
-    if (!row_pointers)
+    if (!row_pointers) {
+        err_val = -1;
         goto cleanup_png;
+    }
 
     unsigned row, col;
     for (row = 0; row < fb_height; row++) {
@@ -134,12 +260,7 @@ static int do_save_screenshot(washdc_hostfile stream, char const *path) {
             (png_bytep)malloc(sizeof(png_byte) * fb_width * 3);
 
         for (col = 0; col < fb_width; col++) {
-            unsigned pix_idx;
-            if (!do_flip)
-                pix_idx = (fb_height - 1 - row) * fb_width + col;
-            else
-                pix_idx = row * fb_width + col;
-            uint32_t in_px = fb_tmp[pix_idx];
+            uint32_t in_px = job->fb[pix_idx(job, row, col)];
             unsigned red = in_px & 0xff;
             unsigned green = (in_px >> 8) & 0xff;
             unsigned blue = (in_px >> 16) & 0xff;
@@ -162,9 +283,133 @@ static int do_save_screenshot(washdc_hostfile stream, char const *path) {
     free(row_pointers);
  cleanup_png:
     png_destroy_write_struct(&png_ptr, &info_ptr);
- close_file:
- free_screengrab:
-    free(fb_tmp);
+    return err_val;
+}
+
+/*
+ * QOI ("quite OK image format") is far cheaper to encode than PNG and still
+ * gets most of the size reduction on the flat-shaded pictures games tend to
+ * have, which makes it a better fit for taking lots of screenshots.  This
+ * always writes 3-channel sRGB images.
+ */
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+
+#define QOI_HEADER_LEN 14
+#define QOI_PADDING_LEN 8
+#define QOI_MAX_RUN 62
+
+static inline void put_be32(uint8_t *dst, uint32_t val) {
+    dst[0] = val >> 24;
+    dst[1] = val >> 16;
+    dst[2] = val >> 8;
+    dst[3] = val;
+}
+
+static int save_qoi(struct screenshot_job const *job) {
+    size_t max_len = QOI_HEADER_LEN + QOI_PADDING_LEN +
+        (size_t)job->width * job->height * 4;
+    uint8_t *out = (uint8_t*)malloc(max_len);
+    if (!out)
+        return -1;
+
+    memcpy(out, "qoif", 4);
+    put_be32(out + 4, job->width);
+    put_be32(out + 8, job->height);
+    out[12] = 3; // channels
+    out[13] = 0; // sRGB with linear alpha
+    size_t len = QOI_HEADER_LEN;
+
+    uint32_t index[64];
+    memset(index, 0, sizeof(index));
+
+    /*
+     * pixels are kept as 0xffRRGGBB so that the empty (transparent black)
+     * slots in the index can't match anything.
+     */
+    uint32_t prev = 0xff000000;
+    unsigned run = 0;
+
+    unsigned row, col;
+    for (row = 0; row < job->height; row++) {
+        for (col = 0; col < job->width; col++) {
+            uint32_t in_px = job->fb[pix_idx(job, row, col)];
+            unsigned red = in_px & 0xff;
+            unsigned green = (in_px >> 8) & 0xff;
+            unsigned blue = (in_px >> 16) & 0xff;
+            uint32_t px = 0xff000000 | (red << 16) | (green << 8) | blue;
+
+            if (px == prev) {
+                if (++run == QOI_MAX_RUN) {
+                    out[len++] = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run) {
+                out[len++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            // alpha is always 255
+            unsigned hash = (red * 3 + green * 5 + blue * 7 + 255 * 11) % 64;
+            if (index[hash] == px) {
+                out[len++] = QOI_OP_INDEX | hash;
+            } else {
+                index[hash] = px;
+
+                int dr = (int)red - (int)((prev >> 16) & 0xff);
+                int dg = (int)green - (int)((prev >> 8) & 0xff);
+                int db = (int)blue - (int)(prev & 0xff);
+                int dr_dg = dr - dg, db_dg = db - dg;
+
+                /*
+                 * differences wrap around, so they're reduced to 8 bits
+                 * before checking what fits.
+                 */
+                dr = (int8_t)dr;
+                dg = (int8_t)dg;
+                db = (int8_t)db;
+                dr_dg = (int8_t)dr_dg;
+                db_dg = (int8_t)db_dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 &&
+                    db >= -2 && db <= 1) {
+                    out[len++] = QOI_OP_DIFF | ((dr + 2) << 4) |
+                        ((dg + 2) << 2) | (db + 2);
+                } else if (dg >= -32 && dg <= 31 &&
+                           dr_dg >= -8 && dr_dg <= 7 &&
+                           db_dg >= -8 && db_dg <= 7) {
+                    out[len++] = QOI_OP_LUMA | (dg + 32);
+                    out[len++] = ((dr_dg + 8) << 4) | (db_dg + 8);
+                } else {
+                    out[len++] = QOI_OP_RGB;
+                    out[len++] = red;
+                    out[len++] = green;
+                    out[len++] = blue;
+                }
+            }
+            prev = px;
+        }
+    }
+
+    if (run)
+        out[len++] = QOI_OP_RUN | (run - 1);
+
+    // end marker
+    memset(out + len, 0, QOI_PADDING_LEN - 1);
+    out[len + QOI_PADDING_LEN - 1] = 1;
+    len += QOI_PADDING_LEN;
+
+    int err_val = 0;
+    if (washdc_hostfile_write(job->stream, out, len) != len)
+        err_val = -1;
+
+    free(out);
     return err_val;
 }
 
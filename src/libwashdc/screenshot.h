@@ -23,7 +23,20 @@
 #ifndef SCREENSHOT_H_
 #define SCREENSHOT_H_
 
+enum screenshot_fmt {
+    SCREENSHOT_FMT_PNG,
+    SCREENSHOT_FMT_QOI
+};
+
+/*
+ * these grab the framebuffer right away, but the file gets written on a
+ * worker thread.  save_screenshot writes QOI if the path ends in .qoi and PNG
+ * otherwise; save_screenshot_dir uses the format from the config.
+ */
 int save_screenshot(char const *path);
 int save_screenshot_dir(void);
 
+// waits for any screenshots which are still being written
+void screenshot_cleanup(void);
+
 #endif
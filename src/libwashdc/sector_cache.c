@@ -0,0 +1,172 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "log.h"
+
+#include "sector_cache.h"
+
+static void sector_cache_thread_main(void *argp);
+static int sector_buf_fill(struct sector_buf *buf,
+                           struct sector_run const *run, unsigned fad);
+static bool sector_buf_has(struct sector_buf const *buf,
+                           struct sector_run const *run, unsigned fad);
+static void sector_cache_prefetch(struct sector_cache *cache,
+                                  struct sector_run const *run, unsigned fad);
+
+void sector_cache_init(struct sector_cache *cache) {
+    memset(cache->bufs, 0, sizeof(cache->bufs));
+    cache->cur = 0;
+    cache->busy = false;
+    cache->quit = false;
+
+    washdc_mutex_init(&cache->lock);
+    washdc_cvar_init(&cache->req_cvar);
+    washdc_cvar_init(&cache->done_cvar);
+
+    washdc_thread_create(&cache->thread, sector_cache_thread_main, cache);
+}
+
+void sector_cache_cleanup(struct sector_cache *cache) {
+    washdc_mutex_lock(&cache->lock);
+    cache->quit = true;
+    washdc_cvar_signal(&cache->req_cvar);
+    washdc_mutex_unlock(&cache->lock);
+
+    washdc_thread_join(&cache->thread);
+
+    washdc_cvar_cleanup(&cache->done_cvar);
+    washdc_cvar_cleanup(&cache->req_cvar);
+    washdc_mutex_cleanup(&cache->lock);
+}
+
+uint8_t const *sector_cache_get(struct sector_cache *cache,
+                                struct sector_run const *run, unsigned fad) {
+    if (fad < run->first || fad >= run->first + run->count ||
+        run->frame_len > CDROM_FRAME_SIZE)
+        return NULL;
+
+    struct sector_buf *buf = cache->bufs + cache->cur;
+    if (!sector_buf_has(buf, run, fad)) {
+        sector_cache_sync(cache);
+
+        struct sector_buf *next = cache->bufs + (cache->cur ^ 1);
+        if (sector_buf_has(next, run, fad)) {
+            cache->cur ^= 1;
+            buf = next;
+        } else if (sector_buf_fill(buf, run, fad) != 0) {
+            return NULL;
+        }
+    }
+
+    unsigned next_fad = buf->fad + buf->len;
+    if (next_fad < run->first + run->count)
+        sector_cache_prefetch(cache, run, next_fad);
+
+    return buf->dat + (size_t)(fad - buf->fad) * run->frame_len;
+}
+
+void sector_cache_sync(struct sector_cache *cache) {
+    washdc_mutex_lock(&cache->lock);
+    while (cache->busy)
+        washdc_cvar_wait(&cache->done_cvar, &cache->lock);
+    washdc_mutex_unlock(&cache->lock);
+}
+
+static void sector_cache_prefetch(struct sector_cache *cache,
+                                  struct sector_run const *run, unsigned fad) {
+    washdc_mutex_lock(&cache->lock);
+    if (!cache->busy) {
+        struct sector_buf *next = cache->bufs + (cache->cur ^ 1);
+        if (!sector_buf_has(next, run, fad)) {
+            next->valid = false;
+            cache->req_run = *run;
+            cache->req_fad = fad;
+            cache->busy = true;
+            washdc_cvar_signal(&cache->req_cvar);
+        }
+    }
+    washdc_mutex_unlock(&cache->lock);
+}
+
+static void sector_cache_thread_main(void *argp) {
+    struct sector_cache *cache = (struct sector_cache*)argp;
+
+    washdc_mutex_lock(&cache->lock);
+    for (;;) {
+        while (!cache->busy && !cache->quit)
+            washdc_cvar_wait(&cache->req_cvar, &cache->lock);
+        if (cache->quit)
+            break;
+
+        struct sector_buf *buf = cache->bufs + (cache->cur ^ 1);
+        struct sector_run run = cache->req_run;
+        unsigned fad = cache->req_fad;
+
+        washdc_mutex_unlock(&cache->lock);
+        if (sector_buf_fill(buf, &run, fad) != 0)
+            LOG_WARN("%s - failed to prefetch fad %u\n", __func__, fad);
+        washdc_mutex_lock(&cache->lock);
+
+        cache->busy = false;
+        washdc_cvar_signal(&cache->done_cvar);
+    }
+    washdc_mutex_unlock(&cache->lock);
+}
+
+static int sector_buf_fill(struct sector_buf *buf,
+                           struct sector_run const *run, unsigned fad) {
+    unsigned n_frames = run->first + run->count - fad;
+    if (n_frames > SECTOR_CACHE_FRAMES)
+        n_frames = SECTOR_CACHE_FRAMES;
+    size_t n_bytes = (size_t)n_frames * run->frame_len;
+    size_t offset = run->offset + (size_t)(fad - run->first) * run->frame_len;
+
+    buf->valid = false;
+
+    size_t bytes_read = washdc_hostfile_pread(run->stream, buf->dat,
+                                              n_bytes, (long)offset);
+    if (bytes_read != n_bytes) {
+        LOG_ERROR("failure to read %llu bytes at byte offset %llx "
+                  "(returned length %llu)\n",
+                  (unsigned long long)n_bytes, (unsigned long long)offset,
+                  (unsigned long long)bytes_read);
+        return -1;
+    }
+
+    buf->run = *run;
+    buf->fad = fad;
+    buf->len = n_frames;
+    buf->valid = true;
+
+    return 0;
+}
+
+static bool sector_buf_has(struct sector_buf const *buf,
+                           struct sector_run const *run, unsigned fad) {
+    return buf->valid && buf->run.stream == run->stream &&
+        buf->run.offset == run->offset &&
+        buf->run.frame_len == run->frame_len &&
+        buf->run.first == run->first &&
+        fad >= buf->fad && fad < buf->fad + buf->len;
+}
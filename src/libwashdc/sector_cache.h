@@ -0,0 +1,96 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef SECTOR_CACHE_H_
+#define SECTOR_CACHE_H_
+
+/*
+ * sector_cache.h
+ *
+ * Read-ahead cache shared by the disc image backends.  Frames are read from
+ * the image in runs of SECTOR_CACHE_FRAMES at a time, and a background thread
+ * reads the next run while the current one is being consumed so that a
+ * sequential GD-ROM transfer rarely has to wait on the host filesystem.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "washdc/hostfile.h"
+#include "threading.h"
+#include "cdrom.h"
+
+#define SECTOR_CACHE_FRAMES 64
+
+/*
+ * a contiguous array of frames within a file.  Frame number first is located
+ * at byte offset, and each subsequent frame is frame_len bytes after that.
+ */
+struct sector_run {
+    washdc_hostfile stream;
+    size_t offset;
+    unsigned frame_len;
+    unsigned first;
+    unsigned count;
+};
+
+struct sector_buf {
+    struct sector_run run;
+    unsigned fad, len; // frames [fad, fad + len) of run
+    bool valid;
+    uint8_t dat[SECTOR_CACHE_FRAMES * CDROM_FRAME_SIZE];
+};
+
+struct sector_cache {
+    struct sector_buf bufs[2];
+    unsigned cur;
+
+    // everything below here is protected by lock
+    washdc_mutex lock;
+    washdc_cvar req_cvar, done_cvar;
+    washdc_thread thread;
+
+    // true while the prefetch thread owns bufs[cur ^ 1]
+    bool busy;
+    bool quit;
+    struct sector_run req_run;
+    unsigned req_fad;
+};
+
+void sector_cache_init(struct sector_cache *cache);
+void sector_cache_cleanup(struct sector_cache *cache);
+
+/*
+ * return a pointer to the beginning of the given frame, or NULL if it could
+ * not be read.  The pointer is only valid until the next call.
+ */
+uint8_t const *sector_cache_get(struct sector_cache *cache,
+                                struct sector_run const *run, unsigned fad);
+
+/*
+ * wait for any outstanding prefetch to finish.  This must be called before
+ * accessing any of the cache's streams from outside of the cache.
+ */
+void sector_cache_sync(struct sector_cache *cache);
+
+#endif
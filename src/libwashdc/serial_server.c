@@ -40,18 +40,54 @@ serial_server_attach(struct serial_server_intf const *intf, struct Sh4 *cpu) {
         sersrv->attach();
 }
 
+/*
+ * set when the serial server couldn't fit everything it had into the rxq.  The
+ * SCIF clears it and tells the serial server to try again once it has made
+ * some room.
+ */
+static washdc_atomic_int rx_blocked = WASHDC_ATOMIC_INT_INIT(0);
+
+void serial_server_notify_rx_space(void) {
+    int expect = 1;
+    if (washdc_atomic_int_compare_exchange(&rx_blocked, &expect, 0) &&
+        sersrv && sersrv->notify_rx_space) {
+        sersrv->notify_rx_space();
+    }
+}
+
 void washdc_serial_server_rx(char ch) {
-    struct text_ring *rxq = &sh4->scif.rxq;
-    text_ring_produce(rxq, ch);
-    sh4_scif_rx(sh4);
+    washdc_serial_server_rx_n(&ch, 1);
+}
+
+unsigned washdc_serial_server_rx_n(char const *dat, unsigned n_chars) {
+    struct scif_ring *rxq = &sh4->scif.rxq;
+    unsigned n_done = scif_ring_produce_n(rxq, dat, n_chars);
+
+    if (n_done < n_chars) {
+        /*
+         * the flag has to be set before trying again, otherwise the SCIF
+         * could empty the rxq in between without knowing that anybody is
+         * waiting on it.
+         */
+        washdc_atomic_int_store(&rx_blocked, 1);
+        n_done += scif_ring_produce_n(rxq, dat + n_done, n_chars - n_done);
+    }
+
+    if (n_done)
+        sh4_scif_rx(sh4);
+    return n_done;
 }
 
 int washdc_serial_server_tx(char *ch) {
-    if (text_ring_consume(&sh4->scif.txq, ch))
+    if (scif_ring_consume_n(&sh4->scif.txq, ch, 1))
         return 0;
     return -1;
 }
 
+unsigned washdc_serial_server_tx_n(char *buf, unsigned max_chars) {
+    return scif_ring_consume_n(&sh4->scif.txq, buf, max_chars);
+}
+
 void washdc_serial_server_cts(void) {
     sh4_scif_cts(sh4);
 }
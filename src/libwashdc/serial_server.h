@@ -28,6 +28,9 @@
 struct Sh4;
 
 void serial_server_notify_tx_ready(void);
+
+// called by the SCIF whenever it takes data out of the rxq
+void serial_server_notify_rx_space(void);
 void
 serial_server_attach(struct serial_server_intf const *intf, struct Sh4 *cpu);
 
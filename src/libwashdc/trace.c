@@ -0,0 +1,283 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "real_ticks.h"
+#include "threading.h"
+#include "config.h"
+#include "log.h"
+
+#include "trace.h"
+
+#define TRACE_CHUNK_LEN 4096
+
+#define TRACE_PID_HOST 1
+#define TRACE_PID_GUEST 2
+
+struct trace_evt {
+    char const *name;
+    enum trace_track track;
+    uint64_t start_ns, dur_ns;
+    dc_cycle_stamp_t cycle_start, cycle_end;
+};
+
+struct trace_chunk {
+    struct trace_chunk *next;
+    unsigned n_evts;
+    struct trace_evt evts[TRACE_CHUNK_LEN];
+};
+
+bool trace_enabled;
+
+static washdc_hostfile trace_file = WASHDC_HOSTFILE_INVALID;
+static washdc_real_time trace_start;
+
+static washdc_thread writer_thread;
+static washdc_mutex trace_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar trace_cvar = WASHDC_CVAR_STATIC_INIT;
+static bool writer_quit;
+
+// chunk that's being filled, and the full ones waiting to be written
+static struct trace_chunk *cur_chunk;
+static struct trace_chunk *full_first, *full_last;
+
+static unsigned long long n_evts_written;
+
+static char const *const track_names[TRACE_TRACK_COUNT] = {
+    [TRACE_TRACK_SH4_SCHED] = "sh4 events",
+    [TRACE_TRACK_ARM7_SCHED] = "arm7 events",
+    [TRACE_TRACK_FRAME] = "frame",
+    [TRACE_TRACK_RENDER] = "render",
+    [TRACE_TRACK_GDROM] = "gdrom"
+};
+
+static void writer_main(void *argp);
+static void write_chunk(struct trace_chunk const *chunk);
+static void write_preamble(void);
+static struct trace_chunk *alloc_chunk(void);
+
+void trace_init(void) {
+    char const *path = config_get_trace_path();
+
+    if (!strlen(path))
+        return;
+
+    trace_file = washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                                      WASHDC_HOSTFILE_TEXT);
+    if (trace_file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open %s to write a trace\n", path);
+        return;
+    }
+
+    write_preamble();
+
+    washdc_get_real_time(&trace_start);
+    n_evts_written = 0;
+    writer_quit = false;
+    cur_chunk = alloc_chunk();
+    full_first = full_last = NULL;
+
+    washdc_thread_create(&writer_thread, writer_main, NULL);
+    trace_enabled = true;
+
+    LOG_INFO("writing trace to %s\n", path);
+}
+
+void trace_cleanup(void) {
+    if (!trace_enabled)
+        return;
+    trace_enabled = false;
+
+    washdc_mutex_lock(&trace_lock);
+    if (full_last)
+        full_last->next = cur_chunk;
+    else
+        full_first = cur_chunk;
+    full_last = cur_chunk;
+    cur_chunk = NULL;
+    writer_quit = true;
+    washdc_cvar_signal(&trace_cvar);
+    washdc_mutex_unlock(&trace_lock);
+
+    washdc_thread_join(&writer_thread);
+
+    washdc_hostfile_puts(trace_file, "\n]}\n");
+    washdc_hostfile_close(trace_file);
+    trace_file = WASHDC_HOSTFILE_INVALID;
+
+    LOG_INFO("%llu trace events written\n", n_evts_written);
+}
+
+uint64_t trace_now(void) {
+    washdc_real_time now, delta;
+    washdc_get_real_time(&now);
+    washdc_real_time_diff(&delta, &now, &trace_start);
+    return washdc_real_time_to_seconds(&delta) * 1000000000.0;
+}
+
+void trace_span_finish(struct trace_span const *span, enum trace_track track,
+                       char const *name, dc_cycle_stamp_t cycle_end) {
+    uint64_t end_ns = trace_now();
+
+    washdc_mutex_lock(&trace_lock);
+
+    // another thread can still be finishing a span while trace_cleanup runs
+    if (!cur_chunk) {
+        washdc_mutex_unlock(&trace_lock);
+        return;
+    }
+
+    struct trace_evt *evt = cur_chunk->evts + cur_chunk->n_evts++;
+    evt->name = name;
+    evt->track = track;
+    evt->start_ns = span->start_ns;
+    evt->dur_ns = end_ns - span->start_ns;
+    evt->cycle_start = span->cycle;
+    evt->cycle_end = cycle_end;
+
+    if (cur_chunk->n_evts == TRACE_CHUNK_LEN) {
+        if (full_last)
+            full_last->next = cur_chunk;
+        else
+            full_first = cur_chunk;
+        full_last = cur_chunk;
+        cur_chunk = alloc_chunk();
+        washdc_cvar_signal(&trace_cvar);
+    }
+
+    washdc_mutex_unlock(&trace_lock);
+}
+
+static struct trace_chunk *alloc_chunk(void) {
+    struct trace_chunk *chunk =
+        (struct trace_chunk*)malloc(sizeof(struct trace_chunk));
+    if (!chunk)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    chunk->next = NULL;
+    chunk->n_evts = 0;
+    return chunk;
+}
+
+static void writer_main(void *argp) {
+    washdc_mutex_lock(&trace_lock);
+    for (;;) {
+        while (!full_first && !writer_quit)
+            washdc_cvar_wait(&trace_cvar, &trace_lock);
+        if (!full_first)
+            break;
+
+        struct trace_chunk *chunk = full_first;
+        full_first = chunk->next;
+        if (!full_first)
+            full_last = NULL;
+
+        // don't hold the lock while writing so the emulator doesn't stall
+        washdc_mutex_unlock(&trace_lock);
+        write_chunk(chunk);
+        free(chunk);
+        washdc_mutex_lock(&trace_lock);
+    }
+    washdc_mutex_unlock(&trace_lock);
+}
+
+static void write_preamble(void) {
+    washdc_hostfile_puts(trace_file, "{\"traceEvents\":[\n");
+    washdc_hostfile_printf(trace_file,
+                           "{\"name\":\"process_name\",\"ph\":\"M\","
+                           "\"pid\":%d,\"args\":{\"name\":\"host\"}},\n"
+                           "{\"name\":\"process_name\",\"ph\":\"M\","
+                           "\"pid\":%d,\"args\":{\"name\":\"guest\"}}",
+                           TRACE_PID_HOST, TRACE_PID_GUEST);
+
+    unsigned track;
+    for (track = 0; track < TRACE_TRACK_COUNT; track++) {
+        washdc_hostfile_printf(trace_file,
+                               ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                               "\"pid\":%d,\"tid\":%u,"
+                               "\"args\":{\"name\":\"%s\"}}",
+                               TRACE_PID_HOST, track, track_names[track]);
+        washdc_hostfile_printf(trace_file,
+                               ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                               "\"pid\":%d,\"tid\":%u,"
+                               "\"args\":{\"name\":\"%s\"}}",
+                               TRACE_PID_GUEST, track, track_names[track]);
+    }
+}
+
+// trace-event timestamps are in microseconds
+static double cycle_to_us(dc_cycle_stamp_t cycle) {
+    return cycle * (1000000.0 / (double)SCHED_FREQUENCY);
+}
+
+static void write_chunk(struct trace_chunk const *chunk) {
+    unsigned idx;
+    for (idx = 0; idx < chunk->n_evts; idx++) {
+        struct trace_evt const *evt = chunk->evts + idx;
+        n_evts_written++;
+
+        if (evt->cycle_start == TRACE_NO_CYCLE) {
+            washdc_hostfile_printf(trace_file,
+                                   ",\n{\"name\":\"%s\",\"ph\":\"X\","
+                                   "\"pid\":%d,\"tid\":%u,"
+                                   "\"ts\":%.3f,\"dur\":%.3f}",
+                                   evt->name, TRACE_PID_HOST,
+                                   (unsigned)evt->track,
+                                   evt->start_ns / 1000.0,
+                                   evt->dur_ns / 1000.0);
+            continue;
+        }
+
+        washdc_hostfile_printf(trace_file,
+                               ",\n{\"name\":\"%s\",\"ph\":\"X\","
+                               "\"pid\":%d,\"tid\":%u,"
+                               "\"ts\":%.3f,\"dur\":%.3f,"
+                               "\"args\":{\"cycle\":%llu}}",
+                               evt->name, TRACE_PID_HOST,
+                               (unsigned)evt->track,
+                               evt->start_ns / 1000.0, evt->dur_ns / 1000.0,
+                               (unsigned long long)evt->cycle_start);
+
+        if (evt->cycle_end > evt->cycle_start) {
+            washdc_hostfile_printf(trace_file,
+                                   ",\n{\"name\":\"%s\",\"ph\":\"X\","
+                                   "\"pid\":%d,\"tid\":%u,"
+                                   "\"ts\":%.3f,\"dur\":%.3f}",
+                                   evt->name, TRACE_PID_GUEST,
+                                   (unsigned)evt->track,
+                                   cycle_to_us(evt->cycle_start),
+                                   cycle_to_us(evt->cycle_end -
+                                               evt->cycle_start));
+        } else {
+            washdc_hostfile_printf(trace_file,
+                                   ",\n{\"name\":\"%s\",\"ph\":\"i\","
+                                   "\"s\":\"t\",\"pid\":%d,\"tid\":%u,"
+                                   "\"ts\":%.3f}",
+                                   evt->name, TRACE_PID_GUEST,
+                                   (unsigned)evt->track,
+                                   cycle_to_us(evt->cycle_start));
+        }
+    }
+}
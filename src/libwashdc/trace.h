@@ -0,0 +1,95 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dc_sched.h"
+
+/*
+ * timeline tracer.
+ *
+ * When config_get_trace_path is set, spans are collected from the scheduler,
+ * the main loop, the renderer and the GD-ROM worker and written to that file
+ * as Chrome trace-event JSON (which Perfetto and chrome://tracing can both
+ * open) by a background thread.  Every span is shown under the "host" process
+ * at the host time it ran; spans that have a guest cycle stamp are also
+ * shown under the "guest" process at the guest time they happened, so a slow
+ * frame on one timeline can be matched up with what the guest was doing on
+ * the other.
+ */
+
+enum trace_track {
+    TRACE_TRACK_SH4_SCHED,
+    TRACE_TRACK_ARM7_SCHED,
+    TRACE_TRACK_FRAME,
+    TRACE_TRACK_RENDER,
+    TRACE_TRACK_GDROM,
+
+    TRACE_TRACK_COUNT
+};
+
+// for spans that don't have a guest time, like the GD-ROM worker's
+#define TRACE_NO_CYCLE ((dc_cycle_stamp_t)-1)
+
+extern bool trace_enabled;
+
+struct trace_span {
+    uint64_t start_ns;
+    dc_cycle_stamp_t cycle;
+};
+
+void trace_init(void);
+void trace_cleanup(void);
+
+uint64_t trace_now(void);
+
+/*
+ * name has to stay valid until trace_cleanup since it gets written out on
+ * the writer thread; in practice that means it has to be a string literal.
+ */
+void trace_span_finish(struct trace_span const *span, enum trace_track track,
+                       char const *name, dc_cycle_stamp_t cycle_end);
+
+static inline void
+trace_begin(struct trace_span *span, dc_cycle_stamp_t cycle) {
+    if (trace_enabled) {
+        span->start_ns = trace_now();
+        span->cycle = cycle;
+    }
+}
+
+/*
+ * cycle_end is the guest time that the span ended at, which is the same as
+ * the cycle it started at for things that don't take any guest time.
+ */
+static inline void
+trace_end(struct trace_span const *span, enum trace_track track,
+          char const *name, dc_cycle_stamp_t cycle_end) {
+    if (trace_enabled)
+        trace_span_finish(span, track, name, cycle_end);
+}
+
+#endif
@@ -0,0 +1,244 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "memory.h"
+#include "hw/sh4/sh4.h"
+#include "threading.h"
+#include "log.h"
+
+#include "upload.h"
+
+#define UPLOAD_MAX_SEGS 32
+
+// a little-endian SH ELF32 executable
+#define ELF_HDR_LEN 52
+#define ELF_PHDR_LEN 32
+#define ELF_EM_SH 42
+#define ELF_PT_LOAD 1
+
+struct upload_seg {
+    uint32_t addr;
+    uint32_t offs;
+    uint32_t file_len;
+    uint32_t mem_len;
+};
+
+struct upload {
+    uint8_t *img;
+    size_t img_len;
+
+    uint32_t entry;
+
+    unsigned n_segs;
+    struct upload_seg segs[UPLOAD_MAX_SEGS];
+};
+
+static washdc_mutex lock = WASHDC_MUTEX_STATIC_INIT;
+static struct upload *pending;
+
+static uint32_t get_u16(uint8_t const *ptr) {
+    return ptr[0] | ((uint32_t)ptr[1] << 8);
+}
+
+static uint32_t get_u32(uint8_t const *ptr) {
+    return ptr[0] | ((uint32_t)ptr[1] << 8) |
+        ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+/*
+ * returns the offset into system memory that addr maps to, or -1 if
+ * [addr, addr + len) isn't entirely within one of system memory's mirrors.
+ */
+static long ram_offs(uint32_t addr, uint32_t len) {
+    uint32_t phys = addr & 0x1fffffff;
+    if (phys < 0x0c000000 || phys > 0x0fffffff)
+        return -1;
+
+    uint32_t offs = phys & MEMORY_MASK;
+    if ((uint64_t)offs + len > MEMORY_SIZE)
+        return -1;
+    return offs;
+}
+
+static bool is_elf(uint8_t const *dat, size_t len) {
+    return len >= 4 && dat[0] == 0x7f && dat[1] == 'E' &&
+        dat[2] == 'L' && dat[3] == 'F';
+}
+
+static int parse_elf(struct upload *up) {
+    uint8_t const *dat = up->img;
+    size_t len = up->img_len;
+
+    if (len < ELF_HDR_LEN) {
+        LOG_ERROR("%s - truncated ELF header\n", __func__);
+        return -1;
+    }
+
+    // ELFCLASS32, ELFDATA2LSB
+    if (dat[4] != 1 || dat[5] != 1 || get_u16(dat + 18) != ELF_EM_SH) {
+        LOG_ERROR("%s - not a little-endian 32-bit SH ELF\n", __func__);
+        return -1;
+    }
+
+    uint32_t phoff = get_u32(dat + 28);
+    unsigned phentsize = get_u16(dat + 42);
+    unsigned phnum = get_u16(dat + 44);
+
+    if (phentsize < ELF_PHDR_LEN ||
+        (uint64_t)phoff + (uint64_t)phentsize * phnum > len) {
+        LOG_ERROR("%s - bad program header table\n", __func__);
+        return -1;
+    }
+
+    up->entry = get_u32(dat + 24);
+    up->n_segs = 0;
+
+    unsigned ph_no;
+    for (ph_no = 0; ph_no < phnum; ph_no++) {
+        uint8_t const *ph = dat + phoff + ph_no * phentsize;
+        if (get_u32(ph) != ELF_PT_LOAD)
+            continue;
+
+        if (up->n_segs >= UPLOAD_MAX_SEGS) {
+            LOG_ERROR("%s - too many PT_LOAD segments\n", __func__);
+            return -1;
+        }
+
+        struct upload_seg *seg = up->segs + up->n_segs++;
+        seg->offs = get_u32(ph + 4);
+        seg->addr = get_u32(ph + 8);
+        seg->file_len = get_u32(ph + 16);
+        seg->mem_len = get_u32(ph + 20);
+
+        if ((uint64_t)seg->offs + seg->file_len > len ||
+            seg->file_len > seg->mem_len) {
+            LOG_ERROR("%s - bad PT_LOAD segment\n", __func__);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int upload_request(void const *dat, size_t len,
+                   uint32_t load_addr, uint32_t entry) {
+    struct upload *up = (struct upload*)calloc(1, sizeof(struct upload));
+    if (!up)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    up->img = (uint8_t*)malloc(len ? len : 1);
+    if (!up->img)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    memcpy(up->img, dat, len);
+    up->img_len = len;
+
+    if (is_elf(up->img, len)) {
+        if (parse_elf(up) != 0)
+            goto on_error;
+    } else {
+        up->entry = entry;
+        up->n_segs = 1;
+        up->segs[0].addr = load_addr;
+        up->segs[0].offs = 0;
+        up->segs[0].file_len = len;
+        up->segs[0].mem_len = len;
+    }
+
+    unsigned seg_no;
+    for (seg_no = 0; seg_no < up->n_segs; seg_no++) {
+        struct upload_seg const *seg = up->segs + seg_no;
+        if (seg->mem_len && ram_offs(seg->addr, seg->mem_len) < 0) {
+            LOG_ERROR("%s - segment at 0x%08x (%u bytes) is not within system "
+                      "memory\n", __func__, (unsigned)seg->addr,
+                      (unsigned)seg->mem_len);
+            goto on_error;
+        }
+    }
+
+    washdc_mutex_lock(&lock);
+    struct upload *old = pending;
+    pending = up;
+    washdc_mutex_unlock(&lock);
+
+    if (old) {
+        free(old->img);
+        free(old);
+    }
+
+    return 0;
+
+on_error:
+    free(up->img);
+    free(up);
+    return -1;
+}
+
+bool upload_run_pending(struct Memory *mem, struct Sh4 *sh4) {
+    static uint8_t const zeros[4096];
+
+    washdc_mutex_lock(&lock);
+    struct upload *up = pending;
+    pending = NULL;
+    washdc_mutex_unlock(&lock);
+
+    if (!up)
+        return false;
+
+    /*
+     * memory_write takes care of telling the code cache and the save-state
+     * dirty tracking about the new data.
+     */
+    unsigned seg_no;
+    for (seg_no = 0; seg_no < up->n_segs; seg_no++) {
+        struct upload_seg const *seg = up->segs + seg_no;
+        if (!seg->mem_len)
+            continue;
+
+        size_t offs = ram_offs(seg->addr, seg->mem_len);
+        if (seg->file_len)
+            memory_write(mem, up->img + seg->offs, offs, seg->file_len);
+
+        size_t bss_offs = offs + seg->file_len;
+        size_t bss_len = seg->mem_len - seg->file_len;
+        while (bss_len) {
+            size_t chunk = bss_len < sizeof(zeros) ? bss_len : sizeof(zeros);
+            memory_write(mem, zeros, bss_offs, chunk);
+            bss_offs += chunk;
+            bss_len -= chunk;
+        }
+    }
+
+    sh4->reg[SH4_REG_PC] = up->entry;
+    sh4->delayed_branch = false;
+
+    LOG_INFO("uploaded %u bytes (%u segment%s), jumping to 0x%08x\n",
+             (unsigned)up->img_len, up->n_segs, up->n_segs == 1 ? "" : "s",
+             (unsigned)up->entry);
+
+    free(up->img);
+    free(up);
+
+    return true;
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef UPLOAD_H_
+#define UPLOAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * fast program upload.
+ *
+ * This lets a frontend drop a homebrew program straight into system memory and
+ * jump to it without going through the GD-ROM or the serial port.  Requests
+ * can come from any thread; they get carried out on the emulation thread at
+ * the end of the current frame, the same way save-state requests do.
+ */
+
+struct Memory;
+struct Sh4;
+
+/*
+ * queue up a program.  If dat is an SH4 ELF executable then its PT_LOAD
+ * segments get loaded wherever the ELF says and load_addr/entry are ignored;
+ * otherwise dat is treated as a flat binary that gets loaded at load_addr with
+ * execution starting at entry.  dat is copied, so the caller can free it once
+ * this returns.
+ *
+ * returns 0 on success, or -1 if the program doesn't fit in system memory.  A
+ * new request replaces any request which hasn't been carried out yet.
+ */
+int upload_request(void const *dat, size_t len,
+                   uint32_t load_addr, uint32_t entry);
+
+/*
+ * carry out the pending upload, if there is one.  This should only be called
+ * from the emulation thread, between frames.  Returns true if a program was
+ * loaded.
+ */
+bool upload_run_pending(struct Memory *mem, struct Sh4 *sh4);
+
+#endif
@@ -22,12 +22,18 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "washdc/washdc.h"
 
 #include "config.h"
 #include "dreamcast.h"
 #include "screenshot.h"
+#include "savestate.h"
+#include "upload.h"
+#include "rewind.h"
+#include "rollback.h"
+#include "perf_cnt.h"
 #include "hw/maple/maple_controller.h"
 #include "hw/maple/maple_keyboard.h"
 #include "gfx/gfx.h"
@@ -35,8 +41,22 @@
 #include "title.h"
 #include "washdc/win.h"
 #include "hw/pvr2/pvr2.h"
+#include "hw/sh4/sh4_dmac.h"
+#include "hw/gdrom/gdrom.h"
 #include "log.h"
 
+#ifdef ENABLE_JIT_X86_64
+#include "jit/x86_64/exec_mem.h"
+#endif
+
+#ifdef ENABLE_JIT_AARCH64
+#include "jit/aarch64/exec_mem.h"
+#endif
+
+#ifdef DEEP_SYSCALL_TRACE
+#include "deep_syscall_trace.h"
+#endif
+
 static struct washdc_hostfile_api const *hostfile_api;
 
 static enum dc_boot_mode translate_boot_mode(enum washdc_boot_mode mode) {
@@ -55,14 +75,20 @@ struct washdc_gameconsole const*
 washdc_init(struct washdc_launch_settings const *settings) {
     config_set_log_stdout(settings->log_to_stdout);
     config_set_log_verbose(settings->log_verbose);
+    config_set_log_drop_on_overflow(settings->log_drop_on_overflow);
 #ifdef ENABLE_DEBUGGER
     config_set_dbg_enable(settings->dbg_enable);
     config_set_washdbg_enable(settings->washdbg_enable);
 #endif
     config_set_inline_mem(settings->inline_mem);
     config_set_jit(settings->enable_jit);
-#ifdef ENABLE_JIT_X86_64
+#ifdef ENABLE_JIT_NATIVE
     config_set_native_jit(settings->enable_native_jit);
+    config_set_jit_dual_map(settings->jit_dual_map);
+    config_set_jit_fastmem(settings->jit_fastmem);
+    config_set_jit_tiered(settings->jit_tiered);
+    config_set_jit_perf_map(settings->jit_perf_map);
+    config_set_jit_bg_compile(settings->jit_bg_compile);
 #endif
     config_set_boot_mode(translate_boot_mode(settings->boot_mode));
     config_set_ip_bin_path(settings->path_ip_bin);
@@ -73,8 +99,71 @@ washdc_init(struct washdc_launch_settings const *settings) {
     config_set_ser_srv_enable(settings->enable_serial);
     config_set_dc_path_rtc(settings->path_rtc);
     config_set_dump_mem_on_error(settings->dump_mem_on_error);
+    config_set_rend_thread(settings->rend_thread);
+    config_set_arm7_thread(settings->arm7_thread);
+    config_set_arm7_jit(settings->arm7_jit);
+    config_set_arm7_idle_skip(settings->arm7_idle_skip);
+    config_set_sh4_icache(settings->sh4_icache);
+    config_set_fpu_pedantic(settings->fpu_pedantic);
+    config_set_intp_predecode(settings->intp_predecode);
+    config_set_jit_superblocks(settings->jit_superblocks);
+    config_set_jit_idle_skip(settings->jit_idle_skip);
+    config_set_jit_stall_model(settings->jit_stall_model);
+    config_set_jit_persist_cache(settings->jit_persist_cache &&
+                                 settings->path_jit_cache);
+    config_set_jit_cache_path(settings->path_jit_cache);
+    config_set_jit_cache_budget(settings->jit_cache_budget);
+    config_set_gpu_palette(settings->gpu_palette);
+    config_set_persistent_verts(settings->persistent_verts);
+    config_set_packed_verts(settings->packed_verts);
+    config_set_merge_draws(settings->merge_draws);
+    config_set_mod_vols(settings->mod_vols);
+    config_set_poly_sort(settings->poly_sort);
+    config_set_list_cache(settings->list_cache);
+    config_set_list_exec_threads(settings->list_exec_threads);
+    config_set_fb_tex_alias(settings->fb_tex_alias);
+    config_set_async_readback(settings->async_readback);
+    config_set_gpu_fb_conv(settings->gpu_fb_conv);
+    config_set_present_mailbox(settings->present_mailbox);
+    config_set_savestate_fork(settings->savestate_fork);
+    config_set_rewind_interval(settings->rewind_interval);
+    config_set_rewind_budget(settings->rewind_budget);
+    config_set_rollback_frames(settings->rollback_frames);
+    config_set_replay_record_path(settings->path_replay_record);
+    config_set_replay_play_path(settings->path_replay_play);
+    config_set_bench_frames(settings->bench_frames);
+    config_set_alloc_audit_frames(settings->alloc_audit_frames);
+    config_set_trace_path(settings->path_trace);
+    config_set_guest_prof_path(settings->path_guest_prof);
+    config_set_guest_prof_syms(settings->path_guest_prof_syms);
+    config_set_guest_prof_interval(settings->guest_prof_interval_us);
+    config_set_hle_func_syms(settings->path_hle_func_syms);
+    config_set_turbo_frames(settings->turbo_frames);
+    config_set_frameskip_max(settings->frameskip_max);
+    config_set_frame_limit(settings->frame_limit);
+    config_set_timeslice_us(settings->timeslice_us);
+    config_set_timeslice_adaptive(settings->timeslice_adaptive);
+    config_set_screenshot_fmt(settings->screenshot_qoi ?
+                              SCREENSHOT_FMT_QOI : SCREENSHOT_FMT_PNG);
+    config_set_screenshot_png_level(settings->screenshot_png_level);
+    config_set_emu_cpus(settings->emu_cpus);
+    config_set_rend_cpus(settings->rend_cpus);
+    config_set_arm7_cpus(settings->arm7_cpus);
+    config_set_jit_cpus(settings->jit_cpus);
+    config_set_tex_dump_dir(settings->tex_dump_dir);
+    config_set_tex_pack_dir(settings->tex_pack_dir);
+
+    /*
+     * the ARM7 thread doesn't run in lockstep, so replays and rollback can't
+     * use it, and benchmark mode can only account for time on the emulation
+     * thread.
+     */
+    if (settings->path_replay_record || settings->path_replay_play ||
+        settings->bench_frames > 0 || settings->rollback_frames > 0)
+        config_set_arm7_thread(false);
 
     win_set_intf(settings->win_intf);
+    rollback_set_input_fn(settings->rollback_input);
 
     hostfile_api = settings->hostfile_api;
 
@@ -110,6 +199,83 @@ int washdc_save_screenshot_dir(void) {
     return save_screenshot_dir();
 }
 
+/*
+ * these wake up the emulation thread so that the request gets handled right
+ * away if it's paused at the end of a frame.
+ */
+void washdc_savestate_checkpoint(char const *path) {
+    savestate_request_checkpoint(path);
+    dc_wake();
+}
+
+void washdc_savestate_restore(char const *path, unsigned checkpoint_no) {
+    savestate_request_restore(path, checkpoint_no);
+    dc_wake();
+}
+
+int washdc_upload(void const *dat, size_t len,
+                  uint32_t load_addr, uint32_t entry) {
+    int ret = upload_request(dat, len, load_addr, entry);
+    dc_wake();
+    return ret;
+}
+
+void washdc_rewind(unsigned n_steps) {
+    rewind_request(n_steps);
+    dc_wake();
+}
+
+int washdc_rollback(unsigned frame_no) {
+    return rollback_request(frame_no);
+}
+
+unsigned washdc_perf_get(struct washdc_perf_probe *out, unsigned max) {
+#ifdef ENABLE_PERF_COUNTERS
+    unsigned probe;
+    for (probe = 0; probe < PERF_PROBE_COUNT && probe < max; probe++) {
+        out[probe].name = perf_cnt_name(probe);
+        out[probe].is_timer = perf_cnt_is_timer(probe);
+        perf_cnt_get(probe, &out[probe].count, &out[probe].seconds);
+    }
+    return PERF_PROBE_COUNT;
+#else
+    return 0;
+#endif
+}
+
+void washdc_perf_reset(void) {
+    perf_cnt_reset();
+}
+
+unsigned washdc_syscall_trace_dump(char *buf, size_t len, unsigned n_recs) {
+#ifdef DEEP_SYSCALL_TRACE
+    struct deep_syscall_rec recs[WASHDC_SYSCALL_TRACE_MAX];
+    if (n_recs > WASHDC_SYSCALL_TRACE_MAX)
+        n_recs = WASHDC_SYSCALL_TRACE_MAX;
+    n_recs = deep_syscall_trace_recent(recs, n_recs);
+
+    size_t pos = 0;
+    if (len)
+        buf[0] = '\0';
+    unsigned idx;
+    for (idx = 0; idx < n_recs && pos + 1 < len; idx++) {
+        int n_chars = deep_syscall_rec_format(buf + pos, len - pos, recs + idx);
+        if (n_chars < 0)
+            break;
+        pos += n_chars;
+        if (pos + 1 >= len)
+            break;
+        buf[pos++] = '\n';
+        buf[pos] = '\0';
+    }
+    return n_recs;
+#else
+    if (len)
+        buf[0] = '\0';
+    return 0;
+#endif
+}
+
 // mark all buttons in btns as being pressed
 void washdc_controller_press_btns(unsigned port_no, uint32_t btns) {
     dc_controller_press_buttons(port_no, btns);
@@ -164,6 +330,9 @@ void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat) {
         src.per_frame_counters.vert_count[PVR2_POLY_TYPE_TRANS_MOD];
     stat->vert_count[WASHDC_PVR2_POLY_GROUP_PUNCH_THROUGH] =
         src.per_frame_counters.vert_count[PVR2_POLY_TYPE_PUNCH_THROUGH];
+    stat->dup_rend_param_count = src.per_frame_counters.dup_rend_param_count;
+    stat->merged_draw_count = src.per_frame_counters.merged_draw_count;
+    stat->fb_tex_alias_count = src.per_frame_counters.fb_tex_alias_count;
 
     stat->tex_xmit_count = src.persistent_counters.tex_xmit_count;
     stat->tex_invalidate_count = src.persistent_counters.tex_invalidate_count;
@@ -175,6 +344,43 @@ void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat) {
         src.persistent_counters.fresh_texture_upload_count;
     stat->tex_eviction_count =
         src.persistent_counters.tex_eviction_count;
+    stat->tex_thrash_count = src.persistent_counters.tex_thrash_count;
+    stat->tex_cache_size = PVR2_TEX_CACHE_SIZE;
+    stat->tex_cache_hit_count = src.persistent_counters.tex_cache_hit_count;
+    stat->tex_cache_miss_count = src.persistent_counters.tex_cache_miss_count;
+    stat->list_cache_hit_count = src.persistent_counters.list_cache_hit_count;
+}
+
+void washdc_get_perf_stat(struct washdc_perf_stat *stat) {
+    memset(stat, 0, sizeof(*stat));
+
+    dc_get_code_cache_stat(&stat->code_cache_entries, &stat->jit_compiles);
+
+#ifdef ENABLE_JIT_NATIVE
+    if (config_get_native_jit()) {
+        struct exec_mem_stats mem_stats;
+        exec_mem_get_stats(&mem_stats);
+        stat->exec_mem_free_bytes = mem_stats.free_bytes;
+        stat->exec_mem_total_bytes = mem_stats.total_bytes;
+        stat->exec_mem_allocations = mem_stats.n_allocations;
+        stat->exec_mem_free_segs = mem_stats.n_free_segs;
+        stat->exec_mem_segs = mem_stats.n_segs;
+    }
+#endif
+
+    stat->ch2_dma_bytes = sh4_dmac_ch2_bytes();
+    stat->gdrom_dma_bytes = gdrom_dma_bytes();
+
+    struct dc_clock_ts_stat sh4_ts, arm7_ts;
+    double ns_per_cycle = 1000000000.0 / (double)SCHED_FREQUENCY;
+    dc_get_ts_stat(&sh4_ts, &arm7_ts);
+    stat->sh4_timeslices = sh4_ts.n_slices;
+    stat->sh4_ts_overrun_ns = sh4_ts.overrun_total * ns_per_cycle;
+    stat->sh4_ts_overrun_max_ns = sh4_ts.overrun_max * ns_per_cycle;
+    stat->arm7_timeslices = arm7_ts.n_slices;
+    stat->arm7_ts_overrun_ns = arm7_ts.overrun_total * ns_per_cycle;
+    stat->arm7_ts_overrun_max_ns = arm7_ts.overrun_max * ns_per_cycle;
+    stat->timeslice_ns = dc_get_timeslice_len() * ns_per_cycle;
 }
 
 void washdc_pause(void) {
@@ -201,6 +407,18 @@ void washdc_run_one_frame(void) {
     }
 }
 
+int washdc_run_frames(unsigned n_frames) {
+    return dc_run_frames(n_frames);
+}
+
+int washdc_run_on_emu_thread(void (*func)(void*), void *arg) {
+    return dc_run_on_emu_thread(func, arg);
+}
+
+int washdc_load_disc(char const *path) {
+    return dc_load_disc(path);
+}
+
 unsigned washdc_get_frame_count(void) {
     return dc_get_frame_count();
 }
@@ -235,6 +453,63 @@ int washdc_hostfile_flush(washdc_hostfile file) {
     return hostfile_api->flush(file);
 }
 
+bool washdc_hostfile_has_pread(void) {
+    return hostfile_api->pread != NULL;
+}
+
+size_t washdc_hostfile_pread(washdc_hostfile file, void *outp,
+                             size_t len, long offs) {
+    if (hostfile_api->pread)
+        return hostfile_api->pread(file, outp, len, offs);
+    if (hostfile_api->seek(file, offs, WASHDC_HOSTFILE_SEEK_BEG) != 0)
+        return 0;
+    return hostfile_api->read(file, outp, len);
+}
+
+size_t washdc_hostfile_preadv(washdc_hostfile file,
+                              struct washdc_hostfile_iov const *iov,
+                              unsigned n_iov, long offs) {
+    if (hostfile_api->preadv)
+        return hostfile_api->preadv(file, iov, n_iov, offs);
+
+    size_t total = 0;
+    unsigned idx;
+    for (idx = 0; idx < n_iov; idx++) {
+        size_t n_read =
+            washdc_hostfile_pread(file, iov[idx].outp, iov[idx].len,
+                                  offs + (long)total);
+        total += n_read;
+        if (n_read != iov[idx].len)
+            break;
+    }
+    return total;
+}
+
+void const *washdc_hostfile_map(washdc_hostfile file, size_t *len) {
+    if (hostfile_api->map && hostfile_api->unmap)
+        return hostfile_api->map(file, len);
+    return NULL;
+}
+
+void washdc_hostfile_unmap(washdc_hostfile file, void const *map, size_t len) {
+    hostfile_api->unmap(file, map, len);
+}
+
+int washdc_hostfile_aio_submit(washdc_hostfile file,
+                               struct washdc_hostfile_aio *aio) {
+    if (hostfile_api->aio_submit && hostfile_api->aio_wait)
+        return hostfile_api->aio_submit(file, aio);
+    aio->n_read = washdc_hostfile_pread(file, aio->outp, aio->len, aio->offs);
+    return 0;
+}
+
+size_t washdc_hostfile_aio_wait(washdc_hostfile file,
+                                struct washdc_hostfile_aio *aio) {
+    if (hostfile_api->aio_submit && hostfile_api->aio_wait)
+        return hostfile_api->aio_wait(file, aio);
+    return aio->n_read;
+}
+
 int washdc_hostfile_putc(washdc_hostfile file, char ch) {
     if (hostfile_api->write(file, &ch, sizeof(ch)) == sizeof(ch))
         return ch;
@@ -295,3 +570,11 @@ double washdc_get_fps(void) {
 double washdc_get_virt_fps(void) {
     return dc_get_virt_fps();
 }
+
+void washdc_set_frame_limit(bool enable) {
+    config_set_frame_limit(enable);
+}
+
+void washdc_gfx_run_sync(void (*func)(void)) {
+    gfx_run_sync(func);
+}
@@ -20,6 +20,8 @@
  *
  ******************************************************************************/
 
+#include <stddef.h>
+
 #include "washdc/win.h"
 
 static struct win_intf const *win_intf;
@@ -41,7 +43,12 @@ void win_check_events(void) {
 }
 
 void win_run_once_on_suspend(void) {
-    win_intf->run_once_on_suspend();
+    if (win_intf->run_once_on_suspend)
+        win_intf->run_once_on_suspend();
+}
+
+bool win_needs_polling(void) {
+    return win_intf->run_once_on_suspend != NULL;
 }
 
 void win_update(void) {
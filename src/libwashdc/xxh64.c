@@ -0,0 +1,124 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "xxh64.h"
+
+#define XXH_P1 0x9e3779b185ebca87ULL
+#define XXH_P2 0xc2b2ae3d27d4eb4fULL
+#define XXH_P3 0x165667b19e3779f9ULL
+#define XXH_P4 0x85ebca77c2b2ae63ULL
+#define XXH_P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t xxh_rotl(uint64_t val, unsigned n) {
+    return (val << n) | (val >> (64 - n));
+}
+
+// the hash is defined in terms of little-endian loads
+static inline uint64_t xxh_read64(uint8_t const *ptr) {
+    uint64_t val;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    val = 0;
+    unsigned idx;
+    for (idx = 0; idx < 8; idx++)
+        val |= (uint64_t)ptr[idx] << (8 * idx);
+#else
+    memcpy(&val, ptr, sizeof(val));
+#endif
+    return val;
+}
+
+static inline uint32_t xxh_read32(uint8_t const *ptr) {
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+        ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_P2;
+    acc = xxh_rotl(acc, 31);
+    return acc * XXH_P1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh_round(0, val);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+uint64_t washdc_xxh64(void const *dat, size_t len, uint64_t seed) {
+    uint8_t const *ptr = (uint8_t const*)dat;
+    uint8_t const *end = ptr + len;
+    uint64_t hash;
+
+    if (len >= 32) {
+        // four independent lanes, so this doesn't stall on the multiplies
+        uint64_t v1 = seed + XXH_P1 + XXH_P2;
+        uint64_t v2 = seed + XXH_P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_P1;
+        uint8_t const *limit = end - 32;
+
+        do {
+            v1 = xxh_round(v1, xxh_read64(ptr));
+            v2 = xxh_round(v2, xxh_read64(ptr + 8));
+            v3 = xxh_round(v3, xxh_read64(ptr + 16));
+            v4 = xxh_round(v4, xxh_read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        hash = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) +
+            xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+        hash = xxh_merge(hash, v1);
+        hash = xxh_merge(hash, v2);
+        hash = xxh_merge(hash, v3);
+        hash = xxh_merge(hash, v4);
+    } else {
+        hash = seed + XXH_P5;
+    }
+
+    hash += len;
+
+    while (end - ptr >= 8) {
+        hash ^= xxh_round(0, xxh_read64(ptr));
+        hash = xxh_rotl(hash, 27) * XXH_P1 + XXH_P4;
+        ptr += 8;
+    }
+
+    if (end - ptr >= 4) {
+        hash ^= (uint64_t)xxh_read32(ptr) * XXH_P1;
+        hash = xxh_rotl(hash, 23) * XXH_P2 + XXH_P3;
+        ptr += 4;
+    }
+
+    while (ptr < end) {
+        hash ^= *ptr++ * XXH_P5;
+        hash = xxh_rotl(hash, 11) * XXH_P1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_P2;
+    hash ^= hash >> 29;
+    hash *= XXH_P3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
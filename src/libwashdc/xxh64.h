@@ -2,7 +2,7 @@
  *
  *
  *    WashingtonDC Dreamcast Emulator
- *    Copyright (C) 2018, 2019 snickerbockers
+ *    Copyright (C) 2020 snickerbockers
  *
  *    This program is free software: you can redistribute it and/or modify
  *    it under the terms of the GNU General Public License as published by
@@ -20,14 +20,21 @@
  *
  ******************************************************************************/
 
-#ifndef JIT_H_
-#define JIT_H_
+#ifndef XXH64_H_
+#define XXH64_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
-#include "dc_sched.h"
-
-void jit_init(struct dc_clock *clk);
-void jit_cleanup(void);
+/*
+ * XXH64, from Yann Collet's xxHash.  This is a fast non-cryptographic hash for
+ * keying things by their contents; it's not suitable for anything where an
+ * adversary gets to pick the input.  Hashes are the same on every host, so
+ * they can be stored in files.
+ *
+ * To hash something that's in more than one piece, pass the hash of one piece
+ * as the seed for the next.
+ */
+uint64_t washdc_xxh64(void const *dat, size_t len, uint64_t seed);
 
 #endif
@@ -0,0 +1,216 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "batch.hpp"
+
+namespace {
+
+struct batch_job {
+    unsigned line_no;
+    std::vector<std::string> args;
+};
+
+}
+
+/*
+ * split a line into arguments on whitespace.  Double quotes can be used to
+ * keep whitespace inside an argument.
+ */
+static std::vector<std::string> split_args(std::string const& line) {
+    std::vector<std::string> args;
+    std::string cur;
+    bool in_arg = false, in_quote = false;
+
+    for (char ch : line) {
+        if (ch == '"') {
+            in_quote = !in_quote;
+            in_arg = true;
+        } else if (!in_quote && (ch == ' ' || ch == '\t' ||
+                                 ch == '\r' || ch == '\n')) {
+            if (in_arg)
+                args.push_back(cur);
+            cur.clear();
+            in_arg = false;
+        } else {
+            cur += ch;
+            in_arg = true;
+        }
+    }
+    if (in_arg)
+        args.push_back(cur);
+
+    return args;
+}
+
+static int load_jobs(char const *job_path, std::vector<batch_job> *jobs) {
+    std::ifstream job_file(job_path);
+    if (!job_file.is_open()) {
+        fprintf(stderr, "ERROR: unable to open %s\n", job_path);
+        return -1;
+    }
+
+    std::string line;
+    unsigned line_no = 0;
+    while (std::getline(job_file, line)) {
+        line_no++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        batch_job job;
+        job.line_no = line_no;
+        job.args = split_args(line);
+        jobs->push_back(job);
+    }
+
+    return 0;
+}
+
+#ifndef _WIN32
+
+unsigned batch_default_parallel(void) {
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return n_cpus > 0 ? n_cpus : 1;
+}
+
+static pid_t spawn_job(char const *exe_path, char const *job_path,
+                       batch_job const& job) {
+    std::stringstream log_path;
+    log_path << job_path << "." << job.line_no << ".log";
+
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(exe_path));
+    for (std::string const& arg : job.args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(NULL);
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "ERROR: fork failed: %s\n", strerror(errno));
+        return -1;
+    } else if (pid == 0) {
+        int fd = open(log_path.str().c_str(),
+                      O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "ERROR: unable to open %s\n",
+                    log_path.str().c_str());
+            _exit(1);
+        }
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+
+        execvp(exe_path, argv.data());
+        fprintf(stderr, "ERROR: unable to execute %s: %s\n",
+                exe_path, strerror(errno));
+        _exit(1);
+    }
+
+    printf("job %u: started (%s)\n", job.line_no, log_path.str().c_str());
+    return pid;
+}
+
+int run_batch(char const *exe_path, char const *job_path, unsigned n_parallel) {
+    std::vector<batch_job> jobs;
+    if (load_jobs(job_path, &jobs) != 0)
+        return 1;
+
+    if (!n_parallel)
+        n_parallel = 1;
+
+    std::map<pid_t, unsigned> running;
+    unsigned next_job = 0, n_failed = 0;
+
+    while (next_job < jobs.size() || !running.empty()) {
+        while (next_job < jobs.size() && running.size() < n_parallel) {
+            batch_job const& job = jobs[next_job++];
+            pid_t pid = spawn_job(exe_path, job_path, job);
+            if (pid < 0)
+                n_failed++;
+            else
+                running[pid] = job.line_no;
+        }
+
+        if (running.empty())
+            continue;
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "ERROR: waitpid failed: %s\n", strerror(errno));
+            return 1;
+        }
+
+        auto it = running.find(pid);
+        if (it == running.end())
+            continue;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            printf("job %u: success\n", it->second);
+        } else if (WIFEXITED(status)) {
+            printf("job %u: FAILED (exit code %d)\n",
+                   it->second, WEXITSTATUS(status));
+            n_failed++;
+        } else {
+            printf("job %u: FAILED (terminated by signal %d)\n",
+                   it->second, WIFSIGNALED(status) ? WTERMSIG(status) : -1);
+            n_failed++;
+        }
+        running.erase(it);
+    }
+
+    printf("%u of %u jobs failed\n", n_failed, (unsigned)jobs.size());
+    return n_failed ? 1 : 0;
+}
+
+#else
+
+unsigned batch_default_parallel(void) {
+    return 1;
+}
+
+int run_batch(char const *exe_path, char const *job_path, unsigned n_parallel) {
+    fprintf(stderr, "ERROR: batch mode is not supported on Windows\n");
+    return 1;
+}
+
+#endif
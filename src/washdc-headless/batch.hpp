@@ -0,0 +1,39 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+/*
+ * batch mode: every non-empty, non-comment line of job_path is a set of
+ * washdc-headless command-line arguments.  Each job is run as a separate
+ * washdc-headless process, with at most n_parallel of them running at once.
+ * Everything a job writes to stdout/stderr goes to <job_path>.<line_no>.log.
+ *
+ * returns the exit code to use: 0 if every job succeeded, 1 otherwise.
+ */
+int run_batch(char const *exe_path, char const *job_path, unsigned n_parallel);
+
+// default for n_parallel: the number of online host CPUs
+unsigned batch_default_parallel(void);
+
+#endif
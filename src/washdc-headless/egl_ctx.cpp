@@ -0,0 +1,186 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "egl_ctx.hpp"
+
+static EGLDisplay egl_disp = EGL_NO_DISPLAY;
+static EGLContext egl_ctx = EGL_NO_CONTEXT;
+static EGLSurface egl_surf = EGL_NO_SURFACE;
+
+static bool has_ext(char const *ext_list, char const *ext) {
+    size_t len = strlen(ext);
+    char const *pos = ext_list;
+    while (pos && (pos = strstr(pos, ext))) {
+        if ((pos == ext_list || pos[-1] == ' ') &&
+            (pos[len] == ' ' || pos[len] == '\0'))
+            return true;
+        pos += len;
+    }
+    return false;
+}
+
+/*
+ * prefer a display that's bound directly to a GPU since that works without
+ * X11 or wayland on both mesa and the proprietary drivers.  Mesa's
+ * surfaceless platform and the default display are fallbacks.
+ */
+static EGLDisplay open_display(void) {
+    char const *client_ext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (client_ext && get_platform_display &&
+        has_ext(client_ext, "EGL_EXT_platform_device")) {
+        PFNEGLQUERYDEVICESEXTPROC query_devices =
+            (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+        EGLDeviceEXT dev;
+        EGLint n_devs;
+        if (query_devices && query_devices(1, &dev, &n_devs) && n_devs > 0) {
+            EGLDisplay disp =
+                get_platform_display(EGL_PLATFORM_DEVICE_EXT, dev, NULL);
+            if (disp != EGL_NO_DISPLAY)
+                return disp;
+        }
+    }
+
+    if (client_ext && get_platform_display &&
+        has_ext(client_ext, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay disp =
+            get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, NULL);
+        if (disp != EGL_NO_DISPLAY)
+            return disp;
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+int egl_ctx_init(void) {
+    EGLint major, minor;
+
+    if ((egl_disp = open_display()) == EGL_NO_DISPLAY) {
+        fprintf(stderr, "%s - unable to open an EGL display\n", __func__);
+        return -1;
+    }
+
+    if (!eglInitialize(egl_disp, &major, &minor)) {
+        fprintf(stderr, "%s - eglInitialize failed (0x%04x)\n",
+                __func__, (unsigned)eglGetError());
+        egl_disp = EGL_NO_DISPLAY;
+        return -1;
+    }
+
+    printf("EGL %d.%d (%s)\n", (int)major, (int)minor,
+           eglQueryString(egl_disp, EGL_VENDOR));
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "%s - EGL implementation does not support desktop "
+                "OpenGL\n", __func__);
+        goto on_error;
+    }
+
+    {
+        static EGLint const cfg_attrs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+        static EGLint const ctx_attrs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 5,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        static EGLint const pbuf_attrs[] = {
+            EGL_WIDTH, 16,
+            EGL_HEIGHT, 16,
+            EGL_NONE
+        };
+
+        EGLConfig cfg;
+        EGLint n_cfg;
+        if (!eglChooseConfig(egl_disp, cfg_attrs, &cfg, 1, &n_cfg) ||
+            n_cfg < 1) {
+            fprintf(stderr, "%s - no suitable EGL config\n", __func__);
+            goto on_error;
+        }
+
+        egl_ctx = eglCreateContext(egl_disp, cfg, EGL_NO_CONTEXT, ctx_attrs);
+        if (egl_ctx == EGL_NO_CONTEXT) {
+            fprintf(stderr, "%s - unable to create an OpenGL 4.5 context "
+                    "(0x%04x)\n", __func__, (unsigned)eglGetError());
+            goto on_error;
+        }
+
+        char const *disp_ext = eglQueryString(egl_disp, EGL_EXTENSIONS);
+        if (!disp_ext || !has_ext(disp_ext, "EGL_KHR_surfaceless_context")) {
+            egl_surf = eglCreatePbufferSurface(egl_disp, cfg, pbuf_attrs);
+            if (egl_surf == EGL_NO_SURFACE) {
+                fprintf(stderr, "%s - unable to create a pbuffer surface\n",
+                        __func__);
+                goto on_error;
+            }
+        }
+    }
+
+    return 0;
+
+on_error:
+    egl_ctx_cleanup();
+    return -1;
+}
+
+void egl_ctx_cleanup(void) {
+    if (egl_disp == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(egl_disp, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (egl_surf != EGL_NO_SURFACE)
+        eglDestroySurface(egl_disp, egl_surf);
+    if (egl_ctx != EGL_NO_CONTEXT)
+        eglDestroyContext(egl_disp, egl_ctx);
+    eglTerminate(egl_disp);
+
+    egl_surf = EGL_NO_SURFACE;
+    egl_ctx = EGL_NO_CONTEXT;
+    egl_disp = EGL_NO_DISPLAY;
+}
+
+void egl_ctx_make_current(void) {
+    if (!eglMakeCurrent(egl_disp, egl_surf, egl_surf, egl_ctx)) {
+        fprintf(stderr, "%s - eglMakeCurrent failed (0x%04x)\n",
+                __func__, (unsigned)eglGetError());
+    }
+}
@@ -2,7 +2,7 @@
  *
  *
  *    WashingtonDC Dreamcast Emulator
- *    Copyright (C) 2018 snickerbockers
+ *    Copyright (C) 2020 snickerbockers
  *
  *    This program is free software: you can redistribute it and/or modify
  *    it under the terms of the GNU General Public License as published by
@@ -20,14 +20,21 @@
  *
  ******************************************************************************/
 
-#include "code_cache.h"
+#ifndef EGL_CTX_HPP_
+#define EGL_CTX_HPP_
 
-#include "jit.h"
+/*
+ * offscreen OpenGL 4.5 context for running gfxgl4 without a display.  The
+ * context is created without a window surface (or with a tiny pbuffer if the
+ * driver can't do surfaceless contexts), so everything gfxgl4 draws goes into
+ * its own render targets and gets read back through the usual gfx_obj reads.
+ */
 
-void jit_init(struct dc_clock *clk) {
-    code_cache_init();
-}
+// returns 0 on success, or -1 if no usable context could be created
+int egl_ctx_init(void);
+void egl_ctx_cleanup(void);
 
-void jit_cleanup(void) {
-    code_cache_cleanup();
-}
+// binds the context to the calling thread
+void egl_ctx_make_current(void);
+
+#endif
@@ -80,6 +80,7 @@ static void null_render_init(void) {
 }
 
 static void null_render_cleanup(void) {
+    gfx_obj_pool_drain();
 }
 
 static void null_render_bind_tex(struct gfx_il_inst *cmd) {
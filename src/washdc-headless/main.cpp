@@ -31,10 +31,19 @@
 #include "washdc_getopt.h"
 
 #include "console_config.hpp"
+#include "batch.hpp"
 #include "gfx_null.hpp"
 
+#ifdef ENABLE_HEADLESS_EGL
+#include "egl_ctx.hpp"
+#include "gfxgl4/gfxgl4_renderer.h"
+#include "stream.h"
+#endif
+
 #ifdef USE_LIBEVENT
 #include "frontend_io/io_thread.hpp"
+#include "frontend_io/upload_server.hpp"
+#include "frontend_io/ctl_server.hpp"
 #endif
 
 #ifdef ENABLE_DEBUGGER
@@ -55,6 +64,10 @@ static void null_sound_submit_samples(washdc_sample_type *samples, unsigned coun
 
 static void print_usage(char const *cmd);
 
+#if defined(ENABLE_HEADLESS_EGL) && defined(USE_LIBEVENT)
+static void gl4_metrics(std::ostream &os);
+#endif
+
 static void
 wizard(path_string console_name, path_string dc_bios_path,
        path_string dc_flash_path);
@@ -67,7 +80,6 @@ struct washdc_gameconsole const *console;
 
 static void null_win_init(unsigned width, unsigned height);
 static void null_win_check_events(void);
-static void null_win_run_once_on_suspend(void);
 static void null_win_update(void);
 static void null_win_make_context_current(void);
 static int null_win_get_width(void);
@@ -91,17 +103,34 @@ int main(int argc, char **argv) {
     bool enable_jit = false, enable_native_jit = false,
         enable_interpreter = false, inline_mem = true;
     bool log_stdout = false, log_verbose = false;
+    bool frame_limit = false;
+    int timeslice_us = 0;
+    bool timeslice_adaptive = false;
+    bool fpu_pedantic = false;
     struct washdc_launch_settings settings = { };
     char const *console_name = NULL;
     bool launch_wizard = false;
     char const *dc_bios_path = NULL, *dc_flash_path = NULL;
     bool write_to_flash_mem = false;
+    char const *path_replay_record = NULL, *path_replay_play = NULL;
+    char const *path_trace = NULL;
+    char const *path_guest_prof = NULL, *path_guest_prof_syms = NULL;
+    char const *path_hle_func_syms = NULL;
+    int turbo_frames = 0;
+    int bench_frames = 0;
+    int alloc_audit_frames = 0;
+    char const *batch_path = NULL;
+    int batch_parallel = 0;
+    char const *gfx_backend = "null";
+    char const *emu_cpus = NULL, *io_cpus = NULL;
+    int ctl_port = 0;
+    char const *stream_dest = NULL;
 
     create_cfg_dir();
     create_data_dir();
     create_screenshot_dir();
 
-    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:htjxpnlv")) != -1) {
+    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:r:R:P:B:M:T:G:O:H:F:J:N:C:I:S:K:Y:htUjxpnlvLAE")) != -1) {
         switch (opt) {
         case 'g':
             enable_debugger = true;
@@ -124,6 +153,18 @@ int main(int argc, char **argv) {
         case 't':
             enable_serial = true;
             break;
+#ifdef USE_LIBEVENT
+        case 'U':
+            upload_server_enable();
+            break;
+        case 'K':
+            ctl_port = atoi(washdc_optarg);
+            if (ctl_port <= 0 || ctl_port > 65535) {
+                fprintf(stderr, "ERROR: -K needs a TCP port number\n");
+                exit(1);
+            }
+            break;
+#endif
         case 'm':
             path_gdi = washdc_optarg;
             break;
@@ -148,6 +189,22 @@ int main(int argc, char **argv) {
         case 'v':
             log_verbose = true;
             break;
+        case 'L':
+            frame_limit = true;
+            break;
+        case 'S':
+            timeslice_us = atoi(washdc_optarg);
+            if (timeslice_us <= 0) {
+                fprintf(stderr, "ERROR: -S needs a number of microseconds\n");
+                exit(1);
+            }
+            break;
+        case 'A':
+            timeslice_adaptive = true;
+            break;
+        case 'E':
+            fpu_pedantic = true;
+            break;
         case 'c':
             console_name = washdc_optarg;
             break;
@@ -160,12 +217,79 @@ int main(int argc, char **argv) {
         case 'w':
             launch_wizard = true;
             break;
+        case 'R':
+            path_replay_record = washdc_optarg;
+            break;
+        case 'P':
+            path_replay_play = washdc_optarg;
+            break;
+        case 'T':
+            path_trace = washdc_optarg;
+            break;
+        case 'G':
+            path_guest_prof = washdc_optarg;
+            break;
+        case 'O':
+            path_guest_prof_syms = washdc_optarg;
+            break;
+        case 'H':
+            path_hle_func_syms = washdc_optarg;
+            break;
+        case 'F':
+            turbo_frames = atoi(washdc_optarg);
+            if (turbo_frames <= 0) {
+                fprintf(stderr, "ERROR: -F needs a number of frames\n");
+                exit(1);
+            }
+            break;
+        case 'B':
+            bench_frames = atoi(washdc_optarg);
+            if (bench_frames <= 0) {
+                fprintf(stderr, "ERROR: -B needs a number of frames\n");
+                exit(1);
+            }
+            break;
+        case 'M':
+            alloc_audit_frames = atoi(washdc_optarg);
+            if (alloc_audit_frames <= 0) {
+                fprintf(stderr, "ERROR: -M needs a number of frames\n");
+                exit(1);
+            }
+            break;
+        case 'J':
+            batch_path = washdc_optarg;
+            break;
+        case 'r':
+            gfx_backend = washdc_optarg;
+            break;
+        case 'C':
+            emu_cpus = washdc_optarg;
+            break;
+        case 'I':
+            io_cpus = washdc_optarg;
+            break;
+        case 'Y':
+            stream_dest = washdc_optarg;
+            break;
+        case 'N':
+            batch_parallel = atoi(washdc_optarg);
+            if (batch_parallel <= 0) {
+                fprintf(stderr, "ERROR: -N needs a number of instances\n");
+                exit(1);
+            }
+            break;
         default:
             print_usage(cmd);
             exit(0);
         }
     }
 
+    if (batch_path) {
+        unsigned n_parallel = batch_parallel ?
+            batch_parallel : batch_default_parallel();
+        exit(run_batch(cmd, batch_path, n_parallel));
+    }
+
     bool have_console_name = console_name;
 
     if (!dc_flash_path) {
@@ -191,6 +315,20 @@ int main(int argc, char **argv) {
     settings.log_to_stdout = log_stdout;
     settings.log_verbose = log_verbose;
     settings.write_to_flash = write_to_flash_mem;
+    settings.path_replay_record = path_replay_record;
+    settings.path_replay_play = path_replay_play;
+    settings.bench_frames = bench_frames;
+    settings.alloc_audit_frames = alloc_audit_frames;
+    settings.path_trace = path_trace;
+    settings.path_guest_prof = path_guest_prof;
+    settings.path_guest_prof_syms = path_guest_prof_syms;
+    settings.path_hle_func_syms = path_hle_func_syms;
+    settings.turbo_frames = turbo_frames;
+    settings.frame_limit = frame_limit;
+    settings.timeslice_us = timeslice_us;
+    settings.timeslice_adaptive = timeslice_adaptive;
+    settings.fpu_pedantic = fpu_pedantic;
+    settings.emu_cpus = emu_cpus;
 
     hostfile_api.open = file_stdio_open;
     hostfile_api.close = file_stdio_close;
@@ -201,6 +339,12 @@ int main(int argc, char **argv) {
     hostfile_api.flush = file_stdio_flush;
     hostfile_api.open_cfg_file = open_cfg_file;
     hostfile_api.open_screenshot = open_screenshot;
+#ifndef _WIN32
+    hostfile_api.pread = file_stdio_pread;
+    hostfile_api.preadv = file_stdio_preadv;
+    hostfile_api.map = file_stdio_map;
+    hostfile_api.unmap = file_stdio_unmap;
+#endif
 #ifdef _WIN32
     hostfile_api.pathsep = '\\';
 #else
@@ -215,13 +359,15 @@ int main(int argc, char **argv) {
     }
 
     if (enable_debugger || enable_washdbg) {
-        if (enable_jit || enable_native_jit) {
-            fprintf(stderr, "Debugger enabled - this overrides the jit "
-                    "compiler and sets WashingtonDC to interpreter mode\n");
-            enable_jit = false;
+        if (enable_native_jit) {
+            fprintf(stderr, "Debugger enabled - this overrides the native "
+                    "jit backend and sets WashingtonDC to jit-interpreter "
+                    "mode\n");
             enable_native_jit = false;
+            enable_jit = true;
         }
-        enable_interpreter = true;
+        if (!enable_jit)
+            enable_interpreter = true;
 
         if (washdc_have_debugger()) {
             settings.dbg_enable = true;
@@ -251,8 +397,8 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    if (washdc_have_x86_64_jit()) {
-        // enable the jit (with x86_64 backend) by default
+    if (washdc_have_native_jit()) {
+        // enable the jit (with the native backend) by default
         if (!(enable_jit || enable_native_jit || enable_interpreter))
             enable_native_jit = true;
     } else {
@@ -264,25 +410,20 @@ int main(int argc, char **argv) {
     settings.inline_mem = inline_mem;
     settings.enable_jit = enable_jit || enable_native_jit;
 
-    if (washdc_have_x86_64_jit()) {
+    if (washdc_have_native_jit()) {
         settings.enable_native_jit = enable_native_jit;
     } else {
         if (enable_native_jit) {
-            fprintf(stderr, "ERROR: the native x86_64 jit backend was not enabled "
+            fprintf(stderr, "ERROR: the native jit backend was not enabled "
                     "for this build configuration.\n"
-                    "Rebuild WashingtonDC with -DENABLE_JIT_X86_64=On to enable "
-                    "the native x86_64 jit backend.\n");
+                    "Rebuild WashingtonDC with -DENABLE_JIT_X86_64=On or "
+                    "-DENABLE_JIT_AARCH64=On to enable the native jit "
+                    "backend.\n");
             exit(1);
         }
     }
 
     if (skip_ip_bin) {
-        if (!path_syscalls_bin) {
-            fprintf(stderr, "Error: cannot direct-boot without a system call "
-                    "table (-s flag).\n");
-            exit(1);
-        }
-
         if (!path_1st_read_bin) {
             fprintf(stderr, "Error: cannot direct-boot without a "
                     "1ST-READ.BIN\n");
@@ -294,12 +435,6 @@ int main(int argc, char **argv) {
         settings.path_1st_read_bin = path_1st_read_bin;
         settings.path_syscalls_bin = path_syscalls_bin;
     } else if (boot_direct) {
-        if (!path_syscalls_bin) {
-            fprintf(stderr, "Error: cannot direct-boot without a system call "
-                    "table (-s flag).\n");
-            exit(1);
-        }
-
         settings.boot_mode = WASHDC_BOOT_IP_BIN;
         settings.path_ip_bin = path_ip_bin;
         settings.path_syscalls_bin = path_syscalls_bin;
@@ -321,7 +456,8 @@ int main(int argc, char **argv) {
     settings.path_gdi = path_gdi;
 
     null_win_intf.check_events = null_win_check_events;
-    null_win_intf.run_once_on_suspend = null_win_run_once_on_suspend;
+    // nothing to service while suspended, so don't poll
+    null_win_intf.run_once_on_suspend = NULL;
     null_win_intf.update = null_win_update;
     null_win_intf.make_context_current = null_win_make_context_current;
     null_win_intf.update_title = null_win_update_title;
@@ -340,16 +476,54 @@ int main(int argc, char **argv) {
 
     settings.sndsrv = &snd_intf;
 
-    settings.gfx_rend_if = null_rend_if_get();
+    if (strcmp(gfx_backend, "null") == 0) {
+        settings.gfx_rend_if = null_rend_if_get();
+#ifdef ENABLE_HEADLESS_EGL
+    } else if (strcmp(gfx_backend, "gl4") == 0) {
+        if (egl_ctx_init() != 0) {
+            fprintf(stderr, "ERROR: unable to create an offscreen OpenGL 4.5 "
+                    "context\n");
+            exit(1);
+        }
+        null_win_intf.make_context_current = egl_ctx_make_current;
+        settings.gfx_rend_if = gfxgl4_renderer.rend_if;
+        if (stream_dest && stream_start(stream_dest) != 0)
+            exit(1);
+#ifdef USE_LIBEVENT
+        ctl_server_set_metrics_fn(gl4_metrics);
+#endif
+#endif
+    } else {
+        fprintf(stderr, "ERROR: unknown rendering backend \"%s\"\n",
+                gfx_backend);
+        exit(1);
+    }
+
+    if (stream_dest && strcmp(gfx_backend, "gl4") != 0) {
+        fprintf(stderr, "ERROR: streaming needs the gl4 rendering backend\n");
+        exit(1);
+    }
 
 #ifdef USE_LIBEVENT
-    io::init();
+    if (ctl_port) {
+        path_string boot_state = path_append(data_dir(), "service_" +
+                                             std::to_string(ctl_port) +
+                                             ".state");
+        ctl_server_enable(ctl_port, boot_state.c_str());
+    }
+
+    io::init(io_cpus);
 #endif
 
     null_win_init(640, 480); // made up fictional resolution
 
     console = washdc_init(&settings);
 
+#ifdef USE_LIBEVENT
+    if (ctl_port)
+        ctl_server_boot();
+#endif
+
     washdc_run();
 
 #ifdef USE_LIBEVENT
@@ -359,11 +533,35 @@ int main(int argc, char **argv) {
 
     washdc_cleanup();
 
+#ifdef ENABLE_HEADLESS_EGL
+    stream_stop();
+    egl_ctx_cleanup();
+#endif
+
     exit(0);
 
     return 0;
 }
 
+#if defined(ENABLE_HEADLESS_EGL) && defined(USE_LIBEVENT)
+// adds the renderer's GPU timings to the control server's metrics
+static void gl4_metrics(std::ostream &os) {
+    struct renderer_stat stat;
+    gfxgl4_renderer.get_stat(&stat);
+    if (!stat.gpu_ms_valid)
+        return;
+
+    os << ",\"gpu_ms\":{";
+    unsigned phase;
+    for (phase = 0; phase < RENDERER_GPU_PHASE_COUNT; phase++) {
+        os << (phase ? "," : "") << "\"" <<
+            renderer_gpu_phase_name((enum renderer_gpu_phase)phase) <<
+            "\":" << stat.gpu_ms[phase];
+    }
+    os << "}";
+}
+#endif
+
 static void print_usage(char const *cmd) {
     fprintf(stderr, "USAGE: %s [options] [-d IP.BIN] [-u 1ST_READ.BIN]\n\n", cmd);
 
@@ -377,9 +575,12 @@ static void print_usage(char const *cmd) {
             "\t-g washdbg\tenable remote WashDbg backend\n"
             "\t-d\t\tenable direct boot (skip BIOS)\n"
             "\t-u\t\tskip IP.BIN and boot straight to 1ST_READ.BIN\n"
-            "\t-s\t\tpath to dreamcast system call image (only needed for "
-            "direct boot)\n"
+            "\t-s\t\tpath to dreamcast system call image (direct boot "
+            "only; system calls are emulated if omitted)\n"
             "\t-t\t\testablish serial server over TCP port 1998\n"
+            "\t-U\t\taccept program uploads over TCP port 1997\n"
+            "\t-K <port>\tservice mode: pause after the first frame and "
+            "take commands\n\t\t\tover the given TCP port\n"
             "\t-h\t\tdisplay this message and exit\n"
             "\t-l\t\tdump logs to stdout\n"
             "\t-m\t\tmount the given image in the GD-ROM drive\n"
@@ -387,8 +588,44 @@ static void print_usage(char const *cmd) {
             "\t-p\t\tdisable the dynarec and enable the interpreter instead\n"
             "\t-j\t\tenable dynamic recompiler (as opposed to interpreter)\n"
             "\t-v\t\tenable verbose logging\n"
-            "\t-x\t\tenable native x86_64 dynamic recompiler backend "
-            "(default)\n");
+            "\t-L\t\tdon't run faster than real hardware\n"
+            "\t-S <us>\tlength of SH4/ARM7 timeslices in microseconds\n"
+            "\t-A\t\tadapt the timeslice length to SH4/ARM7 traffic\n"
+            "\t-E\t\tcheck SH4 FPU opcodes for denormals and invalid "
+            "operations\n"
+            "\t-x\t\tenable native (x86_64 or AArch64) dynamic recompiler backend "
+            "(default)\n"
+            "\t-R <path>\trecord controller input to a replay file\n"
+            "\t-P <path>\tplay back a replay file\n"
+            "\t-B <frames>\trun for the given number of frames, then print "
+            "a JSON\n\t\t\tbenchmark report and exit\n"
+            "\t-M <frames>\tafter the given number of frames, count and log "
+            "heap\n\t\t\tallocations on the emulation thread\n"
+            "\t-T <path>\twrite a Chrome trace-event timeline to path\n"
+            "\t-G <path>\tsample the guest's call stacks and write them to "
+            "path as folded stacks\n"
+            "\t-O <elf>\tget function names for -G from elf's symbol table\n"
+            "\t-H <elf>\treplace library routines that match the ones in elf "
+            "with\n\t\t\thost implementations (jit only)\n"
+            "\t-F <frames>\tfast-forward: only draw one out of every <frames> "
+            "frames\n\t\t\tand mute the sound\n"
+            "\t-J <path>\tbatch mode: run each line of path as a separate "
+            "set of\n\t\t\twashdc-headless arguments\n"
+            "\t-N <count>\tmaximum number of batch jobs to run at once "
+            "(default is\n\t\t\tthe number of CPUs)\n"
+            "\t-C <cpus>\tpin the emulation thread to a list of CPUs like "
+            "0,2-3\n"
+            "\t-I <cpus>\tpin the io thread to a list of CPUs\n"
+#ifdef ENABLE_HEADLESS_EGL
+            "\t-Y <host:port>\tstream video and audio over UDP and take "
+            "controller\n\t\t\tinput back from the same address (gl4 "
+            "only)\n"
+#endif
+            "\t-r <backend>\trendering backend: null (default)"
+#ifdef ENABLE_HEADLESS_EGL
+            ", or gl4 to render\n\t\t\toffscreen with OpenGL 4.5 over EGL"
+#endif
+            "\n");
 }
 
 static void null_sound_init(void) {
@@ -398,6 +635,9 @@ static void null_sound_cleanup(void) {
 }
 
 static void null_sound_submit_samples(washdc_sample_type *samples, unsigned count) {
+#ifdef ENABLE_HEADLESS_EGL
+    stream_submit_audio(samples, count);
+#endif
 }
 
 static void wizard(path_string console_name, path_string dc_bios_path,
@@ -482,9 +722,6 @@ static void null_win_init(unsigned width, unsigned height) {
 static void null_win_check_events(void) {
 }
 
-static void null_win_run_once_on_suspend(void) {
-}
-
 static void null_win_update(void) {
 }
 
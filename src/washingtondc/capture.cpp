@@ -0,0 +1,398 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+
+#include "capture.h"
+
+/*
+ * the dreamcast's native 59.94Hz.  PAL games will play back a little fast,
+ * but it's the audio that the video gets lined up against so they stay in
+ * sync.
+ */
+#define CAPTURE_FPS_NUM 60000
+#define CAPTURE_FPS_DEN 1001
+#define CAPTURE_SAMPLE_RATE 44100
+
+// frames queued beyond this get dropped instead of blocking the emulator
+#define CAPTURE_MAX_QUEUED_FRAMES 8
+
+// audio is batched up into packets of about this many samples
+#define CAPTURE_AUDIO_BATCH 2048
+
+// about a minute and a half of backed-up audio
+#define CAPTURE_MAX_QUEUED_SAMPLES (1 << 22)
+
+namespace {
+
+enum packet_tp {
+    PACKET_VIDEO,
+    PACKET_AUDIO
+};
+
+struct packet {
+    enum packet_tp tp;
+    unsigned width, height;
+    bool bottom_up;
+    std::vector<uint8_t> pix;
+    std::vector<int16_t> samples;
+};
+
+}
+
+static std::string cap_dir;
+static std::atomic<bool> active;
+
+static std::thread encoder;
+static std::mutex queue_lock;
+static std::condition_variable queue_cond;
+static std::deque<packet> queue;
+static bool stop_req;
+static unsigned n_frames_queued, n_samples_queued;
+
+// pixel buffers that the encoder is done with, so they can be reused
+static std::vector<std::vector<uint8_t> > spare_frames;
+
+// only accessed on the emulation thread
+static std::vector<int16_t> audio_batch;
+static unsigned n_frames_dropped;
+
+// only accessed on the encoder thread
+static FILE *vid_file, *aud_file;
+static unsigned vid_width, vid_height;
+static std::vector<uint8_t> yuv;
+static uint64_t frames_written, samples_written;
+
+static void encoder_main(void);
+static void flush_audio(void);
+static void push_packet(packet &&pkt);
+
+static void write_wav_header(FILE *fp, uint32_t n_samples);
+static void write_video(packet const &pkt);
+static void write_audio(packet const &pkt);
+static void convert_frame(packet const &pkt);
+
+void capture_set_dir(char const *dir) {
+    cap_dir = dir;
+}
+
+int capture_start(void) {
+    if (active.load())
+        return 0;
+
+    char stamp[64];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "capture_%Y%m%d_%H%M%S", localtime(&now));
+
+    std::string base = cap_dir.empty() ? std::string(stamp) :
+        cap_dir + "/" + stamp;
+    std::string vid_path = base + ".y4m";
+    std::string aud_path = base + ".wav";
+
+    if (!(vid_file = fopen(vid_path.c_str(), "wb"))) {
+        fprintf(stderr, "%s - unable to open %s\n", __func__, vid_path.c_str());
+        return -1;
+    }
+    if (!(aud_file = fopen(aud_path.c_str(), "wb"))) {
+        fprintf(stderr, "%s - unable to open %s\n", __func__, aud_path.c_str());
+        fclose(vid_file);
+        vid_file = NULL;
+        return -1;
+    }
+
+    // sizes get filled in when the capture stops
+    write_wav_header(aud_file, 0);
+
+    vid_width = vid_height = 0;
+    frames_written = samples_written = 0;
+    n_frames_dropped = 0;
+    n_frames_queued = n_samples_queued = 0;
+    audio_batch.clear();
+    stop_req = false;
+
+    encoder = std::thread(encoder_main);
+    active.store(true);
+
+    printf("recording to %s.{y4m,wav}\n", base.c_str());
+    return 0;
+}
+
+void capture_stop(void) {
+    if (!active.load())
+        return;
+    active.store(false);
+
+    flush_audio();
+    {
+        std::lock_guard<std::mutex> lck(queue_lock);
+        stop_req = true;
+    }
+    queue_cond.notify_one();
+    encoder.join();
+
+    fseek(aud_file, 0, SEEK_SET);
+    write_wav_header(aud_file, samples_written);
+    fclose(aud_file);
+    fclose(vid_file);
+    aud_file = vid_file = NULL;
+
+    spare_frames.clear();
+    yuv.clear();
+
+    printf("recording stopped: %llu frames (%u dropped in the queue)\n",
+           (unsigned long long)frames_written, n_frames_dropped);
+}
+
+void capture_cleanup(void) {
+    capture_stop();
+}
+
+bool capture_active(void) {
+    return active.load(std::memory_order_relaxed);
+}
+
+void capture_submit_video(void const *rgba, unsigned width, unsigned height,
+                          bool bottom_up) {
+    if (!active.load(std::memory_order_relaxed))
+        return;
+
+    flush_audio();
+
+    packet pkt;
+    pkt.tp = PACKET_VIDEO;
+    pkt.width = width;
+    pkt.height = height;
+    pkt.bottom_up = bottom_up;
+
+    {
+        std::lock_guard<std::mutex> lck(queue_lock);
+        if (n_frames_queued >= CAPTURE_MAX_QUEUED_FRAMES) {
+            n_frames_dropped++;
+            return;
+        }
+        if (spare_frames.size()) {
+            pkt.pix.swap(spare_frames.back());
+            spare_frames.pop_back();
+        }
+    }
+
+    size_t n_bytes = size_t(width) * height * 4;
+    pkt.pix.resize(n_bytes);
+    memcpy(pkt.pix.data(), rgba, n_bytes);
+
+    push_packet(std::move(pkt));
+}
+
+void capture_submit_audio(washdc_sample_type const *samples, unsigned count) {
+    if (!active.load(std::memory_order_relaxed))
+        return;
+
+    while (count--) {
+        washdc_sample_type sample = *samples++;
+        if (sample > INT16_MAX)
+            sample = INT16_MAX;
+        else if (sample < INT16_MIN)
+            sample = INT16_MIN;
+        audio_batch.push_back(int16_t(sample));
+    }
+
+    if (audio_batch.size() >= CAPTURE_AUDIO_BATCH)
+        flush_audio();
+}
+
+static void flush_audio(void) {
+    if (audio_batch.empty())
+        return;
+
+    packet pkt;
+    pkt.tp = PACKET_AUDIO;
+    pkt.samples.swap(audio_batch);
+    audio_batch.reserve(CAPTURE_AUDIO_BATCH);
+    push_packet(std::move(pkt));
+}
+
+static void push_packet(packet &&pkt) {
+    {
+        std::lock_guard<std::mutex> lck(queue_lock);
+        if (pkt.tp == PACKET_VIDEO) {
+            n_frames_queued++;
+        } else {
+            if (n_samples_queued >= CAPTURE_MAX_QUEUED_SAMPLES) {
+                fprintf(stderr, "%s - encoder has fallen too far behind; "
+                        "dropping audio\n", __func__);
+                return;
+            }
+            n_samples_queued += pkt.samples.size();
+        }
+        queue.push_back(std::move(pkt));
+    }
+    queue_cond.notify_one();
+}
+
+static void encoder_main(void) {
+    for (;;) {
+        packet pkt;
+        {
+            std::unique_lock<std::mutex> lck(queue_lock);
+            queue_cond.wait(lck, [] { return stop_req || !queue.empty(); });
+            if (queue.empty())
+                return;
+            pkt = std::move(queue.front());
+            queue.pop_front();
+            if (pkt.tp == PACKET_VIDEO)
+                n_frames_queued--;
+            else
+                n_samples_queued -= pkt.samples.size();
+        }
+
+        if (pkt.tp == PACKET_VIDEO) {
+            write_video(pkt);
+            std::lock_guard<std::mutex> lck(queue_lock);
+            spare_frames.emplace_back(std::move(pkt.pix));
+        } else {
+            write_audio(pkt);
+        }
+    }
+}
+
+static void write_u16(FILE *fp, uint16_t val) {
+    uint8_t bytes[2] = { uint8_t(val), uint8_t(val >> 8) };
+    fwrite(bytes, 1, sizeof(bytes), fp);
+}
+
+static void write_u32(FILE *fp, uint32_t val) {
+    uint8_t bytes[4] = {
+        uint8_t(val), uint8_t(val >> 8), uint8_t(val >> 16), uint8_t(val >> 24)
+    };
+    fwrite(bytes, 1, sizeof(bytes), fp);
+}
+
+// 16-bit mono PCM
+static void write_wav_header(FILE *fp, uint32_t n_samples) {
+    uint32_t data_len = n_samples * 2;
+
+    fwrite("RIFF", 1, 4, fp);
+    write_u32(fp, 36 + data_len);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    write_u32(fp, 16);
+    write_u16(fp, 1); // PCM
+    write_u16(fp, 1); // channel count
+    write_u32(fp, CAPTURE_SAMPLE_RATE);
+    write_u32(fp, CAPTURE_SAMPLE_RATE * 2);
+    write_u16(fp, 2);
+    write_u16(fp, 16);
+    fwrite("data", 1, 4, fp);
+    write_u32(fp, data_len);
+}
+
+static void write_audio(packet const &pkt) {
+    for (int16_t sample : pkt.samples)
+        write_u16(aud_file, uint16_t(sample));
+    samples_written += pkt.samples.size();
+}
+
+static void write_video(packet const &pkt) {
+    if (!vid_width) {
+        // 4:2:0 chroma needs even dimensions
+        vid_width = pkt.width & ~1;
+        vid_height = pkt.height & ~1;
+        if (!vid_width || !vid_height)
+            return;
+        fprintf(vid_file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg\n",
+                vid_width, vid_height, CAPTURE_FPS_NUM, CAPTURE_FPS_DEN);
+    }
+
+    uint64_t frames_due = samples_written * CAPTURE_FPS_NUM /
+        (uint64_t(CAPTURE_SAMPLE_RATE) * CAPTURE_FPS_DEN);
+
+    // video is running ahead of the audio
+    if (frames_written > frames_due + 1)
+        return;
+
+    convert_frame(pkt);
+
+    // repeat the frame to catch up if video has fallen behind
+    do {
+        fwrite("FRAME\n", 1, 6, vid_file);
+        fwrite(yuv.data(), 1, yuv.size(), vid_file);
+        frames_written++;
+    } while (frames_written + 1 < frames_due);
+}
+
+/*
+ * full-range BT.601, which is what C420jpeg means.  Frames that don't match
+ * the size of the first one are cropped or padded with black.
+ */
+static void convert_frame(packet const &pkt) {
+    yuv.resize(size_t(vid_width) * vid_height * 3 / 2);
+    capture_rgba_to_yuv420(yuv.data(), vid_width, vid_height, pkt.pix.data(),
+                           pkt.width, pkt.height, pkt.bottom_up);
+}
+
+void capture_rgba_to_yuv420(uint8_t *yuv, unsigned width, unsigned height,
+                            void const *rgba, unsigned src_width,
+                            unsigned src_height, bool bottom_up) {
+    unsigned const w = width, h = height;
+    unsigned const cw = w / 2, ch = h / 2;
+
+    uint8_t *y_plane = yuv;
+    uint8_t *u_plane = y_plane + size_t(w) * h;
+    uint8_t *v_plane = u_plane + size_t(cw) * ch;
+
+    memset(y_plane, 0, size_t(w) * h);
+    memset(u_plane, 128, 2 * size_t(cw) * ch);
+
+    unsigned const src_w = std::min(w, src_width);
+    unsigned const src_h = std::min(h, src_height);
+
+    for (unsigned row = 0; row < src_h; row++) {
+        unsigned src_row = bottom_up ? src_height - 1 - row : row;
+        uint8_t const *src = (uint8_t const*)rgba +
+            size_t(src_row) * src_width * 4;
+        uint8_t *dst_y = y_plane + size_t(row) * w;
+        uint8_t *dst_u = u_plane + size_t(row / 2) * cw;
+        uint8_t *dst_v = v_plane + size_t(row / 2) * cw;
+
+        for (unsigned col = 0; col < src_w; col++, src += 4) {
+            int r = src[0], g = src[1], b = src[2];
+            dst_y[col] = uint8_t((77 * r + 150 * g + 29 * b) >> 8);
+
+            // chroma comes from the top-left pixel of each 2x2 block
+            if (!(row & 1) && !(col & 1) && col / 2 < cw) {
+                int u = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+                int v = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+                dst_u[col / 2] = uint8_t(std::min(std::max(u, 0), 255));
+                dst_v[col / 2] = uint8_t(std::min(std::max(v, 0), 255));
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "washdc/sound_intf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * gameplay recording.  Video frames and AICA output get copied into a bounded
+ * queue and written out on a separate thread so that the emulation thread
+ * never has to wait on the disk.  Video goes to a .y4m file and audio goes to
+ * a .wav file with the same name.  When the queue is full, video frames get
+ * dropped; the encoder repeats or drops frames as needed to keep the video
+ * lined up with the audio.
+ */
+
+// set the directory that recordings get written to
+void capture_set_dir(char const *dir);
+
+int capture_start(void);
+void capture_stop(void);
+
+// stops any recording that's still in progress
+void capture_cleanup(void);
+
+bool capture_active(void);
+
+/*
+ * rgba is width * height pixels, row 0 first.  If bottom_up is true then
+ * row 0 is the bottom of the picture.
+ */
+void capture_submit_video(void const *rgba, unsigned width, unsigned height,
+                          bool bottom_up);
+
+// 44.1kHz mono, the same samples that go to submit_samples in sound_intf
+void capture_submit_audio(washdc_sample_type const *samples, unsigned count);
+
+/*
+ * convert rgba (src_width * src_height pixels, laid out like it is for
+ * capture_submit_video) to full-range BT.601 4:2:0.  width and height must
+ * be even, and yuv must have room for width * height * 3 / 2 bytes.  The
+ * picture is cropped or padded with black to fit.
+ */
+void capture_rgba_to_yuv420(uint8_t *yuv, unsigned width, unsigned height,
+                            void const *rgba, unsigned src_width,
+                            unsigned src_height, bool bottom_up);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -84,6 +84,110 @@ void cfg_create_default_config(FILE *cfg_file) {
         "; purposes)\n"
         "wash.dbg.dump_mem_on_error false\n"
         "\n"
+        "; set to true to throw away log messages when the logger thread can't\n"
+        "; keep up instead of making the emulator wait for it\n"
+        "wash.log.drop-on-overflow false\n"
+        "\n"
+        "; set to true to map the native jit's code through separate writable\n"
+        "; and executable views.  This is needed on hosts which refuse memory\n"
+        "; that is both writable and executable; WashingtonDC will also fall\n"
+        "; back to it automatically if that happens.\n"
+        "wash.jit.dual-map false\n"
+        "\n"
+        "; set to true to let the native jit access guest RAM directly through\n"
+        "; a 4GB window of host address space (Linux only)\n"
+        "wash.jit.fastmem false\n"
+        "\n"
+        "; set to true to interpret blocks until they've run enough times to be\n"
+        "; worth compiling with the native jit.  This cuts down on time spent\n"
+        "; compiling code that only runs once, like during boot and loading.\n"
+        "wash.jit.tiered false\n"
+        "\n"
+        "; set to true to write the address of every block the native jit\n"
+        "; compiles to /tmp/perf-<pid>.map so that perf can tell which guest\n"
+        "; code the time is being spent in\n"
+        "wash.jit.perf-map false\n"
+        "\n"
+        "; set to true to compile hot blocks with the native jit on a separate\n"
+        "; thread while they keep running through the interpreter.  This only\n"
+        "; does anything when wash.jit.tiered is true.\n"
+        "wash.jit.bg-compile false\n"
+        "\n"
+        "; set to true to let the jit keep compiling past forward conditional\n"
+        "; branches instead of ending the block on every BT/BF\n"
+        "wash.jit.superblocks false\n"
+        "\n"
+        "; set to true to detect SH4 busy-wait loops and skip ahead to the\n"
+        "; next scheduled event instead of running them over and over\n"
+        "wash.jit.idle-skip false\n"
+        "\n"
+        "; set to true to charge the SH4 for pipeline stalls (using a register\n"
+        "; before a load or FPU op has finished writing it) instead of only\n"
+        "; counting issue cycles.  More accurate timing at no runtime cost.\n"
+        "wash.jit.stall-model false\n"
+        "\n"
+        "; set to true to save compiled SH4 code between runs so that it\n"
+        "; doesn't have to be translated again.  This only has an effect\n"
+        "; when a console is selected with -c.\n"
+        "wash.jit.persist-cache false\n"
+        "\n"
+        "; once the SH4 code cache is using this many megabytes, throw out\n"
+        "; every block and start over.  0 means no limit.\n"
+        "wash.jit.cache-budget 0\n"
+        "\n"
+        "; uncomment these to pin threads to lists of CPUs like 0,2-3.  The\n"
+        "; emulation thread is the one that runs the SH4.  This is only\n"
+        "; supported on Linux and Windows.\n"
+        "; wash.thread.emu-cpus 2\n"
+        "; wash.thread.rend-cpus 3\n"
+        "; wash.thread.arm7-cpus 4\n"
+        "; wash.thread.jit-cpus 5\n"
+        "; wash.thread.io-cpus 0-1\n"
+        "\n"
+        "; set to true to make the SH4 interpreter (-p) cache blocks of\n"
+        "; predecoded instructions instead of decoding every instruction\n"
+        "wash.intp.predecode false\n"
+        "\n"
+        "; set to true to detect ARM7 sound driver wait loops and skip ahead\n"
+        "; to the next scheduled event instead of running them over and over\n"
+        "wash.arm7.idle-skip false\n"
+        "\n"
+        "; length of the timeslices the SH4 and ARM7 take turns running for,\n"
+        "; in microseconds.  0 means the default of 2500.  Set\n"
+        "; adaptive-timeslice to true to shorten them while the CPUs are\n"
+        "; busy interrupting each other and grow them back when they aren't.\n"
+        "wash.sched.timeslice-us 0\n"
+        "wash.sched.adaptive-timeslice false\n"
+        "\n"
+        "; uncomment dump-dir to save every texture the game uses as a PNG,\n"
+        "; and pack-dir to replace textures with the PNGs from a texture pack\n"
+        "; (a directory of PNGs with a textures.idx file, like the one\n"
+        "; dump-dir makes)\n"
+        "; wash.tex.dump-dir /path/to/texture/dumps\n"
+        "; wash.tex.pack-dir /path/to/texture/pack\n"
+        "\n"
+        "; set to true to emulate the SH4's instruction cache in the interpreter\n"
+        "; so code which gets overwritten without an icache flush keeps running\n"
+        "; the stale instructions like it would on real hardware\n"
+        "wash.sh4.icache false\n"
+        "\n"
+        "; set to true to write save-states from a forked copy of the\n"
+        "; emulator so it doesn't pause while memory gets copied (Linux only)\n"
+        "wash.savestate.fork false\n"
+        "\n"
+        "; take a rewind snapshot every this many frames (0 disables rewind),\n"
+        "; and keep up to this many megabytes of them\n"
+        "wash.rewind.interval 0\n"
+        "wash.rewind.budget 256\n"
+        "\n"
+        "; screenshot format, either png or qoi.  qoi files are larger but\n"
+        "; much faster to encode, which helps when taking a lot of them\n"
+        "wash.screenshot.format png\n"
+        "\n"
+        "; zlib compression level for png screenshots, from 1 (fastest) to 9\n"
+        "; (smallest), or 0 for zlib's default\n"
+        "wash.screenshot.png-level 0\n"
+        "\n"
         "; background color (use html hex syntax)\n"
         "ui.bgcolor #3d77c0\n"
         "\n"
@@ -116,10 +220,95 @@ void cfg_create_default_config(FILE *cfg_file) {
         "; seem to be a good enough approximation most of the time.\n"
         "gfx.rend.oit-mode per-group\n"
         "\n"
+        "; set to true to upload paletted textures as palette indices and\n"
+        "; let the renderer look up the colors.  This saves re-decoding\n"
+        "; textures when a game animates its palette.  This only has an\n"
+        "; effect when the gl4 renderer is used.\n"
+        "gfx.rend.gpu-palette false\n"
+        "\n"
+        "; set to true to have display list vertices written directly into\n"
+        "; persistently-mapped GPU buffers instead of uploading them every\n"
+        "; frame.  This only has an effect when the gl4 renderer is used and\n"
+        "; the driver supports GL_ARB_buffer_storage.\n"
+        "gfx.rend.persistent-verts false\n"
+        "\n"
+        "; set to true to store display list vertices in a packed 32-byte\n"
+        "; format (8-bit colors) instead of 56 bytes of floats.  This only\n"
+        "; has an effect when one of the OpenGL renderers is used.\n"
+        "gfx.rend.packed-verts false\n"
+        "\n"
+        "; set to true to merge consecutive triangle strips that share the\n"
+        "; same render state into a single indexed draw.  This only has an\n"
+        "; effect when the gl4 renderer is used.\n"
+        "gfx.rend.merge-draws false\n"
+        "\n"
+        "; set to true to draw the shadows that games make with opaque\n"
+        "; modifier volumes.  This only has an effect when the gl4 renderer\n"
+        "; is used.\n"
+        "gfx.rend.mod-vols false\n"
+        "\n"
+        "; set to true to sort translucent polygons by depth before they're\n"
+        "; drawn instead of sorting them in the renderer, which scales much\n"
+        "; better in busy scenes.  This only has an effect when the gl3\n"
+        "; renderer is used.\n"
+        "gfx.rend.poly-sort false\n"
+        "\n"
+        "; set to true to reuse the previous frame's draw commands when a\n"
+        "; game submits the exact same display list again, which is common in\n"
+        "; menus and pause screens.\n"
+        "gfx.rend.list-cache false\n"
+        "\n"
+        "; set to true to build the draw commands for opaque, translucent and\n"
+        "; punch-through polygons on separate threads.\n"
+        "gfx.rend.list-threads false\n"
+        "\n"
+        "; set to true to let polygons sample framebuffers directly from the\n"
+        "; GPU instead of copying them back into emulated texture memory\n"
+        "; first.  This only has an effect when the gl4 renderer is used.\n"
+        "gfx.rend.fb-tex-alias false\n"
+        "\n"
+        "; set to true to start copying framebuffers that the game tends to\n"
+        "; read back as soon as they finish rendering, instead of waiting\n"
+        "; for the game to read them.  This only has an effect when the gl4\n"
+        "; renderer is used.\n"
+        "gfx.rend.async-readback false\n"
+        "\n"
+        "; set to true to convert framebuffers that games draw from the CPU\n"
+        "; to RGBA on the GPU instead of the CPU.  This only has an effect\n"
+        "; when the gl4 renderer is used.\n"
+        "gfx.rend.gpu-fb-conv false\n"
+        "\n"
+        "; render at this many times the dreamcast's native resolution.  Render\n"
+        "; targets only get scaled back down when the game reads them.  This\n"
+        "; only has an effect when the gl4 renderer is used.\n"
+        "gfx.rend.internal-scale 1\n"
+        "\n"
+        "; set to true to save compiled shader programs to disk so that they\n"
+        "; don't have to be compiled again the next time they're needed.\n"
+        "; Programs are thrown away whenever the graphics driver changes.\n"
+        "; This only has an effect when the gl4 renderer is used.\n"
+        "gfx.rend.program-cache false\n"
+        "\n"
+        "; set to true to pack small textures with the same size and format\n"
+        "; into texture arrays so that switching between them doesn't need\n"
+        "; a texture bind.  This only has an effect when the gl4 renderer is\n"
+        "; used.\n"
+        "gfx.rend.tex-arrays false\n"
+        "\n"
+        "; set to true to let emulation run ahead while the previous frame is\n"
+        "; still being presented.  Frames that get superseded before they can\n"
+        "; be presented are dropped.  This only has an effect when the render\n"
+        "; thread is enabled.\n"
+        "gfx.rend.present-mailbox false\n"
+        "\n"
         "; set this to true to mute audio.  Set it to false to allow audio \n"
         "; to play\n"
         "audio.mute false\n"
         "\n"
+        "; priority of the audio callback thread: normal, high or realtime.\n"
+        "; realtime usually needs elevated privileges.\n"
+        "audio.thread-priority normal\n"
+        "\n"
         "; to \"unplug\" any of the below controllers, comment out or delete it\n"
         "wash.dc.port.0.0 dreamcast_controller\n"
         "wash.dc.port.1.0 dreamcast_controller\n"
@@ -164,8 +353,10 @@ void cfg_create_default_config(FILE *cfg_file) {
         "wash.ctrl.pause-execution kbd.f7\n"
 
         "wash.ctrl.toggle-mute kbd.f8\n"
+        "wash.ctrl.rewind kbd.f9\n"
         "wash.ctrl.toggle-fullscreen kbd.f11\n"
         "wash.ctrl.screenshot kbd.f12\n"
+        "wash.ctrl.toggle-capture kbd.f1\n"
 
         "wash.ctrl.renderdoc-capture kbd.f10\n"
 
@@ -441,11 +632,12 @@ void cfg_init(FILE *cfg_file) {
     fifo_init(&cfg_state.cfg_nodes);
 
     printf("Parsing wash.cfg\n");
-    for (;;) {
-        int ch = fgetc(cfg_file);
-        if (ch == EOF)
-            break;
-        cfg_put_char(ch);
+    char buf[4096];
+    size_t n_read;
+    while ((n_read = fread(buf, 1, sizeof(buf), cfg_file)) > 0) {
+        size_t idx;
+        for (idx = 0; idx < n_read; idx++)
+            cfg_put_char(buf[idx]);
     }
     cfg_put_char('\n'); // in case the last line doesn't end with newline
 }
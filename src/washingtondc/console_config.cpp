@@ -59,6 +59,15 @@ char const* console_get_rtc_path(char const *console_name) {
     return c_path;
 }
 
+char const *console_get_jit_cache_path(char const *console_name) {
+    path_string path(path_append(console_get_dir(console_name), "jit_cache.bin"));
+
+    static char c_path[HOSTFILE_PATH_LEN];
+    strncpy(c_path, path.c_str(), sizeof(c_path));
+    c_path[sizeof(c_path) - 1] = '\0';
+    return c_path;
+}
+
 char const *console_get_firmware_path(char const *console_name) {
     path_string path(path_append(console_get_dir(console_name), "dc_bios.bin"));
 
@@ -35,6 +35,7 @@
 void create_console_dir(char const *console_name);
 
 char const *console_get_rtc_path(char const *console_name);
+char const *console_get_jit_cache_path(char const *console_name);
 char const *console_get_firmware_path(char const *console_name);
 char const *console_get_flashrom_path(char const *console_name);
 
@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,6 +31,78 @@
 
 static struct gfx_obj obj_array[GFX_OBJ_COUNT];
 
+/*
+ * buffers in the pool are grouped by size class.  Class n holds buffers of
+ * (1 << (n + GFX_OBJ_POOL_MIN_SHIFT)) bytes; anything bigger than the largest
+ * class is allocated and freed directly.  Each class keeps at most
+ * GFX_OBJ_POOL_DEPTH buffers, and the pool as a whole never holds more than
+ * GFX_OBJ_POOL_MAX_BYTES.
+ */
+#define GFX_OBJ_POOL_MIN_SHIFT 12
+#define GFX_OBJ_POOL_MAX_SHIFT 24
+#define GFX_OBJ_POOL_CLASSES (GFX_OBJ_POOL_MAX_SHIFT - GFX_OBJ_POOL_MIN_SHIFT + 1)
+#define GFX_OBJ_POOL_DEPTH 16
+#define GFX_OBJ_POOL_MAX_BYTES (64 * 1024 * 1024)
+
+static void *obj_pool[GFX_OBJ_POOL_CLASSES][GFX_OBJ_POOL_DEPTH];
+static unsigned obj_pool_count[GFX_OBJ_POOL_CLASSES];
+static size_t obj_pool_bytes;
+
+// returns GFX_OBJ_POOL_CLASSES if n_bytes is too big to be pooled
+static unsigned gfx_obj_pool_class(size_t n_bytes) {
+    unsigned class_no;
+    for (class_no = 0; class_no < GFX_OBJ_POOL_CLASSES; class_no++)
+        if (n_bytes <= ((size_t)1 << (class_no + GFX_OBJ_POOL_MIN_SHIFT)))
+            break;
+    return class_no;
+}
+
+void *gfx_obj_pool_get(size_t n_bytes) {
+    unsigned class_no = gfx_obj_pool_class(n_bytes);
+    void *dat;
+
+    if (class_no < GFX_OBJ_POOL_CLASSES) {
+        size_t class_len = (size_t)1 << (class_no + GFX_OBJ_POOL_MIN_SHIFT);
+        if (obj_pool_count[class_no]) {
+            obj_pool_bytes -= class_len;
+            return obj_pool[class_no][--obj_pool_count[class_no]];
+        }
+        dat = malloc(class_len);
+    } else {
+        dat = malloc(n_bytes);
+    }
+
+    if (!dat) {
+        fprintf(stderr, "ERROR: FAILED ALLOC\n");
+        abort();
+    }
+    return dat;
+}
+
+// dat has to have come from gfx_obj_pool_get(n_bytes)
+static void gfx_obj_pool_put(void *dat, size_t n_bytes) {
+    unsigned class_no = gfx_obj_pool_class(n_bytes);
+    if (class_no < GFX_OBJ_POOL_CLASSES) {
+        size_t class_len = (size_t)1 << (class_no + GFX_OBJ_POOL_MIN_SHIFT);
+        if (obj_pool_count[class_no] < GFX_OBJ_POOL_DEPTH &&
+            obj_pool_bytes + class_len <= GFX_OBJ_POOL_MAX_BYTES) {
+            obj_pool[class_no][obj_pool_count[class_no]++] = dat;
+            obj_pool_bytes += class_len;
+            return;
+        }
+    }
+    free(dat);
+}
+
+void gfx_obj_pool_drain(void) {
+    unsigned class_no;
+    for (class_no = 0; class_no < GFX_OBJ_POOL_CLASSES; class_no++) {
+        while (obj_pool_count[class_no])
+            free(obj_pool[class_no][--obj_pool_count[class_no]]);
+    }
+    obj_pool_bytes = 0;
+}
+
 void gfx_obj_init(int handle, size_t n_bytes) {
     struct gfx_obj *obj = obj_array + handle;
     if (obj->dat_len)
@@ -41,7 +114,8 @@ void gfx_obj_init(int handle, size_t n_bytes) {
 
 void gfx_obj_free(int handle) {
     struct gfx_obj *obj = obj_array + handle;
-    free(obj->dat);
+    if (obj->dat)
+        gfx_obj_pool_put(obj->dat, obj->dat_len);
     obj->dat = NULL;
     obj->on_read = NULL;
     obj->on_write = NULL;
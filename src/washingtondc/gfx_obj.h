@@ -57,15 +57,20 @@ void gfx_obj_free(int handle);
 void gfx_obj_write(int handle, void const *dat, size_t n_bytes);
 void gfx_obj_read(int handle, void *dat, size_t n_bytes);
 
+/*
+ * data stores come out of a pool of recycled buffers so that objs which get
+ * freed and initialized over and over again (like evicted textures) don't go
+ * through malloc every time.  Only call these from the gfx code.
+ */
+void *gfx_obj_pool_get(size_t n_bytes);
+
+// free every buffer the pool is holding onto
+void gfx_obj_pool_drain(void);
+
 // Only call this from the gfx code
 static inline void gfx_obj_alloc(struct gfx_obj *obj) {
-    if (!obj->dat) {
-        obj->dat = malloc(obj->dat_len);
-        if (!obj->dat) {
-            fprintf(stderr, "ERROR: FAILED ALLOC\n");
-            abort();
-        }
-    }
+    if (!obj->dat)
+        obj->dat = gfx_obj_pool_get(obj->dat_len);
 }
 
 struct gfx_obj *gfx_obj_get(int handle);
@@ -48,6 +48,7 @@
 #include "gfxgl3_target.h"
 #include "../shader.h"
 #include "../shader_cache.h"
+#include "../gl_state_cache.h"
 #include "gfxgl3_renderer.h"
 #include "tex_cache.h"
 #include "../gfx_obj.h"
@@ -111,6 +112,8 @@ struct obj_tex_meta {
      * regardless of the other parameters.
      */
     bool dirty;
+
+    struct gl_tex_params params;
 };
 
 // one texture object for each gfx_obj
@@ -118,6 +121,30 @@ static GLuint obj_tex_array[GFX_OBJ_COUNT];
 
 static struct obj_tex_meta obj_tex_meta_array[GFX_OBJ_COUNT];
 
+/*
+ * GL state set by GFX_IL_SET_REND_PARAM and the draw commands.  cur_shader_ent
+ * is the shader_cache_ent of the bound program, or NULL if that's unknown.
+ * last_shader_ent is the last one that was bound, which might not be anymore.
+ */
+static struct gl_state_cache gl_state;
+static struct shader_cache_ent *cur_shader_ent, *last_shader_ent;
+
+static struct gl_uniform_cache *uniform_cache(unsigned slot) {
+    if (cur_shader_ent)
+        return cur_shader_ent->uniforms + slot;
+
+    // the uniform is going to whatever is bound, which might be this one
+    if (last_shader_ent)
+        last_shader_ent->uniforms[slot].valid = false;
+    return NULL;
+}
+
+static void get_stat(struct renderer_stat *stat) {
+    stat->gl_calls_issued = gl_state.last.issued;
+    stat->gl_calls_skipped = gl_state.last.skipped;
+    stat->gpu_ms_valid = false;
+}
+
 static DEF_ERROR_INT_ATTR(gfx_tex_fmt);
 
 static GLenum tex_fmt_to_data_type(enum gfx_tex_fmt gfx_fmt);
@@ -196,6 +223,7 @@ static struct oit_state {
 
     float *vert_array;
     unsigned vert_array_len;
+    enum gfx_vert_fmt vert_fmt;
 } oit_state;
 
 // converts pixels from ARGB 4444 to RGBA 4444
@@ -227,6 +255,8 @@ static void gfxgl3_renderer_end_rend(struct gfx_il_inst *cmd);
 
 static void
 gfxgl3_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd);
+static bool gl_state_preserved(enum gfx_il op);
+static void invalidate_gl_state(void);
 
 static void do_set_rend_param(struct gfx_rend_param const *param);
 static void do_draw_array(GLint first_idx, GLsizei n_verts);
@@ -244,7 +274,8 @@ struct renderer const gfxgl3_renderer = {
     .set_callbacks = set_callbacks,
     .video_present = gfxgl3_video_present,
     .toggle_video_filter = gfxgl3_video_toggle_filter,
-    .capture_renderdoc = capture_renderdoc
+    .capture_renderdoc = capture_renderdoc,
+    .get_stat = get_stat
 };
 
 static void init_renderdoc_api(void);
@@ -590,6 +621,9 @@ static void opengl_render_init(void) {
 
     memset(obj_tex_meta_array, 0, sizeof(obj_tex_meta_array));
 
+    gl_state_init(&gl_state);
+    cur_shader_ent = last_shader_ent = NULL;
+
     unsigned tex_no;
     for (tex_no = 0; tex_no < GFX_OBJ_COUNT; tex_no++) {
         obj_tex_meta_array[tex_no].dirty = true;
@@ -617,12 +651,14 @@ static void opengl_render_cleanup(void) {
     glDeleteVertexArrays(1, &vao);
 
     shader_cache_cleanup(&shader_cache);
+    cur_shader_ent = last_shader_ent = NULL;
 
     vao = 0;
     vbo = 0;
     memset(obj_tex_array, 0, sizeof(obj_tex_array));
 
     gfxgl3_tex_cache_cleanup();
+    gfx_obj_pool_drain();
 
     cleanup_renderdoc_api();
 
@@ -780,10 +816,7 @@ static void gfxgl3_renderer_set_blend_enable(struct gfx_il_inst *cmd) {
     bool enable = cmd->arg.set_blend_enable.do_enable;
     struct gfx_cfg rend_cfg = gfx_config_read();
 
-    if (rend_cfg.blend_enable && enable)
-        glEnable(GL_BLEND);
-    else
-        glDisable(GL_BLEND);
+    gl_state_blend_enable(&gl_state, rend_cfg.blend_enable && enable);
 }
 
 static void gfxgl3_renderer_set_rend_param(struct gfx_il_inst *cmd) {
@@ -828,15 +861,20 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
             break;
         }
 
+        gl_state_active_tex(&gl_state, GL_TEXTURE0);
+
+        struct gl_tex_params *tex_params = NULL;
         if (gfx_gfxgl3_tex_cache_get(param->tex_idx)->valid) {
             int obj_handle = gfx_gfxgl3_tex_cache_get(param->tex_idx)->obj_handle;
-            glBindTexture(GL_TEXTURE_2D, obj_tex_array[obj_handle]);
+            gl_state_bind_tex(&gl_state, obj_tex_array[obj_handle]);
+            tex_params = &obj_tex_meta_array[obj_handle].params;
         } else {
             fprintf(stderr, "WARNING: attempt to bind invalid texture %u\n",
                     (unsigned)param->tex_idx);
-            glBindTexture(GL_TEXTURE_2D, 0);
+            gl_state_bind_tex(&gl_state, 0);
         }
 
+        GLint tex_filter_gl;
         switch (param->tex_filter) {
         case TEX_FILTER_TRILINEAR_A:
         case TEX_FILTER_TRILINEAR_B:
@@ -844,12 +882,11 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
                     "WARNING: trilinear filtering is not yet supported\n");
             // intentional fall-through
         case TEX_FILTER_NEAREST:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        default:
+            tex_filter_gl = GL_NEAREST;
             break;
         case TEX_FILTER_BILINEAR:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            tex_filter_gl = GL_LINEAR;
             break;
         }
         GLenum tex_wrap_mode_gl[2];
@@ -880,10 +917,12 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
             RAISE_ERROR(ERROR_INTEGRITY);
         }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, tex_wrap_mode_gl[0]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, tex_wrap_mode_gl[1]);
-
-        glActiveTexture(GL_TEXTURE0);
+        // nothing to set if the texture was invalid since 0 is bound
+        if (tex_params) {
+            gl_state_tex_params(&gl_state, tex_params,
+                                tex_filter_gl, tex_filter_gl,
+                                tex_wrap_mode_gl[0], tex_wrap_mode_gl[1]);
+        }
     } else if (rend_cfg.color_enable) {
         shader_cache_key = SHADER_KEY_COLOR_ENABLE_BIT;
     } else {
@@ -908,14 +947,21 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
                 "texture with key 0x%08x\n", __func__, (int)shader_cache_key);
         return;
     }
-    glUseProgram(shader_ent->shader.shader_prog_obj);
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_BOUND_TEX], 0);
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_PT_ALPHA_REF],
-                param->pt_ref - 1);
-    trans_mat_slot = shader_ent->slots[SHADER_CACHE_SLOT_TRANS_MAT];
-    user_clip_slot = shader_ent->slots[SHADER_CACHE_SLOT_USER_CLIP];
-    glUniform4f(user_clip_slot, user_clip[0], user_clip[1],
-                user_clip[2], user_clip[3]);
+    gl_state_use_program(&gl_state, shader_ent->shader.shader_prog_obj);
+    cur_shader_ent = last_shader_ent = shader_ent;
+
+    struct gl_uniform_cache *uniforms = shader_ent->uniforms;
+    GLint const *slots = shader_ent->slots;
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_BOUND_TEX,
+                       slots[SHADER_CACHE_SLOT_BOUND_TEX], 0);
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_PT_ALPHA_REF,
+                       slots[SHADER_CACHE_SLOT_PT_ALPHA_REF],
+                       param->pt_ref - 1);
+    trans_mat_slot = slots[SHADER_CACHE_SLOT_TRANS_MAT];
+    user_clip_slot = slots[SHADER_CACHE_SLOT_USER_CLIP];
+    gl_state_uniform4f(&gl_state, uniforms + SHADER_CACHE_SLOT_USER_CLIP,
+                       user_clip_slot, user_clip[0], user_clip[1],
+                       user_clip[2], user_clip[3]);
 
     GLfloat tex_transform[4] = {
         param->tex_transform[0],
@@ -923,14 +969,17 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
         param->tex_transform[2],
         param->tex_transform[3],
     };
-    glUniformMatrix2fv(shader_ent->slots[SHADER_CACHE_SLOT_TEX_TRANSFORM],
-                       1, GL_TRUE, tex_transform);
+    gl_state_uniform_mat2(&gl_state, uniforms + SHADER_CACHE_SLOT_TEX_TRANSFORM,
+                          slots[SHADER_CACHE_SLOT_TEX_TRANSFORM],
+                          GL_TRUE, tex_transform);
 
-    glBlendFunc(src_blend_factors[(unsigned)param->src_blend_factor],
-                dst_blend_factors[(unsigned)param->dst_blend_factor]);
+    gl_state_blend_func(&gl_state,
+                        src_blend_factors[(unsigned)param->src_blend_factor],
+                        dst_blend_factors[(unsigned)param->dst_blend_factor]);
 
-    glDepthMask(param->enable_depth_writes ? GL_TRUE : GL_FALSE);
-    glDepthFunc(depth_funcs[param->depth_func]);
+    gl_state_depth_mask(&gl_state,
+                        param->enable_depth_writes ? GL_TRUE : GL_FALSE);
+    gl_state_depth_func(&gl_state, depth_funcs[param->depth_func]);
 
     tex_enable = param->tex_enable;
 }
@@ -939,7 +988,8 @@ static void gfxgl3_renderer_set_vert_array(struct gfx_il_inst *cmd) {
     unsigned n_verts = cmd->arg.set_vert_array.n_verts;
     float const *verts = cmd->arg.set_vert_array.verts;
 
-    size_t bytes_per_vert = sizeof(float) * (size_t)GFX_VERT_LEN;
+    oit_state.vert_fmt = cmd->arg.set_vert_array.fmt;
+    size_t bytes_per_vert = GFX_VERT_SIZE(oit_state.vert_fmt);
     if (gfx_config_read().depth_sort_enable &&
         SIZE_MAX / bytes_per_vert >= n_verts) {
         if (n_verts) {
@@ -997,12 +1047,15 @@ static void do_draw_array(GLint first_idx, GLsizei n_verts) {
             grp->first = first_idx;
             grp->count = n_verts;
 
+            // the position is at the start of each vertex in either format
+            size_t vert_stride =
+                GFX_VERT_SIZE(oit_state.vert_fmt) / sizeof(float);
             float avg_depth = 0.0f;
             unsigned vert_no;
             unsigned last_idx = first_idx + (n_verts - 1);
             for (vert_no = first_idx; vert_no <= last_idx; vert_no++) {
                 avg_depth +=
-                    1.0f / oit_state.vert_array[vert_no * GFX_VERT_LEN + 2];
+                    1.0f / oit_state.vert_array[vert_no * vert_stride + 2];
             }
             avg_depth /= n_verts;
 
@@ -1031,7 +1084,8 @@ static void do_draw_array(GLint first_idx, GLsizei n_verts) {
         0, 0, 0, 1
     };
 
-    glUniformMatrix4fv(trans_mat_slot, 1, GL_TRUE, trans_mat);
+    gl_state_uniform_mat4(&gl_state, uniform_cache(SHADER_CACHE_SLOT_TRANS_MAT),
+                          trans_mat_slot, GL_TRUE, trans_mat);
 
     // now draw the geometry itself
     glBindVertexArray(vao);
@@ -1039,20 +1093,38 @@ static void do_draw_array(GLint first_idx, GLsizei n_verts) {
     glEnableVertexAttribArray(POSITION_SLOT);
     glEnableVertexAttribArray(BASE_COLOR_SLOT);
     glEnableVertexAttribArray(OFFS_COLOR_SLOT);
-    glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_POS_OFFSET * sizeof(float)));
-    glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_BASE_COLOR_OFFSET * sizeof(float)));
-    glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_OFFS_COLOR_OFFSET * sizeof(float)));
-    if (tex_enable) {
-        glEnableVertexAttribArray(TEX_COORD_SLOT);
-        glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+    if (oit_state.vert_fmt == GFX_VERT_FMT_PACKED) {
+        glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)GFX_PACKED_VERT_POS_OFFSET);
+        glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)GFX_PACKED_VERT_BASE_COLOR_OFFSET);
+        glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)GFX_PACKED_VERT_OFFS_COLOR_OFFSET);
+        if (tex_enable) {
+            glEnableVertexAttribArray(TEX_COORD_SLOT);
+            glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+                                  GFX_PACKED_VERT_SIZE,
+                                  (GLvoid*)GFX_PACKED_VERT_TEX_COORD_OFFSET);
+        }
+    } else {
+        glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
                               GFX_VERT_LEN * sizeof(float),
-                              (GLvoid*)(GFX_VERT_TEX_COORD_OFFSET * sizeof(float)));
+                              (GLvoid*)(GFX_VERT_POS_OFFSET * sizeof(float)));
+        glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_VERT_LEN * sizeof(float),
+                              (GLvoid*)(GFX_VERT_BASE_COLOR_OFFSET * sizeof(float)));
+        glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_VERT_LEN * sizeof(float),
+                              (GLvoid*)(GFX_VERT_OFFS_COLOR_OFFSET * sizeof(float)));
+        if (tex_enable) {
+            glEnableVertexAttribArray(TEX_COORD_SLOT);
+            glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+                                  GFX_VERT_LEN * sizeof(float),
+                                  (GLvoid*)(GFX_VERT_TEX_COORD_OFFSET * sizeof(float)));
+        }
     }
     glDrawArrays(GL_TRIANGLE_STRIP, first_idx, n_verts);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -1183,9 +1255,11 @@ static void gfxgl3_renderer_end_sort_mode(struct gfx_il_inst *cmd) {
             struct oit_group *grp_src = oit_state.groups + src_idx;
             do_set_rend_param(&grp_src->rend_param);
             if (grp_src->rend_param.user_clip_mode != GFX_USER_CLIP_DISABLE) {
-                glUniform4f(user_clip_slot,
-                            grp_src->user_clip[0], grp_src->user_clip[1],
-                            grp_src->user_clip[2], grp_src->user_clip[3]);
+                gl_state_uniform4f(&gl_state,
+                                   uniform_cache(SHADER_CACHE_SLOT_USER_CLIP),
+                                   user_clip_slot,
+                                   grp_src->user_clip[0], grp_src->user_clip[1],
+                                   grp_src->user_clip[2], grp_src->user_clip[3]);
             }
             do_draw_array(grp_src->first, grp_src->count);
         }
@@ -1300,6 +1374,8 @@ static void gfxgl3_renderer_post_framebuffer(struct gfx_il_inst *cmd) {
 }
 
 static void gfxgl3_renderer_begin_rend(struct gfx_il_inst *cmd) {
+    gl_state_begin_frame(&gl_state);
+
     if (!renderdoc_capture_in_progress && renderdoc_capture_requested) {
         if (is_renderdoc_enabled()) {
             rdoc_api->StartFrameCapture(NULL, NULL);
@@ -1338,6 +1414,8 @@ static void gfxgl3_renderer_begin_rend(struct gfx_il_inst *cmd) {
 }
 
 static void gfxgl3_renderer_end_rend(struct gfx_il_inst *cmd) {
+    gl_state_end_frame(&gl_state);
+
     glDisable(GL_SCISSOR_TEST);
     gfxgl3_target_end(cmd->arg.end_rend.rend_tgt_obj);
 
@@ -1347,9 +1425,39 @@ static void gfxgl3_renderer_end_rend(struct gfx_il_inst *cmd) {
     }
 }
 
+/*
+ * returns true if op only touches GL state that goes through gl_state.
+ * anything else could change that state without the cache knowing about it.
+ */
+static bool gl_state_preserved(enum gfx_il op) {
+    switch (op) {
+    case GFX_IL_SET_BLEND_ENABLE:
+    case GFX_IL_SET_REND_PARAM:
+    case GFX_IL_SET_CLIP_RANGE:
+    case GFX_IL_SET_USER_CLIP:
+    case GFX_IL_SET_VERT_ARRAY:
+    case GFX_IL_DRAW_VERT_ARRAY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void invalidate_gl_state(void) {
+    gl_state_invalidate(&gl_state);
+    cur_shader_ent = NULL;
+}
+
 static void
 gfxgl3_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
+    // the ui and the video output may have changed things since last time
+    invalidate_gl_state();
+
     while (n_cmd--) {
+        bool preserved = gl_state_preserved(cmd->op);
+        if (!preserved)
+            invalidate_gl_state();
+
         switch (cmd->op) {
         case GFX_IL_BIND_TEX:
             gfxgl3_renderer_bind_tex(cmd);
@@ -1425,13 +1533,18 @@ gfxgl3_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
             else
                 user_clip[3] = 0;
 
-            glUniform4f(user_clip_slot, user_clip[0], user_clip[1],
-                        user_clip[2], user_clip[3]);
+            gl_state_uniform4f(&gl_state,
+                               uniform_cache(SHADER_CACHE_SLOT_USER_CLIP),
+                               user_clip_slot, user_clip[0], user_clip[1],
+                               user_clip[2], user_clip[3]);
             break;
         default:
             fprintf(stderr, "ERROR: UNKNOWN GFX IL COMMAND %02X\n",
                     (unsigned)cmd->op);
         }
+
+        if (!preserved)
+            invalidate_gl_state();
         cmd++;
     }
 }
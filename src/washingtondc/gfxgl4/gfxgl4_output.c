@@ -24,6 +24,7 @@
 #include "i_hate_windows.h"
 #endif
 
+#include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <errno.h>
@@ -39,6 +40,8 @@
 
 #include "../config_file.h"
 #include "../gfx_obj.h"
+#include "../capture.h"
+#include "../stream.h"
 #include "gfxgl4_output.h"
 #include "gfxgl4_renderer.h"
 #include "../shader.h"
@@ -86,7 +89,7 @@ static struct fb_poly {
 
 static int bound_obj_handle;
 static double bound_obj_w, bound_obj_h;
-static bool bound_obj_interlace;
+static bool bound_obj_interlace, bound_obj_raw;
 static GLenum min_filter = GL_NEAREST, mag_filter = GL_NEAREST;
 
 static GLfloat trans_mat[16] = {
@@ -104,13 +107,48 @@ static GLfloat tex_mat[9] = {
 
 static GLfloat bgcolor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 
+/*
+ * frames being recorded are read back through a small ring of pixel buffers
+ * so that the emulation thread never has to wait for the GPU.  Each frame is
+ * picked up a frame or two after it was issued, once its fence has signaled.
+ * If every buffer is still in flight then the frame is skipped.
+ */
+#define CAPTURE_PBO_COUNT 3
+static struct capture_pbo {
+    GLuint buf;
+    GLsync fence;
+    size_t len;
+    unsigned width, height;
+    bool bottom_up;
+} cap_pbo[CAPTURE_PBO_COUNT];
+static unsigned cap_read_idx, cap_n_pending;
+
+static void capture_frame(void);
+
+/*
+ * framebuffers which are posted in the guest's pixel format get uploaded to
+ * raw_tex as an integer texture, and then decode_shader converts them into the
+ * obj's RGBA8 texture so that the rest of the output stage (and screenshots)
+ * can treat them like any other framebuffer.
+ */
+static struct shader decode_shader;
+static GLuint raw_tex, decode_fbo;
+static GLenum raw_tex_fmt;
+static unsigned raw_tex_width, raw_tex_height;
+
 static void set_flip(bool flip);
 
 static void
 gfxgl4_video_update_framebuffer(int obj_handle,
                                 unsigned fb_read_width,
                                 unsigned fb_read_height,
-                                bool interlace);
+                                bool interlace,
+                                enum gfx_fb_raw_fmt raw_fmt,
+                                unsigned concat);
+
+static void decode_raw_fb(int obj_handle, unsigned width, unsigned height,
+                          bool interlace, enum gfx_fb_raw_fmt raw_fmt,
+                          unsigned concat);
 
 void gfxgl4_video_output_init(void) {
     char const *filter_str;
@@ -169,20 +207,90 @@ void gfxgl4_video_output_init(void) {
     shader_load_frag(&fb_shader, SHADER_VER_430, final_frag_glsl);
     shader_link(&fb_shader);
 
+    static char const * const decode_vert_glsl =
+        "layout (location = 0) in vec3 vert_pos;\n"
+
+        "void main() {\n"
+        "    gl_Position = vec4(vert_pos.x, vert_pos.y, 0.0, 1.0);\n"
+        "}\n";
+
+    /*
+     * the bit manipulation here is the same as what the conv_* functions in
+     * libwashdc's framebuffer.c do, so both paths give the same picture.
+     * raw_fmt is compared against the values of enum gfx_fb_raw_fmt.
+     */
+    static_assert(GFX_FB_RAW_RGB565 == 2 && GFX_FB_RAW_RGB888 == 3 &&
+                  GFX_FB_RAW_RGB0888 == 4,
+                  "update decode_frag_glsl to match enum gfx_fb_raw_fmt");
+    static char const * const decode_frag_glsl =
+        "out vec4 color;\n"
+
+        "uniform usampler2D raw_fb;\n"
+        "uniform int raw_fmt;\n"
+        "uniform uint concat;\n"
+        "uniform int rows_per_field;\n"
+        "uniform bool interlace;\n"
+
+        "void main() {\n"
+        "    ivec2 pos = ivec2(gl_FragCoord.xy);\n"
+        "    int row = pos.y;\n"
+        "    if (interlace)\n"
+        "        row = (pos.y & 1) * rows_per_field + (pos.y >> 1);\n"
+
+        "    uvec3 rgb;\n"
+        "    if (raw_fmt == 3) {\n"
+        "        rgb.b = texelFetch(raw_fb, ivec2(pos.x * 3, row), 0).r;\n"
+        "        rgb.g = texelFetch(raw_fb, ivec2(pos.x * 3 + 1, row), 0).r;\n"
+        "        rgb.r = texelFetch(raw_fb, ivec2(pos.x * 3 + 2, row), 0).r;\n"
+        "    } else {\n"
+        "        uint pix = texelFetch(raw_fb, ivec2(pos.x, row), 0).r;\n"
+        "        uvec3 fill = uvec3(concat, concat & 3u, concat);\n"
+        "        if (raw_fmt == 4) {\n"
+        "            rgb = uvec3(pix >> 16, pix >> 8, pix) & 0xffu;\n"
+        "        } else if (raw_fmt == 2) {\n"
+        "            rgb = uvec3((pix >> 8) & 0xf8u, (pix >> 3) & 0xfcu,\n"
+        "                        (pix << 3) & 0xf8u) | fill;\n"
+        "        } else {\n"
+        "            rgb = uvec3((pix >> 8) & 0xecu, (pix >> 3) & 0x7cu,\n"
+        "                        (pix << 3) & 0xf8u) | fill;\n"
+        "        }\n"
+        "    }\n"
+        "    color = vec4(vec3(rgb) / 255.0, 1.0);\n"
+        "}\n";
+
+    shader_load_vert(&decode_shader, SHADER_VER_430, decode_vert_glsl);
+    shader_load_frag(&decode_shader, SHADER_VER_430, decode_frag_glsl);
+    shader_link(&decode_shader);
+
+    glGenFramebuffers(1, &decode_fbo);
+
     init_poly();
 }
 
 void gfxgl4_video_output_cleanup(void) {
     // TODO cleanup OpenGL stuff
+
+    unsigned idx;
+    for (idx = 0; idx < CAPTURE_PBO_COUNT; idx++) {
+        if (cap_pbo[idx].fence)
+            glDeleteSync(cap_pbo[idx].fence);
+        if (cap_pbo[idx].buf)
+            glDeleteBuffers(1, &cap_pbo[idx].buf);
+    }
+    memset(cap_pbo, 0, sizeof(cap_pbo));
+    cap_read_idx = cap_n_pending = 0;
 }
 
 void gfxgl4_video_new_framebuffer(int obj_handle,
                                   unsigned fb_new_width,
                                   unsigned fb_new_height,
                                   bool do_flip,
-                                  bool interlace) {
+                                  bool interlace,
+                                  enum gfx_fb_raw_fmt raw_fmt,
+                                  unsigned concat) {
     set_flip(do_flip);
-    gfxgl4_video_update_framebuffer(obj_handle, fb_new_width, fb_new_height, interlace);
+    gfxgl4_video_update_framebuffer(obj_handle, fb_new_width, fb_new_height,
+                                    interlace, raw_fmt, concat);
 }
 
 static void set_flip(bool flip) {
@@ -193,28 +301,37 @@ static void
 gfxgl4_video_update_framebuffer(int obj_handle,
                                 unsigned fb_read_width,
                                 unsigned fb_read_height,
-                                bool interlace) {
+                                bool interlace,
+                                enum gfx_fb_raw_fmt raw_fmt,
+                                unsigned concat) {
     if (obj_handle < 0)
         return;
 
     struct gfx_obj *obj = gfx_obj_get(obj_handle);
-    GLuint tex_obj = gfxgl4_renderer_tex(obj_handle);
-
-    glBindTexture(GL_TEXTURE_2D, tex_obj);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
 
-    if (!(obj->state & GFX_OBJ_STATE_TEX)) {
+    if (!(obj->state & GFX_OBJ_STATE_TEX) ||
+        gfxgl4_renderer_tex_get_dirty(obj_handle)) {
         if (obj->dat_len < fb_read_width * fb_read_height * sizeof(uint32_t)) {
             fprintf(stderr, "ERROR: INTEGRITY\n");
             abort();
         }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, fb_read_width, fb_read_height, 0,
-                     GL_RGBA, GL_UNSIGNED_BYTE, obj->dat);
+        gfxgl4_renderer_tex_storage(obj_handle, GL_RGBA8,
+                                    fb_read_width, fb_read_height, 1);
+        if (raw_fmt == GFX_FB_RAW_NONE) {
+            size_t n_bytes = fb_read_width * fb_read_height * sizeof(uint32_t);
+            struct gfxgl4_tex_upload up;
+            gfxgl4_tex_upload_map(&up, n_bytes);
+            memcpy(up.dat, obj->dat, n_bytes);
+            gfxgl4_tex_upload_unmap(&up);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                            fb_read_width, fb_read_height,
+                            GL_RGBA, GL_UNSIGNED_BYTE, up.src);
+            gfxgl4_tex_upload_finish(&up);
+        } else {
+            decode_raw_fb(obj_handle, fb_read_width, fb_read_height,
+                          interlace, raw_fmt, concat);
+        }
 
         gfxgl4_renderer_tex_set_dims(obj_handle, fb_read_width, fb_read_height);
         gfxgl4_renderer_tex_set_format(obj_handle, GL_RGBA);
@@ -222,12 +339,112 @@ gfxgl4_video_update_framebuffer(int obj_handle,
         gfxgl4_renderer_tex_set_dirty(obj_handle, false);
     }
 
+    glBindTexture(GL_TEXTURE_2D, gfxgl4_renderer_tex(obj_handle));
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+
     glBindTexture(GL_TEXTURE_2D, 0);
 
     bound_obj_handle = obj_handle;
     bound_obj_w = (double)fb_read_width;
     bound_obj_h = (double)fb_read_height;
     bound_obj_interlace = interlace;
+    bound_obj_raw = raw_fmt != GFX_FB_RAW_NONE;
+}
+
+static void decode_raw_fb(int obj_handle, unsigned width, unsigned height,
+                          bool interlace, enum gfx_fb_raw_fmt raw_fmt,
+                          unsigned concat) {
+    struct gfx_obj *obj = gfx_obj_get(obj_handle);
+    GLenum internal_fmt, dat_type;
+    unsigned tex_width = width;
+    size_t bytes_per_texel;
+
+    switch (raw_fmt) {
+    case GFX_FB_RAW_RGB555:
+    case GFX_FB_RAW_RGB565:
+        internal_fmt = GL_R16UI;
+        dat_type = GL_UNSIGNED_SHORT;
+        bytes_per_texel = sizeof(uint16_t);
+        break;
+    case GFX_FB_RAW_RGB888:
+        // one texel per byte since there's no three-byte integer format
+        internal_fmt = GL_R8UI;
+        dat_type = GL_UNSIGNED_BYTE;
+        bytes_per_texel = sizeof(uint8_t);
+        tex_width = width * 3;
+        break;
+    case GFX_FB_RAW_RGB0888:
+        internal_fmt = GL_R32UI;
+        dat_type = GL_UNSIGNED_INT;
+        bytes_per_texel = sizeof(uint32_t);
+        break;
+    default:
+        fprintf(stderr, "ERROR: unknown raw framebuffer format %d\n",
+                (int)raw_fmt);
+        return;
+    }
+
+    if (!raw_tex)
+        glGenTextures(1, &raw_tex);
+    glBindTexture(GL_TEXTURE_2D, raw_tex);
+
+    // 888 rows are not always a multiple of four bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (raw_tex_fmt != internal_fmt || raw_tex_width != tex_width ||
+        raw_tex_height != height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_fmt, tex_width, height, 0,
+                     GL_RED_INTEGER, dat_type, obj->dat);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        raw_tex_fmt = internal_fmt;
+        raw_tex_width = tex_width;
+        raw_tex_height = height;
+    } else {
+        size_t n_bytes = bytes_per_texel * tex_width * height;
+        struct gfxgl4_tex_upload up;
+        gfxgl4_tex_upload_map(&up, n_bytes);
+        memcpy(up.dat, obj->dat, n_bytes);
+        gfxgl4_tex_upload_unmap(&up);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tex_width, height,
+                        GL_RED_INTEGER, dat_type, up.src);
+        gfxgl4_tex_upload_finish(&up);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, decode_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           gfxgl4_renderer_tex(obj_handle), 0);
+
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+
+    GLuint prog = decode_shader.shader_prog_obj;
+    glUseProgram(prog);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(prog, "raw_fb"), 0);
+    glUniform1i(glGetUniformLocation(prog, "raw_fmt"), (GLint)raw_fmt);
+    glUniform1ui(glGetUniformLocation(prog, "concat"), concat);
+    glUniform1i(glGetUniformLocation(prog, "rows_per_field"), height / 2);
+    glUniform1i(glGetUniformLocation(prog, "interlace"), interlace);
+
+    glBindVertexArray(fb_poly.vao);
+    glDrawElements(GL_TRIANGLE_STRIP, FB_QUAD_IDX_COUNT, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // gfxgl4_renderer_tex_storage left this bound
+    glBindTexture(GL_TEXTURE_2D, gfxgl4_renderer_tex(obj_handle));
+}
+
+bool gfxgl4_video_fb_raw(void) {
+    return bound_obj_raw;
 }
 
 void gfxgl4_video_present(void) {
@@ -333,6 +550,78 @@ void gfxgl4_video_present(void) {
 
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (capture_active() || stream_active() || cap_n_pending)
+        capture_frame();
+}
+
+// the same readbacks feed both the recorder and the stream
+static void capture_frame(void) {
+    bool recording = capture_active() || stream_active();
+
+    // hand off whatever has finished; stale readbacks are just thrown away
+    while (cap_n_pending) {
+        struct capture_pbo *pbo = cap_pbo + cap_read_idx;
+        if (recording &&
+            glClientWaitSync(pbo->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+
+        glDeleteSync(pbo->fence);
+        pbo->fence = NULL;
+
+        if (recording) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo->buf);
+            void const *pix = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                               pbo->width * pbo->height * 4,
+                                               GL_MAP_READ_BIT);
+            if (pix) {
+                capture_submit_video(pix, pbo->width, pbo->height,
+                                     pbo->bottom_up);
+                stream_submit_video(pix, pbo->width, pbo->height,
+                                    pbo->bottom_up);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        cap_read_idx = (cap_read_idx + 1) % CAPTURE_PBO_COUNT;
+        cap_n_pending--;
+    }
+
+    if (!recording || bound_obj_handle < 0 ||
+        cap_n_pending == CAPTURE_PBO_COUNT)
+        return;
+
+    struct capture_pbo *pbo =
+        cap_pbo + (cap_read_idx + cap_n_pending) % CAPTURE_PBO_COUNT;
+    pbo->width = gfxgl4_renderer_tex_get_width(bound_obj_handle);
+    pbo->height = gfxgl4_renderer_tex_get_height(bound_obj_handle);
+
+    /*
+     * row 0 of the framebuffer texture is at the bottom of the screen unless
+     * the picture is flipped.
+     */
+    pbo->bottom_up = !do_flip;
+
+    size_t len = pbo->width * pbo->height * 4;
+    if (!len)
+        return;
+
+    if (!pbo->buf)
+        glGenBuffers(1, &pbo->buf);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo->buf);
+    if (pbo->len < len) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, len, NULL, GL_STREAM_READ);
+        pbo->len = len;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, gfxgl4_renderer_tex(bound_obj_handle));
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pbo->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    cap_n_pending++;
 }
 
 static void init_poly() {
@@ -32,6 +32,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "washdc/gfx/gfx_il.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,6 +43,9 @@ extern "C" {
  * fb_new belongs to the caller, and its contents will be copied into a new
  * storage area.
  *
+ * if raw_fmt is anything other than GFX_FB_RAW_NONE, the obj's contents get
+ * converted to RGBA8888 on the GPU (see post_framebuffer in gfx_il.h).
+ *
  * this function is safe to call from outside of the graphics thread
  * from outside of the graphics thread, it should only be called indirectly via
  * gfx_thread_post_framebuffer.
@@ -48,7 +53,9 @@ extern "C" {
 void gfxgl4_video_new_framebuffer(int obj_handle,
                                   unsigned fb_new_width,
                                   unsigned fb_new_height,
-                                  bool do_flip, bool interlace);
+                                  bool do_flip, bool interlace,
+                                  enum gfx_fb_raw_fmt raw_fmt,
+                                  unsigned concat);
 
 void gfxgl4_video_present(void);
 
@@ -60,6 +67,12 @@ void gfxgl4_video_toggle_filter(void);
 int gfxgl4_video_get_fb(int *obj_handle_out, unsigned *width_out,
                         unsigned *height_out, bool *flip_out);
 
+/*
+ * true if the framebuffer from gfxgl4_video_get_fb was converted on the GPU,
+ * in which case the RGBA8888 pixels are only in its texture.
+ */
+bool gfxgl4_video_fb_raw(void);
+
 // vertex position (x, y, z)
 #define OUTPUT_SLOT_VERT_POS 0
 
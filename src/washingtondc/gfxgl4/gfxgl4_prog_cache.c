@@ -0,0 +1,204 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifdef _WIN32
+#include "i_hate_windows.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../shader.h"
+#include "gfxgl4_prog_cache.h"
+
+#define PROG_CACHE_MAGIC 0x50474c57 // "WLGP"
+#define PROG_CACHE_VERSION 1
+
+// nothing the driver gives us should ever be this big
+#define PROG_CACHE_MAX_LEN (16 * 1024 * 1024)
+
+#define PROG_CACHE_PATH_LEN 4096
+
+#ifdef _WIN32
+static char const pathsep = '\\';
+#else
+static char const pathsep = '/';
+#endif
+
+struct prog_cache_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key;
+    uint32_t fmt;
+    uint64_t src_hash;
+    uint64_t drv_hash;
+    uint32_t len;
+    uint32_t pad;
+};
+
+static char *cache_dir;
+static bool cache_en;
+static uint64_t src_hash, drv_hash;
+
+static uint64_t fnv1a(uint64_t hash, char const *str) {
+    // hash the NUL terminator too so that "ab"+"c" and "a"+"bc" differ
+    do {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ull;
+    } while (*str++);
+    return hash;
+}
+
+static uint64_t fnv1a_gl_string(uint64_t hash, GLenum name) {
+    char const *str = (char const*)glGetString(name);
+    return fnv1a(hash, str ? str : "");
+}
+
+static void prog_path(char *path, unsigned key) {
+    snprintf(path, PROG_CACHE_PATH_LEN, "%s%cprog_%03x.bin",
+             cache_dir, pathsep, key);
+    path[PROG_CACHE_PATH_LEN - 1] = '\0';
+}
+
+void gfxgl4_prog_cache_set_dir(char const *dir) {
+    free(cache_dir);
+    cache_dir = dir ? strdup(dir) : NULL;
+}
+
+void gfxgl4_prog_cache_init(char const *vert_src, char const *frag_src) {
+    cache_en = false;
+    if (!cache_dir)
+        return;
+
+    GLint n_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+    if (n_formats <= 0) {
+        fprintf(stderr, "%s - driver does not support program binaries; "
+                "program cache is disabled\n", __func__);
+        return;
+    }
+
+    src_hash = fnv1a(fnv1a(0xcbf29ce484222325ull, vert_src), frag_src);
+
+    drv_hash = 0xcbf29ce484222325ull;
+    drv_hash = fnv1a_gl_string(drv_hash, GL_VENDOR);
+    drv_hash = fnv1a_gl_string(drv_hash, GL_RENDERER);
+    drv_hash = fnv1a_gl_string(drv_hash, GL_VERSION);
+
+    cache_en = true;
+}
+
+void gfxgl4_prog_cache_cleanup(void) {
+    cache_en = false;
+}
+
+bool gfxgl4_prog_cache_enabled(void) {
+    return cache_en;
+}
+
+int gfxgl4_prog_cache_load(unsigned key, struct shader *out) {
+    static char path[PROG_CACHE_PATH_LEN];
+    struct prog_cache_hdr hdr;
+    void *bin;
+    int ret = -1;
+
+    if (!cache_en)
+        return -1;
+
+    prog_path(path, key);
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return -1;
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        hdr.magic != PROG_CACHE_MAGIC || hdr.version != PROG_CACHE_VERSION ||
+        hdr.key != key || hdr.src_hash != src_hash ||
+        hdr.drv_hash != drv_hash || !hdr.len || hdr.len > PROG_CACHE_MAX_LEN)
+        goto close_file;
+
+    if (!(bin = malloc(hdr.len)))
+        goto close_file;
+
+    if (fread(bin, hdr.len, 1, fp) == 1)
+        ret = shader_load_binary(out, hdr.fmt, bin, hdr.len);
+
+    free(bin);
+
+close_file:
+    fclose(fp);
+    return ret;
+}
+
+void gfxgl4_prog_cache_store(unsigned key, struct shader const *shader) {
+    static char path[PROG_CACHE_PATH_LEN];
+    struct prog_cache_hdr hdr;
+    GLint len = 0;
+    GLsizei len_out;
+    GLenum fmt;
+    void *bin;
+
+    if (!cache_en)
+        return;
+
+    glGetProgramiv(shader->shader_prog_obj, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0 || len > PROG_CACHE_MAX_LEN || !(bin = malloc(len)))
+        return;
+
+    glGetProgramBinary(shader->shader_prog_obj, len, &len_out, &fmt, bin);
+    if (len_out <= 0)
+        goto free_bin;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = PROG_CACHE_MAGIC;
+    hdr.version = PROG_CACHE_VERSION;
+    hdr.key = key;
+    hdr.fmt = fmt;
+    hdr.src_hash = src_hash;
+    hdr.drv_hash = drv_hash;
+    hdr.len = len_out;
+
+    prog_path(path, key);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "%s - unable to open \"%s\"\n", __func__, path);
+        goto free_bin;
+    }
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        fwrite(bin, len_out, 1, fp) != 1) {
+        // don't leave a truncated file behind
+        fclose(fp);
+        remove(path);
+        goto free_bin;
+    }
+
+    fclose(fp);
+
+free_bin:
+    free(bin);
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef GFXGL4_PROG_CACHE_H_
+#define GFXGL4_PROG_CACHE_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * on-disk cache of linked shader programs (via glGetProgramBinary) so that
+ * programs which were built in a previous session don't have to be compiled
+ * again in the middle of a frame.  Each program is kept in its own file in
+ * the cache directory.
+ */
+
+/*
+ * set the directory that program binaries are kept in.  This must be called
+ * before the renderer is initialized, and the cache stays disabled if it is
+ * never called.
+ */
+void gfxgl4_prog_cache_set_dir(char const *dir);
+
+struct shader;
+
+/*
+ * the rest of these are only for the renderer.  The sources are hashed into
+ * every file so that binaries built from an older version of the shaders
+ * don't get used.
+ */
+void gfxgl4_prog_cache_init(char const *vert_src, char const *frag_src);
+void gfxgl4_prog_cache_cleanup(void);
+
+bool gfxgl4_prog_cache_enabled(void);
+
+// returns 0 on success or -1 if there's no usable binary for key
+int gfxgl4_prog_cache_load(unsigned key, struct shader *out);
+
+// the program should have been linked with shader_link_retrievable
+void gfxgl4_prog_cache_store(unsigned key, struct shader const *shader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
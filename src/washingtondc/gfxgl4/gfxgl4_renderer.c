@@ -46,8 +46,10 @@
 
 #include "gfxgl4_output.h"
 #include "gfxgl4_target.h"
+#include "gfxgl4_prog_cache.h"
 #include "../shader.h"
 #include "../shader_cache.h"
+#include "../gl_state_cache.h"
 #include "gfxgl4_renderer.h"
 #include "tex_cache.h"
 #include "../gfx_obj.h"
@@ -65,6 +67,26 @@ static GLint trans_mat_slot = -1;
 
 static GLuint vbo, vao;
 
+// index array for GFX_IL_DRAW_INDEXED_VERT_ARRAY
+static GLuint ibo;
+
+/*
+ * persistently-mapped vertex buffers (see map_vert_bufs in struct
+ * gfx_rend_if).  These are all in persist_vbo, one after the other.
+ *
+ * cur_vert_buf is the buffer the current vertex array is in; that's either
+ * vbo or persist_vbo.  cur_vert_offs is the offset of the vertex array
+ * within that buffer.
+ */
+static GLuint persist_vbo;
+static unsigned persist_n_bufs;
+static size_t persist_buf_len;
+static GLsync *persist_fences;
+
+static GLuint cur_vert_buf;
+static size_t cur_vert_offs;
+static enum gfx_vert_fmt cur_vert_fmt;
+
 static struct renderer_callbacks const *switch_table;
 
 static float clip_min, clip_max;
@@ -105,17 +127,50 @@ static GLint oit_sort_shader_color_accum_slot;
  */
 static GLuint oit_quad_vao, oit_quad_vbo;
 
+/*
+ * stencil bits used for modifier volumes.  SHADOW is set on pixels last drawn
+ * by a polygon which modifier volumes can darken.  PARITY gets toggled by
+ * every face of the volume being drawn that's in front of the geometry, so
+ * it's set on pixels inside of that volume once it's done.  INSIDE collects
+ * PARITY from every volume so far.
+ */
+#define MOD_VOL_STENCIL_PARITY 0x01
+#define MOD_VOL_STENCIL_INSIDE 0x02
+#define MOD_VOL_STENCIL_SHADOW 0x80
+
+/*
+ * draws modifier volumes, and darkens the shadowed pixels with
+ * oit_quad_vao afterwards.  Nothing ever sees the color it writes.
+ */
+static struct shader mod_vol_shader;
+static GLint mod_vol_shader_trans_mat_slot;
+
+// reference value of the SHADOW stencil writes, or -1 if that's unknown
+static GLint stencil_shadow_ref = -1;
+
 // size of each struct oit_node in the GLSL fragment shader
-#define OIT_NODE_SIZE (4 * sizeof(GLfloat) + sizeof(GLfloat) + sizeof(GLuint))
+#define OIT_NODE_SIZE (4 * sizeof(GLuint))
 
 /*
- * arbitrary limit - here we set it to 32 * typical screen dims
- *
- * TODO: when we finally implement high-resolution rendering, will probably want
- * to scale this with the screen resolution.  otherwise we'll be more likely to
- * run out of oit nodes in higher resolutions
+ * average number of transparent fragments per pixel there's room for.  The
+ * node buffer gets resized to match the render target at the start of every
+ * depth-sorted group.
  */
-#define MAX_OIT_NODES (640 * 480 * 32)
+#define OIT_NODES_PER_PIXEL 16
+static GLint max_oit_nodes;
+
+// dimensions oit_heads_tex was last allocated with
+static unsigned oit_heads_width, oit_heads_height;
+
+/*
+ * number of fragments per pixel that get sorted by the resolve shader.  Any
+ * more than that get blended in whatever order they come in underneath the
+ * OIT_K nearest ones.
+ */
+#define OIT_K 16
+
+#define OIT_K_GLSL_(k) "#define OIT_K " #k "\n"
+#define OIT_K_GLSL(k) OIT_K_GLSL_(k)
 
 #define OIT_NODE_COUNT_BINDING 0
 
@@ -152,14 +207,33 @@ static void capture_renderdoc(void) {
 struct obj_tex_meta {
     unsigned width, height;
 
-    GLenum format;   // internalformat and format parameter for glTexImage2D
-    GLenum dat_type; // type parameter for glTexImage2D
+    // the GL texture is scale times larger than width x height
+    unsigned scale;
+
+    GLenum format;   // format parameter for glTexSubImage2D
+    GLenum dat_type; // type parameter for glTexSubImage2D
 
     /*
      * if this is set, the OpenGL texture object will be re-initialized
      * regardless of the other parameters.
      */
     bool dirty;
+
+    /*
+     * immutable storage allocated by gfxgl4_renderer_tex_storage.
+     * storage_fmt is 0 if the texture doesn't have any yet.
+     */
+    GLenum storage_fmt;
+    unsigned storage_width, storage_height, storage_levels;
+
+    /*
+     * index into tex_arrays if the obj's texture lives in a layer of a texture
+     * array instead of in its own texture object, or -1.
+     */
+    int tex_array;
+    unsigned tex_layer;
+
+    struct gl_tex_params params;
 };
 
 // one texture object for each gfx_obj
@@ -167,6 +241,212 @@ static GLuint obj_tex_array[GFX_OBJ_COUNT];
 
 static struct obj_tex_meta obj_tex_meta_array[GFX_OBJ_COUNT];
 
+/*
+ * when gfx.rend.tex-arrays is enabled, small textures which have the same
+ * dimensions, format and mip chain get packed into the layers of a shared
+ * GL_TEXTURE_2D_ARRAY.  Switching between them only changes the tex_layer
+ * uniform instead of rebinding textures.  Texture parameters belong to the
+ * whole array, so they're cached per-array.
+ */
+#define TEX_ARRAY_MAX_SIDE 256
+#define TEX_ARRAY_N_LAYERS 32
+#define TEX_ARRAY_COUNT 64
+
+struct tex_array {
+    GLuint tex; // 0 if this slot is unused
+    GLenum fmt;
+    unsigned width, height, n_levels;
+    uint32_t layers_used; // one bit per layer
+    struct gl_tex_params params;
+};
+
+static bool tex_arrays_en;
+static struct tex_array tex_arrays[TEX_ARRAY_COUNT];
+
+/*
+ * GL state set by GFX_IL_SET_REND_PARAM and the draw commands.  cur_shader_ent
+ * is the shader_cache_ent of the bound program, or NULL if that's unknown.
+ * last_shader_ent is the last one that was bound, which might not be anymore.
+ */
+static struct gl_state_cache gl_state;
+static struct shader_cache_ent *cur_shader_ent, *last_shader_ent;
+
+// set if the last polygon header was for punch-through polygons
+static bool pt_mode;
+
+static struct gl_uniform_cache *uniform_cache(unsigned slot) {
+    if (cur_shader_ent)
+        return cur_shader_ent->uniforms + slot;
+
+    // the uniform is going to whatever is bound, which might be this one
+    if (last_shader_ent)
+        last_shader_ent->uniforms[slot].valid = false;
+    return NULL;
+}
+
+/*
+ * GPU timestamps.  A timestamp query gets issued every time the renderer moves
+ * on to a different phase of the frame, and the time between one timestamp and
+ * the next is charged to the phase that the first one started.  The two sets
+ * of queries trade off every frame so that one frame's results can be read
+ * back while the next frame is being rendered.  If the results still aren't
+ * ready by the time that set comes around again then they get thrown away
+ * instead of waiting on the GPU.
+ */
+#define GPU_TIMER_SETS 2
+#define GPU_TIMER_MAX_STAMPS 64
+#define GPU_PHASE_NONE RENDERER_GPU_PHASE_COUNT
+
+struct gpu_timer_set {
+    GLuint queries[GPU_TIMER_MAX_STAMPS];
+
+    // the phase which each timestamp starts
+    unsigned char phases[GPU_TIMER_MAX_STAMPS];
+
+    unsigned n_stamps;
+};
+
+static struct gpu_timer_set gpu_timer_sets[GPU_TIMER_SETS];
+static unsigned gpu_timer_cur, gpu_phase = GPU_PHASE_NONE;
+static bool gpu_ms_valid;
+static bool gpu_timing = true;
+static double gpu_ms[RENDERER_GPU_PHASE_COUNT];
+
+static void gpu_timer_init(void) {
+    unsigned set_no;
+    for (set_no = 0; set_no < GPU_TIMER_SETS; set_no++) {
+        glGenQueries(GPU_TIMER_MAX_STAMPS, gpu_timer_sets[set_no].queries);
+        gpu_timer_sets[set_no].n_stamps = 0;
+    }
+    gpu_timer_cur = 0;
+    gpu_phase = GPU_PHASE_NONE;
+    gpu_ms_valid = false;
+}
+
+static void gpu_timer_cleanup(void) {
+    unsigned set_no;
+    for (set_no = 0; set_no < GPU_TIMER_SETS; set_no++)
+        glDeleteQueries(GPU_TIMER_MAX_STAMPS, gpu_timer_sets[set_no].queries);
+    memset(gpu_timer_sets, 0, sizeof(gpu_timer_sets));
+}
+
+static void gpu_timer_phase(unsigned phase) {
+    if (!gpu_timing || phase == gpu_phase)
+        return;
+
+    /*
+     * the last timestamp is saved for the end of the frame.  If the frame
+     * runs out before that, everything left gets charged to the current
+     * phase.
+     */
+    struct gpu_timer_set *set = gpu_timer_sets + gpu_timer_cur;
+    unsigned max_stamps = GPU_TIMER_MAX_STAMPS;
+    if (phase != GPU_PHASE_NONE)
+        max_stamps--;
+    if (set->n_stamps >= max_stamps)
+        return;
+
+    glQueryCounter(set->queries[set->n_stamps], GL_TIMESTAMP);
+    set->phases[set->n_stamps++] = phase;
+    gpu_phase = phase;
+}
+
+static void gpu_timer_collect(struct gpu_timer_set *set) {
+    unsigned n_stamps = set->n_stamps;
+    set->n_stamps = 0;
+    if (n_stamps < 2)
+        return;
+
+    // timestamps finish in order, so if the last one is ready they all are
+    GLint avail = 0;
+    glGetQueryObjectiv(set->queries[n_stamps - 1],
+                       GL_QUERY_RESULT_AVAILABLE, &avail);
+    if (!avail)
+        return;
+
+    double ms[RENDERER_GPU_PHASE_COUNT] = { 0 };
+    GLuint64 prev;
+    glGetQueryObjectui64v(set->queries[0], GL_QUERY_RESULT, &prev);
+
+    unsigned idx;
+    for (idx = 1; idx < n_stamps; idx++) {
+        GLuint64 stamp;
+        glGetQueryObjectui64v(set->queries[idx], GL_QUERY_RESULT, &stamp);
+        unsigned phase = set->phases[idx - 1];
+        if (phase != GPU_PHASE_NONE)
+            ms[phase] += (stamp - prev) / 1000000.0;
+        prev = stamp;
+    }
+
+    memcpy(gpu_ms, ms, sizeof(gpu_ms));
+    gpu_ms_valid = true;
+}
+
+// call this after the frame has been presented
+static void gpu_timer_end_frame(void) {
+    if (!gpu_timing)
+        return;
+    gpu_timer_phase(GPU_PHASE_NONE);
+    gpu_timer_cur = (gpu_timer_cur + 1) % GPU_TIMER_SETS;
+    gpu_timer_collect(gpu_timer_sets + gpu_timer_cur);
+}
+
+/*
+ * this can get called before the renderer is initialized.  Results from
+ * before timing was turned off get thrown away.
+ */
+static void set_gpu_timing(bool enable) {
+    if (enable == gpu_timing)
+        return;
+
+    unsigned set_no;
+    for (set_no = 0; set_no < GPU_TIMER_SETS; set_no++)
+        gpu_timer_sets[set_no].n_stamps = 0;
+    gpu_phase = GPU_PHASE_NONE;
+    gpu_ms_valid = false;
+    gpu_timing = enable;
+}
+
+static void get_stat(struct renderer_stat *stat) {
+    stat->gl_calls_issued = gl_state.last.issued;
+    stat->gl_calls_skipped = gl_state.last.skipped;
+    stat->gpu_ms_valid = gpu_ms_valid;
+    memcpy(stat->gpu_ms, gpu_ms, sizeof(stat->gpu_ms));
+}
+
+/*
+ * buffer texture holding the palette for GFX_TEX_FMT_PAL_INDEX16 textures.
+ * It stays bound to PALETTE_TEX_UNIT.
+ */
+#define PALETTE_TEX_UNIT 1
+static GLuint palette_buf, palette_tex;
+
+/*
+ * ring of pixel-unpack memory that texture and framebuffer uploads get staged
+ * in.  Each upload takes the next unused range.  Uploads too big for the ring
+ * come from client memory.
+ *
+ * When GL_ARB_buffer_storage is available the ring stays mapped the whole
+ * time.  It's split into TEX_UPLOAD_SEGS segments, and a fence goes in after
+ * the last upload out of a segment, so the next time around the ring only has
+ * to wait on that fence instead of remapping anything.  Otherwise every
+ * upload maps its own range, and the whole ring gets orphaned when it runs
+ * out so the driver doesn't have to wait on textures that are still being
+ * read.
+ */
+#define TEX_UPLOAD_RING_LEN (8 * 1024 * 1024)
+#define TEX_UPLOAD_SEGS 4
+#define TEX_UPLOAD_SEG_LEN (TEX_UPLOAD_RING_LEN / TEX_UPLOAD_SEGS)
+#define TEX_UPLOAD_ALIGN 64
+static GLuint tex_upload_pbo;
+static size_t tex_upload_offs;
+static char *tex_upload_ptr; // NULL unless the ring is persistently mapped
+static GLsync tex_upload_fences[TEX_UPLOAD_SEGS];
+static unsigned tex_upload_seg; // TEX_UPLOAD_SEGS right after wrapping around
+
+static void tex_upload_ring_init(void);
+static void tex_upload_ring_cleanup(void);
+
 static DEF_ERROR_INT_ATTR(gfx_tex_fmt);
 
 static GLenum tex_fmt_to_data_type(enum gfx_tex_fmt gfx_fmt);
@@ -236,11 +516,13 @@ static struct oit_state {
     bool enabled;
 } oit_state;
 
-// converts pixels from ARGB 4444 to RGBA 4444
-static void render_conv_argb_4444(uint16_t *pixels, size_t n_pixels);
+// copies pixels from ARGB 4444 in src to RGBA 4444 in dst
+static void render_conv_argb_4444(uint16_t *dst, uint16_t const *src,
+                                  size_t n_pixels);
 
-// converts pixels from ARGB 1555 to ABGR1555
-static void render_conv_argb_1555(uint16_t *pixels, size_t n_pizels);
+// copies pixels from ARGB 1555 in src to ABGR1555 in dst
+static void render_conv_argb_1555(uint16_t *dst, uint16_t const *src,
+                                  size_t n_pixels);
 
 static void opengl_render_init(void);
 static void opengl_render_cleanup(void);
@@ -262,20 +544,40 @@ static void gfxgl4_renderer_grab_framebuffer(struct gfx_il_inst *cmd);
 static void gfxgl4_renderer_post_framebuffer(struct gfx_il_inst *cmd);
 static void gfxgl4_renderer_begin_rend(struct gfx_il_inst *cmd);
 static void gfxgl4_renderer_end_rend(struct gfx_il_inst *cmd);
+static void gfxgl4_renderer_set_palette(struct gfx_il_inst *cmd);
+static void gfxgl4_renderer_draw_mod_vol(struct gfx_il_inst *cmd);
+static void gfxgl4_renderer_apply_mod_vol(struct gfx_il_inst *cmd);
 
 static void
 gfxgl4_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd);
+static bool gl_state_preserved(enum gfx_il op);
+static void invalidate_gl_state(void);
 
 static void do_set_rend_param(struct gfx_rend_param const *param);
 static void
 gfxgl4_renderer_draw_vert_array(struct gfx_il_inst *cmd);
+static void
+gfxgl4_renderer_draw_indexed_vert_array(struct gfx_il_inst *cmd);
+static void gfxgl4_renderer_set_index_array(struct gfx_il_inst *cmd);
+static void draw_setup(void);
+static void draw_teardown(void);
+static void get_trans_mat(GLfloat *trans_mat);
+static void set_user_clip_uniform(void);
 
 static void set_callbacks(struct renderer_callbacks const *callbacks);
 
+static void *gfxgl4_renderer_map_vert_bufs(unsigned n_bufs, size_t buf_len);
+static void gfxgl4_renderer_unmap_vert_bufs(void);
+static bool gfxgl4_renderer_vert_buf_done(unsigned buf_no, bool wait);
+static void gfxgl4_renderer_fence_vert_buf(struct gfx_il_inst *cmd);
+
 struct gfx_rend_if const gfxgl4_rend_if = {
     .init = opengl_render_init,
     .cleanup = opengl_render_cleanup,
-    .exec_gfx_il = gfxgl4_renderer_exec_gfx_il
+    .exec_gfx_il = gfxgl4_renderer_exec_gfx_il,
+    .map_vert_bufs = gfxgl4_renderer_map_vert_bufs,
+    .unmap_vert_bufs = gfxgl4_renderer_unmap_vert_bufs,
+    .vert_buf_done = gfxgl4_renderer_vert_buf_done
 };
 
 struct renderer const gfxgl4_renderer = {
@@ -283,7 +585,9 @@ struct renderer const gfxgl4_renderer = {
     .set_callbacks = set_callbacks,
     .video_present = gfxgl4_video_present,
     .toggle_video_filter = gfxgl4_video_toggle_filter,
-    .capture_renderdoc = capture_renderdoc
+    .capture_renderdoc = capture_renderdoc,
+    .get_stat = get_stat,
+    .set_gpu_timing = set_gpu_timing
 };
 
 static void init_renderdoc_api(void);
@@ -298,6 +602,7 @@ static char const * const pvr2_ta_vert_glsl =
     "#ifdef TEX_ENABLE\n"
     "layout (location = 3) in vec2 tex_coord_in;\n"
     "uniform mat2 tex_matrix;\n"
+    "uniform vec2 tex_offset;\n"
     "#endif\n"
 
     "uniform mat4 trans_mat;\n"
@@ -315,7 +620,7 @@ static char const * const pvr2_ta_vert_glsl =
      */
     "void tex_transform() {\n"
     "#ifdef TEX_ENABLE\n"
-    "    st = tex_matrix * tex_coord_in * vert_pos.z;\n"
+    "    st = (tex_matrix * tex_coord_in + tex_offset) * vert_pos.z;\n"
     "#endif\n"
     "}\n"
     "\n"
@@ -354,14 +659,11 @@ static char const * const pvr2_ta_vert_glsl =
 #define OIT_NODE_GLSL_DEF                                               \
     "#define OIT_NODE_INVALID 0xffffffff\n"                             \
                                                                         \
-    "struct oit_pixel {\n"                                              \
-    "    vec4 color;\n"                                                 \
-    "    float depth;\n"                                                \
-    "    unsigned int src_blend_factor, dst_blend_factor;\n"            \
-    "};\n"                                                              \
-                                                                        \
+    /* color is packUnorm4x8, blend_factors is src | (dst << 8) */     \
     "struct oit_node {\n"                                               \
-    "    struct oit_pixel pix;\n"                                       \
+    "    unsigned int color;\n"                                         \
+    "    float depth;\n"                                                \
+    "    unsigned int blend_factors;\n"                                 \
     "    unsigned int next_node;\n"                                     \
     "};\n"                                                              \
                                                                         \
@@ -399,9 +701,56 @@ static char const * const pvr2_ta_frag_glsl =
 
     "#ifdef TEX_ENABLE\n"
     "in vec2 st;\n"
+
+    "#ifdef TEX_ARRAY\n"
+    "uniform float tex_layer;\n"
+    "#define TEX_COORD(coord) vec3(coord, tex_layer)\n"
+    "#else\n"
+    "#define TEX_COORD(coord) (coord)\n"
+    "#endif\n"
+
+    "#ifdef TEX_PALETTE\n"
+    /*
+     * bound_tex holds indices into palette_tex.  Integer textures can't be
+     * filtered, so bilinear filtering is done here on the palette colors.
+     * palette_tex is stored ARGB8888, so it gets swizzled on the way out.
+     */
+    "#ifdef TEX_ARRAY\n"
+    "uniform usampler2DArray bound_tex;\n"
+    "#else\n"
+    "uniform usampler2D bound_tex;\n"
+    "#endif\n"
+    "uniform samplerBuffer palette_tex;\n"
+
+    "vec4 palette_lookup(uint idx) {\n"
+    "    return texelFetch(palette_tex, int(idx)).bgra;\n"
+    "}\n"
+
+    "vec4 sample_tex(vec2 coord) {\n"
+    "#ifdef TEX_PALETTE_LINEAR\n"
+    "    uvec4 idx = textureGather(bound_tex, TEX_COORD(coord), 0);\n"
+    "    vec2 weight =\n"
+    "        fract(coord * vec2(textureSize(bound_tex, 0).xy) - 0.5);\n"
+    "    vec4 top = mix(palette_lookup(idx.w), palette_lookup(idx.z), weight.x);\n"
+    "    vec4 bot = mix(palette_lookup(idx.x), palette_lookup(idx.y), weight.x);\n"
+    "    return mix(top, bot, weight.y);\n"
+    "#else\n"
+    "    return palette_lookup(texture(bound_tex, TEX_COORD(coord)).r);\n"
+    "#endif\n"
+    "}\n"
+    "#else\n"
+    "#ifdef TEX_ARRAY\n"
+    "uniform sampler2DArray bound_tex;\n"
+    "#else\n"
     "uniform sampler2D bound_tex;\n"
     "#endif\n"
 
+    "vec4 sample_tex(vec2 coord) {\n"
+    "    return texture(bound_tex, TEX_COORD(coord));\n"
+    "}\n"
+    "#endif\n"
+    "#endif\n"
+
     "#ifdef USER_CLIP_ENABLE\n"
     /*
      * user_clip.x - x_min
@@ -443,7 +792,7 @@ static char const * const pvr2_ta_frag_glsl =
     "     */\n"
     "    vec4 base_color = vert_base_color / w_coord;\n"
     "    vec4 offs_color = vert_offs_color / w_coord;\n"
-    "    vec4 tex_color = texture(bound_tex, st / w_coord);\n"
+    "    vec4 tex_color = sample_tex(st / w_coord);\n"
     "    vec4 color;\n"
     // TODO: is the offset alpha color supposed to be used for anything?
     "#if TEX_INST == TEX_INST_DECAL\n"
@@ -494,10 +843,10 @@ static char const * const pvr2_ta_frag_glsl =
     "#ifdef OIT_ENABLE\n"
     "    unsigned int node_idx = atomicCounterIncrement(node_count);\n"
     "    if (node_idx < MAX_OIT_NODES) {\n"
-    "        oit_nodes[node_idx].pix.color = color;\n"
-    "        oit_nodes[node_idx].pix.depth = gl_FragCoord.z;\n"
-    "        oit_nodes[node_idx].pix.src_blend_factor = src_blend_factor;\n"
-    "        oit_nodes[node_idx].pix.dst_blend_factor = dst_blend_factor;\n"
+    "        oit_nodes[node_idx].color = packUnorm4x8(color);\n"
+    "        oit_nodes[node_idx].depth = gl_FragCoord.z;\n"
+    "        oit_nodes[node_idx].blend_factors =\n"
+    "            uint(src_blend_factor) | (uint(dst_blend_factor) << 8);\n"
 
     "        oit_nodes[node_idx].next_node =\n"
     "            imageAtomicExchange(oit_heads, ivec2(gl_FragCoord.xy), node_idx);\n"
@@ -515,6 +864,7 @@ static char const * const oit_sort_vert_shader =
     "void main() { gl_Position = vert_pos; }\n";
 
 static char const * const oit_sort_frag_shader =
+    OIT_K_GLSL(OIT_K)
     OIT_NODE_GLSL_DEF
 
     "out vec4 out_color;\n"
@@ -566,62 +916,119 @@ static char const * const oit_sort_frag_shader =
     "    }\n"
     "}\n"
 
-    "void swap_oit_nodes(uint node1, uint node2) {\n"
-    "    oit_pixel pix_tmp = oit_nodes[node1].pix;\n"
-    "    oit_nodes[node1].pix = oit_nodes[node2].pix;\n"
-    "    oit_nodes[node2].pix = pix_tmp;\n"
-    "}\n"
-
+    "struct oit_pixel {\n"
+    "    vec4 color;\n"
+    "    float depth;\n"
+    "    unsigned int blend_factors;\n"
+    "};\n"
 
-    "// it's my favorite algorithm, the insertion sort!\n"
-    "void sort_list(unsigned int index) {\n"
-    "    unsigned int src_idx = index;"
-    "    while (src_idx != OIT_NODE_INVALID) {\n"
-    "        unsigned int cmp_idx = oit_nodes[src_idx].next_node;\n"
-    "        while (cmp_idx != OIT_NODE_INVALID) {\n"
-    "            if (oit_nodes[cmp_idx].pix.depth <= oit_nodes[src_idx].pix.depth)\n"
-    "                swap_oit_nodes(src_idx, cmp_idx);\n"
-    "            cmp_idx = oit_nodes[cmp_idx].next_node;\n"
-    "        }\n"
-    "        src_idx = oit_nodes[src_idx].next_node;\n"
-    "    }\n"
+    "vec4 blend_pixel(oit_pixel pix, vec4 dst) {\n"
+    "    unsigned int src_factor = pix.blend_factors & 0xffu;\n"
+    "    unsigned int dst_factor = pix.blend_factors >> 8u;\n"
+    "    vec4 src_mul = eval_src_blend_factor(src_factor, pix.color, dst);\n"
+    "    vec4 dst_mul = eval_dst_blend_factor(dst_factor, pix.color, dst);\n"
+    "    return clamp(src_mul * pix.color + dst_mul * dst, 0, 1);\n"
     "}\n"
 
     "void main() {\n"
-    "    unsigned int head = imageLoad(oit_heads, ivec2(gl_FragCoord.xy))[0];\n"
-    "    sort_list(head);\n"
-
-    "    unsigned int cur_node = head;\n"
-    "    vec4 color = texture(color_accum, gl_FragCoord.xy / textureSize(color_accum, 0));\n"
-
-    /*
-     * XXX this is actually wrong because gl_FragCoord.z samples from  the
-     * fullscreen quad, *not* the original fragment value.  The reason why that
-     * doesn't matter is because we discard when there are no transparent pixels
-     * to render, which will preserve the original depth value.
-     */
-    "    float depth = gl_FragCoord.z;\n"
+    "    unsigned int cur_node = imageLoad(oit_heads, ivec2(gl_FragCoord.xy))[0];\n"
 
     "    // skip fragments that have no transparent pixels to render\n"
     "    if (cur_node == OIT_NODE_INVALID)\n"
     "        discard;\n"
 
+    "    vec4 color = texture(color_accum, gl_FragCoord.xy / textureSize(color_accum, 0));\n"
+
+    /*
+     * the OIT_K nearest fragments are kept here sorted from farthest to
+     * nearest.  Whenever a nearer one comes along when the array is full,
+     * the farthest one gets blended right away and the new one takes its
+     * place.
+     *
+     * the list goes from newest to oldest, and older fragments need to be
+     * blended first when depths are equal, so ties put the new fragment in
+     * front of the old ones.
+     */
+    "    oit_pixel frags[OIT_K];\n"
+    "    int n_frags = 0;\n"
     "    while (cur_node != OIT_NODE_INVALID) {\n"
-    "        oit_pixel pix_in = oit_nodes[cur_node].pix;\n"
-    "        vec4 color_in = pix_in.color;\n"
-    "        vec4 src_factor = eval_src_blend_factor(pix_in.src_blend_factor, color_in, color);\n"
-    "        vec4 dst_factor = eval_dst_blend_factor(pix_in.dst_blend_factor, color_in, color);\n"
-    "        color = clamp(src_factor * color_in + dst_factor * color, 0, 1);\n"
-    "        depth = oit_nodes[cur_node].pix.depth;\n"
+    "        oit_pixel pix;\n"
+    "        pix.color = unpackUnorm4x8(oit_nodes[cur_node].color);\n"
+    "        pix.depth = oit_nodes[cur_node].depth;\n"
+    "        pix.blend_factors = oit_nodes[cur_node].blend_factors;\n"
     "        cur_node = oit_nodes[cur_node].next_node;\n"
+
+    "        int idx;\n"
+    "        if (n_frags < OIT_K) {\n"
+    "            for (idx = n_frags; idx > 0 && frags[idx - 1].depth >= pix.depth; idx--)\n"
+    "                frags[idx] = frags[idx - 1];\n"
+    "            frags[idx] = pix;\n"
+    "            n_frags++;\n"
+    "        } else if (pix.depth <= frags[0].depth) {\n"
+    "            color = blend_pixel(pix, color);\n"
+    "        } else {\n"
+    "            color = blend_pixel(frags[0], color);\n"
+    "            for (idx = 0; idx < OIT_K - 1 && frags[idx + 1].depth < pix.depth; idx++)\n"
+    "                frags[idx] = frags[idx + 1];\n"
+    "            frags[idx] = pix;\n"
+    "        }\n"
     "    }\n"
-    "    gl_FragDepth = depth;\n"
+
+    "    int idx;\n"
+    "    for (idx = 0; idx < n_frags; idx++)\n"
+    "        color = blend_pixel(frags[idx], color);\n"
+
+    /*
+     * gl_FragCoord.z would be the depth of the fullscreen quad, so this uses
+     * the nearest transparent fragment instead.
+     */
+    "    gl_FragDepth = frags[n_frags - 1].depth;\n"
     "    out_color = color;\n"
     "}"
     ;
 
+static char const * const mod_vol_vert_shader =
+    "layout (location = 0) in vec4 vert_pos;\n"
+    "uniform mat4 trans_mat;\n"
+    "void main() { gl_Position = trans_mat * vert_pos; }\n";
+
+static char const * const mod_vol_frag_shader =
+    "out vec4 out_color;\n"
+    "void main() { out_color = vec4(1.0, 1.0, 1.0, 1.0); }\n";
+
+static void find_uniform_slots(struct shader_cache_ent *ent) {
+    /*
+     * not all of these are valid for every shader.  This is alright because
+     * glGetUniformLocation will return -1 for invalid uniform handles.
+     * When -1 is passed as a uniform location to glUniform*, it will silently
+     * fail without error.
+     */
+    ent->slots[SHADER_CACHE_SLOT_BOUND_TEX] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "bound_tex");
+    ent->slots[SHADER_CACHE_SLOT_TEX_TRANSFORM] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "tex_matrix");
+    ent->slots[SHADER_CACHE_SLOT_TEX_OFFSET] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "tex_offset");
+    ent->slots[SHADER_CACHE_SLOT_PT_ALPHA_REF] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "pt_alpha_ref");
+    ent->slots[SHADER_CACHE_SLOT_TRANS_MAT] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "trans_mat");
+    ent->slots[SHADER_CACHE_SLOT_USER_CLIP] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "user_clip");
+    ent->slots[SHADER_CACHE_SLOT_MAX_OIT_NODES] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "MAX_OIT_NODES");
+    ent->slots[SHADER_CACHE_SLOT_SRC_BLEND_FACTOR] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "src_blend_factor");
+    ent->slots[SHADER_CACHE_SLOT_DST_BLEND_FACTOR] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "dst_blend_factor");
+    ent->slots[SHADER_CACHE_SLOT_PALETTE_TEX] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "palette_tex");
+    ent->slots[SHADER_CACHE_SLOT_TEX_LAYER] =
+        glGetUniformLocation(ent->shader.shader_prog_obj, "tex_layer");
+}
+
 static struct shader_cache_ent* create_shader(shader_key key) {
-    #define PREAMBLE_LEN 256
+    #define PREAMBLE_LEN 512
     static char preamble[PREAMBLE_LEN];
     bool tex_en = key & SHADER_KEY_TEX_ENABLE_BIT;
     bool color_en = key & SHADER_KEY_COLOR_ENABLE_BIT;
@@ -630,6 +1037,9 @@ static struct shader_cache_ent* create_shader(shader_key key) {
     bool user_clip_en = key & SHADER_KEY_USER_CLIP_ENABLE_BIT;
     bool user_clip_invert = key & SHADER_KEY_USER_CLIP_INVERT_BIT;
     bool oit_en = key & SHADER_KEY_OIT_BIT;
+    bool tex_palette = key & SHADER_KEY_TEX_PALETTE_BIT;
+    bool tex_palette_linear = key & SHADER_KEY_TEX_PALETTE_LINEAR_BIT;
+    bool tex_array = key & SHADER_KEY_TEX_ARRAY_BIT;
 
     char const *tex_inst_str = "";
     if (tex_en) {
@@ -656,8 +1066,12 @@ static struct shader_cache_ent* create_shader(shader_key key) {
         }
     }
 
-    snprintf(preamble, PREAMBLE_LEN, "%s%s%s%s%s%s%s",
+    snprintf(preamble, PREAMBLE_LEN, "%s%s%s%s%s%s%s%s%s%s",
              tex_en ? "#define TEX_ENABLE\n" : "",
+             tex_en && tex_array ? "#define TEX_ARRAY\n" : "",
+             tex_en && tex_palette ? "#define TEX_PALETTE\n" : "",
+             tex_en && tex_palette_linear ?
+             "#define TEX_PALETTE_LINEAR\n" : "",
              color_en ? "#define COLOR_ENABLE\n" : "",
              punchthrough ? "#define PUNCH_THROUGH_ENABLE\n" : "",
              user_clip_en ? "#define USER_CLIP_ENABLE\n" : "",
@@ -678,34 +1092,48 @@ static struct shader_cache_ent* create_shader(shader_key key) {
                                    pvr2_ta_vert_glsl, preamble);
     shader_load_frag_with_preamble(&ent->shader, SHADER_VER_430,
                                    pvr2_ta_frag_glsl, preamble);
-    shader_link(&ent->shader);
+    if (gfxgl4_prog_cache_enabled()) {
+        shader_link_retrievable(&ent->shader);
+        gfxgl4_prog_cache_store(key, &ent->shader);
+    } else {
+        shader_link(&ent->shader);
+    }
 
-    /*
-     * not all of these are valid for every shader.  This is alright because
-     * glGetUniformLocation will return -1 for invalid uniform handles.
-     * When -1 is passed as a uniform location to glUniform*, it will silently
-     * fail without error.
-     */
-    ent->slots[SHADER_CACHE_SLOT_BOUND_TEX] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "bound_tex");
-    ent->slots[SHADER_CACHE_SLOT_TEX_TRANSFORM] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "tex_matrix");
-    ent->slots[SHADER_CACHE_SLOT_PT_ALPHA_REF] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "pt_alpha_ref");
-    ent->slots[SHADER_CACHE_SLOT_TRANS_MAT] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "trans_mat");
-    ent->slots[SHADER_CACHE_SLOT_USER_CLIP] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "user_clip");
-    ent->slots[SHADER_CACHE_SLOT_MAX_OIT_NODES] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "MAX_OIT_NODES");
-    ent->slots[SHADER_CACHE_SLOT_SRC_BLEND_FACTOR] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "src_blend_factor");
-    ent->slots[SHADER_CACHE_SLOT_DST_BLEND_FACTOR] =
-        glGetUniformLocation(ent->shader.shader_prog_obj, "dst_blend_factor");
+    find_uniform_slots(ent);
 
     return ent;
 }
 
+/*
+ * pull every program that a previous session left in the program cache into
+ * the shader cache so that none of them have to be compiled mid-frame.
+ */
+static void preload_shaders(void) {
+    shader_key key;
+    unsigned n_loaded = 0;
+
+    if (!gfxgl4_prog_cache_enabled())
+        return;
+
+    for (key = 0; key < SHADER_KEY_COUNT; key++) {
+        struct shader prog;
+        if (gfxgl4_prog_cache_load(key, &prog) != 0)
+            continue;
+
+        struct shader_cache_ent *ent = shader_cache_add_ent(&shader_cache, key);
+        if (!ent) {
+            shader_cleanup(&prog);
+            break;
+        }
+        ent->shader = prog;
+        find_uniform_slots(ent);
+        n_loaded++;
+    }
+
+    printf("OpenGL renderer: loaded %u programs from the program cache\n",
+           n_loaded);
+}
+
 static DEF_ERROR_INT_ATTR(shader_cache_key)
 
 static struct shader_cache_ent* fetch_shader(shader_key key) {
@@ -783,16 +1211,30 @@ static void opengl_render_init(void) {
     gfx_config_oit_enable();
 
     shader_cache_init(&shader_cache);
+    gfxgl4_prog_cache_init(pvr2_ta_vert_glsl, pvr2_ta_frag_glsl);
+    preload_shaders();
+
+    gpu_timer_init();
 
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+    cur_vert_buf = vbo;
+    cur_vert_offs = 0;
+
+    // GFX_IL_RESTART_IDX is the fixed restart index for GL_UNSIGNED_INT
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
     glGenTextures(GFX_OBJ_COUNT, obj_tex_array);
 
     memset(obj_tex_meta_array, 0, sizeof(obj_tex_meta_array));
 
+    gl_state_init(&gl_state);
+    cur_shader_ent = last_shader_ent = NULL;
+
     unsigned tex_no;
     for (tex_no = 0; tex_no < GFX_OBJ_COUNT; tex_no++) {
         obj_tex_meta_array[tex_no].dirty = true;
+        obj_tex_meta_array[tex_no].tex_array = -1;
 
         /*
          * unconditionally set the texture wrapping mode to repeat.
@@ -808,6 +1250,24 @@ static void opengl_render_init(void) {
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
+    tex_arrays_en = false;
+    cfg_get_bool("gfx.rend.tex-arrays", &tex_arrays_en);
+    memset(tex_arrays, 0, sizeof(tex_arrays));
+
+    tex_upload_ring_init();
+
+    glGenBuffers(1, &palette_buf);
+    glBindBuffer(GL_TEXTURE_BUFFER, palette_buf);
+    glBufferData(GL_TEXTURE_BUFFER, GFX_PALETTE_LEN * sizeof(uint32_t),
+                 NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &palette_tex);
+    glActiveTexture(GL_TEXTURE0 + PALETTE_TEX_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, palette_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, palette_buf);
+    glActiveTexture(GL_TEXTURE0);
+
     glClear(GL_COLOR_BUFFER_BIT);
 
     // initialize oit-related things
@@ -817,9 +1277,9 @@ static void opengl_render_init(void) {
     glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint),
                  NULL, GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, oit_buffers[OIT_BUFFER_NODES_SSBO]);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, OIT_NODE_SIZE * MAX_OIT_NODES,
-                 NULL, GL_DYNAMIC_DRAW);
+    // the node buffer gets allocated by gfxgl4_renderer_begin_sort_mode
+    max_oit_nodes = 0;
+    oit_heads_width = oit_heads_height = 0;
 
     glGenTextures(1, &oit_heads_tex);
     glGenTextures(1, &oit_color_tex);
@@ -830,6 +1290,12 @@ static void opengl_render_init(void) {
     oit_sort_shader_color_accum_slot =
         glGetUniformLocation(oit_sort_shader.shader_prog_obj, "color_accum");
 
+    shader_load_vert(&mod_vol_shader, SHADER_VER_430, mod_vol_vert_shader);
+    shader_load_frag(&mod_vol_shader, SHADER_VER_430, mod_vol_frag_shader);
+    shader_link(&mod_vol_shader);
+    mod_vol_shader_trans_mat_slot =
+        glGetUniformLocation(mod_vol_shader.shader_prog_obj, "trans_mat");
+
     GLfloat quad_dat[16] = {
         -1.0f, -1.0f, 0.0f, 1.0f,
         1.0f, -1.0f, 0.0f, 1.0f,
@@ -847,9 +1313,12 @@ static void opengl_render_init(void) {
 }
 
 static void opengl_render_cleanup(void) {
+    gpu_timer_cleanup();
+
     glDeleteVertexArrays(1, &oit_quad_vao);
     glDeleteBuffers(1, &oit_quad_vbo);
 
+    shader_cleanup(&mod_vol_shader);
     shader_cleanup(&oit_sort_shader);
 
     glDeleteTextures(1, &oit_color_tex);
@@ -858,17 +1327,41 @@ static void opengl_render_cleanup(void) {
     glDeleteBuffers(N_OIT_BUFFERS, oit_buffers);
     memset(oit_buffers, 0, sizeof(oit_buffers));
 
+    glDeleteTextures(1, &palette_tex);
+    glDeleteBuffers(1, &palette_buf);
+    palette_tex = 0;
+    palette_buf = 0;
+
+    tex_upload_ring_cleanup();
+
+    unsigned arr_idx;
+    for (arr_idx = 0; arr_idx < TEX_ARRAY_COUNT; arr_idx++)
+        if (tex_arrays[arr_idx].tex)
+            glDeleteTextures(1, &tex_arrays[arr_idx].tex);
+    memset(tex_arrays, 0, sizeof(tex_arrays));
+
+    if (persist_vbo)
+        gfxgl4_renderer_unmap_vert_bufs();
+
+    gfxgl4_target_cleanup();
+
     glDeleteTextures(GFX_OBJ_COUNT, obj_tex_array);
+    glDeleteBuffers(1, &ibo);
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
 
     shader_cache_cleanup(&shader_cache);
+    gfxgl4_prog_cache_cleanup();
+    cur_shader_ent = last_shader_ent = NULL;
 
     vao = 0;
     vbo = 0;
+    ibo = 0;
+    cur_vert_buf = 0;
     memset(obj_tex_array, 0, sizeof(obj_tex_array));
 
     gfxgl4_tex_cache_cleanup();
+    gfx_obj_pool_drain();
 
     cleanup_renderdoc_api();
 
@@ -877,6 +1370,305 @@ static void opengl_render_cleanup(void) {
 
 static DEF_ERROR_INT_ATTR(max_length);
 
+// number of pixels in the texture, including every level of the mip chain
+static size_t tex_chain_pixels(struct gfxgl4_tex const *tex) {
+    size_t n_pix = tex->width * tex->height;
+    if (tex->mipmap) {
+        size_t side;
+        for (side = tex->width / 2; side; side /= 2)
+            n_pix += side * side;
+    }
+    return n_pix;
+}
+
+// give up obj_no's layer of a texture array, if it has one
+static void tex_array_release(unsigned obj_no) {
+    struct obj_tex_meta *meta = obj_tex_meta_array + obj_no;
+    if (meta->tex_array < 0)
+        return;
+
+    struct tex_array *arr = tex_arrays + meta->tex_array;
+    arr->layers_used &= ~(UINT32_C(1) << meta->tex_layer);
+    if (!arr->layers_used) {
+        glDeleteTextures(1, &arr->tex);
+        memset(arr, 0, sizeof(*arr));
+    }
+
+    meta->tex_array = -1;
+    meta->tex_layer = 0;
+}
+
+/*
+ * find a layer for obj_no in a texture array with the given storage, and
+ * bind that array to GL_TEXTURE_2D_ARRAY.  The obj keeps the layer it already
+ * has if that one matches.  Returns false if every array is full.
+ */
+static bool tex_array_alloc(unsigned obj_no, GLenum fmt, unsigned width,
+                            unsigned height, unsigned n_levels) {
+    struct obj_tex_meta *meta = obj_tex_meta_array + obj_no;
+    struct tex_array *arr;
+
+    if (meta->tex_array >= 0) {
+        arr = tex_arrays + meta->tex_array;
+        if (arr->fmt == fmt && arr->width == width &&
+            arr->height == height && arr->n_levels == n_levels) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, arr->tex);
+            return true;
+        }
+        tex_array_release(obj_no);
+    }
+
+    int arr_idx, free_idx = -1;
+    uint32_t const all_layers =
+        (uint32_t)((UINT64_C(1) << TEX_ARRAY_N_LAYERS) - 1);
+    for (arr_idx = 0; arr_idx < TEX_ARRAY_COUNT; arr_idx++) {
+        arr = tex_arrays + arr_idx;
+        if (!arr->tex) {
+            if (free_idx < 0)
+                free_idx = arr_idx;
+        } else if (arr->fmt == fmt && arr->width == width &&
+                   arr->height == height && arr->n_levels == n_levels &&
+                   arr->layers_used != all_layers) {
+            break;
+        }
+    }
+
+    if (arr_idx < TEX_ARRAY_COUNT) {
+        arr = tex_arrays + arr_idx;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arr->tex);
+    } else if (free_idx >= 0) {
+        arr_idx = free_idx;
+        arr = tex_arrays + arr_idx;
+        glGenTextures(1, &arr->tex);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arr->tex);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, n_levels, fmt,
+                       width, height, TEX_ARRAY_N_LAYERS);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        arr->fmt = fmt;
+        arr->width = width;
+        arr->height = height;
+        arr->n_levels = n_levels;
+        arr->layers_used = 0;
+        memset(&arr->params, 0, sizeof(arr->params));
+    } else {
+        return false;
+    }
+
+    unsigned layer = 0;
+    while (arr->layers_used & (UINT32_C(1) << layer))
+        layer++;
+    arr->layers_used |= UINT32_C(1) << layer;
+
+    meta->tex_array = arr_idx;
+    meta->tex_layer = layer;
+    return true;
+}
+
+// mipmapped textures are square and go all the way down to 1x1
+static unsigned tex_chain_levels(struct gfxgl4_tex const *tex) {
+    unsigned n_levels = 1;
+    if (tex->mipmap) {
+        unsigned side;
+        for (side = tex->width / 2; side; side /= 2)
+            n_levels++;
+    }
+    return n_levels;
+}
+
+static void tex_upload_ring_init(void) {
+    glGenBuffers(1, &tex_upload_pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex_upload_pbo);
+
+    tex_upload_ptr = NULL;
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEX_UPLOAD_RING_LEN,
+                        NULL, flags);
+        tex_upload_ptr = (char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                                 TEX_UPLOAD_RING_LEN, flags);
+        if (!tex_upload_ptr) {
+            // buffer storage is immutable, so start over with a new buffer
+            fprintf(stderr, "%s - failed to map the texture upload ring\n",
+                    __func__);
+            glDeleteBuffers(1, &tex_upload_pbo);
+            glGenBuffers(1, &tex_upload_pbo);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex_upload_pbo);
+        }
+    }
+
+    if (!tex_upload_ptr) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, TEX_UPLOAD_RING_LEN,
+                     NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    tex_upload_offs = 0;
+    tex_upload_seg = 0;
+    memset(tex_upload_fences, 0, sizeof(tex_upload_fences));
+}
+
+static void tex_upload_ring_cleanup(void) {
+    unsigned seg_no;
+    for (seg_no = 0; seg_no < TEX_UPLOAD_SEGS; seg_no++)
+        if (tex_upload_fences[seg_no])
+            glDeleteSync(tex_upload_fences[seg_no]);
+    memset(tex_upload_fences, 0, sizeof(tex_upload_fences));
+
+    // deleting a buffer unmaps it
+    glDeleteBuffers(1, &tex_upload_pbo);
+    tex_upload_pbo = 0;
+    tex_upload_ptr = NULL;
+}
+
+// fence off the segment the ring is leaving
+static void tex_upload_fence_seg(void) {
+    if (tex_upload_seg < TEX_UPLOAD_SEGS) {
+        GLsync *fence = tex_upload_fences + tex_upload_seg;
+        if (*fence)
+            glDeleteSync(*fence);
+        *fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+// move on to seg_no once the GPU is done with what was in it last time
+static void tex_upload_enter_seg(unsigned seg_no) {
+    tex_upload_fence_seg();
+
+    GLsync fence = tex_upload_fences[seg_no];
+    if (fence) {
+        GLenum res;
+        do {
+            res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   1000 * 1000 * 1000);
+        } while (res == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        tex_upload_fences[seg_no] = NULL;
+    }
+
+    tex_upload_seg = seg_no;
+}
+
+/*
+ * get n_bytes of memory to stage a texture upload in.  This is in the upload
+ * ring if there's room for it, and in a temporary buffer if there isn't.
+ * Between this and gfxgl4_tex_upload_finish, GL_PIXEL_UNPACK_BUFFER may be
+ * bound.
+ */
+void gfxgl4_tex_upload_map(struct gfxgl4_tex_upload *up, size_t n_bytes) {
+    up->len = n_bytes;
+    up->pbo = false;
+
+    if (n_bytes && n_bytes <= TEX_UPLOAD_RING_LEN && tex_upload_ptr) {
+        if (tex_upload_offs + n_bytes > TEX_UPLOAD_RING_LEN) {
+            tex_upload_fence_seg();
+            tex_upload_seg = TEX_UPLOAD_SEGS;
+            tex_upload_offs = 0;
+        }
+
+        unsigned seg_no = tex_upload_offs / TEX_UPLOAD_SEG_LEN;
+        unsigned last_seg =
+            (tex_upload_offs + n_bytes - 1) / TEX_UPLOAD_SEG_LEN;
+        for (; seg_no <= last_seg; seg_no++)
+            if (seg_no != tex_upload_seg)
+                tex_upload_enter_seg(seg_no);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex_upload_pbo);
+        up->dat = tex_upload_ptr + tex_upload_offs;
+        up->src = (void const*)(uintptr_t)tex_upload_offs;
+        up->pbo = true;
+        return;
+    }
+
+    if (n_bytes && n_bytes <= TEX_UPLOAD_RING_LEN) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex_upload_pbo);
+        if (tex_upload_offs + n_bytes > TEX_UPLOAD_RING_LEN) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, TEX_UPLOAD_RING_LEN,
+                         NULL, GL_STREAM_DRAW);
+            tex_upload_offs = 0;
+        }
+
+        /*
+         * nothing in the ring past tex_upload_offs has been written since the
+         * last time it got orphaned, so there's no need to synchronize.
+         */
+        up->dat = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, tex_upload_offs,
+                                   n_bytes, GL_MAP_WRITE_BIT |
+                                   GL_MAP_INVALIDATE_RANGE_BIT |
+                                   GL_MAP_UNSYNCHRONIZED_BIT);
+        if (up->dat) {
+            up->src = (void const*)(uintptr_t)tex_upload_offs;
+            up->pbo = true;
+            return;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (!(up->dat = malloc(n_bytes)))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    up->src = up->dat;
+}
+
+void gfxgl4_tex_upload_unmap(struct gfxgl4_tex_upload *up) {
+    if (up->pbo && !tex_upload_ptr &&
+        !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+        fprintf(stderr, "%s - texture upload buffer was lost\n", __func__);
+}
+
+void gfxgl4_tex_upload_finish(struct gfxgl4_tex_upload *up) {
+    if (up->pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        tex_upload_offs += (up->len + TEX_UPLOAD_ALIGN - 1) &
+            ~(size_t)(TEX_UPLOAD_ALIGN - 1);
+    } else {
+        free(up->dat);
+    }
+    up->dat = NULL;
+}
+
+// upload one level to GL_TEXTURE_2D, or to a layer of GL_TEXTURE_2D_ARRAY
+static void tex_sub_image(GLenum target, GLint level, int layer,
+                          unsigned width, unsigned height,
+                          GLenum format, GLenum type, void const *dat) {
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                        width, height, 1, format, type, dat);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height,
+                        format, type, dat);
+    }
+}
+
+/*
+ * upload the texture to whatever's bound to target, which needs to already
+ * have storage for every level.  For mipmapped textures, dat holds every
+ * level of the chain starting with the full-size level and going down to 1x1.
+ */
+static void
+tex_sub_image_chain(struct gfxgl4_tex const *tex, GLenum target, int layer,
+                    GLenum format, GLenum type,
+                    void const *dat, size_t bytes_per_pix) {
+    unsigned tex_w = tex->width, tex_h = tex->height;
+    char const *level_dat = (char const*)dat;
+    GLint level = 0;
+
+    tex_sub_image(target, 0, layer, tex_w, tex_h, format, type, level_dat);
+
+    if (tex->mipmap) {
+        while (tex_w > 1) {
+            level_dat += tex_w * tex_h * bytes_per_pix;
+            tex_w /= 2;
+            tex_h /= 2;
+            tex_sub_image(target, ++level, layer, tex_w, tex_h,
+                          format, type, level_dat);
+        }
+    }
+
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, level);
+}
+
 void gfxgl4_renderer_update_tex(unsigned tex_obj) {
     struct gfxgl4_tex const *tex = gfx_gfxgl4_tex_cache_get(tex_obj);
     struct gfx_obj *obj = gfx_obj_get(tex->obj_handle);
@@ -889,37 +1681,79 @@ void gfxgl4_renderer_update_tex(unsigned tex_obj) {
 
     void const *tex_dat = obj->dat;
 
-    GLenum internal_format, format;
+    GLenum internal_format, format, dat_type;
+    size_t bytes_per_pix = sizeof(uint16_t);
+    unsigned n_levels = tex_chain_levels(tex);
     switch (tex->tex_fmt) {
     case GFX_TEX_FMT_RGB_565:
-        internal_format = GL_RGB;
+        internal_format = GL_RGB565;
         format = GL_RGB;
+        dat_type = tex_fmt_to_data_type(tex->tex_fmt);
         break;
     case GFX_TEX_FMT_ARGB_8888:
-        internal_format = GL_RGBA;
+        internal_format = GL_RGBA8;
         format = GL_BGRA;
+        dat_type = tex_fmt_to_data_type(tex->tex_fmt);
+        bytes_per_pix = sizeof(uint32_t);
+        break;
+    case GFX_TEX_FMT_ARGB_4444:
+        internal_format = GL_RGBA4;
+        format = GL_RGBA;
+        dat_type = tex_fmt_to_data_type(tex->tex_fmt);
+        break;
+    case GFX_TEX_FMT_ARGB_1555:
+        internal_format = GL_RGB5_A1;
+        format = GL_RGBA;
+        dat_type = tex_fmt_to_data_type(tex->tex_fmt);
+        break;
+    case GFX_TEX_FMT_PAL_INDEX16:
+        internal_format = GL_R16UI;
+        format = GL_RED_INTEGER;
+        dat_type = GL_UNSIGNED_SHORT;
+        break;
+    case GFX_TEX_FMT_YUV_422:
+        // converted to RGBA8888, and never mipmapped
+        internal_format = GL_RGBA8;
+        format = GL_RGBA;
+        dat_type = GL_UNSIGNED_BYTE;
+        bytes_per_pix = sizeof(uint32_t);
+        n_levels = 1;
         break;
     default:
-        internal_format = GL_RGBA;
+        internal_format = GL_RGBA8;
         format = GL_RGBA;
+        dat_type = tex_fmt_to_data_type(tex->tex_fmt);
     }
 
     unsigned tex_w = tex->width;
     unsigned tex_h = tex->height;
 
-    glBindTexture(GL_TEXTURE_2D, obj_tex_array[tex->obj_handle]);
+    GLenum target = GL_TEXTURE_2D;
+    int layer = 0;
+    if (tex_arrays_en && tex_w <= TEX_ARRAY_MAX_SIDE &&
+        tex_h <= TEX_ARRAY_MAX_SIDE &&
+        tex_array_alloc(tex->obj_handle, internal_format,
+                        tex_w, tex_h, n_levels)) {
+        target = GL_TEXTURE_2D_ARRAY;
+        layer = obj_tex_meta_array[tex->obj_handle].tex_layer;
+    } else {
+        gfxgl4_renderer_tex_storage(tex->obj_handle, internal_format,
+                                    tex_w, tex_h, n_levels);
+    }
+
     // TODO: maybe don't always set this to 1
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     /*
-     * TODO: ideally I wouldn't need to copy ARGB_4444 and ARGB_1555 into a
-     * separate buffer to do the pixel conversion.  The reason I do this is that
-     * the tex-dump command in the cmd thread also sees the texture data in the
-     * struct gfxgl4_tex, so I don't want to modify that.  Maybe someday I'll
-     * change things to remove this mostly-unnecessary buffering...
+     * the tex-dump command in the cmd thread also sees the texture data in
+     * the struct gfxgl4_tex, so formats that need converting get converted on
+     * their way into the upload buffer instead of in place.
      */
-    if (tex->tex_fmt == GFX_TEX_FMT_ARGB_4444) {
-        size_t n_bytes = tex->width * tex->height * sizeof(uint16_t);
+    struct gfxgl4_tex_upload up;
+    if (tex->tex_fmt == GFX_TEX_FMT_ARGB_4444 ||
+        tex->tex_fmt == GFX_TEX_FMT_ARGB_1555) {
+        size_t n_pix = tex_chain_pixels(tex);
+        size_t n_bytes = n_pix * sizeof(uint16_t);
 #ifdef INVARIANTS
         if (n_bytes > obj->dat_len) {
             error_set_length(n_bytes);
@@ -927,94 +1761,73 @@ void gfxgl4_renderer_update_tex(unsigned tex_obj) {
             RAISE_ERROR(ERROR_OVERFLOW);
         }
 #endif
-        uint16_t *tex_dat_conv = (uint16_t*)malloc(n_bytes);
-        if (!tex_dat_conv)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(tex_dat_conv, tex_dat, n_bytes);
-        render_conv_argb_4444(tex_dat_conv, tex_w * tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
-                     format, tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_4444),
-                     tex_dat_conv);
-        gfxgl4_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        gfxgl4_renderer_tex_set_format(tex->obj_handle, format);
-        gfxgl4_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_4444));
-        gfxgl4_renderer_tex_set_dirty(tex->obj_handle, false);
-        free(tex_dat_conv);
-    } else if (tex->tex_fmt == GFX_TEX_FMT_ARGB_1555) {
-        size_t n_bytes = tex->width * tex->height * sizeof(uint16_t);
-#ifdef INVARIANTS
-        if (n_bytes > obj->dat_len) {
-            error_set_length(n_bytes);
-            error_set_max_length(obj->dat_len);
-            RAISE_ERROR(ERROR_OVERFLOW);
-        }
-#endif
-        uint16_t *tex_dat_conv = (uint16_t*)malloc(n_bytes);
-        if (!tex_dat_conv)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(tex_dat_conv, tex_dat, n_bytes);
-        render_conv_argb_1555(tex_dat_conv, tex_w * tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
-                     format, tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_1555),
-                     tex_dat_conv);
-        gfxgl4_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        gfxgl4_renderer_tex_set_format(tex->obj_handle, format);
-        gfxgl4_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_1555));
-        gfxgl4_renderer_tex_set_dirty(tex->obj_handle, false);
-        free(tex_dat_conv);
+        gfxgl4_tex_upload_map(&up, n_bytes);
+        if (tex->tex_fmt == GFX_TEX_FMT_ARGB_4444)
+            render_conv_argb_4444((uint16_t*)up.dat, tex_dat, n_pix);
+        else
+            render_conv_argb_1555((uint16_t*)up.dat, tex_dat, n_pix);
+        gfxgl4_tex_upload_unmap(&up);
+        tex_sub_image_chain(tex, target, layer, format, dat_type,
+                            up.src, bytes_per_pix);
     } else if (tex->tex_fmt == GFX_TEX_FMT_YUV_422) {
-        uint8_t *tmp_dat =
-            (uint8_t*)malloc(sizeof(uint8_t) * 4 * tex_w * tex_h);
-        if (!tmp_dat)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        washdc_conv_yuv422_rgba8888(tmp_dat, tex_dat, tex_w, tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_w, tex_h, 0,
-                     GL_RGBA, GL_UNSIGNED_BYTE, tmp_dat);
-        gfxgl4_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        gfxgl4_renderer_tex_set_format(tex->obj_handle, GL_RGBA);
-        gfxgl4_renderer_tex_set_dat_type(tex->obj_handle, GL_UNSIGNED_BYTE);
-        gfxgl4_renderer_tex_set_dirty(tex->obj_handle, false);
-        free(tmp_dat);
+        gfxgl4_tex_upload_map(&up, sizeof(uint8_t) * 4 * tex_w * tex_h);
+        washdc_conv_yuv422_rgba8888(up.dat, tex_dat, tex_w, tex_h);
+        gfxgl4_tex_upload_unmap(&up);
+        tex_sub_image(target, 0, layer, tex_w, tex_h,
+                      format, dat_type, up.src);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
     } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, tex_w, tex_h, 0,
-                     format, tex_fmt_to_data_type(tex->tex_fmt), tex_dat);
-        gfxgl4_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        gfxgl4_renderer_tex_set_format(tex->obj_handle, format);
-        gfxgl4_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(tex->tex_fmt));
-        gfxgl4_renderer_tex_set_dirty(tex->obj_handle, false);
+        size_t n_bytes = tex_chain_pixels(tex) * bytes_per_pix;
+        gfxgl4_tex_upload_map(&up, n_bytes);
+        memcpy(up.dat, tex_dat, n_bytes);
+        gfxgl4_tex_upload_unmap(&up);
+        tex_sub_image_chain(tex, target, layer, format, dat_type,
+                            up.src, bytes_per_pix);
     }
+    gfxgl4_tex_upload_finish(&up);
+
+    gfxgl4_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
+    gfxgl4_renderer_tex_set_format(tex->obj_handle, format);
+    gfxgl4_renderer_tex_set_dat_type(tex->obj_handle, dat_type);
+
+    /*
+     * the obj's own texture object doesn't hold anything when it's in an
+     * array, so anything that wants to use that needs to set it up again.
+     */
+    gfxgl4_renderer_tex_set_dirty(tex->obj_handle,
+                                  target == GL_TEXTURE_2D_ARRAY);
+
     obj->state |= GFX_OBJ_STATE_TEX;
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(target, 0);
 }
 
 void gfxgl4_renderer_release_tex(unsigned tex_obj) {
     // do nothing
 }
 
-static void render_conv_argb_4444(uint16_t *pixels, size_t n_pixels) {
-    for (size_t pix_no = 0; pix_no < n_pixels; pix_no++, pixels++) {
-        uint16_t pix_current = *pixels;
+static void render_conv_argb_4444(uint16_t *dst, uint16_t const *src,
+                                  size_t n_pixels) {
+    for (size_t pix_no = 0; pix_no < n_pixels; pix_no++) {
+        uint16_t pix_current = src[pix_no];
         uint16_t b = (pix_current & 0x000f) >> 0;
         uint16_t g = (pix_current & 0x00f0) >> 4;
         uint16_t r = (pix_current & 0x0f00) >> 8;
         uint16_t a = (pix_current & 0xf000) >> 12;
 
-        *pixels = a | (b << 4) | (g << 8) | (r << 12);
+        dst[pix_no] = a | (b << 4) | (g << 8) | (r << 12);
     }
 }
 
-static void render_conv_argb_1555(uint16_t *pixels, size_t n_pixels) {
-    for (size_t pix_no = 0; pix_no < n_pixels; pix_no++, pixels++) {
-        uint16_t pix_current = *pixels;
+static void render_conv_argb_1555(uint16_t *dst, uint16_t const *src,
+                                  size_t n_pixels) {
+    for (size_t pix_no = 0; pix_no < n_pixels; pix_no++) {
+        uint16_t pix_current = src[pix_no];
         uint16_t b = (pix_current & 0x001f) >> 0;
         uint16_t g = (pix_current & 0x03e0) >> 5;
         uint16_t r = (pix_current & 0x7c00) >> 10;
         uint16_t a = (pix_current & 0x8000) >> 15;
 
-        *pixels = (a << 15) | (b << 10) | (g << 5) | (r << 0);
+        dst[pix_no] = (a << 15) | (b << 10) | (g << 5) | (r << 0);
     }
 }
 
@@ -1022,10 +1835,7 @@ static void gfxgl4_renderer_set_blend_enable(struct gfx_il_inst *cmd) {
     bool enable = cmd->arg.set_blend_enable.do_enable;
     struct gfx_cfg rend_cfg = gfx_config_read();
 
-    if (rend_cfg.blend_enable && enable)
-        glEnable(GL_BLEND);
-    else
-        glDisable(GL_BLEND);
+    gl_state_blend_enable(&gl_state, rend_cfg.blend_enable && enable);
 }
 
 static void gfxgl4_renderer_set_rend_param(struct gfx_il_inst *cmd) {
@@ -1036,11 +1846,15 @@ static void gfxgl4_renderer_set_rend_param(struct gfx_il_inst *cmd) {
 static void do_set_rend_param(struct gfx_rend_param const *param) {
     struct gfx_cfg rend_cfg = gfx_config_read();
 
+    pt_mode = param->pt_mode && rend_cfg.pt_enable;
+
     /*
      * TODO: currently disable color also disables textures; ideally these
      * would be two independent settings.
      */
     shader_key shader_cache_key;
+    GLenum tex_target = GL_TEXTURE_2D;
+    unsigned tex_layer = 0;
     if (param->tex_enable && rend_cfg.tex_enable && rend_cfg.color_enable) {
         shader_cache_key =
             SHADER_KEY_TEX_ENABLE_BIT | SHADER_KEY_COLOR_ENABLE_BIT;
@@ -1060,30 +1874,71 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
             break;
         }
 
-        if (gfx_gfxgl4_tex_cache_get(param->tex_idx)->valid) {
-            int obj_handle = gfx_gfxgl4_tex_cache_get(param->tex_idx)->obj_handle;
-            glBindTexture(GL_TEXTURE_2D, obj_tex_array[obj_handle]);
+        gl_state_active_tex(&gl_state, GL_TEXTURE0);
+
+        struct gfxgl4_tex const *tex = gfx_gfxgl4_tex_cache_get(param->tex_idx);
+        struct gl_tex_params *tex_params = NULL;
+        bool tex_palette = false, tex_mipmap = false;
+        if (tex->valid) {
+            int obj_handle = tex->obj_handle;
+            struct obj_tex_meta *meta = obj_tex_meta_array + obj_handle;
+            if (meta->tex_array >= 0) {
+                struct tex_array *arr = tex_arrays + meta->tex_array;
+                gl_state_bind_tex_array(&gl_state, arr->tex);
+                tex_params = &arr->params;
+                tex_target = GL_TEXTURE_2D_ARRAY;
+                tex_layer = meta->tex_layer;
+                shader_cache_key |= SHADER_KEY_TEX_ARRAY_BIT;
+            } else {
+                gl_state_bind_tex(&gl_state, obj_tex_array[obj_handle]);
+                tex_params = &meta->params;
+            }
+            tex_palette = tex->tex_fmt == GFX_TEX_FMT_PAL_INDEX16;
+            tex_mipmap = tex->mipmap;
         } else {
             fprintf(stderr, "WARNING: attempt to bind invalid texture %u\n",
                     (unsigned)param->tex_idx);
-            glBindTexture(GL_TEXTURE_2D, 0);
+            gl_state_bind_tex(&gl_state, 0);
         }
 
+        /*
+         * the palette shader only ever reads the top level, so palette
+         * textures don't get mipmap filtering.
+         */
+        bool use_mipmap = tex_mipmap && !tex_palette;
+
+        GLint min_filter, mag_filter;
         switch (param->tex_filter) {
         case TEX_FILTER_TRILINEAR_A:
         case TEX_FILTER_TRILINEAR_B:
-            fprintf(stderr,
-                    "WARNING: trilinear filtering is not yet supported\n");
+            if (use_mipmap) {
+                min_filter = GL_LINEAR_MIPMAP_LINEAR;
+                mag_filter = GL_LINEAR;
+                break;
+            }
+            fprintf(stderr, "WARNING: trilinear filtering is only supported "
+                    "on mipmapped textures\n");
             // intentional fall-through
         case TEX_FILTER_NEAREST:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        default:
+            min_filter = use_mipmap ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST;
+            mag_filter = GL_NEAREST;
             break;
         case TEX_FILTER_BILINEAR:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (tex_palette) {
+                // integer textures can only be sampled with GL_NEAREST
+                min_filter = GL_NEAREST;
+                mag_filter = GL_NEAREST;
+                shader_cache_key |= SHADER_KEY_TEX_PALETTE_LINEAR_BIT;
+            } else {
+                min_filter = use_mipmap ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR;
+                mag_filter = GL_LINEAR;
+            }
             break;
         }
+
+        if (tex_palette)
+            shader_cache_key |= SHADER_KEY_TEX_PALETTE_BIT;
         GLenum tex_wrap_mode_gl[2];
         switch (param->tex_wrap_mode[0]) {
         case TEX_WRAP_REPEAT:
@@ -1112,17 +1967,20 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
             RAISE_ERROR(ERROR_INTEGRITY);
         }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, tex_wrap_mode_gl[0]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, tex_wrap_mode_gl[1]);
-
-        glActiveTexture(GL_TEXTURE0);
+        // nothing to set if the texture was invalid since 0 is bound
+        if (tex_params) {
+            gl_state_tex_params_target(&gl_state, tex_target, tex_params,
+                                       min_filter, mag_filter,
+                                       tex_wrap_mode_gl[0],
+                                       tex_wrap_mode_gl[1]);
+        }
     } else if (rend_cfg.color_enable) {
         shader_cache_key = SHADER_KEY_COLOR_ENABLE_BIT;
     } else {
         shader_cache_key = 0;
     }
 
-    if (param->pt_mode && rend_cfg.pt_enable)
+    if (pt_mode)
         shader_cache_key |= SHADER_KEY_PUNCH_THROUGH_BIT;
 
     user_clip_mode = param->user_clip_mode;
@@ -1143,16 +2001,25 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
                 "texture with key 0x%08x\n", __func__, (int)shader_cache_key);
         return;
     }
-    glUseProgram(shader_ent->shader.shader_prog_obj);
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_BOUND_TEX], 0);
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_PT_ALPHA_REF],
-                param->pt_ref - 1);
-    trans_mat_slot = shader_ent->slots[SHADER_CACHE_SLOT_TRANS_MAT];
-    user_clip_slot = shader_ent->slots[SHADER_CACHE_SLOT_USER_CLIP];
-    glUniform4f(user_clip_slot, user_clip[0], user_clip[1],
-                user_clip[2], user_clip[3]);
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_MAX_OIT_NODES],
-                MAX_OIT_NODES);
+    gl_state_use_program(&gl_state, shader_ent->shader.shader_prog_obj);
+    cur_shader_ent = last_shader_ent = shader_ent;
+
+    struct gl_uniform_cache *uniforms = shader_ent->uniforms;
+    GLint const *slots = shader_ent->slots;
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_BOUND_TEX,
+                       slots[SHADER_CACHE_SLOT_BOUND_TEX], 0);
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_PALETTE_TEX,
+                       slots[SHADER_CACHE_SLOT_PALETTE_TEX], PALETTE_TEX_UNIT);
+    gl_state_uniform1f(&gl_state, uniforms + SHADER_CACHE_SLOT_TEX_LAYER,
+                       slots[SHADER_CACHE_SLOT_TEX_LAYER], (GLfloat)tex_layer);
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_PT_ALPHA_REF,
+                       slots[SHADER_CACHE_SLOT_PT_ALPHA_REF],
+                       param->pt_ref - 1);
+    trans_mat_slot = slots[SHADER_CACHE_SLOT_TRANS_MAT];
+    user_clip_slot = slots[SHADER_CACHE_SLOT_USER_CLIP];
+    set_user_clip_uniform();
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_MAX_OIT_NODES,
+                       slots[SHADER_CACHE_SLOT_MAX_OIT_NODES], max_oit_nodes);
 
     GLfloat tex_transform[4] = {
         param->tex_transform[0],
@@ -1160,15 +2027,21 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
         param->tex_transform[2],
         param->tex_transform[3],
     };
-    glUniformMatrix2fv(shader_ent->slots[SHADER_CACHE_SLOT_TEX_TRANSFORM],
-                       1, GL_TRUE, tex_transform);
+    gl_state_uniform_mat2(&gl_state, uniforms + SHADER_CACHE_SLOT_TEX_TRANSFORM,
+                          slots[SHADER_CACHE_SLOT_TEX_TRANSFORM],
+                          GL_TRUE, tex_transform);
+    gl_state_uniform2f(&gl_state, uniforms + SHADER_CACHE_SLOT_TEX_OFFSET,
+                       slots[SHADER_CACHE_SLOT_TEX_OFFSET],
+                       param->tex_offset[0], param->tex_offset[1]);
 
     enum Pvr2BlendFactor cur_src_blend_factor = param->src_blend_factor;
     enum Pvr2BlendFactor cur_dst_blend_factor = param->dst_blend_factor;
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_SRC_BLEND_FACTOR],
-                cur_src_blend_factor);
-    glUniform1i(shader_ent->slots[SHADER_CACHE_SLOT_DST_BLEND_FACTOR],
-                cur_dst_blend_factor);
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_SRC_BLEND_FACTOR,
+                       slots[SHADER_CACHE_SLOT_SRC_BLEND_FACTOR],
+                       cur_src_blend_factor);
+    gl_state_uniform1i(&gl_state, uniforms + SHADER_CACHE_SLOT_DST_BLEND_FACTOR,
+                       slots[SHADER_CACHE_SLOT_DST_BLEND_FACTOR],
+                       cur_dst_blend_factor);
 
     if (oit_state.enabled) {
         glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER,
@@ -1181,8 +2054,9 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
                            GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
     }
 
-    glBlendFunc(src_blend_factors[(unsigned)cur_src_blend_factor],
-                dst_blend_factors[(unsigned)cur_dst_blend_factor]);
+    gl_state_blend_func(&gl_state,
+                        src_blend_factors[(unsigned)cur_src_blend_factor],
+                        dst_blend_factors[(unsigned)cur_dst_blend_factor]);
 
     /*
      * TODO: is it correct to unconditionally disable depth writes whenever oit
@@ -1190,13 +2064,23 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
      * for the sort shader somehow.  This can effect the punch-throughs since
      * they get drawn last
      */
-    glDepthMask(param->enable_depth_writes && !oit_state.enabled ?
-                GL_TRUE : GL_FALSE);
+    gl_state_depth_mask(&gl_state,
+                        param->enable_depth_writes && !oit_state.enabled ?
+                        GL_TRUE : GL_FALSE);
 
     if (oit_state.enabled)
-        glDepthFunc(depth_funcs[PVR2_DEPTH_GREATER]);
+        gl_state_depth_func(&gl_state, depth_funcs[PVR2_DEPTH_GREATER]);
     else
-        glDepthFunc(depth_funcs[param->depth_func]);
+        gl_state_depth_func(&gl_state, depth_funcs[param->depth_func]);
+
+    GLint shadow_ref = param->shadow ? MOD_VOL_STENCIL_SHADOW : 0;
+    if (shadow_ref != stencil_shadow_ref) {
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(MOD_VOL_STENCIL_SHADOW);
+        glStencilFunc(GL_ALWAYS, shadow_ref, MOD_VOL_STENCIL_SHADOW);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        stencil_shadow_ref = shadow_ref;
+    }
 
     tex_enable = param->tex_enable;
 }
@@ -1204,11 +2088,124 @@ static void do_set_rend_param(struct gfx_rend_param const *param) {
 static void gfxgl4_renderer_set_vert_array(struct gfx_il_inst *cmd) {
     unsigned n_verts = cmd->arg.set_vert_array.n_verts;
     float const *verts = cmd->arg.set_vert_array.verts;
+    int buf_no = cmd->arg.set_vert_array.buf_no;
+
+    cur_vert_fmt = cmd->arg.set_vert_array.fmt;
+
+    if (buf_no >= 0) {
+        // the vertices are already where the GPU can see them
+        if ((unsigned)buf_no >= persist_n_bufs)
+            RAISE_ERROR(ERROR_INTEGRITY);
+        cur_vert_buf = persist_vbo;
+        cur_vert_offs = buf_no * persist_buf_len;
+        return;
+    }
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * n_verts * GFX_VERT_LEN,
+    glBufferData(GL_ARRAY_BUFFER, GFX_VERT_SIZE(cur_vert_fmt) * n_verts,
                  verts, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    cur_vert_buf = vbo;
+    cur_vert_offs = 0;
+}
+
+static void *gfxgl4_renderer_map_vert_bufs(unsigned n_bufs, size_t buf_len) {
+    if (!GLEW_ARB_buffer_storage) {
+        fprintf(stderr, "%s - GL_ARB_buffer_storage is not available\n",
+                __func__);
+        return NULL;
+    }
+
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr n_bytes = (GLsizeiptr)n_bufs * buf_len;
+
+    glGenBuffers(1, &persist_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, persist_vbo);
+    glBufferStorage(GL_ARRAY_BUFFER, n_bytes, NULL, flags);
+    void *ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, n_bytes, flags);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (!ptr) {
+        fprintf(stderr, "%s - failed to map %u vertex buffers\n",
+                __func__, n_bufs);
+        glDeleteBuffers(1, &persist_vbo);
+        persist_vbo = 0;
+        return NULL;
+    }
+
+    persist_fences = (GLsync*)calloc(n_bufs, sizeof(GLsync));
+    if (!persist_fences)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    persist_n_bufs = n_bufs;
+    persist_buf_len = buf_len;
+
+    return ptr;
+}
+
+static void gfxgl4_renderer_unmap_vert_bufs(void) {
+    unsigned buf_no;
+    for (buf_no = 0; buf_no < persist_n_bufs; buf_no++)
+        if (persist_fences[buf_no])
+            glDeleteSync(persist_fences[buf_no]);
+    free(persist_fences);
+    persist_fences = NULL;
+
+    if (cur_vert_buf == persist_vbo) {
+        cur_vert_buf = vbo;
+        cur_vert_offs = 0;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, persist_vbo);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteBuffers(1, &persist_vbo);
+
+    persist_vbo = 0;
+    persist_n_bufs = 0;
+    persist_buf_len = 0;
+}
+
+static bool gfxgl4_renderer_vert_buf_done(unsigned buf_no, bool wait) {
+    if (buf_no >= persist_n_bufs)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    GLsync fence = persist_fences[buf_no];
+    if (!fence)
+        return true;
+
+    GLenum res;
+    if (wait) {
+        do {
+            res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   1000 * 1000 * 1000);
+        } while (res == GL_TIMEOUT_EXPIRED);
+    } else {
+        res = glClientWaitSync(fence, 0, 0);
+    }
+
+    if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED) {
+        glDeleteSync(fence);
+        persist_fences[buf_no] = NULL;
+        return true;
+    }
+    return false;
+}
+
+static void gfxgl4_renderer_fence_vert_buf(struct gfx_il_inst *cmd) {
+    unsigned buf_no = cmd->arg.fence_vert_buf.buf_no;
+    if (buf_no >= persist_n_bufs)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    if (persist_fences[buf_no])
+        glDeleteSync(persist_fences[buf_no]);
+    persist_fences[buf_no] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+static void gfxgl4_renderer_set_index_array(struct gfx_il_inst *cmd) {
+    glNamedBufferData(ibo, cmd->arg.set_index_array.n_idx * sizeof(GLuint),
+                      cmd->arg.set_index_array.idx, GL_DYNAMIC_DRAW);
 }
 
 static void
@@ -1219,6 +2216,28 @@ gfxgl4_renderer_draw_vert_array(struct gfx_il_inst *cmd) {
     if (!n_verts)
         return;
 
+    draw_setup();
+    glDrawArrays(GL_TRIANGLE_STRIP, first_idx, n_verts);
+    draw_teardown();
+}
+
+static void
+gfxgl4_renderer_draw_indexed_vert_array(struct gfx_il_inst *cmd) {
+    GLsizei n_idx = cmd->arg.draw_indexed_vert_array.n_idx;
+    size_t first_idx = cmd->arg.draw_indexed_vert_array.first_idx;
+
+    if (!n_idx)
+        return;
+
+    draw_setup();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glDrawElements(GL_TRIANGLE_STRIP, n_idx, GL_UNSIGNED_INT,
+                   (GLvoid*)(first_idx * sizeof(GLuint)));
+    draw_teardown();
+}
+
+// orthographic transform from screen coordinates to clip coordinates
+static void get_trans_mat(GLfloat *trans_mat) {
     float clip_min_actual = clip_min;
     float clip_max_actual = clip_max;
 
@@ -1228,12 +2247,19 @@ gfxgl4_renderer_draw_vert_array(struct gfx_il_inst *cmd) {
     };
 
     GLfloat clip_delta = clip_max_actual - clip_min_actual;
-    GLfloat trans_mat[16] = {
+    GLfloat mat[16] = {
         1.0 / half_screen_dims[0], 0, 0, -1,
         0, -1.0 / half_screen_dims[1], 0, 1,
         0, 0, 1.0 / clip_delta, -clip_min_actual / clip_delta,
         0, 0, 0, 1
     };
+    memcpy(trans_mat, mat, sizeof(mat));
+}
+
+// set up the transform and vertex attributes for the current vertex array
+static void draw_setup(void) {
+    GLfloat trans_mat[16];
+    get_trans_mat(trans_mat);
 
     /*
      * somehow using this in conjunction with the 32-bit floating point depth
@@ -1249,34 +2275,63 @@ gfxgl4_renderer_draw_vert_array(struct gfx_il_inst *cmd) {
      */
     glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
 
-    glUniformMatrix4fv(trans_mat_slot, 1, GL_TRUE, trans_mat);
+    gl_state_uniform_mat4(&gl_state, uniform_cache(SHADER_CACHE_SLOT_TRANS_MAT),
+                          trans_mat_slot, GL_TRUE, trans_mat);
 
     // now draw the geometry itself
     glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, cur_vert_buf);
     glEnableVertexAttribArray(POSITION_SLOT);
     glEnableVertexAttribArray(BASE_COLOR_SLOT);
     glEnableVertexAttribArray(OFFS_COLOR_SLOT);
-    glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_POS_OFFSET * sizeof(float)));
-    glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_BASE_COLOR_OFFSET * sizeof(float)));
-    glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_OFFS_COLOR_OFFSET * sizeof(float)));
-    if (tex_enable) {
-        glEnableVertexAttribArray(TEX_COORD_SLOT);
-        glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+    if (cur_vert_fmt == GFX_VERT_FMT_PACKED) {
+        glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_PACKED_VERT_POS_OFFSET));
+        glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_PACKED_VERT_BASE_COLOR_OFFSET));
+        glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_PACKED_VERT_OFFS_COLOR_OFFSET));
+        if (tex_enable) {
+            glEnableVertexAttribArray(TEX_COORD_SLOT);
+            glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+                                  GFX_PACKED_VERT_SIZE,
+                                  (GLvoid*)(cur_vert_offs +
+                                            GFX_PACKED_VERT_TEX_COORD_OFFSET));
+        }
+    } else {
+        glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_VERT_LEN * sizeof(float),
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_VERT_POS_OFFSET * sizeof(float)));
+        glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
                               GFX_VERT_LEN * sizeof(float),
-                              (GLvoid*)(GFX_VERT_TEX_COORD_OFFSET * sizeof(float)));
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_VERT_BASE_COLOR_OFFSET * sizeof(float)));
+        glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_VERT_LEN * sizeof(float),
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_VERT_OFFS_COLOR_OFFSET * sizeof(float)));
+        if (tex_enable) {
+            glEnableVertexAttribArray(TEX_COORD_SLOT);
+            glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+                                  GFX_VERT_LEN * sizeof(float),
+                                  (GLvoid*)(cur_vert_offs +
+                                            GFX_VERT_TEX_COORD_OFFSET * sizeof(float)));
+        }
     }
     if (oit_state.enabled) {
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
                         GL_ATOMIC_COUNTER_BARRIER_BIT);
     }
-    glDrawArrays(GL_TRIANGLE_STRIP, first_idx, n_verts);
+}
+
+static void draw_teardown(void) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
@@ -1305,7 +2360,9 @@ static void gfxgl4_renderer_clear(struct gfx_il_inst *cmd) {
     }
     glClearDepth(0.0f);
     glDepthMask(GL_TRUE);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearStencil(0);
+    glStencilMask(0xff);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     if (rend_cfg.depth_enable)
         glEnable(GL_DEPTH_TEST);
@@ -1313,10 +2370,131 @@ static void gfxgl4_renderer_clear(struct gfx_il_inst *cmd) {
         glDisable(GL_DEPTH_TEST);
 }
 
+// bind the position attribute of the current vertex array for mod_vol_shader
+static void mod_vol_setup(void) {
+    GLfloat trans_mat[16];
+    get_trans_mat(trans_mat);
+
+    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glUseProgram(mod_vol_shader.shader_prog_obj);
+    glUniformMatrix4fv(mod_vol_shader_trans_mat_slot, 1, GL_TRUE, trans_mat);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, cur_vert_buf);
+    glEnableVertexAttribArray(POSITION_SLOT);
+    if (cur_vert_fmt == GFX_VERT_FMT_PACKED) {
+        glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_PACKED_VERT_SIZE,
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_PACKED_VERT_POS_OFFSET));
+    } else {
+        glVertexAttribPointer(POSITION_SLOT, 4, GL_FLOAT, GL_FALSE,
+                              GFX_VERT_LEN * sizeof(float),
+                              (GLvoid*)(cur_vert_offs +
+                                        GFX_VERT_POS_OFFSET * sizeof(float)));
+    }
+}
+
+/*
+ * The hardware decides whether a pixel is inside of a volume by counting the
+ * volume's faces in front of it, so this does the same thing with the stencil
+ * buffer.  Counting the parity instead of incrementing on front faces and
+ * decrementing on back faces means it doesn't matter which way the game wound
+ * the triangles, and the hardware doesn't guarantee that.
+ */
+static void gfxgl4_renderer_draw_mod_vol(struct gfx_il_inst *cmd) {
+    GLsizei n_verts = cmd->arg.draw_mod_vol.n_verts;
+    GLint first_idx = cmd->arg.draw_mod_vol.first_idx;
+    struct gfx_cfg rend_cfg = gfx_config_read();
+
+    if (!n_verts || rend_cfg.wireframe)
+        return;
+
+    mod_vol_setup();
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_STENCIL_TEST);
+
+    // larger 1/z values are closer
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_GREATER);
+    glStencilMask(MOD_VOL_STENCIL_PARITY);
+    glStencilFunc(GL_ALWAYS, 0, 0xff);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+    glDrawArrays(GL_TRIANGLES, first_idx, n_verts);
+
+    /*
+     * draw it again to move PARITY into INSIDE.  The reference value's
+     * PARITY bit is 0 so the test passes wherever the stencil's is 1, and
+     * replacing clears PARITY so every pixel only gets written once.
+     */
+    glDisable(GL_DEPTH_TEST);
+    glStencilMask(MOD_VOL_STENCIL_PARITY | MOD_VOL_STENCIL_INSIDE);
+    glStencilFunc(GL_LESS, MOD_VOL_STENCIL_INSIDE, MOD_VOL_STENCIL_PARITY);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glDrawArrays(GL_TRIANGLES, first_idx, n_verts);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    if (rend_cfg.depth_enable)
+        glEnable(GL_DEPTH_TEST);
+    draw_teardown();
+}
+
+static void gfxgl4_renderer_apply_mod_vol(struct gfx_il_inst *cmd) {
+    GLfloat scale = cmd->arg.apply_mod_vol.scale;
+    struct gfx_cfg rend_cfg = gfx_config_read();
+    static GLfloat const ident[16] = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    };
+
+    if (!rend_cfg.wireframe) {
+        glUseProgram(mod_vol_shader.shader_prog_obj);
+        glUniformMatrix4fv(mod_vol_shader_trans_mat_slot, 1, GL_TRUE, ident);
+        glBindVertexArray(oit_quad_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, oit_quad_vbo);
+        glEnableVertexAttribArray(0);
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(0);
+        glStencilFunc(GL_EQUAL, MOD_VOL_STENCIL_SHADOW | MOD_VOL_STENCIL_INSIDE,
+                      MOD_VOL_STENCIL_SHADOW | MOD_VOL_STENCIL_INSIDE);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+        // dst = dst * scale
+        glEnable(GL_BLEND);
+        glBlendColor(scale, scale, scale, 1.0f);
+        glBlendFunc(GL_ZERO, GL_CONSTANT_COLOR);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        if (rend_cfg.depth_enable)
+            glEnable(GL_DEPTH_TEST);
+        draw_teardown();
+    }
+
+    // start over for the next frame's volumes
+    glStencilMask(MOD_VOL_STENCIL_PARITY | MOD_VOL_STENCIL_INSIDE);
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+}
+
 static void gfxgl4_renderer_set_screen_dim(unsigned width, unsigned height) {
+    unsigned scale = gfxgl4_target_scale();
     screen_width = width;
     screen_height = height;
-    glViewport(0, 0, width, height);
+    glViewport(0, 0, width * scale, height * scale);
+}
+
+// the user clip rect is compared against gl_FragCoord, so it has to be scaled
+static void set_user_clip_uniform(void) {
+    GLfloat scale = gfxgl4_target_scale();
+    gl_state_uniform4f(&gl_state, uniform_cache(SHADER_CACHE_SLOT_USER_CLIP),
+                       user_clip_slot, user_clip[0] * scale,
+                       user_clip[1] * scale, user_clip[2] * scale,
+                       user_clip[3] * scale);
 }
 
 static void gfxgl4_renderer_set_clip_range(struct gfx_il_inst *cmd) {
@@ -1340,6 +2518,15 @@ void gfxgl4_renderer_tex_set_dims(unsigned obj_no,
                                   unsigned width, unsigned height) {
     obj_tex_meta_array[obj_no].width = width;
     obj_tex_meta_array[obj_no].height = height;
+    obj_tex_meta_array[obj_no].scale = 1;
+}
+
+unsigned gfxgl4_renderer_tex_get_scale(unsigned obj_no) {
+    return obj_tex_meta_array[obj_no].scale;
+}
+
+void gfxgl4_renderer_tex_set_scale(unsigned obj_no, unsigned scale) {
+    obj_tex_meta_array[obj_no].scale = scale;
 }
 
 void gfxgl4_renderer_tex_set_format(unsigned obj_no, GLenum fmt) {
@@ -1366,6 +2553,42 @@ bool gfxgl4_renderer_tex_get_dirty(unsigned obj_no) {
     return obj_tex_meta_array[obj_no].dirty;
 }
 
+void gfxgl4_renderer_tex_forget_params(unsigned obj_no) {
+    memset(&obj_tex_meta_array[obj_no].params, 0,
+           sizeof(obj_tex_meta_array[obj_no].params));
+}
+
+void gfxgl4_renderer_tex_storage(unsigned obj_no, GLenum internal_fmt,
+                                 unsigned width, unsigned height,
+                                 unsigned n_levels) {
+    struct obj_tex_meta *meta = obj_tex_meta_array + obj_no;
+
+    tex_array_release(obj_no);
+
+    if (meta->storage_fmt == internal_fmt && meta->storage_width == width &&
+        meta->storage_height == height && meta->storage_levels == n_levels) {
+        glBindTexture(GL_TEXTURE_2D, obj_tex_array[obj_no]);
+        return;
+    }
+
+    // immutable storage can't be respecified, so it needs a new texture
+    if (meta->storage_fmt) {
+        glDeleteTextures(1, obj_tex_array + obj_no);
+        glGenTextures(1, obj_tex_array + obj_no);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, obj_tex_array[obj_no]);
+    glTexStorage2D(GL_TEXTURE_2D, n_levels, internal_fmt, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    gfxgl4_renderer_tex_forget_params(obj_no);
+
+    meta->storage_fmt = internal_fmt;
+    meta->storage_width = width;
+    meta->storage_height = height;
+    meta->storage_levels = n_levels;
+}
+
 static void gfxgl4_renderer_begin_sort_mode(struct gfx_il_inst *cmd) {
     if (gfx_config_read().wireframe)
         return;
@@ -1375,35 +2598,46 @@ static void gfxgl4_renderer_begin_sort_mode(struct gfx_il_inst *cmd) {
 
     oit_state.enabled = true;
 
+    unsigned scale = gfxgl4_target_scale();
+    unsigned tgt_width = screen_width * scale;
+    unsigned tgt_height = screen_height * scale;
+
+    // resize the node buffer to match the render target
+    GLint n_nodes = tgt_width * tgt_height * OIT_NODES_PER_PIXEL;
+    if (n_nodes != max_oit_nodes) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER,
+                     oit_buffers[OIT_BUFFER_NODES_SSBO]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, OIT_NODE_SIZE * n_nodes,
+                     NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        max_oit_nodes = n_nodes;
+    }
+
     // per-pixel oit
     glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, oit_buffers[OIT_BUFFER_NODE_COUNT]);
     GLuint new_val = 0;
     glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(new_val), &new_val);
     glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
 
-    /*
-     * reset the oit_heads texture to all -1
-     *
-     * TODO: there has got to be a better way to do this than the way I'm doing
-     * it now.
-     */
-    size_t oit_heads_len = screen_width * screen_height * sizeof(GLint);
-    void *oit_reset_data = malloc(oit_heads_len);
-    if (!oit_reset_data)
-        abort();
-    memset(oit_reset_data, 0xff, oit_heads_len);
-    glBindTexture(GL_TEXTURE_2D, oit_heads_tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI,
-                 screen_width, screen_height, 0,
-                 GL_RED_INTEGER, GL_UNSIGNED_INT, oit_reset_data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    free(oit_reset_data);
+    // reset the oit_heads texture to all -1
+    if (tgt_width != oit_heads_width || tgt_height != oit_heads_height) {
+        glBindTexture(GL_TEXTURE_2D, oit_heads_tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI,
+                     tgt_width, tgt_height, 0,
+                     GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        oit_heads_width = tgt_width;
+        oit_heads_height = tgt_height;
+    }
+    GLuint const oit_heads_reset = ~(GLuint)0;
+    glClearTexImage(oit_heads_tex, 0, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                    &oit_heads_reset);
 
     glBindTexture(GL_TEXTURE_2D, oit_color_tex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                 screen_width, screen_height, 0,
+                 tgt_width, tgt_height, 0,
                  GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -1419,7 +2653,9 @@ static void gfxgl4_renderer_end_sort_mode(struct gfx_il_inst *cmd) {
 
     glNamedFramebufferReadBuffer(gfxgl4_tgt_fbo, GL_COLOR_ATTACHMENT0);
     glBindTexture(GL_TEXTURE_2D, oit_color_tex);
-    glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, screen_width, screen_height, 0);
+    unsigned scale = gfxgl4_target_scale();
+    glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0,
+                     screen_width * scale, screen_height * scale, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     if (!oit_state.enabled)
@@ -1480,14 +2716,24 @@ static void gfxgl4_renderer_bind_tex(struct gfx_il_inst *cmd) {
     enum gfx_tex_fmt pix_fmt = cmd->arg.bind_tex.pix_fmt;
     int width = cmd->arg.bind_tex.width;
     int height = cmd->arg.bind_tex.height;
+    bool mipmap = cmd->arg.bind_tex.mipmap;
+    bool alias = cmd->arg.bind_tex.alias;
 
-    gfxgl4_tex_cache_bind(tex_no, obj_handle, width, height, pix_fmt);
+    gfxgl4_tex_cache_bind(tex_no, obj_handle, width, height, pix_fmt,
+                          mipmap, alias);
 }
 
 static void gfxgl4_renderer_unbind_tex(struct gfx_il_inst *cmd) {
     gfxgl4_tex_cache_unbind(cmd->arg.unbind_tex.tex_no);
 }
 
+static void gfxgl4_renderer_set_palette(struct gfx_il_inst *cmd) {
+    glBindBuffer(GL_TEXTURE_BUFFER, palette_buf);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, GFX_PALETTE_LEN * sizeof(uint32_t),
+                    cmd->arg.set_palette.dat);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
 static void gfxgl4_renderer_obj_init(struct gfx_il_inst *cmd) {
     int obj_no = cmd->arg.init_obj.obj_no;
     size_t n_bytes = cmd->arg.init_obj.n_bytes;
@@ -1510,6 +2756,7 @@ static void gfxgl4_renderer_obj_read(struct gfx_il_inst *cmd) {
 
 static void gfxgl4_renderer_obj_free(struct gfx_il_inst *cmd) {
     int obj_no = cmd->arg.free_obj.obj_no;
+    tex_array_release(obj_no);
     gfx_obj_free(obj_no);
 }
 
@@ -1536,7 +2783,13 @@ static void gfxgl4_renderer_grab_framebuffer(struct gfx_il_inst *cmd) {
         return;
     }
 
-    gfx_obj_read(handle, dat, n_bytes);
+    if (gfxgl4_video_fb_raw()) {
+        glBindTexture(GL_TEXTURE_2D, gfxgl4_renderer_tex(handle));
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, dat);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    } else {
+        gfx_obj_read(handle, dat, n_bytes);
+    }
 
     cmd->arg.grab_framebuffer.fb->valid = true;
     cmd->arg.grab_framebuffer.fb->width = width;
@@ -1551,10 +2804,13 @@ static void gfxgl4_renderer_post_framebuffer(struct gfx_il_inst *cmd) {
     int obj_handle = cmd->arg.post_framebuffer.obj_handle;
     bool do_flip = cmd->arg.post_framebuffer.vert_flip;
     bool interlace = cmd->arg.post_framebuffer.interlaced;
+    enum gfx_fb_raw_fmt raw_fmt = cmd->arg.post_framebuffer.raw_fmt;
+    unsigned concat = cmd->arg.post_framebuffer.concat;
 
     gfxgl4_video_new_framebuffer(obj_handle, width, height,
-                                 do_flip, interlace);
+                                 do_flip, interlace, raw_fmt, concat);
     gfxgl4_video_present();
+    gpu_timer_end_frame();
 
     if (switch_table) {
         if (switch_table->overlay_draw)
@@ -1566,6 +2822,8 @@ static void gfxgl4_renderer_post_framebuffer(struct gfx_il_inst *cmd) {
 }
 
 static void gfxgl4_renderer_begin_rend(struct gfx_il_inst *cmd) {
+    gl_state_begin_frame(&gl_state);
+
     if (!renderdoc_capture_in_progress && renderdoc_capture_requested) {
         if (is_renderdoc_enabled()) {
             rdoc_api->StartFrameCapture(NULL, NULL);
@@ -1597,14 +2855,19 @@ static void gfxgl4_renderer_begin_rend(struct gfx_il_inst *cmd) {
      */
     glEnable(GL_DEPTH_CLAMP);
 
+    unsigned scale = gfxgl4_target_scale();
     glEnable(GL_SCISSOR_TEST);
-    glScissor(clip[0], clip[3], clip[2] - clip[0] + 1, clip[1] - clip[3] + 1);
+    glScissor(clip[0] * scale, clip[3] * scale,
+              (clip[2] - clip[0] + 1) * scale, (clip[1] - clip[3] + 1) * scale);
     gfxgl4_renderer_set_screen_dim(cmd->arg.begin_rend.screen_width,
                                    cmd->arg.begin_rend.screen_height);
 }
 
 static void gfxgl4_renderer_end_rend(struct gfx_il_inst *cmd) {
+    gl_state_end_frame(&gl_state);
+
     glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_STENCIL_TEST);
     gfxgl4_target_end(cmd->arg.end_rend.rend_tgt_obj);
 
     if (renderdoc_capture_in_progress && is_renderdoc_enabled()) {
@@ -1613,9 +2876,78 @@ static void gfxgl4_renderer_end_rend(struct gfx_il_inst *cmd) {
     }
 }
 
+/*
+ * returns true if op only touches GL state that goes through gl_state.
+ * anything else could change that state without the cache knowing about it.
+ */
+static bool gl_state_preserved(enum gfx_il op) {
+    switch (op) {
+    case GFX_IL_SET_BLEND_ENABLE:
+    case GFX_IL_SET_REND_PARAM:
+    case GFX_IL_SET_CLIP_RANGE:
+    case GFX_IL_SET_USER_CLIP:
+    case GFX_IL_SET_VERT_ARRAY:
+    case GFX_IL_DRAW_VERT_ARRAY:
+    case GFX_IL_SET_INDEX_ARRAY:
+    case GFX_IL_DRAW_INDEXED_VERT_ARRAY:
+    case GFX_IL_FENCE_VERT_BUF:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void invalidate_gl_state(void) {
+    gl_state_invalidate(&gl_state);
+    cur_shader_ent = NULL;
+    stencil_shadow_ref = -1;
+}
+
+// returns the GPU phase that op does its work in
+static unsigned gpu_phase_of(enum gfx_il op) {
+    switch (op) {
+    case GFX_IL_CLEAR:
+    case GFX_IL_DRAW_VERT_ARRAY:
+    case GFX_IL_DRAW_INDEXED_VERT_ARRAY:
+    case GFX_IL_DRAW_MOD_VOL:
+    case GFX_IL_APPLY_MOD_VOL:
+        if (oit_state.enabled)
+            return RENDERER_GPU_PHASE_OIT_BUILD;
+        return pt_mode ? RENDERER_GPU_PHASE_PUNCH_THROUGH :
+            RENDERER_GPU_PHASE_OPAQUE;
+    case GFX_IL_BEGIN_DEPTH_SORT:
+        return RENDERER_GPU_PHASE_OIT_BUILD;
+    case GFX_IL_END_DEPTH_SORT:
+        return RENDERER_GPU_PHASE_OIT_RESOLVE;
+    case GFX_IL_BEGIN_REND:
+    case GFX_IL_END_REND:
+    case GFX_IL_BIND_RENDER_TARGET:
+    case GFX_IL_UNBIND_RENDER_TARGET:
+    case GFX_IL_WRITE_OBJ:
+    case GFX_IL_READ_OBJ:
+    case GFX_IL_PREFETCH_OBJ:
+    case GFX_IL_GRAB_FRAMEBUFFER:
+        return RENDERER_GPU_PHASE_FB_BLIT;
+    case GFX_IL_POST_FRAMEBUFFER:
+        return RENDERER_GPU_PHASE_OUTPUT;
+    default:
+        // no GPU work of its own
+        return gpu_phase;
+    }
+}
+
 static void
 gfxgl4_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
+    // the ui and the video output may have changed things since last time
+    invalidate_gl_state();
+
     while (n_cmd--) {
+        bool preserved = gl_state_preserved(cmd->op);
+        if (!preserved)
+            invalidate_gl_state();
+
+        gpu_timer_phase(gpu_phase_of(cmd->op));
+
         switch (cmd->op) {
         case GFX_IL_BIND_TEX:
             gfxgl4_renderer_bind_tex(cmd);
@@ -1653,6 +2985,12 @@ gfxgl4_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
         case GFX_IL_DRAW_VERT_ARRAY:
             gfxgl4_renderer_draw_vert_array(cmd);
             break;
+        case GFX_IL_SET_INDEX_ARRAY:
+            gfxgl4_renderer_set_index_array(cmd);
+            break;
+        case GFX_IL_DRAW_INDEXED_VERT_ARRAY:
+            gfxgl4_renderer_draw_indexed_vert_array(cmd);
+            break;
         case GFX_IL_INIT_OBJ:
             gfxgl4_renderer_obj_init(cmd);
             break;
@@ -1671,12 +3009,21 @@ gfxgl4_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
         case GFX_IL_GRAB_FRAMEBUFFER:
             gfxgl4_renderer_grab_framebuffer(cmd);
             break;
+        case GFX_IL_PREFETCH_OBJ:
+            gfxgl4_target_prefetch_obj(cmd);
+            break;
         case GFX_IL_BEGIN_DEPTH_SORT:
             gfxgl4_renderer_begin_sort_mode(cmd);
             break;
         case GFX_IL_END_DEPTH_SORT:
             gfxgl4_renderer_end_sort_mode(cmd);
             break;
+        case GFX_IL_SET_PALETTE:
+            gfxgl4_renderer_set_palette(cmd);
+            break;
+        case GFX_IL_FENCE_VERT_BUF:
+            gfxgl4_renderer_fence_vert_buf(cmd);
+            break;
         case GFX_IL_SET_USER_CLIP:
             user_clip[0] = cmd->arg.set_user_clip.x_min;
 
@@ -1691,13 +3038,21 @@ gfxgl4_renderer_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
             else
                 user_clip[3] = 0;
 
-            glUniform4f(user_clip_slot, user_clip[0], user_clip[1],
-                        user_clip[2], user_clip[3]);
+            set_user_clip_uniform();
+            break;
+        case GFX_IL_DRAW_MOD_VOL:
+            gfxgl4_renderer_draw_mod_vol(cmd);
+            break;
+        case GFX_IL_APPLY_MOD_VOL:
+            gfxgl4_renderer_apply_mod_vol(cmd);
             break;
         default:
             fprintf(stderr, "ERROR: UNKNOWN GFX IL COMMAND %02X\n",
                     (unsigned)cmd->op);
         }
+
+        if (!preserved)
+            invalidate_gl_state();
         cmd++;
     }
 }
@@ -54,9 +54,49 @@ GLenum gfxgl4_renderer_tex_get_format(unsigned obj_no);
 GLenum gfxgl4_renderer_tex_get_dat_type(unsigned obj_no);
 bool gfxgl4_renderer_tex_get_dirty(unsigned obj_no);
 
+/*
+ * bind obj_no's texture to GL_TEXTURE_2D after making sure it has immutable
+ * storage with the given dimensions, format and number of mipmap levels.
+ * Storage that doesn't match gets replaced by a whole new texture object, so
+ * gfxgl4_renderer_tex has to be called again afterwards.
+ */
+void gfxgl4_renderer_tex_storage(unsigned obj_no, GLenum internal_fmt,
+                                 unsigned width, unsigned height,
+                                 unsigned n_levels);
+
+/*
+ * render targets can be larger than their width and height by an integer
+ * scale factor (see gfxgl4_target_scale).  gfxgl4_renderer_tex_set_dims resets
+ * the scale to 1.
+ */
+unsigned gfxgl4_renderer_tex_get_scale(unsigned obj_no);
+void gfxgl4_renderer_tex_set_scale(unsigned obj_no, unsigned scale);
+
+/*
+ * call this after setting texture parameters on obj_no's texture without
+ * going through the GL state cache.
+ */
+void gfxgl4_renderer_tex_forget_params(unsigned obj_no);
+
 void gfxgl4_renderer_update_tex(unsigned tex_obj);
 void gfxgl4_renderer_release_tex(unsigned tex_obj);
 
+/*
+ * staging memory for uploading pixels into textures.  Write the pixels into
+ * dat between gfxgl4_tex_upload_map and gfxgl4_tex_upload_unmap, then pass
+ * src to glTexSubImage2D and friends before calling gfxgl4_tex_upload_finish.
+ */
+struct gfxgl4_tex_upload {
+    void *dat;       // caller writes the pixels here
+    void const *src; // pixel pointer to hand to glTexSubImage2D
+    size_t len;
+    bool pbo;
+};
+
+void gfxgl4_tex_upload_map(struct gfxgl4_tex_upload *up, size_t n_bytes);
+void gfxgl4_tex_upload_unmap(struct gfxgl4_tex_upload *up);
+void gfxgl4_tex_upload_finish(struct gfxgl4_tex_upload *up);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,7 @@
 #include "washdc/error.h"
 
 #include "../gfx_obj.h"
+#include "../config_file.h"
 #include "gfxgl4_renderer.h"
 #include "gfxgl4_target.h"
 
@@ -43,16 +44,99 @@ static GLuint depth_buf_tex;
 static GLenum draw_buffer = GL_COLOR_ATTACHMENT0;
 static unsigned fbo_width, fbo_height;
 
+#define REND_SCALE_MAX 8
+
+static unsigned rend_scale = 1;
+
+/*
+ * when rend_scale is more than 1, render targets get blitted down to
+ * native resolution through these before being read back.
+ */
+static GLuint resolve_read_fbo, resolve_draw_fbo, resolve_tex;
+static unsigned resolve_width, resolve_height;
+
+/*
+ * readback queue.  GFX_IL_PREFETCH_OBJ copies a render target into one of
+ * these pixel-buffer objects and drops a fence after it, so when the
+ * emulator reads the obj later on, the copy has usually already finished and
+ * there's no need to wait for the GPU to catch up.  A slot goes stale as soon
+ * as its render target gets drawn to again.
+ */
+#define READBACK_SLOT_COUNT 4
+
+struct readback_slot {
+    GLuint pbo;
+    GLsync fence;
+    size_t pbo_len;
+
+    int obj_handle; // -1 if the slot is free
+    unsigned width, height;
+    unsigned stamp;
+};
+
+static struct readback_slot readback_slots[READBACK_SLOT_COUNT];
+static unsigned readback_stamp;
+
 static void gfxgl4_target_obj_read(struct gfx_obj  *obj, void *out,
                                    size_t n_bytes);
 static void gfxgl4_target_grab_pixels(int handle, void *out, GLsizei buf_size);
 
+static struct readback_slot *readback_find(int obj_handle);
+static void readback_drop(struct readback_slot *slot);
+static GLuint gfxgl4_target_resolve(int obj_handle);
+
 void gfxgl4_target_init(void) {
     fbo_width = 0;
     fbo_height = 0;
 
+    int scale;
+    if (cfg_get_int("gfx.rend.internal-scale", &scale) == 0 &&
+        scale >= 1 && scale <= REND_SCALE_MAX) {
+        rend_scale = scale;
+    } else {
+        rend_scale = 1;
+    }
+
     glGenFramebuffers(1, &gfxgl4_tgt_fbo);
     glGenTextures(1, &depth_buf_tex);
+
+    glGenFramebuffers(1, &resolve_read_fbo);
+    glGenFramebuffers(1, &resolve_draw_fbo);
+    glGenTextures(1, &resolve_tex);
+    resolve_width = resolve_height = 0;
+
+    unsigned slot_no;
+    memset(readback_slots, 0, sizeof(readback_slots));
+    readback_stamp = 0;
+    for (slot_no = 0; slot_no < READBACK_SLOT_COUNT; slot_no++) {
+        glGenBuffers(1, &readback_slots[slot_no].pbo);
+        readback_slots[slot_no].obj_handle = -1;
+    }
+}
+
+void gfxgl4_target_cleanup(void) {
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < READBACK_SLOT_COUNT; slot_no++) {
+        struct readback_slot *slot = readback_slots + slot_no;
+        readback_drop(slot);
+        glDeleteBuffers(1, &slot->pbo);
+    }
+    memset(readback_slots, 0, sizeof(readback_slots));
+
+    glDeleteTextures(1, &resolve_tex);
+    glDeleteFramebuffers(1, &resolve_draw_fbo);
+    glDeleteFramebuffers(1, &resolve_read_fbo);
+    resolve_tex = 0;
+    resolve_draw_fbo = resolve_read_fbo = 0;
+
+    glDeleteTextures(1, &depth_buf_tex);
+    glDeleteFramebuffers(1, &gfxgl4_tgt_fbo);
+    depth_buf_tex = 0;
+    gfxgl4_tgt_fbo = 0;
+}
+
+unsigned gfxgl4_target_scale(void) {
+    return rend_scale;
 }
 
 void gfxgl4_target_begin(unsigned width, unsigned height, int tgt_handle) {
@@ -63,24 +147,31 @@ void gfxgl4_target_begin(unsigned width, unsigned height, int tgt_handle) {
 
     glBindFramebuffer(GL_FRAMEBUFFER, gfxgl4_tgt_fbo);
 
-    GLuint color_buf_tex = gfxgl4_renderer_tex(tgt_handle);
+    // anything that got prefetched from this target is about to go stale
+    struct readback_slot *stale = readback_find(tgt_handle);
+    if (stale)
+        readback_drop(stale);
 
     if (gfxgl4_renderer_tex_get_dirty(tgt_handle) ||
         gfxgl4_renderer_tex_get_width(tgt_handle) != width ||
         gfxgl4_renderer_tex_get_height(tgt_handle) != height ||
+        gfxgl4_renderer_tex_get_scale(tgt_handle) != rend_scale ||
         gfxgl4_renderer_tex_get_format(tgt_handle) != GL_RGBA ||
         gfxgl4_renderer_tex_get_dat_type(tgt_handle) != GL_UNSIGNED_BYTE) {
-        glBindTexture(GL_TEXTURE_2D, color_buf_tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                     GL_UNSIGNED_BYTE, NULL);
+        gfxgl4_renderer_tex_storage(tgt_handle, GL_RGBA8, width * rend_scale,
+                                    height * rend_scale, 1);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         gfxgl4_renderer_tex_set_dims(tgt_handle, width, height);
+        gfxgl4_renderer_tex_set_scale(tgt_handle, rend_scale);
         gfxgl4_renderer_tex_set_format(tgt_handle, GL_RGBA);
         gfxgl4_renderer_tex_set_dat_type(tgt_handle, GL_UNSIGNED_BYTE);
         gfxgl4_renderer_tex_set_dirty(tgt_handle, false);
+        gfxgl4_renderer_tex_forget_params(tgt_handle);
     }
 
+    GLuint color_buf_tex = gfxgl4_renderer_tex(tgt_handle);
+
     if (width != fbo_width || height != fbo_height) {
         // change texture dimensions
         // TODO: is all of this necessary, or just the glTexImage2D stuff?
@@ -94,10 +185,13 @@ void gfxgl4_target_begin(unsigned width, unsigned height, int tgt_handle) {
          * if we ever have to move to an API that doesn't mandate all implementations
          * support this (like Vulkan or GLES) then we need a better approach to depth
          * buffer precision
+         *
+         * The stencil bits are for modifier volumes.
          */
         glBindTexture(GL_TEXTURE_2D, depth_buf_tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0,
-                     GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8,
+                     width * rend_scale, height * rend_scale, 0,
+                     GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     }
@@ -106,11 +200,11 @@ void gfxgl4_target_begin(unsigned width, unsigned height, int tgt_handle) {
      * it is guaranteed that fbo_width == width && fbo_height == height due to
      * the above if statement.
      */
-    glViewport(0, 0, width, height);
+    glViewport(0, 0, width * rend_scale, height * rend_scale);
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                            GL_TEXTURE_2D, color_buf_tex, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
                            GL_TEXTURE_2D, depth_buf_tex, 0);
     glBindTexture(GL_TEXTURE_2D, color_buf_tex);
     glDrawBuffers(1, &draw_buffer);
@@ -154,9 +248,53 @@ void gfxgl4_target_end(int tgt_handle) {
     gfx_obj_get(tgt_handle)->state = GFX_OBJ_STATE_TEX;
 }
 
+/*
+ * returns a texture holding obj_handle's pixels at native resolution.  If the
+ * obj was rendered at a higher resolution, it gets downsampled first.
+ */
+static GLuint gfxgl4_target_resolve(int obj_handle) {
+    GLuint color_buf_tex = gfxgl4_renderer_tex(obj_handle);
+    unsigned scale = gfxgl4_renderer_tex_get_scale(obj_handle);
+    if (scale <= 1)
+        return color_buf_tex;
+
+    unsigned width = gfxgl4_renderer_tex_get_width(obj_handle);
+    unsigned height = gfxgl4_renderer_tex_get_height(obj_handle);
+
+    if (width != resolve_width || height != resolve_height) {
+        glBindTexture(GL_TEXTURE_2D, resolve_tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        resolve_width = width;
+        resolve_height = height;
+    }
+
+    glNamedFramebufferTexture(resolve_read_fbo, GL_COLOR_ATTACHMENT0,
+                              color_buf_tex, 0);
+    glNamedFramebufferTexture(resolve_draw_fbo, GL_COLOR_ATTACHMENT0,
+                              resolve_tex, 0);
+
+    // this can happen in the middle of a render, so don't let it get scissored
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    if (scissor)
+        glDisable(GL_SCISSOR_TEST);
+    glBlitNamedFramebuffer(resolve_read_fbo, resolve_draw_fbo,
+                           0, 0, width * scale, height * scale,
+                           0, 0, width, height,
+                           GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    if (scissor)
+        glEnable(GL_SCISSOR_TEST);
+
+    return resolve_tex;
+}
+
 static void gfxgl4_target_grab_pixels(int obj_handle, void *out,
                                       GLsizei buf_size) {
-    size_t length_expect = fbo_width * fbo_height * 4 * sizeof(uint8_t);
+    size_t length_expect = gfxgl4_renderer_tex_get_width(obj_handle) *
+        gfxgl4_renderer_tex_get_height(obj_handle) * 4 * sizeof(uint8_t);
 
     if (buf_size < length_expect) {
         fprintf(stderr, "need at least 0x%08x bytes (have 0x%08x)\n",
@@ -166,12 +304,107 @@ static void gfxgl4_target_grab_pixels(int obj_handle, void *out,
         RAISE_ERROR(ERROR_MEM_OUT_OF_BOUNDS);
     }
 
-    GLuint color_buf_tex = gfxgl4_renderer_tex(obj_handle);
+    struct readback_slot *slot = readback_find(obj_handle);
+    if (slot && slot->width * slot->height * 4 == length_expect) {
+        /*
+         * the timeout is in nanoseconds.  This should almost never have to
+         * wait since the copy was started a while ago.
+         */
+        GLenum stat = glClientWaitSync(slot->fence,
+                                       GL_SYNC_FLUSH_COMMANDS_BIT,
+                                       (GLuint64)1000 * 1000 * 1000);
+        if (stat == GL_ALREADY_SIGNALED || stat == GL_CONDITION_SATISFIED) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+            void const *src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                               length_expect, GL_MAP_READ_BIT);
+            if (src)
+                memcpy(out, src, length_expect);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            readback_drop(slot);
+            if (src)
+                return;
+        } else {
+            fprintf(stderr, "%s - timed out waiting for readback of obj %d\n",
+                    __func__, obj_handle);
+            readback_drop(slot);
+        }
+    } else if (slot) {
+        // the target got resized since the prefetch
+        readback_drop(slot);
+    }
+
+    GLuint color_buf_tex = gfxgl4_target_resolve(obj_handle);
     glBindTexture(GL_TEXTURE_2D, color_buf_tex);
     glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, out);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void gfxgl4_target_prefetch_obj(struct gfx_il_inst *cmd) {
+    int obj_handle = cmd->arg.prefetch_obj.obj_no;
+    struct gfx_obj *obj = gfx_obj_get(obj_handle);
+
+    // only render targets that have actually been rendered to
+    if (obj->on_read != gfxgl4_target_obj_read ||
+        obj->state != GFX_OBJ_STATE_TEX)
+        return;
+
+    struct readback_slot *slot = readback_find(obj_handle);
+    if (!slot) {
+        // take a free slot, or else whichever one is oldest
+        unsigned slot_no;
+        for (slot_no = 0; slot_no < READBACK_SLOT_COUNT; slot_no++) {
+            struct readback_slot *cand = readback_slots + slot_no;
+            if (cand->obj_handle < 0) {
+                slot = cand;
+                break;
+            }
+            if (!slot || cand->stamp < slot->stamp)
+                slot = cand;
+        }
+    }
+    readback_drop(slot);
+
+    unsigned width = gfxgl4_renderer_tex_get_width(obj_handle);
+    unsigned height = gfxgl4_renderer_tex_get_height(obj_handle);
+    size_t n_bytes = width * height * 4 * sizeof(uint8_t);
+    if (!n_bytes)
+        return;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    if (slot->pbo_len < n_bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, n_bytes, NULL, GL_STREAM_READ);
+        slot->pbo_len = n_bytes;
+    }
+
+    // the resolve is queued on the GPU ahead of the copy into the PBO
+    glBindTexture(GL_TEXTURE_2D, gfxgl4_target_resolve(obj_handle));
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->obj_handle = obj_handle;
+    slot->width = width;
+    slot->height = height;
+    slot->stamp = readback_stamp++;
+}
+
+static struct readback_slot *readback_find(int obj_handle) {
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < READBACK_SLOT_COUNT; slot_no++)
+        if (readback_slots[slot_no].obj_handle == obj_handle)
+            return readback_slots + slot_no;
+    return NULL;
+}
+
+static void readback_drop(struct readback_slot *slot) {
+    if (slot->fence)
+        glDeleteSync(slot->fence);
+    slot->fence = NULL;
+    slot->obj_handle = -1;
+}
+
 void gfxgl4_target_bind_obj(struct gfx_il_inst *cmd) {
     int obj_handle = cmd->arg.bind_render_target.gfx_obj_handle;
 #ifdef INVARIANTS
@@ -202,6 +435,11 @@ static void gfxgl4_target_obj_read(struct gfx_obj *obj, void *out,
     if (obj->state == GFX_OBJ_STATE_TEX) {
         gfxgl4_target_grab_pixels(gfx_obj_handle(obj), out, n_bytes);
     } else {
+        // the obj was written to since the last time it was rendered
+        struct readback_slot *stale = readback_find(gfx_obj_handle(obj));
+        if (stale)
+            readback_drop(stale);
+
         gfx_obj_alloc(obj);
         memcpy(out, obj->dat, n_bytes);
     }
@@ -28,16 +28,31 @@
 /* code for configuring opengl's rendering target (which is a texture+FBO) */
 
 void gfxgl4_target_init(void);
+void gfxgl4_target_cleanup(void);
 
 void gfxgl4_target_bind_obj(struct gfx_il_inst *cmd);
 void gfxgl4_target_unbind_obj(struct gfx_il_inst *cmd);
 
+/*
+ * internal resolution multiplier.  Render targets are this many times larger
+ * than the guest's framebuffer in each direction, and get scaled back down
+ * when the guest reads them.
+ */
+unsigned gfxgl4_target_scale(void);
+
 // call this before rendering to the target
 void gfxgl4_target_begin(unsigned width, unsigned height, int tgt_handle);
 
 // call this when done rendering to the target
 void gfxgl4_target_end(int tgt_handle);
 
+/*
+ * start an asynchronous readback of a render target (GFX_IL_PREFETCH_OBJ).
+ * The next read of that obj uses the result if the target hasn't been
+ * rendered to since.
+ */
+void gfxgl4_target_prefetch_obj(struct gfx_il_inst *cmd);
+
 // this is the FBO that we render to
 extern GLuint gfxgl4_tgt_fbo;
 
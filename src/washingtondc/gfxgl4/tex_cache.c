@@ -43,16 +43,30 @@ void gfxgl4_tex_cache_cleanup(void) {
 }
 
 void gfxgl4_tex_cache_bind(unsigned tex_no, int obj_no, unsigned width,
-                    unsigned height, enum gfx_tex_fmt tex_fmt) {
+                           unsigned height, enum gfx_tex_fmt tex_fmt,
+                           bool mipmap, bool alias) {
     struct gfx_obj *obj = gfx_obj_get(obj_no);
     struct gfxgl4_tex *tex = tex_cache + tex_no;
 
+    // texture slots can get re-pointed at a different obj without an unbind
+    if (tex->valid && tex->obj_handle != obj_no)
+        gfxgl4_tex_cache_evict(tex_no);
+
     tex->obj_handle = obj_no;
     tex->tex_fmt = tex_fmt;
     tex->width = width;
     tex->height = height;
+    tex->mipmap = mipmap;
+    tex->alias = alias;
     tex->valid = true;
 
+    /*
+     * aliased objs are render targets; their GL texture gets filled in by
+     * rendering, not by writes.
+     */
+    if (alias)
+        return;
+
     obj->arg = tex;
     obj->on_write = update_tex_from_obj;
 
@@ -71,6 +85,8 @@ void gfxgl4_tex_cache_unbind(unsigned tex_no) {
  */
 void gfxgl4_tex_cache_evict(unsigned idx) {
     tex_cache[idx].valid = false;
+    if (tex_cache[idx].alias)
+        return;
     struct gfx_obj *obj = gfx_obj_get(tex_cache[idx].obj_handle);
     obj->on_write = NULL;
     obj->arg = NULL;
@@ -32,16 +32,24 @@ struct gfxgl4_tex {
     int obj_handle;
     enum gfx_tex_fmt tex_fmt;
     unsigned width, height;
+    bool mipmap;
+
+    // the gfx_obj is a render target; see bind_tex.alias in gfx_il.h
+    bool alias;
+
     bool valid;
 };
 
 struct gfxgl4_tex const* gfx_gfxgl4_tex_cache_get(unsigned idx);
 
 /*
- * Bind the given gfx_obj to the given texture-unit.
+ * Bind the given gfx_obj to the given texture-unit.  If mipmap is true, the
+ * gfx_obj holds every level of the mip chain.  If alias is true, the gfx_obj
+ * is a render target and the texture unit samples it as-is.
  */
 void gfxgl4_tex_cache_bind(unsigned tex_no, int obj_no, unsigned width,
-                    unsigned height, enum gfx_tex_fmt tex_fmt);
+                           unsigned height, enum gfx_tex_fmt tex_fmt,
+                           bool mipmap, bool alias);
 
 void gfxgl4_tex_cache_unbind(unsigned tex_no);
 
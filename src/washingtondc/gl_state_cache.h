@@ -0,0 +1,317 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * shadow copy of the OpenGL state that gfxgl3 and gfxgl4 change on every
+ * GFX_IL_SET_REND_PARAM.  Calls that wouldn't change anything get dropped.
+ *
+ * This only works if nothing changes the same state behind the cache's back,
+ * so gl_state_invalidate needs to be called after any code which doesn't go
+ * through here.
+ */
+
+#ifndef GL_STATE_CACHE_H_
+#define GL_STATE_CACHE_H_
+
+#ifdef _WIN32
+#include "i_hate_windows.h"
+#endif
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+enum {
+    GL_STATE_PROG_BIT = 1,
+    GL_STATE_ACTIVE_TEX_BIT = 2,
+    GL_STATE_TEX_2D_BIT = 4,
+    GL_STATE_BLEND_ENABLE_BIT = 8,
+    GL_STATE_BLEND_FUNC_BIT = 16,
+    GL_STATE_DEPTH_MASK_BIT = 32,
+    GL_STATE_DEPTH_FUNC_BIT = 64,
+    GL_STATE_TEX_2D_ARRAY_BIT = 128
+};
+
+struct gl_state_stat {
+    unsigned issued, skipped;
+};
+
+struct gl_state_cache {
+    // GL_STATE_*_BIT for every value below that is known to be current
+    unsigned known;
+
+    GLuint prog;
+    GLenum active_tex;
+    GLuint tex_2d; // texture bound to GL_TEXTURE_2D on active_tex
+    GLuint tex_2d_array; // texture bound to GL_TEXTURE_2D_ARRAY on active_tex
+    bool blend_enable;
+    GLenum blend_src, blend_dst;
+    GLboolean depth_mask;
+    GLenum depth_func;
+
+    // cur is the frame in progress, last is the most recently finished frame
+    struct gl_state_stat cur, last;
+};
+
+/*
+ * texture parameters are per-texture state, so each texture object needs one
+ * of these.  zero-initialized means unknown.
+ */
+struct gl_tex_params {
+    GLint min_filter, mag_filter, wrap_s, wrap_t;
+};
+
+/*
+ * uniforms are per-program state, so each program needs one of these for
+ * every uniform.  zero-initialized means unknown.
+ */
+struct gl_uniform_cache {
+    bool valid;
+    GLfloat val[16];
+};
+
+static inline void gl_state_init(struct gl_state_cache *cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+static inline void gl_state_invalidate(struct gl_state_cache *cache) {
+    cache->known = 0;
+}
+
+static inline void gl_state_begin_frame(struct gl_state_cache *cache) {
+    memset(&cache->cur, 0, sizeof(cache->cur));
+}
+
+static inline void gl_state_end_frame(struct gl_state_cache *cache) {
+    cache->last = cache->cur;
+}
+
+// returns true if the call needs to be issued
+static inline bool
+gl_state_check(struct gl_state_cache *cache, unsigned bit, bool same) {
+    if ((cache->known & bit) && same) {
+        cache->cur.skipped++;
+        return false;
+    }
+    cache->known |= bit;
+    cache->cur.issued++;
+    return true;
+}
+
+static inline void
+gl_state_use_program(struct gl_state_cache *cache, GLuint prog) {
+    if (gl_state_check(cache, GL_STATE_PROG_BIT, cache->prog == prog)) {
+        cache->prog = prog;
+        glUseProgram(prog);
+    }
+}
+
+static inline void
+gl_state_active_tex(struct gl_state_cache *cache, GLenum unit) {
+    if (gl_state_check(cache, GL_STATE_ACTIVE_TEX_BIT,
+                       cache->active_tex == unit)) {
+        cache->active_tex = unit;
+        glActiveTexture(unit);
+
+        // every texture unit has its own binding
+        cache->known &= ~(GL_STATE_TEX_2D_BIT | GL_STATE_TEX_2D_ARRAY_BIT);
+    }
+}
+
+static inline void
+gl_state_bind_tex(struct gl_state_cache *cache, GLuint tex) {
+    /*
+     * the binding is only meaningful if the active texture unit is known,
+     * which it will be if gl_state_active_tex was called first.
+     */
+    bool same = cache->tex_2d == tex &&
+        (cache->known & GL_STATE_ACTIVE_TEX_BIT);
+    if (gl_state_check(cache, GL_STATE_TEX_2D_BIT, same)) {
+        cache->tex_2d = tex;
+        glBindTexture(GL_TEXTURE_2D, tex);
+    }
+}
+
+static inline void
+gl_state_bind_tex_array(struct gl_state_cache *cache, GLuint tex) {
+    bool same = cache->tex_2d_array == tex &&
+        (cache->known & GL_STATE_ACTIVE_TEX_BIT);
+    if (gl_state_check(cache, GL_STATE_TEX_2D_ARRAY_BIT, same)) {
+        cache->tex_2d_array = tex;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+    }
+}
+
+static inline void
+gl_state_tex_param(struct gl_state_cache *cache, GLenum target, GLint *cur,
+                   GLenum pname, GLint val) {
+    if (*cur == val) {
+        cache->cur.skipped++;
+    } else {
+        cache->cur.issued++;
+        *cur = val;
+        glTexParameteri(target, pname, val);
+    }
+}
+
+// set the parameters of the texture currently bound to target
+static inline void
+gl_state_tex_params_target(struct gl_state_cache *cache, GLenum target,
+                           struct gl_tex_params *params,
+                           GLint min_filter, GLint mag_filter,
+                           GLint wrap_s, GLint wrap_t) {
+    gl_state_tex_param(cache, target, &params->min_filter,
+                       GL_TEXTURE_MIN_FILTER, min_filter);
+    gl_state_tex_param(cache, target, &params->mag_filter,
+                       GL_TEXTURE_MAG_FILTER, mag_filter);
+    gl_state_tex_param(cache, target, &params->wrap_s,
+                       GL_TEXTURE_WRAP_S, wrap_s);
+    gl_state_tex_param(cache, target, &params->wrap_t,
+                       GL_TEXTURE_WRAP_T, wrap_t);
+}
+
+// set the parameters of the texture currently bound to GL_TEXTURE_2D
+static inline void
+gl_state_tex_params(struct gl_state_cache *cache, struct gl_tex_params *params,
+                    GLint min_filter, GLint mag_filter,
+                    GLint wrap_s, GLint wrap_t) {
+    gl_state_tex_params_target(cache, GL_TEXTURE_2D, params,
+                               min_filter, mag_filter, wrap_s, wrap_t);
+}
+
+static inline void
+gl_state_blend_enable(struct gl_state_cache *cache, bool enable) {
+    if (gl_state_check(cache, GL_STATE_BLEND_ENABLE_BIT,
+                       cache->blend_enable == enable)) {
+        cache->blend_enable = enable;
+        if (enable)
+            glEnable(GL_BLEND);
+        else
+            glDisable(GL_BLEND);
+    }
+}
+
+static inline void
+gl_state_blend_func(struct gl_state_cache *cache, GLenum src, GLenum dst) {
+    if (gl_state_check(cache, GL_STATE_BLEND_FUNC_BIT,
+                       cache->blend_src == src && cache->blend_dst == dst)) {
+        cache->blend_src = src;
+        cache->blend_dst = dst;
+        glBlendFunc(src, dst);
+    }
+}
+
+static inline void
+gl_state_depth_mask(struct gl_state_cache *cache, GLboolean mask) {
+    if (gl_state_check(cache, GL_STATE_DEPTH_MASK_BIT,
+                       cache->depth_mask == mask)) {
+        cache->depth_mask = mask;
+        glDepthMask(mask);
+    }
+}
+
+static inline void
+gl_state_depth_func(struct gl_state_cache *cache, GLenum func) {
+    if (gl_state_check(cache, GL_STATE_DEPTH_FUNC_BIT,
+                       cache->depth_func == func)) {
+        cache->depth_func = func;
+        glDepthFunc(func);
+    }
+}
+
+/*
+ * the uniform functions operate on the currently-bound program, and ucache
+ * has to belong to that program.  ucache can be NULL if the program isn't
+ * known, in which case the call always gets issued.
+ */
+static inline bool
+gl_state_check_uniform(struct gl_state_cache *cache,
+                       struct gl_uniform_cache *ucache,
+                       GLfloat const *val, unsigned n_vals) {
+    if (!ucache) {
+        cache->cur.issued++;
+        return true;
+    }
+    if (ucache->valid &&
+        memcmp(ucache->val, val, n_vals * sizeof(GLfloat)) == 0) {
+        cache->cur.skipped++;
+        return false;
+    }
+    ucache->valid = true;
+    memcpy(ucache->val, val, n_vals * sizeof(GLfloat));
+    cache->cur.issued++;
+    return true;
+}
+
+static inline void
+gl_state_uniform1i(struct gl_state_cache *cache,
+                   struct gl_uniform_cache *ucache, GLint slot, GLint val) {
+    GLfloat as_float;
+    memcpy(&as_float, &val, sizeof(as_float));
+    if (gl_state_check_uniform(cache, ucache, &as_float, 1))
+        glUniform1i(slot, val);
+}
+
+static inline void
+gl_state_uniform1f(struct gl_state_cache *cache,
+                   struct gl_uniform_cache *ucache, GLint slot, GLfloat val) {
+    if (gl_state_check_uniform(cache, ucache, &val, 1))
+        glUniform1f(slot, val);
+}
+
+static inline void
+gl_state_uniform2f(struct gl_state_cache *cache,
+                   struct gl_uniform_cache *ucache, GLint slot,
+                   GLfloat v0, GLfloat v1) {
+    GLfloat val[2] = { v0, v1 };
+    if (gl_state_check_uniform(cache, ucache, val, 2))
+        glUniform2f(slot, v0, v1);
+}
+
+static inline void
+gl_state_uniform4f(struct gl_state_cache *cache,
+                   struct gl_uniform_cache *ucache, GLint slot,
+                   GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+    GLfloat val[4] = { v0, v1, v2, v3 };
+    if (gl_state_check_uniform(cache, ucache, val, 4))
+        glUniform4f(slot, v0, v1, v2, v3);
+}
+
+static inline void
+gl_state_uniform_mat2(struct gl_state_cache *cache,
+                      struct gl_uniform_cache *ucache, GLint slot,
+                      GLboolean transpose, GLfloat const *val) {
+    if (gl_state_check_uniform(cache, ucache, val, 4))
+        glUniformMatrix2fv(slot, 1, transpose, val);
+}
+
+static inline void
+gl_state_uniform_mat4(struct gl_state_cache *cache,
+                      struct gl_uniform_cache *ucache, GLint slot,
+                      GLboolean transpose, GLfloat const *val) {
+    if (gl_state_check_uniform(cache, ucache, val, 16))
+        glUniformMatrix4fv(slot, 1, transpose, val);
+}
+
+#endif
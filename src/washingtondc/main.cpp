@@ -42,6 +42,9 @@
 #include "console_config.hpp"
 #include "gfxgl3/gfxgl3_renderer.h"
 #include "gfxgl4/gfxgl4_renderer.h"
+#include "gfxgl4/gfxgl4_prog_cache.h"
+#include "capture.h"
+#include "stream.h"
 #include "soft_gfx/soft_gfx.h"
 #include "stdio_hostfile.hpp"
 #include "washdc_getopt.h"
@@ -50,6 +53,7 @@
 
 #ifdef USE_LIBEVENT
 #include "frontend_io/io_thread.hpp"
+#include "frontend_io/upload_server.hpp"
 #endif
 
 #ifdef ENABLE_DEBUGGER
@@ -68,6 +72,7 @@
 
 struct renderer const *renderer;
 static std::string rend_string;
+static bool rend_thread;
 
 static struct washdc_sound_intf snd_intf;
 static struct washdc_hostfile_api hostfile_api;
@@ -88,9 +93,10 @@ static void print_usage(char const *cmd) {
             "\t-g washdbg\tenable remote WashDbg backend\n"
             "\t-d\t\tenable direct boot (skip BIOS)\n"
             "\t-u\t\tskip IP.BIN and boot straight to 1ST_READ.BIN\n"
-            "\t-s\t\tpath to dreamcast system call image (only needed for "
-            "direct boot)\n"
+            "\t-s\t\tpath to dreamcast system call image (direct boot "
+            "only; system calls are emulated if omitted)\n"
             "\t-t\t\testablish serial server over TCP port 1998\n"
+            "\t-U\t\taccept program uploads over TCP port 1997\n"
             "\t-h\t\tdisplay this message and exit\n"
             "\t-l\t\tdump logs to stdout\n"
             "\t-m\t\tmount the given image in the GD-ROM drive\n"
@@ -98,9 +104,23 @@ static void print_usage(char const *cmd) {
             "\t-p\t\tdisable the dynarec and enable the interpreter instead\n"
             "\t-j\t\tenable dynamic recompiler (as opposed to interpreter)\n"
             "\t-v\t\tenable verbose logging\n"
-            "\t-x\t\tenable native x86_64 dynamic recompiler backend "
+            "\t-e\t\trender graphics from a separate thread (disables the "
+            "overlay)\n"
+            "\t-a\t\trun the ARM7 sound CPU on a separate thread\n"
+            "\t-k\t\tenable dynamic recompiler for the ARM7 sound CPU\n"
+            "\t-x\t\tenable native (x86_64 or AArch64) dynamic recompiler backend "
             "(default)\n"
-            "\t-r opengl|soft\tselect renderer (default is opengl))\n");
+            "\t-r opengl|soft\tselect renderer (default is opengl))\n"
+            "\t-R <path>\trecord controller input to a replay file\n"
+            "\t-P <path>\tplay back a replay file at unlimited speed\n"
+            "\t-T <path>\twrite a Chrome trace-event timeline to path\n"
+            "\t-F <frames>\tfast-forward: only draw one out of every <frames> "
+            "frames\n\t\t\tand mute the sound\n"
+            "\t-S <frames>\tskip drawing up to <frames> frames in a row when "
+            "the\n\t\t\thost can't keep up\n"
+            "\t-Y <host:port>\tstream video and audio over UDP and take "
+            "controller\n\t\t\tinput back from the same address (gl4 "
+            "only)\n");
 }
 
 struct washdc_gameconsole const *console;
@@ -242,19 +262,27 @@ int main(int argc, char **argv) {
     bool enable_jit = false, enable_native_jit = false,
         enable_interpreter = false, inline_mem = true;
     bool log_stdout = false, log_verbose = false;
+    bool arm7_thread = false, arm7_jit = false;
     struct washdc_launch_settings settings = { };
     char const *console_name = NULL;
     bool launch_wizard = false;
     char const *dc_bios_path = NULL, *dc_flash_path = NULL;
     bool write_to_flash_mem = false;
     char const *gfx_backend = "opengl";
+    char const *path_replay_record = NULL, *path_replay_play = NULL;
+    char const *path_trace = NULL;
+    int turbo_frames = 0;
+    int frameskip_max = 0;
+    char const *stream_dest = NULL;
 
     create_cfg_dir();
     create_data_dir();
     create_screenshot_dir();
     create_vmu_dir();
+    create_capture_dir();
+    capture_set_dir(capture_dir().c_str());
 
-    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:r:htjxpnlv")) != -1) {
+    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:r:R:P:T:F:S:Y:htUjxpnlveak")) != -1) {
         switch (opt) {
         case 'g':
             enable_debugger = true;
@@ -277,6 +305,11 @@ int main(int argc, char **argv) {
         case 't':
             enable_serial = true;
             break;
+#ifdef USE_LIBEVENT
+        case 'U':
+            upload_server_enable();
+            break;
+#endif
         case 'm':
             path_gdi = washdc_optarg;
             break;
@@ -301,6 +334,15 @@ int main(int argc, char **argv) {
         case 'v':
             log_verbose = true;
             break;
+        case 'e':
+            rend_thread = true;
+            break;
+        case 'a':
+            arm7_thread = true;
+            break;
+        case 'k':
+            arm7_jit = true;
+            break;
         case 'c':
             console_name = washdc_optarg;
             break;
@@ -316,6 +358,32 @@ int main(int argc, char **argv) {
         case 'r':
             gfx_backend = washdc_optarg;
             break;
+        case 'R':
+            path_replay_record = washdc_optarg;
+            break;
+        case 'P':
+            path_replay_play = washdc_optarg;
+            break;
+        case 'T':
+            path_trace = washdc_optarg;
+            break;
+        case 'F':
+            turbo_frames = atoi(washdc_optarg);
+            if (turbo_frames <= 0) {
+                fprintf(stderr, "ERROR: -F needs a number of frames\n");
+                exit(1);
+            }
+            break;
+        case 'S':
+            frameskip_max = atoi(washdc_optarg);
+            if (frameskip_max <= 0) {
+                fprintf(stderr, "ERROR: -S needs a number of frames\n");
+                exit(1);
+            }
+            break;
+        case 'Y':
+            stream_dest = washdc_optarg;
+            break;
         default:
             print_usage(cmd);
             exit(0);
@@ -346,6 +414,42 @@ int main(int argc, char **argv) {
 
     settings.log_to_stdout = log_stdout;
     settings.log_verbose = log_verbose;
+    settings.rend_thread = rend_thread;
+    settings.arm7_thread = arm7_thread;
+    settings.arm7_jit = arm7_jit;
+    cfg_get_bool("wash.intp.predecode", &settings.intp_predecode);
+    cfg_get_bool("wash.arm7.idle-skip", &settings.arm7_idle_skip);
+    cfg_get_int("wash.sched.timeslice-us", &settings.timeslice_us);
+    cfg_get_bool("wash.sched.adaptive-timeslice", &settings.timeslice_adaptive);
+    cfg_get_bool("wash.sh4.icache", &settings.sh4_icache);
+    cfg_get_bool("wash.sh4.fpu-pedantic", &settings.fpu_pedantic);
+    cfg_get_bool("wash.jit.superblocks", &settings.jit_superblocks);
+    cfg_get_bool("wash.jit.idle-skip", &settings.jit_idle_skip);
+    cfg_get_bool("wash.jit.stall-model", &settings.jit_stall_model);
+    cfg_get_bool("wash.jit.persist-cache", &settings.jit_persist_cache);
+    cfg_get_int("wash.jit.cache-budget", &settings.jit_cache_budget);
+    cfg_get_bool("wash.savestate.fork", &settings.savestate_fork);
+    cfg_get_int("wash.rewind.interval", &settings.rewind_interval);
+    cfg_get_int("wash.rewind.budget", &settings.rewind_budget);
+    char const *screenshot_fmt = cfg_get_node("wash.screenshot.format");
+    if (screenshot_fmt && strcmp(screenshot_fmt, "qoi") == 0)
+        settings.screenshot_qoi = true;
+    else if (screenshot_fmt && strcmp(screenshot_fmt, "png") != 0)
+        fprintf(stderr, "unrecognized screenshot format \"%s\"\n",
+                screenshot_fmt);
+    cfg_get_int("wash.screenshot.png-level", &settings.screenshot_png_level);
+    settings.emu_cpus = cfg_get_node("wash.thread.emu-cpus");
+    settings.rend_cpus = cfg_get_node("wash.thread.rend-cpus");
+    settings.arm7_cpus = cfg_get_node("wash.thread.arm7-cpus");
+    settings.jit_cpus = cfg_get_node("wash.thread.jit-cpus");
+    settings.tex_dump_dir = cfg_get_node("wash.tex.dump-dir");
+    settings.tex_pack_dir = cfg_get_node("wash.tex.pack-dir");
+    settings.path_replay_record = path_replay_record;
+    settings.path_replay_play = path_replay_play;
+    settings.path_trace = path_trace;
+    settings.turbo_frames = turbo_frames;
+    settings.frameskip_max = frameskip_max;
+    settings.frame_limit = !path_replay_play;
     settings.write_to_flash = write_to_flash_mem;
 
     settings.hostfile_api = &hostfile_api;
@@ -359,6 +463,12 @@ int main(int argc, char **argv) {
     hostfile_api.flush = file_stdio_flush;
     hostfile_api.open_cfg_file = open_cfg_file;
     hostfile_api.open_screenshot = open_screenshot;
+#ifndef _WIN32
+    hostfile_api.pread = file_stdio_pread;
+    hostfile_api.preadv = file_stdio_preadv;
+    hostfile_api.map = file_stdio_map;
+    hostfile_api.unmap = file_stdio_unmap;
+#endif
 #ifdef _WIN32
     hostfile_api.pathsep = '\\';
 #else
@@ -398,6 +508,7 @@ int main(int argc, char **argv) {
     settings.controllers[3][2] = get_cfg_controller("wash.dc.port.3.2");
 
     cfg_get_bool("wash.dbg.dump_mem_on_error", &settings.dump_mem_on_error);
+    cfg_get_bool("wash.log.drop-on-overflow", &settings.log_drop_on_overflow);
 
     if (enable_debugger && enable_washdbg) {
         fprintf(stderr, "You can't enable WashDbg and GDB at the same time\n");
@@ -405,13 +516,15 @@ int main(int argc, char **argv) {
     }
 
     if (enable_debugger || enable_washdbg) {
-        if (enable_jit || enable_native_jit) {
-            fprintf(stderr, "Debugger enabled - this overrides the jit "
-                    "compiler and sets WashingtonDC to interpreter mode\n");
-            enable_jit = false;
+        if (enable_native_jit) {
+            fprintf(stderr, "Debugger enabled - this overrides the native "
+                    "jit backend and sets WashingtonDC to jit-interpreter "
+                    "mode\n");
             enable_native_jit = false;
+            enable_jit = true;
         }
-        enable_interpreter = true;
+        if (!enable_jit)
+            enable_interpreter = true;
 
         if (washdc_have_debugger()) {
             settings.dbg_enable = true;
@@ -441,8 +554,8 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    if (washdc_have_x86_64_jit()) {
-        // enable the jit (with x86_64 backend) by default
+    if (washdc_have_native_jit()) {
+        // enable the jit (with the native backend) by default
         if (!(enable_jit || enable_native_jit || enable_interpreter))
             enable_native_jit = true;
     } else {
@@ -454,25 +567,25 @@ int main(int argc, char **argv) {
     settings.inline_mem = inline_mem;
     settings.enable_jit = enable_jit || enable_native_jit;
 
-    if (washdc_have_x86_64_jit()) {
+    if (washdc_have_native_jit()) {
         settings.enable_native_jit = enable_native_jit;
+        cfg_get_bool("wash.jit.dual-map", &settings.jit_dual_map);
+        cfg_get_bool("wash.jit.fastmem", &settings.jit_fastmem);
+        cfg_get_bool("wash.jit.tiered", &settings.jit_tiered);
+        cfg_get_bool("wash.jit.perf-map", &settings.jit_perf_map);
+        cfg_get_bool("wash.jit.bg-compile", &settings.jit_bg_compile);
     } else {
         if (enable_native_jit) {
-            fprintf(stderr, "ERROR: the native x86_64 jit backend was not enabled "
+            fprintf(stderr, "ERROR: the native jit backend was not enabled "
                     "for this build configuration.\n"
-                    "Rebuild WashingtonDC with -DENABLE_JIT_X86_64=On to enable "
-                    "the native x86_64 jit backend.\n");
+                    "Rebuild WashingtonDC with -DENABLE_JIT_X86_64=On or "
+                    "-DENABLE_JIT_AARCH64=On to enable the native jit "
+                    "backend.\n");
             exit(1);
         }
     }
 
     if (skip_ip_bin) {
-        if (!path_syscalls_bin) {
-            fprintf(stderr, "Error: cannot direct-boot without a system call "
-                    "table (-s flag).\n");
-            exit(1);
-        }
-
         if (!path_1st_read_bin) {
             fprintf(stderr, "Error: cannot direct-boot without a "
                     "1ST-READ.BIN\n");
@@ -484,12 +597,6 @@ int main(int argc, char **argv) {
         settings.path_1st_read_bin = path_1st_read_bin;
         settings.path_syscalls_bin = path_syscalls_bin;
     } else if (boot_direct) {
-        if (!path_syscalls_bin) {
-            fprintf(stderr, "Error: cannot direct-boot without a system call "
-                    "table (-s flag).\n");
-            exit(1);
-        }
-
         settings.boot_mode = WASHDC_BOOT_IP_BIN;
         settings.path_ip_bin = path_ip_bin;
         settings.path_syscalls_bin = path_syscalls_bin;
@@ -535,8 +642,10 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    if (have_console_name)
+    if (have_console_name) {
         settings.path_rtc = console_get_rtc_path(console_name);
+        settings.path_jit_cache = console_get_jit_cache_path(console_name);
+    }
     settings.enable_serial = enable_serial;
     settings.path_gdi = path_gdi;
     settings.win_intf = get_win_intf_glfw();
@@ -607,6 +716,56 @@ int main(int argc, char **argv) {
 
     settings.gfx_rend_if = renderer->rend_if;
 
+    // gfxgl4 is the only renderer that can do its own palette lookups
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.gpu-palette", &settings.gpu_palette);
+
+    cfg_get_bool("gfx.rend.persistent-verts", &settings.persistent_verts);
+
+    // soft_gfx only understands the float vertex format
+    if (renderer == &gfxgl4_renderer || renderer == &gfxgl3_renderer)
+        cfg_get_bool("gfx.rend.packed-verts", &settings.packed_verts);
+
+    // gfxgl4 is the only renderer that can do indexed draws
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.merge-draws", &settings.merge_draws);
+
+    // gfxgl4 is the only renderer that can draw modifier volumes
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.mod-vols", &settings.mod_vols);
+
+    // gfxgl3 has no OIT of its own, so pvr2_core can sort its polygons for it
+    if (renderer == &gfxgl3_renderer)
+        cfg_get_bool("gfx.rend.poly-sort", &settings.poly_sort);
+
+    cfg_get_bool("gfx.rend.list-cache", &settings.list_cache);
+    cfg_get_bool("gfx.rend.list-threads", &settings.list_exec_threads);
+
+    // gfxgl4 is the only renderer that can sample its render targets
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.fb-tex-alias", &settings.fb_tex_alias);
+
+    // gfxgl4 is the only renderer with a readback queue
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.async-readback", &settings.async_readback);
+
+    // gfxgl4 is the only renderer that can decode the guest's framebuffer
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.gpu-fb-conv", &settings.gpu_fb_conv);
+
+    // gfxgl4 is the only renderer that saves its shader programs
+    bool program_cache = false;
+    if (renderer == &gfxgl4_renderer)
+        cfg_get_bool("gfx.rend.program-cache", &program_cache);
+    if (program_cache) {
+        create_shader_cache_dir();
+        gfxgl4_prog_cache_set_dir(shader_cache_dir().c_str());
+    }
+
+    // frames can only be queued up for presentation from the render thread
+    if (rend_thread)
+        cfg_get_bool("gfx.rend.present-mailbox", &settings.present_mailbox);
+
     if (renderer == &gfxgl4_renderer)
         rend_string = "gfxgl4";
     else if (renderer == &gfxgl3_renderer)
@@ -619,7 +778,7 @@ int main(int argc, char **argv) {
     printf("\"%s\" renderer selected\n", rend_string.c_str());
 
 #ifdef USE_LIBEVENT
-    io::init();
+    io::init(cfg_get_node("wash.thread.io-cpus"));
 #endif
 
     static struct renderer_callbacks callbacks = { };
@@ -629,11 +788,28 @@ int main(int argc, char **argv) {
     callbacks.win_update = win_glfw_update;
     renderer->set_callbacks(&callbacks);
 
+    /*
+     * the overlay's performance window is the only thing here that reads the
+     * GPU timings, so it turns them on when it's visible.
+     */
+    rend_set_gpu_timing(false);
+
     console = washdc_init(&settings);
 
     if (overlay_enabled())
         overlay::init(enable_debugger || enable_washdbg);
 
+    // replays are for benchmarking, so don't wait on the audio device
+    if (path_replay_play)
+        sound::set_sync_mode(sound::SYNC_MODE_UNLIMITED);
+
+    if (stream_dest) {
+        if (renderer != &gfxgl4_renderer)
+            fprintf(stderr, "WARNING: streaming needs the gl4 renderer\n");
+        else if (stream_start(stream_dest) != 0)
+            exit(1);
+    }
+
     washdc_run();
 
     renderer->set_callbacks(NULL);
@@ -648,6 +824,9 @@ int main(int argc, char **argv) {
 
     washdc_cleanup();
 
+    capture_cleanup();
+    stream_stop();
+
     win_glfw_cleanup();
 
     cfg_cleanup();
@@ -671,7 +850,41 @@ std::string const& rend_name(void) {
     return rend_string;
 }
 
+bool rend_gl_call_stat(unsigned *issued, unsigned *skipped) {
+    if (!renderer->get_stat)
+        return false;
+
+    struct renderer_stat stat;
+    renderer->get_stat(&stat);
+    *issued = stat.gl_calls_issued;
+    *skipped = stat.gl_calls_skipped;
+    return true;
+}
+
+bool rend_gpu_ms(double ms[RENDERER_GPU_PHASE_COUNT]) {
+    if (!renderer->get_stat)
+        return false;
+
+    struct renderer_stat stat;
+    renderer->get_stat(&stat);
+    if (!stat.gpu_ms_valid)
+        return false;
+    memcpy(ms, stat.gpu_ms, sizeof(stat.gpu_ms));
+    return true;
+}
+
+void rend_set_gpu_timing(bool enable) {
+    if (renderer->set_gpu_timing)
+        renderer->set_gpu_timing(enable);
+}
+
 bool overlay_enabled(void) {
+    /*
+     * the overlay is updated from the main thread, so it can't share the
+     * graphics context with the render thread.
+     */
+    if (rend_thread)
+        return false;
     return renderer == &gfxgl3_renderer ||
         renderer == &gfxgl4_renderer;
 }
@@ -24,9 +24,26 @@
 #define REND_IF_HPP_
 
 #include "washdc/gfx/gfx_all.h"
+#include "renderer.h"
 
 std::string const& rend_name(void);
 
+/*
+ * OpenGL calls made and dropped as redundant by the renderer during the last
+ * frame.  Returns false if the renderer doesn't keep track of that.
+ */
+bool rend_gl_call_stat(unsigned *issued, unsigned *skipped);
+
+/*
+ * GPU time spent in each renderer_gpu_phase during a recent frame, in
+ * milliseconds.  Returns false if the renderer doesn't time its phases or
+ * nothing has come back from the GPU yet.
+ */
+bool rend_gpu_ms(double ms[RENDERER_GPU_PHASE_COUNT]);
+
+// turn the renderer's GPU phase timings on or off if it has any
+void rend_set_gpu_timing(bool enable);
+
 bool overlay_enabled(void);
 
 #endif
@@ -37,6 +37,52 @@ struct renderer_callbacks {
     void (*overlay_draw)(void);
 };
 
+enum renderer_gpu_phase {
+    // opaque polygons, and translucent ones when they aren't being sorted
+    RENDERER_GPU_PHASE_OPAQUE,
+    RENDERER_GPU_PHASE_PUNCH_THROUGH,
+
+    // drawing translucent polygons into the per-pixel lists
+    RENDERER_GPU_PHASE_OIT_BUILD,
+
+    // sorting and blending the per-pixel lists
+    RENDERER_GPU_PHASE_OIT_RESOLVE,
+
+    // moving framebuffers between render targets and gfx_objs
+    RENDERER_GPU_PHASE_FB_BLIT,
+
+    // drawing the framebuffer to the screen
+    RENDERER_GPU_PHASE_OUTPUT,
+
+    RENDERER_GPU_PHASE_COUNT
+};
+
+static inline char const *renderer_gpu_phase_name(enum renderer_gpu_phase phase) {
+    static char const *names[RENDERER_GPU_PHASE_COUNT] = {
+        "opaque",
+        "punch_through",
+        "oit_build",
+        "oit_resolve",
+        "fb_blit",
+        "output"
+    };
+    return names[phase];
+}
+
+struct renderer_stat {
+    // OpenGL calls made and dropped as redundant during the last frame
+    unsigned gl_calls_issued, gl_calls_skipped;
+
+    /*
+     * GPU time spent in each phase of a recent frame, in milliseconds.  This
+     * lags a frame or two behind because the timestamps get read without
+     * waiting on the GPU.  gpu_ms_valid is false if the renderer doesn't
+     * time its phases or no results have come back yet.
+     */
+    bool gpu_ms_valid;
+    double gpu_ms[RENDERER_GPU_PHASE_COUNT];
+};
+
 struct renderer {
     // for receiving rendering commands from washdc's gfx infrastructure
     struct gfx_rend_if const* rend_if;
@@ -51,6 +97,15 @@ struct renderer {
 
     // optional, can be NULL if your renderer doesn't support renderdoc
     void (*capture_renderdoc)(void);
+
+    // optional, can be NULL
+    void (*get_stat)(struct renderer_stat *stat);
+
+    /*
+     * optional, can be NULL.  Turns the GPU phase timings in renderer_stat on
+     * or off.  They're on by default.
+     */
+    void (*set_gpu_timing)(bool enable);
 };
 
 #ifdef __cplusplus
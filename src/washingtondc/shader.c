@@ -24,6 +24,7 @@
 #include "i_hate_windows.h"
 #endif
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -159,8 +160,11 @@ void shader_load_frag_from_file(struct shader *out, char const *verstr,
     shader_load_frag_from_file_with_preamble(out, verstr, frag_shader_path, NULL);
 }
 
-void shader_link(struct shader *out) {
+static void do_shader_link(struct shader *out, bool retrievable) {
     GLuint shader_obj = glCreateProgram();
+    if (retrievable)
+        glProgramParameteri(shader_obj, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
     glAttachShader(shader_obj, out->vert_shader);
     glAttachShader(shader_obj, out->frag_shader);
     glLinkProgram(shader_obj);
@@ -183,6 +187,31 @@ void shader_link(struct shader *out) {
     out->shader_prog_obj = shader_obj;
 }
 
+void shader_link(struct shader *out) {
+    do_shader_link(out, false);
+}
+
+void shader_link_retrievable(struct shader *out) {
+    do_shader_link(out, true);
+}
+
+int shader_load_binary(struct shader *out, GLenum fmt,
+                       void const *bin, GLsizei len) {
+    GLuint shader_obj = glCreateProgram();
+    glProgramBinary(shader_obj, fmt, bin, len);
+
+    GLint shader_success;
+    glGetProgramiv(shader_obj, GL_LINK_STATUS, &shader_success);
+    if (!shader_success) {
+        glDeleteProgram(shader_obj);
+        return -1;
+    }
+
+    out->vert_shader = out->frag_shader = 0;
+    out->shader_prog_obj = shader_obj;
+    return 0;
+}
+
 static char *read_txt(char const *path) {
     FILE *txt_fp;
     char *src;
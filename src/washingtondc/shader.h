@@ -82,6 +82,21 @@ void shader_load_frag(struct shader *out, char const *verstr, char const *frag_s
 
 void shader_link(struct shader *out);
 
+/*
+ * same as shader_link, but tells the driver that the program binary is going
+ * to be read back with glGetProgramBinary.
+ */
+void shader_link_retrievable(struct shader *out);
+
+/*
+ * create a program from a binary that was previously returned by
+ * glGetProgramBinary.  Unlike shader_link, this does not exit on failure
+ * since the driver is allowed to reject binaries at any time (eg after an
+ * update).  Returns 0 on success or -1 on failure.
+ */
+int shader_load_binary(struct shader *out, GLenum fmt,
+                       void const *bin, GLsizei len);
+
 void shader_cleanup(struct shader *shader);
 
 #ifdef __cplusplus
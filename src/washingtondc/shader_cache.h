@@ -33,6 +33,7 @@
 #include <GL/gl.h>
 
 #include "../shader.h"
+#include "gl_state_cache.h"
 
 typedef unsigned shader_key;
 
@@ -62,6 +63,22 @@ typedef unsigned shader_key;
 #define SHADER_KEY_OIT_SHIFT 7
 #define SHADER_KEY_OIT_BIT (1 << SHADER_KEY_OIT_SHIFT)
 
+// bound texture holds palette indices; only valid with SHADER_KEY_TEX_ENABLE
+#define SHADER_KEY_TEX_PALETTE_SHIFT 8
+#define SHADER_KEY_TEX_PALETTE_BIT (1 << SHADER_KEY_TEX_PALETTE_SHIFT)
+
+// bilinear filtering in the shader; only valid with SHADER_KEY_TEX_PALETTE
+#define SHADER_KEY_TEX_PALETTE_LINEAR_SHIFT 9
+#define SHADER_KEY_TEX_PALETTE_LINEAR_BIT \
+    (1 << SHADER_KEY_TEX_PALETTE_LINEAR_SHIFT)
+
+// bound texture is a layer of a texture array; only valid with TEX_ENABLE
+#define SHADER_KEY_TEX_ARRAY_SHIFT 10
+#define SHADER_KEY_TEX_ARRAY_BIT (1 << SHADER_KEY_TEX_ARRAY_SHIFT)
+
+// one past the highest possible key
+#define SHADER_KEY_COUNT (1 << 11)
+
 enum {
     // only valid if SHADER_KEY_TEX_ENABLE_BIT is set
     SHADER_CACHE_SLOT_BOUND_TEX,
@@ -69,6 +86,9 @@ enum {
     // only valid if SHADER_KEY_TEX_ENABLE_BIT is set
     SHADER_CACHE_SLOT_TEX_TRANSFORM,
 
+    // only valid if SHADER_KEY_TEX_ENABLE_BIT is set
+    SHADER_CACHE_SLOT_TEX_OFFSET,
+
     // only valid if SHADER_KEY_PUNCH_THROUGH_BIT is set
     SHADER_CACHE_SLOT_PT_ALPHA_REF,
 
@@ -84,6 +104,12 @@ enum {
 
     SHADER_CACHE_SLOT_DST_BLEND_FACTOR,
 
+    // only valid if SHADER_KEY_TEX_PALETTE_BIT is set
+    SHADER_CACHE_SLOT_PALETTE_TEX,
+
+    // only valid if SHADER_KEY_TEX_ARRAY_BIT is set
+    SHADER_CACHE_SLOT_TEX_LAYER,
+
     SHADER_CACHE_SLOT_COUNT
 };
 
@@ -91,6 +117,10 @@ struct shader_cache_ent {
     struct shader_cache_ent *next;
     shader_key key;
     GLint slots[SHADER_CACHE_SLOT_COUNT];
+
+    // last value uploaded to each of the uniforms in slots
+    struct gl_uniform_cache uniforms[SHADER_CACHE_SLOT_COUNT];
+
     struct shader shader;
 };
 
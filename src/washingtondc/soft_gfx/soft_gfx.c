@@ -20,10 +20,27 @@
  *
  ******************************************************************************/
 
+// this has to come first because it might include i_hate_windows.h
+#include "threading.h"
+
 #include <stdint.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 #define GL3_PROTOTYPES 1
 #include <GL/glew.h>
 #include <GL/gl.h>
@@ -50,7 +67,9 @@ put_pix_blended(struct gfx_obj *obj, int x_pix, int y_pix, uint32_t color,
                 enum Pvr2BlendFactor src_blend_factor,
                 enum Pvr2BlendFactor dst_blend_factor);
 
-static bool user_clip_test(int x_pix, int y_pix);
+static bool
+user_clip_test(struct gfx_rend_param const *param,
+               unsigned const user_clip[4], int x_pix, int y_pix);
 static bool clip_test(int x_pix, int y_pix);
 
 static void soft_gfx_set_callbacks(struct renderer_callbacks const *callbacks);
@@ -113,25 +132,138 @@ static struct fb_poly {
 
 static uint32_t fb[FB_WIDTH * FB_HEIGHT];
 
-static float *w_buffer = NULL;
+/*
+ * Textures are expanded to RGBA8888 the first time a polygon uses them so that
+ * sampling doesn't need to decode the texture's format for every texel.  The
+ * expanded copy is stored in TEX_BLOCK_SIDE x TEX_BLOCK_SIDE blocks so that
+ * texels which are neighbours vertically are also close together in memory.
+ */
+#define TEX_BLOCK_SHIFT 2
+#define TEX_BLOCK_SIDE (1 << TEX_BLOCK_SHIFT)
+#define TEX_BLOCK_MASK (TEX_BLOCK_SIDE - 1)
+
+struct tex {
+    int obj_no;
+    unsigned width, height;
+    enum gfx_tex_fmt fmt;
+
+    // expanded copy of the texture, or NULL if it hasn't been expanded yet
+    uint32_t *texels;
+    unsigned blocks_w;
+};
+
+/*
+ * Like the real PowerVR2, the screen is divided into 32x32 tiles.  Triangles
+ * get binned into every tile their bounding box touches, and then the tiles
+ * get rasterized in parallel when the bins are flushed.
+ */
+#define TILE_SHIFT 5
+#define TILE_SIDE (1 << TILE_SHIFT)
+#define TILE_PIX (TILE_SIDE * TILE_SIDE)
 
 // used for per-pixel order-independent transparency if sort_mode==true
-#define MAX_OIT_PIXELS (FB_WIDTH * FB_HEIGHT * 32)
-static struct oit_pixel {
+#define MAX_OIT_PIXELS_PER_TILE (TILE_PIX * 32)
+struct oit_pixel {
     int rgba[4];
     float w_coord;
     int next_pix_idx; // if less than 0, then there is no next index
     enum Pvr2BlendFactor src_blend_factor, dst_blend_factor;
-} oit_pixels[MAX_OIT_PIXELS];
-static unsigned n_oit_pixels;
+};
 
 /*
- * 1 index into oit_pixels per pixel.  If less than 0 then there is nothing
- * there.
+ * Each tile owns its depth buffer and its OIT buffers, so no two threads
+ * ever touch the same one.
  */
-static int oit_buf[FB_WIDTH * FB_HEIGHT];
+struct tile {
+    // pixel-space bounds of this tile, inclusive
+    int x_min, y_min, x_max, y_max;
 
-static void sort_oit_pix_list(int first_idx);
+    float w_buffer[TILE_PIX];
+
+    /*
+     * 1 index into oit_pixels per pixel.  If less than 0 then there is nothing
+     * there.
+     */
+    int oit_buf[TILE_PIX];
+    struct oit_pixel *oit_pixels;
+    unsigned n_oit_pixels, oit_pixels_alloc;
+
+    // indices into bin_cmds of everything that touches this tile
+    unsigned *cmds;
+    unsigned n_cmds, cmds_alloc;
+};
+
+static struct tile *tiles;
+static unsigned n_tiles_x, n_tiles_y;
+
+static void sort_oit_pix_list(struct oit_pixel *oit_pixels, int first_idx);
+
+/*
+ * rendering state that gets captured when a triangle is binned, since the
+ * triangle won't get rasterized until long after the IL has moved on.
+ */
+struct draw_state {
+    struct gfx_rend_param rend_param;
+    bool blend_enable;
+    bool sort_mode_enable;
+    unsigned user_clip[4];
+
+    // texp is NULL if texturing is disabled, else it points to tex
+    struct tex const *texp;
+    struct tex tex;
+};
+
+enum bin_cmd_tp {
+    BIN_CMD_TRI,
+    BIN_CMD_CLEAR,
+    BIN_CMD_BEGIN_SORT,
+    BIN_CMD_END_SORT
+};
+
+struct bin_cmd {
+    enum bin_cmd_tp tp;
+    union {
+        struct {
+            unsigned state_idx;
+
+            // indices into bin_verts
+            unsigned verts[3];
+        } tri;
+        struct {
+            uint32_t color;
+        } clear;
+    } arg;
+};
+
+static struct bin_cmd *bin_cmds;
+static unsigned n_bin_cmds, bin_cmds_alloc;
+
+static struct draw_state *bin_states;
+static unsigned n_bin_states, bin_states_alloc;
+static bool bin_state_dirty;
+
+/*
+ * every vertex array sent since the last flush, since binned triangles still
+ * point at them.
+ */
+static float *bin_verts;
+static unsigned n_bin_verts, bin_verts_alloc;
+
+// worker pool that rasterizes tiles
+#define MAX_TILE_WORKERS 15
+static washdc_thread tile_workers[MAX_TILE_WORKERS];
+static unsigned n_tile_workers;
+
+// Only wait on or signal the cvars when you hold tile_lock.
+static washdc_mutex tile_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar tile_work_cvar = WASHDC_CVAR_STATIC_INIT;
+static washdc_cvar tile_done_cvar = WASHDC_CVAR_STATIC_INIT;
+static unsigned next_tile, n_tiles_done, n_tiles_queued;
+static bool tile_workers_exit;
+static struct gfx_obj *tile_tgt_obj;
+
+static void flush_tiles(void);
+static void bin_all_tiles(struct bin_cmd const *cmd);
 
 static bool sort_mode_enable;
 static bool blend_enable;
@@ -152,17 +284,24 @@ static unsigned clip[4];
  */
 static unsigned user_clip[4];
 
-static float *vert_array;
+// the current vertex array is vert_array_len vertices starting at bin_verts
+static unsigned vert_array_base;
 unsigned vert_array_len;
 
-struct tex {
-    int obj_no;
-    unsigned width, height;
-    enum gfx_tex_fmt fmt;
-};
 // maps texture objects to gfx objects
 static struct tex textures[GFX_TEX_CACHE_SIZE];
 
+/*
+ * expanded textures which were invalidated while binned draws could still be
+ * referencing them.  These get freed by flush_tiles.
+ */
+static uint32_t **retired_texels;
+static unsigned n_retired_texels, retired_texels_alloc;
+
+static void tex_drop(struct tex *texp);
+static void tex_drop_obj(int obj_no);
+static void tex_free_retired(void);
+
 static void rot90(float out[2], float const in[2]);
 
 struct gfx_rend_if const soft_gfx_if = {
@@ -176,6 +315,117 @@ struct renderer const soft_gfx_renderer = {
     .set_callbacks = soft_gfx_set_callbacks
 };
 
+static unsigned cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+#else
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return n_cpus > 0 ? n_cpus : 1;
+#endif
+}
+
+/*
+ * make sure *arr has room for at least n_elem elements, doubling its size as
+ * necessary.
+ */
+static void *grow_array(void *arr, unsigned *alloc,
+                        unsigned n_elem, size_t elem_sz) {
+    if (n_elem <= *alloc)
+        return arr;
+
+    unsigned new_alloc = *alloc ? *alloc : 64;
+    while (new_alloc < n_elem)
+        new_alloc *= 2;
+
+    void *new_arr = realloc(arr, new_alloc * elem_sz);
+    if (!new_arr) {
+        fprintf(stderr, "ERROR: %s - failed to allocate %u elements\n",
+                __func__, new_alloc);
+        abort();
+    }
+    *alloc = new_alloc;
+    return new_arr;
+}
+
+static void tile_reset_oit(struct tile *tile) {
+    unsigned idx;
+    for (idx = 0; idx < TILE_PIX; idx++)
+        tile->oit_buf[idx] = -1;
+    tile->n_oit_pixels = 0;
+}
+
+static void free_tiles(void) {
+    unsigned idx;
+    for (idx = 0; idx < n_tiles_x * n_tiles_y; idx++) {
+        free(tiles[idx].oit_pixels);
+        free(tiles[idx].cmds);
+    }
+    free(tiles);
+    tiles = NULL;
+    n_tiles_x = n_tiles_y = 0;
+}
+
+static void alloc_tiles(unsigned width, unsigned height) {
+    free_tiles();
+
+    n_tiles_x = (width + TILE_SIDE - 1) >> TILE_SHIFT;
+    n_tiles_y = (height + TILE_SIDE - 1) >> TILE_SHIFT;
+    if (!n_tiles_x || !n_tiles_y) {
+        n_tiles_x = n_tiles_y = 0;
+        return;
+    }
+
+    tiles = calloc(n_tiles_x * n_tiles_y, sizeof(struct tile));
+    if (!tiles) {
+        fprintf(stderr, "ERROR: %s - failure to allocate tiles\n", __func__);
+        abort();
+    }
+
+    unsigned tile_x, tile_y;
+    for (tile_y = 0; tile_y < n_tiles_y; tile_y++) {
+        for (tile_x = 0; tile_x < n_tiles_x; tile_x++) {
+            struct tile *tile = tiles + tile_y * n_tiles_x + tile_x;
+            tile->x_min = tile_x << TILE_SHIFT;
+            tile->y_min = tile_y << TILE_SHIFT;
+            tile->x_max = tile->x_min + TILE_SIDE - 1;
+            tile->y_max = tile->y_min + TILE_SIDE - 1;
+            if (tile->x_max >= width)
+                tile->x_max = width - 1;
+            if (tile->y_max >= height)
+                tile->y_max = height - 1;
+
+            unsigned idx;
+            for (idx = 0; idx < TILE_PIX; idx++)
+                tile->w_buffer[idx] = -INFINITY;
+            tile_reset_oit(tile);
+        }
+    }
+}
+
+static void tile_render(struct tile *tile, struct gfx_obj *obj);
+
+static void tile_worker_main(void *argp) {
+    washdc_mutex_lock(&tile_lock);
+    for (;;) {
+        while (!tile_workers_exit && next_tile >= n_tiles_queued)
+            washdc_cvar_wait(&tile_work_cvar, &tile_lock);
+        if (tile_workers_exit)
+            break;
+
+        unsigned tile_idx = next_tile++;
+        washdc_mutex_unlock(&tile_lock);
+
+        tile_render(tiles + tile_idx, tile_tgt_obj);
+
+        washdc_mutex_lock(&tile_lock);
+        if (++n_tiles_done == n_tiles_queued)
+            washdc_cvar_signal(&tile_done_cvar);
+    }
+    washdc_mutex_unlock(&tile_lock);
+}
+
 static void soft_gfx_init(void) {
     glewExperimental = GL_TRUE;
     glewInit();
@@ -220,30 +470,67 @@ static void soft_gfx_init(void) {
     memset(fb, 0, sizeof(fb));
 
     unsigned idx;
-    for (idx = 0; idx < GFX_TEX_CACHE_SIZE; idx++)
+    for (idx = 0; idx < GFX_TEX_CACHE_SIZE; idx++) {
         textures[idx].obj_no = -1;
+        textures[idx].texels = NULL;
+    }
     render_tgt = -1;
     screen_width = 0;
     screen_height = 0;
-    w_buffer = NULL;
-    vert_array = NULL;
+    vert_array_base = 0;
     vert_array_len = 0;
 
-    n_oit_pixels = 0;
-    for (idx = 0; idx < FB_WIDTH * FB_HEIGHT; idx++)
-        oit_buf[idx] = -1;
+    tiles = NULL;
+    n_tiles_x = n_tiles_y = 0;
+    n_bin_cmds = n_bin_states = n_bin_verts = 0;
+    bin_state_dirty = true;
+
+    // the thread that calls into soft_gfx rasterizes tiles too
+    n_tile_workers = cpu_count() - 1;
+    if (n_tile_workers > MAX_TILE_WORKERS)
+        n_tile_workers = MAX_TILE_WORKERS;
+    next_tile = n_tiles_done = n_tiles_queued = 0;
+    tile_workers_exit = false;
+    for (idx = 0; idx < n_tile_workers; idx++)
+        washdc_thread_create(tile_workers + idx, tile_worker_main, NULL);
 
     init_poly();
 }
 
 static void soft_gfx_cleanup(void) {
+    washdc_mutex_lock(&tile_lock);
+    tile_workers_exit = true;
+    washdc_cvar_broadcast(&tile_work_cvar);
+    washdc_mutex_unlock(&tile_lock);
+
+    unsigned idx;
+    for (idx = 0; idx < n_tile_workers; idx++)
+        washdc_thread_join(tile_workers + idx);
+    n_tile_workers = 0;
+
     glDeleteTextures(1, &fb_tex);
 
-    free(w_buffer);
-    w_buffer = NULL;
+    free_tiles();
+    gfx_obj_pool_drain();
+
+    free(bin_cmds);
+    bin_cmds = NULL;
+    n_bin_cmds = bin_cmds_alloc = 0;
+    free(bin_states);
+    bin_states = NULL;
+    n_bin_states = bin_states_alloc = 0;
+    free(bin_verts);
+    bin_verts = NULL;
+    n_bin_verts = bin_verts_alloc = 0;
 
-    free(vert_array);
-    vert_array = NULL;
+    for (idx = 0; idx < GFX_TEX_CACHE_SIZE; idx++)
+        tex_drop(textures + idx);
+    tex_free_retired();
+    free(retired_texels);
+    retired_texels = NULL;
+    retired_texels_alloc = 0;
+
+    vert_array_base = 0;
     vert_array_len = 0;
 }
 
@@ -283,19 +570,26 @@ static void soft_gfx_set_callbacks(struct renderer_callbacks const *callbacks) {
 }
 
 static void soft_gfx_obj_init(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int obj_no = cmd->arg.init_obj.obj_no;
     size_t n_bytes = cmd->arg.init_obj.n_bytes;
     gfx_obj_init(obj_no, n_bytes);
 }
 
 static void soft_gfx_obj_write(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int obj_no = cmd->arg.write_obj.obj_no;
     size_t n_bytes = cmd->arg.write_obj.n_bytes;
     void const *dat = cmd->arg.write_obj.dat;
     gfx_obj_write(obj_no, dat, n_bytes);
+    tex_drop_obj(obj_no);
 }
 
 static void soft_gfx_obj_read(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int obj_no = cmd->arg.read_obj.obj_no;
     size_t n_bytes = cmd->arg.read_obj.n_bytes;
     void *dat = cmd->arg.read_obj.dat;
@@ -303,11 +597,16 @@ static void soft_gfx_obj_read(struct gfx_il_inst *cmd) {
 }
 
 static void soft_gfx_obj_free(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int obj_no = cmd->arg.free_obj.obj_no;
     gfx_obj_free(obj_no);
+    tex_drop_obj(obj_no);
 }
 
 static void soft_gfx_bind_render_target(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int obj_handle = cmd->arg.bind_render_target.gfx_obj_handle;
     struct gfx_obj *obj = gfx_obj_get(obj_handle);
 
@@ -315,6 +614,8 @@ static void soft_gfx_bind_render_target(struct gfx_il_inst *cmd) {
 }
 
 static void soft_gfx_post_fb(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int obj_handle = cmd->arg.post_framebuffer.obj_handle;
     struct gfx_obj *obj = gfx_obj_get(obj_handle);
     bool do_flip = cmd->arg.post_framebuffer.vert_flip;
@@ -402,34 +703,17 @@ static void soft_gfx_clear(struct gfx_il_inst *cmd) {
         return;
     }
 
-    /*
-     * TODO: write directly to the framebuffer instead of calling put_pix.
-     *
-     * It should be faster that way, and we can skip the per-pixel clip
-     * rectangle check by looping across the range of the rectangle.
-     */
-    unsigned row, col;
-    for (row = 0; row <= screen_height-1; row++)
-        for (col = 0; col <= screen_width-1; col++)
-            put_pix(obj, col, row, as_32);
-
-    /*
-     * clear depth buffer
-     *
-     * XXX not entirely sure what the best default value here should be since
-     * there are several different depth tests that games can configure.
-     * Greater/Greater-or-equal seem to be the most popular ones (and the only
-     * one supports for order-independent transparency) so -INFINITY works well
-     * here.  Ideally we would be implementing the depth test on a per-tile
-     * basis using the same algorithm as the actual PVR2 hardware instead of
-     * using a persistent depth buffer like high-level APIs do.
-     */
-    unsigned idx;
-    for (idx = 0; idx < screen_width * screen_height; idx++)
-        w_buffer[idx] = -INFINITY;
+    // the clear itself happens in tile_clear when the tiles get flushed
+    struct bin_cmd bin_cmd = {
+        .tp = BIN_CMD_CLEAR,
+        .arg = { .clear = { .color = as_32 } }
+    };
+    bin_all_tiles(&bin_cmd);
 }
 
 static void soft_gfx_begin_rend(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     int old_screen_width = screen_width;
     int old_screen_height = screen_height;
 
@@ -440,15 +724,7 @@ static void soft_gfx_begin_rend(struct gfx_il_inst *cmd) {
 
     if (screen_width != old_screen_width ||
         screen_height != old_screen_height) {
-        float *w_buf_new = realloc(w_buffer,
-                                   sizeof(float) *
-                                   screen_width * screen_height);
-        if (!w_buf_new) {
-            fprintf(stderr, "ERROR: %s - failure to allocate new w_buffer\n",
-                    __func__);
-            abort();
-        }
-        w_buffer = w_buf_new;
+        alloc_tiles(screen_width, screen_height);
     }
 
     int obj_handle = cmd->arg.begin_rend.rend_tgt_obj;
@@ -481,8 +757,12 @@ static void soft_gfx_begin_rend(struct gfx_il_inst *cmd) {
 }
 
 static void soft_gfx_end_rend(struct gfx_il_inst *cmd) {
+    flush_tiles();
+
     if (render_tgt < 0)
         fprintf(stderr, "%s - no render target bound!\n", __func__);
+    else
+        tex_drop_obj(render_tgt); // in case it also gets used as a texture
     render_tgt = -1;
 }
 
@@ -749,7 +1029,8 @@ draw_line(struct gfx_obj *obj, int x1, int y1, int x2, int y2, uint32_t color) {
             int x_pos = x1, y_pos = y1;
             int error = 0;
             do {
-                if (user_clip_test(x_pos, y_pos) && clip_test(x_pos, y_pos))
+                if (user_clip_test(&rend_param, user_clip, x_pos, y_pos) &&
+                    clip_test(x_pos, y_pos))
                     put_pix(obj, x_pos, y_pos, color);
                 error += delta_y;
                 if (2 * error >= delta_x) {
@@ -783,7 +1064,8 @@ draw_line(struct gfx_obj *obj, int x1, int y1, int x2, int y2, uint32_t color) {
             int x_pos = x1, y_pos = y1;
             int error = 0;
             do {
-                if (user_clip_test(x_pos, y_pos) && clip_test(x_pos, y_pos))
+                if (user_clip_test(&rend_param, user_clip, x_pos, y_pos) &&
+                    clip_test(x_pos, y_pos))
                     put_pix(obj, x_pos, y_pos, color);
                 error += delta_y;
                 if (2 * error < -delta_x) {
@@ -820,7 +1102,8 @@ draw_line(struct gfx_obj *obj, int x1, int y1, int x2, int y2, uint32_t color) {
             int x_pos = x1, y_pos = y1;
             int error = 0;
             do {
-                if (user_clip_test(x_pos, y_pos) && clip_test(x_pos, y_pos))
+                if (user_clip_test(&rend_param, user_clip, x_pos, y_pos) &&
+                    clip_test(x_pos, y_pos))
                     put_pix(obj, x_pos, y_pos, color);
                 error += delta_x;
                 if (2 * error >= delta_y) {
@@ -854,7 +1137,8 @@ draw_line(struct gfx_obj *obj, int x1, int y1, int x2, int y2, uint32_t color) {
             int x_pos = x1, y_pos = y1;
             int error = 0;
             do {
-                if (user_clip_test(x_pos, y_pos) && clip_test(x_pos, y_pos))
+                if (user_clip_test(&rend_param, user_clip, x_pos, y_pos) &&
+                    clip_test(x_pos, y_pos))
                     put_pix(obj, x_pos, y_pos, color);
                 error += delta_x;
                 if (2 * error < -delta_y) {
@@ -915,11 +1199,18 @@ tri_area2_signed(float const v1[2], float const v2[2], float const v3[2]) {
     return -vec1[1] * vec2[0] + vec1[0] * vec2[1];
 }
 
-static bool depth_test(int x_pos, int y_pos, float w_coord) {
-    float w_ref = w_buffer[y_pos * screen_width + x_pos];
-    if (sort_mode_enable)
+static inline float *
+tile_w_buffer(struct tile *tile, int x_pos, int y_pos) {
+    return tile->w_buffer +
+        (y_pos - tile->y_min) * TILE_SIDE + (x_pos - tile->x_min);
+}
+
+static bool depth_test(struct tile *tile, struct draw_state const *state,
+                       int x_pos, int y_pos, float w_coord) {
+    float w_ref = *tile_w_buffer(tile, x_pos, y_pos);
+    if (state->sort_mode_enable)
         return w_coord >= w_ref;
-    switch (rend_param.depth_func) {
+    switch (state->rend_param.depth_func) {
     case PVR2_DEPTH_NEVER:
         return false;
     case PVR2_DEPTH_LESS:
@@ -938,13 +1229,15 @@ static bool depth_test(int x_pos, int y_pos, float w_coord) {
         return true;
     default:
         fprintf(stderr, "Unknown depth function %d!\n",
-                (int)rend_param.depth_func);
+                (int)state->rend_param.depth_func);
         return true;
     }
 }
 
-static bool user_clip_test(int x_pix, int y_pix) {
-    switch (rend_param.user_clip_mode) {
+static bool
+user_clip_test(struct gfx_rend_param const *param,
+               unsigned const user_clip[4], int x_pix, int y_pix) {
+    switch (param->user_clip_mode) {
     case GFX_USER_CLIP_INSIDE:
         if (x_pix < user_clip[0] ||
             x_pix > user_clip[2] ||
@@ -976,158 +1269,83 @@ static bool clip_test(int x_pix, int y_pix) {
     return true;
 }
 
-static void
-tex_sample(struct tex const *texp, float rgba[4], int const texcoord[2]) {
-    if (texp->obj_no < 0) {
-        fprintf(stderr, "%s - invalid texture/object binding %d\n", __func__, texp->obj_no);
-        rgba[0] = 1.0f;
-        rgba[1] = 1.0f;
-        rgba[2] = 1.0f;
-        rgba[3] = 1.0f;
-        return;
-    }
-
-    struct gfx_obj *obj = gfx_obj_get(texp->obj_no);
-
-    int uv[2];
-
-    switch (rend_param.tex_wrap_mode[0]) {
-    case TEX_WRAP_CLAMP:
-        uv[0] = clamp_int(texcoord[0], 0, texp->width - 1);
-        break;
-    case TEX_WRAP_REPEAT:
-        uv[0] = texcoord[0] % texp->width;
-        break;
-    case TEX_WRAP_FLIP:
-        if ((texcoord[0] / texp->width) % 2 == 0)
-            uv[0] = texcoord[0] % texp->width;
-        else
-            uv[0] = texp->width - 1 - (texcoord[0] % texp->width);
-        break;
-    default:
-        fprintf(stderr, "%s - invalid tex clamp mode\n", __func__);
-        rgba[0] = 1.0f;
-        rgba[1] = 1.0f;
-        rgba[2] = 1.0f;
-        rgba[3] = 1.0f;
-        return;
-    }
+static inline unsigned
+tex_texel_idx(unsigned blocks_w, unsigned u, unsigned v) {
+    return (((v >> TEX_BLOCK_SHIFT) * blocks_w + (u >> TEX_BLOCK_SHIFT)) <<
+            (2 * TEX_BLOCK_SHIFT)) +
+        ((v & TEX_BLOCK_MASK) << TEX_BLOCK_SHIFT) + (u & TEX_BLOCK_MASK);
+}
 
-    switch (rend_param.tex_wrap_mode[1]) {
-    case TEX_WRAP_CLAMP:
-        uv[1] = clamp_int(texcoord[1], 0, texp->height - 1);
-        break;
-    case TEX_WRAP_REPEAT:
-        uv[1] = texcoord[1] % texp->height;
-        break;
-    case TEX_WRAP_FLIP:
-        if ((texcoord[1] / texp->height) % 2 == 0)
-            uv[1] = texcoord[1] % texp->height;
-        else
-            uv[1] = texp->height - 1 - (texcoord[1] % texp->height);
-        break;
-    default:
-        fprintf(stderr, "%s - invalid tex clamp mode\n", __func__);
-        rgba[0] = 1.0f;
-        rgba[1] = 1.0f;
-        rgba[2] = 1.0f;
-        rgba[3] = 1.0f;
-        return;
-    }
+static inline uint32_t
+pack_rgba(unsigned red, unsigned green, unsigned blue, unsigned alpha) {
+    return red | (green << 8) | (blue << 16) | (alpha << 24);
+}
 
-    unsigned tex_idx = uv[1] * texp->width + uv[0];
+/*
+ * decode the texel at (u, v) into RGBA8888.  returns false if the texel lies
+ * outside of obj's data store.
+ */
+static bool tex_decode_texel(struct tex const *texp, struct gfx_obj const *obj,
+                             unsigned u, unsigned v, uint32_t *out) {
+    unsigned tex_idx = v * texp->width + u;
+    char const *dat = obj->dat;
 
     switch (texp->fmt) {
     case GFX_TEX_FMT_ARGB_1555:
         {
             if (tex_idx * sizeof(uint16_t) + (sizeof(uint16_t) - 1) >=
-                obj->dat_len || !obj->dat) {
-                fprintf(stderr, "%s - buffer overflow\n", __func__);
-                fprintf(stderr, "\tdat_len %llu\n",
-                        (unsigned long long)obj->dat_len);
-                fprintf(stderr, "\ttex_idx: %u\n", tex_idx);
-                rgba[0] = 1.0f;
-                rgba[1] = 1.0f;
-                rgba[2] = 1.0f;
-                rgba[3] = 1.0f;
-                return;
-            }
+                obj->dat_len)
+                return false;
             uint16_t val;
-            memcpy(&val, ((char*)obj->dat) + sizeof(uint16_t) * tex_idx,
-                   sizeof(val));
-
-            rgba[0] = ((val >> 10) & 0x1f) / 31.0f;
-            rgba[1] = ((val >> 5) & 0x1f) / 31.0f;
-            rgba[2] = ((val >> 0) & 0x1f) / 31.0f;
-            rgba[3] = val & 0x8000 ? 1.0f : 0.0f;
+            memcpy(&val, dat + sizeof(uint16_t) * tex_idx, sizeof(val));
+
+            unsigned red = (val >> 10) & 0x1f;
+            unsigned green = (val >> 5) & 0x1f;
+            unsigned blue = val & 0x1f;
+            *out = pack_rgba((red << 3) | (red >> 2),
+                             (green << 3) | (green >> 2),
+                             (blue << 3) | (blue >> 2),
+                             val & 0x8000 ? 255 : 0);
         }
-        return;
+        return true;
     case GFX_TEX_FMT_ARGB_4444:
         {
             if (tex_idx * sizeof(uint16_t) + (sizeof(uint16_t) - 1) >=
-                obj->dat_len || !obj->dat) {
-                fprintf(stderr, "%s - buffer overflow\n", __func__);
-                fprintf(stderr, "\tdat_len %llu\n",
-                        (unsigned long long)obj->dat_len);
-                fprintf(stderr, "\ttex_idx: %u\n", tex_idx);
-                rgba[0] = 1.0f;
-                rgba[1] = 1.0f;
-                rgba[2] = 1.0f;
-                rgba[3] = 1.0f;
-                return;
-            }
+                obj->dat_len)
+                return false;
             uint16_t val;
-            memcpy(&val, ((char*)obj->dat) + sizeof(uint16_t) * tex_idx,
-                   sizeof(val));
+            memcpy(&val, dat + sizeof(uint16_t) * tex_idx, sizeof(val));
 
-            rgba[0] = ((val >> 8) & 0xf) / 15.0f;
-            rgba[1] = ((val >> 4) & 0xf) / 15.0f;
-            rgba[2] = ((val >> 0) & 0xf) / 15.0f;
-            rgba[3] = ((val >> 12) & 0xf) / 15.0f;
+            *out = pack_rgba(((val >> 8) & 0xf) * 0x11,
+                             ((val >> 4) & 0xf) * 0x11,
+                             (val & 0xf) * 0x11,
+                             ((val >> 12) & 0xf) * 0x11);
         }
-        return;
+        return true;
     case GFX_TEX_FMT_RGB_565:
         {
             if (tex_idx * sizeof(uint16_t) + (sizeof(uint16_t) - 1) >=
-                obj->dat_len || !obj->dat) {
-                fprintf(stderr, "%s - buffer overflow\n", __func__);
-                fprintf(stderr, "\tdat_len %llu\n",
-                        (unsigned long long)obj->dat_len);
-                fprintf(stderr, "\ttex_idx: %u\n", tex_idx);
-                rgba[0] = 1.0f;
-                rgba[1] = 1.0f;
-                rgba[2] = 1.0f;
-                rgba[3] = 1.0f;
-                return;
-            }
+                obj->dat_len)
+                return false;
             uint16_t val;
-            memcpy(&val, ((char*)obj->dat) + sizeof(uint16_t) * tex_idx,
-                   sizeof(val));
-
-            rgba[0] = ((val >> 11) & 0x1f) / 31.0f;
-            rgba[1] = ((val >> 5) & 0x3f) / 63.0f;
-            rgba[2] = ((val >> 0) & 0x1f) / 31.0f;
-            rgba[3] = 1.0f;
+            memcpy(&val, dat + sizeof(uint16_t) * tex_idx, sizeof(val));
+
+            unsigned red = (val >> 11) & 0x1f;
+            unsigned green = (val >> 5) & 0x3f;
+            unsigned blue = val & 0x1f;
+            *out = pack_rgba((red << 3) | (red >> 2),
+                             (green << 2) | (green >> 4),
+                             (blue << 3) | (blue >> 2), 255);
         }
-        return;
+        return true;
     case GFX_TEX_FMT_YUV_422:
         {
             if ((tex_idx / 2) * sizeof(uint32_t) + (sizeof(uint32_t) - 1) >=
-                obj->dat_len || !obj->dat) {
-                fprintf(stderr, "%s - buffer overflow\n", __func__);
-                fprintf(stderr, "\tdat_len %llu\n",
-                        (unsigned long long)obj->dat_len);
-                fprintf(stderr, "\ttex_idx: %u\n", tex_idx);
-                rgba[0] = 1.0f;
-                rgba[1] = 1.0f;
-                rgba[2] = 1.0f;
-                rgba[3] = 1.0f;
-                return;
-            }
+                obj->dat_len)
+                return false;
 
             uint32_t val;
-            memcpy(&val, ((char*)obj->dat) + sizeof(uint32_t) * (tex_idx / 2),
-                   sizeof(val));
+            memcpy(&val, dat + sizeof(uint32_t) * (tex_idx / 2), sizeof(val));
 
             unsigned lum;
             int chrom_b = val & 0xff, chrom_r = (val >> 16) & 0xff;
@@ -1135,7 +1353,7 @@ tex_sample(struct tex const *texp, float rgba[4], int const texcoord[2]) {
             chrom_b -= 128;
             chrom_r -= 128;
 
-            if (texcoord[0] % 2)
+            if (u % 2)
                 lum = (val >> 24) & 0xff;
             else
                 lum = (val >> 8) & 0xff;
@@ -1145,50 +1363,203 @@ tex_sample(struct tex const *texp, float rgba[4], int const texcoord[2]) {
                            -((0x5800 * chrom_b + 0xb000 * chrom_r) >> 16),
                            (0x1b800 * chrom_b) >> 16
             };
-            rgba[0] = clamp_int(lum + adds[0], 0, 255) / 255.0f;
-            rgba[1] = clamp_int(lum + adds[1], 0, 255) / 255.0f;
-            rgba[2] = clamp_int(lum + adds[2], 0, 255) / 255.0f;
-            rgba[3] = 1.0f;
+            *out = pack_rgba(clamp_int(lum + adds[0], 0, 255),
+                             clamp_int(lum + adds[1], 0, 255),
+                             clamp_int(lum + adds[2], 0, 255), 255);
         }
-        return;
+        return true;
     case GFX_TEX_FMT_ARGB_8888:
         {
             if (tex_idx * sizeof(uint32_t) + (sizeof(uint32_t) - 1) >=
-                obj->dat_len || !obj->dat) {
-                fprintf(stderr, "%s - buffer overflow\n", __func__);
-                fprintf(stderr, "\tdat_len %llu\n",
-                        (unsigned long long)obj->dat_len);
-                fprintf(stderr, "\ttex_idx: %u\n", tex_idx);
-                rgba[0] = 1.0f;
-                rgba[1] = 1.0f;
-                rgba[2] = 1.0f;
-                rgba[3] = 1.0f;
-                return;
-            }
+                obj->dat_len)
+                return false;
             uint32_t val;
-            memcpy(&val, ((char*)obj->dat) + sizeof(uint32_t) * tex_idx,
-                   sizeof(val));
+            memcpy(&val, dat + sizeof(uint32_t) * tex_idx, sizeof(val));
 
-            rgba[0] = ((val >> 16) & 0xff) / 255.0f;
-            rgba[1] = ((val >> 8) & 0xff) / 255.0f;
-            rgba[2] = ((val >> 0) & 0xff) / 255.0f;
-            rgba[3] = ((val >> 24) & 0xff) / 255.0f;
+            *out = pack_rgba((val >> 16) & 0xff, (val >> 8) & 0xff,
+                             val & 0xff, (val >> 24) & 0xff);
         }
-        return;
+        return true;
     default:
         fprintf(stderr, "%s - unimplemented tex format %d\n",
                 __func__, (int)texp->fmt);
-        rgba[0] = 1.0f;
-        rgba[1] = 1.0f;
-        rgba[2] = 1.0f;
-        rgba[3] = 1.0f;
+        abort();
+    }
+}
+
+// build the expanded copy of the given texture if it doesn't already exist
+static void tex_expand(struct tex *texp) {
+    if (texp->texels || texp->obj_no < 0 || texp->obj_no >= GFX_OBJ_COUNT)
+        return;
+
+    struct gfx_obj *obj = gfx_obj_get(texp->obj_no);
+    if (!obj->dat || !texp->width || !texp->height) {
+        fprintf(stderr, "%s - texture object %d has no data\n",
+                __func__, texp->obj_no);
+        return;
+    }
 
+    unsigned blocks_w = (texp->width + TEX_BLOCK_MASK) >> TEX_BLOCK_SHIFT;
+    unsigned blocks_h = (texp->height + TEX_BLOCK_MASK) >> TEX_BLOCK_SHIFT;
+    uint32_t *texels = malloc(sizeof(uint32_t) * blocks_w * blocks_h *
+                              TEX_BLOCK_SIDE * TEX_BLOCK_SIDE);
+    if (!texels) {
+        fprintf(stderr, "ERROR: %s - failed to allocate %ux%u texture\n",
+                __func__, texp->width, texp->height);
         abort();
+    }
+
+    bool overflow = false;
+    unsigned u, v;
+    for (v = 0; v < texp->height; v++) {
+        for (u = 0; u < texp->width; u++) {
+            uint32_t texel;
+            if (!tex_decode_texel(texp, obj, u, v, &texel)) {
+                overflow = true;
+                texel = 0xffffffff;
+            }
+            texels[tex_texel_idx(blocks_w, u, v)] = texel;
+        }
+    }
 
+    if (overflow) {
+        fprintf(stderr, "%s - buffer overflow\n", __func__);
+        fprintf(stderr, "\tdat_len %llu\n", (unsigned long long)obj->dat_len);
+        fprintf(stderr, "\tdimensions: %ux%u\n", texp->width, texp->height);
+    }
+
+    texp->texels = texels;
+    texp->blocks_w = blocks_w;
+}
+
+static void tex_drop(struct tex *texp) {
+    if (!texp->texels)
         return;
+
+    if (n_bin_cmds) {
+        // binned draws may still reference it
+        retired_texels = grow_array(retired_texels, &retired_texels_alloc,
+                                    n_retired_texels + 1, sizeof(uint32_t*));
+        retired_texels[n_retired_texels++] = texp->texels;
+    } else {
+        free(texp->texels);
+    }
+    texp->texels = NULL;
+    bin_state_dirty = true;
+}
+
+// invalidate the expanded copy of every texture which is bound to obj_no
+static void tex_drop_obj(int obj_no) {
+    unsigned idx;
+    for (idx = 0; idx < GFX_TEX_CACHE_SIZE; idx++)
+        if (textures[idx].obj_no == obj_no)
+            tex_drop(textures + idx);
+}
+
+static void tex_free_retired(void) {
+    while (n_retired_texels)
+        free(retired_texels[--n_retired_texels]);
+}
+
+static unsigned tex_wrap(int coord, unsigned size, enum tex_wrap_mode mode) {
+    int isize = size;
+    switch (mode) {
+    case TEX_WRAP_CLAMP:
+        return clamp_int(coord, 0, isize - 1);
+    case TEX_WRAP_REPEAT:
+        coord %= isize;
+        return coord < 0 ? coord + isize : coord;
+    case TEX_WRAP_FLIP:
+        coord %= 2 * isize;
+        if (coord < 0)
+            coord += 2 * isize;
+        return coord < isize ? coord : 2 * isize - 1 - coord;
+    default:
+        fprintf(stderr, "%s - invalid tex clamp mode\n", __func__);
+        return 0;
     }
 }
 
+static inline void unpack_rgba(float rgba[4], uint32_t texel) {
+    rgba[0] = (texel & 0xff) / 255.0f;
+    rgba[1] = ((texel >> 8) & 0xff) / 255.0f;
+    rgba[2] = ((texel >> 16) & 0xff) / 255.0f;
+    rgba[3] = (texel >> 24) / 255.0f;
+}
+
+static bool tex_sample_valid(struct tex const *texp, float rgba[4]) {
+    if (texp->obj_no < 0) {
+        fprintf(stderr, "%s - invalid texture/object binding %d\n",
+                __func__, texp->obj_no);
+    } else if (texp->texels) {
+        return true;
+    }
+
+    rgba[0] = 1.0f;
+    rgba[1] = 1.0f;
+    rgba[2] = 1.0f;
+    rgba[3] = 1.0f;
+    return false;
+}
+
+static void
+tex_sample(struct tex const *texp, struct gfx_rend_param const *param,
+           float rgba[4], int const texcoord[2]) {
+    if (!tex_sample_valid(texp, rgba))
+        return;
+
+    unsigned u = tex_wrap(texcoord[0], texp->width, param->tex_wrap_mode[0]);
+    unsigned v = tex_wrap(texcoord[1], texp->height, param->tex_wrap_mode[1]);
+
+    unpack_rgba(rgba, texp->texels[tex_texel_idx(texp->blocks_w, u, v)]);
+}
+
+/*
+ * linearly interpolate between two RGBA8888 texels.  frac is in 1/256ths.  Two
+ * channels are interpolated at once in each half of the 32-bit word, which
+ * works because 255 * 256 still fits in 16 bits.
+ */
+static inline uint32_t lerp_rgba(uint32_t lhs, uint32_t rhs, unsigned frac) {
+    unsigned inv = 256 - frac;
+    uint32_t rb = (((lhs & 0x00ff00ff) * inv +
+                    (rhs & 0x00ff00ff) * frac) >> 8) & 0x00ff00ff;
+    uint32_t ga = (((lhs >> 8) & 0x00ff00ff) * inv +
+                   ((rhs >> 8) & 0x00ff00ff) * frac) & 0xff00ff00;
+    return rb | ga;
+}
+
+static void
+tex_sample_bilinear(struct tex const *texp, struct gfx_rend_param const *param,
+                    float rgba[4], double const texcoord[2]) {
+    if (!tex_sample_valid(texp, rgba))
+        return;
+
+    // texel centers are at half-integer coordinates
+    double u_pos = texcoord[0] * texp->width - 0.5;
+    double v_pos = texcoord[1] * texp->height - 0.5;
+    double u_floor = floor(u_pos);
+    double v_floor = floor(v_pos);
+    int u0 = u_floor, v0 = v_floor;
+    unsigned u_frac = (u_pos - u_floor) * 256.0;
+    unsigned v_frac = (v_pos - v_floor) * 256.0;
+
+    unsigned u_lo = tex_wrap(u0, texp->width, param->tex_wrap_mode[0]);
+    unsigned u_hi = tex_wrap(u0 + 1, texp->width, param->tex_wrap_mode[0]);
+    unsigned v_lo = tex_wrap(v0, texp->height, param->tex_wrap_mode[1]);
+    unsigned v_hi = tex_wrap(v0 + 1, texp->height, param->tex_wrap_mode[1]);
+
+    uint32_t const *texels = texp->texels;
+    unsigned blocks_w = texp->blocks_w;
+    uint32_t top = lerp_rgba(texels[tex_texel_idx(blocks_w, u_lo, v_lo)],
+                             texels[tex_texel_idx(blocks_w, u_hi, v_lo)],
+                             u_frac);
+    uint32_t bottom = lerp_rgba(texels[tex_texel_idx(blocks_w, u_lo, v_hi)],
+                                texels[tex_texel_idx(blocks_w, u_hi, v_hi)],
+                                u_frac);
+
+    unpack_rgba(rgba, lerp_rgba(top, bottom, v_frac));
+}
+
 /*
  * per-vertex attribute interpolated across a triangle
  *
@@ -1206,32 +1577,295 @@ static double vert_attr_val(struct vert_attr const *attr, int y_pos, int x_pos)
     return attr->init + y_pos * attr->ystep + x_pos * attr->xstep;
 }
 
-static void
-draw_tri(struct gfx_obj *obj, float const *p1,
-         float const *p2, float const *p3) {
+/*
+ * clip the triangle's bounding box to the given rectangle.  Returns false if
+ * there's nothing left.
+ */
+static bool
+tri_bbox_clipped(int bbox[4], float const *p1, float const *p2,
+                 float const *p3, int x_min, int y_min, int x_max, int y_max) {
     float bbox_float[4];
     tri_bbox(bbox_float, p1, p2, p3);
 
-    int bbox[4] = { bbox_float[0], bbox_float[1],
-                    bbox_float[2], bbox_float[3] };
+    bbox[0] = bbox_float[0];
+    bbox[1] = bbox_float[1];
+    bbox[2] = bbox_float[2];
+    bbox[3] = bbox_float[3];
 
-    if (bbox[0] < 0)
-        bbox[0] = 0;
-    else if (bbox[0] >= screen_width)
-        return;
-    if (bbox[1] < 0)
-        bbox[1] = 0;
-    else if (bbox[1] >= screen_height)
-        return;
-    if (bbox[2] >= screen_width)
-        bbox[2] = screen_width - 1;
-    else if (bbox[2] < 0)
+    if (bbox[0] < x_min)
+        bbox[0] = x_min;
+    else if (bbox[0] > x_max)
+        return false;
+    if (bbox[1] < y_min)
+        bbox[1] = y_min;
+    else if (bbox[1] > y_max)
+        return false;
+    if (bbox[2] > x_max)
+        bbox[2] = x_max;
+    else if (bbox[2] < x_min)
+        return false;
+    if (bbox[3] > y_max)
+        bbox[3] = y_max;
+    else if (bbox[3] < y_min)
+        return false;
+
+    return true;
+}
+
+// pixels are rasterized in groups of PIX_GROUP horizontally-adjacent pixels
+#define PIX_GROUP 4
+
+// size of the blocks that draw_tri can reject without looking at every pixel
+#define TRI_BLOCK_SIDE 8
+
+/*
+ * evaluate the edge functions for PIX_GROUP pixels starting at x_offs.  The
+ * bits of the return value are set for the pixels that are inside the
+ * triangle.
+ */
+static inline unsigned
+edge_test_group(float const row_val[3], float const xstep[3], int x_offs) {
+#ifdef __SSE2__
+    __m128 xs = _mm_cvtepi32_ps(_mm_setr_epi32(x_offs, x_offs + 1,
+                                               x_offs + 2, x_offs + 3));
+    __m128 inside =
+        _mm_cmpge_ps(_mm_mul_ps(xs, _mm_set1_ps(xstep[0])),
+                     _mm_set1_ps(-row_val[0]));
+    inside = _mm_and_ps(inside,
+                        _mm_cmpge_ps(_mm_mul_ps(xs, _mm_set1_ps(xstep[1])),
+                                     _mm_set1_ps(-row_val[1])));
+    inside = _mm_and_ps(inside,
+                        _mm_cmpge_ps(_mm_mul_ps(xs, _mm_set1_ps(xstep[2])),
+                                     _mm_set1_ps(-row_val[2])));
+    return _mm_movemask_ps(inside);
+#else
+    unsigned mask = 0;
+    unsigned lane;
+    for (lane = 0; lane < PIX_GROUP; lane++) {
+        int x_pos = x_offs + lane;
+        if (x_pos * xstep[0] >= -row_val[0] &&
+            x_pos * xstep[1] >= -row_val[1] &&
+            x_pos * xstep[2] >= -row_val[2])
+            mask |= 1 << lane;
+    }
+    return mask;
+#endif
+}
+
+/*
+ * returns false if every pixel in the given block (offsets relative to
+ * dist_init) is outside of the triangle.  The edge functions are linear, so
+ * if all four corners of the block are outside of the same edge then so is
+ * everything in between.
+ */
+static bool
+tri_block_test(float const dist_init[3], float const dist_xstep[3],
+               float const dist_ystep[3], int x_min, int y_min,
+               int x_max, int y_max) {
+    unsigned edge;
+    for (edge = 0; edge < 3; edge++) {
+        float row_min = -(dist_init[edge] + y_min * dist_ystep[edge]);
+        float row_max = -(dist_init[edge] + y_max * dist_ystep[edge]);
+        float col_min = x_min * dist_xstep[edge];
+        float col_max = x_max * dist_xstep[edge];
+
+        if (!(col_min >= row_min || col_max >= row_min ||
+              col_min >= row_max || col_max >= row_max))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * interpolate attr across PIX_GROUP pixels starting at x_offs.  This does the
+ * same arithmetic as vert_attr_val, just several pixels at a time.
+ */
+static inline void
+interp_group(double out[PIX_GROUP], struct vert_attr const *attr,
+             int y_offs, int x_offs) {
+#if defined(__AVX__)
+    __m256d xs = _mm256_setr_pd(x_offs, x_offs + 1, x_offs + 2, x_offs + 3);
+    __m256d row = _mm256_set1_pd(attr->init + y_offs * attr->ystep);
+    __m256d xstep = _mm256_set1_pd(attr->xstep);
+    _mm256_storeu_pd(out,
+                     _mm256_add_pd(row, _mm256_mul_pd(xs, xstep)));
+#elif defined(__SSE2__)
+    __m128d row = _mm_set1_pd(attr->init + y_offs * attr->ystep);
+    __m128d xstep = _mm_set1_pd(attr->xstep);
+    __m128d xs_lo = _mm_setr_pd(x_offs, x_offs + 1);
+    __m128d xs_hi = _mm_setr_pd(x_offs + 2, x_offs + 3);
+    _mm_storeu_pd(out, _mm_add_pd(row, _mm_mul_pd(xs_lo, xstep)));
+    _mm_storeu_pd(out + 2, _mm_add_pd(row, _mm_mul_pd(xs_hi, xstep)));
+#else
+    unsigned lane;
+    for (lane = 0; lane < PIX_GROUP; lane++)
+        out[lane] = vert_attr_val(attr, y_offs, x_offs + lane);
+#endif
+}
+
+// shade one pixel that's already known to be inside the triangle
+static void
+draw_tri_pix(struct tile *tile, struct gfx_obj *obj,
+             struct draw_state const *state, int x_pos, int y_pos,
+             float w_coord, double w_coord_area, double const base_col_in[4],
+             double const offs_col_in[4], double const texcoord_in[2]) {
+    struct gfx_rend_param const *param = &state->rend_param;
+    struct tex const *texp = state->texp;
+
+    if ((!state->sort_mode_enable &&
+         !depth_test(tile, state, x_pos, y_pos, w_coord)) ||
+        !user_clip_test(param, state->user_clip, x_pos, y_pos) ||
+        !clip_test(x_pos, y_pos))
         return;
-    if (bbox[3] >= screen_height)
-        bbox[3] = screen_height - 1;
-    else if (bbox[3] < 0)
+
+    if (param->enable_depth_writes && !state->sort_mode_enable)
+        *tile_w_buffer(tile, x_pos, y_pos) = w_coord;
+
+    double base_col[4] = {
+        base_col_in[0], base_col_in[1],
+        base_col_in[2], base_col_in[3]
+    };
+
+    base_col[0] /= w_coord_area;
+    base_col[1] /= w_coord_area;
+    base_col[2] /= w_coord_area;
+    base_col[3] /= w_coord_area;
+
+    double offs_col[4] = {
+        offs_col_in[0], offs_col_in[1],
+        offs_col_in[2], offs_col_in[3]
+    };
+
+    offs_col[0] /= w_coord_area;
+    offs_col[1] /= w_coord_area;
+    offs_col[2] /= w_coord_area;
+    offs_col[3] /= w_coord_area;
+
+    double pix_color[4];
+
+    if (texp) {
+        double texcoord[2] = { texcoord_in[0], texcoord_in[1] };
+
+        texcoord[0] /= w_coord_area;
+        texcoord[1] /= w_coord_area;
+
+        float sample[4];
+        switch (param->tex_filter) {
+        case TEX_FILTER_TRILINEAR_A:
+        case TEX_FILTER_TRILINEAR_B:
+            // TODO: TRILINEAR FILTERING
+        case TEX_FILTER_BILINEAR:
+            tex_sample_bilinear(texp, param, sample, texcoord);
+            break;
+        case TEX_FILTER_NEAREST:
+            {
+                int texcoord_pix[2] = {
+                    texcoord[0] * texp->width,
+                    texcoord[1] * texp->height
+                };
+
+                tex_sample(texp, param, sample, texcoord_pix);
+            }
+            break;
+        default:
+            fprintf(stderr, "%s - invalid texture filter %d\n",
+                    __func__, (int)param->tex_filter);
+            abort();
+        }
+
+        switch (param->tex_inst) {
+        case TEX_INST_DECAL:
+            pix_color[0] = sample[0] + offs_col[0];
+            pix_color[1] = sample[1] + offs_col[1];
+            pix_color[2] = sample[2] + offs_col[2];
+            pix_color[3] = sample[3];
+            break;
+        case TEX_INST_MOD:
+            pix_color[0] = sample[0] * base_col[0] + offs_col[0];
+            pix_color[1] = sample[1] * base_col[1] + offs_col[1];
+            pix_color[2] = sample[2] * base_col[2] + offs_col[2];
+            pix_color[3] = sample[3];
+            break;
+        case TEXT_INST_DECAL_ALPHA:
+            pix_color[0] = sample[0] * sample[3] +
+                base_col[0] * (1.0 - sample[3]) + offs_col[0];
+            pix_color[1] = sample[1] * sample[3] +
+                base_col[1] * (1.0 - sample[3]) + offs_col[1];
+            pix_color[2] = sample[2] * sample[3] +
+                base_col[2] * (1.0 - sample[3]) + offs_col[2];
+            pix_color[3] = base_col[3];
+            break;
+        case TEX_INST_MOD_ALPHA:
+            pix_color[0] = sample[0] * base_col[0] + offs_col[0];
+            pix_color[1] = sample[1] * base_col[1] + offs_col[1];
+            pix_color[2] = sample[2] * base_col[2] + offs_col[2];
+            pix_color[3] = sample[3] * base_col[3];
+            break;
+        default:
+            fprintf(stderr, "unknown texture inst %d\n",
+                    (int)param->tex_inst);
+            pix_color[0] = 1.0;
+            pix_color[1] = 1.0;
+            pix_color[2] = 1.0;
+            pix_color[3] = 1.0;
+        }
+    } else {
+        memcpy(pix_color, base_col, sizeof(pix_color));
+    }
+
+    int rgba[4] = {
+        clamp_int(pix_color[0] * 255, 0, 255),
+        clamp_int(pix_color[1] * 255, 0, 255),
+        clamp_int(pix_color[2] * 255, 0, 255),
+        clamp_int(pix_color[3] * 255, 0, 255)
+    };
+
+    if (state->sort_mode_enable) {
+        if (tile->n_oit_pixels >= MAX_OIT_PIXELS_PER_TILE)
+            return;
+        unsigned oit_node_idx = tile->n_oit_pixels++;
+        tile->oit_pixels =
+            grow_array(tile->oit_pixels, &tile->oit_pixels_alloc,
+                       tile->n_oit_pixels,
+                       sizeof(struct oit_pixel));
+        struct oit_pixel *pix = tile->oit_pixels + oit_node_idx;
+        unsigned buf_idx = (y_pos - tile->y_min) * TILE_SIDE +
+            (x_pos - tile->x_min);
+        memcpy(pix->rgba, rgba, sizeof(pix->rgba));
+        pix->w_coord = w_coord;
+        pix->src_blend_factor = param->src_blend_factor;
+        pix->dst_blend_factor = param->dst_blend_factor;
+        pix->next_pix_idx = tile->oit_buf[buf_idx];
+        tile->oit_buf[buf_idx] = oit_node_idx;
+    } else if (state->blend_enable) {
+        put_pix_blended(obj, x_pos, y_pos,
+                        rgba[0]          |
+                        (rgba[1] << 8)   |
+                        (rgba[2] << 16)  |
+                        (rgba[3] << 24),
+                        param->src_blend_factor,
+                        param->dst_blend_factor);
+    } else {
+        put_pix(obj, x_pos, y_pos,
+                rgba[0]          |
+                (rgba[1] << 8)   |
+                (rgba[2] << 16)  |
+                (rgba[3] << 24));
+    }
+}
+
+// rasterize the part of a binned triangle that falls within the given tile
+static void
+draw_tri(struct tile *tile, struct gfx_obj *obj,
+         struct draw_state const *state, float const *p1,
+         float const *p2, float const *p3) {
+    int bbox[4];
+    if (!tri_bbox_clipped(bbox, p1, p2, p3, tile->x_min, tile->y_min,
+                          tile->x_max, tile->y_max))
         return;
 
+    struct gfx_rend_param const *param = &state->rend_param;
+
     /*
      * positive is counter-clockwise and negative is clockwise
      *
@@ -1300,10 +1934,10 @@ draw_tri(struct gfx_obj *obj, float const *p1,
     };
 
     double texmat[4] = {
-        rend_param.tex_transform[0],
-        rend_param.tex_transform[1],
-        rend_param.tex_transform[2],
-        rend_param.tex_transform[3]
+        param->tex_transform[0],
+        param->tex_transform[1],
+        param->tex_transform[2],
+        param->tex_transform[3]
     };
 
     // perspective-correct texture coordinates
@@ -1329,20 +1963,7 @@ draw_tri(struct gfx_obj *obj, float const *p1,
          p3[GFX_VERT_TEX_COORD_OFFSET + 1] * texmat[3]) * p3[2],
     };
 
-    struct tex *texp = NULL;
-    if (rend_param.tex_enable) {
-        if (rend_param.tex_idx < GFX_TEX_CACHE_SIZE) {
-            if (textures[rend_param.tex_idx].obj_no >= 0 &&
-                textures[rend_param.tex_idx].obj_no < GFX_OBJ_COUNT)
-                texp = textures + rend_param.tex_idx;
-            else
-                fprintf(stderr, "%s - texture %d not bound to object\n",
-                        __func__, rend_param.tex_idx);
-        } else {
-            fprintf(stderr, "%s - invalid tex_idx %u\n",
-                    __func__, rend_param.tex_idx);
-        }
-    }
+    struct tex const *texp = state->texp;
 
     float dist_xstep[3] = { e1[0], e2[0], e3[0] };
     float dist_ystep[3] = { e1[1], e2[1], e3[1] };
@@ -1576,171 +2197,98 @@ draw_tri(struct gfx_obj *obj, float const *p1,
         }
     };
 
-    int x_pos, y_pos;
-    for (y_pos = bbox[1]; y_pos <= bbox[3]; y_pos++) {
-        int y_offs = y_pos - bbox[1];
-        float dist_row_val[3] = {
-            dist_init[0] + y_offs * dist_ystep[0],
-            dist_init[1] + y_offs * dist_ystep[1],
-            dist_init[2] + y_offs * dist_ystep[2]
-        };
-        for (x_pos = bbox[0]; x_pos <= bbox[2]; x_pos++) {
-            int x_offs = x_pos - bbox[0];
-
-            if (x_offs * dist_xstep[0] >= -dist_row_val[0] &&
-                x_offs * dist_xstep[1] >= -dist_row_val[1] &&
-                x_offs * dist_xstep[2] >= -dist_row_val[2]) {
-
-                // reciprocal depth * area
-                double w_coord_area =
-                    vert_attr_val(&w_coord_area_attr, y_offs, x_offs);
-
-                // reciprocal depth
-                float w_coord = w_coord_init +
-                    y_offs * w_coord_ystep +
-                    x_offs * w_coord_xstep;
-
-                if ((!sort_mode_enable &&
-                     !depth_test(x_pos, y_pos, w_coord)) ||
-                    !user_clip_test(x_pos, y_pos) ||
-                    !clip_test(x_pos, y_pos))
-                    continue;
-
-                if (rend_param.enable_depth_writes && !sort_mode_enable)
-                    w_buffer[y_pos * screen_width + x_pos] = w_coord;
-
-                double base_col[4] = {
-                    vert_attr_val(base_col_attr + 0, y_offs, x_offs),
-                    vert_attr_val(base_col_attr + 1, y_offs, x_offs),
-                    vert_attr_val(base_col_attr + 2, y_offs, x_offs),
-                    vert_attr_val(base_col_attr + 3, y_offs, x_offs)
-                };
-
-                base_col[0] /= w_coord_area;
-                base_col[1] /= w_coord_area;
-                base_col[2] /= w_coord_area;
-                base_col[3] /= w_coord_area;
+    struct vert_attr w_coord_attr = {
+        w_coord_init, w_coord_ystep, w_coord_xstep
+    };
 
-                double offs_col[4] = {
-                    vert_attr_val(offs_col_attr + 0, y_offs, x_offs),
-                    vert_attr_val(offs_col_attr + 1, y_offs, x_offs),
-                    vert_attr_val(offs_col_attr + 2, y_offs, x_offs),
-                    vert_attr_val(offs_col_attr + 3, y_offs, x_offs)
+    /*
+     * The bounding box is walked in TRI_BLOCK_SIDE x TRI_BLOCK_SIDE blocks,
+     * and within each block pixels are tested and interpolated PIX_GROUP at a
+     * time.
+     */
+    int block_x, block_y, x_pos, y_pos;
+    for (block_y = bbox[1]; block_y <= bbox[3]; block_y += TRI_BLOCK_SIDE) {
+        int block_y_max = block_y + TRI_BLOCK_SIDE - 1;
+        if (block_y_max > bbox[3])
+            block_y_max = bbox[3];
+
+        for (block_x = bbox[0]; block_x <= bbox[2]; block_x += TRI_BLOCK_SIDE) {
+            int block_x_max = block_x + TRI_BLOCK_SIDE - 1;
+            if (block_x_max > bbox[2])
+                block_x_max = bbox[2];
+
+            if (!tri_block_test(dist_init, dist_xstep, dist_ystep,
+                                block_x - bbox[0], block_y - bbox[1],
+                                block_x_max - bbox[0], block_y_max - bbox[1]))
+                continue;
+
+            for (y_pos = block_y; y_pos <= block_y_max; y_pos++) {
+                int y_offs = y_pos - bbox[1];
+                float dist_row_val[3] = {
+                    dist_init[0] + y_offs * dist_ystep[0],
+                    dist_init[1] + y_offs * dist_ystep[1],
+                    dist_init[2] + y_offs * dist_ystep[2]
                 };
 
-                offs_col[0] /= w_coord_area;
-                offs_col[1] /= w_coord_area;
-                offs_col[2] /= w_coord_area;
-                offs_col[3] /= w_coord_area;
-
-                double pix_color[4];
-
-                if (texp) {
-                    double texcoord[2] = {
-                        vert_attr_val(texcoord_attr + 0, y_offs, x_offs),
-                        vert_attr_val(texcoord_attr + 1, y_offs, x_offs),
-                    };
-
-                    texcoord[0] /= w_coord_area;
-                    texcoord[1] /= w_coord_area;
-
-                    float sample[4];
-                    switch (rend_param.tex_filter) {
-                    case TEX_FILTER_TRILINEAR_A:
-                    case TEX_FILTER_TRILINEAR_B:
-                        // TODO: TRILINEAR FILTERING
-                    case TEX_FILTER_BILINEAR:
-                        // TODO: BILINEAR FILTERING
-                    case TEX_FILTER_NEAREST:
-                        {
-                            int texcoord_pix[2] = {
-                                texcoord[0] * texp->width,
-                                texcoord[1] * texp->height
-                            };
-
-                            tex_sample(texp, sample, texcoord_pix);
-                        }
-                        break;
-                    default:
-                        fprintf(stderr, "%s - invalid texture filter %d\n",
-                                __func__, (int)rend_param.tex_filter);
-                        abort();
-                    }
+                for (x_pos = block_x; x_pos <= block_x_max;
+                     x_pos += PIX_GROUP) {
+                    int x_offs = x_pos - bbox[0];
+                    unsigned mask =
+                        edge_test_group(dist_row_val, dist_xstep, x_offs);
+                    if (block_x_max - x_pos + 1 < PIX_GROUP)
+                        mask &= (1 << (block_x_max - x_pos + 1)) - 1;
+                    if (!mask)
+                        continue;
 
-                    switch (rend_param.tex_inst) {
-                    case TEX_INST_DECAL:
-                        pix_color[0] = sample[0] + offs_col[0];
-                        pix_color[1] = sample[1] + offs_col[1];
-                        pix_color[2] = sample[2] + offs_col[2];
-                        pix_color[3] = sample[3];
-                        break;
-                    case TEX_INST_MOD:
-                        pix_color[0] = sample[0] * base_col[0] + offs_col[0];
-                        pix_color[1] = sample[1] * base_col[1] + offs_col[1];
-                        pix_color[2] = sample[2] * base_col[2] + offs_col[2];
-                        pix_color[3] = sample[3];
-                        break;
-                    case TEXT_INST_DECAL_ALPHA:
-                        pix_color[0] = sample[0] * sample[3] +
-                            base_col[0] * (1.0 - sample[3]) + offs_col[0];
-                        pix_color[1] = sample[1] * sample[3] +
-                            base_col[1] * (1.0 - sample[3]) + offs_col[1];
-                        pix_color[2] = sample[2] * sample[3] +
-                            base_col[2] * (1.0 - sample[3]) + offs_col[2];
-                        pix_color[3] = base_col[3];
-                        break;
-                    case TEX_INST_MOD_ALPHA:
-                        pix_color[0] = sample[0] * base_col[0] + offs_col[0];
-                        pix_color[1] = sample[1] * base_col[1] + offs_col[1];
-                        pix_color[2] = sample[2] * base_col[2] + offs_col[2];
-                        pix_color[3] = sample[3] * base_col[3];
-                        break;
-                    default:
-                        fprintf(stderr, "unknown texture inst %d\n",
-                                (int)rend_param.tex_inst);
-                        pix_color[0] = 1.0;
-                        pix_color[1] = 1.0;
-                        pix_color[2] = 1.0;
-                        pix_color[3] = 1.0;
+                    // reciprocal depth * area
+                    double w_coord_area[PIX_GROUP];
+                    // reciprocal depth
+                    double w_coord[PIX_GROUP];
+                    double base_col[4][PIX_GROUP];
+                    double offs_col[4][PIX_GROUP];
+                    double texcoord[2][PIX_GROUP];
+
+                    interp_group(w_coord_area, &w_coord_area_attr,
+                                 y_offs, x_offs);
+                    interp_group(w_coord, &w_coord_attr, y_offs, x_offs);
+
+                    unsigned idx;
+                    for (idx = 0; idx < 4; idx++) {
+                        interp_group(base_col[idx], base_col_attr + idx,
+                                     y_offs, x_offs);
+                        interp_group(offs_col[idx], offs_col_attr + idx,
+                                     y_offs, x_offs);
+                    }
+                    if (texp) {
+                        interp_group(texcoord[0], texcoord_attr + 0,
+                                     y_offs, x_offs);
+                        interp_group(texcoord[1], texcoord_attr + 1,
+                                     y_offs, x_offs);
                     }
-                } else {
-                    memcpy(pix_color, base_col, sizeof(pix_color));
-                }
-
-                int rgba[4] = {
-                    clamp_int(pix_color[0] * 255, 0, 255),
-                    clamp_int(pix_color[1] * 255, 0, 255),
-                    clamp_int(pix_color[2] * 255, 0, 255),
-                    clamp_int(pix_color[3] * 255, 0, 255)
-                };
 
-                if (sort_mode_enable) {
-                    if (x_pos < 0 || x_pos >= FB_WIDTH ||
-                        y_pos < 0 || y_pos >= FB_HEIGHT ||
-                        n_oit_pixels >= MAX_OIT_PIXELS)
-                        continue;
-                    unsigned oit_node_idx = n_oit_pixels++;
-                    struct oit_pixel *pix = oit_pixels + oit_node_idx;
-                    memcpy(pix->rgba, rgba, sizeof(pix->rgba));
-                    pix->w_coord = w_coord;
-                    pix->src_blend_factor = rend_param.src_blend_factor;
-                    pix->dst_blend_factor = rend_param.dst_blend_factor;
-                    pix->next_pix_idx = oit_buf[y_pos * FB_WIDTH + x_pos];
-                    oit_buf[y_pos * FB_WIDTH + x_pos] = oit_node_idx;
-                } else if (blend_enable) {
-                    put_pix_blended(obj, x_pos, y_pos,
-                                    rgba[0]          |
-                                    (rgba[1] << 8)   |
-                                    (rgba[2] << 16)  |
-                                    (rgba[3] << 24),
-                                    rend_param.src_blend_factor,
-                                    rend_param.dst_blend_factor);
-                } else {
-                    put_pix(obj, x_pos, y_pos,
-                            rgba[0]          |
-                            (rgba[1] << 8)   |
-                            (rgba[2] << 16)  |
-                            (rgba[3] << 24));
+                    unsigned lane;
+                    for (lane = 0; lane < PIX_GROUP; lane++) {
+                        if (!(mask & (1 << lane)))
+                            continue;
+
+                        double lane_base_col[4] = {
+                            base_col[0][lane], base_col[1][lane],
+                            base_col[2][lane], base_col[3][lane]
+                        };
+                        double lane_offs_col[4] = {
+                            offs_col[0][lane], offs_col[1][lane],
+                            offs_col[2][lane], offs_col[3][lane]
+                        };
+                        double lane_texcoord[2] = {
+                            texp ? texcoord[0][lane] : 0.0,
+                            texp ? texcoord[1][lane] : 0.0
+                        };
+
+                        draw_tri_pix(tile, obj, state, x_pos + lane, y_pos,
+                                     w_coord[lane], w_coord_area[lane],
+                                     lane_base_col, lane_offs_col,
+                                     lane_texcoord);
+                    }
                 }
             }
         }
@@ -1753,34 +2301,131 @@ static void soft_gfx_set_vert_array(struct gfx_il_inst *cmd) {
         return;
     }
 
+    if (cmd->arg.set_vert_array.fmt != GFX_VERT_FMT_FLOAT) {
+        fprintf(stderr, "%s - only GFX_VERT_FMT_FLOAT is supported!\n",
+                __func__);
+        return;
+    }
+
     unsigned n_verts = cmd->arg.set_vert_array.n_verts;
     float const *verts = cmd->arg.set_vert_array.verts;
 
-    if (!n_verts) {
-        free(vert_array);
-        vert_array = NULL;
-        vert_array_len = 0;
+    vert_array_base = n_bin_verts;
+    vert_array_len = 0;
+
+    if (!n_verts)
         return;
-    }
-    size_t bytes_per_vert = sizeof(float) * (size_t)GFX_VERT_LEN;
-    if (SIZE_MAX / n_verts < bytes_per_vert) {
+
+    if ((UINT_MAX / GFX_VERT_LEN) - n_bin_verts < n_verts) {
         // overflow
-        free(vert_array);
-        vert_array = NULL;
-        vert_array_len = 0;
+        fprintf(stderr, "%s - too many vertices\n", __func__);
         return;
     }
-    float *new_vert_array = realloc(vert_array, bytes_per_vert * n_verts);
-    if (!new_vert_array) {
-        // failed alloc
-        vert_array_len = 0;
-        free(vert_array);
-        vert_array = NULL;
+
+    /*
+     * triangles that have already been binned still point into bin_verts,
+     * so the new array goes after them instead of replacing them.
+     */
+    bin_verts = grow_array(bin_verts, &bin_verts_alloc,
+                           (n_bin_verts + n_verts) * GFX_VERT_LEN,
+                           sizeof(float));
+    memcpy(bin_verts + n_bin_verts * GFX_VERT_LEN, verts,
+           sizeof(float) * GFX_VERT_LEN * n_verts);
+    n_bin_verts += n_verts;
+    vert_array_len = n_verts;
+}
+
+static void bin_push_tile(struct tile *tile, unsigned cmd_idx) {
+    tile->cmds = grow_array(tile->cmds, &tile->cmds_alloc,
+                            tile->n_cmds + 1, sizeof(unsigned));
+    tile->cmds[tile->n_cmds++] = cmd_idx;
+}
+
+static unsigned bin_push_cmd(struct bin_cmd const *cmd) {
+    bin_cmds = grow_array(bin_cmds, &bin_cmds_alloc,
+                          n_bin_cmds + 1, sizeof(struct bin_cmd));
+    bin_cmds[n_bin_cmds] = *cmd;
+    return n_bin_cmds++;
+}
+
+// for commands that affect the whole screen
+static void bin_all_tiles(struct bin_cmd const *cmd) {
+    unsigned cmd_idx = bin_push_cmd(cmd);
+    unsigned tile_idx;
+    for (tile_idx = 0; tile_idx < n_tiles_x * n_tiles_y; tile_idx++)
+        bin_push_tile(tiles + tile_idx, cmd_idx);
+}
+
+/*
+ * snapshot the rendering state if it has changed since the last triangle was
+ * binned, and return its index in bin_states.
+ */
+static unsigned bin_cur_state(void) {
+    if (!bin_state_dirty && n_bin_states)
+        return n_bin_states - 1;
+
+    bin_states = grow_array(bin_states, &bin_states_alloc,
+                            n_bin_states + 1, sizeof(struct draw_state));
+    struct draw_state *state = bin_states + n_bin_states;
+
+    state->rend_param = rend_param;
+    state->blend_enable = blend_enable;
+    state->sort_mode_enable = sort_mode_enable;
+    memcpy(state->user_clip, user_clip, sizeof(state->user_clip));
+
+    /*
+     * texp is fixed up in flush_tiles since bin_states can move around
+     * whenever it grows.
+     */
+    state->texp = NULL;
+    state->tex.obj_no = -1;
+    if (rend_param.tex_enable) {
+        if (rend_param.tex_idx < GFX_TEX_CACHE_SIZE) {
+            if (textures[rend_param.tex_idx].obj_no >= 0 &&
+                textures[rend_param.tex_idx].obj_no < GFX_OBJ_COUNT) {
+                tex_expand(textures + rend_param.tex_idx);
+                state->tex = textures[rend_param.tex_idx];
+            } else
+                fprintf(stderr, "%s - texture %d not bound to object\n",
+                        __func__, rend_param.tex_idx);
+        } else {
+            fprintf(stderr, "%s - invalid tex_idx %u\n",
+                    __func__, rend_param.tex_idx);
+        }
+    }
+
+    bin_state_dirty = false;
+    return n_bin_states++;
+}
+
+static void bin_tri(unsigned v1, unsigned v2, unsigned v3) {
+    float const *p1 = bin_verts + v1 * GFX_VERT_LEN;
+    float const *p2 = bin_verts + v2 * GFX_VERT_LEN;
+    float const *p3 = bin_verts + v3 * GFX_VERT_LEN;
+
+    // clip_test would reject everything outside of clip anyways
+    int x_max = (int)clip[2] < screen_width - 1 ? (int)clip[2] : screen_width - 1;
+    int y_max = (int)clip[3] < screen_height - 1 ? (int)clip[3] : screen_height - 1;
+
+    int bbox[4];
+    if (!tri_bbox_clipped(bbox, p1, p2, p3, clip[0], clip[1], x_max, y_max))
         return;
+
+    struct bin_cmd cmd = {
+        .tp = BIN_CMD_TRI,
+        .arg = { .tri = { .state_idx = bin_cur_state(),
+                          .verts = { v1, v2, v3 } } }
+    };
+    unsigned cmd_idx = bin_push_cmd(&cmd);
+
+    unsigned tile_x, tile_y;
+    for (tile_y = bbox[1] >> TILE_SHIFT;
+         tile_y <= (unsigned)bbox[3] >> TILE_SHIFT; tile_y++) {
+        for (tile_x = bbox[0] >> TILE_SHIFT;
+             tile_x <= (unsigned)bbox[2] >> TILE_SHIFT; tile_x++) {
+            bin_push_tile(tiles + tile_y * n_tiles_x + tile_x, cmd_idx);
+        }
     }
-    vert_array = new_vert_array;
-    memcpy(vert_array, verts, bytes_per_vert * n_verts);
-    vert_array_len = n_verts;
 }
 
 static void soft_gfx_draw_vert_array(struct gfx_il_inst *cmd) {
@@ -1788,36 +2433,42 @@ static void soft_gfx_draw_vert_array(struct gfx_il_inst *cmd) {
     unsigned first_idx = cmd->arg.draw_vert_array.first_idx;
     unsigned last_idx = first_idx + (n_verts - 1);
 
-    if (!n_verts || !vert_array || last_idx >= vert_array_len)
+    if (!n_verts || render_tgt < 0 || last_idx >= vert_array_len)
         return;
 
-    struct gfx_obj *obj = gfx_obj_get(render_tgt);
     unsigned cur_idx;
-    float const *tri_buf[2];
+    unsigned tri_buf[2];
     unsigned tri_buf_len = 0;
 
     if (wireframe_mode) {
         /*
          * draw triangles as white lines with no depth testing or
-         * per-vertex attributes
+         * per-vertex attributes.  These go straight to the framebuffer, so
+         * anything that's been binned has to get drawn first.
          */
+        flush_tiles();
+
+        struct gfx_obj *obj = gfx_obj_get(render_tgt);
+        float const *vert_array = bin_verts + vert_array_base * GFX_VERT_LEN;
+        float const *line_buf[2];
         for (cur_idx = first_idx; cur_idx <= last_idx; cur_idx++) {
             if (tri_buf_len == 2) {
                 float const *newvert = vert_array + cur_idx * GFX_VERT_LEN;
 
-                draw_line(obj, tri_buf[0][0], tri_buf[0][1], tri_buf[1][0], tri_buf[1][1], 0xffffffff);
-                draw_line(obj, tri_buf[1][0], tri_buf[1][1], newvert[0], newvert[1], 0xffffffff);
-                draw_line(obj, newvert[0], newvert[1], tri_buf[0][0], tri_buf[0][1], 0xffffffff);
+                draw_line(obj, line_buf[0][0], line_buf[0][1], line_buf[1][0], line_buf[1][1], 0xffffffff);
+                draw_line(obj, line_buf[1][0], line_buf[1][1], newvert[0], newvert[1], 0xffffffff);
+                draw_line(obj, newvert[0], newvert[1], line_buf[0][0], line_buf[0][1], 0xffffffff);
 
-                tri_buf[0] = tri_buf[1];
-                tri_buf[1] = newvert;
+                line_buf[0] = line_buf[1];
+                line_buf[1] = newvert;
             } else {
-                tri_buf[tri_buf_len++] = vert_array + cur_idx * GFX_VERT_LEN;
+                line_buf[tri_buf_len++] = vert_array + cur_idx * GFX_VERT_LEN;
             }
         }
     } else {
         bool odd = false;
         for (cur_idx = first_idx; cur_idx <= last_idx; cur_idx++) {
+            unsigned newvert = vert_array_base + cur_idx;
             if (tri_buf_len == 2) {
                 /*
                  * reverse winding order on every other triangle so that they all
@@ -1827,17 +2478,16 @@ static void soft_gfx_draw_vert_array(struct gfx_il_inst *cmd) {
                  * winding order but I want to keep things consistent for when I
                  * eventually implement culling.
                  */
-                float const *newvert = vert_array + cur_idx * GFX_VERT_LEN;
                 if (odd)
-                    draw_tri(obj, tri_buf[1], tri_buf[0], newvert);
+                    bin_tri(tri_buf[1], tri_buf[0], newvert);
                 else
-                    draw_tri(obj, tri_buf[0], tri_buf[1], newvert);
+                    bin_tri(tri_buf[0], tri_buf[1], newvert);
                 odd = !odd;
 
                 tri_buf[0] = tri_buf[1];
                 tri_buf[1] = newvert;
             } else {
-                tri_buf[tri_buf_len++] = vert_array + cur_idx * GFX_VERT_LEN;
+                tri_buf[tri_buf_len++] = newvert;
             }
         }
     }
@@ -1855,10 +2505,13 @@ static void soft_gfx_bind_tex(struct gfx_il_inst *cmd) {
     } else {
         struct tex *texp = textures + tex_no;
 
+        // the new binding gets expanded the first time it's drawn with
+        tex_drop(texp);
         texp->obj_no = obj_handle;
         texp->width = width;
         texp->height = height;
         texp->fmt = pix_fmt;
+        bin_state_dirty = true;
     }
 }
 
@@ -1867,11 +2520,13 @@ static void soft_gfx_unbind_tex(struct gfx_il_inst *cmd) {
     if (tex_no >= GFX_TEX_CACHE_SIZE) {
         fprintf(stderr, "%s - invalid texture handle %u\n", __func__, tex_no);
     } else {
+        tex_drop(textures + tex_no);
         textures[tex_no].obj_no = -1;
+        bin_state_dirty = true;
     }
 }
 
-static void sort_oit_pix_list(int first_idx) {
+static void sort_oit_pix_list(struct oit_pixel *oit_pixels, int first_idx) {
     int src_idx = first_idx;
     struct oit_pixel *srcp = oit_pixels + src_idx;
     struct oit_pixel *cmpp = srcp;
@@ -1900,7 +2555,141 @@ static void sort_oit_pix_list(int first_idx) {
     }
 
     if (srcp->next_pix_idx >= 0)
-        sort_oit_pix_list(srcp->next_pix_idx);
+        sort_oit_pix_list(oit_pixels, srcp->next_pix_idx);
+}
+
+static void tile_clear(struct tile *tile, struct gfx_obj *obj, uint32_t color) {
+    int row, col;
+    for (row = tile->y_min; row <= tile->y_max; row++)
+        for (col = tile->x_min; col <= tile->x_max; col++)
+            put_pix(obj, col, row, color);
+
+    /*
+     * clear depth buffer
+     *
+     * XXX not entirely sure what the best default value here should be since
+     * there are several different depth tests that games can configure.
+     * Greater/Greater-or-equal seem to be the most popular ones (and the only
+     * one supports for order-independent transparency) so -INFINITY works well
+     * here.  Ideally we would be implementing the depth test using the same
+     * algorithm as the actual PVR2 hardware instead of using a persistent
+     * depth buffer like high-level APIs do.
+     */
+    unsigned idx;
+    for (idx = 0; idx < TILE_PIX; idx++)
+        tile->w_buffer[idx] = -INFINITY;
+}
+
+// sort pixels and render back-to-front
+static void tile_resolve_oit(struct tile *tile, struct gfx_obj *obj) {
+    int row, col;
+    for (row = tile->y_min; row <= tile->y_max; row++) {
+        for (col = tile->x_min; col <= tile->x_max; col++) {
+            float *w_ref = tile_w_buffer(tile, col, row);
+            int pix_idx = tile->oit_buf[(row - tile->y_min) * TILE_SIDE +
+                                        (col - tile->x_min)];
+            if (pix_idx < 0)
+                continue;
+
+            sort_oit_pix_list(tile->oit_pixels, pix_idx);
+            do {
+                struct oit_pixel *pix = tile->oit_pixels + pix_idx;
+                if (pix->w_coord >= *w_ref) {
+                    put_pix_blended(obj, col, row,
+                                    pix->rgba[0]          |
+                                    (pix->rgba[1] << 8)   |
+                                    (pix->rgba[2] << 16)  |
+                                    (pix->rgba[3] << 24),
+                                    pix->src_blend_factor,
+                                    pix->dst_blend_factor);
+                    *w_ref = pix->w_coord;
+                }
+                pix_idx = pix->next_pix_idx;
+            } while (pix_idx >= 0);
+        }
+    }
+    tile_reset_oit(tile);
+}
+
+// run everything that was binned into this tile, in order
+static void tile_render(struct tile *tile, struct gfx_obj *obj) {
+    unsigned idx;
+    for (idx = 0; idx < tile->n_cmds; idx++) {
+        struct bin_cmd const *cmd = bin_cmds + tile->cmds[idx];
+        switch (cmd->tp) {
+        case BIN_CMD_TRI:
+            draw_tri(tile, obj, bin_states + cmd->arg.tri.state_idx,
+                     bin_verts + cmd->arg.tri.verts[0] * GFX_VERT_LEN,
+                     bin_verts + cmd->arg.tri.verts[1] * GFX_VERT_LEN,
+                     bin_verts + cmd->arg.tri.verts[2] * GFX_VERT_LEN);
+            break;
+        case BIN_CMD_CLEAR:
+            tile_clear(tile, obj, cmd->arg.clear.color);
+            break;
+        case BIN_CMD_BEGIN_SORT:
+            tile_reset_oit(tile);
+            break;
+        case BIN_CMD_END_SORT:
+            tile_resolve_oit(tile, obj);
+            break;
+        }
+    }
+    tile->n_cmds = 0;
+}
+
+/*
+ * rasterize everything that's been binned so far.  This has to happen before
+ * anything that could look at or modify the render target or a texture.
+ */
+static void flush_tiles(void) {
+    if (!n_bin_cmds)
+        return;
+
+    if (render_tgt >= 0) {
+        unsigned idx;
+        for (idx = 0; idx < n_bin_states; idx++) {
+            struct draw_state *state = bin_states + idx;
+            state->texp = state->tex.obj_no >= 0 ? &state->tex : NULL;
+        }
+
+        washdc_mutex_lock(&tile_lock);
+        tile_tgt_obj = gfx_obj_get(render_tgt);
+        next_tile = 0;
+        n_tiles_done = 0;
+        n_tiles_queued = n_tiles_x * n_tiles_y;
+        washdc_cvar_broadcast(&tile_work_cvar);
+
+        while (next_tile < n_tiles_queued) {
+            unsigned tile_idx = next_tile++;
+            washdc_mutex_unlock(&tile_lock);
+            tile_render(tiles + tile_idx, tile_tgt_obj);
+            washdc_mutex_lock(&tile_lock);
+            n_tiles_done++;
+        }
+        while (n_tiles_done < n_tiles_queued)
+            washdc_cvar_wait(&tile_done_cvar, &tile_lock);
+
+        next_tile = n_tiles_queued = n_tiles_done = 0;
+        washdc_mutex_unlock(&tile_lock);
+    } else {
+        fprintf(stderr, "%s - no render target bound!\n", __func__);
+        unsigned idx;
+        for (idx = 0; idx < n_tiles_x * n_tiles_y; idx++)
+            tiles[idx].n_cmds = 0;
+    }
+
+    n_bin_cmds = 0;
+    n_bin_states = 0;
+    bin_state_dirty = true;
+    tex_free_retired();
+
+    // the current vertex array is still needed for future draws
+    if (vert_array_len) {
+        memmove(bin_verts, bin_verts + vert_array_base * GFX_VERT_LEN,
+                sizeof(float) * GFX_VERT_LEN * vert_array_len);
+    }
+    vert_array_base = 0;
+    n_bin_verts = vert_array_len;
 }
 
 static void soft_gfx_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
@@ -1928,9 +2717,11 @@ static void soft_gfx_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
             break;
         case GFX_IL_SET_BLEND_ENABLE:
             blend_enable = cmd->arg.set_blend_enable.do_enable;
+            bin_state_dirty = true;
             break;
         case GFX_IL_SET_REND_PARAM:
             rend_param = cmd->arg.set_rend_param.param;
+            bin_state_dirty = true;
             break;
         case GFX_IL_SET_CLIP_RANGE:
             break;
@@ -1961,49 +2752,26 @@ static void soft_gfx_exec_gfx_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
             break;
         case GFX_IL_BEGIN_DEPTH_SORT:
             sort_mode_enable = true;
-
-            // re-initialize
-            n_oit_pixels = 0;
+            bin_state_dirty = true;
             {
-                unsigned idx;
-                for (idx = 0; idx < FB_WIDTH * FB_HEIGHT; idx++)
-                    oit_buf[idx] = -1;
+                struct bin_cmd bin_cmd = { .tp = BIN_CMD_BEGIN_SORT };
+                bin_all_tiles(&bin_cmd);
             }
             break;
         case GFX_IL_END_DEPTH_SORT:
-            // sort pixels and render back-to-front
             {
-                int row, col;
-                for (row = 0; row < FB_HEIGHT; row++)
-                    for (col = 0; col < FB_WIDTH; col++) {
-                        int pix_idx = oit_buf[row * FB_WIDTH + col];
-                        if (pix_idx >= 0) {
-                            sort_oit_pix_list(pix_idx);
-                            struct gfx_obj *obj = gfx_obj_get(render_tgt);
-                            do {
-                                struct oit_pixel *pix = oit_pixels + pix_idx;
-                                if (depth_test(col, row, pix->w_coord)) {
-                                    put_pix_blended(obj, col, row,
-                                                    pix->rgba[0]          |
-                                                    (pix->rgba[1] << 8)   |
-                                                    (pix->rgba[2] << 16)  |
-                                                    (pix->rgba[3] << 24),
-                                                    pix->src_blend_factor,
-                                                    pix->dst_blend_factor);
-                                    w_buffer[row * screen_width + col] = pix->w_coord;
-                                }
-                                pix_idx = pix->next_pix_idx;
-                            } while (pix_idx >= 0);
-                        }
-                    }
+                struct bin_cmd bin_cmd = { .tp = BIN_CMD_END_SORT };
+                bin_all_tiles(&bin_cmd);
             }
             sort_mode_enable = false;
+            bin_state_dirty = true;
             break;
         case GFX_IL_SET_USER_CLIP:
             user_clip[0] = cmd->arg.set_user_clip.x_min;
             user_clip[1] = cmd->arg.set_user_clip.y_min;
             user_clip[2] = cmd->arg.set_user_clip.x_max;
             user_clip[3] = cmd->arg.set_user_clip.y_max;
+            bin_state_dirty = true;
             break;
         default:
             fprintf(stderr, "ERROR: UNKNOWN GFX IL COMMAND %02X\n",
@@ -23,16 +23,23 @@
 #include "i_hate_windows.h"
 
 #include <cmath>
-#include <mutex>
-#include <condition_variable>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 #include <portaudio.h>
 
 #include "washdc/error.h"
+#include "washdc/washdc.h"
+#include "threading.h"
 #include "sound.hpp"
 #include "config_file.h"
-#include "threading.h"
 #include "intmath.h"
+#include "resampler.hpp"
+#include "capture.h"
+#include "stream.h"
 
 namespace sound {
 
@@ -48,26 +55,63 @@ static int snd_cb(const void *input, void *output,
                   void *argp);
 
 
-static washdc_mutex buffer_lock;
-static washdc_cvar samples_submitted;
+/*
+ * single-producer/single-consumer ring of stereo frames.  The emulation
+ * thread is the only writer and the PortAudio callback is the only reader,
+ * so neither side ever has to take a lock.  The indices are free-running and
+ * only get masked when they're used to access the ring.
+ */
+struct frame {
+    washdc_sample_type left, right;
+};
+
+// about 1/10 of a second
+static const unsigned RING_LEN = 4096;
+static const unsigned RING_MASK = RING_LEN - 1;
+static struct frame ring[RING_LEN];
+static std::atomic<unsigned> read_idx, write_idx;
 
-// 1/10 of a second
-static const unsigned BUF_LEN = 4410;
-static washdc_sample_type sample_buf[BUF_LEN];
-static unsigned read_buf_idx, write_buf_idx;
 static bool do_mute, have_sound_dev;
 static enum sync_mode audio_sync_mode;
 
-void init(void) {
-    washdc_mutex_init(&buffer_lock);
-    washdc_cvar_init(&samples_submitted);
+/*
+ * PortAudio owns the callback thread, so its priority gets set from inside
+ * the first callback.
+ */
+static enum washdc_thread_prio cb_prio;
+static bool cb_prio_applied;
+
+/*
+ * dynamic rate control.  The emulator's output rate gets nudged up or down
+ * to keep the ring around half full, so that small differences between the
+ * emulator's pacing and the audio device's clock don't turn into underruns
+ * or make the emulation thread block on the ring.
+ */
+static const unsigned SAMPLE_RATE = 44100;
+static const unsigned RING_TARGET = RING_LEN / 2;
+static struct resampler drc;
 
+static void push_frames(struct frame const *frames, unsigned count);
+
+void init(void) {
     do_mute = false;
     have_sound_dev = true;
     audio_sync_mode = SYNC_MODE_NORM;
     cfg_get_bool("audio.mute", &do_mute);
 
-    read_buf_idx = write_buf_idx = 0;
+    cb_prio = WASHDC_THREAD_PRIO_NORMAL;
+    cb_prio_applied = false;
+    char const *prio = cfg_get_node("audio.thread-priority");
+    if (prio && strcmp(prio, "high") == 0)
+        cb_prio = WASHDC_THREAD_PRIO_HIGH;
+    else if (prio && strcmp(prio, "realtime") == 0)
+        cb_prio = WASHDC_THREAD_PRIO_REALTIME;
+    else if (prio && strcmp(prio, "normal") != 0)
+        fprintf(stderr, "unrecognized audio thread priority \"%s\"\n", prio);
+
+    read_idx.store(0);
+    write_idx.store(0);
+    resampler_init(&drc, SAMPLE_RATE, SAMPLE_RATE);
 
     int err;
     if ((err = Pa_Initialize()) != paNoError) {
@@ -82,7 +126,7 @@ void init(void) {
      * 44.1kHz, then AICA_EXTERNAL_FREQ in libwashdc/hw/aica/aica.c needs to be
      * changed to match it.
      */
-    err = Pa_OpenDefaultStream(&snd_stream, 0, 2, paInt32, 44100*1,
+    err = Pa_OpenDefaultStream(&snd_stream, 0, 2, paInt32, SAMPLE_RATE,
                                paFramesPerBufferUnspecified,
                                snd_cb, NULL);
     if (err != paNoError) {
@@ -109,9 +153,6 @@ void cleanup(void) {
             RAISE_ERROR(ERROR_EXT_FAILURE);
         }
     }
-
-    washdc_cvar_cleanup(&samples_submitted);
-    washdc_mutex_cleanup(&buffer_lock);
 }
 
 static int snd_cb(const void *input, void *output,
@@ -119,25 +160,30 @@ static int snd_cb(const void *input, void *output,
                   PaStreamCallbackTimeInfo const *ti,
                   PaStreamCallbackFlags flags,
                   void *argp) {
-    washdc_mutex_lock(&buffer_lock);
-
-    washdc_sample_type *outbuf = (washdc_sample_type*)output;
-    unsigned long frame_no;
-    for (frame_no = 0; frame_no < n_frames; frame_no++) {
-        // TODO: stereo
-        washdc_sample_type sample;
-        if (read_buf_idx != write_buf_idx) {
-            sample = sample_buf[read_buf_idx];
-            read_buf_idx = (1 + read_buf_idx) % BUF_LEN;
-        } else {
-            sample = 0;
-        }
-        *outbuf++ = sample;
-        *outbuf++ = sample;
+    struct frame *outbuf = (struct frame*)output;
+
+    if (!cb_prio_applied) {
+        cb_prio_applied = true;
+        if (cb_prio != WASHDC_THREAD_PRIO_NORMAL &&
+            washdc_thread_set_prio(cb_prio) != 0)
+            fprintf(stderr, "unable to raise the audio thread's priority\n");
     }
-    washdc_cvar_signal(&samples_submitted);
 
-    washdc_mutex_unlock(&buffer_lock);
+    unsigned rd = read_idx.load(std::memory_order_relaxed);
+    unsigned avail = write_idx.load(std::memory_order_acquire) - rd;
+    unsigned count = std::min<unsigned long>(avail, n_frames);
+
+    // the frames can wrap around the end of the ring at most once
+    unsigned first = std::min(count, RING_LEN - (rd & RING_MASK));
+    memcpy(outbuf, ring + (rd & RING_MASK), first * sizeof(struct frame));
+    memcpy(outbuf + first, ring, (count - first) * sizeof(struct frame));
+
+    read_idx.store(rd + count, std::memory_order_release);
+
+    // underrun
+    if (count < n_frames)
+        memset(outbuf + count, 0, (n_frames - count) * sizeof(struct frame));
+
     return 0;
 }
 
@@ -150,25 +196,74 @@ static washdc_sample_type scale_sample(washdc_sample_type sample) {
     return sat_shift(sample, 8);
 }
 
+/*
+ * copy frames into the ring.  In SYNC_MODE_NORM this waits for the callback
+ * to make room, which keeps the emulator from running ahead of realtime when
+ * nothing else is pacing it.  Otherwise anything that doesn't fit gets
+ * dropped.
+ */
+static void push_frames(struct frame const *frames, unsigned count) {
+    while (count) {
+        unsigned wr = write_idx.load(std::memory_order_relaxed);
+        unsigned rd = read_idx.load(std::memory_order_acquire);
+        unsigned space = RING_LEN - (wr - rd);
+
+        if (!space) {
+            if (audio_sync_mode != SYNC_MODE_NORM)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        unsigned n_copy = std::min(count, space);
+        unsigned first = std::min(n_copy, RING_LEN - (wr & RING_MASK));
+        memcpy(ring + (wr & RING_MASK), frames, first * sizeof(struct frame));
+        memcpy(ring, frames + first, (n_copy - first) * sizeof(struct frame));
+
+        write_idx.store(wr + n_copy, std::memory_order_release);
+
+        frames += n_copy;
+        count -= n_copy;
+    }
+}
+
 void submit_samples(washdc_sample_type *samples, unsigned count) {
+    static const unsigned CHUNK_LEN = 256;
+    washdc_sample_type resampled[CHUNK_LEN + CHUNK_LEN / 2];
+    struct frame chunk[sizeof(resampled) / sizeof(resampled[0])];
+
+    capture_submit_audio(samples, count);
+    stream_submit_audio(samples, count);
+
     if (!have_sound_dev)
         return;
-    washdc_mutex_lock(&buffer_lock);
 
-    while (count) {
-        unsigned next_write_buf_idx = (1 + write_buf_idx) % BUF_LEN;
-        if (audio_sync_mode == SYNC_MODE_NORM)
-            while (next_write_buf_idx == read_buf_idx)
-                washdc_cvar_wait(&samples_submitted, &buffer_lock);
-        if (do_mute)
-            sample_buf[write_buf_idx] = 0;
-        else
-            sample_buf[write_buf_idx] = scale_sample(*samples++);
-        write_buf_idx = next_write_buf_idx;
-        count--;
+    double adjust = 0.0;
+    if (audio_sync_mode == SYNC_MODE_NORM) {
+        unsigned fill = write_idx.load(std::memory_order_relaxed) -
+            read_idx.load(std::memory_order_acquire);
+        adjust = RESAMPLER_MAX_ADJUST *
+            ((double)RING_TARGET - (double)fill) / (double)RING_TARGET;
     }
+    resampler_set_adjust(&drc, adjust);
+
+    while (count) {
+        unsigned n_in = std::min(count, CHUNK_LEN);
+        unsigned n_frames = resampler_process(&drc, samples, n_in, resampled);
 
-    washdc_mutex_unlock(&buffer_lock);
+        // the AICA mixes down to a single channel, so both sides get the same
+        unsigned idx;
+        for (idx = 0; idx < n_frames; idx++) {
+            washdc_sample_type sample =
+                do_mute ? 0 : scale_sample(resampled[idx]);
+            chunk[idx].left = chunk[idx].right = sample;
+        }
+
+        push_frames(chunk, n_frames);
+
+        samples += n_in;
+        count -= n_in;
+    }
 }
 
 void mute(bool en_mute) {
@@ -181,6 +276,7 @@ bool is_muted(void) {
 
 void set_sync_mode(enum sync_mode mode) {
     audio_sync_mode = mode;
+    washdc_set_frame_limit(mode == SYNC_MODE_NORM);
 }
 
 }
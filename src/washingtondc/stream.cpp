@@ -0,0 +1,417 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+#include "washdc/washdc.h"
+
+#include "capture.h"
+#include "stream.h"
+
+#define STREAM_MAGIC 0x54534457 // "WDST"
+#define STREAM_HDR_LEN 20
+
+// 10ms of audio per packet
+#define STREAM_AUDIO_BATCH 441
+
+// about a second of audio; anything older than that gets dropped
+#define STREAM_MAX_QUEUED_AUDIO 100
+
+#define STREAM_INPUT_LEN (STREAM_HDR_LEN + 8 + WASHDC_CONTROLLER_N_AXES)
+
+static std::atomic<bool> active;
+static std::atomic<bool> stop_req;
+static int sock = -1;
+
+static std::thread sender, receiver;
+static std::mutex queue_lock;
+static std::condition_variable queue_cond;
+
+/*
+ * the newest frame that hasn't been sent yet.  The emulation thread copies
+ * into it and the sender thread swaps it out, so a late frame just gets
+ * overwritten by the next one.
+ */
+static std::vector<uint8_t> pend_pix;
+static unsigned pend_width, pend_height;
+static bool pend_bottom_up, have_pend;
+static unsigned n_frames_dropped;
+
+static std::deque<std::vector<int16_t> > audio_queue;
+
+// only accessed on the emulation thread
+static std::vector<int16_t> audio_batch;
+
+// only accessed on the sender thread
+static std::vector<uint8_t> cur_pix, yuv, prev_yuv;
+static unsigned prev_width, prev_height;
+static uint32_t frame_no;
+static uint32_t sample_no;
+static unsigned long long n_pkts_dropped;
+
+static void sender_main(void);
+static void receiver_main(void);
+static void flush_audio(void);
+static void send_frame(unsigned width, unsigned height, bool bottom_up);
+static void send_audio(std::vector<int16_t> const& samples);
+
+static void put_u16(uint8_t *dst, uint16_t val) {
+    dst[0] = uint8_t(val);
+    dst[1] = uint8_t(val >> 8);
+}
+
+static void put_u32(uint8_t *dst, uint32_t val) {
+    dst[0] = uint8_t(val);
+    dst[1] = uint8_t(val >> 8);
+    dst[2] = uint8_t(val >> 16);
+    dst[3] = uint8_t(val >> 24);
+}
+
+static uint32_t get_u32(uint8_t const *src) {
+    return src[0] | (uint32_t(src[1]) << 8) |
+        (uint32_t(src[2]) << 16) | (uint32_t(src[3]) << 24);
+}
+
+static void put_hdr(uint8_t *dst, unsigned tp, unsigned flags,
+                    unsigned len, uint32_t seq, unsigned width,
+                    unsigned height, unsigned x, unsigned y) {
+    put_u32(dst, STREAM_MAGIC);
+    dst[4] = tp;
+    dst[5] = flags;
+    put_u16(dst + 6, len);
+    put_u32(dst + 8, seq);
+    put_u16(dst + 12, width);
+    put_u16(dst + 14, height);
+    put_u16(dst + 16, x);
+    put_u16(dst + 18, y);
+}
+
+#ifndef _WIN32
+
+int stream_start(char const *dest) {
+    if (active.load())
+        return 0;
+
+    std::string dest_str(dest);
+    size_t colon = dest_str.rfind(':');
+    if (colon == std::string::npos || colon == 0 ||
+        colon + 1 == dest_str.size()) {
+        fprintf(stderr, "%s - \"%s\" should look like host:port\n",
+                __func__, dest);
+        return -1;
+    }
+    std::string host = dest_str.substr(0, colon);
+    std::string port = dest_str.substr(colon + 1);
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "%s - unable to resolve %s: %s\n",
+                __func__, dest, gai_strerror(err));
+        return -1;
+    }
+
+    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock < 0 || connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        fprintf(stderr, "%s - unable to open a socket to %s: %s\n",
+                __func__, dest, strerror(errno));
+        if (sock >= 0)
+            close(sock);
+        sock = -1;
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    // so the receiver notices stop_req
+    struct timeval tv = { 0, 100000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    have_pend = false;
+    n_frames_dropped = 0;
+    n_pkts_dropped = 0;
+    audio_queue.clear();
+    audio_batch.clear();
+    prev_yuv.clear();
+    prev_width = prev_height = 0;
+    frame_no = sample_no = 0;
+    stop_req.store(false);
+
+    sender = std::thread(sender_main);
+    receiver = std::thread(receiver_main);
+    active.store(true);
+
+    printf("streaming to %s\n", dest);
+    return 0;
+}
+
+void stream_stop(void) {
+    if (!active.load())
+        return;
+    active.store(false);
+
+    {
+        std::lock_guard<std::mutex> lck(queue_lock);
+        stop_req.store(true);
+    }
+    queue_cond.notify_one();
+    sender.join();
+    receiver.join();
+
+    close(sock);
+    sock = -1;
+
+    printf("streaming stopped: %u frames dropped before sending, %llu "
+           "packets dropped by the socket\n", n_frames_dropped,
+           n_pkts_dropped);
+}
+
+#else
+
+int stream_start(char const *dest) {
+    fprintf(stderr, "ERROR: streaming is not supported on Windows\n");
+    return -1;
+}
+
+void stream_stop(void) {
+}
+
+#endif
+
+bool stream_active(void) {
+    return active.load(std::memory_order_relaxed);
+}
+
+void stream_submit_video(void const *rgba, unsigned width, unsigned height,
+                         bool bottom_up) {
+    if (!active.load(std::memory_order_relaxed))
+        return;
+
+    flush_audio();
+
+    {
+        std::lock_guard<std::mutex> lck(queue_lock);
+        if (have_pend)
+            n_frames_dropped++;
+        size_t n_bytes = size_t(width) * height * 4;
+        pend_pix.resize(n_bytes);
+        memcpy(pend_pix.data(), rgba, n_bytes);
+        pend_width = width;
+        pend_height = height;
+        pend_bottom_up = bottom_up;
+        have_pend = true;
+    }
+    queue_cond.notify_one();
+}
+
+void stream_submit_audio(washdc_sample_type const *samples, unsigned count) {
+    if (!active.load(std::memory_order_relaxed))
+        return;
+
+    while (count--) {
+        washdc_sample_type sample = *samples++;
+        if (sample > INT16_MAX)
+            sample = INT16_MAX;
+        else if (sample < INT16_MIN)
+            sample = INT16_MIN;
+        audio_batch.push_back(int16_t(sample));
+        if (audio_batch.size() >= STREAM_AUDIO_BATCH)
+            flush_audio();
+    }
+}
+
+static void flush_audio(void) {
+    if (audio_batch.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lck(queue_lock);
+        if (audio_queue.size() >= STREAM_MAX_QUEUED_AUDIO)
+            audio_queue.pop_front();
+        audio_queue.emplace_back();
+        audio_queue.back().swap(audio_batch);
+    }
+    audio_batch.reserve(STREAM_AUDIO_BATCH);
+    queue_cond.notify_one();
+}
+
+#ifndef _WIN32
+
+static void send_pkt(uint8_t const *pkt, size_t len) {
+    // a full socket buffer means the link can't keep up, so just drop it
+    if (send(sock, pkt, len, MSG_DONTWAIT) < 0)
+        n_pkts_dropped++;
+}
+
+static void sender_main(void) {
+    for (;;) {
+        std::deque<std::vector<int16_t> > audio;
+        bool have_frame;
+        unsigned width, height;
+        bool bottom_up;
+        {
+            std::unique_lock<std::mutex> lck(queue_lock);
+            queue_cond.wait(lck, [] {
+                return stop_req.load() || have_pend || !audio_queue.empty();
+            });
+            if (stop_req.load())
+                return;
+            audio.swap(audio_queue);
+            have_frame = have_pend;
+            if (have_frame) {
+                cur_pix.swap(pend_pix);
+                width = pend_width;
+                height = pend_height;
+                bottom_up = pend_bottom_up;
+                have_pend = false;
+            }
+        }
+
+        // audio goes first since it's the one that's noticeable when late
+        for (std::vector<int16_t> const& samples : audio)
+            send_audio(samples);
+        if (have_frame)
+            send_frame(width, height, bottom_up);
+    }
+}
+
+static void send_audio(std::vector<int16_t> const& samples) {
+    uint8_t pkt[STREAM_HDR_LEN + 2 * STREAM_AUDIO_BATCH];
+    size_t idx = 0;
+    while (idx < samples.size()) {
+        unsigned n_samples = samples.size() - idx;
+        if (n_samples > STREAM_AUDIO_BATCH)
+            n_samples = STREAM_AUDIO_BATCH;
+        put_hdr(pkt, STREAM_PKT_AUDIO, 0, n_samples, sample_no, 0, 0, 0, 0);
+        for (unsigned sample = 0; sample < n_samples; sample++)
+            put_u16(pkt + STREAM_HDR_LEN + 2 * sample,
+                    uint16_t(samples[idx + sample]));
+        send_pkt(pkt, STREAM_HDR_LEN + 2 * n_samples);
+        sample_no += n_samples;
+        idx += n_samples;
+    }
+}
+
+static void send_frame(unsigned src_width, unsigned src_height,
+                       bool bottom_up) {
+    // 4:2:0 chroma needs even dimensions
+    unsigned const w = src_width & ~1, h = src_height & ~1;
+    if (!w || !h)
+        return;
+    unsigned const cw = w / 2;
+
+    yuv.resize(size_t(w) * h * 3 / 2);
+    capture_rgba_to_yuv420(yuv.data(), w, h, cur_pix.data(),
+                           src_width, src_height, bottom_up);
+
+    bool keyframe = !(frame_no % STREAM_KEYFRAME_INTERVAL) ||
+        w != prev_width || h != prev_height;
+    uint8_t const *y_plane = yuv.data();
+    uint8_t const *u_plane = y_plane + size_t(w) * h;
+    uint8_t const *v_plane = u_plane + size_t(cw) * (h / 2);
+    size_t const u_offs = size_t(w) * h, v_offs = u_offs + size_t(cw) * (h / 2);
+
+    uint8_t pkt[STREAM_HDR_LEN + 3 * STREAM_TILE_W];
+    for (unsigned y = 0; y < h; y += 2) {
+        for (unsigned x = 0; x < w; x += STREAM_TILE_W) {
+            unsigned tile_w = w - x < STREAM_TILE_W ? w - x : STREAM_TILE_W;
+            size_t y0 = size_t(y) * w + x, y1 = y0 + w;
+            size_t c = size_t(y / 2) * cw + x / 2;
+
+            if (!keyframe &&
+                !memcmp(y_plane + y0, prev_yuv.data() + y0, tile_w) &&
+                !memcmp(y_plane + y1, prev_yuv.data() + y1, tile_w) &&
+                !memcmp(u_plane + c, prev_yuv.data() + u_offs + c,
+                        tile_w / 2) &&
+                !memcmp(v_plane + c, prev_yuv.data() + v_offs + c,
+                        tile_w / 2))
+                continue;
+
+            uint8_t *dst = pkt + STREAM_HDR_LEN;
+            put_hdr(pkt, STREAM_PKT_VIDEO,
+                    keyframe ? STREAM_FLAG_KEYFRAME : 0,
+                    tile_w, frame_no, w, h, x, y);
+            memcpy(dst, y_plane + y0, tile_w);
+            memcpy(dst + tile_w, y_plane + y1, tile_w);
+            memcpy(dst + 2 * tile_w, u_plane + c, tile_w / 2);
+            memcpy(dst + 2 * tile_w + tile_w / 2, v_plane + c, tile_w / 2);
+            send_pkt(pkt, STREAM_HDR_LEN + 3 * tile_w);
+        }
+    }
+
+    prev_yuv.swap(yuv);
+    prev_width = w;
+    prev_height = h;
+    frame_no++;
+}
+
+// controller state goes straight into maple, which is safe from any thread
+static void receiver_main(void) {
+    uint8_t pkt[STREAM_INPUT_LEN];
+    while (!stop_req.load()) {
+        ssize_t len = recv(sock, pkt, sizeof(pkt), 0);
+        if (len != STREAM_INPUT_LEN || get_u32(pkt) != STREAM_MAGIC ||
+            pkt[4] != STREAM_PKT_INPUT)
+            continue;
+
+        uint8_t const *body = pkt + STREAM_HDR_LEN;
+        unsigned port_no = body[0];
+        if (port_no >= WASHDC_CONTROLLER_PORTS)
+            continue;
+
+        uint32_t btns = get_u32(body + 4);
+        washdc_controller_press_btns(port_no, btns);
+        washdc_controller_release_btns(port_no, ~btns);
+        for (unsigned axis = 0; axis < WASHDC_CONTROLLER_N_AXES; axis++)
+            washdc_controller_set_axis(port_no, axis, body[8 + axis]);
+    }
+}
+
+#else
+
+static void sender_main(void) {
+}
+
+static void receiver_main(void) {
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdbool.h>
+
+#include "washdc/sound_intf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * low-latency remote output.  Finished frames and AICA output get sent over
+ * UDP to a single client, and that client's controller state comes back over
+ * the same socket.  Like capture, the emulation thread only ever copies into
+ * a buffer and moves on; the conversion and the network I/O happen on their
+ * own threads.  Only the newest frame is kept, so a slow link drops frames
+ * instead of adding latency.
+ *
+ * Every datagram starts with this little-endian header:
+ *
+ *     u32 "WDST" magic
+ *     u8  packet type (STREAM_PKT_*)
+ *     u8  flags (STREAM_FLAG_*)
+ *     u16 tile width in pixels (video) or sample count (audio)
+ *     u32 frame number (video) or index of the first sample (audio)
+ *     u16 picture width, u16 picture height (video only)
+ *     u16 tile x, u16 tile y (video only)
+ *
+ * Video is sent as tiles of at most STREAM_TILE_W x 2 pixels of full-range
+ * BT.601 4:2:0: the two rows of Y followed by one row each of U and V.  Only
+ * tiles that changed since the last frame get sent, except for keyframes
+ * every STREAM_KEYFRAME_INTERVAL frames where all of them do.  Audio is
+ * 16-bit mono PCM at 44.1kHz.
+ *
+ * Input packets from the client have the same header (only the magic and
+ * type matter) followed by a u8 port number, three bytes of padding, the
+ * u32 WASHDC_CONT_BTN_* state and WASHDC_CONTROLLER_N_AXES bytes of axes.
+ */
+#define STREAM_TILE_W 256
+#define STREAM_KEYFRAME_INTERVAL 60
+
+#define STREAM_PKT_VIDEO 0
+#define STREAM_PKT_AUDIO 1
+#define STREAM_PKT_INPUT 2
+
+#define STREAM_FLAG_KEYFRAME 1
+
+// dest is "host:port"
+int stream_start(char const *dest);
+void stream_stop(void);
+
+bool stream_active(void);
+
+// same as capture_submit_video
+void stream_submit_video(void const *rgba, unsigned width, unsigned height,
+                         bool bottom_up);
+
+// same as capture_submit_audio
+void stream_submit_audio(washdc_sample_type const *samples, unsigned count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -46,6 +46,7 @@
 #include "../sound.hpp"
 #include "../washingtondc.hpp"
 #include "../config_file.h"
+#include "../rend_if.hpp"
 
 #ifndef DISABLE_MEM_DUMP_UI
 #include "imfilebrowser.h"
@@ -60,6 +61,7 @@ static bool not_hidden;
 static bool en_perf_win = true;
 static bool en_demo_win = false;
 static bool en_aica_win = true;
+static bool en_perf_graph_win = false;
 
 // disabled by default due to poor performance
 static bool en_tex_cache_win = false;
@@ -81,6 +83,7 @@ static std::unique_ptr<renderer> ui_renderer;
 
 namespace overlay {
 static void show_perf_win(void);
+static void show_perf_graph_win(void);
 static void show_aica_win(void);
 static void show_tex_cache_win(void);
 static void show_tex_win(unsigned idx);
@@ -111,16 +114,51 @@ static void update_tex_cache_ent(struct washdc_texinfo *texinfo, tex_stat stat);
 
 static std::vector<tex_stat> textures;
 
+// the last PERF_GRAPH_LEN per-frame samples of something, oldest first
+#define PERF_GRAPH_LEN 240
+struct perf_graph {
+    float vals[PERF_GRAPH_LEN];
+    int head;
+
+    perf_graph() : vals(), head(0) {
+    }
+
+    void push(float val) {
+        vals[head] = val;
+        head = (head + 1) % PERF_GRAPH_LEN;
+    }
+
+    float latest(void) const {
+        return vals[(head + PERF_GRAPH_LEN - 1) % PERF_GRAPH_LEN];
+    }
+
+    void plot(char const *label) const {
+        char txt[32];
+        snprintf(txt, sizeof(txt), "%.2f", (double)latest());
+        ImGui::PlotLines(label, vals, PERF_GRAPH_LEN, head, txt,
+                         FLT_MAX, FLT_MAX, ImVec2(0, 48));
+    }
+};
+
 }
 
 void overlay::show(bool do_show) {
     not_hidden = do_show;
+    if (!do_show)
+        rend_set_gpu_timing(false);
 }
 
+/*
+ * nothing in here runs while the overlay is hidden.  The stats that the
+ * windows show are all cumulative counters, so they get read when the overlay
+ * comes back.
+ */
 void overlay::draw(void) {
     if (!not_hidden)
         return;
 
+    rend_set_gpu_timing(en_perf_win);
+
     ImGuiIO& io = ImGui::GetIO();
     io.DisplaySize = ImVec2((float)win_glfw_get_width(),
                             (float)win_glfw_get_height());
@@ -187,6 +225,7 @@ void overlay::draw(void) {
 
         if (ImGui::BeginMenu("Window")) {
             ImGui::Checkbox("Performance", &en_perf_win);
+            ImGui::Checkbox("Performance Graphs", &en_perf_graph_win);
             ImGui::Checkbox("AICA", &en_aica_win);
             ImGui::Checkbox("Texture Cache", &en_tex_cache_win);
             ImGui::EndMenu();
@@ -255,6 +294,8 @@ void overlay::draw(void) {
     // Performance Window
     if (en_perf_win)
         show_perf_win();
+    if (en_perf_graph_win)
+        show_perf_graph_win();
 
     if (en_demo_win)
         ImGui::ShowDemoWindow(&en_demo_win);
@@ -356,6 +397,27 @@ static void overlay::show_perf_win(void) {
                 stat.vert_count[WASHDC_PVR2_POLY_GROUP_TRANS_MOD]);
     ImGui::Text("%u punch-through vertices",
                 stat.vert_count[WASHDC_PVR2_POLY_GROUP_PUNCH_THROUGH]);
+    ImGui::Text("%u redundant polygon headers", stat.dup_rend_param_count);
+    ImGui::Text("%u merged draws", stat.merged_draw_count);
+    ImGui::Text("%u aliased framebuffer textures", stat.fb_tex_alias_count);
+
+    unsigned gl_calls_issued, gl_calls_skipped;
+    if (rend_gl_call_stat(&gl_calls_issued, &gl_calls_skipped)) {
+        ImGui::Text("%u OpenGL state calls issued", gl_calls_issued);
+        ImGui::Text("%u OpenGL state calls skipped", gl_calls_skipped);
+    }
+
+    double gpu_ms[RENDERER_GPU_PHASE_COUNT];
+    if (rend_gpu_ms(gpu_ms)) {
+        double gpu_total = 0.0;
+        unsigned phase;
+        for (phase = 0; phase < RENDERER_GPU_PHASE_COUNT; phase++) {
+            ImGui::Text("%.3f ms GPU %s", gpu_ms[phase],
+                        renderer_gpu_phase_name((enum renderer_gpu_phase)phase));
+            gpu_total += gpu_ms[phase];
+        }
+        ImGui::Text("%.3f ms GPU total", gpu_total);
+    }
     ImGui::Text("%u texture transmissions",
                 stat.tex_xmit_count);
     ImGui::Text("%u texture invalidates",
@@ -365,6 +427,147 @@ static void overlay::show_perf_win(void) {
     ImGui::Text("%u texture overwrites", stat.texture_overwrite_count);
     ImGui::Text("%u fresh texture uploads", stat.fresh_texture_upload_count);
     ImGui::Text("%u texture cache evictions", stat.tex_eviction_count);
+    ImGui::Text("%u texture cache thrashes", stat.tex_thrash_count);
+    ImGui::Text("%u display lists replayed", stat.list_cache_hit_count);
+    ImGui::End();
+}
+
+static void overlay::show_perf_graph_win(void) {
+    static perf_graph frame_ms, real_fps, virt_fps;
+    static perf_graph cache_entries, compiles, exec_mem_frag;
+    static perf_graph tex_hits, tex_misses, tex_decodes;
+    static perf_graph tex_overwrites, tex_thrashes;
+    static perf_graph ta_verts, ch2_kb, gdrom_kb;
+    static perf_graph sh4_overrun, arm7_overrun, timeslice_us;
+
+    static bool have_last;
+    static unsigned last_frame;
+    static struct washdc_perf_stat last_perf;
+    static struct washdc_pvr2_stat last_pvr2;
+
+    struct washdc_perf_stat perf;
+    struct washdc_pvr2_stat pvr2;
+    washdc_get_perf_stat(&perf);
+    washdc_get_pvr2_stat(&pvr2);
+
+    /*
+     * take one sample per emulated frame.  Sometimes more than one frame goes
+     * by between overlay updates, in which case the counters get averaged.
+     */
+    unsigned frame = washdc_get_frame_count();
+    if (frame != last_frame) {
+        if (have_last && frame > last_frame) {
+            float n_frames = frame - last_frame;
+            double fps = washdc_get_fps();
+
+            frame_ms.push(fps > 0.0 ? 1000.0 / fps : 0.0);
+            real_fps.push(fps);
+            virt_fps.push(washdc_get_virt_fps());
+
+            cache_entries.push(perf.code_cache_entries);
+            compiles.push((perf.jit_compiles - last_perf.jit_compiles) /
+                          n_frames);
+
+            /*
+             * fragmentation is the portion of free exec memory that's
+             * stranded in segments which still have live allocations.
+             */
+            float frag = 0.0f;
+            if (perf.exec_mem_free_bytes && perf.exec_mem_segs) {
+                size_t seg_len = perf.exec_mem_total_bytes / perf.exec_mem_segs;
+                size_t stranded = perf.exec_mem_free_bytes -
+                    perf.exec_mem_free_segs * seg_len;
+                frag = 100.0f * stranded / perf.exec_mem_free_bytes;
+            }
+            exec_mem_frag.push(frag);
+
+            tex_hits.push((pvr2.tex_cache_hit_count -
+                           last_pvr2.tex_cache_hit_count) / n_frames);
+            tex_misses.push((pvr2.tex_cache_miss_count -
+                             last_pvr2.tex_cache_miss_count) / n_frames);
+            tex_decodes.push((pvr2.tex_xmit_count -
+                              last_pvr2.tex_xmit_count) / n_frames);
+            tex_overwrites.push((pvr2.texture_overwrite_count -
+                                 last_pvr2.texture_overwrite_count) /
+                                n_frames);
+            tex_thrashes.push((pvr2.tex_thrash_count -
+                               last_pvr2.tex_thrash_count) / n_frames);
+
+            unsigned n_verts = 0;
+            for (unsigned group = 0; group < WASHDC_PVR2_POLY_GROUP_COUNT;
+                 group++)
+                n_verts += pvr2.vert_count[group];
+            ta_verts.push(n_verts);
+
+            ch2_kb.push((perf.ch2_dma_bytes - last_perf.ch2_dma_bytes) /
+                        (1024.0f * n_frames));
+            gdrom_kb.push((perf.gdrom_dma_bytes - last_perf.gdrom_dma_bytes) /
+                          (1024.0f * n_frames));
+
+            // average overrun per timeslice over the last frame(s)
+            unsigned long long n_slices =
+                perf.sh4_timeslices - last_perf.sh4_timeslices;
+            sh4_overrun.push(n_slices ? (perf.sh4_ts_overrun_ns -
+                                         last_perf.sh4_ts_overrun_ns) /
+                             n_slices : 0.0f);
+            timeslice_us.push(perf.timeslice_ns / 1000.0);
+            n_slices = perf.arm7_timeslices - last_perf.arm7_timeslices;
+            arm7_overrun.push(n_slices ? (perf.arm7_ts_overrun_ns -
+                                          last_perf.arm7_ts_overrun_ns) /
+                              n_slices : 0.0f);
+        }
+
+        have_last = true;
+        last_frame = frame;
+        last_perf = perf;
+        last_pvr2 = pvr2;
+    }
+
+    ImGui::Begin("Performance Graphs", &en_perf_graph_win);
+
+    frame_ms.plot("frame time (ms)");
+    real_fps.plot("real FPS");
+    virt_fps.plot("virtual FPS");
+
+    ImGui::Separator();
+    cache_entries.plot("code cache entries");
+    compiles.plot("compiles/frame");
+    if (perf.exec_mem_total_bytes) {
+        ImGui::Text("exec_mem: %u KB free of %u KB, %u allocations",
+                    (unsigned)(perf.exec_mem_free_bytes / 1024),
+                    (unsigned)(perf.exec_mem_total_bytes / 1024),
+                    perf.exec_mem_allocations);
+        ImGui::Text("%u of %u segments free",
+                    perf.exec_mem_free_segs, perf.exec_mem_segs);
+        exec_mem_frag.plot("exec_mem fragmentation (%)");
+    }
+
+    ImGui::Separator();
+    tex_hits.plot("tex cache hits/frame");
+    tex_misses.plot("tex cache misses/frame");
+    tex_decodes.plot("tex decodes/frame");
+
+    /*
+     * fresh uploads only ever go into empty slots, and slots never get
+     * emptied again, so that count is also how full the cache is.
+     */
+    ImGui::Text("%u of %u texture slots in use",
+                pvr2.fresh_texture_upload_count, pvr2.tex_cache_size);
+    tex_overwrites.plot("tex cache overwrites/frame");
+    tex_thrashes.plot("tex cache thrashes/frame");
+    ta_verts.plot("TA vertices/frame");
+
+    ImGui::Separator();
+    ch2_kb.plot("CH2 DMA KB/frame");
+    gdrom_kb.plot("GD-ROM DMA KB/frame");
+
+    ImGui::Separator();
+    timeslice_us.plot("timeslice length (us)");
+    sh4_overrun.plot("SH4 timeslice overrun (ns)");
+    arm7_overrun.plot("ARM7 timeslice overrun (ns)");
+    ImGui::Text("worst overrun: SH4 %.0f ns, ARM7 %.0f ns",
+                perf.sh4_ts_overrun_max_ns, perf.arm7_ts_overrun_max_ns);
+
     ImGui::End();
 }
 
@@ -674,7 +877,8 @@ void overlay::cleanup(void) {
 }
 
 void overlay::update(void) {
-    ui_renderer->update();
+    if (not_hidden)
+        ui_renderer->update();
 }
 
 static std::string overlay::var_as_str(struct washdc_var const *var) {
@@ -25,6 +25,7 @@
 #include <cstring>
 #include <algorithm>
 #include <iostream>
+#include <string>
 
 #include <GLFW/glfw3.h>
 
@@ -36,6 +37,7 @@
 #include "window.hpp"
 #include "ui/overlay.hpp"
 #include "sound.hpp"
+#include "capture.h"
 #include "rend_if.hpp"
 #include "../renderer.h"
 
@@ -72,6 +74,8 @@ static void mouse_btn_cb(GLFWwindow *win, int btn, int action, int mods);
 static void
 mouse_scroll_cb(GLFWwindow *win, double scroll_x, double scroll_y);
 static void text_input_cb(GLFWwindow* window, unsigned int codepoint);
+static void joystick_cb(int jid, int event);
+static void load_gamepad_mappings(int jid);
 
 extern struct renderer const *renderer; // see main.cpp
 
@@ -83,7 +87,7 @@ enum controller_tp {
 
 static enum controller_tp controller_type(unsigned port_no);
 
-static void do_redraw(void) {
+static void do_redraw_gfx(void) {
     if (renderer->video_present) {
         renderer->video_present();
     } else {
@@ -95,6 +99,14 @@ static void do_redraw(void) {
     win_glfw_update();
 }
 
+static void do_redraw(void) {
+    /*
+     * if the render thread is enabled then it owns the graphics context, so
+     * the redraw has to happen over there.
+     */
+    washdc_gfx_run_sync(do_redraw_gfx);
+}
+
 struct win_intf const* get_win_intf_glfw(void) {
     static struct win_intf win_intf_glfw = { };
 
@@ -149,6 +161,33 @@ static int bind_ctrl_from_cfg(char const *name, char const *cfg_node) {
     }
 }
 
+static void load_gamepad_mappings(int jid) {
+    static char const *gamecontrollerdb[] = {
+#include "sdl_gamecontrollerdb.h"
+    };
+
+    char const *guid = glfwGetJoystickGUID(jid);
+    if (!guid)
+        return;
+    size_t guid_len = strlen(guid);
+
+    // collect every line for this GUID so GLFW only has to parse once
+    std::string mappings;
+    char const **curs;
+    for (curs = gamecontrollerdb; *curs; curs++) {
+        if (strncmp(*curs, guid, guid_len) == 0 && (*curs)[guid_len] == ',')
+            mappings += *curs;
+    }
+
+    if (mappings.size())
+        glfwUpdateGamepadMappings(mappings.c_str());
+}
+
+static void joystick_cb(int jid, int event) {
+    if (event == GLFW_CONNECTED)
+        load_gamepad_mappings(jid);
+}
+
 int win_glfw_init(unsigned width, unsigned height,
                   int version_opengl_major, int version_opengl_minor) {
     res_x = width;
@@ -164,12 +203,16 @@ int win_glfw_init(unsigned width, unsigned height,
         return -1;
     }
 
-    static char const *gamecontrollerdb[] = {
-#include "sdl_gamecontrollerdb.h"
-    };
-    char const **curs = gamecontrollerdb;
-    while (*curs)
-        glfwUpdateGamepadMappings(*curs++);
+    /*
+     * only the mappings for joysticks which are actually plugged in get
+     * handed to GLFW, and the rest are looked up if and when something
+     * else gets connected.
+     */
+    int jid;
+    for (jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; jid++)
+        if (glfwJoystickPresent(jid))
+            load_gamepad_mappings(jid);
+    glfwSetJoystickCallback(joystick_cb);
 
     GLFWmonitor *monitor = glfwGetPrimaryMonitor();
     const GLFWvidmode *vidmode = glfwGetVideoMode(monitor);
@@ -236,7 +279,9 @@ int win_glfw_init(unsigned width, unsigned height,
     bind_ctrl_from_cfg("toggle-filter", "wash.ctrl.toggle-filter");
     bind_ctrl_from_cfg("toggle-wireframe", "wash.ctrl.toggle-wireframe");
     bind_ctrl_from_cfg("screenshot", "wash.ctrl.screenshot");
+    bind_ctrl_from_cfg("toggle-capture", "wash.ctrl.toggle-capture");
     bind_ctrl_from_cfg("toggle-mute", "wash.ctrl.toggle-mute");
+    bind_ctrl_from_cfg("rewind", "wash.ctrl.rewind");
     bind_ctrl_from_cfg("resume-execution", "wash.ctrl.resume-execution");
     bind_ctrl_from_cfg("run-one-frame", "wash.ctrl.run-one-frame");
     bind_ctrl_from_cfg("pause-execution", "wash.ctrl.pause-execution");
@@ -1178,12 +1223,28 @@ static void scan_input(void) {
         washdc_save_screenshot_dir();
     screenshot_key_prev = screenshot_key;
 
+    static bool capture_key_prev = false;
+    bool capture_key = ctrl_get_button("toggle-capture");
+    if (capture_key && !capture_key_prev) {
+        if (capture_active())
+            capture_stop();
+        else
+            capture_start();
+    }
+    capture_key_prev = capture_key;
+
     static bool mute_key_prev = false;
     bool mute_key = ctrl_get_button("toggle-mute");
     if (mute_key && !mute_key_prev)
         sound::mute(!sound::is_muted());
     mute_key_prev = mute_key;
 
+    static bool rewind_key_prev = false;
+    bool rewind_key = ctrl_get_button("rewind");
+    if (rewind_key && !rewind_key_prev)
+        washdc_rewind(1);
+    rewind_key_prev = rewind_key;
+
     static bool resume_key_prev = false;
     bool resume_key = ctrl_get_button("resume-execution");
     if (resume_key && !resume_key_prev) {
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+
+################################################################################
+#
+#
+#   WashingtonDC Dreamcast Emulator
+#   Copyright (C) 2020 snickerbockers
+#   chimerasaurusrex@gmail.com
+#
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the
+#   Free Software Foundation, Inc.,
+#   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+#
+#
+################################################################################
+
+# decodes the binary system call trace written by builds with
+# DEEP_SYSCALL_TRACE enabled (see src/libwashdc/deep_syscall_trace.h).  This
+# prints the same thing washdbg's syscalls command does.
+#
+# usage: decode_syscall_trace.py [syscall_trace.bin]
+
+import struct
+import sys
+
+FILE_MAGIC = b"WASHSYSC"
+FILE_VERSION = 1
+
+# struct deep_syscall_file_hdr and struct deep_syscall_rec
+HDR_FMT = "=8sII"
+REC_FMT = "=Q12IBBB5x"
+
+REC_ENTER = 0
+REC_RETURN = 1
+
+FLAG_RECURSIVE = 1
+FLAG_READ_FAIL = 2
+
+GDROM_SYSCALLS = {
+    0: "GDROM_SEND_COMMAND",
+    1: "GDROM_CHECK_COMMAND",
+    2: "GDROM_MAINLOOP",
+    3: "GDROM_INIT",
+    4: "GDROM_CHECK_DRIVE",
+    6: "GDROM_DMA_BEGIN",
+    7: "GDROM_DMA_CHECK",
+    8: "GDROM_ABORT_COMMAND",
+    9: "GDROM_RESET",
+    10: "GDROM_SECTOR_MODE"
+}
+
+GDROM_CMDS = {
+    16: "READ_PIO", 17: "READ_DMA", 18: "GET_TOC", 19: "GET_TOC_2",
+    20: "PLAY", 21: "PLAY_2", 22: "PAUSE", 23: "RELEASE", 24: "INIT",
+    27: "SEEK", 28: "READ", 33: "STOP", 34: "GET_SCD", 35: "GET_SESSION"
+}
+
+DRIVE_STATS = [ "BUSY", "PAUSE", "STANDBY", "PLAY", "SEEK",
+                "SCAN", "OPEN", "NO_DISC", "RETRY", "ERROR" ]
+
+DISC_FMTS = {
+    0x00: "CD DIGITAL AUDIO", 0x10: "CD-ROM", 0x20: "CD-ROM XA",
+    0x30: "CD-I", 0x80: "GD-ROM"
+}
+
+UNKNOWN = "UNKNOWN (EMULATOR OR FIRMWARE ERROR)"
+
+def syscall_name(r6, r7):
+    name = None
+    if r6 == 0xffffffff:
+        name = { 0: "MISC_INIT", 1: "MISC_SETVECTOR" }.get(r7)
+    elif r6 == 0:
+        name = GDROM_SYSCALLS.get(r7)
+    return name or "unknown system call"
+
+def hex_words(words):
+    return " ".join("%08X" % word for word in words)
+
+def format_rec(rec):
+    (stamp, pc, pr, r4, r5, r6, r7, r0, gdrom_state,
+     e0, e1, e2, e3, tp, n_extra, flags) = rec
+    extra = [e0, e1, e2, e3][:n_extra]
+    gdrom = r6 == 0
+
+    line = "%u: " % stamp
+    if tp == REC_ENTER:
+        line += "%s r4=%08X r5=%08X r6=%08X r7=%08X pr=%08X" % \
+            (syscall_name(r6, r7), r4, r5, r6, r7, pr)
+        if gdrom and r7 == 0:
+            line += " cmd=%s params=[%s]" % \
+                (GDROM_CMDS.get(r4, "UNKNOWN"), hex_words(extra))
+        elif gdrom and r7 == 6 and n_extra == 2:
+            line += " dst=%08X n_bytes=%08X" % (extra[0], extra[1])
+    else:
+        line += "return from %s to %08X r0=%08X" % \
+            (syscall_name(r6, r7), pc, r0)
+        if gdrom and r7 == 1 and n_extra == 4:
+            line += " status=[%s]" % hex_words(extra)
+        elif gdrom and r7 == 4 and n_extra == 2:
+            drive_stat = DRIVE_STATS[extra[0]] \
+                if extra[0] < len(DRIVE_STATS) else UNKNOWN
+            line += " drive_status=%s disc_format=%s" % \
+                (drive_stat, DISC_FMTS.get(extra[1], UNKNOWN))
+        elif gdrom and r7 == 7 and n_extra == 1:
+            line += " n_bytes=%08X" % extra[0]
+
+    # gdrom_state is signed in the C version
+    if gdrom_state >= 0x80000000:
+        gdrom_state -= 0x100000000
+    line += " gdrom_state=%d" % gdrom_state
+    if flags & FLAG_RECURSIVE:
+        line += " (recursive, trace is unreliable)"
+    if flags & FLAG_READ_FAIL:
+        line += " (guest memory read failed)"
+    return line
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "syscall_trace.bin"
+    with open(path, "rb") as trace:
+        hdr = trace.read(struct.calcsize(HDR_FMT))
+        if len(hdr) != struct.calcsize(HDR_FMT):
+            sys.exit("%s is too short to be a system call trace" % path)
+        magic, version, rec_len = struct.unpack(HDR_FMT, hdr)
+        if magic != FILE_MAGIC:
+            sys.exit("%s is not a system call trace" % path)
+        if version != FILE_VERSION or rec_len != struct.calcsize(REC_FMT):
+            sys.exit("%s is from an incompatible version of WashingtonDC" %
+                     path)
+
+        while True:
+            rec = trace.read(rec_len)
+            if len(rec) < rec_len:
+                break
+            print(format_rec(struct.unpack(REC_FMT, rec)))
+
+if __name__ == "__main__":
+    main()
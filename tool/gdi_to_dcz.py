@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+
+################################################################################
+#
+#
+#   WashingtonDC Dreamcast Emulator
+#   Copyright (C) 2020 snickerbockers
+#   chimerasaurusrex@gmail.com
+#
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the
+#   Free Software Foundation, Inc.,
+#   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+#
+#
+################################################################################
+
+# converts a .gdi image into WashingtonDC's hunk-compressed .dcz format (see
+# src/libwashdc/dcz.h).
+#
+# usage: gdi_to_dcz.py [-n hunk_frames] [-l level] input.gdi output.dcz
+
+import argparse
+import os
+import struct
+import zlib
+
+FRAME_SIZE = 2352
+MODE1_DATA_OFFSET = 16
+
+DCZ_VERSION = 1
+DCZ_CODEC_NONE = 0
+DCZ_CODEC_DEFLATE = 1
+
+def parse_gdi(path):
+    tracks = []
+    with open(path, 'r') as gdi:
+        lines = [ln.split() for ln in gdi.read().splitlines() if ln.strip()]
+    n_tracks = int(lines[0][0])
+    for fields in lines[1:n_tracks + 1]:
+        # track_no lba ctrl sector_size path offset
+        lba, ctrl, sector_size = int(fields[1]), int(fields[2]), int(fields[3])
+        name = ' '.join(fields[4:-1]).strip('"')
+        tracks.append({ 'fad' : lba + 150, 'ctrl' : ctrl,
+                        'sector_size' : sector_size,
+                        'path' : os.path.join(os.path.dirname(path), name) })
+    if len(tracks) != n_tracks or n_tracks < 3:
+        raise ValueError('%s is not a valid .gdi' % path)
+    return tracks
+
+def read_frames(track):
+    sector_size = track['sector_size']
+    if sector_size not in (2048, FRAME_SIZE):
+        raise ValueError('unsupported sector size %d' % sector_size)
+    with open(track['path'], 'rb') as src:
+        while True:
+            sector = src.read(sector_size)
+            if not sector:
+                break
+            sector = sector.ljust(sector_size, b'\0')
+            if sector_size == 2048:
+                # only the user data is there, pad it out to a full frame
+                sector = (b'\0' * MODE1_DATA_OFFSET + sector).ljust(FRAME_SIZE,
+                                                                    b'\0')
+            yield sector
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-n', '--hunk-frames', type=int, default=8)
+    parser.add_argument('-l', '--level', type=int, default=9)
+    parser.add_argument('gdi')
+    parser.add_argument('dcz')
+    args = parser.parse_args()
+
+    tracks = parse_gdi(args.gdi)
+    for track in tracks:
+        track['n_frames'] = 0
+
+    header_len = 32 + 16 * len(tracks)
+    hunks = []
+    with open(args.dcz, 'wb') as out:
+        # the header and hunk index get filled in at the end once the number
+        # of hunks is known, so write the hunks first and leave room for them.
+        total_frames = sum((os.path.getsize(t['path']) + t['sector_size'] - 1) //
+                           t['sector_size'] for t in tracks)
+        n_hunks = (total_frames + args.hunk_frames - 1) // args.hunk_frames
+        offset = header_len + 16 * n_hunks
+        out.seek(offset)
+
+        pending = b''
+        def flush(dat):
+            nonlocal offset
+            comp = zlib.compress(dat, args.level)
+            codec = DCZ_CODEC_DEFLATE
+            if len(comp) >= len(dat):
+                comp, codec = dat, DCZ_CODEC_NONE
+            out.write(comp)
+            hunks.append((offset, len(comp), codec))
+            offset += len(comp)
+
+        for track in tracks:
+            for frame in read_frames(track):
+                track['n_frames'] += 1
+                pending += frame
+                if len(pending) == args.hunk_frames * FRAME_SIZE:
+                    flush(pending)
+                    pending = b''
+        if pending:
+            flush(pending)
+
+        assert len(hunks) == n_hunks
+
+        out.seek(0)
+        out.write(struct.pack('<8sIIIIII', b'WASHDCZ\0', DCZ_VERSION,
+                              len(tracks), args.hunk_frames, n_hunks, 0, 0))
+        for track in tracks:
+            out.write(struct.pack('<IIII', track['fad'], track['ctrl'],
+                                  track['n_frames'], 0))
+        for hunk in hunks:
+            out.write(struct.pack('<QII', *hunk))
+
+if __name__ == '__main__':
+    main()